@@ -9,6 +9,7 @@
 
 #include "AbstractDomain.h"
 #include "CallGraph.h"
+#include "ConcurrentContainers.h"
 #include "MethodOverrideGraph.h"
 #include "PatriciaTreeMapAbstractEnvironment.h"
 #include "PatriciaTreeMapAbstractPartition.h"
@@ -124,10 +125,27 @@ struct Summary : public AbstractDomain<Summary> {
 
 namespace mog = method_override_graph;
 
+/*
+ * The inputs and results of the last intraprocedural analysis of a method.
+ * That analysis only depends on the calling context of the method and on the
+ * summaries of the callees it queries, so while none of those change, each
+ * further iteration over the call graph would compute the same results.
+ */
+struct CachedAnalysis {
+  reflection::CallingContext context;
+  std::vector<std::pair<const DexMethod*, reflection::AbstractObjectDomain>>
+      callee_returns;
+  reflection::AbstractObjectDomain return_value;
+  reflection::ReflectionSites reflection_sites;
+  reflection::CallingContextMap calling_context_partition;
+};
+
 struct Metadata {
   std::unique_ptr<const mog::Graph> method_override_graph;
   // For speeding up reflection analysis
   reflection::MetadataCache refl_meta_cache;
+  ConcurrentMap<const DexMethod*, std::shared_ptr<const CachedAnalysis>>
+      analysis_cache;
 };
 
 template <typename FunctionSummaries>
@@ -171,15 +189,33 @@ class ReflectionAnalyzer : public Intraprocedural {
     };
 
     auto context = m_context->get(m_method);
-    reflection::ReflectionAnalysis analysis(const_cast<DexMethod*>(m_method),
-                                            &context,
-                                            &query_fn,
-                                            &m_metadata->refl_meta_cache);
+    auto cached = m_metadata->analysis_cache.get(m_method, nullptr);
+    if (cached == nullptr || !is_up_to_date(*cached, context, query_fn)) {
+      auto analysis_inputs = std::make_shared<CachedAnalysis>();
+      analysis_inputs->context = context;
+      reflection::SummaryQueryFn recording_query_fn =
+          [&](const DexMethod* callee) {
+            auto ret = query_fn(callee);
+            analysis_inputs->callee_returns.emplace_back(callee, ret);
+            return ret;
+          };
+      reflection::ReflectionAnalysis analysis(const_cast<DexMethod*>(m_method),
+                                              &context,
+                                              &recording_query_fn,
+                                              &m_metadata->refl_meta_cache);
+      analysis_inputs->return_value = analysis.get_return_value();
+      analysis_inputs->reflection_sites = analysis.get_reflection_sites();
+      analysis_inputs->calling_context_partition =
+          analysis.get_calling_context_partition();
+      m_metadata->analysis_cache.insert_or_assign(
+          std::make_pair(m_method, analysis_inputs));
+      cached = std::move(analysis_inputs);
+    }
 
-    m_summary.set_value(analysis.get_return_value());
-    m_summary.set_reflection_sites(std::move(analysis.get_reflection_sites()));
+    m_summary.set_value(cached->return_value);
+    m_summary.set_reflection_sites(cached->reflection_sites);
 
-    auto partition = analysis.get_calling_context_partition();
+    const auto& partition = cached->calling_context_partition;
     if (!partition.is_top() && !partition.is_bottom()) {
       for (const auto& entry : partition.bindings()) {
         auto insn = entry.first;
@@ -213,6 +249,21 @@ class ReflectionAnalyzer : public Intraprocedural {
     }
   }
 
+  static bool is_up_to_date(const CachedAnalysis& cached,
+                            const reflection::CallingContext& context,
+                            const reflection::SummaryQueryFn& query_fn) {
+    if (!cached.context.equals(context)) {
+      return false;
+    }
+    for (const auto& callee_and_return : cached.callee_returns) {
+      if (!query_fn(callee_and_return.first)
+               .equals(callee_and_return.second)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
   void summarize() override {
     if (!m_method) {
       return;
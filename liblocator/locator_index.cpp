@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_set>
+#include "locator_index.h"
+
+namespace facebook {
+
+LocatorIndexView::LocatorIndexView(const void* data, size_t size) noexcept {
+  const uint32_t* words = (const uint32_t*)data;
+  if (((uintptr_t)data & 3) != 0 || size < header_words * 4 ||
+      words[0] != magic || words[1] != version || words[2] == 0 ||
+      words[3] == 0) {
+    return;
+  }
+  uint32_t num_slots = words[2];
+  uint32_t num_buckets = words[3];
+  uint32_t pool_size = words[4];
+  uint64_t tables_size =
+      ((uint64_t)header_words + num_buckets + 2 * (uint64_t)num_slots) * 4;
+  if (tables_size + pool_size != size) {
+    return;
+  }
+  const char* pool = (const char*)data + tables_size;
+  if (pool_size == 0 || pool[pool_size - 1] != '\0') {
+    return;
+  }
+  m_buckets = words + header_words;
+  m_slots = m_buckets + num_buckets;
+  m_pool = pool;
+  m_num_slots = num_slots;
+  m_num_buckets = num_buckets;
+  m_pool_size = pool_size;
+}
+
+static void push_word(std::vector<uint8_t>& out, uint32_t word) {
+  for (int i = 0; i < 4; i++) {
+    out.push_back((word >> (8 * i)) & 0xFF);
+  }
+}
+
+std::vector<uint8_t> build_locator_index(
+    const std::vector<LocatorIndexEntry>& entries) {
+  {
+    std::unordered_set<std::string> seen;
+    for (const auto& entry : entries) {
+      if (!seen.insert(entry.descriptor).second) {
+        throw std::runtime_error("duplicate class in locator index");
+      }
+    }
+  }
+
+  // About four descriptors per bucket, and some slack in the slots, keep
+  // the seed search short.
+  uint32_t num_entries = entries.size();
+  uint32_t num_buckets = num_entries / 4 + 1;
+  uint32_t num_slots = num_entries + num_entries / 8 + 1;
+
+  std::vector<std::vector<uint32_t>> buckets(num_buckets);
+  for (uint32_t i = 0; i < num_entries; i++) {
+    const char* descriptor = entries[i].descriptor.c_str();
+    buckets[LocatorIndexView::hash(descriptor, 0) % num_buckets].push_back(i);
+  }
+  std::vector<uint32_t> order(num_buckets);
+  for (uint32_t b = 0; b < num_buckets; b++) {
+    order[b] = b;
+  }
+  std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    return buckets[a].size() > buckets[b].size();
+  });
+
+  // Place the largest buckets first, while most slots are still free.
+  std::vector<uint32_t> seeds(num_buckets, 0);
+  std::vector<uint32_t> slot_entry(num_slots,
+                                   LocatorIndexView::empty_slot);
+  std::vector<uint32_t> candidate;
+  for (uint32_t b : order) {
+    const auto& bucket = buckets[b];
+    if (bucket.empty()) {
+      break;
+    }
+    for (uint32_t seed = 1;; seed++) {
+      if (seed == 0) {
+        throw std::runtime_error("cannot build locator index");
+      }
+      candidate.clear();
+      bool fits = true;
+      for (uint32_t i : bucket) {
+        uint32_t slot =
+            LocatorIndexView::hash(entries[i].descriptor.c_str(), seed) %
+            num_slots;
+        if (slot_entry[slot] != LocatorIndexView::empty_slot ||
+            std::find(candidate.begin(), candidate.end(), slot) !=
+                candidate.end()) {
+          fits = false;
+          break;
+        }
+        candidate.push_back(slot);
+      }
+      if (fits) {
+        for (size_t j = 0; j < bucket.size(); j++) {
+          slot_entry[candidate[j]] = bucket[j];
+        }
+        seeds[b] = seed;
+        break;
+      }
+    }
+  }
+
+  std::vector<uint32_t> offsets;
+  std::string pool;
+  for (const auto& entry : entries) {
+    offsets.push_back(pool.size());
+    pool.append(entry.descriptor.c_str(), entry.descriptor.size() + 1);
+  }
+  if (pool.empty()) {
+    // Keeps the pool non-empty, so that readers can tell us from garbage.
+    pool.push_back('\0');
+  }
+
+  std::vector<uint8_t> out;
+  out.reserve((LocatorIndexView::header_words + num_buckets + 2 * num_slots) *
+                  4 +
+              pool.size());
+  push_word(out, LocatorIndexView::magic);
+  push_word(out, LocatorIndexView::version);
+  push_word(out, num_slots);
+  push_word(out, num_buckets);
+  push_word(out, pool.size());
+  for (uint32_t seed : seeds) {
+    push_word(out, seed);
+  }
+  for (uint32_t i : slot_entry) {
+    if (i == LocatorIndexView::empty_slot) {
+      push_word(out, LocatorIndexView::empty_slot);
+      push_word(out, 0);
+      continue;
+    }
+    const auto& entry = entries[i];
+    // Validates the numbers the same way locator strings do.
+    Locator::make(0, entry.dexnr, entry.clsnr);
+    push_word(out, offsets[i]);
+    push_word(out, entry.dexnr | (entry.clsnr << Locator::dexnr_bits));
+  }
+  out.insert(out.end(), pool.begin(), pool.end());
+  return out;
+}
+
+} // namespace facebook
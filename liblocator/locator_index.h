@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "locator.h"
+
+namespace facebook {
+
+//
+// A locator index is a standalone blob, emitted next to the dexes of a
+// store, that maps class descriptors to the (dexnr, clsnr) pair of their
+// locator.  Unlike locator strings it takes no space in the dex string
+// tables, and a lookup costs two hashes of the descriptor and a single
+// string comparison, with no decoding.
+//
+// The index is a perfect hash table built with the hash-and-displace
+// scheme: each descriptor is first hashed into one of `num_buckets`
+// buckets, and each bucket stores a seed such that hashing all the
+// descriptors of the bucket again with that seed yields distinct free
+// slots.  All integers are little-endian uint32_t:
+//
+//   header:   magic, version, num_slots, num_buckets, pool_size
+//   buckets:  num_buckets seeds
+//   slots:    num_slots (name offset, dexnr | clsnr << dexnr_bits)
+//               pairs; unused slots have the name offset empty_slot
+//   pool:     pool_size bytes of NUL-terminated descriptors
+//
+// The store number isn't recorded; there is one index per store.  The
+// reader maps the words directly, so the blob must be 4-byte aligned, as
+// mmap'ed files are, and the host little-endian, as all Android ABIs are.
+//
+class LocatorIndexView {
+ public:
+  constexpr static const uint32_t magic = 0x58494c52; // "RLIX"
+  constexpr static const uint32_t version = 1;
+  constexpr static const uint32_t empty_slot = 0xFFFFFFFF;
+  constexpr static const uint32_t header_words = 5;
+
+  // Hash of a NUL-terminated descriptor; seed 0 selects the bucket, the
+  // bucket's seed selects the slot.
+  static inline uint32_t hash(const char* descriptor, uint32_t seed) noexcept;
+
+  // Validates the blob; on failure, the view is empty and every find
+  // fails.  The blob must outlive the view.
+  LocatorIndexView(const void* data, size_t size) noexcept;
+
+  bool valid() const noexcept { return m_slots != nullptr; }
+
+  // Finds the locator of the given descriptor.  Returns false if the class
+  // is not in the index.
+  inline bool find(const char* descriptor,
+                   uint32_t* dexnr,
+                   uint32_t* clsnr) const noexcept;
+
+ private:
+  const uint32_t* m_buckets{nullptr};
+  const uint32_t* m_slots{nullptr};
+  const char* m_pool{nullptr};
+  uint32_t m_num_slots{0};
+  uint32_t m_num_buckets{0};
+  uint32_t m_pool_size{0};
+};
+
+// Builds the index blob of a store from (descriptor, dexnr, clsnr) entries.
+// Throws if a descriptor appears twice.
+struct LocatorIndexEntry {
+  std::string descriptor;
+  uint32_t dexnr;
+  uint32_t clsnr;
+};
+std::vector<uint8_t> build_locator_index(
+    const std::vector<LocatorIndexEntry>& entries);
+
+uint32_t LocatorIndexView::hash(const char* descriptor,
+                                uint32_t seed) noexcept {
+  // FNV-1a, with the seed folded into the basis and a final avalanche so
+  // that the low bits, which pick the slot, depend on every byte.
+  uint32_t h = 2166136261u ^ (seed * 0x9E3779B9u);
+  for (const uint8_t* p = (const uint8_t*)descriptor; *p != 0; ++p) {
+    h = (h ^ *p) * 16777619u;
+  }
+  h ^= h >> 16;
+  h *= 0x85EBCA6Bu;
+  h ^= h >> 13;
+  return h;
+}
+
+bool LocatorIndexView::find(const char* descriptor,
+                            uint32_t* dexnr,
+                            uint32_t* clsnr) const noexcept {
+  if (m_slots == nullptr) {
+    return false;
+  }
+  uint32_t seed = m_buckets[hash(descriptor, 0) % m_num_buckets];
+  const uint32_t* slot = &m_slots[2 * (hash(descriptor, seed) % m_num_slots)];
+  if (slot[0] >= m_pool_size || strcmp(m_pool + slot[0], descriptor) != 0) {
+    return false;
+  }
+  *dexnr = slot[1] & ((1u << Locator::dexnr_bits) - 1);
+  *clsnr = slot[1] >> Locator::dexnr_bits;
+  return true;
+}
+
+} // namespace facebook
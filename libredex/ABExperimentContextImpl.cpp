@@ -29,7 +29,7 @@ void ABExperimentContextImpl::flush() {
 
   if (!use_test()) {
     // control should only keep the original cfg, not the modified one
-    m_cloned_cfg->deep_copy(m_cfg);
+    m_cfg->restore(std::move(m_snapshot));
   } // else do nothing
 
   // Clean up
@@ -68,7 +68,6 @@ void ABExperimentContextImpl::setup_context() {
     return;
   }
 
-  // Clone the original content of the CFG
-  m_cloned_cfg = std::make_unique<cfg::ControlFlowGraph>();
-  m_cfg->deep_copy(m_cloned_cfg.get());
+  // Keep a compact copy of the original content of the CFG
+  m_snapshot = m_cfg->snapshot();
 }
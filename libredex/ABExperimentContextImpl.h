@@ -34,7 +34,8 @@ class ABExperimentContextImpl : public ABExperimentContext {
 
   DexMethod* m_original_method{nullptr};
   cfg::ControlFlowGraph* m_cfg{nullptr};
-  std::unique_ptr<cfg::ControlFlowGraph> m_cloned_cfg{nullptr};
+  // The original code, to roll back to in control mode.
+  std::unique_ptr<cfg::ControlFlowGraph::Snapshot> m_snapshot{nullptr};
   bool m_flushed{false};
   ABExperimentPreferredMode m_preferred_mode;
 
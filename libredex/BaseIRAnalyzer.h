@@ -13,6 +13,14 @@
 
 namespace ir_analyzer {
 
+/*
+ * Analyzers whose transfer functions are safe to run concurrently on distinct
+ * blocks pass this to `set_parallel_threshold`, so that the handful of huge
+ * methods in an app are analyzed on several threads. Below it, spinning up a
+ * work queue costs more than it saves.
+ */
+constexpr size_t PARALLEL_FIXPOINT_MIN_NODES = 2000;
+
 template <typename Domain>
 class BaseIRAnalyzer
     : public sparta::MonotonicFixpointIterator<cfg::GraphInterface, Domain> {
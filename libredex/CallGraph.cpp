@@ -7,124 +7,112 @@
 
 #include "CallGraph.h"
 
+#include <algorithm>
+#include <functional>
 #include <utility>
 
 #include "MethodOverrideGraph.h"
 #include "Walkers.h"
+#include "WeakTopologicalOrdering.h"
 
 namespace mog = method_override_graph;
 
-namespace {
+namespace call_graph {
 
-using namespace call_graph;
+SingleCalleeStrategy::SingleCalleeStrategy(const Scope& scope)
+    : m_scope(scope) {
+  auto non_virtual_vec = mog::get_non_true_virtuals(scope);
+  m_non_virtual.insert(non_virtual_vec.begin(), non_virtual_vec.end());
+}
 
-class SingleCalleeStrategy final : public BuildStrategy {
- public:
-  explicit SingleCalleeStrategy(const Scope& scope) : m_scope(scope) {
-    auto non_virtual_vec = mog::get_non_true_virtuals(scope);
-    m_non_virtual.insert(non_virtual_vec.begin(), non_virtual_vec.end());
+CallSites SingleCalleeStrategy::get_callsites(const DexMethod* method) const {
+  CallSites callsites;
+  auto* code = const_cast<IRCode*>(method->get_code());
+  if (code == nullptr) {
+    return callsites;
   }
-
-  CallSites get_callsites(const DexMethod* method) const override {
-    CallSites callsites;
-    auto* code = const_cast<IRCode*>(method->get_code());
-    if (code == nullptr) {
-      return callsites;
-    }
-    for (auto& mie : InstructionIterable(code)) {
-      auto insn = mie.insn;
-      if (is_invoke(insn->opcode())) {
-        auto callee = resolve_method(insn->get_method(),
-                                     opcode_to_search(insn),
-                                     m_resolved_refs,
-                                     method);
-        if (callee == nullptr || is_definitely_virtual(callee)) {
-          continue;
-        }
-        if (callee->is_concrete()) {
-          callsites.emplace_back(callee, code->iterator_to(mie));
-        }
+  for (auto& mie : InstructionIterable(code)) {
+    auto insn = mie.insn;
+    if (is_invoke(insn->opcode())) {
+      auto callee = resolve_method(insn->get_method(),
+                                   opcode_to_search(insn),
+                                   m_resolved_refs,
+                                   method);
+      if (callee == nullptr || is_definitely_virtual(callee)) {
+        continue;
+      }
+      if (callee->is_concrete()) {
+        callsites.emplace_back(callee, code->iterator_to(mie));
       }
     }
-    return callsites;
   }
+  return callsites;
+}
 
-  std::vector<const DexMethod*> get_roots() const override {
-    std::vector<const DexMethod*> roots;
-
-    walk::code(m_scope, [&](DexMethod* method, IRCode& code) {
-      if (is_definitely_virtual(method) || root(method) ||
-          method::is_clinit(method)) {
-        roots.emplace_back(method);
-      }
-    });
-    return roots;
-  }
-
- private:
-  bool is_definitely_virtual(DexMethod* method) const {
-    return method->is_virtual() && m_non_virtual.count(method) == 0;
-  }
-
-  const Scope& m_scope;
-  std::unordered_set<DexMethod*> m_non_virtual;
-  mutable MethodRefCache m_resolved_refs;
-};
-
-class CompleteCallGraphStrategy final : public BuildStrategy {
- public:
-  explicit CompleteCallGraphStrategy(const Scope& scope)
-      : m_scope(scope), m_method_override_graph(mog::build_graph(scope)) {}
-
-  CallSites get_callsites(const DexMethod* method) const override {
-    CallSites callsites;
-    auto* code = const_cast<IRCode*>(method->get_code());
-    if (code == nullptr) {
-      return callsites;
-    }
-    for (auto& mie : InstructionIterable(code)) {
-      auto insn = mie.insn;
-      if (is_invoke(insn->opcode())) {
-        auto callee = resolve_method(insn->get_method(),
-                                     opcode_to_search(insn),
-                                     m_resolved_refs,
-                                     method);
-        if (callee == nullptr) {
-          continue;
-        }
-        if (callee->is_concrete()) {
-          callsites.emplace_back(callee, code->iterator_to(mie));
-        }
-        auto overriding =
-            mog::get_overriding_methods(*m_method_override_graph, callee);
+std::vector<const DexMethod*> SingleCalleeStrategy::get_roots() const {
+  std::vector<const DexMethod*> roots;
 
-        for (auto m : overriding) {
-          callsites.emplace_back(m, code->iterator_to(mie));
-        }
-      }
+  walk::code(m_scope, [&](DexMethod* method, IRCode& code) {
+    if (is_definitely_virtual(method) || root(method) ||
+        method::is_clinit(method)) {
+      roots.emplace_back(method);
     }
+  });
+  return roots;
+}
+
+bool SingleCalleeStrategy::is_definitely_virtual(DexMethod* method) const {
+  return method->is_virtual() && m_non_virtual.count(method) == 0;
+}
+
+CompleteCallGraphStrategy::CompleteCallGraphStrategy(const Scope& scope)
+    : m_scope(scope),
+      m_method_override_graph(
+          std::make_unique<mog::CompactGraph>(*mog::build_graph(scope))) {}
+
+CompleteCallGraphStrategy::~CompleteCallGraphStrategy() {}
+
+CallSites CompleteCallGraphStrategy::get_callsites(
+    const DexMethod* method) const {
+  CallSites callsites;
+  auto* code = const_cast<IRCode*>(method->get_code());
+  if (code == nullptr) {
     return callsites;
   }
+  for (auto& mie : InstructionIterable(code)) {
+    auto insn = mie.insn;
+    if (is_invoke(insn->opcode())) {
+      auto callee = resolve_method(insn->get_method(),
+                                   opcode_to_search(insn),
+                                   m_resolved_refs,
+                                   method);
+      if (callee == nullptr) {
+        continue;
+      }
+      if (callee->is_concrete()) {
+        callsites.emplace_back(callee, code->iterator_to(mie));
+      }
+      auto overriding =
+          mog::get_overriding_methods(*m_method_override_graph, callee);
 
-  std::vector<const DexMethod*> get_roots() const override {
-    std::vector<const DexMethod*> roots;
-
-    walk::methods(m_scope, [&](DexMethod* method) {
-      if (root(method) || method::is_clinit(method)) {
-        roots.emplace_back(method);
+      for (auto m : overriding) {
+        callsites.emplace_back(m, code->iterator_to(mie));
       }
-    });
-    return roots;
+    }
   }
+  return callsites;
+}
 
- private:
-  const Scope& m_scope;
-  mutable MethodRefCache m_resolved_refs;
-  std::unique_ptr<const mog::Graph> m_method_override_graph;
-};
-} // namespace
+std::vector<const DexMethod*> CompleteCallGraphStrategy::get_roots() const {
+  std::vector<const DexMethod*> roots;
 
-namespace call_graph {
+  walk::methods(m_scope, [&](DexMethod* method) {
+    if (root(method) || method::is_clinit(method)) {
+      roots.emplace_back(method);
+    }
+  });
+  return roots;
+}
 
 Graph single_callee_graph(const Scope& scope) {
   return Graph(SingleCalleeStrategy(scope));
@@ -196,4 +184,286 @@ void Graph::add_edge(const NodeId& caller,
   callee->m_predecessors.emplace_back(edge);
 }
 
+void Graph::detach_from_callee(const EdgeId& edge) {
+  auto& predecessors = edge->callee()->m_predecessors;
+  predecessors.erase(std::find(predecessors.begin(), predecessors.end(), edge));
+}
+
+void Graph::add_callsite_edge(const NodeId& caller,
+                              const NodeId& callee,
+                              const IRList::iterator& invoke_it) {
+  auto& successors = caller->m_successors;
+  if (successors.size() == 1 && successors[0]->callee() == m_exit) {
+    detach_from_callee(successors[0]);
+    successors.clear();
+  }
+  add_edge(caller, callee, invoke_it);
+}
+
+template <typename Predicate>
+void Graph::remove_callee_edges(const NodeId& caller, const Predicate& pred) {
+  auto& successors = caller->m_successors;
+  auto it = std::stable_partition(
+      successors.begin(), successors.end(),
+      [&](const EdgeId& edge) { return !pred(edge); });
+  for (auto removed = it; removed != successors.end(); ++removed) {
+    detach_from_callee(*removed);
+  }
+  successors.erase(it, successors.end());
+  if (successors.empty() && caller != m_entry) {
+    add_edge(caller, m_exit, IRList::iterator());
+  }
+}
+
+void Graph::remove_caller_edges(const NodeId& callee) {
+  // Copy, as removing the edges modifies the predecessors of :callee.
+  auto predecessors = callee->m_predecessors;
+  for (const auto& edge : predecessors) {
+    remove_callee_edges(edge->caller(),
+                        [&](const EdgeId& e) { return e == edge; });
+  }
+}
+
+void Graph::add_callsite(const DexMethod* caller,
+                         const DexMethod* callee,
+                         const IRList::iterator& invoke_it) {
+  auto callee_node = make_node(callee);
+  if (callee_node->m_successors.empty()) {
+    add_edge(callee_node, m_exit, IRList::iterator());
+  }
+  add_callsite_edge(node(caller), callee_node, invoke_it);
+}
+
+void Graph::remove_callsite(const DexMethod* caller,
+                            const IRList::iterator& invoke_it) {
+  remove_callee_edges(node(caller), [&](const EdgeId& edge) {
+    return edge->callee() != m_exit && edge->invoke_iterator() == invoke_it;
+  });
+}
+
+void Graph::retarget_callsite(const DexMethod* caller,
+                              const IRList::iterator& invoke_it,
+                              const DexMethod* callee) {
+  remove_callsite(caller, invoke_it);
+  add_callsite(caller, callee, invoke_it);
+}
+
+void Graph::remove_method(const DexMethod* method) {
+  auto it = m_nodes.find(method);
+  if (it == m_nodes.end()) {
+    return;
+  }
+  auto method_node = it->second;
+  remove_caller_edges(method_node);
+  for (const auto& edge : method_node->m_successors) {
+    detach_from_callee(edge);
+  }
+  method_node->m_successors.clear();
+  m_nodes.erase(it);
+}
+
+size_t Graph::rebuild_callsites(const BuildStrategy& strat,
+                                const std::vector<const DexMethod*>& dirty) {
+  size_t added = 0;
+  // Unlike in the constructor, only the methods that are new to the graph
+  // are explored, since the edges of all others are up to date.
+  auto visit = [&](const DexMethod* caller) {
+    auto visit_impl = [&](const DexMethod* caller, auto& visit_fn) -> void {
+      auto caller_node = make_node(caller);
+      auto callsites = strat.get_callsites(caller);
+      if (callsites.empty()) {
+        this->add_edge(caller_node, m_exit, IRList::iterator());
+      }
+      for (const auto& callsite : callsites) {
+        bool is_new = !has_node(callsite.callee);
+        this->add_edge(caller_node, make_node(callsite.callee),
+                       callsite.invoke);
+        if (is_new) {
+          ++added;
+          visit_fn(callsite.callee, visit_fn);
+        }
+      }
+    };
+    visit_impl(caller, visit_impl);
+  };
+
+  std::vector<const DexMethod*> callers;
+  for (const DexMethod* method : dirty) {
+    auto it = m_nodes.find(method);
+    if (it == m_nodes.end()) {
+      continue;
+    }
+    auto& successors = it->second->m_successors;
+    if (successors.empty()) {
+      // Already cleared, i.e. a duplicate.
+      continue;
+    }
+    for (const auto& edge : successors) {
+      detach_from_callee(edge);
+    }
+    successors.clear();
+    callers.push_back(method);
+  }
+  for (const DexMethod* caller : callers) {
+    visit(caller);
+  }
+  return added;
+}
+
+CompactGraph::CompactGraph(const Graph& graph) {
+  // Number the nodes in breadth-first order from the entry, so that callers
+  // and their callees tend to be close to each other. Nodes that have become
+  // unreachable through incremental updates go last.
+  std::unordered_map<const Node*, NodeId> ids;
+  std::vector<const Node*> nodes;
+  auto number = [&](const Node* node) {
+    if (ids.emplace(node, nodes.size()).second) {
+      nodes.push_back(node);
+    }
+  };
+  number(graph.m_entry.get());
+  number(graph.m_exit.get());
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    for (const auto& edge : nodes[i]->callees()) {
+      number(edge->callee().get());
+    }
+  }
+  if (nodes.size() < graph.m_nodes.size() + 2) {
+    std::vector<const DexMethod*> unreachable;
+    for (const auto& p : graph.m_nodes) {
+      if (!ids.count(p.second.get())) {
+        unreachable.push_back(p.first);
+      }
+    }
+    std::sort(unreachable.begin(), unreachable.end(), compare_dexmethods);
+    for (const auto* method : unreachable) {
+      number(graph.m_nodes.at(method).get());
+    }
+  }
+
+  m_methods.reserve(nodes.size());
+  m_nodes.reserve(nodes.size());
+  std::vector<std::pair<NodeId, NodeId>> callee_pairs;
+  for (NodeId id = 0; id < nodes.size(); ++id) {
+    const auto* method = nodes[id]->method();
+    m_methods.push_back(method);
+    if (method != nullptr) {
+      m_nodes.emplace(method, id);
+    }
+    for (const auto& edge : nodes[id]->callees()) {
+      callee_pairs.emplace_back(id, ids.at(edge->callee().get()));
+      m_edge_callers.push_back(id);
+      m_invokes.push_back(edge->invoke_iterator());
+    }
+  }
+  // The pairs are grouped by caller already, so the position of each pair is
+  // the id of its edge.
+  m_callees = CompressedSparseRow<>(nodes.size(), callee_pairs);
+  std::vector<std::pair<NodeId, EdgeId>> caller_edge_pairs;
+  caller_edge_pairs.reserve(callee_pairs.size());
+  for (EdgeId e = 0; e < callee_pairs.size(); ++e) {
+    caller_edge_pairs.emplace_back(callee_pairs[e].second, e);
+  }
+  m_caller_edges = CompressedSparseRow<>(nodes.size(), caller_edge_pairs);
+}
+
+size_t CompactGraph::memory_footprint() const {
+  // Assume about two words of overhead per hash table entry.
+  return m_methods.capacity() * sizeof(const DexMethod*) +
+         m_nodes.size() * (sizeof(std::pair<const DexMethod*, NodeId>) +
+                           2 * sizeof(void*)) +
+         m_callees.memory_footprint() + m_caller_edges.memory_footprint() +
+         m_edge_callers.capacity() * sizeof(NodeId) +
+         m_invokes.capacity() * sizeof(IRList::iterator);
+}
+
+std::vector<std::vector<Component>> components_by_level(
+    const Scope& scope, const Graph& graph) {
+  std::vector<const DexMethod*> methods;
+  walk::code(scope, [&](const DexMethod* method, IRCode&) {
+    methods.push_back(method);
+  });
+  std::sort(methods.begin(), methods.end(), compare_dexmethods);
+  std::unordered_set<const DexMethod*> method_set(methods.begin(),
+                                                  methods.end());
+  std::unordered_map<const DexMethod*, std::vector<const DexMethod*>> callees;
+  std::unordered_map<const DexMethod*, std::vector<const DexMethod*>> callers;
+  for (auto method : methods) {
+    if (!graph.has_node(method)) {
+      continue;
+    }
+    for (const auto& edge : graph.node(method)->callees()) {
+      auto callee = edge->callee()->method();
+      if (callee != nullptr && callee != method && method_set.count(callee)) {
+        callees[method].push_back(callee);
+        callers[callee].push_back(method);
+      }
+    }
+  }
+  for (auto* map : {&callees, &callers}) {
+    for (auto& p : *map) {
+      auto& v = p.second;
+      std::sort(v.begin(), v.end(), compare_dexmethods);
+      v.erase(std::unique(v.begin(), v.end()), v.end());
+    }
+  }
+
+  // The top-level components of a WTO following the caller edges are the
+  // strongly connected components, callees first.
+  sparta::WeakTopologicalOrdering<const DexMethod*> wto(
+      nullptr, [&methods, &callers](const DexMethod* const& m) {
+        if (m == nullptr) {
+          return methods;
+        }
+        auto it = callers.find(m);
+        return it == callers.end() ? std::vector<const DexMethod*>()
+                                   : it->second;
+      });
+  std::vector<Component> components;
+  std::unordered_map<const DexMethod*, size_t> component_of;
+  std::function<void(const sparta::WtoComponent<const DexMethod*>&)>
+      collect_members;
+  collect_members =
+      [&](const sparta::WtoComponent<const DexMethod*>& component) {
+        component_of.emplace(component.head_node(), components.size() - 1);
+        components.back().push_back(component.head_node());
+        if (component.is_scc()) {
+          for (const auto& inner : component) {
+            collect_members(inner);
+          }
+        }
+      };
+  for (const auto& component : wto) {
+    if (component.head_node() != nullptr) {
+      components.emplace_back();
+      collect_members(component);
+    }
+  }
+
+  std::vector<std::vector<Component>> levels;
+  std::vector<size_t> level_of(components.size());
+  for (size_t i = 0; i < components.size(); i++) {
+    size_t level = 0;
+    for (auto method : components[i]) {
+      auto it = callees.find(method);
+      if (it == callees.end()) {
+        continue;
+      }
+      for (auto callee : it->second) {
+        auto j = component_of.at(callee);
+        if (j != i) {
+          always_assert(j < i);
+          level = std::max(level, level_of[j] + 1);
+        }
+      }
+    }
+    level_of[i] = level;
+    if (level >= levels.size()) {
+      levels.resize(level + 1);
+    }
+    levels[level].push_back(std::move(components[i]));
+  }
+  return levels;
+}
+
 } // namespace call_graph
@@ -7,13 +7,22 @@
 
 #pragma once
 
+#include <cstdint>
+#include <memory>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
+#include "CompressedSparseRow.h"
 #include "DexClass.h"
 #include "IRCode.h"
 #include "MonotonicFixpointIterator.h"
 #include "Resolver.h"
 
+namespace method_override_graph {
+class CompactGraph;
+} // namespace method_override_graph
+
 /*
  * Call graph representation that implements the standard graph interface
  * API for use with fixpoint iteration algorithms.
@@ -63,6 +72,43 @@ class BuildStrategy {
   virtual CallSites get_callsites(const DexMethod*) const = 0;
 };
 
+/*
+ * The strategies behind single_callee_graph() and complete_call_graph(). They
+ * are exposed so that graphs built from them can be updated with
+ * Graph::rebuild_callsites().
+ */
+class SingleCalleeStrategy final : public BuildStrategy {
+ public:
+  explicit SingleCalleeStrategy(const Scope& scope);
+
+  CallSites get_callsites(const DexMethod* method) const override;
+
+  std::vector<const DexMethod*> get_roots() const override;
+
+ private:
+  bool is_definitely_virtual(DexMethod* method) const;
+
+  const Scope& m_scope;
+  std::unordered_set<DexMethod*> m_non_virtual;
+  mutable MethodRefCache m_resolved_refs;
+};
+
+class CompleteCallGraphStrategy final : public BuildStrategy {
+ public:
+  explicit CompleteCallGraphStrategy(const Scope& scope);
+  ~CompleteCallGraphStrategy() override;
+
+  CallSites get_callsites(const DexMethod* method) const override;
+
+  std::vector<const DexMethod*> get_roots() const override;
+
+ private:
+  const Scope& m_scope;
+  mutable MethodRefCache m_resolved_refs;
+  std::unique_ptr<const method_override_graph::CompactGraph>
+      m_method_override_graph;
+};
+
 class Edge;
 using EdgeId = std::shared_ptr<Edge>;
 using Edges = std::vector<std::shared_ptr<Edge>>;
@@ -117,6 +163,45 @@ class Graph final {
   NodeId entry() const { return m_entry; }
   NodeId exit() const { return m_exit; }
 
+  /*
+   * Incremental updates, so that a graph can be kept up to date as passes
+   * change the code instead of being rebuilt from scratch.
+   *
+   * Edges refer to invoke instructions, so every method whose invokes were
+   * changed, moved or deleted must be updated before the graph is traversed
+   * again. Methods that end up without callees get an edge to the ghost exit
+   * node, as in a freshly built graph.
+   */
+
+  // Add an edge for the invoke at :invoke_it in :caller to :callee. A callee
+  // that was not in the graph yet is added without any callees of its own;
+  // use rebuild_callsites() to explore them.
+  void add_callsite(const DexMethod* caller,
+                    const DexMethod* callee,
+                    const IRList::iterator& invoke_it);
+
+  // Remove all the edges for the invoke at :invoke_it in :caller, e.g. after
+  // the invoke got inlined or deleted.
+  void remove_callsite(const DexMethod* caller,
+                       const IRList::iterator& invoke_it);
+
+  // Let the invoke at :invoke_it in :caller call :callee only, e.g. after it
+  // got devirtualized.
+  void retarget_callsite(const DexMethod* caller,
+                         const IRList::iterator& invoke_it,
+                         const DexMethod* callee);
+
+  // Remove :method along with all its incoming and outgoing edges, e.g. after
+  // it was found to be unreachable and deleted.
+  void remove_method(const DexMethod* method);
+
+  // Recompute the outgoing edges of the :dirty methods from :strat. Callees
+  // that were not in the graph yet are explored recursively, as when building
+  // the graph; the callees of all other methods are left untouched. Returns
+  // the number of methods that were added to the graph.
+  size_t rebuild_callsites(const BuildStrategy& strat,
+                           const std::vector<const DexMethod*>& dirty);
+
   bool has_node(const DexMethod* m) const {
     return m_nodes.count(const_cast<DexMethod*>(m)) != 0;
   }
@@ -135,9 +220,91 @@ class Graph final {
                 const NodeId& callee,
                 const IRList::iterator& invoke_it);
 
+  // Like add_edge, but replaces the edge to the ghost exit node, if any.
+  void add_callsite_edge(const NodeId& caller,
+                         const NodeId& callee,
+                         const IRList::iterator& invoke_it);
+
+  // Remove the edges out of :caller that satisfy :pred, adding an edge to the
+  // ghost exit node if no edges remain.
+  template <typename Predicate>
+  void remove_callee_edges(const NodeId& caller, const Predicate& pred);
+
+  void remove_caller_edges(const NodeId& callee);
+
+  // Remove :edge from the predecessors of its callee.
+  static void detach_from_callee(const EdgeId& edge);
+
   std::shared_ptr<Node> m_entry;
   std::shared_ptr<Node> m_exit;
   std::unordered_map<const DexMethod*, NodeId> m_nodes;
+
+  friend class CompactGraph;
+};
+
+/*
+ * A frozen copy of a Graph for traversal-heavy analyses. Nodes are numbered
+ * densely in breadth-first order from the ghost entry node, and the edges are
+ * kept in compressed-sparse-row form, so that a node's outgoing edges have
+ * consecutive ids. This takes a small fraction of the memory of a Graph, whose
+ * nodes and edges are all separately allocated and reference counted, and is
+ * much friendlier to the cache.
+ */
+class CompactGraph final {
+ public:
+  using NodeId = uint32_t;
+  using EdgeId = uint32_t;
+
+  explicit CompactGraph(const Graph& graph);
+
+  NodeId entry() const { return 0; }
+  NodeId exit() const { return 1; }
+
+  size_t num_nodes() const { return m_methods.size(); }
+  size_t num_edges() const { return m_edge_callers.size(); }
+
+  // The method of :node, or nullptr for the ghost nodes.
+  const DexMethod* method(NodeId node) const { return m_methods[node]; }
+
+  bool has_node(const DexMethod* m) const { return m_nodes.count(m) != 0; }
+
+  NodeId node(const DexMethod* m) const {
+    if (m == nullptr) {
+      return entry();
+    }
+    return m_nodes.at(m);
+  }
+
+  // The ids of the edges out of :node are first_callee_edge(node) up to
+  // first_callee_edge(node + 1).
+  EdgeId first_callee_edge(NodeId node) const {
+    return m_callees.first_edge(node);
+  }
+
+  // The ids of the edges into :node.
+  CompressedSparseRow<>::Range caller_edges(NodeId node) const {
+    return m_caller_edges.neighbors(node);
+  }
+
+  NodeId caller(EdgeId edge) const { return m_edge_callers[edge]; }
+  NodeId callee(EdgeId edge) const {
+    return m_callees.neighbor_at(edge);
+  }
+  IRList::iterator invoke_iterator(EdgeId edge) const {
+    return m_invokes[edge];
+  }
+
+  size_t memory_footprint() const;
+
+ private:
+  std::vector<const DexMethod*> m_methods;
+  std::unordered_map<const DexMethod*, NodeId> m_nodes;
+  // The callee node of each edge, grouped by caller.
+  CompressedSparseRow<> m_callees;
+  // The ids of the edges into each node.
+  CompressedSparseRow<> m_caller_edges;
+  std::vector<NodeId> m_edge_callers;
+  std::vector<IRList::iterator> m_invokes;
 };
 
 // A static-method-only API for use with the monotonic fixpoint iterator.
@@ -163,4 +330,46 @@ class GraphInterface {
   }
 };
 
+// The same API for CompactGraphs. The edge lists are returned as vectors for
+// compatibility with sparta::BackwardsFixpointIterationAdaptor.
+class CompactGraphInterface {
+ public:
+  using Graph = call_graph::CompactGraph;
+  using NodeId = CompactGraph::NodeId;
+  using EdgeId = CompactGraph::EdgeId;
+
+  static NodeId entry(const Graph& graph) { return graph.entry(); }
+  static NodeId exit(const Graph& graph) { return graph.exit(); }
+  static std::vector<EdgeId> predecessors(const Graph& graph,
+                                          const NodeId& m) {
+    auto edges = graph.caller_edges(m);
+    return std::vector<EdgeId>(edges.begin(), edges.end());
+  }
+  static std::vector<EdgeId> successors(const Graph& graph, const NodeId& m) {
+    std::vector<EdgeId> edges;
+    auto end = graph.first_callee_edge(m + 1);
+    for (auto e = graph.first_callee_edge(m); e < end; ++e) {
+      edges.push_back(e);
+    }
+    return edges;
+  }
+  static NodeId source(const Graph& graph, const EdgeId& e) {
+    return graph.caller(e);
+  }
+  static NodeId target(const Graph& graph, const EdgeId& e) {
+    return graph.callee(e);
+  }
+};
+
+/*
+ * The strongly connected components of the call graph restricted to the
+ * methods with code in :scope, grouped into levels such that the callees of a
+ * component are in the same component or in lower levels. The components of a
+ * level can thus be analyzed in parallel once the lower levels are done, as
+ * bottom-up analyses do. The order is deterministic.
+ */
+using Component = std::vector<const DexMethod*>;
+std::vector<std::vector<Component>> components_by_level(const Scope& scope,
+                                                        const Graph& graph);
+
 } // namespace call_graph
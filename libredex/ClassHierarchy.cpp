@@ -7,7 +7,13 @@
 
 #include "ClassHierarchy.h"
 
+#include <algorithm>
+#include <unordered_set>
+
+#include <boost/functional/hash.hpp>
+
 #include "DexUtil.h"
+#include "RedexContext.h"
 #include "Resolver.h"
 #include "Timer.h"
 
@@ -104,8 +110,101 @@ void build_interface_map(InterfaceMap& interfaces,
   }
 }
 
+// The same as build_interface_map(hierarchy), using the index to enumerate
+// the children of each class.
+InterfaceMap build_interface_map(const ClassHierarchy& hierarchy,
+                                 const ClassHierarchyIndex& index) {
+  InterfaceMap interfaces;
+  for (const auto& cls_it : hierarchy) {
+    const auto cls = type_class(cls_it.first);
+    if (cls == nullptr) continue;
+    if (is_interface(cls)) continue;
+    auto children = index.get_all_children(cls->get_type());
+    TypeSet implementors(children.begin(), children.end());
+    implementors.insert(cls->get_type());
+    build_interface_map(interfaces, hierarchy, cls, implementors);
+  }
+  return interfaces;
+}
+
 } // namespace
 
+size_t class_structure_hash(const Scope& scope) {
+  size_t seed = scope.size();
+  boost::hash_combine(seed, g_redex->external_classes().size());
+  for (const auto* cls : scope) {
+    boost::hash_combine(seed, cls);
+    boost::hash_combine(seed, cls->get_super_class());
+    boost::hash_combine(seed, cls->get_interfaces());
+    boost::hash_combine(seed, is_interface(cls));
+  }
+  return seed;
+}
+
+ClassHierarchyIndex::ClassHierarchyIndex(const ClassHierarchy& hierarchy) {
+  std::unordered_set<const DexType*> children;
+  for (const auto& p : hierarchy) {
+    children.insert(p.second.begin(), p.second.end());
+  }
+  std::vector<const DexType*> roots;
+  for (const auto& p : hierarchy) {
+    if (!children.count(p.first)) {
+      roots.push_back(p.first);
+    }
+  }
+  std::sort(roots.begin(), roots.end(), compare_dextypes);
+
+  m_preorder.reserve(hierarchy.size());
+  m_intervals.reserve(hierarchy.size());
+  // Each type has a single super class, so this visits every type once. An
+  // entry (type, false) marks the start and (type, true) the end of the
+  // type's interval.
+  std::vector<std::pair<const DexType*, bool>> stack;
+  for (auto it = roots.rbegin(); it != roots.rend(); ++it) {
+    stack.emplace_back(*it, false);
+  }
+  while (!stack.empty()) {
+    auto entry = stack.back();
+    stack.pop_back();
+    if (entry.second) {
+      m_intervals.at(entry.first).end = m_preorder.size();
+      continue;
+    }
+    m_intervals.emplace(entry.first,
+                        Interval{static_cast<uint32_t>(m_preorder.size()), 0});
+    m_preorder.push_back(entry.first);
+    stack.emplace_back(entry.first, true);
+    const auto& direct = ::get_children(hierarchy, entry.first);
+    for (auto it = direct.rbegin(); it != direct.rend(); ++it) {
+      stack.emplace_back(*it, false);
+    }
+  }
+}
+
+ClassHierarchyIndex::Range ClassHierarchyIndex::get_all_children(
+    const DexType* type) const {
+  auto it = m_intervals.find(type);
+  if (it == m_intervals.end()) {
+    return Range(m_preorder.end(), m_preorder.end());
+  }
+  return Range(m_preorder.begin() + it->second.begin + 1,
+               m_preorder.begin() + it->second.end);
+}
+
+CachedClassHierarchy::CachedClassHierarchy(const Scope& scope)
+    : hierarchy(build_type_hierarchy(scope)),
+      index(hierarchy),
+      interfaces(build_interface_map(hierarchy, index)) {}
+
+std::shared_ptr<const CachedClassHierarchy> get_cached_class_hierarchy(
+    const Scope& scope) {
+  static RedexContextCache<const CachedClassHierarchy> cache;
+  return cache.get(class_structure_hash(scope), [&] {
+    Timer t("Building cached class hierarchy");
+    return std::make_shared<const CachedClassHierarchy>(scope);
+  });
+}
+
 ClassHierarchy build_type_hierarchy(const Scope& scope) {
   ClassHierarchy hierarchy;
   // build the type hierarchy
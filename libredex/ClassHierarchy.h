@@ -8,8 +8,11 @@
 #pragma once
 
 #include "DexClass.h"
+#include <boost/range/iterator_range.hpp>
+#include <memory>
 #include <set>
 #include <unordered_map>
+#include <vector>
 
 using TypeSet = std::set<const DexType*, dextypes_comparator>;
 
@@ -42,6 +45,53 @@ void get_all_children(const ClassHierarchy& hierarchy,
 
 TypeSet get_all_children(const ClassHierarchy& hierarchy, const DexType* type);
 
+/**
+ * An immutable index over a ClassHierarchy that numbers its types in
+ * depth-first preorder, so that the types below each type form a contiguous
+ * interval (interval labeling). Subclass tests take constant time, and all
+ * children of a type are a slice of a vector rather than the result of a walk.
+ */
+class ClassHierarchyIndex {
+ public:
+  using Range =
+      boost::iterator_range<std::vector<const DexType*>::const_iterator>;
+
+  explicit ClassHierarchyIndex(const ClassHierarchy& hierarchy);
+
+  bool contains(const DexType* type) const {
+    return m_intervals.count(type) != 0;
+  }
+
+  /**
+   * Whether :child is :parent or one of its children down the hierarchy.
+   */
+  bool is_subclass(const DexType* parent, const DexType* child) const {
+    auto p = m_intervals.find(parent);
+    auto c = m_intervals.find(child);
+    if (p == m_intervals.end() || c == m_intervals.end()) {
+      return false;
+    }
+    return p->second.begin <= c->second.begin &&
+           c->second.begin < p->second.end;
+  }
+
+  /**
+   * All children down the hierarchy of :type, in preorder.
+   */
+  Range get_all_children(const DexType* type) const;
+
+ private:
+  struct Interval {
+    // The preorder position of the type, and of the first type after it that
+    // is not one of its children.
+    uint32_t begin;
+    uint32_t end;
+  };
+
+  std::vector<const DexType*> m_preorder;
+  std::unordered_map<const DexType*, Interval> m_intervals;
+};
+
 /**
  * Map from each interface to the classes implementing that interface.
  * Interfaces are "flattened" so that a super interface maps to every
@@ -58,6 +108,33 @@ using InterfaceMap = std::unordered_map<const DexType*, TypeSet>;
  */
 InterfaceMap build_interface_map(const ClassHierarchy& hierarchy);
 
+/**
+ * The class hierarchy of a scope together with its index and interface map.
+ */
+struct CachedClassHierarchy {
+  explicit CachedClassHierarchy(const Scope& scope);
+
+  const ClassHierarchy hierarchy;
+  const ClassHierarchyIndex index;
+  const InterfaceMap interfaces;
+};
+
+/**
+ * A hash of the class structure of :scope: its classes and their super
+ * classes, interfaces and interface flags.
+ */
+size_t class_structure_hash(const Scope& scope);
+
+/**
+ * Return the hierarchy of :scope, shared across all callers (typically the
+ * passes of a pipeline) for as long as the class structure of the scope, i.e.
+ * its classes and their super classes, interfaces and interface flags, stays
+ * the same. Checking this takes a single walk over the scope, which is much
+ * cheaper than rebuilding the hierarchy.
+ */
+std::shared_ptr<const CachedClassHierarchy> get_cached_class_hierarchy(
+    const Scope& scope);
+
 /**
  * Return whether a given class implements a given interface.
  */
@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "CodeFingerprint.h"
+
+#include <boost/functional/hash.hpp>
+
+#include "IRCode.h"
+#include "IRInstruction.h"
+#include "Walkers.h"
+
+namespace code_fingerprint {
+
+namespace {
+
+class Hasher {
+ public:
+  explicit Hasher(bool canonicalize_registers)
+      : m_canonicalize_registers(canonicalize_registers) {}
+
+  void hash_instruction(const IRInstruction* insn) {
+    combine(insn->opcode());
+    for (auto src : insn->srcs()) {
+      combine(canonical_reg(src));
+    }
+    if (insn->has_dest()) {
+      combine(canonical_reg(insn->dest()));
+    }
+    if (insn->has_literal()) {
+      combine(insn->get_literal());
+    } else if (insn->has_type()) {
+      combine(insn->get_type());
+    } else if (insn->has_field()) {
+      combine(insn->get_field());
+    } else if (insn->has_method()) {
+      combine(insn->get_method());
+    } else if (insn->has_string()) {
+      combine(insn->get_string());
+    } else if (insn->has_callsite()) {
+      combine(insn->get_callsite());
+    } else if (insn->has_methodhandle()) {
+      combine(insn->get_methodhandle());
+    } else if (insn->has_data()) {
+      auto data = insn->get_data();
+      combine(boost::hash_range(data->data(),
+                                data->data() + data->data_size()));
+    }
+  }
+
+  template <typename T>
+  void combine(const T& value) {
+    boost::hash_combine(m_hash, value);
+  }
+
+  Fingerprint get() const { return m_hash; }
+
+ private:
+  // Registers are numbered by their first occurrence.
+  reg_t canonical_reg(reg_t reg) {
+    if (!m_canonicalize_registers) {
+      return reg;
+    }
+    return m_regs.emplace(reg, m_regs.size()).first->second;
+  }
+
+  bool m_canonicalize_registers;
+  size_t m_hash{0};
+  std::unordered_map<reg_t, reg_t> m_regs;
+};
+
+Fingerprint hash_code(const IRCode& code, Hasher* hasher_ptr) {
+  auto& hasher = *hasher_ptr;
+  for (const auto& mie : code) {
+    switch (mie.type) {
+    case MFLOW_DEBUG:
+    case MFLOW_POSITION:
+      continue;
+    case MFLOW_OPCODE:
+      hasher.hash_instruction(mie.insn);
+      break;
+    case MFLOW_TARGET:
+      hasher.combine(mie.target->type);
+      if (mie.target->type == BRANCH_MULTI) {
+        hasher.combine(mie.target->case_key);
+      }
+      break;
+    case MFLOW_TRY:
+      hasher.combine(mie.tentry->type);
+      break;
+    case MFLOW_CATCH:
+      hasher.combine(mie.centry->catch_type);
+      break;
+    default:
+      break;
+    }
+    hasher.combine(mie.type);
+  }
+  return hasher.get();
+}
+
+} // namespace
+
+Fingerprint compute(const IRCode& code) {
+  Hasher hasher(/* canonicalize_registers */ true);
+  return hash_code(code, &hasher);
+}
+
+Fingerprint compute_exact(const IRCode& code) {
+  Hasher hasher(/* canonicalize_registers */ false);
+  hasher.combine(code.get_registers_size());
+  // Also tell apart which branch each target belongs to.
+  std::unordered_map<const MethodItemEntry*, size_t> positions;
+  for (const auto& mie : code) {
+    if (mie.type == MFLOW_OPCODE) {
+      positions.emplace(&mie, positions.size());
+    }
+  }
+  for (const auto& mie : code) {
+    if (mie.type == MFLOW_TARGET) {
+      auto it = positions.find(mie.target->src);
+      hasher.combine(it == positions.end() ? positions.size() : it->second);
+    }
+  }
+  return hash_code(code, &hasher);
+}
+
+Fingerprint FingerprintCache::get(const DexMethod* method) {
+  auto code = method->get_code();
+  always_assert(code != nullptr);
+  auto it = m_entries.find(method);
+  if (it != m_entries.end() && it->second.code == code &&
+      it->second.epoch == code->get_mutation_epoch() &&
+      it->second.size == code->size()) {
+    m_hits++;
+    return it->second.fingerprint;
+  }
+  m_misses++;
+  Entry entry{code, code->get_mutation_epoch(), code->size(),
+              compute(*code)};
+  m_entries.update(method, [&](const DexMethod*, Entry& e, bool) {
+    e = entry;
+  });
+  return entry.fingerprint;
+}
+
+void FingerprintCache::compute_all(const Scope& scope) {
+  walk::parallel::code(scope, [&](DexMethod* method, IRCode&) { get(method); });
+}
+
+void FingerprintCache::invalidate(const DexMethod* method) {
+  m_entries.erase(method);
+}
+
+} // namespace code_fingerprint
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include "ConcurrentContainers.h"
+#include "DexClass.h"
+
+class IRCode;
+
+namespace code_fingerprint {
+
+using Fingerprint = uint64_t;
+
+/*
+ * A canonical hash of the linear IR of :code. Registers are numbered in the
+ * order in which they first occur, so the fingerprint doesn't change when
+ * registers are renamed, and debug and position entries are ignored.
+ * Structurally equal code, see IRCode::structural_equals, always has equal
+ * fingerprints.
+ */
+Fingerprint compute(const IRCode& code);
+
+/*
+ * Like compute(), but registers are hashed as they are, along with the number
+ * of registers of :code, so that renaming registers changes the fingerprint.
+ */
+Fingerprint compute_exact(const IRCode& code);
+
+/*
+ * Caches fingerprints of method bodies, so that one round of duplicate
+ * detection only needs to hash each method once, and to compare methods
+ * structurally only if their fingerprints agree.
+ *
+ * An entry is recomputed when the method's code object, its mutation epoch
+ * or the length of its IR changes. In-place rewrites of instructions, e.g.
+ * set_type() or set_method(), change none of these, so a cache must not
+ * outlive the grouping it was made for.
+ *
+ * All operations are thread-safe.
+ */
+class FingerprintCache {
+ public:
+  // The fingerprint of the code of :method, which must have code.
+  Fingerprint get(const DexMethod* method);
+
+  // Compute the fingerprints of all methods with code in :scope in parallel.
+  void compute_all(const Scope& scope);
+
+  void invalidate(const DexMethod* method);
+
+  size_t hits() const { return m_hits; }
+  size_t misses() const { return m_misses; }
+
+ private:
+  struct Entry {
+    const IRCode* code;
+    uint64_t epoch;
+    size_t size;
+    Fingerprint fingerprint;
+  };
+
+  ConcurrentMap<const DexMethod*, Entry> m_entries;
+  std::atomic<size_t> m_hits{0};
+  std::atomic<size_t> m_misses{0};
+};
+
+} // namespace code_fingerprint
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "Debug.h"
+
+/*
+ * A frozen adjacency structure in compressed-sparse-row form: the neighbors of
+ * all nodes 0..n-1 are stored back to back in a single array, and node i's
+ * neighbors are the ones between offsets i and i+1. This takes two integers
+ * per edge and one per node, and a traversal touches contiguous memory.
+ *
+ * Nodes and neighbors are dense indices assigned by the owner of the
+ * structure, typically the position of a method in a vector of methods.
+ */
+template <typename Index = uint32_t>
+class CompressedSparseRow {
+ public:
+  class Range {
+   public:
+    Range(const Index* begin, const Index* end) : m_begin(begin), m_end(end) {}
+    const Index* begin() const { return m_begin; }
+    const Index* end() const { return m_end; }
+    size_t size() const { return m_end - m_begin; }
+    bool empty() const { return m_begin == m_end; }
+
+   private:
+    const Index* m_begin;
+    const Index* m_end;
+  };
+
+  CompressedSparseRow() : m_offsets{0} {}
+
+  /*
+   * Build the structure for :num_nodes nodes from a list of (node, neighbor)
+   * pairs. Each node's neighbors keep the order in which they appear in
+   * :pairs. This is a counting sort, so it is linear in the number of nodes
+   * and pairs.
+   */
+  CompressedSparseRow(size_t num_nodes,
+                      const std::vector<std::pair<Index, Index>>& pairs)
+      : m_offsets(num_nodes + 1, 0) {
+    for (const auto& p : pairs) {
+      always_assert(p.first < num_nodes);
+      ++m_offsets[p.first + 1];
+    }
+    for (size_t i = 0; i < num_nodes; ++i) {
+      m_offsets[i + 1] += m_offsets[i];
+    }
+    m_neighbors.resize(pairs.size());
+    std::vector<Index> next(m_offsets.begin(), m_offsets.end() - 1);
+    for (const auto& p : pairs) {
+      m_neighbors[next[p.first]++] = p.second;
+    }
+  }
+
+  size_t num_nodes() const { return m_offsets.size() - 1; }
+
+  size_t num_edges() const { return m_neighbors.size(); }
+
+  Range neighbors(Index node) const {
+    const Index* data = m_neighbors.data();
+    return Range(data + m_offsets[node], data + m_offsets[node + 1]);
+  }
+
+  // The neighbor at :position in the neighbor array, see first_edge().
+  Index neighbor_at(Index position) const { return m_neighbors[position]; }
+
+  // The position of the first neighbor of :node in the neighbor array, which
+  // can serve as a dense edge index.
+  Index first_edge(Index node) const { return m_offsets[node]; }
+
+  size_t memory_footprint() const {
+    return (m_offsets.capacity() + m_neighbors.capacity()) * sizeof(Index);
+  }
+
+ private:
+  std::vector<Index> m_offsets;
+  std::vector<Index> m_neighbors;
+};
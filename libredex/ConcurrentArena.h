@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+/*
+ * A bump-pointer arena for objects of a single type T that are created
+ * concurrently and then live until the arena is released, such as the
+ * entities interned by RedexContext.
+ *
+ * Each thread carves objects out of its own chunk without any locking; the
+ * arena mutex is only taken to hand out a fresh chunk. Objects are never freed
+ * individually. `release()`, also called by the destructor, runs the destroy
+ * function on every object still alive and frees all chunks at once.
+ *
+ * The destroy function is supplied by the owner, so that types with private
+ * destructors can befriend just the owner.
+ */
+template <typename T>
+class ConcurrentArena final {
+ public:
+  using DestroyFn = void (*)(T*);
+
+  explicit ConcurrentArena(DestroyFn destroy)
+      : m_destroy(destroy), m_id(next_id()) {}
+
+  ConcurrentArena(const ConcurrentArena&) = delete;
+  ConcurrentArena& operator=(const ConcurrentArena&) = delete;
+
+  ~ConcurrentArena() { release(); }
+
+  /*
+   * Return uninitialized storage for one T. The caller must construct an
+   * object in it (with placement new) before the arena is released, or give it
+   * back via `destroy`. This operation is thread-safe.
+   */
+  void* allocate() {
+    auto& cache = thread_cache();
+    if (cache.arena_id != m_id || cache.chunk->used == cache.chunk->capacity) {
+      cache.arena_id = m_id;
+      cache.chunk = new_chunk();
+    }
+    auto* chunk = cache.chunk;
+    auto& slot = chunk->slots[chunk->used++];
+    slot.live = true;
+    return &slot.storage;
+  }
+
+  /*
+   * Run the destroy function on an object of this arena right away. Its
+   * storage is reclaimed when the arena is released. This operation is
+   * thread-safe, as long as each object is destroyed at most once.
+   */
+  void destroy(T* object) {
+    auto* slot = reinterpret_cast<Slot*>(object);
+    slot->live = false;
+    m_destroy(object);
+  }
+
+  /*
+   * Destroy all live objects and free all memory. This is not thread-safe, and
+   * nothing allocated from this arena may be used afterwards.
+   */
+  void release() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& chunk : m_chunks) {
+      for (size_t i = 0; i < chunk->used; ++i) {
+        auto& slot = chunk->slots[i];
+        if (slot.live) {
+          slot.live = false;
+          m_destroy(reinterpret_cast<T*>(&slot.storage));
+        }
+      }
+    }
+    m_chunks.clear();
+    // Chunks cached by other threads become stale; a new id makes them fetch
+    // fresh chunks should this arena be used again.
+    m_id = next_id();
+  }
+
+ private:
+  struct Slot {
+    // Must come first, so that a T* is also a Slot*.
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+    bool live;
+  };
+
+  struct Chunk {
+    explicit Chunk(size_t cap) : capacity(cap), slots(new Slot[cap]) {}
+    const size_t capacity;
+    // Only modified by the thread that owns this chunk.
+    size_t used{0};
+    std::unique_ptr<Slot[]> slots;
+  };
+
+  struct ThreadCache {
+    uint64_t arena_id{0};
+    Chunk* chunk{nullptr};
+  };
+
+  // Roughly 64KB per chunk.
+  static size_t chunk_capacity() {
+    return std::max<size_t>(1, (64 * 1024) / sizeof(Slot));
+  }
+
+  // One cache per thread and element type; it is only valid for the arena
+  // whose id it records. Ids are never reused, so a cache can never refer to
+  // an arena that has been destroyed or released in the meantime.
+  static ThreadCache& thread_cache() {
+    static thread_local ThreadCache cache;
+    return cache;
+  }
+
+  static uint64_t next_id() {
+    static std::atomic<uint64_t> id{1};
+    return id++;
+  }
+
+  Chunk* new_chunk() {
+    auto chunk = std::make_unique<Chunk>(chunk_capacity());
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_chunks.push_back(std::move(chunk));
+    return m_chunks.back().get();
+  }
+
+  const DestroyFn m_destroy;
+  std::mutex m_mutex;
+  std::vector<std::unique_ptr<Chunk>> m_chunks;
+  uint64_t m_id;
+};
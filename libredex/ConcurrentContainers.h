@@ -7,12 +7,17 @@
 
 #pragma once
 
+#include <atomic>
+#include <deque>
 #include <functional>
 #include <initializer_list>
 #include <iterator>
+#include <memory>
+#include <stdexcept>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
+#include <vector>
 
 #include <boost/thread.hpp>
 
@@ -24,6 +29,15 @@ namespace cc_impl {
 template <typename Container, size_t n_slots>
 class ConcurrentContainerIterator;
 
+template <typename Entry, typename Slot, typename Table, size_t n_slots>
+class ReadOptimizedIterator;
+
+// Marks erased entries of a ReadOptimizedConcurrentMap.
+inline void* read_optimized_tombstone() {
+  static char sentinel;
+  return &sentinel;
+}
+
 } // namespace cc_impl
 
 /*
@@ -296,6 +310,32 @@ class ConcurrentMapContainer
     return map.emplace(std::move(entry)).second;
   }
 
+  /*
+   * Like emplacing each of the :entries in turn, but takes the lock of each
+   * slot only once. Returns, for each entry, the value that the map holds for
+   * its key afterwards, i.e. either the entry's own value or the one that was
+   * already there. This operation is always thread-safe.
+   */
+  std::vector<Value> get_or_emplace_all(
+      const std::vector<std::pair<Key, Value>>& entries) {
+    std::vector<std::vector<size_t>> by_slot(n_slots);
+    for (size_t i = 0; i < entries.size(); ++i) {
+      by_slot[Hash()(entries[i].first) % n_slots].push_back(i);
+    }
+    std::vector<Value> values(entries.size());
+    for (size_t slot = 0; slot < n_slots; ++slot) {
+      if (by_slot[slot].empty()) {
+        continue;
+      }
+      boost::lock_guard<boost::mutex> lock(this->get_lock(slot));
+      auto& map = this->get_container(slot);
+      for (auto i : by_slot[slot]) {
+        values[i] = map.emplace(entries[i]).first->second;
+      }
+    }
+    return values;
+  }
+
   /*
    * This operation atomically modifies an entry in the map. If the entry
    * doesn't exist, it is created. The third argument of the updater function is
@@ -461,6 +501,395 @@ class InsertOnlyConcurrentSet final
   size_t erase(const Key& key) = delete;
 };
 
+/*
+ * A concurrent map tuned for workloads where lookups vastly outnumber updates,
+ * such as the interning tables of RedexContext once loading has finished.
+ *
+ * Like ConcurrentMap, the map is split into slots by hash code. Unlike
+ * ConcurrentMap, lookups never take a lock: each slot is an open-addressing
+ * hash table of atomic pointers to immutable entries, and readers just follow
+ * the probe sequence. Writers (insertions and erasures) still lock the slot.
+ * A slot's table grows by rehashing into a fresh table; retired tables and
+ * erased entries are kept alive until the map is destroyed or cleared, so a
+ * concurrent reader never touches freed memory.
+ *
+ * Values are fixed once inserted; there is no `update` or `insert_or_assign`.
+ */
+template <typename Key,
+          typename Value,
+          typename Hash = std::hash<Key>,
+          typename Equal = std::equal_to<Key>,
+          size_t n_slots = 31>
+class ReadOptimizedConcurrentMap final {
+ public:
+  static_assert(n_slots > 0, "The concurrent container has no slots");
+
+  using value_type = std::pair<const Key, Value>;
+
+ private:
+  struct Table {
+    explicit Table(size_t capacity)
+        : mask(capacity - 1), entries(new std::atomic<value_type*>[capacity]) {
+      for (size_t i = 0; i < capacity; ++i) {
+        entries[i].store(nullptr, std::memory_order_relaxed);
+      }
+    }
+    size_t capacity() const { return mask + 1; }
+    const size_t mask;
+    std::unique_ptr<std::atomic<value_type*>[]> entries;
+  };
+
+  struct alignas(64) Slot {
+    Slot() : table(nullptr) {}
+    std::atomic<Table*> table;
+    // The following fields are guarded by this mutex.
+    boost::mutex mutex;
+    // Entries are never moved, so pointers to them stay valid.
+    std::deque<value_type> entries;
+    std::vector<std::unique_ptr<Table>> tables;
+    size_t size{0};
+    // Non-null entries of the current table, including tombstones.
+    size_t used{0};
+  };
+
+ public:
+  using const_iterator = cc_impl::ReadOptimizedIterator<value_type,
+                                                        Slot,
+                                                        Table,
+                                                        n_slots>;
+  using iterator = const_iterator;
+
+  ReadOptimizedConcurrentMap() = default;
+  ReadOptimizedConcurrentMap(const ReadOptimizedConcurrentMap&) = delete;
+  ReadOptimizedConcurrentMap& operator=(const ReadOptimizedConcurrentMap&) =
+      delete;
+
+  /*
+   * Using iterators while the map is concurrently modified will result in
+   * undefined behavior.
+   */
+  const_iterator begin() const { return const_iterator(m_slots, 0, 0); }
+
+  const_iterator end() const { return const_iterator(m_slots); }
+
+  const_iterator find(const Key& key) const {
+    size_t hash = Hash()(key);
+    size_t slot = hash % n_slots;
+    Table* table = m_slots[slot].table.load(std::memory_order_acquire);
+    if (table == nullptr) {
+      return end();
+    }
+    for (size_t i = position(hash, *table);; i = (i + 1) & table->mask) {
+      value_type* entry = table->entries[i].load(std::memory_order_acquire);
+      if (entry == nullptr) {
+        return end();
+      }
+      if (entry != tombstone() && Equal()(entry->first, key)) {
+        // Hand out the probed entry itself: the slot may have grown or the
+        // key may have been erased since, so re-reading the table here could
+        // yield some other key's entry.
+        return const_iterator(m_slots, slot, table, i, entry);
+      }
+    }
+  }
+
+  /*
+   * This operation is always thread-safe.
+   */
+  Value get(const Key& key, Value default_value) const {
+    const value_type* entry = lookup(key);
+    return entry == nullptr ? default_value : entry->second;
+  }
+
+  /*
+   * This operation is always thread-safe. Throws std::out_of_range if the key
+   * is absent.
+   */
+  Value at(const Key& key) const {
+    const value_type* entry = lookup(key);
+    if (entry == nullptr) {
+      throw std::out_of_range("ReadOptimizedConcurrentMap::at");
+    }
+    return entry->second;
+  }
+
+  /*
+   * This operation is always thread-safe.
+   */
+  size_t count(const Key& key) const { return lookup(key) == nullptr ? 0 : 1; }
+
+  /*
+   * The Boolean return value denotes whether the insertion took place.
+   * This operation is always thread-safe.
+   */
+  template <typename... Args>
+  bool emplace(Args&&... args) {
+    std::pair<Key, Value> entry(std::forward<Args>(args)...);
+    return insert(entry);
+  }
+
+  /*
+   * The Boolean return value denotes whether the insertion took place.
+   * This operation is always thread-safe.
+   */
+  bool insert(const std::pair<Key, Value>& entry) {
+    size_t hash = Hash()(entry.first);
+    Slot& slot = m_slots[hash % n_slots];
+    boost::lock_guard<boost::mutex> lock(slot.mutex);
+    Table* table = slot.table.load(std::memory_order_relaxed);
+    if (table == nullptr || (slot.used + 1) * 2 > table->capacity()) {
+      table = grow(&slot);
+    }
+    size_t insert_at = table->capacity();
+    for (size_t i = position(hash, *table);; i = (i + 1) & table->mask) {
+      value_type* existing = table->entries[i].load(std::memory_order_relaxed);
+      if (existing == nullptr) {
+        if (insert_at == table->capacity()) {
+          insert_at = i;
+          ++slot.used;
+        }
+        break;
+      }
+      if (existing == tombstone()) {
+        if (insert_at == table->capacity()) {
+          insert_at = i;
+        }
+      } else if (Equal()(existing->first, entry.first)) {
+        return false;
+      }
+    }
+    slot.entries.emplace_back(entry.first, entry.second);
+    ++slot.size;
+    // Publish the fully constructed entry.
+    table->entries[insert_at].store(&slot.entries.back(),
+                                    std::memory_order_release);
+    return true;
+  }
+
+  /*
+   * This operation is always thread-safe.
+   */
+  size_t erase(const Key& key) {
+    size_t hash = Hash()(key);
+    Slot& slot = m_slots[hash % n_slots];
+    boost::lock_guard<boost::mutex> lock(slot.mutex);
+    Table* table = slot.table.load(std::memory_order_relaxed);
+    if (table == nullptr) {
+      return 0;
+    }
+    for (size_t i = position(hash, *table);; i = (i + 1) & table->mask) {
+      value_type* existing = table->entries[i].load(std::memory_order_relaxed);
+      if (existing == nullptr) {
+        return 0;
+      }
+      if (existing != tombstone() && Equal()(existing->first, key)) {
+        // The entry itself stays alive for concurrent readers.
+        table->entries[i].store(tombstone(), std::memory_order_release);
+        --slot.size;
+        return 1;
+      }
+    }
+  }
+
+  size_t size() const {
+    size_t s = 0;
+    for (size_t i = 0; i < n_slots; ++i) {
+      boost::lock_guard<boost::mutex> lock(m_slots[i].mutex);
+      s += m_slots[i].size;
+    }
+    return s;
+  }
+
+  bool empty() const { return size() == 0; }
+
+  /*
+   * This operation is not thread-safe.
+   */
+  void clear() {
+    for (size_t i = 0; i < n_slots; ++i) {
+      Slot& slot = m_slots[i];
+      slot.table.store(nullptr, std::memory_order_relaxed);
+      slot.tables.clear();
+      slot.entries.clear();
+      slot.size = 0;
+      slot.used = 0;
+    }
+  }
+
+ private:
+  static value_type* tombstone() {
+    return static_cast<value_type*>(cc_impl::read_optimized_tombstone());
+  }
+
+  // Fibonacci hashing, so that the position within a slot's table does not
+  // correlate with the choice of slot.
+  static size_t position(size_t hash, const Table& table) {
+    return (hash * static_cast<size_t>(0x9E3779B97F4A7C15ULL) >> 16) &
+           table.mask;
+  }
+
+  const value_type* lookup(const Key& key) const {
+    size_t hash = Hash()(key);
+    Table* table = m_slots[hash % n_slots].table.load(std::memory_order_acquire);
+    if (table == nullptr) {
+      return nullptr;
+    }
+    for (size_t i = position(hash, *table);; i = (i + 1) & table->mask) {
+      value_type* entry = table->entries[i].load(std::memory_order_acquire);
+      if (entry == nullptr) {
+        return nullptr;
+      }
+      if (entry != tombstone() && Equal()(entry->first, key)) {
+        return entry;
+      }
+    }
+  }
+
+  // Rehash the live entries of `slot` into a table with room to spare. The
+  // slot's mutex must be held.
+  Table* grow(Slot* slot) {
+    size_t capacity = 16;
+    while (capacity < (slot->size + 1) * 4) {
+      capacity <<= 1;
+    }
+    auto fresh = std::make_unique<Table>(capacity);
+    Table* old = slot->table.load(std::memory_order_relaxed);
+    if (old != nullptr) {
+      for (size_t i = 0; i < old->capacity(); ++i) {
+        value_type* entry = old->entries[i].load(std::memory_order_relaxed);
+        if (entry == nullptr || entry == tombstone()) {
+          continue;
+        }
+        size_t j = position(Hash()(entry->first), *fresh);
+        while (fresh->entries[j].load(std::memory_order_relaxed) != nullptr) {
+          j = (j + 1) & fresh->mask;
+        }
+        fresh->entries[j].store(entry, std::memory_order_relaxed);
+      }
+    }
+    slot->used = slot->size;
+    Table* result = fresh.get();
+    slot->tables.push_back(std::move(fresh));
+    slot->table.store(result, std::memory_order_release);
+    return result;
+  }
+
+  mutable Slot m_slots[n_slots];
+};
+
+namespace cc_impl {
+
+/*
+ * Each slot's table is loaded once and the current entry pointer is cached, so
+ * a concurrent grow or erase never makes a dereference observe a different
+ * entry than the one the iterator stopped at. Retired tables stay alive for
+ * the lifetime of the map, which keeps the cached pointers valid.
+ */
+template <typename Entry, typename Slot, typename Table, size_t n_slots>
+class ReadOptimizedIterator final {
+ public:
+  using difference_type = std::ptrdiff_t;
+  using value_type = Entry;
+  using pointer = const Entry*;
+  using reference = const Entry&;
+  using iterator_category = std::forward_iterator_tag;
+
+  // The end iterator.
+  explicit ReadOptimizedIterator(const Slot* slots)
+      : m_slots(slots),
+        m_slot(n_slots),
+        m_table(nullptr),
+        m_index(0),
+        m_entry(nullptr) {}
+
+  // The first live entry at or after `index` in `slot`.
+  ReadOptimizedIterator(const Slot* slots, size_t slot, size_t index)
+      : m_slots(slots),
+        m_slot(slot),
+        m_table(slot < n_slots
+                    ? slots[slot].table.load(std::memory_order_acquire)
+                    : nullptr),
+        m_index(index),
+        m_entry(nullptr) {
+    skip_to_valid();
+  }
+
+  // An entry that was found by probing `table`.
+  ReadOptimizedIterator(const Slot* slots,
+                        size_t slot,
+                        const Table* table,
+                        size_t index,
+                        const Entry* entry)
+      : m_slots(slots),
+        m_slot(slot),
+        m_table(table),
+        m_index(index),
+        m_entry(entry) {}
+
+  ReadOptimizedIterator& operator++() {
+    always_assert(m_slot < n_slots);
+    ++m_index;
+    skip_to_valid();
+    return *this;
+  }
+
+  ReadOptimizedIterator operator++(int) {
+    ReadOptimizedIterator retval = *this;
+    ++(*this);
+    return retval;
+  }
+
+  bool operator==(const ReadOptimizedIterator& other) const {
+    return m_slots == other.m_slots && m_slot == other.m_slot &&
+           m_entry == other.m_entry;
+  }
+
+  bool operator!=(const ReadOptimizedIterator& other) const {
+    return !(*this == other);
+  }
+
+  reference operator*() const {
+    always_assert(m_slot < n_slots);
+    return *m_entry;
+  }
+
+  pointer operator->() const {
+    always_assert(m_slot < n_slots);
+    return m_entry;
+  }
+
+ private:
+  // Advance to the next live entry, or to the end.
+  void skip_to_valid() {
+    while (m_slot < n_slots) {
+      if (m_table != nullptr) {
+        for (; m_index < m_table->capacity(); ++m_index) {
+          auto* entry =
+              m_table->entries[m_index].load(std::memory_order_acquire);
+          if (entry != nullptr && entry != read_optimized_tombstone()) {
+            m_entry = entry;
+            return;
+          }
+        }
+      }
+      ++m_slot;
+      m_index = 0;
+      m_table = m_slot < n_slots
+                    ? m_slots[m_slot].table.load(std::memory_order_acquire)
+                    : nullptr;
+    }
+    m_entry = nullptr;
+  }
+
+  const Slot* m_slots;
+  size_t m_slot;
+  const Table* m_table;
+  size_t m_index;
+  const Entry* m_entry;
+};
+
+} // namespace cc_impl
+
 namespace cc_impl {
 
 template <typename Container, size_t n_slots>
@@ -7,6 +7,9 @@
 
 #include "ConfigFiles.h"
 
+#include <boost/filesystem.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <cctype>
 #include <fstream>
 #include <iostream>
 #include <string>
@@ -15,6 +18,49 @@
 #include "Debug.h"
 #include "DexClass.h"
 
+namespace {
+
+/*
+ * Calls `fn(token, size)` on each whitespace-separated token of the file,
+ * like reading it with `>>`, but over a mapping of the whole file rather than
+ * copying it through a stream. `fn` returns false to stop early. Returns
+ * false if the file can't be opened.
+ */
+template <typename Fn>
+bool for_each_token(const std::string& filename, const Fn& fn) {
+  boost::system::error_code ec;
+  auto file_size = boost::filesystem::file_size(filename, ec);
+  if (ec) {
+    return false;
+  }
+  if (file_size == 0) {
+    return true;
+  }
+  boost::iostreams::mapped_file_source file;
+  try {
+    file.open(filename);
+  } catch (const std::exception&) {
+    return false;
+  }
+  const char* p = file.data();
+  const char* end = p + file.size();
+  while (p < end) {
+    while (p < end && isspace((unsigned char)*p)) {
+      ++p;
+    }
+    const char* token = p;
+    while (p < end && !isspace((unsigned char)*p)) {
+      ++p;
+    }
+    if (p > token && !fn(token, size_t(p - token))) {
+      break;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
 ConfigFiles::ConfigFiles(const Json::Value& config, const std::string& outdir)
     : m_json(config),
       outdir(outdir),
@@ -29,8 +75,17 @@ ConfigFiles::ConfigFiles(const Json::Value& config, const std::string& outdir)
         config.get("default_coldstart_classes", "").asString();
   }
 
+  if (!m_coldstart_class_filename.empty()) {
+    m_coldstart_classes_loaded =
+        std::async(std::launch::async, [this] {
+          return load_coldstart_classes();
+        }).share();
+  }
   if (!m_profiled_methods_filename.empty()) {
-    load_method_to_weight();
+    m_method_to_weight_loaded =
+        std::async(std::launch::async, [this] {
+          load_method_to_weight();
+        }).share();
   }
   load_method_sorting_whitelisted_substrings();
   uint32_t instruction_size_bitwidth_limit =
@@ -81,38 +136,38 @@ const std::unordered_set<DexMethodRef*>& ConfigFiles::get_pure_methods() {
   return m_pure_methods;
 }
 
+const std::vector<std::string>& ConfigFiles::get_coldstart_classes() const {
+  if (m_coldstart_classes_loaded.valid() && !m_coldstart_classes_loaded.get()) {
+    fprintf(stderr,
+            "[error] Can not open <coldstart_classes> file, path is %s\n",
+            m_coldstart_class_filename.c_str());
+    exit(EXIT_FAILURE);
+  }
+  return m_coldstart_classes;
+}
+
 /**
- * Read an interdex list file and return as a vector of appropriately-formatted
- * classname strings.
+ * Read an interdex list file into a vector of appropriately-formatted
+ * classname strings. Returns false if the file can't be opened.
  */
-std::vector<std::string> ConfigFiles::load_coldstart_classes() {
-  if (m_coldstart_class_filename.empty()) {
-    return {};
-  }
+bool ConfigFiles::load_coldstart_classes() {
   const char* kClassTail = ".class";
   const size_t lentail = strlen(kClassTail);
   auto file = m_coldstart_class_filename.c_str();
 
-  std::vector<std::string> coldstart_classes;
-
-  std::ifstream input(file);
-  if (!input) {
-    fprintf(stderr,
-            "[error] Can not open <coldstart_classes> file, path is %s\n",
-            file);
-    exit(EXIT_FAILURE);
-  }
   std::string clzname;
-  while (input >> clzname) {
-    long position = clzname.length() - lentail;
-    always_assert_log(position >= 0,
-                      "Bailing, invalid class spec '%s' in interdex file %s\n",
-                      clzname.c_str(), file);
-    clzname.replace(position, lentail, ";");
-    coldstart_classes.emplace_back(
-        m_proguard_map.translate_class("L" + clzname));
-  }
-  return coldstart_classes;
+  auto add_class = [&](const char* token, size_t size) {
+    always_assert_log(
+        size >= lentail,
+        "Bailing, invalid class spec '%.*s' in interdex file %s\n",
+        (int)size, token, file);
+    clzname.assign("L");
+    clzname.append(token, size - lentail);
+    clzname.push_back(';');
+    m_coldstart_classes.emplace_back(m_proguard_map.translate_class(clzname));
+    return true;
+  };
+  return for_each_token(m_coldstart_class_filename, add_class);
 }
 
 /**
@@ -152,20 +207,35 @@ ConfigFiles::load_class_lists() {
 }
 
 void ConfigFiles::load_method_to_weight() {
-  std::ifstream infile(m_profiled_methods_filename.c_str());
-  assert_log(infile, "Can't open method profile file: %s\n",
-             m_profiled_methods_filename.c_str());
-
-  std::string deobfuscated_name;
-  unsigned int weight;
   TRACE(CUSTOMSORT, 2, "Setting sort start file %s",
         m_profiled_methods_filename.c_str());
 
+  // The file alternates names and weights; like reading it with `>>`, stop at
+  // the first weight that isn't a number.
+  std::string deobfuscated_name;
+  bool expect_name = true;
   unsigned int count = 0;
-  while (infile >> deobfuscated_name >> weight) {
-    m_method_to_weight[deobfuscated_name] = weight;
-    count++;
-  }
+  bool opened = for_each_token(
+      m_profiled_methods_filename, [&](const char* token, size_t size) {
+        if (expect_name) {
+          deobfuscated_name.assign(token, size);
+          expect_name = false;
+          return true;
+        }
+        std::string weight_str(token, size);
+        char* weight_end;
+        auto weight = strtoul(weight_str.c_str(), &weight_end, 10);
+        if (weight_str.empty() || !isdigit((unsigned char)weight_str[0]) ||
+            *weight_end != '\0') {
+          return false;
+        }
+        m_method_to_weight[deobfuscated_name] = (unsigned int)weight;
+        count++;
+        expect_name = true;
+        return true;
+      });
+  assert_log(opened, "Can't open method profile file: %s\n",
+             m_profiled_methods_filename.c_str());
 
   assert_log(count > 0, "Method profile file %s didn't contain valid entries\n",
              m_profiled_methods_filename.c_str());
@@ -184,7 +254,7 @@ void ConfigFiles::load_method_sorting_whitelisted_substrings() {
   }
 }
 
-void ConfigFiles::ensure_agg_method_stats_loaded() {
+void ConfigFiles::ensure_agg_method_stats_loaded() const {
   const std::string& empty_str = "";
   const std::string& csv_filename =
       get_json_config().get("agg_method_stats_file", empty_str);
@@ -226,6 +296,11 @@ void ConfigFiles::load_inliner_config(inliner::InlinerConfig* inliner_config) {
   jw.get("run_copy_prop", false, inliner_config->run_copy_prop);
   jw.get("run_local_dce", false, inliner_config->run_local_dce);
   jw.get("run_dedup_blocks", false, inliner_config->run_dedup_blocks);
+  jw.get("wave_scheduling", false, inliner_config->wave_scheduling);
+  jw.get("profile_guided_size_budget", (size_t)0,
+         inliner_config->profile_guided_size_budget);
+  jw.get("max_inline_call_depth", (size_t)0,
+         inliner_config->max_inline_call_depth);
   jw.get("debug", false, inliner_config->debug);
   jw.get("black_list", {}, inliner_config->m_black_list);
   jw.get("caller_black_list", {}, inliner_config->m_caller_black_list);
@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <future>
 #include <map>
 #include <string>
 #include <unordered_set>
@@ -27,17 +28,19 @@ using MethodMap = std::map<MethodTuple, DexClass*>;
 
 /**
  * ConfigFiles should be a readonly structure
+ *
+ * The coldstart classes and the method weights are read on background threads
+ * from construction on, and waited for on first use. The getters return views
+ * of the loaded lists; there is one copy of each per ConfigFiles.
  */
 struct ConfigFiles {
   explicit ConfigFiles(const Json::Value& config);
   ConfigFiles(const Json::Value& config, const std::string& outdir);
+  // The background loads write into this object.
+  ConfigFiles(const ConfigFiles&) = delete;
+  ConfigFiles& operator=(const ConfigFiles&) = delete;
 
-  const std::vector<std::string>& get_coldstart_classes() {
-    if (m_coldstart_classes.empty()) {
-      m_coldstart_classes = load_coldstart_classes();
-    }
-    return m_coldstart_classes;
-  }
+  const std::vector<std::string>& get_coldstart_classes() const;
 
   void ensure_class_lists_loaded() {
     if (!m_load_class_lists_attempted) {
@@ -62,7 +65,7 @@ struct ConfigFiles {
     return m_class_lists.at(name);
   }
 
-  const method_profiles::MethodProfiles& get_method_profiles() {
+  const method_profiles::MethodProfiles& get_method_profiles() const {
     ensure_agg_method_stats_loaded();
     return m_method_profiles;
   }
@@ -72,6 +75,9 @@ struct ConfigFiles {
 
   const std::unordered_map<std::string, unsigned int>& get_method_to_weight()
       const {
+    if (m_method_to_weight_loaded.valid()) {
+      m_method_to_weight_loaded.get();
+    }
     return m_method_to_weight;
   }
 
@@ -161,23 +167,29 @@ struct ConfigFiles {
   JsonWrapper m_json;
   std::string outdir;
 
-  std::vector<std::string> load_coldstart_classes();
+  bool load_coldstart_classes();
   std::unordered_map<std::string, std::vector<std::string>> load_class_lists();
   void load_method_to_weight();
   void load_method_sorting_whitelisted_substrings();
-  void ensure_agg_method_stats_loaded();
+  void ensure_agg_method_stats_loaded() const;
   void load_inliner_config(inliner::InlinerConfig*);
 
   bool m_load_class_lists_attempted{false};
   ProguardMap m_proguard_map;
   std::string m_coldstart_class_filename;
   std::string m_profiled_methods_filename;
+  // The method profiles are loaded lazily, also by const users such as
+  // DexOutput.
   std::vector<std::string> m_coldstart_classes;
+  // Whether the background load of the coldstart classes could open the file;
+  // the failure is reported on first use.
+  std::shared_future<bool> m_coldstart_classes_loaded;
   std::unordered_map<std::string, std::vector<std::string>> m_class_lists;
   std::unordered_map<std::string, unsigned int> m_method_to_weight;
+  std::shared_future<void> m_method_to_weight_loaded;
   std::unordered_set<std::string> m_method_sorting_whitelisted_substrings;
   std::string m_printseeds; // Filename to dump computed seeds.
-  method_profiles::MethodProfiles m_method_profiles;
+  mutable method_profiles::MethodProfiles m_method_profiles;
 
   // limits the output instruction size of any DexMethod to 2^n
   // 0 when limit is not present
@@ -9,13 +9,17 @@
 
 #include <boost/dynamic_bitset.hpp>
 #include <boost/numeric/conversion/cast.hpp>
+#include <algorithm>
 #include <iterator>
 #include <stack>
 #include <utility>
 
+#include "AllocTracking.h"
 #include "CppUtil.h"
 #include "DexUtil.h"
+#include "Dominators.h"
 #include "GraphUtil.h"
+#include "MonotonicFixpointIterator.h"
 #include "Transform.h"
 #include "WeakTopologicalOrdering.h"
 
@@ -108,7 +112,9 @@ IRList::iterator insn_before_position(cfg::Block* b) {
 
 /*
  * Given an output ordering, Find adjacent positions that are exact duplicates
- * and delete the extras. Make sure not to delete any positions that are
+ * and delete the extras. Also delete positions that are superseded by another
+ * position before any instruction, as they don't apply to anything; inlining
+ * leaves many of those behind. Make sure not to delete any positions that are
  * referenced by a parent pointer.
  */
 void remove_duplicate_positions(IRList* ir) {
@@ -119,6 +125,8 @@ void remove_duplicate_positions(IRList* ir) {
     }
   }
   DexPosition* prev = nullptr;
+  // The last position that no instruction follows yet.
+  auto unused = ir->end();
   for (auto it = ir->begin(); it != ir->end();) {
     if (it->type == MFLOW_POSITION) {
       DexPosition* curr = it->pos.get();
@@ -126,8 +134,14 @@ void remove_duplicate_positions(IRList* ir) {
         it = ir->erase_and_dispose(it);
         continue;
       } else {
+        if (unused != ir->end() && keep.count(unused->pos.get()) == 0) {
+          ir->erase_and_dispose(unused);
+        }
+        unused = it;
         prev = curr;
       }
+    } else if (it->type == MFLOW_OPCODE) {
+      unused = ir->end();
     }
     ++it;
   }
@@ -579,6 +593,7 @@ ControlFlowGraph::ControlFlowGraph(IRList* ir,
                                    bool editable)
     : m_registers_size(registers_size), m_editable(editable) {
   always_assert_log(!ir->empty(), "IRList contains no instructions");
+  alloc_tracking::ScopedCategory scope(alloc_tracking::Category::CFG);
 
   BranchToTargets branch_to_targets;
   TryEnds try_ends;
@@ -885,6 +900,7 @@ uint32_t ControlFlowGraph::remove_unreachable_blocks() {
       b->free();
       delete b;
       it = m_blocks.erase(it);
+      ++m_version;
     } else {
       ++it;
     }
@@ -957,16 +973,12 @@ void ControlFlowGraph::remove_empty_blocks() {
         set_edge_source(ghost, succ);
       }
 
-      // Redirect from b's predecessors to b's successor (skipping b). We
-      // can't move edges around while we iterate through the edge list
-      // though.
-      std::vector<Edge*> need_redirect(b->m_preds.begin(), b->m_preds.end());
-      for (Edge* pred_edge : need_redirect) {
-        set_edge_target(pred_edge, succ);
-      }
+      // Redirect from b's predecessors to b's successor (skipping b).
+      redirect_pred_edges(b, succ);
 
       if (b == entry_block()) {
         m_entry_block = succ;
+        ++m_version;
       }
     }
     if (b == m_entry_block) {
@@ -984,6 +996,7 @@ void ControlFlowGraph::remove_empty_blocks() {
     b->free();
     delete b;
     it = m_blocks.erase(it);
+    ++m_version;
   }
   remove_dangling_parents(deleted_positions);
 }
@@ -1377,6 +1390,151 @@ void ControlFlowGraph::deep_copy(ControlFlowGraph* new_cfg) const {
   }
 }
 
+ControlFlowGraph::Snapshot::~Snapshot() {
+  for (auto& insn : m_insns) {
+    if (insn.has_data()) {
+      delete insn.get_data();
+    }
+  }
+  for (auto mie : m_other_entries) {
+    delete mie;
+  }
+}
+
+std::unique_ptr<ControlFlowGraph::Snapshot> ControlFlowGraph::snapshot()
+    const {
+  always_assert(editable());
+  auto snapshot = std::make_unique<Snapshot>();
+  snapshot->m_registers_size = get_registers_size();
+  snapshot->m_entry_block = m_entry_block->id();
+  if (m_exit_block != nullptr) {
+    snapshot->m_exit_block = m_exit_block->id();
+  }
+
+  std::unordered_map<const Edge*, uint32_t> edge_ids;
+  edge_ids.reserve(m_edges.size());
+  snapshot->m_edges.reserve(m_edges.size());
+  for (const Edge* e : m_edges) {
+    edge_ids.emplace(e, snapshot->m_edges.size());
+    Snapshot::EdgeRecord record{e->src()->id(), e->target()->id(), e->type(),
+                                nullptr, 0, boost::none};
+    if (e->type() == EDGE_THROW) {
+      record.catch_type = e->throw_info()->catch_type;
+      record.index = e->throw_info()->index;
+    } else {
+      record.case_key = e->case_key();
+    }
+    snapshot->m_edges.push_back(record);
+  }
+
+  size_t num_entries = 0;
+  size_t num_insns = 0;
+  for (const auto& entry : m_blocks) {
+    for (const auto& mie : *entry.second) {
+      num_entries++;
+      num_insns += mie.type == MFLOW_OPCODE;
+    }
+  }
+  snapshot->m_blocks.reserve(m_blocks.size());
+  snapshot->m_entries.reserve(num_entries);
+  // IRInstruction isn't movable, so all the copies must fit without growing.
+  snapshot->m_insns.reserve(num_insns);
+  snapshot->m_edge_ids.reserve(2 * m_edges.size());
+  MethodItemEntryCloner cloner;
+  for (const auto& entry : m_blocks) {
+    const Block* block = entry.second;
+    for (const auto& mie : *block) {
+      if (mie.type == MFLOW_OPCODE) {
+        snapshot->m_entries.push_back(snapshot->m_insns.size());
+        snapshot->m_insns.emplace_back(*mie.insn);
+        auto& insn = snapshot->m_insns.back();
+        if (insn.has_data()) {
+          insn.set_data(insn.get_data()->clone());
+        }
+      } else {
+        snapshot->m_entries.push_back(Snapshot::kOtherEntry |
+                                      snapshot->m_other_entries.size());
+        snapshot->m_other_entries.push_back(cloner.clone(&mie));
+      }
+    }
+    for (const Edge* e : block->preds()) {
+      snapshot->m_edge_ids.push_back(edge_ids.at(e));
+    }
+    uint32_t preds_end = snapshot->m_edge_ids.size();
+    for (const Edge* e : block->succs()) {
+      snapshot->m_edge_ids.push_back(edge_ids.at(e));
+    }
+    snapshot->m_blocks.push_back(Snapshot::BlockRecord{
+        block->id(), (uint32_t)snapshot->m_entries.size(), preds_end,
+        (uint32_t)snapshot->m_edge_ids.size()});
+  }
+  // As in deep_copy, the parent of a position may be in a later block.
+  cloner.fix_parent_positions();
+  return snapshot;
+}
+
+void ControlFlowGraph::restore(std::unique_ptr<Snapshot> snapshot) {
+  clear();
+  set_registers_size(snapshot->m_registers_size);
+
+  for (const auto& record : snapshot->m_blocks) {
+    m_blocks.emplace(record.id, new Block(this, record.id));
+  }
+
+  std::vector<Edge*> edges;
+  edges.reserve(snapshot->m_edges.size());
+  for (const auto& record : snapshot->m_edges) {
+    auto src = m_blocks.at(record.src);
+    auto target = m_blocks.at(record.target);
+    Edge* e;
+    if (record.type == EDGE_THROW) {
+      e = new Edge(src, target, record.catch_type, record.index);
+    } else if (record.case_key) {
+      e = new Edge(src, target, *record.case_key);
+    } else {
+      e = new Edge(src, target, record.type);
+    }
+    m_edges.insert(e);
+    edges.push_back(e);
+  }
+
+  uint32_t entries_begin = 0;
+  uint32_t edges_begin = 0;
+  for (const auto& record : snapshot->m_blocks) {
+    Block* block = m_blocks.at(record.id);
+    for (auto i = entries_begin; i < record.entries_end; i++) {
+      auto index = snapshot->m_entries[i];
+      MethodItemEntry* mie;
+      if (index & Snapshot::kOtherEntry) {
+        auto& other = snapshot->m_other_entries[index & ~Snapshot::kOtherEntry];
+        mie = other;
+        other = nullptr;
+      } else {
+        // Takes over the DexOpcodeData of the snapshot's copy.
+        mie = new MethodItemEntry(new IRInstruction(snapshot->m_insns[index]));
+      }
+      block->m_entries.push_back(*mie);
+    }
+    for (auto i = edges_begin; i < record.preds_end; i++) {
+      block->m_preds.push_back(edges[snapshot->m_edge_ids[i]]);
+    }
+    for (auto i = record.preds_end; i < record.succs_end; i++) {
+      block->m_succs.push_back(edges[snapshot->m_edge_ids[i]]);
+    }
+    entries_begin = record.entries_end;
+    edges_begin = record.succs_end;
+  }
+  // Everything was handed over to the graph.
+  snapshot->m_insns.clear();
+  snapshot->m_other_entries.clear();
+
+  m_entry_block = m_blocks.at(snapshot->m_entry_block);
+  if (snapshot->m_exit_block) {
+    m_exit_block = m_blocks.at(*snapshot->m_exit_block);
+  }
+  ++m_code_version;
+}
+
 InstructionIterator ControlFlowGraph::find_insn(IRInstruction* needle,
                                                 Block* hint) {
   if (hint != nullptr) {
@@ -1397,29 +1555,37 @@ InstructionIterator ControlFlowGraph::find_insn(IRInstruction* needle,
   return iterable.end();
 }
 
-std::vector<Block*> ControlFlowGraph::order() {
-  // We must simplify first to remove any unreachable blocks
-  simplify();
+// The chains depend on which blocks start with a move-result, so the order is
+// a code analysis rather than just one of the blocks and edges.
+struct ControlFlowGraph::BlockOrder {
+  explicit BlockOrder(ControlFlowGraph& cfg) {
+    // This is a modified Weak Topological Ordering (WTO). We create "chains"
+    // of blocks that will be kept together, then feed these chains to WTO for
+    // it to choose the ordering of the chains. Then, we deconstruct the chains
+    // to get an ordering of the blocks.
+
+    // hold the chains of blocks here, though they mostly will be accessed via
+    // the map
+    std::vector<std::unique_ptr<Chain>> chains;
+    // keep track of which blocks are in each chain, for quick lookup.
+    std::unordered_map<Block*, Chain*> block_to_chain;
+    block_to_chain.reserve(cfg.m_blocks.size());
 
-  // This is a modified Weak Topological Ordering (WTO). We create "chains" of
-  // blocks that will be kept together, then feed these chains to WTO for it to
-  // choose the ordering of the chains. Then, we deconstruct the chains to get
-  // an ordering of the blocks.
+    cfg.build_chains(&chains, &block_to_chain);
+    blocks = cfg.wto_chains(block_to_chain);
 
-  // hold the chains of blocks here, though they mostly will be accessed via the
-  // map
-  std::vector<std::unique_ptr<Chain>> chains;
-  // keep track of which blocks are in each chain, for quick lookup.
-  std::unordered_map<Block*, Chain*> block_to_chain;
-  block_to_chain.reserve(m_blocks.size());
+    always_assert_log(blocks.size() == cfg.m_blocks.size(),
+                      "result has %lu blocks, m_blocks has %lu", blocks.size(),
+                      cfg.m_blocks.size());
+  }
 
-  build_chains(&chains, &block_to_chain);
-  const auto& result = wto_chains(block_to_chain);
+  std::vector<Block*> blocks;
+};
 
-  always_assert_log(result.size() == m_blocks.size(),
-                    "result has %lu blocks, m_blocks has %lu", result.size(),
-                    m_blocks.size());
-  return result;
+std::vector<Block*> ControlFlowGraph::order() {
+  // We must simplify first to remove any unreachable blocks
+  simplify();
+  return get_code_analysis<BlockOrder>().blocks;
 }
 
 void ControlFlowGraph::build_chains(
@@ -1774,6 +1940,7 @@ Block* ControlFlowGraph::create_block() {
   size_t id = next_block_id();
   Block* b = new Block(this, id);
   m_blocks.emplace(id, b);
+  ++m_version;
   return b;
 }
 
@@ -1813,6 +1980,10 @@ class ExitBlocks {
     // outside itself
     bool has_exit{false};
     for (auto& succ : b->succs()) {
+      if (succ->type() == EDGE_GHOST) {
+        // Only the edges into a previously computed exit block are ghosts.
+        continue;
+      }
       uint32_t succ_dfn = dfns[succ->target()];
       uint32_t min;
       if (succ_dfn == 0) {
@@ -1890,30 +2061,71 @@ std::vector<Block*> ControlFlowGraph::return_blocks() const {
  * (SCCs) and vertices that lack successors. For SCCs that lack successors, any
  * one of its vertices can be treated as an exit block; this implementation
  * picks the head of the SCC.
+ *
+ * The blocks and edges, and thus the cached analyses, are left alone when the
+ * exit block is still the same.
  */
 void ControlFlowGraph::calculate_exit_block() {
-  if (m_exit_block != nullptr) {
-    if (!m_editable) {
-      return;
-    }
-    if (get_pred_edge_of_type(m_exit_block, EDGE_GHOST) != nullptr) {
-      // Need to clear old exit block before recomputing the exit of a CFG
-      // with multiple exit points
-      remove_block(m_exit_block);
-      m_exit_block = nullptr;
-    }
+  if (m_exit_block != nullptr && !m_editable) {
+    return;
   }
 
   ExitBlocks eb;
   eb.visit(entry_block());
+
+  Block* ghost_exit = nullptr;
+  if (m_exit_block != nullptr &&
+      get_pred_edge_of_type(m_exit_block, EDGE_GHOST) != nullptr) {
+    ghost_exit = m_exit_block;
+  }
   if (eb.exit_blocks.size() == 1) {
-    m_exit_block = eb.exit_blocks[0];
-  } else {
-    m_exit_block = create_block();
-    for (Block* b : eb.exit_blocks) {
-      add_edge(b, m_exit_block, EDGE_GHOST);
+    if (ghost_exit != nullptr) {
+      remove_block(ghost_exit);
+      m_exit_block = nullptr;
     }
+    if (m_exit_block != eb.exit_blocks[0]) {
+      set_exit_block(eb.exit_blocks[0]);
+    }
+    return;
+  }
+
+  if (ghost_exit != nullptr) {
+    std::unordered_set<const Block*> joined;
+    for (const Edge* e : ghost_exit->preds()) {
+      if (e->type() == EDGE_GHOST) {
+        joined.insert(e->src());
+      }
+    }
+    bool unchanged = ghost_exit->succs().empty() &&
+                     joined.size() == ghost_exit->preds().size() &&
+                     joined.size() == eb.exit_blocks.size() &&
+                     std::all_of(eb.exit_blocks.begin(), eb.exit_blocks.end(),
+                                 [&joined](const Block* b) {
+                                   return joined.count(b) != 0;
+                                 });
+    if (unchanged) {
+      return;
+    }
+    // Need to clear old exit block before recomputing the exit of a CFG
+    // with multiple exit points
+    remove_block(ghost_exit);
+    m_exit_block = nullptr;
+  }
+  m_exit_block = create_block();
+  for (Block* b : eb.exit_blocks) {
+    add_edge(b, m_exit_block, EDGE_GHOST);
+  }
+}
+
+const Dominators& ControlFlowGraph::get_dominators() {
+  return get_analysis<Dominators>();
+}
+
+const PostDominators& ControlFlowGraph::get_post_dominators() {
+  if (!has_analysis<PostDominators>()) {
+    calculate_exit_block();
   }
+  return get_analysis<PostDominators>();
 }
 
 // public API edge removal functions
@@ -1970,6 +2182,7 @@ void ControlFlowGraph::clear() {
   m_exit_block = nullptr;
 
   m_editable = true;
+  ++m_version;
 }
 
 // After `edges` have been removed from the graph,
@@ -2095,6 +2308,7 @@ void ControlFlowGraph::merge_blocks(Block* pred, Block* succ) {
   delete_pred_edges(succ);
   delete_succ_edges(succ);
   m_blocks.erase(succ->id());
+  ++m_version;
   delete succ;
 }
 
@@ -2124,6 +2338,30 @@ void ControlFlowGraph::move_edge(Edge* edge,
 
   edge->src()->m_succs.push_back(edge);
   edge->target()->m_preds.push_back(edge);
+  ++m_version;
+}
+
+void ControlFlowGraph::redirect_pred_edges(Block* from, Block* to) {
+  std::vector<Edge*> edges;
+  edges.swap(from->m_preds);
+  // move_edge would move each edge to the end of its source's successors.
+  // Take them all out of each source at once, then append them in order.
+  EdgeSet moved(edges.begin(), edges.end());
+  std::unordered_set<Block*> sources;
+  for (Edge* e : edges) {
+    if (sources.insert(e->src()).second) {
+      auto& succs = e->src()->m_succs;
+      succs.erase(std::remove_if(succs.begin(), succs.end(),
+                                 [&moved](Edge* s) { return moved.count(s); }),
+                  succs.end());
+    }
+  }
+  for (Edge* e : edges) {
+    e->set_target(to);
+    e->src()->m_succs.push_back(e);
+    to->m_preds.push_back(e);
+  }
+  ++m_version;
 }
 
 bool ControlFlowGraph::blocks_are_in_same_try(const Block* b1,
@@ -2157,6 +2395,7 @@ bool ControlFlowGraph::replace_insn(const InstructionIterator& it,
 
 void ControlFlowGraph::remove_insn(const InstructionIterator& it) {
   always_assert(m_editable);
+  ++m_code_version;
 
   MethodItemEntry& mie = *it;
   auto insn = mie.insn;
@@ -2263,6 +2502,7 @@ void ControlFlowGraph::create_branch(
                       "%s must have a false case", SHOW(insn));
   }
 
+  ++m_code_version;
   b->m_entries.push_back(*new MethodItemEntry(insn));
   if (is_switch(op)) {
     for (const auto& entry : case_to_block) {
@@ -2360,6 +2600,7 @@ void ControlFlowGraph::remove_block(Block* block) {
 
   auto id = block->id();
   auto num_removed = m_blocks.erase(id);
+  ++m_version;
   always_assert_log(num_removed == 1,
                     "Block %d wasn't in CFG. Attempted double delete?", id);
   block->m_entries.clear_and_dispose();
@@ -2368,10 +2609,7 @@ void ControlFlowGraph::remove_block(Block* block) {
 
 // delete old_block and reroute its predecessors to new_block
 void ControlFlowGraph::replace_block(Block* old_block, Block* new_block) {
-  std::vector<Edge*> to_redirect = old_block->preds();
-  for (auto e : to_redirect) {
-    set_edge_target(e, new_block);
-  }
+  redirect_pred_edges(old_block, new_block);
   remove_block(old_block);
 }
 
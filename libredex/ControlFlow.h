@@ -10,7 +10,10 @@
 #include <boost/dynamic_bitset.hpp>
 #include <boost/optional/optional.hpp>
 #include <boost/range/sub_range.hpp>
+#include <memory>
 #include <type_traits>
+#include <typeindex>
+#include <unordered_map>
 #include <unordered_set>
 #include <utility>
 #include <vector>
@@ -65,8 +68,25 @@ struct BlockAccessor;
 } // namespace impl
 } // namespace inliner
 
+namespace dominators {
+template <class GraphInterface>
+class SimpleFastDominators;
+} // namespace dominators
+
+namespace sparta {
+template <typename GraphInterface>
+class BackwardsFixpointIterationAdaptor;
+} // namespace sparta
+
 namespace cfg {
 
+class GraphInterface;
+
+// Defined in Dominators.h, which users of get_(post_)dominators() include.
+using Dominators = dominators::SimpleFastDominators<GraphInterface>;
+using PostDominators = dominators::SimpleFastDominators<
+    sparta::BackwardsFixpointIterationAdaptor<GraphInterface>>;
+
 enum EdgeType : uint8_t {
   // The false branch of an if statement, default of a switch, or unconditional
   // goto
@@ -295,6 +315,10 @@ class Block final {
   // returns true if there are no MethodItemEntries (not IRInstructions)
   bool empty() const { return m_entries.empty(); }
 
+  // returns the number of MethodItemEntries (not IRInstructions), in constant
+  // time
+  size_t num_entries() const { return m_entries.size(); }
+
   uint32_t num_opcodes() const;
 
   uint32_t sum_opcode_sizes() const;
@@ -458,8 +482,14 @@ class ControlFlowGraph {
 
   Block* entry_block() const { return m_entry_block; }
   Block* exit_block() const { return m_exit_block; }
-  void set_entry_block(Block* b) { m_entry_block = b; }
-  void set_exit_block(Block* b) { m_exit_block = b; }
+  void set_entry_block(Block* b) {
+    m_entry_block = b;
+    ++m_version;
+  }
+  void set_exit_block(Block* b) {
+    m_exit_block = b;
+    ++m_version;
+  }
 
   /*
    * If there is a single method exit point, this returns a vector holding the
@@ -483,6 +513,77 @@ class ControlFlowGraph {
    */
   void calculate_exit_block();
 
+  /*
+   * Return the result of `Analysis(*this)`, computing it only if there is no
+   * up-to-date result yet. Results are cached until the blocks or edges of
+   * this CFG change, e.g. the loop nest via `get_analysis<loop_impl::LoopInfo>()`
+   * is computed once for a run of passes that only edit instructions. An
+   * analysis may itself change the CFG while it is built, as LoopInfo does when
+   * it inserts preheaders; that only drops the results cached before it.
+   *
+   * The returned reference stays valid until the next call after a change.
+   */
+  template <class Analysis>
+  const Analysis& get_analysis() {
+    drop_stale_analyses();
+    std::type_index key(typeid(Analysis));
+    auto it = m_analyses.find(key);
+    if (it != m_analyses.end()) {
+      return *static_cast<const Analysis*>(it->second.get());
+    }
+    auto analysis = std::make_shared<Analysis>(*this);
+    drop_stale_analyses();
+    const Analysis& result = *analysis;
+    m_analyses.emplace(key, std::move(analysis));
+    return result;
+  }
+
+  template <class Analysis>
+  bool has_analysis() const {
+    return m_analyses_version == m_version &&
+           m_analyses.count(std::type_index(typeid(Analysis)));
+  }
+
+  /*
+   * Like get_analysis(), for analyses of the instructions rather than just of
+   * the blocks and edges, e.g. the def-use chains via
+   * `get_code_analysis<live_range::Chains>()`. Results are also dropped when
+   * instructions are inserted, replaced or removed through this CFG. Code that
+   * edits instructions any other way, e.g. with IRInstruction::set_src(), must
+   * call code_changed() afterwards.
+   */
+  template <class Analysis>
+  const Analysis& get_code_analysis() {
+    drop_stale_code_analyses();
+    std::type_index key(typeid(Analysis));
+    auto it = m_code_analyses.find(key);
+    if (it != m_code_analyses.end()) {
+      return *static_cast<const Analysis*>(it->second.get());
+    }
+    auto analysis = std::make_shared<Analysis>(*this);
+    drop_stale_code_analyses();
+    const Analysis& result = *analysis;
+    m_code_analyses.emplace(key, std::move(analysis));
+    return result;
+  }
+
+  template <class Analysis>
+  bool has_code_analysis() const {
+    return m_code_analyses_version == m_code_version &&
+           m_code_analyses_cfg_version == m_version &&
+           m_code_analyses.count(std::type_index(typeid(Analysis)));
+  }
+
+  // Drop the results of get_code_analysis().
+  void code_changed() { ++m_code_version; }
+
+  // Cached dominator tree, see get_analysis().
+  const Dominators& get_dominators();
+
+  // Cached post-dominator tree, see get_analysis(). This recomputes the exit
+  // block first if there is no up-to-date result.
+  const PostDominators& get_post_dominators();
+
   // args are arguments to an Edge constructor
   template <class... Args>
   void add_edge(Args&&... args) {
@@ -490,6 +591,7 @@ class ControlFlowGraph {
   }
 
   void add_edge(Edge* e) {
+    ++m_version;
     m_edges.insert(e);
     e->src()->m_succs.emplace_back(e);
     e->target()->m_preds.emplace_back(e);
@@ -797,11 +899,26 @@ class ControlFlowGraph {
    */
   void deep_copy(ControlFlowGraph* new_cfg) const;
 
+  /*
+   * A compact copy of `this`, to roll back to later with restore(). Unlike a
+   * deep_copy(), it stores the instructions by value in a single array and
+   * the blocks and edges as plain records, so it takes a fraction of the
+   * memory of the graph.
+   */
+  class Snapshot;
+  std::unique_ptr<Snapshot> snapshot() const;
+
+  /*
+   * clear and refill `this` from the snapshot, which it consumes.
+   */
+  void restore(std::unique_ptr<Snapshot> snapshot);
+
   // Search all the instructions in this CFG for the given one. Return an
   // iterator to it, or end, if it isn't in the graph.
   InstructionIterator find_insn(IRInstruction* insn, Block* hint = nullptr);
 
-  // choose an order of blocks for output
+  // choose an order of blocks for output. The order is cached like the
+  // results of get_code_analysis().
   std::vector<Block*> order();
 
   /*
@@ -847,6 +964,7 @@ class ControlFlowGraph {
   void remove_try_catch_markers();
 
   // helper functions
+  struct BlockOrder;
   using Chain = std::vector<Block*>;
   void build_chains(std::vector<std::unique_ptr<Chain>>* chains,
                     std::unordered_map<Block*, Chain*>* block_to_chain);
@@ -922,6 +1040,7 @@ class ControlFlowGraph {
                          Block* target,
                          EdgePredicate predicate,
                          bool cleanup = true) {
+    ++m_version;
     auto& forward_edges = source->m_succs;
     EdgeSet to_remove;
     forward_edges.erase(
@@ -954,6 +1073,7 @@ class ControlFlowGraph {
   EdgeSet remove_pred_edge_if(Block* block,
                               EdgePredicate predicate,
                               bool cleanup = true) {
+    ++m_version;
     auto& reverse_edges = block->m_preds;
 
     std::vector<Block*> source_blocks;
@@ -990,6 +1110,7 @@ class ControlFlowGraph {
   EdgeSet remove_succ_edge_if(Block* block,
                               EdgePredicate predicate,
                               bool cleanup = true) {
+    ++m_version;
     auto& forward_edges = block->m_succs;
 
     std::vector<Block*> target_blocks;
@@ -1044,6 +1165,10 @@ class ControlFlowGraph {
   // edge
   void move_edge(Edge* edge, Block* new_source, Block* new_target);
 
+  // Same as calling set_edge_target(e, to) on each predecessor edge of `from`
+  // in turn, but linear instead of quadratic in the number of those edges.
+  void redirect_pred_edges(Block* from, Block* to);
+
   reg_t compute_registers_size() const;
 
   // Return the next unused block identifier
@@ -1051,6 +1176,22 @@ class ControlFlowGraph {
 
   std::vector<Block*> blocks_post_helper(bool reverse) const;
 
+  void drop_stale_analyses() {
+    if (m_analyses_version != m_version) {
+      m_analyses.clear();
+      m_analyses_version = m_version;
+    }
+  }
+
+  void drop_stale_code_analyses() {
+    if (m_code_analyses_version != m_code_version ||
+        m_code_analyses_cfg_version != m_version) {
+      m_code_analyses.clear();
+      m_code_analyses_version = m_code_version;
+      m_code_analyses_cfg_version = m_version;
+    }
+  }
+
   // The memory of all blocks and edges in this graph are owned here
   Blocks m_blocks;
   EdgeSet m_edges;
@@ -1059,6 +1200,62 @@ class ControlFlowGraph {
   Block* m_exit_block{nullptr};
   reg_t m_registers_size{0};
   bool m_editable{true};
+
+  // Bumped by every change to the blocks or edges, see get_analysis().
+  uint64_t m_version{0};
+  uint64_t m_analyses_version{0};
+  std::unordered_map<std::type_index, std::shared_ptr<void>> m_analyses;
+  // Bumped by every change to the instructions, see get_code_analysis().
+  uint64_t m_code_version{0};
+  uint64_t m_code_analyses_version{0};
+  uint64_t m_code_analyses_cfg_version{0};
+  std::unordered_map<std::type_index, std::shared_ptr<void>> m_code_analyses;
+};
+
+class ControlFlowGraph::Snapshot final {
+ public:
+  Snapshot() = default;
+  Snapshot(const Snapshot&) = delete;
+  Snapshot& operator=(const Snapshot&) = delete;
+  ~Snapshot();
+
+ private:
+  friend class ControlFlowGraph;
+
+  struct BlockRecord {
+    BlockId id;
+    // The ends of the block's ranges in m_entries and m_edge_ids.
+    uint32_t entries_end;
+    uint32_t preds_end;
+    uint32_t succs_end;
+  };
+
+  struct EdgeRecord {
+    BlockId src;
+    BlockId target;
+    EdgeType type;
+    // Only for EDGE_THROW.
+    DexType* catch_type;
+    uint32_t index;
+    Edge::MaybeCaseKey case_key;
+  };
+
+  // Entries with this bit set index into m_other_entries, the rest into
+  // m_insns.
+  static constexpr uint32_t kOtherEntry = 1u << 31;
+
+  reg_t m_registers_size{0};
+  BlockId m_entry_block{0};
+  boost::optional<BlockId> m_exit_block;
+  std::vector<BlockRecord> m_blocks;
+  std::vector<uint32_t> m_entries;
+  // The instructions own their DexOpcodeData, if any.
+  std::vector<IRInstruction> m_insns;
+  // The positions and debug entries, which are comparatively rare.
+  std::vector<MethodItemEntry*> m_other_entries;
+  // The predecessors and then the successors of each block, in order.
+  std::vector<uint32_t> m_edge_ids;
+  std::vector<EdgeRecord> m_edges;
 };
 
 // A static-method-only API for use with the monotonic fixpoint iterator.
@@ -1304,6 +1501,7 @@ bool ControlFlowGraph::insert(const InstructionIterator& position,
   IRList::iterator pos =
       before ? position.unwrap() : std::next(position.unwrap());
 
+  ++m_code_version;
   bool invalidated_its = false;
   for (auto insns_it = begin_index; insns_it != end_index; insns_it++) {
     IRInstruction* insn = *insns_it;
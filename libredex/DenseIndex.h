@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Debug.h"
+
+/*
+ * Dense indices for interned entities.
+ *
+ * RedexContext numbers every DexType, DexFieldRef and DexMethodRef it creates
+ * consecutively from 0, see their index() methods, and can map indices back
+ * to entities. A whole-program analysis can thus keep per-entity state in flat
+ * arrays and bitsets instead of hash maps keyed by pointers, e.g. with the
+ * containers below.
+ *
+ * Indices are stable for the lifetime of the RedexContext. The few entities
+ * that are created concurrently but lose the race to be interned leave holes,
+ * so index tables may contain null entries.
+ */
+
+namespace dense_index {
+
+using Index = uint32_t;
+
+namespace detail {
+
+/*
+ * A lazily allocated two-level array of atomic elements that can grow while
+ * being accessed concurrently, without ever moving its elements.
+ */
+template <typename T, size_t ChunkBits = 16, size_t MaxChunks = 4096>
+class ChunkedAtomicArray final {
+ public:
+  static constexpr size_t kChunkSize = size_t(1) << ChunkBits;
+  static constexpr size_t kCapacity = kChunkSize * MaxChunks;
+
+  ChunkedAtomicArray() {
+    for (auto& chunk : m_chunks) {
+      chunk.store(nullptr, std::memory_order_relaxed);
+    }
+  }
+
+  ChunkedAtomicArray(const ChunkedAtomicArray&) = delete;
+  ChunkedAtomicArray& operator=(const ChunkedAtomicArray&) = delete;
+
+  ~ChunkedAtomicArray() {
+    for (auto& chunk : m_chunks) {
+      delete[] chunk.load(std::memory_order_relaxed);
+    }
+  }
+
+  // The element at :i, allocating its chunk if needed. Thread-safe.
+  std::atomic<T>& at(size_t i) {
+    always_assert(i < kCapacity);
+    auto& slot = m_chunks[i >> ChunkBits];
+    auto* chunk = slot.load(std::memory_order_acquire);
+    if (chunk == nullptr) {
+      auto* fresh = new std::atomic<T>[kChunkSize]();
+      if (slot.compare_exchange_strong(chunk, fresh,
+                                       std::memory_order_acq_rel)) {
+        chunk = fresh;
+      } else {
+        delete[] fresh;
+      }
+    }
+    return chunk[i & (kChunkSize - 1)];
+  }
+
+  // The element at :i, or a value-initialized T if its chunk does not exist.
+  // Thread-safe.
+  T get(size_t i, std::memory_order order = std::memory_order_acquire) const {
+    if (i >= kCapacity) {
+      return T();
+    }
+    auto* chunk = m_chunks[i >> ChunkBits].load(std::memory_order_acquire);
+    return chunk == nullptr ? T() : chunk[i & (kChunkSize - 1)].load(order);
+  }
+
+ private:
+  std::array<std::atomic<std::atomic<T>*>, MaxChunks> m_chunks;
+};
+
+} // namespace detail
+
+/*
+ * Assigns consecutive indices to entities and maps them back. Used by
+ * RedexContext; analyses only need the lookups.
+ */
+template <typename T>
+class IndexTable final {
+ public:
+  // Assign the next index to :entity. Thread-safe.
+  Index add(T* entity) {
+    Index index = m_size.fetch_add(1, std::memory_order_relaxed);
+    m_entities.at(index).store(entity, std::memory_order_release);
+    return index;
+  }
+
+  // Forget the entity at :index, e.g. because it was never published.
+  void clear(Index index) {
+    m_entities.at(index).store(nullptr, std::memory_order_release);
+  }
+
+  // The entity with :index, or nullptr for holes. Thread-safe.
+  T* at(Index index) const { return m_entities.get(index); }
+
+  // One more than the largest index handed out so far.
+  size_t size() const { return m_size.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<Index> m_size{0};
+  detail::ChunkedAtomicArray<T*> m_entities;
+};
+
+/*
+ * A set of entities with dense indices, as a plain bitset that grows on
+ * demand. Not thread-safe.
+ */
+template <typename Entity>
+class IndexedBitSet final {
+ public:
+  bool contains(const Entity* entity) const {
+    auto i = entity->index();
+    return (i >> 6) < m_words.size() && (m_words[i >> 6] >> (i & 63)) & 1;
+  }
+
+  // Returns whether :entity was not in the set before.
+  bool insert(const Entity* entity) {
+    auto i = entity->index();
+    if ((i >> 6) >= m_words.size()) {
+      m_words.resize((i >> 6) + 1, 0);
+    }
+    uint64_t bit = uint64_t(1) << (i & 63);
+    bool inserted = (m_words[i >> 6] & bit) == 0;
+    m_words[i >> 6] |= bit;
+    m_size += inserted;
+    return inserted;
+  }
+
+  size_t size() const { return m_size; }
+
+ private:
+  std::vector<uint64_t> m_words;
+  size_t m_size{0};
+};
+
+/*
+ * A set of entities with dense indices, as a bitset that supports concurrent
+ * insertions and lookups. It takes one bit per index in each 64K-index range
+ * that has members, and never needs to be resized.
+ */
+template <typename Entity>
+class ConcurrentIndexedBitSet final {
+ public:
+  bool contains(const Entity* entity) const {
+    auto i = entity->index();
+    return (m_words.get(i >> 6, std::memory_order_relaxed) >> (i & 63)) & 1;
+  }
+
+  // Returns whether :entity was not in the set before, so that of several
+  // threads inserting the same entity exactly one gets true.
+  bool insert(const Entity* entity) {
+    auto i = entity->index();
+    uint64_t bit = uint64_t(1) << (i & 63);
+    if (m_words.get(i >> 6, std::memory_order_relaxed) & bit) {
+      return false;
+    }
+    bool inserted = (m_words.at(i >> 6).fetch_or(bit) & bit) == 0;
+    if (inserted) {
+      m_size.fetch_add(1, std::memory_order_relaxed);
+    }
+    return inserted;
+  }
+
+  size_t size() const { return m_size.load(std::memory_order_relaxed); }
+
+ private:
+  detail::ChunkedAtomicArray<uint64_t, 10, 65536> m_words;
+  std::atomic<size_t> m_size{0};
+};
+
+/*
+ * A map from entities with dense indices to values, as a flat vector that
+ * grows on demand. Entities that were never assigned map to a
+ * value-initialized Value. Not thread-safe.
+ */
+template <typename Entity, typename Value>
+class IndexedVector final {
+ public:
+  Value& operator[](const Entity* entity) {
+    auto i = entity->index();
+    if (i >= m_values.size()) {
+      m_values.resize(i + 1);
+    }
+    return m_values[i];
+  }
+
+  const Value& get(const Entity* entity, const Value& default_value) const {
+    auto i = entity->index();
+    return i < m_values.size() ? m_values[i] : default_value;
+  }
+
+  void reserve(size_t num_indices) { m_values.reserve(num_indices); }
+
+ private:
+  std::vector<Value> m_values;
+};
+
+} // namespace dense_index
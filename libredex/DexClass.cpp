@@ -21,8 +21,10 @@
 #include "Util.h"
 #include "Walkers.h"
 #include "Warning.h"
+#include "WorkQueue.h"
 
 #include <algorithm>
+#include <array>
 #include <boost/functional/hash.hpp>
 #include <boost/optional.hpp>
 #include <memory>
@@ -40,6 +42,18 @@ int32_t DexString::java_hashcode() const {
   return java_hashcode_of_utf8_string(c_str());
 }
 
+const std::string* DexString::materialize() const {
+  auto* fresh = new std::string(m_data, m_size);
+  std::string* expected = nullptr;
+  if (m_storage.compare_exchange_strong(expected, fresh,
+                                        std::memory_order_acq_rel)) {
+    return fresh;
+  }
+  // Another thread got there first.
+  delete fresh;
+  return expected;
+}
+
 int DexTypeList::encode(DexOutputIdx* dodx, uint32_t* output) const {
   uint16_t* typep = (uint16_t*)(output + 1);
   *output = (uint32_t)m_list.size();
@@ -330,6 +344,52 @@ void DexDebugItem::gather_strings(std::vector<DexString*>& lstring) const {
   }
 }
 
+void DexCode::gather_types(std::vector<DexType*>& ltype) const {
+  for (auto const& insn : *m_insns) {
+    insn->gather_types(ltype);
+  }
+  for (auto const& tri : m_tries) {
+    for (auto const& catz : tri->m_catches) {
+      if (catz.first != nullptr) {
+        ltype.push_back(catz.first);
+      }
+    }
+  }
+  if (m_dbg) m_dbg->gather_types(ltype);
+}
+
+void DexCode::gather_strings(std::vector<DexString*>& lstring) const {
+  for (auto const& insn : *m_insns) {
+    insn->gather_strings(lstring);
+  }
+  if (m_dbg) m_dbg->gather_strings(lstring);
+}
+
+void DexCode::gather_fields(std::vector<DexFieldRef*>& lfield) const {
+  for (auto const& insn : *m_insns) {
+    insn->gather_fields(lfield);
+  }
+}
+
+void DexCode::gather_methods(std::vector<DexMethodRef*>& lmethod) const {
+  for (auto const& insn : *m_insns) {
+    insn->gather_methods(lmethod);
+  }
+}
+
+void DexCode::gather_callsites(std::vector<DexCallSite*>& lcallsite) const {
+  for (auto const& insn : *m_insns) {
+    insn->gather_callsites(lcallsite);
+  }
+}
+
+void DexCode::gather_methodhandles(
+    std::vector<DexMethodHandle*>& lmethodhandle) const {
+  for (auto const& insn : *m_insns) {
+    insn->gather_methodhandles(lmethodhandle);
+  }
+}
+
 DexCode::DexCode(const DexCode& that)
     : m_registers_size(that.m_registers_size),
       m_ins_size(that.m_ins_size),
@@ -521,6 +581,9 @@ std::string DexMethod::get_fully_deobfuscated_name() const {
 }
 
 void DexMethod::set_code(std::unique_ptr<IRCode> code) {
+  if (m_balloon_pending.exchange(false)) {
+    m_dex_code.reset();
+  }
   m_code = std::move(code);
 }
 
@@ -530,7 +593,44 @@ void DexMethod::balloon() {
   m_dex_code.reset();
 }
 
+namespace {
+// Striped, so that methods being ballooned on demand by different threads
+// rarely wait on each other.
+std::mutex& balloon_mutex(const DexMethod* method) {
+  static std::array<std::mutex, 64> mutexes;
+  return mutexes[(reinterpret_cast<uintptr_t>(method) >> 4) % mutexes.size()];
+}
+} // namespace
+
+void DexMethod::defer_balloon() {
+  redex_assert(m_code == nullptr);
+  redex_assert(m_dex_code != nullptr);
+  m_balloon_pending.store(true, std::memory_order_release);
+}
+
+size_t DexMethod::estimate_code_size() const {
+  if (is_balloon_pending()) {
+    std::lock_guard<std::mutex> lock(balloon_mutex(this));
+    if (m_balloon_pending.load(std::memory_order_relaxed)) {
+      return m_dex_code->get_instructions().size();
+    }
+  }
+  return m_code == nullptr ? 0 : m_code->estimate_size();
+}
+
+void DexMethod::balloon_pending() {
+  std::lock_guard<std::mutex> lock(balloon_mutex(this));
+  if (m_balloon_pending.load(std::memory_order_relaxed)) {
+    balloon();
+    m_balloon_pending.store(false, std::memory_order_release);
+  }
+}
+
 void DexMethod::sync() {
+  if (m_balloon_pending.exchange(false)) {
+    // The code was never looked at, so what we loaded is still accurate.
+    return;
+  }
   redex_assert(m_dex_code == nullptr);
   m_dex_code = m_code->sync(this);
   m_code.reset();
@@ -689,6 +789,9 @@ DexMethod* DexMethodRef::make_concrete(DexAccessFlags access, bool is_virtual) {
 void DexMethod::make_non_concrete() {
   m_access = static_cast<DexAccessFlags>(0);
   m_concrete = false;
+  if (m_balloon_pending.exchange(false)) {
+    m_dex_code.reset();
+  }
   m_code.reset();
   m_virtual = false;
   m_param_anno.clear();
@@ -766,7 +869,10 @@ void DexClass::load_class_data_item(DexIdx* idx,
   }
 }
 
-std::unique_ptr<IRCode> DexMethod::release_code() { return std::move(m_code); }
+std::unique_ptr<IRCode> DexMethod::release_code() {
+  balloon_if_pending();
+  return std::move(m_code);
+}
 
 void DexClass::add_method(DexMethod* m) {
   always_assert_log(m->is_concrete() || m->is_external(),
@@ -1272,7 +1378,11 @@ void DexField::gather_methods(std::vector<DexMethodRef*>& lmethod) const {
 
 void DexMethod::gather_types(std::vector<DexType*>& ltype) const {
   gather_types_shallow(ltype); // Handle DexMethodRef parts.
-  if (m_code) m_code->gather_types(ltype);
+  if (m_code) {
+    m_code->gather_types(ltype);
+  } else if (is_balloon_pending()) {
+    m_dex_code->gather_types(ltype);
+  }
   if (m_anno) m_anno->gather_types(ltype);
   auto param_anno = get_param_anno();
   if (param_anno) {
@@ -1285,18 +1395,32 @@ void DexMethod::gather_types(std::vector<DexType*>& ltype) const {
 
 void DexMethod::gather_callsites(std::vector<DexCallSite*>& lcallsite) const {
   // We handle m_spec.cls and proto in the first-layer gather.
-  if (m_code) m_code->gather_callsites(lcallsite);
+  if (m_code) {
+    m_code->gather_callsites(lcallsite);
+  } else if (is_balloon_pending()) {
+    m_dex_code->gather_callsites(lcallsite);
+  }
 }
 
 void DexMethod::gather_methodhandles(
     std::vector<DexMethodHandle*>& lmethodhandle) const {
   // We handle m_spec.cls and proto in the first-layer gather.
-  if (m_code) m_code->gather_methodhandles(lmethodhandle);
+  if (m_code) {
+    m_code->gather_methodhandles(lmethodhandle);
+  } else if (is_balloon_pending()) {
+    m_dex_code->gather_methodhandles(lmethodhandle);
+  }
 }
 void DexMethod::gather_strings(std::vector<DexString*>& lstring,
                                bool exclude_loads) const {
   // We handle m_name and proto in the first-layer gather.
-  if (m_code && !exclude_loads) m_code->gather_strings(lstring);
+  if (!exclude_loads) {
+    if (m_code) {
+      m_code->gather_strings(lstring);
+    } else if (is_balloon_pending()) {
+      m_dex_code->gather_strings(lstring);
+    }
+  }
   if (m_anno) m_anno->gather_strings(lstring);
   auto param_anno = get_param_anno();
   if (param_anno) {
@@ -1308,7 +1432,11 @@ void DexMethod::gather_strings(std::vector<DexString*>& lstring,
 }
 
 void DexMethod::gather_fields(std::vector<DexFieldRef*>& lfield) const {
-  if (m_code) m_code->gather_fields(lfield);
+  if (m_code) {
+    m_code->gather_fields(lfield);
+  } else if (is_balloon_pending()) {
+    m_dex_code->gather_fields(lfield);
+  }
   if (m_anno) m_anno->gather_fields(lfield);
   auto param_anno = get_param_anno();
   if (param_anno) {
@@ -1320,7 +1448,11 @@ void DexMethod::gather_fields(std::vector<DexFieldRef*>& lfield) const {
 }
 
 void DexMethod::gather_methods(std::vector<DexMethodRef*>& lmethod) const {
-  if (m_code) m_code->gather_methods(lmethod);
+  if (m_code) {
+    m_code->gather_methods(lmethod);
+  } else if (is_balloon_pending()) {
+    m_dex_code->gather_methods(lmethod);
+  }
   if (m_anno) m_anno->gather_methods(lmethod);
   auto param_anno = get_param_anno();
   if (param_anno) {
@@ -1416,14 +1548,59 @@ void gather_components(std::vector<DexString*>& lstring,
                        std::vector<DexMethodHandle*>& lmethodhandle,
                        const DexClasses& classes,
                        bool exclude_loads) {
-  // Gather references reachable from each class.
+  // Gather references reachable from each class. Each thread collects into
+  // its own buffers, which it dedups before they get merged.
+  struct Components {
+    std::vector<DexString*> strings;
+    std::vector<DexType*> types;
+    std::vector<DexFieldRef*> fields;
+    std::vector<DexMethodRef*> methods;
+    std::vector<DexCallSite*> callsites;
+    std::vector<DexMethodHandle*> methodhandles;
+  };
+  size_t num_threads = redex_parallel::default_num_threads();
+  std::vector<Components> components(num_threads);
+  auto wq = workqueue_foreach<DexClass*>(
+      [&](sparta::SpartaWorkerState<DexClass*>* state, DexClass* cls) {
+        auto& c = components.at(state->worker_id());
+        cls->gather_strings(c.strings, exclude_loads);
+        cls->gather_types(c.types);
+        cls->gather_fields(c.fields);
+        cls->gather_methods(c.methods);
+        cls->gather_callsites(c.callsites);
+        cls->gather_methodhandles(c.methodhandles);
+      },
+      num_threads);
   for (auto const& cls : classes) {
-    cls->gather_strings(lstring, exclude_loads);
-    cls->gather_types(ltype);
-    cls->gather_fields(lfield);
-    cls->gather_methods(lmethod);
-    cls->gather_callsites(lcallsite);
-    cls->gather_methodhandles(lmethodhandle);
+    wq.add_item(cls);
+  }
+  wq.run_all();
+
+  auto dedup_wq = workqueue_foreach<Components*>(
+      [](Components* c) {
+        sort_unique(c->strings);
+        sort_unique(c->types);
+        sort_unique(c->fields);
+        sort_unique(c->methods);
+        sort_unique(c->callsites);
+        sort_unique(c->methodhandles);
+      },
+      num_threads);
+  for (auto& c : components) {
+    dedup_wq.add_item(&c);
+  }
+  dedup_wq.run_all();
+
+  auto merge = [](const auto& from, auto& into) {
+    into.insert(into.end(), from.begin(), from.end());
+  };
+  for (auto& c : components) {
+    merge(c.strings, lstring);
+    merge(c.types, ltype);
+    merge(c.fields, lfield);
+    merge(c.methods, lmethod);
+    merge(c.callsites, lcallsite);
+    merge(c.methodhandles, lmethodhandle);
   }
 
   // Remove duplicates to speed up the later loops.
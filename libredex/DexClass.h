@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <cstdlib>
 #include <cstring>
 #include <functional>
@@ -68,15 +69,37 @@ extern "C" bool strcmp_less(const char* str1, const char* str2);
 class DexString {
   friend struct RedexContext;
 
-  std::string m_storage;
+  // Strings either own their contents, or borrow them from an input dex that
+  // stays mapped for the lifetime of the RedexContext (see
+  // RedexContext::make_borrowed_string). In both cases, m_data points to the
+  // NUL-terminated MUTF-8 contents. A borrowed string has no std::string until
+  // str() is first called on it.
+  const char* m_data;
+  uint32_t m_size;
   uint32_t m_utfsize;
+  mutable std::atomic<std::string*> m_storage;
 
   // See UNIQUENESS above for the rationale for the private constructor pattern.
   DexString(std::string nstr, uint32_t utfsize)
-      : m_storage(std::move(nstr)), m_utfsize(utfsize) {}
+      : m_utfsize(utfsize), m_storage(new std::string(std::move(nstr))) {
+    auto* storage = m_storage.load(std::memory_order_relaxed);
+    m_data = storage->c_str();
+    m_size = static_cast<uint32_t>(storage->size());
+  }
+
+  struct Borrowed {};
+  DexString(Borrowed, const char* nstr, uint32_t utfsize)
+      : m_data(nstr),
+        m_size(static_cast<uint32_t>(strlen(nstr))),
+        m_utfsize(utfsize),
+        m_storage(nullptr) {}
+
+  ~DexString() { delete m_storage.load(std::memory_order_relaxed); }
+
+  const std::string* materialize() const;
 
  public:
-  uint32_t size() const { return static_cast<uint32_t>(m_storage.size()); }
+  uint32_t size() const { return m_size; }
 
   // UTF-aware length
   uint32_t length() const;
@@ -99,6 +122,11 @@ class DexString {
     return make_string(nstr.c_str());
   }
 
+  static std::vector<DexString*> make_strings(
+      const std::vector<std::string>& strs) {
+    return g_redex->make_strings(strs);
+  }
+
   // Return an existing DexString or nullptr if one does not exist.
   static DexString* get_string(const char* nstr, uint32_t utfsize) {
     return g_redex->get_string(nstr, utfsize);
@@ -115,8 +143,11 @@ class DexString {
  public:
   bool is_simple() const { return size() == m_utfsize; }
 
-  const char* c_str() const { return m_storage.c_str(); }
-  const std::string& str() const { return m_storage; }
+  const char* c_str() const { return m_data; }
+  const std::string& str() const {
+    auto* storage = m_storage.load(std::memory_order_acquire);
+    return storage != nullptr ? *storage : *materialize();
+  }
 
   uint32_t get_entry_size() const {
     uint32_t len = uleb128_encoding_size(m_utfsize);
@@ -144,32 +175,7 @@ inline bool compare_dexstrings(const DexString* a, const DexString* b) {
 #else
     return (strcmp(a->c_str(), b->c_str()) < 0);
 #endif
-  /*
-   * Bother, need to do code-point character-by-character
-   * comparison.
-   */
-  const char* sa = a->c_str();
-  const char* sb = b->c_str();
-  /* Equivalence test first, so we don't worry about walking
-   * off the end.
-   */
-  if (strcmp(sa, sb) == 0) return false;
-  if (strlen(sa) == 0) {
-    return true;
-  }
-  if (strlen(sb) == 0) {
-    return false;
-  }
-  while (1) {
-    uint32_t cpa = mutf8_next_code_point(sa);
-    uint32_t cpb = mutf8_next_code_point(sb);
-    if (cpa == cpb) {
-      if (*sa == '\0') return true;
-      if (*sb == '\0') return false;
-      continue;
-    }
-    return (cpa < cpb);
-  }
+  return mutf8_less(a->c_str(), b->c_str());
 }
 
 struct dexstrings_comparator {
@@ -182,11 +188,15 @@ class DexType {
   friend struct RedexContext;
 
   DexString* m_name;
+  uint32_t m_index{0};
 
   // See UNIQUENESS above for the rationale for the private constructor pattern.
   explicit DexType(DexString* dstring) { m_name = dstring; }
 
  public:
+  // The dense index of this type, see DenseIndex.h.
+  uint32_t index() const { return m_index; }
+
   // DexType retrieval/creation
 
   // If the DexType exists, return it, otherwise create it and return it.
@@ -273,6 +283,7 @@ class DexFieldRef {
   DexFieldSpec m_spec;
   bool m_concrete;
   bool m_external;
+  uint32_t m_index{0};
 
   ~DexFieldRef() {}
   DexFieldRef(DexType* container, DexString* name, DexType* type) {
@@ -290,6 +301,9 @@ class DexFieldRef {
   const DexField* as_def() const;
   DexField* as_def();
 
+  // The dense index of this field, see DenseIndex.h.
+  uint32_t index() const { return m_index; }
+
   DexType* get_class() const { return m_spec.cls; }
   DexString* get_name() const { return m_spec.name; }
   const char* c_str() const { return get_name()->c_str(); }
@@ -790,6 +804,13 @@ class DexCode {
    */
   uint32_t size() const;
 
+  void gather_types(std::vector<DexType*>& ltype) const;
+  void gather_strings(std::vector<DexString*>& lstring) const;
+  void gather_fields(std::vector<DexFieldRef*>& lfield) const;
+  void gather_methods(std::vector<DexMethodRef*>& lmethod) const;
+  void gather_callsites(std::vector<DexCallSite*>& lcallsite) const;
+  void gather_methodhandles(std::vector<DexMethodHandle*>& lmethodhandle) const;
+
   friend std::string show(const DexCode*);
 };
 
@@ -816,6 +837,7 @@ class DexMethodRef {
   DexMethodSpec m_spec;
   bool m_concrete;
   bool m_external;
+  uint32_t m_index{0};
 
   ~DexMethodRef() {}
   DexMethodRef(DexType* type, DexString* name, DexProto* proto)
@@ -831,6 +853,9 @@ class DexMethodRef {
   const DexMethod* as_def() const;
   DexMethod* as_def();
 
+  // The dense index of this method, see DenseIndex.h.
+  uint32_t index() const { return m_index; }
+
   DexType* get_class() const { return m_spec.cls; }
   DexString* get_name() const { return m_spec.name; }
   const char* c_str() const { return get_name()->c_str(); }
@@ -868,6 +893,8 @@ class DexMethod : public DexMethodRef {
   DexAnnotationSet* m_anno;
   std::unique_ptr<DexCode> m_dex_code;
   std::unique_ptr<IRCode> m_code;
+  // Set by defer_balloon() while m_dex_code still awaits conversion to IRCode.
+  std::atomic<bool> m_balloon_pending{false};
   DexAccessFlags m_access;
   bool m_virtual;
   ParamAnnotations m_param_anno;
@@ -877,11 +904,6 @@ class DexMethod : public DexMethodRef {
   DexMethod(DexType* type, DexString* name, DexProto* proto);
   ~DexMethod();
 
-  // For friend classes to use with smart pointers.
-  struct Deleter {
-    void operator()(DexMethod* m) { delete m; }
-  };
-
  public:
   // Tracks whether this method can be deleted or renamed
   ReferencedState rstate;
@@ -976,8 +998,14 @@ class DexMethod : public DexMethodRef {
   DexAnnotationSet* get_anno_set() { return m_anno; }
   const DexCode* get_dex_code() const { return m_dex_code.get(); }
   DexCode* get_dex_code() { return m_dex_code.get(); }
-  IRCode* get_code() { return m_code.get(); }
-  const IRCode* get_code() const { return m_code.get(); }
+  IRCode* get_code() {
+    balloon_if_pending();
+    return m_code.get();
+  }
+  const IRCode* get_code() const {
+    const_cast<DexMethod*>(this)->balloon_if_pending();
+    return m_code.get();
+  }
   std::unique_ptr<IRCode> release_code();
   bool is_virtual() const { return m_virtual; }
   DexAccessFlags get_access() const {
@@ -1101,6 +1129,31 @@ class DexMethod : public DexMethodRef {
    */
   void balloon();
   void sync();
+
+  /*
+   * Like balloon(), but the conversion only happens when the IRCode is first
+   * asked for via get_code(), which may be from any thread. If nobody ever
+   * looks at the code, sync() keeps the DexCode that was loaded.
+   */
+  void defer_balloon();
+  bool is_balloon_pending() const {
+    return m_balloon_pending.load(std::memory_order_acquire);
+  }
+
+  /*
+   * A rough size of the code, for scheduling decisions. Unlike get_code(), it
+   * never balloons: while that is pending, it counts the loaded dex
+   * instructions instead.
+   */
+  size_t estimate_code_size() const;
+
+ private:
+  void balloon_if_pending() {
+    if (is_balloon_pending()) {
+      balloon_pending();
+    }
+  }
+  void balloon_pending();
 };
 
 using dexcode_to_offset = std::unordered_map<DexCode*, uint32_t>;
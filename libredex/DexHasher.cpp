@@ -51,7 +51,13 @@ void DexClassHasher::hash(const std::string& str) {
   boost::hash_combine(m_hash, str);
 }
 
-void DexClassHasher::hash(const DexString* s) { hash(s->str()); }
+void DexClassHasher::hash(const DexString* s) {
+  // Same value as hashing s->str(), but we don't want to materialize the
+  // std::string of strings borrowed from an input dex just for hashing.
+  TRACE(HASHER, 4, "[hasher] %s", s->c_str());
+  boost::hash_combine(m_hash,
+                      boost::hash_range(s->c_str(), s->c_str() + s->size()));
+}
 
 void DexClassHasher::hash(bool value) {
   TRACE(HASHER, 4, "[hasher] %u", value);
@@ -84,7 +90,12 @@ void DexClassHasher::hash(const IRInstruction* insn) {
 
   auto old_hash = m_hash;
   m_hash = 0;
-  hash(insn->srcs_vec());
+  // Same as hashing srcs_vec(), without allocating the vector.
+  auto srcs_size = insn->srcs_size();
+  hash((uint64_t)srcs_size);
+  for (size_t i = 0; i < srcs_size; ++i) {
+    hash(insn->src(i));
+  }
   if (insn->has_dest()) {
     hash(insn->dest());
   }
@@ -20,7 +20,8 @@
   m_##TYPE##_ids_size = dh->TYPE##_ids_size;                           \
   m_##TYPE##_cache = (CACHETYPE*)calloc(dh->TYPE##_ids_size, sizeof(CACHETYPE))
 
-DexIdx::DexIdx(const dex_header* dh) {
+DexIdx::DexIdx(const dex_header* dh, bool borrow_strings)
+    : m_borrow_strings(borrow_strings) {
   m_dexbase = (const uint8_t*)dh;
   INIT_DMAP_ID(string, DexString*);
   INIT_DMAP_ID(type, DexType*);
@@ -128,6 +129,9 @@ DexString* DexIdx::get_stringidx_fromdex(uint32_t stridx) {
   const uint8_t* dstr = m_dexbase + stroff;
   /* Strip off uleb128 size encoding */
   int utfsize = read_uleb128(&dstr);
+  if (m_borrow_strings) {
+    return g_redex->make_borrowed_string((const char*)dstr, utfsize);
+  }
   return DexString::make_string((const char*)dstr, utfsize);
 }
 
@@ -27,6 +27,9 @@ class DexMethodHandle;
 class DexIdx {
  private:
   const uint8_t* m_dexbase;
+  // Whether the dex outlives the RedexContext, so that DexStrings may
+  // reference its string data instead of copying it.
+  bool m_borrow_strings;
 
   dex_string_id* m_string_ids;
   uint32_t m_string_ids_size;
@@ -60,7 +63,7 @@ class DexIdx {
   DexMethodHandle* get_methodhandleidx_fromdex(uint32_t mhidx);
 
  public:
-  explicit DexIdx(const dex_header* dh);
+  explicit DexIdx(const dex_header* dh, bool borrow_strings = false);
   ~DexIdx();
 
   DexString* get_stringidx(uint32_t stridx) {
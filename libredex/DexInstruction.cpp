@@ -88,62 +88,13 @@ DexInstruction* DexInstruction::set_opcode(DexOpcode op) {
 bool DexInstruction::has_dest() const { return dex_opcode::has_dest(opcode()); }
 
 unsigned DexInstruction::srcs_size() const {
-  auto format = dex_opcode::format(opcode());
-  switch (format) {
-  case FMT_f00x:
-  case FMT_f10x:
-  case FMT_f11n:
-  case FMT_f11x_d:
-  case FMT_f10t:
-  case FMT_f20t:
-  case FMT_f21s:
-  case FMT_f21h:
-  case FMT_f21c_d:
-  case FMT_f30t:
-  case FMT_f31i:
-  case FMT_f31c:
-  case FMT_f3rc:
-  case FMT_f4rcc:
-  case FMT_f51l:
-  case FMT_f5rc:
-  case FMT_f41c_d:
-  case FMT_fopcode:
-    return 0;
-  case FMT_f12x:
-  case FMT_f11x_s:
-  case FMT_f22x:
-  case FMT_f21t:
-  case FMT_f21c_s:
-  case FMT_f22b:
-  case FMT_f22s:
-  case FMT_f22c_d:
-  case FMT_f32x:
-  case FMT_f31t:
-  case FMT_f41c_s:
-  case FMT_f52c_d:
-    return 1;
-  case FMT_f12x_2:
-  case FMT_f23x_d:
-  case FMT_f22t:
-  case FMT_f22c_s:
-  case FMT_f52c_s:
-    return 2;
-  case FMT_f23x_s:
-    return 3;
-  case FMT_f35c:
-  case FMT_f45cc:
-  case FMT_f57c:
+  auto op = opcode();
+  auto format = dex_opcode::format(op);
+  if (format == FMT_f35c || format == FMT_f45cc || format == FMT_f57c) {
     return arg_word_count();
-  case FMT_f20bc:
-  case FMT_f22cs:
-  case FMT_f35ms:
-  case FMT_f35mi:
-  case FMT_f3rms:
-  case FMT_f3rmi:
-  case FMT_iopcode:
-    always_assert_log(false, "Unimplemented opcode `%s'", SHOW(this));
   }
-  not_reached();
+  // The other formats have a fixed number of source registers.
+  return dex_opcode::min_srcs_size(op);
 }
 
 uint16_t DexInstruction::dest() const {
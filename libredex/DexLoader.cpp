@@ -15,10 +15,72 @@
 #include "Walkers.h"
 #include "WorkQueue.h"
 
+#include <algorithm>
+#include <chrono>
 #include <exception>
 #include <stdexcept>
+#include <unordered_set>
 #include <vector>
 
+#ifndef _MSC_VER
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+/*
+ * Pass :advice for the pages of [begin, end) of a mapping at :base to the
+ * kernel. The range is widened to whole pages when asking for them and
+ * narrowed when giving them up, so that no neighboring data is dropped.
+ * Advice is only a hint, so errors are ignored. Returns the number of bytes
+ * advised.
+ */
+size_t advise(const uint8_t* base, size_t begin, size_t end, bool willneed) {
+#if !defined(_MSC_VER) && defined(MADV_WILLNEED) && defined(MADV_DONTNEED)
+  static const size_t page_size = sysconf(_SC_PAGESIZE);
+  // Mappings start at a page boundary.
+  if (willneed) {
+    begin = begin / page_size * page_size;
+    end = (end + page_size - 1) / page_size * page_size;
+  } else {
+    begin = (begin + page_size - 1) / page_size * page_size;
+    end = end / page_size * page_size;
+  }
+  if (begin >= end) {
+    return 0;
+  }
+  auto addr = const_cast<uint8_t*>(base + begin);
+  if (madvise(addr, end - begin, willneed ? MADV_WILLNEED : MADV_DONTNEED) !=
+      0) {
+    return 0;
+  }
+  return end - begin;
+#else
+  return 0;
+#endif
+}
+
+// The major page faults of the calling thread so far, if the OS tells.
+int64_t thread_major_faults() {
+#ifdef RUSAGE_THREAD
+  struct rusage usage;
+  if (getrusage(RUSAGE_THREAD, &usage) == 0) {
+    return usage.ru_majflt;
+  }
+#endif
+  return 0;
+}
+
+int64_t elapsed_us(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+} // namespace
+
 DexLoader::DexLoader(const char* location)
     : m_idx(nullptr),
       m_file(new boost::iostreams::mapped_file()),
@@ -78,6 +140,9 @@ void DexLoader::gather_input_stats(dex_stats_t* stats, const dex_header* dh) {
   stats->num_strings += dh->string_ids_size;
   stats->num_protos += dh->proto_ids_size;
   stats->num_bytes += dh->file_size;
+  stats->open_us += m_open_us;
+  stats->decode_us += m_decode_us;
+  stats->major_faults += m_major_faults;
   // T58562665: TODO - actually update states for callsites/methodhandles
   stats->num_callsites += 0;
   stats->num_methodhandles += 0;
@@ -167,7 +232,7 @@ void DexLoader::gather_input_stats(dex_stats_t* stats, const dex_header* dh) {
   }
 
   const dex_map_list* map_list =
-      reinterpret_cast<const dex_map_list*>(m_file->const_data() + dh->map_off);
+      reinterpret_cast<const dex_map_list*>((const uint8_t*)dh + dh->map_off);
   bool header_seen = false;
   uint32_t header_index = 0;
   for (uint32_t i = 0; i < map_list->size; i++) {
@@ -453,8 +518,12 @@ void DexLoader::gather_input_stats(dex_stats_t* stats, const dex_header* dh) {
 }
 
 void DexLoader::load_dex_class(int num) {
+  auto start = std::chrono::steady_clock::now();
+  auto faults = thread_major_faults();
   const dex_class_def* cdef = m_class_defs + num;
   DexClass* dc = DexClass::create(m_idx.get(), cdef, m_dex_location);
+  m_decode_us += elapsed_us(start);
+  m_major_faults += thread_major_faults() - faults;
   // We may be inserting a nullptr here. Need to remove them later
   //
   // We're inserting nullptr because we can't mess up the indices of the other
@@ -463,12 +532,64 @@ void DexLoader::load_dex_class(int num) {
 }
 
 const dex_header* DexLoader::get_dex_header(const char* location) {
+  auto start = std::chrono::steady_clock::now();
   m_file->open(location, boost::iostreams::mapped_file::readonly);
   if (!m_file->is_open()) {
     fprintf(stderr, "error: cannot create memory-mapped file: %s\n", location);
     exit(EXIT_FAILURE);
   }
-  return reinterpret_cast<const dex_header*>(m_file->const_data());
+  m_mapped_data = reinterpret_cast<const uint8_t*>(m_file->const_data());
+  m_mapped_size = m_file->size();
+  // Loading reads the id tables first, and then the class definitions point
+  // all over the data section. Start reading both in that order right away
+  // rather than faulting them in page by page.
+  auto dh = reinterpret_cast<const dex_header*>(m_mapped_data);
+  if (m_mapped_size >= sizeof(dex_header) && dh->data_off < m_mapped_size) {
+    advise(m_mapped_data, 0, dh->data_off, /* willneed */ true);
+    advise(m_mapped_data, dh->data_off, m_mapped_size, /* willneed */ true);
+  }
+  m_open_us = elapsed_us(start);
+  return dh;
+}
+
+void DexLoader::release_decoded_sections(const dex_header* dh) {
+  if (m_mapped_data == nullptr ||
+      reinterpret_cast<const dex_header*>(m_mapped_data) != dh) {
+    return;
+  }
+  const auto* map_list = reinterpret_cast<const dex_map_list*>(
+      m_mapped_data + dh->map_off);
+  std::vector<dex_map_item> items(map_list->items,
+                                  map_list->items + map_list->size);
+  std::sort(items.begin(), items.end(),
+            [](const dex_map_item& a, const dex_map_item& b) {
+              return a.offset < b.offset;
+            });
+  for (size_t i = 0; i < items.size(); ++i) {
+    switch (items[i].type) {
+    case TYPE_TYPE_LIST:
+    case TYPE_ANNOTATION_SET_REF_LIST:
+    case TYPE_ANNOTATION_SET_ITEM:
+    case TYPE_CLASS_DATA_ITEM:
+    case TYPE_CODE_ITEM:
+    case TYPE_DEBUG_INFO_ITEM:
+    case TYPE_ANNOTATION_ITEM:
+    case TYPE_ENCODED_ARRAY_ITEM:
+    case TYPE_ANNOTATIONS_DIR_ITEM: {
+      // Sections are contiguous, so one ends where the next one begins.
+      size_t end =
+          i + 1 < items.size() ? items[i + 1].offset : (size_t)dh->file_size;
+      m_released_bytes +=
+          advise(m_mapped_data, items[i].offset,
+                 std::min(end, m_mapped_size), /* willneed */ false);
+      break;
+    }
+    default:
+      // The ids are looked up while loading other dexes, and interned
+      // strings may point into the string data.
+      break;
+    }
+  }
 }
 
 DexClasses DexLoader::load_dex(const char* location,
@@ -479,18 +600,28 @@ DexClasses DexLoader::load_dex(const char* location,
   return load_dex(dh, stats);
 }
 
-DexClasses DexLoader::load_dex(const dex_header* dh, dex_stats_t* stats) {
-  if (dh->class_defs_size == 0) {
-    return DexClasses(0);
+void DexLoader::init_idx(const dex_header* dh) {
+  // When the dex is mapped by this loader, hand the mapping over to the
+  // RedexContext right away so that the strings interned from it can keep
+  // pointing into it, even if loading fails halfway.
+  bool borrow_strings =
+      m_file->is_open() &&
+      reinterpret_cast<const dex_header*>(m_file->const_data()) == dh;
+  m_idx = std::make_unique<DexIdx>(dh, borrow_strings);
+  if (borrow_strings) {
+    g_redex->retain_mapped_dex(std::move(m_file));
+    m_file = std::make_unique<boost::iostreams::mapped_file>();
   }
-  m_idx = std::make_unique<DexIdx>(dh);
   auto off = (uint64_t)dh->class_defs_off;
   m_class_defs =
       reinterpret_cast<const dex_class_def*>((const uint8_t*)dh + off);
-  DexClasses classes(dh->class_defs_size);
-  m_classes = &classes;
+}
 
-  auto lwork = new class_load_work[dh->class_defs_size];
+/*
+ * Run load_dex_class on all of :work in parallel, and throw an
+ * aggregate_exception if any of them threw.
+ */
+static void load_dex_classes(std::vector<class_load_work>& work) {
   auto num_threads = redex_parallel::default_num_threads();
   std::vector<std::vector<std::exception_ptr>> exceptions_vec(num_threads);
   auto wq = workqueue_foreach<class_load_work*>(
@@ -505,13 +636,10 @@ DexClasses DexLoader::load_dex(const dex_header* dh, dex_stats_t* stats) {
         }
       },
       num_threads);
-  for (uint32_t i = 0; i < dh->class_defs_size; i++) {
-    lwork[i].dl = this;
-    lwork[i].num = i;
-    wq.add_item(&lwork[i]);
+  for (auto& clw : work) {
+    wq.add_item(&clw);
   }
   wq.run_all();
-  delete[] lwork;
 
   std::vector<std::exception_ptr> all_exceptions;
   for (auto& exceptions : exceptions_vec) {
@@ -523,18 +651,133 @@ DexClasses DexLoader::load_dex(const dex_header* dh, dex_stats_t* stats) {
     aggregate_exception ae(all_exceptions);
     throw ae;
   }
+}
 
-  gather_input_stats(stats, dh);
-
-  // Remove nulls from the classes list. They may have been introduced by benign
-  // duplicate classes.
+// Remove nulls from the classes list. They may have been introduced by benign
+// duplicate classes.
+static void remove_duplicates(DexClasses& classes) {
   classes.erase(std::remove(classes.begin(), classes.end(), nullptr),
                 classes.end());
+}
+
+DexClasses DexLoader::load_dex(const dex_header* dh, dex_stats_t* stats) {
+  if (dh->class_defs_size == 0) {
+    return DexClasses(0);
+  }
+  init_idx(dh);
+  DexClasses classes(dh->class_defs_size);
+  m_classes = &classes;
+
+  std::vector<class_load_work> lwork(dh->class_defs_size);
+  for (uint32_t i = 0; i < dh->class_defs_size; i++) {
+    lwork[i].dl = this;
+    lwork[i].num = i;
+  }
+  load_dex_classes(lwork);
+
+  gather_input_stats(stats, dh);
+  release_decoded_sections(dh);
+  if (stats != nullptr) {
+    stats->released_bytes += m_released_bytes;
+  }
+
+  remove_duplicates(classes);
 
   return classes;
 }
 
+std::vector<DexClasses> DexLoader::load_dexes(
+    const std::vector<std::string>& locations,
+    std::vector<dex_stats_t>* stats,
+    int support_dex_version) {
+  const size_t num_dexes = locations.size();
+  std::vector<std::unique_ptr<DexLoader>> loaders;
+  std::vector<const dex_header*> headers;
+  std::vector<DexClasses> dexes(num_dexes);
+  for (size_t d = 0; d < num_dexes; ++d) {
+    const char* location = locations[d].c_str();
+    loaders.push_back(std::make_unique<DexLoader>(location));
+    auto& dl = *loaders.back();
+    const dex_header* dh = dl.get_dex_header(location);
+    validate_dex_header(dh, dl.m_file->size(), support_dex_version);
+    headers.push_back(dh);
+    if (dh->class_defs_size != 0) {
+      dl.init_idx(dh);
+      dexes[d].resize(dh->class_defs_size);
+      dl.m_classes = &dexes[d];
+    }
+  }
+
+  auto for_each_dex = [&](const std::function<void(size_t)>& fn) {
+    auto wq = workqueue_foreach<size_t>(fn);
+    for (size_t d = 0; d < num_dexes; ++d) {
+      wq.add_item(d);
+    }
+    wq.run_all();
+  };
+
+  // Which of several definitions of the same class gets loaded must not depend
+  // on timing. Resolve that up front, from the class types alone: like the
+  // serial loader, we keep the first definition in dex order.
+  std::vector<std::vector<DexType*>> types(num_dexes);
+  for_each_dex([&](size_t d) {
+    auto& dl = *loaders[d];
+    for (uint32_t i = 0; i < headers[d]->class_defs_size; ++i) {
+      types[d].push_back(dl.m_idx->get_typeidx(dl.m_class_defs[i].typeidx));
+    }
+  });
+  std::unordered_set<const DexType*> seen;
+  std::vector<class_load_work> firsts;
+  std::vector<class_load_work> duplicates;
+  for (size_t d = 0; d < num_dexes; ++d) {
+    for (uint32_t i = 0; i < types[d].size(); ++i) {
+      class_load_work clw{loaders[d].get(), (int)i};
+      if (seen.insert(types[d][i]).second) {
+        firsts.push_back(clw);
+      } else {
+        duplicates.push_back(clw);
+      }
+    }
+  }
+
+  // The class definitions of all dexes share one work queue.
+  load_dex_classes(firsts);
+  // Now that every class they duplicate is loaded, DexClass::create reports
+  // (or rejects) the duplicates in the same order as the serial loader.
+  for (auto& clw : duplicates) {
+    clw.dl->load_dex_class(clw.num);
+  }
+
+  if (stats != nullptr) {
+    stats->resize(num_dexes);
+  }
+  for_each_dex([&](size_t d) {
+    if (headers[d]->class_defs_size == 0) {
+      return;
+    }
+    loaders[d]->gather_input_stats(stats ? &stats->at(d) : nullptr,
+                                   headers[d]);
+    loaders[d]->release_decoded_sections(headers[d]);
+    if (stats != nullptr) {
+      stats->at(d).released_bytes += loaders[d]->m_released_bytes;
+    }
+  });
+
+  for (auto& classes : dexes) {
+    remove_duplicates(classes);
+  }
+  return dexes;
+}
+
 static void balloon_all(const Scope& scope) {
+  if (RedexContext::lazy_balloon()) {
+    walk::methods(scope, [](DexMethod* m) {
+      if (m->get_dex_code()) {
+        m->defer_balloon();
+      }
+    });
+    return;
+  }
   auto wq = workqueue_foreach<DexMethod*>(
       [](DexMethod* method) { method->balloon(); });
   walk::methods(scope, [&](DexMethod* m) {
@@ -582,4 +825,23 @@ std::string load_dex_magic_from_dex(const char* location) {
   return dh->magic;
 }
 
+std::vector<DexClasses> load_classes_from_dexes(
+    const std::vector<std::string>& locations,
+    std::vector<dex_stats_t>* stats,
+    bool balloon,
+    int support_dex_version) {
+  for (const auto& location : locations) {
+    TRACE(MAIN, 1, "Loading classes from dex from %s", location.c_str());
+  }
+  auto dexes = DexLoader::load_dexes(locations, stats, support_dex_version);
+  if (balloon) {
+    Scope scope;
+    for (const auto& classes : dexes) {
+      scope.insert(scope.end(), classes.begin(), classes.end());
+    }
+    balloon_all(scope);
+  }
+  return dexes;
+}
+
 void balloon_for_test(const Scope& scope) { balloon_all(scope); }
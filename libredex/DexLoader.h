@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <boost/iostreams/device/mapped_file.hpp>
 
 #include "DexClass.h"
@@ -21,6 +22,21 @@ class DexLoader {
   DexClasses* m_classes;
   std::unique_ptr<boost::iostreams::mapped_file> m_file;
   std::string m_dex_location;
+  // The mapping of the dex, if this loader opened it. It stays valid after
+  // init_idx hands m_file over to the RedexContext.
+  const uint8_t* m_mapped_data{nullptr};
+  size_t m_mapped_size{0};
+  // I/O stats, see dex_stats_t.
+  int64_t m_open_us{0};
+  std::atomic<int64_t> m_decode_us{0};
+  std::atomic<int64_t> m_major_faults{0};
+  int64_t m_released_bytes{0};
+
+  void init_idx(const dex_header* dh);
+
+  // Lets the kernel drop the pages of the sections that are fully decoded
+  // once the classes are loaded, i.e. all but the ids and the string data.
+  void release_decoded_sections(const dex_header* dh);
 
  public:
   explicit DexLoader(const char* location);
@@ -33,6 +49,12 @@ class DexLoader {
   void load_dex_class(int num);
   void gather_input_stats(dex_stats_t* stats, const dex_header* dh);
   DexIdx* get_idx() { return m_idx.get(); }
+
+  // See load_classes_from_dexes.
+  static std::vector<DexClasses> load_dexes(
+      const std::vector<std::string>& locations,
+      std::vector<dex_stats_t>* stats,
+      int support_dex_version);
 };
 
 DexClasses load_classes_from_dex(const char* location,
@@ -45,6 +67,18 @@ DexClasses load_classes_from_dex(const char* location,
 DexClasses load_classes_from_dex(const dex_header* dh,
                                  const char* location,
                                  bool balloon = true);
+/*
+ * Load several dexes at once. The class definitions of all of them are spread
+ * across the same worker threads, rather than loading one dex after the other.
+ * The result is the same as calling load_classes_from_dex on each location in
+ * turn, including which definition is kept when a class is defined more than
+ * once. :stats, if given, receives the stats of each dex.
+ */
+std::vector<DexClasses> load_classes_from_dexes(
+    const std::vector<std::string>& locations,
+    std::vector<dex_stats_t>* stats,
+    bool balloon = true,
+    int support_dex_version = 35);
 std::string load_dex_magic_from_dex(const char* location);
 void balloon_for_test(const Scope& scope);
 
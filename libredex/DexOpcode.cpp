@@ -12,29 +12,120 @@
 
 namespace dex_opcode {
 
-// clang-format off
-OpcodeFormat format(DexOpcode opcode) {
-  switch (opcode) {
+namespace {
+
+enum class OpcodeKind : uint8_t { UNUSED, DEX, QUICK };
+
+// The format of each one-byte opcode, generated from the opcode definitions.
+struct OpcodeFormatTable {
+  OpcodeFormat formats[256];
+  OpcodeKind kinds[256];
+
+  constexpr OpcodeFormatTable() : formats(), kinds() {
+    for (size_t i = 0; i < 256; ++i) {
+      formats[i] = FMT_iopcode;
+      kinds[i] = OpcodeKind::UNUSED;
+    }
 #define OP(op, code, fmt, ...) \
-  case code:                   \
-    return FMT_##fmt;
+  formats[code] = FMT_##fmt;   \
+  kinds[code] = OpcodeKind::DEX;
     DOPS
 #undef OP
-  case FOPCODE_PACKED_SWITCH : return FMT_fopcode;
-  case FOPCODE_SPARSE_SWITCH:
-    return FMT_fopcode;
-  case FOPCODE_FILLED_ARRAY:
-    return FMT_fopcode;
-#define OP(op, code, fmt, ...) \
-  case code:                   \
-    always_assert_log(false, "Unexpected quick opcode 0x%x", opcode);
-    break;
+#define OP(op, code, fmt, ...) kinds[code] = OpcodeKind::QUICK;
     QDOPS
 #undef OP
   }
+};
+
+constexpr OpcodeFormatTable kOpcodeFormats;
+
+// What the register operands of each format look like. The formats that
+// Redex doesn't implement have the `implemented` bit unset.
+struct FormatTraits {
+  bool implemented;
+  bool has_dest;
+  bit_width_t dest_width;
+  uint8_t min_srcs;
+  // The number of source registers that can be encoded, and their width.
+  uint8_t max_srcs;
+  bit_width_t src_width;
+};
+
+// clang-format off
+constexpr FormatTraits kFormatTraits[] = {
+  // implemented, has_dest, dest_width, min_srcs, max_srcs, src_width
+  {true,  false, 0,  0, 0, 0 }, /* FMT_f00x    */
+  {true,  false, 0,  0, 0, 0 }, /* FMT_f10x    */
+  {true,  true,  4,  1, 1, 4 }, /* FMT_f12x    */
+  {true,  true,  4,  2, 2, 4 }, /* FMT_f12x_2  */
+  {true,  true,  4,  0, 0, 0 }, /* FMT_f11n    */
+  {true,  true,  8,  0, 0, 0 }, /* FMT_f11x_d  */
+  {true,  false, 0,  1, 1, 8 }, /* FMT_f11x_s  */
+  {true,  false, 0,  0, 0, 0 }, /* FMT_f10t    */
+  {true,  false, 0,  0, 0, 0 }, /* FMT_f20t    */
+  {false, false, 0,  0, 0, 0 }, /* FMT_f20bc   */
+  {true,  true,  8,  1, 1, 16}, /* FMT_f22x    */
+  {true,  false, 0,  1, 1, 8 }, /* FMT_f21t    */
+  {true,  true,  8,  0, 0, 0 }, /* FMT_f21s    */
+  {true,  true,  8,  0, 0, 0 }, /* FMT_f21h    */
+  {true,  true,  8,  0, 0, 0 }, /* FMT_f21c_d  */
+  {true,  false, 0,  1, 1, 8 }, /* FMT_f21c_s  */
+  {true,  true,  8,  2, 2, 8 }, /* FMT_f23x_d  */
+  {true,  false, 0,  3, 3, 8 }, /* FMT_f23x_s  */
+  {true,  true,  8,  1, 1, 8 }, /* FMT_f22b    */
+  {true,  false, 0,  2, 2, 4 }, /* FMT_f22t    */
+  {true,  true,  4,  1, 1, 4 }, /* FMT_f22s    */
+  {true,  true,  4,  1, 1, 4 }, /* FMT_f22c_d  */
+  {true,  false, 0,  2, 2, 4 }, /* FMT_f22c_s  */
+  {false, false, 0,  0, 0, 0 }, /* FMT_f22cs   */
+  {true,  false, 0,  0, 0, 0 }, /* FMT_f30t    */
+  {true,  true,  16, 1, 1, 16}, /* FMT_f32x    */
+  {true,  true,  8,  0, 0, 0 }, /* FMT_f31i    */
+  {true,  false, 0,  1, 1, 8 }, /* FMT_f31t    */
+  {true,  true,  8,  0, 0, 0 }, /* FMT_f31c    */
+  {true,  false, 0,  0, 5, 4 }, /* FMT_f35c    */
+  {false, false, 0,  0, 0, 0 }, /* FMT_f35ms   */
+  {false, false, 0,  0, 0, 0 }, /* FMT_f35mi   */
+  {true,  false, 0,  0, 1, 16}, /* FMT_f3rc    */
+  {false, false, 0,  0, 0, 0 }, /* FMT_f3rms   */
+  {false, false, 0,  0, 0, 0 }, /* FMT_f3rmi   */
+  {true,  true,  8,  0, 0, 0 }, /* FMT_f51l    */
+  {true,  true,  16, 0, 0, 0 }, /* FMT_f41c_d  */
+  {true,  false, 0,  1, 1, 16}, /* FMT_f41c_s  */
+  {true,  false, 0,  0, 5, 4 }, /* FMT_f45cc   */
+  {true,  false, 0,  0, 1, 16}, /* FMT_f4rcc   */
+  {true,  true,  16, 1, 1, 16}, /* FMT_f52c_d  */
+  {true,  false, 0,  2, 2, 16}, /* FMT_f52c_s  */
+  {true,  false, 0,  0, 1, 16}, /* FMT_f5rc    */
+  {true,  false, 0,  0, 7, 4 }, /* FMT_f57c    */
+  {true,  false, 0,  0, 0, 0 }, /* FMT_fopcode */
+  {true,  true,  16, 0, 0, 0 }, /* FMT_iopcode */
+};
+// clang-format on
+
+static_assert(sizeof(kFormatTraits) / sizeof(kFormatTraits[0]) ==
+                  FMT_iopcode + 1,
+              "Missing format traits");
+
+const FormatTraits& traits(DexOpcode op) {
+  return kFormatTraits[dex_opcode::format(op)];
+}
+
+} // namespace
+
+OpcodeFormat format(DexOpcode opcode) {
+  if (opcode < 256) {
+    auto fmt = kOpcodeFormats.formats[opcode];
+    if (kOpcodeFormats.kinds[opcode] == OpcodeKind::DEX) {
+      return fmt;
+    }
+    always_assert_log(kOpcodeFormats.kinds[opcode] != OpcodeKind::QUICK,
+                      "Unexpected quick opcode 0x%x", opcode);
+  } else if (is_fopcode(opcode)) {
+    return FMT_fopcode;
+  }
   always_assert_log(false, "Unexpected opcode 0x%x", opcode);
 }
-// clang-format on
 
 bool dest_is_src(DexOpcode op) { return format(op) == FMT_f12x_2; }
 
@@ -176,324 +267,27 @@ DexOpcode invert_conditional_branch(DexOpcode op) {
 }
 
 bit_width_t src_bit_width(DexOpcode op, uint16_t i) {
-  switch (dex_opcode::format(op)) {
-  case FMT_f00x:
-    redex_assert(false);
-  case FMT_f10x:
-    redex_assert(false);
-  case FMT_f12x:
-    redex_assert(i == 0);
-    return 4;
-  case FMT_f12x_2:
-    redex_assert(i <= 1);
-    return 4;
-  case FMT_f11n:
-    redex_assert(false);
-  case FMT_f11x_d:
-    redex_assert(false);
-  case FMT_f11x_s:
-    redex_assert(i == 0);
-    return 8;
-  case FMT_f10t:
-    redex_assert(false);
-  case FMT_f20t:
-    redex_assert(false);
-  case FMT_f20bc:
-    redex_assert(false);
-  case FMT_f22x:
-    redex_assert(i == 0);
-    return 16;
-  case FMT_f21t:
-    redex_assert(i == 0);
-    return 8;
-  case FMT_f21s:
-    redex_assert(false);
-  case FMT_f21h:
-    redex_assert(false);
-  case FMT_f21c_d:
-    redex_assert(false);
-  case FMT_f21c_s:
-    redex_assert(i == 0);
-    return 8;
-  case FMT_f23x_d:
-    redex_assert(i <= 1);
-    return 8;
-  case FMT_f23x_s:
-    redex_assert(i <= 2);
-    return 8;
-  case FMT_f22b:
-    redex_assert(i == 0);
-    return 8;
-  case FMT_f22t:
-    redex_assert(i <= 1);
-    return 4;
-  case FMT_f22s:
-    redex_assert(i == 0);
-    return 4;
-  case FMT_f22c_d:
-    redex_assert(i == 0);
-    return 4;
-  case FMT_f22c_s:
-    redex_assert(i <= 1);
-    return 4;
-  case FMT_f22cs:
-    redex_assert(false);
-  case FMT_f30t:
-    redex_assert(false);
-  case FMT_f32x:
-    redex_assert(i == 0);
-    return 16;
-  case FMT_f31i:
-    redex_assert(false);
-  case FMT_f31t:
-    redex_assert(i == 0);
-    return 8;
-  case FMT_f31c:
-    redex_assert(false);
-  case FMT_f35c:
-    redex_assert(i <= 4);
-    return 4;
-  case FMT_f3rc:
-    redex_assert(i == 0);
-    return 16;
-  case FMT_f41c_d:
-    redex_assert(false);
-  case FMT_f41c_s:
-    redex_assert(i == 0);
-    return 16;
-  case FMT_f45cc:
-    redex_assert(i <= 4);
-    return 4;
-  case FMT_f4rcc:
-    redex_assert(i == 0);
-    return 16;
-  case FMT_f52c_d:
-    redex_assert(i == 0);
-    return 16;
-  case FMT_f52c_s:
-    redex_assert(i <= 1);
-    return 16;
-  case FMT_f5rc:
-    redex_assert(i == 0);
-    return 16;
-  case FMT_f57c:
-    redex_assert(i <= 6);
-    return 4;
-  case FMT_f35ms:
-  case FMT_f35mi:
-  case FMT_f3rms:
-  case FMT_f3rmi:
-  case FMT_f51l:
-  case FMT_fopcode:
-  case FMT_iopcode:
-    redex_assert(false);
-  }
-  not_reached();
+  const auto& t = traits(op);
+  redex_assert(i < t.max_srcs);
+  return t.src_width;
 }
 
 bit_width_t dest_bit_width(DexOpcode op) {
-  switch (dex_opcode::format(op)) {
-  case FMT_f00x:
-    redex_assert(false);
-  case FMT_f10x:
-    redex_assert(false);
-  case FMT_f12x:
-    return 4;
-  case FMT_f12x_2:
-    return 4;
-  case FMT_f11n:
-    return 4;
-  case FMT_f11x_d:
-    return 8;
-  case FMT_f11x_s:
-    redex_assert(false);
-  case FMT_f10t:
-    redex_assert(false);
-  case FMT_f20t:
-    redex_assert(false);
-  case FMT_f20bc:
-    redex_assert(false);
-  case FMT_f22x:
-    return 8;
-  case FMT_f21t:
-    redex_assert(false);
-  case FMT_f21s:
-    return 8;
-  case FMT_f21h:
-    return 8;
-  case FMT_f21c_d:
-    return 8;
-  case FMT_f21c_s:
-    redex_assert(false);
-  case FMT_f23x_d:
-    return 8;
-  case FMT_f23x_s:
-    redex_assert(false);
-  case FMT_f22b:
-    return 8;
-  case FMT_f22t:
-    redex_assert(false);
-  case FMT_f22s:
-    return 4;
-  case FMT_f22c_d:
-    return 4;
-  case FMT_f22c_s:
-    redex_assert(false);
-  case FMT_f22cs:
-    redex_assert(false);
-  case FMT_f30t:
-    redex_assert(false);
-  case FMT_f32x:
-    return 16;
-  case FMT_f31i:
-    return 8;
-  case FMT_f31t:
-    redex_assert(false);
-  case FMT_f31c:
-    return 8;
-  case FMT_f35c:
-    redex_assert(false);
-  case FMT_f35ms:
-  case FMT_f35mi:
-  case FMT_f3rc:
-  case FMT_f3rms:
-  case FMT_f3rmi:
-    redex_assert(false);
-  case FMT_f51l:
-    return 8;
-  case FMT_f41c_d:
-    return 16;
-  case FMT_f41c_s:
-  case FMT_f45cc:
-  case FMT_f4rcc:
-    redex_assert(false);
-  case FMT_f52c_d:
-    return 16;
-  case FMT_f52c_s:
-    redex_assert(false);
-  case FMT_f5rc:
-    redex_assert(false);
-  case FMT_f57c:
-    redex_assert(false);
-  case FMT_fopcode:
-    redex_assert(false);
-  case FMT_iopcode:
-    return 16;
-  }
-  not_reached();
+  const auto& t = traits(op);
+  redex_assert(t.has_dest);
+  return t.dest_width;
 }
 
 bool has_dest(DexOpcode op) {
-  switch (dex_opcode::format(op)) {
-  case FMT_f00x:
-  case FMT_f10x:
-  case FMT_f11x_s:
-  case FMT_f10t:
-  case FMT_f20t:
-  case FMT_f21t:
-  case FMT_f21c_s:
-  case FMT_f23x_s:
-  case FMT_f22t:
-  case FMT_f22c_s:
-  case FMT_f30t:
-  case FMT_f31t:
-  case FMT_f35c:
-  case FMT_f3rc:
-  case FMT_f41c_s:
-  case FMT_f45cc:
-  case FMT_f4rcc:
-  case FMT_f52c_s:
-  case FMT_f5rc:
-  case FMT_f57c:
-  case FMT_fopcode:
-    return false;
-  case FMT_f12x:
-  case FMT_f12x_2:
-  case FMT_f11n:
-  case FMT_f11x_d:
-  case FMT_f22x:
-  case FMT_f21s:
-  case FMT_f21h:
-  case FMT_f21c_d:
-  case FMT_f23x_d:
-  case FMT_f22b:
-  case FMT_f22s:
-  case FMT_f22c_d:
-  case FMT_f32x:
-  case FMT_f31i:
-  case FMT_f31c:
-  case FMT_f51l:
-  case FMT_f41c_d:
-  case FMT_f52c_d:
-  case FMT_iopcode:
-    return true;
-  case FMT_f20bc:
-  case FMT_f22cs:
-  case FMT_f35ms:
-  case FMT_f35mi:
-  case FMT_f3rms:
-  case FMT_f3rmi:
-    always_assert_log(false, "Unimplemented opcode `%s'", SHOW(op));
-  }
-  not_reached();
+  const auto& t = traits(op);
+  always_assert_log(t.implemented, "Unimplemented opcode `%s'", SHOW(op));
+  return t.has_dest;
 }
 
 unsigned min_srcs_size(DexOpcode op) {
-  switch (dex_opcode::format(op)) {
-  case FMT_f00x:
-  case FMT_f10x:
-  case FMT_f11n:
-  case FMT_f11x_d:
-  case FMT_f10t:
-  case FMT_f20t:
-  case FMT_f21s:
-  case FMT_f21h:
-  case FMT_f21c_d:
-  case FMT_f30t:
-  case FMT_f31i:
-  case FMT_f31c:
-  case FMT_f3rc:
-  case FMT_f51l:
-  case FMT_f5rc:
-  case FMT_f41c_d:
-  case FMT_f4rcc:
-  case FMT_fopcode:
-  case FMT_iopcode:
-    return 0;
-  case FMT_f12x:
-  case FMT_f11x_s:
-  case FMT_f22x:
-  case FMT_f21t:
-  case FMT_f21c_s:
-  case FMT_f22b:
-  case FMT_f22s:
-  case FMT_f22c_d:
-  case FMT_f32x:
-  case FMT_f31t:
-  case FMT_f41c_s:
-  case FMT_f52c_d:
-    return 1;
-  case FMT_f12x_2:
-  case FMT_f23x_d:
-  case FMT_f22t:
-  case FMT_f22c_s:
-  case FMT_f52c_s:
-    return 2;
-  case FMT_f23x_s:
-    return 3;
-  case FMT_f35c:
-  case FMT_f45cc:
-  case FMT_f57c:
-    return 0;
-  case FMT_f20bc:
-  case FMT_f22cs:
-  case FMT_f35ms:
-  case FMT_f35mi:
-  case FMT_f3rms:
-  case FMT_f3rmi:
-    always_assert_log(false, "Unimplemented opcode `%s'", SHOW(op));
-  }
-  not_reached();
+  const auto& t = traits(op);
+  always_assert_log(t.implemented, "Unimplemented opcode `%s'", SHOW(op));
+  return t.min_srcs;
 }
 
 } // namespace dex_opcode
@@ -7,6 +7,7 @@
 
 #include <algorithm>
 #include <assert.h>
+#include <cstdio>
 #include <exception>
 #include <fcntl.h>
 #include <fstream>
@@ -17,6 +18,9 @@
 #include <sys/stat.h>
 #include <unordered_set>
 
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/functional/hash.hpp>
+
 #ifdef _MSC_VER
 // TODO: Rewrite open/write/close with C/C++ standards. But it works for now.
 #include <io.h>
@@ -45,6 +49,7 @@
 #include "Trace.h"
 #include "Walkers.h"
 #include "WorkQueue.h"
+#include "locator_index.h"
 
 /*
  * For adler32...
@@ -84,6 +89,11 @@ class CustomSort {
   }
 };
 
+namespace {
+// Marks the end of a startup phase in the coldstart class list.
+constexpr const char* END_MARKER_PREFIX = "LDexEndMarker";
+} // namespace
+
 GatheredTypes::GatheredTypes(DexClasses* classes,
                              PostLowering const* post_lowering)
     : m_classes(classes) {
@@ -117,6 +127,55 @@ std::vector<DexString*> GatheredTypes::keep_cls_strings_together_emitlist() {
       CustomSort<DexString, cmp_dstring>(m_cls_strings, compare_dexstrings));
 }
 
+std::vector<DexString*> GatheredTypes::get_coldstart_phase_dexstring_emitlist(
+    const ColdStartLayout& layout) {
+  // Like the class load order, but one phase after another, and within each
+  // phase, strings of methods that ran more often first.
+  std::vector<std::vector<DexClass*>> phase_classes(layout.num_phases + 1);
+  for (auto cls : *m_classes) {
+    phase_classes[layout.get_phase(cls)].push_back(cls);
+  }
+  std::unordered_map<const DexString*, unsigned int> string_order;
+  auto add_strings = [&](const std::vector<DexString*>& strings) {
+    for (auto s : strings) {
+      auto index = string_order.size();
+      string_order.emplace(s, index);
+    }
+  };
+  for (const auto& classes : phase_classes) {
+    std::vector<DexMethod*> methods;
+    for (auto cls : classes) {
+      std::vector<DexType*> cls_types;
+      cls->gather_types(cls_types);
+      for (auto t : cls_types) {
+        add_strings({t->get_name()});
+      }
+      for (auto m : cls->get_dmethods()) {
+        if (method::is_clinit(m)) {
+          std::vector<DexString*> method_strings;
+          m->gather_strings(method_strings);
+          add_strings(method_strings);
+        }
+      }
+      methods.insert(methods.end(), cls->get_dmethods().begin(),
+                     cls->get_dmethods().end());
+      methods.insert(methods.end(), cls->get_vmethods().begin(),
+                     cls->get_vmethods().end());
+    }
+    std::stable_sort(methods.begin(), methods.end(),
+                     [&layout](const DexMethod* a, const DexMethod* b) {
+                       return layout.get_bucket(a) < layout.get_bucket(b);
+                     });
+    for (auto m : methods) {
+      std::vector<DexString*> method_strings;
+      m->gather_strings(method_strings);
+      add_strings(method_strings);
+    }
+  }
+  return get_dexstring_emitlist(
+      CustomSort<DexString, cmp_dstring>(string_order, compare_dexstrings));
+}
+
 std::vector<DexMethodHandle*> GatheredTypes::get_dexmethodhandle_emitlist() {
   return m_lmethodhandle;
 }
@@ -159,14 +218,18 @@ void GatheredTypes::sort_dexmethod_emitlist_cls_order(
 
 void GatheredTypes::sort_dexmethod_emitlist_profiled_order(
     std::vector<DexMethod*>& lmeth) {
+  static const std::unordered_map<std::string, unsigned int> no_weights;
+  static const std::unordered_set<std::string> no_substrings;
   std::unordered_map<DexMethod*, unsigned int> cache;
   cache.reserve(lmeth.size());
-  std::stable_sort(
-      lmeth.begin(),
-      lmeth.end(),
-      dexmethods_profiled_comparator(&m_method_to_weight,
-                                     &m_method_sorting_whitelisted_substrings,
-                                     &cache));
+  std::stable_sort(lmeth.begin(),
+                   lmeth.end(),
+                   dexmethods_profiled_comparator(
+                       m_method_to_weight ? m_method_to_weight : &no_weights,
+                       m_method_sorting_whitelisted_substrings
+                           ? m_method_sorting_whitelisted_substrings
+                           : &no_substrings,
+                       &cache));
 }
 
 void GatheredTypes::sort_dexmethod_emitlist_clinit_order(
@@ -181,6 +244,107 @@ void GatheredTypes::sort_dexmethod_emitlist_clinit_order(
                    });
 }
 
+void GatheredTypes::sort_dexmethod_emitlist_coldstart_phase_order(
+    std::vector<DexMethod*>& lmeth, const ColdStartLayout& layout) {
+  std::vector<std::pair<uint64_t, DexMethod*>> keyed;
+  keyed.reserve(lmeth.size());
+  for (auto m : lmeth) {
+    uint64_t phase = layout.get_phase(type_class(m->get_class()));
+    keyed.emplace_back(phase << 32 | layout.get_bucket(m), m);
+  }
+  std::stable_sort(keyed.begin(), keyed.end(),
+                   [](const std::pair<uint64_t, DexMethod*>& a,
+                      const std::pair<uint64_t, DexMethod*>& b) {
+                     return a.first < b.first;
+                   });
+  for (size_t i = 0; i < keyed.size(); ++i) {
+    lmeth[i] = keyed[i].second;
+  }
+}
+
+void GatheredTypes::sort_dexmethod_emitlist_interaction_order(
+    std::vector<DexMethod*>& lmeth,
+    const method_profiles::MethodProfiles& profiles,
+    const std::vector<std::string>& interactions) {
+  std::vector<const method_profiles::StatsMap*> interaction_stats;
+  for (const auto& interaction : interactions) {
+    interaction_stats.push_back(&profiles.method_stats(interaction));
+  }
+  std::unordered_map<const DexMethod*, std::pair<size_t, double>> keys;
+  keys.reserve(lmeth.size());
+  for (auto m : lmeth) {
+    auto& key = keys[m];
+    key = {interactions.size(), 0.0};
+    for (size_t i = 0; i < interaction_stats.size(); ++i) {
+      auto it = interaction_stats[i]->find(m);
+      if (it != interaction_stats[i]->end() &&
+          it->second.appear_percent > 0) {
+        key = {i, it->second.order_percent};
+        break;
+      }
+    }
+  }
+  std::stable_sort(lmeth.begin(), lmeth.end(),
+                   [&keys](const DexMethod* a, const DexMethod* b) {
+                     return keys.at(a) < keys.at(b);
+                   });
+}
+
+ColdStartLayout::ColdStartLayout(const DexClasses& classes,
+                                 const ConfigFiles& conf,
+                                 bool use_method_profiles)
+    : use_method_profiles(use_method_profiles) {
+  std::unordered_set<const DexClass*> dex_classes(classes.begin(),
+                                                  classes.end());
+  for (const auto& name : conf.get_coldstart_classes()) {
+    if (boost::algorithm::starts_with(name, END_MARKER_PREFIX)) {
+      ++num_phases;
+      continue;
+    }
+    auto type = DexType::get_type(name.c_str());
+    auto cls = type == nullptr ? nullptr : type_class(type);
+    if (cls != nullptr && dex_classes.count(cls)) {
+      class_phases.emplace(cls, num_phases);
+    }
+  }
+  // Classes after the last end marker are in a phase of their own.
+  if (!conf.get_coldstart_classes().empty() &&
+      !boost::algorithm::starts_with(conf.get_coldstart_classes().back(),
+                                     END_MARKER_PREFIX)) {
+    ++num_phases;
+  }
+
+  if (!use_method_profiles) {
+    return;
+  }
+  const auto& stats =
+      conf.get_method_profiles().method_stats(method_profiles::COLD_START);
+  for (const auto& p : class_phases) {
+    for (auto methods : {&p.first->get_dmethods(), &p.first->get_vmethods()}) {
+      for (auto m : *methods) {
+        auto it = stats.find(m);
+        if (it == stats.end() || it->second.appear_percent <= 0) {
+          continue;
+        }
+        double appear = std::min(it->second.appear_percent, 100.0);
+        method_buckets.emplace(
+            m, std::min<uint32_t>(kUnprofiledBucket - 1,
+                                  (uint32_t)((100.0 - appear) / 10)));
+      }
+    }
+  }
+}
+
+uint32_t ColdStartLayout::get_phase(const DexClass* cls) const {
+  auto it = class_phases.find(cls);
+  return it == class_phases.end() ? num_phases : it->second;
+}
+
+uint32_t ColdStartLayout::get_bucket(const DexMethodRef* method) const {
+  auto it = method_buckets.find(method);
+  return it == method_buckets.end() ? kUnprofiledBucket : it->second;
+}
+
 DexOutputIdx* GatheredTypes::get_dodx(const uint8_t* base) {
   /*
    * These are symbol table indices.  Symbols which are used
@@ -205,8 +369,9 @@ DexOutputIdx* GatheredTypes::get_dodx(const uint8_t* base) {
 }
 
 dexstring_to_idx* GatheredTypes::get_string_index(cmp_dstring cmp) {
-  std::sort(m_lstring.begin(), m_lstring.end(), cmp);
+  redex_parallel::sort(m_lstring.begin(), m_lstring.end(), cmp);
   dexstring_to_idx* sidx = new dexstring_to_idx();
+  sidx->reserve(m_lstring.size());
   uint32_t idx = 0;
   for (auto it = m_lstring.begin(); it != m_lstring.end(); it++) {
     sidx->insert(std::make_pair(*it, idx++));
@@ -215,8 +380,9 @@ dexstring_to_idx* GatheredTypes::get_string_index(cmp_dstring cmp) {
 }
 
 dextype_to_idx* GatheredTypes::get_type_index(cmp_dtype cmp) {
-  std::sort(m_ltype.begin(), m_ltype.end(), cmp);
+  redex_parallel::sort(m_ltype.begin(), m_ltype.end(), cmp);
   dextype_to_idx* sidx = new dextype_to_idx();
+  sidx->reserve(m_ltype.size());
   uint32_t idx = 0;
   for (auto it = m_ltype.begin(); it != m_ltype.end(); it++) {
     sidx->insert(std::make_pair(*it, idx++));
@@ -426,6 +592,10 @@ constexpr const char* METHOD_MAPPING = "redex-method-id-map.txt";
 constexpr const char* CLASS_MAPPING = "redex-class-id-map.txt";
 constexpr const char* BYTECODE_OFFSET_MAPPING = "redex-bytecode-offset-map.txt";
 constexpr const char* REDEX_PG_MAPPING = "redex-class-rename-map.txt";
+constexpr const char* COLDSTART_PAGE_ESTIMATES =
+    "redex-coldstart-page-estimates.txt";
+constexpr const char* INTERACTION_PAGE_ESTIMATES =
+    "redex-interaction-page-estimates.txt";
 } // namespace
 
 DexOutput::DexOutput(
@@ -465,6 +635,16 @@ DexOutput::DexOutput(
   m_class_mapping_filename = config_files.metafile(CLASS_MAPPING);
   m_pg_mapping_filename = config_files.metafile(REDEX_PG_MAPPING);
   m_bytecode_offset_filename = config_files.metafile(BYTECODE_OFFSET_MAPPING);
+  if (config_files.get_json_config().get("emit_coldstart_page_estimates",
+                                         false)) {
+    m_coldstart_page_estimates_filename =
+        config_files.metafile(COLDSTART_PAGE_ESTIMATES);
+  }
+  if (config_files.get_json_config().get("emit_interaction_page_estimates",
+                                         false)) {
+    m_interaction_page_estimates_filename =
+        config_files.metafile(INTERACTION_PAGE_ESTIMATES);
+  }
   m_store_number = store_number;
   m_dex_number = dex_number;
   m_locator_index = locator_index;
@@ -643,6 +823,10 @@ void DexOutput::generate_string_data(SortMode mode) {
   } else if (mode == SortMode::CLASS_STRINGS) {
     TRACE(CUSTOMSORT, 2, "using class names pack for string pool sorting");
     string_order = m_gtypes->keep_cls_strings_together_emitlist();
+  } else if (mode == SortMode::COLDSTART_PHASE_ORDER) {
+    TRACE(CUSTOMSORT, 2, "using coldstart phase order for string pool sorting");
+    string_order =
+        m_gtypes->get_coldstart_phase_dexstring_emitlist(*m_coldstart_layout);
   } else {
     TRACE(CUSTOMSORT, 2, "using default string pool sorting");
     string_order = m_gtypes->get_dexstring_emitlist();
@@ -894,12 +1078,14 @@ void DexOutput::generate_class_data_items() {
   }
   dex_class_def* cdefs = (dex_class_def*)(m_output + hdr.class_defs_off);
   uint32_t count = 0;
+  m_class_data_ranges.assign(hdr.class_defs_size, {0, 0});
   for (uint32_t i = 0; i < hdr.class_defs_size; i++) {
     DexClass* clz = m_classes->at(i);
     if (!clz->has_class_data()) continue;
     /* No alignment constraints for this data */
     int size = clz->encode(dodx, dco, m_output + m_offset);
     cdefs[i].class_data_offset = m_offset;
+    m_class_data_ranges[i] = {m_offset, size};
     m_offset += size;
     count += 1;
   }
@@ -909,19 +1095,80 @@ void DexOutput::generate_class_data_items() {
 static void sync_all(const Scope& scope) {
   constexpr bool serial = false; // for debugging
   auto wq = workqueue_foreach<DexMethod*>([](DexMethod* m) { m->sync(); });
-  walk::code(scope,
-             [](DexMethod*) { return true; },
-             [&](DexMethod* m, IRCode&) {
-               if (serial) {
-                 TRACE(MTRANS, 2, "Syncing %s", SHOW(m));
-                 m->sync();
-               } else {
-                 wq.add_item(m);
-               }
-             });
+  // Methods whose ballooning is still pending are synced too, which keeps their
+  // original DexCode without ever building IRCode for them.
+  walk::methods(scope, [&](DexMethod* m) {
+    if (!m->is_balloon_pending() && m->get_code() == nullptr) {
+      return;
+    }
+    if (serial) {
+      TRACE(MTRANS, 2, "Syncing %s", SHOW(m));
+      m->sync();
+    } else {
+      wq.add_item(m);
+    }
+  });
+  wq.run_all();
+}
+
+namespace {
+
+/*
+ * Encode items 0 ... n - 1 in parallel. `encode(i, scratch)` writes item i into
+ * the calling worker's scratch buffer, growing it as needed, and returns the
+ * number of bytes written. The encoded items are returned in order, so that
+ * callers can lay them out deterministically.
+ */
+template <typename EncodeFn>
+std::vector<std::vector<uint8_t>> encode_in_parallel(size_t n,
+                                                     const EncodeFn& encode) {
+  size_t num_threads = redex_parallel::default_num_threads();
+  std::vector<std::vector<uint32_t>> scratch(num_threads);
+  std::vector<std::vector<uint8_t>> items(n);
+  auto wq = workqueue_foreach<size_t>(
+      [&](sparta::SpartaWorkerState<size_t>* state, size_t i) {
+        auto& buffer = scratch.at(state->worker_id());
+        size_t size = encode(i, buffer);
+        always_assert(size <= buffer.size() * sizeof(uint32_t));
+        auto* begin = reinterpret_cast<const uint8_t*>(buffer.data());
+        items[i].assign(begin, begin + size);
+      },
+      num_threads);
+  for (size_t i = 0; i < n; ++i) {
+    wq.add_item(i);
+  }
   wq.run_all();
+  return items;
+}
+
+// Grow `buffer` to hold at least `size` bytes.
+void reserve_scratch(std::vector<uint32_t>& buffer, size_t size) {
+  size_t words = (size + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+  if (buffer.size() < words) {
+    buffer.resize(words);
+  }
+}
+
+// An upper bound on the number of bytes DexCode::encode will write.
+size_t code_item_size_bound(const DexCode* code) {
+  // One extra code unit pads the instructions before the tries.
+  size_t size = sizeof(dex_code_item) + (code->size() + 1) * sizeof(uint16_t);
+  const auto& tries = code->get_tries();
+  if (tries.empty()) {
+    return size;
+  }
+  // A uleb128 takes at most 5 bytes. There is one for the handler count, and
+  // each handler has its size, a type and an address per catch, and a
+  // catch-all address.
+  size += 5;
+  for (const auto& dextry : tries) {
+    size += sizeof(dex_tries_item) + 2 * 5 + dextry->m_catches.size() * 2 * 5;
+  }
+  return size;
 }
 
+} // namespace
+
 void DexOutput::generate_code_items(const std::vector<SortMode>& mode) {
   TRACE(MAIN, 2, "generate_code_items");
   /*
@@ -952,6 +1199,17 @@ void DexOutput::generate_code_items(const std::vector<SortMode>& mode) {
             "sorting <clinit> sections before all other bytecode");
       m_gtypes->sort_dexmethod_emitlist_clinit_order(lmeth);
       break;
+    case SortMode::METHOD_INTERACTION_ORDER:
+      TRACE(CUSTOMSORT, 2,
+            "using method interaction order for bytecode sorting");
+      m_gtypes->sort_dexmethod_emitlist_interaction_order(
+          lmeth, m_config_files.get_method_profiles(), m_profile_interactions);
+      break;
+    case SortMode::COLDSTART_PHASE_ORDER:
+      TRACE(CUSTOMSORT, 2, "using coldstart phase order for bytecode sorting");
+      m_gtypes->sort_dexmethod_emitlist_coldstart_phase_order(
+          lmeth, *m_coldstart_layout);
+      break;
 
     case SortMode::CLASS_STRINGS:
       TRACE(CUSTOMSORT, 2,
@@ -963,20 +1221,37 @@ void DexOutput::generate_code_items(const std::vector<SortMode>& mode) {
       break;
     }
   }
+  std::vector<DexMethod*> emit_methods;
   for (DexMethod* meth : lmeth) {
     if (meth->get_access() & (ACC_ABSTRACT | ACC_NATIVE)) {
       // There is no code item for ABSTRACT or NATIVE methods.
       continue;
     }
-    TRACE(CUSTOMSORT, 3, "method emit %s %s", SHOW(meth->get_class()),
-          SHOW(meth));
-    DexCode* code = meth->get_dex_code();
     always_assert_log(
-        meth->is_concrete() && code != nullptr,
+        meth->is_concrete() && meth->get_dex_code() != nullptr,
         "Undefined method in generate_code_items()\n\t prototype: %s\n",
         SHOW(meth));
+    emit_methods.push_back(meth);
+  }
+
+  // Code items don't depend on where they end up, so they are encoded in
+  // parallel and then copied into place in emit order.
+  auto encoded = encode_in_parallel(
+      emit_methods.size(), [&](size_t i, std::vector<uint32_t>& scratch) {
+        DexCode* code = emit_methods[i]->get_dex_code();
+        reserve_scratch(scratch, code_item_size_bound(code));
+        return code->encode(dodx, scratch.data());
+      });
+
+  for (size_t i = 0; i < emit_methods.size(); ++i) {
+    DexMethod* meth = emit_methods[i];
+    TRACE(CUSTOMSORT, 3, "method emit %s %s", SHOW(meth->get_class()),
+          SHOW(meth));
+    DexCode* code = meth->get_dex_code();
     align_output();
-    int size = code->encode(dodx, (uint32_t*)(m_output + m_offset));
+    int size = encoded[i].size();
+    memcpy(m_output + m_offset, encoded[i].data(), size);
+    std::vector<uint8_t>().swap(encoded[i]);
     check_method_instruction_size_limit(m_config_files, size, SHOW(meth));
     m_method_bytecode_offsets.emplace_back(meth->get_name()->c_str(), m_offset);
     m_code_item_emits.emplace_back(meth, code,
@@ -1102,28 +1377,93 @@ static bool annotation_cmp(const DexAnnotationDirectory* a,
   return (a->viz_score() < b->viz_score());
 }
 
-void DexOutput::unique_annotations(annomap_t& annomap,
-                                   std::vector<DexAnnotation*>& annolist) {
-  int annocnt = 0;
-  uint32_t mentry_offset = m_offset;
-  std::map<std::vector<uint8_t>, uint32_t> annotation_byte_offsets;
-  for (auto anno : annolist) {
-    if (annomap.count(anno)) continue;
-    std::vector<uint8_t> annotation_bytes;
-    anno->vencode(dodx, annotation_bytes);
-    if (annotation_byte_offsets.count(annotation_bytes)) {
-      annomap[anno] = annotation_byte_offsets[annotation_bytes];
+namespace {
+
+// The encoding of an annotation item, with the hash of its content computed
+// once so that deduplicating doesn't rehash or compare it more than needed.
+template <typename T>
+struct EncodedItem {
+  std::vector<T> data;
+  size_t hash{0};
+};
+
+struct EncodedItemHash {
+  template <typename T>
+  size_t operator()(const EncodedItem<T>* item) const {
+    return item->hash;
+  }
+};
+
+struct EncodedItemEqual {
+  template <typename T>
+  bool operator()(const EncodedItem<T>* a, const EncodedItem<T>* b) const {
+    return a->hash == b->hash && a->data == b->data;
+  }
+};
+
+/*
+ * Encodes the distinct items of `items` in parallel, then writes each
+ * distinct encoding once, in the order of `items`, at `*offset` and records
+ * the offset of every item in `offsets`. `encode` is called concurrently, so
+ * it may only read shared state. Returns the number of encodings written.
+ */
+template <typename T, typename Item, typename Encode>
+int emit_unique_items(const std::vector<Item*>& items,
+                      const Encode& encode,
+                      std::unordered_map<Item*, uint32_t>* offsets,
+                      uint8_t* output,
+                      uint32_t* offset) {
+  std::vector<Item*> distinct;
+  distinct.reserve(items.size());
+  for (auto item : items) {
+    if (offsets->emplace(item, 0).second) {
+      distinct.push_back(item);
+    }
+  }
+
+  std::vector<EncodedItem<T>> encoded(distinct.size());
+  auto wq = workqueue_foreach<size_t>([&](size_t i) {
+    auto& enc = encoded[i];
+    encode(distinct[i], enc.data);
+    enc.hash = boost::hash_range(enc.data.begin(), enc.data.end());
+  });
+  for (size_t i = 0; i < distinct.size(); i++) {
+    wq.add_item(i);
+  }
+  wq.run_all();
+
+  std::unordered_map<const EncodedItem<T>*, uint32_t, EncodedItemHash,
+                     EncodedItemEqual>
+      unique_offsets;
+  unique_offsets.reserve(encoded.size());
+  int count = 0;
+  for (size_t i = 0; i < distinct.size(); i++) {
+    const auto& enc = encoded[i];
+    auto inserted = unique_offsets.emplace(&enc, *offset);
+    (*offsets)[distinct[i]] = inserted.first->second;
+    if (!inserted.second) {
       continue;
     }
-    /* Insert new annotation in tracking structs */
-    annotation_byte_offsets[annotation_bytes] = m_offset;
-    annomap[anno] = m_offset;
     /* Not a dupe, encode... */
-    uint8_t* annoout = (uint8_t*)(m_output + m_offset);
-    memcpy(annoout, &annotation_bytes[0], annotation_bytes.size());
-    m_offset += annotation_bytes.size();
-    annocnt++;
+    auto size = enc.data.size() * sizeof(T);
+    memcpy(output + *offset, enc.data.data(), size);
+    *offset += size;
+    count++;
   }
+  return count;
+}
+
+} // namespace
+
+void DexOutput::unique_annotations(annomap_t& annomap,
+                                   std::vector<DexAnnotation*>& annolist) {
+  uint32_t mentry_offset = m_offset;
+  int annocnt = emit_unique_items<uint8_t>(
+      annolist,
+      [&](DexAnnotation* anno, std::vector<uint8_t>& annotation_bytes) {
+        anno->vencode(dodx, annotation_bytes);
+      },
+      &annomap, m_output, &m_offset);
   if (annocnt) {
     insert_map_item(TYPE_ANNOTATION_ITEM, annocnt, mentry_offset,
                     m_offset - mentry_offset);
@@ -1134,26 +1474,13 @@ void DexOutput::unique_annotations(annomap_t& annomap,
 void DexOutput::unique_asets(annomap_t& annomap,
                              asetmap_t& asetmap,
                              std::vector<DexAnnotationSet*>& asetlist) {
-  int asetcnt = 0;
   uint32_t mentry_offset = m_offset;
-  std::map<std::vector<uint32_t>, uint32_t> aset_offsets;
-  for (auto aset : asetlist) {
-    if (asetmap.count(aset)) continue;
-    std::vector<uint32_t> aset_bytes;
-    aset->vencode(dodx, aset_bytes, annomap);
-    if (aset_offsets.count(aset_bytes)) {
-      asetmap[aset] = aset_offsets[aset_bytes];
-      continue;
-    }
-    /* Insert new aset in tracking structs */
-    aset_offsets[aset_bytes] = m_offset;
-    asetmap[aset] = m_offset;
-    /* Not a dupe, encode... */
-    uint8_t* asetout = (uint8_t*)(m_output + m_offset);
-    memcpy(asetout, &aset_bytes[0], aset_bytes.size() * sizeof(uint32_t));
-    m_offset += aset_bytes.size() * sizeof(uint32_t);
-    asetcnt++;
-  }
+  int asetcnt = emit_unique_items<uint32_t>(
+      asetlist,
+      [&](DexAnnotationSet* aset, std::vector<uint32_t>& aset_bytes) {
+        aset->vencode(dodx, aset_bytes, annomap);
+      },
+      &asetmap, m_output, &m_offset);
   if (asetcnt) {
     insert_map_item(TYPE_ANNOTATION_SET_ITEM, asetcnt, mentry_offset,
                     m_offset - mentry_offset);
@@ -1163,32 +1490,19 @@ void DexOutput::unique_asets(annomap_t& annomap,
 void DexOutput::unique_xrefs(asetmap_t& asetmap,
                              xrefmap_t& xrefmap,
                              std::vector<ParamAnnotations*>& xreflist) {
-  int xrefcnt = 0;
   uint32_t mentry_offset = m_offset;
-  std::map<std::vector<uint32_t>, uint32_t> xref_offsets;
-  for (auto xref : xreflist) {
-    if (xrefmap.count(xref)) continue;
-    std::vector<uint32_t> xref_bytes;
-    xref_bytes.push_back((unsigned int)xref->size());
-    for (auto param : *xref) {
-      DexAnnotationSet* das = param.second;
-      always_assert_log(asetmap.count(das) != 0, "Uninitialized aset %p '%s'",
-                        das, SHOW(das));
-      xref_bytes.push_back(asetmap[das]);
-    }
-    if (xref_offsets.count(xref_bytes)) {
-      xrefmap[xref] = xref_offsets[xref_bytes];
-      continue;
-    }
-    /* Insert new xref in tracking structs */
-    xref_offsets[xref_bytes] = m_offset;
-    xrefmap[xref] = m_offset;
-    /* Not a dupe, encode... */
-    uint8_t* xrefout = (uint8_t*)(m_output + m_offset);
-    memcpy(xrefout, &xref_bytes[0], xref_bytes.size() * sizeof(uint32_t));
-    m_offset += xref_bytes.size() * sizeof(uint32_t);
-    xrefcnt++;
-  }
+  int xrefcnt = emit_unique_items<uint32_t>(
+      xreflist,
+      [&](ParamAnnotations* xref, std::vector<uint32_t>& xref_bytes) {
+        xref_bytes.push_back((unsigned int)xref->size());
+        for (auto param : *xref) {
+          DexAnnotationSet* das = param.second;
+          always_assert_log(asetmap.count(das) != 0,
+                            "Uninitialized aset %p '%s'", das, SHOW(das));
+          xref_bytes.push_back(asetmap.at(das));
+        }
+      },
+      &xrefmap, m_output, &m_offset);
   if (xrefcnt) {
     insert_map_item(TYPE_ANNOTATION_SET_REF_LIST, xrefcnt, mentry_offset,
                     m_offset - mentry_offset);
@@ -1199,26 +1513,13 @@ void DexOutput::unique_adirs(asetmap_t& asetmap,
                              xrefmap_t& xrefmap,
                              adirmap_t& adirmap,
                              std::vector<DexAnnotationDirectory*>& adirlist) {
-  int adircnt = 0;
   uint32_t mentry_offset = m_offset;
-  std::map<std::vector<uint32_t>, uint32_t> adir_offsets;
-  for (auto adir : adirlist) {
-    if (adirmap.count(adir)) continue;
-    std::vector<uint32_t> adir_bytes;
-    adir->vencode(dodx, adir_bytes, xrefmap, asetmap);
-    if (adir_offsets.count(adir_bytes)) {
-      adirmap[adir] = adir_offsets[adir_bytes];
-      continue;
-    }
-    /* Insert new adir in tracking structs */
-    adir_offsets[adir_bytes] = m_offset;
-    adirmap[adir] = m_offset;
-    /* Not a dupe, encode... */
-    uint8_t* adirout = (uint8_t*)(m_output + m_offset);
-    memcpy(adirout, &adir_bytes[0], adir_bytes.size() * sizeof(uint32_t));
-    m_offset += adir_bytes.size() * sizeof(uint32_t);
-    adircnt++;
-  }
+  int adircnt = emit_unique_items<uint32_t>(
+      adirlist,
+      [&](DexAnnotationDirectory* adir, std::vector<uint32_t>& adir_bytes) {
+        adir->vencode(dodx, adir_bytes, xrefmap, asetmap);
+      },
+      &adirmap, m_output, &m_offset);
   if (adircnt) {
     insert_map_item(TYPE_ANNOTATIONS_DIR_ITEM, adircnt, mentry_offset,
                     m_offset - mentry_offset);
@@ -1319,23 +1620,12 @@ int emit_debug_info_for_metadata(DexOutputIdx* dodx,
   return size;
 }
 
-int emit_debug_info(
-    DexOutputIdx* dodx,
-    bool emit_positions,
-    DexDebugItem* dbg,
-    DexCode* dc,
-    dex_code_item* dci,
-    PositionMapper* pos_mapper,
-    uint8_t* output,
-    uint32_t offset,
-    uint32_t num_params,
-    std::unordered_map<DexCode*, std::vector<DebugLineItem>>* dbg_lines) {
-  // No align requirement for debug items.
-  DebugMetadata metadata =
-      calculate_debug_metadata(dbg, dc, dci, pos_mapper, num_params, dbg_lines);
-  return emit_positions
-             ? emit_debug_info_for_metadata(dodx, metadata, output, offset)
-             : 0;
+// An upper bound on the number of bytes emit_debug_info_for_metadata will
+// write. A uleb128 takes at most 5 bytes, and no debug opcode needs more than
+// four of them.
+size_t debug_info_size_bound(const DebugMetadata& metadata) {
+  return 5 * (2 + metadata.num_params) + (1 + 4 * 5) * metadata.dbgops.size() +
+         1;
 }
 
 uint32_t emit_instruction_offset_debug_info(
@@ -1376,52 +1666,73 @@ uint32_t emit_instruction_offset_debug_info(
   using DebugMethodMap = std::map<MethodKey, DebugSize, Compare>;
   // 1)
   std::map<uint32_t, DebugMethodMap> param_to_sizes;
-  std::unordered_map<const DexMethod*, DebugMetadata> method_to_debug_meta;
-  // We need this to calculate the size of normal debug programs for each
-  // method. Hopefully no debug program is > 128k. Its ok to increase this
-  // in the future.
-  constexpr int TMP_SIZE = 128 * 1024;
-  uint8_t* tmp = (uint8_t*)malloc(TMP_SIZE);
+  // The metadata of the code items that have debug info, in order. We still
+  // want to fill in pos_mapper and code_debug_map, so run the usual code to
+  // emit debug info, which maps positions in emit order and stays serial.
+  std::vector<DebugMetadata> metadatas;
   for (auto& it : code_items) {
     DexCode* dc = it.code;
     const auto dbg_item = dc->get_debug_item();
     if (!dbg_item) {
       continue;
     }
-    dex_code_item* dci = it.code_item;
-    DexMethod* method = it.method;
-    uint32_t param_size = method->get_proto()->get_args()->size();
-    // We still want to fill in pos_mapper and code_debug_map, so run the
-    // usual code to emit debug info. We cache this and use it later if
-    // it turns out we want to emit normal debug info for a given method.
-    DebugMetadata metadata = calculate_debug_metadata(
-        dbg_item, dc, it.code_item, pos_mapper, param_size, code_debug_map);
-
-    int debug_size =
-        emit_debug_info_for_metadata(dodx, metadata, tmp, 0, false);
-    always_assert_log(debug_size < TMP_SIZE, "Tmp buffer overrun");
-    method_to_debug_meta.emplace(method, std::move(metadata));
-    if (!iodi_metadata.can_safely_use_iodi(method)) {
-      continue;
+    uint32_t param_size = it.method->get_proto()->get_args()->size();
+    metadatas.push_back(calculate_debug_metadata(
+        dbg_item, dc, it.code_item, pos_mapper, param_size, code_debug_map));
+  }
+  // We need the size of the normal debug program of each method. Encoding
+  // them is independent, and we keep the result around to emit it if it
+  // turns out we want normal debug info for a given method.
+  auto encoded = encode_in_parallel(
+      metadatas.size(), [&](size_t i, std::vector<uint32_t>& scratch) {
+        const auto& metadata = metadatas[i];
+        reserve_scratch(scratch, debug_info_size_bound(metadata));
+        return emit_debug_info_for_metadata(
+            dodx, metadata, reinterpret_cast<uint8_t*>(scratch.data()), 0,
+            /* set_dci_offset */ false);
+      });
+  {
+    size_t i = 0;
+    for (auto& it : code_items) {
+      DexCode* dc = it.code;
+      if (!dc->get_debug_item()) {
+        continue;
+      }
+      DebugSize debug_size = encoded[i++].size();
+      DexMethod* method = it.method;
+      if (!iodi_metadata.can_safely_use_iodi(method)) {
+        continue;
+      }
+      uint32_t param_size = method->get_proto()->get_args()->size();
+      auto res = param_to_sizes[param_size].emplace(
+          MethodKey{method, dc->size()}, debug_size);
+      always_assert_log(res.second, "Failed to insert %s, %d pair",
+                        SHOW(method), dc->size());
     }
-    auto res = param_to_sizes[param_size].emplace(MethodKey{method, dc->size()},
-                                                  debug_size);
-    always_assert_log(res.second, "Failed to insert %s, %d pair", SHOW(method),
-                      dc->size());
   }
-  free((void*)tmp);
-  // 2)
-  std::unordered_map<uint32_t, std::map<uint32_t, uint32_t>> param_size_to_oset;
-  uint32_t initial_offset = offset;
+  // 2) The arities are laid out independently, in parallel, and their IODI
+  // programs are emitted afterwards in order.
+  struct ArityLayout {
+    // The methods that are too large to benefit from IODI.
+    std::vector<const DexMethod*> huge_methods;
+    // A {IODI size, method count} pair describing each bucket.
+    std::vector<std::pair<uint32_t, uint32_t>> buckets;
+    size_t num_big{0};
+    size_t insns_size{0};
+  };
+  std::vector<uint32_t> arities;
   for (auto& pts : param_to_sizes) {
-    auto param_size = pts.first;
+    arities.push_back(pts.first);
+  }
+  std::vector<ArityLayout> layouts(arities.size());
+  auto layout_arity = [&](uint32_t param_size, DebugMethodMap& sizes,
+                          ArityLayout* layout) {
     // 2.1) We determine the methods to use IODI we go through two filtering
     // phases:
     //   2.1.1) Filter out methods that will cause an OOM in dexlayout on
     //          Android 8+
     //   2.1.2) Filter out methods who increase uncompressed APK size
 
-    auto& sizes = pts.second;
     always_assert(!sizes.empty());
 
     // 2.1.1) In Android 8+ there's a background optimizer service that
@@ -1685,28 +1996,21 @@ uint32_t emit_instruction_offset_debug_info(
             param_size);
     }
 
-    // Now we've found which methods are too large to be beneficial. Tell IODI
-    // infra about these large methods
-    size_t num_big = 0;
+    // Now we've found which methods are too large to be beneficial. They are
+    // reported to the IODI infra once all arities are laid out.
     for (auto big = sizes.begin(); big != best_iter; big++) {
-      iodi_metadata.mark_method_huge(big->first.method);
+      layout->huge_methods.push_back(big->first.method);
       TRACE(IODI, 3, "[IODI] %s is too large to benefit from IODI: %u vs %u",
             SHOW(big->first.method), big->first.size, big->second);
-      num_big += 1;
     }
-    size_t num_small_enough = sizes.size() - num_big;
-
-    // 2.2) Emit IODI programs (other debug programs will be emitted below)
-    TRACE(IODI, 2,
-          "[IODI] @%u(%u): Of %u methods %u were too big, %u at biggest %u",
-          offset, param_size, sizes.size(), num_big, num_small_enough,
-          insns_size);
+    layout->num_big = layout->huge_methods.size();
+    layout->insns_size = insns_size;
+    size_t num_small_enough = sizes.size() - layout->num_big;
     if (num_small_enough == 0) {
-      continue;
+      return;
     }
-    auto previous_best_iter = best_iter;
     auto bucket_res = create_buckets(best_iter, end);
-    auto& buckets = bucket_res.first;
+    layout->buckets = std::move(bucket_res.first);
     total_inflated_size = bucket_res.second;
     if (traceEnabled(IODI, 4)) {
       double ammortized_cost = (double)iodi_size / (double)num_small_enough;
@@ -1720,9 +2024,35 @@ uint32_t emit_instruction_offset_debug_info(
     TRACE(IODI, 3,
           "[IODI][Buckets] Bucketed %u arity methods into %u buckets with total"
           " inflated size %u:\n",
-          param_size, buckets.size(), total_inflated_size);
+          param_size, layout->buckets.size(), total_inflated_size);
+  };
+  auto wq = workqueue_foreach<size_t>([&](size_t i) {
+    layout_arity(arities[i], param_to_sizes.at(arities[i]), &layouts[i]);
+  });
+  for (size_t i = 0; i < arities.size(); ++i) {
+    wq.add_item(i);
+  }
+  wq.run_all();
+
+  // 2.2) Emit IODI programs (other debug programs will be emitted below)
+  std::unordered_map<uint32_t, std::map<uint32_t, uint32_t>> param_size_to_oset;
+  uint32_t initial_offset = offset;
+  for (size_t i = 0; i < arities.size(); ++i) {
+    auto param_size = arities[i];
+    const auto& layout = layouts[i];
+    for (auto* method : layout.huge_methods) {
+      iodi_metadata.mark_method_huge(method);
+    }
+    size_t num_methods = param_to_sizes.at(param_size).size();
+    TRACE(IODI, 2,
+          "[IODI] @%u(%u): Of %u methods %u were too big, %u at biggest %u",
+          offset, param_size, num_methods, layout.num_big,
+          num_methods - layout.num_big, layout.insns_size);
+    if (layout.buckets.empty()) {
+      continue;
+    }
     auto& size_to_offset = param_size_to_oset[param_size];
-    for (auto& bucket : buckets) {
+    for (auto& bucket : layout.buckets) {
       auto bucket_size = bucket.first;
       TRACE(IODI, 3, "  - %u methods in bucket size %u @ %lu", bucket.second,
             bucket_size, offset);
@@ -1747,12 +2077,14 @@ uint32_t emit_instruction_offset_debug_info(
         post_iodi_offset - initial_offset);
   // 3)
   auto size_offset_end = param_size_to_oset.end();
+  size_t metadata_idx = 0;
   for (auto& it : code_items) {
     DexCode* dc = it.code;
     const auto dbg = dc->get_debug_item();
     if (!dbg) {
       continue;
     }
+    const auto& program = encoded[metadata_idx++];
     dex_code_item* dci = it.code_item;
     auto code_size = dc->size();
     if (code_size == 0) {
@@ -1781,8 +2113,10 @@ uint32_t emit_instruction_offset_debug_info(
                         SHOW(method), code_size);
       dci->debug_info_off = offset_it->second;
     } else {
-      offset += emit_debug_info_for_metadata(
-          dodx, method_to_debug_meta.at(method), output, offset, true);
+      // No align requirement for debug items.
+      memcpy(output + offset, program.data(), program.size());
+      dci->debug_info_off = offset;
+      offset += program.size();
       *dbgcount += 1;
     }
   }
@@ -1814,6 +2148,9 @@ void DexOutput::generate_debug_items() {
               "[IODI] WARNING: Not using IODI because no iodi metadata file was"
               " specified.\n");
     }
+    // Generating the debug programs maps positions in emit order, so it stays
+    // serial; encoding them is independent and happens in parallel.
+    std::vector<DebugMetadata> metadatas;
     for (auto& it : m_code_item_emits) {
       DexCode* dc = it.code;
       dex_code_item* dci = it.code_item;
@@ -1821,9 +2158,24 @@ void DexOutput::generate_debug_items() {
       if (dbg == nullptr) continue;
       dbgcount++;
       size_t num_params = it.method->get_proto()->get_args()->size();
-      m_offset +=
-          emit_debug_info(dodx, emit_positions, dbg, dc, dci, m_pos_mapper,
-                          m_output, m_offset, num_params, m_code_debug_lines);
+      metadatas.push_back(calculate_debug_metadata(
+          dbg, dc, dci, m_pos_mapper, num_params, m_code_debug_lines));
+    }
+    if (emit_positions) {
+      auto encoded = encode_in_parallel(
+          metadatas.size(), [&](size_t i, std::vector<uint32_t>& scratch) {
+            const auto& metadata = metadatas[i];
+            reserve_scratch(scratch, debug_info_size_bound(metadata));
+            return emit_debug_info_for_metadata(
+                dodx, metadata, reinterpret_cast<uint8_t*>(scratch.data()), 0,
+                /* set_dci_offset */ false);
+          });
+      // No align requirement for debug items.
+      for (size_t i = 0; i < metadatas.size(); ++i) {
+        memcpy(m_output + m_offset, encoded[i].data(), encoded[i].size());
+        metadatas[i].dci->debug_info_off = m_offset;
+        m_offset += encoded[i].size();
+      }
     }
   }
   if (emit_positions) {
@@ -2147,134 +2499,149 @@ const char* deobf_primitive(char type) {
   }
 }
 
+// Writes the external form of a type descriptor, without building an
+// intermediate string for the common case of a class type.
+void write_external_name(std::ostream& os, const char* internal, size_t size) {
+  if (size >= 2 && internal[0] == 'L' && internal[size - 1] == ';') {
+    for (size_t i = 1; i + 1 < size; ++i) {
+      os.put(internal[i] == '/' ? '.' : internal[i]);
+    }
+    return;
+  }
+  os << java_names::internal_to_external(std::string(internal, size));
+}
+
+void write_external_name(std::ostream& os, const std::string& internal) {
+  write_external_name(os, internal.data(), internal.size());
+}
+
+// Writes the member name out of a deobfuscated name of the form
+// <class>.<name>:<type>, see get_simple_deobfuscated_name.
+template <class Member>
+void write_simple_deobfuscated_name(std::ostream& os, const Member* member) {
+  const auto& full_name = member->get_deobfuscated_name();
+  if (full_name.empty()) {
+    os << member->c_str();
+    return;
+  }
+  auto dot_pos = full_name.find('.');
+  auto colon_pos = full_name.find(':');
+  if (dot_pos == std::string::npos || colon_pos == std::string::npos) {
+    os << full_name;
+    return;
+  }
+  os.write(full_name.data() + dot_pos + 1, colon_pos - dot_pos - 1);
+}
+
+// The mapping of big apps has millions of entries, so they are streamed out
+// one piece at a time rather than formatted into strings first.
 void write_pg_mapping(const std::string& filename, DexClasses* classes) {
   if (filename.empty()) return;
 
-  auto deobf_class = [&](DexClass* cls) {
-    if (cls) {
-      auto deobname = cls->get_deobfuscated_name();
-      if (!deobname.empty()) return deobname;
+  std::ofstream ofs(filename.c_str(), std::ofstream::out | std::ofstream::app);
+
+  auto write_deobf_class = [&](DexClass* cls) {
+    const auto& deobname = cls->get_deobfuscated_name();
+    if (!deobname.empty()) {
+      write_external_name(ofs, deobname);
+    } else {
+      write_external_name(ofs, cls->get_type()->str());
     }
-    return show(cls);
   };
 
-  auto deobf_type = [&](DexType* type) {
-    if (type) {
-      if (type::is_array(type)) {
-        auto* type_str = type->c_str();
-        int dim = 0;
-        while (type_str[dim] == '[') {
-          dim++;
-        }
-        DexType* inner_type = DexType::get_type(&type_str[dim]);
-        DexClass* inner_cls = inner_type ? type_class(inner_type) : nullptr;
-        std::string result;
-        if (inner_cls) {
-          result = java_names::internal_to_external(deobf_class(inner_cls));
-        } else if (inner_type && type::is_primitive(inner_type)) {
-          result = deobf_primitive(type_str[dim]);
-        } else {
-          result = java_names::internal_to_external(&type_str[dim]);
-        }
-        for (int i = 0; i < dim; ++i) {
-          result = result + "[]";
-        }
-        return result;
-      } else {
-        DexClass* cls = type_class(type);
-        if (cls) {
-          return java_names::internal_to_external(deobf_class(cls));
-        } else if (type::is_primitive(type)) {
-          return std::string(deobf_primitive(type->c_str()[0]));
-        } else {
-          return java_names::internal_to_external(type->c_str());
-        }
-      }
+  auto write_deobf_type = [&](DexType* type) {
+    auto* type_str = type->c_str();
+    int dim = 0;
+    while (type_str[dim] == '[') {
+      dim++;
+    }
+    auto* inner_type_str = &type_str[dim];
+    DexType* inner_type = dim == 0 ? type : DexType::get_type(inner_type_str);
+    DexClass* inner_cls = inner_type ? type_class(inner_type) : nullptr;
+    if (inner_cls) {
+      write_deobf_class(inner_cls);
+    } else if (inner_type && type::is_primitive(inner_type)) {
+      ofs << deobf_primitive(inner_type_str[0]);
+    } else {
+      write_external_name(ofs, inner_type_str, strlen(inner_type_str));
+    }
+    for (int i = 0; i < dim; ++i) {
+      ofs << "[]";
     }
-    return show(type);
   };
 
-  auto deobf_meth = [&](DexMethod* method) {
-    if (method) {
-      /* clang-format off */
-      // Example: 672:672:boolean customShouldDelayInitMessage(android.os.Handler,android.os.Message)
-      /* clang-format on */
-      auto* proto = method->get_proto();
-      std::ostringstream ss;
-      auto* code = method->get_dex_code();
-      auto* dbg = code ? code->get_debug_item() : nullptr;
-      if (dbg) {
-        uint32_t line_start = code->get_debug_item()->get_line_start();
-        uint32_t line_end = line_start;
-        for (auto& entry : dbg->get_entries()) {
-          if (entry.type == DexDebugEntryType::Position) {
-            if (entry.pos->line > line_end) {
-              line_end = entry.pos->line;
-            }
+  auto write_deobf_meth = [&](DexMethod* method) {
+    /* clang-format off */
+    // Example: 672:672:boolean customShouldDelayInitMessage(android.os.Handler,android.os.Message)
+    /* clang-format on */
+    auto* proto = method->get_proto();
+    auto* code = method->get_dex_code();
+    auto* dbg = code ? code->get_debug_item() : nullptr;
+    if (dbg) {
+      uint32_t line_start = code->get_debug_item()->get_line_start();
+      uint32_t line_end = line_start;
+      for (auto& entry : dbg->get_entries()) {
+        if (entry.type == DexDebugEntryType::Position) {
+          if (entry.pos->line > line_end) {
+            line_end = entry.pos->line;
           }
         }
-        // Treat anything bigger than 2^31 as 0
-        if (line_start >
-            static_cast<uint32_t>(std::numeric_limits<int32_t>::max())) {
-          line_start = 0;
-        }
-        if (line_end >
-            static_cast<uint32_t>(std::numeric_limits<int32_t>::max())) {
-          line_end = 0;
-        }
-        ss << line_start << ":" << line_end << ":";
       }
-      auto* rtype = proto->get_rtype();
-      auto rtype_str = deobf_type(rtype);
-      ss << rtype_str;
-      ss << " " << method->get_simple_deobfuscated_name() << "(";
-      auto args = proto->get_args()->get_type_list();
-      for (auto iter = args.begin(); iter != args.end(); ++iter) {
-        auto* atype = *iter;
-        auto atype_str = deobf_type(atype);
-        ss << atype_str;
-        if (iter + 1 != args.end()) {
-          ss << ",";
-        }
+      // Treat anything bigger than 2^31 as 0
+      if (line_start >
+          static_cast<uint32_t>(std::numeric_limits<int32_t>::max())) {
+        line_start = 0;
       }
-      ss << ")";
-      return ss.str();
+      if (line_end >
+          static_cast<uint32_t>(std::numeric_limits<int32_t>::max())) {
+        line_end = 0;
+      }
+      ofs << line_start << ":" << line_end << ":";
     }
-    return show(method);
-  };
-
-  auto deobf_field = [&](DexField* field) {
-    if (field) {
-      std::ostringstream ss;
-      ss << deobf_type(field->get_type()) << " "
-         << field->get_simple_deobfuscated_name();
-      return ss.str();
+    write_deobf_type(proto->get_rtype());
+    ofs << " ";
+    write_simple_deobfuscated_name(ofs, method);
+    ofs << "(";
+    auto& args = proto->get_args()->get_type_list();
+    for (auto iter = args.begin(); iter != args.end(); ++iter) {
+      if (iter != args.begin()) {
+        ofs << ",";
+      }
+      write_deobf_type(*iter);
     }
-    return show(field);
+    ofs << ")";
   };
 
-  std::ofstream ofs(filename.c_str(), std::ofstream::out | std::ofstream::app);
+  auto write_deobf_field = [&](DexField* field) {
+    write_deobf_type(field->get_type());
+    ofs << " ";
+    write_simple_deobfuscated_name(ofs, field);
+  };
 
   for (auto cls : *classes) {
-    auto deobf_cls = deobf_class(cls);
-    ofs << java_names::internal_to_external(deobf_cls) << " -> "
-        << java_names::internal_to_external(cls->get_type()->c_str()) << ":"
-        << std::endl;
+    write_deobf_class(cls);
+    ofs << " -> ";
+    write_external_name(ofs, cls->get_type()->str());
+    ofs << ":\n";
     for (auto field : cls->get_ifields()) {
-      auto deobf = deobf_field(field);
-      ofs << "    " << deobf << " -> " << field->c_str() << std::endl;
+      ofs << "    ";
+      write_deobf_field(field);
+      ofs << " -> " << field->c_str() << '\n';
     }
     for (auto field : cls->get_sfields()) {
-      auto deobf = deobf_field(field);
-      ofs << "    " << deobf << " -> " << field->c_str() << std::endl;
+      ofs << "    ";
+      write_deobf_field(field);
+      ofs << " -> " << field->c_str() << '\n';
     }
     for (auto meth : cls->get_dmethods()) {
-      auto deobf = deobf_meth(meth);
-      ofs << "    " << deobf << " -> " << meth->c_str() << std::endl;
+      ofs << "    ";
+      write_deobf_meth(meth);
+      ofs << " -> " << meth->c_str() << '\n';
     }
     for (auto meth : cls->get_vmethods()) {
-      auto deobf = deobf_meth(meth);
-      ofs << "    " << deobf << " -> " << meth->c_str() << std::endl;
+      ofs << "    ";
+      write_deobf_meth(meth);
+      ofs << " -> " << meth->c_str() << '\n';
     }
   }
 }
@@ -2299,27 +2666,191 @@ void write_bytecode_offset_mapping(
 
 } // namespace
 
-void DexOutput::write_symbol_files() {
+// Each symbol file is appended to by every dex in turn, so the writers of one
+// dex may run concurrently but must all be done before the next dex starts.
+void DexOutput::add_symbol_file_writers(
+    std::vector<std::function<void()>>* tasks) {
   if (m_debug_info_kind != DebugInfoKind::NoCustomSymbolication) {
-    write_method_mapping(m_method_mapping_filename, dodx, m_classes,
-                         hdr.signature);
-    write_class_mapping(m_class_mapping_filename, m_classes,
-                        hdr.class_defs_size, hdr.signature);
+    tasks->push_back([this] {
+      write_method_mapping(m_method_mapping_filename, dodx, m_classes,
+                           hdr.signature);
+    });
+    tasks->push_back([this] {
+      write_class_mapping(m_class_mapping_filename, m_classes,
+                          hdr.class_defs_size, hdr.signature);
+    });
     // XXX: should write_bytecode_offset_mapping be included here too?
   }
-  write_pg_mapping(m_pg_mapping_filename, m_classes);
-  write_bytecode_offset_mapping(m_bytecode_offset_filename,
-                                m_method_bytecode_offsets);
+  tasks->push_back(
+      [this] { write_pg_mapping(m_pg_mapping_filename, m_classes); });
+  tasks->push_back([this] {
+    write_bytecode_offset_mapping(m_bytecode_offset_filename,
+                                  m_method_bytecode_offsets);
+  });
+  tasks->push_back([this] { write_coldstart_page_estimates(); });
+  tasks->push_back([this] { write_interaction_page_estimates(); });
+}
+
+namespace {
+
+constexpr uint32_t kPageSize = 4096;
+
+void add_pages(uint32_t offset,
+               uint32_t size,
+               std::unordered_set<uint32_t>* pages) {
+  if (size == 0) {
+    return;
+  }
+  uint32_t last_page = (offset + size - 1) / kPageSize;
+  for (uint32_t page = offset / kPageSize; page <= last_page; ++page) {
+    pages->insert(page);
+  }
+}
+
+} // namespace
+
+/*
+ * For each profiled interaction, count the distinct code pages of this dex
+ * that hold methods which ran during it, and estimate how many of them end up
+ * resident: a page is touched unless none of its methods runs, where each
+ * method runs independently with its appear100 probability.
+ */
+void DexOutput::write_interaction_page_estimates() {
+  if (m_interaction_page_estimates_filename.empty()) {
+    return;
+  }
+  const auto& profiles = m_config_files.get_method_profiles();
+  auto fd = fopen(m_interaction_page_estimates_filename.c_str(), "a");
+  assert_log(fd, "Can't open interaction page estimates file %s: %s\n",
+             m_interaction_page_estimates_filename.c_str(), strerror(errno));
+  for (const auto& interaction : m_profile_interactions) {
+    const auto& stats = profiles.method_stats(interaction);
+    // For each page, the probability that none of its methods runs.
+    std::unordered_map<uint32_t, double> untouched;
+    size_t methods = 0;
+    for (const auto& emit : m_code_item_emits) {
+      auto it = stats.find(emit.method);
+      if (it == stats.end() || it->second.appear_percent <= 0) {
+        continue;
+      }
+      methods++;
+      double appear = std::min(it->second.appear_percent, 100.0) / 100;
+      std::unordered_set<uint32_t> pages;
+      add_pages((uint32_t)((uint8_t*)emit.code_item - m_output),
+                sizeof(dex_code_item) + emit.code_item->insns_size * 2,
+                &pages);
+      for (auto page : pages) {
+        auto p = untouched.emplace(page, 1.0).first;
+        p->second *= 1 - appear;
+      }
+    }
+    double expected = 0;
+    for (const auto& p : untouched) {
+      expected += 1 - p.second;
+    }
+    fprintf(fd,
+            "store %zu dex %zu interaction %s: %zu methods, %zu code pages, "
+            "%.1f expected resident code pages\n",
+            m_store_number, m_dex_number, interaction.c_str(), methods,
+            untouched.size(), expected);
+  }
+  fclose(fd);
+}
+
+/*
+ * For each startup phase, estimate how many distinct pages of this dex get
+ * touched when loading the phase's classes and running their methods: when
+ * method profiles are used, only the methods that ran.
+ */
+void DexOutput::write_coldstart_page_estimates() {
+  if (m_coldstart_page_estimates_filename.empty() || !m_coldstart_layout) {
+    return;
+  }
+  const auto& layout = *m_coldstart_layout;
+  auto touched = [&layout](const DexMethod* m) {
+    return !layout.use_method_profiles ||
+           layout.get_bucket(m) != ColdStartLayout::kUnprofiledBucket;
+  };
+
+  struct PhasePages {
+    size_t classes{0};
+    size_t methods{0};
+    std::unordered_set<uint32_t> class_pages;
+    std::unordered_set<uint32_t> code_pages;
+    std::unordered_set<uint32_t> string_pages;
+  };
+  std::vector<PhasePages> phases(layout.num_phases);
+  auto add_string_pages = [&](const std::vector<DexString*>& strings,
+                              PhasePages* phase) {
+    auto stringids = (const dex_string_id*)(m_output + hdr.string_ids_off);
+    for (auto s : strings) {
+      add_pages(stringids[dodx->stringidx(s)].offset, s->get_entry_size(),
+                &phase->string_pages);
+    }
+  };
+  for (uint32_t i = 0; i < hdr.class_defs_size; i++) {
+    DexClass* clz = m_classes->at(i);
+    auto p = layout.get_phase(clz);
+    if (p == layout.num_phases) {
+      continue;
+    }
+    auto& phase = phases[p];
+    phase.classes++;
+    add_pages(hdr.class_defs_off + i * sizeof(dex_class_def),
+              sizeof(dex_class_def), &phase.class_pages);
+    add_pages(m_class_data_ranges[i].first, m_class_data_ranges[i].second,
+              &phase.class_pages);
+    std::vector<DexType*> cls_types;
+    clz->gather_types(cls_types);
+    std::vector<DexString*> type_names;
+    for (auto t : cls_types) {
+      type_names.push_back(t->get_name());
+    }
+    add_string_pages(type_names, &phase);
+  }
+  for (const auto& emit : m_code_item_emits) {
+    auto p = layout.get_phase(type_class(emit.method->get_class()));
+    if (p == layout.num_phases || !touched(emit.method)) {
+      continue;
+    }
+    auto& phase = phases[p];
+    phase.methods++;
+    // Estimated without tries and handlers.
+    add_pages((uint32_t)((uint8_t*)emit.code_item - m_output),
+              sizeof(dex_code_item) + emit.code_item->insns_size * 2,
+              &phase.code_pages);
+    std::vector<DexString*> method_strings;
+    emit.method->gather_strings(method_strings);
+    add_string_pages(method_strings, &phase);
+  }
+
+  auto fd = fopen(m_coldstart_page_estimates_filename.c_str(), "a");
+  assert_log(fd, "Can't open coldstart page estimates file %s: %s\n",
+             m_coldstart_page_estimates_filename.c_str(), strerror(errno));
+  for (size_t p = 0; p < phases.size(); ++p) {
+    const auto& phase = phases[p];
+    std::unordered_set<uint32_t> all_pages(phase.class_pages);
+    all_pages.insert(phase.code_pages.begin(), phase.code_pages.end());
+    all_pages.insert(phase.string_pages.begin(), phase.string_pages.end());
+    fprintf(fd,
+            "store %zu dex %zu phase %zu: %zu classes, %zu methods, "
+            "%zu class pages, %zu code pages, %zu string pages, "
+            "%zu pages\n",
+            m_store_number, m_dex_number, p, phase.classes, phase.methods,
+            phase.class_pages.size(), phase.code_pages.size(),
+            phase.string_pages.size(), all_pages.size());
+  }
+  fclose(fd);
 }
 
 void GatheredTypes::set_method_sorting_whitelisted_substrings(
     const std::unordered_set<std::string>& whitelisted_substrings) {
-  m_method_sorting_whitelisted_substrings = whitelisted_substrings;
+  m_method_sorting_whitelisted_substrings = &whitelisted_substrings;
 }
 
 void GatheredTypes::set_method_to_weight(
     const std::unordered_map<std::string, unsigned int>& method_to_weight) {
-  m_method_to_weight = method_to_weight;
+  m_method_to_weight = &method_to_weight;
 }
 
 void DexOutput::prepare(SortMode string_mode,
@@ -2333,6 +2864,38 @@ void DexOutput::prepare(SortMode string_mode,
     m_gtypes->set_method_sorting_whitelisted_substrings(
         conf.get_method_sorting_whitelisted_substrings());
   }
+  if (std::find(code_mode.begin(), code_mode.end(),
+                SortMode::METHOD_INTERACTION_ORDER) != code_mode.end() ||
+      !m_interaction_page_estimates_filename.empty()) {
+    // Cold start first, then the other interactions in the configured
+    // order; by default, all profiled interactions in name order.
+    std::vector<std::string> interactions;
+    conf.get_json_config().get("method_profile_interactions",
+                               std::vector<std::string>(), interactions);
+    if (interactions.empty()) {
+      for (const auto& p : conf.get_method_profiles().all_interactions()) {
+        interactions.push_back(p.first.empty() ? method_profiles::COLD_START
+                                               : p.first);
+      }
+    }
+    m_profile_interactions = {method_profiles::COLD_START};
+    for (const auto& interaction : interactions) {
+      if (std::find(m_profile_interactions.begin(),
+                    m_profile_interactions.end(),
+                    interaction) == m_profile_interactions.end()) {
+        m_profile_interactions.push_back(interaction);
+      }
+    }
+  }
+  if (string_mode == SortMode::COLDSTART_PHASE_ORDER ||
+      std::find(code_mode.begin(), code_mode.end(),
+                SortMode::COLDSTART_PHASE_ORDER) != code_mode.end() ||
+      !m_coldstart_page_estimates_filename.empty()) {
+    m_coldstart_layout.emplace(
+        *m_classes, conf,
+        conf.get_json_config().get("coldstart_layout_use_method_profiles",
+                                   false));
+  }
 
   fix_jumbos(m_classes, dodx);
   init_header_offsets(dex_magic);
@@ -2362,19 +2925,28 @@ void DexOutput::prepare(SortMode string_mode,
 }
 
 void DexOutput::write() {
-  struct stat st;
-  int fd = open(m_filename, O_CREAT | O_TRUNC | O_WRONLY, 0660);
-  if (fd == -1) {
-    perror("Error writing dex");
-    return;
-  }
-  ::write(fd, m_output, m_offset);
-  if (0 == fstat(fd, &st)) {
-    m_stats.num_bytes = st.st_size;
-  }
-  close(fd);
-
-  write_symbol_files();
+  // The dex and its symbol files only read the finished output, so they are
+  // written concurrently.
+  std::vector<std::function<void()>> tasks;
+  tasks.push_back([this] {
+    struct stat st;
+    // The input dexes are kept mapped while we write (their strings are
+    // referenced by DexStrings), and the output may go to the same path.
+    // Write a fresh file instead of truncating theirs in place.
+    std::remove(m_filename);
+    int fd = open(m_filename, O_CREAT | O_TRUNC | O_WRONLY, 0660);
+    if (fd == -1) {
+      perror("Error writing dex");
+      return;
+    }
+    ::write(fd, m_output, m_offset);
+    if (0 == fstat(fd, &st)) {
+      m_stats.num_bytes = st.st_size;
+    }
+    close(fd);
+  });
+  add_symbol_file_writers(&tasks);
+  redex_parallel::run_tasks(tasks);
 }
 
 class UniqueReferences {
@@ -2451,6 +3023,10 @@ static SortMode make_sort_bytecode(const std::string& sort_bytecode) {
     return SortMode::CLINIT_FIRST;
   } else if (sort_bytecode == "method_profiled_order") {
     return SortMode::METHOD_PROFILED_ORDER;
+  } else if (sort_bytecode == "method_interaction_order") {
+    return SortMode::METHOD_INTERACTION_ORDER;
+  } else if (sort_bytecode == "coldstart_phase_order") {
+    return SortMode::COLDSTART_PHASE_ORDER;
   } else {
     return SortMode::DEFAULT;
   }
@@ -2481,6 +3057,8 @@ dex_stats_t write_classes_to_dex(
     string_sort_mode = SortMode::CLASS_STRINGS;
   } else if (sort_strings == "class_order") {
     string_sort_mode = SortMode::CLASS_ORDER;
+  } else if (sort_strings == "coldstart_phase_order") {
+    string_sort_mode = SortMode::COLDSTART_PHASE_ORDER;
   }
 
   auto interdex_config = json_cfg.get("InterDexPass", Json::Value());
@@ -2559,3 +3137,19 @@ LocatorIndex make_locator_index(DexStoresVector& stores) {
 
   return index;
 }
+
+std::vector<uint8_t> make_locator_index_blob(const LocatorIndex& index,
+                                             uint32_t strnr) {
+  std::vector<facebook::LocatorIndexEntry> entries;
+  for (const auto& pair : index) {
+    if (pair.second.strnr == strnr) {
+      entries.push_back(
+          {pair.first->str(), pair.second.dexnr, pair.second.clsnr});
+    }
+  }
+  // The index is keyed by pointers, so sort for a deterministic blob.
+  std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) {
+    return a.descriptor < b.descriptor;
+  });
+  return facebook::build_locator_index(entries);
+}
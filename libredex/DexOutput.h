@@ -7,7 +7,9 @@
 
 #pragma once
 
+#include <functional>
 #include <unordered_map>
+#include <vector>
 
 #include <boost/optional/optional.hpp>
 
@@ -17,6 +19,7 @@
 #include "DexUtil.h"
 #include "Pass.h"
 #include "PostLowering.h"
+#include "ParallelSort.h"
 #include "ProguardMap.h"
 #include "Trace.h"
 
@@ -36,15 +39,47 @@ using dexmethodhandle_to_idx = std::unordered_map<DexMethodHandle*, uint32_t>;
 
 using LocatorIndex = std::unordered_map<DexString*, Locator>;
 LocatorIndex make_locator_index(DexStoresVector& stores);
+// The perfect-hash index blob (see locator_index.h) of the classes of the
+// given store, as an alternative to emitting locator strings.
+std::vector<uint8_t> make_locator_index_blob(const LocatorIndex& index,
+                                             uint32_t strnr);
 
 enum class SortMode {
   CLASS_ORDER,
   CLASS_STRINGS,
   CLINIT_FIRST,
   METHOD_PROFILED_ORDER,
+  METHOD_INTERACTION_ORDER,
+  COLDSTART_PHASE_ORDER,
   DEFAULT
 };
 
+/*
+ * The startup phase of each class of a dex that is in the coldstart class
+ * list, where the list's end markers delimit the phases. A class that is not
+ * in the list is in phase num_phases.
+ *
+ * Optionally, methods of such classes are also put in "appear" buckets: a
+ * method that ran in all profiled cold starts is in bucket 0, one that ran in
+ * less than 10% of them is in bucket 9, and one that never ran is in
+ * kUnprofiledBucket.
+ */
+struct ColdStartLayout {
+  static constexpr uint32_t kUnprofiledBucket = 10;
+
+  ColdStartLayout(const DexClasses& classes,
+                  const ConfigFiles& conf,
+                  bool use_method_profiles);
+
+  uint32_t get_phase(const DexClass* cls) const;
+  uint32_t get_bucket(const DexMethodRef* method) const;
+
+  bool use_method_profiles;
+  uint32_t num_phases{0};
+  std::unordered_map<const DexClass*, uint32_t> class_phases;
+  std::unordered_map<const DexMethodRef*, uint32_t> method_buckets;
+};
+
 class DexOutputIdx {
  private:
   dexstring_to_idx* m_string;
@@ -219,8 +254,11 @@ class GatheredTypes {
   std::unordered_map<const DexString*, unsigned int> m_cls_load_strings;
   std::unordered_map<const DexString*, unsigned int> m_cls_strings;
   std::unordered_map<const DexMethod*, unsigned int> m_methods_in_cls_order;
-  std::unordered_map<std::string, unsigned int> m_method_to_weight;
-  std::unordered_set<std::string> m_method_sorting_whitelisted_substrings;
+  // Views of the lists loaded by ConfigFiles, which outlives the output.
+  const std::unordered_map<std::string, unsigned int>* m_method_to_weight{
+      nullptr};
+  const std::unordered_set<std::string>*
+      m_method_sorting_whitelisted_substrings{nullptr};
 
   void gather_components(PostLowering const* post_lowering);
   dexstring_to_idx* get_string_index(cmp_dstring cmp = compare_dexstrings);
@@ -248,6 +286,8 @@ class GatheredTypes {
   std::vector<DexString*> get_dexstring_emitlist(T cmp = compare_dexstrings);
   std::vector<DexString*> get_cls_order_dexstring_emitlist();
   std::vector<DexString*> keep_cls_strings_together_emitlist();
+  std::vector<DexString*> get_coldstart_phase_dexstring_emitlist(
+      const ColdStartLayout& layout);
   std::vector<DexMethod*> get_dexmethod_emitlist();
   std::vector<DexMethodHandle*> get_dexmethodhandle_emitlist();
   std::vector<DexCallSite*> get_dexcallsite_emitlist();
@@ -258,6 +298,15 @@ class GatheredTypes {
   void sort_dexmethod_emitlist_cls_order(std::vector<DexMethod*>& lmeth);
   void sort_dexmethod_emitlist_clinit_order(std::vector<DexMethod*>& lmeth);
   void sort_dexmethod_emitlist_profiled_order(std::vector<DexMethod*>& lmeth);
+  void sort_dexmethod_emitlist_coldstart_phase_order(
+      std::vector<DexMethod*>& lmeth, const ColdStartLayout& layout);
+  // Methods that ran in the first of the given interactions come first,
+  // ordered by when they first ran on average, then those that ran in the
+  // second interaction, and so on.
+  void sort_dexmethod_emitlist_interaction_order(
+      std::vector<DexMethod*>& lmeth,
+      const method_profiles::MethodProfiles& profiles,
+      const std::vector<std::string>& interactions);
   void set_method_sorting_whitelisted_substrings(
       const std::unordered_set<std::string>& whitelisted_substrings);
   void set_method_to_weight(
@@ -269,14 +318,14 @@ class GatheredTypes {
 template <class T>
 std::vector<DexString*> GatheredTypes::get_dexstring_emitlist(T cmp) {
   std::vector<DexString*> strlist(m_lstring);
-  std::sort(strlist.begin(), strlist.end(), std::cref(cmp));
+  redex_parallel::sort(strlist.begin(), strlist.end(), std::cref(cmp));
   return strlist;
 }
 
-using annomap_t = std::map<DexAnnotation*, uint32_t>;
-using asetmap_t = std::map<DexAnnotationSet*, uint32_t>;
-using xrefmap_t = std::map<ParamAnnotations*, uint32_t>;
-using adirmap_t = std::map<DexAnnotationDirectory*, uint32_t>;
+using annomap_t = std::unordered_map<DexAnnotation*, uint32_t>;
+using asetmap_t = std::unordered_map<DexAnnotationSet*, uint32_t>;
+using xrefmap_t = std::unordered_map<ParamAnnotations*, uint32_t>;
+using adirmap_t = std::unordered_map<DexAnnotationDirectory*, uint32_t>;
 
 struct CodeItemEmit {
   DexMethod* method;
@@ -308,6 +357,9 @@ class DexOutput {
   std::string m_class_mapping_filename;
   std::string m_pg_mapping_filename;
   std::string m_bytecode_offset_filename;
+  std::string m_coldstart_page_estimates_filename;
+  std::string m_interaction_page_estimates_filename;
+  std::vector<std::string> m_profile_interactions;
   std::unordered_map<DexTypeList*, uint32_t> m_tl_emit_offsets;
   std::vector<CodeItemEmit> m_code_item_emits;
   std::unordered_map<DexMethod*, uint64_t>* m_method_to_id;
@@ -322,6 +374,9 @@ class DexOutput {
   const ConfigFiles& m_config_files;
   std::unordered_set<std::string> m_method_sorting_whitelisted_substrings;
   bool m_force_class_data_end_of_file;
+  boost::optional<ColdStartLayout> m_coldstart_layout;
+  // Offset and size of the class data of each class def, if any.
+  std::vector<std::pair<uint32_t, uint32_t>> m_class_data_ranges;
 
   void insert_map_item(uint16_t typeidx,
                        uint32_t size,
@@ -361,7 +416,9 @@ class DexOutput {
   void generate_map();
   void finalize_header();
   void init_header_offsets(const std::string& dex_magic);
-  void write_symbol_files();
+  void add_symbol_file_writers(std::vector<std::function<void()>>* tasks);
+  void write_coldstart_page_estimates();
+  void write_interaction_page_estimates();
   void align_output() { m_offset = (m_offset + 3) & ~3; }
   void emit_locator(Locator locator);
   void emit_magic_locators();
@@ -34,6 +34,10 @@ dex_stats_t& operator+=(dex_stats_t& lhs, const dex_stats_t& rhs) {
   lhs.num_dbg_items += rhs.num_dbg_items;
   lhs.dbg_total_size += rhs.dbg_total_size;
   lhs.instruction_bytes += rhs.instruction_bytes;
+  lhs.open_us += rhs.open_us;
+  lhs.decode_us += rhs.decode_us;
+  lhs.major_faults += rhs.major_faults;
+  lhs.released_bytes += rhs.released_bytes;
 
   lhs.header_item_count += rhs.header_item_count;
   lhs.header_item_bytes += rhs.header_item_bytes;
@@ -41,6 +41,15 @@ struct dex_stats_t {
 
   int instruction_bytes = 0;
 
+  /* I/O of the input dex, in microseconds. Decoding is summed over the
+   * threads that loaded classes; major faults are the page faults that had to
+   * wait for the disk while decoding. Released bytes were handed back to the
+   * kernel after loading. */
+  int open_us = 0;
+  int decode_us = 0;
+  int major_faults = 0;
+  int released_bytes = 0;
+
   /* Stats collected from the Map List section of a Dex. */
   int header_item_count = 0;
   int header_item_bytes = 0;
@@ -60,31 +60,70 @@ void DexMetadata::parse(const std::string& path) {
 }
 
 XStoreRefs::XStoreRefs(const DexStoresVector& stores) {
-  m_xstores.push_back(std::unordered_set<const DexType*>());
+  // Classes that are in several stores belong to the first one.
+  auto add_classes = [this](const DexClasses& classes) {
+    uint32_t idx_plus_one = m_stores.size();
+    for (const auto& cls : classes) {
+      auto& idx = m_store_idx_plus_one[cls->get_type()];
+      if (idx == 0) {
+        idx = idx_plus_one;
+      }
+    }
+  };
   m_stores.push_back(&stores[0]);
-  for (const auto& cls : stores[0].get_dexen()[0]) {
-    m_xstores.back().insert(cls->get_type());
-  }
+  add_classes(stores[0].get_dexen()[0]);
   m_root_stores = 1;
   if (stores[0].get_dexen().size() > 1) {
     m_root_stores++;
-    m_xstores.push_back(std::unordered_set<const DexType*>());
     m_stores.push_back(&stores[0]);
     for (size_t i = 1; i < stores[0].get_dexen().size(); i++) {
-      for (const auto& cls : stores[0].get_dexen()[i]) {
-        m_xstores.back().insert(cls->get_type());
-      }
+      add_classes(stores[0].get_dexen()[i]);
     }
   }
   for (size_t i = 1; i < stores.size(); i++) {
-    m_xstores.push_back(std::unordered_set<const DexType*>());
     m_stores.push_back(&stores[i]);
     for (const auto& classes : stores[i].get_dexen()) {
-      for (const auto& cls : classes) {
-        m_xstores.back().insert(cls->get_type());
-      }
+      add_classes(classes);
+    }
+  }
+
+  size_t num_stores = m_stores.size();
+  m_illegal_refs.resize(num_stores * num_stores);
+  for (size_t caller = 0; caller < num_stores; caller++) {
+    for (size_t callee = 0; callee < num_stores; callee++) {
+      m_illegal_refs[caller * num_stores + callee] =
+          compute_illegal_ref_between_stores(caller, callee);
+    }
+  }
+}
+
+bool XStoreRefs::compute_illegal_ref_between_stores(
+    size_t caller_store_idx, size_t callee_store_idx) const {
+  if (caller_store_idx == callee_store_idx) {
+    return false;
+  }
+
+  bool callee_in_root_store = callee_store_idx < m_root_stores;
+
+  if (callee_in_root_store) {
+    // Check if primary to secondary reference
+    return callee_store_idx > caller_store_idx;
+  }
+
+  // Check if the caller depends on the callee,
+  // TODO - do it transitively.
+  if (caller_store_idx >= m_root_stores) {
+    const auto& callee_store_name = get_store(callee_store_idx)->get_name();
+    const auto& caller_dependencies =
+        get_store(caller_store_idx)->get_dependencies();
+
+    if (std::find(caller_dependencies.begin(), caller_dependencies.end(),
+                  callee_store_name) != caller_dependencies.end()) {
+      return false;
     }
   }
+
+  return true;
 }
 
 XDexRefs::XDexRefs(const DexStoresVector& stores) {
@@ -92,7 +131,11 @@ XDexRefs::XDexRefs(const DexStoresVector& stores) {
   for (auto& store : stores) {
     for (auto& dexen : store.get_dexen()) {
       for (const auto cls : dexen) {
-        m_dexes.emplace(cls->get_type(), dex_nr);
+        // Like emplace, the first dex of a class wins.
+        auto& idx = m_dex_idx_plus_one[cls->get_type()];
+        if (idx == 0) {
+          idx = dex_nr + 1;
+        }
       }
       dex_nr++;
     }
@@ -101,11 +144,9 @@ XDexRefs::XDexRefs(const DexStoresVector& stores) {
 }
 
 size_t XDexRefs::get_dex_idx(const DexType* type) const {
-  auto it = m_dexes.find(type);
-  if (it != m_dexes.end()) {
-    return it->second;
-  }
-  always_assert_log(false, "type %s not in the current APK", SHOW(type));
+  auto idx = m_dex_idx_plus_one.get(type, 0);
+  always_assert_log(idx != 0, "type %s not in the current APK", SHOW(type));
+  return idx - 1;
 }
 
 bool XDexRefs::cross_dex_ref_override(const DexMethod* overridden,
@@ -13,6 +13,7 @@
 #include <utility>
 #include <vector>
 
+#include "DenseIndex.h"
 #include "DexClass.h"
 
 class DexStore;
@@ -128,14 +129,14 @@ class DexStoreClassesIterator
 class XStoreRefs {
  private:
   /**
-   * Set of classes in each logical store. A primary DEX goes in its own
-   * bucket (first element in the array).
+   * One more than the index of the logical store of each class, indexed by
+   * the dense index of its type, so that types of no class in the APK map to
+   * 0. A primary DEX goes in its own logical store (index 0).
    */
-  std::vector<std::unordered_set<const DexType*>> m_xstores;
+  dense_index::IndexedVector<DexType, uint32_t> m_store_idx_plus_one;
 
   /**
-   * Pointers to original stores in the same order as used to populate
-   * m_xstores
+   * Pointers to original stores in the order of the store indices.
    */
   std::vector<const DexStore*> m_stores;
 
@@ -144,6 +145,24 @@ class XStoreRefs {
    */
   size_t m_root_stores;
 
+  /**
+   * Whether a reference between two stores is illegal, precomputed for all
+   * pairs: the entry of caller store i and callee store j is at
+   * i * m_stores.size() + j.
+   */
+  std::vector<uint8_t> m_illegal_refs;
+
+  /**
+   * The index of the store of the type plus one, or 0 if it is not in the
+   * APK.
+   */
+  size_t store_idx_plus_one(const DexType* type) const {
+    return m_store_idx_plus_one.get(type, 0);
+  }
+
+  bool compute_illegal_ref_between_stores(size_t caller_store_idx,
+                                          size_t callee_store_idx) const;
+
  public:
   explicit XStoreRefs(const DexStoresVector& stores);
 
@@ -153,10 +172,9 @@ class XStoreRefs {
    * api.
    */
   size_t get_store_idx(const DexType* type) const {
-    for (size_t store_idx = 0; store_idx < m_xstores.size(); store_idx++) {
-      if (m_xstores[store_idx].count(type) > 0) return store_idx;
-    }
-    always_assert_log(false, "type %s not in the current APK", SHOW(type));
+    auto idx = store_idx_plus_one(type);
+    always_assert_log(idx != 0, "type %s not in the current APK", SHOW(type));
+    return idx - 1;
   }
 
   /**
@@ -166,13 +184,8 @@ class XStoreRefs {
    * the current scope.
    */
   bool is_in_root_store(const DexType* type) const {
-    for (size_t store_idx = 0; store_idx < m_root_stores; store_idx++) {
-      if (m_xstores[store_idx].count(type) > 0) {
-        return true;
-      }
-    }
-
-    return false;
+    auto idx = store_idx_plus_one(type);
+    return idx != 0 && idx - 1 < m_root_stores;
   }
 
   const DexStore* get_store(size_t idx) const { return m_stores[idx]; }
@@ -202,44 +215,20 @@ class XStoreRefs {
     if (type_class_internal(type) == nullptr) return false;
     // Temporary HACK: optimizations may leave references to dead classes and
     // if we just call get_store_idx() - as we should - the assert will fire...
-    size_t type_store_idx = 0;
-    for (; type_store_idx < m_xstores.size(); type_store_idx++) {
-      if (m_xstores[type_store_idx].count(type) > 0) break;
-    }
-    if ((store_idx >= m_xstores.size()) ||
-        (type_store_idx >= m_xstores.size())) {
+    // Types that aren't in the APK get the index one past the last store.
+    size_t num_stores = m_stores.size();
+    size_t type_store_idx = store_idx_plus_one(type);
+    type_store_idx = type_store_idx == 0 ? num_stores : type_store_idx - 1;
+    if ((store_idx >= num_stores) || (type_store_idx >= num_stores)) {
       return type_store_idx > store_idx;
     }
-    return illegal_ref_between_stores(store_idx, type_store_idx);
+    return m_illegal_refs[store_idx * num_stores + type_store_idx];
   }
 
   bool illegal_ref_between_stores(size_t caller_store_idx,
                                   size_t callee_store_idx) const {
-    if (caller_store_idx == callee_store_idx) {
-      return false;
-    }
-
-    bool callee_in_root_store = callee_store_idx < m_root_stores;
-
-    if (callee_in_root_store) {
-      // Check if primary to secondary reference
-      return callee_store_idx > caller_store_idx;
-    }
-
-    // Check if the caller depends on the callee,
-    // TODO - do it transitively.
-    if (caller_store_idx >= m_root_stores) {
-      const auto& callee_store_name = get_store(callee_store_idx)->get_name();
-      const auto& caller_dependencies =
-          get_store(caller_store_idx)->get_dependencies();
-
-      if (std::find(caller_dependencies.begin(), caller_dependencies.end(),
-                    callee_store_name) != caller_dependencies.end()) {
-        return false;
-      }
-    }
-
-    return true;
+    return m_illegal_refs[caller_store_idx * m_stores.size() +
+                          callee_store_idx];
   }
 
   bool cross_store_ref(const DexMethod* caller, const DexMethod* callee) const {
@@ -253,7 +242,9 @@ class XStoreRefs {
  * is used for quick validation for crossing-dex references.
  */
 class XDexRefs {
-  std::unordered_map<const DexType*, size_t> m_dexes;
+  // One more than the index of the dex of each class, indexed by the dense
+  // index of its type, so that types of no class in the APK map to 0.
+  dense_index::IndexedVector<DexType, uint32_t> m_dex_idx_plus_one;
   size_t m_num_dexes;
 
  public:
@@ -309,54 +309,79 @@ void change_visibility(DexMethod* method, DexType* scope) {
 void change_visibility(IRCode* code,
                        DexType* scope,
                        DexMethod* effective_caller_resolved_from) {
+  get_visibility_changes(code, scope, effective_caller_resolved_from).apply();
+}
+
+void VisibilityChanges::insert(const VisibilityChanges& other) {
+  m_classes.insert(other.m_classes.begin(), other.m_classes.end());
+  m_fields.insert(other.m_fields.begin(), other.m_fields.end());
+  m_methods.insert(other.m_methods.begin(), other.m_methods.end());
+}
+
+void VisibilityChanges::apply() const {
+  for (auto cls : m_classes) {
+    set_public(cls);
+  }
+  for (auto field : m_fields) {
+    set_public(field);
+  }
+  for (auto method : m_methods) {
+    set_public(method);
+  }
+}
+
+VisibilityChanges get_visibility_changes(
+    IRCode* code,
+    DexType* scope,
+    DexMethod* effective_caller_resolved_from,
+    bool rewrite_refs) {
   // NOTE: Keep in sync with can_change_visibility_for_relocation
   always_assert(code != nullptr);
 
-  editable_cfg_adapter::iterate(
-      code, [scope, effective_caller_resolved_from](MethodItemEntry& mie) {
-        auto insn = mie.insn;
+  VisibilityChanges changes;
+  auto add_class = [&changes](DexClass* cls) {
+    if (cls != nullptr && !cls->is_external()) {
+      changes.m_classes.insert(cls);
+    }
+  };
+  editable_cfg_adapter::iterate(code, [&](MethodItemEntry& mie) {
+    auto insn = mie.insn;
 
-        if (insn->has_field()) {
-          auto cls = type_class(insn->get_field()->get_class());
-          if (cls != nullptr && !cls->is_external()) {
-            set_public(cls);
-          }
-          auto field =
-              resolve_field(insn->get_field(), is_sfield_op(insn->opcode())
-                                                   ? FieldSearch::Static
-                                                   : FieldSearch::Instance);
-          if (field != nullptr && field->is_concrete()) {
-            set_public(field);
-            set_public(type_class(field->get_class()));
-            // FIXME no point in rewriting opcodes in the method
-            insn->set_field(field);
-          }
-        } else if (insn->has_method()) {
-          auto cls = type_class(insn->get_method()->get_class());
-          if (cls != nullptr && !cls->is_external()) {
-            set_public(cls);
-          }
-          auto current_method =
-              resolve_method(insn->get_method(), opcode_to_search(insn),
-                             effective_caller_resolved_from);
-          if (current_method != nullptr && current_method->is_concrete() &&
-              (scope == nullptr || current_method->get_class() != scope)) {
-            set_public(current_method);
-            cls = type_class(current_method->get_class());
-            always_assert(cls != nullptr);
-            set_public(cls);
-            // FIXME no point in rewriting opcodes in the method
-            insn->set_method(current_method);
-          }
-        } else if (insn->has_type()) {
-          auto type = insn->get_type();
-          auto cls = type_class(type);
-          if (cls != nullptr && !cls->is_external()) {
-            set_public(cls);
-          }
+    if (insn->has_field()) {
+      add_class(type_class(insn->get_field()->get_class()));
+      auto field =
+          resolve_field(insn->get_field(), is_sfield_op(insn->opcode())
+                                               ? FieldSearch::Static
+                                               : FieldSearch::Instance);
+      if (field != nullptr && field->is_concrete()) {
+        changes.m_fields.insert(field);
+        changes.m_classes.insert(type_class(field->get_class()));
+        if (rewrite_refs) {
+          // FIXME no point in rewriting opcodes in the method
+          insn->set_field(field);
         }
-        return editable_cfg_adapter::LOOP_CONTINUE;
-      });
+      }
+    } else if (insn->has_method()) {
+      add_class(type_class(insn->get_method()->get_class()));
+      auto current_method =
+          resolve_method(insn->get_method(), opcode_to_search(insn),
+                         effective_caller_resolved_from);
+      if (current_method != nullptr && current_method->is_concrete() &&
+          (scope == nullptr || current_method->get_class() != scope)) {
+        changes.m_methods.insert(current_method);
+        auto cls = type_class(current_method->get_class());
+        always_assert(cls != nullptr);
+        changes.m_classes.insert(cls);
+        if (rewrite_refs) {
+          // FIXME no point in rewriting opcodes in the method
+          insn->set_method(current_method);
+        }
+      }
+    } else if (insn->has_type()) {
+      add_class(type_class(insn->get_type()));
+    }
+    return editable_cfg_adapter::LOOP_CONTINUE;
+  });
 
   std::vector<DexType*> types;
   if (code->editable_cfg_built()) {
@@ -365,11 +390,9 @@ void change_visibility(IRCode* code,
     code->gather_catch_types(types);
   }
   for (auto type : types) {
-    auto cls = type_class(type);
-    if (cls != nullptr && !cls->is_external()) {
-      set_public(cls);
-    }
+    add_class(type_class(type));
   }
+  return changes;
 }
 
 // Check that visibility / accessibility changes to the current method
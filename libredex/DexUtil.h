@@ -33,6 +33,50 @@ void change_visibility(IRCode* code,
                        DexType* scope,
                        DexMethod* effective_caller_resolved_from);
 
+/**
+ * The classes and members that change_visibility makes public, recorded
+ * instead of applied. Parallel workers gather them for the methods they own,
+ * e.g. in walk::parallel::methods<VisibilityChanges>, and the merged changes
+ * are then applied in one serial step. As making something public is
+ * idempotent, the result does not depend on the order in which the workers
+ * ran.
+ */
+class VisibilityChanges {
+ public:
+  void insert(const VisibilityChanges& other);
+  VisibilityChanges& operator+=(const VisibilityChanges& other) {
+    insert(other);
+    return *this;
+  }
+
+  void apply() const;
+
+  bool empty() const {
+    return m_classes.empty() && m_fields.empty() && m_methods.empty();
+  }
+
+ private:
+  friend VisibilityChanges get_visibility_changes(IRCode*,
+                                                  DexType*,
+                                                  DexMethod*,
+                                                  bool);
+
+  std::unordered_set<DexClass*> m_classes;
+  std::unordered_set<DexField*> m_fields;
+  std::unordered_set<DexMethod*> m_methods;
+};
+
+/**
+ * Like change_visibility, but only rewrites the member references of :code,
+ * which belong to the calling worker, and returns the visibility changes
+ * for the caller to apply. With :rewrite_refs false, :code isn't modified.
+ */
+VisibilityChanges get_visibility_changes(
+    IRCode* code,
+    DexType* scope,
+    DexMethod* effective_caller_resolved_from,
+    bool rewrite_refs = true);
+
 /**
  * NOTE: Only relocates the method. Doesn't check the correctness here,
  *       nor does it make sure that the members are accessible from the
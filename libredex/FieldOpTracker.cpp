@@ -13,12 +13,25 @@
 #include "ControlFlow.h"
 #include "IRCode.h"
 #include "IRInstruction.h"
+#include "EditableCfgAdapter.h"
 #include "PatriciaTreeMapAbstractEnvironment.h"
 #include "Resolver.h"
 #include "Walkers.h"
 
 namespace field_op_tracker {
 
+FieldIndex::FieldIndex(const Scope& scope) {
+  walk::fields(scope, [&](DexField* field) {
+    m_indices.emplace(field, m_fields.size());
+    m_fields.push_back(field);
+  });
+}
+
+size_t FieldIndex::get(const DexField* field) const {
+  auto it = m_indices.find(field);
+  return it == m_indices.end() ? m_fields.size() : it->second;
+}
+
 bool is_own_init(DexField* field, const DexMethod* method) {
   return (method::is_clinit(method) || method::is_init(method)) &&
          method->get_class() == field->get_class();
@@ -82,27 +95,76 @@ NonZeroWrittenFields analyze_non_zero_writes(const Scope& scope) {
                               concurrent_non_zero_written_fields.end());
 }
 
-FieldStatsMap analyze(const Scope& scope) {
-  FieldStatsMap field_stats;
-  // Gather the read/write counts.
-  walk::opcodes(scope, [&](const DexMethod* method, const IRInstruction* insn) {
-    auto op = insn->opcode();
-    if (!insn->has_field()) {
-      return;
+namespace {
+
+// The stats of the fields defined in the scope, by index, and of the other
+// fields that instructions resolve to.
+struct FieldStatsAccumulator {
+  std::vector<FieldStats> indexed;
+  FieldStatsMap others;
+};
+
+struct FieldStatsReducer {
+  void operator()(const FieldStatsAccumulator& addend,
+                  FieldStatsAccumulator* accumulator) const {
+    for (size_t i = 0; i < addend.indexed.size(); ++i) {
+      accumulator->indexed[i] += addend.indexed[i];
     }
-    auto field = resolve_field(insn->get_field());
-    if (field == nullptr) {
-      return;
+    for (auto& pair : addend.others) {
+      accumulator->others[pair.first] += pair.second;
     }
-    if (is_sget(op) || is_iget(op)) {
-      ++field_stats[field].reads;
-      if (!is_own_init(field, method)) {
-        ++field_stats[field].reads_outside_init;
-      }
-    } else if (is_sput(op) || is_iput(op)) {
-      ++field_stats[field].writes;
+  }
+};
+
+} // namespace
+
+FieldStatsMap analyze(const Scope& scope) {
+  FieldIndex index(scope);
+  FieldStatsAccumulator init;
+  init.indexed.resize(index.size());
+  // Gather the read/write counts.
+  auto acc = walk::parallel::methods<FieldStatsAccumulator, FieldStatsReducer>(
+      scope,
+      [&index](DexMethod* method, FieldStatsAccumulator* acc) {
+        auto code = method->get_code();
+        if (code == nullptr) {
+          return;
+        }
+        editable_cfg_adapter::iterate(code, [&](MethodItemEntry& mie) {
+          auto insn = mie.insn;
+          auto op = insn->opcode();
+          if (!insn->has_field()) {
+            return editable_cfg_adapter::LOOP_CONTINUE;
+          }
+          auto field = resolve_field(insn->get_field());
+          if (field == nullptr) {
+            return editable_cfg_adapter::LOOP_CONTINUE;
+          }
+          auto i = index.get(field);
+          auto& stats =
+              i < index.size() ? acc->indexed[i] : acc->others[field];
+          if (is_sget(op) || is_iget(op)) {
+            ++stats.reads;
+            if (!is_own_init(field, method)) {
+              ++stats.reads_outside_init;
+            }
+          } else if (is_sput(op) || is_iput(op)) {
+            ++stats.writes;
+          }
+          return editable_cfg_adapter::LOOP_CONTINUE;
+        });
+      },
+      redex_parallel::default_num_threads(),
+      init);
+
+  FieldStatsMap field_stats = std::move(acc.others);
+  for (size_t i = 0; i < acc.indexed.size(); ++i) {
+    const auto& stats = acc.indexed[i];
+    // Only the fields that are accessed get an entry.
+    if (stats.reads > 0 || stats.writes > 0) {
+      field_stats.emplace(index.get_field(i), stats);
     }
-  });
+  }
   return field_stats;
 }
 
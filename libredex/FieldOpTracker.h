@@ -10,9 +10,28 @@
 #include "DexClass.h"
 
 #include <unordered_map>
+#include <vector>
 
 namespace field_op_tracker {
 
+// Assigns dense indices to the fields defined in a scope, so that per-field
+// data can be accumulated in flat vectors rather than in maps keyed by fields.
+class FieldIndex {
+ public:
+  explicit FieldIndex(const Scope& scope);
+
+  // Returns size() for fields that aren't defined in the scope.
+  size_t get(const DexField* field) const;
+
+  DexField* get_field(size_t index) const { return m_fields.at(index); }
+
+  size_t size() const { return m_fields.size(); }
+
+ private:
+  std::vector<DexField*> m_fields;
+  std::unordered_map<const DexField*, size_t> m_indices;
+};
+
 struct FieldStats {
   // Number of instructions which read a field in the entire program.
   size_t reads{0};
@@ -21,10 +40,20 @@ struct FieldStats {
   size_t reads_outside_init{0};
   // Number of instructions which write a field in the entire program.
   size_t writes{0};
+
+  FieldStats& operator+=(const FieldStats& that) {
+    reads += that.reads;
+    reads_outside_init += that.reads_outside_init;
+    writes += that.writes;
+    return *this;
+  }
 };
 
 using FieldStatsMap = std::unordered_map<DexField*, FieldStats>;
 
+// Gathers the stats of all fields that are accessed by the code of the scope.
+// Each thread counts into its own flat vector, and the vectors are summed up
+// at the end.
 FieldStatsMap analyze(const Scope& scope);
 
 using NonZeroWrittenFields = std::unordered_set<DexField*>;
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <type_traits>
+
+/*
+ * A pool of fixed-size blocks for small objects that are created and destroyed
+ * in great numbers, such as the nodes of an IRList and their instructions.
+ *
+ * Blocks are carved sequentially out of large slabs, so objects that are
+ * created together, e.g. while ballooning a method, also sit next to each
+ * other in memory, and no block pays for a malloc header. Each thread has its
+ * own free list, so neither allocating nor freeing takes a lock. A block may be
+ * freed on any thread, which will then reuse it. When a thread exits, its free
+ * list is handed over to a shared list that other threads refill from. Slabs
+ * are never returned to the system.
+ *
+ * Under AddressSanitizer, the pool defers to the global allocator so that
+ * use-after-free bugs in pooled objects are still caught.
+ */
+#if defined(__SANITIZE_ADDRESS__)
+#define REDEX_FIXED_SIZE_POOL_PASSTHROUGH
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define REDEX_FIXED_SIZE_POOL_PASSTHROUGH
+#endif
+#endif
+
+template <size_t Size, size_t Align>
+class FixedSizePool final {
+  static_assert(Align <= alignof(std::max_align_t),
+                "Slabs only have the default alignment");
+
+ public:
+  static void* allocate() {
+#ifdef REDEX_FIXED_SIZE_POOL_PASSTHROUGH
+    return ::operator new(Size);
+#else
+    auto& cache = thread_cache();
+    if (cache.free_list == nullptr && cache.slab_cur == cache.slab_end) {
+      refill(cache);
+    }
+    if (cache.free_list != nullptr) {
+      auto* block = cache.free_list;
+      cache.free_list = block->next;
+      return block;
+    }
+    return cache.slab_cur++;
+#endif
+  }
+
+  static void deallocate(void* ptr) {
+#ifdef REDEX_FIXED_SIZE_POOL_PASSTHROUGH
+    ::operator delete(ptr);
+#else
+    auto& cache = thread_cache();
+    ensure_flusher(cache);
+    auto* block = static_cast<Block*>(ptr);
+    block->next = cache.free_list;
+    cache.free_list = block;
+#endif
+  }
+
+ private:
+  union Block {
+    Block* next;
+    typename std::aligned_storage<Size, Align>::type storage;
+  };
+
+  // Roughly 64KB per slab.
+  static constexpr size_t kBlocksPerSlab =
+      sizeof(Block) >= 64 * 1024 ? 1 : (64 * 1024) / sizeof(Block);
+
+  // Kept trivially destructible, so that blocks freed during static
+  // destruction, after the flusher below has run, are still safe to handle.
+  struct ThreadCache {
+    Block* free_list;
+    Block* slab_cur;
+    Block* slab_end;
+    bool has_flusher;
+  };
+
+  struct Shared {
+    std::mutex mutex;
+    Block* free_list{nullptr};
+  };
+
+  // Hands the free list of an exiting thread over to the shared list.
+  struct Flusher {
+    ~Flusher() {
+      auto& cache = thread_cache();
+      if (cache.free_list == nullptr) {
+        return;
+      }
+      auto* tail = cache.free_list;
+      while (tail->next != nullptr) {
+        tail = tail->next;
+      }
+      auto& shared = shared_state();
+      std::lock_guard<std::mutex> lock(shared.mutex);
+      tail->next = shared.free_list;
+      shared.free_list = cache.free_list;
+      cache.free_list = nullptr;
+    }
+  };
+
+  static ThreadCache& thread_cache() {
+    static thread_local ThreadCache cache{nullptr, nullptr, nullptr, false};
+    return cache;
+  }
+
+  // Leaked, so that threads that outlive static destruction can still use it.
+  static Shared& shared_state() {
+    static auto* shared = new Shared();
+    return *shared;
+  }
+
+  // The flusher is only constructed once per thread, as it must not be touched
+  // again once it has been destroyed.
+  static void ensure_flusher(ThreadCache& cache) {
+    if (!cache.has_flusher) {
+      cache.has_flusher = true;
+      static thread_local Flusher flusher;
+      (void)flusher;
+    }
+  }
+
+  static void refill(ThreadCache& cache) {
+    ensure_flusher(cache);
+    {
+      auto& shared = shared_state();
+      std::lock_guard<std::mutex> lock(shared.mutex);
+      if (shared.free_list != nullptr) {
+        cache.free_list = shared.free_list;
+        shared.free_list = nullptr;
+        return;
+      }
+    }
+    cache.slab_cur = static_cast<Block*>(
+        ::operator new(kBlocksPerSlab * sizeof(Block)));
+    cache.slab_end = cache.slab_cur + kBlocksPerSlab;
+  }
+};
@@ -16,10 +16,15 @@ bool FrameworkAPI::has_method(const std::string& simple_deobfuscated_name,
                               DexProto* meth_proto,
                               DexAccessFlags meth_access_flags,
                               bool relax_access_flags_matching) const {
+  // Names are interned, so if there is no such string, there is no such
+  // method either, and otherwise we can compare pointers.
+  auto* name = DexString::get_string(simple_deobfuscated_name);
+  if (name == nullptr) {
+    return false;
+  }
   for (const MRefInfo& mref_info : mrefs_info) {
     auto* mref = mref_info.mref;
-    if (mref->get_proto() != meth_proto ||
-        mref->get_name()->str() != simple_deobfuscated_name) {
+    if (mref->get_proto() != meth_proto || mref->get_name() != name) {
       continue;
     }
 
@@ -21,6 +21,20 @@ void InlinerConfig::bind_config() {
   bind("run_dedup_blocks", run_dedup_blocks, run_dedup_blocks);
   bind("run_copy_prop", run_copy_prop, run_copy_prop);
   bind("run_local_dce", run_local_dce, run_local_dce);
+  bind("wave_scheduling", wave_scheduling, wave_scheduling,
+       "Inline bottom-up in waves: each wave inlines into and shrinks all "
+       "methods whose callees were completed by earlier waves, in parallel.");
+  bind("profile_guided_size_budget", profile_guided_size_budget,
+       profile_guided_size_budget,
+       "When inlining with method profiles, rank call sites by profiled call "
+       "frequency times estimated savings, and inline the best ones until the "
+       "inlined callees add up to this many instructions. 0 keeps the fixed "
+       "hotness thresholds.");
+  bind("max_inline_call_depth", max_inline_call_depth, max_inline_call_depth,
+       "Don't inline callees that make chains of calls deeper than this, so "
+       "that bottom-up inlining folds at most this many levels of calls into "
+       "a method. Callees whose depth is unbounded because of recursion are "
+       "left to the inliner's recursion checks. 0 disables the cap.");
   bind("no_inline_annos", {}, m_no_inline_annos);
   bind("force_inline_annos", {}, m_force_inline_annos);
   bind("black_list", {}, m_black_list);
@@ -44,6 +58,7 @@ void IRTypeCheckerConfig::bind_config() {
   bind("verify_moves", {}, verify_moves);
   bind("run_after_passes", {}, run_after_passes);
   bind("check_no_overwrite_this", {}, check_no_overwrite_this);
+  bind("check_monitors", {}, check_monitors);
 }
 
 void HasherConfig::bind_config() {
@@ -33,6 +33,7 @@ struct IRTypeCheckerConfig : public Configurable {
   bool verify_moves;
   std::unordered_set<std::string> run_after_passes;
   bool check_no_overwrite_this;
+  bool check_monitors;
 };
 
 struct HasherConfig : public Configurable {
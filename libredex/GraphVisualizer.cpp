@@ -16,6 +16,7 @@
 #include "ControlFlow.h"
 #include "Debug.h"
 #include "IRCode.h"
+#include "WorkQueue.h"
 
 // The "Hotspot Client Compiler Visualizer" (c1visualizer) is a tool consuming
 // Hotspot C1 compiler debug info to display control flow graphs of compilation
@@ -742,9 +743,14 @@ void Classes::add(DexClass* klass) {
 }
 
 void Classes::add_pass(const std::string& pass_name, Options o) {
-  for (auto& class_cfg : m_class_cfgs) {
-    class_cfg.add_pass(pass_name, o);
-  }
+  // Each class only prints (and possibly builds the CFGs of) its own methods,
+  // so the classes can be printed concurrently.
+  auto wq = workqueue_foreach<size_t>(
+      [&](size_t i) { m_class_cfgs[i].add_pass(pass_name, o); });
+  for (size_t i = 0; i < m_class_cfgs.size(); ++i) {
+    wq.add_item(i);
+  }
+  wq.run_all();
   if (m_write_after_each_pass) {
     write();
   }
@@ -7,6 +7,9 @@
 
 #include "IODIMetadata.h"
 
+#include <algorithm>
+
+#include "DexEncoding.h"
 #include "DexUtil.h"
 #include "Trace.h"
 
@@ -104,18 +107,24 @@ bool IODIMetadata::can_safely_use_iodi(const DexMethod* method) const {
 
 void IODIMetadata::write(
     const std::string& iodi_metadata_filename,
-    const std::unordered_map<DexMethod*, uint64_t>& method_to_id) {
+    const std::unordered_map<DexMethod*, uint64_t>& method_to_id,
+    Format format) {
   if (iodi_metadata_filename.empty()) {
     return;
   }
   std::ofstream ofs(iodi_metadata_filename.c_str(),
                     std::ofstream::out | std::ofstream::trunc);
-  write(ofs, method_to_id);
+  write(ofs, method_to_id, format);
 }
 
 void IODIMetadata::write(
     std::ostream& ofs,
-    const std::unordered_map<DexMethod*, uint64_t>& method_to_id) {
+    const std::unordered_map<DexMethod*, uint64_t>& method_to_id,
+    Format format) {
+  if (format == Format::Columnar) {
+    write_columnar(ofs, method_to_id);
+    return;
+  }
   /*
    * Binary file format
    * {
@@ -176,3 +185,97 @@ void IODIMetadata::write(
         "[IODI] Emitted %u entries, %u ignored because they were too big.",
         count, huge_count);
 }
+
+void IODIMetadata::write_columnar(
+    std::ostream& ofs,
+    const std::unordered_map<DexMethod*, uint64_t>& method_to_id) {
+  /*
+   * Binary file format
+   * {
+   *  magic: uint32_t = 0xfaceb001
+   *  version: uint32_t = 2
+   *  count: uint32_t
+   *  zero: uint32_t = 0
+   *  signature_count: uint32_t
+   *  signatures: uint32_t[signature_count]
+   *  key_offsets: uint32_t[count + 1]
+   *  id_block_offsets: uint32_t[(count + 63) / 64]
+   *  ids_size: uint32_t
+   *  ids: uint8_t[ids_size]
+   *  keys: char[key_offsets[count]]
+   * }
+   * Keys are sorted, and key i is keys[key_offsets[i], key_offsets[i + 1]).
+   *
+   * A method id is the method's index in its dex in its upper 32 bits, and
+   * the dex signature in its lower 32 bits. The ids column holds, for each
+   * key, the uleb128 index of its dex signature in signatures followed by the
+   * uleb128 method index. Block b of 64 ids starts at ids[id_block_offsets[b]],
+   * so that finding the id of key i only decodes the ids before it in its
+   * block.
+   */
+  constexpr uint32_t kIdsPerBlock = 64;
+  std::vector<std::pair<const std::string*, uint64_t>> entries;
+  uint32_t huge_count = 0;
+  for (const auto& it : m_iodi_methods) {
+    if (!can_safely_use_iodi(it.second)) {
+      huge_count += 1;
+      continue;
+    }
+    always_assert(entries.size() < UINT32_MAX);
+    entries.emplace_back(&it.first,
+                         method_to_id.at(const_cast<DexMethod*>(it.second)));
+  }
+  std::sort(entries.begin(), entries.end(),
+            [](const std::pair<const std::string*, uint64_t>& a,
+               const std::pair<const std::string*, uint64_t>& b) {
+              return *a.first < *b.first;
+            });
+
+  std::vector<uint32_t> signatures;
+  std::unordered_map<uint32_t, uint32_t> signature_to_idx;
+  std::vector<uint32_t> key_offsets;
+  std::vector<uint32_t> id_block_offsets;
+  std::string ids;
+  std::string keys;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    const auto& key = *entries[i].first;
+    uint64_t method_id = entries[i].second;
+    uint32_t signature = (uint32_t)method_id;
+    auto res = signature_to_idx.emplace(signature, signatures.size());
+    if (res.second) {
+      signatures.push_back(signature);
+    }
+    if (i % kIdsPerBlock == 0) {
+      id_block_offsets.push_back(ids.size());
+    }
+    uint8_t buf[10];
+    uint8_t* end = write_uleb128(buf, res.first->second);
+    end = write_uleb128(end, (uint32_t)(method_id >> 32));
+    ids.append((const char*)buf, end - buf);
+    key_offsets.push_back(keys.size());
+    keys += key;
+    always_assert(keys.size() < UINT32_MAX);
+  }
+  key_offsets.push_back(keys.size());
+
+  auto write_u32 = [&](uint32_t value) {
+    ofs.write((const char*)&value, sizeof(value));
+  };
+  auto write_u32s = [&](const std::vector<uint32_t>& values) {
+    ofs.write((const char*)values.data(), values.size() * sizeof(uint32_t));
+  };
+  write_u32(0xfaceb001);
+  write_u32(2);
+  write_u32(entries.size());
+  write_u32(0);
+  write_u32(signatures.size());
+  write_u32s(signatures);
+  write_u32s(key_offsets);
+  write_u32s(id_block_offsets);
+  write_u32(ids.size());
+  ofs << ids << keys;
+  TRACE(IODI, 1,
+        "[IODI] Emitted %u columnar entries, %u ignored because they were too "
+        "big.",
+        entries.size(), huge_count);
+}
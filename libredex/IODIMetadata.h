@@ -45,15 +45,30 @@ class IODIMetadata {
   // Returns whether we can symbolicate using IODI for the given method.
   bool can_safely_use_iodi(const DexMethod* method) const;
 
+  enum class Format {
+    // Version 1: one entry per method, holding its name and method id.
+    Entries,
+    // Version 2: the names sorted in a column of their own, and the method
+    // ids varint-encoded in another, so that the file can be mapped and
+    // searched in place. See write_columnar.
+    Columnar,
+  };
+
   // Write to disk, pretty usual. Does nothing if filename len is 0.
   using MethodToIdMap = std::unordered_map<DexMethod*, uint64_t>;
-  void write(const std::string& file, const MethodToIdMap& method_to_id);
+  void write(const std::string& file,
+             const MethodToIdMap& method_to_id,
+             Format format = Format::Entries);
 
   // Write to out. Underlying logic used by write(const std::string&, ...)
   // but exposed for testing.
-  void write(std::ostream& ofs, const MethodToIdMap& method_to_id);
+  void write(std::ostream& ofs,
+             const MethodToIdMap& method_to_id,
+             Format format = Format::Entries);
 
  private:
+  void write_columnar(std::ostream& ofs, const MethodToIdMap& method_to_id);
+
   std::unordered_map<std::string, const DexMethod*> m_iodi_methods;
   // These exists for can_safely_use_iodi
   std::unordered_map<const DexMethod*, std::string> m_method_to_name;
@@ -9,6 +9,7 @@
 
 #include <boost/functional/hash.hpp>
 #include <boost/optional/optional.hpp>
+#include <cstdlib>
 #include <sstream>
 #include <string>
 #include <unordered_map>
@@ -174,6 +175,25 @@ std::vector<s_expr> to_s_exprs(
   }
 }
 
+/*
+ * Takes the string at the head of the list off it, like matching
+ * s_patn({s_patn(&str)}, *list), but without building the pattern, nor the
+ * error message unless there is no such string.
+ */
+std::string pop_string(s_expr* list,
+                       const char* expected,
+                       const std::string& opcode_str) {
+  if (list->is_list() && list->size() > 0 && (*list)[0].is_string()) {
+    std::string str = (*list)[0].get_string();
+    *list = list->tail(1);
+    return str;
+  }
+  std::string str;
+  s_patn({s_patn(&str)}, *list)
+      .must_match(*list, std::string(expected) + opcode_str);
+  not_reached();
+}
+
 std::unique_ptr<IRInstruction> instruction_from_s_expr(
     const std::string& opcode_str, const s_expr& e, LabelRefs* label_refs) {
   auto op_it = string_to_opcode_table.find(opcode_str);
@@ -182,12 +202,10 @@ std::unique_ptr<IRInstruction> instruction_from_s_expr(
                     opcode_str.c_str());
   auto op = op_it->second;
   auto insn = std::make_unique<IRInstruction>(op);
-  std::string reg_str;
   s_expr tail = e;
   if (insn->has_dest()) {
-    s_patn({s_patn(&reg_str)}, tail)
-        .must_match(tail, "Expected dest reg for " + opcode_str);
-    insn->set_dest(reg_from_str(reg_str));
+    insn->set_dest(
+        reg_from_str(pop_string(&tail, "Expected dest reg for ", opcode_str)));
   }
   if (opcode::has_variable_srcs_size(op)) {
     auto srcs = tail[0];
@@ -198,8 +216,7 @@ std::unique_ptr<IRInstruction> instruction_from_s_expr(
     }
   } else {
     for (size_t i = 0; i < insn->srcs_size(); ++i) {
-      s_patn({s_patn(&reg_str)}, tail)
-          .must_match(tail, "Expected src reg for" + opcode_str);
+      auto reg_str = pop_string(&tail, "Expected src reg for", opcode_str);
       insn->set_src(i, reg_from_str(reg_str));
     }
   }
@@ -210,43 +227,32 @@ std::unique_ptr<IRInstruction> instruction_from_s_expr(
     always_assert_log(false, "Not yet supported");
     break;
   case opcode::Ref::Field: {
-    std::string str;
-    s_patn({s_patn(&str)}, tail)
-        .must_match(tail, "Expecting string literal for " + opcode_str);
+    auto str = pop_string(&tail, "Expecting string literal for ", opcode_str);
     auto* dex_field = DexField::make_field(str);
     insn->set_field(dex_field);
     break;
   }
   case opcode::Ref::Method: {
-    std::string str;
-    s_patn({s_patn(&str)}, tail)
-        .must_match(tail, "Expecting string literal for " + opcode_str);
+    auto str = pop_string(&tail, "Expecting string literal for ", opcode_str);
     auto* dex_method = DexMethod::make_method(str);
     insn->set_method(dex_method);
     break;
   }
   case opcode::Ref::String: {
-    std::string str;
-    s_patn({s_patn(&str)}, tail)
-        .must_match(tail, "Expecting string literal for " + opcode_str);
+    auto str = pop_string(&tail, "Expecting string literal for ", opcode_str);
     auto* dex_str = DexString::make_string(str);
     insn->set_string(dex_str);
     break;
   }
   case opcode::Ref::Literal: {
-    std::string num_str;
-    s_patn({s_patn(&num_str)}, tail)
-        .must_match(tail, "Expecting numeric literal for " + opcode_str);
-    int64_t num;
-    std::istringstream in(num_str);
-    in >> num;
-    insn->set_literal(num);
+    auto num_str =
+        pop_string(&tail, "Expecting numeric literal for ", opcode_str);
+    insn->set_literal(std::strtoll(num_str.c_str(), nullptr, 10));
     break;
   }
   case opcode::Ref::Type: {
-    std::string type_str;
-    s_patn({s_patn(&type_str)}, tail)
-        .must_match(tail, "Expecting type specifier for " + opcode_str);
+    auto type_str =
+        pop_string(&tail, "Expecting type specifier for ", opcode_str);
     DexType* ty = DexType::make_type(type_str.c_str());
     insn->set_type(ty);
     break;
@@ -262,18 +268,17 @@ std::unique_ptr<IRInstruction> instruction_from_s_expr(
   }
 
   if (is_branch(op)) {
-    std::string label_str;
     if (is_switch(op)) {
       s_expr list;
       s_patn({s_patn(list)}, tail)
           .must_match(tail, "Expecting list of labels for " + opcode_str);
+      std::string label_str;
       while (s_patn({s_patn(&label_str)}, list).match_with(list)) {
         (*label_refs)[insn.get()].push_back(label_str);
       }
     } else {
-      s_patn({s_patn(&label_str)}, tail)
-          .must_match(tail, "Expecting label for " + opcode_str);
-      (*label_refs)[insn.get()].push_back(label_str);
+      (*label_refs)[insn.get()].push_back(
+          pop_string(&tail, "Expecting label for ", opcode_str));
     }
   }
 
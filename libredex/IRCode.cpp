@@ -16,6 +16,7 @@
 #include <memory>
 #include <unordered_set>
 
+#include "AllocTracking.h"
 #include "ControlFlow.h"
 #include "Debug.h"
 #include "DexClass.h"
@@ -571,6 +572,7 @@ IRCode::~IRCode() {
 }
 
 IRCode::IRCode(DexMethod* method) : m_ir_list(new IRList()) {
+  alloc_tracking::ScopedCategory scope(alloc_tracking::Category::IR);
   auto* dc = method->get_dex_code();
   generate_load_params(
       method, dc->get_registers_size() - dc->get_ins_size(), this);
@@ -600,18 +602,47 @@ IRCode::IRCode(const IRCode& code) {
 
 void IRCode::cleanup_debug() { m_ir_list->cleanup_debug(); }
 
+namespace {
+std::atomic<bool> s_retain_editable_cfgs{false};
+std::atomic<uint64_t> s_mutation_epochs{0};
+} // namespace
+
+uint64_t IRCode::new_mutation_epoch() {
+  return s_mutation_epochs.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+void IRCode::set_retain_editable_cfgs(bool retain) {
+  s_retain_editable_cfgs = retain;
+}
+
+bool IRCode::retain_editable_cfgs() { return s_retain_editable_cfgs; }
+
 void IRCode::build_cfg(bool editable) {
-  clear_cfg();
+  if (editable) {
+    mark_changed();
+  }
+  if (editable && editable_cfg_built() && retain_editable_cfgs()) {
+    return;
+  }
+  force_clear_cfg();
   m_cfg = std::make_unique<cfg::ControlFlowGraph>(
       m_ir_list, m_registers_size, editable);
 }
 
 void IRCode::clear_cfg() {
+  if (editable_cfg_built() && retain_editable_cfgs()) {
+    return;
+  }
+  force_clear_cfg();
+}
+
+void IRCode::force_clear_cfg() {
   if (!m_cfg) {
     return;
   }
 
   if (m_cfg->editable()) {
+    mark_changed();
     m_registers_size = m_cfg->get_registers_size();
     if (m_ir_list != nullptr) {
       m_ir_list->clear_and_dispose();
@@ -1120,3 +1151,14 @@ size_t IRCode::count_opcodes() const {
   }
   return m_ir_list->count_opcodes();
 }
+
+size_t IRCode::estimate_size() const {
+  if (editable_cfg_built()) {
+    size_t size{0};
+    for (auto* block : m_cfg->blocks()) {
+      size += block->num_entries();
+    }
+    return size;
+  }
+  return m_ir_list->size();
+}
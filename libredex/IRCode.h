@@ -43,6 +43,7 @@ class IRCode {
   std::unique_ptr<cfg::ControlFlowGraph> m_cfg;
 
   reg_t m_registers_size{0};
+  uint64_t m_mutation_epoch{new_mutation_epoch()};
   // TODO(jezng): we shouldn't be storing / exposing the DexDebugItem... just
   // exposing the param names should be enough
   std::unique_ptr<DexDebugItem> m_dbg;
@@ -50,12 +51,14 @@ class IRCode {
   IRList::iterator make_if_block(const IRList::iterator& cur,
                                  IRInstruction* insn,
                                  IRList::iterator* if_block) {
+    mark_changed();
     return m_ir_list->make_if_block(cur, insn, if_block);
   }
   IRList::iterator make_if_else_block(const IRList::iterator& cur,
                                       IRInstruction* insn,
                                       IRList::iterator* if_block,
                                       IRList::iterator* else_block) {
+    mark_changed();
     return m_ir_list->make_if_else_block(cur, insn, if_block, else_block);
   }
   IRList::iterator make_switch_block(
@@ -63,9 +66,12 @@ class IRCode {
       IRInstruction* insn,
       IRList::iterator* default_block,
       std::map<SwitchIndices, IRList::iterator>& cases) {
+    mark_changed();
     return m_ir_list->make_switch_block(cur, insn, default_block, cases);
   }
 
+  static uint64_t new_mutation_epoch();
+
   friend struct MethodCreator;
 
  public:
@@ -105,11 +111,31 @@ class IRCode {
 
   reg_t get_registers_size() const { return m_registers_size; }
 
-  void set_registers_size(reg_t sz) { m_registers_size = sz; }
+  /*
+   * A number that changes whenever the code is changed through the methods of
+   * IRCode, and that no other IRCode ever had, so that whoever remembers it
+   * can tell later on whether the code changed since (see MutationCheckpoint).
+   * Building an editable cfg counts as a change, since edits of the cfg are
+   * not tracked individually. Instructions that are changed in place, e.g.
+   * by renaming their registers, are not noticed either; code that does so
+   * must call mark_changed() to let consumers of the epoch know.
+   */
+  uint64_t get_mutation_epoch() const { return m_mutation_epoch; }
+
+  void mark_changed() { m_mutation_epoch = new_mutation_epoch(); }
 
-  reg_t allocate_temp() { return m_registers_size++; }
+  void set_registers_size(reg_t sz) {
+    mark_changed();
+    m_registers_size = sz;
+  }
+
+  reg_t allocate_temp() {
+    mark_changed();
+    return m_registers_size++;
+  }
 
   reg_t allocate_wide_temp() {
+    mark_changed();
     reg_t new_reg = m_registers_size;
     m_registers_size += 2;
     return new_reg;
@@ -157,6 +183,16 @@ class IRCode {
   // if the cfg was editable, linearize it back into m_ir_list
   void clear_cfg();
 
+  // Like clear_cfg(), but also when editable CFGs are being retained.
+  void force_clear_cfg();
+
+  // While set, clear_cfg() leaves an editable CFG in place and
+  // build_cfg(true) reuses one that exists, so that a run of passes that only
+  // work on the CFG builds and linearizes it just once. The PassManager sets
+  // this for passes that declare Pass::is_editable_cfg_friendly().
+  static void set_retain_editable_cfgs(bool retain);
+  static bool retain_editable_cfgs();
+
   bool cfg_built() const;
   bool editable_cfg_built() const;
 
@@ -165,12 +201,14 @@ class IRCode {
 
   /* Passes memory ownership of "from" to callee.  It will delete it. */
   void replace_opcode(IRInstruction* from, IRInstruction* to) {
+    mark_changed();
     m_ir_list->replace_opcode(from, to);
   }
 
   /* Passes memory ownership of "from" to callee.  It will delete it. */
   void replace_opcode(IRInstruction* to_delete,
                       const std::vector<IRInstruction*>& replacements) {
+    mark_changed();
     m_ir_list->replace_opcode(to_delete, replacements);
   }
 
@@ -179,22 +217,28 @@ class IRCode {
    * to appease the compiler in various scenarios of unreachable code.
    */
   void replace_opcode_with_infinite_loop(IRInstruction* from) {
+    mark_changed();
     m_ir_list->replace_opcode_with_infinite_loop(from);
   }
 
   /* Like replace_opcode, but both :from and :to must be branch opcodes.
    * :to will end up jumping to the same destination as :from. */
   void replace_branch(IRInstruction* from, IRInstruction* to) {
+    mark_changed();
     m_ir_list->replace_branch(from, to);
   }
 
   template <class... Args>
   void push_back(Args&&... args) {
+    mark_changed();
     m_ir_list->push_back(*(new MethodItemEntry(std::forward<Args>(args)...)));
   }
 
   /* Passes memory ownership of "mie" to callee. */
-  void push_back(MethodItemEntry& mie) { m_ir_list->push_back(mie); }
+  void push_back(MethodItemEntry& mie) {
+    mark_changed();
+    m_ir_list->push_back(mie);
+  }
 
   /*
    * Insert after instruction :position.
@@ -206,22 +250,26 @@ class IRCode {
    */
   void insert_after(IRInstruction* position,
                     const std::vector<IRInstruction*>& opcodes) {
+    mark_changed();
     m_ir_list->insert_after(position, opcodes);
   }
 
   IRList::iterator insert_before(const IRList::iterator& position,
                                  MethodItemEntry& mie) {
+    mark_changed();
     return m_ir_list->insert_before(position, mie);
   }
 
   IRList::iterator insert_after(const IRList::iterator& position,
                                 MethodItemEntry& mie) {
+    mark_changed();
     return m_ir_list->insert_after(position, mie);
   }
 
   template <class... Args>
   IRList::iterator insert_before(const IRList::iterator& position,
                                  Args&&... args) {
+    mark_changed();
     return m_ir_list->insert_before(
         position, *(new MethodItemEntry(std::forward<Args>(args)...)));
   }
@@ -230,6 +278,7 @@ class IRCode {
   IRList::iterator insert_after(const IRList::iterator& position,
                                 Args&&... args) {
     always_assert(position != m_ir_list->end());
+    mark_changed();
     return m_ir_list->insert_after(
         position, *(new MethodItemEntry(std::forward<Args>(args)...)));
   }
@@ -237,7 +286,10 @@ class IRCode {
   /* DEPRECATED! Use the version below that passes in the iterator instead,
    * which is O(1) instead of O(n). */
   /* Memory ownership of "insn" passes to callee, it will delete it. */
-  void remove_opcode(IRInstruction* insn) { m_ir_list->remove_opcode(insn); }
+  void remove_opcode(IRInstruction* insn) {
+    mark_changed();
+    m_ir_list->remove_opcode(insn);
+  }
 
   /*
    * Remove the instruction that :it points to.
@@ -246,6 +298,7 @@ class IRCode {
    * remove both that instruction and the move-result-pseudo that follows.
    */
   void remove_opcode(const IRList::iterator& it) {
+    mark_changed();
     m_ir_list->remove_opcode(it);
   }
 
@@ -260,6 +313,13 @@ class IRCode {
    */
   size_t count_opcodes() const;
 
+  /*
+   * Returns a cheap estimate of the size of the code, in MethodItemEntries,
+   * meant for balancing work. Unlike count_opcodes() and sum_opcode_sizes(),
+   * this does not visit every entry.
+   */
+  size_t estimate_size() const;
+
   void sanity_check() const { m_ir_list->sanity_check(); }
 
   IRList::iterator begin() { return m_ir_list->begin(); }
@@ -273,14 +333,29 @@ class IRCode {
   IRList::const_reverse_iterator rbegin() const { return m_ir_list->rbegin(); }
   IRList::const_reverse_iterator rend() const { return m_ir_list->rend(); }
 
+  // The number of entries of the linear IR, in constant time.
+  size_t size() const { return m_ir_list->size(); }
+
   IRList::iterator main_block() { return m_ir_list->main_block(); }
 
   IRList::iterator erase(const IRList::iterator& it) {
+    mark_changed();
     return m_ir_list->erase(it);
   }
   IRList::iterator erase_and_dispose(const IRList::iterator& it) {
+    mark_changed();
     return m_ir_list->erase_and_dispose(it);
   }
+  // Erases and frees all the entries matching the predicate in a single walk
+  // over the linear IR. The predicate is called once per entry, in order.
+  template <typename Predicate>
+  void remove_and_dispose_if(Predicate predicate) {
+    auto size = m_ir_list->size();
+    m_ir_list->remove_and_dispose_if(predicate);
+    if (m_ir_list->size() != size) {
+      mark_changed();
+    }
+  }
 
   IRList::iterator iterator_to(MethodItemEntry& mie) {
     return m_ir_list->iterator_to(mie);
@@ -10,37 +10,62 @@
 #include "DexClass.h"
 #include "DexUtil.h"
 
+#include <algorithm>
 #include <boost/range/any_range.hpp>
 #include <cstring>
 #include <iterator>
 
-IRInstruction::IRInstruction(IROpcode op) : m_opcode(op) {
-  auto count = opcode_impl::min_srcs_size(op);
-  if (count <= MAX_NUM_INLINE_SRCS) {
-    m_num_inline_srcs = count;
+namespace {
+
+// Spilled source registers of invokes with a handful of arguments, which is
+// most of them, come from a pool rather than the heap.
+constexpr size_t NUM_POOLED_SRCS = 6;
+using PooledSrcs =
+    FixedSizePool<NUM_POOLED_SRCS * sizeof(reg_t), alignof(reg_t)>;
+
+} // namespace
+
+reg_t* IRInstruction::allocate_srcs(size_t count) {
+  if (count <= NUM_POOLED_SRCS) {
+    return static_cast<reg_t*>(PooledSrcs::allocate());
+  }
+  return new reg_t[count];
+}
+
+void IRInstruction::free_srcs(reg_t* srcs, size_t count) {
+  if (count <= NUM_POOLED_SRCS) {
+    PooledSrcs::deallocate(srcs);
   } else {
-    m_num_inline_srcs = MAX_NUM_INLINE_SRCS + 1;
-    m_srcs = new std::vector<reg_t>(count);
+    delete[] srcs;
+  }
+}
+
+IRInstruction::IRInstruction(IROpcode op)
+    : m_opcode(op), m_num_srcs(opcode_impl::min_srcs_size(op)) {
+  if (!has_inline_srcs()) {
+    m_srcs = allocate_srcs(m_num_srcs);
+    std::fill(m_srcs, m_srcs + m_num_srcs, 0);
   }
 }
 
 IRInstruction::IRInstruction(const IRInstruction& other)
     : m_opcode(other.m_opcode),
-      m_num_inline_srcs(other.m_num_inline_srcs),
+      m_num_srcs(other.m_num_srcs),
       m_dest(other.m_dest),
       m_literal(other.m_literal) {
-  if (m_num_inline_srcs <= MAX_NUM_INLINE_SRCS) {
-    for (auto i = 0; i < m_num_inline_srcs; ++i) {
+  if (has_inline_srcs()) {
+    for (auto i = 0; i < m_num_srcs; ++i) {
       m_inline_srcs[i] = other.m_inline_srcs[i];
     }
   } else {
-    m_srcs = new std::vector<reg_t>(*other.m_srcs);
+    m_srcs = allocate_srcs(m_num_srcs);
+    std::copy(other.m_srcs, other.m_srcs + m_num_srcs, m_srcs);
   }
 }
 
 IRInstruction::~IRInstruction() {
-  if (m_num_inline_srcs > MAX_NUM_INLINE_SRCS) {
-    delete m_srcs;
+  if (!has_inline_srcs()) {
+    free_srcs(m_srcs, m_num_srcs);
   }
 }
 
@@ -48,42 +73,23 @@ IRInstruction::~IRInstruction() {
 // because they are unknown until we sync back to DexInstructions.
 bool IRInstruction::operator==(const IRInstruction& that) const {
   bool simple_fields_match =
-      m_opcode == that.m_opcode &&
-      m_num_inline_srcs == that.m_num_inline_srcs && m_dest == that.m_dest &&
+      m_opcode == that.m_opcode && m_num_srcs == that.m_num_srcs &&
+      m_dest == that.m_dest &&
       m_literal == that.m_literal; // just test one member of the union
   if (!simple_fields_match) {
     return false;
   }
-  // Check the source registers union
-  if (m_num_inline_srcs <= MAX_NUM_INLINE_SRCS) {
-    for (auto i = 0; i < m_num_inline_srcs; ++i) {
-      if (m_inline_srcs[i] != that.m_inline_srcs[i]) {
-        return false;
-      }
-    }
-    return true;
-  } else {
-    return *m_srcs == *that.m_srcs;
-  }
+  return std::equal(srcs_data(), srcs_data() + m_num_srcs, that.srcs_data());
 }
 
 reg_t IRInstruction::src(size_t i) const {
-  if (m_num_inline_srcs <= MAX_NUM_INLINE_SRCS) {
-    always_assert(i < m_num_inline_srcs);
-    return m_inline_srcs[i];
-  }
-  return m_srcs->at(i);
+  always_assert(i < m_num_srcs);
+  return srcs_data()[i];
 }
 
 IRInstruction::reg_range IRInstruction::srcs() const {
-  if (m_num_inline_srcs <= MAX_NUM_INLINE_SRCS) {
-    const reg_t* begin = std::begin(m_inline_srcs);
-    const reg_t* end = begin + m_num_inline_srcs;
-    return reg_range(begin, end);
-  }
-  const reg_t* begin = m_srcs->data();
-  const reg_t* end = begin + m_srcs->size();
-  return reg_range(begin, end);
+  const reg_t* begin = srcs_data();
+  return reg_range(begin, begin + m_num_srcs);
 }
 
 std::vector<reg_t> IRInstruction::srcs_vec() const {
@@ -96,50 +102,33 @@ std::vector<reg_t> IRInstruction::srcs_vec() const {
 }
 
 IRInstruction* IRInstruction::set_src(size_t i, reg_t reg) {
-  if (m_num_inline_srcs <= MAX_NUM_INLINE_SRCS) {
-    always_assert(i < m_num_inline_srcs);
-    m_inline_srcs[i] = reg;
-  } else {
-    m_srcs->at(i) = reg;
-  }
+  always_assert(i < m_num_srcs);
+  srcs_data()[i] = reg;
   return this;
 }
 
-size_t IRInstruction::srcs_size() const {
-  if (m_num_inline_srcs <= MAX_NUM_INLINE_SRCS) {
-    return m_num_inline_srcs;
-  }
-  return m_srcs->size();
-}
+size_t IRInstruction::srcs_size() const { return m_num_srcs; }
 
 IRInstruction* IRInstruction::set_srcs_size(uint16_t count) {
-  if (m_num_inline_srcs <= MAX_NUM_INLINE_SRCS) {
-    if (count <= MAX_NUM_INLINE_SRCS) {
-      // staying in the inline state
-      m_num_inline_srcs = count;
-    } else {
-      // inline regs -> vector
-      auto srcs = new std::vector<reg_t>();
-      srcs->reserve(count);
-      for (auto i = 0; i < m_num_inline_srcs; ++i) {
-        srcs->push_back(m_inline_srcs[i]);
-      }
-      srcs->resize(count);
-      m_num_inline_srcs = MAX_NUM_INLINE_SRCS + 1;
-      m_srcs = srcs;
+  if (count <= MAX_NUM_INLINE_SRCS) {
+    if (!has_inline_srcs()) {
+      // spilled regs -> inline regs
+      auto old_srcs = m_srcs;
+      std::memcpy(m_inline_srcs, old_srcs, count * sizeof(reg_t));
+      free_srcs(old_srcs, m_num_srcs);
     }
-  } else {
-    if (count <= MAX_NUM_INLINE_SRCS) {
-      // vector -> inline regs
-      auto old_srcs_ptr = m_srcs;
-      m_num_inline_srcs = count;
-      always_assert(count <= old_srcs_ptr->size());
-      std::memcpy(m_inline_srcs, old_srcs_ptr->data(), count * sizeof(reg_t));
-      delete old_srcs_ptr;
-    } else {
-      // staying in the vector state
-      m_srcs->resize(count);
+    m_num_srcs = count;
+  } else if (count != m_num_srcs) {
+    // inline or spilled regs -> newly spilled regs
+    auto srcs = allocate_srcs(count);
+    size_t kept = std::min<size_t>(count, m_num_srcs);
+    std::copy(srcs_data(), srcs_data() + kept, srcs);
+    std::fill(srcs + kept, srcs + count, 0);
+    if (!has_inline_srcs()) {
+      free_srcs(m_srcs, m_num_srcs);
     }
+    m_srcs = srcs;
+    m_num_srcs = count;
   }
   return this;
 }
@@ -326,19 +315,8 @@ void IRInstruction::denormalize_registers() {
       }
     }
 
-    // update m_inline_srcs or m_srcs
-    if (m_num_inline_srcs > MAX_NUM_INLINE_SRCS) {
-      delete m_srcs;
-    }
-    if (srcs.size() <= MAX_NUM_INLINE_SRCS) {
-      m_num_inline_srcs = srcs.size();
-      for (size_t i = 0; i < srcs.size(); ++i) {
-        m_inline_srcs[i] = srcs.at(i);
-      }
-    } else {
-      m_num_inline_srcs = MAX_NUM_INLINE_SRCS + 1;
-      m_srcs = new std::vector<reg_t>(std::move(srcs));
-    }
+    set_srcs_size(srcs.size());
+    std::copy(srcs.begin(), srcs.end(), srcs_data());
   }
 }
 
@@ -10,6 +10,7 @@
 #include "DexCallSite.h"
 #include "DexInstruction.h"
 #include "DexMethodHandle.h"
+#include "FixedSizePool.h"
 #include "Show.h"
 
 #include <boost/range/any_range.hpp>
@@ -126,6 +127,17 @@ class IRInstruction final {
   IRInstruction(const IRInstruction&);
   ~IRInstruction();
 
+  // Instructions come from a pool, so that those of a method sit close
+  // together.
+  static void* operator new(size_t /* size */) {
+    return FixedSizePool<sizeof(IRInstruction),
+                         alignof(IRInstruction)>::allocate();
+  }
+  static void operator delete(void* ptr) {
+    FixedSizePool<sizeof(IRInstruction),
+                  alignof(IRInstruction)>::deallocate(ptr);
+  }
+
   /*
    * Ensures that wide registers only have their first register referenced
    * in the srcs list. This only affects invoke-* instructions.
@@ -402,21 +414,27 @@ class IRInstruction final {
   // 2 is chosen because it's the maximum number of registers (32 bits each) we
   // can fit in the size of a pointer (on a 64bit system).
   // In practice, most IRInstructions have 2 or fewer source registers, so we
-  // can avoid a vector allocation most of the time.
+  // can avoid a separate allocation most of the time.
   static constexpr uint8_t MAX_NUM_INLINE_SRCS = 2;
 
+  bool has_inline_srcs() const { return m_num_srcs <= MAX_NUM_INLINE_SRCS; }
+  const reg_t* srcs_data() const {
+    return has_inline_srcs() ? m_inline_srcs : m_srcs;
+  }
+  reg_t* srcs_data() { return has_inline_srcs() ? m_inline_srcs : m_srcs; }
+
+  // Storage for source registers that don't fit inline.
+  static reg_t* allocate_srcs(size_t count);
+  static void free_srcs(reg_t* srcs, size_t count);
+
   // The fields of IRInstruction are carefully selected and ordered to avoid
   // empty packing bytes and minimize total size. This is optimized for 8 byte
   // alignment on a 64bit system.
 
   IROpcode m_opcode; // 2 bytes
-  // m_num_inline_srcs can take a small set of possible values:
-  //   * 0, ..., MAX_NUM_INLINE_SRCS: the size of the valid section of
-  //     m_inline_srcs
-  //   * MAX_NUM_INLINE_SRCS + 1: indicates that m_srcs should be used, not
-  //     m_inline_srcs
-  uint16_t m_num_inline_srcs{0}; // 2 bytes. Could be 1 byte
-                                 // but extra byte would just be padding
+  // The number of source registers. Up to MAX_NUM_INLINE_SRCS of them are
+  // stored in m_inline_srcs, any more than that in m_srcs.
+  uint16_t m_num_srcs{0}; // 2 bytes
   reg_t m_dest{0}; // 4 bytes
   // 8 bytes so far
   union {
@@ -433,11 +451,11 @@ class IRInstruction final {
   };
   // 16 bytes so far
   union {
-    // m_num_inline_srcs indicates how to interpret the union. See comment above
+    // m_num_srcs indicates how to interpret the union. See comment above
     reg_t m_inline_srcs[MAX_NUM_INLINE_SRCS] = {0};
-    // Use a pointer here because it's 8 bytes instead of ~24.
-    // Be careful to new and delete it correctly!
-    std::vector<reg_t>* m_srcs;
+    // m_num_srcs registers, from allocate_srcs(). Be careful to allocate and
+    // free it correctly!
+    reg_t* m_srcs;
   };
   // 24 bytes total
 };
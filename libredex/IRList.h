@@ -13,6 +13,7 @@
 
 #include "DexClass.h"
 #include "DexDebugInstruction.h"
+#include "FixedSizePool.h"
 #include "IRInstruction.h"
 
 struct MethodItemEntry;
@@ -163,6 +164,17 @@ struct MethodItemEntry {
   MethodItemEntry() : type(MFLOW_FALLTHROUGH) {}
   ~MethodItemEntry();
 
+  // Entries come from a pool, so that those of a method sit close together.
+  static void* operator new(size_t size) {
+    always_assert(size == sizeof(MethodItemEntry));
+    return FixedSizePool<sizeof(MethodItemEntry),
+                         alignof(MethodItemEntry)>::allocate();
+  }
+  static void operator delete(void* ptr) {
+    FixedSizePool<sizeof(MethodItemEntry),
+                  alignof(MethodItemEntry)>::deallocate(ptr);
+  }
+
   /*
    * This should only ever be used by the instruction lowering step. Do NOT use
    * it in passes!
@@ -7,6 +7,8 @@
 
 #include "IRMetaIO.h"
 
+#include <boost/iostreams/device/mapped_file.hpp>
+
 #include "StringBuilder.h"
 #include "Walkers.h"
 
@@ -31,44 +33,52 @@ void serialize_str(const std::string& str, std::ofstream& ostrm) {
   ostrm.put('\0');
 }
 
-DexField* find_field(const DexClass* cls, const std::string& name) {
-  auto result =
-      std::find_if(cls->get_sfields().begin(),
-                   cls->get_sfields().end(),
-                   [&](const DexField* f) { return f->str() == name; });
-  if (result != cls->get_sfields().end()) {
-    return *result;
+/**
+ * Looks up the members of a class by the names they are serialized with. The
+ * lookup tables are only built for classes that have member blocks, and then
+ * only once per class rather than once per member.
+ */
+class MemberIndex {
+ public:
+  void reset(const DexClass* cls) {
+    m_cls = cls;
+    m_fields.clear();
+    m_methods.clear();
   }
-  auto result2 =
-      std::find_if(cls->get_ifields().begin(),
-                   cls->get_ifields().end(),
-                   [&](const DexField* f) { return f->str() == name; });
-  redex_assert(result2 != cls->get_ifields().end());
-  return *result2;
-}
 
-DexMethod* find_method(const DexClass* cls, const std::string& name_and_proto) {
-  int colon = name_and_proto.find(':');
-  const DexString* method_name =
-      DexString::make_string(name_and_proto.substr(0, colon));
-  std::string proto =
-      name_and_proto.substr(colon + 1, name_and_proto.length() - colon - 1);
-  auto result = std::find_if(
-      cls->get_dmethods().begin(), cls->get_dmethods().end(),
-      [&](const DexMethod* m) {
-        return m->get_name() == method_name && show(m->get_proto()) == proto;
-      });
-  if (result != cls->get_dmethods().end()) {
-    return *result;
+  DexField* find_field(const std::string& name) {
+    if (m_fields.empty()) {
+      for (auto* fields : {&m_cls->get_sfields(), &m_cls->get_ifields()}) {
+        for (DexField* field : *fields) {
+          m_fields.emplace(field->str(), field);
+        }
+      }
+    }
+    auto it = m_fields.find(name);
+    redex_assert(it != m_fields.end());
+    return it->second;
   }
-  auto result2 = std::find_if(
-      cls->get_vmethods().begin(), cls->get_vmethods().end(),
-      [&](const DexMethod* m) {
-        return m->get_name() == method_name && show(m->get_proto()) == proto;
-      });
-  redex_assert(result2 != cls->get_vmethods().end());
-  return *result2;
-}
+
+  DexMethod* find_method(const std::string& name_and_proto) {
+    if (m_methods.empty()) {
+      for (auto* methods : {&m_cls->get_dmethods(), &m_cls->get_vmethods()}) {
+        for (DexMethod* method : *methods) {
+          string_builders::StaticStringBuilder<3> b;
+          b << method->c_str() << ":" << show(method->get_proto());
+          m_methods.emplace(b.str(), method);
+        }
+      }
+    }
+    auto it = m_methods.find(name_and_proto);
+    redex_assert(it != m_methods.end());
+    return it->second;
+  }
+
+ private:
+  const DexClass* m_cls{nullptr};
+  std::unordered_map<std::string, DexField*> m_fields;
+  std::unordered_map<std::string, DexMethod*> m_methods;
+};
 
 /**
  * Serialize deobfuscated_name and rstate of class, method or field.
@@ -88,7 +98,9 @@ void deserialize_name_and_rstate(const char** _ptr, T* obj) {
   int utfsize = read_uleb128((const uint8_t**)_ptr);
   if (utfsize) {
     obj->set_deobfuscated_name(std::string(*_ptr));
-  } else {
+  } else if (obj->get_deobfuscated_name().empty()) {
+    // The loader already defaults the names of all members to show(obj), so
+    // only compute it for members that have none yet.
     obj->set_deobfuscated_name(show(obj));
   }
   (*_ptr) += utfsize + 1;
@@ -166,12 +178,11 @@ void serialize_class_data(const Scope& classes, std::ofstream& ostrm) {
   });
 }
 
-void deserialize_class_data(std::ifstream& istrm, uint32_t data_size) {
-  auto data = std::make_unique<char[]>(data_size);
-  istrm.read((char*)data.get(), data_size);
-  char* ptr = data.get();
+void deserialize_class_data(const char* data, uint32_t data_size) {
+  const char* ptr = data;
   DexClass* cls = nullptr;
-  while (ptr - data.get() < data_size) {
+  MemberIndex members;
+  while (ptr - data < data_size) {
     BlockType btype = (BlockType)*ptr++;
     always_assert(btype >= 0 && btype < BlockType::EndOfBlock);
     int utfsize = read_uleb128((const uint8_t**)&ptr);
@@ -180,20 +191,21 @@ void deserialize_class_data(std::ifstream& istrm, uint32_t data_size) {
       DexType* type = DexType::get_type(ptr, utfsize);
       cls = type_class(type);
       always_assert(cls != nullptr);
+      members.reset(cls);
       ptr += utfsize + 1;
-      deserialize_name_and_rstate((const char**)&ptr, cls);
+      deserialize_name_and_rstate(&ptr, cls);
       break;
     }
     case BlockType::FieldBlock: {
-      DexField* field = find_field(cls, std::string(ptr, utfsize));
+      DexField* field = members.find_field(std::string(ptr, utfsize));
       ptr += utfsize + 1;
-      deserialize_name_and_rstate((const char**)&ptr, field);
+      deserialize_name_and_rstate(&ptr, field);
       break;
     }
     case BlockType::MethodBlock: {
-      DexMethod* method = find_method(cls, std::string(ptr, utfsize));
+      DexMethod* method = members.find_method(std::string(ptr, utfsize));
       ptr += utfsize + 1;
-      deserialize_name_and_rstate((const char**)&ptr, method);
+      deserialize_name_and_rstate(&ptr, method);
       break;
     }
     default: {
@@ -230,14 +242,20 @@ void dump(const Scope& classes, const std::string& output_dir) {
 
 bool load(const std::string& input_dir) {
   std::string input_file = input_dir + IRMETA_FILE_NAME;
-  std::ifstream istrm(input_file, std::ios::binary | std::ios::in);
-  if (!istrm.is_open()) {
+  boost::iostreams::mapped_file_source file;
+  try {
+    file.open(input_file);
+  } catch (const std::exception& e) {
     std::cerr << "Can not open " << input_file << std::endl;
     return false;
   }
+  if (file.size() < sizeof(ir_meta_header_t)) {
+    std::cerr << "May be not valid meta file\n";
+    return false;
+  }
 
   ir_meta_header_t meta_header;
-  istrm.read((char*)&meta_header, sizeof(meta_header));
+  memcpy(&meta_header, file.data(), sizeof(meta_header));
   if (strcmp(meta_header.magic, IRMETA_MAGIC_NUMBER) != 0) {
     std::cerr << "May be not valid meta file\n";
     return false;
@@ -246,9 +264,13 @@ bool load(const std::string& input_dir) {
     std::cerr << "Could not load the outdated IR meta data\n";
     return false;
   }
-  // file size
+  if (file.size() < sizeof(meta_header) + meta_header.classes_size) {
+    std::cerr << "Truncated meta file\n";
+    return false;
+  }
 
-  deserialize_class_data(istrm, meta_header.classes_size);
+  deserialize_class_data(file.data() + sizeof(meta_header),
+                         meta_header.classes_size);
 
   return true;
 }
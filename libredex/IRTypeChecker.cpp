@@ -9,8 +9,10 @@
 
 #include <boost/optional/optional.hpp>
 
+#include "ClassHierarchy.h"
 #include "DexUtil.h"
 #include "Match.h"
+#include "MonitorCount.h"
 #include "Resolver.h"
 #include "Show.h"
 
@@ -626,6 +628,7 @@ IRTypeChecker::IRTypeChecker(DexMethod* dex_method, bool validate_access)
       m_complete(false),
       m_verify_moves(false),
       m_check_no_overwrite_this(false),
+      m_check_monitors(false),
       m_good(true),
       m_what("OK") {}
 
@@ -655,6 +658,19 @@ void IRTypeChecker::run() {
   // We then infer types for all the registers used in the method.
   const cfg::ControlFlowGraph& cfg = code->cfg();
 
+  if (m_check_monitors) {
+    auto insn = monitor_count::find_synchronized_throw_outside_catch_all(
+        cfg, /* only_in_try_regions */ true);
+    if (insn != nullptr) {
+      m_complete = true;
+      m_good = false;
+      m_what = "Encountered " + show(insn) +
+               " that may throw while a monitor is held, in a try region "
+               "without a catch-all";
+      return;
+    }
+  }
+
   // Check that the load-params match the signature.
   auto params_result = check_load_params(m_dex_method);
   if (params_result != Result::Ok()) {
@@ -1305,3 +1321,26 @@ std::ostream& operator<<(std::ostream& output, const IRTypeChecker& checker) {
   checker.m_type_inference->print(output);
   return output;
 }
+
+void IRTypeCheckerCache::prepare(const Scope& scope) {
+  auto structure_hash = class_structure_hash(scope);
+  if (m_structure_hash != structure_hash) {
+    m_verified.clear();
+    m_structure_hash = structure_hash;
+  }
+}
+
+IRTypeCheckerCache::State IRTypeCheckerCache::get_state(
+    const DexMethod* method,
+    bool verify_moves,
+    bool check_no_overwrite_this,
+    bool check_monitors) {
+  State state;
+  state.fingerprint = code_fingerprint::compute_exact(*method->get_code());
+  state.proto = method->get_proto();
+  state.access = method->get_access();
+  state.verify_moves = verify_moves;
+  state.check_no_overwrite_this = check_no_overwrite_this;
+  state.check_monitors = check_monitors;
+  return state;
+}
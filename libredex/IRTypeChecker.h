@@ -7,6 +7,10 @@
 
 #pragma once
 
+#include <boost/optional.hpp>
+
+#include "CodeFingerprint.h"
+#include "ConcurrentContainers.h"
 #include "TypeInference.h"
 
 /*
@@ -71,6 +75,19 @@ class IRTypeChecker final {
     }
   }
 
+  /*
+   * The verifier rejects methods where an opcode that may throw, executed
+   * while a monitor is held, has catch handlers but no catch-all (see
+   * MonitorCount.h). This checks for those too, on the same CFG as the other
+   * checks.
+   */
+  void check_monitors() {
+    if (!m_complete) {
+      // We can only set this parameter before running the type checker.
+      m_check_monitors = true;
+    }
+  }
+
   void run();
 
   bool good() const {
@@ -130,6 +147,7 @@ class IRTypeChecker final {
   bool m_complete;
   bool m_verify_moves;
   bool m_check_no_overwrite_this;
+  bool m_check_monitors;
   bool m_good;
   std::string m_what;
   std::unique_ptr<type_inference::TypeInference> m_type_inference;
@@ -138,3 +156,64 @@ class IRTypeChecker final {
 };
 
 std::ostream& operator<<(std::ostream& output, const IRTypeChecker& checker);
+
+/*
+ * Remembers the methods that passed the type checker, so that checking the
+ * whole scope again, e.g. after every pass, only needs to re-verify the
+ * methods whose code, proto or access flags changed in the meantime. As the
+ * outcome also depends on the class hierarchy, all methods are forgotten when
+ * the class structure of the scope changes.
+ *
+ * Code is compared by its exact fingerprint. Changes to the definitions that
+ * a method merely refers to, e.g. changing the proto of a callee without
+ * updating its callers, are not noticed. Checks that validate access are not
+ * meant to be cached, since they also depend on the access flags of all the
+ * referenced classes and members.
+ *
+ * is_verified() and set_verified() are thread-safe.
+ */
+class IRTypeCheckerCache final {
+ public:
+  struct State {
+    code_fingerprint::Fingerprint fingerprint{0};
+    const DexProto* proto{nullptr};
+    DexAccessFlags access{};
+    bool verify_moves{false};
+    bool check_no_overwrite_this{false};
+    bool check_monitors{false};
+
+    bool operator==(const State& that) const {
+      return fingerprint == that.fingerprint && proto == that.proto &&
+             access == that.access && verify_moves == that.verify_moves &&
+             check_no_overwrite_this == that.check_no_overwrite_this &&
+             check_monitors == that.check_monitors;
+    }
+  };
+
+  // Forget all methods if the class structure of :scope changed since the
+  // last call.
+  void prepare(const Scope& scope);
+
+  // The state of :method, which must have code, when checked with the given
+  // settings.
+  static State get_state(const DexMethod* method,
+                         bool verify_moves,
+                         bool check_no_overwrite_this,
+                         bool check_monitors = false);
+
+  bool is_verified(const DexMethod* method, const State& state) const {
+    return m_verified.get(method, State()) == state;
+  }
+
+  void set_verified(const DexMethod* method, const State& state) {
+    m_verified.update(method, [&state](const DexMethod*, State& s, bool) {
+      s = state;
+    });
+  }
+
+  size_t size() const { return m_verified.size(); }
+
+ private:
+  boost::optional<size_t> m_structure_hash;
+  ConcurrentMap<const DexMethod*, State> m_verified;
+};
@@ -12,7 +12,9 @@
 #include "MethodProfiles.h"
 #include "Resolver.h"
 
+#include <algorithm>
 #include <queue>
+#include <unordered_map>
 
 using namespace method_profiles;
 
@@ -88,6 +90,9 @@ bool InlineForSpeed::should_inline(const DexMethod* caller_method,
   if (!enabled()) {
     return false;
   }
+  if (m_budgeted) {
+    return m_selected.count(CallEdge(caller_method, callee_method)) != 0;
+  }
 
   auto caller_insns = caller_method->get_code()->cfg().num_opcodes();
   // The cost of inlining large methods usually outweighs the benefits
@@ -168,3 +173,107 @@ bool InlineForSpeed::should_inline_per_interaction(
   }
   return result;
 }
+
+double InlineForSpeed::estimated_frequency(const DexMethod* caller,
+                                           const DexMethod* callee,
+                                           size_t sites,
+                                           size_t callee_sites) const {
+  double frequency = 0;
+  for (const auto& pair : m_method_profiles->all_interactions()) {
+    const auto& method_stats = pair.second;
+    auto caller_it = method_stats.find(caller);
+    auto callee_it = method_stats.find(callee);
+    if (caller_it == method_stats.end() || callee_it == method_stats.end() ||
+        caller_it->second.appear_percent < MIN_APPEAR_PERCENT) {
+      continue;
+    }
+    // Without edge profiles, spread the calls of the callee evenly over its
+    // call sites in measured callers.
+    frequency = std::max(frequency, callee_it->second.call_count * sites /
+                                        callee_sites);
+  }
+  return frequency;
+}
+
+void InlineForSpeed::select_within_budget(
+    const std::vector<CallEdge>& call_sites, size_t size_budget) {
+  if (!enabled()) {
+    return;
+  }
+  m_budgeted = true;
+
+  auto is_profiled = [&](const DexMethod* method) {
+    for (const auto& pair : m_method_profiles->all_interactions()) {
+      auto it = pair.second.find(method);
+      if (it != pair.second.end() &&
+          it->second.appear_percent >= MIN_APPEAR_PERCENT) {
+        return true;
+      }
+    }
+    return false;
+  };
+  std::unordered_map<CallEdge, size_t, boost::hash<CallEdge>> edge_sites;
+  std::unordered_map<const DexMethod*, size_t> callee_sites;
+  for (const auto& edge : call_sites) {
+    if (is_profiled(edge.first)) {
+      ++edge_sites[edge];
+      ++callee_sites[edge.second];
+    }
+  }
+
+  struct Candidate {
+    CallEdge edge;
+    double score;
+    size_t size;
+  };
+  // The cost of inlining large methods usually outweighs the benefits
+  constexpr uint32_t MAX_NUM_INSNS = 240;
+  std::vector<Candidate> candidates;
+  for (const auto& p : edge_sites) {
+    const auto* callee = p.first.second;
+    auto callee_insns = callee->get_code()->cfg().num_opcodes();
+    if (callee_insns > MAX_NUM_INSNS) {
+      continue;
+    }
+    auto frequency = estimated_frequency(p.first.first, callee, p.second,
+                                         callee_sites.at(callee));
+    if (frequency == 0) {
+      continue;
+    }
+    // Each inlined call saves the invoke, and the moves into the parameter
+    // registers of the callee.
+    auto savings = 1 + callee->get_proto()->get_args()->size() +
+                   (is_static(callee) ? 0 : 1);
+    candidates.push_back(
+        Candidate{p.first, frequency * savings, callee_insns * p.second});
+  }
+  std::sort(candidates.begin(), candidates.end(),
+            [](const Candidate& a, const Candidate& b) {
+              if (a.score != b.score) {
+                return a.score > b.score;
+              }
+              if (a.size != b.size) {
+                return a.size < b.size;
+              }
+              if (a.edge.first != b.edge.first) {
+                return compare_dexmethods(a.edge.first, b.edge.first);
+              }
+              return compare_dexmethods(a.edge.second, b.edge.second);
+            });
+
+  size_t used = 0;
+  for (const auto& candidate : candidates) {
+    if (used + candidate.size > size_budget) {
+      continue;
+    }
+    used += candidate.size;
+    m_selected.insert(candidate.edge);
+    m_selected_call_sites += edge_sites.at(candidate.edge);
+    TRACE(METH_PROF, 5, "selected %s -> %s, score %f, size %zu",
+          SHOW(candidate.edge.first), SHOW(candidate.edge.second),
+          candidate.score, candidate.size);
+  }
+  TRACE(METH_PROF, 1,
+        "Selected %zu of %zu profiled call edges, %zu of %zu instructions",
+        m_selected.size(), candidates.size(), used, size_budget);
+}
@@ -7,6 +7,12 @@
 
 #pragma once
 
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <boost/functional/hash.hpp>
+
 #include "DexClass.h"
 #include "MethodProfiles.h"
 
@@ -19,8 +25,32 @@ class InlineForSpeed final {
 
   bool enabled() const;
 
+  using CallEdge = std::pair<const DexMethod*, const DexMethod*>;
+
+  /*
+   * Switch from the per-pair hot/warm thresholds to a global budget. Each
+   * call site in :call_sites (one entry per invoke of the callee in the
+   * caller) gets a score of its estimated profiled call frequency times the
+   * estimated savings per call. Starting from the highest score, call sites
+   * are then selected until their callees add up to :size_budget
+   * instructions. Afterwards, should_inline only accepts selected pairs.
+   */
+  void select_within_budget(const std::vector<CallEdge>& call_sites,
+                            size_t size_budget);
+
+  size_t selected_call_sites() const { return m_selected_call_sites; }
+
  private:
   void compute_hot_methods();
+
+  // The estimated number of calls from :caller to :callee, over all call
+  // sites when :callee is called from :callee_sites call sites of profiled
+  // methods altogether.
+  double estimated_frequency(const DexMethod* caller,
+                             const DexMethod* callee,
+                             size_t sites,
+                             size_t callee_sites) const;
+
   bool should_inline_per_interaction(
       const DexMethod* caller_method,
       const DexMethod* callee_method,
@@ -31,4 +61,7 @@ class InlineForSpeed final {
 
   const method_profiles::MethodProfiles* m_method_profiles;
   std::map<std::string, std::pair<double, double>> m_min_scores;
+  bool m_budgeted{false};
+  std::unordered_set<CallEdge, boost::hash<CallEdge>> m_selected;
+  size_t m_selected_call_sites{0};
 };
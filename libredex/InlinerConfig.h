@@ -30,6 +30,17 @@ struct InlinerConfig {
   bool run_local_dce{false};
   bool run_dedup_blocks{false};
   bool shrink_other_methods{true};
+  // Inline and shrink bottom-up in waves of independent methods, rather than
+  // as soon as the callees of a caller are ready.
+  bool wave_scheduling{false};
+  // When inlining for speed, i.e. with method profiles, inline the hottest
+  // call sites until the inlined callees add up to this many instructions,
+  // instead of applying fixed hotness thresholds. 0 disables the budget.
+  size_t profile_guided_size_budget{0};
+  // Don't inline callees whose maximum call depth (see call_depth::compute)
+  // is greater than this, which bounds how many levels of calls bottom-up
+  // inlining can fold into a single method. 0 disables the cap.
+  size_t max_inline_call_depth{0};
   bool unique_inlined_registers{true};
   bool debug{false};
   std::unordered_set<DexType*> whitelist_no_method_limit;
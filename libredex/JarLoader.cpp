@@ -7,7 +7,9 @@
 
 #include <boost/iostreams/device/mapped_file.hpp>
 
+#include <atomic>
 #include <cstdint>
+#include <memory>
 #include <utility>
 #include <vector>
 #include <zlib.h>
@@ -25,6 +27,7 @@
 #include "JarLoader.h"
 #include "Trace.h"
 #include "Util.h"
+#include "WorkQueue.h"
 
 /******************
  * Begin Class Loading code.
@@ -70,15 +73,29 @@ struct cp_entry {
   };
 };
 
-struct cp_field_info {
-  uint16_t aflags;
-  uint16_t nameNdx;
-  uint16_t descNdx;
+struct parsed_member {
+  uint16_t aflags{0};
+  DexString* name{nullptr};
+  // The type of fields, or the proto of methods.
+  DexType* type{nullptr};
+  DexProto* proto{nullptr};
+  uint8_t* attributes{nullptr};
 };
-struct cp_method_info {
-  uint16_t aflags;
-  uint16_t nameNdx;
-  uint16_t descNdx;
+
+/*
+ * A class file parsed up to the point where its class can be created. Parsing
+ * only interns strings, types and protos, so class files can be parsed in
+ * parallel. The constant pool and the attributes point into the class file
+ * buffer, which must outlive this.
+ */
+struct parsed_class {
+  std::vector<cp_entry> cpool;
+  uint16_t aflags{0};
+  DexType* self{nullptr};
+  DexType* super{nullptr};
+  std::vector<DexType*> interfaces;
+  std::vector<parsed_member> fields;
+  std::vector<parsed_member> methods;
 };
 } // namespace
 
@@ -195,22 +212,19 @@ static bool extract_utf8(std::vector<cp_entry>& cpool,
   return true;
 }
 
-static DexField* make_dexfield(std::vector<cp_entry>& cpool,
-                               DexType* self,
-                               cp_field_info& finfo) {
+static bool parse_field(std::vector<cp_entry>& cpool,
+                        uint16_t name_index,
+                        uint16_t desc_index,
+                        parsed_member& field) {
   char dbuffer[MAX_CLASS_NAMELEN];
   char nbuffer[MAX_CLASS_NAMELEN];
-  if (!extract_utf8(cpool, finfo.nameNdx, nbuffer, MAX_CLASS_NAMELEN) ||
-      !extract_utf8(cpool, finfo.descNdx, dbuffer, MAX_CLASS_NAMELEN)) {
-    return nullptr;
+  if (!extract_utf8(cpool, name_index, nbuffer, MAX_CLASS_NAMELEN) ||
+      !extract_utf8(cpool, desc_index, dbuffer, MAX_CLASS_NAMELEN)) {
+    return false;
   }
-  DexString* name = DexString::make_string(nbuffer);
-  DexType* desc = DexType::make_type(dbuffer);
-  DexField* field =
-      static_cast<DexField*>(DexField::make_field(self, name, desc));
-  field->set_access((DexAccessFlags)finfo.aflags);
-  field->set_external();
-  return field;
+  field.name = DexString::make_string(nbuffer);
+  field.type = DexType::make_type(dbuffer);
+  return true;
 }
 
 static DexType* simpleTypeB;
@@ -310,34 +324,48 @@ static DexTypeList* extract_arguments(const char*& buf) {
   return DexTypeList::make_type_list(std::move(args));
 }
 
-static DexMethod* make_dexmethod(std::vector<cp_entry>& cpool,
-                                 DexType* self,
-                                 cp_method_info& finfo) {
+static bool parse_method(std::vector<cp_entry>& cpool,
+                         uint16_t name_index,
+                         uint16_t desc_index,
+                         parsed_member& method) {
   char dbuffer[MAX_CLASS_NAMELEN];
   char nbuffer[MAX_CLASS_NAMELEN];
-  if (!extract_utf8(cpool, finfo.nameNdx, nbuffer, MAX_CLASS_NAMELEN) ||
-      !extract_utf8(cpool, finfo.descNdx, dbuffer, MAX_CLASS_NAMELEN)) {
-    return nullptr;
+  if (!extract_utf8(cpool, name_index, nbuffer, MAX_CLASS_NAMELEN) ||
+      !extract_utf8(cpool, desc_index, dbuffer, MAX_CLASS_NAMELEN)) {
+    return false;
   }
-  DexString* name = DexString::make_string(nbuffer);
+  method.name = DexString::make_string(nbuffer);
   const char* ptr = dbuffer;
   DexTypeList* tlist = extract_arguments(ptr);
-  if (tlist == nullptr) return nullptr;
+  if (tlist == nullptr) return false;
   DexType* rtype = parse_type(ptr);
-  if (rtype == nullptr) return nullptr;
-  DexProto* proto = DexProto::make_proto(rtype, tlist);
-  DexMethod* method =
-      static_cast<DexMethod*>(DexMethod::make_method(self, name, proto));
+  if (rtype == nullptr) return false;
+  method.proto = DexProto::make_proto(rtype, tlist);
+  return true;
+}
+
+static DexField* make_dexfield(DexType* self, const parsed_member& finfo) {
+  DexField* field = static_cast<DexField*>(
+      DexField::make_field(self, finfo.name, finfo.type));
+  field->set_access((DexAccessFlags)finfo.aflags);
+  field->set_external();
+  return field;
+}
+
+static DexMethod* make_dexmethod(DexType* self, const parsed_member& finfo) {
+  DexMethod* method = static_cast<DexMethod*>(
+      DexMethod::make_method(self, finfo.name, finfo.proto));
   if (method->is_concrete()) {
     fprintf(stderr, "Pre-concrete method attempted to load '%s', bailing\n",
             SHOW(method));
     return nullptr;
   }
+  const char* name = finfo.name->c_str();
   uint32_t access = finfo.aflags;
   bool is_virt = true;
-  if (nbuffer[0] == '<') {
+  if (name[0] == '<') {
     is_virt = false;
-    if (nbuffer[1] == 'i') {
+    if (name[1] == 'i') {
       access |= ACC_CONSTRUCTOR;
     }
   } else if (access & (ACC_PRIVATE | ACC_STATIC))
@@ -348,10 +376,7 @@ static DexMethod* make_dexmethod(std::vector<cp_entry>& cpool,
   return method;
 }
 
-static bool parse_class(uint8_t* buffer,
-                        Scope* classes,
-                        attribute_hook_t attr_hook,
-                        const std::string& jar_location = "") {
+static bool parse_class_file(uint8_t* buffer, parsed_class& pc) {
   uint32_t magic = read32(buffer);
   uint16_t vminor DEBUG_ONLY = read16(buffer);
   uint16_t vmajor DEBUG_ONLY = read16(buffer);
@@ -360,7 +385,7 @@ static bool parse_class(uint8_t* buffer,
     fprintf(stderr, "Bad class magic %08x, Bailing\n", magic);
     return false;
   }
-  std::vector<cp_entry> cpool;
+  auto& cpool = pc.cpool;
   cpool.resize(cp_count);
   /* The zero'th entry is always empty.  Java is annoying. */
   for (int i = 1; i < cp_count; i++) {
@@ -370,11 +395,42 @@ static bool parse_class(uint8_t* buffer,
       i++;
     }
   }
-  uint16_t aflags = read16(buffer);
+  pc.aflags = read16(buffer);
   uint16_t clazz = read16(buffer);
   uint16_t super = read16(buffer);
   uint16_t ifcount = read16(buffer);
-  DexType* self = make_dextype_from_cref(cpool, clazz);
+  pc.self = make_dextype_from_cref(cpool, clazz);
+  if (pc.self == nullptr) return false;
+  pc.super = super != 0 ? make_dextype_from_cref(cpool, super) : nullptr;
+  for (int i = 0; i < ifcount; i++) {
+    uint16_t iface = read16(buffer);
+    pc.interfaces.push_back(make_dextype_from_cref(cpool, iface));
+  }
+
+  auto parse_members = [&](std::vector<parsed_member>& members,
+                           bool (*parse)(std::vector<cp_entry>&, uint16_t,
+                                         uint16_t, parsed_member&)) {
+    uint16_t count = read16(buffer);
+    members.resize(count);
+    for (auto& member : members) {
+      member.aflags = read16(buffer);
+      uint16_t name_index = read16(buffer);
+      uint16_t desc_index = read16(buffer);
+      member.attributes = buffer;
+      skip_attributes(buffer);
+      if (!parse(cpool, name_index, desc_index, member)) return false;
+    }
+    return true;
+  };
+  return parse_members(pc.fields, parse_field) &&
+         parse_members(pc.methods, parse_method);
+}
+
+static bool create_class(const parsed_class& pc,
+                         Scope* classes,
+                         const attribute_hook_t& attr_hook,
+                         const std::string& jar_location) {
+  DexType* self = pc.self;
   DexClass* cls = type_class(self);
   if (cls) {
     // We are seeing duplicate classes when parsing jar file
@@ -407,19 +463,13 @@ static bool parse_class(uint8_t* buffer,
 
   ClassCreator cc(self, jar_location);
   cc.set_external();
-  if (super != 0) {
-    DexType* sclazz = make_dextype_from_cref(cpool, super);
-    cc.set_super(sclazz);
-  }
-  cc.set_access((DexAccessFlags)aflags);
-  if (ifcount) {
-    for (int i = 0; i < ifcount; i++) {
-      uint16_t iface = read16(buffer);
-      DexType* iftype = make_dextype_from_cref(cpool, iface);
-      cc.add_interface(iftype);
-    }
+  if (pc.super != nullptr) {
+    cc.set_super(pc.super);
+  }
+  cc.set_access((DexAccessFlags)pc.aflags);
+  for (auto* iftype : pc.interfaces) {
+    cc.add_interface(iftype);
   }
-  uint16_t fcount = read16(buffer);
 
   auto invoke_attr_hook =
       [&](const boost::variant<DexField*, DexMethod*>& field_or_method,
@@ -427,6 +477,7 @@ static bool parse_class(uint8_t* buffer,
         if (attr_hook == nullptr) {
           return;
         }
+        auto& cpool = const_cast<std::vector<cp_entry>&>(pc.cpool);
         uint16_t attributes_count = read16(attrPtr);
         for (uint16_t j = 0; j < attributes_count; j++) {
           uint16_t attribute_name_index = read16(attrPtr);
@@ -445,34 +496,17 @@ static bool parse_class(uint8_t* buffer,
         }
       };
 
-  for (int i = 0; i < fcount; i++) {
-    cp_field_info cpfield;
-    cpfield.aflags = read16(buffer);
-    cpfield.nameNdx = read16(buffer);
-    cpfield.descNdx = read16(buffer);
-    uint8_t* attrPtr = buffer;
-    skip_attributes(buffer);
-    DexField* field = make_dexfield(cpool, self, cpfield);
-    if (field == nullptr) return false;
+  for (const auto& finfo : pc.fields) {
+    DexField* field = make_dexfield(self, finfo);
     cc.add_field(field);
-    invoke_attr_hook({field}, attrPtr);
+    invoke_attr_hook({field}, finfo.attributes);
   }
 
-  uint16_t mcount = read16(buffer);
-  if (mcount) {
-    for (int i = 0; i < mcount; i++) {
-      cp_method_info cpmethod;
-      cpmethod.aflags = read16(buffer);
-      cpmethod.nameNdx = read16(buffer);
-      cpmethod.descNdx = read16(buffer);
-
-      uint8_t* attrPtr = buffer;
-      skip_attributes(buffer);
-      DexMethod* method = make_dexmethod(cpool, self, cpmethod);
-      if (method == nullptr) return false;
-      cc.add_method(method);
-      invoke_attr_hook({method}, attrPtr);
-    }
+  for (const auto& minfo : pc.methods) {
+    DexMethod* method = make_dexmethod(self, minfo);
+    if (method == nullptr) return false;
+    cc.add_method(method);
+    invoke_attr_hook({method}, minfo.attributes);
   }
   DexClass* dc = cc.create();
   if (classes != nullptr) {
@@ -510,6 +544,15 @@ static bool parse_class(uint8_t* buffer,
   return true;
 }
 
+static bool parse_class(uint8_t* buffer,
+                        Scope* classes,
+                        const attribute_hook_t& attr_hook,
+                        const std::string& jar_location = "") {
+  parsed_class pc;
+  return parse_class_file(buffer, pc) &&
+         create_class(pc, classes, attr_hook, jar_location);
+}
+
 bool load_class_file(const std::string& filename, Scope* classes) {
   // It's not exactly efficient to call init_basic_types repeatedly for each
   // class file that we load, but load_class_file should typically only be used
@@ -671,38 +714,57 @@ static bool get_jar_entries(const uint8_t* mapping,
   return true;
 }
 
-static int jar_uncompress(Bytef* dest,
-                          uLongf* destLen,
-                          const Bytef* source,
-                          uLong sourceLen) {
-  z_stream stream;
-  int err;
+namespace {
+/*
+ * A raw inflate stream that is initialized once and reset for every entry, so
+ * that a worker doesn't set up and tear down the zlib state for each class.
+ */
+class JarInflater {
+ public:
+  JarInflater() {
+    memset(&m_stream, 0, sizeof(m_stream));
+    m_init = inflateInit2(&m_stream, -MAX_WBITS);
+  }
 
-  stream.next_in = (Bytef*)source;
-  stream.avail_in = (uInt)sourceLen;
-  stream.next_out = dest;
-  stream.avail_out = (uInt)*destLen;
-  stream.zalloc = (alloc_func)0;
-  stream.zfree = (free_func)0;
+  JarInflater(const JarInflater&) = delete;
+  JarInflater& operator=(const JarInflater&) = delete;
 
-  err = inflateInit2(&stream, -MAX_WBITS);
-  if (err != Z_OK) return err;
+  ~JarInflater() {
+    if (m_init == Z_OK) {
+      inflateEnd(&m_stream);
+    }
+  }
+
+  int uncompress(Bytef* dest,
+                 uLongf* destLen,
+                 const Bytef* source,
+                 uLong sourceLen) {
+    if (m_init != Z_OK) return m_init;
+    int err = inflateReset(&m_stream);
+    if (err != Z_OK) return err;
+
+    m_stream.next_in = (Bytef*)source;
+    m_stream.avail_in = (uInt)sourceLen;
+    m_stream.next_out = dest;
+    m_stream.avail_out = (uInt)*destLen;
 
-  err = inflate(&stream, Z_FINISH);
-  if (err != Z_STREAM_END) {
-    inflateEnd(&stream);
-    return err;
+    err = inflate(&m_stream, Z_FINISH);
+    if (err != Z_STREAM_END) return err;
+    *destLen = m_stream.total_out;
+    return Z_OK;
   }
-  *destLen = stream.total_out;
 
-  err = inflateEnd(&stream);
-  return err;
-}
+ private:
+  z_stream m_stream;
+  int m_init;
+};
+} // namespace
 
 static bool decompress_class(jar_entry& file,
                              const uint8_t* mapping,
                              uint8_t* outbuffer,
-                             ssize_t bufsize) {
+                             ssize_t bufsize,
+                             JarInflater& inflater) {
   if (file.cd_entry.comp_method != kCompMethodDeflate) {
     fprintf(stderr, "Unknown compression method %d, Bailing\n",
             file.cd_entry.comp_method);
@@ -738,7 +800,7 @@ static bool decompress_class(jar_entry& file,
   lfile += pkf.fname_len;
   lfile += pkf.extra_len;
   uLongf dlen = bufsize;
-  int zlibrv = jar_uncompress(outbuffer, &dlen, lfile, pkf.comp_size);
+  int zlibrv = inflater.uncompress(outbuffer, &dlen, lfile, pkf.comp_size);
   if (zlibrv != Z_OK) {
     fprintf(stderr, "uncompress failed with code %d, Bailing\n", zlibrv);
     return false;
@@ -750,18 +812,19 @@ static bool decompress_class(jar_entry& file,
   return true;
 }
 
-static const int kStartBufferSize = 128 * 1024;
+// The number of class files inflated before their classes are created, which
+// bounds the memory held by inflated class files.
+static const size_t kClassBatchSize = 16 * 1024;
 
 static bool process_jar_entries(const char* location,
                                 std::vector<jar_entry>& files,
                                 const uint8_t* mapping,
                                 Scope* classes,
                                 const attribute_hook_t& attr_hook) {
-  ssize_t bufsize = kStartBufferSize;
-  uint8_t* outbuffer = (uint8_t*)malloc(bufsize);
   static char classEndString[] = ".class";
   static size_t classEndStringLen = strlen(classEndString);
   init_basic_types();
+  std::vector<jar_entry*> class_files;
   for (auto& file : files) {
     if (file.cd_entry.ucomp_size == 0) continue;
     if (file.cd_entry.fname_len < (classEndStringLen + 1)) continue;
@@ -770,26 +833,54 @@ static bool process_jar_entries(const char* location,
     uint8_t* endcomp =
         file.filename + (file.cd_entry.fname_len - classEndStringLen);
     if (memcmp(endcomp, classEndString, classEndStringLen) != 0) continue;
-
-    // Resize output if necessary.
-    if (bufsize < file.cd_entry.ucomp_size) {
-      while (bufsize < file.cd_entry.ucomp_size)
-        bufsize *= 2;
-      free(outbuffer);
-      outbuffer = (uint8_t*)malloc(bufsize);
+    class_files.push_back(&file);
+  }
+
+  // Class files are inflated and parsed in parallel, then their classes are
+  // created in the order of the entries, so that duplicate classes are
+  // handled and the classes are listed as if they had been loaded one by one.
+  size_t num_threads = redex_parallel::default_num_threads();
+  std::vector<std::unique_ptr<JarInflater>> inflaters(num_threads);
+  for (size_t batch = 0; batch < class_files.size();
+       batch += kClassBatchSize) {
+    size_t batch_size = std::min(kClassBatchSize, class_files.size() - batch);
+    std::vector<std::unique_ptr<uint8_t[]>> buffers(batch_size);
+    std::vector<parsed_class> parsed(batch_size);
+    std::atomic<bool> failed{false};
+    auto wq = workqueue_foreach<size_t>(
+        [&](sparta::SpartaWorkerState<size_t>* state, size_t i) {
+          if (failed) {
+            return;
+          }
+          auto& inflater = inflaters.at(state->worker_id());
+          if (inflater == nullptr) {
+            inflater = std::make_unique<JarInflater>();
+          }
+          auto& file = *class_files[batch + i];
+          ssize_t bufsize = file.cd_entry.ucomp_size;
+          buffers[i] = std::make_unique<uint8_t[]>(bufsize);
+          if (!decompress_class(file, mapping, buffers[i].get(), bufsize,
+                                *inflater) ||
+              !parse_class_file(buffers[i].get(), parsed[i])) {
+            failed = true;
+          }
+        },
+        num_threads);
+    for (size_t i = 0; i < batch_size; ++i) {
+      wq.add_item(i);
     }
-
-    if (!decompress_class(file, mapping, outbuffer, bufsize)) {
-      free(outbuffer);
+    wq.run_all();
+    if (failed) {
       return false;
     }
 
-    if (!parse_class(outbuffer, classes, attr_hook, location)) {
-      free(outbuffer);
-      return false;
+    for (size_t i = 0; i < batch_size; ++i) {
+      if (!create_class(parsed[i], classes, attr_hook, location)) {
+        return false;
+      }
+      buffers[i].reset();
     }
   }
-  free(outbuffer);
   return true;
 }
 
@@ -10,6 +10,7 @@
 #include <boost/functional/hash.hpp>
 #include <ostream>
 #include <unordered_set>
+#include <vector>
 
 #include "Debug.h"
 
@@ -81,4 +82,11 @@ struct ReasonPtrEqual {
 using ReasonPtrSet =
     std::unordered_set<const Reason*, ReasonPtrHash, ReasonPtrEqual>;
 
+/*
+ * The keep reasons of a single class or member. Reasons are interned by the
+ * RedexContext, so a sorted vector of pointers is enough to keep them unique,
+ * and it is much smaller than a hash set for the few reasons a member has.
+ */
+using ReasonPtrVector = std::vector<const Reason*>;
+
 } // namespace keep_reason
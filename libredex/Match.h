@@ -69,6 +69,21 @@ void find_matches(const std::vector<IRInstruction*>& insns,
   }
 }
 
+// Whether some sequence in `insns` matches `p`. Stops at the first one.
+template <typename P, size_t N = std::tuple_size<P>::value>
+bool contains_match(const std::vector<IRInstruction*>& insns, const P& p) {
+  if (insns.size() < N) {
+    return false;
+  }
+  for (size_t i = 0; i <= insns.size() - N; ++i) {
+    if (m::insns_matcher<P, std::integral_constant<size_t, 0>>::matches_at(
+            i, insns, p)) {
+      return true;
+    }
+  }
+  return false;
+}
+
 // Find all instructions in `insns` that match `p`
 template <typename P>
 void find_insn_match(const std::vector<IRInstruction*>& insns,
@@ -52,29 +52,25 @@ void patch_call_site(DexMethod* callee,
   method_inst->set_method(callee);
 }
 
-void fix_call_sites(const std::vector<DexClass*>& scope,
+/*
+ * Rewrite the invokes in :invokes that resolve to any of :target_methods.
+ * Each distinct method ref is resolved once, instead of once per invoke.
+ */
+void fix_call_sites(const MethodDevirtualizer::InvokeIndex& invokes,
                     const std::unordered_set<DexMethod*>& target_methods,
                     DevirtualizerMetrics& metrics,
                     bool drop_this = false) {
-  const auto fixer = [&target_methods, drop_this](DexMethod* m) -> CallCounter {
-    CallCounter call_counter;
-    IRCode* code = m->get_code();
-    if (code == nullptr) {
-      return call_counter;
+  if (target_methods.empty()) {
+    return;
+  }
+  CallCounter call_counter;
+  MethodSearch type = drop_this ? MethodSearch::Any : MethodSearch::Virtual;
+  for (const auto& pair : invokes) {
+    auto method = resolve_method(pair.first, type);
+    if (method == nullptr || !target_methods.count(method)) {
+      continue;
     }
-
-    for (const MethodItemEntry& mie : InstructionIterable(code)) {
-      IRInstruction* insn = mie.insn;
-      if (!insn->has_method()) {
-        continue;
-      }
-
-      MethodSearch type = drop_this ? MethodSearch::Any : MethodSearch::Virtual;
-      auto method = resolve_method(insn->get_method(), type);
-      if (method == nullptr || !target_methods.count(method)) {
-        continue;
-      }
-
+    for (auto insn : pair.second) {
       always_assert(drop_this || !is_invoke_static(insn->opcode()));
       patch_call_site(method, insn, call_counter);
 
@@ -86,11 +82,7 @@ void fix_call_sites(const std::vector<DexClass*>& scope,
         insn->set_srcs_size(nargs - 1);
       }
     }
-
-    return call_counter;
-  };
-
-  CallCounter call_counter = walk::parallel::methods<CallCounter>(scope, fixer);
+  }
 
   metrics.num_virtual_calls += call_counter.virtuals;
   metrics.num_super_calls += call_counter.supers;
@@ -137,7 +129,7 @@ std::vector<DexMethod*> get_devirtualizable_vmethods(
     const std::vector<DexClass*>& scope,
     const std::vector<DexClass*>& targets) {
   std::vector<DexMethod*> ret;
-  const auto& override_graph = mog::build_graph(scope);
+  auto override_graph = mog::get_cached_graph(scope);
   auto vmethods = mog::get_non_true_virtuals(*override_graph, scope);
   auto targets_set =
       std::unordered_set<DexClass*>(targets.begin(), targets.end());
@@ -200,26 +192,49 @@ void MethodDevirtualizer::verify_and_split(
 }
 
 void MethodDevirtualizer::staticize_methods_not_using_this(
-    const std::vector<DexClass*>& scope,
+    const InvokeIndex& invokes,
     const std::unordered_set<DexMethod*>& methods) {
-  fix_call_sites(scope, methods, m_metrics, true /* drop_this */);
+  fix_call_sites(invokes, methods, m_metrics, true /* drop_this */);
   make_methods_static(methods, false);
   TRACE(VIRT, 1, "Staticized %lu methods not using this", methods.size());
   m_metrics.num_methods_not_using_this += methods.size();
 }
 
 void MethodDevirtualizer::staticize_methods_using_this(
-    const std::vector<DexClass*>& scope,
+    const InvokeIndex& invokes,
     const std::unordered_set<DexMethod*>& methods) {
-  fix_call_sites(scope, methods, m_metrics, false /* drop_this */);
+  fix_call_sites(invokes, methods, m_metrics, false /* drop_this */);
   make_methods_static(methods, true);
   TRACE(VIRT, 1, "Staticized %lu methods using this", methods.size());
   m_metrics.num_methods_using_this += methods.size();
 }
 
+MethodDevirtualizer::InvokeIndex MethodDevirtualizer::build_invoke_index(
+    const Scope& scope) {
+  ConcurrentMap<DexMethodRef*, std::vector<IRInstruction*>> invokes;
+  walk::parallel::opcodes(
+      scope,
+      [](DexMethod*) { return true; },
+      [&](DexMethod*, IRInstruction* insn) {
+        if (!insn->has_method()) {
+          return;
+        }
+        invokes.update(
+            insn->get_method(),
+            [insn](DexMethodRef*, std::vector<IRInstruction*>& insns, bool) {
+              insns.push_back(insn);
+            });
+      });
+  return InvokeIndex(invokes.begin(), invokes.end());
+}
+
 DevirtualizerMetrics MethodDevirtualizer::devirtualize_methods(
     const Scope& scope, const std::vector<DexClass*>& target_classes) {
   reset_metrics();
+  // The four rounds below rewrite disjoint sets of methods, and every invoke
+  // is rewritten at most once, so a single index of the invokes by their
+  // original method ref serves all of them.
+  auto invokes = build_invoke_index(scope);
   auto vmethods = get_devirtualizable_vmethods(scope, target_classes);
   std::unordered_set<DexMethod*> using_this, not_using_this;
   verify_and_split(vmethods, using_this, not_using_this);
@@ -230,11 +245,11 @@ DevirtualizerMetrics MethodDevirtualizer::devirtualize_methods(
         not_using_this.size());
 
   if (m_config.vmethods_not_using_this) {
-    staticize_methods_not_using_this(scope, not_using_this);
+    staticize_methods_not_using_this(invokes, not_using_this);
   }
 
   if (m_config.vmethods_using_this) {
-    staticize_methods_using_this(scope, using_this);
+    staticize_methods_using_this(invokes, using_this);
   }
 
   auto dmethods = get_devirtualizable_dmethods(scope, target_classes);
@@ -248,11 +263,11 @@ DevirtualizerMetrics MethodDevirtualizer::devirtualize_methods(
         not_using_this.size());
 
   if (m_config.dmethods_not_using_this) {
-    staticize_methods_not_using_this(scope, not_using_this);
+    staticize_methods_not_using_this(invokes, not_using_this);
   }
 
   if (m_config.dmethods_using_this) {
-    staticize_methods_using_this(scope, using_this);
+    staticize_methods_using_this(invokes, using_this);
   }
 
   return m_metrics;
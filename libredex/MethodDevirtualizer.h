@@ -45,18 +45,24 @@ class MethodDevirtualizer {
   DevirtualizerMetrics devirtualize_methods(
       const Scope& scope, const std::vector<DexClass*>& target_classes);
 
+  // The invokes of a scope, by the method ref they name.
+  using InvokeIndex =
+      std::unordered_map<DexMethodRef*, std::vector<IRInstruction*>>;
+
  private:
   DevirtualizerConfigs m_config;
   DevirtualizerMetrics m_metrics;
 
   void reset_metrics() { m_metrics = DevirtualizerMetrics(); }
 
+  static InvokeIndex build_invoke_index(const Scope& scope);
+
   void staticize_methods_using_this(
-      const std::vector<DexClass*>& scope,
+      const InvokeIndex& invokes,
       const std::unordered_set<DexMethod*>& methods);
 
   void staticize_methods_not_using_this(
-      const std::vector<DexClass*>& scope,
+      const InvokeIndex& invokes,
       const std::unordered_set<DexMethod*>& methods);
 
   void verify_and_split(const std::vector<DexMethod*>& candidates,
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "MethodLocalTransform.h"
+
+#include <atomic>
+#include <limits>
+
+#include "DexUtil.h"
+
+namespace {
+
+// The walker's per-thread accumulator, which we only use to give each
+// thread a dense id.
+struct Worker {
+  size_t id{std::numeric_limits<size_t>::max()};
+};
+
+struct IgnoreWorkers {
+  void operator()(const Worker&, Worker*) const {}
+};
+
+} // namespace
+
+void run_method_local_transforms(
+    const Scope& scope, const std::vector<MethodLocalTransform*>& transforms) {
+  size_t num_threads = redex_parallel::default_num_threads();
+  for (auto* transform : transforms) {
+    transform->begin(num_threads);
+  }
+  std::atomic<size_t> next_worker_id{0};
+  walk::parallel::methods<Worker, IgnoreWorkers>(
+      scope,
+      [&](DexMethod* method, Worker* worker) {
+        if (worker->id == std::numeric_limits<size_t>::max()) {
+          worker->id = next_worker_id++;
+        }
+        for (auto* transform : transforms) {
+          transform->run(worker->id, method);
+        }
+      },
+      num_threads);
+}
+
+void MethodLocalPass::run_pass(DexStoresVector& stores,
+                               ConfigFiles& conf,
+                               PassManager& mgr) {
+  auto transform = make_method_local_transform(stores, conf, mgr);
+  run_method_local_transforms(build_class_scope(stores), {transform.get()});
+  transform->report(mgr);
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "DexClass.h"
+#include "Pass.h"
+#include "Walkers.h"
+
+/*
+ * The per-method part of a pass that, after some whole-program preparation,
+ * transforms each method independently of all others. `run` is called
+ * concurrently for distinct methods, with a `worker_id` below the number of
+ * threads given to `begin`, and `report` records the pass's metrics once all
+ * methods are done.
+ */
+class MethodLocalTransform {
+ public:
+  virtual ~MethodLocalTransform() = default;
+
+  virtual void begin(size_t num_threads) = 0;
+  virtual void run(size_t worker_id, DexMethod* method) = 0;
+  virtual void report(PassManager& mgr) = 0;
+};
+
+/*
+ * A MethodLocalTransform that sums up the Stats returned for each method,
+ * like walk::parallel::methods<Stats> does, and hands the total to `report`.
+ */
+template <typename Stats>
+class StatsMethodLocalTransform : public MethodLocalTransform {
+ public:
+  using TransformFn = std::function<Stats(DexMethod*)>;
+  using ReportFn = std::function<void(const Stats&, PassManager&)>;
+
+  StatsMethodLocalTransform(TransformFn transform, ReportFn report)
+      : m_transform(std::move(transform)), m_report(std::move(report)) {}
+
+  void begin(size_t num_threads) override {
+    m_stats = std::vector<CacheAligned<Stats>>(num_threads, Stats());
+  }
+
+  void run(size_t worker_id, DexMethod* method) override {
+    Stats& stats = m_stats[worker_id];
+    stats += m_transform(method);
+  }
+
+  void report(PassManager& mgr) override {
+    Stats total = Stats();
+    for (Stats& stats : m_stats) {
+      total += stats;
+    }
+    m_report(total, mgr);
+  }
+
+ private:
+  TransformFn m_transform;
+  ReportFn m_report;
+  std::vector<CacheAligned<Stats>> m_stats;
+};
+
+/*
+ * Runs the transforms back-to-back on each method of the scope, in one
+ * parallel walk, so that each method's code is still hot in the cache for
+ * all but the first. While IRCode::retain_editable_cfgs() is set, the
+ * transforms also share one editable CFG per method.
+ */
+void run_method_local_transforms(
+    const Scope& scope, const std::vector<MethodLocalTransform*>& transforms);
+
+/*
+ * A pass whose run_pass is just its MethodLocalTransform applied to all
+ * methods. With the "fused_local_passes" option, the PassManager runs the
+ * transforms of consecutive MethodLocalPasses together, which changes no
+ * pass's metrics as long as each preparation only relies on facts that the
+ * transforms of the preceding passes preserve. Pass-specific metrics are
+ * still attributed to their own pass.
+ */
+class MethodLocalPass : public Pass {
+ public:
+  explicit MethodLocalPass(const std::string& name) : Pass(name) {}
+
+  void run_pass(DexStoresVector& stores,
+                ConfigFiles& conf,
+                PassManager& mgr) final;
+
+  virtual std::unique_ptr<MethodLocalTransform> make_method_local_transform(
+      DexStoresVector& stores, ConfigFiles& conf, PassManager& mgr) = 0;
+};
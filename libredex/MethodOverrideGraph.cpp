@@ -7,11 +7,16 @@
 
 #include "MethodOverrideGraph.h"
 
+#include <algorithm>
+
+#include <boost/functional/hash.hpp>
 #include <boost/range/adaptor/map.hpp>
 
 #include "BinarySerialization.h"
+#include "ClassHierarchy.h"
 #include "PatriciaTreeMap.h"
 #include "PatriciaTreeSet.h"
+#include "RedexContext.h"
 #include "Timer.h"
 #include "Walkers.h"
 
@@ -247,6 +252,24 @@ std::unique_ptr<const Graph> build_graph(const Scope& scope) {
   return GraphBuilder(scope).run();
 }
 
+std::shared_ptr<const Graph> get_cached_graph(const Scope& scope) {
+  static RedexContextCache<const Graph> cache;
+
+  size_t hash = class_structure_hash(scope);
+  for (const auto* cls : scope) {
+    boost::hash_combine(hash, cls->get_access());
+    for (const auto* vmeth : cls->get_vmethods()) {
+      boost::hash_combine(hash, vmeth);
+      boost::hash_combine(hash, vmeth->get_name());
+      boost::hash_combine(hash, vmeth->get_proto());
+      boost::hash_combine(hash, vmeth->get_access());
+    }
+  }
+  return cache.get(hash, [&] {
+    return std::shared_ptr<const Graph>(build_graph(scope));
+  });
+}
+
 std::unordered_set<const DexMethod*> get_overriding_methods(
     const Graph& graph, const DexMethod* method, bool include_interfaces) {
   std::unordered_set<const DexMethod*> overrides;
@@ -312,4 +335,104 @@ std::unordered_set<DexMethod*> get_non_true_virtuals(const Graph& graph,
   return non_true_virtuals;
 }
 
+CompactGraph::CompactGraph(const Graph& graph) {
+  m_methods.reserve(graph.nodes().size());
+  for (const auto& p : graph.nodes()) {
+    m_methods.push_back(p.first);
+  }
+  std::sort(m_methods.begin(), m_methods.end(), compare_dexmethods);
+  m_indices.reserve(m_methods.size());
+  for (Index i = 0; i < m_methods.size(); ++i) {
+    m_indices.emplace(m_methods[i], i);
+  }
+  std::vector<std::pair<Index, Index>> parent_pairs;
+  std::vector<std::pair<Index, Index>> child_pairs;
+  for (Index i = 0; i < m_methods.size(); ++i) {
+    const auto& node = graph.get_node(m_methods[i]);
+    for (const auto* parent : node.parents) {
+      parent_pairs.emplace_back(i, m_indices.at(parent));
+    }
+    for (const auto* child : node.children) {
+      child_pairs.emplace_back(i, m_indices.at(child));
+    }
+  }
+  // Sort the neighbors of each node, so that traversals are deterministic.
+  std::sort(parent_pairs.begin(), parent_pairs.end());
+  std::sort(child_pairs.begin(), child_pairs.end());
+  m_parents = CompressedSparseRow<Index>(m_methods.size(), parent_pairs);
+  m_children = CompressedSparseRow<Index>(m_methods.size(), child_pairs);
+}
+
+size_t CompactGraph::memory_footprint() const {
+  // Assume about two words of overhead per hash table entry.
+  return m_methods.capacity() * sizeof(const DexMethod*) +
+         m_indices.size() * (sizeof(std::pair<const DexMethod*, Index>) +
+                             2 * sizeof(void*)) +
+         m_parents.memory_footprint() + m_children.memory_footprint();
+}
+
+namespace {
+
+// Collect the methods reachable from :method through :neighbors, without
+// :method itself.
+template <typename Neighbors>
+std::unordered_set<const DexMethod*> collect_transitively(
+    const CompactGraph& graph,
+    const DexMethod* method,
+    bool include_interfaces,
+    const Neighbors& neighbors) {
+  std::unordered_set<const DexMethod*> result;
+  auto start = graph.index(method);
+  if (!start) {
+    return result;
+  }
+  std::unordered_set<CompactGraph::Index> visited{*start};
+  std::vector<CompactGraph::Index> worklist{*start};
+  while (!worklist.empty()) {
+    auto current = worklist.back();
+    worklist.pop_back();
+    for (auto next : neighbors(current)) {
+      if (!visited.emplace(next).second) {
+        continue;
+      }
+      const auto* next_method = graph.method(next);
+      if (include_interfaces ||
+          !is_interface(type_class(next_method->get_class()))) {
+        result.emplace(next_method);
+      }
+      worklist.push_back(next);
+    }
+  }
+  return result;
+}
+
+} // namespace
+
+std::unordered_set<const DexMethod*> get_overriding_methods(
+    const CompactGraph& graph,
+    const DexMethod* method,
+    bool include_interfaces) {
+  return collect_transitively(
+      graph, method, include_interfaces,
+      [&](CompactGraph::Index index) { return graph.children(index); });
+}
+
+std::unordered_set<const DexMethod*> get_overridden_methods(
+    const CompactGraph& graph,
+    const DexMethod* method,
+    bool include_interfaces) {
+  return collect_transitively(
+      graph, method, include_interfaces,
+      [&](CompactGraph::Index index) { return graph.parents(index); });
+}
+
+bool is_true_virtual(const CompactGraph& graph, const DexMethod* method) {
+  if (is_abstract(method)) {
+    return true;
+  }
+  auto index = graph.index(method);
+  return index &&
+         (!graph.parents(*index).empty() || !graph.children(*index).empty());
+}
+
 } // namespace method_override_graph
@@ -7,6 +7,11 @@
 
 #pragma once
 
+#include <unordered_map>
+
+#include <boost/optional.hpp>
+
+#include "CompressedSparseRow.h"
 #include "ConcurrentContainers.h"
 #include "DexClass.h"
 #include "DexStore.h"
@@ -25,6 +30,14 @@ class Graph;
  */
 std::unique_ptr<const Graph> build_graph(const Scope&);
 
+/*
+ * Return the graph of :scope, shared across all callers (typically the passes
+ * of a pipeline) for as long as the class structure of the scope, see
+ * get_cached_class_hierarchy, and the virtual methods of its classes, i.e.
+ * their identities, names, protos and access flags, stay the same.
+ */
+std::shared_ptr<const Graph> get_cached_graph(const Scope&);
+
 /*
  * Returns all the methods that override :method. The set does *not* include
  * :method itself.
@@ -86,4 +99,55 @@ class Graph {
   ConcurrentMap<const DexMethod*, Node> m_nodes;
 };
 
+/*
+ * A frozen copy of a Graph for traversal-heavy users. Methods are numbered
+ * densely in a deterministic order, and their parents and children are kept
+ * in compressed-sparse-row form, which takes a fraction of the memory of the
+ * per-node hash sets of a Graph and is much friendlier to the cache.
+ */
+class CompactGraph {
+ public:
+  using Index = uint32_t;
+  using Range = CompressedSparseRow<Index>::Range;
+
+  explicit CompactGraph(const Graph& graph);
+
+  size_t size() const { return m_methods.size(); }
+
+  // The index of :method, or boost::none if it neither overrides nor is
+  // overridden by any method.
+  boost::optional<Index> index(const DexMethod* method) const {
+    auto it = m_indices.find(method);
+    if (it == m_indices.end()) {
+      return boost::none;
+    }
+    return it->second;
+  }
+
+  const DexMethod* method(Index index) const { return m_methods[index]; }
+
+  Range parents(Index index) const { return m_parents.neighbors(index); }
+  Range children(Index index) const { return m_children.neighbors(index); }
+
+  size_t memory_footprint() const;
+
+ private:
+  std::vector<const DexMethod*> m_methods;
+  std::unordered_map<const DexMethod*, Index> m_indices;
+  CompressedSparseRow<Index> m_parents;
+  CompressedSparseRow<Index> m_children;
+};
+
+std::unordered_set<const DexMethod*> get_overriding_methods(
+    const CompactGraph& graph,
+    const DexMethod* method,
+    bool include_interfaces = false);
+
+std::unordered_set<const DexMethod*> get_overridden_methods(
+    const CompactGraph& graph,
+    const DexMethod* method,
+    bool include_interfaces = false);
+
+bool is_true_virtual(const CompactGraph& graph, const DexMethod* method);
+
 } // namespace method_override_graph
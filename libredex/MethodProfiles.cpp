@@ -7,17 +7,21 @@
 
 #include "MethodProfiles.h"
 
+#include <algorithm>
+#include <atomic>
+#include <boost/filesystem.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <fstream>
 #include <iostream>
 #include <stdio.h>
 #include <stdlib.h>
 
 #include "Timer.h"
 #include "Trace.h"
+#include "WorkQueue.h"
 
 using namespace method_profiles;
 
-extern int errno;
-
 const StatsMap& MethodProfiles::method_stats(
     const std::string& interaction_id) const {
   const auto& search1 = m_method_stats.find(interaction_id);
@@ -38,6 +42,68 @@ const StatsMap& MethodProfiles::method_stats(
   return empty_map;
 }
 
+namespace {
+
+constexpr char BINARY_MAGIC[8] = {'R', 'D', 'X', 'M', 'P', 'R', 'O', 'F'};
+constexpr uint32_t BINARY_VERSION = 1;
+
+// name index, interaction index, appear100, avg_call, avg_rank100 and
+// min_api_level, unpadded.
+constexpr size_t BINARY_ROW_SIZE =
+    2 * sizeof(uint32_t) + 3 * sizeof(double) + sizeof(uint8_t);
+
+const DexMethodRef* resolve_ref(const char* name, uint32_t name_size) {
+  std::string descriptor(name, name_size);
+  auto ref = DexMethod::get_method</*kCheckFormat=*/true>(descriptor);
+  if (ref == nullptr) {
+    TRACE(METH_PROF, 6, "failed to resolve %s", descriptor.c_str());
+  }
+  return ref;
+}
+
+class BinaryReader {
+ public:
+  BinaryReader(const char* data, size_t size)
+      : m_cur(data), m_end(data + size) {}
+
+  template <typename T>
+  bool read(T* value) {
+    if ((size_t)(m_end - m_cur) < sizeof(T)) {
+      return false;
+    }
+    memcpy(value, m_cur, sizeof(T));
+    m_cur += sizeof(T);
+    return true;
+  }
+
+  bool read_string(const char** str, uint32_t* size) {
+    if (!read(size) || (size_t)(m_end - m_cur) < *size) {
+      return false;
+    }
+    *str = m_cur;
+    m_cur += *size;
+    return true;
+  }
+
+  size_t remaining() const { return m_end - m_cur; }
+
+ private:
+  const char* m_cur;
+  const char* m_end;
+};
+
+template <typename T>
+void write_value(std::ostream& os, const T& value) {
+  os.write((const char*)&value, sizeof(T));
+}
+
+void write_string(std::ostream& os, const char* str, uint32_t size) {
+  write_value(os, size);
+  os.write(str, size);
+}
+
+} // namespace
+
 bool MethodProfiles::parse_stats_file(const std::string& csv_filename) {
   TRACE(METH_PROF, 3, "input csv filename: %s", csv_filename.c_str());
   if (csv_filename.empty()) {
@@ -46,59 +112,301 @@ bool MethodProfiles::parse_stats_file(const std::string& csv_filename) {
   }
   Timer t("Parsing agg_method_stats_file");
 
-  auto cleanup = [](FILE* fp, char* line = nullptr) {
-    if (fp) {
-      fclose(fp);
-    }
-    if (line) {
-      // getline allocates buffer space and expects us to free it
-      free(line);
-    }
-  };
-
-  // Using C-style file reading and parsing because it's faster than the
-  // iostreams equivalent and we expect to read very large csv files.
-  FILE* fp = fopen(csv_filename.c_str(), "r");
-  if (fp == nullptr) {
-    std::cerr << "FAILED to open " << csv_filename << ": " << strerror(errno)
+  boost::system::error_code ec;
+  auto file_size = boost::filesystem::file_size(csv_filename, ec);
+  if (ec) {
+    std::cerr << "FAILED to open " << csv_filename << ": " << ec.message()
               << "\n";
-    cleanup(fp);
     return false;
   }
-
-  // getline will allocate a buffer and put a pointer to it here
-  char* line = nullptr;
-  size_t len = 0;
-  bool first = true;
-  while (getline(&line, &len, fp) != -1) {
-    bool success = parse_line(line, first);
-    if (!success) {
-      cleanup(fp, line);
-      return false;
-    }
-    first = false;
+  if (file_size == 0) {
+    TRACE(METH_PROF, 1, "MethodProfiles successfully parsed 0 rows");
+    return true;
   }
-  if (errno != 0) {
-    std::cerr << "FAILED to read a line: " << strerror(errno) << "\n";
-    cleanup(fp, line);
+  // The whole file is mapped rather than read line by line: the rows are
+  // parsed in parallel, and the parsed names point into the mapping until
+  // they are resolved.
+  boost::iostreams::mapped_file_source file;
+  try {
+    file.open(csv_filename);
+  } catch (const std::exception& e) {
+    std::cerr << "FAILED to open " << csv_filename << ": " << e.what()
+              << "\n";
+    return false;
+  }
+  std::vector<ParsedChunk> chunks;
+  if (!parse_file(file.data(), file.size(), /* resolve */ true, &chunks)) {
     return false;
   }
 
+  // Group the rows by interaction, in file order so that the first row for a
+  // method wins as before, and fill each interaction's map in parallel.
+  std::vector<StatsMap*> maps;
+  std::unordered_map<std::string, uint32_t> interaction_indices;
+  std::vector<std::vector<const ParsedRow*>> rows_by_interaction;
   size_t total_rows = 0;
+  for (const auto& chunk : chunks) {
+    std::vector<uint32_t> global_index;
+    global_index.reserve(chunk.interactions.size());
+    for (const auto& interaction_id : chunk.interactions) {
+      auto inserted =
+          interaction_indices.emplace(interaction_id, maps.size());
+      if (inserted.second) {
+        maps.push_back(&m_method_stats[interaction_id]);
+        rows_by_interaction.emplace_back();
+      }
+      global_index.push_back(inserted.first->second);
+    }
+    for (const auto& row : chunk.rows) {
+      if (row.ref != nullptr) {
+        rows_by_interaction[global_index[row.interaction]].push_back(&row);
+      }
+    }
+  }
+  auto wq = workqueue_foreach<uint32_t>([&](uint32_t i) {
+    auto& map = *maps[i];
+    map.reserve(rows_by_interaction[i].size());
+    for (const auto* row : rows_by_interaction[i]) {
+      map.emplace(row->ref, row->stats);
+    }
+  });
+  for (uint32_t i = 0; i < maps.size(); ++i) {
+    wq.add_item(i);
+  }
+  wq.run_all();
+
   for (const auto& pair : m_method_stats) {
     total_rows += pair.second.size();
   }
   TRACE(METH_PROF, 1, "MethodProfiles successfully parsed %zu rows",
         total_rows);
-  cleanup(fp, line);
   return true;
 }
 
-bool MethodProfiles::parse_line(char* line, bool first) {
-  if (first) {
-    return parse_header(line);
+bool MethodProfiles::parse_file(const char* data,
+                                size_t size,
+                                bool resolve,
+                                std::vector<ParsedChunk>* chunks) {
+  if (size >= sizeof(BINARY_MAGIC) &&
+      memcmp(data, BINARY_MAGIC, sizeof(BINARY_MAGIC)) == 0) {
+    return parse_binary(data, size, resolve, chunks);
   }
+  return parse_csv(data, size, resolve, chunks);
+}
 
+bool MethodProfiles::parse_csv(const char* data,
+                               size_t size,
+                               bool resolve,
+                               std::vector<ParsedChunk>* chunks) {
+  const char* end = data + size;
+  const char* header_end = std::find(data, end, '\n');
+  std::string header(data, header_end);
+  if (!parse_header(&header[0])) {
+    return false;
+  }
+  const char* rows_begin = header_end == end ? end : header_end + 1;
+
+  // Split the rows into a few chunks per thread, at line boundaries.
+  const size_t num_chunks = redex_parallel::default_num_threads() * 4;
+  const size_t chunk_size = (end - rows_begin) / num_chunks + 1;
+  std::vector<std::pair<const char*, const char*>> ranges;
+  for (const char* begin = rows_begin; begin < end;) {
+    const char* chunk_end =
+        (size_t)(end - begin) <= chunk_size ? end : begin + chunk_size;
+    chunk_end = chunk_end == end ? end : std::find(chunk_end, end, '\n');
+    chunk_end = chunk_end == end ? end : chunk_end + 1;
+    ranges.emplace_back(begin, chunk_end);
+    begin = chunk_end;
+  }
+
+  chunks->resize(ranges.size());
+  std::atomic<bool> success{true};
+  auto wq = workqueue_foreach<size_t>([&](size_t i) {
+    auto& chunk = (*chunks)[i];
+    std::string line;
+    for (const char* cur = ranges[i].first; cur < ranges[i].second;) {
+      const char* line_end = std::find(cur, ranges[i].second, '\n');
+      // strtok_r needs a writable, terminated copy of the line.
+      line.assign(cur, line_end);
+      if (!parse_line(&line[0], cur, &chunk)) {
+        success = false;
+        return;
+      }
+      cur = line_end + 1;
+    }
+    if (resolve) {
+      for (auto& row : chunk.rows) {
+        row.ref = resolve_ref(row.name, row.name_size);
+      }
+    }
+  });
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    wq.add_item(i);
+  }
+  wq.run_all();
+  return success;
+}
+
+bool MethodProfiles::parse_binary(const char* data,
+                                  size_t size,
+                                  bool resolve,
+                                  std::vector<ParsedChunk>* chunks) {
+  BinaryReader reader(data + sizeof(BINARY_MAGIC),
+                      size - sizeof(BINARY_MAGIC));
+  auto truncated = []() {
+    std::cerr << "FAILED to parse binary method profile: truncated\n";
+    return false;
+  };
+  uint32_t version;
+  if (!reader.read(&version)) {
+    return truncated();
+  }
+  if (version != BINARY_VERSION) {
+    std::cerr << "FAILED to parse binary method profile: unknown version "
+              << version << "\n";
+    return false;
+  }
+
+  chunks->resize(1);
+  auto& chunk = chunks->front();
+  uint32_t num_interactions;
+  if (!reader.read(&num_interactions)) {
+    return truncated();
+  }
+  for (uint32_t i = 0; i < num_interactions; ++i) {
+    const char* str;
+    uint32_t str_size;
+    if (!reader.read_string(&str, &str_size)) {
+      return truncated();
+    }
+    chunk.interactions.emplace_back(str, str_size);
+  }
+
+  uint32_t num_names;
+  if (!reader.read(&num_names)) {
+    return truncated();
+  }
+  std::vector<std::pair<const char*, uint32_t>> names(num_names);
+  for (auto& name : names) {
+    if (!reader.read_string(&name.first, &name.second)) {
+      return truncated();
+    }
+  }
+  // Every name is only stored, and so resolved, once.
+  std::vector<const DexMethodRef*> refs(num_names);
+  if (resolve) {
+    auto wq = workqueue_foreach<uint32_t>([&](uint32_t i) {
+      refs[i] = resolve_ref(names[i].first, names[i].second);
+    });
+    for (uint32_t i = 0; i < num_names; ++i) {
+      wq.add_item(i);
+    }
+    wq.run_all();
+  }
+
+  uint32_t num_rows;
+  if (!reader.read(&num_rows) ||
+      reader.remaining() < (size_t)num_rows * BINARY_ROW_SIZE) {
+    return truncated();
+  }
+  chunk.rows.resize(num_rows);
+  for (auto& row : chunk.rows) {
+    uint32_t name_index;
+    reader.read(&name_index);
+    reader.read(&row.interaction);
+    reader.read(&row.stats.appear_percent);
+    reader.read(&row.stats.call_count);
+    reader.read(&row.stats.order_percent);
+    reader.read(&row.stats.min_api_level);
+    if (name_index >= num_names || row.interaction >= num_interactions) {
+      std::cerr << "FAILED to parse binary method profile: bad row\n";
+      return false;
+    }
+    row.name = names[name_index].first;
+    row.name_size = names[name_index].second;
+    row.ref = refs[name_index];
+  }
+  return true;
+}
+
+bool MethodProfiles::convert_to_binary(const std::string& input,
+                                       const std::string& output) {
+  boost::iostreams::mapped_file_source file;
+  try {
+    file.open(input);
+  } catch (const std::exception& e) {
+    std::cerr << "FAILED to open " << input << ": " << e.what() << "\n";
+    return false;
+  }
+  MethodProfiles profiles;
+  std::vector<ParsedChunk> chunks;
+  if (!profiles.parse_file(file.data(), file.size(), /* resolve */ false,
+                           &chunks)) {
+    return false;
+  }
+
+  std::vector<std::string> interactions;
+  std::unordered_map<std::string, uint32_t> interaction_indices;
+  std::vector<std::pair<const char*, uint32_t>> names;
+  std::unordered_map<std::string, uint32_t> name_indices;
+  std::vector<std::pair<uint32_t, uint32_t>> row_indices;
+  for (const auto& chunk : chunks) {
+    std::vector<uint32_t> global_index;
+    for (const auto& interaction_id : chunk.interactions) {
+      auto inserted =
+          interaction_indices.emplace(interaction_id, interactions.size());
+      if (inserted.second) {
+        interactions.push_back(interaction_id);
+      }
+      global_index.push_back(inserted.first->second);
+    }
+    for (const auto& row : chunk.rows) {
+      auto inserted = name_indices.emplace(
+          std::string(row.name, row.name_size), names.size());
+      if (inserted.second) {
+        names.emplace_back(row.name, row.name_size);
+      }
+      row_indices.emplace_back(inserted.first->second,
+                               global_index[row.interaction]);
+    }
+  }
+
+  std::ofstream os(output, std::ios::binary | std::ios::trunc);
+  os.write(BINARY_MAGIC, sizeof(BINARY_MAGIC));
+  write_value(os, BINARY_VERSION);
+  write_value(os, (uint32_t)interactions.size());
+  for (const auto& interaction_id : interactions) {
+    write_string(os, interaction_id.data(), interaction_id.size());
+  }
+  write_value(os, (uint32_t)names.size());
+  for (const auto& name : names) {
+    write_string(os, name.first, name.second);
+  }
+  write_value(os, (uint32_t)row_indices.size());
+  size_t i = 0;
+  for (const auto& chunk : chunks) {
+    for (const auto& row : chunk.rows) {
+      write_value(os, row_indices[i].first);
+      write_value(os, row_indices[i].second);
+      write_value(os, row.stats.appear_percent);
+      write_value(os, row.stats.call_count);
+      write_value(os, row.stats.order_percent);
+      write_value(os, row.stats.min_api_level);
+      ++i;
+    }
+  }
+  if (!os) {
+    std::cerr << "FAILED to write " << output << "\n";
+    return false;
+  }
+  TRACE(METH_PROF, 1, "Wrote %zu rows (%zu methods) to %s",
+        row_indices.size(), names.size(), output.c_str());
+  return true;
+}
+
+bool MethodProfiles::parse_line(char* line,
+                                const char* line_in_file,
+                                ParsedChunk* chunk) {
   auto parse_byte = [](const char* tok) -> uint8_t {
     char* rest = nullptr;
     const auto result = static_cast<uint8_t>(strtoul(tok, &rest, 10));
@@ -118,9 +426,10 @@ bool MethodProfiles::parse_line(char* line, bool first) {
     return result;
   };
 
-  Stats stats;
+  ParsedRow row;
+  row.name = nullptr;
+  row.name_size = 0;
   std::string interaction_id = "";
-  DexMethodRef* ref = nullptr;
   auto parse_cell = [&](char* tok, uint32_t i) -> bool {
     switch (i) {
     case INDEX:
@@ -128,30 +437,28 @@ bool MethodProfiles::parse_line(char* line, bool first) {
       // the file)
       return true;
     case NAME:
-      ref = DexMethod::get_method</*kCheckFormat=*/true>(tok);
-      if (ref == nullptr) {
-        TRACE(METH_PROF, 6, "failed to resolve %s", tok);
-      }
+      row.name = line_in_file + (tok - line);
+      row.name_size = strlen(tok);
       return true;
     case APPEAR100:
-      stats.appear_percent = parse_double(tok);
+      row.stats.appear_percent = parse_double(tok);
       return true;
     case APPEAR_NUMBER:
       // Don't need this raw data. appear_percent is the same thing but
       // normalized
       return true;
     case AVG_CALL:
-      stats.call_count = parse_double(tok);
+      row.stats.call_count = parse_double(tok);
       return true;
     case AVG_ORDER:
       // Don't need this raw data. order_percent is the same thing but
       // normalized
       return true;
     case AVG_RANK100:
-      stats.order_percent = parse_double(tok);
+      row.stats.order_percent = parse_double(tok);
       return true;
     case MIN_API_LEVEL:
-      stats.min_api_level = parse_byte(tok);
+      row.stats.min_api_level = parse_byte(tok);
       return true;
     default:
       const auto& search = m_optional_columns.find(i);
@@ -173,11 +480,25 @@ bool MethodProfiles::parse_line(char* line, bool first) {
   if (!success) {
     return false;
   }
-  if (ref != nullptr) {
-    TRACE(METH_PROF, 6, "(%s, %s) -> {%f, %f, %f, %u}", SHOW(ref),
-          interaction_id.c_str(), stats.appear_percent, stats.call_count,
-          stats.order_percent, stats.min_api_level);
-    m_method_stats[interaction_id].emplace(ref, stats);
+  if (row.name != nullptr) {
+    // Lines are mostly grouped by interaction, so only the last one needs to
+    // be checked to intern it.
+    auto& interactions = chunk->interactions;
+    if (!interactions.empty() && interactions.back() == interaction_id) {
+      row.interaction = interactions.size() - 1;
+    } else {
+      auto it = std::find(interactions.begin(), interactions.end(),
+                          interaction_id);
+      row.interaction = it - interactions.begin();
+      if (it == interactions.end()) {
+        interactions.push_back(interaction_id);
+      }
+    }
+    TRACE(METH_PROF, 6, "(%.*s, %s) -> {%f, %f, %f, %u}",
+          (int)row.name_size, row.name, interaction_id.c_str(),
+          row.stats.appear_percent, row.stats.call_count,
+          row.stats.order_percent, row.stats.min_api_level);
+    chunk->rows.push_back(row);
   }
   return true;
 }
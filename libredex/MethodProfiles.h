@@ -50,6 +50,8 @@ class MethodProfiles {
  public:
   MethodProfiles() {}
 
+  // Accepts either a csv file or the binary format that convert_to_binary()
+  // writes.
   bool initialize(const std::string& csv_filename) {
     m_initialized = true;
     bool success = parse_stats_file(csv_filename);
@@ -89,18 +91,55 @@ class MethodProfiles {
     return it->second;
   }
 
+  // Write the profile in :input (csv or binary) to :output in the binary
+  // format. Method names are stored once, however many interactions they
+  // appear in, and the stats as fixed-size rows, so loading it needs no
+  // number parsing and resolves each name once. Nothing is resolved here, so
+  // this doesn't need the dex files the profile is for.
+  static bool convert_to_binary(const std::string& input,
+                                const std::string& output);
+
+  // Rows of a profile, unresolved; the names point into the parsed file.
+  struct ParsedRow {
+    const char* name;
+    uint32_t name_size;
+    // Index into ParsedChunk::interactions
+    uint32_t interaction;
+    Stats stats;
+    const DexMethodRef* ref{nullptr};
+  };
+  struct ParsedChunk {
+    std::vector<std::string> interactions;
+    std::vector<ParsedRow> rows;
+  };
+
  private:
   AllInteractions m_method_stats;
   bool m_initialized{false};
   // A map from column index to column header
   std::unordered_map<uint32_t, std::string> m_optional_columns;
 
-  // Read a "simple" csv file (no quoted commas or extra spaces) and populate
-  // m_method_stats
+  // Read a "simple" csv file (no quoted commas or extra spaces), or a binary
+  // one, and populate m_method_stats
   bool parse_stats_file(const std::string& csv_filename);
-  // Read a line from the "simple" csv file and put an entry into
-  // m_method_stats
-  bool parse_line(char* line, bool first);
+  // Split the file's rows into chunks, parsed in parallel. With :resolve, the
+  // names are looked up (in parallel, too) and the rows' refs are set.
+  bool parse_file(const char* data,
+                  size_t size,
+                  bool resolve,
+                  std::vector<ParsedChunk>* chunks);
+  bool parse_csv(const char* data,
+                 size_t size,
+                 bool resolve,
+                 std::vector<ParsedChunk>* chunks);
+  static bool parse_binary(const char* data,
+                           size_t size,
+                           bool resolve,
+                           std::vector<ParsedChunk>* chunks);
+  // Read a line (without its newline) from the "simple" csv file and append
+  // its row to :chunk. :line_in_file is where :line was copied from, so that
+  // the row's name can point there.
+  bool parse_line(char* line, const char* line_in_file, ParsedChunk* chunk);
   // Parse the first line and make sure it matches our expectations
   bool parse_header(char* line);
 
@@ -22,13 +22,22 @@ bool has_catch_all(const cfg::ControlFlowGraph& cfg, const cfg::Block* block) {
       });
 }
 
+bool in_try_region(const cfg::Block* block) {
+  const auto& succs = block->succs();
+  return std::any_of(succs.begin(), succs.end(), [](const auto* edge) {
+    return edge->type() == cfg::EDGE_THROW;
+  });
+}
+
 } // namespace
 
 namespace monitor_count {
 
 void mark_sketchy_methods_with_no_optimize(const Scope& scope) {
   walk::parallel::code(scope, [](DexMethod* method, IRCode& code) {
-    code.build_cfg();
+    // The analysis only reads the code, so a non-editable CFG will do, and
+    // the code isn't rewritten by linearizing it again.
+    code.build_cfg(/* editable */ false);
     auto bad_insn = find_synchronized_throw_outside_catch_all(code);
     if (bad_insn != nullptr) {
       TRACE(MONITOR, 3,
@@ -42,13 +51,18 @@ void mark_sketchy_methods_with_no_optimize(const Scope& scope) {
 }
 
 IRInstruction* find_synchronized_throw_outside_catch_all(const IRCode& code) {
-  auto& cfg = code.cfg();
+  return find_synchronized_throw_outside_catch_all(code.cfg());
+}
+
+IRInstruction* find_synchronized_throw_outside_catch_all(
+    const cfg::ControlFlowGraph& cfg, bool only_in_try_regions) {
   Analyzer analyzer(cfg);
   analyzer.run(MonitorCountDomain(0));
 
   for (auto* block : cfg.blocks()) {
     auto count = analyzer.get_entry_state_at(block);
-    if (!count.is_value()) {
+    if (!count.is_value() ||
+        (only_in_try_regions && !in_try_region(block))) {
       continue;
     }
     for (auto& mie : InstructionIterable(block)) {
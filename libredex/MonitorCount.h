@@ -35,6 +35,14 @@ void mark_sketchy_methods_with_no_optimize(const Scope&);
 
 IRInstruction* find_synchronized_throw_outside_catch_all(const IRCode&);
 
+/*
+ * Like the above, on a CFG of any kind. With :only_in_try_regions, only the
+ * throwing opcodes that the verifier actually checks count, i.e. those with
+ * some catch handler but no catch-all. These fail verification.
+ */
+IRInstruction* find_synchronized_throw_outside_catch_all(
+    const cfg::ControlFlowGraph& cfg, bool only_in_try_regions = false);
+
 using MonitorCountDomain = sparta::ConstantAbstractDomain<uint32_t>;
 
 class Analyzer : public ir_analyzer::BaseIRAnalyzer<MonitorCountDomain> {
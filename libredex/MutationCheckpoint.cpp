@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "MutationCheckpoint.h"
+
+#include "IRCode.h"
+#include "Walkers.h"
+
+MutationCheckpoint::MutationCheckpoint(const Scope& scope) {
+  walk::code(scope, [&](DexMethod* method, IRCode& code) {
+    m_epochs.emplace(method, code.get_mutation_epoch());
+  });
+}
+
+bool MutationCheckpoint::changed(const DexMethod* method) const {
+  auto it = m_epochs.find(method);
+  return it == m_epochs.end() ||
+         it->second != method->get_code()->get_mutation_epoch();
+}
+
+std::vector<DexMethod*> MutationCheckpoint::changed_methods(
+    const Scope& scope) const {
+  std::vector<DexMethod*> changed_methods;
+  walk::code(scope, [&](DexMethod* method, IRCode&) {
+    if (changed(method)) {
+      changed_methods.push_back(method);
+    }
+  });
+  return changed_methods;
+}
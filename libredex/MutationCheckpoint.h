@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "DexClass.h"
+
+/*
+ * Remembers the mutation epochs (see IRCode::get_mutation_epoch) of the code
+ * of all methods in a scope, so that the methods whose code changed since can
+ * be listed later on, e.g. to only revisit those between passes.
+ *
+ * Like the epochs themselves, this only notices changes made through IRCode,
+ * including any editable cfg that was built in the meantime.
+ */
+class MutationCheckpoint final {
+ public:
+  explicit MutationCheckpoint(const Scope& scope);
+
+  /*
+   * Whether :method, which must have code, got new code or changed code since
+   * the checkpoint. Methods that didn't have code then count as changed.
+   */
+  bool changed(const DexMethod* method) const;
+
+  std::vector<DexMethod*> changed_methods(const Scope& scope) const;
+
+ private:
+  std::unordered_map<const DexMethod*, uint64_t> m_epochs;
+};
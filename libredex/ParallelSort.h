@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <iterator>
+
+#include "WorkQueue.h"
+
+namespace redex_parallel {
+
+/*
+ * Sorts the range like std::sort, but splits it into one chunk per thread,
+ * sorts the chunks concurrently and then merges them pairwise, also
+ * concurrently. The comparator must be safe to call from several threads.
+ *
+ * When the comparator is a strict total order on the elements of the range
+ * (e.g. interned strings or types), the result is the same as std::sort's.
+ */
+template <class RandomIt, class Compare>
+void sort(RandomIt first,
+          RandomIt last,
+          Compare cmp,
+          size_t num_threads = default_num_threads()) {
+  // Below this many elements per chunk, the threads cost more than they save.
+  constexpr size_t kMinChunkSize = 4096;
+  size_t size = std::distance(first, last);
+  size_t num_chunks = 1;
+  while (num_chunks * 2 <= num_threads &&
+         size / (num_chunks * 2) >= kMinChunkSize) {
+    num_chunks *= 2;
+  }
+  if (num_chunks == 1) {
+    std::sort(first, last, cmp);
+    return;
+  }
+
+  size_t chunk_size = (size + num_chunks - 1) / num_chunks;
+  auto chunk_begin = [&](size_t i) {
+    return first + std::min(size, i * chunk_size);
+  };
+  auto sort_wq = workqueue_foreach<size_t>(
+      [&](size_t i) { std::sort(chunk_begin(i), chunk_begin(i + 1), cmp); },
+      num_chunks);
+  for (size_t i = 0; i < num_chunks; ++i) {
+    sort_wq.add_item(i);
+  }
+  sort_wq.run_all();
+
+  // Each round merges pairs of adjacent sorted runs of `width` chunks.
+  for (size_t width = 1; width < num_chunks; width *= 2) {
+    auto merge_wq = workqueue_foreach<size_t>(
+        [&](size_t i) {
+          std::inplace_merge(chunk_begin(i), chunk_begin(i + width),
+                             chunk_begin(i + 2 * width), cmp);
+        },
+        num_chunks / (2 * width));
+    for (size_t i = 0; i < num_chunks; i += 2 * width) {
+      merge_wq.add_item(i);
+    }
+    merge_wq.run_all();
+  }
+}
+
+} // namespace redex_parallel
@@ -43,6 +43,15 @@ class Pass : public Configurable {
 
   virtual void destroy_analysis_result() {}
 
+  /**
+   * Return true if this pass only looks at code through the editable CFG of
+   * the method it is working on (via build_cfg(true) or ScopedCFG), so that it
+   * may find and leave one already built instead of IRList form. With the
+   * "keep_editable_cfgs" option, a run of such passes then doesn't rebuild
+   * and linearize the CFG each time.
+   */
+  virtual bool is_editable_cfg_friendly() const { return false; }
+
   /**
    * All passes' eval_pass are run, and then all passes' run_pass are run. This
    * allows each pass to evaluate its rules in terms of the original input,
@@ -8,11 +8,13 @@
 #include "PassManager.h"
 
 #include <boost/filesystem.hpp>
+#include <chrono>
 #include <cinttypes>
 #include <cstdio>
 #include <typeinfo>
 #include <unordered_set>
 
+#include "AllocTracking.h"
 #include "ApiLevelChecker.h"
 #include "ApkManager.h"
 #include "CommandProfiling.h"
@@ -27,18 +29,24 @@
 #include "IRTypeChecker.h"
 #include "InstructionLowering.h"
 #include "JemallocUtil.h"
+#include "MethodLocalTransform.h"
+#include "MutationCheckpoint.h"
 #include "OptData.h"
+#include "PassResultCache.h"
+#include "PerfCounters.h"
 #include "PrintSeeds.h"
 #include "ProguardPrintConfiguration.h"
 #include "ProguardReporting.h"
 #include "ReachableClasses.h"
 #include "Sanitizers.h"
+#include "SummaryCache.h"
 #include "Timer.h"
 #include "Walkers.h"
 
 namespace {
 
 const std::string PASS_ORDER_KEY = "pass_order";
+const std::string CHANGED_METHODS_KEY = "num_changed_methods";
 
 constexpr const char* CFG_DUMP_BASE_NAME = "redex-cfg-dumps.cfg";
 
@@ -49,13 +57,31 @@ std::string get_apk_dir(const Json::Value& config) {
 }
 
 // TODO(fengliu): Kill the `validate_access` flag.
+// With a :cache, methods that passed an earlier check and haven't changed
+// since are not checked again.
 void run_verifier(const Scope& scope,
                   bool verify_moves,
                   bool check_no_overwrite_this,
-                  bool validate_access) {
+                  bool validate_access,
+                  IRTypeCheckerCache* cache = nullptr,
+                  bool check_monitors = false) {
   TRACE(PM, 1, "Running IRTypeChecker...");
   Timer t("IRTypeChecker");
-  walk::parallel::methods(scope, [=](DexMethod* dex_method) {
+  always_assert(cache == nullptr || !validate_access);
+  if (cache != nullptr) {
+    cache->prepare(scope);
+  }
+  std::atomic<size_t> skipped{0};
+  walk::parallel::methods(scope, [=, &skipped](DexMethod* dex_method) {
+    boost::optional<IRTypeCheckerCache::State> state;
+    if (cache != nullptr && dex_method->get_code() != nullptr) {
+      state = IRTypeCheckerCache::get_state(
+          dex_method, verify_moves, check_no_overwrite_this, check_monitors);
+      if (cache->is_verified(dex_method, *state)) {
+        ++skipped;
+        return;
+      }
+    }
     IRTypeChecker checker(dex_method, validate_access);
     if (verify_moves) {
       checker.verify_moves();
@@ -63,6 +89,9 @@ void run_verifier(const Scope& scope,
     if (check_no_overwrite_this) {
       checker.check_no_overwrite_this();
     }
+    if (check_monitors) {
+      checker.check_monitors();
+    }
     checker.run();
     if (checker.fail()) {
       std::string msg = checker.what();
@@ -71,7 +100,13 @@ void run_verifier(const Scope& scope,
       fprintf(stderr, "Code:\n%s\n", SHOW(dex_method->get_code()->cfg()));
       exit(EXIT_FAILURE);
     }
+    if (state) {
+      cache->set_verified(dex_method, *state);
+    }
   });
+  if (cache != nullptr) {
+    TRACE(PM, 1, "IRTypeChecker skipped %zu unchanged methods", skipped.load());
+  }
 }
 
 struct ScopedVmHWM {
@@ -80,24 +115,48 @@ struct ScopedVmHWM {
       if (reset) {
         try_reset_hwm_mem_stat();
       }
-      before = get_mem_stats().vm_hwm;
+      auto stats = get_mem_stats();
+      before = stats.vm_hwm;
+      rss_before = stats.vm_rss;
+      has_jemalloc_stats = jemalloc_util::get_stats(&jemalloc_before);
     }
   }
 
   void trace_log(PassManager* mgr, const Pass* pass) {
     if (enabled) {
-      uint64_t after = get_mem_stats().vm_hwm;
+      auto stats = get_mem_stats();
+      uint64_t after = stats.vm_hwm;
+      int64_t rss_delta = (int64_t)stats.vm_rss - (int64_t)rss_before;
       if (mgr != nullptr) {
         mgr->set_metric("vm_hwm_after", after);
         mgr->set_metric("vm_hwm_delta", after - before);
+        mgr->set_metric("vm_rss_after", stats.vm_rss);
+        mgr->set_metric("vm_rss_delta", rss_delta);
       }
       TRACE(STATS, 1, "VmHWM for %s was %s (%s over start).",
             pass->name().c_str(), pretty_bytes(after).c_str(),
             pretty_bytes(after - before).c_str());
+      jemalloc_util::Stats jemalloc_after;
+      if (has_jemalloc_stats && jemalloc_util::get_stats(&jemalloc_after)) {
+        int64_t allocated_delta = (int64_t)jemalloc_after.allocated -
+                                  (int64_t)jemalloc_before.allocated;
+        if (mgr != nullptr) {
+          mgr->set_metric("jemalloc_allocated_after", jemalloc_after.allocated);
+          mgr->set_metric("jemalloc_allocated_delta", allocated_delta);
+          mgr->set_metric("jemalloc_active_after", jemalloc_after.active);
+        }
+        TRACE(STATS, 1, "jemalloc for %s: %s allocated, %s active.",
+              pass->name().c_str(),
+              pretty_bytes(jemalloc_after.allocated).c_str(),
+              pretty_bytes(jemalloc_after.active).c_str());
+      }
     }
   }
 
   uint64_t before;
+  uint64_t rss_before;
+  jemalloc_util::Stats jemalloc_before;
+  bool has_jemalloc_stats{false};
   bool enabled;
 };
 
@@ -147,6 +206,9 @@ PassManager::PassManager(
     fprintf(stderr, "Will run jemalloc profiler for %s\n",
             m_malloc_profile_pass->name().c_str());
   }
+  if (getenv("SLOWEST_METHODS_PER_PASS")) {
+    m_num_slowest_methods = std::stoul(getenv("SLOWEST_METHODS_PER_PASS"));
+  }
 }
 
 void PassManager::init(const Json::Value& config) {
@@ -180,6 +242,89 @@ void PassManager::init(const Json::Value& config) {
     m_pass_info[i].metrics[PASS_ORDER_KEY] = i;
     m_pass_info[i].config = JsonWrapper(config[pass->name()]);
   }
+
+  m_pass_result_cache_dir =
+      config.get("pass_result_cache_dir", "").asString();
+  if (!m_pass_result_cache_dir.empty()) {
+    m_pass_result_cache_salt =
+        config.get("pass_result_cache_salt", "").asString();
+    Json::FastWriter writer;
+    for (const Pass* pass : m_activated_passes) {
+      m_pass_configs.emplace(pass, writer.write(config[pass->name()]));
+    }
+  }
+  m_keep_editable_cfgs = config.get("keep_editable_cfgs", false).asBool();
+}
+
+void PassManager::release_memory() {
+  // The metrics show what the mode costs in time and what it gains in RSS.
+  auto rss_before = get_mem_stats().vm_rss;
+  auto start = std::chrono::steady_clock::now();
+  jemalloc_util::purge_arenas();
+  auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start)
+                .count();
+  auto rss_after = get_mem_stats().vm_rss;
+  set_metric("low_memory_release_ms", ms);
+  set_metric("low_memory_released_rss",
+             (int64_t)rss_before - (int64_t)rss_after);
+  TRACE(STATS, 1, "Releasing memory took %lld ms, RSS went from %s to %s.",
+        (long long)ms, pretty_bytes(rss_before).c_str(),
+        pretty_bytes(rss_after).c_str());
+}
+
+std::unique_ptr<PassResultCache> PassManager::make_pass_result_cache(
+    const std::string& salt) const {
+  if (m_pass_result_cache_dir.empty() || m_current_pass_info == nullptr) {
+    return nullptr;
+  }
+  const auto& info = *m_current_pass_info;
+  // Repeated runs of a pass see different inputs, so each gets its own file.
+  auto path = m_pass_result_cache_dir + "/" + info.name + ".cache";
+  auto full_salt = m_pass_result_cache_salt + '\0' + info.pass->name() +
+                   '\0' + m_pass_configs.at(info.pass) + '\0' + salt;
+  return std::make_unique<PassResultCache>(path, full_salt);
+}
+
+std::unique_ptr<SummaryCache> PassManager::make_summary_cache(
+    const std::string& analysis, const std::string& salt) const {
+  if (m_pass_result_cache_dir.empty() || m_current_pass_info == nullptr) {
+    return nullptr;
+  }
+  const auto& info = *m_current_pass_info;
+  auto path =
+      m_pass_result_cache_dir + "/" + info.name + "." + analysis + ".cache";
+  auto full_salt = m_pass_result_cache_salt + '\0' + info.pass->name() +
+                   '\0' + m_pass_configs.at(info.pass) + '\0' + analysis +
+                   '\0' + salt;
+  return std::make_unique<SummaryCache>(path, full_salt);
+}
+
+void PassManager::report_cache_hit_rates() const {
+  auto percent = [](int64_t hits, int64_t misses) {
+    return hits + misses == 0 ? 0.0 : 100.0 * hits / (hits + misses);
+  };
+  int64_t total_hits = 0;
+  int64_t total_misses = 0;
+  for (const auto& info : m_pass_info) {
+    for (const char* cache : {"pass_result_cache", "summary_cache"}) {
+      auto hits_it = info.metrics.find(std::string(cache) + "_hits");
+      auto misses_it = info.metrics.find(std::string(cache) + "_misses");
+      if (hits_it == info.metrics.end() || misses_it == info.metrics.end()) {
+        continue;
+      }
+      auto hits = hits_it->second;
+      auto misses = misses_it->second;
+      TRACE(PM, 1, "%s: %s hit rate %.1f%% (%lld hits, %lld misses)",
+            info.name.c_str(), cache, percent(hits, misses), (long long)hits,
+            (long long)misses);
+      total_hits += hits;
+      total_misses += misses;
+    }
+  }
+  TRACE(PM, 1, "Cache hit rate of the build: %.1f%% (%lld hits, %lld misses)",
+        percent(total_hits, total_misses), (long long)total_hits,
+        (long long)total_misses);
 }
 
 hashing::DexHash PassManager::run_hasher(const char* pass_name,
@@ -281,6 +426,12 @@ void PassManager::run_passes(DexStoresVector& stores, ConfigFiles& conf) {
   bool verify_moves = type_checker_args.get("verify_moves", true).asBool();
   bool check_no_overwrite_this =
       type_checker_args.get("check_no_overwrite_this", false).asBool();
+  bool check_monitors =
+      type_checker_args.get("check_monitors", false).asBool();
+  // Only re-verify the methods that changed since the previous check.
+  bool incremental_type_checker =
+      type_checker_args.get("incremental", false).asBool();
+  IRTypeCheckerCache type_checker_cache;
   std::unordered_set<std::string> type_checker_trigger_passes;
 
   for (auto& trigger_pass : type_checker_args["run_after_passes"]) {
@@ -307,6 +458,31 @@ void PassManager::run_passes(DexStoresVector& stores, ConfigFiles& conf) {
       traceEnabled(STATS, 1) || conf.get_json_config().get("mem_stats", true);
   const bool hwm_per_pass =
       conf.get_json_config().get("mem_stats_per_pass", true);
+  // Count hardware events of each pass, e.g. to catch IPC regressions.
+  const bool perf_counters_per_pass =
+      conf.get_json_config().get("perf_counters_per_pass", false);
+  // Count the methods whose code each pass changed.
+  const bool track_changed_methods =
+      conf.get_json_config().get("track_changed_methods", false);
+
+  // Runs of consecutive MethodLocalPasses may be fused into one walk over
+  // all methods, unless something needs to look at the code in between.
+  const bool fuse_local_passes =
+      conf.get_json_config().get("fused_local_passes", false) &&
+      !run_hasher_after_each_pass && !run_type_checker_after_each_pass &&
+      !track_changed_methods &&
+      !conf.get_json_config().get("write_cfg_each_pass", false);
+  auto fusable = [&](size_t i) {
+    Pass* pass = m_activated_passes[i];
+    if (!fuse_local_passes ||
+        (m_profiler_info && m_profiler_info->pass == pass) ||
+        m_malloc_profile_pass == pass) {
+      return false;
+    }
+    return dynamic_cast<MethodLocalPass*>(pass) != nullptr;
+  };
+  // The passes up to this index already ran, fused with an earlier one.
+  size_t fused_end = 0;
 
   for (size_t i = 0; i < m_activated_passes.size(); ++i) {
     Pass* pass = m_activated_passes[i];
@@ -321,9 +497,21 @@ void PassManager::run_passes(DexStoresVector& stores, ConfigFiles& conf) {
     }
 
     TRACE(PM, 1, "Running %s...", pass->name().c_str());
+    boost::optional<MutationCheckpoint> checkpoint;
+    if (track_changed_methods) {
+      checkpoint.emplace(build_class_scope(stores));
+    }
     ScopedVmHWM vm_hwm{hwm_pass_stats, hwm_per_pass};
+    boost::optional<perf_counters::ScopedPerfCounters> perf_counters;
+    if (perf_counters_per_pass) {
+      perf_counters.emplace();
+    }
     Timer t(pass->name() + " (run)");
     m_current_pass_info = &m_pass_info[i];
+    // In low-memory mode, we never keep CFGs alive across passes.
+    const bool retain_cfgs = m_keep_editable_cfgs &&
+                             !m_redex_options.low_memory &&
+                             pass->is_editable_cfg_friendly();
 
     {
       bool run_profiler = m_profiler_info && m_profiler_info->pass == pass;
@@ -333,26 +521,104 @@ void PassManager::run_passes(DexStoresVector& stores, ConfigFiles& conf) {
           run_profiler ? m_profiler_info->shutdown_cmd : boost::none,
           run_profiler ? m_profiler_info->post_cmd : boost::none);
       jemalloc_util::ScopedProfiling malloc_prof(m_malloc_profile_pass == pass);
-      pass->run_pass(stores, conf, *this);
+      IRCode::set_retain_editable_cfgs(retain_cfgs);
+      TraceContext::s_num_slowest_methods = m_num_slowest_methods;
+      if (i < fused_end) {
+        TRACE(PM, 1, "%s ran fused with an earlier pass",
+              pass->name().c_str());
+      } else {
+        // A pass that triggers the type checker ends a run.
+        size_t end = i;
+        while (end < m_activated_passes.size() && fusable(end) &&
+               (end == i || type_checker_trigger_passes.count(
+                                m_activated_passes[end - 1]->name()) == 0)) {
+          ++end;
+        }
+        if (end > i + 1) {
+          run_fused_local_passes(i, end, stores, conf);
+          fused_end = end;
+        } else {
+          pass->run_pass(stores, conf, *this);
+        }
+      }
+      TraceContext::s_num_slowest_methods = 0;
+      IRCode::set_retain_editable_cfgs(false);
+    }
+    // Only the methods that the pass visits through the walkers are timed.
+    auto slowest_methods = TraceContext::take_slowest_methods();
+    for (size_t rank = 0; rank < slowest_methods.size(); ++rank) {
+      const auto& method_time = slowest_methods[rank];
+      TRACE(PM, 2, "%s: slowest method #%zu %s took %lld us",
+            pass->name().c_str(), rank + 1, method_time.first.c_str(),
+            (long long)method_time.second.count());
+      set_metric("~slowest_method_us~" + std::to_string(rank + 1) + "~" +
+                     method_time.first,
+                 method_time.second.count());
     }
 
     vm_hwm.trace_log(this, pass);
-
-    sanitizers::lsan_do_recoverable_leak_check();
-    walk::parallel::code(build_class_scope(stores), [](DexMethod* m,
-                                                       IRCode& code) {
-      // Ensure that pass authors deconstructed the editable CFG at the end of
-      // their pass. Currently, passes assume the incoming code will be in
-      // IRCode form
-      always_assert_log(!code.editable_cfg_built(), "%s has a cfg!", SHOW(m));
-    });
-
-    class_cfgs.add_pass(pass->name(), VISUALIZER_PASS_OPTIONS);
+    if (perf_counters) {
+      std::unordered_map<std::string, uint64_t> counts;
+      for (const auto& count : perf_counters->read()) {
+        TRACE(STATS, 1, "%s: %llu %s", pass->name().c_str(),
+              (unsigned long long)count.second, count.first.c_str());
+        set_metric("perf_" + count.first, count.second);
+        counts.emplace(count);
+      }
+      if (counts.count("cycles") && counts.count("instructions") &&
+          counts.at("cycles") != 0) {
+        set_metric("perf_ipc_x1000",
+                   counts.at("instructions") * 1000 / counts.at("cycles"));
+      }
+    }
+    if (alloc_tracking::is_sampler_installed()) {
+      // The live bytes at the pass boundary, by the category they were
+      // allocated under; the deltas between passes attribute them to passes.
+      auto live_bytes = alloc_tracking::get_live_bytes();
+      for (size_t i = 0; i < alloc_tracking::kNumCategories; ++i) {
+        auto name = alloc_tracking::category_name(
+            static_cast<alloc_tracking::Category>(i));
+        TRACE(STATS, 1, "%s: %lld sampled live bytes of %s",
+              pass->name().c_str(), (long long)live_bytes[i], name);
+        set_metric(std::string("sampled_live_bytes_") + name, live_bytes[i]);
+      }
+    }
 
     bool run_hasher = run_hasher_after_each_pass;
     bool run_type_checker = run_type_checker_after_each_pass ||
                             type_checker_trigger_passes.count(pass->name()) > 0;
 
+    sanitizers::lsan_do_recoverable_leak_check();
+    // Editable CFGs that the pass kept are handed on as they are if the next
+    // pass works on them too, and nothing else looks at the code in between.
+    const bool hand_on_cfgs =
+        retain_cfgs && i + 1 < m_activated_passes.size() &&
+        m_activated_passes[i + 1]->is_editable_cfg_friendly() && !run_hasher &&
+        !run_type_checker;
+    if (!hand_on_cfgs) {
+      auto check_scope = build_class_scope(stores);
+      walk::parallel::code(check_scope, [retain_cfgs](DexMethod* m,
+                                                      IRCode& code) {
+        if (retain_cfgs) {
+          code.clear_cfg();
+        }
+        // Ensure that pass authors deconstructed the editable CFG at the end
+        // of their pass. Currently, passes assume the incoming code will be in
+        // IRCode form
+        always_assert_log(!code.editable_cfg_built(), "%s has a cfg!",
+                          SHOW(m));
+      });
+    }
+
+    if (checkpoint) {
+      auto changed = checkpoint->changed_methods(build_class_scope(stores));
+      TRACE(PM, 1, "%s changed %zu methods", pass->name().c_str(),
+            changed.size());
+      m_current_pass_info->metrics[CHANGED_METHODS_KEY] = changed.size();
+    }
+
+    class_cfgs.add_pass(pass->name(), VISUALIZER_PASS_OPTIONS);
+
     if (run_hasher || run_type_checker) {
       scope = build_class_scope(it);
       if (run_hasher) {
@@ -362,9 +628,12 @@ void PassManager::run_passes(DexStoresVector& stores, ConfigFiles& conf) {
       if (run_type_checker) {
         // It's OK to overwrite the `this` register if we are not yet at the
         // output phase -- the register allocator can fix it up later.
-        run_verifier(scope, verify_moves,
-                     /* check_no_overwrite_this */ false,
-                     /* validate_access */ false);
+        run_verifier(
+            scope, verify_moves,
+            /* check_no_overwrite_this */ false,
+            /* validate_access */ false,
+            incremental_type_checker ? &type_checker_cache : nullptr,
+            check_monitors);
       }
     }
 
@@ -381,17 +650,26 @@ void PassManager::run_passes(DexStoresVector& stores, ConfigFiles& conf) {
       m_preserved_analysis_passes.emplace(typeid(*pass).name(), pass);
     }
 
+    if (m_redex_options.low_memory) {
+      release_memory();
+    }
+
     m_current_pass_info = nullptr;
   }
 
   // Always run the type checker before generating the optimized dex code.
   scope = build_class_scope(it);
   run_verifier(scope, verify_moves, get_redex_options().no_overwrite_this(),
-               /* validate_access */ true);
+               /* validate_access */ true, /* cache */ nullptr,
+               check_monitors);
 
   class_cfgs.add_pass("After all passes");
   class_cfgs.write();
 
+  if (!m_pass_result_cache_dir.empty()) {
+    report_cache_hit_rates();
+  }
+
   if (!conf.get_printseeds().empty()) {
     Timer t("Writing outgoing classes to file " + conf.get_printseeds() +
             ".outgoing");
@@ -404,6 +682,36 @@ void PassManager::run_passes(DexStoresVector& stores, ConfigFiles& conf) {
   sanitizers::lsan_do_recoverable_leak_check();
 }
 
+void PassManager::run_fused_local_passes(size_t begin,
+                                         size_t end,
+                                         DexStoresVector& stores,
+                                         ConfigFiles& conf) {
+  std::vector<std::unique_ptr<MethodLocalTransform>> transforms;
+  std::vector<MethodLocalTransform*> transform_ptrs;
+  for (size_t i = begin; i < end; ++i) {
+    auto* pass = static_cast<MethodLocalPass*>(m_activated_passes[i]);
+    TRACE(PM, 1, "Fusing %s...", pass->name().c_str());
+    m_current_pass_info = &m_pass_info[i];
+    transforms.push_back(
+        pass->make_method_local_transform(stores, conf, *this));
+    transform_ptrs.push_back(transforms.back().get());
+  }
+
+  // The CFGs may only be shared if all the fused passes work on them alone.
+  bool retain_cfgs = IRCode::retain_editable_cfgs();
+  for (size_t i = begin; i < end; ++i) {
+    retain_cfgs &= m_activated_passes[i]->is_editable_cfg_friendly();
+  }
+  IRCode::set_retain_editable_cfgs(retain_cfgs);
+  run_method_local_transforms(build_class_scope(stores), transform_ptrs);
+
+  for (size_t i = begin; i < end; ++i) {
+    m_current_pass_info = &m_pass_info[i];
+    transforms[i - begin]->report(*this);
+  }
+  m_current_pass_info = &m_pass_info[begin];
+}
+
 void PassManager::activate_pass(const char* name, const Json::Value& conf) {
   std::string name_str(name);
 
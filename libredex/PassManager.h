@@ -15,12 +15,16 @@
 
 #include <boost/optional.hpp>
 #include <json/json.h>
+#include <memory>
 #include <string>
 #include <typeinfo>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
+class PassResultCache;
+class SummaryCache;
+
 class PassManager {
  public:
   explicit PassManager(
@@ -77,6 +81,21 @@ class PassManager {
 
   bool regalloc_has_run() { return m_regalloc_has_run; }
 
+  // If the config sets `pass_result_cache_dir`, return a cache for the
+  // per-method results of the currently running pass, and nullptr otherwise.
+  // Only method-local passes may use it (see PassResultCache). :salt must
+  // capture whatever else besides the pass config their results depend on.
+  // The config's `pass_result_cache_salt` is part of every key as well.
+  // Call save() on the cache at the end of the pass, and report its hits()
+  // and misses() as the pass_result_cache_hits/misses metrics.
+  std::unique_ptr<PassResultCache> make_pass_result_cache(
+      const std::string& salt = "") const;
+
+  // Likewise, return a store for the method summaries of the interprocedural
+  // :analysis run by the current pass (see SummaryCache), or nullptr.
+  std::unique_ptr<SummaryCache> make_summary_cache(
+      const std::string& analysis, const std::string& salt = "") const;
+
   template <typename PassType>
   PassType* get_preserved_analysis() const {
     auto pass = m_preserved_analysis_passes.find(typeid(PassType).name());
@@ -95,6 +114,20 @@ class PassManager {
 
   hashing::DexHash run_hasher(const char* name, const Scope& scope);
 
+  // Runs the MethodLocalPasses in [begin, end) in a single walk over all
+  // methods, with each pass's metrics going to its own PassInfo.
+  void run_fused_local_passes(size_t begin,
+                              size_t end,
+                              DexStoresVector& stores,
+                              ConfigFiles& conf);
+
+  // Hands freed memory back to the OS after a pass in low-memory mode.
+  void release_memory();
+
+  // Traces the hit rates of the pass result and summary caches, per pass and
+  // over the whole build, from the passes' *cache_hits/misses metrics.
+  void report_cache_hit_rates() const;
+
   ApkManager m_apk_mgr;
   std::vector<Pass*> m_registered_passes;
   std::vector<Pass*> m_activated_passes;
@@ -126,5 +159,16 @@ class PassManager {
 
   boost::optional<ProfilerInfo> m_profiler_info;
   Pass* m_malloc_profile_pass{nullptr};
+  // How many of the slowest methods of each pass to report; 0 for none.
+  size_t m_num_slowest_methods{0};
   boost::optional<hashing::DexHash> m_initial_hash;
+  std::string m_pass_result_cache_dir;
+  // Part of every cache key, e.g. the Redex version, so that builds with a
+  // different Redex don't reuse each other's results.
+  std::string m_pass_result_cache_salt;
+  // The serialized config of each pass, if pass result caching is enabled.
+  std::unordered_map<const Pass*, std::string> m_pass_configs;
+  // Whether editable CFGs are kept across consecutive passes that declare
+  // Pass::is_editable_cfg_friendly().
+  bool m_keep_editable_cfgs{false};
 };
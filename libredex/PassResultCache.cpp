@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "PassResultCache.h"
+
+#include <cstdio>
+#include <fstream>
+
+#include "DexClass.h"
+#include "IRAssembler.h"
+#include "IRCode.h"
+#include "IROpcode.h"
+#include "Sha1.h"
+#include "Show.h"
+#include "Trace.h"
+
+namespace {
+
+constexpr const char* CACHE_HEADER = "redex-pass-result-cache 2";
+
+} // namespace
+
+namespace pass_result_cache {
+
+bool is_representable(const IRCode* code) {
+  if (code->editable_cfg_built()) {
+    return false;
+  }
+  for (const auto& mie : InstructionIterable(code)) {
+    switch (opcode::ref(mie.insn->opcode())) {
+    case opcode::Ref::Data:
+    case opcode::Ref::CallSite:
+    case opcode::Ref::MethodHandle:
+      return false;
+    default:
+      break;
+    }
+  }
+  return true;
+}
+
+std::string sha1_hex(const std::string& data) {
+  Sha1Context context;
+  unsigned char digest[20];
+  sha1_init(&context);
+  sha1_update(&context, reinterpret_cast<const unsigned char*>(data.data()),
+              data.size());
+  sha1_final(digest, &context);
+  static const char* hex = "0123456789abcdef";
+  std::string result;
+  for (auto byte : digest) {
+    result += hex[byte >> 4];
+    result += hex[byte & 0xf];
+  }
+  return result;
+}
+
+} // namespace pass_result_cache
+
+PassResultCache::PassResultCache(std::string path, std::string salt)
+    : m_path(std::move(path)), m_salt(std::move(salt)) {
+  load();
+}
+
+void PassResultCache::load() {
+  std::ifstream in(m_path, std::ios::binary);
+  if (!in) {
+    return;
+  }
+  std::string header;
+  if (!std::getline(in, header) || header != CACHE_HEADER) {
+    TRACE(PM, 1, "Ignoring pass result cache %s with unknown format",
+          m_path.c_str());
+    return;
+  }
+  // Each entry is
+  // "<key> <registers size> <has debug item> <code length>\n<code>\n".
+  std::string key;
+  Entry entry;
+  size_t length;
+  while (in >> key >> entry.registers_size >> entry.has_debug_item >> length &&
+         in.get() == '\n') {
+    entry.code.resize(length);
+    if (!in.read(&entry.code[0], length) || in.get() != '\n') {
+      TRACE(PM, 1, "Truncated pass result cache %s", m_path.c_str());
+      break;
+    }
+    m_loaded.emplace(key, entry);
+  }
+  TRACE(PM, 2, "Loaded %zu entries from pass result cache %s",
+        m_loaded.size(), m_path.c_str());
+}
+
+std::string PassResultCache::key(const DexMethod* method) const {
+  auto* code = method->get_code();
+  if (code == nullptr || !pass_result_cache::is_representable(code)) {
+    return "";
+  }
+  std::string input = m_salt;
+  input += '\0';
+  input += show(method);
+  input += '\0';
+  input += std::to_string(method->get_access());
+  input += '\0';
+  input += std::to_string(code->get_registers_size());
+  input += '\0';
+  input += code->get_debug_item() != nullptr ? '1' : '0';
+  input += '\0';
+  input += assembler::to_string(code);
+  return pass_result_cache::sha1_hex(input);
+}
+
+bool PassResultCache::replay(const std::string& key, DexMethod* method) {
+  auto it = m_loaded.find(key);
+  if (it == m_loaded.end()) {
+    ++m_misses;
+    return false;
+  }
+  auto code = assembler::ircode_from_string(it->second.code);
+  // The assembler cannot infer the register frame of non-symbolic registers.
+  code->set_registers_size(it->second.registers_size);
+  // The positions and debug entries are part of the code; the debug item
+  // only needs to exist so that sync() emits them. Parameter names are not
+  // kept by the loader in the first place.
+  if (it->second.has_debug_item) {
+    code->set_debug_item(std::make_unique<DexDebugItem>());
+  }
+  method->set_code(std::move(code));
+  m_used.emplace(key, it->second);
+  ++m_hits;
+  return true;
+}
+
+void PassResultCache::record(const std::string& key, const DexMethod* method) {
+  auto* code = method->get_code();
+  if (code == nullptr || !pass_result_cache::is_representable(code)) {
+    return;
+  }
+  auto str = assembler::to_string(code);
+  // Only keep results that survive a round trip through the assembler.
+  if (assembler::to_string(assembler::ircode_from_string(str).get()) != str) {
+    TRACE(PM, 3, "Not caching %s: it does not round-trip", SHOW(method));
+    return;
+  }
+  m_used.emplace(key, Entry{code->get_registers_size(),
+                            code->get_debug_item() != nullptr,
+                            std::move(str)});
+}
+
+void PassResultCache::save() const {
+  auto tmp_path = m_path + ".tmp";
+  {
+    std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+      TRACE(PM, 1, "Cannot write pass result cache %s", tmp_path.c_str());
+      return;
+    }
+    out << CACHE_HEADER << '\n';
+    for (const auto& p : m_used) {
+      out << p.first << ' ' << p.second.registers_size << ' '
+          << p.second.has_debug_item << ' ' << p.second.code.size() << '\n'
+          << p.second.code << '\n';
+    }
+  }
+  // Replace the previous cache atomically, so that an interrupted run never
+  // leaves a partial cache behind.
+  if (std::rename(tmp_path.c_str(), m_path.c_str()) != 0) {
+    TRACE(PM, 1, "Cannot write pass result cache %s", m_path.c_str());
+  }
+}
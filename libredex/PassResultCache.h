@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include "ConcurrentContainers.h"
+
+class DexMethod;
+class IRCode;
+
+/*
+ * An on-disk cache of the per-method results of a method-local pass, i.e. a
+ * pass whose effect on a method depends only on that method's own code and on
+ * the pass configuration. In incremental builds most methods are unchanged, so
+ * their cached results can be replayed instead of being computed again.
+ *
+ * Entries are keyed by a SHA1 digest of a salt (which captures the pass and its
+ * configuration) and of the method's signature and code before the pass runs.
+ * Code is stored in IRAssembler's s-expression syntax, along with its register
+ * count and whether it has a debug item; methods with constructs that the
+ * syntax cannot represent are never cached.
+ *
+ * Typical use from a parallel walk, see PassManager::make_pass_result_cache:
+ *
+ *   auto key = cache->key(method);
+ *   if (!key.empty() && cache->replay(key, method)) {
+ *     return;
+ *   }
+ *   transform(method);
+ *   if (!key.empty()) {
+ *     cache->record(key, method);
+ *   }
+ *
+ * key, replay and record are thread-safe.
+ */
+class PassResultCache {
+ public:
+  // Load the entries previously saved to :path, if any.
+  PassResultCache(std::string path, std::string salt);
+
+  // The key for :method's current code, or the empty string if it cannot be
+  // cached.
+  std::string key(const DexMethod* method) const;
+
+  // If there is an entry for :key, replace :method's code with it and return
+  // true.
+  bool replay(const std::string& key, DexMethod* method);
+
+  // Store :method's current code as the result for :key.
+  void record(const std::string& key, const DexMethod* method);
+
+  // Write back the entries that were replayed or recorded in this run. Entries
+  // that went unused are dropped, so that the cache does not grow without
+  // bound.
+  void save() const;
+
+  size_t hits() const { return m_hits; }
+  size_t misses() const { return m_misses; }
+
+ private:
+  struct Entry {
+    uint32_t registers_size;
+    // Whether the code had a debug item, which the assembler syntax doesn't
+    // capture.
+    bool has_debug_item;
+    std::string code;
+  };
+
+  void load();
+
+  const std::string m_path;
+  const std::string m_salt;
+  // Read-only once loaded.
+  std::unordered_map<std::string, Entry> m_loaded;
+  ConcurrentMap<std::string, Entry> m_used;
+  std::atomic<size_t> m_hits{0};
+  std::atomic<size_t> m_misses{0};
+};
+
+namespace pass_result_cache {
+
+// Whether IRAssembler's s-expression syntax can represent :code.
+bool is_representable(const IRCode* code);
+
+// The hexadecimal SHA1 digest of :data.
+std::string sha1_hex(const std::string& data);
+
+} // namespace pass_result_cache
@@ -0,0 +1,673 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "PointsToSolver.h"
+
+#include <algorithm>
+
+#include "Debug.h"
+#include "DexUtil.h"
+#include "Resolver.h"
+#include "Show.h"
+#include "Trace.h"
+#include "TypeUtil.h"
+
+namespace {
+
+const PointsToSolver::CalleeSet& no_callees() {
+  static const PointsToSolver::CalleeSet empty;
+  return empty;
+}
+
+bool is_dispatched(const PointsToOperation& operation) {
+  return operation.kind == PTS_INVOKE_VIRTUAL ||
+         operation.kind == PTS_INVOKE_INTERFACE;
+}
+
+} // namespace
+
+std::ostream& operator<<(std::ostream& o, const PointsToAbstractObject& obj) {
+  switch (obj.kind) {
+  case PTS_CONST_CLASS: {
+    o << "CLASS " << show(obj.class_type);
+    break;
+  }
+  case PTS_GET_EXCEPTION: {
+    o << "EXCEPTION";
+    break;
+  }
+  default: {
+    o << show(obj.type) << "@" << show(obj.method) << ":" << obj.variable;
+  }
+  }
+  return o;
+}
+
+PointsToSolver::PointsToSolver(PointsToSemantics& semantics)
+    : m_semantics(semantics) {
+  for (const auto& entry : m_semantics) {
+    add_method(entry.first, entry.second);
+  }
+}
+
+void PointsToSolver::run() {
+  while (!m_worklist.empty()) {
+    NodeId node = m_worklist.front();
+    m_worklist.pop_front();
+    if (find(node) != node) {
+      // The node has been merged with its cycle, whose representative has
+      // inherited its pending objects.
+      continue;
+    }
+    process(node);
+    for (NodeId candidate : m_cycle_candidates) {
+      collapse_cycles(find(candidate));
+    }
+    m_cycle_candidates.clear();
+  }
+  m_stats.variables = m_nodes.size();
+  m_stats.objects = m_objects.size();
+  TRACE(PTA,
+        1,
+        "Points-to solver: %zu variables (%zu collapsed), %zu objects, "
+        "%zu copy edges, %zu call edges, %zu propagations",
+        m_stats.variables,
+        m_stats.collapsed_variables,
+        m_stats.objects,
+        m_stats.copy_edges,
+        m_stats.call_edges,
+        m_stats.propagations);
+}
+
+PointsToSolver::ObjectSet PointsToSolver::get_points_to_set(
+    DexMethodRef* method, PointsToVariable v) const {
+  auto it = m_locals.find({method, v});
+  return it == m_locals.end() ? ObjectSet() : points_to_set(it->second);
+}
+
+PointsToSolver::ObjectSet PointsToSolver::get_return_points_to_set(
+    DexMethodRef* method) const {
+  auto it = m_returns.find(method);
+  return it == m_returns.end() ? ObjectSet() : points_to_set(it->second);
+}
+
+PointsToSolver::ObjectSet PointsToSolver::get_static_field_points_to_set(
+    DexFieldRef* field) const {
+  auto it = m_static_fields.find(canonical_field(field));
+  return it == m_static_fields.end() ? ObjectSet() : points_to_set(it->second);
+}
+
+PointsToSolver::ObjectSet PointsToSolver::get_instance_field_points_to_set(
+    ObjectId object, DexFieldRef* field) const {
+  auto it = m_instance_fields.find({object, canonical_field(field)});
+  return it == m_instance_fields.end() ? ObjectSet()
+                                       : points_to_set(it->second);
+}
+
+PointsToSolver::ObjectSet PointsToSolver::get_array_element_points_to_set(
+    ObjectId array) const {
+  auto it = m_instance_fields.find({array, nullptr});
+  return it == m_instance_fields.end() ? ObjectSet()
+                                       : points_to_set(it->second);
+}
+
+const PointsToSolver::CalleeSet& PointsToSolver::get_callees(
+    DexMethodRef* method, const PointsToAction& call) const {
+  auto it = m_call_site_ids.find(&call);
+  if (it == m_call_site_ids.end()) {
+    return no_callees();
+  }
+  const auto& site = m_call_sites.at(it->second);
+  always_assert(site.caller == method);
+  return site.callees;
+}
+
+PointsToSolver::CalleeSet PointsToSolver::get_callees(
+    DexMethodRef* method) const {
+  CalleeSet callees;
+  auto it = m_method_call_sites.find(method);
+  if (it != m_method_call_sites.end()) {
+    for (size_t call_site : it->second) {
+      const auto& site_callees = m_call_sites.at(call_site).callees;
+      callees.insert(site_callees.begin(), site_callees.end());
+    }
+  }
+  return callees;
+}
+
+void PointsToSolver::add_method(DexMethodRef* method,
+                                const PointsToMethodSemantics& s) {
+  for (const PointsToAction& a : s.get_points_to_actions()) {
+    add_action(method, a);
+  }
+}
+
+void PointsToSolver::add_action(DexMethodRef* method, const PointsToAction& a) {
+  const PointsToOperation& op = a.operation();
+  switch (op.kind) {
+  case PTS_CONST_STRING: {
+    add_objects(local_node(method, a.dest()),
+                ObjectSet{allocation_site(
+                    op.kind, type::java_lang_String(), method, a.dest())});
+    break;
+  }
+  case PTS_CONST_CLASS: {
+    add_objects(local_node(method, a.dest()),
+                ObjectSet{class_object(op.dex_type)});
+    break;
+  }
+  case PTS_GET_EXCEPTION: {
+    if (!m_exception_object) {
+      m_exception_object = m_objects.size();
+      m_objects.push_back({PTS_GET_EXCEPTION, type::java_lang_Throwable(),
+                           nullptr, PointsToVariable(), nullptr});
+    }
+    add_objects(local_node(method, a.dest()), ObjectSet{*m_exception_object});
+    break;
+  }
+  case PTS_NEW_OBJECT: {
+    add_objects(
+        local_node(method, a.dest()),
+        ObjectSet{allocation_site(op.kind, op.dex_type, method, a.dest())});
+    break;
+  }
+  case PTS_LOAD_PARAM: {
+    add_edge(parameter_node(method, op.parameter),
+             local_node(method, a.dest()));
+    break;
+  }
+  case PTS_GET_CLASS:
+  case PTS_CHECK_CAST: {
+    if (is_null(a.src())) {
+      break;
+    }
+    Constraint c;
+    c.target = local_node(method, a.dest());
+    if (op.kind == PTS_GET_CLASS) {
+      c.kind = GET_CLASS;
+    } else {
+      c.kind = CHECK_CAST;
+      c.type = op.dex_type;
+    }
+    add_constraint(local_node(method, a.src()), c);
+    break;
+  }
+  case PTS_IGET:
+  case PTS_IGET_SPECIAL: {
+    if (is_null(a.instance())) {
+      break;
+    }
+    Constraint c;
+    c.kind = LOAD;
+    c.target = local_node(method, a.dest());
+    c.field = op.kind == PTS_IGET ? canonical_field(op.dex_field) : nullptr;
+    add_constraint(local_node(method, a.instance()), c);
+    break;
+  }
+  case PTS_SGET: {
+    add_edge(static_field_node(canonical_field(op.dex_field)),
+             local_node(method, a.dest()));
+    break;
+  }
+  case PTS_IPUT:
+  case PTS_IPUT_SPECIAL: {
+    if (is_null(a.lhs()) || is_null(a.rhs())) {
+      break;
+    }
+    Constraint c;
+    c.kind = STORE;
+    c.target = local_node(method, a.rhs());
+    c.field = op.kind == PTS_IPUT ? canonical_field(op.dex_field) : nullptr;
+    add_constraint(local_node(method, a.lhs()), c);
+    break;
+  }
+  case PTS_SPUT: {
+    if (!is_null(a.rhs())) {
+      add_edge(local_node(method, a.rhs()),
+               static_field_node(canonical_field(op.dex_field)));
+    }
+    break;
+  }
+  case PTS_INVOKE_VIRTUAL:
+  case PTS_INVOKE_SUPER:
+  case PTS_INVOKE_DIRECT:
+  case PTS_INVOKE_INTERFACE:
+  case PTS_INVOKE_STATIC: {
+    add_call(method, a);
+    break;
+  }
+  case PTS_RETURN: {
+    if (!is_null(a.src())) {
+      add_edge(local_node(method, a.src()), return_node(method));
+    }
+    break;
+  }
+  case PTS_DISJUNCTION: {
+    NodeId dest = local_node(method, a.dest());
+    for (const auto& arg : a.get_arguments()) {
+      if (!is_null(arg.second)) {
+        add_edge(local_node(method, arg.second), dest);
+      }
+    }
+    break;
+  }
+  }
+}
+
+void PointsToSolver::add_call(DexMethodRef* method, const PointsToAction& a) {
+  const PointsToOperation& op = a.operation();
+  size_t call_site = m_call_sites.size();
+  m_call_sites.push_back({method, &a, {}});
+  m_call_site_ids.emplace(&a, call_site);
+  m_method_call_sites[method].push_back(call_site);
+  if (is_dispatched(op)) {
+    if (is_null(a.instance())) {
+      return;
+    }
+    Constraint c;
+    c.kind = VIRTUAL_CALL;
+    c.target = local_node(method, a.instance());
+    c.call_site = call_site;
+    add_constraint(local_node(method, a.instance()), c);
+    return;
+  }
+  DexMethod* callee;
+  switch (op.kind) {
+  case PTS_INVOKE_STATIC: {
+    callee = resolve_method(op.dex_method, MethodSearch::Static);
+    break;
+  }
+  case PTS_INVOKE_DIRECT: {
+    callee = resolve_method(op.dex_method, MethodSearch::Direct);
+    break;
+  }
+  case PTS_INVOKE_SUPER: {
+    callee = resolve_method(
+        op.dex_method, MethodSearch::Super, method->as_def());
+    break;
+  }
+  default: {
+    not_reached();
+  }
+  }
+  // Unresolved methods may still have a stub.
+  link(call_site, callee != nullptr ? callee : op.dex_method);
+}
+
+void PointsToSolver::add_constraint(NodeId source, const Constraint& c) {
+  source = find(source);
+  size_t id = m_constraints.size();
+  m_constraints.push_back(c);
+  m_nodes[source].constraints.push_back(id);
+  // The constraint applies to the objects that have already reached the
+  // source.
+  ObjectSet objects = m_nodes[source].points_to;
+  for (ObjectId object : objects) {
+    apply_constraint(m_constraints[id], object);
+  }
+}
+
+void PointsToSolver::apply_constraint(const Constraint& c, ObjectId object) {
+  switch (c.kind) {
+  case LOAD: {
+    add_edge(instance_field_node(object, c.field), c.target);
+    break;
+  }
+  case STORE: {
+    add_edge(c.target, instance_field_node(object, c.field));
+    break;
+  }
+  case GET_CLASS: {
+    add_objects(c.target, ObjectSet{class_object(m_objects[object].type)});
+    break;
+  }
+  case CHECK_CAST: {
+    if (may_cast(m_objects[object].type, c.type)) {
+      add_objects(c.target, ObjectSet{object});
+    }
+    break;
+  }
+  case VIRTUAL_CALL: {
+    DexType* type = m_objects[object].type;
+    if (type::is_array(type)) {
+      // Arrays only inherit the methods of java.lang.Object.
+      type = type::java_lang_Object();
+    }
+    const DexClass* cls = type_class(type);
+    if (cls == nullptr) {
+      break;
+    }
+    DexMethodRef* method =
+        m_call_sites[c.call_site].action->operation().dex_method;
+    DexMethod* callee = resolve_method(
+        cls, method->get_name(), method->get_proto(), MethodSearch::Virtual);
+    if (callee == nullptr) {
+      break;
+    }
+    link(c.call_site, callee);
+    // Only the objects on which the callee is dispatched flow into `this`.
+    add_objects(local_node(callee, PointsToVariable::this_variable()),
+                ObjectSet{object});
+    break;
+  }
+  }
+}
+
+void PointsToSolver::link(size_t call_site, DexMethodRef* callee) {
+  DexMethodRef* caller = m_call_sites[call_site].caller;
+  const PointsToAction& a = *m_call_sites[call_site].action;
+  if (!m_call_sites[call_site].callees.insert(callee).second) {
+    return;
+  }
+  ++m_stats.call_edges;
+  for (const auto& arg : a.get_arguments()) {
+    if (!is_null(arg.second)) {
+      add_edge(local_node(caller, arg.second),
+               parameter_node(callee, arg.first));
+    }
+  }
+  if (a.has_dest()) {
+    add_edge(return_node(callee), local_node(caller, a.dest()));
+  }
+  if (!a.operation().is_static_call() && !is_dispatched(a.operation()) &&
+      !is_null(a.instance())) {
+    add_edge(local_node(caller, a.instance()),
+             local_node(callee, PointsToVariable::this_variable()));
+  }
+}
+
+void PointsToSolver::add_edge(NodeId source, NodeId target) {
+  source = find(source);
+  target = find(target);
+  if (source == target || m_nodes[source].successors.contains(target)) {
+    return;
+  }
+  m_nodes[source].successors.insert(target);
+  ++m_stats.copy_edges;
+  // The new edge needs to carry all the objects that have already reached the
+  // source, not only the pending ones.
+  ObjectSet objects = m_nodes[source].points_to;
+  add_objects(target, objects);
+}
+
+void PointsToSolver::add_objects(NodeId node, const ObjectSet& objects) {
+  node = find(node);
+  Node& n = m_nodes[node];
+  ObjectSet added = objects.get_difference_with(n.points_to);
+  if (added.empty()) {
+    return;
+  }
+  n.points_to.union_with(added);
+  n.delta.union_with(added);
+  if (!n.in_worklist) {
+    n.in_worklist = true;
+    m_worklist.push_back(node);
+  }
+}
+
+void PointsToSolver::process(NodeId node) {
+  m_nodes[node].in_worklist = false;
+  ObjectSet delta = m_nodes[node].delta;
+  m_nodes[node].delta.clear();
+  if (delta.empty()) {
+    return;
+  }
+  ++m_stats.propagations;
+  // Applying a constraint may create new nodes, which invalidates references
+  // into m_nodes, hence the copies. Constraints added in the meantime have
+  // already been applied to the whole points-to set.
+  std::vector<size_t> constraints = m_nodes[node].constraints;
+  for (size_t id : constraints) {
+    for (ObjectId object : delta) {
+      apply_constraint(m_constraints[id], object);
+    }
+  }
+  NodeSet successors = m_nodes[node].successors;
+  for (NodeId successor : successors) {
+    NodeId target = find(successor);
+    if (target == node) {
+      continue;
+    }
+    add_objects(target, delta);
+    if (m_nodes[target].points_to.equals(m_nodes[node].points_to) &&
+        m_checked_edges.emplace(node, target).second) {
+      m_cycle_candidates.push_back(node);
+    }
+  }
+}
+
+void PointsToSolver::collapse_cycles(NodeId root) {
+  // Tarjan's algorithm on the copy edges reachable from the root, without
+  // recursion since the chains of copies can get very long.
+  struct Frame {
+    NodeId node;
+    std::vector<NodeId> successors;
+    size_t next;
+  };
+  std::unordered_map<NodeId, size_t> index;
+  std::unordered_map<NodeId, size_t> lowlink;
+  std::unordered_set<NodeId> on_stack;
+  std::vector<NodeId> stack;
+  std::vector<Frame> frames;
+  size_t counter = 0;
+  auto visit = [&](NodeId node) {
+    index[node] = lowlink[node] = counter++;
+    stack.push_back(node);
+    on_stack.insert(node);
+    Frame frame{node, {}, 0};
+    for (NodeId successor : m_nodes[node].successors) {
+      frame.successors.push_back(find(successor));
+    }
+    frames.push_back(std::move(frame));
+  };
+  visit(root);
+  while (!frames.empty()) {
+    Frame& frame = frames.back();
+    if (frame.next < frame.successors.size()) {
+      NodeId successor = frame.successors[frame.next++];
+      if (index.count(successor) == 0) {
+        visit(successor);
+      } else if (on_stack.count(successor) != 0) {
+        lowlink[frame.node] = std::min(lowlink[frame.node], index[successor]);
+      }
+      continue;
+    }
+    NodeId node = frame.node;
+    frames.pop_back();
+    if (!frames.empty()) {
+      NodeId parent = frames.back().node;
+      lowlink[parent] = std::min(lowlink[parent], lowlink[node]);
+    }
+    if (lowlink[node] != index[node]) {
+      continue;
+    }
+    // The node is the root of a strongly connected component.
+    NodeId member;
+    do {
+      member = stack.back();
+      stack.pop_back();
+      on_stack.erase(member);
+      if (member != node) {
+        merge(node, member);
+      }
+    } while (member != node);
+  }
+}
+
+void PointsToSolver::merge(NodeId rep, NodeId node) {
+  Node& r = m_nodes[rep];
+  Node& n = m_nodes[node];
+  // The constraints of each node need to see the objects that only the other
+  // one had.
+  ObjectSet delta = r.points_to.get_difference_with(n.points_to);
+  delta.union_with(n.points_to.get_difference_with(r.points_to));
+  delta.union_with(n.delta);
+  r.points_to.union_with(n.points_to);
+  r.delta.union_with(delta);
+  r.successors.union_with(n.successors);
+  r.successors.remove(node);
+  r.constraints.insert(
+      r.constraints.end(), n.constraints.begin(), n.constraints.end());
+  n.points_to.clear();
+  n.delta.clear();
+  n.successors.clear();
+  n.constraints.clear();
+  n.parent = rep;
+  ++m_stats.collapsed_variables;
+  if (!r.delta.empty() && !r.in_worklist) {
+    r.in_worklist = true;
+    m_worklist.push_back(rep);
+  }
+}
+
+PointsToSolver::NodeId PointsToSolver::find(NodeId node) {
+  while (m_nodes[node].parent != node) {
+    // Path halving.
+    m_nodes[node].parent = m_nodes[m_nodes[node].parent].parent;
+    node = m_nodes[node].parent;
+  }
+  return node;
+}
+
+PointsToSolver::ObjectSet PointsToSolver::points_to_set(NodeId node) const {
+  while (m_nodes[node].parent != node) {
+    node = m_nodes[node].parent;
+  }
+  return m_nodes[node].points_to;
+}
+
+bool PointsToSolver::may_cast(DexType* type, DexType* base_type) {
+  if (type::check_cast(type, base_type)) {
+    return true;
+  }
+  // The cast can only be ruled out if we know the whole class hierarchy.
+  return !has_known_hierarchy(type);
+}
+
+bool PointsToSolver::has_known_hierarchy(const DexType* type) {
+  if (type::is_array(type)) {
+    type = type::get_array_element_type(type);
+  }
+  if (type == nullptr || type::is_primitive(type)) {
+    return true;
+  }
+  auto it = m_known_hierarchies.find(type);
+  if (it != m_known_hierarchies.end()) {
+    return it->second;
+  }
+  const DexClass* cls = type_class(type);
+  bool known = cls != nullptr;
+  if (known) {
+    // Breaks the recursion on malformed hierarchies.
+    m_known_hierarchies[type] = false;
+    known = has_known_hierarchy(cls->get_super_class());
+    for (DexType* intf : cls->get_interfaces()->get_type_list()) {
+      known = known && has_known_hierarchy(intf);
+    }
+  }
+  m_known_hierarchies[type] = known;
+  return known;
+}
+
+PointsToSolver::NodeId PointsToSolver::new_node() {
+  NodeId id = m_nodes.size();
+  m_nodes.emplace_back();
+  m_nodes.back().parent = id;
+  return id;
+}
+
+PointsToSolver::NodeId PointsToSolver::local_node(DexMethodRef* method,
+                                                  PointsToVariable v) {
+  auto it = m_locals.find({method, v});
+  if (it != m_locals.end()) {
+    return it->second;
+  }
+  NodeId node = new_node();
+  m_locals.emplace(LocalKey(method, v), node);
+  return node;
+}
+
+PointsToSolver::NodeId PointsToSolver::parameter_node(DexMethodRef* method,
+                                                      size_t parameter) {
+  auto it = m_parameters.find({method, parameter});
+  if (it != m_parameters.end()) {
+    return it->second;
+  }
+  NodeId node = new_node();
+  m_parameters.emplace(ParameterKey(method, parameter), node);
+  return node;
+}
+
+PointsToSolver::NodeId PointsToSolver::return_node(DexMethodRef* method) {
+  auto it = m_returns.find(method);
+  if (it != m_returns.end()) {
+    return it->second;
+  }
+  NodeId node = new_node();
+  m_returns.emplace(method, node);
+  return node;
+}
+
+PointsToSolver::NodeId PointsToSolver::static_field_node(
+    const DexFieldRef* field) {
+  auto it = m_static_fields.find(field);
+  if (it != m_static_fields.end()) {
+    return it->second;
+  }
+  NodeId node = new_node();
+  m_static_fields.emplace(field, node);
+  return node;
+}
+
+PointsToSolver::NodeId PointsToSolver::instance_field_node(
+    ObjectId object, const DexFieldRef* field) {
+  auto it = m_instance_fields.find({object, field});
+  if (it != m_instance_fields.end()) {
+    return it->second;
+  }
+  NodeId node = new_node();
+  m_instance_fields.emplace(FieldKey(object, field), node);
+  return node;
+}
+
+PointsToSolver::ObjectId PointsToSolver::allocation_site(
+    PointsToOperationKind kind,
+    DexType* type,
+    DexMethodRef* method,
+    PointsToVariable v) {
+  auto it = m_sites.find({method, v});
+  if (it != m_sites.end()) {
+    return it->second;
+  }
+  ObjectId id = m_objects.size();
+  m_objects.push_back({kind, type, method, v, nullptr});
+  m_sites.emplace(LocalKey(method, v), id);
+  return id;
+}
+
+PointsToSolver::ObjectId PointsToSolver::class_object(DexType* type) {
+  auto it = m_class_objects.find(type);
+  if (it != m_class_objects.end()) {
+    return it->second;
+  }
+  ObjectId id = m_objects.size();
+  m_objects.push_back(
+      {PTS_CONST_CLASS, type::java_lang_Class(), nullptr, PointsToVariable(),
+       type});
+  m_class_objects.emplace(type, id);
+  return id;
+}
+
+const DexFieldRef* PointsToSolver::canonical_field(const DexFieldRef* field) {
+  if (field == nullptr) {
+    return nullptr;
+  }
+  // Field references may name a subclass of the class that declares the
+  // field.
+  const DexField* def = resolve_field(field);
+  return def != nullptr ? def : field;
+}
@@ -0,0 +1,252 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <ostream>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <boost/functional/hash.hpp>
+#include <boost/optional.hpp>
+
+#include "DexClass.h"
+#include "PatriciaTreeSet.h"
+#include "PointsToSemantics.h"
+
+/*
+ * An abstract object instance, i.e., an allocation site. Class objects and
+ * exceptions are not tied to a site: there is one abstract java.lang.Class
+ * object per class denoted and, following the interpretation of
+ * PTS_GET_EXCEPTION, a single abstract object standing for all exceptions.
+ */
+struct PointsToAbstractObject {
+  // One of PTS_NEW_OBJECT, PTS_CONST_STRING, PTS_CONST_CLASS or
+  // PTS_GET_EXCEPTION.
+  PointsToOperationKind kind;
+  // The dynamic type of the object.
+  DexType* type;
+  // The method containing the allocation site, if any.
+  DexMethodRef* method;
+  // The variable defined by the allocation site, if any.
+  PointsToVariable variable;
+  // For class objects, the class denoted.
+  DexType* class_type;
+};
+
+std::ostream& operator<<(std::ostream& o, const PointsToAbstractObject& obj);
+
+/*
+ * A whole-program, context-insensitive and field-sensitive solver for the
+ * points-to semantics of a scope, in the style of Andersen's analysis. The
+ * call graph is built on the fly: virtual and interface calls are resolved
+ * against the dynamic types of the objects that flow into their receiver.
+ *
+ * The solver scales to whole apps by means of two standard techniques:
+ *
+ * - Difference propagation: each variable only pushes the objects it has
+ *   received since it was last processed along its outgoing edges, instead of
+ *   its entire points-to set.
+ *
+ *     D. J. Pearce, P. H. J. Kelly and C. Hankin. Online Cycle Detection and
+ *     Difference Propagation for Pointer Analysis. SCAM 2003.
+ *
+ * - Lazy cycle detection: all the variables of a cycle of copy edges end up
+ *   with the same points-to set, hence they can be merged into one. When an
+ *   edge propagates nothing because both of its ends already agree, we look
+ *   for a cycle through that edge and collapse it.
+ *
+ *     B. Hardekopf and C. Lin. The Ant and the Grasshopper: Fast and Accurate
+ *     Pointer Analysis for Millions of Lines of Code. PLDI 2007.
+ *
+ * Calls to methods that have no points-to semantics (external or native
+ * methods, unless stubs have been loaded) don't return any object. Check-cast
+ * operations filter out objects that can't be cast when the class hierarchy
+ * is known.
+ */
+class PointsToSolver final {
+ public:
+  using ObjectId = uint32_t;
+  using ObjectSet = sparta::PatriciaTreeSet<ObjectId>;
+  using CalleeSet = std::unordered_set<DexMethodRef*>;
+
+  struct Stats {
+    size_t variables{0};
+    size_t objects{0};
+    size_t copy_edges{0};
+    size_t call_edges{0};
+    size_t collapsed_variables{0};
+    size_t propagations{0};
+  };
+
+  explicit PointsToSolver(PointsToSemantics& semantics);
+
+  PointsToSolver(const PointsToSolver& other) = delete;
+
+  PointsToSolver& operator=(const PointsToSolver& other) = delete;
+
+  void run();
+
+  const Stats& get_stats() const { return m_stats; }
+
+  const PointsToAbstractObject& get_object(ObjectId id) const {
+    return m_objects.at(id);
+  }
+
+  ObjectSet get_points_to_set(DexMethodRef* method, PointsToVariable v) const;
+
+  // The objects returned by the method.
+  ObjectSet get_return_points_to_set(DexMethodRef* method) const;
+
+  ObjectSet get_static_field_points_to_set(DexFieldRef* field) const;
+
+  ObjectSet get_instance_field_points_to_set(ObjectId object,
+                                             DexFieldRef* field) const;
+
+  ObjectSet get_array_element_points_to_set(ObjectId array) const;
+
+  // The methods that the given invoke action of the method may call.
+  const CalleeSet& get_callees(DexMethodRef* method,
+                               const PointsToAction& call) const;
+
+  // The methods that the method may call.
+  CalleeSet get_callees(DexMethodRef* method) const;
+
+ private:
+  using NodeId = uint32_t;
+  using NodeSet = sparta::PatriciaTreeSet<NodeId>;
+
+  // Constraints that depend on the dynamic contents of a points-to set.
+  enum ConstraintKind {
+    // `target = o.field` for each object o of the set.
+    LOAD,
+    // `o.field = target` for each object o of the set.
+    STORE,
+    // `target = o.getClass()` for each object o of the set.
+    GET_CLASS,
+    // `target = (type) o` for each object o of the set.
+    CHECK_CAST,
+    // A virtual call on each object o of the set.
+    VIRTUAL_CALL,
+  };
+
+  struct Constraint {
+    ConstraintKind kind;
+    NodeId target;
+    union {
+      const DexFieldRef* field;
+      DexType* type;
+      size_t call_site;
+    };
+  };
+
+  struct Node {
+    ObjectSet points_to;
+    // The objects that haven't been propagated yet.
+    ObjectSet delta;
+    NodeSet successors;
+    std::vector<size_t> constraints;
+    NodeId parent;
+    bool in_worklist{false};
+  };
+
+  struct CallSite {
+    DexMethodRef* caller;
+    const PointsToAction* action;
+    CalleeSet callees;
+  };
+
+  using LocalKey = std::pair<DexMethodRef*, PointsToVariable>;
+  using ParameterKey = std::pair<DexMethodRef*, size_t>;
+  using FieldKey = std::pair<ObjectId, const DexFieldRef*>;
+
+  void add_method(DexMethodRef* method, const PointsToMethodSemantics& s);
+
+  void add_action(DexMethodRef* method, const PointsToAction& a);
+
+  void add_call(DexMethodRef* method, const PointsToAction& a);
+
+  void add_constraint(NodeId source, const Constraint& c);
+
+  void apply_constraint(const Constraint& c, ObjectId object);
+
+  // Connects a call site with one of its targets.
+  void link(size_t call_site, DexMethodRef* callee);
+
+  void add_edge(NodeId source, NodeId target);
+
+  void add_objects(NodeId node, const ObjectSet& objects);
+
+  void process(NodeId node);
+
+  void collapse_cycles(NodeId root);
+
+  void merge(NodeId rep, NodeId node);
+
+  // Returns the representative of the node's cycle, if it's been collapsed.
+  NodeId find(NodeId node);
+
+  ObjectSet points_to_set(NodeId node) const;
+
+  bool may_cast(DexType* type, DexType* base_type);
+
+  bool has_known_hierarchy(const DexType* type);
+
+  NodeId new_node();
+
+  NodeId local_node(DexMethodRef* method, PointsToVariable v);
+
+  NodeId parameter_node(DexMethodRef* method, size_t parameter);
+
+  NodeId return_node(DexMethodRef* method);
+
+  NodeId static_field_node(const DexFieldRef* field);
+
+  NodeId instance_field_node(ObjectId object, const DexFieldRef* field);
+
+  ObjectId allocation_site(PointsToOperationKind kind,
+                           DexType* type,
+                           DexMethodRef* method,
+                           PointsToVariable v);
+
+  ObjectId class_object(DexType* type);
+
+  static bool is_null(PointsToVariable v) {
+    return v == PointsToVariable::null_variable();
+  }
+
+  static const DexFieldRef* canonical_field(const DexFieldRef* field);
+
+  PointsToSemantics& m_semantics;
+  std::vector<Node> m_nodes;
+  std::deque<NodeId> m_worklist;
+  std::vector<Constraint> m_constraints;
+  std::vector<CallSite> m_call_sites;
+  std::vector<PointsToAbstractObject> m_objects;
+  // The copy edges that have already triggered a cycle detection.
+  std::unordered_set<std::pair<NodeId, NodeId>,
+                     boost::hash<std::pair<NodeId, NodeId>>>
+      m_checked_edges;
+  std::vector<NodeId> m_cycle_candidates;
+  std::unordered_map<LocalKey, NodeId, boost::hash<LocalKey>> m_locals;
+  std::unordered_map<ParameterKey, NodeId, boost::hash<ParameterKey>>
+      m_parameters;
+  std::unordered_map<DexMethodRef*, NodeId> m_returns;
+  std::unordered_map<const DexFieldRef*, NodeId> m_static_fields;
+  std::unordered_map<FieldKey, NodeId, boost::hash<FieldKey>> m_instance_fields;
+  std::unordered_map<LocalKey, ObjectId, boost::hash<LocalKey>> m_sites;
+  std::unordered_map<DexType*, ObjectId> m_class_objects;
+  boost::optional<ObjectId> m_exception_object;
+  std::unordered_map<const DexType*, bool> m_known_hierarchies;
+  std::unordered_map<const PointsToAction*, size_t> m_call_site_ids;
+  std::unordered_map<DexMethodRef*, std::vector<size_t>> m_method_call_sites;
+  Stats m_stats;
+};
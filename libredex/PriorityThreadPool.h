@@ -23,6 +23,7 @@
 #include <boost/thread/mutex.hpp>
 
 #include "Debug.h"
+#include "SpartaThreadPool.h"
 #include "SpartaWorkQueue.h"
 
 /*
@@ -32,16 +33,63 @@
  *   priorities.
  *
  * The thread-pool must be initialized with a positive number of threads to be
- * functional.
+ * functional. If a shared sparta::parallel::ThreadPool is installed at that
+ * point, work items run on it, with at most that many items in flight, rather
+ * than on a dedicated set of threads.
  */
 class PriorityThreadPool {
  private:
   std::unique_ptr<boost::asio::thread_pool> m_pool;
-  // The following data structures are guarded by this mutex.
-  boost::mutex m_mutex;
-  std::map<int, std::queue<std::function<void()>>> m_pending_work_items;
-  size_t m_running_work_items{0};
-  boost::condition_variable m_condition;
+  // When a shared sparta thread pool is installed, work items are drained by
+  // at most m_max_drainers jobs running on it instead of on m_pool.
+  sparta::parallel::ThreadPool* m_shared_pool{nullptr};
+  size_t m_max_drainers{0};
+  struct State {
+    // The following data structures are guarded by this mutex.
+    boost::mutex mutex;
+    std::map<int, std::queue<std::function<void()>>> pending_work_items;
+    size_t running_work_items{0};
+    // Drainers posted to the shared pool that have not returned yet.
+    size_t num_drainers{0};
+    boost::condition_variable condition;
+
+    // Pop the work item with highest priority. The mutex must be held.
+    std::function<void()> take_highest_priority_work_item() {
+      auto& p = *pending_work_items.rbegin();
+      auto& queue = p.second;
+      std::function<void()> highest_priority_f = queue.front();
+      queue.pop();
+      if (queue.empty()) {
+        auto highest_priority = p.first;
+        pending_work_items.erase(highest_priority);
+      }
+      running_work_items++;
+      return highest_priority_f;
+    }
+
+    // Run pending work items on the calling thread until there are none left.
+    // The mutex must be held via :lock.
+    void run_pending_work_items(boost::mutex::scoped_lock& lock) {
+      while (!pending_work_items.empty()) {
+        auto f = take_highest_priority_work_item();
+        lock.unlock();
+        // Run!
+        f();
+        lock.lock();
+        // Notify when *all* work is done, i.e. nothing is running or pending.
+        if (--running_work_items == 0 && pending_work_items.empty()) {
+          condition.notify_all();
+        }
+      }
+    }
+
+    bool is_done() const {
+      return running_work_items == 0 && pending_work_items.empty();
+    }
+  };
+  // Drainers hold on to the state, as they may only get to run on a busy
+  // shared pool after this instance is gone; they then find nothing to do.
+  std::shared_ptr<State> m_state{std::make_shared<State>()};
   std::chrono::duration<double> m_waited_time;
 
  public:
@@ -55,7 +103,7 @@ class PriorityThreadPool {
 
   ~PriorityThreadPool() {
     // .join() must be manually called before the executor may be destroyed
-    always_assert(m_pending_work_items.empty());
+    always_assert(m_state->pending_work_items.empty());
   }
 
   long get_waited_seconds() {
@@ -65,67 +113,101 @@ class PriorityThreadPool {
 
   // The number of threads may be set at most once to a positive number
   void set_num_threads(int num_threads) {
-    always_assert(!m_pool);
+    always_assert(!m_pool && !m_shared_pool);
     if (num_threads > 0) {
-      m_pool = std::make_unique<boost::asio::thread_pool>(num_threads);
+      m_shared_pool = sparta::parallel::get_shared_thread_pool();
+      if (m_shared_pool != nullptr) {
+        m_shared_pool->ensure_threads(num_threads);
+        m_max_drainers = num_threads;
+      } else {
+        m_pool = std::make_unique<boost::asio::thread_pool>(num_threads);
+      }
     }
   }
 
   // Post a work item with a priority. This method is thread safe.
   void post(int priority, const std::function<void()>& f) {
-    always_assert(m_pool);
+    always_assert(m_pool || m_shared_pool);
+    if (m_shared_pool) {
+      bool spawn_drainer = false;
+      {
+        boost::mutex::scoped_lock lock(m_state->mutex);
+        m_state->pending_work_items[priority].push(f);
+        if (m_state->num_drainers < m_max_drainers) {
+          m_state->num_drainers++;
+          spawn_drainer = true;
+        }
+      }
+      if (spawn_drainer) {
+        m_shared_pool->post([state = m_state]() {
+          boost::mutex::scoped_lock lock(state->mutex);
+          state->run_pending_work_items(lock);
+          state->num_drainers--;
+        });
+      }
+      return;
+    }
     {
-      boost::mutex::scoped_lock lock(m_mutex);
-      m_pending_work_items[priority].push(f);
+      boost::mutex::scoped_lock lock(m_state->mutex);
+      m_state->pending_work_items[priority].push(f);
     }
     boost::asio::defer(*m_pool, [this]() {
+      auto& state = *m_state;
       // Find work item with highest priority
       std::function<void()> highest_priority_f;
       {
-        boost::mutex::scoped_lock lock(m_mutex);
-        auto& p = *m_pending_work_items.rbegin();
-        auto& queue = p.second;
-        highest_priority_f = queue.front();
-        queue.pop();
-        if (queue.empty()) {
-          auto highest_priority = p.first;
-          m_pending_work_items.erase(highest_priority);
-        }
-        m_running_work_items++;
+        boost::mutex::scoped_lock lock(state.mutex);
+        highest_priority_f = state.take_highest_priority_work_item();
       }
       // Run!
       highest_priority_f();
       // Notify when *all* work is done, i.e. nothing is running or pending.
       {
-        boost::mutex::scoped_lock lock(m_mutex);
-        if (--m_running_work_items == 0 && m_pending_work_items.empty()) {
-          m_condition.notify_one();
+        boost::mutex::scoped_lock lock(state.mutex);
+        if (--state.running_work_items == 0 &&
+            state.pending_work_items.empty()) {
+          state.condition.notify_all();
         }
       }
     });
   }
 
-  // Wait for all work items to be processed.
+  // Wait for all work items to be processed, including those that running
+  // work items post in the meantime.
   void wait() {
-    always_assert(m_pool);
+    always_assert(m_pool || m_shared_pool);
     auto start = std::chrono::system_clock::now();
+    auto& state = *m_state;
     {
       // We wait until *all* work is done, i.e. nothing is running or pending.
-      boost::mutex::scoped_lock lock(m_mutex);
-      while (m_running_work_items != 0 || !m_pending_work_items.empty()) {
+      boost::mutex::scoped_lock lock(state.mutex);
+      while (!state.is_done()) {
+        if (m_shared_pool) {
+          // The shared pool may be too busy to ever start our drainers, e.g.
+          // when we are waiting on one of its threads, so help out. Work
+          // items don't wait on each other, so this makes progress even
+          // when no drainer does.
+          state.run_pending_work_items(lock);
+          if (state.is_done()) {
+            break;
+          }
+        }
         // We'll wait until the condition variable gets notified. Waiting for
         // that will first release the lock, and re-acquire it after the
         // notification came in.
-        m_condition.wait(lock);
+        state.condition.wait(lock);
       }
     }
     auto end = std::chrono::system_clock::now();
     m_waited_time += end - start;
-    always_assert(m_pending_work_items.empty());
+    always_assert(state.pending_work_items.empty());
   }
 
   void join() {
     wait();
-    m_pool->join();
+    // The shared pool outlives this instance and is joined by its owner.
+    if (m_pool) {
+      m_pool->join();
+    }
   }
 };
@@ -7,6 +7,9 @@
 
 #include "ProguardMap.h"
 
+#include <boost/filesystem.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+
 #include "DexUtil.h"
 #include "IRCode.h"
 #include "Timer.h"
@@ -14,14 +17,6 @@
 
 namespace {
 
-std::string find_or_same(
-    const std::string& key,
-    const std::unordered_map<std::string, std::string>& map) {
-  auto it = map.find(key);
-  if (it == map.end()) return key;
-  return it->second;
-}
-
 std::string convert_scalar_type(const std::string& type) {
   static const std::unordered_map<std::string, std::string> prim_map = {
       {"void", "V"},  {"boolean", "Z"}, {"byte", "B"},
@@ -147,12 +142,31 @@ bool is_maybe_proguard_generated_member(const std::string& s) {
 ProguardMap::ProguardMap(const std::string& filename) {
   if (!filename.empty()) {
     Timer t("Parsing proguard map");
-    std::ifstream fp(filename);
-    always_assert_log(fp, "Can't open proguard map: %s\n", filename.c_str());
-    parse_proguard_map(fp);
+    boost::system::error_code ec;
+    auto size = boost::filesystem::file_size(filename, ec);
+    always_assert_log(!ec, "Can't open proguard map: %s\n", filename.c_str());
+    // Empty files can't be mapped.
+    if (size == 0) {
+      return;
+    }
+    boost::iostreams::mapped_file_source file(filename);
+    parse_proguard_map(file.data(), file.size());
   }
 }
 
+const std::string* ProguardMap::intern(std::string name) {
+  return &*m_names.emplace(std::move(name)).first;
+}
+
+std::string ProguardMap::find_or_same(const std::string& key,
+                                      const NameMap& map) const {
+  auto name = m_names.find(key);
+  if (name == m_names.end()) return key;
+  auto it = map.find(&*name);
+  if (it == map.end()) return key;
+  return *it->second;
+}
+
 std::string ProguardMap::translate_class(const std::string& cls) const {
   return find_or_same(cls, m_classMap);
 }
@@ -219,21 +233,45 @@ void ProguardMap::parse_proguard_map(std::istream& fp) {
   fp.seekg(0);
   assert_log(!fp.fail(), "Can't use ProguardMap with non-seekable stream");
   while (std::getline(fp, line)) {
-    if (parse_class(line)) {
-      continue;
-    }
-    if (parse_field(line)) {
-      continue;
-    }
-    if (parse_method(line)) {
-      continue;
-    }
-    if (comment(line)) {
-      continue;
+    parse_line(line);
+  }
+}
+
+void ProguardMap::parse_proguard_map(const char* data, size_t size) {
+  // The parsers expect a null-terminated line, so each line is copied into
+  // the same buffer, which stops allocating once it fits the longest line.
+  std::string line;
+  auto for_each_line = [&](const std::function<void()>& f) {
+    const char* end = data + size;
+    for (const char* b = data; b < end;) {
+      auto e = static_cast<const char*>(memchr(b, '\n', end - b));
+      if (e == nullptr) {
+        e = end;
+      }
+      line.assign(b, e);
+      f();
+      b = e + 1;
     }
-    always_assert_log(
-        false, "Bogus line encountered in proguard map: %s\n", line.c_str());
+  };
+  for_each_line([&] { parse_class(line); });
+  for_each_line([&] { parse_line(line); });
+}
+
+void ProguardMap::parse_line(const std::string& line) {
+  if (parse_class(line)) {
+    return;
+  }
+  if (parse_field(line)) {
+    return;
+  }
+  if (parse_method(line)) {
+    return;
+  }
+  if (comment(line)) {
+    return;
   }
+  always_assert_log(
+      false, "Bogus line encountered in proguard map: %s\n", line.c_str());
 }
 
 bool ProguardMap::parse_class(const std::string& line) {
@@ -245,8 +283,10 @@ bool ProguardMap::parse_class(const std::string& line) {
   if (!id(p, newname)) return false;
   m_currClass = convert_type(classname);
   m_currNewClass = convert_type(newname);
-  m_classMap[m_currClass] = m_currNewClass;
-  m_obfClassMap[m_currNewClass] = m_currClass;
+  auto old_name = intern(m_currClass);
+  auto new_name = intern(m_currNewClass);
+  m_classMap[old_name] = new_name;
+  m_obfClassMap[new_name] = old_name;
   return true;
 }
 
@@ -276,9 +316,11 @@ bool ProguardMap::parse_field(const std::string& line) {
             pgold.c_str());
     m_pg_coalesced_interfaces.insert(ctype);
   }
-  m_fieldMap[pgold] = pgnew;
-  m_obfFieldMap[pgnew] = pgold;
-  m_obfUntypedFieldMap[pgnew_notype] = pgold;
+  auto old_name = intern(std::move(pgold));
+  auto new_name = intern(std::move(pgnew));
+  m_fieldMap[old_name] = new_name;
+  m_obfFieldMap[new_name] = old_name;
+  m_obfUntypedFieldMap[intern(std::move(pgnew_notype))] = old_name;
   return true;
 }
 
@@ -328,11 +370,14 @@ bool ProguardMap::parse_method(const std::string& line) {
   auto pgold = convert_method(classname, old_rtype, methodname, old_args);
   auto pgnew = convert_method(m_currNewClass, new_rtype, newname, new_args);
   auto pgnew_no_rtype = convert_method(m_currNewClass, "", newname, new_args);
-  m_methodMap[pgold] = pgnew;
-  m_obfMethodMap[pgnew] = pgold;
-  m_obfUntypedMethodMap[pgnew_no_rtype] = pgold;
-  lines->original_name = pgold;
-  m_obfMethodLinesMap[pg_impl::lines_key(pgnew)].push_back(std::move(lines));
+  auto old_name = intern(std::move(pgold));
+  auto new_name = intern(std::move(pgnew));
+  m_methodMap[old_name] = new_name;
+  m_obfMethodMap[new_name] = old_name;
+  m_obfUntypedMethodMap[intern(std::move(pgnew_no_rtype))] = old_name;
+  lines->original_name = *old_name;
+  m_obfMethodLinesMap[pg_impl::lines_key(*new_name)].push_back(
+      std::move(lines));
   return true;
 }
 
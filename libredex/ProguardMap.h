@@ -37,6 +37,10 @@
  * For classes, this is the full descriptor.
  * For methods, it's <class descriptor>.<name>(<args descs>)<return desc> .
  * For fields,  it's <class descriptor>.<name>:<type desc> .
+ *
+ * Mapping files can be huge, so every distinct name is stored only once and
+ * the translation tables refer to those copies. Files are memory-mapped and
+ * parsed in place rather than read through a stream.
  */
 struct ProguardMap {
   /**
@@ -111,30 +115,41 @@ struct ProguardMap {
   }
 
  private:
+  // Maps between names owned by m_names.
+  using NameMap = std::unordered_map<const std::string*, const std::string*>;
+
   void parse_proguard_map(std::istream& fp);
+  void parse_proguard_map(const char* data, size_t size);
+  void parse_line(const std::string& line);
 
   bool parse_class(const std::string& line);
   bool parse_field(const std::string& line);
   bool parse_method(const std::string& line);
 
+  const std::string* intern(std::string name);
+  std::string find_or_same(const std::string& key, const NameMap& map) const;
+
  private:
+  // All the names in the maps below
+  std::unordered_set<std::string> m_names;
+
   // Unobfuscated to obfuscated maps
-  std::unordered_map<std::string, std::string> m_classMap;
-  std::unordered_map<std::string, std::string> m_fieldMap;
-  std::unordered_map<std::string, std::string> m_methodMap;
+  NameMap m_classMap;
+  NameMap m_fieldMap;
+  NameMap m_methodMap;
 
   // Obfuscated to unobfuscated maps from proguard
-  std::unordered_map<std::string, std::string> m_obfClassMap;
-  std::unordered_map<std::string, std::string> m_obfFieldMap;
-  std::unordered_map<std::string, std::string> m_obfMethodMap;
+  NameMap m_obfClassMap;
+  NameMap m_obfFieldMap;
+  NameMap m_obfMethodMap;
 
   // Field map for reflection analysis when type is unknown
   // Stores Lcom/facebook/Class;.field -> original name without class name
-  std::unordered_map<std::string, std::string> m_obfUntypedFieldMap;
+  NameMap m_obfUntypedFieldMap;
 
   // Method map for reflection analysis when return type is unknown
   // Stores Lcom/facebook/Class;.method(II) -> original name without class name
-  std::unordered_map<std::string, std::string> m_obfUntypedMethodMap;
+  NameMap m_obfUntypedMethodMap;
 
   std::unordered_map<std::string, ProguardLineRangeVector> m_obfMethodLinesMap;
 
@@ -6,6 +6,7 @@
  */
 
 #include <algorithm>
+#include <atomic>
 #include <boost/regex.hpp>
 #include <iostream>
 #include <mutex>
@@ -28,14 +29,43 @@ using namespace keep_rules;
 
 namespace {
 
-using RegexMap = std::unordered_map<std::string, boost::regex>;
+/*
+ * The compiled regexes of all rules, shared by the threads that match them.
+ * Compiling a boost::regex is expensive and many rules use the same class and
+ * member patterns, so each pattern is compiled only once.
+ */
+class RegexCache {
+ public:
+  const boost::regex& get(const std::string& regex) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto& rx = m_regexes[regex];
+    if (rx == nullptr) {
+      rx = std::make_unique<boost::regex>(regex);
+    }
+    return *rx;
+  }
 
-std::unique_ptr<boost::regex> make_rx(const std::string& s,
-                                      bool convert = true) {
-  if (s.empty()) return nullptr;
+ private:
+  std::mutex m_mutex;
+  std::unordered_map<std::string, std::unique_ptr<boost::regex>> m_regexes;
+};
+
+std::string type_rx(const std::string& s, bool convert = true) {
+  if (s.empty()) return "";
   auto wc = convert ? proguard_parser::convert_wildcard_type(s) : s;
-  auto rx = proguard_parser::form_type_regex(wc);
-  return std::make_unique<boost::regex>(rx);
+  return proguard_parser::form_type_regex(wc);
+}
+
+const boost::regex* make_rx(RegexCache& regex_cache,
+                            const std::string& s,
+                            bool convert = true) {
+  if (s.empty()) return nullptr;
+  return &regex_cache.get(type_rx(s, convert));
+}
+
+// Whether :name starts with :prefix.
+bool has_prefix(const std::string& name, const std::string& prefix) {
+  return name.compare(0, prefix.size(), prefix) == 0;
 }
 
 std::string get_deobfuscated_name(const DexType* type) {
@@ -62,14 +92,19 @@ bool match_annotation_rx(const DexClass* cls, const boost::regex& annorx) {
  * rule.
  */
 struct ClassMatcher {
-  explicit ClassMatcher(const KeepSpec& ks)
+  ClassMatcher(const KeepSpec& ks, RegexCache& regex_cache)
       : setFlags_(ks.class_spec.setAccessFlags),
         unsetFlags_(ks.class_spec.unsetAccessFlags),
         m_class_name(ks.class_spec.className),
-        m_cls(make_rx(ks.class_spec.className)),
-        m_anno(make_rx(ks.class_spec.annotationType, false)),
-        m_extends(make_rx(ks.class_spec.extendsClassName)),
-        m_extends_anno(make_rx(ks.class_spec.extendsAnnotationType, false)) {}
+        m_cls(make_rx(regex_cache, ks.class_spec.className)),
+        m_anno(make_rx(regex_cache, ks.class_spec.annotationType, false)),
+        m_extends(make_rx(regex_cache, ks.class_spec.extendsClassName)),
+        m_extends_anno(
+            make_rx(regex_cache, ks.class_spec.extendsAnnotationType, false)),
+        m_cls_prefix(
+            proguard_parser::literal_prefix(type_rx(ks.class_spec.className))),
+        m_extends_prefix(proguard_parser::literal_prefix(
+            type_rx(ks.class_spec.extendsClassName))) {}
 
   bool match(const DexClass* cls) {
     // Check for class name match
@@ -93,7 +128,9 @@ struct ClassMatcher {
  private:
   bool match_name(const DexClass* cls) const {
     const auto& deob_name = cls->get_deobfuscated_name();
-    return boost::regex_match(deob_name, *m_cls);
+    // Most classes are rejected by the literal prefix of the pattern alone.
+    return has_prefix(deob_name, m_cls_prefix) &&
+           boost::regex_match(deob_name, *m_cls);
   }
 
   bool match_access(const DexClass* cls) const {
@@ -120,7 +157,8 @@ struct ClassMatcher {
       }
     }
     const auto& deob_name = cls->get_deobfuscated_name();
-    return boost::regex_match(deob_name, *m_extends);
+    return has_prefix(deob_name, m_extends_prefix) &&
+           boost::regex_match(deob_name, *m_extends);
   }
 
   bool search_interfaces(const DexClass* cls) {
@@ -168,10 +206,12 @@ struct ClassMatcher {
   DexAccessFlags setFlags_;
   DexAccessFlags unsetFlags_;
   std::string m_class_name;
-  std::unique_ptr<boost::regex> m_cls;
-  std::unique_ptr<boost::regex> m_anno;
-  std::unique_ptr<boost::regex> m_extends;
-  std::unique_ptr<boost::regex> m_extends_anno;
+  const boost::regex* m_cls;
+  const boost::regex* m_anno;
+  const boost::regex* m_extends;
+  const boost::regex* m_extends_anno;
+  std::string m_cls_prefix;
+  std::string m_extends_prefix;
 
   std::unordered_map<const DexClass*, bool> m_extends_result_cache;
 };
@@ -215,23 +255,52 @@ void build_extends_or_implements_hierarchy(const Scope& scope,
   }
 }
 
+std::string field_regex(const MemberSpecification& field_spec) {
+  string_builders::StaticStringBuilder<3> ss;
+  ss << proguard_parser::form_member_regex(field_spec.name);
+  ss << "\\:";
+  ss << proguard_parser::form_type_regex(field_spec.descriptor);
+  return ss.str();
+}
+
+std::string method_regex(const MemberSpecification& method_spec) {
+  auto qualified_method_regex =
+      proguard_parser::form_member_regex(method_spec.name);
+  qualified_method_regex += "\\:";
+  qualified_method_regex +=
+      proguard_parser::form_type_regex(method_spec.descriptor);
+  return qualified_method_regex;
+}
+
 /*
  * This class contains the logic for matching against a single keep rule.
+ * Its member regexes are compiled upfront, so that it can be applied to
+ * different classes concurrently.
  */
 class KeepRuleMatcher {
  public:
   KeepRuleMatcher(RuleType rule_type,
                   const KeepSpec& keep_rule,
-                  RegexMap& regex_map)
+                  RegexCache& regex_cache)
       : m_rule_type(rule_type),
         m_keep_rule(keep_rule),
-        m_regex_map(regex_map) {}
+        m_regex_cache(regex_cache) {
+    for (const auto& field_spec : keep_rule.class_spec.fieldSpecifications) {
+      m_field_regexes.push_back(&regex_cache.get(field_regex(field_spec)));
+    }
+    for (const auto& method_spec : keep_rule.class_spec.methodSpecifications) {
+      m_method_regexes.push_back(&regex_cache.get(method_regex(method_spec)));
+    }
+  }
 
   ~KeepRuleMatcher() {
     TRACE(PGR, 3, "%s matched %lu classes and %lu members",
-          show_keep(m_keep_rule).c_str(), m_class_matches, m_member_matches);
+          show_keep(m_keep_rule).c_str(), m_class_matches.load(),
+          m_member_matches.load());
   }
 
+  const KeepSpec& keep_rule() const { return m_keep_rule; }
+
   void keep_processor(DexClass*);
 
   void mark_class_and_members_for_keep(DexClass* cls);
@@ -241,16 +310,14 @@ class KeepRuleMatcher {
                           const boost::regex& method_regex);
 
   // Check that each method keep matches at least one method in :cls.
-  bool all_method_keeps_match(
-      const std::vector<MemberSpecification>& method_keeps,
-      const DexClass* cls);
+  bool all_method_keeps_match(const DexClass* cls);
 
   bool any_field_matches(const DexClass* cls,
-                         const MemberSpecification& field_keep);
+                         const MemberSpecification& field_keep,
+                         const boost::regex& field_regex);
 
   // Check that each field keep matches at least one field in :cls.
-  bool all_field_keeps_match(
-      const std::vector<MemberSpecification>& field_keeps, const DexClass* cls);
+  bool all_field_keeps_match(const DexClass* cls);
 
   void process_whyareyoukeeping(DexClass* cls);
 
@@ -287,19 +354,19 @@ class KeepRuleMatcher {
   bool has_annotation(const DexMember* member,
                       const std::string& annotation) const;
 
-  boost::regex register_matcher(const std::string& regex) const {
-    if (!m_regex_map.count(regex)) {
-      m_regex_map.emplace(regex, boost::regex{regex});
-    }
-    return m_regex_map.at(regex);
+  const boost::regex& register_matcher(const std::string& regex) const {
+    return m_regex_cache.get(regex);
   }
 
  private:
-  size_t m_member_matches{0};
-  size_t m_class_matches{0};
+  std::atomic<size_t> m_member_matches{0};
+  std::atomic<size_t> m_class_matches{0};
   RuleType m_rule_type;
   const KeepSpec& m_keep_rule;
-  RegexMap& m_regex_map;
+  RegexCache& m_regex_cache;
+  // The regexes of the field and method specifications of the rule.
+  std::vector<const boost::regex*> m_field_regexes;
+  std::vector<const boost::regex*> m_method_regexes;
 };
 
 class ProguardMatcher {
@@ -331,6 +398,7 @@ class ProguardMatcher {
   const Scope& m_classes;
   const Scope& m_external_classes;
   ClassHierarchy m_hierarchy;
+  RegexCache m_regex_cache;
 };
 
 // Updates a class, field or method to add keep modifiers.
@@ -445,20 +513,12 @@ void KeepRuleMatcher::keep_fields(const Container& fields,
   }
 }
 
-std::string field_regex(const MemberSpecification& field_spec) {
-  string_builders::StaticStringBuilder<3> ss;
-  ss << proguard_parser::form_member_regex(field_spec.name);
-  ss << "\\:";
-  ss << proguard_parser::form_type_regex(field_spec.descriptor);
-  return ss.str();
-}
-
 void KeepRuleMatcher::apply_field_keeps(const DexClass* cls) {
-  for (const auto& field_spec : m_keep_rule.class_spec.fieldSpecifications) {
-    auto fieldname_regex = field_regex(field_spec);
-    const boost::regex& matcher = register_matcher(fieldname_regex);
-    keep_fields(cls->get_ifields(), field_spec, matcher);
-    keep_fields(cls->get_sfields(), field_spec, matcher);
+  const auto& field_specs = m_keep_rule.class_spec.fieldSpecifications;
+  for (size_t i = 0; i < field_specs.size(); ++i) {
+    const boost::regex& matcher = *m_field_regexes[i];
+    keep_fields(cls->get_ifields(), field_specs[i], matcher);
+    keep_fields(cls->get_sfields(), field_specs[i], matcher);
   }
 }
 
@@ -497,22 +557,12 @@ void KeepRuleMatcher::keep_methods(
   }
 }
 
-std::string method_regex(const MemberSpecification& method_spec) {
-  auto qualified_method_regex =
-      proguard_parser::form_member_regex(method_spec.name);
-  qualified_method_regex += "\\:";
-  qualified_method_regex +=
-      proguard_parser::form_type_regex(method_spec.descriptor);
-  return qualified_method_regex;
-}
-
 void KeepRuleMatcher::apply_method_keeps(const DexClass* cls) {
-  auto methodSpecifications = m_keep_rule.class_spec.methodSpecifications;
-  for (auto& method_spec : methodSpecifications) {
-    auto qualified_method_regex = method_regex(method_spec);
-    const boost::regex& method_regex = register_matcher(qualified_method_regex);
-    keep_methods(method_spec, cls->get_vmethods(), method_regex);
-    keep_methods(method_spec, cls->get_dmethods(), method_regex);
+  const auto& method_specs = m_keep_rule.class_spec.methodSpecifications;
+  for (size_t i = 0; i < method_specs.size(); ++i) {
+    const boost::regex& method_regex = *m_method_regexes[i];
+    keep_methods(method_specs[i], cls->get_vmethods(), method_regex);
+    keep_methods(method_specs[i], cls->get_dmethods(), method_regex);
   }
 }
 
@@ -538,24 +588,21 @@ bool KeepRuleMatcher::any_method_matches(const DexClass* cls,
 }
 
 // Check that each method keep matches at least one method in :cls.
-bool KeepRuleMatcher::all_method_keeps_match(
-    const std::vector<MemberSpecification>& method_keeps, const DexClass* cls) {
-  return std::all_of(method_keeps.begin(),
-                     method_keeps.end(),
-                     [&](const MemberSpecification& method_keep) {
-                       auto qualified_method_regex = method_regex(method_keep);
-                       const boost::regex& matcher =
-                           register_matcher(qualified_method_regex);
-                       return any_method_matches(cls, method_keep, matcher);
-                     });
+bool KeepRuleMatcher::all_method_keeps_match(const DexClass* cls) {
+  const auto& method_keeps = m_keep_rule.class_spec.methodSpecifications;
+  for (size_t i = 0; i < method_keeps.size(); ++i) {
+    if (!any_method_matches(cls, method_keeps[i], *m_method_regexes[i])) {
+      return false;
+    }
+  }
+  return true;
 }
 
 bool KeepRuleMatcher::any_field_matches(const DexClass* cls,
-                                        const MemberSpecification& field_keep) {
-  auto fieldtype_regex = field_regex(field_keep);
-  const boost::regex& matcher = register_matcher(fieldtype_regex);
+                                        const MemberSpecification& field_keep,
+                                        const boost::regex& field_regex) {
   auto match = [&](const DexField* field) {
-    return field_level_match(field_keep, field, matcher);
+    return field_level_match(field_keep, field, field_regex);
   };
   return std::any_of(cls->get_ifields().begin(), cls->get_ifields().end(),
                      match) ||
@@ -564,13 +611,14 @@ bool KeepRuleMatcher::any_field_matches(const DexClass* cls,
 }
 
 // Check that each field keep matches at least one field in :cls.
-bool KeepRuleMatcher::all_field_keeps_match(
-    const std::vector<MemberSpecification>& field_keeps, const DexClass* cls) {
-  return std::all_of(field_keeps.begin(),
-                     field_keeps.end(),
-                     [&](const MemberSpecification& field_keep) {
-                       return any_field_matches(cls, field_keep);
-                     });
+bool KeepRuleMatcher::all_field_keeps_match(const DexClass* cls) {
+  const auto& field_keeps = m_keep_rule.class_spec.fieldSpecifications;
+  for (size_t i = 0; i < field_keeps.size(); ++i) {
+    if (!any_field_matches(cls, field_keeps[i], *m_field_regexes[i])) {
+      return false;
+    }
+  }
+  return true;
 }
 
 bool KeepRuleMatcher::process_mark_conditionally(const DexClass* cls) {
@@ -581,8 +629,7 @@ bool KeepRuleMatcher::process_mark_conditionally(const DexClass* cls) {
               << class_spec.className
               << " has no field or member specifications.\n";
   }
-  return all_field_keeps_match(class_spec.fieldSpecifications, cls) &&
-         all_method_keeps_match(class_spec.methodSpecifications, cls);
+  return all_field_keeps_match(cls) && all_method_keeps_match(cls);
 }
 
 // Once a match has been made against a class i.e. the class name
@@ -735,32 +782,16 @@ void ProguardMatcher::process_keep(const KeepSpecSet& keep_rules,
     }
   };
 
-  // We only parallelize if keep_rule needs to be applied to all classes.
-  auto wq = workqueue_foreach<const KeepSpec*>([&](const KeepSpec* keep_rule) {
-    RegexMap regex_map;
-    ClassMatcher class_match(*keep_rule);
-    KeepRuleMatcher rule_matcher(rule_type, *keep_rule, regex_map);
-
-    for (const auto& cls : m_classes) {
-      process_single_keep(class_match, rule_matcher, cls);
-    }
-    if (process_external) {
-      for (const auto& cls : m_external_classes) {
-        process_single_keep(class_match, rule_matcher, cls);
-      }
-    }
-  });
-
-  RegexMap regex_map;
+  std::vector<std::unique_ptr<KeepRuleMatcher>> slow_rules;
   for (const auto& keep_rule_ptr : keep_rules) {
     const auto& keep_rule = *keep_rule_ptr;
-    ClassMatcher class_match(keep_rule);
 
     // This case is very fast. Just process it immediately in the main thread.
     const auto& className = keep_rule.class_spec.className;
     if (!classname_contains_wildcard(className)) {
+      ClassMatcher class_match(keep_rule, m_regex_cache);
       DexClass* cls = find_single_class(className);
-      KeepRuleMatcher rule_matcher(rule_type, keep_rule, regex_map);
+      KeepRuleMatcher rule_matcher(rule_type, keep_rule, m_regex_cache);
       process_single_keep(class_match, rule_matcher, cls);
       continue;
     }
@@ -771,7 +802,8 @@ void ProguardMatcher::process_keep(const KeepSpecSet& keep_rules,
         !classname_contains_wildcard(extendsClassName)) {
       DexClass* super = find_single_class(extendsClassName);
       if (super != nullptr) {
-        KeepRuleMatcher rule_matcher(rule_type, keep_rule, regex_map);
+        ClassMatcher class_match(keep_rule, m_regex_cache);
+        KeepRuleMatcher rule_matcher(rule_type, keep_rule, m_regex_cache);
         auto children = get_all_children(m_hierarchy, super->get_type());
         process_single_keep(class_match, rule_matcher, super);
         for (auto const* type : children) {
@@ -782,10 +814,52 @@ void ProguardMatcher::process_keep(const KeepSpecSet& keep_rules,
     }
 
     TRACE(PGR, 2, "Slow rule: %s", show_keep(keep_rule).c_str());
-    // Otherwise, it might take a longer time. Add to the work queue.
-    wq.add_item(&keep_rule);
+    // Otherwise, it might take a longer time. Match it in parallel below.
+    slow_rules.push_back(
+        std::make_unique<KeepRuleMatcher>(rule_type, keep_rule, m_regex_cache));
+  }
+  if (slow_rules.empty()) {
+    return;
+  }
+
+  std::vector<DexClass*> classes(m_classes.begin(), m_classes.end());
+  if (process_external) {
+    classes.insert(classes.end(), m_external_classes.begin(),
+                   m_external_classes.end());
   }
 
+  // Each work item matches one slow rule against one shard of the classes.
+  // With only a few slow rules the classes are split up so that all threads
+  // are busy, but not so finely that building each item's ClassMatcher
+  // dominates.
+  struct RuleShard {
+    KeepRuleMatcher* rule_matcher;
+    size_t begin;
+    size_t end;
+  };
+  constexpr size_t MIN_SHARD_SIZE = 256u;
+  const size_t num_threads = redex_parallel::default_num_threads();
+  const size_t num_shards = std::max<size_t>(
+      1,
+      std::min((4 * num_threads + slow_rules.size() - 1) / slow_rules.size(),
+               (classes.size() + MIN_SHARD_SIZE - 1) / MIN_SHARD_SIZE));
+
+  auto wq = workqueue_foreach<RuleShard>(
+      [&](RuleShard shard) {
+        ClassMatcher class_match(shard.rule_matcher->keep_rule(),
+                                 m_regex_cache);
+        for (size_t i = shard.begin; i < shard.end; ++i) {
+          process_single_keep(class_match, *shard.rule_matcher, classes[i]);
+        }
+      },
+      num_threads);
+  for (auto& rule_matcher : slow_rules) {
+    for (size_t s = 0; s < num_shards; ++s) {
+      wq.add_item(RuleShard{rule_matcher.get(),
+                            classes.size() * s / num_shards,
+                            classes.size() * (s + 1) / num_shards});
+    }
+  }
   wq.run_all();
 }
 
@@ -12,6 +12,7 @@
 #include "ProguardMap.h"
 #include "ProguardParser.h"
 #include "ProguardRegex.h"
+#include "WorkQueue.h"
 
 namespace keep_rules {
 namespace proguard_parser {
@@ -975,10 +976,9 @@ void parse(std::vector<unique_ptr<Token>>::iterator it,
   }
 }
 
-void parse(istream& config,
+void parse(std::vector<unique_ptr<Token>> tokens,
            ProguardConfiguration* pg_config,
            const std::string& filename) {
-  std::vector<unique_ptr<Token>> tokens = lex(config);
   bool ok = true;
   // Check for bad tokens.
   for (auto& tok : tokens) {
@@ -1002,6 +1002,27 @@ void parse(istream& config,
   }
 }
 
+void parse(istream& config,
+           ProguardConfiguration* pg_config,
+           const std::string& filename) {
+  parse(lex(config), pg_config, filename);
+}
+
+namespace {
+
+void parse_includes(ProguardConfiguration* pg_config) {
+  for (const auto& included_filename : pg_config->includes) {
+    if (pg_config->already_included.find(included_filename) !=
+        pg_config->already_included.end()) {
+      continue;
+    }
+    pg_config->already_included.emplace(included_filename);
+    parse_file(included_filename, pg_config);
+  }
+}
+
+} // namespace
+
 void parse_file(const std::string& filename, ProguardConfiguration* pg_config) {
   ifstream config(filename);
   // First try relative path.
@@ -1017,13 +1038,35 @@ void parse_file(const std::string& filename, ProguardConfiguration* pg_config) {
 
   parse(config, pg_config, filename);
   // Parse the included files.
-  for (const auto& included_filename : pg_config->includes) {
-    if (pg_config->already_included.find(included_filename) !=
-        pg_config->already_included.end()) {
+  parse_includes(pg_config);
+}
+
+void parse_files(const std::vector<std::string>& filenames,
+                 ProguardConfiguration* pg_config) {
+  // Lexing doesn't depend on the configuration, so all the files that can be
+  // opened without the -basedirectory of earlier files are lexed up front, in
+  // parallel. Everything else still happens in order, as in parse_file().
+  std::vector<boost::optional<std::vector<unique_ptr<Token>>>> tokens(
+      filenames.size());
+  auto wq = workqueue_foreach<size_t>([&](size_t i) {
+    ifstream config(filenames[i]);
+    if (config.is_open()) {
+      tokens[i] = lex(config);
+    }
+  });
+  for (size_t i = 0; i < filenames.size(); ++i) {
+    wq.add_item(i);
+  }
+  wq.run_all();
+
+  for (size_t i = 0; i < filenames.size(); ++i) {
+    if (!tokens[i]) {
+      parse_file(filenames[i], pg_config);
       continue;
     }
-    pg_config->already_included.emplace(included_filename);
-    parse_file(included_filename, pg_config);
+    parse(std::move(*tokens[i]), pg_config, filenames[i]);
+    tokens[i] = boost::none;
+    parse_includes(pg_config);
   }
 }
 
@@ -18,6 +18,14 @@ namespace keep_rules {
 namespace proguard_parser {
 
 void parse_file(const std::string& filename, ProguardConfiguration* pg_config);
+
+/*
+ * Same as calling parse_file() on each of the files in order, but lexes them
+ * in parallel.
+ */
+void parse_files(const std::vector<std::string>& filenames,
+                 ProguardConfiguration* pg_config);
+
 void parse(istream& config,
            ProguardConfiguration* pg_config,
            const std::string& filename = "");
@@ -5,6 +5,7 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <cctype>
 #include <cstring>
 
 #include "ProguardMap.h"
@@ -200,5 +201,48 @@ std::string convert_wildcard_type(const std::string& typ) {
   return wildcard_descriptor;
 }
 
+std::string literal_prefix(const std::string& regex) {
+  // A top-level alternation may make the leading literals optional.
+  int depth = 0;
+  bool in_set = false;
+  for (size_t i = 0; i < regex.size(); i++) {
+    const char ch = regex[i];
+    if (ch == '\\') {
+      i++;
+    } else if (in_set) {
+      in_set = ch != ']';
+    } else if (ch == '[') {
+      in_set = true;
+    } else if (ch == '(') {
+      depth++;
+    } else if (ch == ')') {
+      depth--;
+    } else if (ch == '|' && depth == 0) {
+      return "";
+    }
+  }
+  std::string prefix;
+  for (size_t i = 0; i < regex.size(); i++) {
+    char ch = regex[i];
+    if (ch == '\\') {
+      // An escaped punctuation character is a literal, anything else (\d,
+      // \w, ...) is a character class.
+      if (i + 1 == regex.size() ||
+          std::isalnum(static_cast<unsigned char>(regex[i + 1]))) {
+        break;
+      }
+      ch = regex[++i];
+    } else if (std::strchr(".[](){}*+?|^$", ch) != nullptr) {
+      break;
+    }
+    // A quantified literal is optional or repeated.
+    if (i + 1 < regex.size() && std::strchr("*+?{", regex[i + 1]) != nullptr) {
+      break;
+    }
+    prefix += ch;
+  }
+  return prefix;
+}
+
 } // namespace proguard_parser
 } // namespace keep_rules
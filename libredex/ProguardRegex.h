@@ -16,6 +16,10 @@ std::string form_member_regex(const std::string& proguard_regex);
 std::string form_type_regex(const std::string& proguard_regex);
 bool has_special_char(const std::string& proguard_regex);
 std::string convert_wildcard_type(const std::string& typ);
+// Return a prefix of every string that fully matches the boost::regex
+// `regex`, e.g. one formed by form_type_regex, conservatively empty when the
+// regex does not start with a literal.
+std::string literal_prefix(const std::string& regex);
 
 } // namespace proguard_parser
 } // namespace keep_rules
@@ -6,12 +6,14 @@
  */
 
 #include "Purity.h"
+#include "BitVectorSetAbstractDomain.h"
 #include "ControlFlow.h"
 #include "EditableCfgAdapter.h"
 #include "IRInstruction.h"
 #include "Resolver.h"
 #include "Walkers.h"
 #include "WeakTopologicalOrdering.h"
+#include "WorkQueue.h"
 
 std::ostream& operator<<(std::ostream& o, const CseLocation& l) {
   switch (l.special_location) {
@@ -422,128 +424,148 @@ size_t compute_locations_closure(
   std::unordered_map<const DexMethod*, LocationsAndDependencies> method_lads(
       concurrent_method_lads.begin(), concurrent_method_lads.end());
 
-  // 2. Compute inverse dependencies so that we know what needs to be recomputed
-  // during the fixpoint computation, and determine set of methods that are
-  // initially "impacted" in the sense that they have dependencies.
-  std::unordered_map<const DexMethod*, std::unordered_set<const DexMethod*>>
+  // 2. Number all locations, so that location sets can be represented as bit
+  //    vectors, and compute inverse dependencies.
+  std::unordered_map<CseLocation, uint32_t, CseLocationHasher> location_ids;
+  std::vector<CseLocation> locations;
+  std::unordered_map<const DexMethod*, std::vector<const DexMethod*>>
       inverse_dependencies;
-  std::unordered_set<const DexMethod*> impacted_methods;
+  std::vector<const DexMethod*> methods;
+  methods.reserve(method_lads.size());
   for (const auto& p : method_lads) {
     auto method = p.first;
     auto& lads = p.second;
-    if (!lads.dependencies.empty()) {
-      for (auto d : lads.dependencies) {
-        inverse_dependencies[d].insert(method);
+    methods.push_back(method);
+    for (const auto& l : lads.locations) {
+      if (location_ids.emplace(l, locations.size()).second) {
+        locations.push_back(l);
+      }
+    }
+    for (auto d : lads.dependencies) {
+      if (d != method) {
+        inverse_dependencies[d].push_back(method);
       }
-      impacted_methods.insert(method);
     }
   }
+  // Make the order of the components deterministic
+  std::sort(methods.begin(), methods.end(), compare_dexmethods);
+  for (auto& p : inverse_dependencies) {
+    std::sort(p.second.begin(), p.second.end(), compare_dexmethods);
+  }
 
-  // 3. Let's try to (semantically) inline locations, computing a fixed
-  //    point. Methods for which information is directly or indirectly absent
-  //    are equivalent to a general memory barrier, and are systematically
-  //    pruned.
-
-  // TODO: Instead of custom fixpoint computation using WTO, consider using the
-  // MonotonicFixpointIterator, operating on a callgraph, capture the
-  // dependencies, and have the Locations as the abstract domain.
-
-  size_t iterations = 0;
-  while (!impacted_methods.empty()) {
-    iterations++;
-    // We order the impacted methods in a deterministic way that's likely
-    // helping to reduce the number of needed iterations.
-    sparta::WeakTopologicalOrdering<const DexMethod*> wto(
-        nullptr,
-        [&impacted_methods, &inverse_dependencies](const DexMethod* const& m) {
-          std::vector<const DexMethod*> successors;
-          if (m == nullptr) {
-            std::copy(impacted_methods.begin(), impacted_methods.end(),
-                      std::back_inserter(successors));
-          } else {
-            auto it = inverse_dependencies.find(m);
-            if (it != inverse_dependencies.end()) {
-              for (auto n : it->second) {
-                if (impacted_methods.count(n)) {
-                  successors.push_back(n);
-                }
-              }
-            }
+  // 3. The methods of a strongly connected component of the dependency graph
+  //    all end up with the same locations. The top-level components of a WTO
+  //    following inverse dependencies are these components, in an order where
+  //    dependencies come first.
+  sparta::WeakTopologicalOrdering<const DexMethod*> wto(
+      nullptr, [&methods, &inverse_dependencies](const DexMethod* const& m) {
+        if (m == nullptr) {
+          return methods;
+        }
+        auto it = inverse_dependencies.find(m);
+        return it == inverse_dependencies.end()
+                   ? std::vector<const DexMethod*>()
+                   : it->second;
+      });
+  std::vector<std::vector<const DexMethod*>> components;
+  std::unordered_map<const DexMethod*, size_t> component_of;
+  std::function<void(const sparta::WtoComponent<const DexMethod*>&)>
+      collect_members;
+  collect_members =
+      [&](const sparta::WtoComponent<const DexMethod*>& component) {
+        component_of.emplace(component.head_node(), components.size() - 1);
+        components.back().push_back(component.head_node());
+        if (component.is_scc()) {
+          for (const auto& inner : component) {
+            collect_members(inner);
           }
-          // Make number of iterations deterministic
-          std::sort(successors.begin(), successors.end(), compare_dexmethods);
-          return successors;
-        });
-
-    std::vector<const DexMethod*> ordered_impacted_methods;
-    wto.visit_depth_first([&ordered_impacted_methods](const DexMethod* m) {
-      if (m) {
-        ordered_impacted_methods.push_back(m);
-      }
-    });
-    impacted_methods.clear();
-
-    std::vector<const DexMethod*> changed_methods;
-    for (const DexMethod* method : ordered_impacted_methods) {
-      auto& lads = method_lads.at(method);
-      bool unknown = false;
-      size_t lads_locations_size = lads.locations.size();
-      for (const DexMethod* d : lads.dependencies) {
-        if (d == method) {
-          continue;
         }
-        auto it = method_lads.find(d);
-        if (it == method_lads.end()) {
-          unknown = true;
-          break;
+      };
+  for (const auto& component : wto) {
+    if (component.head_node() != nullptr) {
+      components.emplace_back();
+      collect_members(component);
+    }
+  }
+
+  // 4. Group the components into levels, such that all dependencies of a
+  //    component are in lower levels.
+  std::vector<std::vector<size_t>> components_by_level;
+  {
+    std::vector<size_t> levels(components.size());
+    for (size_t i = 0; i < components.size(); i++) {
+      size_t level = 0;
+      for (auto method : components[i]) {
+        for (auto d : method_lads.at(method).dependencies) {
+          auto it = component_of.find(d);
+          if (it != component_of.end() && it->second != i) {
+            always_assert(it->second < i);
+            level = std::max(level, levels[it->second] + 1);
+          }
         }
-        const auto& other_locations = it->second.locations;
-        lads.locations.insert(other_locations.begin(), other_locations.end());
       }
-      if (unknown || lads_locations_size < lads.locations.size()) {
-        // something changed
-        changed_methods.push_back(method);
-        if (unknown) {
-          method_lads.erase(method);
-        }
+      levels[i] = level;
+      if (level >= components_by_level.size()) {
+        components_by_level.resize(level + 1);
       }
+      components_by_level[level].push_back(i);
     }
+  }
 
-    // Given set of changed methods, determine set of dependents for which
-    // we need to re-run the analysis in another iteration.
-    for (auto changed_method : changed_methods) {
-      auto idit = inverse_dependencies.find(changed_method);
-      if (idit == inverse_dependencies.end()) {
-        continue;
-      }
-
-      // remove inverse dependency entries as appropriate
-      auto& entries = idit->second;
-      for (auto it = entries.begin(); it != entries.end();) {
-        if (!method_lads.count(*it)) {
-          it = entries.erase(it);
-        } else {
-          it++;
+  // 5. Let's (semantically) inline locations bottom-up, one level at a time,
+  //    processing the components of a level in parallel. Methods for which
+  //    information is directly or indirectly absent are equivalent to a
+  //    general memory barrier, and are systematically pruned.
+  using LocationBits = sparta::BitVectorSetAbstractDomain<uint32_t>;
+  std::vector<LocationBits> component_locations(components.size());
+  // Not a vector<bool>, as the components are updated concurrently.
+  std::vector<uint8_t> component_unknown(components.size(), false);
+  for (const auto& level_components : components_by_level) {
+    auto wq = workqueue_foreach<size_t>([&](size_t i) {
+      LocationBits bits;
+      for (auto method : components[i]) {
+        const auto& lads = method_lads.at(method);
+        for (const auto& l : lads.locations) {
+          bits.add(location_ids.at(l));
+        }
+        for (auto d : lads.dependencies) {
+          if (d == method) {
+            continue;
+          }
+          auto it = component_of.find(d);
+          if (it == component_of.end() || component_unknown[it->second]) {
+            component_unknown[i] = true;
+            return;
+          }
+          if (it->second != i) {
+            bits.join_with(component_locations[it->second]);
+          }
         }
       }
-
-      if (entries.empty()) {
-        // remove inverse dependency
-        inverse_dependencies.erase(changed_method);
-      } else {
-        // add inverse dependencies entries to impacted methods
-        impacted_methods.insert(entries.begin(), entries.end());
-      }
+      component_locations[i] = std::move(bits);
+    });
+    for (auto i : level_components) {
+      wq.add_item(i);
     }
+    wq.run_all();
   }
 
   // For all methods which have a known set of locations at this point,
   // persist that information
-  for (auto& p : method_lads) {
-    result->emplace(p.first, p.second.locations);
+  for (size_t i = 0; i < components.size(); i++) {
+    if (component_unknown[i]) {
+      continue;
+    }
+    CseUnorderedLocationSet component_result;
+    for (auto id : component_locations[i].elements()) {
+      component_result.insert(locations[id]);
+    }
+    for (auto method : components[i]) {
+      result->emplace(method, component_result);
+    }
   }
 
-  return iterations;
+  return components_by_level.size();
 }
 
 // Helper function that invokes compute_locations_closure, providing initial
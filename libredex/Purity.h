@@ -141,8 +141,10 @@ bool process_base_and_overriding_methods(
 // account all overriding methods.
 // When encountering unknown method implementations, the resulting map will have
 // no entry for the relevant (base) methods.
-// The return value indicates how many iterations the fixed-point computation
-// required.
+// The closure is computed bottom-up over the strongly connected components of
+// the dependency graph, in parallel for components that don't depend on each
+// other. The return value indicates how many such rounds were needed, i.e. the
+// length of the longest chain of dependencies between components.
 size_t compute_locations_closure(
     const Scope& scope,
     const method_override_graph::Graph* method_override_graph,
@@ -182,25 +182,33 @@ void RootSetMarker::record_is_seed(Seed* seed) {
  * Mark as seeds all methods that override or implement an external method.
  */
 void RootSetMarker::mark_external_method_overriders() {
-  std::unordered_set<const DexMethod*> visited;
+  // Look upwards from each internal method rather than downwards from each
+  // external one, so that the methods can be checked independently.
+  std::vector<const DexMethod*> methods;
+  methods.reserve(m_method_override_graph.nodes().size());
   for (auto& pair : m_method_override_graph.nodes()) {
     auto method = pair.first;
-    if (!method->is_external() || visited.count(method)) {
-      continue;
-    }
-    const auto& overriding_methods =
-        mog::get_overriding_methods(m_method_override_graph, method);
-    for (auto* overriding : overriding_methods) {
-      // Avoid re-visiting methods found in overriding sets since we would
-      // already have conditionally marked all their children.
-      visited.emplace(overriding);
-      if (!overriding->is_external()) {
-        TRACE(REACH, 3, "Visiting seed: %s (implements %s)", SHOW(overriding),
-              SHOW(method));
-        push_seed(overriding);
+    if (!method->is_external() &&
+        !is_interface(type_class(method->get_class()))) {
+      methods.push_back(method);
+    }
+  }
+  auto wq = workqueue_foreach<const DexMethod*>([&](const DexMethod* method) {
+    const auto& overridden_methods = mog::get_overridden_methods(
+        m_method_override_graph, method, /* include_interfaces */ true);
+    for (auto* overridden : overridden_methods) {
+      if (overridden->is_external()) {
+        TRACE(REACH, 3, "Visiting seed: %s (implements %s)", SHOW(method),
+              SHOW(overridden));
+        push_seed(method);
+        break;
       }
     }
+  });
+  for (auto* method : methods) {
+    wq.add_item(method);
   }
+  wq.run_all();
 }
 
 /*
@@ -246,10 +254,9 @@ void TransitiveClosureMarker::push(const Parent* parent, const DexClass* cls) {
     return;
   }
   record_reachability(parent, cls);
-  if (m_reachable_objects->marked(cls)) {
+  if (!m_reachable_objects->mark(cls)) {
     return;
   }
-  m_reachable_objects->mark(cls);
   m_worker_state->push_task(ReachableObject(cls));
 }
 
@@ -260,14 +267,13 @@ void TransitiveClosureMarker::push(const Parent* parent,
     return;
   }
   record_reachability(parent, field);
-  if (m_reachable_objects->marked(field)) {
+  if (!m_reachable_objects->mark(field)) {
     return;
   }
   auto f = field->as_def();
   if (f) {
     gather_and_push(f);
   }
-  m_reachable_objects->mark(field);
   m_worker_state->push_task(ReachableObject(field));
 }
 
@@ -278,10 +284,9 @@ void TransitiveClosureMarker::push(const Parent* parent,
     return;
   }
   record_reachability(parent, method);
-  if (m_reachable_objects->marked(method)) {
+  if (!m_reachable_objects->mark(method)) {
     return;
   }
-  m_reachable_objects->mark(method);
   m_worker_state->push_task(ReachableObject(method));
 }
 
@@ -527,7 +532,10 @@ std::unique_ptr<ReachableObjects> compute_reachable_objects(
         return nullptr;
       },
       num_threads,
-      /*push_tasks_while_running=*/true);
+      /*push_tasks_while_running=*/true,
+      // The frontier grows very unevenly, e.g. from a few seeds into most of
+      // the app, so let idle workers steal from busy ones.
+      /*work_stealing=*/true);
   for (const auto& obj : root_set) {
     work_queue.add_item(obj);
   }
@@ -638,17 +646,19 @@ void sweep(DexStoresVector& stores,
   for (auto& dex : DexStoreClassesIterator(stores)) {
     sweep_if_unmarked(reachables, (void (*)(DexClass*))(nullptr), &dex,
                       removed_symbols);
-    walk::parallel::classes(dex, [&](DexClass* cls) {
-      sweep_if_unmarked(reachables, DexField::erase_field, &cls->get_ifields(),
-                        removed_symbols);
-      sweep_if_unmarked(reachables, DexField::erase_field, &cls->get_sfields(),
-                        removed_symbols);
-      sweep_if_unmarked(reachables, DexMethod::erase_method,
-                        &cls->get_dmethods(), removed_symbols);
-      sweep_if_unmarked(reachables, DexMethod::erase_method,
-                        &cls->get_vmethods(), removed_symbols);
-    });
   }
+  // Sweep the members of the remaining classes of all dexes in one parallel
+  // walk, rather than starting a walk (and its threads) for each dex.
+  walk::parallel::classes(build_class_scope(stores), [&](DexClass* cls) {
+    sweep_if_unmarked(reachables, DexField::erase_field, &cls->get_ifields(),
+                      removed_symbols);
+    sweep_if_unmarked(reachables, DexField::erase_field, &cls->get_sfields(),
+                      removed_symbols);
+    sweep_if_unmarked(reachables, DexMethod::erase_method, &cls->get_dmethods(),
+                      removed_symbols);
+    sweep_if_unmarked(reachables, DexMethod::erase_method, &cls->get_vmethods(),
+                      removed_symbols);
+  });
 }
 
 ObjectCounts count_objects(const DexStoresVector& stores) {
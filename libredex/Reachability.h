@@ -11,6 +11,7 @@
 #include <unordered_set>
 
 #include "ConcurrentContainers.h"
+#include "DenseIndex.h"
 #include "DexClass.h"
 #include "KeepReason.h"
 #include "MethodOverrideGraph.h"
@@ -93,33 +94,38 @@ class ReachableObjects {
  public:
   const ReachableObjectGraph& retainers_of() const { return m_retainers_of; }
 
-  void mark(const DexClass* cls) { m_marked_classes.insert(cls); }
+  // The mark functions return whether the object was not marked before, so
+  // that concurrent markers can tell which one gets to visit it.
+  bool mark(const DexClass* cls) {
+    return m_marked_classes.insert(cls->get_type());
+  }
 
-  void mark(const DexMethodRef* method) { m_marked_methods.insert(method); }
+  bool mark(const DexMethodRef* method) {
+    return m_marked_methods.insert(method);
+  }
 
-  void mark(const DexFieldRef* field) { m_marked_fields.insert(field); }
+  bool mark(const DexFieldRef* field) { return m_marked_fields.insert(field); }
 
-  bool marked(const DexClass* cls) const { return m_marked_classes.count(cls); }
+  bool marked(const DexClass* cls) const {
+    return m_marked_classes.contains(cls->get_type());
+  }
 
   bool marked(const DexMethodRef* method) const {
-    return m_marked_methods.count(method);
+    return m_marked_methods.contains(method);
   }
 
   bool marked(const DexFieldRef* field) const {
-    return m_marked_fields.count(field);
+    return m_marked_fields.contains(field);
   }
 
-  bool marked_unsafe(const DexClass* cls) const {
-    return m_marked_classes.count_unsafe(cls);
-  }
+  // The marked sets are lock-free, so these are the same as marked().
+  bool marked_unsafe(const DexClass* cls) const { return marked(cls); }
 
   bool marked_unsafe(const DexMethodRef* method) const {
-    return m_marked_methods.count_unsafe(method);
+    return marked(method);
   }
 
-  bool marked_unsafe(const DexFieldRef* field) const {
-    return m_marked_fields.count_unsafe(field);
-  }
+  bool marked_unsafe(const DexFieldRef* field) const { return marked(field); }
 
   size_t num_marked_classes() const { return m_marked_classes.size(); }
 
@@ -141,9 +147,10 @@ class ReachableObjects {
 
   void record_reachability(const DexMethodRef* member, const DexClass* cls);
 
-  ConcurrentSet<const DexClass*> m_marked_classes;
-  ConcurrentSet<const DexFieldRef*> m_marked_fields;
-  ConcurrentSet<const DexMethodRef*> m_marked_methods;
+  // Bitsets over the dense indices of the classes' types and of the members.
+  dense_index::ConcurrentIndexedBitSet<DexType> m_marked_classes;
+  dense_index::ConcurrentIndexedBitSet<DexFieldRef> m_marked_fields;
+  dense_index::ConcurrentIndexedBitSet<DexMethodRef> m_marked_methods;
   ReachableObjectGraph m_retainers_of;
 
   friend class RootSetMarker;
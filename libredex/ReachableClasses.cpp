@@ -14,6 +14,7 @@
 #include <unordered_set>
 
 #include "ClassHierarchy.h"
+#include "ConcurrentContainers.h"
 #include "DexClass.h"
 #include "Match.h"
 #include "RedexResources.h"
@@ -181,9 +182,23 @@ void analyze_reflection(const Scope& scope) {
     }
   };
 
+  // The metadata cache is only read once constructed, so the workers share it.
   reflection::MetadataCache refl_metadata_cache;
 
-  walk::code(scope, [&](DexMethod* method, IRCode& code) {
+  struct ReflectionSite {
+    ReflectionType refl_type;
+    DexType* dex_type;
+    DexString* name;
+    boost::optional<std::vector<DexType*>> param_types;
+  };
+
+  // Running the reflection analysis is the expensive part, and only depends on
+  // the method at hand, so we run it in parallel and collect the sites. Marking
+  // the reflected members is done afterwards in scope order, as it writes to
+  // members that other methods may reflect on too.
+  ConcurrentMap<DexMethod*, std::vector<ReflectionSite>> sites_by_method;
+  walk::parallel::code(scope, [&](DexMethod* method, IRCode& code) {
+    std::vector<ReflectionSite> sites;
     std::unique_ptr<ReflectionAnalysis> analysis = nullptr;
     for (auto& mie : InstructionIterable(code)) {
       IRInstruction* insn = mie.insn;
@@ -239,27 +254,40 @@ void analyze_reflection(const Scope& scope) {
             SHOW(arg_cls->dex_type), SHOW(arg_cls->dex_string),
             SHOW(arg_str_value));
 
-      switch (refl_type) {
+      sites.push_back(ReflectionSite{refl_type, arg_cls->dex_type,
+                                     arg_str_value, std::move(param_types)});
+    }
+    if (!sites.empty()) {
+      sites_by_method.emplace(method, std::move(sites));
+    }
+  });
+
+  walk::methods(scope, [&](DexMethod* method) {
+    if (!sites_by_method.count(method)) {
+      return;
+    }
+    for (const auto& site : sites_by_method.at_unsafe(method)) {
+      switch (site.refl_type) {
       case GET_FIELD:
-        blacklist_field(method, arg_cls->dex_type, arg_str_value, false);
+        blacklist_field(method, site.dex_type, site.name, false);
         break;
       case GET_DECLARED_FIELD:
-        blacklist_field(method, arg_cls->dex_type, arg_str_value, true);
+        blacklist_field(method, site.dex_type, site.name, true);
         break;
       case GET_METHOD:
       case GET_CONSTRUCTOR:
-        blacklist_method(method, arg_cls->dex_type, arg_str_value, param_types,
+        blacklist_method(method, site.dex_type, site.name, site.param_types,
                          false);
         break;
       case GET_DECLARED_METHOD:
       case GET_DECLARED_CONSTRUCTOR:
-        blacklist_method(method, arg_cls->dex_type, arg_str_value, param_types,
+        blacklist_method(method, site.dex_type, site.name, site.param_types,
                          true);
         break;
       case INT_UPDATER:
       case LONG_UPDATER:
       case REF_UPDATER:
-        blacklist_field(method, arg_cls->dex_type, arg_str_value, true);
+        blacklist_field(method, site.dex_type, site.name, true);
         break;
       }
     }
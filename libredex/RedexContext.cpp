@@ -7,53 +7,106 @@
 
 #include "RedexContext.h"
 
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
 #include <exception>
 #include <iostream>
 #include <mutex>
 #include <regex>
-#include <unordered_set>
 
+#include <boost/iostreams/device/mapped_file.hpp>
+
+#include "AllocTracking.h"
 #include "Debug.h"
 #include "DexCallSite.h"
 #include "DexClass.h"
 #include "DuplicateClasses.h"
+#include "SpartaThreadPool.h"
 
 RedexContext* g_redex;
 
-RedexContext::RedexContext(bool allow_class_duplicates)
-    : m_allow_class_duplicates(allow_class_duplicates) {}
+namespace {
 
-RedexContext::~RedexContext() {
-  // Delete DexStrings.
-  for (auto const& p : s_string_map) {
-    delete p.second;
-  }
-  // Delete DexTypes.  NB: This table intentionally contains aliases (multiple
-  // DexStrings map to the same DexType), so we have to dedup the set of types
-  // before deleting to avoid double-frees.
-  std::unordered_set<DexType*> delete_types;
-  for (auto const& p : s_type_map) {
-    delete_types.emplace(p.second);
-  }
-  for (auto const& t : delete_types) {
-    delete t;
-  }
-  // Delete DexFields.
-  for (auto const& it : s_field_map) {
-    delete static_cast<DexField*>(it.second);
+uint64_t next_context_id() {
+  static std::atomic<uint64_t> id{1};
+  return id++;
+}
+
+/*
+ * A small direct-mapped cache, per thread, of the strings that the thread
+ * interned or looked up last. Hits skip the locked string table; since
+ * strings are never removed from their context, an entry stays valid for as
+ * long as the context that it was recorded for, which `context_id` tracks.
+ */
+struct StringCache {
+  static constexpr size_t kSize = 4096;
+  uint64_t context_id{0};
+  std::array<DexString*, kSize> entries;
+
+  static size_t slot(const char* s) {
+    // FNV-1a over the whole string, as strings often share long prefixes.
+    uint32_t h = 2166136261u;
+    for (auto p = (const uint8_t*)s; *p != 0; ++p) {
+      h = (h ^ *p) * 16777619u;
+    }
+    return h % kSize;
   }
-  // Delete DexTypeLists.
-  for (auto const& p : s_typelist_map) {
-    delete p.second;
+
+  DexString* find(const char* s, size_t slot) const {
+    auto cached = entries[slot];
+    return cached != nullptr && strcmp(cached->c_str(), s) == 0 ? cached
+                                                                : nullptr;
   }
-  // Delete DexProtos.
-  for (auto const& p : s_proto_map) {
-    delete p.second;
+};
+
+StringCache& string_cache(uint64_t context_id) {
+  static thread_local StringCache cache;
+  if (cache.context_id != context_id) {
+    cache.context_id = context_id;
+    cache.entries.fill(nullptr);
   }
-  // Delete DexMethods.
-  for (auto const& it : s_method_map) {
-    delete static_cast<DexMethod*>(it.second);
+  return cache;
+}
+
+} // namespace
+
+RedexContext::RedexContext(bool allow_class_duplicates)
+    : m_id(next_context_id()),
+      m_string_arena([](DexString* s) { s->~DexString(); }),
+      m_type_arena([](DexType* t) { t->~DexType(); }),
+      m_field_arena([](DexField* f) { f->~DexField(); }),
+      m_typelist_arena([](DexTypeList* l) { l->~DexTypeList(); }),
+      m_proto_arena([](DexProto* p) { p->~DexProto(); }),
+      m_method_arena([](DexMethod* m) { m->~DexMethod(); }),
+      m_allow_class_duplicates(allow_class_duplicates),
+      // PIN_WORKER_THREADS binds each worker to its own CPU, which keeps
+      // memory traffic on multi-socket hosts local to the NUMA nodes.
+      m_thread_pool(std::make_unique<sparta::parallel::ThreadPool>(
+          getenv("PIN_WORKER_THREADS") != nullptr)) {
+  // Let every work queue created while this context is alive reuse the same
+  // worker threads instead of spawning fresh ones for each run.
+  sparta::parallel::set_shared_thread_pool(m_thread_pool.get());
+}
+
+RedexContext::~RedexContext() {
+  // No work queue may be running at this point. Only uninstall the pool if it
+  // is still ours, then join its threads.
+  if (sparta::parallel::get_shared_thread_pool() == m_thread_pool.get()) {
+    sparta::parallel::set_shared_thread_pool(nullptr);
   }
+  m_thread_pool.reset();
+
+  // Destroy DexStrings, DexTypes, DexFields, DexTypeLists, DexProtos and
+  // DexMethods, in that order. The arenas also take care of the aliases in
+  // the type table (multiple DexStrings map to the same DexType), and of
+  // entities that were erased from their tables.
+  m_string_arena.release();
+  m_type_arena.release();
+  m_field_arena.release();
+  m_typelist_arena.release();
+  m_proto_arena.release();
+  m_method_arena.release();
   // Delete DexClasses.
   for (auto const& it : m_type_to_class) {
     delete it.second;
@@ -68,10 +121,16 @@ RedexContext::~RedexContext() {
   }
 }
 
+void RedexContext::retain_mapped_dex(
+    std::unique_ptr<boost::iostreams::mapped_file> file) {
+  std::lock_guard<std::mutex> lock(m_mapped_dexes_mutex);
+  m_mapped_dexes.push_back(std::move(file));
+}
+
 /*
  * Try and insert (:key, :value) into :container. This insertion may fail if
  * another thread has already inserted that key. In that case, return the
- * existing value and discard the one we were trying to insert.
+ * existing value and destroy the one we were trying to insert.
  *
  * We distinguish between the types of the inserted and stored values to handle
  * DexFields and DexMethods, where we upcast the inserted value into a
@@ -79,38 +138,140 @@ RedexContext::~RedexContext() {
  */
 template <class InsertValue,
           class StoredValue = InsertValue,
-          class Deleter = std::default_delete<InsertValue>,
           class Key,
           class Container>
 static StoredValue* try_insert(Key key,
                                InsertValue* value,
-                               Container* container) {
-  std::unique_ptr<InsertValue, Deleter> to_insert(value);
-  if (container->emplace(key, to_insert.get())) {
-    return to_insert.release();
+                               Container* container,
+                               ConcurrentArena<InsertValue>* arena) {
+  if (container->emplace(key, value)) {
+    return value;
   }
-  return container->at(key);
+  // The key may point into the value, so look up before destroying it.
+  StoredValue* existing = container->at(key);
+  arena->destroy(value);
+  return existing;
+}
+
+/*
+ * Like try_insert, but first assigns :value the next dense index and stores it
+ * in :value_index, so that the index is set by the time other threads can find
+ * :value.
+ */
+template <class InsertValue,
+          class StoredValue = InsertValue,
+          class Key,
+          class Container>
+static StoredValue* try_insert_indexed(
+    Key key,
+    InsertValue* value,
+    Container* container,
+    ConcurrentArena<InsertValue>* arena,
+    dense_index::IndexTable<StoredValue>* indices,
+    uint32_t* value_index) {
+  auto index = indices->add(value);
+  *value_index = index;
+  auto* stored =
+      try_insert<InsertValue, StoredValue>(key, value, container, arena);
+  if (stored != value) {
+    indices->clear(index);
+  }
+  return stored;
 }
 
 DexString* RedexContext::make_string(const char* nstr, uint32_t utfsize) {
   always_assert(nstr != nullptr);
+  auto& cache = string_cache(m_id);
+  auto slot = StringCache::slot(nstr);
+  auto rv = cache.find(nstr, slot);
+  if (rv != nullptr) {
+    return rv;
+  }
+  rv = s_string_map.get(nstr, nullptr);
+  if (rv == nullptr) {
+    alloc_tracking::ScopedCategory scope(
+        alloc_tracking::Category::INTERNING);
+    // Note that DexStrings are keyed by their c_str(). It points into storage
+    // owned by the DexString (or, for borrowed strings, into a retained input
+    // dex), so it is valid until the string is destroyed.
+    auto dexstring = new (m_string_arena.allocate()) DexString(nstr, utfsize);
+    rv = try_insert(dexstring->c_str(), dexstring, &s_string_map,
+                    &m_string_arena);
+  }
+  cache.entries[slot] = rv;
+  return rv;
+}
+
+std::vector<DexString*> RedexContext::make_strings(
+    const std::vector<std::string>& strs) {
+  auto& cache = string_cache(m_id);
+  std::vector<DexString*> result(strs.size());
+  std::vector<std::pair<const char*, DexString*>> entries;
+  std::vector<size_t> indices;
+  {
+    alloc_tracking::ScopedCategory scope(
+        alloc_tracking::Category::INTERNING);
+    for (size_t i = 0; i < strs.size(); ++i) {
+      auto nstr = strs[i].c_str();
+      auto slot = StringCache::slot(nstr);
+      auto rv = cache.find(nstr, slot);
+      if (rv == nullptr) {
+        rv = s_string_map.get(nstr, nullptr);
+        if (rv != nullptr) {
+          cache.entries[slot] = rv;
+        }
+      }
+      // Only allocate the strings that aren't interned yet.
+      if (rv != nullptr) {
+        result[i] = rv;
+        continue;
+      }
+      // As in make_string, each new DexString is keyed by its own c_str().
+      auto dexstring = new (m_string_arena.allocate())
+          DexString(nstr, length_of_utf8_string(nstr));
+      entries.emplace_back(dexstring->c_str(), dexstring);
+      indices.push_back(i);
+    }
+  }
+  auto stored = s_string_map.get_or_emplace_all(entries);
+  for (size_t j = 0; j < entries.size(); ++j) {
+    if (stored[j] != entries[j].second) {
+      m_string_arena.destroy(entries[j].second);
+    }
+    auto rv = stored[j];
+    cache.entries[StringCache::slot(rv->c_str())] = rv;
+    result[indices[j]] = rv;
+  }
+  return result;
+}
+
+DexString* RedexContext::make_borrowed_string(const char* nstr,
+                                              uint32_t utfsize) {
   auto rv = s_string_map.get(nstr, nullptr);
   if (rv != nullptr) {
     return rv;
   }
-  // Note that DexStrings are keyed by the c_str() of the underlying
-  // std::string. The c_str is valid until a the string is destroyed, or until a
-  // non-const function is called on the string (but note the std::string itself
-  // is const)
-  auto dexstring = new DexString(nstr, utfsize);
-  return try_insert(dexstring->c_str(), dexstring, &s_string_map);
+  alloc_tracking::ScopedCategory scope(alloc_tracking::Category::INTERNING);
+  auto dexstring = new (m_string_arena.allocate())
+      DexString(DexString::Borrowed(), nstr, utfsize);
+  return try_insert(dexstring->c_str(), dexstring, &s_string_map,
+                    &m_string_arena);
 }
 
 DexString* RedexContext::get_string(const char* nstr, uint32_t utfsize) {
   if (nstr == nullptr) {
     return nullptr;
   }
-  return s_string_map.get(nstr, nullptr);
+  auto& cache = string_cache(m_id);
+  auto slot = StringCache::slot(nstr);
+  auto rv = cache.find(nstr, slot);
+  if (rv == nullptr) {
+    rv = s_string_map.get(nstr, nullptr);
+    if (rv != nullptr) {
+      cache.entries[slot] = rv;
+    }
+  }
+  return rv;
 }
 
 DexType* RedexContext::make_type(const DexString* dstring) {
@@ -119,8 +280,11 @@ DexType* RedexContext::make_type(const DexString* dstring) {
   if (rv != nullptr) {
     return rv;
   }
-  return try_insert(dstring, new DexType(const_cast<DexString*>(dstring)),
-                    &s_type_map);
+  alloc_tracking::ScopedCategory scope(alloc_tracking::Category::INTERNING);
+  auto type =
+      new (m_type_arena.allocate()) DexType(const_cast<DexString*>(dstring));
+  return try_insert_indexed(dstring, type, &s_type_map, &m_type_arena,
+                            &m_type_indices, &type->m_index);
 }
 
 DexType* RedexContext::get_type(const DexString* dstring) {
@@ -156,10 +320,14 @@ DexFieldRef* RedexContext::make_field(const DexType* container,
   if (rv != nullptr) {
     return rv;
   }
-  auto field = new DexField(const_cast<DexType*>(container),
-                            const_cast<DexString*>(name),
-                            const_cast<DexType*>(type));
-  return try_insert<DexField, DexFieldRef>(r, field, &s_field_map);
+  alloc_tracking::ScopedCategory scope(alloc_tracking::Category::INTERNING);
+  auto field = new (m_field_arena.allocate())
+      DexField(const_cast<DexType*>(container),
+               const_cast<DexString*>(name),
+               const_cast<DexType*>(type));
+  return try_insert_indexed<DexField, DexFieldRef>(
+      r, field, &s_field_map, &m_field_arena, &m_field_indices,
+      &field->m_index);
 }
 
 DexFieldRef* RedexContext::get_field(const DexType* container,
@@ -214,8 +382,10 @@ DexTypeList* RedexContext::make_type_list(std::deque<DexType*>&& p) {
   if (rv != nullptr) {
     return rv;
   }
-  auto typelist = new DexTypeList(std::move(p));
-  return try_insert(typelist->m_list, typelist, &s_typelist_map);
+  alloc_tracking::ScopedCategory scope(alloc_tracking::Category::INTERNING);
+  auto typelist = new (m_typelist_arena.allocate()) DexTypeList(std::move(p));
+  return try_insert(typelist->m_list, typelist, &s_typelist_map,
+                    &m_typelist_arena);
 }
 
 DexTypeList* RedexContext::get_type_list(std::deque<DexType*>&& p) {
@@ -231,11 +401,13 @@ DexProto* RedexContext::make_proto(const DexType* rtype,
   if (rv != nullptr) {
     return rv;
   }
+  alloc_tracking::ScopedCategory scope(alloc_tracking::Category::INTERNING);
   return try_insert(key,
-                    new DexProto(const_cast<DexType*>(rtype),
+                    new (m_proto_arena.allocate())
+                        DexProto(const_cast<DexType*>(rtype),
                                  const_cast<DexTypeList*>(args),
                                  const_cast<DexString*>(shorty)),
-                    &s_proto_map);
+                    &s_proto_map, &m_proto_arena);
 }
 
 DexProto* RedexContext::get_proto(const DexType* rtype,
@@ -261,8 +433,11 @@ DexMethodRef* RedexContext::make_method(const DexType* type_,
   if (rv != nullptr) {
     return rv;
   }
-  return try_insert<DexMethod, DexMethodRef, DexMethod::Deleter>(
-      r, new DexMethod(type, name, proto), &s_method_map);
+  alloc_tracking::ScopedCategory scope(alloc_tracking::Category::INTERNING);
+  auto method = new (m_method_arena.allocate()) DexMethod(type, name, proto);
+  return try_insert_indexed<DexMethod, DexMethodRef>(
+      r, method, &s_method_map, &m_method_arena, &m_method_indices,
+      &method->m_index);
 }
 
 DexMethodRef* RedexContext::get_method(const DexType* type,
@@ -14,12 +14,15 @@
 #include <functional>
 #include <list>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <sstream>
 #include <unordered_map>
 #include <vector>
 
+#include "ConcurrentArena.h"
 #include "ConcurrentContainers.h"
+#include "DenseIndex.h"
 #include "DexMemberRefs.h"
 #include "FrequentlyUsedPointersCache.h"
 #include "KeepReason.h"
@@ -34,11 +37,25 @@ class DexProto;
 class DexMethodRef;
 class DexMethodHandle;
 class DexClass;
+class DexField;
+class DexMethod;
 struct DexFieldSpec;
 struct DexDebugEntry;
 struct DexPosition;
 struct RedexContext;
 
+namespace boost {
+namespace iostreams {
+class mapped_file;
+} // namespace iostreams
+} // namespace boost
+
+namespace sparta {
+namespace parallel {
+class ThreadPool;
+} // namespace parallel
+} // namespace sparta
+
 extern RedexContext* g_redex;
 
 #if defined(__SSE4_2__) && defined(__linux__) && defined(__STRCMP_LESS__)
@@ -50,7 +67,16 @@ struct RedexContext {
   ~RedexContext();
 
   DexString* make_string(const char* nstr, uint32_t utfsize);
+  // Like make_string, but a newly created DexString references :nstr instead
+  // of copying it. :nstr must be NUL-terminated and must stay valid and
+  // unchanged for as long as this context lives, e.g. by handing the mapping
+  // it points into to retain_mapped_dex.
+  DexString* make_borrowed_string(const char* nstr, uint32_t utfsize);
   DexString* get_string(const char* nstr, uint32_t utfsize);
+  // Like calling make_string on each of :strs, but creates the new strings
+  // with one lock acquisition per shard of the string table, rather than one
+  // per string.
+  std::vector<DexString*> make_strings(const std::vector<std::string>& strs);
 
   DexType* make_type(const DexString* dstring);
   DexType* get_type(const DexString* dstring);
@@ -99,6 +125,20 @@ struct RedexContext {
   DexMethodHandle* make_methodhandle();
   DexMethodHandle* get_methodhandle();
 
+  // Map dense indices, see DenseIndex.h, back to the interned entities. These
+  // return nullptr for indices that were never published. The num_* functions
+  // return one more than the largest index handed out so far.
+  DexType* type_at(uint32_t index) const { return m_type_indices.at(index); }
+  DexFieldRef* field_at(uint32_t index) const {
+    return m_field_indices.at(index);
+  }
+  DexMethodRef* method_at(uint32_t index) const {
+    return m_method_indices.at(index);
+  }
+  size_t num_type_indices() const { return m_type_indices.size(); }
+  size_t num_field_indices() const { return m_field_indices.size(); }
+  size_t num_method_indices() const { return m_method_indices.size(); }
+
   void erase_method(DexMethodRef*);
   void mutate_method(DexMethodRef* method,
                      const DexMethodSpec& new_spec,
@@ -136,21 +176,45 @@ struct RedexContext {
     g_redex->m_record_keep_reasons = v;
   }
 
+  /*
+   * This returns true if loaded methods should only be ballooned into IRCode
+   * when their code is first accessed.
+   */
+  static bool lazy_balloon() { return g_redex->m_lazy_balloon; }
+  static void set_lazy_balloon(bool v) { g_redex->m_lazy_balloon = v; }
+
   template <class... Args>
   static keep_reason::Reason* make_keep_reason(Args&&... args) {
-    auto to_insert =
-        std::make_unique<keep_reason::Reason>(std::forward<Args>(args)...);
+    // Most reasons are requested many times, e.g. one per kept member of a
+    // rule, so look them up before allocating.
+    keep_reason::Reason reason(std::forward<Args>(args)...);
+    auto existing = g_redex->s_keep_reasons.get(&reason, nullptr);
+    if (existing != nullptr) {
+      return existing;
+    }
+    auto to_insert = std::make_unique<keep_reason::Reason>(reason);
     if (g_redex->s_keep_reasons.emplace(to_insert.get(), to_insert.get())) {
       return to_insert.release();
     }
     return g_redex->s_keep_reasons.at(to_insert.get());
   }
 
+  // Guards the keep reasons of the given class or member. The mutexes are
+  // shared between members so that each member only pays for its reasons.
+  static std::mutex& keep_reasons_mutex(const void* member) {
+    auto& mutexes = g_redex->m_keep_reasons_mutexes;
+    return mutexes[std::hash<const void*>()(member) % mutexes.size()];
+  }
+
   // Add a lambda to be called when RedexContext is destructed. This is
   // especially useful for resetting caches/singletons in tests.
   using Task = std::function<void(void)>;
   void add_destruction_task(const Task& t) { m_destruction_tasks.push_back(t); }
 
+  // Keep an input dex mapped until this context is destroyed, so that the
+  // strings borrowed from it stay valid. This method is thread-safe.
+  void retain_mapped_dex(std::unique_ptr<boost::iostreams::mapped_file> file);
+
   FrequentlyUsedPointers pointers_cache() { return m_pointers_cache; }
 
  private:
@@ -204,28 +268,49 @@ struct RedexContext {
 
   // DexString
   ConcurrentLargeStringMap<DexString*> s_string_map;
+  // Identifies this context to the per-thread caches of recently interned
+  // strings, see make_string. Ids are never reused.
+  const uint64_t m_id;
+
+  // Interned entities are carved out of per-kind arenas rather than being
+  // allocated one by one, and are destroyed wholesale with this context.
+  ConcurrentArena<DexString> m_string_arena;
+  ConcurrentArena<DexType> m_type_arena;
+  ConcurrentArena<DexField> m_field_arena;
+  ConcurrentArena<DexTypeList> m_typelist_arena;
+  ConcurrentArena<DexProto> m_proto_arena;
+  ConcurrentArena<DexMethod> m_method_arena;
+
+  // The interning tables below are looked up far more often than they are
+  // updated once loading is done, so they use lock-free reads.
 
   // DexType
-  ConcurrentMap<const DexString*, DexType*> s_type_map;
+  ReadOptimizedConcurrentMap<const DexString*, DexType*> s_type_map;
 
   // DexFieldRef
-  ConcurrentMap<DexFieldSpec, DexFieldRef*> s_field_map;
+  ReadOptimizedConcurrentMap<DexFieldSpec, DexFieldRef*> s_field_map;
   std::mutex s_field_lock;
 
   // DexTypeList
-  ConcurrentMap<std::deque<DexType*>,
-                DexTypeList*,
-                boost::hash<std::deque<DexType*>>>
+  ReadOptimizedConcurrentMap<std::deque<DexType*>,
+                             DexTypeList*,
+                             boost::hash<std::deque<DexType*>>>
       s_typelist_map;
 
   // DexProto
   using ProtoKey = std::pair<const DexType*, const DexTypeList*>;
-  ConcurrentMap<ProtoKey, DexProto*, boost::hash<ProtoKey>> s_proto_map;
+  ReadOptimizedConcurrentMap<ProtoKey, DexProto*, boost::hash<ProtoKey>>
+      s_proto_map;
 
   // DexMethod
-  ConcurrentMap<DexMethodSpec, DexMethodRef*> s_method_map;
+  ReadOptimizedConcurrentMap<DexMethodSpec, DexMethodRef*> s_method_map;
   std::mutex s_method_lock;
 
+  // Dense indices of the interned types, fields and methods.
+  dense_index::IndexTable<DexType> m_type_indices;
+  dense_index::IndexTable<DexFieldRef> m_field_indices;
+  dense_index::IndexTable<DexMethodRef> m_method_indices;
+
   // Type-to-class map
   std::mutex m_type_system_mutex;
   std::unordered_map<const DexType*, DexClass*> m_type_to_class;
@@ -238,14 +323,66 @@ struct RedexContext {
                 keep_reason::ReasonPtrHash,
                 keep_reason::ReasonPtrEqual>
       s_keep_reasons;
+  std::array<std::mutex, 64> m_keep_reasons_mutexes;
 
   // These functions will be called when ~RedexContext() is called
   std::vector<Task> m_destruction_tasks;
 
   bool m_record_keep_reasons{false};
+  bool m_lazy_balloon{false};
   bool m_allow_class_duplicates;
 
   FrequentlyUsedPointers m_pointers_cache;
+
+  std::mutex m_mapped_dexes_mutex;
+  std::vector<std::unique_ptr<boost::iostreams::mapped_file>> m_mapped_dexes;
+
+  // Worker threads shared by all work queues and priority thread pools that
+  // run while this context is alive.
+  std::unique_ptr<sparta::parallel::ThreadPool> m_thread_pool;
+};
+
+/*
+ * A value derived from the types and members of the current RedexContext,
+ * meant to be kept in a function-local static so that consecutive passes can
+ * share it. It is dropped when the context is destroyed, so that it never
+ * outlives what it refers to, and rebuilt when asked for with a different
+ * hash of its inputs. This class is thread-safe.
+ */
+template <typename T>
+class RedexContextCache {
+ public:
+  // Return the value built for :hash in the current context, or else replace
+  // it with the result of :build(), which must return a std::shared_ptr<T>.
+  template <typename Build>
+  std::shared_ptr<T> get(size_t hash, const Build& build) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_value != nullptr && m_context == g_redex && m_hash == hash) {
+      return m_value;
+    }
+    if (m_context != g_redex) {
+      g_redex->add_destruction_task([this] {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_context = nullptr;
+        m_value.reset();
+      });
+      m_context = g_redex;
+    }
+    m_hash = hash;
+    m_value = build();
+    return m_value;
+  }
+
+  // For values that don't depend on anything but the context itself.
+  T& get() {
+    return *get(0, [] { return std::make_shared<T>(); });
+  }
+
+ private:
+  std::mutex m_mutex;
+  const RedexContext* m_context{nullptr};
+  size_t m_hash{0};
+  std::shared_ptr<T> m_value;
 };
 
 // One or more exceptions
@@ -19,6 +19,7 @@ void RedexOptions::serialize(Json::Value& entry_data) const {
   options["min_sdk"] = min_sdk;
   options["debug_info_kind"] = debug_info_kind_to_string(debug_info_kind);
   options["redacted"] = redacted;
+  options["low_memory"] = low_memory;
 }
 
 void RedexOptions::deserialize(const Json::Value& entry_data) {
@@ -32,6 +33,7 @@ void RedexOptions::deserialize(const Json::Value& entry_data) {
   debug_info_kind =
       parse_debug_info_kind(options_data["debug_info_kind"].asString());
   redacted = options_data["redacted"].asBool();
+  low_memory = options_data["low_memory"].asBool();
 }
 
 Architecture parse_architecture(const std::string& s) {
@@ -41,6 +41,8 @@ class RedexOptions {
   bool disable_dex_hasher{false};
   bool instrument_pass_enabled{false};
   bool redacted{false};
+  // Trade some run time for a lower peak RSS, see PassManager::run_passes.
+  bool low_memory{false};
   int32_t min_sdk{0};
   Architecture arch{Architecture::UNKNOWN};
   DebugInfoKind debug_info_kind{DebugInfoKind::NoCustomSymbolication};
@@ -11,19 +11,24 @@
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/optional.hpp>
-#include <boost/regex.hpp>
+#include <cctype>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <fcntl.h>
 #include <fstream>
+#include <limits>
 #include <map>
+#include <mutex>
 #include <sstream>
 #include <string>
 
 #ifdef _MSC_VER
+#include <io.h>
 #include <mman/sys/mman.h>
 #else
 #include <sys/mman.h>
+#include <unistd.h>
 #endif
 
 #include <sys/stat.h>
@@ -35,6 +40,9 @@
 #include "CompatWindows.h"
 #endif
 
+// Before Debug.h, which undefines the assert that the work queue relies on.
+#include "WorkQueue.h"
+
 #include "androidfw/ResourceTypes.h"
 #include "utils/ByteOrder.h"
 #include "utils/Errors.h"
@@ -145,79 +153,205 @@ std::string dotname_to_dexname(const std::string& classname) {
   return dexname;
 }
 
-void extract_by_pattern(const std::string& string_to_search,
-                        const boost::regex& regex,
-                        std::unordered_set<std::string>& result) {
-  boost::smatch m;
-  std::string s = string_to_search;
-  while (boost::regex_search(s, m, regex)) {
-    if (m.size() > 1) {
-      result.insert(m[1].str());
+namespace {
+
+/*
+ * Finds the JS resources of a bundle in a single scan, as if by searching for
+ * each of these patterns in turn:
+ *
+ *   "([^"]+)\.(m4a|ogg)"   sounds
+ *   \buri:\s*"([^"]+)"     uris
+ *   registerAsset\((.+?)\) asset registrations
+ *
+ * The scan dispatches on the first character of each pattern, and every
+ * pattern keeps its own state, so that the matches are exactly those of
+ * successive regex searches that each restart after the previous match.
+ */
+class JsResourceScanner {
+ public:
+  JsResourceScanner(const char* data, size_t size)
+      : m_data(data), m_size(size) {}
+
+  void scan(std::unordered_set<std::string>& result) {
+    for (size_t i = 0; i < m_size; ++i) {
+      switch (m_data[i]) {
+      case '"':
+        scan_sound_quote(i, result);
+        break;
+      case 'u':
+        scan_uri(i, result);
+        break;
+      case 'r':
+        scan_registration(i, result);
+        break;
+      default:
+        break;
+      }
     }
-    s = m.suffix().str();
   }
-}
 
-void extract_js_sounds(const std::string& file_contents,
-                       std::unordered_set<std::string>& result) {
-  static boost::regex sound_regex("\"([^\\\"]+)\\.(m4a|ogg)\"");
-  extract_by_pattern(file_contents, sound_regex, result);
-}
+ private:
+  static constexpr size_t NONE = std::numeric_limits<size_t>::max();
 
-void extract_js_uris(const std::string& file_contents,
-                     std::unordered_set<std::string>& result) {
-  static boost::regex uri_regex("\\buri:\\s*\"([^\\\"]+)\"");
-  extract_by_pattern(file_contents, uri_regex, result);
-}
+  template <size_t N>
+  bool starts_with_at(size_t i, const char (&prefix)[N]) const {
+    return m_size - i >= N - 1 && memcmp(m_data + i, prefix, N - 1) == 0;
+  }
 
-void extract_js_asset_registrations(const std::string& file_contents,
-                                    std::unordered_set<std::string>& result) {
-  static boost::regex register_regex("registerAsset\\((.+?)\\)");
-  static boost::regex name_regex("name:\\\"(.+?)\\\"");
-  static boost::regex location_regex(
-      "httpServerLocation:\\\"/assets/(.+?)\\\"");
-  static boost::regex special_char_regex("[^a-z0-9_]");
-  std::unordered_set<std::string> registrations;
-  extract_by_pattern(file_contents, register_regex, registrations);
-  for (const std::string& registration : registrations) {
-    boost::smatch m;
-    if (!boost::regex_search(registration, m, location_regex) || m.empty()) {
-      continue;
+  /*
+   * The position of the first :c at or after :from, or m_size. Lookups only
+   * move forward, so remembering the last answer keeps the scan linear even
+   * when the character doesn't occur anymore.
+   */
+  struct NextChar {
+    size_t from{NONE};
+    size_t at{0};
+  };
+  size_t find_next(char c, size_t from, NextChar* cache) const {
+    if (from >= cache->from && from <= cache->at) {
+      return cache->at;
     }
-    std::ostringstream asset_path;
-    asset_path << m[1].str() << '/'; // location
-    if (!boost::regex_search(registration, m, name_regex) || m.empty()) {
-      continue;
+    auto found =
+        static_cast<const char*>(memchr(m_data + from, c, m_size - from));
+    cache->from = from;
+    cache->at = found == nullptr ? m_size : found - m_data;
+    return cache->at;
+  }
+
+  // A quote either closes the pending sound candidate, or opens a new one.
+  void scan_sound_quote(size_t i, std::unordered_set<std::string>& result) {
+    if (m_sound_open == NONE) {
+      m_sound_open = i;
+      return;
+    }
+    size_t begin = m_sound_open + 1;
+    size_t len = i - begin;
+    if (len > 4 && (memcmp(m_data + i - 4, ".m4a", 4) == 0 ||
+                    memcmp(m_data + i - 4, ".ogg", 4) == 0)) {
+      result.emplace(m_data + begin, len - 4);
+      m_sound_open = NONE;
+    } else {
+      m_sound_open = i;
+    }
+  }
+
+  void scan_uri(size_t i, std::unordered_set<std::string>& result) {
+    if (i < m_uri_resume || !starts_with_at(i, "uri:")) {
+      return;
+    }
+    // Searches restart after each match, so that is a word boundary too.
+    if (i != m_uri_resume && is_word_char(m_data[i - 1])) {
+      return;
+    }
+    size_t j = i + strlen("uri:");
+    while (j < m_size && isspace(static_cast<unsigned char>(m_data[j]))) {
+      ++j;
+    }
+    if (j + 1 >= m_size || m_data[j] != '"' || m_data[j + 1] == '"') {
+      return;
+    }
+    size_t end = find_next('"', j + 1, &m_next_quote);
+    if (end == m_size) {
+      return;
     }
-    asset_path << m[1].str(); // name
-    std::string full_path = asset_path.str();
-    boost::replace_all(full_path, "/", "_");
-    ;
-    boost::algorithm::to_lower(full_path);
+    result.emplace(m_data + j + 1, end - j - 1);
+    m_uri_resume = end + 1;
+  }
 
-    std::ostringstream stripped_asset_path;
-    std::ostream_iterator<char, char> oi(stripped_asset_path);
-    boost::regex_replace(oi, full_path.begin(), full_path.end(),
-                         special_char_regex, "",
-                         boost::match_default | boost::format_all);
+  void scan_registration(size_t i, std::unordered_set<std::string>& result) {
+    if (i < m_registration_resume || !starts_with_at(i, "registerAsset(")) {
+      return;
+    }
+    size_t begin = i + strlen("registerAsset(");
+    // The registration is never empty, even if it starts with a parenthesis.
+    size_t end = begin + 1 >= m_size
+                     ? m_size
+                     : find_next(')', begin + 1, &m_next_paren);
+    if (end == m_size) {
+      m_registration_resume = m_size;
+      return;
+    }
+    add_asset_registration(m_data + begin, end - begin, result);
+    m_registration_resume = end + 1;
+  }
 
-    result.emplace(stripped_asset_path.str());
+  static bool is_word_char(char c) {
+    return isalnum(static_cast<unsigned char>(c)) || c == '_';
   }
+
+  /*
+   * The shortest non-empty string between :prefix and a quote, as matched by
+   * prefix(.+?)".
+   */
+  static bool find_quoted_after(const std::string& s,
+                                const char* prefix,
+                                std::string* out) {
+    auto pos = s.find(prefix);
+    if (pos == std::string::npos) {
+      return false;
+    }
+    auto begin = pos + strlen(prefix);
+    auto end = s.find('"', begin + 1);
+    if (end == std::string::npos) {
+      return false;
+    }
+    *out = s.substr(begin, end - begin);
+    return true;
+  }
+
+  static void add_asset_registration(const char* data,
+                                     size_t size,
+                                     std::unordered_set<std::string>& result) {
+    std::string registration(data, size);
+    std::string location;
+    std::string name;
+    if (!find_quoted_after(registration, "httpServerLocation:\"/assets/",
+                           &location) ||
+        !find_quoted_after(registration, "name:\"", &name)) {
+      return;
+    }
+    // The asset is referred to by location_name, lowercased, and stripped of
+    // anything that can't be part of a resource name.
+    std::string asset;
+    for (char c : location + '/' + name) {
+      if (c == '/') {
+        c = '_';
+      }
+      c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+      if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_') {
+        asset += c;
+      }
+    }
+    result.emplace(std::move(asset));
+  }
+
+  const char* m_data;
+  size_t m_size;
+  size_t m_sound_open{NONE};
+  size_t m_uri_resume{0};
+  size_t m_registration_resume{0};
+  NextChar m_next_quote;
+  NextChar m_next_paren;
+};
+
+} // namespace
+
+std::unordered_set<std::string> extract_js_resources(const char* data,
+                                                     size_t size) {
+  std::unordered_set<std::string> result;
+  JsResourceScanner(data, size).scan(result);
+  return result;
 }
 
 std::unordered_set<std::string> extract_js_resources(
     const std::string& file_contents) {
-  std::unordered_set<std::string> result;
-  extract_js_sounds(file_contents, result);
-  extract_js_uris(file_contents, result);
-  extract_js_asset_registrations(file_contents, result);
-  return result;
+  return extract_js_resources(file_contents.data(), file_contents.size());
 }
 
 std::unordered_set<uint32_t> extract_xml_reference_attributes(
-    const std::string& file_contents, const std::string& filename) {
+    const void* data, size_t size, const std::string& filename) {
   android::ResXMLTree parser;
-  parser.setTo(file_contents.data(), file_contents.size());
+  parser.setTo(data, size);
   std::unordered_set<uint32_t> result;
   if (parser.getError() != android::NO_ERROR) {
     throw std::runtime_error("Unable to read file: " + filename);
@@ -472,13 +606,14 @@ std::string read_attribute_name_at_idx(const android::ResXMLTree& parser,
 }
 
 void extract_classes_from_layout(
-    const std::string& layout_contents,
+    const void* data,
+    size_t size,
     const std::unordered_set<std::string>& attributes_to_read,
     std::unordered_set<std::string>& out_classes,
     std::unordered_multimap<std::string, std::string>& out_attributes) {
 
   android::ResXMLTree parser;
-  parser.setTo(layout_contents.data(), layout_contents.size());
+  parser.setTo(data, size);
 
   android::String16 name("name");
   android::String16 klazz("class");
@@ -611,6 +746,68 @@ void write_entire_file(const std::string& filename,
   out << contents;
 }
 
+namespace {
+
+/*
+ * A file mapped into memory for the lifetime of the object. Unlike
+ * read_entire_file, nothing is copied: the pages are read straight from the
+ * page cache. Writable mappings are shared, so in-place edits of the contents
+ * end up in the file without a separate write.
+ *
+ * As with read_entire_file, a missing or empty file maps to empty contents.
+ */
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string& filename, bool mode_write = false) {
+    m_fd = open(filename.c_str(), mode_write ? O_RDWR : O_RDONLY);
+    if (m_fd < 0) {
+      return;
+    }
+    struct stat st = {};
+    if (fstat(m_fd, &st) == -1 || st.st_size == 0) {
+      return;
+    }
+    int prot = mode_write ? PROT_READ | PROT_WRITE : PROT_READ;
+    void* data = mmap(nullptr, st.st_size, prot, MAP_SHARED, m_fd, 0);
+    if (data == MAP_FAILED) {
+      return;
+    }
+    m_data = data;
+    m_size = static_cast<size_t>(st.st_size);
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  ~MappedFile() {
+    if (m_data != nullptr) {
+      munmap(m_data, m_size);
+    }
+    if (m_fd >= 0) {
+      close(m_fd);
+    }
+  }
+
+  void* data() const { return m_data; }
+  size_t size() const { return m_size; }
+  bool empty() const { return m_size == 0; }
+
+ private:
+  int m_fd{-1};
+  void* m_data{nullptr};
+  size_t m_size{0};
+};
+
+void ensure_file_contents(const MappedFile& file,
+                          const std::string& filename) {
+  if (file.empty()) {
+    fprintf(stderr, "Unable to read file: %s\n", filename.data());
+    throw std::runtime_error("Unable to read file: " + filename);
+  }
+}
+
+} // namespace
+
 boost::optional<int32_t> get_min_sdk(const std::string& manifest_filename) {
   const std::string& manifest = read_entire_file(manifest_filename);
 
@@ -699,10 +896,11 @@ std::unordered_set<std::string> get_js_files(const std::string& directory) {
 
 std::unordered_set<std::string> get_candidate_js_resources_from_bundle(
     const std::string& filename) {
-  std::string file_contents = read_entire_file(filename);
+  MappedFile file(filename);
   std::unordered_set<std::string> js_candidate_resources;
-  if (!file_contents.empty()) {
-    js_candidate_resources = extract_js_resources(file_contents);
+  if (!file.empty()) {
+    js_candidate_resources = extract_js_resources(
+        static_cast<const char*>(file.data()), file.size());
   } else {
     fprintf(stderr, "Unable to read file: %s\n", filename.data());
   }
@@ -808,14 +1006,6 @@ std::unordered_set<uint32_t> get_resources_by_name_prefix(
   return found_resources;
 }
 
-void ensure_file_contents(const std::string& file_contents,
-                          const std::string& filename) {
-  if (file_contents.empty()) {
-    fprintf(stderr, "Unable to read file: %s\n", filename.data());
-    throw std::runtime_error("Unable to read file: " + filename);
-  }
-}
-
 bool is_raw_resource(const std::string& filename) {
   return filename.find("/res/raw/") != std::string::npos ||
          filename.find("/res/raw-") != std::string::npos;
@@ -827,9 +1017,25 @@ std::unordered_set<uint32_t> get_xml_reference_attributes(
     std::unordered_set<uint32_t> empty;
     return empty;
   }
-  std::string file_contents = read_entire_file(filename);
-  ensure_file_contents(file_contents, filename);
-  return extract_xml_reference_attributes(file_contents, filename);
+  MappedFile file(filename);
+  ensure_file_contents(file, filename);
+  return extract_xml_reference_attributes(file.data(), file.size(), filename);
+}
+
+std::unordered_set<uint32_t> get_xml_reference_attributes(
+    const std::vector<std::string>& filenames) {
+  std::mutex result_lock;
+  std::unordered_set<uint32_t> result;
+  auto wq = workqueue_foreach<std::string>([&](const std::string& filename) {
+    auto ids = get_xml_reference_attributes(filename);
+    std::lock_guard<std::mutex> lock(result_lock);
+    result.insert(ids.begin(), ids.end());
+  });
+  for (const auto& filename : filenames) {
+    wq.add_item(filename);
+  }
+  wq.run_all();
+  return result;
 }
 
 bool is_drawable_attribute(android::ResXMLTree& parser, size_t attr_index) {
@@ -859,12 +1065,12 @@ int inline_xml_reference_attributes(
     const std::string& filename,
     const std::map<uint32_t, android::Res_value>& id_to_inline_value) {
   int num_values_inlined = 0;
-  std::string file_contents = read_entire_file(filename);
-  ensure_file_contents(file_contents, filename);
-  bool made_change = false;
+  // Inlining only rewrites values in place, which goes straight to the file.
+  MappedFile file(filename, /* mode_write */ true);
+  ensure_file_contents(file, filename);
 
   android::ResXMLTree parser;
-  parser.setTo(file_contents.data(), file_contents.size());
+  parser.setTo(file.data(), file.size());
   if (parser.getError() != android::NO_ERROR) {
     throw std::runtime_error("Unable to read file: " + filename);
   }
@@ -894,7 +1100,6 @@ int inline_xml_reference_attributes(
             android::Res_value new_value = p->second;
             parser.setAttribute(i, new_value);
             ++num_values_inlined;
-            made_change = true;
           }
         }
       }
@@ -902,10 +1107,6 @@ int inline_xml_reference_attributes(
   } while (type != android::ResXMLParser::BAD_DOCUMENT &&
            type != android::ResXMLParser::END_DOCUMENT);
 
-  if (made_change) {
-    write_entire_file(filename, file_contents);
-  }
-
   return num_values_inlined;
 }
 
@@ -915,12 +1116,12 @@ void remap_xml_reference_attributes(
   if (is_raw_resource(filename)) {
     return;
   }
-  std::string file_contents = read_entire_file(filename);
-  ensure_file_contents(file_contents, filename);
-  bool made_change = false;
+  // As with inlining, ids are rewritten in place in the mapped file.
+  MappedFile file(filename, /* mode_write */ true);
+  ensure_file_contents(file, filename);
 
   android::ResXMLTree parser;
-  parser.setTo(file_contents.data(), file_contents.size());
+  parser.setTo(file.data(), file.size());
   if (parser.getError() != android::NO_ERROR) {
     throw std::runtime_error("Unable to read file: " + filename);
   }
@@ -932,7 +1133,6 @@ void remap_xml_reference_attributes(
     auto id_search = kept_to_remapped_ids.find(resourceIds[i]);
     if (id_search != kept_to_remapped_ids.end()) {
       resourceIds[i] = id_search->second;
-      made_change = true;
     }
   }
 
@@ -953,7 +1153,6 @@ void remap_xml_reference_attributes(
             uint32_t new_value = kept_to_remapped_ids.at(outValue.data);
             if (new_value != outValue.data) {
               parser.setAttributeData(i, new_value);
-              made_change = true;
             }
           }
         }
@@ -961,10 +1160,18 @@ void remap_xml_reference_attributes(
     }
   } while (type != android::ResXMLParser::BAD_DOCUMENT &&
            type != android::ResXMLParser::END_DOCUMENT);
+}
 
-  if (made_change) {
-    write_entire_file(filename, file_contents);
+void remap_xml_reference_attributes(
+    const std::vector<std::string>& filenames,
+    const std::map<uint32_t, uint32_t>& kept_to_remapped_ids) {
+  auto wq = workqueue_foreach<std::string>([&](const std::string& filename) {
+    remap_xml_reference_attributes(filename, kept_to_remapped_ids);
+  });
+  for (const auto& filename : filenames) {
+    wq.add_item(filename);
   }
+  wq.run_all();
 }
 
 std::vector<std::string> find_layout_files(const std::string& apk_directory) {
@@ -1000,9 +1207,12 @@ void collect_layout_classes_and_attributes_for_file(
     const std::unordered_set<std::string>& attributes_to_read,
     std::unordered_set<std::string>& out_classes,
     std::unordered_multimap<std::string, std::string>& out_attributes) {
-  std::string contents = read_entire_file(file_path);
-  extract_classes_from_layout(contents, attributes_to_read, out_classes,
-                              out_attributes);
+  MappedFile file(file_path);
+  if (file.empty()) {
+    return;
+  }
+  extract_classes_from_layout(file.data(), file.size(), attributes_to_read,
+                              out_classes, out_attributes);
 }
 
 void collect_layout_classes_and_attributes(
@@ -1011,10 +1221,21 @@ void collect_layout_classes_and_attributes(
     std::unordered_set<std::string>& out_classes,
     std::unordered_multimap<std::string, std::string>& out_attributes) {
   std::vector<std::string> files = find_layout_files(apk_directory);
-  for (const auto& layout_file : files) {
+  // Layouts are parsed independently; only merging the results is serialized.
+  std::mutex out_lock;
+  auto wq = workqueue_foreach<std::string>([&](const std::string& file_path) {
+    std::unordered_set<std::string> classes;
+    std::unordered_multimap<std::string, std::string> attributes;
     collect_layout_classes_and_attributes_for_file(
-        layout_file, attributes_to_read, out_classes, out_attributes);
+        file_path, attributes_to_read, classes, attributes);
+    std::lock_guard<std::mutex> lock(out_lock);
+    out_classes.insert(classes.begin(), classes.end());
+    out_attributes.insert(attributes.begin(), attributes.end());
+  });
+  for (const auto& layout_file : files) {
+    wq.add_item(layout_file);
   }
+  wq.run_all();
 }
 
 std::unordered_set<std::string> get_layout_classes(
@@ -1117,12 +1338,27 @@ size_t write_serialized_data(const android::Vector<char>& cVec,
                              void* file_pointer,
                              size_t length) {
   size_t vec_size = cVec.size();
-  if (vec_size > 0) {
-    memcpy(file_pointer, &(cVec[0]), vec_size);
-  }
-
   munmap(file_pointer, length);
-  ftruncate(file_descriptor, cVec.size());
+  ftruncate(file_descriptor, vec_size);
+  // Write through the descriptor rather than the mapping, which can't hold
+  // data that grew past the original length.
+  size_t written = 0;
+#ifdef _MSC_VER
+  // There is no pwrite here, but nothing else uses the descriptor.
+  always_assert_log(lseek(file_descriptor, 0, SEEK_SET) == 0,
+                    "Failed to write serialized data");
+#endif
+  while (written < vec_size) {
+#ifdef _MSC_VER
+    auto n = write(file_descriptor, cVec.array() + written,
+                   static_cast<unsigned int>(vec_size - written));
+#else
+    auto n = pwrite(file_descriptor, cVec.array() + written,
+                    vec_size - written, written);
+#endif
+    always_assert_log(n > 0, "Failed to write serialized data");
+    written += n;
+  }
   close(file_descriptor);
   return vec_size > 0 ? vec_size : length;
 }
@@ -1286,6 +1522,8 @@ void ResourcesArscFile::remap_ids(
     remapped.add(pair.second);
   }
 
+  // Remapping visits every remapped resource, so index their entries first.
+  res_table.buildEntryIndex();
   for (const auto& pair : old_to_remapped_ids) {
     res_table.remapReferenceValuesForResource(pair.first, old, remapped);
   }
@@ -113,6 +113,9 @@ std::unordered_set<std::string> get_layout_classes(
 std::unordered_set<std::string> get_xml_files(const std::string& directory);
 std::unordered_set<uint32_t> get_xml_reference_attributes(
     const std::string& filename);
+// Same as above, for many files, parsed in parallel.
+std::unordered_set<uint32_t> get_xml_reference_attributes(
+    const std::vector<std::string>& filenames);
 // Checks if the file is in a res/raw folder. Such a file won't be considered
 // for resource remapping, class name extraction, etc. These files don't follow
 // binary XML format, and thus are out of scope for many optimizations.
@@ -123,6 +126,10 @@ int inline_xml_reference_attributes(
 void remap_xml_reference_attributes(
     const std::string& filename,
     const std::map<uint32_t, uint32_t>& kept_to_remapped_ids);
+// Same as above, for many files, remapped in parallel.
+void remap_xml_reference_attributes(
+    const std::vector<std::string>& filenames,
+    const std::map<uint32_t, uint32_t>& kept_to_remapped_ids);
 
 // Iterates through all layouts in the given directory. Adds all class names to
 // the output set, and allows for any specified attribute values to be returned
@@ -177,6 +184,13 @@ void walk_references_for_resource(
     std::unordered_set<uint32_t>* nodes_visited,
     std::unordered_set<std::string>* leaf_string_values);
 
+// Names of the sounds, uris and registered assets that a JS bundle refers to,
+// found in a single pass over the bundle.
+std::unordered_set<std::string> extract_js_resources(const char* data,
+                                                     size_t size);
+std::unordered_set<std::string> extract_js_resources(
+    const std::string& file_contents);
+
 std::unordered_set<uint32_t> get_js_resources(
     const std::string& directory,
     const std::vector<std::string>& js_assets_lists,
@@ -195,7 +209,7 @@ class ResourcesArscFile {
 
   android::ResTable res_table;
   android::SortedVector<uint32_t> sorted_res_ids;
-  std::map<uint32_t, std::string> id_to_name;
+  std::unordered_map<uint32_t, std::string> id_to_name;
   std::map<std::string, std::vector<uint32_t>> name_to_ids;
 
   explicit ResourcesArscFile(const std::string& path);
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "ReferenceIndex.h"
+
+#include <algorithm>
+
+#include "ControlFlow.h"
+#include "IRCode.h"
+#include "IRInstruction.h"
+#include "Resolver.h"
+#include "Walkers.h"
+#include "WorkQueue.h"
+
+namespace reference_index {
+
+namespace {
+
+template <typename Fn>
+void for_each_insn(IRCode* code, const Fn& fn) {
+  if (code->editable_cfg_built()) {
+    for (auto& mie : cfg::InstructionIterable(code->cfg())) {
+      fn(mie.insn);
+    }
+  } else {
+    for (auto& mie : InstructionIterable(code)) {
+      fn(mie.insn);
+    }
+  }
+}
+
+} // namespace
+
+ReferenceIndex::ReferenceIndex(const Scope& scope) {
+  walk::parallel::code(scope,
+                       [&](DexMethod* method, IRCode&) { index(method); });
+}
+
+void ReferenceIndex::mark_dirty(DexMethod* method) { m_dirty.insert(method); }
+
+void ReferenceIndex::update() {
+  auto wq = workqueue_foreach<DexMethod*>([&](DexMethod* method) {
+    unindex(method);
+    if (method->get_code() != nullptr) {
+      index(method);
+    }
+  });
+  for (auto method : m_dirty) {
+    wq.add_item(method);
+  }
+  wq.run_all();
+  m_dirty.clear();
+}
+
+void ReferenceIndex::index(DexMethod* method) {
+  std::unordered_set<const void*> entities;
+  for_each_insn(method->get_code(), [&](IRInstruction* insn) {
+    if (insn->has_method()) {
+      entities.insert(insn->get_method());
+    } else if (insn->has_field()) {
+      auto field = insn->get_field();
+      entities.insert(field);
+      auto def = resolve_field(field);
+      if (def != nullptr) {
+        entities.insert(def);
+      }
+    } else if (insn->has_type()) {
+      entities.insert(insn->get_type());
+    } else if (insn->has_string()) {
+      entities.insert(insn->get_string());
+    }
+  });
+  for (auto entity : entities) {
+    m_methods.update(entity,
+                     [&](const void*, std::unordered_set<DexMethod*>& methods,
+                         bool) { methods.insert(method); });
+  }
+  m_entities.emplace(method, std::vector<const void*>(entities.begin(),
+                                                      entities.end()));
+}
+
+void ReferenceIndex::unindex(DexMethod* method) {
+  std::vector<const void*> entities;
+  m_entities.update(
+      method, [&](DexMethod*, std::vector<const void*>& e, bool) {
+        entities = std::move(e);
+      });
+  m_entities.erase(method);
+  for (auto entity : entities) {
+    m_methods.update(entity,
+                     [&](const void*, std::unordered_set<DexMethod*>& methods,
+                         bool) { methods.erase(method); });
+  }
+}
+
+std::vector<DexMethod*> ReferenceIndex::methods_of(const void* entity) const {
+  std::vector<DexMethod*> result;
+  auto it = m_methods.find(entity);
+  if (it != m_methods.end()) {
+    result.assign(it->second.begin(), it->second.end());
+    std::sort(result.begin(), result.end(), compare_dexmethods);
+  }
+  return result;
+}
+
+} // namespace reference_index
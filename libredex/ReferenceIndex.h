@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "ConcurrentContainers.h"
+#include "DexClass.h"
+
+namespace reference_index {
+
+/*
+ * An inverted index from the method refs, field refs, types and strings that
+ * instructions refer to, to the methods whose code has such instructions, so
+ * that "who references X?" costs O(result) instead of a walk over all code.
+ *
+ * Refs are indexed as they appear in the instructions. Field refs are also
+ * indexed under the field definition they resolve to, so a query for a
+ * definition finds accesses through refs on subclasses.
+ *
+ * The index is built in parallel once. It holds methods rather than
+ * instructions, so editing code never leaves it with dangling pointers, but
+ * code that changes which entities a method refers to must report the method
+ * via mark_dirty(). update() then re-indexes just the dirty methods. Until
+ * then, queries reflect the code as it was, so callers should look at the
+ * code of the methods they get.
+ *
+ * mark_dirty() is thread-safe. Queries may run concurrently with each other,
+ * but not with update().
+ */
+class ReferenceIndex {
+ public:
+  explicit ReferenceIndex(const Scope& scope);
+
+  void mark_dirty(DexMethod* method);
+
+  void update();
+
+  // The methods referring to the given entity, in a deterministic order.
+  std::vector<DexMethod*> methods(const DexMethodRef* method) const {
+    return methods_of(method);
+  }
+  std::vector<DexMethod*> methods(const DexFieldRef* field) const {
+    return methods_of(field);
+  }
+  std::vector<DexMethod*> methods(const DexType* type) const {
+    return methods_of(type);
+  }
+  std::vector<DexMethod*> methods(const DexString* str) const {
+    return methods_of(str);
+  }
+
+  size_t num_indexed_methods() const { return m_entities.size(); }
+
+ private:
+  void index(DexMethod* method);
+  void unindex(DexMethod* method);
+  std::vector<DexMethod*> methods_of(const void* entity) const;
+
+  // The entities each indexed method refers to, without repetitions.
+  ConcurrentMap<DexMethod*, std::vector<const void*>> m_entities;
+  ConcurrentMap<const void*, std::unordered_set<DexMethod*>> m_methods;
+  ConcurrentSet<DexMethod*> m_dirty;
+};
+
+} // namespace reference_index
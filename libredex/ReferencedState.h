@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <atomic>
 #include <boost/optional.hpp>
 #include <mutex>
@@ -114,12 +115,9 @@ class ReferencedState {
   boost::optional<InterdexSubgroupIdx> m_interdex_subgroup{boost::none};
 
   // Going through hoops here to reduce the size of ReferencedState while
-  // keeping memory requirements still small in non-default case.
-  struct KeepReasons {
-    std::mutex m_keep_reasons_mtx;
-    keep_reason::ReasonPtrSet m_keep_reasons;
-  };
-  mutable std::atomic<KeepReasons*> m_keep_reasons{nullptr};
+  // keeping memory requirements still small in non-default case. Updates are
+  // guarded by RedexContext::keep_reasons_mutex.
+  mutable std::atomic<keep_reason::ReasonPtrVector*> m_keep_reasons{nullptr};
 
  public:
   ReferencedState() = default;
@@ -268,14 +266,13 @@ class ReferencedState {
     }
   }
 
-  const keep_reason::ReasonPtrSet& keep_reasons() const {
+  const keep_reason::ReasonPtrVector& keep_reasons() const {
     if (!RedexContext::record_keep_reasons()) {
       // We really should not allow this.
-      static keep_reason::ReasonPtrSet SINGLETON;
+      static keep_reason::ReasonPtrVector SINGLETON;
       return SINGLETON;
     }
-    auto& keep_reasons = ensure_keep_reasons();
-    return keep_reasons.m_keep_reasons;
+    return ensure_keep_reasons();
   }
 
   template <class... Args>
@@ -374,7 +371,7 @@ class ReferencedState {
     inner_struct.m_unset_allowobfuscation = true;
   }
 
-  KeepReasons& ensure_keep_reasons() const {
+  keep_reason::ReasonPtrVector& ensure_keep_reasons() const {
     always_assert(RedexContext::record_keep_reasons());
     // First see whether it's already done to avoid allocating.
     auto attempt = m_keep_reasons.load();
@@ -382,8 +379,8 @@ class ReferencedState {
       return *attempt;
     }
     // OK, allocate and CAS.
-    auto keep_reasons = std::make_unique<KeepReasons>();
-    KeepReasons* expected = nullptr;
+    auto keep_reasons = std::make_unique<keep_reason::ReasonPtrVector>();
+    keep_reason::ReasonPtrVector* expected = nullptr;
     if (m_keep_reasons.compare_exchange_strong(expected, keep_reasons.get())) {
       return *keep_reasons.release();
     }
@@ -393,8 +390,12 @@ class ReferencedState {
   void add_keep_reason(const keep_reason::Reason* reason) {
     always_assert(RedexContext::record_keep_reasons());
     auto& keep_reasons = ensure_keep_reasons();
-    std::lock_guard<std::mutex> lock(keep_reasons.m_keep_reasons_mtx);
-    keep_reasons.m_keep_reasons.emplace(reason);
+    std::lock_guard<std::mutex> lock(RedexContext::keep_reasons_mutex(this));
+    auto it =
+        std::lower_bound(keep_reasons.begin(), keep_reasons.end(), reason);
+    if (it == keep_reasons.end() || *it != reason) {
+      keep_reasons.insert(it, reason);
+    }
   }
 
   friend class keep_rules::impl::KeepState;
@@ -7,6 +7,7 @@
 
 #include "ReflectionAnalysis.h"
 
+#include <atomic>
 #include <iomanip>
 #include <unordered_map>
 
@@ -131,7 +132,8 @@ std::ostream& operator<<(std::ostream& out,
 namespace reflection {
 
 AbstractHeapAddress allocate_heap_address() {
-  static AbstractHeapAddress addr = 1;
+  // Methods may be analyzed concurrently.
+  static std::atomic<AbstractHeapAddress> addr{1};
   return addr++;
 }
 
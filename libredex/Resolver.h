@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include "ConcurrentContainers.h"
 #include "DexClass.h"
 #include "DexUtil.h"
 #include "IRInstruction.h"
@@ -61,6 +62,9 @@ struct MethodRefCacheKeyHash {
 using MethodRefCache =
     std::unordered_map<MethodRefCacheKey, DexMethod*, MethodRefCacheKeyHash>;
 
+using ConcurrentMethodRefCache =
+    ConcurrentMap<MethodRefCacheKey, DexMethod*, MethodRefCacheKeyHash>;
+
 /**
  * Helper to map an opcode to a MethodSearch rule.
  */
@@ -240,6 +244,35 @@ inline DexMethod* resolve_method(DexMethodRef* method,
   return mdef;
 }
 
+/**
+ * Same as above, but the cache may be shared by several threads. Use this one
+ * when the resolver is called from parallel code, e.g. the one handed to
+ * MultiMethodInliner, which resolves callees from its worker threads.
+ */
+inline DexMethod* resolve_method(DexMethodRef* method,
+                                 MethodSearch search,
+                                 ConcurrentMethodRefCache& ref_cache,
+                                 const DexMethod* caller = nullptr) {
+  if (search == MethodSearch::Super) {
+    // We don't have cache for that since caller might be different.
+    return resolve_method(method, search, caller);
+  }
+  auto m = method->as_def();
+  if (m) {
+    return m;
+  }
+  MethodRefCacheKey cache_key{method, search};
+  auto def = ref_cache.get(cache_key, nullptr);
+  if (def != nullptr) {
+    return def;
+  }
+  auto mdef = resolve_method(method, search);
+  if (mdef != nullptr) {
+    ref_cache.emplace(cache_key, mdef);
+  }
+  return mdef;
+}
+
 /**
  * Given a scope defined by DexClass, a name and a proto look for the vmethod
  * on the top ancestor. Essentially finds where the method was introduced.
@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "SuffixArray.h"
+
+#include <algorithm>
+
+namespace suffix_array {
+
+namespace {
+
+// Stable counting sort of :in into :out by key(i), where all keys are < :range.
+template <typename Key>
+void counting_sort(const std::vector<uint32_t>& in,
+                   size_t range,
+                   const Key& key,
+                   std::vector<uint32_t>* counts,
+                   std::vector<uint32_t>* out) {
+  counts->assign(range + 1, 0);
+  for (auto i : in) {
+    ++(*counts)[key(i) + 1];
+  }
+  for (size_t k = 1; k <= range; ++k) {
+    (*counts)[k] += (*counts)[k - 1];
+  }
+  for (auto i : in) {
+    (*out)[(*counts)[key(i)]++] = i;
+  }
+}
+
+} // namespace
+
+std::vector<uint32_t> build(const std::vector<Symbol>& text) {
+  auto n = text.size();
+  std::vector<uint32_t> sa(n);
+  if (n == 0) {
+    return sa;
+  }
+  std::vector<uint32_t> counts;
+  std::vector<uint32_t> tmp(n);
+  for (uint32_t i = 0; i < n; ++i) {
+    tmp[i] = i;
+  }
+  auto alphabet_size = *std::max_element(text.begin(), text.end()) + size_t(1);
+  counting_sort(tmp, alphabet_size, [&](uint32_t i) { return text[i]; },
+                &counts, &sa);
+
+  // rank[i] is the class of the first h symbols of the suffix at i. Class 0 is
+  // reserved for the empty suffix past the end of the text.
+  std::vector<uint32_t> rank(n);
+  std::vector<uint32_t> next_rank(n);
+  uint32_t classes = 1;
+  rank[sa[0]] = classes;
+  for (size_t k = 1; k < n; ++k) {
+    if (text[sa[k]] != text[sa[k - 1]]) {
+      ++classes;
+    }
+    rank[sa[k]] = classes;
+  }
+  for (size_t h = 1; classes < n && h < n; h <<= 1) {
+    auto second = [&](uint32_t i) { return i + h < n ? rank[i + h] : 0; };
+    // Sort by the second half of each 2h prefix, then stably by the first.
+    counting_sort(sa, classes + 1, second, &counts, &tmp);
+    counting_sort(tmp, classes + 1, [&](uint32_t i) { return rank[i]; },
+                  &counts, &sa);
+    classes = 1;
+    next_rank[sa[0]] = classes;
+    for (size_t k = 1; k < n; ++k) {
+      auto a = sa[k - 1];
+      auto b = sa[k];
+      if (rank[a] != rank[b] || second(a) != second(b)) {
+        ++classes;
+      }
+      next_rank[b] = classes;
+    }
+    rank.swap(next_rank);
+  }
+  return sa;
+}
+
+std::vector<uint32_t> lcp(const std::vector<Symbol>& text,
+                          const std::vector<uint32_t>& sa) {
+  auto n = text.size();
+  std::vector<uint32_t> rank(n);
+  for (uint32_t k = 0; k < n; ++k) {
+    rank[sa[k]] = k;
+  }
+  std::vector<uint32_t> result(n, 0);
+  uint32_t h = 0;
+  for (uint32_t i = 0; i < n; ++i) {
+    if (rank[i] == 0) {
+      h = 0;
+      continue;
+    }
+    auto j = sa[rank[i] - 1];
+    while (i + h < n && j + h < n && text[i + h] == text[j + h]) {
+      ++h;
+    }
+    result[rank[i]] = h;
+    if (h > 0) {
+      --h;
+    }
+  }
+  return result;
+}
+
+std::vector<uint32_t> longest_repeats(const std::vector<Symbol>& text) {
+  auto sa = build(text);
+  auto lcps = lcp(text, sa);
+  auto n = text.size();
+  std::vector<uint32_t> result(n);
+  for (size_t k = 0; k < n; ++k) {
+    auto next = k + 1 < n ? lcps[k + 1] : 0;
+    result[sa[k]] = std::max(lcps[k], next);
+  }
+  return result;
+}
+
+} // namespace suffix_array
@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/*
+ * Suffix arrays over texts of integer symbols.
+ *
+ * To find repeats across many strings at once, concatenate them with a
+ * distinct separator symbol after each string; no common prefix then extends
+ * across a separator.
+ */
+namespace suffix_array {
+
+using Symbol = uint32_t;
+
+/*
+ * The start positions of all suffixes of :text in lexicographic order,
+ * computed by prefix doubling in O(n log n) time. Shorter suffixes come before
+ * longer ones that they are prefixes of.
+ */
+std::vector<uint32_t> build(const std::vector<Symbol>& text);
+
+/*
+ * The longest common prefix of each suffix with its predecessor in :sa, with
+ * 0 for the first one, computed in linear time [Kasai01].
+ *
+ *  [Kasai01] T. Kasai et al. Linear-Time Longest-Common-Prefix Computation in
+ *    Suffix Arrays and Its Applications. CPM 2001.
+ */
+std::vector<uint32_t> lcp(const std::vector<Symbol>& text,
+                          const std::vector<uint32_t>& sa);
+
+/*
+ * For each position of :text, the length of the longest prefix of the suffix
+ * starting there that also occurs at some other position.
+ */
+std::vector<uint32_t> longest_repeats(const std::vector<Symbol>& text);
+
+} // namespace suffix_array
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "SummaryCache.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include "DexClass.h"
+#include "IRAssembler.h"
+#include "IRCode.h"
+#include "PassResultCache.h"
+#include "Show.h"
+#include "Trace.h"
+
+namespace {
+
+constexpr const char* CACHE_HEADER = "redex-summary-cache 1";
+
+} // namespace
+
+SummaryCache::SummaryCache(std::string path, std::string salt)
+    : m_path(std::move(path)), m_salt(std::move(salt)) {
+  load();
+}
+
+void SummaryCache::load() {
+  std::ifstream in(m_path, std::ios::binary);
+  if (!in) {
+    return;
+  }
+  std::string header;
+  if (!std::getline(in, header) || header != CACHE_HEADER) {
+    TRACE(PM, 1, "Ignoring summary cache %s with unknown format",
+          m_path.c_str());
+    return;
+  }
+  // Each entry is "<key> <summary length>\n<summary>\n".
+  std::string key;
+  std::string summary;
+  size_t length;
+  while (in >> key >> length && in.get() == '\n') {
+    summary.resize(length);
+    if (!in.read(&summary[0], length) || in.get() != '\n') {
+      TRACE(PM, 1, "Truncated summary cache %s", m_path.c_str());
+      break;
+    }
+    m_loaded.emplace(key, summary);
+  }
+  TRACE(PM, 2, "Loaded %zu entries from summary cache %s", m_loaded.size(),
+        m_path.c_str());
+}
+
+std::string SummaryCache::key(
+    const DexMethod* method,
+    const std::vector<std::string>& dependencies) const {
+  auto* code = method->get_code();
+  if (code == nullptr || !pass_result_cache::is_representable(code)) {
+    return "";
+  }
+  std::string input = m_salt;
+  input += '\0';
+  input += show(method);
+  input += '\0';
+  input += std::to_string(method->get_access());
+  input += '\0';
+  input += assembler::to_string(code);
+  for (const auto& dependency : dependencies) {
+    input += '\0';
+    input += dependency;
+  }
+  return pass_result_cache::sha1_hex(input);
+}
+
+boost::optional<sparta::s_expr> SummaryCache::find(const std::string& key) {
+  auto it = m_loaded.find(key);
+  if (key.empty() || it == m_loaded.end()) {
+    ++m_misses;
+    return boost::none;
+  }
+  std::istringstream input(it->second);
+  sparta::s_expr_istream s_expr_input(input);
+  sparta::s_expr summary;
+  s_expr_input >> summary;
+  if (s_expr_input.fail()) {
+    TRACE(PM, 1, "Malformed entry in summary cache %s: %s", m_path.c_str(),
+          s_expr_input.what().c_str());
+    ++m_misses;
+    return boost::none;
+  }
+  m_used.emplace(key, it->second);
+  ++m_hits;
+  return summary;
+}
+
+void SummaryCache::record(const std::string& key,
+                          const sparta::s_expr& summary) {
+  if (key.empty()) {
+    return;
+  }
+  m_used.emplace(key, summary.str());
+}
+
+void SummaryCache::save() const {
+  auto tmp_path = m_path + ".tmp";
+  {
+    std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+      TRACE(PM, 1, "Cannot write summary cache %s", tmp_path.c_str());
+      return;
+    }
+    out << CACHE_HEADER << '\n';
+    for (const auto& p : m_used) {
+      out << p.first << ' ' << p.second.size() << '\n' << p.second << '\n';
+    }
+  }
+  if (std::rename(tmp_path.c_str(), m_path.c_str()) != 0) {
+    TRACE(PM, 1, "Cannot write summary cache %s", m_path.c_str());
+  }
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/optional.hpp>
+
+#include "ConcurrentContainers.h"
+#include "S_Expression.h"
+
+class DexMethod;
+
+/*
+ * An on-disk store of the method summaries computed by an interprocedural
+ * analysis, so that incremental builds only reanalyze the methods whose inputs
+ * changed.
+ *
+ * A summary is keyed by a SHA1 digest of a salt (which captures the analysis
+ * and its configuration), of the method's signature and code, and of the
+ * serialized summaries of everything else that the analysis of the method
+ * reads, typically its callees. An analysis that computes summaries bottom-up
+ * thus only recomputes the summaries of changed methods, and of those callers
+ * for which a callee summary actually changed.
+ *
+ * Typical use, once the summaries of the callees are known:
+ *
+ *   std::vector<std::string> dependencies;
+ *   for (auto* callee : callees) {
+ *     dependencies.push_back(show(callee) + " " + summaries.at(callee).str());
+ *   }
+ *   auto key = cache->key(method, dependencies);
+ *   if (auto cached = cache->find(key)) {
+ *     return Summary::from_s_expr(*cached);
+ *   }
+ *   auto summary = analyze(method);
+ *   cache->record(key, to_s_expr(summary));
+ *
+ * The dependencies must be serialized deterministically. key, find and record
+ * are thread-safe.
+ */
+class SummaryCache {
+ public:
+  // Load the summaries previously saved to :path, if any.
+  SummaryCache(std::string path, std::string salt);
+
+  // The key for :method's current code and the given :dependencies, or the
+  // empty string if it cannot be cached.
+  std::string key(const DexMethod* method,
+                  const std::vector<std::string>& dependencies) const;
+
+  // The summary recorded for :key, if any.
+  boost::optional<sparta::s_expr> find(const std::string& key);
+
+  // Store :summary as the summary for :key. Empty keys are ignored.
+  void record(const std::string& key, const sparta::s_expr& summary);
+
+  // Write back the summaries that were found or recorded in this run, see
+  // PassResultCache::save.
+  void save() const;
+
+  size_t hits() const { return m_hits; }
+  size_t misses() const { return m_misses; }
+
+ private:
+  void load();
+
+  const std::string m_path;
+  const std::string m_salt;
+  // Read-only once loaded.
+  std::unordered_map<std::string, std::string> m_loaded;
+  ConcurrentMap<std::string, std::string> m_used;
+  std::atomic<size_t> m_hits{0};
+  std::atomic<size_t> m_misses{0};
+};
@@ -7,26 +7,144 @@
 
 #include "Timer.h"
 
+#include <algorithm>
+#include <atomic>
+#include <ctime>
+#include <map>
+
 #include "Trace.h"
 
-unsigned Timer::s_indent = 0;
 std::mutex Timer::s_lock;
 Timer::times_t Timer::s_times;
+std::vector<Timer::Event> Timer::s_events;
 
-Timer::Timer(const std::string& msg)
-    : m_msg(msg), m_start(std::chrono::high_resolution_clock::now()) {
-  ++s_indent;
+namespace {
+
+const auto s_process_start = std::chrono::high_resolution_clock::now();
+
+struct ThreadState {
+  uint32_t id;
+  uint32_t depth{0};
+  ThreadState() {
+    static std::atomic<uint32_t> next_id{0};
+    id = next_id++;
+  }
+};
+
+ThreadState& thread_state() {
+  static thread_local ThreadState state;
+  return state;
+}
+
+double thread_cpu_seconds() {
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+  struct timespec ts;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0) {
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+  }
+#endif
+  return 0;
+}
+
+void write_json_string(std::ostream& os, const std::string& str) {
+  os << '"';
+  for (unsigned char c : str) {
+    switch (c) {
+    case '"':
+      os << "\\\"";
+      break;
+    case '\\':
+      os << "\\\\";
+      break;
+    case '\n':
+      os << "\\n";
+      break;
+    case '\t':
+      os << "\\t";
+      break;
+    default:
+      if (c < 0x20) {
+        static const char* hex = "0123456789abcdef";
+        os << "\\u00" << hex[c >> 4] << hex[c & 0xf];
+      } else {
+        os << c;
+      }
+    }
+  }
+  os << '"';
 }
 
+} // namespace
+
+Timer::Timer(const std::string& msg)
+    : m_msg(msg),
+      m_start(std::chrono::high_resolution_clock::now()),
+      m_cpu_start(thread_cpu_seconds()),
+      m_depth(thread_state().depth++) {}
+
 Timer::~Timer() {
-  --s_indent;
+  auto& state = thread_state();
+  --state.depth;
   auto end = std::chrono::high_resolution_clock::now();
   auto duration_s = std::chrono::duration<double>(end - m_start).count();
-  TRACE(TIME, 1, "%*s%s completed in %.1lf seconds", 4 * s_indent, "",
+  auto cpu_s = thread_cpu_seconds() - m_cpu_start;
+  TRACE(TIME, 1, "%*s%s completed in %.1lf seconds", 4 * m_depth, "",
         m_msg.c_str(), duration_s);
 
+  Event event;
+  event.name = m_msg;
+  event.thread = state.id;
+  event.depth = m_depth;
+  event.start_s =
+      std::chrono::duration<double>(m_start - s_process_start).count();
+  event.wall_s = duration_s;
+  event.cpu_s = cpu_s;
   {
     std::lock_guard<std::mutex> guard(s_lock);
     s_times.push_back({std::move(m_msg), duration_s});
+    s_events.push_back(std::move(event));
+  }
+}
+
+std::vector<Timer::Event> Timer::get_events() {
+  std::lock_guard<std::mutex> guard(s_lock);
+  return s_events;
+}
+
+std::vector<std::pair<std::string, Timer::Summary>> Timer::get_summary() {
+  std::map<std::string, Summary> by_name;
+  for (const auto& event : get_events()) {
+    auto& summary = by_name[event.name];
+    ++summary.count;
+    summary.wall_s += event.wall_s;
+    summary.cpu_s += event.cpu_s;
+  }
+  return {by_name.begin(), by_name.end()};
+}
+
+void Timer::write_chrome_trace(std::ostream& os) {
+  auto events = get_events();
+  uint32_t num_threads = 0;
+  os << "{\"traceEvents\":[";
+  bool first = true;
+  for (const auto& event : events) {
+    num_threads = std::max(num_threads, event.thread + 1);
+    os << (first ? "\n" : ",\n");
+    first = false;
+    // A complete ("X") event; timestamps are in microseconds.
+    os << "{\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread << ",\"name\":";
+    write_json_string(os, event.name);
+    os << ",\"ts\":" << static_cast<uint64_t>(event.start_s * 1e6)
+       << ",\"dur\":" << static_cast<uint64_t>(event.wall_s * 1e6)
+       << ",\"args\":{\"depth\":" << event.depth << ",\"cpu_us\":"
+       << static_cast<uint64_t>(event.cpu_s * 1e6) << "}}";
+  }
+  for (uint32_t t = 0; t < num_threads; ++t) {
+    os << (first ? "\n" : ",\n");
+    first = false;
+    os << "{\"ph\":\"M\",\"pid\":1,\"tid\":" << t
+       << ",\"name\":\"thread_name\",\"args\":{\"name\":\"thread " << t
+       << "\"}}";
   }
+  os << "\n]}\n";
 }
@@ -8,11 +8,20 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
 #include <mutex>
+#include <ostream>
 #include <string>
 #include <utility>
 #include <vector>
 
+/*
+ * A scoped timer. Besides logging its duration via TRACE(TIME, ...), every
+ * Timer records an event with its nesting depth on the current thread, its wall
+ * time and the CPU time that thread spent in it. The events of a whole run can
+ * be written out in Chrome trace-event format (see write_chrome_trace), and
+ * viewed in Perfetto or chrome://tracing.
+ */
 struct Timer {
   explicit Timer(const std::string& msg);
   ~Timer();
@@ -21,10 +30,39 @@ struct Timer {
   // there should be no currently running Timers when this function is called
   static const times_t& get_times() { return s_times; }
 
+  struct Event {
+    std::string name;
+    // Threads are numbered in the order in which they first start a Timer.
+    uint32_t thread;
+    // The number of enclosing Timers on the same thread.
+    uint32_t depth;
+    // Relative to the start of the process.
+    double start_s;
+    double wall_s;
+    double cpu_s;
+  };
+
+  // Completed timer scopes, in order of completion.
+  static std::vector<Event> get_events();
+
+  struct Summary {
+    size_t count{0};
+    double wall_s{0};
+    double cpu_s{0};
+  };
+
+  // Aggregate the completed scopes by name.
+  static std::vector<std::pair<std::string, Summary>> get_summary();
+
+  // Write all completed scopes as a JSON trace in Chrome trace-event format.
+  static void write_chrome_trace(std::ostream& os);
+
  private:
   static std::mutex s_lock;
   static times_t s_times;
-  static unsigned s_indent;
+  static std::vector<Event> s_events;
   std::string m_msg;
   std::chrono::high_resolution_clock::time_point m_start;
+  double m_cpu_start;
+  uint32_t m_depth;
 };
@@ -7,6 +7,7 @@
 
 #include "Trace.h"
 
+#include <algorithm>
 #include <array>
 #include <cstdarg>
 #include <cstdio>
@@ -14,6 +15,7 @@
 #include <cstring>
 #include <ctime>
 #include <iostream>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <unordered_map>
@@ -33,6 +35,8 @@ struct Tracer {
     const char* envfile = getenv("TRACEFILE");
     const char* show_timestamps = getenv("SHOW_TIMESTAMPS");
     const char* show_tracemodule = getenv("SHOW_TRACEMODULE");
+    const char* sample = getenv("TRACE_SAMPLE");
+    const char* buffered = getenv("TRACE_BUFFERED");
     m_method_filter = getenv("TRACE_METHOD_FILTER");
     if (!traceenv) {
       return;
@@ -50,6 +54,10 @@ struct Tracer {
     std::cerr << "TRACE_METHOD_FILTER="
               << (m_method_filter == nullptr ? "" : m_method_filter)
               << std::endl;
+    std::cerr << "TRACE_SAMPLE=" << (sample == nullptr ? "" : sample)
+              << std::endl;
+    std::cerr << "TRACE_BUFFERED=" << (buffered == nullptr ? "" : buffered)
+              << std::endl;
 
     init_trace_modules(traceenv);
     init_trace_file(envfile);
@@ -60,6 +68,12 @@ struct Tracer {
     if (show_tracemodule) {
       m_show_tracemodule = true;
     }
+    if (sample) {
+      m_sample = std::max(1L, strtol(sample, nullptr, 10));
+    }
+    if (buffered) {
+      m_buffered = true;
+    }
 
 #define TM(x) m_module_id_name_map[static_cast<int>(x)] = #x;
     TMS
@@ -87,7 +101,18 @@ struct Tracer {
         return;
       }
     }
-    std::lock_guard<std::mutex> guard(TraceContext::s_trace_mutex);
+    if (m_sample > 1) {
+      // Each thread keeps every m_sample-th of its messages.
+      thread_local long t_num_messages = 0;
+      if (t_num_messages++ % m_sample != 0) {
+        return;
+      }
+    }
+
+    // Format the whole message before taking the lock, so that threads only
+    // contend for writing it out.
+    thread_local std::string t_line;
+    t_line.clear();
     if (m_show_timestamps) {
       auto t = std::time(nullptr);
       struct tm local_tm;
@@ -98,19 +123,36 @@ struct Tracer {
 #endif
       std::array<char, 40> buf;
       std::strftime(buf.data(), sizeof(buf), "%c", &local_tm);
-      fprintf(m_file, "[%s]", buf.data());
-      if (!m_show_tracemodule) {
-        fprintf(m_file, " ");
-      }
+      t_line += '[';
+      t_line += buf.data();
+      t_line += m_show_tracemodule ? "]" : "] ";
     }
     if (m_show_tracemodule) {
-      fprintf(m_file, "[%s:%d] ", m_module_id_name_map[module].c_str(), level);
+      t_line += '[';
+      t_line += m_module_id_name_map.at(module);
+      t_line += ':';
+      t_line += std::to_string(level);
+      t_line += "] ";
+    }
+    va_list ap_copy;
+    va_copy(ap_copy, ap);
+    int size = vsnprintf(nullptr, 0, fmt, ap_copy);
+    va_end(ap_copy);
+    if (size > 0) {
+      auto prefix_size = t_line.size();
+      t_line.resize(prefix_size + size + 1);
+      vsnprintf(&t_line[prefix_size], size + 1, fmt, ap);
+      t_line.resize(prefix_size + size);
     }
-    vfprintf(m_file, fmt, ap);
     if (!suppress_newline) {
-      fprintf(m_file, "\n");
+      t_line += '\n';
+    }
+
+    std::lock_guard<std::mutex> guard(TraceContext::s_trace_mutex);
+    fwrite(t_line.data(), 1, t_line.size(), m_file);
+    if (!m_buffered) {
+      fflush(m_file);
     }
-    fflush(m_file);
   }
 
  private:
@@ -169,6 +211,10 @@ struct Tracer {
   FILE* m_file{nullptr};
   long m_level{0};
   std::array<long, N_TRACE_MODULES> m_traces;
+  // Only every m_sample-th message of a thread is written.
+  long m_sample{1};
+  // Whether to leave flushing to stdio instead of flushing every message.
+  bool m_buffered{false};
 };
 
 static Tracer tracer;
@@ -193,3 +239,75 @@ void trace(TraceModule module,
 
 thread_local const std::string* TraceContext::s_current_method = nullptr;
 std::mutex TraceContext::s_trace_mutex;
+std::atomic<size_t> TraceContext::s_num_slowest_methods{0};
+
+namespace {
+
+using MethodTime = TraceContext::MethodTime;
+
+bool slower(const MethodTime& a, const MethodTime& b) {
+  return a.second > b.second;
+}
+
+// A min-heap (by `slower`) of the slowest methods one thread has seen. The
+// heaps outlive their threads, so that worker threads which are gone by the
+// time the pass ends still count.
+struct SlowestMethods {
+  std::vector<MethodTime> heap;
+
+  // Only copies the name when the method makes it into the heap.
+  void add(const std::string& method,
+           std::chrono::microseconds time,
+           size_t limit) {
+    if (heap.size() < limit) {
+      heap.emplace_back(method, time);
+      std::push_heap(heap.begin(), heap.end(), slower);
+    } else if (!heap.empty() && time > heap.front().second) {
+      std::pop_heap(heap.begin(), heap.end(), slower);
+      heap.back() = MethodTime(method, time);
+      std::push_heap(heap.begin(), heap.end(), slower);
+    }
+  }
+};
+
+std::mutex s_slowest_methods_mutex;
+std::vector<std::shared_ptr<SlowestMethods>> s_slowest_methods;
+
+} // namespace
+
+void TraceContext::record_method_time(
+    const std::string& method, std::chrono::steady_clock::duration time) {
+  thread_local std::shared_ptr<SlowestMethods> slowest;
+  if (slowest == nullptr) {
+    slowest = std::make_shared<SlowestMethods>();
+    std::lock_guard<std::mutex> guard(s_slowest_methods_mutex);
+    s_slowest_methods.push_back(slowest);
+  }
+  slowest->add(method,
+               std::chrono::duration_cast<std::chrono::microseconds>(time),
+               s_num_slowest_methods.load(std::memory_order_relaxed));
+}
+
+std::vector<TraceContext::MethodTime> TraceContext::take_slowest_methods() {
+  std::lock_guard<std::mutex> guard(s_slowest_methods_mutex);
+  std::vector<MethodTime> result;
+  for (auto& slowest : s_slowest_methods) {
+    for (auto& method_time : slowest->heap) {
+      result.push_back(std::move(method_time));
+    }
+    slowest->heap.clear();
+  }
+  // Drop the heaps of threads that have exited.
+  s_slowest_methods.erase(
+      std::remove_if(s_slowest_methods.begin(), s_slowest_methods.end(),
+                     [](const std::shared_ptr<SlowestMethods>& slowest) {
+                       return slowest.use_count() == 1;
+                     }),
+      s_slowest_methods.end());
+  std::sort(result.begin(), result.end(), slower);
+  auto limit = s_num_slowest_methods.load(std::memory_order_relaxed);
+  if (result.size() > limit) {
+    result.resize(limit);
+  }
+  return result;
+}
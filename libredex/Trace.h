@@ -7,9 +7,13 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "Util.h"
 
@@ -177,9 +181,35 @@ void trace(
 struct TraceContext {
   explicit TraceContext(const std::string& current_method) {
     s_current_method = &current_method;
+    if (s_num_slowest_methods.load(std::memory_order_relaxed) != 0) {
+      m_method = &current_method;
+      m_start = std::chrono::steady_clock::now();
+    }
   }
-  ~TraceContext() { s_current_method = nullptr; }
+  ~TraceContext() {
+    if (m_method != nullptr) {
+      record_method_time(*m_method, std::chrono::steady_clock::now() - m_start);
+    }
+    s_current_method = nullptr;
+  }
+
+  /*
+   * While s_num_slowest_methods is nonzero, every TraceContext measures how
+   * long the method it wraps took, and that many of the slowest are kept.
+   * take_slowest_methods() returns them, slowest first, and forgets them; it
+   * must not race with any walk.
+   */
+  using MethodTime = std::pair<std::string, std::chrono::microseconds>;
+  static std::vector<MethodTime> take_slowest_methods();
 
   thread_local static const std::string* s_current_method;
   static std::mutex s_trace_mutex;
+  static std::atomic<size_t> s_num_slowest_methods;
+
+ private:
+  static void record_method_time(const std::string& method,
+                                 std::chrono::steady_clock::duration time);
+
+  const std::string* m_method{nullptr};
+  std::chrono::steady_clock::time_point m_start;
 };
@@ -11,6 +11,8 @@
 #include <ostream>
 #include <sstream>
 
+#include "AllocTracking.h"
+
 std::ostream& operator<<(std::ostream& output, const IRType& type) {
   switch (type) {
   case BOTTOM: {
@@ -322,6 +324,7 @@ void TypeInference::run(const DexMethod* dex_method) {
 void TypeInference::run(bool is_static,
                         DexType* declaring_type,
                         DexTypeList* args) {
+  alloc_tracking::ScopedCategory scope(alloc_tracking::Category::ANALYSIS);
   // We need to compute the initial environment by assigning the parameter
   // registers their correct types derived from the method's signature. The
   // IOPCODE_LOAD_PARAM_* instructions are pseudo-operations that are used to
@@ -69,7 +69,8 @@ void load_interface_children(const Scope& scope, ClassHierarchy& children) {
 const TypeSet TypeSystem::empty_set = TypeSet();
 const TypeVector TypeSystem::empty_vec = TypeVector();
 
-TypeSystem::TypeSystem(const Scope& scope) : m_class_scopes(scope) {
+TypeSystem::TypeSystem(const Scope& scope)
+    : m_class_scopes(get_cached_class_scopes(scope)) {
   load_interface_children(scope, m_intf_children);
   make_instanceof_interfaces_table();
 }
@@ -127,7 +128,7 @@ const VirtualScope* TypeSystem::find_virtual_scope(
   auto type = meth->get_class();
   while (type != nullptr) {
     TRACE(VIRT, 5, "check... %s", SHOW(type));
-    for (const auto& scope : m_class_scopes.get(type)) {
+    for (const auto& scope : m_class_scopes->get(type)) {
       TRACE(VIRT, 5, "check... %s", SHOW(scope->methods[0].first));
       if (match(scope->methods[0].first, meth)) {
         TRACE(VIRT, 5, "return scope");
@@ -170,7 +171,7 @@ std::vector<const DexMethod*> TypeSystem::select_from(
 
 void TypeSystem::make_instanceof_interfaces_table() {
   TypeVector no_parents;
-  const auto& hierarchy = m_class_scopes.get_class_hierarchy();
+  const auto& hierarchy = m_class_scopes->get_class_hierarchy();
   for (const auto& children_it : hierarchy) {
     const auto parent = children_it.first;
     const auto parent_cls = type_class(parent);
@@ -203,7 +204,7 @@ void TypeSystem::make_interfaces_table(const DexType* type) {
     }
   }
 
-  const auto& hierarchy = m_class_scopes.get_class_hierarchy();
+  const auto& hierarchy = m_class_scopes->get_class_hierarchy();
   const auto& children = hierarchy.find(type);
   if (children == hierarchy.end()) return;
   for (const auto& child : children->second) {
@@ -11,6 +11,7 @@
 #include "DexClass.h"
 #include "VirtualScope.h"
 
+#include <memory>
 #include <unordered_map>
 
 using TypeVector = std::vector<const DexType*>;
@@ -34,7 +35,7 @@ class TypeSystem {
   static const TypeSet empty_set;
   static const TypeVector empty_vec;
 
-  ClassScopes m_class_scopes;
+  std::shared_ptr<const ClassScopes> m_class_scopes;
   ClassHierarchy m_intf_children;
   InstanceOfTable m_instanceof_table;
   TypeToTypeSet m_interfaces;
@@ -47,8 +48,8 @@ class TypeSystem {
    * The type must be a class (not an interface).
    */
   const TypeSet& get_children(const DexType* type) const {
-    const auto& children = m_class_scopes.get_class_hierarchy().find(type);
-    return children != m_class_scopes.get_class_hierarchy().end()
+    const auto& children = m_class_scopes->get_class_hierarchy().find(type);
+    return children != m_class_scopes->get_class_hierarchy().end()
                ? children->second
                : empty_set;
   }
@@ -59,7 +60,7 @@ class TypeSystem {
    */
   void get_all_children(const DexType* type, TypeSet& children) const {
     return ::get_all_children(
-        m_class_scopes.get_class_hierarchy(), type, children);
+        m_class_scopes->get_class_hierarchy(), type, children);
   }
 
   /**
@@ -124,8 +125,8 @@ class TypeSystem {
    * or an interface DAG.
    */
   bool implements(const DexType* cls, const DexType* intf) const {
-    const auto& implementors = m_class_scopes.get_interface_map().find(intf);
-    if (implementors == m_class_scopes.get_interface_map().end()) return false;
+    const auto& implementors = m_class_scopes->get_interface_map().find(intf);
+    if (implementors == m_class_scopes->get_interface_map().end()) return false;
     return implementors->second.count(cls) > 0;
   }
 
@@ -137,8 +138,8 @@ class TypeSystem {
    * interface will be included in the returning set.
    */
   const TypeSet& get_implementors(const DexType* intf) const {
-    const auto& implementors = m_class_scopes.get_interface_map().find(intf);
-    if (implementors == m_class_scopes.get_interface_map().end()) {
+    const auto& implementors = m_class_scopes->get_interface_map().find(intf);
+    if (implementors == m_class_scopes->get_interface_map().end()) {
       return empty_set;
     }
     return implementors->second;
@@ -181,14 +182,14 @@ class TypeSystem {
    * The ClassScopes lifetime is tied to that of the TypeSystem, as
    * such it should not exceed it.
    */
-  const ClassScopes& get_class_scopes() const { return m_class_scopes; }
+  const ClassScopes& get_class_scopes() const { return *m_class_scopes; }
 
   /**
    * Given a DexMethod return the scope the method is in.
    */
   const VirtualScope* find_virtual_scope(const DexMethod* meth) const;
   InterfaceScope find_interface_scope(const DexMethod* meth) const {
-    return m_class_scopes.find_interface_scope(meth);
+    return m_class_scopes->find_interface_scope(meth);
   }
 
   /**
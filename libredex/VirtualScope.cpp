@@ -10,9 +10,12 @@
 #include "DexAccess.h"
 #include "DexUtil.h"
 #include "ReachableClasses.h"
+#include "RedexContext.h"
 #include "Timer.h"
 #include "Trace.h"
+#include "WorkQueue.h"
 
+#include <boost/functional/hash.hpp>
 #include <map>
 #include <set>
 
@@ -646,10 +649,15 @@ void load_methods(const DexType* type, SignatureMap& sig_map) {
  * in this case, not knowing interface I, we mark all methods in A, B and C
  * ESCAPED but methods in D are not, so in this case they are just FINAL and
  * effectively D.k() would be non virtual as opposed to C.k() which is ESCAPED.
+ *
+ * The children of a type are independent of each other until they are merged
+ * into the type. With :parallel_children they are built concurrently, and
+ * then merged in the same order as they would be otherwise.
  */
 bool build_signature_map(const ClassHierarchy& hierarchy,
                          const DexType* type,
-                         SignatureMap& sig_map) {
+                         SignatureMap& sig_map,
+                         bool parallel_children = false) {
   always_assert_log(sig_map.empty(),
                     "intf_methods and children_methods are out params");
   const TypeSet& children = hierarchy.at(type);
@@ -665,16 +673,44 @@ bool build_signature_map(const ClassHierarchy& hierarchy,
   // recurse through every child to collect all methods
   // and interface methods under type
   bool escape_up = false;
-  for (const auto& child : children) {
-    SignatureMap child_sig_map;
-    escape_up =
-        build_signature_map(hierarchy, child, child_sig_map) || escape_up;
-    TRACE(VIRT,
-          3,
-          "* Merging sig map of %s with child %s",
-          SHOW(type),
-          SHOW(child));
-    merge(base_sigs, intf_sig_map, sig_map, child_sig_map);
+  if (parallel_children) {
+    std::vector<const DexType*> ordered(children.begin(), children.end());
+    std::vector<SignatureMap> child_sig_maps(ordered.size());
+    std::vector<char> child_escapes(ordered.size());
+    auto wq = workqueue_foreach<size_t>(
+        [&](size_t i) {
+          child_escapes[i] =
+              build_signature_map(hierarchy, ordered[i], child_sig_maps[i]);
+        },
+        redex_parallel::default_num_threads(),
+        /* push_tasks_while_running */ false,
+        /* work_stealing */ true);
+    for (size_t i = 0; i < ordered.size(); ++i) {
+      wq.add_item(i);
+    }
+    wq.run_all();
+    for (size_t i = 0; i < ordered.size(); ++i) {
+      escape_up = child_escapes[i] || escape_up;
+      TRACE(VIRT,
+            3,
+            "* Merging sig map of %s with child %s",
+            SHOW(type),
+            SHOW(ordered[i]));
+      merge(base_sigs, intf_sig_map, sig_map, child_sig_maps[i]);
+      child_sig_maps[i].clear();
+    }
+  } else {
+    for (const auto& child : children) {
+      SignatureMap child_sig_map;
+      escape_up =
+          build_signature_map(hierarchy, child, child_sig_map) || escape_up;
+      TRACE(VIRT,
+            3,
+            "* Merging sig map of %s with child %s",
+            SHOW(type),
+            SHOW(child));
+      merge(base_sigs, intf_sig_map, sig_map, child_sig_map);
+    }
   }
 
   TRACE(VIRT, 3, "* Marking methods at %s", SHOW(type));
@@ -776,7 +812,11 @@ void get_root_scopes(const SignatureMap& sig_map,
 
 SignatureMap build_signature_map(const ClassHierarchy& class_hierarchy) {
   SignatureMap signature_map;
-  build_signature_map(class_hierarchy, type::java_lang_Object(), signature_map);
+  // Every class sub-hierarchy and every interface hangs off java.lang.Object.
+  build_signature_map(class_hierarchy,
+                      type::java_lang_Object(),
+                      signature_map,
+                      /* parallel_children */ true);
   return signature_map;
 }
 
@@ -849,56 +889,95 @@ const std::vector<std::vector<const VirtualScope*>>
     ClassScopes::empty_interface_scope =
         std::vector<std::vector<const VirtualScope*>>();
 
-ClassScopes::ClassScopes(const Scope& scope) {
-  m_hierarchy = build_type_hierarchy(scope);
-  m_interface_map = build_interface_map(m_hierarchy);
-  m_sig_map = build_signature_map(m_hierarchy);
-  build_class_scopes(type::java_lang_Object());
+ClassScopes::ClassScopes(const Scope& scope)
+    : m_class_hierarchy(get_cached_class_hierarchy(scope)) {
+  m_sig_map = build_signature_map(m_class_hierarchy->hierarchy);
+  build_class_scopes();
   build_interface_scopes();
 }
 
 const ClassHierarchy& ClassScopes::get_parent_to_children() const {
-  return m_hierarchy;
+  return m_class_hierarchy->hierarchy;
 }
 
 /**
- * Builds the ClassScope for type and children.
- * Calling with type::java_lang_Object() builds the ClassScope
- * for the entire system as redex knows it.
+ * Builds the ClassScope for java.lang.Object and all its children, i.e.
+ * for the entire system as redex knows it. The scopes of each type only
+ * depend on the SignatureMap, so they are found in parallel.
  */
-void ClassScopes::build_class_scopes(const DexType* type) {
-  auto cls = type_class(type);
-  always_assert(cls != nullptr || type == type::java_lang_Object());
-  get_root_scopes(m_sig_map, type, m_scopes);
+void ClassScopes::build_class_scopes() {
+  const auto& hierarchy = m_class_hierarchy->hierarchy;
+  std::vector<const DexType*> types;
+  std::vector<const DexType*> stack{type::java_lang_Object()};
+  while (!stack.empty()) {
+    auto type = stack.back();
+    stack.pop_back();
+    types.push_back(type);
+    const auto& children_it = hierarchy.find(type);
+    if (children_it != hierarchy.end()) {
+      stack.insert(stack.end(), children_it->second.begin(),
+                   children_it->second.end());
+    }
+  }
+
+  std::vector<std::vector<const VirtualScope*>> type_scopes(types.size());
+  auto wq = workqueue_foreach<size_t>([&](size_t i) {
+    auto type = types[i];
+    auto cls = type_class(type);
+    always_assert(cls != nullptr || type == type::java_lang_Object());
+    Scopes cls_scopes;
+    get_root_scopes(m_sig_map, type, cls_scopes);
+    auto it = cls_scopes.find(type);
+    if (it != cls_scopes.end()) {
+      type_scopes[i] = std::move(it->second);
+    }
+  });
+  for (size_t i = 0; i < types.size(); ++i) {
+    wq.add_item(i);
+  }
+  wq.run_all();
 
-  const auto& children_it = m_hierarchy.find(type);
-  if (children_it != m_hierarchy.end()) {
-    for (const auto& child : children_it->second) {
-      build_class_scopes(child);
+  for (size_t i = 0; i < types.size(); ++i) {
+    if (!type_scopes[i].empty()) {
+      m_scopes.emplace(types[i], std::move(type_scopes[i]));
     }
   }
 }
 
 void ClassScopes::build_interface_scopes() {
-  for (const auto& intf_it : m_interface_map) {
+  // Create all entries upfront, then fill them in parallel.
+  std::vector<std::pair<const DexClass*, std::vector<InterfaceScope>*>>
+      intf_scopes;
+  for (const auto& intf_it : m_class_hierarchy->interfaces) {
     const DexClass* intf_cls = type_class(intf_it.first);
     if (intf_cls == nullptr) {
       TRACE_NO_LINE(VIRT, 9, "missing DexClass for %s", SHOW(intf_it.first));
       continue;
     }
+    if (intf_cls->get_vmethods().empty()) continue;
+    intf_scopes.emplace_back(intf_cls, &m_interface_scopes[intf_it.first]);
+  }
+
+  auto wq = workqueue_foreach<size_t>([&](size_t i) {
+    const DexClass* intf_cls = intf_scopes[i].first;
+    const DexType* intf = intf_cls->get_type();
+    auto& intf_scope = *intf_scopes[i].second;
     for (const auto& meth : intf_cls->get_vmethods()) {
-      const auto& scopes = m_sig_map[meth->get_name()][meth->get_proto()];
+      const auto& scopes =
+          m_sig_map.at(meth->get_name()).at(meth->get_proto());
       always_assert(!scopes.empty()); // at least the method itself
-      auto& intf_scope = m_interface_scopes[intf_it.first];
       intf_scope.push_back({});
       for (const auto& scope : scopes) {
-        if (scope.interfaces.count(intf_it.first) == 0) continue;
-        TRACE_NO_LINE(
-            VIRT, 9, "add interface scope for %s", SHOW(intf_it.first));
+        if (scope.interfaces.count(intf) == 0) continue;
+        TRACE_NO_LINE(VIRT, 9, "add interface scope for %s", SHOW(intf));
         intf_scope.back().push_back(&scope);
       }
     }
+  });
+  for (size_t i = 0; i < intf_scopes.size(); ++i) {
+    wq.add_item(i);
   }
+  wq.run_all();
 }
 
 InterfaceScope ClassScopes::find_interface_scope(const DexMethod* meth) const {
@@ -918,3 +997,21 @@ InterfaceScope ClassScopes::find_interface_scope(const DexMethod* meth) const {
   }
   return intf_scope;
 }
+
+std::shared_ptr<const ClassScopes> get_cached_class_scopes(const Scope& scope) {
+  static RedexContextCache<const ClassScopes> cache;
+
+  // Virtual scopes also depend on the virtual methods of each class.
+  size_t hash = class_structure_hash(scope);
+  for (const auto* cls : scope) {
+    for (const auto* vmeth : cls->get_vmethods()) {
+      boost::hash_combine(hash, vmeth);
+      boost::hash_combine(hash, vmeth->get_name());
+      boost::hash_combine(hash, vmeth->get_proto());
+    }
+  }
+  return cache.get(hash, [&] {
+    Timer t("Building cached class scopes");
+    return std::make_shared<const ClassScopes>(scope);
+  });
+}
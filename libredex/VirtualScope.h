@@ -12,6 +12,7 @@
 #include "DexUtil.h"
 #include "Timer.h"
 #include <map>
+#include <memory>
 #include <unordered_map>
 #include <vector>
 
@@ -255,8 +256,7 @@ class ClassScopes {
 
   Scopes m_scopes;
   InterfaceScopes m_interface_scopes;
-  ClassHierarchy m_hierarchy;
-  InterfaceMap m_interface_map;
+  std::shared_ptr<const CachedClassHierarchy> m_class_hierarchy;
   SignatureMap m_sig_map;
 
  public:
@@ -335,10 +335,11 @@ class ClassScopes {
         walker(type, scope);
       }
     }
-    always_assert_log(m_hierarchy.find(type) != m_hierarchy.end(),
+    const auto& hierarchy = m_class_hierarchy->hierarchy;
+    always_assert_log(hierarchy.find(type) != hierarchy.end(),
                       "no entry in ClassHierarchy for type %s\n", SHOW(type));
     // recursively call for each child
-    for (const auto& child : m_hierarchy.at(type)) {
+    for (const auto& child : hierarchy.at(type)) {
       walk_virtual_scopes(child, walker);
     }
   }
@@ -366,10 +367,11 @@ class ClassScopes {
     if (scopes_it != m_scopes.end()) {
       walker(type, scopes_it->second);
     }
-    always_assert_log(m_hierarchy.find(type) != m_hierarchy.end(),
+    const auto& hierarchy = m_class_hierarchy->hierarchy;
+    always_assert_log(hierarchy.find(type) != hierarchy.end(),
                       "no entry in ClassHierarchy for type %s\n", SHOW(type));
     // recursively call for each child
-    for (const auto& child : m_hierarchy.at(type)) {
+    for (const auto& child : hierarchy.at(type)) {
       walk_class_scopes(child, walker);
     }
   }
@@ -401,14 +403,25 @@ class ClassScopes {
    * The ClassHierarchy lifetime is tied to that of the ClassScopes, as
    * such it should not exceed it.
    */
-  const ClassHierarchy& get_class_hierarchy() const { return m_hierarchy; }
+  const ClassHierarchy& get_class_hierarchy() const {
+    return m_class_hierarchy->hierarchy;
+  }
+
+  /**
+   * Return the index over the ClassHierarchy, with the same lifetime.
+   */
+  const ClassHierarchyIndex& get_class_hierarchy_index() const {
+    return m_class_hierarchy->index;
+  }
 
   /**
    * Return the InterfaceMap known when building the scopes.
    * The InterfaceMap lifetime is tied to that of the ClassScopes, as
    * such it should not exceed it.
    */
-  const InterfaceMap& get_interface_map() const { return m_interface_map; }
+  const InterfaceMap& get_interface_map() const {
+    return m_class_hierarchy->interfaces;
+  }
 
   /**
    * Return the SignatureMap known when building the scopes.
@@ -418,10 +431,18 @@ class ClassScopes {
   const SignatureMap& get_signature_map() const { return m_sig_map; }
 
  private:
-  void build_class_scopes(const DexType* type);
+  void build_class_scopes();
   void build_interface_scopes();
 };
 
+/**
+ * Return the ClassScopes of :scope, shared across all callers (typically the
+ * passes of a pipeline) for as long as the class structure of the scope, see
+ * get_cached_class_hierarchy, and the virtual methods of its classes, i.e.
+ * their identities, names and protos, stay the same.
+ */
+std::shared_ptr<const ClassScopes> get_cached_class_scopes(const Scope& scope);
+
 /**
  * Return the list of virtual methods for a given type.
  * If the type is java.lang.Object and it is not known (no DexClass for it)
@@ -65,7 +65,12 @@ inline CacheAligned<T>::operator T&() {
 
 class walk {
  private:
-  static constexpr bool all_methods(DexMethod*) { return true; }
+  // The filter of the walks that visit all methods. Being a type rather than
+  // a function, it is inlined like any other functor, so the filter check
+  // folds away.
+  struct AllMethods {
+    constexpr bool operator()(const DexMethod*) const { return true; }
+  };
 
  public:
   // This is a "static class". Disallow construction.
@@ -115,7 +120,7 @@ class walk {
   // Same as `code()` but with a filter that accepts all methods
   template <class Classes, typename WalkerFn>
   static void code(const Classes& classes, const WalkerFn& walker) {
-    walk::code(classes, all_methods, walker);
+    walk::code(classes, AllMethods(), walker);
   }
 
   // Call `walker` on every instruction in the code of every method defined in
@@ -134,7 +139,7 @@ class walk {
   // Same as `opcodes()` but with a filter that accepts all methods
   template <class Classes, typename WalkerFn>
   static void opcodes(const Classes& classes, const WalkerFn& walker) {
-    walk::opcodes(classes, all_methods, walker);
+    walk::opcodes(classes, AllMethods(), walker);
   }
 
   // Call `walker` on every annotation on the classes (and its fields, methods,
@@ -193,11 +198,11 @@ class walk {
             size_t N = std::tuple_size<Predicate>::value,
             typename Walker = void(DexMethod*,
                                    const std::vector<IRInstruction*>&),
-            typename FilterFn>
+            typename FilterFn = AllMethods>
   static void matching_opcodes(const Classes& classes,
                                const Predicate& predicate,
                                const Walker& walker,
-                               const FilterFn& filter = all_methods) {
+                               const FilterFn& filter = AllMethods()) {
     for (const auto& cls : classes) {
       iterate_matching(cls, predicate, walker, filter);
     }
@@ -212,12 +217,12 @@ class walk {
   template <class Classes,
             typename Predicate,
             typename WalkerFn,
-            typename FilterFn = decltype(all_methods),
+            typename FilterFn = AllMethods,
             size_t N = std::tuple_size<Predicate>::value>
   static void matching_opcodes_in_block(const Classes& classes,
                                         const Predicate& predicate,
                                         const WalkerFn& walker,
-                                        const FilterFn& filter = all_methods) {
+                                        const FilterFn& filter = AllMethods()) {
     for (const auto& cls : classes) {
       iterate_matching_block(cls, predicate, walker, filter);
     }
@@ -340,11 +345,11 @@ class walk {
             size_t N = std::tuple_size<Predicate>::value,
             typename Walker = void(DexMethod*,
                                    const std::vector<IRInstruction*>&),
-            typename FilterFn = decltype(all_methods)>
+            typename FilterFn = AllMethods>
   static void iterate_matching(DexClass* cls,
                                const Predicate& predicate,
                                const Walker& walker,
-                               const FilterFn& filter = all_methods) {
+                               const FilterFn& filter = AllMethods()) {
     iterate_code(
         cls, filter, [&predicate, &walker](DexMethod* m, IRCode& ir_code) {
           iterate_matching_worker(*m, ir_code, predicate, walker);
@@ -358,6 +363,19 @@ class walk {
                                             IRCode& ir_code,
                                             const Predicate& predicate,
                                             const WalkerFn& walker) {
+    if (!ir_code.cfg_built()) {
+      // The instructions of a block are contiguous in the method, so there can
+      // only be a match in a block if there is one in the method. Checking for
+      // that first is much cheaper than building the CFG.
+      std::vector<IRInstruction*> insns;
+      for (MethodItemEntry& mie : ir_list::InstructionIterable(ir_code)) {
+        insns.emplace_back(mie.insn);
+      }
+      if (!m::contains_match(insns, predicate)) {
+        return;
+      }
+    }
+
     std::vector<std::pair<cfg::Block*, std::vector<IRInstruction*>>>
         block_matches;
     ir_code.build_cfg(/* editable */ false);
@@ -381,11 +399,11 @@ class walk {
   template <typename Predicate,
             size_t N = std::tuple_size<Predicate>::value,
             typename WalkerFn,
-            typename FilterFn = decltype(all_methods)>
+            typename FilterFn = AllMethods>
   static void iterate_matching_block(DexClass* cls,
                                      const Predicate& predicate,
                                      const WalkerFn& walker,
-                                     const FilterFn& filter = all_methods) {
+                                     const FilterFn& filter = AllMethods()) {
     iterate_code(
         cls, filter, [&predicate, &walker](DexMethod* m, IRCode& ir_code) {
           iterate_matching_block_worker(*m, ir_code, predicate, walker);
@@ -405,6 +423,9 @@ class walk {
    * sequential counterparts.
    * The unit of parallelization is a DexClass. The reason is that we don't want
    * to create too many tasks on the WorkQueue, paying the overhead for each.
+   * For the same reason, when walking many more classes than there are
+   * threads, consecutive classes are batched into tasks of similar estimated
+   * cost (see `run_all_classes`).
    */
   class parallel {
    public:
@@ -422,10 +443,9 @@ class walk {
         Classes const& classes,
         const WalkerFn& walker,
         size_t num_threads = redex_parallel::default_num_threads()) {
-      auto wq = workqueue_foreach<DexClass*>( // over-parallelized maybe
-          [&walker](DexClass* cls) { walker(cls); },
+      run_all_classes(
+          classes, [&walker](size_t, DexClass* cls) { walker(cls); },
           num_threads);
-      run_all(wq, classes);
     }
 
     // Call `walker` on all methods in `classes` in parallel.
@@ -435,10 +455,12 @@ class walk {
         const Classes& classes,
         const WalkerFn& walker,
         size_t num_threads = redex_parallel::default_num_threads()) {
-      auto wq = workqueue_foreach<DexClass*>(
-          [&walker](DexClass* cls) { walk::iterate_methods(cls, walker); },
+      run_all_classes(
+          classes,
+          [&walker](size_t, DexClass* cls) {
+            walk::iterate_methods(cls, walker);
+          },
           num_threads);
-      run_all(wq, classes);
     }
 
     // Call `walker` on all methods in `classes` in parallel. Then combine the
@@ -459,26 +481,41 @@ class walk {
         const WalkerFn& walker,
         size_t num_threads = redex_parallel::default_num_threads(),
         Accumulator init = Accumulator()) {
+      return reduce<Accumulator>(classes, walker, Reduce(), std::move(init),
+                                 num_threads);
+    }
+
+    // Map-reduce over all methods in `classes` in parallel. Each thread
+    // updates its own Accumulator in place, with no locking and no per-method
+    // allocation; the accumulators start out as copies of `init` and are
+    // merged into `init` at the end, in the order of the threads. Unlike the
+    // Reduce class of `methods<Accumulator>`, `merge` may be a lambda.
+    //
+    // WalkerFn should accept `(DexMethod*, Accumulator*)`.
+    // MergeFn should accept `(const Accumulator&, Accumulator*)`.
+    template <class Accumulator,
+              class Classes,
+              typename WalkerFn,
+              typename MergeFn>
+    static Accumulator reduce(
+        const Classes& classes,
+        const WalkerFn& walker,
+        MergeFn merge,
+        Accumulator init = Accumulator(),
+        size_t num_threads = redex_parallel::default_num_threads()) {
       std::vector<CacheAligned<Accumulator>> acc_vec(num_threads, init);
 
-      auto wq = workqueue_foreach<DexClass*>(
-          [&](sparta::SpartaWorkerState<DexClass*>* state, DexClass* cls) {
-            Accumulator& acc = acc_vec[state->worker_id()];
-            for (auto dmethod : cls->get_dmethods()) {
-              TraceContext context(dmethod->get_deobfuscated_name());
-              walker(dmethod, &acc);
-            }
-            for (auto vmethod : cls->get_vmethods()) {
-              TraceContext context(vmethod->get_deobfuscated_name());
-              walker(vmethod, &acc);
-            }
+      run_all_classes(
+          classes,
+          [&](size_t worker_id, DexClass* cls) {
+            Accumulator& acc = acc_vec[worker_id];
+            walk::iterate_methods(
+                cls, [&](DexMethod* method) { walker(method, &acc); });
           },
           num_threads);
-      run_all(wq, classes);
 
-      auto reduce = Reduce();
       for (Accumulator& acc : acc_vec) {
-        reduce(acc, &init);
+        merge(acc, &init);
       }
       return init;
     }
@@ -519,10 +556,12 @@ class walk {
         const Classes& classes,
         const WalkerFn& walker,
         size_t num_threads = redex_parallel::default_num_threads()) {
-      auto wq = workqueue_foreach<DexClass*>(
-          [&walker](DexClass* cls) { walk::iterate_fields(cls, walker); },
+      run_all_classes(
+          classes,
+          [&walker](size_t, DexClass* cls) {
+            walk::iterate_fields(cls, walker);
+          },
           num_threads);
-      run_all(wq, classes);
     }
 
     // Call `walker` on all code (of methods approved by `filter`) in `classes`
@@ -535,12 +574,12 @@ class walk {
         const FilterFn& filter,
         const WalkerFn& walker,
         size_t num_threads = redex_parallel::default_num_threads()) {
-      auto wq = workqueue_foreach<DexClass*>(
-          [&filter, &walker](DexClass* cls) {
+      run_all_classes(
+          classes,
+          [&filter, &walker](size_t, DexClass* cls) {
             walk::iterate_code(cls, filter, walker);
           },
           num_threads);
-      run_all(wq, classes);
     }
 
     // Same as `code()` but with a filter function that accepts all methods
@@ -549,7 +588,7 @@ class walk {
         const Classes& classes,
         const WalkerFn& walker,
         size_t num_threads = redex_parallel::default_num_threads()) {
-      walk::parallel::code(classes, all_methods, walker, num_threads);
+      walk::parallel::code(classes, AllMethods(), walker, num_threads);
     }
 
     // Call `walker` on all opcodes (of methods approved by `filter`) in
@@ -562,12 +601,12 @@ class walk {
         const FilterFn& filter,
         const WalkerFn& walker,
         size_t num_threads = redex_parallel::default_num_threads()) {
-      auto wq = workqueue_foreach<DexClass*>(
-          [&filter, &walker](DexClass* cls) {
+      run_all_classes(
+          classes,
+          [&filter, &walker](size_t, DexClass* cls) {
             walk::iterate_opcodes(cls, filter, walker);
           },
           num_threads);
-      run_all(wq, classes);
     }
 
     // Same as `opcodes()` but with a filter function that accepts all methods
@@ -576,7 +615,7 @@ class walk {
         const Classes& classes,
         const WalkerFn& walker,
         size_t num_threads = redex_parallel::default_num_threads()) {
-      walk::parallel::opcodes(classes, all_methods, walker, num_threads);
+      walk::parallel::opcodes(classes, AllMethods(), walker, num_threads);
     }
 
     // Call `walker` on all annotations in `classes` in parallel.
@@ -586,10 +625,12 @@ class walk {
         const Classes& classes,
         const WalkerFn& walker,
         size_t num_threads = redex_parallel::default_num_threads()) {
-      auto wq = workqueue_foreach<DexClass*>(
-          [&walker](DexClass* cls) { walk::iterate_annotations(cls, walker); },
+      run_all_classes(
+          classes,
+          [&walker](size_t, DexClass* cls) {
+            walk::iterate_annotations(cls, walker);
+          },
           num_threads);
-      run_all(wq, classes);
     }
 
     // Call `walker` on all matching opcodes (according to `predicate`) in
@@ -605,12 +646,12 @@ class walk {
         const Predicate& predicate,
         const Walker& walker,
         size_t num_threads = redex_parallel::default_num_threads()) {
-      auto wq = workqueue_foreach<DexClass*>(
-          [&predicate, &walker](DexClass* cls) {
+      run_all_classes(
+          classes,
+          [&predicate, &walker](size_t, DexClass* cls) {
             walk::iterate_matching(cls, predicate, walker);
           },
           num_threads);
-      run_all(wq, classes);
     }
 
     // Call `walker` on all matching opcodes (according to `predicate`) in
@@ -628,12 +669,12 @@ class walk {
         const Predicate& predicate,
         const WalkerFn& walker,
         size_t num_threads = redex_parallel::default_num_threads()) {
-      auto wq = workqueue_foreach<DexClass*>(
-          [&predicate, &walker](DexClass* cls) {
+      run_all_classes(
+          classes,
+          [&predicate, &walker](size_t, DexClass* cls) {
             walk::iterate_matching_block(cls, predicate, walker);
           },
           num_threads);
-      run_all(wq, classes);
     }
 
     // Call `walker` on all given virtual scopes in parallel.
@@ -648,10 +689,104 @@ class walk {
     }
 
    private:
-    template <class WQ, class Classes>
-    static void run_all(WQ& wq, const Classes& classes) {
-      for (const auto& cls : classes) {
-        wq.add_item(cls);
+    // When there are many more classes than threads, consecutive classes are
+    // grouped into batches of roughly equal estimated cost, aiming for this
+    // many batches per thread. That amortizes the per-task scheduling
+    // overhead for cheap walkers while leaving enough tasks to even out
+    // estimation errors.
+    static constexpr size_t kBatchesPerThread = 16;
+
+    // A cheap estimate of the cost of walking a class: one unit per class and
+    // per method, plus the size of the code, if any. It must not balloon code
+    // whose ballooning is deferred, or it would do so serially on this thread.
+    static size_t estimate_cost(const DexClass* cls) {
+      size_t cost = 1;
+      auto add_methods = [&cost](const std::vector<DexMethod*>& methods) {
+        for (const auto* method : methods) {
+          cost += 1 + method->estimate_code_size();
+        }
+      };
+      add_methods(cls->get_dmethods());
+      add_methods(cls->get_vmethods());
+      return cost;
+    }
+
+    // Call `fn(worker_id, cls)` on all classes in `classes` in parallel.
+    //
+    // Tasks are queued longest-first by estimated cost, so that a few huge
+    // classes (think generated switch dispatchers) start right away instead
+    // of becoming the tail of the walk while all other threads idle.
+    template <class Classes, typename ClassFn>
+    static void run_all_classes(const Classes& classes,
+                                const ClassFn& fn,
+                                size_t num_threads) {
+      std::vector<DexClass*> all_classes(classes.begin(), classes.end());
+      std::vector<size_t> costs;
+      costs.reserve(all_classes.size());
+      size_t total_cost = 0;
+      for (const auto* cls : all_classes) {
+        costs.push_back(estimate_cost(cls));
+        total_cost += costs.back();
+      }
+
+      // Each batch is a half-open range of indices into `all_classes`, with
+      // its cost. Classes as costly as a whole batch get a batch of their own.
+      struct Batch {
+        size_t begin;
+        size_t end;
+        size_t cost;
+      };
+      std::vector<Batch> batches;
+      size_t num_batches = num_threads * kBatchesPerThread;
+      if (all_classes.size() <= num_batches) {
+        for (size_t i = 0; i < all_classes.size(); ++i) {
+          batches.push_back(Batch{i, i + 1, costs[i]});
+        }
+      } else {
+        size_t batch_cost = std::max<size_t>(1, total_cost / num_batches);
+        size_t begin = 0;
+        size_t cost = 0;
+        for (size_t i = 0; i < all_classes.size(); ++i) {
+          if (costs[i] >= batch_cost && begin < i) {
+            batches.push_back(Batch{begin, i, cost});
+            begin = i;
+            cost = 0;
+          }
+          cost += costs[i];
+          if (cost >= batch_cost) {
+            batches.push_back(Batch{begin, i + 1, cost});
+            begin = i + 1;
+            cost = 0;
+          }
+        }
+        if (begin < all_classes.size()) {
+          batches.push_back(Batch{begin, all_classes.size(), cost});
+        }
+      }
+      std::stable_sort(batches.begin(),
+                       batches.end(),
+                       [](const Batch& a, const Batch& b) {
+                         return a.cost > b.cost;
+                       });
+
+      auto wq = workqueue_foreach<const Batch*>(
+          [&](sparta::SpartaWorkerState<const Batch*>* state,
+              const Batch* batch) {
+            for (size_t i = batch->begin; i < batch->end; ++i) {
+              fn(state->worker_id(), all_classes[i]);
+            }
+          },
+          num_threads);
+      for (const auto& batch : batches) {
+        wq.add_item(&batch);
+      }
+      wq.run_all();
+    }
+
+    template <class WQ, class Items>
+    static void run_all(WQ& wq, const Items& items) {
+      for (const auto& item : items) {
+        wq.add_item(item);
       };
       wq.run_all();
     }
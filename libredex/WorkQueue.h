@@ -7,7 +7,10 @@
 
 #pragma once
 
+#include <algorithm>
 #include <exception>
+#include <functional>
+#include <vector>
 
 #include "SpartaWorkQueue.h"
 
@@ -60,13 +63,15 @@ sparta::SpartaWorkQueue<Input,
 workqueue_foreach(
     const Fn& fn,
     unsigned int num_threads = sparta::parallel::default_num_threads(),
-    bool push_tasks_while_running = false) {
+    bool push_tasks_while_running = false,
+    bool work_stealing = false) {
   return sparta::SpartaWorkQueue<
       Input,
       redex_workqueue_impl::NoStateWorkQueueHelper<Input, Fn>>(
       redex_workqueue_impl::NoStateWorkQueueHelper<Input, Fn>{fn},
       num_threads,
-      push_tasks_while_running);
+      push_tasks_while_running,
+      work_stealing);
 }
 template <class Input,
           typename Fn,
@@ -77,11 +82,35 @@ sparta::SpartaWorkQueue<
 workqueue_foreach(
     const Fn& fn,
     unsigned int num_threads = sparta::parallel::default_num_threads(),
-    bool push_tasks_while_running = false) {
+    bool push_tasks_while_running = false,
+    bool work_stealing = false) {
   return sparta::SpartaWorkQueue<
       Input,
       redex_workqueue_impl::WithStateWorkQueueHelper<Input, Fn>>(
       redex_workqueue_impl::WithStateWorkQueueHelper<Input, Fn>{fn},
       num_threads,
-      push_tasks_while_running);
+      push_tasks_while_running,
+      work_stealing);
 }
+
+namespace redex_parallel {
+
+/*
+ * Runs independent tasks concurrently, one thread per task up to the default
+ * number of threads, and returns once all of them are done.
+ */
+inline void run_tasks(const std::vector<std::function<void()>>& tasks) {
+  if (tasks.empty()) {
+    return;
+  }
+  unsigned int num_threads =
+      std::min<size_t>(tasks.size(), default_num_threads());
+  auto wq = workqueue_foreach<size_t>([&](size_t i) { tasks[i](); },
+                                      num_threads);
+  for (size_t i = 0; i < tasks.size(); ++i) {
+    wq.add_item(i);
+  }
+  wq.run_all();
+}
+
+} // namespace redex_parallel
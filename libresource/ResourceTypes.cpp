@@ -429,6 +429,14 @@ void rewriteSize(Vector<char>& cVec, size_t initSize)
     memcpy((char *)&(cVec[sizeIndex]), (char *)(&newSize), 4);
 }
 
+// Opaque serialization of the given bytes, in a single copy.
+static void appendBytes(Vector<char>& cVec, const void* data, size_t size)
+{
+    if (size > 0) {
+        cVec.appendArray(reinterpret_cast<const char*>(data), size);
+    }
+}
+
 // --------------------------------------------------------------------
 // --------------------------------------------------------------------
 // --------------------------------------------------------------------
@@ -538,10 +546,7 @@ void ResStringPool::serialize(Vector<char>& cVec)
   // Perform opaque serialization, unless new strings have been added.
   // See method serializeWithAdditionalStrings for caveats on adding new strings
   if (mAppendedStrings.size() == 0) {
-    size_t dataSize = mHeader->header.size;
-    for (size_t i = 0; i < dataSize; ++i) {
-        cVec.push_back(*((unsigned char*)(mHeader) + i));
-    }
+    appendBytes(cVec, mHeader, mHeader->header.size);
   } else {
     serializeWithAdditionalStrings(cVec);
   }
@@ -3094,16 +3099,13 @@ struct ResTable::Type
     Vector<const ResTable_type*>    configs;
     SortedVector<int>               deletedEntries;
 
-    void serialize(Vector<char>& cVec)
+    void serializeTypeSpec(Vector<char>& cVec)
     {
         size_t initSize = cVec.size();
 
-        // Serialize ResourceTableTypeSpec
-        // First, we perform opaque serialization of the header
+        // Opaque serialization of the header
         uint32_t tHeaderSize = typeSpec->header.headerSize;
-        for (size_t i = 0; i < tHeaderSize; ++i) {
-            cVec.push_back(*((unsigned char*)(typeSpec) + i));
-        }
+        appendBytes(cVec, typeSpec, tHeaderSize);
 
         // Fixup count of rows in header
         uint32_t newRowCount = entryCount - deletedEntries.size();
@@ -3130,17 +3132,62 @@ struct ResTable::Type
         }
 
         rewriteSize(cVec, initSize);
+    }
+
+    // Whether serializing the typeSpec would reproduce it as it is, i.e. no
+    // entries were deleted and its flags immediately follow the header.
+    bool isTypeSpecUnchanged() const
+    {
+        return deletedEntries.isEmpty()
+            && dtohl(typeSpec->entryCount) == entryCount
+            && dtohl(typeSpec->header.size)
+                == dtohs(typeSpec->header.headerSize) + 4 * entryCount;
+    }
+
+    // As above, for a ResTable_type: its entries must also immediately follow
+    // the offsets, with the first entry at offset 0.
+    bool isTypeUnchanged(const ResTable_type* type) const
+    {
+        const uint32_t headSize = dtohs(type->header.headerSize);
+        if (!deletedEntries.isEmpty()
+                || dtohl(type->entryCount) != entryCount
+                || dtohl(type->entriesStart) != headSize + 4 * entryCount) {
+            return false;
+        }
+        const uint32_t* const offsets = reinterpret_cast<const uint32_t*>(
+                reinterpret_cast<const uint8_t*>(type) + headSize);
+        for (size_t i = 0; i < entryCount; ++i) {
+            uint32_t offset = dtohl(offsets[i]);
+            if (offset != ResTable_type::NO_ENTRY) {
+                return offset == 0;
+            }
+        }
+        // An empty column is dropped.
+        return false;
+    }
+
+    void serialize(Vector<char>& cVec)
+    {
+        // Chunks that serialization wouldn't change are copied whole.
+        if (isTypeSpecUnchanged()) {
+            appendBytes(cVec, typeSpec, dtohl(typeSpec->header.size));
+        } else {
+            serializeTypeSpec(cVec);
+        }
 
         // Serialize each ResourceTableType
+        uint32_t newRowCount = entryCount - deletedEntries.size();
         for (size_t k = 0; k < configs.size(); k++) {
-            initSize = cVec.size();
+            size_t initSize = cVec.size();
             const ResTable_type* type = configs[k];
+            if (isTypeUnchanged(type)) {
+                appendBytes(cVec, type, dtohl(type->header.size));
+                continue;
+            }
 
             // Opaque serialization of header
             uint32_t headSize = type->header.headerSize;
-            for (size_t i = 0; i < headSize; ++i) {
-                cVec.push_back(*((unsigned char*)(type) + i));
-            }
+            appendBytes(cVec, type, headSize);
 
             // Fixup entry count and offset to start of entries
             size_t skippedHeaderFields =
@@ -3216,9 +3263,7 @@ struct ResTable::Type
                                 reinterpret_cast<const uint8_t*>(type) + offset + type->entriesStart);
 
                         // Opaque serialization of entry
-                        for (size_t j = 0; j < entrySize; ++j) {
-                            entryData.push_back(*((unsigned char*)(entry) + j));
-                        }
+                        appendBytes(entryData, entry, entrySize);
 
                         // Fix offset for serialization
                         offset -= sumOfDeletedSizes;
@@ -3235,15 +3280,11 @@ struct ResTable::Type
             }
 
             // Copy serialized data for the entries we kept
-            for (size_t i = 0; i < entryData.size(); ++i) {
-                cVec.push_back(entryData[i]);
-            }
+            cVec.appendVector(entryData);
 
             if (entryData.size() == 0) {
               // We wrote an entirely dead column- let's erase it.
-              for (size_t d = cVec.size() - 1; d >= initSize; --d) {
-                  cVec.removeAt(d);
-              }
+              cVec.removeItemsAt(initSize, cVec.size() - initSize);
             } else {
                 rewriteSize(cVec, initSize);
             }
@@ -3808,6 +3849,7 @@ status_t ResTable::add(Asset* asset, Asset* idmapAsset, const int32_t cookie, bo
 
 status_t ResTable::add(ResTable* src)
 {
+    clearEntryIndex();
     mError = src->mError;
 
     for (size_t i=0; i<src->mHeaders.size(); i++) {
@@ -3862,6 +3904,7 @@ status_t ResTable::addInternal(const void* data, size_t dataSize, const void* id
     if (!data) {
         return NO_ERROR;
     }
+    clearEntryIndex();
 
     if (dataSize < sizeof(ResTable_header)) {
         ALOGE("Invalid data. Size(%d) is smaller than a ResTable_header(%d).",
@@ -4008,9 +4051,7 @@ status_t ResTable::serialize(Vector<char>& cVec, size_t resTableIndex)
     size_t initSize = cVec.size();
 
     // 1. Write header
-    for (size_t i = 0; i < tableHeader->header.headerSize; ++i) {
-        cVec.push_back(*((unsigned char*)(tableHeader) + i));
-    }
+    appendBytes(cVec, tableHeader, tableHeader->header.headerSize);
 
     // 2. Write global strings (ResStringPool)
     header->values.serialize(cVec);
@@ -4029,6 +4070,7 @@ status_t ResTable::serialize(Vector<char>& cVec, size_t resTableIndex)
 
 void ResTable::uninit()
 {
+    clearEntryIndex();
     mError = NO_INIT;
     size_t N = mPackageGroups.size();
     for (size_t i=0; i<N; i++) {
@@ -7053,8 +7095,8 @@ void ResTable::deleteResource(uint32_t resID)
 
 static uint32_t getRemappedEntry(
     uint32_t reference,
-    SortedVector<uint32_t> originalIds,
-    Vector<uint32_t> newIds)
+    const SortedVector<uint32_t>& originalIds,
+    const Vector<uint32_t>& newIds)
 {
     ssize_t index = originalIds.indexOf(reference);
     if (index < 0) {
@@ -7070,30 +7112,13 @@ static uint32_t getRemappedEntry(
 // align based on index.
 void ResTable::remapReferenceValuesForResource(
     uint32_t resID,
-    SortedVector<uint32_t> originalIds,
-    Vector<uint32_t> newIds)
+    const SortedVector<uint32_t>& originalIds,
+    const Vector<uint32_t>& newIds)
 {
-    resource_name resName;
-    if (!this->getResourceName(resID, /* allowUtf8 */ true, &resName)) {
-        return;
-    }
-
-    const ssize_t pgIndex = getResourcePackageIndex(resID);
-    const int typeIndex = Res_GETTYPE(resID);
-    const int entryIndex = Res_GETENTRY(resID);
-    const PackageGroup* pg = mPackageGroups[pgIndex];
-    const TypeList& typeList = pg->types[typeIndex];
-    if (typeList.isEmpty()) {
-        return;
-    }
-    const Type* typeConfigs = typeList[0];
-    const size_t NTC = typeConfigs->configs.size();
-    for (size_t configIndex = 0; configIndex < NTC; configIndex++) {
-        const ResTable_type* type = typeConfigs->configs[configIndex];
-        const ResTable_entry* ent;
-        if (!tryGetConfigEntry(entryIndex, type, &ent)) {
-            continue;
-        }
+    std::vector<ConfigEntry> scratch;
+    for (const auto& configEntry : getConfigEntries(resID, &scratch)) {
+        const ResTable_type* type = configEntry.type;
+        const ResTable_entry* ent = configEntry.entry;
 
         uintptr_t esize = dtohs(ent->size);
         uint32_t typeSize = dtohl(type->header.size);
@@ -7201,6 +7226,62 @@ bool ResTable::tryGetConfigEntry(
     return true;
 }
 
+const std::vector<ResTable::ConfigEntry>& ResTable::getConfigEntries(
+    uint32_t resID,
+    std::vector<ConfigEntry>* scratch) const
+{
+    scratch->clear();
+    if (mHasEntryIndex) {
+        auto it = mEntryIndex.find(resID);
+        return it == mEntryIndex.end() ? *scratch : it->second;
+    }
+
+    resource_name resName;
+    if (!this->getResourceName(resID, /* allowUtf8 */ true, &resName)) {
+        return *scratch;
+    }
+
+    const ssize_t pgIndex = getResourcePackageIndex(resID);
+    const int typeIndex = Res_GETTYPE(resID);
+    const int entryIndex = Res_GETENTRY(resID);
+    const PackageGroup* pg = mPackageGroups[pgIndex];
+    const TypeList& typeList = pg->types[typeIndex];
+    if (typeList.isEmpty()) {
+        return *scratch;
+    }
+    const Type* typeConfigs = typeList[0];
+    const size_t NTC = typeConfigs->configs.size();
+    for (size_t configIndex = 0; configIndex < NTC; configIndex++) {
+        const ResTable_type* type = typeConfigs->configs[configIndex];
+        const ResTable_entry* ent;
+        if (tryGetConfigEntry(entryIndex, type, &ent)) {
+            scratch->push_back({type, ent});
+        }
+    }
+    return *scratch;
+}
+
+void ResTable::buildEntryIndex()
+{
+    clearEntryIndex();
+    // Only resources with a name are indexed, as without the index they are
+    // the only ones the per-resource methods look at.
+    SortedVector<uint32_t> resIds;
+    getResourceIds(&resIds);
+    std::vector<ConfigEntry> scratch;
+    mEntryIndex.reserve(resIds.size());
+    for (size_t i = 0; i < resIds.size(); i++) {
+        mEntryIndex.emplace(resIds[i], getConfigEntries(resIds[i], &scratch));
+    }
+    mHasEntryIndex = true;
+}
+
+void ResTable::clearEntryIndex()
+{
+    mHasEntryIndex = false;
+    mEntryIndex.clear();
+}
+
 // Helper method for defineNewType. This copies data from source entries into
 // the serialized format for a ResTable_type.
 void ResTable::serializeSingleResType(
@@ -7388,34 +7469,18 @@ void ResTable::defineNewType(
   type_list.push_back(type);
   const TypeList x = type_list;
   pg->types.set(type_id - 1, x);
+  clearEntryIndex();
 }
 
 void ResTable::inlineReferenceValuesForResource(
     uint32_t resID,
-    SortedVector<uint32_t> inlineable_ids,
-    Vector<Res_value> inline_values)
+    const SortedVector<uint32_t>& inlineable_ids,
+    const Vector<Res_value>& inline_values)
 {
-    resource_name resName;
-    if (!this->getResourceName(resID, true, &resName)) {
-        return;
-    }
-
-    const ssize_t pgIndex = getResourcePackageIndex(resID);
-    const int typeIndex = Res_GETTYPE(resID);
-    const int entryIndex = Res_GETENTRY(resID);
-    const PackageGroup* pg = mPackageGroups[pgIndex];
-    const TypeList& typeList = pg->types[typeIndex];
-    if (typeList.isEmpty()) {
-        return;
-    }
-    const Type* typeConfigs = typeList[0];
-    const size_t NTC = typeConfigs->configs.size();
-    for (size_t configIndex = 0; configIndex < NTC; configIndex++) {
-        const ResTable_type* type = typeConfigs->configs[configIndex];
-        const ResTable_entry* ent;
-        if (!tryGetConfigEntry(entryIndex, type, &ent)) {
-            continue;
-        }
+    std::vector<ConfigEntry> scratch;
+    for (const auto& configEntry : getConfigEntries(resID, &scratch)) {
+        const ResTable_type* type = configEntry.type;
+        const ResTable_entry* ent = configEntry.entry;
 
         uintptr_t esize = dtohs(ent->size);
         uint32_t typeSize = dtohl(type->header.size);
@@ -7545,39 +7610,17 @@ void ResTable::getAllValuesForResource(
     Vector<Res_value>& values,
     const ResTable_config* allowed_config) const
 {
-    resource_name resName;
-    if (!this->getResourceName(resID, /* allowUtf8 */ true, &resName)) {
-        return;
-    }
-
-    const ssize_t pgIndex = getResourcePackageIndex(resID);
-    const int typeIndex = Res_GETTYPE(resID);
-    const int entryIndex = Res_GETENTRY(resID);
-
-    const PackageGroup* pg = mPackageGroups[pgIndex];
-
-    const TypeList& typeList = pg->types[typeIndex];
-    if (typeList.isEmpty()) {
-        return;
-    }
-    const Type* typeConfigs = typeList[0];
-    const size_t NTC = typeConfigs->configs.size();
-
-    for (size_t configIndex = 0; configIndex < NTC; configIndex++) {
-        const ResTable_type* type = typeConfigs->configs[configIndex];
+    std::vector<ConfigEntry> scratch;
+    for (const auto& configEntry : getConfigEntries(resID, &scratch)) {
+        const ResTable_type* type = configEntry.type;
 
         if (allowed_config != nullptr &&
             type->config.compare(*allowed_config) != 0) {
           continue;
         }
 
-        const ResTable_entry* ent;
-        if (!tryGetConfigEntry(entryIndex, type, &ent)) {
-            continue;
-        }
-
         uint32_t typeSize = dtohl(type->header.size);
-        collectValuesInConfig(values, ent, typeSize);
+        collectValuesInConfig(values, configEntry.entry, typeSize);
     }
 }
 
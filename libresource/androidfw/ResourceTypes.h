@@ -31,6 +31,8 @@
 
 #include <stdint.h>
 #include <sys/types.h>
+#include <unordered_map>
+#include <vector>
 
 #ifdef _MSC_VER
 #include <mutex>
@@ -1891,16 +1893,16 @@ public:
     // align based on index.
     void remapReferenceValuesForResource(
         uint32_t resID,
-        SortedVector<uint32_t> originalIds,
-        Vector<uint32_t> newIds);
+        const SortedVector<uint32_t>& originalIds,
+        const Vector<uint32_t>& newIds);
 
     // For the given resource ID, looks across all configurations and inlines
     // all reference Res_value entries based on the given keys -> inline_values
     // mapping. The entries in the inputs are expected to align based on index.
     void inlineReferenceValuesForResource(
         uint32_t resID,
-        SortedVector<uint32_t> inlineable_ids,
-        Vector<Res_value> inline_values);
+        const SortedVector<uint32_t>& inlineable_ids,
+        const Vector<Res_value>& inline_values);
 
     // For the given resource ID, looks across all configurations and returns all
     // the corresponding Res_value entries. This is much more reliable than
@@ -1937,6 +1939,13 @@ public:
 
     ssize_t getResourcePackageIndex(uint32_t resID) const;
 
+    // Indexes the entries of every resource in every configuration, so that
+    // the per-resource methods above (remapping, inlining and collecting
+    // values) find them with a single lookup, instead of checking every
+    // configuration of the resource's type. Worth it for passes that visit
+    // most resources. Adding packages or types drops the index.
+    void buildEntryIndex();
+
 private:
     struct Header;
     struct Type;
@@ -1958,6 +1967,19 @@ private:
         const ResTable_type* type,
         const ResTable_entry** ent) const;
 
+    struct ConfigEntry {
+        const ResTable_type* type;
+        const ResTable_entry* entry;
+    };
+
+    // The entries of the given resource in each configuration that has one,
+    // from the entry index if it was built, otherwise collected into scratch.
+    const std::vector<ConfigEntry>& getConfigEntries(
+        uint32_t resID,
+        std::vector<ConfigEntry>* scratch) const;
+
+    void clearEntryIndex();
+
     status_t addInternal(const void* data, size_t size, const void* idmapData, size_t idmapDataSize,
             const int32_t cookie, bool copyData);
 
@@ -2002,6 +2024,9 @@ private:
     uint8_t                     mPackageMap[256];
 
     uint8_t                     mNextPackageId;
+
+    bool                        mHasEntryIndex = false;
+    std::unordered_map<uint32_t, std::vector<ConfigEntry>> mEntryIndex;
 };
 
 float complex_value(uint32_t complex);
@@ -24,7 +24,8 @@ namespace mog = method_override_graph;
 namespace {
 
 size_t mark_classes_final(const Scope& scope) {
-  ClassHierarchy ch = build_type_hierarchy(scope);
+  auto cached_hierarchy = get_cached_class_hierarchy(scope);
+  const auto& ch = cached_hierarchy->hierarchy;
   size_t n_classes_finalized = 0;
   for (auto const& cls : scope) {
     if (!can_rename(cls) || is_abstract(cls) || is_final(cls)) {
@@ -85,8 +86,17 @@ std::vector<DexMethod*> direct_methods(const std::vector<DexClass*>& scope) {
   return ret;
 }
 
+using CallSites = std::unordered_map<DexMethod*, std::vector<IRInstruction*>>;
+
+/*
+ * Find the methods that can be made private. The invokes that resolve to
+ * each of them are collected into :call_sites during the same scan, so that
+ * fixing them up later doesn't need another walk over the scope.
+ */
 std::unordered_set<DexMethod*> find_private_methods(
-    const std::vector<DexClass*>& scope, const mog::Graph& override_graph) {
+    const std::vector<DexClass*>& scope,
+    const mog::Graph& override_graph,
+    CallSites* call_sites) {
   auto candidates = mog::get_non_true_virtuals(override_graph, scope);
   auto dmethods = direct_methods(scope);
   for (auto* dmethod : dmethods) {
@@ -104,6 +114,7 @@ std::unordered_set<DexMethod*> find_private_methods(
   }
 
   ConcurrentSet<DexMethod*> externally_referenced;
+  ConcurrentMap<DexMethod*, std::vector<IRInstruction*>> candidate_call_sites;
   walk::parallel::opcodes(
       scope,
       [](DexMethod*) { return true; },
@@ -113,35 +124,47 @@ std::unordered_set<DexMethod*> find_private_methods(
         }
         auto callee =
             resolve_method(inst->get_method(), opcode_to_search(inst), caller);
-        if (callee == nullptr || callee->get_class() == caller->get_class()) {
+        if (callee == nullptr) {
+          return;
+        }
+        if (callee->get_class() != caller->get_class()) {
+          externally_referenced.emplace(callee);
           return;
         }
-        externally_referenced.emplace(callee);
+        // should be safe to read `candidates` here because there are no
+        // writers
+        if (candidates.count(callee)) {
+          candidate_call_sites.update(
+              callee,
+              [inst](DexMethod*, std::vector<IRInstruction*>& insns, bool) {
+                insns.push_back(inst);
+              });
+        }
       });
 
   for (auto* m : externally_referenced) {
     candidates.erase(m);
   }
+  for (auto& pair : candidate_call_sites) {
+    if (candidates.count(pair.first)) {
+      call_sites->emplace(pair.first, std::move(pair.second));
+    }
+  }
   return candidates;
 }
 
-void fix_call_sites_private(const std::vector<DexClass*>& scope,
-                            const std::unordered_set<DexMethod*>& privates) {
-  walk::parallel::code(scope, [&](DexMethod* caller, IRCode& code) {
-    for (const MethodItemEntry& mie : InstructionIterable(code)) {
-      IRInstruction* insn = mie.insn;
-      if (!insn->has_method()) continue;
-      auto callee =
-          resolve_method(insn->get_method(), opcode_to_search(insn), caller);
-      // should be safe to read `privates` here because there are no writers
-      if (callee != nullptr && privates.count(callee)) {
-        insn->set_method(callee);
-        if (!is_static(callee)) {
-          insn->set_opcode(OPCODE_INVOKE_DIRECT);
-        }
+void fix_call_sites_private(const std::unordered_set<DexMethod*>& privates,
+                            const CallSites& call_sites) {
+  for (const auto& pair : call_sites) {
+    auto callee = pair.first;
+    always_assert(privates.count(callee));
+    for (auto insn : pair.second) {
+      insn->set_method(callee);
+      if (!is_static(callee)) {
+        insn->set_opcode(OPCODE_INVOKE_DIRECT);
       }
     }
-  });
+  }
 }
 
 void mark_methods_private(const std::unordered_set<DexMethod*>& privates) {
@@ -169,7 +192,9 @@ void AccessMarkingPass::run_pass(DexStoresVector& stores,
                                  ConfigFiles& /* conf */,
                                  PassManager& pm) {
   auto scope = build_class_scope(stores);
-  auto override_graph = mog::build_graph(scope);
+  // Shared with later passes, e.g. devirtualization, as long as no virtual
+  // methods change in between.
+  auto override_graph = mog::get_cached_graph(scope);
   if (m_finalize_classes) {
     auto n_classes_final = mark_classes_final(scope);
     pm.incr_metric("finalized_classes", n_classes_final);
@@ -186,8 +211,9 @@ void AccessMarkingPass::run_pass(DexStoresVector& stores,
     TRACE(ACCESS, 1, "Finalized %lu fields", n_fields_final);
   }
   if (m_privatize_methods) {
-    auto privates = find_private_methods(scope, *override_graph);
-    fix_call_sites_private(scope, privates);
+    CallSites call_sites;
+    auto privates = find_private_methods(scope, *override_graph, &call_sites);
+    fix_call_sites_private(privates, call_sites);
     mark_methods_private(privates);
     pm.incr_metric("privatized_methods", privates.size());
     TRACE(ACCESS, 1, "Privatized %lu methods", privates.size());
@@ -15,6 +15,7 @@
 #include "DexUtil.h"
 #include "Resolver.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 constexpr const char* METRIC_ANNO_KILLED = "num_anno_killed";
 constexpr const char* METRIC_ANNO_TOTAL = "num_anno_total";
@@ -29,6 +30,62 @@ constexpr const char* METRIC_FIELD_ASETS_CLEARED = "num_field_cleared";
 constexpr const char* METRIC_FIELD_ASETS_TOTAL = "num_field_total";
 constexpr const char* METRIC_SIGNATURES_KILLED = "num_signatures_killed";
 
+namespace {
+
+// Runs `fn(cls, &acc)` on all the classes of `scope` in parallel, where `acc`
+// is the accumulator of the worker running it, and returns the accumulators.
+template <typename Accumulator, typename Fn>
+std::vector<Accumulator> run_on_classes(const Scope& scope, const Fn& fn) {
+  auto num_threads = redex_parallel::default_num_threads();
+  std::vector<Accumulator> accs(num_threads);
+  auto wq = workqueue_foreach<DexClass*>(
+      [&](sparta::SpartaWorkerState<DexClass*>* state, DexClass* cls) {
+        fn(cls, &accs[state->worker_id()]);
+      },
+      num_threads);
+  for (auto cls : scope) {
+    wq.add_item(cls);
+  }
+  wq.run_all();
+  return accs;
+}
+
+template <typename K>
+void add_counts(const std::map<K, size_t>& from, std::map<K, size_t>* to) {
+  for (const auto& p : from) {
+    (*to)[p.first] += p.second;
+  }
+}
+
+} // namespace
+
+AnnoKill::AnnoKillStats& AnnoKill::AnnoKillStats::operator+=(
+    const AnnoKillStats& that) {
+  annotations += that.annotations;
+  annotations_killed += that.annotations_killed;
+  class_asets += that.class_asets;
+  class_asets_cleared += that.class_asets_cleared;
+  method_asets += that.method_asets;
+  method_asets_cleared += that.method_asets_cleared;
+  method_param_asets += that.method_param_asets;
+  method_param_asets_cleared += that.method_param_asets_cleared;
+  field_asets += that.field_asets;
+  field_asets_cleared += that.field_asets_cleared;
+  visibility_build_count += that.visibility_build_count;
+  visibility_runtime_count += that.visibility_runtime_count;
+  visibility_system_count += that.visibility_system_count;
+  signatures_killed += that.signatures_killed;
+  return *this;
+}
+
+AnnoKill::Counters& AnnoKill::Counters::operator+=(const Counters& that) {
+  stats += that.stats;
+  add_counts(that.build_anno_map, &build_anno_map);
+  add_counts(that.runtime_anno_map, &runtime_anno_map);
+  add_counts(that.system_anno_map, &system_anno_map);
+  return *this;
+}
+
 AnnoKill::AnnoKill(
     Scope& scope,
     bool kill_bad_signatures,
@@ -42,7 +99,8 @@ AnnoKill::AnnoKill(
         annotated_keep_annos)
     : m_scope(scope),
       m_only_force_kill(only_force_kill),
-      m_kill_bad_signatures(kill_bad_signatures) {
+      m_kill_bad_signatures(kill_bad_signatures),
+      m_scope_classes(scope.begin(), scope.end()) {
   // Load annotations that should not be deleted.
   TRACE(ANNO, 2, "Keep annotations count %d", keep.size());
   for (const auto& anno_name : keep) {
@@ -81,7 +139,8 @@ AnnoKill::AnnoKill(
   }
 
   // Populate class hierarchy keep map
-  auto ch = build_type_hierarchy(m_scope);
+  auto cached_hierarchy = get_cached_class_hierarchy(m_scope);
+  const auto& ch = cached_hierarchy->hierarchy;
   for (const auto& it : class_hierarchy_keep_annos) {
     auto* type = DexType::get_type(it.first.c_str());
     auto* type_cls = type ? type_class(type) : nullptr;
@@ -118,59 +177,59 @@ AnnoKill::AnnoKill(
 }
 
 AnnoKill::AnnoSet AnnoKill::get_referenced_annos() {
+  // The scan is done in two parallel walks over the classes, each worker
+  // collecting into its own set: first all the used annotations, then the
+  // ones among them that are referenced.
   AnnoKill::AnnoSet all_annos;
 
   // all used annotations
-  auto annos_in_aset = [&](DexAnnotationSet* aset) {
+  auto annos_in_aset = [](DexAnnotationSet* aset, AnnoKill::AnnoSet* annos) {
     if (!aset) {
       return;
     }
     for (const auto& anno : aset->get_annotations()) {
-      all_annos.insert(anno->type());
+      annos->insert(anno->type());
     }
   };
 
-  for (const auto& cls : m_scope) {
-    // all annotations referenced in classes
-    annos_in_aset(cls->get_anno_set());
+  auto worker_all_annos = run_on_classes<AnnoKill::AnnoSet>(
+      m_scope, [&](DexClass* cls, AnnoKill::AnnoSet* annos) {
+        // all annotations referenced in classes
+        annos_in_aset(cls->get_anno_set(), annos);
 
-    // all classes marked as annotation
-    if (is_annotation(cls)) {
-      all_annos.insert(cls->get_type());
-    }
-  }
+        // all classes marked as annotation
+        if (is_annotation(cls)) {
+          annos->insert(cls->get_type());
+        }
 
-  // all annotations in methods
-  walk::methods(m_scope, [&](DexMethod* method) {
-    annos_in_aset(method->get_anno_set());
-    auto param_annos = method->get_param_anno();
-    if (!param_annos) {
-      return;
-    }
-    for (auto pa : *param_annos) {
-      annos_in_aset(pa.second);
-    }
-  });
-  // all annotations in fields
-  walk::fields(m_scope,
-               [&](DexField* field) { annos_in_aset(field->get_anno_set()); });
+        // all annotations in methods
+        for (auto* methods : {&cls->get_dmethods(), &cls->get_vmethods()}) {
+          for (auto method : *methods) {
+            annos_in_aset(method->get_anno_set(), annos);
+            auto param_annos = method->get_param_anno();
+            if (!param_annos) {
+              continue;
+            }
+            for (auto pa : *param_annos) {
+              annos_in_aset(pa.second, annos);
+            }
+          }
+        }
 
-  AnnoKill::AnnoSet referenced_annos;
+        // all annotations in fields
+        for (auto* fields : {&cls->get_sfields(), &cls->get_ifields()}) {
+          for (auto field : *fields) {
+            annos_in_aset(field->get_anno_set(), annos);
+          }
+        }
+      });
+  for (AnnoKill::AnnoSet& annos : worker_all_annos) {
+    all_annos.insert(annos.begin(), annos.end());
+  }
 
   // mark an annotation as "unremovable" if a field is typed with that
   // annotation
-  walk::fields(m_scope, [&](DexField* field) {
-    // don't look at fields defined on the annotation itself
-    const auto field_cls_type = field->get_class();
-    if (all_annos.count(field_cls_type) > 0) {
-      return;
-    }
-
-    const auto field_cls = type_class(field_cls_type);
-    if (field_cls != nullptr && is_annotation(field_cls)) {
-      return;
-    }
-
+  auto check_field = [&](DexField* field, AnnoKill::AnnoSet* referenced_annos) {
     auto ftype = field->get_type();
     if (all_annos.count(ftype) > 0) {
       TRACE(ANNO,
@@ -179,24 +238,14 @@ AnnoKill::AnnoSet AnnoKill::get_referenced_annos() {
             SHOW(field->get_class()),
             SHOW(field->get_name()),
             SHOW(ftype));
-      referenced_annos.insert(ftype);
+      referenced_annos->insert(ftype);
     }
-  });
+  };
 
   // mark an annotation as "unremovable" if a method signature contains a type
   // with that annotation
-  walk::methods(m_scope, [&](DexMethod* meth) {
-    // don't look at methods defined on the annotation itself
-    const auto meth_cls_type = meth->get_class();
-    if (all_annos.count(meth_cls_type) > 0) {
-      return;
-    }
-
-    const auto meth_cls = type_class(meth_cls_type);
-    if (meth_cls != nullptr && is_annotation(meth_cls)) {
-      return;
-    }
-
+  auto check_signature = [&](DexMethod* meth,
+                             AnnoKill::AnnoSet* referenced_annos) {
     const auto& has_anno = [&](DexType* type) {
       if (all_annos.count(type) > 0) {
         TRACE(ANNO,
@@ -205,7 +254,7 @@ AnnoKill::AnnoSet AnnoKill::get_referenced_annos() {
               SHOW(meth->get_class()),
               SHOW(meth->get_name()),
               SHOW(meth->get_proto()));
-        referenced_annos.insert(type);
+        referenced_annos->insert(type);
       }
     };
 
@@ -214,100 +263,119 @@ AnnoKill::AnnoSet AnnoKill::get_referenced_annos() {
     for (const auto& arg : proto->get_args()->get_type_list()) {
       has_anno(arg);
     }
-  });
+  };
 
   // mark an annotation as "unremovable" if any opcode references the annotation
   // type
-  walk::opcodes(
-      m_scope,
-      [](DexMethod*) { return true; },
-      [&](DexMethod* meth, IRInstruction* insn) {
-        // don't look at methods defined on the annotation itself
-        const auto meth_cls_type = meth->get_class();
-        if (all_annos.count(meth_cls_type) > 0) {
-          return;
+  auto check_opcode = [&](DexMethod* meth,
+                          IRInstruction* insn,
+                          AnnoKill::AnnoSet* referenced_annos) {
+    if (insn->has_type()) {
+      auto type = insn->get_type();
+      if (all_annos.count(type) > 0) {
+        referenced_annos->insert(type);
+        TRACE(ANNO,
+              3,
+              "Annotation referenced in type opcode\n\t%s.%s:%s - %s",
+              SHOW(meth->get_class()),
+              SHOW(meth->get_name()),
+              SHOW(meth->get_proto()),
+              SHOW(insn));
+      }
+    } else if (insn->has_field()) {
+      auto field = insn->get_field();
+      auto fdef = resolve_field(field,
+                                is_sfield_op(insn->opcode())
+                                    ? FieldSearch::Static
+                                    : FieldSearch::Instance);
+      if (fdef != nullptr) field = fdef;
+
+      bool referenced = false;
+      auto owner = field->get_class();
+      if (all_annos.count(owner) > 0) {
+        referenced = true;
+        referenced_annos->insert(owner);
+      }
+      auto type = field->get_type();
+      if (all_annos.count(type) > 0) {
+        referenced = true;
+        referenced_annos->insert(type);
+      }
+      if (referenced) {
+        TRACE(ANNO,
+              3,
+              "Annotation referenced in field opcode\n\t%s.%s:%s - %s",
+              SHOW(meth->get_class()),
+              SHOW(meth->get_name()),
+              SHOW(meth->get_proto()),
+              SHOW(insn));
+      }
+    } else if (insn->has_method()) {
+      auto method = insn->get_method();
+      DexMethod* methdef = resolve_method(method, opcode_to_search(insn), meth);
+      if (methdef != nullptr) method = methdef;
+
+      bool referenced = false;
+      auto owner = method->get_class();
+      if (all_annos.count(owner) > 0) {
+        referenced = true;
+        referenced_annos->insert(owner);
+      }
+      auto proto = method->get_proto();
+      auto rtype = proto->get_rtype();
+      if (all_annos.count(rtype) > 0) {
+        referenced = true;
+        referenced_annos->insert(rtype);
+      }
+      auto arg_list = proto->get_args();
+      for (const auto& arg : arg_list->get_type_list()) {
+        if (all_annos.count(arg) > 0) {
+          referenced = true;
+          referenced_annos->insert(arg);
         }
-        const auto meth_cls = type_class(meth_cls_type);
-        if (meth_cls != nullptr && is_annotation(meth_cls)) {
+      }
+      if (referenced) {
+        TRACE(ANNO,
+              3,
+              "Annotation referenced in method opcode\n\t%s.%s:%s - %s",
+              SHOW(meth->get_class()),
+              SHOW(meth->get_name()),
+              SHOW(meth->get_proto()),
+              SHOW(insn));
+      }
+    }
+  };
+
+  auto worker_referenced_annos = run_on_classes<AnnoKill::AnnoSet>(
+      m_scope, [&](DexClass* cls, AnnoKill::AnnoSet* referenced_annos) {
+        // don't look at members defined on the annotation itself
+        if (all_annos.count(cls->get_type()) > 0 || is_annotation(cls)) {
           return;
         }
-
-        if (insn->has_type()) {
-          auto type = insn->get_type();
-          if (all_annos.count(type) > 0) {
-            referenced_annos.insert(type);
-            TRACE(ANNO,
-                  3,
-                  "Annotation referenced in type opcode\n\t%s.%s:%s - %s",
-                  SHOW(meth->get_class()),
-                  SHOW(meth->get_name()),
-                  SHOW(meth->get_proto()),
-                  SHOW(insn));
-          }
-        } else if (insn->has_field()) {
-          auto field = insn->get_field();
-          auto fdef = resolve_field(field,
-                                    is_sfield_op(insn->opcode())
-                                        ? FieldSearch::Static
-                                        : FieldSearch::Instance);
-          if (fdef != nullptr) field = fdef;
-
-          bool referenced = false;
-          auto owner = field->get_class();
-          if (all_annos.count(owner) > 0) {
-            referenced = true;
-            referenced_annos.insert(owner);
-          }
-          auto type = field->get_type();
-          if (all_annos.count(type) > 0) {
-            referenced = true;
-            referenced_annos.insert(type);
-          }
-          if (referenced) {
-            TRACE(ANNO,
-                  3,
-                  "Annotation referenced in field opcode\n\t%s.%s:%s - %s",
-                  SHOW(meth->get_class()),
-                  SHOW(meth->get_name()),
-                  SHOW(meth->get_proto()),
-                  SHOW(insn));
-          }
-        } else if (insn->has_method()) {
-          auto method = insn->get_method();
-          DexMethod* methdef =
-              resolve_method(method, opcode_to_search(insn), meth);
-          if (methdef != nullptr) method = methdef;
-
-          bool referenced = false;
-          auto owner = method->get_class();
-          if (all_annos.count(owner) > 0) {
-            referenced = true;
-            referenced_annos.insert(owner);
-          }
-          auto proto = method->get_proto();
-          auto rtype = proto->get_rtype();
-          if (all_annos.count(rtype) > 0) {
-            referenced = true;
-            referenced_annos.insert(rtype);
+        for (auto* fields : {&cls->get_sfields(), &cls->get_ifields()}) {
+          for (auto field : *fields) {
+            check_field(field, referenced_annos);
           }
-          auto arg_list = proto->get_args();
-          for (const auto& arg : arg_list->get_type_list()) {
-            if (all_annos.count(arg) > 0) {
-              referenced = true;
-              referenced_annos.insert(arg);
+        }
+        for (auto* methods : {&cls->get_dmethods(), &cls->get_vmethods()}) {
+          for (auto meth : *methods) {
+            check_signature(meth, referenced_annos);
+            auto code = meth->get_code();
+            if (code == nullptr) {
+              continue;
             }
-          }
-          if (referenced) {
-            TRACE(ANNO,
-                  3,
-                  "Annotation referenced in method opcode\n\t%s.%s:%s - %s",
-                  SHOW(meth->get_class()),
-                  SHOW(meth->get_name()),
-                  SHOW(meth->get_proto()),
-                  SHOW(insn));
+            editable_cfg_adapter::iterate(code, [&](MethodItemEntry& mie) {
+              check_opcode(meth, mie.insn, referenced_annos);
+              return editable_cfg_adapter::LOOP_CONTINUE;
+            });
           }
         }
       });
+
+  AnnoKill::AnnoSet referenced_annos;
+  for (AnnoKill::AnnoSet& annos : worker_referenced_annos) {
+    referenced_annos.insert(annos.begin(), annos.end());
+  }
   return referenced_annos;
 }
 
@@ -336,29 +404,32 @@ AnnoKill::AnnoSet AnnoKill::get_removable_annotation_instances() {
   return bannotations;
 }
 
-void AnnoKill::count_annotation(const DexAnnotation* da) {
+void AnnoKill::count_annotation(const DexAnnotation* da,
+                                Counters* counters) const {
   std::string annoName(da->type()->get_name()->c_str());
   if (da->system_visible()) {
-    m_system_anno_map[annoName]++;
-    m_stats.visibility_system_count++;
+    counters->system_anno_map[annoName]++;
+    counters->stats.visibility_system_count++;
   } else if (da->runtime_visible()) {
-    m_runtime_anno_map[annoName]++;
-    m_stats.visibility_runtime_count++;
+    counters->runtime_anno_map[annoName]++;
+    counters->stats.visibility_runtime_count++;
   } else if (da->build_visible()) {
-    m_build_anno_map[annoName]++;
-    m_stats.visibility_build_count++;
+    counters->build_anno_map[annoName]++;
+    counters->stats.visibility_build_count++;
   }
 }
 
 void AnnoKill::cleanup_aset(
     DexAnnotationSet* aset,
     const AnnoKill::AnnoSet& referenced_annos,
-    const std::unordered_set<const DexType*>& keep_annos) {
-  m_stats.annotations += aset->size();
+    const std::unordered_set<const DexType*>& keep_annos,
+    Counters* counters) const {
+  auto& stats = counters->stats;
+  stats.annotations += aset->size();
   auto& annos = aset->get_annotations();
   auto fn = [&](DexAnnotation* da) {
     auto anno_type = da->type();
-    count_annotation(da);
+    count_annotation(da, counters);
 
     if (referenced_annos.count(anno_type) > 0) {
       TRACE(ANNO,
@@ -392,7 +463,7 @@ void AnnoKill::cleanup_aset(
             "annotation: %s",
             SHOW(anno_type),
             SHOW(da));
-      m_stats.annotations_killed++;
+      stats.annotations_killed++;
       delete da;
       return true;
     }
@@ -404,21 +475,21 @@ void AnnoKill::cleanup_aset(
             "annotation: %s",
             SHOW(anno_type),
             SHOW(da));
-      m_stats.annotations_killed++;
+      stats.annotations_killed++;
       delete da;
       return true;
     }
 
     if (!m_only_force_kill && !da->system_visible()) {
       TRACE(ANNO, 3, "Killing annotation instance %s", SHOW(da));
-      m_stats.annotations_killed++;
+      stats.annotations_killed++;
       delete da;
       return true;
     }
 
     if (anno_type == DexType::get_type("Ldalvik/annotation/Signature;")) {
       if (should_kill_bad_signature(da)) {
-        m_stats.signatures_killed++;
+        stats.signatures_killed++;
         delete da;
         return true;
       }
@@ -426,10 +497,15 @@ void AnnoKill::cleanup_aset(
 
     return false;
   };
+  auto size = annos.size();
   annos.erase(std::remove_if(annos.begin(), annos.end(), fn), annos.end());
+  if (annos.size() < size) {
+    // Most sets lose most of their annotations; don't keep their storage.
+    annos.shrink_to_fit();
+  }
 }
 
-bool AnnoKill::should_kill_bad_signature(DexAnnotation* da) {
+bool AnnoKill::should_kill_bad_signature(DexAnnotation* da) const {
   if (!m_kill_bad_signatures) return false;
   TRACE(ANNO, 3, "Examining @Signature instance %s", SHOW(da));
   auto elems = da->anno_elems();
@@ -478,20 +554,11 @@ bool AnnoKill::should_kill_bad_signature(DexAnnotation* da) {
           auto* sigcls = type_class(sigtype);
           if (!sigcls) {
             sigtype = nullptr;
-          } else if (!sigcls->is_external()) {
-            bool found = false;
-            for (auto cls : m_scope) {
-              if (cls == sigcls) {
-                // Valid class, we're good, go to element in array
-                found = true;
-                continue;
-              }
-            }
+          } else if (!sigcls->is_external() &&
+                     m_scope_classes.count(sigcls) == 0) {
             // Could not find the (non-external) class in Scope, so set signal
             // to kill
-            if (!found) {
-              sigtype = nullptr;
-            }
+            sigtype = nullptr;
           }
         }
         if (!sigtype) {
@@ -505,63 +572,65 @@ bool AnnoKill::should_kill_bad_signature(DexAnnotation* da) {
 }
 
 std::unordered_set<const DexType*> AnnoKill::build_anno_keep(
-    DexAnnotationSet* aset) {
+    DexAnnotationSet* aset) const {
   std::unordered_set<const DexType*> keep_list;
   for (const auto& anno : aset->get_annotations()) {
-    auto& keeps = m_annotated_keep_annos[anno->type()];
-    keep_list.insert(keeps.begin(), keeps.end());
+    auto it = m_annotated_keep_annos.find(anno->type());
+    if (it != m_annotated_keep_annos.end()) {
+      keep_list.insert(it->second.begin(), it->second.end());
+    }
   }
   return keep_list;
 }
 
-bool AnnoKill::kill_annotations() {
-  const auto& referenced_annos = get_referenced_annos();
-  if (!m_only_force_kill) {
-    m_kill = get_removable_annotation_instances();
-  }
-
-  for (auto clazz : m_scope) {
-    DexAnnotationSet* aset = clazz->get_anno_set();
-    if (!aset) {
-      continue;
-    }
+void AnnoKill::cleanup_class(DexClass* clazz,
+                             const AnnoSet& referenced_annos,
+                             Counters* counters) const {
+  auto& stats = counters->stats;
+  DexAnnotationSet* aset = clazz->get_anno_set();
+  if (aset) {
     auto keep_list = build_anno_keep(aset);
-    auto& class_hier_keep_list = m_anno_class_hierarchy_keep[clazz->get_type()];
-    keep_list.insert(class_hier_keep_list.begin(), class_hier_keep_list.end());
+    auto it = m_anno_class_hierarchy_keep.find(clazz->get_type());
+    if (it != m_anno_class_hierarchy_keep.end()) {
+      keep_list.insert(it->second.begin(), it->second.end());
+    }
 
-    m_stats.class_asets++;
-    cleanup_aset(aset, referenced_annos, keep_list);
+    stats.class_asets++;
+    cleanup_aset(aset, referenced_annos, keep_list, counters);
     if (aset->size() == 0) {
       TRACE(
           ANNO, 3, "Clearing annotation for class %s", SHOW(clazz->get_type()));
       clazz->clear_annotations();
-      m_stats.class_asets_cleared++;
+      stats.class_asets_cleared++;
     }
   }
 
-  walk::methods(m_scope, [&](DexMethod* method) {
-    // Method annotations
-    auto method_aset = method->get_anno_set();
-    if (method_aset) {
-      m_stats.method_asets++;
-      auto keep_list = build_anno_keep(method_aset);
-      cleanup_aset(method_aset, referenced_annos, keep_list);
-      if (method_aset->size() == 0) {
-        TRACE(ANNO,
-              3,
-              "Clearing annotations for method %s.%s:%s",
-              SHOW(method->get_class()),
-              SHOW(method->get_name()),
-              SHOW(method->get_proto()));
-        method->clear_annotations();
-        m_stats.method_asets_cleared++;
+  for (auto* methods : {&clazz->get_dmethods(), &clazz->get_vmethods()}) {
+    for (auto method : *methods) {
+      // Method annotations
+      auto method_aset = method->get_anno_set();
+      if (method_aset) {
+        stats.method_asets++;
+        auto keep_list = build_anno_keep(method_aset);
+        cleanup_aset(method_aset, referenced_annos, keep_list, counters);
+        if (method_aset->size() == 0) {
+          TRACE(ANNO,
+                3,
+                "Clearing annotations for method %s.%s:%s",
+                SHOW(method->get_class()),
+                SHOW(method->get_name()),
+                SHOW(method->get_proto()));
+          method->clear_annotations();
+          stats.method_asets_cleared++;
+        }
       }
-    }
 
-    // Parameter annotations.
-    auto param_annos = method->get_param_anno();
-    if (param_annos) {
-      m_stats.method_param_asets += param_annos->size();
+      // Parameter annotations.
+      auto param_annos = method->get_param_anno();
+      if (!param_annos) {
+        continue;
+      }
+      stats.method_param_asets += param_annos->size();
       bool clear_pas = true;
       for (auto pa : *param_annos) {
         auto param_aset = pa.second;
@@ -569,7 +638,7 @@ bool AnnoKill::kill_annotations() {
           continue;
         }
         auto keep_list = build_anno_keep(param_aset);
-        cleanup_aset(param_aset, referenced_annos, keep_list);
+        cleanup_aset(param_aset, referenced_annos, keep_list, counters);
         if (param_aset->size() == 0) {
           continue;
         }
@@ -582,34 +651,51 @@ bool AnnoKill::kill_annotations() {
               SHOW(method->get_class()),
               SHOW(method->get_name()),
               SHOW(method->get_proto()));
-        m_stats.method_param_asets_cleared += param_annos->size();
+        stats.method_param_asets_cleared += param_annos->size();
         for (auto pa : *param_annos) {
           delete pa.second;
         }
         param_annos->clear();
       }
     }
-  });
+  }
 
-  walk::fields(m_scope, [&](DexField* field) {
-    DexAnnotationSet* aset = field->get_anno_set();
-    if (!aset) {
-      return;
-    }
-    m_stats.field_asets++;
-    auto keep_list = build_anno_keep(aset);
-    cleanup_aset(aset, referenced_annos, keep_list);
-    if (aset->size() == 0) {
-      TRACE(ANNO,
-            3,
-            "Clearing annotations for field %s.%s:%s",
-            SHOW(field->get_class()),
-            SHOW(field->get_name()),
-            SHOW(field->get_type()));
-      field->clear_annotations();
-      m_stats.field_asets_cleared++;
+  for (auto* fields : {&clazz->get_sfields(), &clazz->get_ifields()}) {
+    for (auto field : *fields) {
+      DexAnnotationSet* field_aset = field->get_anno_set();
+      if (!field_aset) {
+        continue;
+      }
+      stats.field_asets++;
+      auto keep_list = build_anno_keep(field_aset);
+      cleanup_aset(field_aset, referenced_annos, keep_list, counters);
+      if (field_aset->size() == 0) {
+        TRACE(ANNO,
+              3,
+              "Clearing annotations for field %s.%s:%s",
+              SHOW(field->get_class()),
+              SHOW(field->get_name()),
+              SHOW(field->get_type()));
+        field->clear_annotations();
+        stats.field_asets_cleared++;
+      }
     }
-  });
+  }
+}
+
+bool AnnoKill::kill_annotations() {
+  const auto& referenced_annos = get_referenced_annos();
+  if (!m_only_force_kill) {
+    m_kill = get_removable_annotation_instances();
+  }
+
+  auto worker_counters = run_on_classes<Counters>(
+      m_scope, [&](DexClass* clazz, Counters* counters) {
+        cleanup_class(clazz, referenced_annos, counters);
+      });
+  for (Counters& counters : worker_counters) {
+    m_counters += counters;
+  }
 
   bool classes_removed = false;
   // We're done removing annotation instances, go ahead and remove annotation
@@ -635,15 +721,15 @@ bool AnnoKill::kill_annotations() {
                      }),
       m_scope.end());
 
-  for (const auto& p : m_build_anno_map) {
+  for (const auto& p : m_counters.build_anno_map) {
     TRACE(ANNO, 3, "Build anno: %lu, %s", p.second, p.first.c_str());
   }
 
-  for (const auto& p : m_runtime_anno_map) {
+  for (const auto& p : m_counters.runtime_anno_map) {
     TRACE(ANNO, 3, "Runtime anno: %lu, %s", p.second, p.first.c_str());
   }
 
-  for (const auto& p : m_system_anno_map) {
+  for (const auto& p : m_counters.system_anno_map) {
     TRACE(ANNO, 3, "System anno: %lu, %s", p.second, p.first.c_str());
   }
 
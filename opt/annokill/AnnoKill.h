@@ -36,6 +36,8 @@ class AnnoKill {
     size_t signatures_killed;
 
     AnnoKillStats() { memset(this, 0, sizeof(AnnoKillStats)); }
+
+    AnnoKillStats& operator+=(const AnnoKillStats& that);
   };
 
   AnnoKill(Scope& scope,
@@ -50,11 +52,23 @@ class AnnoKill {
                annotated_keep_annos);
 
   bool kill_annotations();
-  std::unordered_set<const DexType*> build_anno_keep(DexAnnotationSet* aset);
-  bool should_kill_bad_signature(DexAnnotation* da);
-  AnnoKillStats get_stats() const { return m_stats; }
+  std::unordered_set<const DexType*> build_anno_keep(
+      DexAnnotationSet* aset) const;
+  bool should_kill_bad_signature(DexAnnotation* da) const;
+  AnnoKillStats get_stats() const { return m_counters.stats; }
 
  private:
+  // What cleaning up the annotation sets tallies. Each worker has its own,
+  // and they are summed up once all the classes are cleaned up.
+  struct Counters {
+    AnnoKillStats stats;
+    std::map<std::string, size_t> build_anno_map;
+    std::map<std::string, size_t> runtime_anno_map;
+    std::map<std::string, size_t> system_anno_map;
+
+    Counters& operator+=(const Counters& that);
+  };
+
   // Gets the set of all annotations referenced in code
   // either by the use of SomeClass.class, as a parameter of a method
   // call or if the annotation is a field of a class.
@@ -64,11 +78,18 @@ class AnnoKill {
   // of annotation types to be removed.
   AnnoSet get_removable_annotation_instances();
 
+  // Cleans up the annotation sets of the class and of its methods, method
+  // parameters and fields. Classes are independent, so this runs on all of
+  // them in parallel.
+  void cleanup_class(DexClass* clazz,
+                     const AnnoSet& referenced_annos,
+                     Counters* counters) const;
+
   void cleanup_aset(DexAnnotationSet* aset,
                     const AnnoSet& referenced_annos,
-                    const std::unordered_set<const DexType*>& keep_annos =
-                        std::unordered_set<const DexType*>{});
-  void count_annotation(const DexAnnotation* da);
+                    const std::unordered_set<const DexType*>& keep_annos,
+                    Counters* counters) const;
+  void count_annotation(const DexAnnotation* da, Counters* counters) const;
 
   Scope& m_scope;
   bool m_only_force_kill;
@@ -76,11 +97,11 @@ class AnnoKill {
   AnnoSet m_kill;
   AnnoSet m_force_kill;
   AnnoSet m_keep;
-  AnnoKillStats m_stats;
+  Counters m_counters;
+  // The classes of the scope, to check @Signature types against without
+  // scanning the scope for each of them.
+  std::unordered_set<const DexClass*> m_scope_classes;
 
-  std::map<std::string, size_t> m_build_anno_map;
-  std::map<std::string, size_t> m_runtime_anno_map;
-  std::map<std::string, size_t> m_system_anno_map;
   std::unordered_map<const DexType*, std::unordered_set<const DexType*>>
       m_anno_class_hierarchy_keep;
   std::unordered_map<const DexType*, std::unordered_set<const DexType*>>
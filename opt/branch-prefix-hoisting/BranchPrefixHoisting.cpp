@@ -315,28 +315,26 @@ int BranchPrefixHoistingPass::process_cfg(cfg::ControlFlowGraph& cfg) {
   return ret_insns_hoisted;
 }
 
-void BranchPrefixHoistingPass::run_pass(DexStoresVector& stores,
-                                        ConfigFiles& /* unused */,
-                                        PassManager& mgr) {
-  auto scope = build_class_scope(stores);
-
-  int total_insns_hoisted =
-      walk::parallel::methods<int>(scope, [](DexMethod* method) -> int {
-        const auto code = method->get_code();
-        if (!code) {
-          return 0;
-        }
-
-        int insns_hoisted = BranchPrefixHoistingPass::process_code(code);
-        if (insns_hoisted) {
-          TRACE(BPH, 3,
-                "[branch prefix hoisting] Moved %u insns in method {%s}",
-                insns_hoisted, SHOW(method));
-        }
-        return insns_hoisted;
-      });
+std::unique_ptr<MethodLocalTransform>
+BranchPrefixHoistingPass::make_method_local_transform(
+    DexStoresVector&, ConfigFiles& /* unused */, PassManager&) {
+  auto transform = [](DexMethod* method) -> int {
+    const auto code = method->get_code();
+    if (!code) {
+      return 0;
+    }
 
-  mgr.incr_metric(METRIC_INSTRUCTIONS_HOISTED, total_insns_hoisted);
+    int insns_hoisted = BranchPrefixHoistingPass::process_code(code);
+    if (insns_hoisted) {
+      TRACE(BPH, 3, "[branch prefix hoisting] Moved %u insns in method {%s}",
+            insns_hoisted, SHOW(method));
+    }
+    return insns_hoisted;
+  };
+  auto report = [](int total_insns_hoisted, PassManager& mgr) {
+    mgr.incr_metric(METRIC_INSTRUCTIONS_HOISTED, total_insns_hoisted);
+  };
+  return std::make_unique<StatsMethodLocalTransform<int>>(transform, report);
 }
 
 static BranchPrefixHoistingPass s_pass;
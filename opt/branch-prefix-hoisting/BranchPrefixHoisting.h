@@ -11,13 +11,15 @@
 #include <vector>
 
 #include "IRList.h"
-#include "Pass.h"
+#include "MethodLocalTransform.h"
 
-class BranchPrefixHoistingPass : public Pass {
+class BranchPrefixHoistingPass : public MethodLocalPass {
  public:
-  BranchPrefixHoistingPass() : Pass("BranchPrefixHoistingPass") {}
+  BranchPrefixHoistingPass()
+      : MethodLocalPass("BranchPrefixHoistingPass") {}
 
-  void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
+  std::unique_ptr<MethodLocalTransform> make_method_local_transform(
+      DexStoresVector&, ConfigFiles&, PassManager&) override;
 
   static int process_code(IRCode*);
   static int process_cfg(cfg::ControlFlowGraph&);
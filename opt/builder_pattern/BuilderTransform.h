@@ -36,7 +36,7 @@ class BuilderTransform {
   const TypeSystem& m_type_system;
   const DexType* m_root;
   std::unique_ptr<MultiMethodInliner> m_inliner;
-  MethodRefCache m_resolved_refs;
+  ConcurrentMethodRefCache m_resolved_refs;
 
   // Used for tracking changes that we need to restore.
   std::unordered_map<DexMethod*, DexMethod*> m_method_copy;
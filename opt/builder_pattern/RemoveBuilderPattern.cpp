@@ -6,6 +6,7 @@
 
 #include "BuilderAnalysis.h"
 #include "BuilderTransform.h"
+#include "ConcurrentContainers.h"
 #include "DexClass.h"
 #include "DexUtil.h"
 #include "PassManager.h"
@@ -118,9 +119,10 @@ class RemoveClasses {
 
   void update_usage() {
     auto buildee_types = get_associated_buildees(m_classes);
+    auto candidates = find_instantiating_methods();
 
     walk::methods(m_scope, [&](DexMethod* method) {
-      if (!method || !method->get_code()) {
+      if (!method || !method->get_code() || !candidates.count(method)) {
         return;
       }
 
@@ -154,6 +156,34 @@ class RemoveClasses {
     });
   }
 
+  /**
+   * The analysis only tracks values created by a new-instance of a builder or
+   * returned by a call whose return type is a builder. A parallel scan over
+   * the linear code finds the methods with such an instruction, so that we
+   * don't build a CFG and run the fixpoint for every other method.
+   */
+  ConcurrentSet<DexMethod*> find_instantiating_methods() {
+    ConcurrentSet<DexMethod*> methods;
+    walk::parallel::code(m_scope, [&](DexMethod* method, IRCode& code) {
+      for (const auto& mie : InstructionIterable(code)) {
+        auto insn = mie.insn;
+        const DexType* type = nullptr;
+        if (insn->opcode() == OPCODE_NEW_INSTANCE) {
+          type = insn->get_type();
+        } else if (insn->opcode() == OPCODE_INVOKE_DIRECT ||
+                   insn->opcode() == OPCODE_INVOKE_VIRTUAL ||
+                   insn->opcode() == OPCODE_INVOKE_STATIC) {
+          type = insn->get_method()->get_proto()->get_rtype();
+        }
+        if (type != nullptr && m_classes.count(type)) {
+          methods.insert(method);
+          return;
+        }
+      }
+    });
+    return methods;
+  }
+
   void collect_excluded_types() {
     walk::fields(m_scope, [&](DexField* field) {
       auto type = field->get_type();
@@ -18,6 +18,7 @@
 #include "IRInstruction.h"
 #include "Resolver.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 /**
  * Performs 2 kind of verifications:
@@ -124,10 +125,53 @@ Breadcrumbs::Breadcrumbs(const Scope& scope,
   m_multiple_root_store_dexes = stores[0].get_dexen().size() > 1;
 }
 
+void Breadcrumbs::Violations::merge(Violations&& that) {
+  auto append_all = [](auto& to, auto& from) {
+    for (auto& pair : from) {
+      auto& elements = to[pair.first];
+      elements.insert(elements.end(), pair.second.begin(), pair.second.end());
+    }
+  };
+  auto append_all_insns = [&](auto& to, auto& from) {
+    for (auto& pair : from) {
+      append_all(to[pair.first], pair.second);
+    }
+  };
+  append_all(bad_fields, that.bad_fields);
+  append_all(bad_methods, that.bad_methods);
+  append_all_insns(bad_type_insns, that.bad_type_insns);
+  append_all_insns(bad_field_insns, that.bad_field_insns);
+  append_all_insns(bad_meth_insns, that.bad_meth_insns);
+  append_all(illegal_field, that.illegal_field);
+  append_all(bad_fields_refs, that.bad_fields_refs);
+  append_all(illegal_type, that.illegal_type);
+  append_all(illegal_field_type, that.illegal_field_type);
+  append_all(illegal_field_cls, that.illegal_field_cls);
+  append_all(illegal_method_call, that.illegal_method_call);
+}
+
 void Breadcrumbs::check_breadcrumbs() {
   check_fields();
-  check_methods();
-  check_opcodes();
+
+  // Check the methods of each class in parallel. Merging the violations in
+  // scope order makes the reports the same as those of a serial walk.
+  auto num_threads = redex_parallel::default_num_threads();
+  std::vector<Violations> class_violations(m_scope.size());
+  // Resolver caches aren't thread-safe, so each worker has its own.
+  std::vector<MethodRefCache> resolved_refs(num_threads);
+  auto wq = workqueue_foreach<size_t>(
+      [&](sparta::SpartaWorkerState<size_t>* state, size_t i) {
+        check_class(m_scope[i], &resolved_refs[state->worker_id()],
+                    &class_violations[i]);
+      },
+      num_threads);
+  for (size_t i = 0; i < m_scope.size(); i++) {
+    wq.add_item(i);
+  }
+  wq.run_all();
+  for (auto& violations : class_violations) {
+    m_violations.merge(std::move(violations));
+  }
 }
 
 void Breadcrumbs::report_deleted_types(bool report_only, PassManager& mgr) {
@@ -136,25 +180,26 @@ void Breadcrumbs::report_deleted_types(bool report_only, PassManager& mgr) {
   size_t bad_type_insns_count = 0;
   size_t bad_field_insns_count = 0;
   size_t bad_meths_insns_count = 0;
-  if (!m_bad_fields.empty() || !m_bad_methods.empty() ||
-      !m_bad_type_insns.empty() || !m_bad_field_insns.empty() ||
-      !m_bad_meth_insns.empty()) {
+  const auto& v = m_violations;
+  if (!v.bad_fields.empty() || !v.bad_methods.empty() ||
+      !v.bad_type_insns.empty() || !v.bad_field_insns.empty() ||
+      !v.bad_meth_insns.empty()) {
     std::ostringstream ss;
-    for (const auto& bad_field : m_bad_fields) {
+    for (const auto& bad_field : v.bad_fields) {
       for (const auto& field : bad_field.second) {
         bad_fields_count++;
         ss << "Reference to deleted type " << SHOW(bad_field.first)
            << " in field " << SHOW(field) << std::endl;
       }
     }
-    for (const auto& bad_meth : m_bad_methods) {
+    for (const auto& bad_meth : v.bad_methods) {
       for (const auto& meth : bad_meth.second) {
         bad_methods_count++;
         ss << "Reference to deleted type " << SHOW(bad_meth.first)
            << " in method " << SHOW(meth) << std::endl;
       }
     }
-    for (const auto& bad_insns : m_bad_type_insns) {
+    for (const auto& bad_insns : v.bad_type_insns) {
       for (const auto& insns : bad_insns.second) {
         for (const auto& insn : insns.second) {
           bad_type_insns_count++;
@@ -164,7 +209,7 @@ void Breadcrumbs::report_deleted_types(bool report_only, PassManager& mgr) {
         }
       }
     }
-    for (const auto& bad_insns : m_bad_field_insns) {
+    for (const auto& bad_insns : v.bad_field_insns) {
       for (const auto& insns : bad_insns.second) {
         for (const auto& insn : insns.second) {
           bad_field_insns_count++;
@@ -174,7 +219,7 @@ void Breadcrumbs::report_deleted_types(bool report_only, PassManager& mgr) {
         }
       }
     }
-    for (const auto& bad_insns : m_bad_meth_insns) {
+    for (const auto& bad_insns : v.bad_meth_insns) {
       for (const auto& insns : bad_insns.second) {
         for (const auto& insn : insns.second) {
           bad_meths_insns_count++;
@@ -209,7 +254,7 @@ void Breadcrumbs::report_deleted_types(bool report_only, PassManager& mgr) {
 
 std::string Breadcrumbs::get_methods_with_bad_refs() {
   std::ostringstream ss;
-  for (const auto& class_meth : m_bad_methods) {
+  for (const auto& class_meth : m_violations.bad_methods) {
     const auto type = class_meth.first;
     const auto& methods = class_meth.second;
     ss << "Bad methods in class " << type->get_name()->c_str() << std::endl;
@@ -218,7 +263,7 @@ std::string Breadcrumbs::get_methods_with_bad_refs() {
     }
     ss << std::endl;
   }
-  for (const auto& meth_field : m_bad_fields_refs) {
+  for (const auto& meth_field : m_violations.bad_fields_refs) {
     const auto type = meth_field.first->get_class();
     const auto method = meth_field.first;
     const auto& fields = meth_field.second;
@@ -234,9 +279,10 @@ std::string Breadcrumbs::get_methods_with_bad_refs() {
 
 void Breadcrumbs::report_illegal_refs(bool fail_if_illegal_refs,
                                       PassManager& mgr) {
+  const auto& v = m_violations;
   size_t num_illegal_fields = 0;
   std::ostringstream ss;
-  for (const auto& pair : m_illegal_field) {
+  for (const auto& pair : v.illegal_field) {
     const auto type = pair.first;
     const auto& fields = pair.second;
     num_illegal_fields += fields.size();
@@ -251,13 +297,13 @@ void Breadcrumbs::report_illegal_refs(bool fail_if_illegal_refs,
   }
 
   size_t num_illegal_type_refs =
-      illegal_elements(m_xstores, m_illegal_type, "type refs", ss);
+      illegal_elements(m_xstores, v.illegal_type, "type refs", ss);
   size_t num_illegal_field_type_refs =
-      illegal_elements(m_xstores, m_illegal_field_type, "field type refs", ss);
+      illegal_elements(m_xstores, v.illegal_field_type, "field type refs", ss);
   size_t num_illegal_field_cls =
-      illegal_elements(m_xstores, m_illegal_field_cls, "field class refs", ss);
+      illegal_elements(m_xstores, v.illegal_field_cls, "field class refs", ss);
   size_t num_illegal_method_calls =
-      illegal_elements(m_xstores, m_illegal_method_call, "method call", ss);
+      illegal_elements(m_xstores, v.illegal_method_call, "method call", ss);
 
   size_t num_illegal_cross_store_refs =
       num_illegal_fields + num_illegal_type_refs + num_illegal_field_cls +
@@ -285,6 +331,13 @@ void Breadcrumbs::report_illegal_refs(bool fail_if_illegal_refs,
 }
 
 bool Breadcrumbs::has_illegal_access(const DexMethod* input_method) {
+  MethodRefCache resolved_refs;
+  return has_illegal_access(input_method, &resolved_refs, &m_violations);
+}
+
+bool Breadcrumbs::has_illegal_access(const DexMethod* input_method,
+                                     MethodRefCache* resolved_refs,
+                                     Violations* v) {
   bool result = false;
   if (input_method->get_code() == nullptr) {
     return false;
@@ -294,7 +347,7 @@ bool Breadcrumbs::has_illegal_access(const DexMethod* input_method) {
     if (insn->has_field()) {
       auto res_field = resolve_field(insn->get_field());
       if (res_field != nullptr) {
-        if (!check_field_accessibility(input_method, res_field)) {
+        if (!check_field_accessibility(input_method, res_field, v)) {
           result = true;
         }
       } else if (referenced_field_is_deleted(insn->get_field())) {
@@ -302,10 +355,11 @@ bool Breadcrumbs::has_illegal_access(const DexMethod* input_method) {
       }
     }
     if (insn->has_method()) {
-      auto res_method = resolve_method(insn->get_method(),
-                                       opcode_to_search(insn), input_method);
+      auto res_method =
+          resolve_method(insn->get_method(), opcode_to_search(insn),
+                         *resolved_refs, input_method);
       if (res_method != nullptr) {
-        if (!check_method_accessibility(input_method, res_method)) {
+        if (!check_method_accessibility(input_method, res_method, v)) {
           result = true;
         }
       } else if (referenced_method_is_deleted(insn->get_method())) {
@@ -382,8 +436,9 @@ const DexType* Breadcrumbs::check_anno(const DexAnnotationSet* anno) {
 
 void Breadcrumbs::bad_type(const DexType* type,
                            const DexMethod* method,
-                           const IRInstruction* insn) {
-  m_bad_type_insns[type][method].emplace_back(insn);
+                           const IRInstruction* insn,
+                           Violations* v) {
+  v->bad_type_insns[type][method].emplace_back(insn);
 }
 
 // Verify that all field definitions reference types that are not deleted.
@@ -395,7 +450,7 @@ void Breadcrumbs::check_fields() {
     for (auto type : type_refs) {
       auto bad_ref = check_type(type);
       if (bad_ref) {
-        m_bad_fields[bad_ref].emplace_back(field);
+        m_violations.bad_fields[bad_ref].emplace_back(field);
         check_cross_store_ref = false;
       }
     }
@@ -403,7 +458,7 @@ void Breadcrumbs::check_fields() {
       const auto cls = field->get_class();
       const auto field_type = field->get_type();
       if (is_illegal_cross_store(cls, field_type)) {
-        m_illegal_field[cls].emplace_back(field);
+        m_violations.illegal_field[cls].emplace_back(field);
       }
       return;
     }
@@ -411,36 +466,65 @@ void Breadcrumbs::check_fields() {
 }
 
 // Verify that all method definitions use not deleted types in their signatures
-// and annotations.
-void Breadcrumbs::check_methods() {
-  walk::methods(m_scope, [&](DexMethod* method) {
+// and annotations, and that all their opcodes are to non deleted references.
+void Breadcrumbs::check_class(const DexClass* cls,
+                              MethodRefCache* resolved_refs,
+                              Violations* v) {
+  auto check_method_def = [&](DexMethod* method) {
     bool check_cross_store_ref = true;
     // Check type references on the method signature.
     const auto* bad_ref = check_method(method);
     if (bad_ref) {
-      m_bad_methods[bad_ref].emplace_back(method);
+      v->bad_methods[bad_ref].emplace_back(method);
       check_cross_store_ref = false;
     }
     // Check type references on the annotations on the method.
     bad_ref = check_anno(method->get_anno_set());
     if (bad_ref) {
-      m_bad_methods[bad_ref].emplace_back(method);
+      v->bad_methods[bad_ref].emplace_back(method);
       check_cross_store_ref = false;
     }
 
     if (check_cross_store_ref) {
-      has_illegal_access(method);
+      has_illegal_access(method, resolved_refs, v);
     }
-  });
+  };
+  auto check_opcodes = [&](DexMethod* method) {
+    auto* code = method->get_code();
+    if (code == nullptr) {
+      return;
+    }
+    for (const auto& mie : InstructionIterable(code)) {
+      auto* insn = mie.insn;
+      if (insn->has_type()) {
+        check_type_opcode(method, insn, v);
+      } else if (insn->has_field()) {
+        check_field_opcode(method, insn, v);
+      } else if (insn->has_method()) {
+        check_method_opcode(method, insn, resolved_refs, v);
+      }
+    }
+  };
+  for (auto* methods : {&cls->get_dmethods(), &cls->get_vmethods()}) {
+    for (auto* method : *methods) {
+      check_method_def(method);
+    }
+  }
+  for (auto* methods : {&cls->get_dmethods(), &cls->get_vmethods()}) {
+    for (auto* method : *methods) {
+      check_opcodes(method);
+    }
+  }
 }
 
 /* verify that all method instructions that access fields are valid */
 bool Breadcrumbs::check_field_accessibility(const DexMethod* method,
-                                            const DexField* res_field) {
+                                            const DexField* res_field,
+                                            Violations* v) {
   const auto field_class = res_field->get_class();
   const auto method_class = method->get_class();
   if (field_class != method_class && is_private(res_field)) {
-    m_bad_fields_refs[method].emplace_back(res_field);
+    v->bad_fields_refs[method].emplace_back(res_field);
     return false;
   }
   return true;
@@ -458,11 +542,13 @@ bool Breadcrumbs::referenced_method_is_deleted(DexMethodRef* method_ref) {
 
 /* verify that all method instructions that access methods are valid */
 bool Breadcrumbs::check_method_accessibility(
-    const DexMethod* method, const DexMethod* res_called_method) {
+    const DexMethod* method,
+    const DexMethod* res_called_method,
+    Violations* v) {
   const auto called_method_class = res_called_method->get_class();
   const auto method_class = method->get_class();
   if (called_method_class != method_class && is_private(res_called_method)) {
-    m_bad_methods[method_class].emplace_back(res_called_method);
+    v->bad_methods[method_class].emplace_back(res_called_method);
     return false;
   }
   return true;
@@ -470,21 +556,23 @@ bool Breadcrumbs::check_method_accessibility(
 
 // verify that all opcodes are to non deleted references
 void Breadcrumbs::check_type_opcode(const DexMethod* method,
-                                    IRInstruction* insn) {
+                                    IRInstruction* insn,
+                                    Violations* v) {
   const DexType* type = insn->get_type();
   type = check_type(type);
   if (type != nullptr) {
-    bad_type(type, method, insn);
+    bad_type(type, method, insn, v);
   } else {
     const auto cls = method->get_class();
     if (is_illegal_cross_store(cls, insn->get_type())) {
-      m_illegal_type[method].emplace_back(insn);
+      v->illegal_type[method].emplace_back(insn);
     }
   }
 }
 
 void Breadcrumbs::check_field_opcode(const DexMethod* method,
-                                     IRInstruction* insn) {
+                                     IRInstruction* insn,
+                                     Violations* v) {
   bool check_cross_store_ref = true;
 
   auto field = insn->get_field();
@@ -493,7 +581,7 @@ void Breadcrumbs::check_field_opcode(const DexMethod* method,
   for (auto type : type_refs) {
     auto bad_ref = check_type(type);
     if (bad_ref) {
-      bad_type(bad_ref, method, insn);
+      bad_type(bad_ref, method, insn, v);
       check_cross_store_ref = false;
     }
   }
@@ -501,11 +589,11 @@ void Breadcrumbs::check_field_opcode(const DexMethod* method,
   if (check_cross_store_ref) {
     auto cls = method->get_class();
     if (is_illegal_cross_store(cls, field->get_class())) {
-      m_illegal_field_type[method].emplace_back(insn);
+      v->illegal_field_type[method].emplace_back(insn);
     }
 
     if (is_illegal_cross_store(cls, field->get_type())) {
-      m_illegal_field_cls[method].emplace_back(insn);
+      v->illegal_field_cls[method].emplace_back(insn);
     }
   }
 
@@ -515,7 +603,7 @@ void Breadcrumbs::check_field_opcode(const DexMethod* method,
     if (field != res_field) {
       auto bad_ref = check_type(field->get_class());
       if (bad_ref != nullptr) {
-        bad_type(bad_ref, method, insn);
+        bad_type(bad_ref, method, insn, v);
         return;
       }
     }
@@ -523,7 +611,7 @@ void Breadcrumbs::check_field_opcode(const DexMethod* method,
     // the class of the field is around but the field may have
     // been deleted so let's verify the field exists on the class
     if (referenced_field_is_deleted(field)) {
-      m_bad_field_insns[static_cast<DexField*>(field)][method].emplace_back(
+      v->bad_field_insns[static_cast<DexField*>(field)][method].emplace_back(
           insn);
       return;
     }
@@ -531,24 +619,27 @@ void Breadcrumbs::check_field_opcode(const DexMethod* method,
 }
 
 void Breadcrumbs::check_method_opcode(const DexMethod* method,
-                                      IRInstruction* insn) {
+                                      IRInstruction* insn,
+                                      MethodRefCache* resolved_refs,
+                                      Violations* v) {
   const auto& meth = insn->get_method();
   const DexType* type = check_method(meth);
   if (type != nullptr) {
-    bad_type(type, method, insn);
+    bad_type(type, method, insn, v);
     return;
   }
   if (is_illegal_cross_store(method->get_class(), meth->get_class())) {
-    m_illegal_method_call[method].emplace_back(insn);
+    v->illegal_method_call[method].emplace_back(insn);
   }
 
-  DexMethod* res_meth = resolve_method(meth, opcode_to_search(insn), method);
+  DexMethod* res_meth =
+      resolve_method(meth, opcode_to_search(insn), *resolved_refs, method);
   if (res_meth != nullptr) {
     // a resolved method can only differ in the owner class
     if (res_meth != meth) {
       type = check_type(res_meth->get_class());
       if (type != nullptr) {
-        bad_type(type, method, insn);
+        bad_type(type, method, insn, v);
         return;
       }
     }
@@ -556,31 +647,13 @@ void Breadcrumbs::check_method_opcode(const DexMethod* method,
     // the class of the method is around but the method may have
     // been deleted so let's verify the method exists on the class
     if (referenced_method_is_deleted(meth)) {
-      m_bad_meth_insns[static_cast<DexMethod*>(meth)][method].emplace_back(
+      v->bad_meth_insns[static_cast<DexMethod*>(meth)][method].emplace_back(
           insn);
       return;
     }
   }
 }
 
-void Breadcrumbs::check_opcodes() {
-  walk::opcodes(m_scope,
-                [](DexMethod*) { return true; },
-                [&](DexMethod* method, IRInstruction* insn) {
-                  if (insn->has_type()) {
-                    check_type_opcode(method, insn);
-                    return;
-                  }
-                  if (insn->has_field()) {
-                    check_field_opcode(method, insn);
-                    return;
-                  }
-                  if (insn->has_method()) {
-                    check_method_opcode(method, insn);
-                  }
-                });
-}
-
 void CheckBreadcrumbsPass::run_pass(DexStoresVector& stores,
                                     ConfigFiles& /* conf */,
                                     PassManager& mgr) {
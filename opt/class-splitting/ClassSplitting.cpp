@@ -61,6 +61,8 @@ constexpr const char* METRIC_POPULAR_METHODS =
 constexpr const char* METRIC_RELOCATED_METHODS =
     "num_class_splitting_relocated_methods";
 constexpr const char* METRIC_TRAMPOLINES = "num_class_splitting_trampolines";
+constexpr const char* METRIC_RELOCATED_CODE_BYTES =
+    "num_class_splitting_relocated_code_bytes";
 
 struct ClassSplittingStats {
   size_t relocation_classes{0};
@@ -70,6 +72,8 @@ struct ClassSplittingStats {
   size_t relocated_true_virtual_methods{0};
   size_t non_relocated_methods{0};
   size_t popular_methods{0};
+  // An estimate of the bytecode moved out of the perf-sensitive classes.
+  size_t relocated_code_bytes{0};
 };
 
 class ClassSplittingInterDexPlugin : public interdex::InterDexPassPlugin {
@@ -82,18 +86,16 @@ class ClassSplittingInterDexPlugin : public interdex::InterDexPassPlugin {
 
   void configure(const Scope& scope, ConfigFiles& conf) override {
     if (m_method_profiles.has_stats()) {
+      // Only methods of the scope are ever looked up, so there's no need to
+      // walk the scope once per interaction; the profiled methods suffice.
       for (auto& p : m_method_profiles.all_interactions()) {
-        auto& method_stats = p.second;
-        walk::methods(scope, [&](DexMethod* method) {
-          auto it = method_stats.find(method);
-          if (it == method_stats.end()) {
-            return;
+        for (auto& q : p.second) {
+          if (q.second.appear_percent >=
+                  m_config.method_profiles_appear_percent_threshold &&
+              q.first->is_def()) {
+            m_sufficiently_popular_methods.insert(q.first->as_def());
           }
-          if (it->second.appear_percent >=
-              m_config.method_profiles_appear_percent_threshold) {
-            m_sufficiently_popular_methods.insert(method);
-          }
-        });
+        }
       }
     }
     if (m_config.relocate_non_true_virtual_methods) {
@@ -260,6 +262,7 @@ class ClassSplittingInterDexPlugin : public interdex::InterDexPassPlugin {
     DexClasses target_classes;
     std::unordered_set<const DexClass*> target_classes_set;
     size_t relocated_methods = 0;
+    size_t relocated_code_bytes = 0;
     // We iterate over the actually added set of classes.
     for (DexClass* cls : classes) {
       auto split_classes_it = m_split_classes.find(cls);
@@ -340,6 +343,8 @@ class ClassSplittingInterDexPlugin : public interdex::InterDexPassPlugin {
           m_methods_to_relocate.emplace_back(method, method_info.target_cls);
         }
         ++relocated_methods;
+        // Code units are two bytes each.
+        relocated_code_bytes += method->get_code()->sum_opcode_sizes() * 2;
         if (is_static(method)) {
           ++m_stats.relocated_static_methods;
         } else if (!method->is_virtual()) {
@@ -360,9 +365,10 @@ class ClassSplittingInterDexPlugin : public interdex::InterDexPassPlugin {
     }
 
     TRACE(CS, 2,
-          "[class splitting] Relocated {%zu} methods to {%zu} target classes "
-          "in this dex.",
-          relocated_methods, target_classes.size());
+          "[class splitting] Relocated {%zu} methods with about {%zu} bytes of "
+          "code to {%zu} target classes in this dex.",
+          relocated_methods, relocated_code_bytes, target_classes.size());
+    m_stats.relocated_code_bytes += relocated_code_bytes;
 
     m_target_classes_by_api_level.clear();
     m_split_classes.clear();
@@ -518,6 +524,8 @@ class ClassSplittingInterDexPlugin : public interdex::InterDexPassPlugin {
     m_mgr.incr_metric(METRIC_POPULAR_METHODS, m_stats.popular_methods);
     m_mgr.incr_metric(METRIC_RELOCATED_METHODS, m_methods_to_relocate.size());
     m_mgr.incr_metric(METRIC_TRAMPOLINES, m_methods_to_trampoline.size());
+    m_mgr.incr_metric(METRIC_RELOCATED_CODE_BYTES,
+                      m_stats.relocated_code_bytes);
 
     TRACE(CS, 2,
           "[class splitting] Relocated {%zu} methods and created {%zu} "
@@ -537,7 +545,7 @@ class ClassSplittingInterDexPlugin : public interdex::InterDexPassPlugin {
   }
 
  private:
-  std::unordered_set<DexMethod*> m_sufficiently_popular_methods;
+  std::unordered_set<const DexMethod*> m_sufficiently_popular_methods;
 
   struct RelocatableMethodInfo {
     DexClass* target_cls;
@@ -25,6 +25,10 @@ void ConstantPropagationPass::run_pass(DexStoresVector& stores,
   mgr.incr_metric("num_branch_propagated", stats.branches_removed);
   mgr.incr_metric("num_materialized_consts", stats.materialized_consts);
   mgr.incr_metric("num_throws", stats.throws);
+  mgr.incr_metric("fixpoint_node_visits", stats.fixpoint_node_visits);
+  mgr.incr_metric("fixpoint_widenings", stats.fixpoint_widenings);
+  mgr.incr_metric("max_fixpoint_iterations", stats.max_fixpoint_iterations);
+  mgr.incr_metric("max_fixpoint_us", stats.max_fixpoint_us);
 
   TRACE(CONSTP, 1, "num_branch_propagated: %d", stats.branches_removed);
   TRACE(CONSTP,
@@ -32,6 +36,10 @@ void ConstantPropagationPass::run_pass(DexStoresVector& stores,
         "num_moves_replaced_by_const_loads: %d",
         stats.materialized_consts);
   TRACE(CONSTP, 1, "num_throws: %d", stats.throws);
+  if (stats.slowest_fixpoint_method != nullptr) {
+    TRACE(CONSTP, 1, "slowest fixpoint: %zuus in %s", stats.max_fixpoint_us,
+          SHOW(stats.slowest_fixpoint_method));
+  }
 }
 
 static ConstantPropagationPass s_pass;
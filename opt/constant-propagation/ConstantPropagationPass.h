@@ -21,6 +21,7 @@ class ConstantPropagationPass : public Pass {
          true,
          m_config.transform.replace_moves_with_consts);
     bind("remove_dead_switch", true, m_config.transform.remove_dead_switch);
+    bind("use_sparse_analysis", false, m_config.use_sparse_analysis);
   }
 
   void run_pass(DexStoresVector& stores,
@@ -100,7 +100,8 @@ std::unique_ptr<FixpointIterator> PassImpl::analyze(
     const ImmutableAttributeAnalyzerState* immut_analyzer_state) {
   call_graph::Graph cg = call_graph::single_callee_graph(scope);
   auto fp_iter = std::make_unique<FixpointIterator>(
-      cg, AnalyzerGenerator(immut_analyzer_state));
+      cg, AnalyzerGenerator(immut_analyzer_state),
+      m_config.cache_intraprocedural_analyses);
   // Run the bootstrap. All field value and method return values are
   // represented by Top.
   fp_iter->run({{CURRENT_PARTITION_LABEL, ArgumentDomain()}});
@@ -207,8 +208,12 @@ void PassImpl::run(const DexStoresVector& stores) {
   std::unique_ptr<ImmutableAttributeAnalyzerState> immut_analyzer_state =
       std::make_unique<ImmutableAttributeAnalyzerState>();
   immutable_state::analyze_constructors(scope, immut_analyzer_state.get());
+  sparta::set_patricia_tree_hash_consing(m_config.hash_cons_environments);
   auto fp_iter = analyze(scope, immut_analyzer_state.get());
   optimize(scope, xstores, *fp_iter, immut_analyzer_state.get());
+  m_stats.analysis_cache_hits = fp_iter->cache_hits();
+  m_stats.analysis_cache_misses = fp_iter->cache_misses();
+  sparta::set_patricia_tree_hash_consing(false);
 }
 
 void PassImpl::run_pass(DexStoresVector& stores,
@@ -227,6 +232,8 @@ void PassImpl::run_pass(DexStoresVector& stores,
   mgr.incr_metric("added_param_const", m_transform_stats.added_param_const);
   mgr.incr_metric("constant_fields", m_stats.constant_fields);
   mgr.incr_metric("constant_methods", m_stats.constant_methods);
+  mgr.incr_metric("analysis_cache_hits", m_stats.analysis_cache_hits);
+  mgr.incr_metric("analysis_cache_misses", m_stats.analysis_cache_misses);
 }
 
 static PassImpl s_pass;
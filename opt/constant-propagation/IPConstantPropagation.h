@@ -27,6 +27,13 @@ class PassImpl : public Pass {
     // Setting this to zero means that all field values and return values will
     // be treated as Top.
     uint64_t max_heap_analysis_iterations{0};
+    // Hash-cons the abstract environments and memoize their joins, see
+    // sparta::set_patricia_tree_hash_consing().
+    bool hash_cons_environments{false};
+    // Reuse the intraprocedural analyses of methods whose inputs did not
+    // change between refinements of the WholeProgramState. This trades memory
+    // for time, see interprocedural::FixpointIterator.
+    bool cache_intraprocedural_analyses{false};
     std::unordered_set<const DexType*> field_black_list;
 
     Transform::Config transform;
@@ -49,6 +56,10 @@ class PassImpl : public Pass {
     bind("max_heap_analysis_iterations",
          UINT64_C(0),
          m_config.max_heap_analysis_iterations);
+    bind("hash_cons_environments", false, m_config.hash_cons_environments);
+    bind("cache_intraprocedural_analyses",
+         false,
+         m_config.cache_intraprocedural_analyses);
     bind("field_black_list",
          {},
          m_config.field_black_list,
@@ -83,6 +94,8 @@ class PassImpl : public Pass {
   struct Stats {
     size_t constant_fields{0};
     size_t constant_methods{0};
+    size_t analysis_cache_hits{0};
+    size_t analysis_cache_misses{0};
   } m_stats;
   Transform::Stats m_transform_stats;
   Config m_config;
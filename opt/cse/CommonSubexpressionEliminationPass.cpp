@@ -27,10 +27,15 @@ constexpr const char* METRIC_ELIMINATED_INSTRUCTIONS =
 constexpr const char* METRIC_MAX_VALUE_IDS = "max_value_ids";
 constexpr const char* METRIC_METHODS_USING_OTHER_TRACKED_LOCATION_BIT =
     "methods_using_other_tracked_location_bit";
+constexpr const char* METRIC_METHODS_SKIPPED = "num_methods_skipped";
+constexpr const char* METRIC_METHODS_USING_LOCAL_VALUE_NUMBERING =
+    "num_methods_using_local_value_numbering";
 constexpr const char* METRIC_INSTR_PREFIX = "instr_";
 constexpr const char* METRIC_METHOD_BARRIERS = "num_method_barriers";
 constexpr const char* METRIC_METHOD_BARRIERS_ITERATIONS =
     "num_method_barriers_iterations";
+constexpr const char* METRIC_METHOD_BARRIERS_CACHE_HITS =
+    "num_method_barriers_cache_hits";
 constexpr const char* METRIC_CONDITIONALLY_PURE_METHODS =
     "num_conditionally_pure_methods";
 constexpr const char* METRIC_CONDITIONALLY_PURE_METHODS_ITERATIONS =
@@ -60,7 +65,8 @@ void CommonSubexpressionEliminationPass::run_pass(DexStoresVector& stores,
   auto rstate_pure_method = get_rstate_pure_methods(scope);
   pure_methods.insert(rstate_pure_method.begin(), rstate_pure_method.end());
 
-  auto shared_state = SharedState(pure_methods);
+  auto shared_state =
+      SharedState(pure_methods, &shared_method_barriers_cache());
   shared_state.init_scope(scope);
 
   // The following default 'features' of copy propagation would only
@@ -122,10 +128,15 @@ void CommonSubexpressionEliminationPass::run_pass(DexStoresVector& stores,
   mgr.incr_metric(METRIC_MAX_VALUE_IDS, stats.max_value_ids);
   mgr.incr_metric(METRIC_METHODS_USING_OTHER_TRACKED_LOCATION_BIT,
                   stats.methods_using_other_tracked_location_bit);
+  mgr.incr_metric(METRIC_METHODS_SKIPPED, stats.methods_skipped);
+  mgr.incr_metric(METRIC_METHODS_USING_LOCAL_VALUE_NUMBERING,
+                  stats.methods_using_local_value_numbering);
   auto& shared_state_stats = shared_state.get_stats();
   mgr.incr_metric(METRIC_METHOD_BARRIERS, shared_state_stats.method_barriers);
   mgr.incr_metric(METRIC_METHOD_BARRIERS_ITERATIONS,
                   shared_state_stats.method_barriers_iterations);
+  mgr.incr_metric(METRIC_METHOD_BARRIERS_CACHE_HITS,
+                  shared_state_stats.method_barriers_cache_hits);
   mgr.incr_metric(METRIC_CONDITIONALLY_PURE_METHODS,
                   shared_state_stats.conditionally_pure_methods);
   mgr.incr_metric(METRIC_CONDITIONALLY_PURE_METHODS_ITERATIONS,
@@ -9,7 +9,6 @@
 
 #include <vector>
 
-#include "ConcurrentContainers.h"
 #include "Creators.h"
 #include "DexAccess.h"
 #include "DexClass.h"
@@ -67,9 +66,9 @@ void DedupStrings::run(DexStoresVector& stores) {
   }
 
   // For each string, figure out how many times it's loaded per dex
-  ConcurrentMap<DexString*, std::unordered_map<size_t, size_t>> occurrences =
-      get_occurrences(scope, methods_to_dex, perf_sensitive_methods,
-                      non_load_strings);
+  std::unordered_map<DexString*, std::unordered_map<size_t, size_t>>
+      occurrences = get_occurrences(scope, methods_to_dex,
+                                    perf_sensitive_methods, non_load_strings);
 
   // Use heuristics to determine which strings to dedup,
   // and figure out factory method details
@@ -274,18 +273,49 @@ void DedupStrings::gather_non_load_strings(
   strings->insert(lstring.begin(), lstring.end());
 }
 
-ConcurrentMap<DexString*, std::unordered_map<size_t, size_t>>
+namespace {
+
+// The const-string loads of one thread, merged once all methods have been
+// visited instead of contending on shared maps for every load.
+struct StringLoads {
+  // For each string, how many times it's loaded per dex.
+  std::unordered_map<DexString*, std::unordered_map<size_t, size_t>>
+      occurrences;
+  // For each string loaded by a perf-sensitive method, the dexes it's in.
+  std::unordered_map<DexString*, std::unordered_set<size_t>>
+      perf_sensitive_strings;
+
+  StringLoads& operator+=(const StringLoads& other) {
+    for (const auto& p : other.occurrences) {
+      auto& m = occurrences[p.first];
+      for (const auto& q : p.second) {
+        m[q.first] += q.second;
+      }
+    }
+    for (const auto& p : other.perf_sensitive_strings) {
+      perf_sensitive_strings[p.first].insert(p.second.begin(),
+                                             p.second.end());
+    }
+    return *this;
+  }
+};
+
+} // namespace
+
+std::unordered_map<DexString*, std::unordered_map<size_t, size_t>>
 DedupStrings::get_occurrences(
     const Scope& scope,
     const std::unordered_map<const DexMethod*, size_t>& methods_to_dex,
     const std::unordered_set<const DexMethod*>& perf_sensitive_methods,
     std::unordered_set<const DexString*> non_load_strings[]) {
   // For each string, figure out how many times it's loaded per dex
-  ConcurrentMap<DexString*, std::unordered_map<size_t, size_t>> occurrences;
-  ConcurrentMap<DexString*, std::unordered_set<size_t>> perf_sensitive_strings;
-  walk::parallel::code(
-      scope, [&occurrences, &perf_sensitive_strings, &methods_to_dex,
-              &perf_sensitive_methods](DexMethod* method, IRCode& code) {
+  auto loads = walk::parallel::methods<StringLoads>(
+      scope, [&methods_to_dex, &perf_sensitive_methods](DexMethod* method,
+                                                        StringLoads* acc) {
+        auto code = method->get_code();
+        if (code == nullptr) {
+          return;
+        }
         const auto dexnr = methods_to_dex.at(method);
         const auto perf_sensitive = perf_sensitive_methods.count(method) != 0;
         for (auto& mie : InstructionIterable(code)) {
@@ -293,20 +323,15 @@ DedupStrings::get_occurrences(
           if (insn->opcode() == OPCODE_CONST_STRING) {
             const auto str = insn->get_string();
             if (perf_sensitive) {
-              perf_sensitive_strings.update(
-                  str,
-                  [dexnr](const DexString*,
-                          std::unordered_set<size_t>& s,
-                          bool /* exists */) { s.emplace(dexnr); });
+              acc->perf_sensitive_strings[str].emplace(dexnr);
             } else {
-              occurrences.update(str,
-                                 [dexnr](const DexString*,
-                                         std::unordered_map<size_t, size_t>& m,
-                                         bool /* exists */) { ++m[dexnr]; });
+              ++acc->occurrences[str][dexnr];
             }
           }
         }
       });
+  auto& occurrences = loads.occurrences;
+  const auto& perf_sensitive_strings = loads.perf_sensitive_strings;
 
   // Also, add all the strings that occurred in perf-sensitive methods
   // to the non_load_strings datastructure, as we won't attempt to dedup them.
@@ -323,13 +348,13 @@ DedupStrings::get_occurrences(
 
   m_stats.perf_sensitive_strings = perf_sensitive_strings.size();
   m_stats.non_perf_sensitive_strings = occurrences.size();
-  return occurrences;
+  return std::move(occurrences);
 }
 
 std::unordered_map<DexString*, DedupStrings::DedupStringInfo>
 DedupStrings::get_strings_to_dedup(
     DexClassesVector& dexen,
-    const ConcurrentMap<DexString*, std::unordered_map<size_t, size_t>>&
+    const std::unordered_map<DexString*, std::unordered_map<size_t, size_t>>&
         occurrences,
     std::unordered_map<const DexMethod*, size_t>& methods_to_dex,
     std::unordered_set<const DexMethod*>& perf_sensitive_methods,
@@ -358,7 +383,7 @@ DedupStrings::get_strings_to_dedup(
   std::sort(ordered_strings.begin(), ordered_strings.end(), compare_dexstrings);
   for (DexString* s : ordered_strings) {
     // We are going to look at the situation of a particular string here
-    const auto& m = occurrences.at_unsafe(s);
+    const auto& m = occurrences.at(s);
     always_assert(m.size() > 1);
     const auto entry_size = s->get_entry_size();
     const auto get_size_reduction = [entry_size, non_load_strings](
@@ -584,7 +609,7 @@ void DedupStrings::rewrite_const_string_instructions(
         // First, we collect all const-string instructions that we want to
         // rewrite
         const auto ii = InstructionIterable(code);
-        std::vector<std::pair<IRInstruction*, reg_t>> const_strings;
+        std::vector<std::pair<IRList::iterator, reg_t>> const_strings;
         for (auto it = ii.begin(); it != ii.end(); it++) {
           // do we have a sequence of const-string + move-pseudo-result
           // instruction?
@@ -594,7 +619,7 @@ void DedupStrings::rewrite_const_string_instructions(
           }
           auto move_result_pseudo = ir_list::move_result_pseudo_of(it.unwrap());
 
-          const_strings.push_back({insn, move_result_pseudo->dest()});
+          const_strings.push_back({it.unwrap(), move_result_pseudo->dest()});
         }
 
         // Second, we actually rewrite them.
@@ -613,10 +638,11 @@ void DedupStrings::rewrite_const_string_instructions(
 
         boost::optional<uint32_t> temp_reg;
         for (const auto& p : const_strings) {
-          const auto const_string = p.first;
+          const auto& const_string_it = p.first;
           const auto reg = p.second;
 
-          const auto it = strings_to_dedup.find(const_string->get_string());
+          const auto it =
+              strings_to_dedup.find(const_string_it->insn->get_string());
           if (it == strings_to_dedup.end()) {
             continue;
           }
@@ -646,8 +672,11 @@ void DedupStrings::rewrite_const_string_instructions(
           move_result_inst->set_dest(reg);
           replacements.push_back(move_result_inst);
 
-          // TODO: replace_opcode takes linear time!
-          code.replace_opcode(const_string, replacements);
+          for (auto replacement : replacements) {
+            code.insert_before(const_string_it, replacement);
+          }
+          // This also removes the move-result-pseudo.
+          code.remove_opcode(const_string_it);
         }
       });
 }
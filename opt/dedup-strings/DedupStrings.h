@@ -58,15 +58,16 @@ class DedupStrings {
       DexClass* host_cls, const std::vector<DexString*>& strings);
   void gather_non_load_strings(DexClasses& classes,
                                std::unordered_set<const DexString*>* strings);
-  ConcurrentMap<DexString*, std::unordered_map<size_t, size_t>> get_occurrences(
+  std::unordered_map<DexString*, std::unordered_map<size_t, size_t>>
+  get_occurrences(
       const Scope& scope,
       const std::unordered_map<const DexMethod*, size_t>& methods_to_dex,
       const std::unordered_set<const DexMethod*>& perf_sensitive_methods,
       std::unordered_set<const DexString*> non_load_strings[]);
   std::unordered_map<DexString*, DedupStringInfo> get_strings_to_dedup(
       DexClassesVector& dexen,
-      const ConcurrentMap<DexString*, std::unordered_map<size_t, size_t>>&
-          occurrences,
+      const std::unordered_map<DexString*,
+                               std::unordered_map<size_t, size_t>>& occurrences,
       std::unordered_map<const DexMethod*, size_t>& methods_to_dex,
       std::unordered_set<const DexMethod*>& perf_sensitive_methods,
       const std::unordered_set<const DexString*> non_load_strings[]);
@@ -16,6 +16,8 @@ class DedupBlocksPass : public Pass {
 
   void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
 
+  bool is_editable_cfg_friendly() const override { return true; }
+
   void bind_config() override {
     bind("method_black_list", {}, m_config.method_black_list);
     bind("block_split_min_opcode_count",
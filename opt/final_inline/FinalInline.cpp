@@ -50,20 +50,25 @@ class FinalInlineImpl {
   }
 
   std::unordered_set<DexField*> get_called_field_defs(const Scope& scope) {
-    std::vector<DexFieldRef*> field_refs;
-    walk::methods(
-        scope, [&](DexMethod* method) { method->gather_fields(field_refs); });
-    sort_unique(field_refs);
-    /* Okay, now we have a complete list of field refs
-     * for this particular dex.  Map to the def actually invoked.
+    using FieldDefs = std::unordered_set<DexField*>;
+    struct MergeFieldDefs {
+      void operator()(const FieldDefs& addend, FieldDefs* accumulator) const {
+        accumulator->insert(addend.begin(), addend.end());
+      }
+    };
+    /* Each thread maps the field refs of its methods to the defs actually
+     * invoked, and the sets of defs are merged at the end.
      */
-    std::unordered_set<DexField*> field_defs;
-    for (auto field_ref : field_refs) {
-      auto field_def = resolve_field(field_ref);
-      if (field_def == nullptr || !field_def->is_concrete()) continue;
-      field_defs.insert(field_def);
-    }
-    return field_defs;
+    return walk::parallel::methods<FieldDefs, MergeFieldDefs>(
+        scope, [](DexMethod* method, FieldDefs* field_defs) {
+          std::vector<DexFieldRef*> field_refs;
+          method->gather_fields(field_refs);
+          for (auto field_ref : field_refs) {
+            auto field_def = resolve_field(field_ref);
+            if (field_def == nullptr || !field_def->is_concrete()) continue;
+            field_defs->insert(field_def);
+          }
+        });
   }
 
   std::unordered_set<DexField*> get_field_target(
@@ -25,6 +25,7 @@
 #include "TypeSystem.h"
 #include "TypeUtil.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 /*
  * dx-generated class initializers often use verbose bytecode sequences to
@@ -56,6 +57,24 @@ namespace {
  * (JLS SE7 12.4.1 indicates that cycles are indeed allowed.) In that case,
  * this pass cannot safely optimize the static final constants.
  */
+template <typename Fn>
+void for_each_clinit_dependee(const DexClass* cls, const Fn& fn) {
+  auto clinit = cls->get_clinit();
+  if (clinit == nullptr || clinit->get_code() == nullptr) {
+    return;
+  }
+  for (auto& mie : InstructionIterable(clinit->get_code())) {
+    auto insn = mie.insn;
+    if (is_sget(insn->opcode())) {
+      auto dependee_cls = type_class(insn->get_field()->get_class());
+      if (dependee_cls == nullptr || dependee_cls == cls) {
+        continue;
+      }
+      fn(dependee_cls);
+    }
+  }
+}
+
 Scope reverse_tsort_by_clinit_deps(const Scope& scope) {
   std::unordered_set<const DexClass*> scope_set(scope.begin(), scope.end());
   Scope result;
@@ -69,19 +88,7 @@ Scope reverse_tsort_by_clinit_deps(const Scope& scope) {
       throw final_inline::class_initialization_cycle(cls);
     }
     visiting.emplace(cls);
-    auto clinit = cls->get_clinit();
-    if (clinit != nullptr && clinit->get_code() != nullptr) {
-      for (auto& mie : InstructionIterable(clinit->get_code())) {
-        auto insn = mie.insn;
-        if (is_sget(insn->opcode())) {
-          auto dependee_cls = type_class(insn->get_field()->get_class());
-          if (dependee_cls == nullptr || dependee_cls == cls) {
-            continue;
-          }
-          visit(dependee_cls);
-        }
-      }
-    }
+    for_each_clinit_dependee(cls, visit);
     visiting.erase(cls);
     result.emplace_back(cls);
     visited.emplace(cls);
@@ -92,6 +99,32 @@ Scope reverse_tsort_by_clinit_deps(const Scope& scope) {
   return result;
 }
 
+/*
+ * Splits the result of reverse_tsort_by_clinit_deps(...) into levels, such
+ * that the <clinit> of a class only depends on classes in earlier levels.
+ * The classes of one level can then be analyzed independently of each other.
+ * Each level keeps the relative order of the sorted scope.
+ */
+std::vector<Scope> split_into_clinit_levels(const Scope& sorted_scope) {
+  std::unordered_map<const DexClass*, size_t> level_of;
+  std::vector<Scope> levels;
+  for (DexClass* cls : sorted_scope) {
+    size_t level = 0;
+    for_each_clinit_dependee(cls, [&](const DexClass* dependee_cls) {
+      auto it = level_of.find(dependee_cls);
+      if (it != level_of.end()) {
+        level = std::max(level, it->second + 1);
+      }
+    });
+    level_of.emplace(cls, level);
+    if (level == levels.size()) {
+      levels.emplace_back();
+    }
+    levels[level].push_back(cls);
+  }
+  return levels;
+}
+
 /**
  * Similar to reverse_tsort_by_clinit_deps(...), but since we are currently
  * only dealing with instance field from class that only have one <init>
@@ -285,43 +318,59 @@ cp::WholeProgramState analyze_and_simplify_clinits(const Scope& scope,
                                                    const XStoreRefs* xstores) {
   const std::unordered_set<DexMethodRef*> pure_methods = get_pure_methods();
   cp::WholeProgramState wps;
-  for (DexClass* cls : reverse_tsort_by_clinit_deps(scope)) {
-    ConstantEnvironment env;
-    cp::set_encoded_values(cls, &env);
-    auto clinit = cls->get_clinit();
-    if (clinit != nullptr && clinit->get_code() != nullptr) {
-      auto* code = clinit->get_code();
-      code->build_cfg(/* editable */ false);
-      auto& cfg = code->cfg();
-      cfg.calculate_exit_block();
-      cp::intraprocedural::FixpointIterator intra_cp(
-          cfg,
-          CombinedAnalyzer(cls->get_type(), &wps, nullptr, nullptr, nullptr));
-      intra_cp.run(env);
-      env = intra_cp.get_exit_state_at(cfg.exit_block());
-
-      // Generate the new encoded_values and re-run the analysis.
-      encode_values(cls, env.get_field_environment(),
-                    gather_read_static_fields(cls), xstores);
-      auto fresh_env = ConstantEnvironment();
-      cp::set_encoded_values(cls, &fresh_env);
-      intra_cp.run(fresh_env);
-
-      // Detect any field writes made redundant by the new encoded_values and
-      // remove those sputs.
-      cp::Transform::Config transform_config;
-      transform_config.class_under_init = cls->get_type();
-      cp::Transform(transform_config)
-          .apply_on_uneditable_cfg(intra_cp, wps, code, xstores,
-                                   cls->get_type());
-      // Delete the instructions rendered dead by the removal of those sputs.
-      LocalDce(pure_methods).dce(code);
-      // If the clinit is empty now, delete it.
-      if (method::is_trivial_clinit(clinit)) {
-        cls->remove_method(clinit);
+  for (const auto& level :
+       split_into_clinit_levels(reverse_tsort_by_clinit_deps(scope))) {
+    // The classes of a level only read the static fields of earlier levels
+    // from the WholeProgramState, so they can be analyzed in parallel. The
+    // results are only collected once the whole level is done.
+    std::vector<ConstantEnvironment> envs(level.size());
+    auto wq = workqueue_foreach<size_t>([&](size_t i) {
+      DexClass* cls = level[i];
+      ConstantEnvironment env;
+      cp::set_encoded_values(cls, &env);
+      auto clinit = cls->get_clinit();
+      if (clinit != nullptr && clinit->get_code() != nullptr) {
+        auto* code = clinit->get_code();
+        code->build_cfg(/* editable */ false);
+        auto& cfg = code->cfg();
+        cfg.calculate_exit_block();
+        cp::intraprocedural::FixpointIterator intra_cp(
+            cfg,
+            CombinedAnalyzer(cls->get_type(), &wps, nullptr, nullptr,
+                             nullptr));
+        intra_cp.run(env);
+        env = intra_cp.get_exit_state_at(cfg.exit_block());
+
+        // Generate the new encoded_values and re-run the analysis.
+        encode_values(cls, env.get_field_environment(),
+                      gather_read_static_fields(cls), xstores);
+        auto fresh_env = ConstantEnvironment();
+        cp::set_encoded_values(cls, &fresh_env);
+        intra_cp.run(fresh_env);
+
+        // Detect any field writes made redundant by the new encoded_values
+        // and remove those sputs.
+        cp::Transform::Config transform_config;
+        transform_config.class_under_init = cls->get_type();
+        cp::Transform(transform_config)
+            .apply_on_uneditable_cfg(intra_cp, wps, code, xstores,
+                                     cls->get_type());
+        // Delete the instructions rendered dead by the removal of those sputs.
+        LocalDce(pure_methods).dce(code);
+        // If the clinit is empty now, delete it.
+        if (method::is_trivial_clinit(clinit)) {
+          cls->remove_method(clinit);
+        }
       }
+      envs[i] = env;
+    });
+    for (size_t i = 0; i < level.size(); ++i) {
+      wq.add_item(i);
+    }
+    wq.run_all();
+    for (size_t i = 0; i < level.size(); ++i) {
+      wps.collect_static_finals(level[i], envs[i].get_field_environment());
     }
-    wps.collect_static_finals(cls, env.get_field_environment());
   }
   return wps;
 }
@@ -331,6 +331,77 @@ void insert_invoke_static_call_bb(IRCode* code,
   }
 }
 
+// Instead of passing the bit vectors to an analysis method, merge them into
+// the preallocated stats array right before every return:
+//
+//  SGET_OBJECT Lcom/foo/Analysis;.sBasicBlockStats:[S
+//  IOPCODE_MOVE_RESULT_PSEUDO_OBJECT v_array
+//  For each bit vector <v_i>:
+//   CONST v_pos, method_id + i
+//   AGET_SHORT v_array, v_pos
+//   IOPCODE_MOVE_RESULT_PSEUDO v_tmp
+//   OR_INT v_tmp, v_tmp, v_i
+//   APUT_SHORT v_tmp, v_array, v_pos
+//
+// This avoids a call (and its frame setup) per method exit at the cost of a
+// few more code units. The read-modify-write isn't atomic, so concurrent
+// exits of the same method may lose bits; coverage doesn't require more than
+// that being rare.
+void insert_inline_stats_update_bb(IRCode* code,
+                                     size_t method_id,
+                                     DexField* stats_field,
+                                     const std::vector<reg_t>& reg_bb_vector) {
+  const bool is_short =
+      stats_field->get_type() == type::make_array_type(type::_short());
+  const IROpcode aget_op = is_short ? OPCODE_AGET_SHORT : OPCODE_AGET;
+  const IROpcode aput_op = is_short ? OPCODE_APUT_SHORT : OPCODE_APUT;
+
+  for (auto mie = code->begin(); mie != code->end(); ++mie) {
+    if (mie->type != MFLOW_OPCODE ||
+        (mie->insn->opcode() != OPCODE_RETURN &&
+         mie->insn->opcode() != OPCODE_RETURN_OBJECT &&
+         mie->insn->opcode() != OPCODE_RETURN_VOID)) {
+      continue;
+    }
+    const auto reg_array = code->allocate_temp();
+    const auto reg_pos = code->allocate_temp();
+    const auto reg_tmp = code->allocate_temp();
+    std::vector<IRInstruction*> insns;
+    insns.push_back(
+        (new IRInstruction(OPCODE_SGET_OBJECT))->set_field(stats_field));
+    insns.push_back(
+        (new IRInstruction(IOPCODE_MOVE_RESULT_PSEUDO_OBJECT))
+            ->set_dest(reg_array));
+    for (size_t i = 0; i < reg_bb_vector.size(); ++i) {
+      insns.push_back((new IRInstruction(OPCODE_CONST))
+                          ->set_literal(method_id + i)
+                          ->set_dest(reg_pos));
+      insns.push_back((new IRInstruction(aget_op))
+                          ->set_src(0, reg_array)
+                          ->set_src(1, reg_pos));
+      insns.push_back(
+          (new IRInstruction(IOPCODE_MOVE_RESULT_PSEUDO))->set_dest(reg_tmp));
+      insns.push_back((new IRInstruction(OPCODE_OR_INT))
+                          ->set_src(0, reg_tmp)
+                          ->set_src(1, reg_bb_vector[i])
+                          ->set_dest(reg_tmp));
+      insns.push_back((new IRInstruction(aput_op))
+                          ->set_src(0, reg_tmp)
+                          ->set_src(1, reg_array)
+                          ->set_src(2, reg_pos));
+    }
+
+    // Like the invokes, keep the array accesses out of any enclosing try
+    // block so no throw edges are added.
+    auto catch_block = find_try_block(code, mie);
+    insert_try_end_instr(code, mie, catch_block);
+    for (auto* insn : insns) {
+      code->insert_before(mie, insn);
+    }
+    insert_try_start_instr(code, mie, catch_block);
+  }
+}
+
 IRList::iterator find_or_insn_insert_point(cfg::Block* block) {
   // After every invoke instruction, the value returned from the function is
   // moved to a register. The instruction used to move depends on the type of
@@ -371,7 +442,8 @@ int instrument_onBasicBlockBegin(
     int& num_blocks_instrumented,
     int& all_methods_inst,
     std::map<int, std::pair<std::string, int>>& method_id_name_map,
-    std::map<size_t, int>& bb_vector_stat) {
+    std::map<size_t, int>& bb_vector_stat,
+    DexField* inline_stats_field) {
   assert(code != nullptr);
 
   code->build_cfg(/* editable */ false);
@@ -405,12 +477,18 @@ int instrument_onBasicBlockBegin(
   // before actual instrumentation to get the updated CFG after adding edges to
   // this invoke call. The INVOKE call takes (num_vectors + 1) arguments:
   // Method ID (actually, the short array offset) and bit vectors * n.
-  size_t index_to_method = (num_vectors > 5) ? 1 : num_vectors + 1;
+  // With an inline stats field, the vectors are written to it directly.
   ++bb_vector_stat[num_vectors];
-  assert(method_onMethodExit_map.count(index_to_method));
-  insert_invoke_static_call_bb(code, method_id,
-                               method_onMethodExit_map.at(index_to_method),
-                               reg_bb_vector);
+  if (inline_stats_field != nullptr) {
+    insert_inline_stats_update_bb(code, method_id, inline_stats_field,
+                                  reg_bb_vector);
+  } else {
+    size_t index_to_method = (num_vectors > 5) ? 1 : num_vectors + 1;
+    assert(method_onMethodExit_map.count(index_to_method));
+    insert_invoke_static_call_bb(code, method_id,
+                                 method_onMethodExit_map.at(index_to_method),
+                                 reg_bb_vector);
+  }
 
   for (cfg::Block* block : blocks) {
     const size_t block_vector_index = block->id() / 15;
@@ -1073,15 +1151,37 @@ void do_simple_method_tracing(DexClass* analysis_cls,
 //                                                     |   Return              |
 //                                                     +-----------------------+
 //
+// With "inline_stats", there is no analysis method: the vectors are OR-ed
+// into sBasicBlockStats (a short[] or int[]) right before each return.
+//
 void do_basic_block_tracing(DexClass* analysis_cls,
                             DexStoresVector& stores,
                             ConfigFiles& cfg,
                             PassManager& pm,
                             const InstrumentPass::Options& options) {
-  const auto& method_onMethodExit_map = find_and_verify_analysis_method(
-      *analysis_cls, options.analysis_method_name);
+  std::unordered_map<int, DexMethod*> method_onMethodExit_map;
+  DexField* inline_stats_field = nullptr;
+  if (options.inline_stats) {
+    inline_stats_field =
+        analysis_cls->find_field_from_simple_deobfuscated_name(
+            "sBasicBlockStats");
+    always_assert_log(inline_stats_field != nullptr &&
+                          is_static(inline_stats_field) &&
+                          (inline_stats_field->get_type() ==
+                               type::make_array_type(type::_short()) ||
+                           inline_stats_field->get_type() ==
+                               type::make_array_type(type::_int())),
+                      "inline_stats needs a static short[] or int[] "
+                      "sBasicBlockStats in %s",
+                      SHOW(analysis_cls));
+  } else {
+    method_onMethodExit_map = find_and_verify_analysis_method(
+        *analysis_cls, options.analysis_method_name);
+  }
 
   size_t method_index = 1;
+  size_t original_code_units = 0;
+  size_t instrumented_code_units = 0;
   int all_bb_nums = 0;
   int all_methods = 0;
   int all_bb_inst = 0;
@@ -1090,7 +1190,7 @@ void do_basic_block_tracing(DexClass* analysis_cls,
       method_id_name_map;
   auto scope = build_class_scope(stores);
 
-  auto interdex_list = cfg.get_coldstart_classes();
+  const auto& interdex_list = cfg.get_coldstart_classes();
   std::unordered_set<std::string> cold_start_classes;
   std::string dex_end_marker0("LDexEndMarker0;");
   for (auto class_string : interdex_list) {
@@ -1129,9 +1229,12 @@ void do_basic_block_tracing(DexClass* analysis_cls,
 
     TRACE(INSTRUMENT, 9, "Whitelist: included: %s", SHOW(method));
     all_methods++;
+    original_code_units += code.sum_opcode_sizes();
     method_index = instrument_onBasicBlockBegin(
         &code, method, method_onMethodExit_map, method_index, all_bb_nums,
-        all_bb_inst, all_method_inst, method_id_name_map, bb_vector_stat);
+        all_bb_inst, all_method_inst, method_id_name_map, bb_vector_stat,
+        inline_stats_field);
+    instrumented_code_units += code.sum_opcode_sizes();
   });
   patch_array_size(analysis_cls, "sBasicBlockStats", method_index);
 
@@ -1151,6 +1254,24 @@ void do_basic_block_tracing(DexClass* analysis_cls,
         "Instrumented %d methods and %d blocks, out of %d methods and %d "
         "blocks",
         (all_method_inst - 1), all_bb_inst, all_methods, all_bb_nums);
+
+  // Report the instrumentation's own overhead. The code size is measured
+  // before register allocation, so it's a lower bound. At runtime, every
+  // executed block costs one or-int/lit16, and every method exit either one
+  // call or, with inline_stats, a handful of array accesses per vector.
+  const size_t added_code_units = instrumented_code_units - original_code_units;
+  TRACE(INSTRUMENT, 1,
+        "Instrumentation added %zu code units to %zu (%.2lf%%) with %s exits",
+        added_code_units, original_code_units,
+        original_code_units == 0
+            ? 0.
+            : (double)added_code_units * 100. / original_code_units,
+        options.inline_stats ? "inline" : "invoke");
+  pm.incr_metric("instrumented_methods", all_method_inst);
+  pm.incr_metric("instrumented_blocks", all_bb_inst);
+  pm.incr_metric("original_code_units", original_code_units);
+  pm.incr_metric("added_code_units", added_code_units);
+  pm.incr_metric("stats_array_size", method_index);
 }
 
 std::unordered_set<std::string> load_blacklist_file(
@@ -1183,6 +1304,9 @@ void InstrumentPass::bind_config() {
   bind("num_stats_per_method", {1}, m_options.num_stats_per_method);
   bind("num_shards", {1}, m_options.num_shards);
   bind("only_cold_start_class", true, m_options.only_cold_start_class);
+  bind("inline_stats", false, m_options.inline_stats,
+       "For basic_block_tracing, update the sBasicBlockStats array inline at "
+       "method exits instead of calling the analysis method.");
   bind("methods_replacement", {}, m_options.methods_replacement,
        "Replacing instance method call with static method call.",
        Configurable::bindflags::methods::error_if_unresolvable);
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "ClassReferencesCache.h"
+
+#include "DexUtil.h"
+#include "WorkQueue.h"
+
+namespace interdex {
+
+ClassReferences::ClassReferences(const DexClass* cls) {
+  cls->gather_methods(method_refs);
+  cls->gather_fields(field_refs);
+  cls->gather_types(types);
+  cls->gather_strings(strings);
+
+  // remove duplicates to speed up actual sorting
+  sort_unique(method_refs);
+  sort_unique(field_refs);
+  sort_unique(types);
+  sort_unique(strings);
+
+  // sort deterministically
+  std::sort(method_refs.begin(), method_refs.end(), compare_dexmethods);
+  std::sort(field_refs.begin(), field_refs.end(), compare_dexfields);
+  std::sort(types.begin(), types.end(), compare_dextypes);
+  std::sort(strings.begin(), strings.end(), compare_dexstrings);
+}
+
+void ClassReferencesCache::prefill(const std::vector<DexClass*>& classes) {
+  auto wq = workqueue_foreach<DexClass*>([&](DexClass* cls) {
+    m_cache.insert(
+        std::make_pair(cls, std::make_shared<const ClassReferences>(cls)));
+  });
+  for (auto cls : classes) {
+    wq.add_item(cls);
+  }
+  wq.run_all();
+}
+
+std::shared_ptr<const ClassReferences> ClassReferencesCache::get(
+    const DexClass* cls) {
+  auto refs = m_cache.get(cls, nullptr);
+  if (refs == nullptr) {
+    refs = std::make_shared<const ClassReferences>(cls);
+    m_cache.insert(std::make_pair(cls, refs));
+  }
+  return refs;
+}
+
+} // namespace interdex
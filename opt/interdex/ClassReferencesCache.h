@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "ConcurrentContainers.h"
+#include "DexClass.h"
+
+namespace interdex {
+
+/*
+ * The method, field, type and string refs of a class, unique and sorted
+ * deterministically.
+ */
+struct ClassReferences {
+  explicit ClassReferences(const DexClass* cls);
+
+  std::vector<DexMethodRef*> method_refs;
+  std::vector<DexFieldRef*> field_refs;
+  std::vector<DexType*> types;
+  std::vector<DexString*> strings;
+};
+
+/*
+ * InterDex and the cross-dex-ref minimizer look at the refs of each class
+ * several times: when sampling, when inserting, for each packing trial and
+ * whenever a class overflows a dex. This caches them, so that each class is
+ * only walked once as long as it doesn't change.
+ *
+ * Whoever changes a class must invalidate it. Concurrent accesses are safe.
+ */
+class ClassReferencesCache {
+ public:
+  // Computes the refs of the given classes in parallel.
+  void prefill(const std::vector<DexClass*>& classes);
+
+  std::shared_ptr<const ClassReferences> get(const DexClass* cls);
+
+  void invalidate(const DexClass* cls) { m_cache.erase(cls); }
+
+ private:
+  ConcurrentMap<const DexClass*, std::shared_ptr<const ClassReferences>>
+      m_cache;
+};
+
+} // namespace interdex
@@ -67,17 +67,25 @@ uint64_t CrossDexRefMinimizer::ClassInfo::get_priority() const {
   return (primary_priority << 24) | secondary_priority;
 }
 
-void CrossDexRefMinimizer::reprioritize(
-    const std::unordered_map<DexClass*, CrossDexRefMinimizer::ClassInfoDelta>&
-        affected_classes) {
+CrossDexRefMinimizer::ClassInfoDelta& CrossDexRefMinimizer::get_delta(
+    uint32_t index) {
+  auto& delta = m_deltas[index];
+  if (!delta.affected) {
+    delta.affected = true;
+    m_affected_classes.push_back(index);
+  }
+  return delta;
+}
+
+void CrossDexRefMinimizer::reprioritize() {
   TRACE(IDEX, 4, "[dex ordering] Reprioritizing %u classes",
-        affected_classes.size());
-  for (auto p : affected_classes) {
+        m_affected_classes.size());
+  for (auto index : m_affected_classes) {
     ++m_stats.reprioritizations;
-    DexClass* affected_class = p.first;
-    CrossDexRefMinimizer::ClassInfoDelta& delta = p.second;
+    CrossDexRefMinimizer::ClassInfoDelta& delta = m_deltas[index];
     CrossDexRefMinimizer::ClassInfo& affected_class_info =
-        m_class_infos.at(affected_class);
+        m_class_infos[index];
+    always_assert(!affected_class_info.erased);
     affected_class_info.applied_refs_weight += delta.applied_refs_weight;
     for (size_t i = 0; i < INFREQUENT_REFS_COUNT; ++i) {
       affected_class_info.infrequent_refs_weight[i] +=
@@ -85,42 +93,26 @@ void CrossDexRefMinimizer::reprioritize(
     }
 
     const auto priority = affected_class_info.get_priority();
-    m_prioritized_classes.update_priority(affected_class, priority);
+    // Deltas often cancel out, e.g. when a ref moves from one infrequent
+    // bucket to the next, so the queue doesn't always need to change.
+    if (priority != affected_class_info.priority) {
+      m_prioritized_classes.update_priority(affected_class_info.cls, priority);
+      affected_class_info.priority = priority;
+    }
     TRACE(
         IDEX, 5,
         "[dex ordering] Reprioritized class {%s} with priority %016lx; "
         "index %u; %u (delta %d) applied refs weight, %s (delta %s) infrequent "
         "refs weights, %u total refs",
-        SHOW(affected_class), priority, affected_class_info.index,
+        SHOW(affected_class_info.cls), priority, affected_class_info.index,
         affected_class_info.applied_refs_weight, delta.applied_refs_weight,
         format_infrequent_refs_array(affected_class_info.infrequent_refs_weight)
             .c_str(),
         format_infrequent_refs_array(delta.infrequent_refs_weight).c_str(),
         affected_class_info.refs.size());
+    delta = CrossDexRefMinimizer::ClassInfoDelta();
   }
-}
-
-void CrossDexRefMinimizer::gather_refs(DexClass* cls,
-                                       std::vector<DexMethodRef*>& method_refs,
-                                       std::vector<DexFieldRef*>& field_refs,
-                                       std::vector<DexType*>& types,
-                                       std::vector<DexString*>& strings) {
-  cls->gather_methods(method_refs);
-  cls->gather_fields(field_refs);
-  cls->gather_types(types);
-  cls->gather_strings(strings);
-
-  // remove duplicates to speed up actual sorting
-  sort_unique(method_refs);
-  sort_unique(field_refs);
-  sort_unique(types);
-  sort_unique(strings);
-
-  // sort deterministically
-  std::sort(method_refs.begin(), method_refs.end(), compare_dexmethods);
-  std::sort(field_refs.begin(), field_refs.end(), compare_dexfields);
-  std::sort(types.begin(), types.end(), compare_dextypes);
-  std::sort(strings.begin(), strings.end(), compare_dexstrings);
+  m_affected_classes.clear();
 }
 
 void CrossDexRefMinimizer::ignore(DexClass* cls) {
@@ -131,11 +123,11 @@ void CrossDexRefMinimizer::ignore(DexClass* cls) {
 }
 
 void CrossDexRefMinimizer::sample(DexClass* cls) {
-  std::vector<DexMethodRef*> method_refs;
-  std::vector<DexFieldRef*> field_refs;
-  std::vector<DexType*> types;
-  std::vector<DexString*> strings;
-  gather_refs(cls, method_refs, field_refs, types, strings);
+  auto class_refs = m_class_references_cache->get(cls);
+  const auto& method_refs = class_refs->method_refs;
+  const auto& field_refs = class_refs->field_refs;
+  const auto& types = class_refs->types;
+  const auto& strings = class_refs->strings;
   auto increment = [& ref_counts = m_ref_counts,
                     &max_ref_count = m_max_ref_count](void* ref) {
     size_t& count = ref_counts[ref];
@@ -158,22 +150,24 @@ void CrossDexRefMinimizer::sample(DexClass* cls) {
 }
 
 void CrossDexRefMinimizer::insert(DexClass* cls) {
-  always_assert(m_class_infos.count(cls) == 0);
+  uint32_t index = m_class_infos.size();
+  auto inserted = m_class_indices.emplace(cls, index).second;
+  always_assert(inserted);
   ++m_stats.classes;
-  CrossDexRefMinimizer::ClassInfo& class_info =
-      m_class_infos
-          .insert({cls, CrossDexRefMinimizer::ClassInfo(m_next_index++)})
-          .first->second;
+  ++m_remaining_classes;
+  m_class_infos.emplace_back(cls, index);
+  m_deltas.emplace_back();
+  CrossDexRefMinimizer::ClassInfo& class_info = m_class_infos.back();
 
   // Collect all relevant references that contribute to cross-dex metadata
   // entries.
   // We don't bother with protos and type_lists, as they are directly related
   // to method refs (I tried, didn't help).
-  std::vector<DexMethodRef*> method_refs;
-  std::vector<DexFieldRef*> field_refs;
-  std::vector<DexType*> types;
-  std::vector<DexString*> strings;
-  gather_refs(cls, method_refs, field_refs, types, strings);
+  auto class_refs = m_class_references_cache->get(cls);
+  const auto& method_refs = class_refs->method_refs;
+  const auto& field_refs = class_refs->field_refs;
+  const auto& types = class_refs->types;
+  const auto& strings = class_refs->strings;
 
   auto& refs = class_info.refs;
   refs.reserve(method_refs.size() + field_refs.size() + types.size() +
@@ -183,8 +177,8 @@ void CrossDexRefMinimizer::insert(DexClass* cls) {
 
   auto add_weight = [& ref_counts = m_ref_counts,
                      max_ref_count = m_max_ref_count, &refs, &refs_weight,
-                     &seed_weight](void* ref, size_t item_weight,
-                                   size_t item_seed_weight) {
+                     &seed_weight, this](void* ref, size_t item_weight,
+                                         size_t item_seed_weight) {
     auto it = ref_counts.find(ref);
     auto ref_count = it == ref_counts.end() ? 1 : it->second;
     double frequency = ref_count * 1.0 / max_ref_count;
@@ -196,7 +190,12 @@ void CrossDexRefMinimizer::insert(DexClass* cls) {
     TRACE(IDEX, 6, "[dex ordering] %zu/%zu = %lf %s", ref_count, max_ref_count,
           frequency, skipping ? "(skipping)" : "");
     if (!skipping) {
-      refs.emplace_back(ref, item_weight);
+      auto p = m_ref_indices.emplace(ref, m_ref_indices.size());
+      if (p.second) {
+        m_ref_classes.emplace_back();
+        m_ref_applied_epochs.push_back(0);
+      }
+      refs.emplace_back(p.first->second, item_weight);
       refs_weight += item_weight;
       seed_weight += item_seed_weight;
     }
@@ -220,10 +219,8 @@ void CrossDexRefMinimizer::insert(DexClass* cls) {
     add_weight(fref, m_config.field_ref_weight, m_config.field_seed_weight);
   }
 
-  std::unordered_map<DexClass*, CrossDexRefMinimizer::ClassInfoDelta>
-      affected_classes;
-  for (const std::pair<void*, uint32_t>& p : refs) {
-    void* ref = p.first;
+  for (const std::pair<uint32_t, uint32_t>& p : refs) {
+    uint32_t ref = p.first;
     uint32_t weight = p.second;
     auto& classes = m_ref_classes[ref];
     size_t frequency = classes.size();
@@ -231,10 +228,10 @@ void CrossDexRefMinimizer::insert(DexClass* cls) {
     // infrequent ref. The actual undoing happens later in
     // reprioritize.
     if (frequency > 0 && frequency <= INFREQUENT_REFS_COUNT) {
-      for (DexClass* affected_class : classes) {
-        always_assert(affected_class != cls);
-        affected_classes[affected_class]
-            .infrequent_refs_weight[frequency - 1] -= weight;
+      for (uint32_t affected_class : classes) {
+        always_assert(affected_class != index);
+        get_delta(affected_class).infrequent_refs_weight[frequency - 1] -=
+            weight;
       }
     }
     ++frequency;
@@ -244,27 +241,28 @@ void CrossDexRefMinimizer::insert(DexClass* cls) {
     // class_info.get_priority() call, while all other change requests happen
     // later in reprioritize.
     if (frequency <= INFREQUENT_REFS_COUNT) {
-      for (DexClass* affected_class : classes) {
-        affected_classes[affected_class]
-            .infrequent_refs_weight[frequency - 1] += weight;
+      for (uint32_t affected_class : classes) {
+        get_delta(affected_class).infrequent_refs_weight[frequency - 1] +=
+            weight;
       }
       class_info.infrequent_refs_weight[frequency - 1] += weight;
     }
 
-    // There's an implicit invariant that class_info and the keys of
-    // affected_classes are disjoint, so we are not going to reprioritize
+    // There's an implicit invariant that class_info and the affected
+    // classes are disjoint, so we are not going to reprioritize
     // the class that we are adding here.
-    classes.emplace(cls);
+    classes.push_back(index);
   }
   const auto priority = class_info.get_priority();
   m_prioritized_classes.insert(cls, priority);
+  class_info.priority = priority;
   TRACE(IDEX, 4,
         "[dex ordering] Inserting class {%s} with priority %016lx; index %u; "
         "%s infrequent refs weights, %u total refs",
         SHOW(cls), priority, class_info.index,
         format_infrequent_refs_array(class_info.infrequent_refs_weight).c_str(),
         refs.size());
-  reprioritize(affected_classes);
+  reprioritize();
 }
 
 bool CrossDexRefMinimizer::empty() const {
@@ -276,49 +274,45 @@ DexClass* CrossDexRefMinimizer::front() const {
 }
 
 DexClass* CrossDexRefMinimizer::worst(bool generated) {
-  auto max_it = m_class_infos.end();
+  const CrossDexRefMinimizer::ClassInfo* max_class_info = nullptr;
   uint64_t max_value = 0;
 
-  for (auto it = m_class_infos.begin(); it != m_class_infos.end(); ++it) {
+  for (const auto& class_info : m_class_infos) {
+    if (class_info.erased) {
+      continue;
+    }
     // If requested, let's skip generated classes, as they tend to be not stable
     // and may cause drastic build-over-build changes.
-    if (it->first->rstate.is_generated() != generated) {
+    if (class_info.cls->rstate.is_generated() != generated) {
       continue;
     }
 
-    const CrossDexRefMinimizer::ClassInfo& class_info = it->second;
     uint64_t value = class_info.seed_weight;
 
-    // Prefer the largest denominator
-    if (value < max_value) {
+    // Prefer the largest denominator. If equal, prefer the class that was
+    // inserted earlier (smaller index) to make things deterministic.
+    if (max_class_info != nullptr && value <= max_value) {
       continue;
     }
 
-    // If equal, prefer the class that was inserted earlier (smaller index) to
-    // make things deterministic.
-    if (value == max_value && max_it != m_class_infos.end() &&
-        class_info.index > max_it->second.index) {
-      continue;
-    }
-
-    max_it = it;
+    max_class_info = &class_info;
     max_value = value;
   }
 
-  if (max_it == m_class_infos.end()) {
+  if (max_class_info == nullptr) {
     return nullptr;
   }
 
   TRACE(IDEX, 3,
         "[dex ordering] Picked worst class {%s} with seed %u; "
         "index %u",
-        SHOW(max_it->first), max_value, max_it->second.index);
-  m_stats.worst_classes.emplace_back(max_it->first, max_value);
-  return max_it->first;
+        SHOW(max_class_info->cls), max_value, max_class_info->index);
+  m_stats.worst_classes.emplace_back(max_class_info->cls, max_value);
+  return max_class_info->cls;
 }
 
 DexClass* CrossDexRefMinimizer::worst() {
-  always_assert(!m_class_infos.empty());
+  always_assert(m_remaining_classes > 0);
   // We prefer to find a class that is not generated. Only when such a class
   // doesn't exist (because all classes are generated), then we pick the worst
   // generated class.
@@ -332,9 +326,11 @@ DexClass* CrossDexRefMinimizer::worst() {
 
 void CrossDexRefMinimizer::erase(DexClass* cls, bool emitted, bool reset) {
   m_prioritized_classes.erase(cls);
-  auto class_info_it = m_class_infos.find(cls);
-  always_assert(class_info_it != m_class_infos.end());
-  const CrossDexRefMinimizer::ClassInfo& class_info = class_info_it->second;
+  auto index_it = m_class_indices.find(cls);
+  always_assert(index_it != m_class_indices.end());
+  uint32_t index = index_it->second;
+  CrossDexRefMinimizer::ClassInfo& class_info = m_class_infos[index];
+  always_assert(!class_info.erased);
   TRACE(IDEX, 3,
         "[dex ordering] Processing class {%s} with priority %016lx; "
         "index %u; %u applied refs weight, %s infrequent refs weights, %u "
@@ -344,74 +340,80 @@ void CrossDexRefMinimizer::erase(DexClass* cls, bool emitted, bool reset) {
         format_infrequent_refs_array(class_info.infrequent_refs_weight).c_str(),
         class_info.refs.size(), emitted);
 
-  // Updating m_applied_refs and m_ref_classes,
+  // Updating the applied refs and m_ref_classes,
   // and gathering information on how this affects other classes
 
   if (reset) {
     TRACE(IDEX, 3, "[dex ordering] Reset");
     ++m_stats.resets;
-    m_applied_refs.clear();
+    ++m_epoch;
+    m_applied_refs = 0;
   }
 
-  std::unordered_map<DexClass*, CrossDexRefMinimizer::ClassInfoDelta>
-      affected_classes;
   const auto& refs = class_info.refs;
-  size_t old_applied_refs = m_applied_refs.size();
-  for (const std::pair<void*, uint32_t>& p : refs) {
-    void* ref = p.first;
+  size_t old_applied_refs = m_applied_refs;
+  for (const std::pair<uint32_t, uint32_t>& p : refs) {
+    uint32_t ref = p.first;
     uint32_t weight = p.second;
-    auto& classes = m_ref_classes.at(ref);
+    auto& classes = m_ref_classes[ref];
     size_t frequency = classes.size();
     always_assert(frequency > 0);
-    const auto erased = classes.erase(cls);
-    always_assert(erased);
+    auto class_it = std::find(classes.begin(), classes.end(), index);
+    always_assert(class_it != classes.end());
+    *class_it = classes.back();
+    classes.pop_back();
     if (frequency <= INFREQUENT_REFS_COUNT) {
-      for (DexClass* affected_class : classes) {
-        affected_classes[affected_class]
-            .infrequent_refs_weight[frequency - 1] -= weight;
+      for (uint32_t affected_class : classes) {
+        get_delta(affected_class).infrequent_refs_weight[frequency - 1] -=
+            weight;
       }
     }
     --frequency;
     if (frequency > 0 && frequency <= INFREQUENT_REFS_COUNT) {
-      for (DexClass* affected_class : classes) {
-        affected_classes[affected_class]
-            .infrequent_refs_weight[frequency - 1] += weight;
+      for (uint32_t affected_class : classes) {
+        get_delta(affected_class).infrequent_refs_weight[frequency - 1] +=
+            weight;
       }
     }
 
     if (!emitted) {
       continue;
     }
-    if (m_applied_refs.count(ref) != 0) {
+    if (m_ref_applied_epochs[ref] == m_epoch) {
       continue;
     }
-    m_applied_refs.emplace(ref);
-    for (DexClass* affected_class : classes) {
-      affected_classes[affected_class].applied_refs_weight += weight;
+    m_ref_applied_epochs[ref] = m_epoch;
+    ++m_applied_refs;
+    for (uint32_t affected_class : classes) {
+      get_delta(affected_class).applied_refs_weight += weight;
     }
   }
 
   // Updating m_class_infos and m_prioritized_classes
 
-  m_class_infos.erase(class_info_it);
-  always_assert(m_class_infos.count(cls) == 0);
+  class_info.erased = true;
+  class_info.refs.clear();
+  class_info.refs.shrink_to_fit();
+  m_class_indices.erase(index_it);
+  --m_remaining_classes;
 
   if (reset) {
     m_prioritized_classes.clear();
-    for (auto it = m_class_infos.begin(); it != m_class_infos.end(); ++it) {
-      DexClass* reset_class = it->first;
-      CrossDexRefMinimizer::ClassInfo& reset_class_info = it->second;
+    for (auto& reset_class_info : m_class_infos) {
+      if (reset_class_info.erased) {
+        continue;
+      }
       reset_class_info.applied_refs_weight = 0;
       const auto priority = reset_class_info.get_priority();
-      m_prioritized_classes.insert(reset_class, priority);
-      always_assert(reset_class_info.applied_refs_weight == 0);
+      m_prioritized_classes.insert(reset_class_info.cls, priority);
+      reset_class_info.priority = priority;
     }
   }
   if (emitted) {
     TRACE(IDEX, 4, "[dex ordering] %u + %u = %u applied refs", old_applied_refs,
-          m_applied_refs.size() - old_applied_refs, m_applied_refs.size());
+          m_applied_refs - old_applied_refs, m_applied_refs);
   }
-  reprioritize(affected_classes);
+  reprioritize();
 }
 
 } // namespace interdex
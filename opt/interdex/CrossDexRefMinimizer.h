@@ -7,10 +7,12 @@
 
 #pragma once
 
+#include <memory>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
+#include "ClassReferencesCache.h"
 #include "DexClass.h"
 #include "MutablePriorityQueue.h"
 
@@ -78,51 +80,71 @@ struct CrossDexRefMinimizerConfig {
 // be the end of the world if an overflow ever happens.
 class CrossDexRefMinimizer {
   PrioritizedDexClasses m_prioritized_classes;
-  std::unordered_set<void*> m_applied_refs;
   struct ClassInfo {
+    DexClass* cls;
     uint32_t index;
     // This array stores (the weights of) how many of the *refs of this class
     // have only one, two, ... classes left that reference them.
     std::array<uint32_t, INFREQUENT_REFS_COUNT> infrequent_refs_weight;
-    std::vector<std::pair<void*, uint32_t>> refs;
+    // Pairs of ref indices and weights.
+    std::vector<std::pair<uint32_t, uint32_t>> refs;
     uint64_t refs_weight;
     uint64_t applied_refs_weight;
     uint64_t seed_weight{0};
-    explicit ClassInfo(uint32_t i)
-        : index(i),
+    // The priority with which the class is currently queued.
+    uint64_t priority{0};
+    bool erased{false};
+    ClassInfo(DexClass* c, uint32_t i)
+        : cls(c),
+          index(i),
           infrequent_refs_weight(),
           refs_weight(0),
           applied_refs_weight(0) {}
     uint64_t get_primary_priority_denominator() const;
     uint64_t get_priority() const;
   };
-  std::unordered_map<DexClass*, ClassInfo> m_class_infos;
-  uint32_t m_next_index{0};
-  std::unordered_map<void*, std::unordered_set<DexClass*>> m_ref_classes;
+  // All inserted classes, indexed by ClassInfo::index, including erased ones.
+  std::vector<ClassInfo> m_class_infos;
+  std::unordered_map<DexClass*, uint32_t> m_class_indices;
+  size_t m_remaining_classes{0};
+  // Refs get dense indices when they are first inserted. For each ref, we
+  // track the indices of the remaining classes that have it, and in which
+  // epoch it was applied last; resetting starts a new epoch.
+  std::unordered_map<void*, uint32_t> m_ref_indices;
+  std::vector<std::vector<uint32_t>> m_ref_classes;
+  std::vector<uint32_t> m_ref_applied_epochs;
+  uint32_t m_epoch{1};
+  size_t m_applied_refs{0};
   CrossDexRefMinimizerStats m_stats;
-  const CrossDexRefMinimizerConfig m_config;
+  CrossDexRefMinimizerConfig m_config;
 
   struct ClassInfoDelta {
     std::array<int32_t, INFREQUENT_REFS_COUNT> infrequent_refs_weight{};
     int64_t applied_refs_weight{0};
+    bool affected{false};
   };
+  // The deltas of the classes affected by the current insertion or erasure,
+  // indexed by ClassInfo::index, and the indices of the affected classes.
+  // Both are reused to avoid allocating for every class.
+  std::vector<ClassInfoDelta> m_deltas;
+  std::vector<uint32_t> m_affected_classes;
 
-  void reprioritize(
-      const std::unordered_map<DexClass*, ClassInfoDelta>& affected_classes);
+  ClassInfoDelta& get_delta(uint32_t index);
+  void reprioritize();
   DexClass* worst(bool generated);
 
   std::unordered_map<void*, size_t> m_ref_counts;
   size_t m_max_ref_count{0};
 
-  void gather_refs(DexClass* cls,
-                   std::vector<DexMethodRef*>& method_refs,
-                   std::vector<DexFieldRef*>& field_refs,
-                   std::vector<DexType*>& types,
-                   std::vector<DexString*>& strings);
+  std::shared_ptr<ClassReferencesCache> m_class_references_cache;
 
  public:
-  explicit CrossDexRefMinimizer(const CrossDexRefMinimizerConfig& config)
-      : m_config(config) {}
+  explicit CrossDexRefMinimizer(
+      const CrossDexRefMinimizerConfig& config,
+      std::shared_ptr<ClassReferencesCache> class_references_cache =
+          std::make_shared<ClassReferencesCache>())
+      : m_config(config),
+        m_class_references_cache(std::move(class_references_cache)) {}
   // Gather frequency counts; must be called for relevant classes before
   // inserting them
   void sample(DexClass* cls);
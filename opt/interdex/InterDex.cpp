@@ -8,6 +8,7 @@
 #include "InterDex.h"
 
 #include <boost/algorithm/string/predicate.hpp>
+#include <boost/optional.hpp>
 
 #include <algorithm>
 #include <string>
@@ -26,6 +27,7 @@
 #include "ReachableClasses.h"
 #include "StringUtil.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 #include "file-utils.h"
 
 namespace {
@@ -129,6 +131,7 @@ std::unordered_set<DexClass*> find_unrefenced_coldstart_classes(
 
 void gather_refs(
     const std::vector<std::unique_ptr<interdex::InterDexPassPlugin>>& plugins,
+    interdex::ClassReferencesCache& class_references_cache,
     const interdex::DexInfo& dex_info,
     const DexClass* cls,
     interdex::MethodRefs* mrefs,
@@ -136,12 +139,11 @@ void gather_refs(
     interdex::TypeRefs* trefs,
     std::vector<DexClass*>* erased_classes,
     bool should_not_relocate_methods_of_class) {
-  std::vector<DexMethodRef*> method_refs;
-  std::vector<DexFieldRef*> field_refs;
-  std::vector<DexType*> type_refs;
-  cls->gather_methods(method_refs);
-  cls->gather_fields(field_refs);
-  cls->gather_types(type_refs);
+  // Plugins may add refs, so they get a copy of the cached ones.
+  auto class_refs = class_references_cache.get(cls);
+  std::vector<DexMethodRef*> method_refs(class_refs->method_refs);
+  std::vector<DexFieldRef*> field_refs(class_refs->field_refs);
+  std::vector<DexType*> type_refs(class_refs->types);
 
   for (const auto& plugin : plugins) {
     plugin->gather_refs(dex_info, cls, method_refs, field_refs, type_refs,
@@ -153,6 +155,88 @@ void gather_refs(
   trefs->insert(type_refs.begin(), type_refs.end());
 }
 
+struct ClassRefs {
+  interdex::MethodRefs mrefs;
+  interdex::FieldRefs frefs;
+  interdex::TypeRefs trefs;
+};
+
+struct PackingTrialResult {
+  bool completed{false};
+  size_t num_dexes{0};
+  size_t num_refs{0};
+};
+
+/*
+ * Simulates emitting the given classes in the order chosen by a
+ * cross-dex-ref-minimizer with the given config, starting from a copy of the
+ * dexes structure. Plugins are not consulted, so that trials can run
+ * concurrently; this makes the result an estimate. The trial is abandoned once
+ * the classes it placed plus the reprioritizations of the minimizer exceed
+ * :work_budget.
+ */
+PackingTrialResult run_packing_trial(
+    const interdex::CrossDexRefMinimizerConfig& config,
+    const interdex::DexesStructure& dexes_structure,
+    const std::vector<DexClass*>& sampled_classes,
+    const std::vector<DexClass*>& classes_to_insert,
+    const std::unordered_map<DexClass*, ClassRefs>& class_refs,
+    const std::shared_ptr<interdex::ClassReferencesCache>&
+        class_references_cache,
+    size_t work_budget) {
+  PackingTrialResult result;
+  interdex::CrossDexRefMinimizer minimizer(config, class_references_cache);
+  for (DexClass* cls : sampled_classes) {
+    minimizer.sample(cls);
+  }
+  for (DexClass* cls : classes_to_insert) {
+    minimizer.sample(cls);
+  }
+  for (DexClass* cls : classes_to_insert) {
+    minimizer.insert(cls);
+  }
+
+  interdex::DexesStructure dexes = dexes_structure;
+  interdex::MethodRefs dex_mrefs;
+  interdex::FieldRefs dex_frefs;
+  interdex::TypeRefs dex_trefs;
+  size_t dexnum = dexes.get_num_dexes();
+  bool pick_worst = true;
+  for (size_t steps = 1; !minimizer.empty(); ++steps) {
+    // The work is counted rather than timed, so that whether a trial
+    // completes, and thus the dex layout, doesn't depend on machine load.
+    if (steps + minimizer.stats().reprioritizations > work_budget) {
+      return result;
+    }
+    DexClass* cls = pick_worst ? minimizer.worst() : minimizer.front();
+    const auto& refs = class_refs.at(cls);
+    if (!dexes.add_class_to_current_dex(refs.mrefs, refs.frefs, refs.trefs,
+                                        cls)) {
+      dexes.end_dex(interdex::DexInfo());
+      result.num_refs += dex_mrefs.size() + dex_frefs.size() + dex_trefs.size();
+      dex_mrefs.clear();
+      dex_frefs.clear();
+      dex_trefs.clear();
+      dexes.add_class_no_checks(refs.mrefs, refs.frefs, refs.trefs, cls);
+    }
+    dex_mrefs.insert(refs.mrefs.begin(), refs.mrefs.end());
+    dex_frefs.insert(refs.frefs.begin(), refs.frefs.end());
+    dex_trefs.insert(refs.trefs.begin(), refs.trefs.end());
+
+    size_t new_dexnum = dexes.get_num_dexes();
+    bool overflowed = dexnum != new_dexnum;
+    minimizer.erase(cls, /* emitted */ true, overflowed);
+    pick_worst = overflowed;
+    dexnum = new_dexnum;
+  }
+
+  result.completed = true;
+  result.num_dexes = dexes.get_num_dexes() +
+                     (dexes.get_current_dex_classes().empty() ? 0 : 1);
+  result.num_refs += dex_mrefs.size() + dex_frefs.size() + dex_trefs.size();
+  return result;
+}
+
 void print_stats(interdex::DexesStructure* dexes_structure) {
   TRACE(IDEX, 2, "InterDex Stats:");
   TRACE(IDEX, 2, "\t dex count: %d", dexes_structure->get_num_dexes());
@@ -273,8 +357,8 @@ bool InterDex::emit_class(DexInfo& dex_info,
   MethodRefs clazz_mrefs;
   FieldRefs clazz_frefs;
   TypeRefs clazz_trefs;
-  gather_refs(m_plugins, dex_info, clazz, &clazz_mrefs, &clazz_frefs,
-              &clazz_trefs, erased_classes,
+  gather_refs(m_plugins, *m_class_references_cache, dex_info, clazz,
+              &clazz_mrefs, &clazz_frefs, &clazz_trefs, erased_classes,
               should_not_relocate_methods_of_class(clazz));
 
   bool fits_current_dex = m_dexes_structure.add_class_to_current_dex(
@@ -290,8 +374,8 @@ bool InterDex::emit_class(DexInfo& dex_info,
     clazz_frefs.clear();
     clazz_trefs.clear();
     if (erased_classes) erased_classes->clear();
-    gather_refs(m_plugins, dex_info, clazz, &clazz_mrefs, &clazz_frefs,
-                &clazz_trefs, erased_classes,
+    gather_refs(m_plugins, *m_class_references_cache, dex_info, clazz,
+                &clazz_mrefs, &clazz_frefs, &clazz_trefs, erased_classes,
                 should_not_relocate_methods_of_class(clazz));
 
     m_dexes_structure.add_class_no_checks(clazz_mrefs, clazz_frefs, clazz_trefs,
@@ -628,6 +712,8 @@ void InterDex::init_cross_dex_ref_minimizer_and_relocate_methods() {
   }
 
   std::vector<DexClass*> classes_to_insert;
+  // Classes that are only sampled, as plugins will account for them.
+  std::vector<DexClass*> sampled_classes;
   // Emit classes using some algorithm to group together classes which
   // tend to share the same refs.
   for (DexClass* cls : m_scope) {
@@ -642,6 +728,7 @@ void InterDex::init_cross_dex_ref_minimizer_and_relocate_methods() {
         !should_not_relocate_methods_of_class(cls)) {
       std::vector<DexClass*> relocated_classes;
       m_cross_dex_relocator->relocate_methods(cls, relocated_classes);
+      m_class_references_cache->invalidate(cls);
       for (DexClass* relocated_cls : relocated_classes) {
         // Tell all plugins that the new class is now effectively part of the
         // scope.
@@ -663,12 +750,23 @@ void InterDex::init_cross_dex_ref_minimizer_and_relocate_methods() {
       // which is accounted for via the erased_classes reported through the
       // plugin's gather_refs callback. So we'll also sample those classes here.
       m_cross_dex_ref_minimizer.sample(cls);
+      sampled_classes.emplace_back(cls);
       continue;
     }
 
     classes_to_insert.emplace_back(cls);
   }
 
+  if (!m_cross_dex_ref_minimizer_trial_configs.empty()) {
+    if (m_cross_dex_relocator != nullptr) {
+      TRACE(IDEX, 2,
+            "[dex ordering] Not running packing trials, as the "
+            "cross-dex-relocator is active.");
+    } else {
+      pick_cross_dex_ref_minimizer_config(sampled_classes, classes_to_insert);
+    }
+  }
+
   // Initialize ref frequency counts
   for (DexClass* cls : classes_to_insert) {
     m_cross_dex_ref_minimizer.sample(cls);
@@ -681,6 +779,98 @@ void InterDex::init_cross_dex_ref_minimizer_and_relocate_methods() {
   }
 }
 
+boost::optional<size_t> pick_packing_trial(
+    const std::vector<CrossDexRefMinimizerConfig>& configs,
+    const DexesStructure& dexes_structure,
+    const std::vector<DexClass*>& sampled_classes,
+    const std::vector<DexClass*>& classes_to_insert,
+    const std::shared_ptr<ClassReferencesCache>& class_references_cache,
+    size_t work_budget) {
+  std::unordered_map<DexClass*, ClassRefs> class_refs;
+  for (DexClass* cls : classes_to_insert) {
+    class_refs[cls];
+  }
+  const std::vector<std::unique_ptr<InterDexPassPlugin>> no_plugins;
+  auto gather_wq = workqueue_foreach<DexClass*>([&](DexClass* cls) {
+    auto& refs = class_refs.at(cls);
+    gather_refs(no_plugins, *class_references_cache, DexInfo(), cls,
+                &refs.mrefs, &refs.frefs, &refs.trefs,
+                /* erased_classes */ nullptr,
+                /* should_not_relocate_methods_of_class */ false);
+  });
+  for (DexClass* cls : classes_to_insert) {
+    gather_wq.add_item(cls);
+  }
+  gather_wq.run_all();
+
+  std::vector<PackingTrialResult> results(configs.size());
+  auto trials_wq = workqueue_foreach<size_t>(
+      [&](size_t i) {
+        results[i] = run_packing_trial(configs[i], dexes_structure,
+                                       sampled_classes, classes_to_insert,
+                                       class_refs, class_references_cache,
+                                       work_budget);
+      },
+      std::max<size_t>(
+          1, std::min(configs.size(), redex_parallel::default_num_threads())));
+  for (size_t i = 0; i < configs.size(); ++i) {
+    trials_wq.add_item(i);
+  }
+  trials_wq.run_all();
+
+  boost::optional<size_t> best;
+  for (size_t i = 0; i < configs.size(); ++i) {
+    const auto& result = results[i];
+    if (!result.completed) {
+      TRACE(IDEX, 2, "[dex ordering] Packing trial %zu ran out of budget.", i);
+      continue;
+    }
+    TRACE(IDEX, 2, "[dex ordering] Packing trial %zu: %zu dexes, %zu refs.", i,
+          result.num_dexes, result.num_refs);
+    if (!best ||
+        std::make_pair(result.num_dexes, result.num_refs) <
+            std::make_pair(results[*best].num_dexes, results[*best].num_refs)) {
+      best = i;
+    }
+  }
+  return best;
+}
+
+void InterDex::pick_cross_dex_ref_minimizer_config(
+    const std::vector<DexClass*>& sampled_classes,
+    const std::vector<DexClass*>& classes_to_insert) {
+  // The first trial is the configured baseline; it wins all ties.
+  std::vector<CrossDexRefMinimizerConfig> configs{
+      m_cross_dex_ref_minimizer.get_config()};
+  configs.insert(configs.end(), m_cross_dex_ref_minimizer_trial_configs.begin(),
+                 m_cross_dex_ref_minimizer_trial_configs.end());
+
+  // The budget scales with the number of classes to place.
+  auto best = pick_packing_trial(
+      configs, m_dexes_structure, sampled_classes, classes_to_insert,
+      m_class_references_cache,
+      m_cross_dex_ref_minimizer_trial_work_per_class *
+          std::max<size_t>(1, classes_to_insert.size()));
+  if (!best || *best == 0) {
+    return;
+  }
+
+  const auto& config = configs[*best];
+  TRACE(IDEX, 2,
+        "[dex ordering] Picked packing trial %zu with method ref weight %d, "
+        "field ref weight %d, type ref weight %d, string ref weight %d, "
+        "method seed weight %d, field seed weight %d, type seed weight %d, "
+        "string seed weight %d.",
+        *best, config.method_ref_weight, config.field_ref_weight,
+        config.type_ref_weight, config.string_ref_weight,
+        config.method_seed_weight, config.field_seed_weight,
+        config.type_seed_weight, config.string_seed_weight);
+  m_cross_dex_ref_minimizer = CrossDexRefMinimizer(config);
+  for (DexClass* cls : sampled_classes) {
+    m_cross_dex_ref_minimizer.sample(cls);
+  }
+}
+
 void InterDex::emit_remaining_classes(DexInfo& dex_info) {
   if (!m_minimize_cross_dex_refs) {
     for (DexClass* cls : m_scope) {
@@ -762,8 +952,8 @@ void InterDex::run_in_force_single_dex_mode() {
     TypeRefs clazz_trefs;
     std::vector<DexClass*> erased_classes;
 
-    gather_refs(m_plugins, dex_info, cls, &clazz_mrefs, &clazz_frefs,
-                &clazz_trefs, &erased_classes,
+    gather_refs(m_plugins, *m_class_references_cache, dex_info, cls,
+                &clazz_mrefs, &clazz_frefs, &clazz_trefs, &erased_classes,
                 should_not_relocate_methods_of_class(cls));
 
     m_dexes_structure.add_class_no_checks(clazz_mrefs, clazz_frefs, clazz_trefs,
@@ -782,6 +972,7 @@ void InterDex::run_in_force_single_dex_mode() {
 
 void InterDex::run() {
   TRACE(IDEX, 2, "IDEX: Running on root store");
+  m_class_references_cache->prefill(m_scope);
   if (m_force_single_dex) {
     run_in_force_single_dex_mode();
     return;
@@ -7,9 +7,12 @@
 
 #pragma once
 
+#include <boost/optional.hpp>
+#include <memory>
 #include <unordered_set>
 
 #include "ApkManager.h"
+#include "ClassReferencesCache.h"
 #include "CrossDexRefMinimizer.h"
 #include "CrossDexRelocator.h"
 #include "DexClass.h"
@@ -23,6 +26,24 @@ namespace interdex {
 
 bool is_canary(DexClass* clazz);
 
+/**
+ * Simulates packing :classes_to_insert after :dexes_structure with each of
+ * :configs in parallel, and returns the index of the config that yields the
+ * fewest dexes, and then the fewest refs; earlier configs win ties. A trial is
+ * discarded once the classes it placed plus the reprioritizations of its
+ * minimizer exceed :work_budget. Returns none if no trial completes.
+ *
+ * The budget counts work rather than time, so the choice only depends on the
+ * inputs.
+ */
+boost::optional<size_t> pick_packing_trial(
+    const std::vector<CrossDexRefMinimizerConfig>& configs,
+    const DexesStructure& dexes_structure,
+    const std::vector<DexClass*>& sampled_classes,
+    const std::vector<DexClass*>& classes_to_insert,
+    const std::shared_ptr<ClassReferencesCache>& class_references_cache,
+    size_t work_budget);
+
 class InterDex {
  public:
   InterDex(const Scope& original_scope,
@@ -54,7 +75,9 @@ class InterDex {
         m_emitting_bg_set(false),
         m_emitted_bg_set(false),
         m_emitting_extended(false),
-        m_cross_dex_ref_minimizer(cross_dex_refs_config),
+        m_class_references_cache(std::make_shared<ClassReferencesCache>()),
+        m_cross_dex_ref_minimizer(cross_dex_refs_config,
+                                  m_class_references_cache),
         m_cross_dex_relocator_config(cross_dex_relocator_config),
         m_original_scope(original_scope),
         m_scope(build_class_scope(m_dexen)),
@@ -76,6 +99,20 @@ class InterDex {
     return m_dexes_structure.get_num_scroll_dexes();
   }
 
+  /**
+   * Before emitting the remaining classes, simulate packing them with each of
+   * the given alternative cross-dex-ref-minimizer configs in parallel, and use
+   * whichever config yields the fewest dexes, and then the fewest refs. Trials
+   * that need more than :work_per_class units of work per class, see
+   * pick_packing_trial, are discarded.
+   */
+  void set_cross_dex_ref_minimizer_trials(
+      const std::vector<CrossDexRefMinimizerConfig>& configs,
+      size_t work_per_class) {
+    m_cross_dex_ref_minimizer_trial_configs = configs;
+    m_cross_dex_ref_minimizer_trial_work_per_class = work_per_class;
+  }
+
   const CrossDexRefMinimizerStats& get_cross_dex_ref_minimizer_stats() const {
     return m_cross_dex_ref_minimizer.stats();
   }
@@ -121,6 +158,9 @@ class InterDex {
       const std::vector<DexType*>& interdex_types,
       const std::unordered_set<DexClass*>& unreferenced_classes);
   void init_cross_dex_ref_minimizer_and_relocate_methods();
+  void pick_cross_dex_ref_minimizer_config(
+      const std::vector<DexClass*>& sampled_classes,
+      const std::vector<DexClass*>& classes_to_insert);
   void emit_remaining_classes(DexInfo& dex_info);
   void flush_out_dex(DexInfo& dex_info);
 
@@ -161,7 +201,11 @@ class InterDex {
   std::vector<DexType*> m_end_markers;
   std::vector<DexType*> m_scroll_markers;
 
+  std::shared_ptr<ClassReferencesCache> m_class_references_cache;
   CrossDexRefMinimizer m_cross_dex_ref_minimizer;
+  std::vector<CrossDexRefMinimizerConfig>
+      m_cross_dex_ref_minimizer_trial_configs;
+  size_t m_cross_dex_ref_minimizer_trial_work_per_class{0};
   const CrossDexRelocatorConfig m_cross_dex_relocator_config;
   const Scope& m_original_scope;
   CrossDexRelocator* m_cross_dex_relocator{nullptr};
@@ -10,6 +10,7 @@
 #include "ConfigFiles.h"
 #include "DexClass.h"
 #include "DexUtil.h"
+#include "JsonWrapper.h"
 #include "PassManager.h"
 #include "WorkQueue.h"
 
@@ -33,6 +34,37 @@ void treat_generated_stores(DexStoresVector& stores,
   }
 }
 
+std::vector<interdex::CrossDexRefMinimizerConfig>
+get_cross_dex_ref_minimizer_trial_configs(
+    const interdex::CrossDexRefMinimizerConfig& base_config,
+    const Json::Value& trials) {
+  std::vector<interdex::CrossDexRefMinimizerConfig> configs;
+  if (trials.isNull()) {
+    return configs;
+  }
+  always_assert_log(trials.isArray(),
+                    "minimize_cross_dex_refs_trials must be a list");
+  for (const auto& trial : trials) {
+    JsonWrapper jw(trial);
+    auto config = base_config;
+    auto get = [&jw](const char* name, uint64_t& weight) {
+      size_t value;
+      jw.get(name, weight, value);
+      weight = value;
+    };
+    get("method_ref_weight", config.method_ref_weight);
+    get("field_ref_weight", config.field_ref_weight);
+    get("type_ref_weight", config.type_ref_weight);
+    get("string_ref_weight", config.string_ref_weight);
+    get("method_seed_weight", config.method_seed_weight);
+    get("field_seed_weight", config.field_seed_weight);
+    get("type_seed_weight", config.type_seed_weight);
+    get("string_seed_weight", config.string_seed_weight);
+    configs.push_back(config);
+  }
+  return configs;
+}
+
 } // namespace
 
 namespace interdex {
@@ -66,6 +98,17 @@ void InterDexPass::bind_config() {
        m_minimize_cross_dex_refs_config.type_seed_weight);
   bind("minimize_cross_dex_refs_string_ref_weight", {20},
        m_minimize_cross_dex_refs_config.string_seed_weight);
+  // A list of objects with any of the weights above (without prefix), e.g.
+  // [{"method_ref_weight": 50}, {"type_seed_weight": 80}]. Each object yields
+  // a config that defaults to the weights above, and which is tried out in
+  // parallel with them before emitting the remaining classes.
+  bind("minimize_cross_dex_refs_trials", Json::Value(),
+       m_minimize_cross_dex_refs_trials);
+  // Trials that need more work than this per class, counting each class
+  // placed and each reprioritization of another class, are abandoned. This is
+  // a count rather than a time limit, so that the outcome is reproducible.
+  bind("minimize_cross_dex_refs_trials_work_per_class", {1000},
+       m_minimize_cross_dex_refs_trials_work_per_class);
   bind("minimize_cross_dex_refs_relocate_static_methods", false,
        m_cross_dex_relocator_config.relocate_static_methods);
   bind("minimize_cross_dex_refs_relocate_non_static_direct_methods", false,
@@ -109,6 +152,10 @@ void InterDexPass::run_pass(DexStoresVector& stores,
                     m_normal_primary_dex, force_single_dex, m_emit_canaries,
                     m_minimize_cross_dex_refs, m_minimize_cross_dex_refs_config,
                     m_cross_dex_relocator_config, reserve_mrefs, &xstore_refs);
+  interdex.set_cross_dex_ref_minimizer_trials(
+      get_cross_dex_ref_minimizer_trial_configs(
+          m_minimize_cross_dex_refs_config, m_minimize_cross_dex_refs_trials),
+      m_minimize_cross_dex_refs_trials_work_per_class);
 
   if (m_expect_order_list) {
     always_assert_log(
@@ -70,6 +70,8 @@ class InterDexPass : public Pass {
   bool m_can_touch_coldstart_extended_cls;
   bool m_minimize_cross_dex_refs;
   CrossDexRefMinimizerConfig m_minimize_cross_dex_refs_config;
+  Json::Value m_minimize_cross_dex_refs_trials;
+  size_t m_minimize_cross_dex_refs_trials_work_per_class;
   CrossDexRelocatorConfig m_cross_dex_relocator_config;
   bool m_expect_order_list;
 
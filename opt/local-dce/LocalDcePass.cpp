@@ -40,21 +40,25 @@ constexpr const char* METRIC_COMPUTED_NO_SIDE_EFFECTS_METHODS_ITERATIONS =
 
 } // namespace
 
-void LocalDcePass::run_pass(DexStoresVector& stores,
-                            ConfigFiles& conf,
-                            PassManager& mgr) {
+std::unique_ptr<MethodLocalTransform> LocalDcePass::make_method_local_transform(
+    DexStoresVector& stores, ConfigFiles& conf, PassManager& mgr) {
   auto scope = build_class_scope(stores);
-  auto pure_methods = get_pure_methods();
+  auto pure_methods_ptr = std::make_shared<std::unordered_set<DexMethodRef*>>(
+      get_pure_methods());
+  auto& pure_methods = *pure_methods_ptr;
   auto configured_pure_methods = conf.get_pure_methods();
   pure_methods.insert(configured_pure_methods.begin(),
                       configured_pure_methods.end());
   auto rstate_pure_method = get_rstate_pure_methods(scope);
   pure_methods.insert(rstate_pure_method.begin(), rstate_pure_method.end());
-  auto override_graph = method_override_graph::build_graph(scope);
+  std::shared_ptr<const method_override_graph::Graph> override_graph =
+      method_override_graph::build_graph(scope);
   std::unordered_set<const DexMethod*> computed_no_side_effects_methods;
-  auto computed_no_side_effects_methods_iterations =
+  size_t computed_no_side_effects_methods_iterations =
       compute_no_side_effects_methods(scope, override_graph.get(), pure_methods,
                                       &computed_no_side_effects_methods);
+  size_t num_computed_no_side_effects_methods =
+      computed_no_side_effects_methods.size();
   for (auto m : computed_no_side_effects_methods) {
     pure_methods.insert(const_cast<DexMethod*>(m));
   }
@@ -74,30 +78,36 @@ void LocalDcePass::run_pass(DexStoresVector& stores,
     }
   }
 
-  auto stats =
-      walk::parallel::methods<LocalDce::Stats>(scope, [&](DexMethod* m) {
-        auto* code = m->get_code();
-        if (code == nullptr || m->rstate.no_optimizations()) {
-          return LocalDce::Stats();
-        }
+  auto transform = [pure_methods_ptr, override_graph,
+                    may_allocate_registers](DexMethod* m) {
+    auto* code = m->get_code();
+    if (code == nullptr || m->rstate.no_optimizations()) {
+      return LocalDce::Stats();
+    }
 
-        LocalDce ldce(pure_methods, override_graph.get(),
-                      may_allocate_registers);
-        ldce.dce(code);
-        return ldce.get_stats();
-      });
-  mgr.incr_metric(METRIC_NPE_INSTRUCTIONS, stats.npe_instruction_count);
-  mgr.incr_metric(METRIC_DEAD_INSTRUCTIONS, stats.dead_instruction_count);
-  mgr.incr_metric(METRIC_UNREACHABLE_INSTRUCTIONS,
-                  stats.unreachable_instruction_count);
-  mgr.incr_metric(METRIC_COMPUTED_NO_SIDE_EFFECTS_METHODS,
-                  computed_no_side_effects_methods.size());
-  mgr.incr_metric(METRIC_COMPUTED_NO_SIDE_EFFECTS_METHODS_ITERATIONS,
-                  computed_no_side_effects_methods_iterations);
+    LocalDce ldce(*pure_methods_ptr, override_graph.get(),
+                  may_allocate_registers);
+    ldce.dce(code);
+    return ldce.get_stats();
+  };
+  auto report = [num_computed_no_side_effects_methods,
+                 computed_no_side_effects_methods_iterations](
+                    const LocalDce::Stats& stats, PassManager& mgr) {
+    mgr.incr_metric(METRIC_NPE_INSTRUCTIONS, stats.npe_instruction_count);
+    mgr.incr_metric(METRIC_DEAD_INSTRUCTIONS, stats.dead_instruction_count);
+    mgr.incr_metric(METRIC_UNREACHABLE_INSTRUCTIONS,
+                    stats.unreachable_instruction_count);
+    mgr.incr_metric(METRIC_COMPUTED_NO_SIDE_EFFECTS_METHODS,
+                    num_computed_no_side_effects_methods);
+    mgr.incr_metric(METRIC_COMPUTED_NO_SIDE_EFFECTS_METHODS_ITERATIONS,
+                    computed_no_side_effects_methods_iterations);
 
-  TRACE(DCE, 1, "instructions removed -- npe: %d, dead: %d, unreachable: %d",
-        stats.npe_instruction_count, stats.dead_instruction_count,
-        stats.unreachable_instruction_count);
+    TRACE(DCE, 1, "instructions removed -- npe: %d, dead: %d, unreachable: %d",
+          stats.npe_instruction_count, stats.dead_instruction_count,
+          stats.unreachable_instruction_count);
+  };
+  return std::make_unique<StatsMethodLocalTransform<LocalDce::Stats>>(
+      transform, report);
 }
 
 static LocalDcePass s_pass;
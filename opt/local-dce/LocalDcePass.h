@@ -8,11 +8,12 @@
 #pragma once
 
 #include "LocalDce.h"
-#include "Pass.h"
+#include "MethodLocalTransform.h"
 
-class LocalDcePass : public Pass {
+class LocalDcePass : public MethodLocalPass {
  public:
-  LocalDcePass() : Pass("LocalDcePass") {}
+  LocalDcePass() : MethodLocalPass("LocalDcePass") {}
 
-  void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
+  std::unique_ptr<MethodLocalTransform> make_method_local_transform(
+      DexStoresVector&, ConfigFiles&, PassManager&) override;
 };
@@ -7,6 +7,7 @@
 
 #include "MergeInterface.h"
 
+#include "BatchedRefUpdater.h"
 #include "ClassHierarchy.h"
 #include "DexAnnotation.h"
 #include "DexClass.h"
@@ -445,6 +446,15 @@ void update_reference_for_code(
     const Scope& scope,
     const std::unordered_map<const DexType*, DexType*>& intf_merge_map,
     const std::unordered_map<DexMethodRef*, DexMethodRef*>& old_to_new_method) {
+  // References to the merged interfaces in type operands, annotations and
+  // encoded values, as well as to arrays of them, are plain renames.
+  reference_update::BatchedRefUpdater type_updater;
+  for (const auto& pair : intf_merge_map) {
+    type_updater.update_type_refs(const_cast<DexType*>(pair.first),
+                                  pair.second);
+  }
+  type_updater.apply(scope);
+
   auto patcher = [&old_to_new_method, &intf_merge_map](DexMethod*,
                                                        IRCode& code) {
     auto ii = InstructionIterable(code);
@@ -488,23 +498,6 @@ void update_reference_for_code(
                              false /* update deobfuscated name */);
           }
         }
-        continue;
-      }
-      // Update simple type refs
-      if (!insn->has_type() || insn->get_type() == nullptr) {
-        continue;
-      }
-      DexType* ref_type = insn->get_type();
-      const DexType* type = type::get_element_type_if_array(ref_type);
-      if (intf_merge_map.count(type) == 0) {
-        continue;
-      }
-      always_assert(type_class(type));
-      DexType* merger_type = intf_merge_map.at(type);
-      if (type::is_array(ref_type)) {
-        insn->set_type(type::make_array_type(merger_type));
-      } else {
-        insn->set_type(merger_type);
       }
     }
   };
@@ -14,6 +14,7 @@
 #include "Trace.h"
 #include "VirtualScope.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 #include <map>
 #include <set>
@@ -110,7 +111,7 @@ using RefsMap =
 // const std::string prefix = __Redex__";
 const std::string prefix;
 
-DexString* get_name(int seed) {
+DexString* make_name(int seed) {
   std::string name;
   obfuscate_utils::compute_identifier(seed, &name);
   if (!prefix.empty()) {
@@ -119,20 +120,62 @@ DexString* get_name(int seed) {
   return DexString::make_string(name);
 }
 
+/**
+ * The names for the first few seeds, interned up front in parallel, so that
+ * looking them up during renaming doesn't hit the string table over and over.
+ */
+class NameTable {
+ public:
+  explicit NameTable(size_t size) : m_names(size) {
+    const size_t chunk_size = 1024;
+    auto wq = workqueue_foreach<size_t>([&](size_t begin) {
+      auto end = std::min(begin + chunk_size, m_names.size());
+      for (size_t seed = begin; seed < end; ++seed) {
+        m_names[seed] = make_name(seed);
+      }
+    });
+    for (size_t begin = 0; begin < size; begin += chunk_size) {
+      wq.add_item(begin);
+    }
+    wq.run_all();
+  }
+
+  DexString* get(int seed) const {
+    return static_cast<size_t>(seed) < m_names.size() ? m_names[seed]
+                                                      : make_name(seed);
+  }
+
+ private:
+  std::vector<DexString*> m_names;
+};
+
+// The number of times each method name occurs in the stack trace elements of
+// a class, see VirtualRenamer::stack_trace_elements.
+using StackTraceElements =
+    std::unordered_map<const DexType*,
+                       std::unordered_map<std::string, uint32_t>>;
+
 struct VirtualRenamer {
   VirtualRenamer(
       const ClassScopes& class_scopes,
       const RefsMap& def_refs,
-      std::unordered_map<std::string, uint32_t>* elms,
-      std::unordered_map<const DexType*, std::string>* cache,
-      const std::unordered_map<const DexClass*, int>& next_dmethod_seeds)
+      StackTraceElements* elms,
+      const std::unordered_map<const DexClass*, int>& next_dmethod_seeds,
+      const NameTable& names)
       : class_scopes(class_scopes),
         def_refs(def_refs),
         stack_trace_elements(elms),
-        external_name_cache(cache),
-        next_dmethod_seeds(next_dmethod_seeds) {}
+        next_dmethod_seeds(next_dmethod_seeds),
+        names(names) {
+    class_scopes.walk_virtual_scopes(
+        [&](const DexType*, const VirtualScope* scope) {
+          next_virtualscope_seeds.emplace(
+              scope, compute_next_virtualscope_seed(scope));
+        });
+  }
 
   int rename_virtual_scopes(const DexType* type, int& seed);
+  int rename_virtual_scopes_in_parallel(const DexType* type, int& seed);
   int rename_interface_scopes(int& seed);
 
  private:
@@ -145,27 +188,23 @@ struct VirtualRenamer {
   // their ref counts get updated, and if the ref count drops to 0 then its
   // entry is erased. When avoid_stack_trace_collision is false then this is
   // null and collision avoidance is disabled.
-  std::unordered_map<std::string, uint32_t>* stack_trace_elements;
-  // Note these entries contain trailing periods
-  std::unordered_map<const DexType*, std::string>* external_name_cache;
+  // The entries are grouped by class, and every class of the scope has a
+  // (possibly empty) group, so renaming in disjoint parts of the hierarchy
+  // only ever touches disjoint groups.
+  StackTraceElements* stack_trace_elements;
   const std::unordered_map<const DexClass*, int>& next_dmethod_seeds;
-  mutable std::unordered_map<const VirtualScope*, int> next_virtualscope_seeds;
+  const NameTable& names;
+  std::unordered_map<const VirtualScope*, int> next_virtualscope_seeds;
 
  private:
-  const std::string& get_prefix(const DexType* type) const {
-    always_assert(external_name_cache != nullptr);
-    auto iter = external_name_cache->find(type);
-    always_assert(iter != external_name_cache->end());
+  std::unordered_map<std::string, uint32_t>& get_stack_trace_elements(
+      const DexType* type) const {
+    auto iter = stack_trace_elements->find(type);
+    always_assert(iter != stack_trace_elements->end());
     return iter->second;
   }
 
-  // Retrieves the next seed that won't overlap with dmethods, considering all
-  // classes participating in the given virtual scope
-  int get_next_virtualscope_seeds(const VirtualScope* scope) const {
-    auto it = next_virtualscope_seeds.find(scope);
-    if (it != next_virtualscope_seeds.end()) {
-      return it->second;
-    }
+  int compute_next_virtualscope_seed(const VirtualScope* scope) const {
     int seed = 0;
     for (auto& m : scope->methods) {
       auto it2 = next_dmethod_seeds.find(type_class(m.first->get_class()));
@@ -173,10 +212,20 @@ struct VirtualRenamer {
         seed = std::max(seed, it2->second);
       }
     }
-    next_virtualscope_seeds.emplace(scope, seed);
     return seed;
   }
 
+  // Retrieves the next seed that won't overlap with dmethods, considering all
+  // classes participating in the given virtual scope
+  int get_next_virtualscope_seeds(const VirtualScope* scope) const {
+    auto it = next_virtualscope_seeds.find(scope);
+    if (it != next_virtualscope_seeds.end()) {
+      return it->second;
+    }
+    return compute_next_virtualscope_seed(scope);
+  }
+
+  int rename_scopes_of(const DexType* type, int& seed);
   void rename(DexMethodRef* meth, DexString* name);
   int rename_scope_ref(DexMethod* meth, DexString* name);
   int rename_scope(const VirtualScope* scope, DexString* name);
@@ -203,15 +252,15 @@ void VirtualRenamer::rename(DexMethodRef* meth, DexString* name) {
     }
   }
   if (stack_trace_elements) {
-    std::string ste = get_prefix(meth->get_class()) + meth->str();
-    auto iter = stack_trace_elements->find(ste);
+    auto& elements = get_stack_trace_elements(meth->get_class());
+    auto iter = elements.find(meth->str());
     // We don't find this ste if it's a miranda method
-    if (iter != stack_trace_elements->end()) {
+    if (iter != elements.end()) {
       // We've found this ste, so let's decrement its ref count, and if it
       // reaches 0 then remove it so we don't have any empty entries
       iter->second -= 1;
       if (iter->second == 0) {
-        stack_trace_elements->erase(iter);
+        elements.erase(iter);
       }
     }
   }
@@ -221,8 +270,8 @@ void VirtualRenamer::rename(DexMethodRef* meth, DexString* name) {
                false /* update deobfuscated name */);
 
   if (stack_trace_elements) {
-    std::string ste = get_prefix(meth->get_class()) + name->str();
-    auto res = stack_trace_elements->emplace(std::move(ste), 1);
+    auto res = get_stack_trace_elements(meth->get_class()).emplace(name->str(),
+                                                                   1);
     // Ideally we've picked a new name that doesn't collide with any other
     // method, so this assert should never fire. We leave this here in case
     // my human brain foobarred the logic (or in a refactor some other
@@ -271,19 +320,21 @@ bool VirtualRenamer::usable_name(DexString* name,
                                  const VirtualScope* scope) const {
   const auto root = scope->type;
   const auto proto = scope->methods[0].first->get_proto();
-  auto hier = get_all_children(class_scopes.get_class_hierarchy(), root);
-  hier.insert(root);
   bool has_ste = stack_trace_elements != nullptr;
-  for (const auto& type : hier) {
+  auto collides = [&](const DexType* type) {
     if (DexMethod::get_method(const_cast<DexType*>(type), name, proto) !=
         nullptr) {
-      return false;
+      return true;
     }
-    if (has_ste) {
-      auto ste = get_prefix(type) + name->str();
-      if (stack_trace_elements->find(ste) != stack_trace_elements->end()) {
-        return false;
-      }
+    return has_ste && get_stack_trace_elements(type).count(name->str()) != 0;
+  };
+  if (collides(root)) {
+    return false;
+  }
+  for (const auto* type :
+       class_scopes.get_class_hierarchy_index().get_all_children(root)) {
+    if (collides(type)) {
+      return false;
     }
   }
   return true;
@@ -297,9 +348,9 @@ bool VirtualRenamer::usable_name(DexString* name,
 DexString* VirtualRenamer::get_unescaped_name(const VirtualScope* scope,
                                               int& seed) const {
   seed = std::max(seed, get_next_virtualscope_seeds(scope));
-  auto name = get_name(seed++);
+  auto name = names.get(seed++);
   while (!usable_name(name, scope)) {
-    name = get_name(seed++);
+    name = names.get(seed++);
   }
   return name;
 }
@@ -316,7 +367,7 @@ DexString* VirtualRenamer::get_unescaped_name(
     seed = std::max(seed, get_next_virtualscope_seeds(scope));
   }
   while (true) {
-    auto name = get_name(seed++);
+    auto name = names.get(seed++);
     for (const auto& scope : scopes) {
       if (!usable_name(name, scope)) goto next_name;
     }
@@ -397,9 +448,9 @@ int VirtualRenamer::rename_interface_scopes(int& seed) {
 }
 
 /**
- * Rename only scopes that are not interface and can_rename.
+ * Rename the scopes rooted at the given type only.
  */
-int VirtualRenamer::rename_virtual_scopes(const DexType* type, int& seed) {
+int VirtualRenamer::rename_scopes_of(const DexType* type, int& seed) {
   int renamed = 0;
   const auto cls = type_class(type);
   TRACE(OBFUSCATE, 5, "Attempting to rename %s", SHOW(type));
@@ -450,6 +501,14 @@ int VirtualRenamer::rename_virtual_scopes(const DexType* type, int& seed) {
       renamed += rename_scope(scope, name);
     }
   }
+  return renamed;
+}
+
+/**
+ * Rename only scopes that are not interface and can_rename.
+ */
+int VirtualRenamer::rename_virtual_scopes(const DexType* type, int& seed) {
+  int renamed = rename_scopes_of(type, seed);
 
   // will be used for interface renaming, effectively this
   // gets the last name (seed) for all virtual scopes and
@@ -468,6 +527,40 @@ int VirtualRenamer::rename_virtual_scopes(const DexType* type, int& seed) {
   return renamed;
 }
 
+/**
+ * Like rename_virtual_scopes, but renames the subtrees of the children of the
+ * given type in parallel. The names chosen in a subtree only need to be unique
+ * within it, and all the state that renaming a subtree reads or writes belongs
+ * to the classes in that subtree, so the subtrees are independent and the
+ * result doesn't depend on scheduling.
+ */
+int VirtualRenamer::rename_virtual_scopes_in_parallel(const DexType* type,
+                                                      int& seed) {
+  int renamed = rename_scopes_of(type, seed);
+
+  const auto& children = get_children(class_scopes.get_class_hierarchy(), type);
+  std::vector<const DexType*> child_types(children.begin(), children.end());
+  // The number of renamed methods and the final seed of each child.
+  std::vector<std::pair<int, int>> results(child_types.size());
+  auto wq = workqueue_foreach<size_t>([&](size_t i) {
+    int base_seed = seed;
+    results[i].first = rename_virtual_scopes(child_types[i], base_seed);
+    results[i].second = base_seed;
+  });
+  for (size_t i = 0; i < child_types.size(); ++i) {
+    wq.add_item(i);
+  }
+  wq.run_all();
+
+  int max_seed = seed;
+  for (const auto& result : results) {
+    renamed += result.first;
+    max_seed = std::max(max_seed, result.second);
+  }
+  seed = max_seed;
+  return renamed;
+}
+
 /**
  * Collect all method refs to concrete methods (definitions).
  */
@@ -517,37 +610,47 @@ size_t rename_virtuals(
   scope_info(class_scopes);
   RefsMap def_refs;
   collect_refs(classes, def_refs);
-  std::unordered_map<std::string, uint32_t> stack_trace_elements;
-  std::unordered_map<const DexType*, std::string> external_cache;
+  StackTraceElements stack_trace_elements;
   if (avoid_stack_trace_collision) {
     for (const auto& cls : classes) {
-      std::string pref = java_names::internal_to_external(cls->str()) + ".";
-      auto emp_res = external_cache.emplace(cls->get_type(), pref);
+      auto emp_res = stack_trace_elements.emplace(
+          cls->get_type(), std::unordered_map<std::string, uint32_t>());
       always_assert(emp_res.second);
+      auto& elements = emp_res.first->second;
       auto meths_visitor = [&](const std::vector<DexMethod*>& methods) {
         for (const DexMethod* method : methods) {
-          std::string ste = pref + method->str();
           // We're 100% ok with the default construction of an entry here, since
           // after this line that would give said entry the correct ref count
           // of 1.
-          stack_trace_elements[ste] += 1;
+          elements[method->str()] += 1;
         }
       };
       meths_visitor(cls->get_dmethods());
       meths_visitor(cls->get_vmethods());
     }
   }
+  // Seeds start above the dmethod seeds and grow by at most one per scope
+  // along a path down the hierarchy, plus one per skipped colliding name.
+  size_t max_dmethod_seed = 0;
+  for (const auto& p : next_dmethod_seeds) {
+    max_dmethod_seed = std::max<size_t>(max_dmethod_seed, p.second);
+  }
+  size_t vmethods = 0;
+  for (const auto& cls : classes) {
+    vmethods += cls->get_vmethods().size();
+  }
+  NameTable names(max_dmethod_seed + std::min<size_t>(vmethods, 1 << 16));
   VirtualRenamer vr(class_scopes,
                     def_refs,
                     avoid_stack_trace_collision ? &stack_trace_elements
                                                 : nullptr,
-                    avoid_stack_trace_collision ? &external_cache : nullptr,
-                    next_dmethod_seeds);
+                    next_dmethod_seeds,
+                    names);
 
   // rename virtual only first
   const auto obj_t = type::java_lang_Object();
   int seed = 0;
-  size_t renamed = vr.rename_virtual_scopes(obj_t, seed);
+  size_t renamed = vr.rename_virtual_scopes_in_parallel(obj_t, seed);
   TRACE(OBFUSCATE, 2, "Virtual renamed: %ld", renamed);
 
   // rename interfaces
@@ -13,6 +13,7 @@
 #include "DexUtil.h"
 #include "HierarchyUtil.h"
 #include "LocalPointersAnalysis.h"
+#include "SummaryCache.h"
 #include "SummarySerialization.h"
 #include "Transform.h"
 #include "Walkers.h"
@@ -137,8 +138,20 @@ void ObjectSensitiveDcePass::run_pass(DexStoresVector& stores,
     std::ifstream file_input(*m_external_side_effect_summaries_file);
     summary_serialization::read(file_input, &effect_summaries);
   }
+  // Summaries of external methods enter the cache keys as callee summaries.
+  auto summary_cache = mgr.make_summary_cache("side_effects");
+  auto& shared_cache = side_effects::shared_side_effect_summary_cache();
+  auto shared_hits = shared_cache.hits();
   side_effects::analyze_scope(scope, call_graph, *ptrs_fp_iter_map,
-                              &effect_summaries);
+                              &effect_summaries, summary_cache.get(),
+                              &escape_summaries_cmap, &shared_cache);
+  mgr.incr_metric("shared_summary_cache_hits",
+                  shared_cache.hits() - shared_hits);
+  if (summary_cache != nullptr) {
+    summary_cache->save();
+    mgr.incr_metric("summary_cache_hits", summary_cache->hits());
+    mgr.incr_metric("summary_cache_misses", summary_cache->misses());
+  }
 
   auto removed =
       walk::parallel::methods<size_t>(scope, [&](DexMethod* method) -> size_t {
@@ -7,9 +7,15 @@
 
 #include "SideEffectSummary.h"
 
+#include <algorithm>
+
 #include "CallGraph.h"
 #include "ConcurrentContainers.h"
+#include "RedexContext.h"
+#include "Show.h"
+#include "SummaryCache.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 using namespace side_effects;
 using namespace sparta;
@@ -215,6 +221,38 @@ void SummaryBuilder::classify_heap_write(const ptrs::Environment& env,
   }
 }
 
+/*
+ * What the summary of :method depends on besides its code: the effect
+ * summaries of its callees, and their escape summaries via the pointer
+ * analysis of :method. Both caches key their entries on these.
+ */
+SideEffectSummaryCache::Dependencies cache_dependencies(
+    const DexMethod* method,
+    const call_graph::Graph& call_graph,
+    const SummaryConcurrentMap& summary_cmap,
+    const ptrs::SummaryCMap& escape_summaries) {
+  SideEffectSummaryCache::Dependencies dependencies;
+  dependencies.emplace_back(method->rstate.no_optimizations() ? "no_optimize"
+                                                              : "");
+  if (call_graph.has_node(method)) {
+    for (const auto& edge : call_graph.node(method)->callees()) {
+      auto* callee = edge->callee()->method();
+      std::string dependency = show(callee);
+      auto it = summary_cmap.find(callee);
+      dependency += ' ';
+      dependency +=
+          it == summary_cmap.end() ? "?" : to_s_expr(it->second).str();
+      auto escape_it = escape_summaries.find(callee);
+      dependency += ' ';
+      dependency += escape_it == escape_summaries.end()
+                        ? "?"
+                        : to_s_expr(escape_it->second).str();
+      dependencies.push_back(std::move(dependency));
+    }
+  }
+  return dependencies;
+}
+
 /*
  * Analyze :method and insert its summary into :summary_cmap. Recursively
  * analyze the callees if necessary. This method is thread-safe.
@@ -223,7 +261,10 @@ void analyze_method_recursive(const DexMethod* method,
                               const call_graph::Graph& call_graph,
                               const ptrs::FixpointIteratorMap& ptrs_fp_iter_map,
                               PatriciaTreeSet<const DexMethodRef*> visiting,
-                              SummaryConcurrentMap* summary_cmap) {
+                              SummaryConcurrentMap* summary_cmap,
+                              SummaryCache* cache,
+                              const ptrs::SummaryCMap* escape_summaries,
+                              SideEffectSummaryCache* shared_cache) {
   if (!method || summary_cmap->count(method) != 0 ||
       visiting.contains(method) || method->get_code() == nullptr) {
     return;
@@ -236,7 +277,8 @@ void analyze_method_recursive(const DexMethod* method,
     for (const auto& edge : callee_edges) {
       auto* callee = edge->callee()->method();
       analyze_method_recursive(callee, call_graph, ptrs_fp_iter_map, visiting,
-                               summary_cmap);
+                               summary_cmap, cache, escape_summaries,
+                               shared_cache);
       if (summary_cmap->count(callee) != 0) {
         invoke_to_summary_cmap.emplace(edge->invoke_iterator()->insn,
                                        summary_cmap->at(callee));
@@ -244,6 +286,32 @@ void analyze_method_recursive(const DexMethod* method,
     }
   }
 
+  SideEffectSummaryCache::Dependencies dependencies;
+  if (cache != nullptr || shared_cache != nullptr) {
+    dependencies = cache_dependencies(method, call_graph, *summary_cmap,
+                                      *escape_summaries);
+  }
+  if (shared_cache != nullptr) {
+    auto cached = shared_cache->get(method, dependencies);
+    if (cached) {
+      summary_cmap->emplace(method, *cached);
+      return;
+    }
+  }
+  std::string key;
+  if (cache != nullptr) {
+    key = cache->key(method, dependencies);
+    auto cached = cache->find(key);
+    if (cached) {
+      auto summary = Summary::from_s_expr(*cached);
+      if (shared_cache != nullptr) {
+        shared_cache->put(method, std::move(dependencies), summary);
+      }
+      summary_cmap->emplace(method, summary);
+      return;
+    }
+  }
+
   const auto* ptrs_fp_iter = ptrs_fp_iter_map.find(method)->second;
   auto summary =
       SummaryBuilder(invoke_to_summary_cmap, *ptrs_fp_iter, method->get_code())
@@ -252,6 +320,12 @@ void analyze_method_recursive(const DexMethod* method,
     summary.effects |= EFF_NO_OPTIMIZE;
   }
   summary_cmap->emplace(method, summary);
+  if (cache != nullptr) {
+    cache->record(key, to_s_expr(summary));
+  }
+  if (shared_cache != nullptr) {
+    shared_cache->put(method, std::move(dependencies), summary);
+  }
 
   if (traceEnabled(OSDCE, 3)) {
     TRACE(OSDCE, 3, "%s %s unknown side effects (%u)", SHOW(method),
@@ -267,6 +341,46 @@ void analyze_method_recursive(const DexMethod* method,
   }
 }
 
+boost::optional<Summary> SideEffectSummaryCache::get(
+    const DexMethod* method, const Dependencies& dependencies) {
+  auto* code = method->get_code();
+  if (code != nullptr && !code->editable_cfg_built()) {
+    auto it = m_entries.find(method);
+    if (it != m_entries.end() && it->second.dependencies == dependencies &&
+        it->second.fingerprint == code_fingerprint::compute(*code)) {
+      m_hits++;
+      return it->second.summary;
+    }
+  }
+  m_misses++;
+  return boost::none;
+}
+
+void SideEffectSummaryCache::put(const DexMethod* method,
+                                 Dependencies dependencies,
+                                 const Summary& summary) {
+  auto* code = method->get_code();
+  // The instructions of an editable CFG aren't covered by the fingerprint.
+  if (code == nullptr || code->editable_cfg_built()) {
+    invalidate(method);
+    return;
+  }
+  Entry entry{code_fingerprint::compute(*code), std::move(dependencies),
+              summary};
+  m_entries.update(method, [&](const DexMethodRef*, Entry& e, bool) {
+    e = std::move(entry);
+  });
+}
+
+void SideEffectSummaryCache::invalidate(const DexMethodRef* method) {
+  m_entries.erase(method);
+}
+
+SideEffectSummaryCache& shared_side_effect_summary_cache() {
+  static RedexContextCache<SideEffectSummaryCache> cache;
+  return cache.get();
+}
+
 Summary analyze_code(const InvokeToSummaryMap& invoke_to_summary_cmap,
                      const ptrs::FixpointIterator& ptrs_fp_iter,
                      const IRCode* code) {
@@ -278,7 +392,12 @@ void analyze_scope(
     const call_graph::Graph& call_graph,
     const ConcurrentMap<const DexMethodRef*, ptrs::FixpointIterator*>&
         ptrs_fp_iter_map,
-    SummaryMap* summary_map) {
+    SummaryMap* summary_map,
+    SummaryCache* cache,
+    const local_pointers::SummaryCMap* escape_summaries,
+    SideEffectSummaryCache* shared_cache) {
+  always_assert((cache == nullptr && shared_cache == nullptr) ||
+                escape_summaries != nullptr);
   // This method is special: the bytecode verifier requires that this method
   // be called before a newly-allocated object gets used in any way. We can
   // model this by treating the method as modifying its `this` parameter --
@@ -291,11 +410,25 @@ void analyze_scope(
     summary_cmap.insert(pair);
   }
 
-  walk::parallel::code(scope, [&](const DexMethod* method, IRCode& code) {
-    PatriciaTreeSet<const DexMethodRef*> visiting;
-    analyze_method_recursive(method, call_graph, ptrs_fp_iter_map, visiting,
-                             &summary_cmap);
-  });
+  // The components of a level only call components of lower levels, whose
+  // summaries are all done, so no two threads ever summarize the same
+  // method. Within a component, the summaries of callees that are being
+  // visited are unknown, as before.
+  for (const auto& level : call_graph::components_by_level(scope, call_graph)) {
+    auto wq = workqueue_foreach<const std::vector<const DexMethod*>*>(
+        [&](const std::vector<const DexMethod*>* component) {
+          for (auto method : *component) {
+            PatriciaTreeSet<const DexMethodRef*> visiting;
+            analyze_method_recursive(method, call_graph, ptrs_fp_iter_map,
+                                     visiting, &summary_cmap, cache,
+                                     escape_summaries, shared_cache);
+          }
+        });
+    for (const auto& component : level) {
+      wq.add_item(&component);
+    }
+    wq.run_all();
+  }
 
   for (auto& pair : summary_cmap) {
     summary_map->insert(pair);
@@ -305,8 +438,12 @@ void analyze_scope(
 s_expr to_s_expr(const Summary& summary) {
   std::vector<s_expr> s_exprs;
   s_exprs.emplace_back(std::to_string(summary.effects));
+  std::vector<param_idx_t> modified_params(summary.modified_params.begin(),
+                                           summary.modified_params.end());
+  // Sort in order that the output is deterministic.
+  std::sort(modified_params.begin(), modified_params.end());
   std::vector<s_expr> mod_param_s_exprs;
-  for (auto idx : summary.modified_params) {
+  for (auto idx : modified_params) {
     mod_param_s_exprs.emplace_back(idx);
   }
   s_exprs.emplace_back(mod_param_s_exprs);
@@ -7,10 +7,15 @@
 
 #pragma once
 
+#include <atomic>
+#include <boost/optional.hpp>
 #include <ostream>
+#include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
+#include "CodeFingerprint.h"
 #include "ConcurrentContainers.h"
 #include "DexClass.h"
 #include "LocalPointersAnalysis.h"
@@ -18,6 +23,8 @@
 #include "Resolver.h"
 #include "S_Expression.h"
 
+class SummaryCache;
+
 /*
  * This analysis identifies the side effects that methods have. A significant
  * portion of this is classifying heap mutations. We have three possible
@@ -118,6 +125,53 @@ class SummaryBuilder final {
   reaching_defs::MoveAwareFixpointIterator* m_reaching_defs_fixpoint_iter;
 };
 
+/*
+ * Effect summaries that outlive a single analysis of the scope, so that later
+ * runs of the analysis in the same pipeline only summarize the methods that
+ * changed since.
+ *
+ * An entry is only reused while its method has code with the same
+ * fingerprint, see code_fingerprint::compute, and while the effect and escape
+ * summaries of the method's callees are the same as when the entry was
+ * computed. Since callees are summarized before their callers, a changed
+ * callee thereby invalidates all of its transitive callers.
+ *
+ * All operations are thread-safe.
+ */
+class SideEffectSummaryCache final {
+ public:
+  // One string per callee, see analyze_scope.
+  using Dependencies = std::vector<std::string>;
+
+  boost::optional<Summary> get(const DexMethod* method,
+                               const Dependencies& dependencies);
+
+  void put(const DexMethod* method,
+           Dependencies dependencies,
+           const Summary& summary);
+
+  void invalidate(const DexMethodRef* method);
+
+  size_t hits() const { return m_hits; }
+  size_t misses() const { return m_misses; }
+
+ private:
+  struct Entry {
+    code_fingerprint::Fingerprint fingerprint;
+    Dependencies dependencies;
+    Summary summary;
+  };
+
+  ConcurrentMap<const DexMethodRef*, Entry> m_entries;
+  std::atomic<size_t> m_hits{0};
+  std::atomic<size_t> m_misses{0};
+};
+
+/*
+ * The cache shared by all passes of the current RedexContext.
+ */
+SideEffectSummaryCache& shared_side_effect_summary_cache();
+
 // For testing.
 Summary analyze_code(const InvokeToSummaryMap& invoke_to_summary_cmap,
                      const local_pointers::FixpointIterator& ptrs_fp_iter,
@@ -125,11 +179,23 @@ Summary analyze_code(const InvokeToSummaryMap& invoke_to_summary_cmap,
 
 /*
  * Get the effect summary for all methods in scope.
+ *
+ * Methods are summarized bottom-up over the strongly connected components of
+ * the call graph, in parallel for components that don't call each other.
+ *
+ * If a cache is given, summaries are looked up in and recorded to it, and
+ * likewise for the in-memory shared cache. The escape summaries that the
+ * pointer analysis of the scope used are then required too, as those are part
+ * of the inputs of each summary.
  */
-void analyze_scope(const Scope& scope,
-                   const call_graph::Graph&,
-                   const ConcurrentMap<const DexMethodRef*,
-                                       local_pointers::FixpointIterator*>&,
-                   SummaryMap* effect_summaries);
+void analyze_scope(
+    const Scope& scope,
+    const call_graph::Graph&,
+    const ConcurrentMap<const DexMethodRef*,
+                        local_pointers::FixpointIterator*>&,
+    SummaryMap* effect_summaries,
+    SummaryCache* cache = nullptr,
+    const local_pointers::SummaryCMap* escape_summaries = nullptr,
+    SideEffectSummaryCache* shared_cache = nullptr);
 
 } // namespace side_effects
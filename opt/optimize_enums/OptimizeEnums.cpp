@@ -8,6 +8,7 @@
 #include "OptimizeEnums.h"
 
 #include "ClassAssemblingUtils.h"
+#include "ConcurrentContainers.h"
 #include "EnumAnalyzeGeneratedMethods.h"
 #include "EnumClinitAnalysis.h"
 #include "EnumInSwitch.h"
@@ -633,8 +634,39 @@ class OptimizeEnums {
       const std::unordered_map<DexField*, size_t>& enum_field_to_ordinal,
       const GeneratedSwitchCases& generated_switch_cases) {
 
+    if (lookup_table_to_enum.empty()) {
+      return;
+    }
+
+    // Building the CFG and running the fixpoint is by far the most expensive
+    // part, so only do it for methods that both read a lookup table and call
+    // `ordinal`. A cheap parallel scan of the linear code finds them.
+    ConcurrentSet<DexMethod*> candidates;
+    walk::parallel::code(m_scope, [&](DexMethod* method, IRCode& code) {
+      bool reads_lookup_table = false;
+      bool calls_ordinal = false;
+      for (const auto& mie : InstructionIterable(code)) {
+        auto insn = mie.insn;
+        if (insn->opcode() == OPCODE_SGET_OBJECT) {
+          auto field = resolve_field(insn->get_field(), FieldSearch::Static);
+          reads_lookup_table |=
+              field != nullptr && lookup_table_to_enum.count(field);
+        } else if (insn->has_method()) {
+          calls_ordinal |= insn->get_method()->get_name()->str() == "ordinal";
+        }
+        if (reads_lookup_table && calls_ordinal) {
+          candidates.insert(method);
+          return;
+        }
+      }
+    });
+    TRACE(ENUM, 2, "%zu methods may use a lookup table", candidates.size());
+
     namespace cp = constant_propagation;
-    walk::code(m_scope, [&](DexMethod*, IRCode& code) {
+    walk::code(m_scope, [&](DexMethod* method, IRCode& code) {
+      if (!candidates.count(method)) {
+        return;
+      }
       code.build_cfg(/* editable */ true);
       auto& cfg = code.cfg();
       cfg.calculate_exit_block();
@@ -12,9 +12,9 @@
  *
  * At its core is a rather naive approach: check if any subsequence of
  * instructions in a block occurs sufficiently often. The average complexity is
- * held down by filtering out instruction sequences where adjacent sequences of
- * abstracted instructions ("cores") of fixed lengths never occur twice anywhere
- * in the scope (seems good enough, even without a suffix tree).
+ * held down by filtering out instruction sequences whose abstracted
+ * instructions ("cores") never occur twice anywhere in the scope, which a
+ * suffix array over all cores tells us.
  *
  * We gather existing method/type references in a dex and make sure that we
  * don't go beyond the limits when adding methods/types, effectively filling up
@@ -72,11 +72,14 @@
 #include "InterDexPass.h"
 #include "Lazy.h"
 #include "Liveness.h"
+#include "MethodProfiles.h"
 #include "MutablePriorityQueue.h"
 #include "Resolver.h"
+#include "SuffixArray.h"
 #include "Trace.h"
 #include "TypeInference.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 namespace {
 
@@ -266,41 +269,11 @@ static CandidateInstructionCore to_core(IRInstruction* insn) {
   return core;
 }
 
-using CandidateInstructionCores =
-    std::array<CandidateInstructionCore, MIN_INSNS_SIZE>;
-using CandidateInstructionCoresHasher = boost::hash<CandidateInstructionCores>;
-using CandidateInstructionCoresSet =
-    std::unordered_set<CandidateInstructionCores,
-                       CandidateInstructionCoresHasher>;
-
-// The cores builder efficiently keeps track of the last MIN_INSNS_SIZE many
-// instructions.
-class CandidateInstructionCoresBuilder {
- public:
-  void push_back(IRInstruction* insn) {
-    m_buffer[m_start] = to_core(insn);
-    m_start = (m_start + 1) % MIN_INSNS_SIZE;
-    m_size = m_size < MIN_INSNS_SIZE ? m_size + 1 : MIN_INSNS_SIZE;
-  }
-
-  void clear() { m_size = 0; }
-
-  bool has_value() const { return m_size == MIN_INSNS_SIZE; }
-
-  CandidateInstructionCores get_value() {
-    always_assert(m_size == MIN_INSNS_SIZE);
-    CandidateInstructionCores res;
-    for (size_t i = 0; i < MIN_INSNS_SIZE; i++) {
-      res[i] = m_buffer.at((m_start + i) % MIN_INSNS_SIZE);
-    }
-    return res;
-  }
-
- private:
-  std::array<CandidateInstructionCore, MIN_INSNS_SIZE> m_buffer;
-  size_t m_start{0};
-  size_t m_size{0};
-};
+// For each instruction that starts a recurring sequence of at least
+// MIN_INSNS_SIZE outlinable instructions, the length of the longest such
+// sequence.
+using RecurringSequenceLengths =
+    std::unordered_map<const IRInstruction*, size_t>;
 
 ////////////////////////////////////////////////////////////////////////////////
 // "Partial" candidate sequences
@@ -1240,7 +1213,7 @@ static void add_method_candidate_sequences_at(
     const std::function<bool(const DexType*)>& illegal_ref,
     DexMethod* method,
     cfg::ControlFlowGraph& cfg,
-    const CandidateInstructionCoresSet& recurring_cores,
+    const RecurringSequenceLengths& recurring_lengths,
     LazyUnorderedMap<cfg::Block*,
                      std::unordered_map<IRInstruction*, LivenessDomain>>&
         live_outs,
@@ -1251,23 +1224,23 @@ static void add_method_candidate_sequences_at(
     big_blocks::InstructionIterator it,
     const big_blocks::InstructionIterator& end,
     MethodCandidateSequences* candidate_sequences) {
+  // Longer sequences starting here don't occur anywhere else.
+  auto recurring_it = recurring_lengths.find(it->insn);
+  if (recurring_it == recurring_lengths.end()) {
+    return;
+  }
+  auto max_insns_size = std::min(config.max_insns_size, recurring_it->second);
   PartialCandidateSequence pcs;
   boost::optional<IROpcode> prev_opcode;
-  CandidateInstructionCoresBuilder cores_builder;
-  for (; it != end && pcs.insns.size() < config.max_insns_size;
+  for (; it != end && pcs.insns.size() < max_insns_size;
        prev_opcode = it->insn->opcode(), it++) {
     auto insn = it->insn;
     if (!append_to_partial_candidate_sequence(insn, &pcs)) {
       return;
     }
-    cores_builder.push_back(insn);
     if (pcs.insns.size() < MIN_INSNS_SIZE) {
       continue;
     }
-    if (cores_builder.has_value() &&
-        !recurring_cores.count(cores_builder.get_value())) {
-      return;
-    }
     // We cannot consider partial candidate sequences when they are missing
     // their move-result piece
     if (insn->has_move_result_any() &&
@@ -1379,7 +1352,7 @@ static MethodCandidateSequences find_method_candidate_sequences(
     const std::function<bool(const DexType*)>& illegal_ref,
     DexMethod* method,
     cfg::ControlFlowGraph& cfg,
-    const CandidateInstructionCoresSet& recurring_cores) {
+    const RecurringSequenceLengths& recurring_lengths) {
   MethodCandidateSequences candidate_sequences;
   LivenessFixpointIterator liveness_fp_iter(cfg);
   liveness_fp_iter.run({});
@@ -1434,7 +1407,7 @@ static MethodCandidateSequences find_method_candidate_sequences(
         continue;
       }
       add_method_candidate_sequences_at(
-          config, illegal_ref, method, cfg, recurring_cores, live_outs,
+          config, illegal_ref, method, cfg, recurring_lengths, live_outs,
           throw_live_out, type_environments, insn_idxes,
           big_block.get_blocks().front(), it, end, &candidate_sequences);
     }
@@ -1443,12 +1416,21 @@ static MethodCandidateSequences find_method_candidate_sequences(
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-// get_recurring_cores
+// get_recurring_sequences
 ////////////////////////////////////////////////////////////////////////////////
 
-static bool can_outline_from_method(
-    DexMethod* method,
-    const std::unordered_map<std::string, unsigned int>* method_to_weight) {
+// Profile data that keeps us from outlining out of methods where the extra
+// invocations would hurt performance.
+struct ProfileGuidance {
+  const std::unordered_map<std::string, unsigned int>* method_to_weight{
+      nullptr};
+  // The cold start stats, if there are any and we should use them
+  const method_profiles::StatsMap* cold_start_stats{nullptr};
+  float max_appear_percent{1.0};
+};
+
+static bool can_outline_from_method(DexMethod* method,
+                                    const ProfileGuidance& profile_guidance) {
   if (method->rstate.no_optimizations()) {
     return false;
   }
@@ -1456,6 +1438,7 @@ static bool can_outline_from_method(
       api::LevelChecker::get_min_level()) {
     return false;
   }
+  auto method_to_weight = profile_guidance.method_to_weight;
   if (method_to_weight) {
     auto cls = type_class(method->get_class());
     if (cls->is_perf_sensitive() &&
@@ -1463,21 +1446,33 @@ static bool can_outline_from_method(
       return false;
     }
   }
+  auto cold_start_stats = profile_guidance.cold_start_stats;
+  if (cold_start_stats) {
+    auto it = cold_start_stats->find(method);
+    if (it != cold_start_stats->end() &&
+        it->second.appear_percent >= profile_guidance.max_appear_percent) {
+      return false;
+    }
+  }
   return true;
 }
 
-// Gather set of recurring small (MIN_INSNS_SIZE) adjacent instruction
-// sequences that are outlinable. Note that all longer recurring outlinable
-// instruction sequences must be  comprised of shorter recurring ones.
-static void get_recurring_cores(
+// Find the recurring adjacent outlinable instruction sequences. Only those can
+// give rise to candidate sequences that occur more than once.
+//
+// All methods' instructions are mapped to their cores, and the maximal runs of
+// outlinable instructions within big blocks are concatenated into one text,
+// with a distinct separator after each run. The suffix array of that text
+// then gives, for each instruction, the longest sequence of cores starting
+// there that also occurs elsewhere.
+static void get_recurring_sequences(
     PassManager& mgr,
     const Scope& scope,
-    const std::unordered_map<std::string, unsigned int>* method_to_weight,
+    const ProfileGuidance& profile_guidance,
     const std::function<bool(const DexType*)>& illegal_ref,
-    CandidateInstructionCoresSet* recurring_cores) {
-  ConcurrentMap<CandidateInstructionCores, size_t,
-                CandidateInstructionCoresHasher>
-      concurrent_cores;
+    RecurringSequenceLengths* recurring_lengths) {
+  using Run = std::vector<IRInstruction*>;
+  ConcurrentMap<DexMethod*, std::vector<Run>> method_runs;
   auto legal_refs = [&illegal_ref](IRInstruction* insn) {
     std::vector<DexType*> types;
     insn->gather_types(types);
@@ -1532,47 +1527,83 @@ static void get_recurring_cores(
     return true;
   };
   walk::parallel::code(
-      scope, [can_outline_insn, method_to_weight,
-              &concurrent_cores](DexMethod* method, IRCode& code) {
-        if (!can_outline_from_method(method, method_to_weight)) {
+      scope, [can_outline_insn, &profile_guidance,
+              &method_runs](DexMethod* method, IRCode& code) {
+        if (!can_outline_from_method(method, profile_guidance)) {
           return;
         }
         code.build_cfg(/* editable */ true);
         code.cfg().calculate_exit_block();
         auto& cfg = code.cfg();
+        std::vector<Run> runs;
+        Run run;
+        auto flush = [&]() {
+          if (run.size() >= MIN_INSNS_SIZE) {
+            runs.push_back(std::move(run));
+          }
+          run.clear();
+        };
         for (auto& big_block : big_blocks::get_big_blocks(cfg)) {
-          CandidateInstructionCoresBuilder cores_builder;
           for (auto& mie : big_blocks::InstructionIterable(big_block)) {
             auto insn = mie.insn;
             if (!can_outline_insn(insn)) {
-              cores_builder.clear();
+              flush();
               continue;
             }
-            cores_builder.push_back(insn);
-            if (cores_builder.has_value()) {
-              concurrent_cores.update(cores_builder.get_value(),
-                                      [](const CandidateInstructionCores&,
-                                         size_t& occurrences,
-                                         bool /* exists */) { occurrences++; });
-            }
+            run.push_back(insn);
           }
+          flush();
+        }
+        if (!runs.empty()) {
+          method_runs.emplace(method, std::move(runs));
         }
       });
-  size_t singleton_cores{0};
-  for (auto& p : concurrent_cores) {
-    always_assert(p.second > 0);
-    if (p.second > 1) {
-      recurring_cores->insert(p.first);
-    } else {
-      singleton_cores++;
+
+  // Build the text in a deterministic order. Cores and separators share one
+  // symbol space so that it stays dense.
+  std::unordered_map<CandidateInstructionCore, suffix_array::Symbol,
+                     CandidateInstructionCoreHasher>
+      symbols;
+  suffix_array::Symbol next_symbol{0};
+  std::vector<suffix_array::Symbol> text;
+  std::vector<IRInstruction*> insns;
+  walk::code(scope, [&](DexMethod* method, IRCode&) {
+    auto it = method_runs.find(method);
+    if (it == method_runs.end()) {
+      return;
+    }
+    for (auto& run : it->second) {
+      for (auto insn : run) {
+        auto p = symbols.emplace(to_core(insn), next_symbol);
+        if (p.second) {
+          next_symbol++;
+        }
+        text.push_back(p.first->second);
+        insns.push_back(insn);
+      }
+      text.push_back(next_symbol++);
+      insns.push_back(nullptr);
+    }
+  });
+  method_runs.clear();
+
+  auto lengths = suffix_array::longest_repeats(text);
+  size_t outlinable_insns{0};
+  for (size_t i = 0; i < text.size(); ++i) {
+    if (insns[i] == nullptr) {
+      continue;
+    }
+    outlinable_insns++;
+    if (lengths[i] >= MIN_INSNS_SIZE) {
+      recurring_lengths->emplace(insns[i], lengths[i]);
     }
   }
-  mgr.incr_metric("num_singleton_cores", singleton_cores);
-  mgr.incr_metric("num_recurring_cores", recurring_cores->size());
+  mgr.incr_metric("num_outlinable_insns", outlinable_insns);
+  mgr.incr_metric("num_recurring_sequence_starts", recurring_lengths->size());
   TRACE(ISO, 2,
-        "[invoke sequence outliner] %zu singleton cores, %zu recurring "
-        "cores",
-        singleton_cores, recurring_cores->size());
+        "[invoke sequence outliner] %zu outlinable instructions, %zu "
+        "recurring sequence starts",
+        outlinable_insns, recurring_lengths->size());
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1622,9 +1653,9 @@ static void get_beneficial_candidates(
     const InstructionSequenceOutlinerConfig& config,
     PassManager& mgr,
     const Scope& scope,
-    const std::unordered_map<std::string, unsigned int>* method_to_weight,
+    const ProfileGuidance& profile_guidance,
     const std::function<bool(const DexType*)>& illegal_ref,
-    const CandidateInstructionCoresSet& recurring_cores,
+    const RecurringSequenceLengths& recurring_lengths,
     const ReusableOutlinedMethods* reusable_outlined_methods,
     std::vector<Candidate>* candidates,
     std::unordered_map<DexMethod*, std::unordered_set<CandidateId>>*
@@ -1633,13 +1664,13 @@ static void get_beneficial_candidates(
       concurrent_candidates;
 
   walk::parallel::code(
-      scope, [&config, method_to_weight, &illegal_ref, &recurring_cores,
+      scope, [&config, &profile_guidance, &illegal_ref, &recurring_lengths,
               &concurrent_candidates](DexMethod* method, IRCode& code) {
-        if (!can_outline_from_method(method, method_to_weight)) {
+        if (!can_outline_from_method(method, profile_guidance)) {
           return;
         }
         for (auto& p : find_method_candidate_sequences(
-                 config, illegal_ref, method, code.cfg(), recurring_cores)) {
+                 config, illegal_ref, method, code.cfg(), recurring_lengths)) {
           std::vector<CandidateMethodLocation>& cmls = p.second;
           concurrent_candidates.update(p.first,
                                        [method, &cmls](const CandidateSequence&,
@@ -1928,11 +1959,13 @@ class OutlinedMethodCreator {
 };
 
 // Rewrite instruction sequence in existing method to invoke an outlined
-// method instead.
+// method instead. The changes are recorded in the given mutation, so that all
+// rewrites in a method can be flushed at once.
 static void rewrite_sequence_at_location(DexMethod* outlined_method,
                                          cfg::ControlFlowGraph& cfg,
                                          const CandidateSequence& cs,
-                                         const CandidateMethodLocation& cml) {
+                                         const CandidateMethodLocation& cml,
+                                         cfg::CFGMutation* cfg_mutation) {
   // Figure out argument and result registers
   auto first_insn_it = cfg.find_insn(cml.first_insn, cml.hint_block);
   if (first_insn_it.is_end()) {
@@ -1942,7 +1975,6 @@ static void rewrite_sequence_at_location(DexMethod* outlined_method,
     // occurrences after processing a candidate.
     always_assert(false);
   }
-  cfg::CFGMutation cfg_mutation(cfg);
   std::vector<reg_t> arg_regs;
   boost::optional<reg_t> res_reg;
   boost::optional<reg_t> highest_mapped_arg_reg;
@@ -1963,7 +1995,7 @@ static void rewrite_sequence_at_location(DexMethod* outlined_method,
       res_reg = it->insn->dest();
     }
     if (!opcode::is_move_result_any(it->insn->opcode())) {
-      cfg_mutation.remove(it.unwrap());
+      cfg_mutation->remove(it.unwrap());
     }
   }
   // Generate and insert invocation instructions
@@ -1981,10 +2013,44 @@ static void rewrite_sequence_at_location(DexMethod* outlined_method,
     move_result_insn->set_dest(*res_reg);
     outlined_method_invocation.push_back(move_result_insn);
   }
-  cfg_mutation.insert_before(first_insn_it, outlined_method_invocation);
-  cfg_mutation.flush();
+  cfg_mutation->insert_before(first_insn_it, outlined_method_invocation);
 };
 
+// A rewrite that the outline loop has decided on, to be applied once all
+// candidates have been selected.
+struct PendingRewrite {
+  DexMethod* outlined_method;
+  const CandidateSequence* sequence;
+  CandidateMethodLocation location;
+};
+
+using PendingRewrites =
+    std::unordered_map<DexMethod*, std::vector<PendingRewrite>>;
+
+// Apply all pending rewrites, in parallel across methods. Selected occurrences
+// never overlap, and the rewrites of a method are applied in the order in
+// which they were selected, so the result doesn't depend on scheduling.
+static void apply_rewrites(const PendingRewrites& pending_rewrites) {
+  auto wq = workqueue_foreach<const PendingRewrites::value_type*>(
+      [](const PendingRewrites::value_type* p) {
+        auto method = p->first;
+        auto& cfg = method->get_code()->cfg();
+        cfg::CFGMutation cfg_mutation(cfg);
+        for (auto& rewrite : p->second) {
+          rewrite_sequence_at_location(rewrite.outlined_method, cfg,
+                                       *rewrite.sequence, rewrite.location,
+                                       &cfg_mutation);
+        }
+        cfg_mutation.flush();
+        TRACE(ISO, 6, "[invoke sequence outliner] outlined from %s\n%s",
+              SHOW(method), SHOW(cfg));
+      });
+  for (auto& p : pending_rewrites) {
+    wq.add_item(&p);
+  }
+  wq.run_all();
+}
+
 // Manages references and assigns numeric ids to classes
 // We don't want to use more methods or types than are available, so we gather
 // all already used references in the given scope.
@@ -2061,13 +2127,23 @@ class DexState {
     always_assert(m_method_refs_count <= kMaxMethodRefs);
   }
 
-  // insert at beginning of dex, but after canary class, if any
-  void insert_outlined_class(DexClass* outlined_cls) {
+  // insert right before the given class, if any, or otherwise at beginning of
+  // dex, but after canary class, if any
+  void insert_outlined_class(DexClass* outlined_cls,
+                             DexType* next_type = nullptr) {
     auto it = m_dex.begin();
     for (; it != m_dex.end() &&
            (interdex::is_canary(*it) || is_outlined_class(*it));
          it++) {
     }
+    if (next_type != nullptr) {
+      auto next_it = std::find_if(it, m_dex.end(), [next_type](DexClass* cls) {
+        return cls->get_type() == next_type;
+      });
+      if (next_it != m_dex.end()) {
+        it = next_it;
+      }
+    }
     m_dex.insert(it, outlined_cls);
   }
 
@@ -2088,6 +2164,7 @@ class HostClassSelector {
   const InstructionSequenceOutlinerConfig& m_config;
   PassManager& m_mgr;
   DexState& m_dex_state;
+  bool m_place_near_callers;
   DexClass* m_outlined_cls{nullptr};
   size_t m_outlined_classes{0};
   size_t m_hosted_direct_count{0};
@@ -2100,8 +2177,12 @@ class HostClassSelector {
   HostClassSelector& operator=(const HostClassSelector&) = delete;
   HostClassSelector(const InstructionSequenceOutlinerConfig& config,
                     PassManager& mgr,
-                    DexState& dex_state)
-      : m_config(config), m_mgr(mgr), m_dex_state(dex_state) {}
+                    DexState& dex_state,
+                    bool place_near_callers)
+      : m_config(config),
+        m_mgr(mgr),
+        m_dex_state(dex_state),
+        m_place_near_callers(place_near_callers) {}
   ~HostClassSelector() {
     m_mgr.incr_metric("num_hosted_direct_count", m_hosted_direct_count);
     m_mgr.incr_metric("num_hosted_base_count", m_hosted_base_count);
@@ -2135,8 +2216,13 @@ class HostClassSelector {
     return DexType::make_type(name);
   }
 
-  // Create a new helper class into which we can place outlined methods.
-  void create_next_outlined_class() {
+  // Create a new helper class into which we can place outlined methods. With
+  // profile data, the beginning of the dex holds the classes that are loaded
+  // during startup, and the methods we outline from are cold; so we then place
+  // the helper class right before the first class hosting the given
+  // candidate's occurrences instead, keeping the outlined code in the same
+  // pages as its callers.
+  void create_next_outlined_class(const CandidateInfo& ci) {
     always_assert(reuse_last_outlined_class() == nullptr);
     auto outlined_type = peek_at_next_outlined_class();
     m_outlined_classes++;
@@ -2145,7 +2231,19 @@ class HostClassSelector {
     cc.set_super(type::java_lang_Object());
     m_outlined_cls = cc.create();
     m_outlined_cls->rstate.set_generated();
-    m_dex_state.insert_outlined_class(m_outlined_cls);
+    DexType* next_type{nullptr};
+    if (m_place_near_callers) {
+      boost::optional<size_t> next_class_id;
+      for (auto& p : ci.methods) {
+        auto type = p.first->get_class();
+        auto class_id = m_dex_state.get_class_id(type);
+        if (class_id && (!next_class_id || *class_id < *next_class_id)) {
+          next_class_id = class_id;
+          next_type = type;
+        }
+      }
+    }
+    m_dex_state.insert_outlined_class(m_outlined_cls, next_type);
   }
 
   DexType* get_direct_or_base_class(const CandidateSequence& cs,
@@ -2218,13 +2316,15 @@ class HostClassSelector {
   }
 };
 
-// Outlining all occurrences of a particular candidate sequence.
+// Outlining all occurrences of a particular candidate sequence. The occurrences
+// are only rewritten later, see apply_rewrites.
 bool outline_candidate(const CandidateSequence& cs,
                        const CandidateInfo& ci,
                        ReusableOutlinedMethods* reusable_outlined_methods,
                        DexState* dex_state,
                        HostClassSelector* host_class_selector,
-                       OutlinedMethodCreator* outlined_method_creator) {
+                       OutlinedMethodCreator* outlined_method_creator,
+                       PendingRewrites* pending_rewrites) {
   // Before attempting to create or reuse an outlined method that hasn't been
   // referenced in this dex before, we'll make sure that all the involved
   // type refs can be added to the dex. We collect those type refs.
@@ -2264,20 +2364,17 @@ bool outline_candidate(const CandidateSequence& cs,
       return false;
     }
     if (must_create_next_outlined_class) {
-      host_class_selector->create_next_outlined_class();
+      host_class_selector->create_next_outlined_class(ci);
     }
     outlined_method =
         outlined_method_creator->create_outlined_method(cs, ci, host_class);
   }
   dex_state->insert_type_refs(type_refs_to_insert);
   for (auto& p : ci.methods) {
-    auto method = p.first;
-    auto& cfg = method->get_code()->cfg();
+    auto& rewrites = (*pending_rewrites)[p.first];
     for (auto& cml : p.second) {
-      rewrite_sequence_at_location(outlined_method, cfg, cs, cml);
+      rewrites.push_back({outlined_method, &cs, cml});
     }
-    TRACE(ISO, 6, "[invoke sequence outliner] outlined from %s\n%s",
-          SHOW(method), SHOW(cfg));
   }
   if (can_reuse && reusable_outlined_methods) {
     // The newly created outlined method was placed in a new helper class
@@ -2296,10 +2393,12 @@ static void outline(
     std::vector<Candidate>* candidates,
     std::unordered_map<DexMethod*, std::unordered_set<CandidateId>>*
         candidate_ids_by_methods,
-    ReusableOutlinedMethods* reusable_outlined_methods) {
+    ReusableOutlinedMethods* reusable_outlined_methods,
+    bool place_near_callers) {
   MethodNameGenerator method_name_generator(mgr);
   OutlinedMethodCreator outlined_method_creator(mgr, method_name_generator);
-  HostClassSelector host_class_selector(config, mgr, dex_state);
+  HostClassSelector host_class_selector(config, mgr, dex_state,
+                                        place_near_callers);
   // While we have a set of beneficial candidates, many are overlapping each
   // other. We are using a priority queue to iteratively outline the most
   // beneficial candidate at any point in time, then removing all impacted
@@ -2335,6 +2434,7 @@ static void outline(
   size_t outlined_count{0};
   size_t outlined_sequences_count{0};
   size_t not_outlined_count{0};
+  PendingRewrites pending_rewrites;
   while (!pq.empty()) {
     // Make sure beforehand that there's a method ref left for us
     if (!dex_state.can_insert_method_ref()) {
@@ -2355,7 +2455,7 @@ static void outline(
           c.info.count, c.info.methods.size(), c.sequence.size, 2 * savings);
     if (outline_candidate(c.sequence, c.info, reusable_outlined_methods,
                           &dex_state, &host_class_selector,
-                          &outlined_method_creator)) {
+                          &outlined_method_creator, &pending_rewrites)) {
       dex_state.insert_method_ref();
     } else {
       TRACE(ISO, 3, "[invoke sequence outliner] could not ouline");
@@ -2406,6 +2506,7 @@ static void outline(
       }
     }
   }
+  apply_rewrites(pending_rewrites);
 
   mgr.incr_metric("num_not_outlined", not_outlined_count);
   TRACE(ISO, 2, "[invoke sequence outliner] %zu not outlined",
@@ -2424,12 +2525,11 @@ static void outline(
 // clear_cfgs
 ////////////////////////////////////////////////////////////////////////////////
 
-static void clear_cfgs(
-    const Scope& scope,
-    const std::unordered_map<std::string, unsigned int>* method_to_weight) {
+static void clear_cfgs(const Scope& scope,
+                       const ProfileGuidance& profile_guidance) {
   walk::parallel::code(
-      scope, [&method_to_weight](DexMethod* method, IRCode& code) {
-        if (!can_outline_from_method(method, method_to_weight)) {
+      scope, [&profile_guidance](DexMethod* method, IRCode& code) {
+        if (!can_outline_from_method(method, profile_guidance)) {
           return;
         }
         code.clear_cfg();
@@ -2466,6 +2566,16 @@ void InstructionSequenceOutliner::bind_config() {
   bind("threshold", m_config.threshold, m_config.threshold,
        "Minimum number of code units saved before a particular code sequence "
        "is outlined anywhere");
+  bind("use_method_profiles", m_config.use_method_profiles,
+       m_config.use_method_profiles,
+       "Whether to use provided cold start method profiles to determine if a "
+       "method should not be outlined from, and where to place outlined "
+       "helper classes");
+  bind("method_profiles_appear_percent",
+       m_config.method_profiles_appear_percent,
+       m_config.method_profiles_appear_percent,
+       "Methods that appear in at least this percentage of cold start samples "
+       "are not outlined from");
   always_assert(m_config.min_insns_size >= MIN_INSNS_SIZE);
   always_assert(m_config.max_insns_size >= m_config.min_insns_size);
   always_assert(m_config.max_outlined_methods_per_class > 0);
@@ -2474,8 +2584,17 @@ void InstructionSequenceOutliner::bind_config() {
 void InstructionSequenceOutliner::run_pass(DexStoresVector& stores,
                                            ConfigFiles& config,
                                            PassManager& mgr) {
-  const std::unordered_map<std::string, unsigned int>* method_to_weight =
-      m_config.use_method_to_weight ? &config.get_method_to_weight() : nullptr;
+  ProfileGuidance profile_guidance;
+  if (m_config.use_method_to_weight) {
+    profile_guidance.method_to_weight = &config.get_method_to_weight();
+  }
+  const auto& method_profiles = config.get_method_profiles();
+  if (m_config.use_method_profiles && method_profiles.has_stats()) {
+    profile_guidance.cold_start_stats =
+        &method_profiles.method_stats(method_profiles::COLD_START);
+    profile_guidance.max_appear_percent =
+        m_config.method_profiles_appear_percent;
+  }
   XStoreRefs xstores(stores);
   size_t dex_id{0};
   const auto& interdex_metrics = mgr.get_interdex_metrics();
@@ -2514,14 +2633,14 @@ void InstructionSequenceOutliner::run_pass(DexStoresVector& stores,
         // on some Android versions are problematic as well.
         return xstores.illegal_ref(store_idx, t);
       };
-      CandidateInstructionCoresSet recurring_cores;
-      get_recurring_cores(mgr, dex, method_to_weight, illegal_ref,
-                          &recurring_cores);
+      RecurringSequenceLengths recurring_lengths;
+      get_recurring_sequences(mgr, dex, profile_guidance, illegal_ref,
+                              &recurring_lengths);
       std::vector<Candidate> candidates;
       std::unordered_map<DexMethod*, std::unordered_set<CandidateId>>
           candidate_ids_by_methods;
-      get_beneficial_candidates(m_config, mgr, dex, method_to_weight,
-                                illegal_ref, recurring_cores,
+      get_beneficial_candidates(m_config, mgr, dex, profile_guidance,
+                                illegal_ref, recurring_lengths,
                                 reusable_outlined_methods.get(), &candidates,
                                 &candidate_ids_by_methods);
 
@@ -2529,8 +2648,10 @@ void InstructionSequenceOutliner::run_pass(DexStoresVector& stores,
       // something and the other doesn't.
       DexState dex_state(mgr, dex, dex_id++, reserved_mrefs);
       outline(m_config, mgr, dex_state, &candidates, &candidate_ids_by_methods,
-              reusable_outlined_methods.get());
-      clear_cfgs(dex, method_to_weight);
+              reusable_outlined_methods.get(),
+              /* place_near_callers */
+              profile_guidance.cold_start_stats != nullptr);
+      clear_cfgs(dex, profile_guidance);
     }
   }
 }
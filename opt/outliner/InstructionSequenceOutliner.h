@@ -18,6 +18,8 @@ struct InstructionSequenceOutlinerConfig {
   bool reuse_outlined_methods_across_dexes{true};
   size_t max_outlined_methods_per_class{100};
   size_t threshold{10};
+  bool use_method_profiles{true};
+  float method_profiles_appear_percent{1};
 };
 
 class InstructionSequenceOutliner : public Pass {
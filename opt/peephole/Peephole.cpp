@@ -8,6 +8,7 @@
 #include "Peephole.h"
 
 #include <algorithm>
+#include <bitset>
 #include <cmath>
 #include <numeric>
 #include <unordered_map>
@@ -1679,11 +1680,15 @@ bool contains(const std::vector<T>& vec, const T& value) {
   return std::find(vec.begin(), vec.end(), value) != vec.end();
 }
 
+using OpcodeSet = std::bitset<IOPCODE_MOVE_RESULT_PSEUDO_WIDE + 1>;
+
 // Each thread will have its own instance of PeepholeOptimizer, so align it in
 // order to avoid false sharing.
 class alignas(CACHE_LINE_SIZE) PeepholeOptimizer {
  private:
   std::vector<Matcher> m_matchers;
+  // For each matcher, the opcodes each of its 'match' patterns accepts.
+  std::vector<std::vector<OpcodeSet>> m_match_opcodes;
   std::vector<size_t> m_stats;
   PassManager& m_mgr;
   int m_stats_removed = 0;
@@ -1709,6 +1714,15 @@ class alignas(CACHE_LINE_SIZE) PeepholeOptimizer {
       for (const Pattern& pattern : pattern_list) {
         if (!contains(disabled_peepholes, pattern.name)) {
           m_matchers.emplace_back(pattern);
+          std::vector<OpcodeSet> match_opcodes;
+          for (const auto& dex_pattern : pattern.match) {
+            OpcodeSet opcodes;
+            for (auto op : dex_pattern.opcodes) {
+              opcodes.set(op);
+            }
+            match_opcodes.push_back(opcodes);
+          }
+          m_match_opcodes.push_back(std::move(match_opcodes));
         } else {
           TRACE(PEEPHOLE,
                 2,
@@ -1728,10 +1742,26 @@ class alignas(CACHE_LINE_SIZE) PeepholeOptimizer {
     code->build_cfg(/* editable */ true);
     auto& cfg = code->cfg();
 
+    // The opcodes that may occur in the method. Instructions that get removed
+    // stay in, which is fine as it only has to be a superset.
+    OpcodeSet present;
+    for (auto& mie : InstructionIterable(cfg)) {
+      present.set(mie.insn->opcode());
+    }
+
     // do optimizations one at a time
     // so they can match on the same pattern without interfering
     for (size_t i = 0; i < m_matchers.size(); ++i) {
       auto& matcher = m_matchers[i];
+      const auto& match_opcodes = m_match_opcodes[i];
+      // Most patterns need an opcode the method does not have; skip those.
+      if (std::any_of(match_opcodes.begin(), match_opcodes.end(),
+                      [&present](const OpcodeSet& opcodes) {
+                        return (opcodes & present).none();
+                      })) {
+        continue;
+      }
+      const auto& first_opcodes = match_opcodes[0];
 
       const auto& blocks = cfg.blocks();
       cfg::CFGMutation mutator(cfg);
@@ -1746,6 +1776,12 @@ class alignas(CACHE_LINE_SIZE) PeepholeOptimizer {
         std::unordered_set<IRInstruction*> removed_insns;
 
         for (auto& mie : InstructionIterable(block)) {
+          // Without a partial match, the matcher is reset and would fail right
+          // away on an instruction the first pattern does not accept.
+          if (matcher.match_index == 0 &&
+              !first_opcodes.test(mie.insn->opcode())) {
+            continue;
+          }
           if (!matcher.try_match(mie.insn)) {
             continue;
           }
@@ -1767,6 +1803,7 @@ class alignas(CACHE_LINE_SIZE) PeepholeOptimizer {
             auto replace = matcher.get_replacements();
             for (const auto& r : replace) {
               TRACE(PEEPHOLE, 8, "-- %s", SHOW(r));
+              present.set(r->opcode());
             }
             mutator.insert_before(it, replace);
 
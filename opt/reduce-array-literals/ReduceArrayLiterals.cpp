@@ -343,6 +343,182 @@ class Analyzer final : public BaseIRAnalyzer<TrackedDomainEnvironment> {
       m_escaped_arrays;
 };
 
+/**
+ * Computes the same array literals as the Analyzer, but for a CFG that is a
+ * single block. There is nothing to join then, so instead of the abstract
+ * environment a single pass keeps the aput instructions of each tracked array
+ * in a plain vector. This keeps huge generated array initializations linear
+ * in time and memory.
+ **/
+class StraightLineScanner final {
+ public:
+  explicit StraightLineScanner(cfg::Block* block) {
+    for (auto& mie : InstructionIterable(block)) {
+      analyze_instruction(mie.insn);
+    }
+  }
+
+  std::unordered_map<const IRInstruction*, std::vector<const IRInstruction*>>
+  get_array_literals() {
+    std::unordered_map<const IRInstruction*, std::vector<const IRInstruction*>>
+        result;
+    for (auto& p : m_escaped_arrays) {
+      if (p.second) {
+        result.emplace(p.first, std::move(*p.second));
+      }
+    }
+    return result;
+  }
+
+ private:
+  struct Array {
+    const IRInstruction* new_array_insn;
+    uint32_t length;
+    std::vector<const IRInstruction*> aput_insns;
+  };
+
+  // A register holds a literal, an index into m_arrays, or, if it isn't in
+  // m_regs, some other value.
+  struct Value {
+    bool is_literal;
+    int32_t literal;
+    size_t array;
+  };
+
+  const Value* get(reg_t reg) const {
+    auto it = m_regs.find(reg);
+    return it == m_regs.end() ? nullptr : &it->second;
+  }
+
+  boost::optional<int64_t> get_literal(reg_t reg) const {
+    auto value = get(reg);
+    if (value == nullptr || !value->is_literal) {
+      return boost::none;
+    }
+    return value->literal;
+  }
+
+  Array* get_array(reg_t reg) {
+    auto value = get(reg);
+    if (value == nullptr || value->is_literal) {
+      return nullptr;
+    }
+    return &m_arrays[value->array];
+  }
+
+  void set_other(reg_t reg, bool wide) {
+    m_regs.erase(reg);
+    if (wide) {
+      m_regs.erase(reg + 1);
+    }
+  }
+
+  void escape(reg_t reg) {
+    auto array = get_array(reg);
+    if (array == nullptr) {
+      return;
+    }
+    if (array->aput_insns.size() != array->length) {
+      TRACE(RAL, 4, "[RAL]   non-literal array escaped");
+      m_escaped_arrays[array->new_array_insn] = boost::none;
+      return;
+    }
+    TRACE(RAL, 4, "[RAL]   literal array escaped");
+    auto it = m_escaped_arrays.find(array->new_array_insn);
+    if (it == m_escaped_arrays.end()) {
+      m_escaped_arrays.emplace(array->new_array_insn, array->aput_insns);
+    } else if (it->second && *it->second != array->aput_insns) {
+      it->second = boost::none;
+    }
+  }
+
+  void default_case(const IRInstruction* insn) {
+    for (size_t i = 0; i < insn->srcs_size(); i++) {
+      escape(insn->src(i));
+    }
+    if (insn->has_dest()) {
+      set_other(insn->dest(), insn->dest_is_wide());
+    } else if (insn->has_move_result_any()) {
+      set_other(RESULT_REGISTER, false);
+    }
+  }
+
+  void analyze_instruction(const IRInstruction* insn) {
+    TRACE(RAL, 3, "[RAL] %s", SHOW(insn));
+    switch (insn->opcode()) {
+    case OPCODE_CONST:
+      m_regs[insn->dest()] = {true, (int32_t)insn->get_literal(), 0};
+      break;
+
+    case OPCODE_NEW_ARRAY: {
+      auto length = get_literal(insn->src(0));
+      if (length) {
+        always_assert(*length >= 0 && *length <= 2147483647);
+        m_arrays.push_back({insn, (uint32_t)*length, {}});
+        m_regs[RESULT_REGISTER] = {false, 0, m_arrays.size() - 1};
+        break;
+      }
+      m_escaped_arrays[insn] = boost::none;
+      default_case(insn);
+      break;
+    }
+
+    case IOPCODE_MOVE_RESULT_PSEUDO_OBJECT: {
+      // The result register is always overwritten before it is read again,
+      // so the array can move instead of being shared with it.
+      auto it = m_regs.find(RESULT_REGISTER);
+      if (it == m_regs.end()) {
+        set_other(insn->dest(), false);
+      } else {
+        m_regs[insn->dest()] = it->second;
+        m_regs.erase(RESULT_REGISTER);
+      }
+      break;
+    }
+
+    case OPCODE_APUT:
+    case OPCODE_APUT_BYTE:
+    case OPCODE_APUT_CHAR:
+    case OPCODE_APUT_WIDE:
+    case OPCODE_APUT_SHORT:
+    case OPCODE_APUT_OBJECT:
+    case OPCODE_APUT_BOOLEAN: {
+      escape(insn->src(0));
+      auto array = get_array(insn->src(1));
+      auto index = get_literal(insn->src(2));
+      if (array && array->aput_insns.size() != array->length && index &&
+          *index == (int64_t)array->aput_insns.size()) {
+        array->aput_insns.push_back(insn);
+        break;
+      }
+      default_case(insn);
+      break;
+    }
+
+    case OPCODE_MOVE: {
+      auto value = get(insn->src(0));
+      if (value && value->is_literal) {
+        m_regs[insn->dest()] = *value;
+        break;
+      }
+      default_case(insn);
+      break;
+    }
+
+    default:
+      default_case(insn);
+      break;
+    }
+  }
+
+  std::unordered_map<reg_t, Value> m_regs;
+  std::vector<Array> m_arrays;
+  // Escaped arrays, with boost::none for those that aren't array literals.
+  std::unordered_map<const IRInstruction*,
+                     boost::optional<std::vector<const IRInstruction*>>>
+      m_escaped_arrays;
+};
+
 } // namespace
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -368,8 +544,15 @@ ReduceArrayLiterals::ReduceArrayLiterals(cfg::ControlFlowGraph& cfg,
     return;
   }
 
-  Analyzer analyzer(cfg);
-  auto array_literals = analyzer.get_array_literals();
+  std::unordered_map<const IRInstruction*, std::vector<const IRInstruction*>>
+      array_literals;
+  if (cfg.blocks().size() == 1) {
+    StraightLineScanner scanner(cfg.entry_block());
+    array_literals = scanner.get_array_literals();
+  } else {
+    Analyzer analyzer(cfg);
+    array_literals = analyzer.get_array_literals();
+  }
   // sort array literals by order of occurrence for determinism
   for (IRInstruction* new_array_insn : new_array_insns) {
     auto it = array_literals.find(new_array_insn);
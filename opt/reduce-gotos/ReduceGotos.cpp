@@ -489,12 +489,11 @@ ReduceGotosPass::Stats ReduceGotosPass::process_code(IRCode* code) {
   return stats;
 }
 
-void ReduceGotosPass::run_pass(DexStoresVector& stores,
-                               ConfigFiles& /* unused */,
-                               PassManager& mgr) {
-  auto scope = build_class_scope(stores);
-
-  Stats stats = walk::parallel::methods<Stats>(scope, [](DexMethod* method) {
+std::unique_ptr<MethodLocalTransform>
+ReduceGotosPass::make_method_local_transform(DexStoresVector&,
+                                             ConfigFiles& /* unused */,
+                                             PassManager&) {
+  auto transform = [](DexMethod* method) {
     const auto code = method->get_code();
     if (!code) {
       return Stats{};
@@ -511,32 +510,36 @@ void ReduceGotosPass::run_pass(DexStoresVector& stores,
             stats.inverted_conditional_branches, SHOW(method));
     }
     return stats;
-  });
-
-  mgr.incr_metric(METRIC_REMOVED_SWITCHES, stats.removed_switches);
-  mgr.incr_metric(METRIC_REDUCED_SWITCHES, stats.reduced_switches);
-  mgr.incr_metric(METRIC_REMAINING_TRIVIAL_SWITCHES,
-                  stats.remaining_trivial_switches);
-  mgr.incr_metric(METRIC_REPLACED_TRIVIAL_SWITCHES,
-                  stats.replaced_trivial_switches);
-  mgr.incr_metric(METRIC_REMAINING_RANGE_SWITCHES,
-                  stats.remaining_range_switches);
-  mgr.incr_metric(METRIC_REMAINING_RANGE_SWITCH_CASES,
-                  stats.remaining_range_switch_cases);
-  mgr.incr_metric(METRIC_REMAINING_TWO_CASE_SWITCHES,
-                  stats.remaining_two_case_switches);
-  mgr.incr_metric(METRIC_REMOVED_SWITCH_CASES, stats.removed_switch_cases);
-  mgr.incr_metric(METRIC_GOTOS_REPLACED_WITH_RETURNS,
-                  stats.replaced_gotos_with_returns);
-  mgr.incr_metric(METRIC_TRAILING_MOVES_REMOVED, stats.removed_trailing_moves);
-  mgr.incr_metric(METRIC_INVERTED_CONDITIONAL_BRANCHES,
-                  stats.inverted_conditional_branches);
-  mgr.incr_metric(METRIC_NUM_GOTOS_REPLACED_WITH_THROWS,
-                  stats.replaced_gotos_with_throws);
-  TRACE(RG, 1,
-        "[reduce gotos] Replaced %u gotos with returns, inverted %u "
-        "conditional brnaches in total",
-        stats.replaced_gotos_with_returns, stats.inverted_conditional_branches);
+  };
+  auto report = [](const Stats& stats, PassManager& mgr) {
+    mgr.incr_metric(METRIC_REMOVED_SWITCHES, stats.removed_switches);
+    mgr.incr_metric(METRIC_REDUCED_SWITCHES, stats.reduced_switches);
+    mgr.incr_metric(METRIC_REMAINING_TRIVIAL_SWITCHES,
+                    stats.remaining_trivial_switches);
+    mgr.incr_metric(METRIC_REPLACED_TRIVIAL_SWITCHES,
+                    stats.replaced_trivial_switches);
+    mgr.incr_metric(METRIC_REMAINING_RANGE_SWITCHES,
+                    stats.remaining_range_switches);
+    mgr.incr_metric(METRIC_REMAINING_RANGE_SWITCH_CASES,
+                    stats.remaining_range_switch_cases);
+    mgr.incr_metric(METRIC_REMAINING_TWO_CASE_SWITCHES,
+                    stats.remaining_two_case_switches);
+    mgr.incr_metric(METRIC_REMOVED_SWITCH_CASES, stats.removed_switch_cases);
+    mgr.incr_metric(METRIC_GOTOS_REPLACED_WITH_RETURNS,
+                    stats.replaced_gotos_with_returns);
+    mgr.incr_metric(METRIC_TRAILING_MOVES_REMOVED,
+                    stats.removed_trailing_moves);
+    mgr.incr_metric(METRIC_INVERTED_CONDITIONAL_BRANCHES,
+                    stats.inverted_conditional_branches);
+    mgr.incr_metric(METRIC_NUM_GOTOS_REPLACED_WITH_THROWS,
+                    stats.replaced_gotos_with_throws);
+    TRACE(RG, 1,
+          "[reduce gotos] Replaced %u gotos with returns, inverted %u "
+          "conditional brnaches in total",
+          stats.replaced_gotos_with_returns,
+          stats.inverted_conditional_branches);
+  };
+  return std::make_unique<StatsMethodLocalTransform<Stats>>(transform, report);
 }
 
 ReduceGotosPass::Stats& ReduceGotosPass::Stats::operator+=(
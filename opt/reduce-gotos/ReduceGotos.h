@@ -7,9 +7,9 @@
 
 #pragma once
 
-#include "Pass.h"
+#include "MethodLocalTransform.h"
 
-class ReduceGotosPass : public Pass {
+class ReduceGotosPass : public MethodLocalPass {
  public:
   struct Stats {
     size_t removed_switches{0};
@@ -28,9 +28,10 @@ class ReduceGotosPass : public Pass {
     Stats& operator+=(const Stats&);
   };
 
-  ReduceGotosPass() : Pass("ReduceGotosPass") {}
+  ReduceGotosPass() : MethodLocalPass("ReduceGotosPass") {}
 
-  void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
+  std::unique_ptr<MethodLocalTransform> make_method_local_transform(
+      DexStoresVector&, ConfigFiles&, PassManager&) override;
 
   static Stats process_code(IRCode*);
   static void process_code_switches(cfg::ControlFlowGraph&, Stats&);
@@ -17,6 +17,7 @@
 #include "Dominators.h"
 #include "IRCode.h"
 #include "Show.h"
+#include "SmallMethodAllocator.h"
 #include "Transform.h"
 #include "VirtualRegistersFile.h"
 
@@ -306,6 +307,18 @@ std::string show(const RegisterTransform& reg_transform) {
 
 } // namespace
 
+void AllocatorScratch::clear() {
+  using interference::impl::clear_for_reuse;
+  ig.clear();
+  clear_for_reuse(&split_costs.reg_constraints);
+  clear_for_reuse(&spill_plan.global_spills);
+  clear_for_reuse(&spill_plan.param_spills);
+  clear_for_reuse(&spill_plan.range_spills);
+  clear_for_reuse(&split_plan.split_around);
+  clear_for_reuse(&reg_transform.map);
+  reg_transform.size = 0;
+}
+
 Allocator::Stats& Allocator::Stats::operator+=(const Allocator::Stats& that) {
   reiteration_count += that.reiteration_count;
   param_spill_moves += that.param_spill_moves;
@@ -314,6 +327,7 @@ Allocator::Stats& Allocator::Stats::operator+=(const Allocator::Stats& that) {
   split_moves += that.split_moves;
   moves_coalesced += that.moves_coalesced;
   params_spill_early += that.params_spill_early;
+  small_methods_allocated += that.small_methods_allocated;
   return *this;
 }
 
@@ -848,7 +862,7 @@ std::unordered_map<reg_t, IRList::iterator> Allocator::find_param_splits(
 
   auto& cfg = code->cfg();
   cfg::Block* start_block = cfg.entry_block();
-  auto doms = dominators::SimpleFastDominators<cfg::GraphInterface>(cfg);
+  const auto& doms = cfg.get_dominators();
   for (auto param : params) {
     auto block_uses = find_first_uses(param, start_block);
     // Since this function only gets called for param regs that need to be
@@ -1066,6 +1080,11 @@ static void dedicate_this_register(DexMethod* method) {
  *     respectively.
  */
 void Allocator::allocate(DexMethod* method) {
+  AllocatorScratch scratch;
+  allocate(method, &scratch);
+}
+
+void Allocator::allocate(DexMethod* method, AllocatorScratch* scratch) {
   IRCode* code = method->get_code();
 
   // Any temp larger than this is the result of the spilling process
@@ -1080,12 +1099,20 @@ void Allocator::allocate(DexMethod* method) {
   if (no_overwrite_this) {
     dedicate_this_register(method);
   }
+  // Params get registers of their own with the small method allocator, so
+  // `this` is never overwritten there either.
+  if (m_config.use_small_method_allocator &&
+      small_method::try_allocate(code, range_set, &m_stats.moves_coalesced)) {
+    ++m_stats.small_methods_allocated;
+    return;
+  }
   bool first{true};
   while (true) {
-    SplitCosts split_costs;
-    SpillPlan spill_plan;
-    SplitPlan split_plan;
-    RegisterTransform reg_transform;
+    scratch->clear();
+    auto& split_costs = scratch->split_costs;
+    auto& spill_plan = scratch->spill_plan;
+    auto& split_plan = scratch->split_plan;
+    auto& reg_transform = scratch->reg_transform;
 
     auto& cfg = code->cfg();
     cfg.calculate_exit_block();
@@ -1093,8 +1120,9 @@ void Allocator::allocate(DexMethod* method) {
     fixpoint_iter.run(LivenessDomain());
 
     TRACE(REG, 5, "Allocating:\n%s", ::SHOW(code->cfg()));
-    auto ig =
-        interference::build_graph(fixpoint_iter, code, initial_regs, range_set);
+    auto& ig = scratch->ig;
+    interference::build_graph(fixpoint_iter, code, initial_regs, range_set,
+                              &ig);
 
     // Make the `this` symreg conflict with every other one so that it never
     // gets overwritten in the method. See check_no_overwrite_this in
@@ -77,12 +77,29 @@ struct RegisterTransform {
  *    Allocation for Irregular Architectures. Technical report, Harvard
  *    University, 2000.
  */
+/*
+ * The containers that Allocator::allocate rebuilds in every round. Passing
+ * the same instance to many calls, e.g. one per worker thread, lets them keep
+ * their memory across rounds and methods instead of reallocating it.
+ */
+struct AllocatorScratch {
+  interference::Graph ig;
+  SplitCosts split_costs;
+  SpillPlan spill_plan;
+  SplitPlan split_plan;
+  RegisterTransform reg_transform;
+
+  void clear();
+};
+
 class Allocator {
 
  public:
   struct Config {
     bool no_overwrite_this{false};
     bool use_splitting{false};
+    // Try small_method::try_allocate before falling back to graph coloring.
+    bool use_small_method_allocator{false};
   };
 
   struct Stats {
@@ -93,6 +110,7 @@ class Allocator {
     size_t split_moves{0};
     size_t moves_coalesced{0};
     size_t params_spill_early{0};
+    size_t small_methods_allocated{0};
     size_t moves_inserted() const {
       return param_spill_moves + range_spill_moves + global_spill_moves +
              split_moves;
@@ -153,6 +171,8 @@ class Allocator {
 
   void allocate(DexMethod*);
 
+  void allocate(DexMethod*, AllocatorScratch*);
+
   const Stats& get_stats() const { return m_stats; }
 
  private:
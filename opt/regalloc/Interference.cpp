@@ -70,7 +70,7 @@ void Graph::add_edge(reg_t u, reg_t v, bool can_coalesce) {
   if (u == v) {
     return;
   }
-  if (!is_adjacent(u, v)) {
+  if (m_adj_matrix.insert(u, v)) {
     auto& u_node = m_nodes.at(u);
     auto& v_node = m_nodes.at(v);
     u_node.m_adjacent.push_back(v);
@@ -87,8 +87,9 @@ void Graph::add_edge(reg_t u, reg_t v, bool can_coalesce) {
   //
   // then the final state of the edge between s0 and s1 must be
   // non-coalesceable.
-  m_adj_matrix[build_edge(u, v)] =
-      m_adj_matrix[build_edge(u, v)] || !can_coalesce;
+  if (!can_coalesce) {
+    m_non_coalesceable.insert(u, v);
+  }
 }
 
 uint32_t Node::colorable_limit() const {
@@ -122,6 +123,14 @@ void Graph::combine(reg_t u, reg_t v) {
   v_node.m_props.reset(Node::ACTIVE);
 }
 
+void Graph::clear() {
+  clear_for_reuse(&m_nodes);
+  m_adj_matrix.clear();
+  m_non_coalesceable.clear();
+  m_containment_graph.clear();
+  clear_for_reuse(&m_range_liveness);
+}
+
 void Graph::remove_node(reg_t u) {
   auto& u_node = m_nodes.at(u);
   for (auto v : u_node.adjacent()) {
@@ -270,6 +279,17 @@ Graph GraphBuilder::build(const LivenessFixpointIterator& fixpoint_iter,
                           reg_t initial_regs,
                           const RangeSet& range_set) {
   Graph graph;
+  build(fixpoint_iter, code, initial_regs, range_set, &graph);
+  return graph;
+}
+
+void GraphBuilder::build(const LivenessFixpointIterator& fixpoint_iter,
+                         IRCode* code,
+                         reg_t initial_regs,
+                         const RangeSet& range_set,
+                         Graph* graph_ptr) {
+  auto& graph = *graph_ptr;
+  graph.clear();
   auto ii = InstructionIterable(code);
   for (auto it = ii.begin(); it != ii.end(); ++it) {
     GraphBuilder::update_node_constraints(it.unwrap(), range_set, &graph);
@@ -344,7 +364,6 @@ Graph GraphBuilder::build(const LivenessFixpointIterator& fixpoint_iter,
                reg,
                SHOW(code));
   }
-  return graph;
 }
 
 std::ostream& Graph::write_dot_format(std::ostream& o) const {
@@ -363,11 +382,9 @@ std::ostream& Graph::write_dot_format(std::ostream& o) const {
   o << "}\n";
 
   o << "containment graph {\n";
-  for (const auto& pair : m_containment_graph) {
-    reg_t reg1 = static_cast<reg_t>((pair & 0xFFFFFFFF00000000) >> 32);
-    reg_t reg2 = static_cast<reg_t>(pair & 0x00000000FFFFFFFF);
+  m_containment_graph.for_each([&o](reg_t reg1, reg_t reg2) {
     o << reg1 << " -- " << reg2 << "\n";
-  }
+  });
   o << "}\n";
   return o;
 }
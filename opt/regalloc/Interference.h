@@ -79,15 +79,124 @@ inline reg_pair_t build_containment_edge(reg_t u, reg_t v) {
   return (hi << (sizeof(reg_t) * 8)) | lo;
 }
 
-inline reg_pair_t build_edge(reg_t u, reg_t v) {
-  reg_pair_t hi = static_cast<reg_pair_t>(u);
-  reg_pair_t lo = static_cast<reg_pair_t>(v);
-  if (u > v) {
-    std::swap(hi, lo);
+/*
+ * Clear a hash container for reuse. It keeps its buckets unless one huge
+ * method made it grow far beyond what most methods need, because clearing
+ * takes time proportional to the number of buckets.
+ */
+template <typename Container>
+void clear_for_reuse(Container* container) {
+  constexpr size_t MAX_RETAINED_BUCKETS = 1u << 12;
+  if (container->bucket_count() > MAX_RETAINED_BUCKETS) {
+    Container().swap(*container);
+  } else {
+    container->clear();
   }
-  return (hi << (sizeof(reg_t) * 8)) | lo;
 }
 
+/*
+ * A set of pairs of registers. Symbolic registers are numbered densely from
+ * zero, so for all but the largest methods the pairs are kept in a bit matrix:
+ * row v holds one bit per register u < v if the pairs are unordered, or one
+ * bit per register u if they are ordered. Rows grow on demand. Pairs with a
+ * register beyond MAX_DENSE_REG go to a hash set instead, which bounds the
+ * matrix at 8MB.
+ */
+template <bool Symmetric>
+class RegPairSet {
+ public:
+  static constexpr reg_t MAX_DENSE_REG = 1u << 13;
+
+  bool contains(reg_t u, reg_t v) const {
+    normalize(u, v);
+    if (v >= MAX_DENSE_REG || u >= MAX_DENSE_REG) {
+      return m_sparse.count(build_containment_edge(u, v)) != 0;
+    }
+    if (v >= m_num_rows) {
+      return false;
+    }
+    const auto& row = m_rows[v];
+    return (u >> 6) < row.size() && (row[u >> 6] >> (u & 63)) & 1;
+  }
+
+  // Returns whether the pair was not in the set before.
+  bool insert(reg_t u, reg_t v) {
+    normalize(u, v);
+    if (v >= MAX_DENSE_REG || u >= MAX_DENSE_REG) {
+      return m_sparse.emplace(build_containment_edge(u, v)).second;
+    }
+    if (v >= m_num_rows) {
+      if (v >= m_rows.size()) {
+        m_rows.resize(v + 1);
+      }
+      m_num_rows = v + 1;
+    }
+    auto& row = m_rows[v];
+    if ((u >> 6) >= row.size()) {
+      row.resize((u >> 6) + 1, 0);
+    }
+    uint64_t bit = uint64_t(1) << (u & 63);
+    bool inserted = (row[u >> 6] & bit) == 0;
+    row[u >> 6] |= bit;
+    return inserted;
+  }
+
+  /*
+   * Calls fn(u, v) for each pair, as inserted for ordered pairs and with
+   * u < v for unordered ones.
+   */
+  template <typename Fn>
+  void for_each(Fn fn) const {
+    for (reg_t v = 0; v < m_num_rows; ++v) {
+      const auto& row = m_rows[v];
+      for (size_t w = 0; w < row.size(); ++w) {
+        for (uint64_t bits = row[w]; bits != 0; bits &= bits - 1) {
+          auto u = static_cast<reg_t>(w * 64 + __builtin_ctzll(bits));
+          call(fn, u, v);
+        }
+      }
+    }
+    for (auto pair : m_sparse) {
+      auto u = static_cast<reg_t>(pair >> (sizeof(reg_t) * 8));
+      auto v = static_cast<reg_t>(pair);
+      call(fn, u, v);
+    }
+  }
+
+  // Remove all pairs, keeping the memory of the rows for reuse.
+  void clear() {
+    for (size_t v = 0; v < m_num_rows; ++v) {
+      m_rows[v].clear();
+    }
+    m_num_rows = 0;
+    clear_for_reuse(&m_sparse);
+  }
+
+ private:
+  // Unordered pairs are stored in the row of their larger register; ordered
+  // pairs (u, v) in row u.
+  static void normalize(reg_t& u, reg_t& v) {
+    if (!Symmetric || u > v) {
+      std::swap(u, v);
+    }
+  }
+
+  // The inverse of normalize.
+  template <typename Fn>
+  static void call(Fn& fn, reg_t u, reg_t v) {
+    if (Symmetric) {
+      fn(u, v);
+    } else {
+      fn(v, u);
+    }
+  }
+
+  // Rows at or beyond m_num_rows are empty but may still have capacity.
+  std::vector<std::vector<uint64_t>> m_rows;
+  size_t m_num_rows{0};
+  std::unordered_set<reg_pair_t> m_sparse;
+};
+
 } // namespace impl
 
 class Node {
@@ -191,16 +300,15 @@ class Graph {
   }
 
   bool is_adjacent(reg_t u, reg_t v) const {
-    return m_adj_matrix.find(impl::build_edge(u, v)) != m_adj_matrix.end();
+    return m_adj_matrix.contains(u, v);
   }
 
   bool is_coalesceable(reg_t u, reg_t v) const {
-    return !is_adjacent(u, v) || !m_adj_matrix.at(impl::build_edge(u, v));
+    return !m_non_coalesceable.contains(u, v);
   }
 
   bool has_containment_edge(reg_t u, reg_t v) const {
-    return m_containment_graph.find(impl::build_containment_edge(u, v)) !=
-           m_containment_graph.end();
+    return m_containment_graph.contains(u, v);
   }
 
   /*
@@ -226,6 +334,12 @@ class Graph {
 
   uint32_t edge_weight(const Node&, const Node&) const;
 
+  /*
+   * Remove all nodes and edges. The graph keeps (most of) its memory, so that
+   * it can be rebuilt more cheaply.
+   */
+  void clear();
+
   Graph() = default;
   void add_edge(reg_t, reg_t, bool can_coalesce = false);
   void add_coalesceable_edge(reg_t u, reg_t v) { add_edge(u, v, true); }
@@ -233,13 +347,15 @@ class Graph {
     if (u == v) {
       return;
     }
-    m_containment_graph.emplace(impl::build_containment_edge(u, v));
+    m_containment_graph.insert(u, v);
   }
 
  private:
   std::unordered_map<reg_t, Node> m_nodes;
-  std::unordered_map<reg_pair_t, bool> m_adj_matrix;
-  std::unordered_set<reg_pair_t> m_containment_graph;
+  impl::RegPairSet</* Symmetric */ true> m_adj_matrix;
+  // The subset of the edges that may not be coalesced.
+  impl::RegPairSet</* Symmetric */ true> m_non_coalesceable;
+  impl::RegPairSet</* Symmetric */ false> m_containment_graph;
   // This map contains the LivenessDomains for all instructions which could
   // potentialy take on the /range format.
   std::unordered_map<IRInstruction*, LivenessDomain> m_range_liveness;
@@ -282,6 +398,13 @@ class GraphBuilder {
                      reg_t initial_regs,
                      const RangeSet&);
 
+  // Clear :graph and build it anew, reusing its memory.
+  static void build(const LivenessFixpointIterator&,
+                    IRCode*,
+                    reg_t initial_regs,
+                    const RangeSet&,
+                    Graph* graph);
+
   // For unit tests
   static Graph create_empty() { return Graph(); }
   static void make_node(Graph*, reg_t, RegisterType, vreg_t max_vreg);
@@ -300,6 +423,15 @@ inline Graph build_graph(const LivenessFixpointIterator& fixpoint_iter,
       fixpoint_iter, code, initial_regs, range_set);
 }
 
+inline void build_graph(const LivenessFixpointIterator& fixpoint_iter,
+                        IRCode* code,
+                        reg_t initial_regs,
+                        const RangeSet& range_set,
+                        Graph* graph) {
+  impl::GraphBuilder::build(fixpoint_iter, code, initial_regs, range_set,
+                            graph);
+}
+
 } // namespace interference
 
 } // namespace regalloc
@@ -16,6 +16,7 @@
 #include "IRCode.h"
 #include "IRInstruction.h"
 #include "LiveRange.h"
+#include "PassResultCache.h"
 #include "Show.h"
 #include "Transform.h"
 #include "Walkers.h"
@@ -26,8 +27,32 @@ namespace regalloc {
 
 using Stats = graph_coloring::Allocator::Stats;
 
+namespace {
+
+// The state of each worker thread: its statistics and the scratch containers
+// it reuses for all the methods it allocates.
+struct WorkerState {
+  Stats stats;
+  graph_coloring::AllocatorScratch scratch;
+
+  WorkerState& operator+=(const WorkerState& that) {
+    stats += that.stats;
+    return *this;
+  }
+};
+
+} // namespace
+
 Stats RegAllocPass::allocate(
     const graph_coloring::Allocator::Config& allocator_config, DexMethod* m) {
+  graph_coloring::AllocatorScratch scratch;
+  return allocate(allocator_config, m, &scratch);
+}
+
+Stats RegAllocPass::allocate(
+    const graph_coloring::Allocator::Config& allocator_config,
+    DexMethod* m,
+    graph_coloring::AllocatorScratch* scratch) {
   if (m->get_code() == nullptr) {
     return Stats();
   }
@@ -39,7 +64,7 @@ Stats RegAllocPass::allocate(
     // here instead of requiring each transform to build it.
     code.build_cfg(/* editable */ false);
     graph_coloring::Allocator allocator(allocator_config);
-    allocator.allocate(m);
+    allocator.allocate(m, scratch);
     TRACE(REG, 5, "After alloc: regs:%d code:\n%s", code.get_registers_size(),
           SHOW(&code));
     return allocator.get_stats();
@@ -67,12 +92,38 @@ void RegAllocPass::run_pass(DexStoresVector& stores,
   graph_coloring::Allocator::Config allocator_config;
   const auto& jw = mgr.get_current_pass_info()->config;
   jw.get("live_range_splitting", false, allocator_config.use_splitting);
+  jw.get("small_method_allocator", false,
+         allocator_config.use_small_method_allocator);
   allocator_config.no_overwrite_this =
       mgr.get_redex_options().no_overwrite_this();
 
+  // Allocation only depends on the method's own code and on the config.
+  auto cache = mgr.make_pass_result_cache(
+      std::to_string(allocator_config.no_overwrite_this) +
+      std::to_string(allocator_config.use_small_method_allocator));
+
   auto scope = build_class_scope(stores);
-  auto stats = walk::parallel::methods<Stats>(
-      scope, [&](DexMethod* m) { return allocate(allocator_config, m); });
+  auto allocate_method = [&](DexMethod* m, WorkerState* state) {
+    std::string key;
+    if (cache != nullptr) {
+      key = cache->key(m);
+      if (!key.empty() && cache->replay(key, m)) {
+        return;
+      }
+    }
+    state->stats += allocate(allocator_config, m, &state->scratch);
+    if (!key.empty()) {
+      cache->record(key, m);
+    }
+  };
+  auto stats =
+      walk::parallel::methods<WorkerState>(scope, allocate_method).stats;
+
+  if (cache != nullptr) {
+    cache->save();
+    mgr.incr_metric("pass_result_cache_hits", cache->hits());
+    mgr.incr_metric("pass_result_cache_misses", cache->misses());
+  }
 
   TRACE(REG, 1, "Total reiteration count: %lu", stats.reiteration_count);
   TRACE(REG, 1, "Total Params spilled early: %lu", stats.params_spill_early);
@@ -83,12 +134,14 @@ void RegAllocPass::run_pass(DexStoresVector& stores,
   TRACE(REG, 1, "  Total splits: %lu", stats.split_moves);
   TRACE(REG, 1, "Total coalesce count: %lu", stats.moves_coalesced);
   TRACE(REG, 1, "Total net moves: %ld", stats.net_moves());
+  TRACE(REG, 1, "Total small methods: %lu", stats.small_methods_allocated);
 
   mgr.incr_metric("param spilled too early", stats.params_spill_early);
   mgr.incr_metric("reiteration_count", stats.reiteration_count);
   mgr.incr_metric("spill_count", stats.moves_inserted());
   mgr.incr_metric("coalesce_count", stats.moves_coalesced);
   mgr.incr_metric("net_moves", stats.net_moves());
+  mgr.incr_metric("small_methods_allocated", stats.small_methods_allocated);
 
   mgr.record_running_regalloc();
 }
@@ -29,6 +29,11 @@ class RegAllocPass : public Pass {
   static graph_coloring::Allocator::Stats allocate(
       const graph_coloring::Allocator::Config&, DexMethod*);
 
+  static graph_coloring::Allocator::Stats allocate(
+      const graph_coloring::Allocator::Config&,
+      DexMethod*,
+      graph_coloring::AllocatorScratch*);
+
   void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
 };
 
@@ -0,0 +1,302 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "SmallMethodAllocator.h"
+
+#include <array>
+#include <limits>
+
+#include "BitVectorDataflow.h"
+#include "ControlFlow.h"
+#include "Debug.h"
+#include "DexUtil.h"
+#include "Show.h"
+#include "Trace.h"
+#include "Transform.h"
+
+namespace regalloc {
+
+namespace small_method {
+
+namespace {
+
+// The symregs of a method are tracked as bits of a RegMask, so at most this
+// many can be handled.
+using RegMask = uint32_t;
+constexpr size_t MAX_SYMREGS = 32;
+
+// Non-range instructions address at least 4 bits, so any frame of up to this
+// size satisfies all operand constraints.
+constexpr reg_t MAX_FRAME_SIZE = 16;
+
+bool has_2addr_form(IROpcode op) {
+  return op >= OPCODE_ADD_INT && op <= OPCODE_REM_DOUBLE;
+}
+
+RegMask bit(reg_t reg) { return RegMask(1) << reg; }
+
+template <typename Fn>
+void for_each_reg(RegMask mask, Fn fn) {
+  while (mask != 0) {
+    fn(reg_t(__builtin_ctz(mask)));
+    mask &= mask - 1;
+  }
+}
+
+// Same transfer function as LivenessFixpointIterator.
+void analyze_instruction(const IRInstruction* insn, RegMask* live) {
+  if (insn->has_dest()) {
+    *live &= ~bit(insn->dest());
+  }
+  for (size_t i = 0; i < insn->srcs_size(); ++i) {
+    *live |= bit(insn->src(i));
+  }
+}
+
+std::unordered_map<cfg::BlockId, RegMask> compute_live_in(
+    const cfg::ControlFlowGraph& cfg) {
+  using namespace bit_vector_dataflow;
+  FixpointIterator<RegMask, Direction::BACKWARD> fixpoint(cfg, RegMask{0});
+  fixpoint.run(
+      [](cfg::Block* block, RegMask live_out, RegMask* live_in) {
+        *live_in = live_out;
+        for (auto mit = block->rbegin(); mit != block->rend(); ++mit) {
+          if (mit->type == MFLOW_OPCODE) {
+            analyze_instruction(mit->insn, live_in);
+          }
+        }
+      });
+  std::unordered_map<cfg::BlockId, RegMask> live_in;
+  for (auto* block : cfg.blocks()) {
+    live_in[block->id()] = fixpoint.get_exit_state_at(block);
+  }
+  return live_in;
+}
+
+struct Constraints {
+  // Symregs whose vregs must not overlap.
+  std::array<RegMask, MAX_SYMREGS> interferes{};
+  // Symregs whose vregs must either be identical or not overlap. These are the
+  // wide operands that the graph coloring allocator marks with coalesceable
+  // edges.
+  std::array<RegMask, MAX_SYMREGS> no_partial_overlap{};
+
+  void add_edge(reg_t u, reg_t v) {
+    if (u != v) {
+      interferes[u] |= bit(v);
+      interferes[v] |= bit(u);
+    }
+  }
+
+  void add_overlap_edge(reg_t u, reg_t v) {
+    if (u != v) {
+      no_partial_overlap[u] |= bit(v);
+      no_partial_overlap[v] |= bit(u);
+    }
+  }
+};
+
+// Mirrors the edges that GraphBuilder::build adds to the interference graph.
+void build_constraints(
+    const cfg::ControlFlowGraph& cfg,
+    const std::unordered_map<cfg::BlockId, RegMask>& live_in,
+    Constraints* constraints) {
+  for (auto* block : cfg.blocks()) {
+    RegMask live_out{0};
+    for (auto* edge : block->succs()) {
+      live_out |= live_in.at(edge->target()->id());
+    }
+    for (auto it = block->rbegin(); it != block->rend(); ++it) {
+      if (it->type != MFLOW_OPCODE) {
+        continue;
+      }
+      auto insn = it->insn;
+      auto op = insn->opcode();
+      if (insn->has_dest()) {
+        auto dest = insn->dest();
+        RegMask interfering = live_out;
+        if (is_move(op)) {
+          interfering &= ~bit(insn->src(0));
+        }
+        for_each_reg(interfering,
+                     [&](reg_t reg) { constraints->add_edge(dest, reg); });
+        for (size_t i = 0; i < insn->srcs_size(); ++i) {
+          if (!insn->src_is_wide(i)) {
+            continue;
+          }
+          // Only the first src may be coalesced with the dest.
+          if (i == 0 && insn->dest_is_wide()) {
+            constraints->add_overlap_edge(dest, insn->src(i));
+          } else {
+            constraints->add_edge(dest, insn->src(i));
+          }
+        }
+      }
+      if (op == OPCODE_CHECK_CAST) {
+        auto move_result_pseudo = std::prev(it)->insn;
+        for_each_reg(live_out, [&](reg_t reg) {
+          constraints->add_edge(move_result_pseudo->dest(), reg);
+        });
+      }
+      analyze_instruction(insn, &live_out);
+    }
+  }
+}
+
+// Record the width of every symreg. Returns false if some symreg is used with
+// inconsistent widths, which the graph coloring allocator reports as an error.
+bool compute_widths(IRCode* code, std::array<uint8_t, MAX_SYMREGS>* widths) {
+  auto set_width = [&](reg_t reg, bool is_wide) {
+    uint8_t width = is_wide ? 2 : 1;
+    auto& w = (*widths)[reg];
+    if (w != 0 && w != width) {
+      return false;
+    }
+    w = width;
+    return true;
+  };
+  for (const auto& mie : InstructionIterable(code)) {
+    auto insn = mie.insn;
+    if (insn->has_dest() && !set_width(insn->dest(), insn->dest_is_wide())) {
+      return false;
+    }
+    for (size_t i = 0; i < insn->srcs_size(); ++i) {
+      if (!set_width(insn->src(i), insn->src_is_wide(i))) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+bool try_allocate(IRCode* code,
+                  const RangeSet& range_set,
+                  size_t* moves_coalesced) {
+  auto regs_size = code->get_registers_size();
+  if (range_set.size() != 0 || regs_size > MAX_SYMREGS) {
+    return false;
+  }
+  std::array<uint8_t, MAX_SYMREGS> widths{};
+  if (!compute_widths(code, &widths)) {
+    return false;
+  }
+
+  auto& cfg = code->cfg();
+  Constraints constraints;
+  build_constraints(cfg, compute_live_in(cfg), &constraints);
+
+  // Pairs of symregs that we would like to share a vreg, i.e. the ones that
+  // the graph coloring allocator tries to coalesce.
+  std::vector<std::pair<reg_t, reg_t>> hints;
+  auto ii = InstructionIterable(code);
+  for (auto it = ii.begin(); it != ii.end(); ++it) {
+    auto insn = it->insn;
+    auto op = insn->opcode();
+    if (!is_move(op) && !has_2addr_form(op) && op != OPCODE_CHECK_CAST) {
+      continue;
+    }
+    auto dest = insn->has_move_result_pseudo()
+                    ? ir_list::move_result_pseudo_of(it.unwrap())->dest()
+                    : insn->dest();
+    hints.emplace_back(dest, insn->src(0));
+  }
+
+  RegMask params{0};
+  reg_t param_words{0};
+  for (const auto& mie : InstructionIterable(code->get_param_instructions())) {
+    params |= bit(mie.insn->dest());
+    param_words += widths[mie.insn->dest()];
+  }
+
+  constexpr reg_t UNASSIGNED = std::numeric_limits<reg_t>::max();
+  std::array<reg_t, MAX_SYMREGS> vregs;
+  vregs.fill(UNASSIGNED);
+  auto fits = [&](reg_t reg, reg_t vreg) {
+    auto width = widths[reg];
+    bool ok{true};
+    auto check = [&](RegMask mask, bool allow_identical) {
+      for_each_reg(mask, [&](reg_t other) {
+        if (vregs[other] == UNASSIGNED) {
+          return;
+        }
+        auto other_vreg = vregs[other];
+        if (allow_identical && other_vreg == vreg &&
+            widths[other] == width) {
+          return;
+        }
+        if (vreg < other_vreg + widths[other] && other_vreg < vreg + width) {
+          ok = false;
+        }
+      });
+    };
+    check(constraints.interferes[reg], false);
+    check(constraints.no_partial_overlap[reg], true);
+    return ok;
+  };
+
+  reg_t locals_size{0};
+  for (reg_t reg = 0; reg < regs_size; ++reg) {
+    if (widths[reg] == 0 || (params & bit(reg))) {
+      continue;
+    }
+    auto vreg = UNASSIGNED;
+    for (const auto& hint : hints) {
+      auto other = hint.first == reg    ? hint.second
+                   : hint.second == reg ? hint.first
+                                        : UNASSIGNED;
+      if (other != UNASSIGNED && vregs[other] != UNASSIGNED &&
+          !(params & bit(other)) && widths[other] == widths[reg] &&
+          fits(reg, vregs[other])) {
+        vreg = vregs[other];
+        break;
+      }
+    }
+    if (vreg == UNASSIGNED) {
+      vreg = 0;
+      while (!fits(reg, vreg)) {
+        ++vreg;
+      }
+    }
+    vregs[reg] = vreg;
+    locals_size = std::max<reg_t>(locals_size, vreg + widths[reg]);
+    if (locals_size + param_words > MAX_FRAME_SIZE) {
+      return false;
+    }
+  }
+
+  transform::RegMap reg_map;
+  for (reg_t reg = 0; reg < regs_size; ++reg) {
+    if (vregs[reg] != UNASSIGNED) {
+      reg_map.emplace(reg, vregs[reg]);
+    }
+  }
+  auto next_param = locals_size;
+  for (const auto& mie : InstructionIterable(code->get_param_instructions())) {
+    auto reg = mie.insn->dest();
+    reg_map[reg] = next_param;
+    next_param += widths[reg];
+  }
+  TRACE(REG, 5, "Small method allocation of %u symregs into %u vregs",
+        regs_size, next_param);
+
+  transform::remap_registers(code, reg_map);
+  for (auto it = ii.begin(); it != ii.end(); ++it) {
+    auto insn = it->insn;
+    if (is_move(insn->opcode()) && insn->dest() == insn->src(0)) {
+      ++*moves_coalesced;
+      code->remove_opcode(it.unwrap());
+    }
+  }
+  code->set_registers_size(next_param);
+  return true;
+}
+
+} // namespace small_method
+
+} // namespace regalloc
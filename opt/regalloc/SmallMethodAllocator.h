@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include "IRCode.h"
+#include "Interference.h"
+
+namespace regalloc {
+
+namespace small_method {
+
+/*
+ * A cheap allocator for the common case of methods that use only a handful of
+ * registers and no range instructions. It computes liveness and interference
+ * with bitmasks instead of building the full interference graph, then assigns
+ * vregs greedily in symreg order, preferring the vreg of a move partner so
+ * that most moves still get coalesced. The params are placed at the end of the
+ * frame, in registers of their own.
+ *
+ * As long as the whole frame fits in 16 registers, every operand of every
+ * non-range instruction can address its vreg, so no spilling is ever needed.
+ * If the assignment does not fit, the code is left untouched and false is
+ * returned; the caller should then fall back to the graph coloring allocator.
+ *
+ * Expects the code to have been renumbered and to have a CFG.
+ */
+bool try_allocate(IRCode*, const RangeSet&, size_t* moves_coalesced);
+
+} // namespace small_method
+
+} // namespace regalloc
@@ -117,7 +117,7 @@ class BuilderTransform {
  private:
   std::unique_ptr<MultiMethodInliner> m_inliner;
   inliner::InlinerConfig m_inliner_config;
-  MethodRefCache m_resolved_refs;
+  ConcurrentMethodRefCache m_resolved_refs;
 };
 
 std::vector<DexMethod*> get_all_methods(IRCode* code, DexType* type);
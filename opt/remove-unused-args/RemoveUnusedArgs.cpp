@@ -265,6 +265,11 @@ RemoveArgs::MethodStats RemoveArgs::update_meths_with_unused_args_or_results() {
       // Nothing to do if the method doesn't have args or result to remove.
       return;
     }
+    if (m_methods_to_check && !m_methods_to_check->count(method) &&
+        !remove_result) {
+      // Its code didn't change since its args were last found to be used.
+      return;
+    }
 
     if (!can_rename(method)) {
       // Nothing to do if ProGuard says we can't change the method args.
@@ -311,6 +316,8 @@ RemoveArgs::MethodStats RemoveArgs::update_meths_with_unused_args_or_results() {
   for (auto& p : ordered_entries) {
     DexMethod* method = p.first;
     const Entry& entry = p.second;
+    // Either the code changes, or we have to try again next time.
+    m_methods_to_recheck.insert(method);
     if (!update_method_signature(method, entry.live_arg_idxs,
                                  entry.remove_result)) {
       continue;
@@ -418,6 +425,9 @@ size_t RemoveArgs::update_callsites() {
             }
           }
         }
+        if (callsite_args_removed > 0) {
+          m_methods_to_recheck.insert(method);
+        }
         return callsite_args_removed;
       });
 }
@@ -433,13 +443,18 @@ void RemoveUnusedArgsPass::run_pass(DexStoresVector& stores,
   size_t num_method_results_removed_count = 0;
   size_t num_iterations = 0;
   LocalDce::Stats local_dce_stats{0, 0};
+  // After the first iteration, only the methods changed by the previous one
+  // can have new unused args.
+  boost::optional<std::unordered_set<DexMethod*>> methods_to_check;
   while (true) {
     num_iterations++;
-    RemoveArgs rm_args(scope, m_black_list, m_total_iterations++);
+    RemoveArgs rm_args(scope, m_black_list, m_total_iterations++,
+                       methods_to_check ? &*methods_to_check : nullptr);
     auto pass_stats = rm_args.run();
     if (pass_stats.methods_updated_count == 0) {
       break;
     }
+    methods_to_check = rm_args.methods_to_recheck();
     num_callsite_args_removed += pass_stats.callsite_args_removed_count;
     num_method_params_removed += pass_stats.method_params_removed_count;
     num_methods_updated += pass_stats.methods_updated_count;
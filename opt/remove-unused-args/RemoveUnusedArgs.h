@@ -31,11 +31,27 @@ class RemoveArgs {
     LocalDce::Stats local_dce_stats{0, 0};
   };
 
+  /**
+   * When methods_to_check is given, only those methods, and methods that now
+   * have an unused result, are checked for unused args. This is meant for the
+   * methods_to_recheck() of the previous iteration: the args of all other
+   * methods are used just as before.
+   */
   RemoveArgs(const Scope& scope,
              const std::vector<std::string>& black_list,
-             size_t iteration = 0)
-      : m_scope(scope), m_black_list(black_list), m_iteration(iteration){};
+             size_t iteration = 0,
+             const std::unordered_set<DexMethod*>* methods_to_check = nullptr)
+      : m_scope(scope),
+        m_black_list(black_list),
+        m_iteration(iteration),
+        m_methods_to_check(methods_to_check){};
   RemoveArgs::PassStats run();
+  // Methods whose code was changed by run(), or whose signature could not be
+  // updated.
+  std::unordered_set<DexMethod*> methods_to_recheck() const {
+    return std::unordered_set<DexMethod*>(m_methods_to_recheck.begin(),
+                                          m_methods_to_recheck.end());
+  }
   std::deque<uint16_t> compute_live_args(
       DexMethod* method,
       size_t num_args,
@@ -49,6 +65,8 @@ class RemoveArgs {
   ConcurrentSet<DexMethod*> m_result_used;
   const std::vector<std::string>& m_black_list;
   size_t m_iteration;
+  const std::unordered_set<DexMethod*>* m_methods_to_check;
+  ConcurrentSet<DexMethod*> m_methods_to_recheck;
 
   std::deque<DexType*> get_live_arg_type_list(
       DexMethod* method, const std::deque<uint16_t>& live_arg_idxs);
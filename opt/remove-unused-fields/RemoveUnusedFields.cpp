@@ -13,8 +13,10 @@
 #include "DexClass.h"
 #include "FieldOpTracker.h"
 #include "IRCode.h"
+#include "ReferenceIndex.h"
 #include "Resolver.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 using namespace remove_unused_fields;
 
@@ -102,13 +104,12 @@ class RemoveUnusedFields final {
     field_op_tracker::FieldStatsMap field_stats =
         field_op_tracker::analyze(m_scope);
 
-    // analyze_non_zero_writes and the later transform() need (editable) cfg
-    walk::parallel::code(m_scope, [&](const DexMethod*, IRCode& code) {
-      code.build_cfg(/* editable = true*/);
-    });
-
     boost::optional<field_op_tracker::NonZeroWrittenFields> non_zero_writes;
     if (m_config.remove_zero_written_fields) {
+      // analyze_non_zero_writes needs (editable) cfg
+      walk::parallel::code(m_scope, [&](const DexMethod*, IRCode& code) {
+        code.build_cfg(/* editable = true*/);
+      });
       non_zero_writes = field_op_tracker::analyze_non_zero_writes(m_scope);
     }
 
@@ -143,9 +144,25 @@ class RemoveUnusedFields final {
   }
 
   void transform() {
+    // Only the methods that access one of the fields need to be rewritten.
+    reference_index::ReferenceIndex index(m_scope);
+    std::unordered_set<DexMethod*> methods;
+    for (const auto* fields :
+         {&m_unread_fields, &m_unwritten_fields, &m_zero_written_fields}) {
+      for (auto* field : *fields) {
+        auto accessors = index.methods(field);
+        methods.insert(accessors.begin(), accessors.end());
+      }
+    }
+    TRACE(RMUF, 2, "methods to rewrite %u", methods.size());
+
     // Replace reads to unwritten fields with appropriate const-0 instructions,
     // and remove the writes to unread fields.
-    walk::parallel::code(m_scope, [&](const DexMethod*, IRCode& code) {
+    auto wq = workqueue_foreach<DexMethod*>([&](DexMethod* method) {
+      auto& code = *method->get_code();
+      if (!code.editable_cfg_built()) {
+        code.build_cfg(/* editable = true*/);
+      }
       auto& cfg = code.cfg();
       cfg::CFGMutation m(cfg);
       auto iterable = cfg::InstructionIterable(cfg);
@@ -197,6 +214,18 @@ class RemoveUnusedFields final {
       m.flush();
       code.clear_cfg();
     });
+    for (auto* method : methods) {
+      wq.add_item(method);
+    }
+    wq.run_all();
+
+    if (m_config.remove_zero_written_fields) {
+      walk::parallel::code(m_scope, [&](const DexMethod*, IRCode& code) {
+        if (code.editable_cfg_built()) {
+          code.clear_cfg();
+        }
+      });
+    }
   }
 
   const Config& m_config;
@@ -35,19 +35,20 @@ void RemoveRedundantCheckCastsPass::bind_config() {
   bind("weaken", m_config.weaken, m_config.weaken);
 }
 
-void RemoveRedundantCheckCastsPass::run_pass(DexStoresVector& stores,
-                                             ConfigFiles&,
-                                             PassManager& mgr) {
-  auto scope = build_class_scope(stores);
-
-  auto stats =
-      walk::parallel::methods<impl::Stats>(scope, [&](DexMethod* method) {
-        return remove_redundant_check_casts(m_config, method);
-      });
-
-  mgr.set_metric("num_removed_casts", stats.removed_casts);
-  mgr.set_metric("num_replaced_casts", stats.replaced_casts);
-  mgr.set_metric("num_weakened_casts", stats.weakened_casts);
+std::unique_ptr<MethodLocalTransform>
+RemoveRedundantCheckCastsPass::make_method_local_transform(DexStoresVector&,
+                                                           ConfigFiles&,
+                                                           PassManager&) {
+  auto transform = [this](DexMethod* method) {
+    return remove_redundant_check_casts(m_config, method);
+  };
+  auto report = [](const impl::Stats& stats, PassManager& mgr) {
+    mgr.set_metric("num_removed_casts", stats.removed_casts);
+    mgr.set_metric("num_replaced_casts", stats.replaced_casts);
+    mgr.set_metric("num_weakened_casts", stats.weakened_casts);
+  };
+  return std::make_unique<StatsMethodLocalTransform<impl::Stats>>(transform,
+                                                                  report);
 }
 
 static RemoveRedundantCheckCastsPass s_pass;
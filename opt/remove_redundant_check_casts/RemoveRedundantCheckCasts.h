@@ -8,16 +8,20 @@
 #pragma once
 
 #include "CheckCastConfig.h"
-#include "Pass.h"
+#include "MethodLocalTransform.h"
 
 namespace check_casts {
 
-class RemoveRedundantCheckCastsPass : public Pass {
+class RemoveRedundantCheckCastsPass : public MethodLocalPass {
  public:
-  RemoveRedundantCheckCastsPass() : Pass("RemoveRedundantCheckCastsPass") {}
+  RemoveRedundantCheckCastsPass()
+      : MethodLocalPass("RemoveRedundantCheckCastsPass") {}
 
   void bind_config() override;
-  void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
+  std::unique_ptr<MethodLocalTransform> make_method_local_transform(
+      DexStoresVector&, ConfigFiles&, PassManager&) override;
+
+  bool is_editable_cfg_friendly() const override { return true; }
 
  private:
   CheckCastConfig m_config;
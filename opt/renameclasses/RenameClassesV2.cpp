@@ -8,6 +8,7 @@
 #include "RenameClassesV2.h"
 
 #include <algorithm>
+#include <atomic>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/regex.hpp>
 #include <map>
@@ -24,6 +25,7 @@
 #include "TypeStringRewriter.h"
 #include "Walkers.h"
 #include "Warning.h"
+#include "WorkQueue.h"
 
 #include <locator.h>
 using facebook::Locator;
@@ -716,13 +718,11 @@ void RenameClassesPassV2::rename_classes_in_layouts(
         java_names::internal_to_external(apair.first->str()),
         java_names::internal_to_external(apair.second->str()));
   }
-  ssize_t layout_bytes_delta = 0;
-  size_t num_layout_renamed = 0;
+  std::atomic<ssize_t> layout_bytes_delta{0};
+  std::atomic<size_t> num_layout_renamed{0};
   auto xml_files = get_xml_files(m_apk_dir + "/res");
-  for (const auto& path : xml_files) {
-    if (is_raw_resource(path)) {
-      continue;
-    }
+  // Every layout is rewritten independently of the others.
+  auto wq = workqueue_foreach<std::string>([&](const std::string& path) {
     size_t num_renamed = 0;
     ssize_t out_delta = 0;
     TRACE(RENAME, 6, "Begin rename Views in layout %s", path.c_str());
@@ -732,10 +732,16 @@ void RenameClassesPassV2::rename_classes_in_layouts(
           num_renamed, path.c_str());
     layout_bytes_delta += out_delta;
     num_layout_renamed += num_renamed;
+  });
+  for (const auto& path : xml_files) {
+    if (!is_raw_resource(path)) {
+      wq.add_item(path);
+    }
   }
+  wq.run_all();
   mgr.incr_metric("layout_bytes_delta", layout_bytes_delta);
   TRACE(RENAME, 2, "Renamed %zu ResStringPool entries, delta %zi bytes",
-        num_layout_renamed, layout_bytes_delta);
+        num_layout_renamed.load(), layout_bytes_delta.load());
 }
 
 std::string RenameClassesPassV2::prepend_package_prefix(
@@ -21,6 +21,27 @@
 #include "SingleImplDefs.h"
 #include "Trace.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
+
+namespace {
+
+/**
+ * A reference to a single impl interface found in some method's code, or the
+ * escape of an interface, to be recorded in the SingleImplData once all
+ * methods have been scanned.
+ */
+struct OpcodeRef {
+  enum Kind { TYPEREF, FIELDREF, METHODREF, INTF_METHODREF, ESCAPE };
+  Kind kind;
+  DexType* intf;
+  IRInstruction* insn;
+  IRList::iterator insn_it;
+  DexFieldRef* field;
+  DexMethodRef* meth;
+  EscapeReason reason;
+};
+
+} // namespace
 
 struct AnalysisImpl : SingleImplAnalysis {
   AnalysisImpl(const Scope& scope,
@@ -39,6 +60,11 @@ struct AnalysisImpl : SingleImplAnalysis {
 
  private:
   DexType* get_and_check_single_impl(DexType* type);
+  DexType* find_single_impl(DexType* type,
+                            std::vector<OpcodeRef>* refs) const;
+  void collect_opcode_refs(DexMethod* method,
+                           IRCode& code,
+                           std::vector<OpcodeRef>* refs) const;
   void collect_children(const TypeSet& intfs);
   void check_impl_hierarchy();
   void escape_with_clinit();
@@ -76,6 +102,28 @@ DexType* AnalysisImpl::get_and_check_single_impl(DexType* type) {
   return nullptr;
 }
 
+/**
+ * Like get_and_check_single_impl, but only records the escape of an array
+ * element type, so that it is safe to call concurrently.
+ */
+DexType* AnalysisImpl::find_single_impl(DexType* type,
+                                        std::vector<OpcodeRef>* refs) const {
+  if (single_impls.count(type)) {
+    return type;
+  }
+  if (type::is_array(type)) {
+    auto element_type = type::get_array_element_type(type);
+    redex_assert(element_type);
+    const auto sit = single_impls.find(element_type);
+    if (sit != single_impls.end()) {
+      refs->push_back({OpcodeRef::ESCAPE, sit->first, nullptr, {}, nullptr,
+                       nullptr, HAS_ARRAY_TYPE});
+      return sit->first;
+    }
+  }
+  return nullptr;
+}
+
 /**
  * Find all single implemented interfaces.
  */
@@ -346,138 +394,186 @@ void AnalysisImpl::collect_method_defs() {
 }
 
 /**
- * Find all opcodes that reference a single implemented interface in a typeref,
- * fieldref or methodref.
+ * Collect, in order, the opcodes of a method that reference a single
+ * implemented interface in a typeref, fieldref or methodref.
  */
-void AnalysisImpl::analyze_opcodes() {
-
-  auto check_arg = [&](DexMethod* referrer,
-                       const IRList::iterator& insn_it,
+void AnalysisImpl::collect_opcode_refs(DexMethod* method,
+                                       IRCode& code,
+                                       std::vector<OpcodeRef>* refs) const {
+  auto check_arg = [&](const IRList::iterator& insn_it,
                        DexType* type,
                        DexMethodRef* meth,
                        IRInstruction* insn) {
-    auto intf = get_and_check_single_impl(type);
+    auto intf = find_single_impl(type, refs);
     if (intf) {
-      single_impls[intf].referencing_methods[referrer][insn] = insn_it;
-      single_impls[intf].methodrefs[meth].insert(insn);
+      refs->push_back(
+          {OpcodeRef::METHODREF, intf, insn, insn_it, nullptr, meth, {}});
     }
   };
 
-  auto check_sig = [&](DexMethod* referrer,
-                       const IRList::iterator& insn_it,
+  auto check_sig = [&](const IRList::iterator& insn_it,
                        DexMethodRef* meth,
                        IRInstruction* insn) {
     // check the sig for single implemented interface
     const auto proto = meth->get_proto();
-    check_arg(referrer, insn_it, proto->get_rtype(), meth, insn);
+    check_arg(insn_it, proto->get_rtype(), meth, insn);
     const auto args = proto->get_args();
     for (const auto arg : args->get_type_list()) {
-      check_arg(referrer, insn_it, arg, meth, insn);
+      check_arg(insn_it, arg, meth, insn);
     }
   };
 
-  auto check_field = [&](DexMethod* referrer,
-                         const IRList::iterator& insn_it,
+  auto check_field = [&](const IRList::iterator& insn_it,
                          DexFieldRef* field,
                          IRInstruction* insn) {
     auto cls = field->get_class();
-    cls = get_and_check_single_impl(cls);
+    cls = find_single_impl(cls, refs);
     if (cls) {
-      escape_interface(cls, HAS_FIELD_REF);
+      refs->push_back({OpcodeRef::ESCAPE, cls, nullptr, {}, nullptr, nullptr,
+                       HAS_FIELD_REF});
     }
     const auto type = field->get_type();
-    auto intf = get_and_check_single_impl(type);
+    auto intf = find_single_impl(type, refs);
     if (intf) {
-      single_impls[intf].referencing_methods[referrer][insn] = insn_it;
-      single_impls[intf].fieldrefs[field].push_back(insn);
+      refs->push_back(
+          {OpcodeRef::FIELDREF, intf, insn, insn_it, field, nullptr, {}});
     }
   };
 
-  walk::code(scope, [&](DexMethod* method, IRCode& code) {
-    redex_assert(!code.editable_cfg_built()); // Need *one* way to
-    auto ii = ir_list::InstructionIterable(code);
-    const auto& end = ii.end();
-    for (auto it = ii.begin(); it != end; ++it) {
-      auto insn = it->insn;
-      auto op = insn->opcode();
-      switch (op) {
-      // type ref
-      case OPCODE_CONST_CLASS:
-      case OPCODE_CHECK_CAST:
-      case OPCODE_INSTANCE_OF:
-      case OPCODE_NEW_INSTANCE:
-      case OPCODE_NEW_ARRAY:
-      case OPCODE_FILLED_NEW_ARRAY: {
-        auto intf = get_and_check_single_impl(insn->get_type());
-        if (intf) {
-          single_impls[intf].referencing_methods[method][insn] = it.unwrap();
-          single_impls[intf].typerefs.push_back(insn);
-        }
-        break;
+  redex_assert(!code.editable_cfg_built()); // Need *one* way to
+  auto ii = ir_list::InstructionIterable(code);
+  const auto& end = ii.end();
+  for (auto it = ii.begin(); it != end; ++it) {
+    auto insn = it->insn;
+    auto op = insn->opcode();
+    switch (op) {
+    // type ref
+    case OPCODE_CONST_CLASS:
+    case OPCODE_CHECK_CAST:
+    case OPCODE_INSTANCE_OF:
+    case OPCODE_NEW_INSTANCE:
+    case OPCODE_NEW_ARRAY:
+    case OPCODE_FILLED_NEW_ARRAY: {
+      auto intf = find_single_impl(insn->get_type(), refs);
+      if (intf) {
+        refs->push_back({OpcodeRef::TYPEREF, intf, insn, it.unwrap(), nullptr,
+                         nullptr, {}});
       }
-      // field ref
-      case OPCODE_IGET:
-      case OPCODE_IGET_WIDE:
-      case OPCODE_IGET_OBJECT:
-      case OPCODE_IPUT:
-      case OPCODE_IPUT_WIDE:
-      case OPCODE_IPUT_OBJECT: {
-        DexFieldRef* field =
-            resolve_field(insn->get_field(), FieldSearch::Instance);
-        if (field == nullptr) {
-          field = insn->get_field();
-        }
-        check_field(method, it.unwrap(), field, insn);
-        break;
+      break;
+    }
+    // field ref
+    case OPCODE_IGET:
+    case OPCODE_IGET_WIDE:
+    case OPCODE_IGET_OBJECT:
+    case OPCODE_IPUT:
+    case OPCODE_IPUT_WIDE:
+    case OPCODE_IPUT_OBJECT: {
+      DexFieldRef* field =
+          resolve_field(insn->get_field(), FieldSearch::Instance);
+      if (field == nullptr) {
+        field = insn->get_field();
       }
-      case OPCODE_SGET:
-      case OPCODE_SGET_WIDE:
-      case OPCODE_SGET_OBJECT:
-      case OPCODE_SPUT:
-      case OPCODE_SPUT_WIDE:
-      case OPCODE_SPUT_OBJECT: {
-        DexFieldRef* field =
-            resolve_field(insn->get_field(), FieldSearch::Static);
-        if (field == nullptr) {
-          field = insn->get_field();
-        }
-        check_field(method, it.unwrap(), field, insn);
-        break;
+      check_field(it.unwrap(), field, insn);
+      break;
+    }
+    case OPCODE_SGET:
+    case OPCODE_SGET_WIDE:
+    case OPCODE_SGET_OBJECT:
+    case OPCODE_SPUT:
+    case OPCODE_SPUT_WIDE:
+    case OPCODE_SPUT_OBJECT: {
+      DexFieldRef* field =
+          resolve_field(insn->get_field(), FieldSearch::Static);
+      if (field == nullptr) {
+        field = insn->get_field();
       }
-      // method ref
-      case OPCODE_INVOKE_INTERFACE: {
-        // if it is an invoke on the interface method, collect it as such
-        const auto meth = insn->get_method();
-        const auto owner = meth->get_class();
-        const auto intf = get_and_check_single_impl(owner);
-        if (intf) {
-          // if the method ref is not defined on the interface
-          // itself drop the optimization
-          const auto& meths = type_class(intf)->get_vmethods();
-          if (std::find(meths.begin(), meths.end(), meth) == meths.end()) {
-            escape_interface(intf, UNKNOWN_MREF);
-          } else {
-            single_impls[intf].referencing_methods[method][insn] = it.unwrap();
-            single_impls[intf].intf_methodrefs[meth].insert(insn);
-          }
+      check_field(it.unwrap(), field, insn);
+      break;
+    }
+    // method ref
+    case OPCODE_INVOKE_INTERFACE: {
+      // if it is an invoke on the interface method, collect it as such
+      const auto meth = insn->get_method();
+      const auto owner = meth->get_class();
+      const auto intf = find_single_impl(owner, refs);
+      if (intf) {
+        // if the method ref is not defined on the interface
+        // itself drop the optimization
+        const auto& meths = type_class(intf)->get_vmethods();
+        if (std::find(meths.begin(), meths.end(), meth) == meths.end()) {
+          refs->push_back({OpcodeRef::ESCAPE, intf, nullptr, {}, nullptr,
+                           nullptr, UNKNOWN_MREF});
+        } else {
+          refs->push_back({OpcodeRef::INTF_METHODREF, intf, insn, it.unwrap(),
+                           nullptr, meth, {}});
         }
-        check_sig(method, it.unwrap(), meth, insn);
-        break;
       }
+      check_sig(it.unwrap(), meth, insn);
+      break;
+    }
 
-      case OPCODE_INVOKE_DIRECT:
-      case OPCODE_INVOKE_STATIC:
-      case OPCODE_INVOKE_VIRTUAL:
-      case OPCODE_INVOKE_SUPER: {
-        const auto meth = insn->get_method();
-        check_sig(method, it.unwrap(), meth, insn);
-        break;
+    case OPCODE_INVOKE_DIRECT:
+    case OPCODE_INVOKE_STATIC:
+    case OPCODE_INVOKE_VIRTUAL:
+    case OPCODE_INVOKE_SUPER: {
+      const auto meth = insn->get_method();
+      check_sig(it.unwrap(), meth, insn);
+      break;
+    }
+    default:
+      break;
+    }
+  }
+}
+
+/**
+ * Find all opcodes that reference a single implemented interface in a typeref,
+ * fieldref or methodref.
+ * The methods are scanned in parallel, and their references then recorded in
+ * scope order, so that the lists in SingleImplData come out as if scanned
+ * serially.
+ */
+void AnalysisImpl::analyze_opcodes() {
+  std::vector<std::pair<DexMethod*, IRCode*>> methods;
+  walk::code(scope, [&](DexMethod* method, IRCode& code) {
+    methods.emplace_back(method, &code);
+  });
+  std::vector<std::vector<OpcodeRef>> refs(methods.size());
+  auto wq = workqueue_foreach<size_t>([&](size_t i) {
+    collect_opcode_refs(methods[i].first, *methods[i].second, &refs[i]);
+  });
+  for (size_t i = 0; i < methods.size(); ++i) {
+    wq.add_item(i);
+  }
+  wq.run_all();
+
+  for (size_t i = 0; i < methods.size(); ++i) {
+    auto method = methods[i].first;
+    for (const auto& ref : refs[i]) {
+      if (ref.kind == OpcodeRef::ESCAPE) {
+        escape_interface(ref.intf, ref.reason);
+        continue;
       }
-      default:
+      auto& data = single_impls[ref.intf];
+      data.referencing_methods[method][ref.insn] = ref.insn_it;
+      switch (ref.kind) {
+      case OpcodeRef::TYPEREF:
+        data.typerefs.push_back(ref.insn);
+        break;
+      case OpcodeRef::FIELDREF:
+        data.fieldrefs[ref.field].push_back(ref.insn);
+        break;
+      case OpcodeRef::METHODREF:
+        data.methodrefs[ref.meth].insert(ref.insn);
         break;
+      case OpcodeRef::INTF_METHODREF:
+        data.intf_methodrefs[ref.meth].insert(ref.insn);
+        break;
+      case OpcodeRef::ESCAPE:
+        not_reached();
       }
     }
-  });
+  }
 }
 
 /**
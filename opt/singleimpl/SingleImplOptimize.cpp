@@ -320,8 +320,10 @@ CheckCastSet OptimizationImpl::fix_instructions(const DexType* intf,
                  data.referencing_methods.end(), std::back_inserter(methods),
                  [](auto& p) { return p.first; });
   // The typical number of methods is too small, it is actually significant
-  // overhead to spin up pool threads to just let them die.
-  constexpr bool PARALLEL = false;
+  // overhead to spin up pool threads to just let them die. Each caller's code
+  // is rewritten on its own, so widely used interfaces may go in parallel.
+  constexpr size_t kMinParallelMethods = 256;
+  const bool PARALLEL = methods.size() >= kMinParallelMethods;
 
   std::mutex ret_lock;
   CheckCastSet ret;
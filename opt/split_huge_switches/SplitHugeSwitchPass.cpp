@@ -241,33 +241,66 @@ DexMethod* create_dex_method(DexMethod* m, std::unique_ptr<IRCode>&& code) {
   return cloned_method;
 }
 
-DexMethod* create_split(DexMethod* orig_method,
-                        IRCode* src,
-                        size_t case_threshold,
-                        int32_t from_excl,
-                        int32_t to_incl) {
-  auto cloned_code = std::make_unique<IRCode>(*src);
-
-  {
-    auto& cfg = cloned_code->cfg();
-    auto cloned_switch_it = find_large_switch(cfg, case_threshold);
-    redex_assert(!cloned_switch_it.is_end());
-
-    cfg.delete_succ_edge_if(cloned_switch_it.block(),
-                            [from_excl, to_incl](const cfg::Edge* e) {
-                              if (e->type() != cfg::EDGE_BRANCH) {
-                                return false;
-                              }
-                              int32_t key = *e->case_key();
-                              return key <= from_excl || key > to_incl;
-                            });
-
-    // Simplify to remove unreachable blocks.
-    cfg.simplify();
+// Keep only the cases in (from_excl, to_incl] of the switch in the given
+// block, and remove what becomes unreachable. Unlike simplify(), this keeps
+// the ids of the remaining blocks, so the switch can be found again in copies.
+void prune_switch(cfg::ControlFlowGraph& cfg,
+                  cfg::BlockId switch_block_id,
+                  int32_t from_excl,
+                  int32_t to_incl) {
+  cfg::Block* switch_block = nullptr;
+  for (auto* b : cfg.blocks()) {
+    if (b->id() == switch_block_id) {
+      switch_block = b;
+      break;
+    }
   }
+  redex_assert(switch_block != nullptr);
+  redex_assert(switch_block->get_last_insn()->insn->opcode() == OPCODE_SWITCH);
+  cfg.delete_succ_edge_if(switch_block,
+                          [from_excl, to_incl](const cfg::Edge* e) {
+                            if (e->type() != cfg::EDGE_BRANCH) {
+                              return false;
+                            }
+                            int32_t key = *e->case_key();
+                            return key <= from_excl || key > to_incl;
+                          });
+  cfg.remove_unreachable_blocks();
+}
 
-  cloned_code->clear_cfg();
-  return create_dex_method(orig_method, std::move(cloned_code));
+// Create the split methods for the case ranges lo ... hi - 1, where range i
+// holds the cases in (mid_cases[i - 1], mid_cases[i]]. `code` must only have
+// the cases of these ranges left.
+//
+// Instead of copying the whole method once per split, the code of a group of
+// ranges is halved recursively, so that each instruction only gets copied a
+// logarithmic number of times. This matters for generated switches with tens
+// of thousands of cases.
+void create_splits(DexMethod* orig_method,
+                   std::unique_ptr<IRCode> code,
+                   cfg::BlockId switch_block_id,
+                   const std::vector<int32_t>& mid_cases,
+                   size_t lo,
+                   size_t hi,
+                   std::vector<std::pair<int32_t, DexMethod*>>* splits) {
+  if (hi - lo == 1) {
+    code->cfg().simplify();
+    code->clear_cfg();
+    splits->emplace_back(mid_cases[lo - 1],
+                         create_dex_method(orig_method, std::move(code)));
+    return;
+  }
+  size_t mid = lo + (hi - lo) / 2;
+  auto upper = std::make_unique<IRCode>(*code);
+  prune_switch(code->cfg(), switch_block_id, mid_cases[lo - 1],
+               mid_cases[mid - 1]);
+  prune_switch(upper->cfg(), switch_block_id, mid_cases[mid - 1],
+               mid_cases[hi - 1]);
+  // The lower ranges first, so that methods get named in case order.
+  create_splits(orig_method, std::move(code), switch_block_id, mid_cases, lo,
+                mid, splits);
+  create_splits(orig_method, std::move(upper), switch_block_id, mid_cases,
+                mid, hi, splits);
 }
 
 void maybe_split_entry(cfg::ControlFlowGraph& cfg) {
@@ -625,17 +658,18 @@ AnalysisData analyze(DexMethod* m,
 // Actually split the method.
 std::vector<DexMethod*> run_split(AnalysisData& analysis_data,
                                   DexMethod* m,
-                                  IRCode* code,
-                                  size_t case_threshold) {
+                                  IRCode* code) {
   const auto& mid_cases = analysis_data.switch_range->mid_cases;
-  // Create splits.
+  // Create splits, all from one copy of the code.
   std::vector<std::pair<int32_t, DexMethod*>> new_methods;
   new_methods.reserve(mid_cases.size() - 1);
-  for (size_t i = 0; i < mid_cases.size() - 1; ++i) {
-    int32_t above = mid_cases[i];
-    int32_t to = mid_cases[i + 1];
-    auto cloned_method = create_split(m, code, case_threshold, above, to);
-    new_methods.emplace_back(above, cloned_method);
+  if (mid_cases.size() > 1) {
+    auto switch_block_id = analysis_data.switch_it->block()->id();
+    auto cloned_code = std::make_unique<IRCode>(*code);
+    prune_switch(cloned_code->cfg(), switch_block_id, mid_cases.front(),
+                 mid_cases.back());
+    create_splits(m, std::move(cloned_code), switch_block_id, mid_cases, 1,
+                  mid_cases.size(), &new_methods);
   }
 
   auto& scoped_cfg = *analysis_data.scoped_cfg;
@@ -665,7 +699,6 @@ std::vector<DexMethod*> run_split(AnalysisData& analysis_data,
 Stats run_split_dexes(DexStoresVector& stores,
                       std::vector<AnalysisData>& methods,
                       const method_profiles::MethodProfiles& method_profiles,
-                      size_t case_threshold,
                       size_t max_split_methods) {
   std::unordered_set<DexType*> cset;
   std::unordered_map<DexType*, std::vector<AnalysisData>> mmap;
@@ -738,8 +771,7 @@ Stats run_split_dexes(DexStoresVector& stores,
         }
         left -= required;
         size_t orig_size = data.m->get_code()->sum_opcode_sizes();
-        auto new_methods =
-            run_split(data, data.m, data.m->get_code(), case_threshold);
+        auto new_methods = run_split(data, data.m, data.m->get_code());
         size_t new_size = data.m->get_code()->sum_opcode_sizes();
         for (DexMethod* m : new_methods) {
           type_class(m->get_class())->add_method(m);
@@ -796,7 +828,7 @@ Stats SplitHugeSwitchPass::run(
     return ret;
   }
 
-  auto new_methods = run_split(data, m, code, case_threshold);
+  auto new_methods = run_split(data, m, code);
   ret.new_methods.insert(new_methods.begin(), new_methods.end());
   return ret;
 }
@@ -884,7 +916,7 @@ void SplitHugeSwitchPass::run_pass(DexStoresVector& stores,
   // 2) Prioritize and split the candidates per dex.
 
   Stats result_stats = run_split_dexes(stores, candidates, method_profiles,
-                                       m_switch_size, m_max_split_methods);
+                                       m_max_split_methods);
 
   mgr.set_metric("created_methods", result_stats.new_methods.size());
   mgr.set_metric("no_slots", result_stats.no_slots);
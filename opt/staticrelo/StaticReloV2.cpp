@@ -11,6 +11,7 @@
 #include "ClassHierarchy.h"
 #include "Resolver.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 /**
  * Implementation:
@@ -81,6 +82,30 @@ struct StaticCallGraph {
   }
 };
 
+/**
+ * Returns the ids of the vertices invoked by the given method, in order.
+ */
+std::vector<int> get_static_callees(const StaticCallGraph& graph,
+                                    const DexMethod* caller) {
+  std::vector<int> callee_ids;
+  const IRCode* code = caller->get_code();
+  if (code == nullptr) {
+    return callee_ids;
+  }
+  for (const auto& mie : InstructionIterable(code)) {
+    if (mie.insn->opcode() != OPCODE_INVOKE_STATIC) {
+      continue;
+    }
+    DexMethod* callee =
+        resolve_method(mie.insn->get_method(), MethodSearch::Static);
+    auto it = graph.method_id_map.find(callee);
+    if (it != graph.method_id_map.end()) {
+      callee_ids.push_back(it->second);
+    }
+  }
+  return callee_ids;
+}
+
 /**
  * Build call graph for all static methods in candidate classes
  */
@@ -96,22 +121,22 @@ void build_call_graph(const std::vector<DexClass*>& candidate_classes,
   graph.callers.resize(graph.vertices.size());
   graph.callees.resize(graph.vertices.size());
 
-  for (auto& meth_id : graph.method_id_map) {
-    DexMethod* caller = meth_id.first;
-    int caller_id = meth_id.second;
-    for (const auto& mie : InstructionIterable(caller->get_code())) {
-      if (mie.insn->has_method()) {
-        if (mie.insn->opcode() != OPCODE_INVOKE_STATIC) {
-          continue;
-        }
-        DexMethod* callee =
-            resolve_method(mie.insn->get_method(), MethodSearch::Static);
-        if (graph.method_id_map.find(callee) != graph.method_id_map.end()) {
-          int callee_id = graph.method_id_map[callee];
-          graph.callers[callee_id].insert(caller_id);
-          graph.callees[caller_id].insert(callee_id);
-        }
-      }
+  // Each vertex only adds its own callees in parallel; the callers are
+  // filled in afterwards.
+  auto wq = workqueue_foreach<size_t>([&](size_t caller_id) {
+    auto& callees = graph.callees[caller_id];
+    for (int callee_id :
+         get_static_callees(graph, graph.vertices[caller_id].method)) {
+      callees.insert(callee_id);
+    }
+  });
+  for (size_t caller_id = 0; caller_id < graph.vertices.size(); ++caller_id) {
+    wq.add_item(caller_id);
+  }
+  wq.run_all();
+  for (size_t caller_id = 0; caller_id < graph.vertices.size(); ++caller_id) {
+    for (int callee_id : graph.callees[caller_id]) {
+      graph.callers[callee_id].insert(caller_id);
     }
   }
 }
@@ -146,34 +171,15 @@ void color_vertex(StaticCallGraph& graph, DexMethod* method, int color) {
 }
 
 /**
- * Color the vertices for a class
+ * Color the vertices for a class, given the callees of its methods.
  * For private static method, should color all the caller within the class to
  * the same color
  */
-void color_from_a_class(StaticCallGraph& graph, DexClass* cls, int color) {
-  auto process_method = [&](DexMethod* caller) {
-    IRCode* code = caller->get_code();
-    if (code == nullptr) {
-      return;
-    }
-    for (const auto& mie : InstructionIterable(code)) {
-      if (mie.insn->has_method()) {
-        if (mie.insn->opcode() != OPCODE_INVOKE_STATIC) {
-          continue;
-        }
-        DexMethod* callee =
-            resolve_method(mie.insn->get_method(), MethodSearch::Static);
-        if (graph.method_id_map.find(callee) != graph.method_id_map.end()) {
-          color_vertex(graph, callee, color);
-        }
-      }
-    }
-  };
-  for (DexMethod* method : cls->get_vmethods()) {
-    process_method(method);
-  }
-  for (DexMethod* method : cls->get_dmethods()) {
-    process_method(method);
+void color_from_a_class(StaticCallGraph& graph,
+                        const std::vector<int>& callee_ids,
+                        int color) {
+  for (int callee_id : callee_ids) {
+    color_vertex(graph, graph.vertices[callee_id], color);
   }
 }
 
@@ -229,7 +235,8 @@ namespace static_relo_v2 {
  */
 std::vector<DexClass*> StaticReloPassV2::gen_candidates(const Scope& scope) {
   std::vector<DexClass*> candidate_classes;
-  ClassHierarchy ch = build_type_hierarchy(scope);
+  auto cached_hierarchy = get_cached_class_hierarchy(scope);
+  const auto& ch = cached_hierarchy->hierarchy;
   walk::classes(scope, [&](DexClass* cls) {
     if (!cls->is_external() && get_children(ch, cls->get_type()).empty() &&
         !is_interface(cls) && cls->get_ifields().empty() &&
@@ -255,11 +262,30 @@ int StaticReloPassV2::run_relocation(
   build_call_graph(candidate_classes, graph);
   std::unordered_set<DexClass*> set(candidate_classes.begin(),
                                     candidate_classes.end());
-  for (size_t color = 0; color < scope.size(); color++) {
-    if (set.find(scope[color]) != set.end()) {
-      continue;
+  // Finding the callees of all the other classes is the expensive part, so do
+  // it in parallel. The coloring itself stays in scope order.
+  std::vector<std::vector<int>> class_callees(scope.size());
+  auto wq = workqueue_foreach<size_t>([&](size_t color) {
+    DexClass* cls = scope[color];
+    if (set.count(cls)) {
+      return;
     }
-    color_from_a_class(graph, scope[color], color);
+    auto& callee_ids = class_callees[color];
+    auto add_callees = [&](const std::vector<DexMethod*>& methods) {
+      for (DexMethod* method : methods) {
+        auto ids = get_static_callees(graph, method);
+        callee_ids.insert(callee_ids.end(), ids.begin(), ids.end());
+      }
+    };
+    add_callees(cls->get_vmethods());
+    add_callees(cls->get_dmethods());
+  });
+  for (size_t color = 0; color < scope.size(); color++) {
+    wq.add_item(color);
+  }
+  wq.run_all();
+  for (size_t color = 0; color < scope.size(); color++) {
+    color_from_a_class(graph, class_callees[color], color);
   }
 
   return relocate_clusters(graph, scope);
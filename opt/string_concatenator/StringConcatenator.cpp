@@ -11,8 +11,10 @@
 #include <map>
 #include <mutex>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 
+#include "ConfigFiles.h"
 #include "ControlFlow.h"
 #include "DexClass.h"
 #include "IRCode.h"
@@ -82,11 +84,14 @@ struct Stats {
   uint32_t insns_removed{0};
   uint32_t clinits_emptied{0};
   uint32_t string_fields_resolved{0};
+  // The <clinit>s of cold-start classes among the emptied ones.
+  uint32_t coldstart_clinits_emptied{0};
 
   Stats& operator+=(const Stats& that) {
     insns_removed += that.insns_removed;
     clinits_emptied += that.clinits_emptied;
     string_fields_resolved += that.string_fields_resolved;
+    coldstart_clinits_emptied += that.coldstart_clinits_emptied;
     return *this;
   }
 
@@ -94,6 +99,7 @@ struct Stats {
     mgr.set_metric("insns_removed", insns_removed);
     mgr.set_metric("clinits_emptied", clinits_emptied);
     mgr.set_metric("string_fields_resolved", string_fields_resolved);
+    mgr.set_metric("coldstart_clinits_emptied", coldstart_clinits_emptied);
     TRACE(STR_CAT, 1,
           "insns removed: %d, methods rewritten %d, string fields resolved %d",
           insns_removed, clinits_emptied, string_fields_resolved);
@@ -366,15 +372,22 @@ class Concatenator {
 } // namespace
 
 void StringConcatenatorPass::run_pass(DexStoresVector& stores,
-                                      ConfigFiles& /* unused */,
+                                      ConfigFiles& conf,
                                       PassManager& mgr) {
   const bool DEBUG = false;
   const auto& scope = build_class_scope(stores);
   const ConcatenatorConfig config{};
+  std::unordered_set<const DexType*> coldstart_types;
+  for (const auto& str : conf.get_coldstart_classes()) {
+    auto type = DexType::get_type(str.c_str());
+    if (type != nullptr) {
+      coldstart_types.insert(type);
+    }
+  }
   LockedMethodSet methods_to_remove;
   Stats stats = walk::parallel::methods<Stats>(
       scope,
-      [&config, &methods_to_remove](DexMethod* m) {
+      [&config, &coldstart_types, &methods_to_remove](DexMethod* m) {
         auto code = m->get_code();
         if (code == nullptr) {
           return Stats{};
@@ -389,6 +402,9 @@ void StringConcatenatorPass::run_pass(DexStoresVector& stores,
         Stats stats =
             Concatenator{config}.run(&code->cfg(), m, &methods_to_remove);
         code->clear_cfg();
+        if (coldstart_types.count(m->get_class())) {
+          stats.coldstart_clinits_emptied = stats.clinits_emptied;
+        }
 
         return stats;
       },
@@ -7,10 +7,12 @@
 
 #include "StringBuilderOutliner.h"
 
+#include <atomic>
 #include <unordered_map>
 #include <unordered_set>
 
 #include "ConcurrentContainers.h"
+#include "ConfigFiles.h"
 #include "Creators.h"
 #include "DexAsm.h"
 #include "DexClass.h"
@@ -356,9 +358,9 @@ static IROpcode invoke_for_method(const DexMethod* method) {
  * move instructions created here will be eliminated as part of move coalescing
  * during register allocation.
  */
-void Outliner::transform(IRCode* code) {
+bool Outliner::transform(IRCode* code) {
   if (m_builder_state_maps.count(code) == 0) {
-    return;
+    return false;
   }
   const auto& tostring_instruction_to_state = m_builder_state_maps.at(code);
 
@@ -402,7 +404,11 @@ void Outliner::transform(IRCode* code) {
     insns_to_replace.emplace(tostring_insn, invoke_outlined);
   }
 
+  if (insns_to_replace.empty()) {
+    return false;
+  }
   apply_changes(insns_to_insert, insns_to_replace, code);
+  return true;
 }
 
 /*
@@ -443,7 +449,7 @@ void Outliner::apply_changes(
 }
 
 void StringBuilderOutlinerPass::run_pass(DexStoresVector& stores,
-                                         ConfigFiles&,
+                                         ConfigFiles& conf,
                                          PassManager& mgr) {
   auto scope = build_class_scope(stores);
   Outliner outliner(m_config);
@@ -454,9 +460,21 @@ void StringBuilderOutlinerPass::run_pass(DexStoresVector& stores,
   // 2) Determine which candidates occur frequently enough to be worth
   // outlining. Build the corresponding outline helper functions.
   outliner.create_outline_helpers(&stores);
-  // 3) Actually do the outlining.
+  // 3) Actually do the outlining. We count the methods of cold-start classes
+  // we rewrite, as those changes are the ones that matter most for startup.
+  std::unordered_set<const DexType*> coldstart_types;
+  for (const auto& str : conf.get_coldstart_classes()) {
+    auto type = DexType::get_type(str.c_str());
+    if (type != nullptr) {
+      coldstart_types.insert(type);
+    }
+  }
+  std::atomic<size_t> coldstart_methods_rewritten{0};
   walk::parallel::code(scope, [&](const DexMethod* method, IRCode& code) {
-    outliner.transform(&code);
+    if (outliner.transform(&code) &&
+        coldstart_types.count(method->get_class())) {
+      ++coldstart_methods_rewritten;
+    }
   });
 
   mgr.incr_metric("stringbuilders_removed",
@@ -465,6 +483,7 @@ void StringBuilderOutlinerPass::run_pass(DexStoresVector& stores,
                   outliner.get_stats().operations_removed);
   mgr.incr_metric("helper_methods_created",
                   outliner.get_stats().helper_methods_created);
+  mgr.incr_metric("coldstart_methods_rewritten", coldstart_methods_rewritten);
 }
 
 static StringBuilderOutlinerPass s_pass;
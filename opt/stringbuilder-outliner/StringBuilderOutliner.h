@@ -214,7 +214,8 @@ class Outliner {
 
   void create_outline_helpers(DexStoresVector* stores);
 
-  void transform(IRCode* code);
+  // Returns whether any StringBuilder in `code` was outlined.
+  bool transform(IRCode* code);
 
  private:
   InstructionSet find_tostring_instructions(
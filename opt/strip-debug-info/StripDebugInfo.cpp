@@ -44,7 +44,8 @@ Stats& Stats::operator+=(const Stats& other) {
   return *this;
 }
 
-bool StripDebugInfo::should_remove(const MethodItemEntry& mei, Stats& stats) {
+bool StripDebugInfo::should_remove(const MethodItemEntry& mei,
+                                   Stats& stats) const {
   bool remove = false;
   if (mei.type == MFLOW_DEBUG) {
     auto op = mei.dbgop->opcode();
@@ -110,11 +111,13 @@ bool StripDebugInfo::should_drop_for_synth(const DexMethod* method) const {
 }
 
 Stats StripDebugInfo::run(const Scope& scope) {
-  Stats stats;
-  walk::code(scope, [&](DexMethod* meth, IRCode& code) {
-    stats += run(code, should_drop_for_synth(meth));
+  return walk::parallel::methods<Stats>(scope, [&](DexMethod* meth) {
+    auto code = meth->get_code();
+    if (code == nullptr) {
+      return Stats();
+    }
+    return run(*code, should_drop_for_synth(meth));
   });
-  return stats;
 }
 
 Stats StripDebugInfo::run(IRCode& code, bool should_drop_synth) {
@@ -123,31 +126,32 @@ Stats StripDebugInfo::run(IRCode& code, bool should_drop_synth) {
   bool debug_info_empty = true;
   bool force_discard = m_config.drop_all_dbg_info || should_drop_synth;
 
-  for (auto it = code.begin(); it != code.end();) {
-    const auto& mie = *it;
+  // The dropped entries, and the positions and debug ops they own, are freed
+  // as they are unlinked. Positions are all dropped or all kept, so none of
+  // the kept ones can have a dropped parent.
+  code.remove_and_dispose_if([&](const MethodItemEntry& mie) {
     if (should_remove(mie, stats) || (force_discard && is_debug_entry(mie))) {
       // Even though force_discard will drop the debug item below, preventing
       // any of the debug entries for :meth to be output, we still want to
       // erase those entries here so that transformations like inlining won't
       // move these entries into a method that does have a debug item.
-      it = code.erase(it);
-    } else {
-      switch (mie.type) {
-      case MFLOW_DEBUG:
-        // Any debug information op other than an end sequence means
-        // we have debug info.
-        if (mie.dbgop->opcode() != DBG_END_SEQUENCE) debug_info_empty = false;
-        break;
-      case MFLOW_POSITION:
-        // Any line position entry means we have debug info.
-        debug_info_empty = false;
-        break;
-      default:
-        break;
-      }
-      ++it;
+      return true;
     }
-  }
+    switch (mie.type) {
+    case MFLOW_DEBUG:
+      // Any debug information op other than an end sequence means
+      // we have debug info.
+      if (mie.dbgop->opcode() != DBG_END_SEQUENCE) debug_info_empty = false;
+      break;
+    case MFLOW_POSITION:
+      // Any line position entry means we have debug info.
+      debug_info_empty = false;
+      break;
+    default:
+      break;
+    }
+    return false;
+  });
 
   if (m_config.drop_all_dbg_info ||
       (debug_info_empty && m_config.drop_all_dbg_info_if_empty) ||
@@ -89,7 +89,7 @@ class StripDebugInfo {
   bool drop_line_numbers() const {
     return m_config.drop_line_nrs || m_config.drop_all_dbg_info;
   }
-  bool should_remove(const MethodItemEntry& mei, Stats& stats);
+  bool should_remove(const MethodItemEntry& mei, Stats& stats) const;
   bool should_drop_for_synth(const DexMethod*) const;
 
   const StripDebugInfoPass::Config& m_config;
@@ -30,6 +30,7 @@
 #include "Resolver.h"
 #include "SynthConfig.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 constexpr const char* METRIC_GETTERS_REMOVED = "getter_methods_removed_count";
 constexpr const char* METRIC_WRAPPERS_REMOVED = "wrapper_methods_removed_count";
@@ -671,6 +672,30 @@ void replace_wrappers(const ClassHierarchy& ch,
   }
 }
 
+/*
+ * Whether replace_wrappers(...) can change anything about the method, i.e.
+ * whether it invokes a getter, wrapper, wrappee or constructor wrapper.
+ */
+bool invokes_wrapper(DexMethod* caller_method, const WrapperMethods& ssms) {
+  for (const auto& mie : InstructionIterable(caller_method->get_code())) {
+    auto insn = mie.insn;
+    DexMethod* callee;
+    if (insn->opcode() == OPCODE_INVOKE_STATIC) {
+      callee = resolve_method(insn->get_method(), MethodSearch::Static);
+    } else if (insn->opcode() == OPCODE_INVOKE_DIRECT) {
+      callee = resolve_method(insn->get_method(), MethodSearch::Direct);
+    } else {
+      continue;
+    }
+    if (callee != nullptr &&
+        (ssms.getters.count(callee) || ssms.wrappers.count(callee) ||
+         ssms.wrapped.count(callee) || ssms.ctors.count(callee))) {
+      return true;
+    }
+  }
+  return false;
+}
+
 void remove_dead_methods(WrapperMethods& ssms,
                          const SynthConfig& synthConfig,
                          SynthMetrics& metrics) {
@@ -774,9 +799,21 @@ void do_transform(const ClassHierarchy& ch,
       methods.emplace_back(vm);
     }
   }
-  for (auto const& m : methods) {
-    if (m->get_code()) {
-      replace_wrappers(ch, m, ssms);
+  // Finding the callers of wrappers is read-only, so it can be done in
+  // parallel. The callers are then updated serially, in the original order,
+  // since replace_wrappers(...) updates ssms as it goes.
+  std::vector<char> invokes_wrappers(methods.size());
+  auto wq = workqueue_foreach<size_t>([&](size_t i) {
+    invokes_wrappers[i] =
+        methods[i]->get_code() != nullptr && invokes_wrapper(methods[i], ssms);
+  });
+  for (size_t i = 0; i < methods.size(); ++i) {
+    wq.add_item(i);
+  }
+  wq.run_all();
+  for (size_t i = 0; i < methods.size(); ++i) {
+    if (invokes_wrappers[i]) {
+      replace_wrappers(ch, methods[i], ssms);
     }
   }
   // check that invokes to promoted static method is correct
@@ -36,6 +36,7 @@
 
 #include "ThrowPropagationPass.h"
 
+#include "ConcurrentContainers.h"
 #include "ControlFlow.h"
 #include "DexUtil.h"
 #include "IRCode.h"
@@ -53,6 +54,44 @@ constexpr const char* METRIC_UNREACHABLE_INSTRUCTIONS =
 constexpr const char* METRIC_NO_RETURN_METHODS = "num_no_return_methods";
 constexpr const char* METRIC_ITERATIONS = "num_iterations";
 
+bool is_no_return_method(const ThrowPropagationPass::Config& config,
+                         DexMethod* method) {
+  if (is_abstract(method) || method->is_external() || is_native(method) ||
+      method->rstate.no_optimizations()) {
+    return false;
+  }
+  if (config.black_list.count(method->get_class())) {
+    TRACE(TP, 4, "black-listed method: %s", SHOW(method));
+    return false;
+  }
+  bool can_return{false};
+  editable_cfg_adapter::iterate_with_iterator(
+      method->get_code(), [&can_return](const IRList::iterator& it) {
+        if (is_return(it->insn->opcode())) {
+          can_return = true;
+          return editable_cfg_adapter::LOOP_BREAK;
+        } else {
+          return editable_cfg_adapter::LOOP_CONTINUE;
+        }
+      });
+  return !can_return;
+}
+
+// Whether the code invokes a method with one of the given names. Any method
+// that an invoke may resolve to, or that overrides it, has the name of the
+// invoked method reference.
+bool invokes_any_of(const IRCode& code,
+                    const std::unordered_set<const DexString*>& names) {
+  for (auto& mie : cfg::ConstInstructionIterable(code.cfg())) {
+    auto insn = mie.insn;
+    if (is_invoke(insn->opcode()) &&
+        names.count(insn->get_method()->get_name())) {
+      return true;
+    }
+  }
+  return false;
+}
+
 } // namespace
 
 void ThrowPropagationPass::bind_config() {
@@ -68,25 +107,7 @@ std::unordered_set<DexMethod*> ThrowPropagationPass::get_no_return_methods(
     const Config& config, const Scope& scope) {
   ConcurrentSet<DexMethod*> concurrent_no_return_methods;
   walk::parallel::methods(scope, [&](DexMethod* method) {
-    if (is_abstract(method) || method->is_external() || is_native(method) ||
-        method->rstate.no_optimizations()) {
-      return;
-    }
-    if (config.black_list.count(method->get_class())) {
-      TRACE(TP, 4, "black-listed method: %s", SHOW(method));
-      return;
-    }
-    bool can_return{false};
-    editable_cfg_adapter::iterate_with_iterator(
-        method->get_code(), [&can_return](const IRList::iterator& it) {
-          if (is_return(it->insn->opcode())) {
-            can_return = true;
-            return editable_cfg_adapter::LOOP_BREAK;
-          } else {
-            return editable_cfg_adapter::LOOP_CONTINUE;
-          }
-        });
-    if (!can_return) {
+    if (is_no_return_method(config, method)) {
       concurrent_no_return_methods.insert(method);
     }
   });
@@ -311,35 +332,54 @@ void ThrowPropagationPass::run_pass(DexStoresVector& stores,
     }
   });
   auto override_graph = method_override_graph::build_graph(scope);
-  size_t last_no_return_methods{0};
-  int iterations = 0;
+  int iterations = 1;
   Stats stats;
-  while (true) {
-    iterations++;
-    std::unordered_set<DexMethod*> no_return_methods =
-        get_no_return_methods(m_config, scope);
-    TRACE(TP,
-          2,
-          "iteration %d, no_return_methods: %zu",
-          iterations,
-          no_return_methods.size());
-    if (no_return_methods.size() == last_no_return_methods) {
-      break;
-    }
-    last_no_return_methods = no_return_methods.size();
+  std::unordered_set<DexMethod*> no_return_methods =
+      get_no_return_methods(m_config, scope);
+  TRACE(TP, 2, "iteration %d, no_return_methods: %zu", iterations,
+        no_return_methods.size());
+  // After the first iteration, only the code changed in the previous one can
+  // have lost its returns, and only invokes of the methods newly found to not
+  // return can lead to new throws.
+  boost::optional<std::unordered_set<const DexString*>> new_no_return_names;
+  while (!no_return_methods.empty()) {
+    ConcurrentSet<DexMethod*> changed_methods;
     auto last_stats =
         walk::parallel::methods<Stats>(scope, [&](DexMethod* method) -> Stats {
           auto code = method->get_code();
           if (method->rstate.no_optimizations() || code == nullptr) {
             return {};
           }
+          if (new_no_return_names &&
+              !invokes_any_of(*code, *new_no_return_names)) {
+            return {};
+          }
 
-          return run(m_config, no_return_methods, *override_graph, code);
+          auto method_stats =
+              run(m_config, no_return_methods, *override_graph, code);
+          if (method_stats.throws_inserted > 0) {
+            changed_methods.insert(method);
+          }
+          return method_stats;
         });
     if (last_stats.throws_inserted == 0) {
       break;
     }
     stats += last_stats;
+
+    iterations++;
+    new_no_return_names = std::unordered_set<const DexString*>();
+    for (auto method : changed_methods) {
+      if (is_no_return_method(m_config, method) &&
+          no_return_methods.insert(method).second) {
+        new_no_return_names->insert(method->get_name());
+      }
+    }
+    TRACE(TP, 2, "iteration %d, no_return_methods: %zu", iterations,
+          no_return_methods.size());
+    if (new_no_return_names->empty()) {
+      break;
+    }
   }
 
   walk::parallel::code(scope, [&](const DexMethod* method, IRCode& code) {
@@ -351,7 +391,7 @@ void ThrowPropagationPass::run_pass(DexStoresVector& stores,
   mgr.incr_metric(METRIC_THROWS_INSERTED, stats.throws_inserted);
   mgr.incr_metric(METRIC_UNREACHABLE_INSTRUCTIONS,
                   stats.unreachable_instruction_count);
-  mgr.incr_metric(METRIC_NO_RETURN_METHODS, last_no_return_methods);
+  mgr.incr_metric(METRIC_NO_RETURN_METHODS, no_return_methods.size());
   mgr.incr_metric(METRIC_ITERATIONS, iterations);
 }
 
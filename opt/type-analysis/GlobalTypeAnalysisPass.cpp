@@ -25,7 +25,8 @@ void GlobalTypeAnalysisPass::run_pass(DexStoresVector& stores,
   type_analyzer::Transform::NullAssertionSet null_assertion_set;
   Transform::setup(null_assertion_set);
   Scope scope = build_class_scope(stores);
-  global::GlobalTypeAnalysis analysis(m_config.max_global_analysis_iteration);
+  global::GlobalTypeAnalysis analysis(m_config.max_global_analysis_iteration,
+                                      m_config.compact_analysis_results);
   auto gta = analysis.analyze(scope);
   optimize(scope, *gta, null_assertion_set, mgr);
 }
@@ -21,6 +21,7 @@ class GlobalTypeAnalysisPass : public Pass {
   struct Config {
     size_t max_global_analysis_iteration{10};
     bool insert_runtime_asserts{false};
+    bool compact_analysis_results{false};
     type_analyzer::Transform::Config transform;
     type_analyzer::RuntimeAssertTransform::Config runtime_assert;
   };
@@ -51,6 +52,9 @@ class GlobalTypeAnalysisPass : public Pass {
          m_config.max_global_analysis_iteration,
          "Maximum number of global iterations the analysis runs");
     bind("insert_runtime_asserts", false, m_config.insert_runtime_asserts);
+    bind("compact_analysis_results", false, m_config.compact_analysis_results,
+         "Only keep method summaries once the analysis is done, which lowers "
+         "the peak memory of the transformations");
   }
 
   void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
@@ -940,12 +940,24 @@ size_t get_interdex_group(
 } // namespace
 
 std::vector<TypeSet> Model::group_per_interdex_set(const TypeSet& types) {
-  const auto& type_to_usages = get_type_usages(types, m_scope);
+  // The usages of a type don't depend on the other types looked up with it,
+  // so one walk over the scope for all the types of the model serves every
+  // group.
+  if (!m_type_usages) {
+    m_type_usages.emplace();
+    for (auto& pair : get_type_usages(m_types, m_scope)) {
+      m_type_usages->emplace(pair.first, std::move(pair.second));
+    }
+  }
   std::vector<TypeSet> new_groups(s_num_interdex_groups);
-  for (const auto& pair : type_to_usages) {
-    auto index = get_interdex_group(pair.second, s_cls_to_interdex_group,
+  for (const auto& type : types) {
+    auto it = m_type_usages->find(type);
+    if (it == m_type_usages->end()) {
+      continue;
+    }
+    auto index = get_interdex_group(it->second, s_cls_to_interdex_group,
                                     s_num_interdex_groups);
-    new_groups[index].emplace(pair.first);
+    new_groups[index].emplace(type);
   }
 
   if (m_spec.merge_per_interdex_set == InterDexGroupingType::NON_HOT_SET) {
@@ -331,6 +331,12 @@ class Model {
 
   const Scope& m_scope;
 
+  // For each type of the model, the classes whose code refers to it. Computed
+  // on first use, as it takes a walk over the code of the whole scope.
+  boost::optional<
+      std::unordered_map<const DexType*, std::unordered_set<DexType*>>>
+      m_type_usages;
+
   static std::unordered_map<DexType*, size_t> s_cls_to_interdex_group;
   static size_t s_num_interdex_groups;
 
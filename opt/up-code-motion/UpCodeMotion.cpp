@@ -333,12 +333,11 @@ UpCodeMotionPass::Stats UpCodeMotionPass::process_code(bool is_static,
   return stats;
 }
 
-void UpCodeMotionPass::run_pass(DexStoresVector& stores,
-                                ConfigFiles& /* unused */,
-                                PassManager& mgr) {
-  auto scope = build_class_scope(stores);
-
-  Stats stats = walk::parallel::methods<Stats>(scope, [](DexMethod* method) {
+std::unique_ptr<MethodLocalTransform>
+UpCodeMotionPass::make_method_local_transform(DexStoresVector&,
+                                              ConfigFiles& /* unused */,
+                                              PassManager&) {
+  auto transform = [](DexMethod* method) {
     const auto code = method->get_code();
     if (!code) {
       return Stats{};
@@ -357,19 +356,21 @@ void UpCodeMotionPass::run_pass(DexStoresVector& stores,
             SHOW(method));
     }
     return stats;
-  });
-
-  mgr.incr_metric(METRIC_INSTRUCTIONS_MOVED, stats.instructions_moved);
-  mgr.incr_metric(METRIC_BRANCHES_MOVED_OVER, stats.branches_moved_over);
-  mgr.incr_metric(METRIC_INVERTED_CONDITIONAL_BRANCHES,
-                  stats.inverted_conditional_branches);
-  mgr.incr_metric(METRIC_CLOBBERED_REGISTERS, stats.clobbered_registers);
-  TRACE(UCM, 1,
-        "[up code motion] Moved %u instructions over %u conditional branches "
-        "while inverting %u conditional branches and dealing with %u clobbered "
-        "registers in total",
-        stats.instructions_moved, stats.branches_moved_over,
-        stats.inverted_conditional_branches, stats.clobbered_registers);
+  };
+  auto report = [](const Stats& stats, PassManager& mgr) {
+    mgr.incr_metric(METRIC_INSTRUCTIONS_MOVED, stats.instructions_moved);
+    mgr.incr_metric(METRIC_BRANCHES_MOVED_OVER, stats.branches_moved_over);
+    mgr.incr_metric(METRIC_INVERTED_CONDITIONAL_BRANCHES,
+                    stats.inverted_conditional_branches);
+    mgr.incr_metric(METRIC_CLOBBERED_REGISTERS, stats.clobbered_registers);
+    TRACE(UCM, 1,
+          "[up code motion] Moved %u instructions over %u conditional "
+          "branches while inverting %u conditional branches and dealing with "
+          "%u clobbered registers in total",
+          stats.instructions_moved, stats.branches_moved_over,
+          stats.inverted_conditional_branches, stats.clobbered_registers);
+  };
+  return std::make_unique<StatsMethodLocalTransform<Stats>>(transform, report);
 }
 
 static UpCodeMotionPass s_pass;
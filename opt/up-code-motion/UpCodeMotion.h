@@ -8,9 +8,9 @@
 #pragma once
 
 #include "ControlFlow.h"
-#include "Pass.h"
+#include "MethodLocalTransform.h"
 
-class UpCodeMotionPass : public Pass {
+class UpCodeMotionPass : public MethodLocalPass {
  public:
   struct Stats {
     size_t instructions_moved{0};
@@ -27,9 +27,10 @@ class UpCodeMotionPass : public Pass {
     }
   };
 
-  UpCodeMotionPass() : Pass("UpCodeMotionPass") {}
+  UpCodeMotionPass() : MethodLocalPass("UpCodeMotionPass") {}
 
-  void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
+  std::unique_ptr<MethodLocalTransform> make_method_local_transform(
+      DexStoresVector&, ConfigFiles&, PassManager&) override;
 
   static Stats process_code(bool is_static,
                             DexType* declaring_type,
@@ -12,6 +12,7 @@
 #include "DexClass.h"
 #include "DexUtil.h"
 #include "IROpcode.h"
+#include "BatchedRefUpdater.h"
 #include "Resolver.h"
 #include "Trace.h"
 #include "TypeReference.h"
@@ -505,7 +506,16 @@ void update_references(const Scope& scope,
                        const std::unordered_map<DexType*, DexType*>& update_map,
                        const std::unordered_map<DexMethodRef*, DexMethodRef*>&
                            methodref_update_map) {
-  walk::opcodes(
+  // Type operands, including arrays of any dimension, and encoded values all
+  // go through one batched walk; method refs need the merge-specific fixups
+  // below.
+  reference_update::BatchedRefUpdater type_updater;
+  for (const auto& pair : update_map) {
+    type_updater.update_type_refs(pair.first, pair.second);
+  }
+  type_updater.apply(scope);
+
+  walk::parallel::opcodes(
       scope,
       [](DexMethod* method) { return true; },
       [&](DexMethod* method, IRInstruction* insn) {
@@ -514,21 +524,7 @@ void update_references(const Scope& scope,
           // removed.
           return;
         }
-        if (insn->has_type()) {
-          auto ref_type = insn->get_type();
-          DexType* type =
-              const_cast<DexType*>(type::get_element_type_if_array(ref_type));
-          if (update_map.count(type) == 0) {
-            return;
-          }
-          auto merger_type = update_map.at(type);
-          if (type::is_array(ref_type)) {
-            auto array_merger_type = type::make_array_type(merger_type);
-            insn->set_type(array_merger_type);
-          } else {
-            insn->set_type(const_cast<DexType*>(merger_type));
-          }
-        } else if (insn->has_field()) {
+        if (insn->has_field()) {
           DexField* field = resolve_field(insn->get_field());
           if (field != nullptr) {
             always_assert_log(
@@ -752,6 +748,9 @@ void VerticalMergingPass::merge_classes(
     const Scope& scope,
     const std::unordered_map<DexClass*, DexClass*>& mergeable_to_merger,
     const std::unordered_set<DexMethod*>& referenced_methods) {
+  // collect_can_merge only pairs a class with its only child, which must be a
+  // leaf, so no class is part of two pairs and all the merges can share a
+  // single round of reference updates.
   std::unordered_map<DexType*, DexType*> update_map;
   std::unordered_map<DexMethodRef*, DexMethodRef*> methodref_update_map;
   for (const auto& pair : mergeable_to_merger) {
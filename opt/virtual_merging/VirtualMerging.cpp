@@ -42,12 +42,15 @@
 
 #include "VirtualMerging.h"
 
+#include <chrono>
+
 #include "ControlFlow.h"
 #include "CppUtil.h"
 #include "IRCode.h"
 #include "IRInstruction.h"
 #include "MethodProfiles.h"
 #include "Resolver.h"
+#include "Timer.h"
 #include "TypeSystem.h"
 #include "Walkers.h"
 
@@ -78,6 +81,8 @@ constexpr const char* METRIC_UNINLINABLE_METHODS = "num_uninlinable_methods";
 constexpr const char* METRIC_HUGE_METHODS = "num_huge_methods";
 constexpr const char* METRIC_REMOVED_VIRTUAL_METHODS =
     "num_removed_virtual_methods";
+constexpr const char* METRIC_ANALYSIS_MS = "analysis_ms";
+constexpr const char* METRIC_REWRITING_MS = "rewriting_ms";
 
 } // namespace
 
@@ -749,18 +754,32 @@ void VirtualMerging::remap_invoke_virtuals() {
 }
 
 void VirtualMerging::run(const method_profiles::MethodProfiles& profiles) {
-  TRACE(VM, 1, "[VM] Finding unsupported virtual scopes");
-  find_unsupported_virtual_scopes();
-  TRACE(VM, 1, "[VM] Computing mergeable scope methods");
-  compute_mergeable_scope_methods();
-  TRACE(VM, 1, "[VM] Computing mergeable pairs by virtual scopes");
-  compute_mergeable_pairs_by_virtual_scopes(profiles);
-  TRACE(VM, 1, "[VM] Merging methods");
-  merge_methods();
-  TRACE(VM, 1, "[VM] Removing methods");
-  remove_methods();
-  TRACE(VM, 1, "[VM] Remapping invoke-virtual instructions");
-  remap_invoke_virtuals();
+  using namespace std::chrono;
+  auto elapsed_ms = [](steady_clock::time_point start) {
+    return duration_cast<milliseconds>(steady_clock::now() - start).count();
+  };
+  auto start = steady_clock::now();
+  {
+    Timer t("VirtualMerging analysis");
+    TRACE(VM, 1, "[VM] Finding unsupported virtual scopes");
+    find_unsupported_virtual_scopes();
+    TRACE(VM, 1, "[VM] Computing mergeable scope methods");
+    compute_mergeable_scope_methods();
+    TRACE(VM, 1, "[VM] Computing mergeable pairs by virtual scopes");
+    compute_mergeable_pairs_by_virtual_scopes(profiles);
+  }
+  m_stats.analysis_ms = elapsed_ms(start);
+  start = steady_clock::now();
+  {
+    Timer t("VirtualMerging rewriting");
+    TRACE(VM, 1, "[VM] Merging methods");
+    merge_methods();
+    TRACE(VM, 1, "[VM] Removing methods");
+    remove_methods();
+    TRACE(VM, 1, "[VM] Remapping invoke-virtual instructions");
+    remap_invoke_virtuals();
+  }
+  m_stats.rewriting_ms = elapsed_ms(start);
   TRACE(VM, 1, "[VM] Done");
 }
 
@@ -820,6 +839,8 @@ void VirtualMergingPass::run_pass(DexStoresVector& stores,
   mgr.incr_metric(METRIC_HUGE_METHODS, stats.huge_methods);
   mgr.incr_metric(METRIC_REMOVED_VIRTUAL_METHODS,
                   stats.removed_virtual_methods);
+  mgr.incr_metric(METRIC_ANALYSIS_MS, stats.analysis_ms);
+  mgr.incr_metric(METRIC_REWRITING_MS, stats.rewriting_ms);
 }
 
 static VirtualMergingPass s_pass;
@@ -30,6 +30,9 @@ struct VirtualMergingStats {
   size_t uninlinable_methods{0};
   size_t huge_methods{0};
   size_t removed_virtual_methods{0};
+  // Wall time of finding the mergeable pairs, and of merging them.
+  size_t analysis_ms{0};
+  size_t rewriting_ms{0};
 };
 
 class VirtualMerging {
@@ -42,9 +45,12 @@ class VirtualMerging {
   Scope m_scope;
   XStoreRefs m_xstores;
   XDexRefs m_xdexes;
+  // The virtual scopes of the candidate search. They come from the class
+  // scopes that are cached across passes (see get_cached_class_scopes), so
+  // VirtualMerging doesn't need an override graph of its own.
   TypeSystem m_type_system;
   size_t m_max_overriding_method_instructions;
-  MethodRefCache m_resolved_refs;
+  ConcurrentMethodRefCache m_resolved_refs;
   inliner::InlinerConfig m_inliner_config;
   std::unique_ptr<MultiMethodInliner> m_inliner;
   VirtualMergingStats m_stats;
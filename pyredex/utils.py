@@ -211,14 +211,28 @@ class ZipManager:
     """
     __enter__: Unzips input_apk into extracted_apk_dir
     __exit__: Zips extracted_apk_dir into output_apk
+
+    With an apk_writer binary, __exit__ lets it build output_apk instead. It
+    reuses the compressed data of unchanged entries from input_apk, and aligns
+    the output, so that it doesn't need zipalign afterwards.
     """
 
     per_file_compression = {}
 
-    def __init__(self, input_apk, extracted_apk_dir, output_apk):
+    def __init__(
+        self,
+        input_apk,
+        extracted_apk_dir,
+        output_apk,
+        apk_writer=None,
+        page_align=False,
+    ):
         self.input_apk = input_apk
         self.extracted_apk_dir = extracted_apk_dir
         self.output_apk = output_apk
+        self.apk_writer = apk_writer
+        self.page_align = page_align
+        self.aligned = False
 
     def __enter__(self):
         log("Extracting apk...")
@@ -233,6 +247,15 @@ class ZipManager:
             os.remove(self.output_apk)
 
         log("Creating output apk")
+        if self.apk_writer is not None:
+            args = [self.apk_writer]
+            if self.page_align:
+                args.append("-p")
+            args += [self.input_apk, self.extracted_apk_dir, self.output_apk]
+            subprocess.check_call(args)
+            self.aligned = True
+            return
+
         with zipfile.ZipFile(self.output_apk, "w") as new_apk:
             # Need sorted output for deterministic zip file. Sorting `dirnames` will
             # ensure the tree walk order. Sorting `filenames` will ensure the files
@@ -530,6 +530,7 @@ def align_and_sign_output_apk(
     key_password,
     ignore_zipalign,
     page_align,
+    aligned=False,
 ):
     if isfile(output_apk_path):
         os.remove(output_apk_path)
@@ -540,7 +541,10 @@ def align_and_sign_output_apk(
         if e.errno != errno.EEXIST:
             raise
 
-    zipalign(unaligned_apk_path, output_apk_path, ignore_zipalign, page_align)
+    if aligned:
+        shutil.move(unaligned_apk_path, output_apk_path)
+    else:
+        zipalign(unaligned_apk_path, output_apk_path, ignore_zipalign, page_align)
 
     if reset_timestamps:
         ZipReset.reset_file(output_apk_path)
@@ -741,6 +745,11 @@ Given an APK, produce a better APK!
         action="store_true",
         help="Preserve 4k page alignment for uncompressed libs",
     )
+    parser.add_argument(
+        "--apk-writer",
+        help="Path to a redex-apk-writer binary. If given, it creates the "
+        "aligned output APK, instead of zipfile and zipalign",
+    )
 
     parser.add_argument(
         "--side-effect-summaries", help="Side effect information for external methods"
@@ -886,7 +895,13 @@ def prepare_redex(args):
 
     directory = make_temp_dir(".redex_unaligned", False)
     unaligned_apk_path = join(directory, "redex-unaligned.apk")
-    zip_manager = ZipManager(args.input_apk, extracted_apk_dir, unaligned_apk_path)
+    zip_manager = ZipManager(
+        args.input_apk,
+        extracted_apk_dir,
+        unaligned_apk_path,
+        apk_writer=args.apk_writer,
+        page_align=args.page_align_libs,
+    )
     zip_manager.__enter__()
 
     if not dex_dir:
@@ -987,6 +1002,7 @@ def finalize_redex(state):
         state.args.keypass,
         state.args.ignore_zipalign,
         state.args.page_align_libs,
+        aligned=state.zip_manager.aligned,
     )
 
     log(
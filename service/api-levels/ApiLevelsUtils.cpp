@@ -118,10 +118,13 @@ bool find_field(const std::string& simple_deobfuscated_name,
                 const std::vector<FRefInfo>& frefs_info,
                 DexType* field_type,
                 DexAccessFlags access_flags) {
+  auto* name = DexString::get_string(simple_deobfuscated_name);
+  if (name == nullptr) {
+    return false;
+  }
   for (const FRefInfo& fref_info : frefs_info) {
     auto* fref = fref_info.fref;
-    if (fref->get_name()->str() == simple_deobfuscated_name &&
-        fref->get_type() == field_type) {
+    if (fref->get_name() == name && fref->get_type() == field_type) {
 
       // We also need to check the access flags.
       // NOTE: We accept cases where the methods are not declared final.
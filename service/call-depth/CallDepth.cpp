@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "CallDepth.h"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "IRCode.h"
+#include "IRInstruction.h"
+#include "WorkQueue.h"
+
+namespace call_depth {
+
+namespace {
+
+constexpr size_t kUnbounded = std::numeric_limits<size_t>::max();
+
+// The depth of a method that isn't part of a cycle, given the depths of the
+// components of the lower levels.
+size_t method_depth(
+    const DexMethod* method,
+    const call_graph::Graph& graph,
+    const std::unordered_map<const DexMethod*, size_t>& index_of,
+    const std::vector<size_t>& depths) {
+  if (!graph.has_node(method)) {
+    return kUnbounded;
+  }
+  size_t depth = 0;
+  // Calls that don't resolve have no edges, but still take a frame.
+  for (auto& mie :
+       InstructionIterable(const_cast<IRCode*>(method->get_code()))) {
+    if (is_invoke(mie.insn->opcode())) {
+      depth = 1;
+      break;
+    }
+  }
+  for (const auto& edge : graph.node(method)->callees()) {
+    auto callee = edge->callee()->method();
+    if (callee == nullptr) {
+      continue;
+    }
+    if (callee == method) {
+      return kUnbounded;
+    }
+    auto it = index_of.find(callee);
+    if (it == index_of.end()) {
+      // No code in the scope.
+      depth = std::max(depth, size_t(1));
+      continue;
+    }
+    auto callee_depth = depths[it->second];
+    if (callee_depth == kUnbounded) {
+      return kUnbounded;
+    }
+    depth = std::max(depth, callee_depth + 1);
+  }
+  return depth;
+}
+
+} // namespace
+
+CallDepths compute(const Scope& scope, const call_graph::Graph& graph) {
+  auto levels = call_graph::components_by_level(scope, graph);
+
+  // Number the methods so that each thread writes its own slots, and only
+  // reads the slots of the lower levels, which are final.
+  std::unordered_map<const DexMethod*, size_t> index_of;
+  for (const auto& level : levels) {
+    for (const auto& component : level) {
+      for (auto method : component) {
+        index_of.emplace(method, index_of.size());
+      }
+    }
+  }
+  std::vector<size_t> depths(index_of.size(), kUnbounded);
+
+  for (const auto& level : levels) {
+    auto wq = workqueue_foreach<const call_graph::Component*>(
+        [&](const call_graph::Component* component) {
+          if (component->size() > 1) {
+            // A cycle; its depths stay unbounded.
+            return;
+          }
+          auto method = component->front();
+          depths[index_of.at(method)] =
+              method_depth(method, graph, index_of, depths);
+        });
+    for (const auto& component : level) {
+      wq.add_item(&component);
+    }
+    wq.run_all();
+  }
+
+  CallDepths result;
+  result.reserve(index_of.size());
+  for (const auto& p : index_of) {
+    if (depths[p.second] != kUnbounded) {
+      result.emplace(p.first, depths[p.second]);
+    }
+  }
+  return result;
+}
+
+} // namespace call_depth
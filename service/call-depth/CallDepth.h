@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <unordered_map>
+
+#include "CallGraph.h"
+#include "DexClass.h"
+
+namespace call_depth {
+
+/*
+ * The maximum call depth of a method is the number of calls on the longest
+ * chain of calls that it can make: 0 if it calls nothing, 1 if it only calls
+ * methods without code in the scope or unresolved methods, and one more than
+ * the deepest of its callees otherwise.
+ *
+ * The depth of a method that is part of a cycle in the call graph, or that
+ * can call into one, is unbounded; such methods are left out of the result,
+ * as are the methods with code that aren't nodes of the call graph.
+ */
+using CallDepths = std::unordered_map<const DexMethod*, size_t>;
+
+/*
+ * Computes the call depths bottom-up over the strongly connected components
+ * of :graph, in parallel for the components of the same level (see
+ * call_graph::components_by_level).
+ */
+CallDepths compute(const Scope& scope, const call_graph::Graph& graph);
+
+} // namespace call_depth
@@ -14,6 +14,7 @@
 #include "ControlFlow.h"
 #include "IRCode.h"
 #include "ScopedCFG.h"
+#include "WorkQueue.h"
 
 using namespace cic;
 
@@ -1120,6 +1121,20 @@ void InitLocation::reset_uses_from(DexClass* cls_impl, DexMethod* method) {
   m_inits[cls_impl].erase(method);
 }
 
+void InitLocation::take_uses_from(DexClass* cls_impl,
+                                  DexMethod* method,
+                                  InitLocation&& other) {
+  m_count += other.m_count;
+  auto methods = other.m_inits.find(cls_impl);
+  if (methods == other.m_inits.end()) {
+    return;
+  }
+  auto instructions_uses = methods->second.find(method);
+  if (instructions_uses != methods->second.end()) {
+    m_inits[cls_impl][method] = std::move(instructions_uses->second);
+  }
+}
+
 void InitLocation::all_uses_from(DexClass* cls_impl,
                                  DexMethod* method,
                                  ObjectUsedSet& set) const {
@@ -1148,14 +1163,65 @@ ClassInitCounter::ClassInitCounter(
         "Found %zu children of parent %s",
         m_type_to_inits.size(),
         SHOW(parent_class));
+  find_uses_within_all(classes);
+}
+
+void ClassInitCounter::find_uses_within_all(
+    const std::unordered_set<DexClass*>& classes) {
+  std::vector<std::pair<DexClass*, DexMethod*>> methods;
   for (DexClass* current : classes) {
     for (DexMethod* method : current->get_vmethods()) {
-      find_uses_within(current, method);
+      methods.emplace_back(current, method);
     }
     for (DexMethod* method : current->get_dmethods()) {
-      find_uses_within(current, method);
+      methods.emplace_back(current, method);
     }
   }
+
+  struct MethodUses {
+    TypeToInit type_to_inits;
+    MergedUsedSet merged_set;
+  };
+  std::vector<MethodUses> results(methods.size());
+  const std::unordered_set<IRInstruction*> empty;
+  auto wq = workqueue_foreach<size_t>([&](size_t i) {
+    DexClass* container = methods[i].first;
+    DexMethod* method = methods[i].second;
+    if (method->get_code() == nullptr) {
+      return;
+    }
+    auto& result = results[i];
+    for (const auto& t_init : m_type_to_inits) {
+      result.type_to_inits.emplace(t_init.first, InitLocation(t_init.first));
+    }
+    drive_analysis(container, method, "find_uses_within", empty,
+                   result.type_to_inits, result.merged_set);
+  });
+  for (size_t i = 0; i < methods.size(); ++i) {
+    wq.add_item(i);
+  }
+  wq.run_all();
+
+  // Merging in the order of the methods builds the same tables as analyzing
+  // the methods one after the other.
+  for (size_t i = 0; i < methods.size(); ++i) {
+    DexClass* container = methods[i].first;
+    DexMethod* method = methods[i].second;
+    for (auto& t_init : m_type_to_inits) {
+      t_init.second.reset_uses_from(container, method);
+    }
+    auto& stored_mergeds = m_stored_mergeds[container->get_type()];
+    stored_mergeds.erase(method);
+    if (method->get_code() == nullptr) {
+      continue;
+    }
+    auto& result = results[i];
+    for (auto& t_init : result.type_to_inits) {
+      m_type_to_inits.at(t_init.first)
+          .take_uses_from(container, method, std::move(t_init.second));
+    }
+    stored_mergeds[method] = std::move(result.merged_set);
+  }
 }
 
 void ClassInitCounter::find_children(
@@ -1174,42 +1240,43 @@ void ClassInitCounter::analyze_block(
     TypeToInit& type_to_inits,
     const std::unordered_set<IRInstruction*>& tracked_set,
     cfg::Block* prev_block,
-    cfg::Block* block) {
+    cfg::Block* block,
+    VisitedBlocks& visited_blocks,
+    MergedUsedSet& stored_mergeds) const {
   bool first_visit = true;
 
   if (visited_blocks.count(prev_block) && visited_blocks.count(block)) {
     TRACE(CIC, 8, "Previously seen block %zu", block->id());
     first_visit = false;
     bool same_registers =
-        visited_blocks[block]->input_registers.consistent_with(
-            visited_blocks[prev_block]->basic_block_registers);
-    if (same_registers && visited_blocks[block]->final_result_registers) {
+        visited_blocks[block].input_registers.consistent_with(
+            visited_blocks[prev_block].basic_block_registers);
+    if (same_registers && visited_blocks[block].final_result_registers) {
       TRACE(CIC, 8, "Input hasn't changed and there's a result so end");
       return;
     }
     if (same_registers) {
       TRACE(CIC, 8, "Loop detected, providing basic block result as result");
-      visited_blocks[block]->final_result_registers =
-          visited_blocks[block]->basic_block_registers;
+      visited_blocks[block].final_result_registers =
+          visited_blocks[block].basic_block_registers;
       return;
     }
     TRACE(CIC, 8, "Repeat visit, with inconsistent input, merge registers");
-    visited_blocks[block]->input_registers.merge_registers(
-        visited_blocks[prev_block]->basic_block_registers,
-        m_stored_mergeds[container->get_type()][method]);
+    visited_blocks[block].input_registers.merge_registers(
+        visited_blocks[prev_block].basic_block_registers, stored_mergeds);
   } else if (visited_blocks.count(prev_block)) {
     TRACE(CIC, 8,
           "First visit to %zu, setup visited blocks with input registers",
           block);
-    visited_blocks[block] = std::make_shared<RegistersPerBlock>();
-    visited_blocks[block]->input_registers =
-        visited_blocks[prev_block]->basic_block_registers;
+    visited_blocks[block] = RegistersPerBlock();
+    visited_blocks[block].input_registers =
+        visited_blocks[prev_block].basic_block_registers;
   } else {
     TRACE(CIC, 8, "First visit to first block of method, setup empty register");
-    visited_blocks[block] = std::make_shared<RegistersPerBlock>();
+    visited_blocks[block] = RegistersPerBlock();
   }
 
-  RegisterSet registers = visited_blocks[block]->input_registers;
+  RegisterSet registers = visited_blocks[block].input_registers;
   uint32_t block_id = block->id();
   uint32_t instruction_count = 0;
 
@@ -1327,28 +1394,28 @@ void ClassInitCounter::analyze_block(
     TRACE(CIC, 8, "Not our first visit to %zu, check for different blocks",
           block_id);
     bool same_block =
-        visited_blocks[block]->basic_block_registers.consistent_with(registers);
-    if (same_block && visited_blocks[block]->final_result_registers) {
+        visited_blocks[block].basic_block_registers.consistent_with(registers);
+    if (same_block && visited_blocks[block].final_result_registers) {
       TRACE(CIC, 8, "No change and a final result, go on");
       return;
     } else if (same_block) {
       TRACE(CIC, 8, "No change, no result, move to have a result and end");
-      visited_blocks[block]->final_result_registers = std::move(registers);
+      visited_blocks[block].final_result_registers = std::move(registers);
       return;
     } else {
       TRACE(CIC, 8, "Basic blocks were inconsistent, update registers");
-      visited_blocks[block]->basic_block_registers.merge_registers(
-          registers, m_stored_mergeds[container->get_type()][method]);
+      visited_blocks[block].basic_block_registers.merge_registers(
+          registers, stored_mergeds);
     }
   } else {
     TRACE(CIC, 8, "Our first visit, move in our registers");
-    visited_blocks[block]->basic_block_registers = std::move(registers);
+    visited_blocks[block].basic_block_registers = std::move(registers);
   }
 
   if (block->succs().empty()) {
     TRACE(CIC, 8, "Termination of block %zu", block->id());
-    visited_blocks[block]->final_result_registers =
-        visited_blocks[block]->basic_block_registers;
+    visited_blocks[block].final_result_registers =
+        visited_blocks[block].basic_block_registers;
     return;
   }
 
@@ -1359,23 +1426,24 @@ void ClassInitCounter::analyze_block(
   for (auto* edge : block->succs()) {
     cfg::Block* next = edge->target();
     TRACE(CIC, 8, "making call from %zu to block %zu", block->id(), next->id());
-    analyze_block(container, method, type_to_inits, tracked_set, block, next);
-    assert(visited_blocks[next]->final_result_registers);
+    analyze_block(container, method, type_to_inits, tracked_set, block, next,
+                  visited_blocks, stored_mergeds);
+    assert(visited_blocks[next].final_result_registers);
 
     TRACE(CIC, 8, "Combining paths after looking at block %zu from %zu",
           block->id(), next->id());
     if (walked_one_path) {
-      paths.combine_paths(visited_blocks[next]->final_result_registers.value());
+      paths.combine_paths(visited_blocks[next].final_result_registers.value());
     } else {
-      paths = visited_blocks[next]->final_result_registers.value();
+      paths = visited_blocks[next].final_result_registers.value();
       walked_one_path = true;
     }
   }
 
   TRACE(CIC, 8, "Update effects of walking paths for %zu", block->id());
-  visited_blocks[block]->final_result_registers =
-      visited_blocks[block]->basic_block_registers;
-  visited_blocks[block]->final_result_registers.value().merge_effects(paths);
+  visited_blocks[block].final_result_registers =
+      visited_blocks[block].basic_block_registers;
+  visited_blocks[block].final_result_registers.value().merge_effects(paths);
 }
 
 std::pair<ObjectUsedSet, MergedUsedSet> ClassInitCounter::find_uses_of(
@@ -1385,7 +1453,8 @@ std::pair<ObjectUsedSet, MergedUsedSet> ClassInitCounter::find_uses_of(
   std::unordered_set<IRInstruction*> tracked{origin};
   DexClass* container = type_class(method->get_class());
 
-  drive_analysis(container, method, "find_uses_of", tracked, init_storage);
+  drive_analysis(container, method, "find_uses_of", tracked, init_storage,
+                 m_stored_mergeds[container->get_type()][method]);
 
   ObjectUsedSet use;
   use.insert(init_storage[typ].get_inits()[container][method][origin][0]);
@@ -1397,7 +1466,8 @@ void ClassInitCounter::drive_analysis(
     DexMethod* method,
     const std::string& analysis,
     const std::unordered_set<IRInstruction*>& tracking,
-    TypeToInit& type_to_inits) {
+    TypeToInit& type_to_inits,
+    MergedUsedSet& merged_set) const {
   IRCode* instructions = method->get_code();
   if (instructions == nullptr) {
     return;
@@ -1405,15 +1475,17 @@ void ClassInitCounter::drive_analysis(
   cfg::ScopedCFG graph(instructions);
 
   cfg::Block* block = graph->entry_block();
-  visited_blocks =
-      std::unordered_map<cfg::Block*, std::shared_ptr<RegistersPerBlock>>();
+  // These registers are the storage for registers during analysis, they
+  // are accessed and modified across recursive calls to analyze_block
+  VisitedBlocks visited_blocks;
+  visited_blocks.reserve(graph->num_blocks());
 
   TRACE(CIC, 5, "starting %s analysis for method %s.%s with %zu blocks\n",
         analysis.c_str(), SHOW(container), SHOW(method), graph->num_blocks());
 
-  analyze_block(container, method, type_to_inits, tracking, nullptr, block);
+  analyze_block(container, method, type_to_inits, tracking, nullptr, block,
+                visited_blocks, merged_set);
 
-  auto& merged_set = m_stored_mergeds[container->get_type()][method];
   // This loop collects the results of all ObjectUses and MergedUses encountered
   // in the forwards analysis, which has been merged bottom up to coalesce the
   // final full possible results from this method across all encountered tracked
@@ -1422,7 +1494,7 @@ void ClassInitCounter::drive_analysis(
   // through non-back edges first in the traversal combined with switching to a
   // loop implementation rather than a recursive one.
   for (const auto& use :
-       visited_blocks[block]->final_result_registers.value().m_all_uses) {
+       visited_blocks[block].final_result_registers.value().m_all_uses) {
     if (use->m_tracked_kind == Object) {
       type_to_inits[static_cast<ObjectUses&>(*use).get_represents_typ()]
           .update_object(container, method, static_cast<ObjectUses&>(*use));
@@ -1439,8 +1511,12 @@ void ClassInitCounter::find_uses_within(DexClass* container,
     t_init.second.reset_uses_from(container, method);
   }
   m_stored_mergeds[container->get_type()].erase(method);
+  if (method->get_code() == nullptr) {
+    return;
+  }
   std::unordered_set<IRInstruction*> empty;
-  drive_analysis(container, method, "find_uses_within", empty, m_type_to_inits);
+  drive_analysis(container, method, "find_uses_within", empty, m_type_to_inits,
+                 m_stored_mergeds[container->get_type()][method]);
 }
 
 std::pair<ObjectUsedSet, MergedUsedSet> ClassInitCounter::all_uses_from(
@@ -442,6 +442,10 @@ class InitLocation final {
   // is accurate.
   void reset_uses_from(DexClass* cls, DexMethod* method);
 
+  // Takes over the data of `other` from `method`, which it must be the only
+  // one to have, along with its count.
+  void take_uses_from(DexClass* cls, DexMethod* method, InitLocation&& other);
+
   DexType* m_typ = nullptr;
 
  private:
@@ -455,6 +459,9 @@ struct RegistersPerBlock {
   boost::optional<RegisterSet> final_result_registers;
 };
 
+// The registers of the blocks of the method under analysis.
+using VisitedBlocks = std::unordered_map<cfg::Block*, RegistersPerBlock>;
+
 class ClassInitCounter final {
  public:
   using TypeToInit = std::unordered_map<DexType*, InitLocation>;
@@ -500,18 +507,17 @@ class ClassInitCounter final {
       // If empty, tracks all new_instance or method calls as set in ctor
       const std::unordered_set<IRInstruction*>& tracking,
       // Reference to data structure to store results in
-      TypeToInit& type_to_init);
+      TypeToInit& type_to_init,
+      // Reference to the set to store the merged uses of the method in
+      MergedUsedSet& merged_set) const;
 
   // Identifies and stores in type_to_inits all classes that extend parent
   void find_children(DexType* parent,
                      const std::unordered_set<DexClass*>& classes);
 
-  // Walks all of the methods of the apk, updating type_to_inits
-  void walk_methods(DexClass* container,
-                    const std::vector<DexMethod*>& methods);
-
-  // Walks the instructions of method, populating the relevant init types
-  void inits_any_children(DexClass* container, DexMethod* method);
+  // Analyzes all the methods of the classes in parallel, and then merges the
+  // results in the order of the methods.
+  void find_uses_within_all(const std::unordered_set<DexClass*>& classes);
 
   // Walks block by block the method code that might instantiate a tracked type
   void analyze_block(
@@ -520,7 +526,9 @@ class ClassInitCounter final {
       TypeToInit& populating_inits,
       const std::unordered_set<IRInstruction*>& tracked_instructions,
       cfg::Block* prev_block,
-      cfg::Block* block);
+      cfg::Block* block,
+      VisitedBlocks& visited_blocks,
+      MergedUsedSet& stored_mergeds) const;
 
   TypeToInit m_type_to_inits;
 
@@ -528,11 +536,6 @@ class ClassInitCounter final {
 
   boost::optional<DexString*> m_optional_method;
   std::unordered_set<DexMethodRef*> m_safe_escapes;
-
-  // These registers are the storage for registers during analysis, they
-  // are accessed and modified across recursive calls to analyze_block
-  std::unordered_map<cfg::Block*, std::shared_ptr<RegistersPerBlock>>
-      visited_blocks;
 };
 
 } // namespace cic
@@ -7,8 +7,11 @@
 
 #include "ConstantPropagation.h"
 
+#include <chrono>
+
 #include "ConstantPropagationAnalysis.h"
 #include "ConstantPropagationTransform.h"
+#include "SparseConstantPropagation.h"
 
 #include "Walkers.h"
 
@@ -26,13 +29,37 @@ Transform::Stats ConstantPropagation::run(DexMethod* method,
 
   TRACE(CONSTP, 5, "CFG: %s", SHOW(code->cfg()));
   Transform::Stats local_stats;
-  {
+  if (m_config.use_sparse_analysis) {
+    intraprocedural::SparseFixpointIterator fp_iter(
+        code->cfg(), ConstantPrimitiveAnalyzer());
+    fp_iter.run(ConstantEnvironment());
+    constant_propagation::Transform tf(m_config.transform);
+    local_stats = tf.apply_on_uneditable_cfg(
+        fp_iter, WholeProgramState(), code, xstores, method->get_class());
+  } else {
     intraprocedural::FixpointIterator fp_iter(code->cfg(),
                                               ConstantPrimitiveAnalyzer());
+    sparta::FixpointIteratorStatistics<cfg::Block*> fp_stats;
+    fp_iter.set_observer(&fp_stats);
+    auto start = std::chrono::steady_clock::now();
     fp_iter.run(ConstantEnvironment());
+    // Huge methods are analyzed in parallel, without fp_stats, so time them
+    // separately.
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
     constant_propagation::Transform tf(m_config.transform);
     local_stats = tf.apply_on_uneditable_cfg(
         fp_iter, WholeProgramState(), code, xstores, method->get_class());
+    local_stats.fixpoint_node_visits = fp_stats.node_visits();
+    local_stats.fixpoint_widenings = fp_stats.widenings();
+    local_stats.max_fixpoint_iterations = fp_stats.max_iterations();
+    local_stats.max_fixpoint_us = us;
+    local_stats.slowest_fixpoint_method = method;
+    TRACE(CONSTP, 3,
+          "Fixpoint: %zu visits, %zu widenings, %u iterations, %ldus",
+          fp_stats.node_visits(), fp_stats.widenings(),
+          fp_stats.max_iterations(), (long)us);
   }
   if (xstores) {
     always_assert(!code->editable_cfg_built());
@@ -14,6 +14,9 @@ namespace constant_propagation {
 
 struct Config {
   Transform::Config transform;
+  // Analyze with the sparse engine (see SparseConstantPropagation.h) instead of
+  // the dense one before the transformations on the uneditable cfg.
+  bool use_sparse_analysis{false};
 };
 
 class ConstantPropagation final {
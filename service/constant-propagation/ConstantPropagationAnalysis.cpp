@@ -988,6 +988,11 @@ void FixpointIterator::analyze_instruction(const IRInstruction* insn,
 
 void FixpointIterator::analyze_instruction_no_throw(
     const IRInstruction* insn, ConstantEnvironment* current_state) const {
+  intraprocedural::analyze_instruction_no_throw(insn, current_state);
+}
+
+void analyze_instruction_no_throw(const IRInstruction* insn,
+                                  ConstantEnvironment* current_state) {
   auto src_index = get_dereferenced_object_src_index(insn);
   if (!src_index) {
     return;
@@ -1130,7 +1135,12 @@ static void analyze_if(const IRInstruction* insn,
 
 ConstantEnvironment FixpointIterator::analyze_edge(
     const EdgeId& edge, const ConstantEnvironment& exit_state_at_source) const {
-  auto env = exit_state_at_source;
+  return intraprocedural::analyze_edge(edge, exit_state_at_source);
+}
+
+ConstantEnvironment analyze_edge(const cfg::Edge* edge,
+                                 const ConstantEnvironment& exit_state) {
+  auto env = exit_state;
   auto last_insn_it = edge->src()->get_last_insn();
   if (last_insn_it == edge->src()->end()) {
     return env;
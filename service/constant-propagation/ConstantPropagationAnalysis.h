@@ -9,6 +9,7 @@
 
 #include <utility>
 
+#include "BaseIRAnalyzer.h"
 #include "ConstantEnvironment.h"
 #include "IRCode.h"
 #include "InstructionAnalyzer.h"
@@ -25,12 +26,18 @@ class FixpointIterator final
   /*
    * The fixpoint iterator takes an optional WholeProgramState argument that
    * it will use to determine the static field values and method return values.
+   *
+   * Huge methods are analyzed on several threads. The sub-analyzers only read
+   * their states, which are not modified while an analysis runs; analyzers
+   * added later must keep it that way.
    */
   explicit FixpointIterator(
       const cfg::ControlFlowGraph& cfg,
       InstructionAnalyzer<ConstantEnvironment> insn_analyzer)
       : MonotonicFixpointIterator(cfg),
-        m_insn_analyzer(std::move(insn_analyzer)) {}
+        m_insn_analyzer(std::move(insn_analyzer)) {
+    set_parallel_threshold(ir_analyzer::PARALLEL_FIXPOINT_MIN_NODES);
+  }
 
   ConstantEnvironment analyze_edge(
       const EdgeId&,
@@ -50,6 +57,16 @@ class FixpointIterator final
   InstructionAnalyzer<ConstantEnvironment> m_insn_analyzer;
 };
 
+/*
+ * The parts of FixpointIterator's transfer functions that don't depend on the
+ * instruction analyzer, so that other engines can share them.
+ */
+ConstantEnvironment analyze_edge(const cfg::Edge* edge,
+                                 const ConstantEnvironment& exit_state);
+
+void analyze_instruction_no_throw(const IRInstruction* insn,
+                                  ConstantEnvironment* current_state);
+
 } // namespace intraprocedural
 
 /*
@@ -42,28 +42,51 @@ class Transform final {
     size_t added_param_const{0};
     size_t throws{0};
 
+    // Filled in by ConstantPropagation, from the intraprocedural fixpoint
+    // iterations. The maxima are over all methods, with the method that took
+    // the longest.
+    size_t fixpoint_node_visits{0};
+    size_t fixpoint_widenings{0};
+    size_t max_fixpoint_iterations{0};
+    size_t max_fixpoint_us{0};
+    const DexMethod* slowest_fixpoint_method{nullptr};
+
     Stats& operator+=(const Stats& that) {
       branches_removed += that.branches_removed;
       branches_forwarded += that.branches_forwarded;
       materialized_consts += that.materialized_consts;
       added_param_const += that.added_param_const;
       throws += that.throws;
+      fixpoint_node_visits += that.fixpoint_node_visits;
+      fixpoint_widenings += that.fixpoint_widenings;
+      max_fixpoint_iterations =
+          std::max(max_fixpoint_iterations, that.max_fixpoint_iterations);
+      if (that.max_fixpoint_us > max_fixpoint_us ||
+          slowest_fixpoint_method == nullptr) {
+        max_fixpoint_us = that.max_fixpoint_us;
+        slowest_fixpoint_method = that.slowest_fixpoint_method;
+      }
       return *this;
     }
   };
 
   explicit Transform(Config config = Config()) : m_config(config) {}
 
+  // The Analysis can be either intraprocedural::FixpointIterator or
+  // intraprocedural::SparseFixpointIterator.
+
   // Apply transformations on uneditable cfg
   // TODO: Migrate all to use editable cfg via `apply` method
-  Stats apply_on_uneditable_cfg(const intraprocedural::FixpointIterator&,
+  template <class Analysis>
+  Stats apply_on_uneditable_cfg(const Analysis&,
                                 const WholeProgramState&,
                                 IRCode*,
                                 const XStoreRefs*,
                                 const DexType*);
 
   // Apply (new) transformations on editable cfg
-  Stats apply(const intraprocedural::FixpointIterator&,
+  template <class Analysis>
+  Stats apply(const Analysis&,
               cfg::ControlFlowGraph&,
               DexMethod*,
               const XStoreRefs*);
@@ -103,13 +126,15 @@ class Transform final {
                           cfg::ControlFlowGraph&,
                           cfg::Block*);
 
-  void eliminate_dead_branch(const intraprocedural::FixpointIterator&,
+  template <class Analysis>
+  void eliminate_dead_branch(const Analysis&,
                              const ConstantEnvironment&,
                              cfg::ControlFlowGraph&,
                              cfg::Block*);
 
+  template <class Analysis>
   void forward_targets(
-      const intraprocedural::FixpointIterator&,
+      const Analysis&,
       const ConstantEnvironment&,
       cfg::ControlFlowGraph&,
       cfg::Block*,
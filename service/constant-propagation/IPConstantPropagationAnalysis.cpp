@@ -7,6 +7,8 @@
 
 #include "IPConstantPropagationAnalysis.h"
 
+#include "Resolver.h"
+
 namespace constant_propagation {
 
 namespace interprocedural {
@@ -92,17 +94,91 @@ Domain FixpointIterator::analyze_edge(
   return entry_state_at_dest;
 }
 
-std::unique_ptr<intraprocedural::FixpointIterator>
+std::shared_ptr<const intraprocedural::FixpointIterator>
 FixpointIterator::get_intraprocedural_analysis(const DexMethod* method) const {
   auto args = Domain::bottom();
 
   if (m_call_graph.has_node(method)) {
     args = this->get_entry_state_at(m_call_graph.node(method));
   }
+  const auto& method_args = args.get(CURRENT_PARTITION_LABEL);
+
+  if (!m_cache_analyses) {
+    return m_proc_analysis_factory(method, this->get_whole_program_state(),
+                                   method_args);
+  }
+
+  const auto& cfg = method->get_code()->cfg();
+  auto it = m_cache.find(method);
+  if (it != m_cache.end() && is_valid(it->second, cfg, method_args)) {
+    ++m_cache_hits;
+    return it->second.analysis;
+  }
+  ++m_cache_misses;
+  std::shared_ptr<const intraprocedural::FixpointIterator> analysis =
+      m_proc_analysis_factory(method, this->get_whole_program_state(),
+                              method_args);
+  auto entry = make_cache_entry(cfg, method_args, analysis);
+  m_cache.update(method, [&](const DexMethod*, CachedAnalysis& e, bool) {
+    e = std::move(entry);
+  });
+  return analysis;
+}
+
+bool FixpointIterator::is_valid(const CachedAnalysis& entry,
+                                const cfg::ControlFlowGraph& cfg,
+                                const ArgumentDomain& args) const {
+  if (entry.cfg != &cfg || !entry.args.equals(args)) {
+    return false;
+  }
+  const auto& wps = this->get_whole_program_state();
+  for (const auto& pair : entry.field_values) {
+    if (!wps.get_field_value(pair.first).equals(pair.second)) {
+      return false;
+    }
+  }
+  for (const auto& pair : entry.return_values) {
+    if (!wps.get_return_value(pair.first).equals(pair.second)) {
+      return false;
+    }
+  }
+  return true;
+}
 
-  return m_proc_analysis_factory(method,
-                                 this->get_whole_program_state(),
-                                 args.get(CURRENT_PARTITION_LABEL));
+/*
+ * The WholeProgramAwareAnalyzer only looks up the resolved fields of the get
+ * instructions and the resolved callees of the invoke instructions, so these
+ * are all the values of the WholeProgramState that the analysis depends on.
+ */
+FixpointIterator::CachedAnalysis FixpointIterator::make_cache_entry(
+    const cfg::ControlFlowGraph& cfg,
+    const ArgumentDomain& args,
+    std::shared_ptr<const intraprocedural::FixpointIterator> analysis) const {
+  CachedAnalysis entry{&cfg, args, {}, {}, std::move(analysis), m_wps};
+  const auto& wps = this->get_whole_program_state();
+  std::unordered_set<const DexField*> fields;
+  std::unordered_set<const DexMethod*> methods;
+  for (auto* block : cfg.blocks()) {
+    for (auto& mie : InstructionIterable(block)) {
+      auto* insn = mie.insn;
+      auto op = insn->opcode();
+      if (is_sget(op) || is_iget(op)) {
+        auto field = resolve_field(insn->get_field());
+        if (field != nullptr && fields.insert(field).second) {
+          entry.field_values.emplace_back(field, wps.get_field_value(field));
+        }
+      } else if (op == OPCODE_INVOKE_DIRECT || op == OPCODE_INVOKE_STATIC ||
+                 op == OPCODE_INVOKE_VIRTUAL) {
+        auto callee =
+            resolve_method(insn->get_method(), opcode_to_search(insn));
+        if (callee != nullptr && methods.insert(callee).second) {
+          entry.return_values.emplace_back(callee,
+                                           wps.get_return_value(callee));
+        }
+      }
+    }
+  }
+  return entry;
 }
 
 } // namespace interprocedural
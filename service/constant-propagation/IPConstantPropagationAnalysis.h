@@ -7,7 +7,10 @@
 
 #pragma once
 
+#include <atomic>
+
 #include "CallGraph.h"
+#include "ConcurrentContainers.h"
 #include "ConstantEnvironment.h"
 #include "ConstantPropagationAnalysis.h"
 #include "ConstantPropagationWholeProgramState.h"
@@ -64,16 +67,27 @@ using ProcedureAnalysisFactory =
  *
  * The intraprocedural propagation logic is delegated to the
  * ProcedureAnalysisFactory.
+ *
+ * If :cache_analyses is set, the intraprocedural analysis of each method is
+ * kept around and reused for as long as the method is analyzed with the same
+ * arguments, and the WholeProgramState has the same values for all the fields
+ * and methods that the method references. This saves most of the work of the
+ * repeated runs with refined WholeProgramStates, and of the clients that
+ * query the analyses afterwards, at the cost of keeping the environments of
+ * all methods in memory. The code of the methods must not change while their
+ * analyses are cached.
  */
 class FixpointIterator : public sparta::ParallelMonotonicFixpointIterator<
                              call_graph::GraphInterface,
                              Domain> {
  public:
   FixpointIterator(const call_graph::Graph& call_graph,
-                   const ProcedureAnalysisFactory& proc_analysis_factory)
+                   const ProcedureAnalysisFactory& proc_analysis_factory,
+                   bool cache_analyses = false)
       : ParallelMonotonicFixpointIterator(call_graph),
         m_proc_analysis_factory(proc_analysis_factory),
-        m_call_graph(call_graph) {
+        m_call_graph(call_graph),
+        m_cache_analyses(cache_analyses) {
     auto wps = new WholeProgramState();
     wps->set_to_top();
     m_wps.reset(wps);
@@ -85,7 +99,7 @@ class FixpointIterator : public sparta::ParallelMonotonicFixpointIterator<
   Domain analyze_edge(const std::shared_ptr<call_graph::Edge>& edge,
                       const Domain& exit_state_at_source) const override;
 
-  std::unique_ptr<intraprocedural::FixpointIterator>
+  std::shared_ptr<const intraprocedural::FixpointIterator>
   get_intraprocedural_analysis(const DexMethod*) const;
 
   const WholeProgramState& get_whole_program_state() const { return *m_wps; }
@@ -96,10 +110,37 @@ class FixpointIterator : public sparta::ParallelMonotonicFixpointIterator<
 
   const call_graph::Graph& get_call_graph() { return m_call_graph; }
 
+  size_t cache_hits() const { return m_cache_hits; }
+  size_t cache_misses() const { return m_cache_misses; }
+
  private:
-  std::unique_ptr<const WholeProgramState> m_wps;
+  struct CachedAnalysis {
+    const cfg::ControlFlowGraph* cfg;
+    ArgumentDomain args;
+    // The values in the WholeProgramState that the analysis depended on.
+    std::vector<std::pair<const DexField*, ConstantValue>> field_values;
+    std::vector<std::pair<const DexMethod*, ConstantValue>> return_values;
+    std::shared_ptr<const intraprocedural::FixpointIterator> analysis;
+    // The analysis keeps referring to the state it was created with.
+    std::shared_ptr<const WholeProgramState> wps;
+  };
+
+  bool is_valid(const CachedAnalysis&,
+                const cfg::ControlFlowGraph&,
+                const ArgumentDomain&) const;
+
+  CachedAnalysis make_cache_entry(
+      const cfg::ControlFlowGraph&,
+      const ArgumentDomain&,
+      std::shared_ptr<const intraprocedural::FixpointIterator>) const;
+
+  std::shared_ptr<const WholeProgramState> m_wps;
   ProcedureAnalysisFactory m_proc_analysis_factory;
   call_graph::Graph m_call_graph;
+  const bool m_cache_analyses;
+  mutable ConcurrentMap<const DexMethod*, CachedAnalysis> m_cache;
+  mutable std::atomic<size_t> m_cache_hits{0};
+  mutable std::atomic<size_t> m_cache_misses{0};
 };
 
 } // namespace interprocedural
@@ -0,0 +1,264 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "SparseConstantPropagation.h"
+
+#include "Trace.h"
+
+namespace constant_propagation {
+
+namespace intraprocedural {
+
+namespace {
+
+/*
+ * The instruction whose result is read by the move-result that starts
+ * :block, i.e. the last instruction of its (only) fallthrough predecessor.
+ */
+const IRInstruction* primary_of_leading_move_result(cfg::Block* block) {
+  for (auto* edge : block->preds()) {
+    if (edge->type() != cfg::EDGE_GOTO) {
+      continue;
+    }
+    auto it = edge->src()->get_last_insn();
+    if (it != edge->src()->end() && it->insn->has_move_result_any()) {
+      return it->insn;
+    }
+  }
+  return nullptr;
+}
+
+} // namespace
+
+SparseFixpointIterator::SparseFixpointIterator(
+    const cfg::ControlFlowGraph& cfg,
+    InstructionAnalyzer<ConstantEnvironment> insn_analyzer)
+    : m_cfg(cfg),
+      m_insn_analyzer(std::move(insn_analyzer)),
+      m_reaching_defs(std::make_unique<reaching_defs::FixpointIterator>(cfg)) {
+  m_reaching_defs->run(reaching_defs::Environment());
+
+  // Besides definitions, we keep track of the sources of block terminators,
+  // which decide the feasibility of edges, and of instructions with
+  // move-results, which decide the values of their move-results.
+  for (auto* block : cfg.blocks()) {
+    auto defs_env = m_reaching_defs->get_entry_state_at(block);
+    auto last_insn = block->get_last_insn();
+    const IRInstruction* prev = nullptr;
+    for (auto& mie : InstructionIterable(block)) {
+      auto* insn = mie.insn;
+      bool is_last = insn == last_insn->insn;
+      if (insn->has_dest() || insn->has_move_result_any() || is_last) {
+        auto& def = m_defs[insn];
+        def.block = block;
+        def.is_last = is_last;
+        for (size_t i = 0; i < insn->srcs_size(); ++i) {
+          def.src_defs.push_back(defs_env.get(insn->src(i)));
+        }
+        if (opcode::is_move_result_any(insn->opcode())) {
+          def.primary = prev != nullptr ? prev
+                                        : primary_of_leading_move_result(block);
+        }
+      }
+      m_reaching_defs->analyze_instruction(insn, &defs_env);
+      prev = insn;
+    }
+  }
+
+  for (auto& pair : m_defs) {
+    auto* insn = pair.first;
+    const auto& def = pair.second;
+    if (!insn->has_dest() && !def.is_last) {
+      continue;
+    }
+    const auto& srcs_def =
+        def.primary != nullptr ? m_defs.at(def.primary) : def;
+    for (const auto& defs : srcs_def.src_defs) {
+      if (defs.is_top() || defs.is_bottom()) {
+        continue;
+      }
+      for (auto* src_def : defs.elements()) {
+        m_defs.at(src_def).uses.push_back(insn);
+      }
+    }
+  }
+}
+
+void SparseFixpointIterator::run(const ConstantEnvironment& init_env) {
+  m_init_env = init_env;
+  mark_executable(m_cfg.entry_block());
+  while (!m_block_worklist.empty() || !m_insn_worklist.empty()) {
+    if (!m_block_worklist.empty()) {
+      auto* block = m_block_worklist.back();
+      m_block_worklist.pop_back();
+      TRACE(CONSTP, 5, "Visiting block: %d", block->id());
+      for (auto& mie : InstructionIterable(block)) {
+        if (mie.insn->has_dest()) {
+          update_value(mie.insn);
+        }
+      }
+      visit_edges(block);
+      continue;
+    }
+    auto* insn = m_insn_worklist.back();
+    m_insn_worklist.pop_back();
+    const auto& def = m_defs.at(insn);
+    if (insn->has_dest()) {
+      update_value(insn);
+    }
+    if (def.is_last) {
+      visit_edges(def.block);
+    }
+  }
+}
+
+ConstantValue SparseFixpointIterator::join_definitions(
+    const reaching_defs::Domain& defs) const {
+  if (defs.is_top()) {
+    return ConstantValue::top();
+  }
+  auto value = ConstantValue::bottom();
+  if (defs.is_bottom()) {
+    return value;
+  }
+  for (auto* def : defs.elements()) {
+    value.join_with(m_defs.at(def).value);
+  }
+  return value;
+}
+
+/*
+ * Bind the sources of :insn to the join of the values of their reaching
+ * definitions. Returns false if one of them has no value yet.
+ */
+bool SparseFixpointIterator::bind_sources(const IRInstruction* insn,
+                                          const Definition& def,
+                                          ConstantEnvironment* env) const {
+  for (size_t i = 0; i < insn->srcs_size(); ++i) {
+    auto value = join_definitions(def.src_defs[i]);
+    if (value.is_bottom()) {
+      return false;
+    }
+    env->set(insn->src(i), value);
+  }
+  return true;
+}
+
+ConstantValue SparseFixpointIterator::evaluate(const IRInstruction* insn,
+                                               const Definition& def) const {
+  if (opcode::is_load_param(insn->opcode())) {
+    return m_init_env.get(insn->dest());
+  }
+  ConstantEnvironment env;
+  if (def.primary != nullptr) {
+    if (!bind_sources(def.primary, m_defs.at(def.primary), &env)) {
+      return ConstantValue::bottom();
+    }
+    m_insn_analyzer(def.primary, &env);
+  } else if (!bind_sources(insn, def, &env)) {
+    return ConstantValue::bottom();
+  }
+  m_insn_analyzer(insn, &env);
+  return env.get(insn->dest());
+}
+
+void SparseFixpointIterator::update_value(const IRInstruction* insn) {
+  auto& def = m_defs.at(insn);
+  auto value = def.value;
+  value.join_with(evaluate(insn, def));
+  if (value.equals(def.value)) {
+    return;
+  }
+  def.value = std::move(value);
+  for (auto* use : def.uses) {
+    if (is_executable(m_defs.at(use).block)) {
+      m_insn_worklist.push_back(use);
+    }
+  }
+}
+
+void SparseFixpointIterator::visit_edges(cfg::Block* block) {
+  ConstantEnvironment env;
+  auto last_insn = block->get_last_insn();
+  if (last_insn != block->end() &&
+      !bind_sources(last_insn->insn, m_defs.at(last_insn->insn), &env)) {
+    return;
+  }
+  for (auto* edge : block->succs()) {
+    if (!analyze_edge(edge, env).is_bottom()) {
+      mark_executable(edge->target());
+    }
+  }
+}
+
+void SparseFixpointIterator::mark_executable(cfg::Block* block) {
+  if (m_executable.insert(block).second) {
+    m_block_worklist.push_back(block);
+  }
+}
+
+ConstantEnvironment SparseFixpointIterator::get_entry_state_at(
+    cfg::Block* block) const {
+  if (!is_executable(block)) {
+    return ConstantEnvironment::bottom();
+  }
+  ConstantEnvironment env;
+  auto defs_env = m_reaching_defs->get_entry_state_at(block);
+  if (!defs_env.is_bottom()) {
+    for (const auto& binding : defs_env.bindings()) {
+      auto value = join_definitions(binding.second);
+      // A register whose definitions have no value yet can only be read on
+      // paths that are not executable, so leaving it unbound is sound.
+      if (!value.is_top() && !value.is_bottom()) {
+        env.set(binding.first, value);
+      }
+    }
+  }
+  auto first_insn = block->get_first_insn();
+  if (first_insn != block->end() &&
+      opcode::is_move_result_any(first_insn->insn->opcode())) {
+    auto value = get_value(first_insn->insn);
+    if (!value.is_bottom()) {
+      env.set(RESULT_REGISTER, value);
+    }
+  }
+  return env;
+}
+
+ConstantEnvironment SparseFixpointIterator::get_exit_state_at(
+    cfg::Block* block) const {
+  auto env = get_entry_state_at(block);
+  if (env.is_bottom()) {
+    return env;
+  }
+  auto last_insn = block->get_last_insn();
+  for (auto& mie : InstructionIterable(block)) {
+    auto* insn = mie.insn;
+    analyze_instruction(insn, &env, insn == last_insn->insn);
+  }
+  return env;
+}
+
+void SparseFixpointIterator::analyze_instruction(
+    const IRInstruction* insn,
+    ConstantEnvironment* current_state,
+    bool is_last) const {
+  m_insn_analyzer(insn, current_state);
+  if (!is_last) {
+    analyze_instruction_no_throw(insn, current_state);
+  }
+}
+
+ConstantValue SparseFixpointIterator::get_value(
+    const IRInstruction* insn) const {
+  auto it = m_defs.find(insn);
+  return it == m_defs.end() ? ConstantValue::bottom() : it->second.value;
+}
+
+} // namespace intraprocedural
+
+} // namespace constant_propagation
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "ConstantPropagationAnalysis.h"
+#include "ReachingDefinitions.h"
+
+namespace constant_propagation {
+
+namespace intraprocedural {
+
+/*
+ * A sparse alternative to FixpointIterator, in the style of Wegman & Zadeck's
+ * sparse conditional constant propagation.
+ *
+ * Instead of keeping a ConstantEnvironment at every block, it keeps a single
+ * ConstantValue per definition, and propagates value changes along def-use
+ * chains derived from reaching definitions. Blocks become executable when a
+ * feasible edge leads to them, and only definitions in executable blocks
+ * contribute to the values of their uses.
+ *
+ * The states it hands out have the same interface as FixpointIterator's, so
+ * that Transform can consume either. They are sound, but can be less precise:
+ * the sparse engine doesn't track refinements of registers implied by
+ * branches or by dereferences, and evaluates every definition in an otherwise
+ * unknown environment, so analyzers that track state beyond registers (fields,
+ * heap objects) gain nothing from it.
+ */
+class SparseFixpointIterator final {
+ public:
+  SparseFixpointIterator(
+      const cfg::ControlFlowGraph& cfg,
+      InstructionAnalyzer<ConstantEnvironment> insn_analyzer);
+
+  void run(const ConstantEnvironment& init_env);
+
+  /*
+   * Bottom for blocks that are not executable. Otherwise, the value of every
+   * register is the join of the values of its reaching definitions.
+   */
+  ConstantEnvironment get_entry_state_at(cfg::Block* block) const;
+
+  ConstantEnvironment get_exit_state_at(cfg::Block* block) const;
+
+  ConstantEnvironment analyze_edge(
+      const cfg::Edge* edge,
+      const ConstantEnvironment& exit_state_at_source) const {
+    return intraprocedural::analyze_edge(edge, exit_state_at_source);
+  }
+
+  void analyze_instruction(const IRInstruction* insn,
+                           ConstantEnvironment* current_state,
+                           bool is_last) const;
+
+  /*
+   * The value that :insn writes to its destination register, or bottom if it
+   * is never executed.
+   */
+  ConstantValue get_value(const IRInstruction* insn) const;
+
+  bool is_executable(cfg::Block* block) const {
+    return m_executable.count(block) != 0;
+  }
+
+ private:
+  struct Definition {
+    cfg::Block* block{nullptr};
+    // The definitions reaching each source register; top when some of them
+    // are unknown.
+    std::vector<reaching_defs::Domain> src_defs;
+    // The instruction whose result a move-result reads.
+    const IRInstruction* primary{nullptr};
+    // Whether the instruction ends its block, so that the feasibility of the
+    // outgoing edges depends on its sources.
+    bool is_last{false};
+    ConstantValue value{ConstantValue::bottom()};
+    // The instructions whose results, or outgoing edges, depend on this one.
+    std::vector<const IRInstruction*> uses;
+  };
+
+  ConstantValue join_definitions(const reaching_defs::Domain& defs) const;
+
+  bool bind_sources(const IRInstruction* insn,
+                    const Definition& def,
+                    ConstantEnvironment* env) const;
+
+  ConstantValue evaluate(const IRInstruction* insn,
+                         const Definition& def) const;
+
+  void update_value(const IRInstruction* insn);
+
+  void visit_edges(cfg::Block* block);
+
+  void mark_executable(cfg::Block* block);
+
+  const cfg::ControlFlowGraph& m_cfg;
+  InstructionAnalyzer<ConstantEnvironment> m_insn_analyzer;
+  std::unique_ptr<reaching_defs::FixpointIterator> m_reaching_defs;
+  std::unordered_map<const IRInstruction*, Definition> m_defs;
+  std::unordered_set<cfg::Block*> m_executable;
+  std::vector<cfg::Block*> m_block_worklist;
+  std::vector<const IRInstruction*> m_insn_worklist;
+  ConstantEnvironment m_init_env;
+};
+
+} // namespace intraprocedural
+
+} // namespace constant_propagation
@@ -8,20 +8,11 @@
 #include "AliasedRegisters.h"
 
 #include <algorithm>
-#ifdef __GNUC__
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wshadow"
-#endif
-#include <boost/graph/adjacency_list.hpp>
-#ifdef __GNUC__
-#pragma GCC diagnostic pop
-#endif
+#include <boost/functional/hash.hpp>
 #include <boost/optional.hpp>
-#include <boost/range/algorithm.hpp>
-#include <boost/range/iterator_range.hpp>
 #include <limits>
-#include <numeric>
-#include <unordered_set>
+#include <map>
+#include <sstream>
 
 using namespace sparta;
 
@@ -34,41 +25,28 @@ using namespace sparta;
 //   move v2, v0
 //   move v1, v2 ; delete this instruction because v1 and v2 are already aliased
 //
-// AliasedRegisters uses a graph to keep track of these alias relationships,
-// where nodes are Values. The graph is a forest of trees, where each tree is an
-// "alias group", meaning that all Values in the group (tree) are aliased to
-// each other. Creating groups like this implements the transitive nature of the
-// aliasing relationship.
+// The aliasing relation is an equivalence relation. An alias group is an
+// equivalence class of this relation. We store the alias groups explicitly as
+// a partition of the Values that are aliased with at least one other Value:
+// every such Value maps to the index of its group, and every group lists its
+// members. Values that are not members are singletons, only aliased to
+// themselves.
 //
 // This is similar in concept to union/find. But it also needs to support
 // deleting an element and intersecting two data structures, which is why we
-// have a custom implementation.
-//
-// The implementation is similar to a link/cut tree, but these trees only have
-// two levels (every node is either a root or a leaf). The reason for the two
-// level design is because we are not actually supporting the "cut" part of the
-// link/cut tree. After two groups A and B get unioned, if one of the elements
-// of B gets overwritten, we only want to remove that single element from the
-// group instead of splitting off all the elements that were formerly in B. So
-// it's more of a link/delete tree.
+// have a custom implementation. Unioning two groups never happens, since a
+// `move` only ever adds a single Value to a group, so the direct mapping gives
+// us constant time lookups without any path compression:
+//   move       : expected constant time
+//   break_alias: linear in the size of the group that loses a member
+//   join       : linear in the number of members of both sides
 //
-// A single group could be represented as multiple different trees (by choosing
-// different roots), but this is undesirable. To enforce canonical trees, we use
-// `Value::operator<` to ensure that the minimum node is always the root node.
-// This incurs the cost of changing the root node more frequently, but it's
-// worth it over all, especially when computing the intersection of two graphs.
-//
-// The aliasing relation is an equivalence relation. An alias group is an
-// equivalence class of this relation.
-//   Reflexive : A node is trivially equivalent to itself
-//   Symmetric : If two nodes have the same root, they must be in the same tree
-//   Transitive: `AliasedRegisters::move` adds an edge from the new node the
-//               root of the tree
+// Each member also has an age, which tells us the order in which the registers
+// of a group were added to it. Ages come from a single counter, so they are
+// only meaningful relative to the other members of the same group.
 
 namespace aliased_registers {
 
-using vertex_t = AliasedRegisters::vertex_t;
-
 // Move `moving` into the alias group of `group`
 void AliasedRegisters::move(const Value& moving, const Value& group) {
   always_assert_log(!moving.is_none() && !group.is_none(),
@@ -76,172 +54,71 @@ void AliasedRegisters::move(const Value& moving, const Value& group) {
                     moving.str().c_str(),
                     group.str().c_str());
   // Only need to do something if they're not already in same group
-  if (!are_aliases(moving, group)) {
-    // remove from the old group
-    break_alias(moving);
-    vertex_t v_moving = find_or_create(moving);
-    vertex_t v_group = find_or_create(group);
-
-    const auto& grp = vertices_in_group(v_group);
-    track_insert_order(moving, v_moving, group, v_group, grp);
-
-    // Add an edge from `moving` to the root of its new group
-    // This maintains a maximum of 2 levels in the tree.
-    // Therefore, root nodes are the only nodes with incoming edges.
-    vertex_t v_group_root = find_root(v_group);
-    boost::add_edge(v_moving, v_group_root, m_graph);
-
-    // We want to have a single canonical representation of a tree. Make sure
-    // the root is always the node that sorts lowest of the Values in this tree
-    const Value& group_root = m_graph[v_group_root];
-    if (moving < group_root) {
-      change_root_to(v_group_root, v_moving);
-    }
+  if (are_aliases(moving, group)) {
+    return;
   }
+  // remove from the old group
+  break_alias(moving);
+
+  size_t group_index;
+  auto it = m_members.find(group);
+  if (it == m_members.end()) {
+    // We're creating a new group from a singleton. The `group` Value is the
+    // oldest, followed by `moving`.
+    group_index = create_group();
+    add_member(group_index, group);
+  } else {
+    group_index = it->second.group;
+  }
+  // `moving` is the newest member of the group so it gets the highest age
+  add_member(group_index, moving);
 }
 
-// Set the insertion number of `v_moving` to 1 + the max of `group`.
-// `v_moving` is the newest member of `group` so it should have the highest
-// insertion number.
-//
-// If this call creates a new group (of size two), also set the insertion
-// number of `v_group`
-void AliasedRegisters::track_insert_order(const Value& moving,
-                                          vertex_t v_moving,
-                                          const Value& group,
-                                          vertex_t v_group,
-                                          const std::vector<vertex_t>& grp) {
-  always_assert(!grp.empty());
-  if (grp.size() == 1 && group.is_register()) {
-    // We're creating a new group from a singleton. The `group`
-    // register is the oldest, followed by `moving`.
-    m_insert_order.emplace(v_group, 0);
+size_t AliasedRegisters::create_group() {
+  if (m_free_groups.empty()) {
+    m_groups.emplace_back();
+    return m_groups.size() - 1;
   }
+  size_t group = m_free_groups.back();
+  m_free_groups.pop_back();
+  return group;
+}
 
-  if (moving.is_register()) {
-    size_t moving_index =
-        1 + std::accumulate(
-                grp.begin(), grp.end(), 0, [this](size_t acc, vertex_t v) {
-                  // use operator[] to ignore non-register group members
-                  return std::max(acc, m_insert_order[v]);
-                });
-    m_insert_order.emplace(v_moving, moving_index);
-  }
+void AliasedRegisters::add_member(size_t group, const Value& value) {
+  m_members.emplace(value, Member{group, m_next_age++});
+  m_groups[group].push_back(value);
 }
 
 // Remove `r` from its alias group
 void AliasedRegisters::break_alias(const Value& r) {
-  const auto& v = find(r);
-  if (v) {
-    // if `v` was the root of a tree, we need to promote a leaf
-    maybe_change_root(*v);
-
-    // clear removes all edges to and from `r`
-    boost::clear_vertex(*v, m_graph);
-
-    if (r.is_register()) {
-      // `v` is not in a group any more so it has no insert order
-      clear_insert_number(*v);
-    }
+  auto it = m_members.find(r);
+  if (it == m_members.end()) {
+    return;
+  }
+  size_t group = it->second.group;
+  m_members.erase(it);
+
+  auto& values = m_groups[group];
+  values.erase(std::find(values.begin(), values.end(), r));
+  if (values.size() == 1) {
+    // The last remaining Value is not aliased to anything anymore
+    m_members.erase(values.front());
+    values.clear();
+    m_free_groups.push_back(group);
   }
 }
 
-// Call this when `v` should no longer have an insertion number (because it does
-// not belong to a group).
-void AliasedRegisters::clear_insert_number(vertex_t v) {
-  m_insert_order.erase(v);
-}
-
-// Two Values are aliased when they are in the same tree
+// Two Values are aliased when they are in the same group
 bool AliasedRegisters::are_aliases(const Value& r1, const Value& r2) const {
   if (r1 == r2) {
     return true;
   }
-  const auto& v1 = find(r1);
-  return v1 != boost::none && find_in_tree(r2, *v1) != boost::none;
-}
-
-// Two vertices are aliased when they have the same root
-bool AliasedRegisters::vertices_are_aliases(vertex_t v1, vertex_t v2) const {
-  return v1 == v2 || find_root(v1) == find_root(v2);
-}
-
-// Return the vertex of the root node of the tree that `v` belongs to
-// If `v` is not part of a group, then it is a singleton and it is its own root
-// node.
-vertex_t AliasedRegisters::find_root(vertex_t v) const {
-  // The trees only have two levels. No need to loop
-  const auto& adj = boost::adjacent_vertices(v, m_graph);
-  const auto& begin = adj.first;
-  const auto& end = adj.second;
-  if (begin == end) {
-    // `v` is its own root
-    return v;
-  }
-  always_assert_log(std::next(begin) == end,
-                    "a tree can't have more than one root");
-  return *begin;
-}
-
-// If `old_root` is a root node, promote a different node from this tree to the
-// root.
-void AliasedRegisters::change_root_helper(
-    vertex_t old_root, boost::optional<vertex_t> maybe_new_root) {
-  const auto& in_adj = boost::inv_adjacent_vertices(old_root, m_graph);
-  const auto& in_begin = in_adj.first;
-  const auto& in_end = in_adj.second;
-  if (in_begin != in_end) {
-    always_assert_log(
-        !has_outgoing(old_root), "Only 2 levels allowed\n%s", dump().c_str());
-    vertex_t new_root = (maybe_new_root == boost::none)
-                            ? find_new_root(old_root)
-                            : *maybe_new_root;
-    if (new_root != old_root) {
-      always_assert_log(
-          !has_incoming(new_root), "Only 2 levels allowed\n%s", dump().c_str());
-      std::vector<vertex_t> leaves;
-      leaves.reserve((in_end - in_begin) - 1);
-      for (auto it = in_begin; it != in_end; ++it) {
-        if (*it != new_root) {
-          leaves.push_back(*it);
-        }
-      }
-      // For all nodes in the tree that aren't the new or old root,
-      // redirect their outgoing edges to the new root
-      for (vertex_t leaf : leaves) {
-        boost::remove_edge(leaf, old_root, m_graph);
-        boost::add_edge(leaf, new_root, m_graph);
-      }
-      // reverse the edge between the old root and the new root
-      boost::remove_edge(new_root, old_root, m_graph);
-      boost::add_edge(old_root, new_root, m_graph);
-    }
+  auto it1 = m_members.find(r1);
+  if (it1 == m_members.end()) {
+    return false;
   }
-}
-
-// If `old_root` is a root, promote one of its leaves to the root.
-// Otherwise, do nothing.
-void AliasedRegisters::maybe_change_root(vertex_t old_root) {
-  change_root_helper(old_root, boost::none);
-}
-
-// Promote `new_root` to a root and demote `old_root` to a leaf
-void AliasedRegisters::change_root_to(vertex_t old_root, vertex_t new_root) {
-  always_assert(old_root != new_root);
-  always_assert(has_incoming(old_root));
-  change_root_helper(old_root, new_root);
-}
-
-// We want to have a single canonical representation of a tree. the new root is
-// the node that sorts lowest of the leaves in this tree
-vertex_t AliasedRegisters::find_new_root(vertex_t old_root) const {
-  const auto& in_adj = boost::inv_adjacent_vertices(old_root, m_graph);
-  const auto& in_begin = in_adj.first;
-  const auto& in_end = in_adj.second;
-  always_assert_log(in_begin != in_end, "%s", dump().c_str());
-  return *boost::range::min_element(in_adj, [this](vertex_t v1, vertex_t v2) {
-    return m_graph[v1] < m_graph[v2];
-  });
+  auto it2 = m_members.find(r2);
+  return it2 != m_members.end() && it1->second.group == it2->second.group;
 }
 
 // Return a representative for this register.
@@ -263,165 +140,72 @@ reg_t AliasedRegisters::get_representative(
     const Value& orig, const boost::optional<reg_t>& max_addressable) const {
   always_assert(orig.is_register());
 
-  // if orig is not in the graph, then it has no representative
-  const auto& v = find(orig);
-  if (!v) {
-    return orig.reg();
-  }
-
-  // intentionally copy the vector so we can safely remove from it
-  std::vector<vertex_t> group = vertices_in_group(*v);
-  // filter out non registers and other ineligible registers
-  group.erase(std::remove_if(group.begin(),
-                             group.end(),
-                             [this, &max_addressable](vertex_t elem) {
-                               // return true to remove it
-                               const Value& val = m_graph[elem];
-                               if (!val.is_register()) {
-                                 return true;
-                               }
-                               return max_addressable &&
-                                      val.reg() > *max_addressable;
-                             }),
-              group.end());
-
-  if (group.empty()) {
+  // if orig is not in a group, then it has no representative
+  auto it = m_members.find(orig);
+  if (it == m_members.end()) {
     return orig.reg();
   }
 
-  // We want the oldest element. It has the lowest insertion number
-  const Value& representative = m_graph[*std::min_element(
-      group.begin(), group.end(), [this](vertex_t a, vertex_t b) {
-        return m_insert_order.at(a) < m_insert_order.at(b);
-      })];
-  return representative.reg();
-}
-
-// if `r` is in the graph, return the vertex holding it.
-// if not, return boost::none.
-// WARNING: this operation is expensive on large graphs. It's an O(n) search of
-// all the nodes.
-boost::optional<vertex_t> AliasedRegisters::find(const Value& r) const {
-  const auto& iters = boost::vertices(m_graph);
-  const auto& begin = iters.first;
-  const auto& end = iters.second;
-  for (auto it = begin; it != end; ++it) {
-    if (m_graph[*it] == r) {
-      return *it;
+  // We want the oldest eligible register. It has the lowest age
+  const Value* representative = nullptr;
+  size_t oldest = std::numeric_limits<size_t>::max();
+  for (const auto& value : m_groups[it->second.group]) {
+    if (!value.is_register() ||
+        (max_addressable && value.reg() > *max_addressable)) {
+      continue;
     }
-  }
-  return boost::none;
-}
-
-// If any nodes in the same tree as `in_this_tree` have the Value `r`, then
-// return `r`'s vertex.
-// This is a faster alternative to a `find()` over the entire graph
-boost::optional<vertex_t> AliasedRegisters::find_in_tree(
-    const Value& r, vertex_t in_this_tree) const {
-  vertex_t root = find_root(in_this_tree);
-  if (m_graph[root] == r) {
-    return root;
-  }
-  const auto& adj = boost::inv_adjacent_vertices(root, m_graph);
-  const auto& begin = adj.first;
-  const auto& end = adj.second;
-  for (auto it = begin; it != end; ++it) {
-    if (m_graph[*it] == r) {
-      return *it;
+    size_t age = m_members.at(value).age;
+    if (age < oldest) {
+      oldest = age;
+      representative = &value;
     }
   }
-  return boost::none;
-}
-
-// returns the vertex holding `r` or creates a new (unconnected)
-// vertex if `r` is not in m_graph
-vertex_t AliasedRegisters::find_or_create(const Value& r) {
-  const auto& it = find(r);
-  if (it) {
-    return *it;
-  } else {
-    vertex_t v = boost::add_vertex(r, m_graph);
-    return v;
-  }
-}
-
-// return a vector of `v` and all the vertices in the same tree
-// (with the root first)
-std::vector<vertex_t> AliasedRegisters::vertices_in_group(
-    vertex_t input) const {
-  vertex_t root = find_root(input);
-  const auto& in_adj = boost::inv_adjacent_vertices(root, m_graph);
-  const auto& in_begin = in_adj.first;
-  const auto& in_end = in_adj.second;
-  std::vector<vertex_t> result;
-  result.reserve(1 + (in_end - in_begin));
-  result.push_back(root);
-  for (auto it = in_begin; it != in_end; ++it) {
-    result.push_back(*it);
-  }
-  return result;
-}
-
-// return true if `v` has no neighbors
-bool AliasedRegisters::is_singleton(vertex_t v) {
-  return !has_outgoing(v) && !has_incoming(v);
-}
-
-// return true if `v` has any incoming edges (equivalent to v being a root of a
-// non-singleton tree)
-bool AliasedRegisters::has_incoming(vertex_t v) {
-  const auto& in_adj = boost::inv_adjacent_vertices(v, m_graph);
-  const auto& in_begin = in_adj.first;
-  const auto& in_end = in_adj.second;
-  return in_begin != in_end;
-}
-
-// return true if `v` has any outgoing edges (equivalent to v being a leaf)
-bool AliasedRegisters::has_outgoing(vertex_t v) {
-  const auto& out_adj = boost::adjacent_vertices(v, m_graph);
-  const auto& out_begin = out_adj.first;
-  const auto& out_end = out_adj.second;
-  return out_begin != out_end;
+  return representative == nullptr ? orig.reg() : representative->reg();
 }
 
 // ---- extends AbstractValue ----
 
 void AliasedRegisters::clear() {
-  m_graph.clear();
-  m_insert_order.clear();
+  m_members.clear();
+  m_groups.clear();
+  m_free_groups.clear();
+  m_next_age = 0;
 }
 
 AbstractValueKind AliasedRegisters::kind() const {
-  return (boost::num_edges(m_graph) > 0) ? AbstractValueKind::Value
-                                         : AbstractValueKind::Top;
+  return m_members.empty() ? AbstractValueKind::Top : AbstractValueKind::Value;
 }
 
 // leq (<=) is the superset relation on the alias groups
 bool AliasedRegisters::leq(const AliasedRegisters& other) const {
-  if (boost::num_edges(m_graph) < boost::num_edges(other.m_graph)) {
+  if (num_edges() < other.num_edges()) {
     // this cannot be a superset of other if this has fewer edges
     return false;
   }
 
-  // for all edges in `other` (the potential subset), make sure `this` has that
-  // alias relationship
-  const auto& iters = boost::edges(other.m_graph);
-  const auto& begin = iters.first;
-  const auto& end = iters.second;
-  for (auto it = begin; it != end; ++it) {
-    const Value& r1 = other.m_graph[boost::source(*it, other.m_graph)];
-    const Value& r2 = other.m_graph[boost::target(*it, other.m_graph)];
-    if (!are_aliases(r1, r2)) {
+  // for all groups in `other` (the potential subset), make sure `this` has
+  // all of their members in a single group
+  for (const auto& values : other.m_groups) {
+    if (values.empty()) {
+      continue;
+    }
+    auto first = m_members.find(values.front());
+    if (first == m_members.end()) {
       return false;
     }
+    for (size_t i = 1; i < values.size(); ++i) {
+      auto it = m_members.find(values[i]);
+      if (it == m_members.end() || it->second.group != first->second.group) {
+        return false;
+      }
+    }
   }
   return true;
 }
 
-// returns true iff they have exactly the same edges between the same Values
+// returns true iff they have exactly the same alias groups
 bool AliasedRegisters::equals(const AliasedRegisters& other) const {
-  return boost::num_edges(m_graph) == boost::num_edges(other.m_graph) &&
-         leq(other);
+  return num_edges() == other.num_edges() && leq(other);
 }
 
 AbstractValueKind AliasedRegisters::narrow_with(const AliasedRegisters& other) {
@@ -439,195 +223,86 @@ AbstractValueKind AliasedRegisters::meet_with(const AliasedRegisters& other) {
 
 // Alias group intersection.
 // Only keep the alias relationships that both `this` and `other` contain.
+//
+// The registers of each new group are reordered by merging the ages of both
+// sides: when `this` and `other` agree on the order of two registers, we
+// preserve it, otherwise we order them by register number.
 AbstractValueKind AliasedRegisters::join_with(const AliasedRegisters& other) {
-  auto this_before_groups = this->all_groups();
-
-  // Remove all edges from this graph. We will add back the ones that `other`
-  // also has
-  using edge_t = boost::graph_traits<Graph>::edge_descriptor;
-  boost::remove_edge_if([](const edge_t&) { return true; }, m_graph);
-
-  // Break up each group into some number of new groups.
-  // Intersection can't create any groups larger than what `this` had, only the
-  // same size or smaller.
-  for (auto& group : this_before_groups) {
-    // Sort so that we only have to scan the nodes after the potential root
-    // (remember that the root node must sort lowest of its tree)
-    std::sort(group.begin(), group.end(), [this](vertex_t v1, vertex_t v2) {
-      return m_graph[v1] < m_graph[v2];
-    });
-    // Starting with the lowest node, grab all the singletons that `other`
-    // agrees are aliased with this potential root.
-    // Repeat with the next potential root.
-    size_t sz = group.size();
-    for (size_t i = 0; i < sz; ++i) {
-      vertex_t new_root = group[i];
-      if (has_outgoing(new_root)) {
-        // This can't be a new root because it's already a leaf
+  AliasedRegisters result;
+  result.m_members.reserve(std::min(m_members.size(), other.m_members.size()));
+  result.m_next_age = m_next_age;
+
+  auto merged_less = [this, &other](const Value& a, const Value& b) {
+    bool this_less_than = m_members.at(a).age < m_members.at(b).age;
+    bool other_less_than =
+        other.m_members.at(a).age < other.m_members.at(b).age;
+    if (this_less_than == other_less_than) {
+      return this_less_than;
+    }
+    return a.reg() < b.reg();
+  };
+
+  // Break up each group into some number of new groups, one for each group of
+  // `other` that it shares at least two Values with. Intersection can't create
+  // any groups larger than what `this` had, only the same size or smaller.
+  for (const auto& values : m_groups) {
+    std::map<size_t, std::vector<Value>> parts;
+    for (const auto& value : values) {
+      auto it = other.m_members.find(value);
+      if (it != other.m_members.end()) {
+        parts[it->second.group].push_back(value);
+      }
+    }
+    for (auto& entry : parts) {
+      auto& part = entry.second;
+      if (part.size() < 2) {
         continue;
       }
-      // We can start iterating from i + 1 because everything beneath `i` has
-      // already been considered as a potential root and had all possible nodes
-      // added to its tree.
-      for (size_t j = i + 1; j < sz; ++j) {
-        // If `v` hasn't already been added to another tree and `other` agrees,
-        // then add the edge.
-        vertex_t v = group[j];
-        if (!has_outgoing(v) &&
-            other.are_aliases(this->m_graph[v], this->m_graph[new_root])) {
-          boost::add_edge(v, new_root, m_graph);
-        }
+      // Registers sort lowest of all Values. Only their relative order
+      // matters, non-registers just get the ages after them.
+      std::sort(part.begin(), part.end());
+      auto registers_end =
+          std::find_if(part.begin(), part.end(),
+                       [](const Value& value) { return !value.is_register(); });
+      std::sort(part.begin(), registers_end, merged_less);
+
+      size_t group = result.create_group();
+      result.m_groups[group].reserve(part.size());
+      for (const auto& value : part) {
+        result.add_member(group, value);
       }
     }
   }
 
-  handle_edge_intersection_insert_order(other);
+  *this = std::move(result);
   return AbstractValueKind::Value;
 }
 
-void AliasedRegisters::handle_edge_intersection_insert_order(
-    const AliasedRegisters& other) {
-  // Clear out stale values in `m_insert_order` for vertices removed from
-  // groups.
-  const auto& iters = boost::vertices(this->m_graph);
-  const auto& begin = iters.first;
-  const auto& end = iters.second;
-  for (auto it = begin; it != end; ++it) {
-    if (is_singleton(*it)) {
-      clear_insert_number(*it);
-    }
-  }
-
-  // Assign new insertion numbers while taking into account both insertion maps.
-  for (auto& group : all_groups()) {
-    handle_insert_order_at_merge(group, other);
-  }
-}
-
-// Merge the ordering in `other.m_insert_order` into `this->m_insert_order`.
-//
-// When both graphs know about an edge (and they don't agree about insertion
-// order), use register number.
-// When only one graph knows about an edge, use insertion order from that graph.
-// When neither graph knows about the edge, use register number.
-void AliasedRegisters::handle_insert_order_at_merge(
-    const std::vector<vertex_t>& group, const AliasedRegisters& other) {
-  renumber_insert_order(group, [this, &other](vertex_t a, vertex_t b) {
-    // return true if `a` occurs before `b`.
-    // return false if they compare equal or if `b` occurs before `a`.
-
-    if (a == b) return false;
-    // `a` and `b` only index into this, not other.
-    const Value& val_a = this->m_graph[a];
-    const Value& val_b = this->m_graph[b];
-
-    bool this_has = this->vertices_are_aliases(a, b);
-    boost::optional<vertex_t> other_a = other.find(val_a);
-    boost::optional<vertex_t> other_b =
-        (other_a == boost::none ? boost::none
-                                : other.find_in_tree(val_b, *other_a));
-    bool other_has = other_b != boost::none;
-
-    if (this_has && other_has) {
-      // Intersection case should always come here
-      bool this_less_than =
-          this->m_insert_order.at(a) < this->m_insert_order.at(b);
-
-      bool other_less_than =
-          other.m_insert_order.at(*other_a) < other.m_insert_order.at(*other_b);
-
-      if (this_less_than == other_less_than) {
-        // The graphs agree on the order of these two vertices.
-        // Preserve that order.
-        return this_less_than;
-      } else {
-        // The graphs do not agree. Choose a deterministic order
-        return val_a.reg() < val_b.reg();
-      }
-    } else if (this_has) {
-      return this->m_insert_order.at(a) < this->m_insert_order.at(b);
-    } else if (other_has) {
-      return other.m_insert_order.at(*other_a) <
-             other.m_insert_order.at(*other_b);
-    } else {
-      // Neither graph has this relationship. Choose a deterministic order
-      return val_a.reg() < val_b.reg();
-    }
-  });
-}
-
-// Rewrite the insertion number of all registers in `group` in an order defined
-// by `less_than`
-void AliasedRegisters::renumber_insert_order(
-    std::vector<vertex_t> group,
-    const std::function<bool(vertex_t, vertex_t)>& less_than) {
-
-  // Filter out non registers.
-  group.erase(
-      std::remove_if(group.begin(),
-                     group.end(),
-                     [this](vertex_t v) { return !m_graph[v].is_register(); }),
-      group.end());
-
-  if (group.size() < 2) {
-    // No need to assign insert order for singletons
-    return;
-  }
-
-  // Assign new insertion numbers based on sorting.
-  std::sort(group.begin(), group.end(), less_than);
-  size_t i = 0;
-  for (vertex_t v : group) {
-    this->m_insert_order[v] = i;
-    ++i;
-  }
-}
-
-// return all groups (not including singletons)
-std::vector<std::vector<vertex_t>> AliasedRegisters::all_groups() {
-  std::vector<std::vector<vertex_t>> result;
-  std::unordered_set<vertex_t> visited;
-
-  const auto& iters = boost::vertices(this->m_graph);
-  const auto& begin = iters.first;
-  const auto& end = iters.second;
-  for (auto it = begin; it != end; ++it) {
-    vertex_t root = find_root(*it);
-    const auto& pair = visited.insert(root);
-    bool insertion_took_place = pair.second;
-    if (insertion_took_place) {
-      auto group = vertices_in_group(root);
-      if (group.size() > 1) {
-        result.emplace_back(std::move(group));
-      }
-    }
-  }
-  return result;
-}
-
-// returns a string representation of this data structure. Intended for
-// debugging.
-std::string AliasedRegisters::dump() const {
-  std::ostringstream oss;
-  const auto& iters = boost::edges(this->m_graph);
-  const auto& begin = iters.first;
-  const auto& end = iters.second;
-  oss << "Graph [" << std::endl;
-  for (auto it = begin; it != end; ++it) {
-    const Value& r1 = m_graph[boost::source(*it, m_graph)];
-    const Value& r2 = m_graph[boost::target(*it, m_graph)];
-    oss << "(" << r1.str().c_str() << " -> " << r2.str().c_str() << ") "
-        << std::endl;
-  }
-  oss << "] insert order [" << std::endl;
-  for (const auto& entry : m_insert_order) {
-    vertex_t v = entry.first;
-    const Value& r = m_graph[v];
-    size_t i = entry.second;
-    oss << r.str().c_str() << " has index " << i << std::endl;
+size_t Value::hash() const {
+  size_t seed = static_cast<size_t>(m_kind);
+  switch (m_kind) {
+  case Kind::REGISTER:
+    boost::hash_combine(seed, m_reg);
+    break;
+  case Kind::CONST_LITERAL:
+  case Kind::CONST_LITERAL_UPPER:
+    boost::hash_combine(seed, m_literal);
+    boost::hash_combine(seed, static_cast<size_t>(m_type_demand));
+    break;
+  case Kind::CONST_STRING:
+    boost::hash_combine(seed, m_str);
+    break;
+  case Kind::CONST_TYPE:
+    boost::hash_combine(seed, m_type);
+    break;
+  case Kind::STATIC_FINAL:
+  case Kind::STATIC_FINAL_UPPER:
+    boost::hash_combine(seed, m_field);
+    break;
+  case Kind::NONE:
+    break;
   }
-  oss << "]" << std::endl;
-  return oss.str();
+  return seed;
 }
 
 bool Value::operator==(const Value& other) const {
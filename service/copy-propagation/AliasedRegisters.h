@@ -7,17 +7,10 @@
 
 #pragma once
 
-#ifdef __GNUC__
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wshadow"
-#endif
-#include <boost/graph/adjacency_list.hpp>
-#ifdef __GNUC__
-#pragma GCC diagnostic pop
-#endif
 #include <boost/optional.hpp>
-#include <boost/range/iterator_range.hpp>
 #include <limits>
+#include <unordered_map>
+#include <vector>
 
 #include "AbstractDomain.h"
 #include "ConstantUses.h"
@@ -104,6 +97,8 @@ class Value {
 
   bool operator!=(const Value& other) const { return !(*this == other); }
 
+  size_t hash() const;
+
   static const Value& none() {
     static const Value s_none;
     return s_none;
@@ -119,6 +114,10 @@ class Value {
   }
 };
 
+struct ValueHash {
+  size_t operator()(const Value& value) const { return value.hash(); }
+};
+
 class AliasedRegisters final : public sparta::AbstractValue<AliasedRegisters> {
  public:
   AliasedRegisters() {}
@@ -158,71 +157,29 @@ class AliasedRegisters final : public sparta::AbstractValue<AliasedRegisters> {
   sparta::AbstractValueKind narrow_with(const AliasedRegisters& other) override;
 
  private:
-  // A directed graph where register Values are vertices
-  using Graph =
-      boost::adjacency_list<boost::vecS, // out edge container
-                            boost::vecS, // vertex container
-                            boost::bidirectionalS, // directed graph with access
-                                                   // to both incoming and
-                                                   // outgoing edges
-                            Value>; // node property
-  Graph m_graph;
+  // Every Value that is aliased with at least one other Value is a member of
+  // an alias group. Members also have an age, which is increasing in the order
+  // in which they joined their group, so that we can choose the oldest
+  // register as the representative of a group.
+  struct Member {
+    size_t group;
+    size_t age;
+  };
+  std::unordered_map<Value, Member, ValueHash> m_members;
 
- public:
-  using vertex_t = boost::graph_traits<Graph>::vertex_descriptor;
+  // The members of each alias group, indexed by group. Groups always have at
+  // least two members, or none if their index is free to be reused.
+  std::vector<std::vector<Value>> m_groups;
+  std::vector<size_t> m_free_groups;
+  size_t m_next_age{0};
 
- private:
-  // For keeping track of the oldest representative.
-  //
-  // When adding a vertex to a group, it gets 1 + the max insertion number of
-  // the group. When choosing a representative, we prefer lower insertion
-  // numbers. Vertices in a group are guaranteed to have an entry in this map.
-  // Do not query this map if the vertex is not in a group.
-  //
-  // We only track the insertion for registers because they're the only type
-  // that could be chosen as a representative.
-  using InsertionOrder = std::unordered_map<vertex_t, size_t>;
-  InsertionOrder m_insert_order;
-
-  boost::optional<vertex_t> find(const Value& r) const;
-  boost::optional<vertex_t> find_in_tree(const Value& r,
-                                         vertex_t in_this_tree) const;
-  vertex_t find_or_create(const Value& r);
-  vertex_t find_root(vertex_t v) const;
-  vertex_t find_new_root(vertex_t old_root) const;
-
-  void change_root_helper(vertex_t old_root,
-                          boost::optional<vertex_t> maybe_new_root);
-  void maybe_change_root(vertex_t old_root);
-  void change_root_to(vertex_t old_root, vertex_t new_root);
-
-  bool has_edge_between(const Value& r1, const Value& r2) const;
-  bool vertices_are_aliases(vertex_t v1, vertex_t v2) const;
-
-  // return a vector of all vertices in v's alias group (including v itself)
-  std::vector<vertex_t> vertices_in_group(vertex_t v) const;
-
-  // return all groups (not including singletons)
-  std::vector<std::vector<vertex_t>> all_groups();
-
-  void track_insert_order(const Value& moving,
-                          vertex_t v_moving,
-                          const Value& group,
-                          vertex_t v_group,
-                          const std::vector<vertex_t>& grp);
-  void clear_insert_number(vertex_t v);
-  void handle_edge_intersection_insert_order(const AliasedRegisters& other);
-  void handle_insert_order_at_merge(const std::vector<vertex_t>& group,
-                                    const AliasedRegisters& other);
-  void renumber_insert_order(
-      std::vector<vertex_t> group,
-      const std::function<bool(vertex_t, vertex_t)>& less_than);
-
-  bool is_singleton(vertex_t v);
-  bool has_incoming(vertex_t v);
-  bool has_outgoing(vertex_t v);
-
-  std::string dump() const;
+  size_t create_group();
+  void add_member(size_t group, const Value& value);
+
+  // The number of edges in a forest with one tree per alias group.
+  size_t num_edges() const {
+    return m_members.size() - (m_groups.size() - m_free_groups.size());
+  }
 };
 
 class AliasDomain final
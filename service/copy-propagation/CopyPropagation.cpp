@@ -486,6 +486,8 @@ Stats CopyPropagation::run(IRCode* code, DexMethod* method) {
   }
 
   mutation.flush();
+  // run_on_block() rewrote some sources in place.
+  cfg->code_changed();
   return stats;
 }
 
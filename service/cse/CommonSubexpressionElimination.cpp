@@ -47,10 +47,14 @@
  *   register as it was *before* the instruction). This recovers the tracking
  *   of merged or havoced registers, in a way that's similar to phi-nodes, but
  *   lazy.
+ * - Methods in which no two instructions could possibly compute the same value
+ *   are not analyzed at all, and single-block methods without relevant memory
+ *   barriers are handled by a cheaper local value numbering.
  */
 
 #include "CommonSubexpressionElimination.h"
 
+#include <boost/functional/hash.hpp>
 #include <utility>
 
 #include "BaseIRAnalyzer.h"
@@ -61,6 +65,7 @@
 #include "IRInstruction.h"
 #include "PatriciaTreeMapAbstractEnvironment.h"
 #include "PatriciaTreeSetAbstractDomain.h"
+#include "RedexContext.h"
 #include "ReducedProductAbstractDomain.h"
 #include "Resolver.h"
 #include "TypeInference.h"
@@ -764,14 +769,338 @@ class Analyzer final : public BaseIRAnalyzer<CseEnvironment> {
       m_positional_insns;
 };
 
+// Numbers values, i.e. tuples of an opcode, the value numbers of its sources
+// and a literal or reference payload, consecutively from 0. Values are kept in
+// a flat open-addressing hash table, and all sources in one array, which makes
+// this much cheaper than the value id map of the Analyzer.
+class ValueNumberTable final {
+ public:
+  using value_number_t = uint32_t;
+  static constexpr value_number_t UNKNOWN =
+      std::numeric_limits<value_number_t>::max();
+
+  // Returns a new value number that is not equal to any other one.
+  value_number_t make_unique() {
+    m_entries.push_back({IOPCODE_POSITIONAL, 0, 0, 0});
+    return m_entries.size() - 1;
+  }
+
+  value_number_t get(IROpcode opcode,
+                     const std::vector<value_number_t>& srcs,
+                     uint64_t payload) {
+    size_t hash = opcode;
+    for (auto src : srcs) {
+      boost::hash_combine(hash, src);
+    }
+    boost::hash_combine(hash, payload);
+    if ((m_num_keys + 1) * 2 > m_slots.size()) {
+      grow();
+    }
+    size_t mask = m_slots.size() - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+      auto& slot = m_slots[i];
+      if (slot.value_number == UNKNOWN) {
+        slot.hash = hash;
+        slot.value_number = m_entries.size();
+        m_entries.push_back(
+            {opcode, (uint32_t)m_srcs.size(), (uint32_t)srcs.size(), payload});
+        m_srcs.insert(m_srcs.end(), srcs.begin(), srcs.end());
+        m_num_keys++;
+        return slot.value_number;
+      }
+      if (slot.hash == hash && equals(m_entries[slot.value_number], opcode,
+                                      srcs, payload)) {
+        return slot.value_number;
+      }
+    }
+  }
+
+  size_t size() const { return m_entries.size(); }
+
+ private:
+  struct Entry {
+    IROpcode opcode;
+    uint32_t srcs_begin;
+    uint32_t srcs_size;
+    uint64_t payload;
+  };
+
+  struct Slot {
+    size_t hash;
+    value_number_t value_number{UNKNOWN};
+  };
+
+  bool equals(const Entry& entry,
+              IROpcode opcode,
+              const std::vector<value_number_t>& srcs,
+              uint64_t payload) const {
+    return entry.opcode == opcode && entry.payload == payload &&
+           entry.srcs_size == srcs.size() &&
+           std::equal(srcs.begin(), srcs.end(),
+                      m_srcs.begin() + entry.srcs_begin);
+  }
+
+  void grow() {
+    std::vector<Slot> slots(std::max<size_t>(16, m_slots.size() * 2));
+    size_t mask = slots.size() - 1;
+    for (const auto& slot : m_slots) {
+      if (slot.value_number == UNKNOWN) {
+        continue;
+      }
+      size_t i = slot.hash & mask;
+      while (slots[i].value_number != UNKNOWN) {
+        i = (i + 1) & mask;
+      }
+      slots[i] = slot;
+    }
+    m_slots = std::move(slots);
+  }
+
+  std::vector<Slot> m_slots;
+  size_t m_num_keys{0};
+  std::vector<Entry> m_entries;
+  std::vector<value_number_t> m_srcs;
+};
+
+// The literal or reference that, together with the opcode and sources,
+// identifies the value computed by an instruction, as in Analyzer::get_value.
+uint64_t get_payload(const IRInstruction* insn) {
+  if (insn->has_literal()) {
+    return insn->get_literal();
+  } else if (insn->has_type()) {
+    return reinterpret_cast<uintptr_t>(insn->get_type());
+  } else if (insn->has_field()) {
+    return reinterpret_cast<uintptr_t>(insn->get_field());
+  } else if (insn->has_method()) {
+    return reinterpret_cast<uintptr_t>(insn->get_method());
+  } else if (insn->has_string()) {
+    return reinterpret_cast<uintptr_t>(insn->get_string());
+  } else if (insn->has_data()) {
+    return reinterpret_cast<uintptr_t>(insn->get_data());
+  }
+  return 0;
+}
+
+/*
+ * Every redundancy the Analyzer can find involves two instructions that
+ * compute the same value, which in particular implies that they have the same
+ * opcode and payload, where writes to memory locations and new-array
+ * instructions count as computing the value of the corresponding reads and
+ * array-length instructions. If no two instructions agree on that, we can skip
+ * the analysis altogether.
+ */
+bool may_have_redundancies(SharedState* shared_state,
+                           cfg::ControlFlowGraph& cfg) {
+  ValueNumberTable table;
+  std::vector<bool> seen;
+  const std::vector<ValueNumberTable::value_number_t> no_srcs;
+  for (const auto& mie : cfg::InstructionIterable(cfg)) {
+    auto insn = mie.insn;
+    auto opcode = insn->opcode();
+    uint64_t payload = 0;
+    if (is_sput(opcode) || is_iput(opcode)) {
+      opcode = (IROpcode)(is_sput(opcode) ? opcode - OPCODE_SPUT + OPCODE_SGET
+                                          : opcode - OPCODE_IPUT + OPCODE_IGET);
+      payload = get_payload(insn);
+    } else if (is_aput(opcode)) {
+      opcode = (IROpcode)(opcode - OPCODE_APUT + OPCODE_AGET);
+    } else if (opcode == OPCODE_NEW_ARRAY || opcode == OPCODE_ARRAY_LENGTH) {
+      opcode = OPCODE_ARRAY_LENGTH;
+    } else if (is_invoke(opcode)) {
+      if (!shared_state->has_pure_method(insn)) {
+        continue;
+      }
+      payload = get_payload(insn);
+    } else if (is_move(opcode) || opcode::is_move_result_any(opcode) ||
+               opcode::is_load_param(opcode) ||
+               opcode == OPCODE_MOVE_EXCEPTION ||
+               opcode == OPCODE_NEW_INSTANCE ||
+               opcode == OPCODE_FILLED_NEW_ARRAY ||
+               (insn->has_dest() && is_const(opcode)) ||
+               (!insn->has_dest() && !insn->has_move_result_any())) {
+      continue;
+    } else {
+      payload = get_payload(insn);
+    }
+    auto value_number = table.get(opcode, no_srcs, payload);
+    if (value_number < seen.size()) {
+      return true;
+    }
+    seen.resize(value_number + 1);
+  }
+  return false;
+}
+
+/*
+ * Local value numbering of a method that consists of a single block. This
+ * computes the same defining instructions as the Analyzer, whose entry state
+ * would be top, but with flat tables instead of abstract environments.
+ *
+ * As long as there are no relevant memory barriers, values are determined by
+ * their structure alone, which is all that is supported here; returns false
+ * if the Analyzer needs to be used instead.
+ */
+bool number_values_locally(
+    SharedState* shared_state,
+    cfg::ControlFlowGraph& cfg,
+    std::vector<std::pair<const IRInstruction*, IRInstruction*>>* forwards,
+    size_t* value_numbers) {
+  using value_number_t = ValueNumberTable::value_number_t;
+  constexpr value_number_t UNKNOWN = ValueNumberTable::UNKNOWN;
+  auto block = cfg.entry_block();
+
+  CseUnorderedLocationSet read_locations;
+  for (const auto& mie : InstructionIterable(block)) {
+    auto insn = mie.insn;
+    auto location = get_read_location(insn);
+    if (location != CseLocation(CseSpecialLocations::GENERAL_MEMORY_BARRIER)) {
+      read_locations.insert(location);
+    } else if (is_invoke(insn->opcode()) &&
+               shared_state->has_pure_method(insn)) {
+      for (auto l :
+           shared_state->get_read_locations_of_conditionally_pure_method(
+               insn->get_method(), insn->opcode())) {
+        read_locations.insert(l);
+      }
+    }
+  }
+  for (const auto& mie : InstructionIterable(block)) {
+    if (!shared_state
+             ->get_relevant_written_locations(
+                 mie.insn, nullptr /* exact_virtual_scope */, read_locations)
+             .empty()) {
+      return false;
+    }
+  }
+
+  ValueNumberTable table;
+  std::vector<value_number_t> regs(cfg.get_registers_size(), UNKNOWN);
+  value_number_t result = UNKNOWN;
+  std::vector<const IRInstruction*> defs;
+  auto get_reg = [&](reg_t reg) -> value_number_t& {
+    if (reg >= regs.size()) {
+      regs.resize(reg + 1, UNKNOWN);
+    }
+    return regs[reg];
+  };
+  auto set_reg = [&](reg_t reg, bool wide, value_number_t value_number) {
+    get_reg(reg) = value_number;
+    if (wide) {
+      get_reg(reg + 1) = UNKNOWN;
+    }
+  };
+  auto define = [&](value_number_t value_number, const IRInstruction* insn,
+                    bool overwrite) {
+    if (value_number >= defs.size()) {
+      defs.resize(value_number + 1, nullptr);
+    }
+    if (overwrite || defs[value_number] == nullptr) {
+      defs[value_number] = insn;
+    }
+  };
+  std::vector<value_number_t> srcs;
+  auto get_value_number = [&](const IRInstruction* insn) {
+    auto opcode = insn->opcode();
+    switch (opcode) {
+    case IOPCODE_LOAD_PARAM:
+    case IOPCODE_LOAD_PARAM_OBJECT:
+    case IOPCODE_LOAD_PARAM_WIDE:
+    case OPCODE_MOVE_EXCEPTION:
+    case OPCODE_NEW_ARRAY:
+    case OPCODE_NEW_INSTANCE:
+    case OPCODE_FILLED_NEW_ARRAY:
+      return table.make_unique();
+    default:
+      if (is_invoke(opcode) && !shared_state->has_pure_method(insn)) {
+        return table.make_unique();
+      }
+      break;
+    }
+    srcs.clear();
+    for (auto reg : insn->srcs()) {
+      srcs.push_back(get_reg(reg));
+    }
+    if (opcode::is_commutative(opcode)) {
+      std::sort(srcs.begin(), srcs.end());
+    }
+    return table.get(opcode, srcs, get_payload(insn));
+  };
+
+  for (const auto& mie : InstructionIterable(block)) {
+    auto insn = mie.insn;
+    // Like the Analyzer's pre-state sources, unknown sources get fresh values.
+    for (auto reg : insn->srcs()) {
+      auto& value_number = get_reg(reg);
+      if (value_number == UNKNOWN) {
+        value_number = table.make_unique();
+      }
+    }
+    auto opcode = insn->opcode();
+    if (is_move(opcode)) {
+      set_reg(insn->dest(), insn->dest_is_wide(), get_reg(insn->src(0)));
+      continue;
+    }
+    if (insn->has_dest()) {
+      auto value_number = opcode::is_move_result_any(opcode)
+                              ? result
+                              : get_value_number(insn);
+      if (value_number != UNKNOWN) {
+        define(value_number, insn, /* overwrite */ false);
+      }
+      set_reg(insn->dest(), insn->dest_is_wide(), value_number);
+      if (value_number != UNKNOWN && !is_const(opcode) &&
+          defs[value_number] != insn) {
+        forwards->emplace_back(defs[value_number], insn);
+      }
+    } else if (insn->has_move_result_any()) {
+      result = get_value_number(insn);
+      if (opcode == OPCODE_NEW_ARRAY) {
+        define(table.get(OPCODE_ARRAY_LENGTH, {result}, 0), insn,
+               /* overwrite */ true);
+      }
+    }
+  }
+  *value_numbers = table.size();
+  return true;
+}
+
 } // namespace
 
 namespace cse_impl {
 
 ////////////////////////////////////////////////////////////////////////////////
 
-SharedState::SharedState(const std::unordered_set<DexMethodRef*>& pure_methods)
-    : m_pure_methods(pure_methods), m_safe_methods(pure_methods) {
+bool MethodBarriersCache::get(
+    const DexMethod* method,
+    size_t key,
+    boost::optional<LocationsAndDependencies>* lads) {
+  auto it = m_entries.find(method);
+  if (it == m_entries.end() || it->second.key != key) {
+    return false;
+  }
+  *lads = it->second.lads;
+  return true;
+}
+
+void MethodBarriersCache::put(
+    const DexMethod* method,
+    size_t key,
+    const boost::optional<LocationsAndDependencies>& lads) {
+  m_entries.update(method, [&](const DexMethod*, Entry& entry, bool) {
+    entry = Entry{key, lads};
+  });
+}
+
+MethodBarriersCache& shared_method_barriers_cache() {
+  static RedexContextCache<MethodBarriersCache> cache;
+  return cache.get();
+}
+
+SharedState::SharedState(const std::unordered_set<DexMethodRef*>& pure_methods,
+                         MethodBarriersCache* method_barriers_cache)
+    : m_pure_methods(pure_methods),
+      m_safe_methods(pure_methods),
+      m_method_barriers_cache(method_barriers_cache) {
   // The following methods are...
   // - static, or
   // - direct (constructors), or
@@ -905,6 +1234,50 @@ const method_override_graph::Graph* SharedState::get_method_override_graph()
 
 void SharedState::init_method_barriers(const Scope& scope) {
   Timer t("init_method_barriers");
+  // What a method may write only depends on its barriers, given the method
+  // override graph and the safe methods.
+  size_t cache_salt = std::hash<const void*>()(m_method_override_graph.get());
+  size_t safe_methods_hash = 0;
+  for (auto method : m_safe_method_defs) {
+    safe_methods_hash += std::hash<const void*>()(method);
+  }
+  boost::hash_combine(cache_salt, safe_methods_hash);
+  std::atomic<size_t> cache_hits{0};
+  auto analyze_barriers = [&](DexMethod* method,
+                              const std::vector<Barrier>& barriers)
+      -> boost::optional<LocationsAndDependencies> {
+    LocationsAndDependencies lads;
+    for (const auto& barrier : barriers) {
+      if (!is_invoke(barrier.opcode)) {
+        auto location = get_written_location(barrier);
+        if (location ==
+            CseLocation(CseSpecialLocations::GENERAL_MEMORY_BARRIER)) {
+          return boost::none;
+        }
+        lads.locations.insert(location);
+        continue;
+      }
+
+      if (barrier.opcode == OPCODE_INVOKE_SUPER) {
+        // TODO: Implement
+        return boost::none;
+      }
+
+      if (!process_base_and_overriding_methods(
+              m_method_override_graph.get(), barrier.method,
+              &m_safe_method_defs,
+              /* ignore_methods_with_assumenosideeffects */ true,
+              [&](DexMethod* other_method) {
+                if (other_method != method) {
+                  lads.dependencies.insert(other_method);
+                }
+                return true;
+              })) {
+        return boost::none;
+      }
+    }
+    return lads;
+  };
   auto iterations = compute_locations_closure(
       scope, m_method_override_graph.get(),
       [&](DexMethod* method) -> boost::optional<LocationsAndDependencies> {
@@ -914,49 +1287,35 @@ void SharedState::init_method_barriers(const Scope& scope) {
         if (action == MethodOverrideAction::UNKNOWN) {
           return boost::none;
         }
-        LocationsAndDependencies lads;
         if (action == MethodOverrideAction::EXCLUDE) {
-          return lads;
+          return LocationsAndDependencies();
         }
+        std::vector<Barrier> barriers;
+        size_t key = cache_salt;
         auto code = method->get_code();
         for (const auto& mie : cfg::InstructionIterable(code->cfg())) {
           auto* insn = mie.insn;
           if (may_be_barrier(insn, nullptr /* exact_virtual_scope */)) {
-            auto barrier = make_barrier(insn);
-            if (!is_invoke(barrier.opcode)) {
-              auto location = get_written_location(barrier);
-              if (location ==
-                  CseLocation(CseSpecialLocations::GENERAL_MEMORY_BARRIER)) {
-                return boost::none;
-              }
-              lads.locations.insert(location);
-              continue;
-            }
-
-            if (barrier.opcode == OPCODE_INVOKE_SUPER) {
-              // TODO: Implement
-              return boost::none;
-            }
-
-            if (!process_base_and_overriding_methods(
-                    m_method_override_graph.get(), barrier.method,
-                    &m_safe_method_defs,
-                    /* ignore_methods_with_assumenosideeffects */ true,
-                    [&](DexMethod* other_method) {
-                      if (other_method != method) {
-                        lads.dependencies.insert(other_method);
-                      }
-                      return true;
-                    })) {
-              return boost::none;
-            }
+            barriers.push_back(make_barrier(insn));
+            boost::hash_combine(key, barriers.back().opcode);
+            boost::hash_combine(key, barriers.back().field);
           }
         }
-
+        boost::optional<LocationsAndDependencies> lads;
+        if (m_method_barriers_cache != nullptr &&
+            m_method_barriers_cache->get(method, key, &lads)) {
+          cache_hits++;
+          return lads;
+        }
+        lads = analyze_barriers(method, barriers);
+        if (m_method_barriers_cache != nullptr) {
+          m_method_barriers_cache->put(method, key, lads);
+        }
         return lads;
       },
       &m_method_written_locations);
   m_stats.method_barriers_iterations = iterations;
+  m_stats.method_barriers_cache_hits = cache_hits;
   m_stats.method_barriers = m_method_written_locations.size();
 
   for (const auto& p : m_method_written_locations) {
@@ -969,7 +1328,7 @@ void SharedState::init_method_barriers(const Scope& scope) {
 
 void SharedState::init_scope(const Scope& scope) {
   always_assert(!m_method_override_graph);
-  m_method_override_graph = method_override_graph::build_graph(scope);
+  m_method_override_graph = method_override_graph::get_cached_graph(scope);
 
   auto iterations = compute_conditionally_pure_methods(
       scope, m_method_override_graph.get(), m_pure_methods,
@@ -1197,11 +1556,9 @@ CommonSubexpressionElimination::CommonSubexpressionElimination(
       m_is_static(is_static),
       m_declaring_type(declaring_type),
       m_args(args) {
-  Analyzer analyzer(shared_state, cfg, is_static, is_init_or_clinit,
-                    declaring_type);
-  m_stats.max_value_ids = analyzer.get_value_ids_size();
-  if (analyzer.using_other_tracked_location_bit()) {
-    m_stats.methods_using_other_tracked_location_bit = 1;
+  if (!may_have_redundancies(shared_state, cfg)) {
+    m_stats.methods_skipped = 1;
+    return;
   }
 
   // We need some helper state/functions to build the list m_earlier_insns
@@ -1231,6 +1588,48 @@ CommonSubexpressionElimination::CommonSubexpressionElimination(
         m_earlier_insns.push_back(insns);
         return index;
       };
+  auto add_forward = [&](const PatriciaTreeSet<const IRInstruction*>&
+                             earlier_insns,
+                         IRInstruction* insn) {
+    auto opcode = insn->opcode();
+    for (auto earlier_insn : earlier_insns) {
+      auto earlier_opcode = earlier_insn->opcode();
+      if (opcode::is_load_param(earlier_opcode)) {
+        return;
+      }
+      if (opcode::is_cmp(opcode) || opcode::is_cmp(earlier_opcode)) {
+        // See T46241704. We never de-duplicate cmp instructions due to an
+        // apparent bug in various Dalvik (and ART?) versions. Also see this
+        // documentation in the r8 source code:
+        // https://r8.googlesource.com/r8/+/2638db4d3465d785a6a740cf09969cab96099cff/src/main/java/com/android/tools/r8/utils/InternalOptions.java#604
+        return;
+      }
+    }
+
+    auto earlier_insns_index = get_earlier_insns_index(earlier_insns);
+    m_forward.push_back({earlier_insns_index, insn});
+  };
+
+  // Straight-line code doesn't need the fixpoint iteration.
+  if (cfg.num_blocks() == 1) {
+    std::vector<std::pair<const IRInstruction*, IRInstruction*>> forwards;
+    size_t value_numbers;
+    if (number_values_locally(shared_state, cfg, &forwards, &value_numbers)) {
+      m_stats.max_value_ids = value_numbers;
+      m_stats.methods_using_local_value_numbering = 1;
+      for (const auto& p : forwards) {
+        add_forward(PatriciaTreeSet<const IRInstruction*>{p.first}, p.second);
+      }
+      return;
+    }
+  }
+
+  Analyzer analyzer(shared_state, cfg, is_static, is_init_or_clinit,
+                    declaring_type);
+  m_stats.max_value_ids = analyzer.get_value_ids_size();
+  if (analyzer.using_other_tracked_location_bit()) {
+    m_stats.methods_using_other_tracked_location_bit = 1;
+  }
 
   // identify all instruction pairs where the result of the first instruction
   // can be forwarded to the second
@@ -1259,28 +1658,7 @@ CommonSubexpressionElimination::CommonSubexpressionElimination(
       if (earlier_insns.contains(insn)) {
         continue;
       }
-      bool skip{false};
-      for (auto earlier_insn : earlier_insns) {
-        auto earlier_opcode = earlier_insn->opcode();
-        if (opcode::is_load_param(earlier_opcode)) {
-          skip = true;
-          break;
-        }
-        if (opcode::is_cmp(opcode) || opcode::is_cmp(earlier_opcode)) {
-          // See T46241704. We never de-duplicate cmp instructions due to an
-          // apparent bug in various Dalvik (and ART?) versions. Also see this
-          // documentation in the r8 source code:
-          // https://r8.googlesource.com/r8/+/2638db4d3465d785a6a740cf09969cab96099cff/src/main/java/com/android/tools/r8/utils/InternalOptions.java#604
-          skip = true;
-          break;
-        }
-      }
-      if (skip) {
-        continue;
-      }
-
-      auto earlier_insns_index = get_earlier_insns_index(earlier_insns);
-      m_forward.push_back({earlier_insns_index, insn});
+      add_forward(earlier_insns, insn);
     }
   }
 }
@@ -1566,6 +1944,9 @@ Stats& Stats::operator+=(const Stats& that) {
   max_value_ids = std::max(max_value_ids, that.max_value_ids);
   methods_using_other_tracked_location_bit +=
       that.methods_using_other_tracked_location_bit;
+  methods_skipped += that.methods_skipped;
+  methods_using_local_value_numbering +=
+      that.methods_using_local_value_numbering;
   for (const auto& p : that.eliminated_opcodes) {
     eliminated_opcodes[p.first] += p.second;
   }
@@ -21,6 +21,10 @@ struct Stats {
   size_t instructions_eliminated{0};
   size_t max_value_ids{0};
   size_t methods_using_other_tracked_location_bit{0};
+  // methods without any candidate redundancies, which aren't analyzed
+  size_t methods_skipped{0};
+  // single-block methods handled without the fixpoint iteration
+  size_t methods_using_local_value_numbering{0};
   // keys are IROpcode encoded as uint16_t, to make OSS build happy
   std::unordered_map<uint16_t, size_t> eliminated_opcodes;
   size_t max_iterations{0};
@@ -31,6 +35,7 @@ struct Stats {
 struct SharedStateStats {
   size_t method_barriers{0};
   size_t method_barriers_iterations{0};
+  size_t method_barriers_cache_hits{0};
   size_t conditionally_pure_methods{0};
   size_t conditionally_pure_methods_iterations{0};
 };
@@ -55,9 +60,46 @@ struct BarrierHasher {
   }
 };
 
+/*
+ * Caches what each method may write, before taking the closure over its
+ * callees, across the SharedStates of a Redex invocation, e.g. of all
+ * CommonSubexpressionEliminationPass runs. Each entry records a key that
+ * covers the method's barriers, the method override graph and the set of safe
+ * methods it was computed with, so that stale entries are ignored and
+ * replaced.
+ *
+ * All operations are thread-safe.
+ */
+class MethodBarriersCache {
+ public:
+  // Whether there is an entry for :method with :key, which is then stored in
+  // :lads; boost::none means that the method may write anything.
+  bool get(const DexMethod* method,
+           size_t key,
+           boost::optional<LocationsAndDependencies>* lads);
+
+  void put(const DexMethod* method,
+           size_t key,
+           const boost::optional<LocationsAndDependencies>& lads);
+
+ private:
+  struct Entry {
+    size_t key;
+    boost::optional<LocationsAndDependencies> lads;
+  };
+
+  ConcurrentMap<const DexMethod*, Entry> m_entries;
+};
+
+/*
+ * The cache shared by all CSE runs of the current RedexContext.
+ */
+MethodBarriersCache& shared_method_barriers_cache();
+
 class SharedState {
  public:
-  explicit SharedState(const std::unordered_set<DexMethodRef*>& pure_methods);
+  explicit SharedState(const std::unordered_set<DexMethodRef*>& pure_methods,
+                       MethodBarriersCache* method_barriers_cache = nullptr);
   void init_scope(const Scope&);
   CseUnorderedLocationSet get_relevant_written_locations(
       const IRInstruction* insn,
@@ -92,7 +134,8 @@ class SharedState {
       m_method_written_locations;
   std::unordered_map<const DexMethod*, CseUnorderedLocationSet>
       m_conditionally_pure_methods;
-  std::unique_ptr<const method_override_graph::Graph> m_method_override_graph;
+  std::shared_ptr<const method_override_graph::Graph> m_method_override_graph;
+  MethodBarriersCache* m_method_barriers_cache;
   SharedStateStats m_stats;
 };
 
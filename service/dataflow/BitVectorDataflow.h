@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#include "ControlFlow.h"
+#include "GraphUtil.h"
+
+namespace bit_vector_dataflow {
+
+enum class Direction { FORWARD, BACKWARD };
+
+/*
+ * A worklist solver for "may" problems over dense bit vectors, such as
+ * liveness or reaching definitions, as a cheaper alternative to the sparta
+ * fixpoint iterators with PatriciaTreeSetAbstractDomain when the universe is
+ * small and dense (e.g. the registers of a method).
+ *
+ * BitVector is any value type with |= and ==, such as an integer mask,
+ * std::bitset or boost::dynamic_bitset; the wide word operations of the
+ * latter are left to the compiler to vectorize. The state flowing into a
+ * block is the union of the states flowing out of its predecessors (its
+ * successors, when going backwards), starting from the given empty vector.
+ *
+ * The blocks are visited in reverse postorder (postorder, when going
+ * backwards), and only revisited when one of their inputs changed.
+ */
+template <typename BitVector, Direction kDirection>
+class FixpointIterator {
+ public:
+  FixpointIterator(const cfg::ControlFlowGraph& cfg, const BitVector& empty)
+      : m_empty(empty) {
+    auto order = graph::postorder_sort<cfg::GraphInterface>(cfg);
+    if (kDirection == Direction::FORWARD) {
+      std::reverse(order.begin(), order.end());
+    }
+    for (size_t i = 0; i < order.size(); ++i) {
+      m_index.emplace(order[i]->id(), i);
+    }
+    // Blocks that aren't reachable from the entry still get a state.
+    for (auto* block : cfg.blocks()) {
+      if (m_index.emplace(block->id(), order.size()).second) {
+        order.push_back(block);
+      }
+    }
+    // The blocks are numbered in visiting order, so that the worklist is just
+    // a scan over a vector of flags.
+    m_blocks = order;
+    m_inputs.resize(order.size());
+    m_dependents.resize(order.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+      const auto& edges = kDirection == Direction::FORWARD
+                              ? order[i]->preds()
+                              : order[i]->succs();
+      for (auto* edge : edges) {
+        auto* other = kDirection == Direction::FORWARD ? edge->src()
+                                                       : edge->target();
+        auto j = m_index.at(other->id());
+        m_inputs[i].push_back(j);
+        m_dependents[j].push_back(i);
+      }
+    }
+  }
+
+  /*
+   * :transfer(block, in, &out) assigns to :out the state at the other end of
+   * :block, given the state :in where the analysis enters it.
+   */
+  template <typename Transfer>
+  void run(const Transfer& transfer) {
+    const size_t size = m_blocks.size();
+    m_entry.assign(size, m_empty);
+    m_exit.assign(size, m_empty);
+    std::vector<bool> dirty(size, true);
+    BitVector out = m_empty;
+    bool again = size > 0;
+    while (again) {
+      again = false;
+      for (size_t i = 0; i < size; ++i) {
+        if (!dirty[i]) {
+          continue;
+        }
+        dirty[i] = false;
+        auto& in = m_entry[i];
+        for (auto j : m_inputs[i]) {
+          in |= m_exit[j];
+        }
+        transfer(m_blocks[i], in, &out);
+        if (out == m_exit[i]) {
+          continue;
+        }
+        std::swap(m_exit[i], out);
+        for (auto j : m_dependents[i]) {
+          dirty[j] = true;
+          // A dependent earlier in the order needs another scan.
+          again |= j <= i;
+        }
+      }
+    }
+  }
+
+  // The state where the analysis enters :block, i.e. at its end when going
+  // backwards.
+  const BitVector& get_entry_state_at(const cfg::Block* block) const {
+    return m_entry.at(m_index.at(block->id()));
+  }
+
+  const BitVector& get_exit_state_at(const cfg::Block* block) const {
+    return m_exit.at(m_index.at(block->id()));
+  }
+
+ private:
+  BitVector m_empty;
+  std::unordered_map<cfg::BlockId, size_t> m_index;
+  std::vector<cfg::Block*> m_blocks;
+  std::vector<std::vector<size_t>> m_inputs;
+  std::vector<std::vector<size_t>> m_dependents;
+  std::vector<BitVector> m_entry;
+  std::vector<BitVector> m_exit;
+};
+
+} // namespace bit_vector_dataflow
@@ -65,52 +65,49 @@
 
 #include "ConstantUses.h"
 #include "DexUtil.h"
+#include "LiveRange.h"
 
 namespace constant_uses {
 
-ConstantUses::ConstantUses(const cfg::ControlFlowGraph& cfg, DexMethod* method)
-    : m_reaching_definitions(cfg),
-      m_rtype(method ? method->get_proto()->get_rtype() : nullptr) {
-  m_reaching_definitions.run(reaching_defs::Environment());
+ConstantUses::ConstantUses(cfg::ControlFlowGraph& cfg, DexMethod* method)
+    : m_rtype(method ? method->get_proto()->get_rtype() : nullptr) {
+  const auto& chains =
+      cfg.get_code_analysis<live_range::MoveAwareChains>().get_use_def_chains();
 
   bool need_type_inference = false;
   for (cfg::Block* block : cfg.blocks()) {
-    auto env = m_reaching_definitions.get_entry_state_at(block);
     for (auto& mie : InstructionIterable(block)) {
       IRInstruction* insn = mie.insn;
       for (size_t src_index = 0; src_index < insn->srcs_size(); src_index++) {
         auto src = insn->src(src_index);
-        auto defs = env.get(src);
-        if (!defs.is_top() && !defs.is_bottom()) {
-          for (auto def : defs.elements()) {
-            auto def_opcode = def->opcode();
-            if (def_opcode == OPCODE_CONST || def_opcode == OPCODE_CONST_WIDE) {
-              m_constant_uses[def].emplace_back(insn, src_index);
-              // So there's an instruction that uses a const value.
-              // For some uses, get_type_demand(IRInstruction*, size_t) will
-              // need to know type inference information on operands.
-              // The following switch logic needs to be kept in sync with that
-              // actual usage of type inference information.
-              auto opcode = insn->opcode();
-              switch (opcode) {
-              case OPCODE_APUT:
-              case OPCODE_APUT_WIDE:
-                if (src_index == 0) {
-                  need_type_inference = true;
-                }
-                break;
-              case OPCODE_IF_EQ:
-              case OPCODE_IF_NE:
+        const auto& defs = chains.at(live_range::Use{insn, src});
+        for (auto def : defs) {
+          auto def_opcode = def->opcode();
+          if (def_opcode == OPCODE_CONST || def_opcode == OPCODE_CONST_WIDE) {
+            m_constant_uses[def].emplace_back(insn, src_index);
+            // So there's an instruction that uses a const value.
+            // For some uses, get_type_demand(IRInstruction*, size_t) will
+            // need to know type inference information on operands.
+            // The following switch logic needs to be kept in sync with that
+            // actual usage of type inference information.
+            auto opcode = insn->opcode();
+            switch (opcode) {
+            case OPCODE_APUT:
+            case OPCODE_APUT_WIDE:
+              if (src_index == 0) {
                 need_type_inference = true;
-                break;
-              default:
-                break;
               }
+              break;
+            case OPCODE_IF_EQ:
+            case OPCODE_IF_NE:
+              need_type_inference = true;
+              break;
+            default:
+              break;
             }
           }
         }
       }
-      m_reaching_definitions.analyze_instruction(insn, &env);
     }
   }
 
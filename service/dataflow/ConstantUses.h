@@ -28,7 +28,8 @@ enum TypeDemand : uint8_t {
 
 class ConstantUses {
  public:
-  explicit ConstantUses(const cfg::ControlFlowGraph& cfg, DexMethod* method);
+  // Shares the def-use chains cached on :cfg, see CFG::get_code_analysis().
+  explicit ConstantUses(cfg::ControlFlowGraph& cfg, DexMethod* method);
 
   // Given a const or const-wide instruction, retrieve all instructions that
   // use it.
@@ -47,7 +48,6 @@ class ConstantUses {
   TypeDemand get_type_demand(IRInstruction* insn, size_t src_index) const;
 
   mutable std::unique_ptr<type_inference::TypeInference> m_type_inference;
-  reaching_defs::MoveAwareFixpointIterator m_reaching_definitions;
   std::unordered_map<IRInstruction*,
                      std::vector<std::pair<IRInstruction*, size_t>>>
       m_constant_uses;
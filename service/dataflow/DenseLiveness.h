@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <boost/dynamic_bitset.hpp>
+
+#include "BitVectorDataflow.h"
+#include "Liveness.h"
+
+/*
+ * The same analysis as LivenessFixpointIterator, with the live registers of
+ * each block as a dense bit vector with one bit per register of the method.
+ * Each block is summarized once into the registers it uses before defining
+ * them and the ones it defines, so that iterating to the fixpoint only takes
+ * a few word-wide operations per block.
+ */
+class DenseLiveness {
+ public:
+  using Registers = boost::dynamic_bitset<uint64_t>;
+
+  explicit DenseLiveness(const cfg::ControlFlowGraph& cfg)
+      : m_fixpoint(cfg, Registers(cfg.get_registers_size())) {
+    const size_t size = cfg.get_registers_size();
+    std::unordered_map<cfg::BlockId, std::pair<Registers, Registers>> summaries;
+    for (auto* block : cfg.blocks()) {
+      auto& summary = summaries[block->id()];
+      auto& uses = summary.first;
+      auto& defs = summary.second;
+      uses.resize(size);
+      defs.resize(size);
+      for (auto it = block->rbegin(); it != block->rend(); ++it) {
+        if (it->type != MFLOW_OPCODE) {
+          continue;
+        }
+        auto insn = it->insn;
+        if (insn->has_dest()) {
+          uses.reset(insn->dest());
+          defs.set(insn->dest());
+        }
+        for (size_t i = 0; i < insn->srcs_size(); ++i) {
+          uses.set(insn->src(i));
+        }
+      }
+    }
+    m_fixpoint.run([&](const cfg::Block* block, const Registers& live_out,
+                       Registers* live_in) {
+      const auto& summary = summaries.at(block->id());
+      *live_in = live_out;
+      *live_in -= summary.second;
+      *live_in |= summary.first;
+    });
+  }
+
+  const Registers& get_live_in_vars_at(const cfg::Block* block) const {
+    return m_fixpoint.get_exit_state_at(block);
+  }
+
+  const Registers& get_live_out_vars_at(const cfg::Block* block) const {
+    return m_fixpoint.get_entry_state_at(block);
+  }
+
+  // Same transfer function as LivenessFixpointIterator.
+  static void analyze_instruction(const IRInstruction* insn, Registers* live) {
+    if (insn->has_dest()) {
+      live->reset(insn->dest());
+    }
+    for (size_t i = 0; i < insn->srcs_size(); ++i) {
+      live->set(insn->src(i));
+    }
+  }
+
+  static LivenessDomain to_domain(const Registers& live) {
+    LivenessDomain domain;
+    for (auto reg = live.find_first(); reg != Registers::npos;
+         reg = live.find_next(reg)) {
+      domain.add(reg);
+    }
+    return domain;
+  }
+
+ private:
+  using FixpointIterator = bit_vector_dataflow::
+      FixpointIterator<Registers, bit_vector_dataflow::Direction::BACKWARD>;
+
+  FixpointIterator m_fixpoint;
+};
@@ -58,14 +58,14 @@ class SymRegMapper {
   std::unordered_map<Def, reg_t> m_def_to_reg;
 };
 
-using UDChains = std::unordered_map<Use, PatriciaTreeSet<Def>>;
-
 /*
  * Put all defs with a use in common into the same set.
  */
-void unify_defs(const UDChains& chains, DefSets* def_sets) {
+void unify_defs(const UseDefChains& chains, DefSets* def_sets) {
   for (const auto& chain : chains) {
     auto& defs = chain.second;
+    always_assert_log(!defs.empty(), "Found use without def for %s",
+                      SHOW(chain.first.insn));
     auto it = defs.begin();
     Def first = *it;
     auto end = defs.end();
@@ -75,10 +75,11 @@ void unify_defs(const UDChains& chains, DefSets* def_sets) {
   }
 }
 
-UDChains calculate_ud_chains(const cfg::ControlFlowGraph& cfg) {
-  reaching_defs::FixpointIterator fixpoint_iter{cfg};
+template <class FixpointIterator>
+UseDefChains calculate_ud_chains(const cfg::ControlFlowGraph& cfg) {
+  FixpointIterator fixpoint_iter{cfg};
   fixpoint_iter.run(reaching_defs::Environment());
-  UDChains chains;
+  UseDefChains chains;
   for (cfg::Block* block : cfg.blocks()) {
     reaching_defs::Environment defs_in =
         fixpoint_iter.get_entry_state_at(block);
@@ -88,10 +89,11 @@ UDChains calculate_ud_chains(const cfg::ControlFlowGraph& cfg) {
         auto src = insn->src(i);
         Use use{insn, src};
         auto defs = defs_in.get(src);
-        always_assert_log(!defs.is_top() && defs.size() > 0,
-                          "Found use without def when processing [0x%lx]%s",
-                          &mie, SHOW(insn));
-        chains[use] = defs.elements();
+        if (!defs.is_top() && !defs.is_bottom()) {
+          chains[use] = defs.elements();
+        } else {
+          chains[use];
+        }
       }
       fixpoint_iter.analyze_instruction(insn, &defs_in);
     }
@@ -107,9 +109,28 @@ bool Use::operator==(const Use& that) const {
   return insn == that.insn && reg == that.reg;
 }
 
+Chains::Chains(const cfg::ControlFlowGraph& cfg)
+    : Chains(calculate_ud_chains<reaching_defs::FixpointIterator>(cfg)) {}
+
+const DefUseChains& Chains::get_def_use_chains() const {
+  if (!m_def_use_chains) {
+    m_def_use_chains = std::make_unique<DefUseChains>();
+    for (const auto& chain : m_use_def_chains) {
+      for (auto def : chain.second) {
+        (*m_def_use_chains)[def].insert(chain.first);
+      }
+    }
+  }
+  return *m_def_use_chains;
+}
+
+MoveAwareChains::MoveAwareChains(const cfg::ControlFlowGraph& cfg)
+    : Chains(calculate_ud_chains<reaching_defs::MoveAwareFixpointIterator>(
+          cfg)) {}
+
 void renumber_registers(IRCode* code, bool width_aware) {
   cfg::ScopedCFG cfg(code);
-  auto chains = calculate_ud_chains(*cfg);
+  const auto& chains = cfg->get_code_analysis<Chains>().get_use_def_chains();
 
   Rank rank;
   Parent parent;
@@ -136,6 +157,7 @@ void renumber_registers(IRCode* code, bool width_aware) {
     }
   }
   cfg->set_registers_size(sym_reg_mapper.regs_size());
+  cfg->code_changed();
 }
 
 } // namespace live_range
@@ -5,12 +5,20 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#pragma once
+
 #include <boost/functional/hash.hpp>
 #include <cstdint>
+#include <memory>
 #include <unordered_map>
 #include <unordered_set>
 
 #include "IRInstruction.h"
+#include "PatriciaTreeSet.h"
+
+namespace cfg {
+class ControlFlowGraph;
+} // namespace cfg
 
 /*
  * This module renumbers registers so that they represent live ranges. Live
@@ -48,6 +56,48 @@ struct hash<live_range::Use> {
 
 namespace live_range {
 
+using UseDefChains = std::unordered_map<Use, sparta::PatriciaTreeSet<Def>>;
+using DefUseChains = std::unordered_map<Def, std::unordered_set<Use>>;
+
+/*
+ * The use-def chains of a method, from the reaching definitions of its
+ * registers, and the def-use chains derived from them on demand. Clients that
+ * look at the same code should share them via
+ * `cfg.get_code_analysis<live_range::Chains>()` instead of running their own
+ * reaching definitions analysis.
+ *
+ * Every source register of every instruction has a use-def chain; it is empty
+ * if no def reaches the use, e.g. in unreachable code. Defs without any use
+ * have no def-use chain.
+ */
+class Chains {
+ public:
+  explicit Chains(const cfg::ControlFlowGraph& cfg);
+
+  const UseDefChains& get_use_def_chains() const { return m_use_def_chains; }
+
+  // Computed on the first call.
+  const DefUseChains& get_def_use_chains() const;
+
+ protected:
+  explicit Chains(UseDefChains use_def_chains)
+      : m_use_def_chains(std::move(use_def_chains)) {}
+
+ private:
+  UseDefChains m_use_def_chains;
+  mutable std::unique_ptr<DefUseChains> m_def_use_chains;
+};
+
+/*
+ * Like Chains, but the defs of a use are the instructions that computed its
+ * value, seen through any moves and move-results in between, as in
+ * reaching_defs::MoveAwareFixpointIterator.
+ */
+class MoveAwareChains : public Chains {
+ public:
+  explicit MoveAwareChains(const cfg::ControlFlowGraph& cfg);
+};
+
 /*
  * width_aware means that the renumbering process will allocate 2 slots per
  * wide register. In general, callers should use the default (true) value.
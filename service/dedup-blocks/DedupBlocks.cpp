@@ -47,6 +47,8 @@
 
 #include "DedupBlocks.h"
 
+#include <deque>
+
 #include "Liveness.h"
 #include "ReachingDefinitions.h"
 #include "TypeInference.h"
@@ -124,14 +126,53 @@ struct BlocksInSameGroup {
   }
 };
 
-struct BlockHasher {
-  hash_t operator()(cfg::Block* b) const {
-    hash_t result = 0;
-    for (auto& mie : InstructionIterable(b)) {
-      result = (result * 7) ^ mie.insn->hash();
+// A structural hash that is consistent with IRInstruction::operator==, but
+// that, unlike IRInstruction::hash, also depends on the order of registers.
+hash_t hash_instruction(const IRInstruction* insn) {
+  hash_t result = insn->hash();
+  boost::hash_combine(result, insn->opcode());
+  for (auto src : insn->srcs()) {
+    boost::hash_combine(result, src);
+  }
+  if (insn->has_dest()) {
+    boost::hash_combine(result, insn->dest());
+  }
+  return result;
+}
+
+// A structural hash of a block's code and successors that is consistent with
+// BlocksInSameGroup, except that a block jumping to a self-loop never hashes
+// like that self-loop.
+hash_t hash_block(const cfg::Block* b) {
+  hash_t result = 0;
+  for (auto& mie : InstructionIterable(b)) {
+    boost::hash_combine(result, hash_instruction(mie.insn));
+  }
+  // Branch and goto successors are compared as a set.
+  hash_t succs = 0;
+  for (auto edge : b->succs()) {
+    if (is_branch_or_goto(edge)) {
+      hash_t succ = edge->type();
+      boost::hash_combine(succ, edge->case_key().value_or(0));
+      auto target = edge->target();
+      boost::hash_combine(succ, target == b ? -1 : target->id());
+      succs += succ;
     }
-    return result;
   }
+  boost::hash_combine(result, succs);
+  boost::hash_combine(result, b->is_catch());
+  for (auto edge : b->get_outgoing_throws_in_order()) {
+    boost::hash_combine(result, edge->target()->id());
+    boost::hash_combine(result, edge->throw_info()->catch_type);
+  }
+  return result;
+}
+
+// Looks up precomputed block hashes, so that grouping blocks only needs to
+// compare blocks structurally when their hashes agree.
+struct BlockHasher {
+  const std::unordered_map<const cfg::Block*, hash_t>* hashes;
+  hash_t operator()(cfg::Block* b) const { return hashes->at(b); }
 };
 
 struct BlockCompare {
@@ -155,14 +196,6 @@ struct BlockSuccHasher {
   }
 };
 
-struct InstructionHasher {
-  hash_t operator()(IRInstruction* insn) const { return insn->hash(); }
-};
-
-struct InstructionEquals {
-  bool operator()(IRInstruction* a, IRInstruction* b) const { return *a == *b; }
-};
-
 // Choose an iteration order based on block ids for determinism. This returns a
 // vector of pointers to the entries of the Map.
 //
@@ -261,11 +294,20 @@ class DedupBlocksImpl {
                                                   SuccBlocksInSameGroup>;
   const Config* m_config;
   Stats& m_stats;
+  // Structural hashes of the eligible blocks, as of the last
+  // collect_duplicates
+  std::unordered_map<const cfg::Block*, hash_t> m_block_hashes;
 
   // Find blocks with the same exact code
   Duplicates collect_duplicates(DexMethod* method, cfg::ControlFlowGraph& cfg) {
     const auto& blocks = cfg.blocks();
-    Duplicates duplicates;
+    m_block_hashes.clear();
+    for (cfg::Block* block : blocks) {
+      if (is_eligible(block)) {
+        m_block_hashes.emplace(block, hash_block(block));
+      }
+    }
+    Duplicates duplicates(m_block_hashes.size(), BlockHasher{&m_block_hashes});
 
     for (cfg::Block* block : blocks) {
       if (is_eligible(block)) {
@@ -414,6 +456,7 @@ class DedupBlocksImpl {
           splitGroupMap.size());
 
     struct CountGroup {
+      IRInstruction* insn;
       size_t count = 0;
       BlockSet blocks;
     };
@@ -439,11 +482,22 @@ class DedupBlocksImpl {
       size_t best_insn_count = 0;
       size_t best_saved_insn = 0;
 
-      // Get (reverse) iterators for all blocks.
+      // Get (reverse) iterators for all blocks, and rolling hashes of all
+      // their instruction postfixes, so that blocks can be grouped by hash.
       std::map<cfg::Block*, IRList::reverse_iterator, BlockCompare>
           block_iterator_map;
+      std::unordered_map<const cfg::Block*, std::vector<hash_t>>
+          postfix_hashes;
       for (auto block : succ_blocks) {
         block_iterator_map[block] = block->rbegin();
+        auto& hashes = postfix_hashes[block];
+        hash_t hash = 0;
+        for (auto it = block->rbegin(); it != block->rend(); ++it) {
+          if (it->type == MFLOW_OPCODE) {
+            boost::hash_combine(hash, hash_instruction(it->insn));
+            hashes.push_back(hash);
+          }
+        }
       }
 
       // Find the best common blocks
@@ -473,9 +527,12 @@ class DedupBlocksImpl {
         // @TODO - Instead of only keeping one group and calculate best savings
         // based on just one group, maintain multiple groups at the same time
         // and split/dedup those groups.
-        std::unordered_map<IRInstruction*, CountGroup, InstructionHasher,
-                           InstructionEquals>
-            insn_count;
+        //
+        // Groups are keyed by postfix hash. All remaining blocks share all
+        // later instructions, so it's enough to compare the current ones if
+        // the hashes agree.
+        std::unordered_map<hash_t, std::deque<CountGroup>> insn_count;
+        CountGroup* majority_count_group = nullptr;
 
         for (auto& block_iterator_pair : block_iterator_map) {
           const auto block = block_iterator_pair.first;
@@ -488,12 +545,21 @@ class DedupBlocksImpl {
 
           if (it != block->rend()) {
             // Count the instructions and locate the majority
-            auto& count_group = insn_count[it->insn];
-            count_group.count++;
-            count_group.blocks.insert(block);
-            if (count_group.count > majority) {
-              majority = count_group.count;
+            auto& count_groups =
+                insn_count[postfix_hashes.at(block).at(cur_insn_index)];
+            auto count_group = std::find_if(
+                count_groups.begin(), count_groups.end(),
+                [&](const CountGroup& g) { return *g.insn == *it->insn; });
+            if (count_group == count_groups.end()) {
+              count_groups.push_back(CountGroup{it->insn});
+              count_group = std::prev(count_groups.end());
+            }
+            count_group->count++;
+            count_group->blocks.insert(block);
+            if (count_group->count > majority) {
+              majority = count_group->count;
               majority_insn = it->insn;
+              majority_count_group = &*count_group;
             }
 
             // Move to next instruction.
@@ -513,13 +579,12 @@ class DedupBlocksImpl {
         }
 
         cur_insn_index++;
-        auto& majority_count_group = insn_count[majority_insn];
 
         // Remove the iterators
         for (auto it = block_iterator_map.begin();
              it != block_iterator_map.end();) {
-          if (majority_count_group.blocks.find(it->first) ==
-              majority_count_group.blocks.end()) {
+          if (majority_count_group->blocks.find(it->first) ==
+              majority_count_group->blocks.end()) {
             // Remove iterator that is not in the majority group
             it = block_iterator_map.erase(it);
           } else {
@@ -531,14 +596,14 @@ class DedupBlocksImpl {
         // Note we only want at least 3 level deep otherwise it is probably not
         // quite worth it (configurable).
         size_t cur_saved_insn =
-            cur_insn_index * (majority_count_group.blocks.size() - 1);
+            cur_insn_index * (majority_count_group->blocks.size() - 1);
         if (cur_saved_insn > best_saved_insn &&
             cur_insn_index >= m_config->block_split_min_opcode_count) {
           // Save it
           best_saved_insn = cur_saved_insn;
           best_insn_count = cur_insn_index;
           best_block_its = block_iterator_map;
-          best_blocks = std::move(majority_count_group.blocks);
+          best_blocks = std::move(majority_count_group->blocks);
         }
       }
 
@@ -973,10 +1038,10 @@ class DedupBlocksImpl {
     return result;
   }
 
-  static void print_dups(const Duplicates& dups) {
+  void print_dups(const Duplicates& dups) const {
     TRACE(DEDUP_BLOCKS, 4, "duplicate blocks set: {");
     for (const auto& entry : dups) {
-      TRACE(DEDUP_BLOCKS, 4, "  hash = %lu", BlockHasher{}(entry.first));
+      TRACE(DEDUP_BLOCKS, 4, "  hash = %lu", m_block_hashes.at(entry.first));
       for (cfg::Block* b : entry.second) {
         TRACE(DEDUP_BLOCKS, 4, "    block %d", b->id());
         for (const MethodItemEntry& mie : *b) {
@@ -12,6 +12,7 @@
 #include <unordered_set>
 #include <vector>
 
+#include "BitVectorDataflow.h"
 #include "ControlFlow.h"
 #include "DexClass.h"
 #include "DexUtil.h"
@@ -70,63 +71,51 @@ void LocalDce::dce(IRCode* code) {
   cfg::ScopedCFG cfg(code);
   const auto& blocks = graph::postorder_sort<cfg::GraphInterface>(*cfg);
   auto regs = cfg->get_registers_size();
-  std::unordered_map<cfg::BlockId, boost::dynamic_bitset<>> liveness;
-  for (cfg::Block* b : blocks) {
-    liveness.emplace(b->id(), boost::dynamic_bitset<>(regs + 1));
-  }
-  bool changed;
   std::vector<std::pair<cfg::Block*, IRList::iterator>> dead_instructions;
 
   TRACE(DCE, 5, "%s", SHOW(*cfg));
 
-  // Iterate liveness analysis to a fixed point.
-  do {
-    changed = false;
-    dead_instructions.clear();
-    for (auto& b : blocks) {
-      auto prev_liveness = liveness.at(b->id());
-      auto& bliveness = liveness.at(b->id());
-      bliveness.reset();
-      TRACE(DCE, 5, "B%lu: %s", b->id(), show(bliveness).c_str());
-
-      // Compute live-out for this block from its successors.
-      for (auto& s : b->succs()) {
-        if (s->target()->id() == b->id()) {
-          bliveness |= prev_liveness;
-        }
-        TRACE(DCE,
-              5,
-              "  S%lu: %s",
-              s->target()->id(),
-              SHOW(liveness.at(s->target()->id())));
-        bliveness |= liveness.at(s->target()->id());
+  // Iterate liveness analysis to a fixed point. Unlike plain liveness, the
+  // sources of instructions that aren't required don't become live.
+  using namespace bit_vector_dataflow;
+  FixpointIterator<boost::dynamic_bitset<>, Direction::BACKWARD> fixpoint(
+      *cfg, boost::dynamic_bitset<>(regs + 1));
+  fixpoint.run([&](cfg::Block* b,
+                   const boost::dynamic_bitset<>& live_out,
+                   boost::dynamic_bitset<>* live_in) {
+    *live_in = live_out;
+    for (auto it = b->rbegin(); it != b->rend(); ++it) {
+      if (it->type == MFLOW_OPCODE &&
+          is_required(*cfg, b, it->insn, *live_in)) {
+        update_liveness(it->insn, *live_in);
       }
-
-      // Compute live-in for this block by walking its instruction list in
-      // reverse and applying the liveness rules.
-      for (auto it = b->rbegin(); it != b->rend(); ++it) {
-        if (it->type != MFLOW_OPCODE) {
-          continue;
-        }
-        bool required = is_required(*cfg, b, it->insn, bliveness);
-        if (required) {
-          update_liveness(it->insn, bliveness);
-        } else {
-          // move-result-pseudo instructions will be automatically removed
-          // when their primary instruction is deleted.
-          if (!opcode::is_move_result_pseudo(it->insn->opcode())) {
-            auto forward_it = std::prev(it.base());
-            dead_instructions.emplace_back(b, forward_it);
-          }
-        }
-        TRACE(CFG, 5, "%s\n%s", show(it->insn).c_str(),
-              show(bliveness).c_str());
+    }
+  });
+
+  for (auto& b : blocks) {
+    // Compute live-in for this block by walking its instruction list in
+    // reverse and applying the liveness rules, starting from its live-out.
+    auto bliveness = fixpoint.get_entry_state_at(b);
+    TRACE(DCE, 5, "B%lu: %s", b->id(), show(bliveness).c_str());
+    for (auto it = b->rbegin(); it != b->rend(); ++it) {
+      if (it->type != MFLOW_OPCODE) {
+        continue;
       }
-      if (bliveness != prev_liveness) {
-        changed = true;
+      bool required = is_required(*cfg, b, it->insn, bliveness);
+      if (required) {
+        update_liveness(it->insn, bliveness);
+      } else {
+        // move-result-pseudo instructions will be automatically removed
+        // when their primary instruction is deleted.
+        if (!opcode::is_move_result_pseudo(it->insn->opcode())) {
+          auto forward_it = std::prev(it.base());
+          dead_instructions.emplace_back(b, forward_it);
+        }
       }
+      TRACE(CFG, 5, "%s\n%s", show(it->insn).c_str(),
+            show(bliveness).c_str());
     }
-  } while (changed);
+  }
 
   // Remove dead instructions.
   std::unordered_set<IRInstruction*> seen;
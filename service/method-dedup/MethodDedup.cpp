@@ -7,40 +7,40 @@
 
 #include "MethodDedup.h"
 
+#include "CodeFingerprint.h"
 #include "IRCode.h"
 #include "MethodReference.h"
+#include "WorkQueue.h"
 
 namespace {
 
 struct CodeAsKey {
   IRCode* code;
+  code_fingerprint::Fingerprint fingerprint;
 
-  explicit CodeAsKey(IRCode* c) : code(c) {}
+  CodeAsKey(DexMethod* method, code_fingerprint::FingerprintCache* fingerprints)
+      : code(method->get_code()), fingerprint(fingerprints->get(method)) {}
 
   bool operator==(const CodeAsKey& other) const {
-    return code->structural_equals(*other.code);
+    return fingerprint == other.fingerprint &&
+           code->structural_equals(*other.code);
   }
 };
 
 struct CodeHasher {
-  size_t operator()(const CodeAsKey& key) const {
-    size_t result = 0;
-    for (auto& mie : InstructionIterable(key.code)) {
-      result ^= mie.insn->hash();
-    }
-    return result;
-  }
+  size_t operator()(const CodeAsKey& key) const { return key.fingerprint; }
 };
 
 using DuplicateMethods =
     std::unordered_map<CodeAsKey, MethodOrderedSet, CodeHasher>;
 
 std::vector<MethodOrderedSet> get_duplicate_methods_simple(
-    const MethodOrderedSet& methods) {
+    const MethodOrderedSet& methods,
+    code_fingerprint::FingerprintCache* fingerprints) {
   DuplicateMethods duplicates;
   for (DexMethod* method : methods) {
     always_assert(method->get_code());
-    duplicates[CodeAsKey(method->get_code())].emplace(method);
+    duplicates[CodeAsKey(method, fingerprints)].emplace(method);
   }
 
   std::vector<MethodOrderedSet> result;
@@ -86,13 +86,24 @@ std::vector<MethodOrderedSet> group_similar_methods(
 
 std::vector<MethodOrderedSet> group_identical_methods(
     const std::vector<DexMethod*>& methods) {
+  // Fingerprint all methods in parallel upfront; the grouping below then only
+  // looks them up. The fingerprints are computed afresh for every grouping, as
+  // passes rewrite instructions in place.
+  code_fingerprint::FingerprintCache fingerprints;
+  auto wq = workqueue_foreach<DexMethod*>(
+      [&fingerprints](DexMethod* method) { fingerprints.get(method); });
+  for (auto method : methods) {
+    wq.add_item(method);
+  }
+  wq.run_all();
+
   std::vector<MethodOrderedSet> result;
   std::vector<MethodOrderedSet> same_protos = group_similar_methods(methods);
 
   // Find actual duplicates.
   for (const auto& same_proto : same_protos) {
     std::vector<MethodOrderedSet> duplicates =
-        get_duplicate_methods_simple(same_proto);
+        get_duplicate_methods_simple(same_proto, &fingerprints);
 
     result.insert(result.end(), duplicates.begin(), duplicates.end());
   }
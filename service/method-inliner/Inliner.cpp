@@ -88,7 +88,8 @@ MultiMethodInliner::MultiMethodInliner(
     const std::unordered_map<const DexMethod*, size_t>*
         same_method_implementations,
     bool analyze_and_prune_inits,
-    const std::unordered_set<DexMethodRef*>& configured_pure_methods)
+    const std::unordered_set<DexMethodRef*>& configured_pure_methods,
+    inliner::CostCache* cost_cache)
     : resolver(std::move(resolve_fn)),
       xstores(stores),
       m_scope(scope),
@@ -97,7 +98,8 @@ MultiMethodInliner::MultiMethodInliner(
       m_inline_for_speed(method_profiles),
       m_same_method_implementations(same_method_implementations),
       m_pure_methods(get_pure_methods()),
-      m_analyze_and_prune_inits(analyze_and_prune_inits) {
+      m_analyze_and_prune_inits(analyze_and_prune_inits),
+      m_cost_cache(cost_cache) {
   for (const auto& callee_callers : true_virtual_callers) {
     for (const auto& caller_insns : callee_callers.second) {
       for (auto insn : caller_insns.second) {
@@ -174,6 +176,18 @@ MultiMethodInliner::MultiMethodInliner(
     }
   }
 
+  if (for_speed() && m_config.profile_guided_size_budget > 0) {
+    std::vector<InlineForSpeed::CallEdge> call_sites;
+    for (const auto& p : caller_callee) {
+      for (auto callee : p.second) {
+        call_sites.emplace_back(p.first, callee);
+      }
+    }
+    m_inline_for_speed.select_within_budget(
+        call_sites, m_config.profile_guided_size_budget);
+    info.profile_guided_call_sites = m_inline_for_speed.selected_call_sites();
+  }
+
   m_shrinking_enabled = m_config.run_const_prop || m_config.run_cse ||
                         m_config.run_copy_prop || m_config.run_local_dce ||
                         m_config.run_dedup_blocks;
@@ -384,6 +398,13 @@ void MultiMethodInliner::inline_methods() {
     callee_priority = (callee_priority << 16) + callers.size();
   }
 
+  if (m_config.wave_scheduling) {
+    inline_methods_in_waves(ordered_stack_depths,
+                            caller_nonrecursive_callees_by_stack_depth);
+    delayed_change_visibilities();
+    return;
+  }
+
   // Kick off (shrinking and) pre-computing the should-inline cache.
   // Once all callees of a caller have been processed, then postprocessing
   // will in turn kick off processing of the caller.
@@ -412,6 +433,88 @@ void MultiMethodInliner::inline_methods() {
   info.waited_seconds = m_async_method_executor.get_waited_seconds();
 }
 
+void MultiMethodInliner::inline_methods_in_waves(
+    const std::vector<size_t>& ordered_stack_depths,
+    const CallerNonrecursiveCalleesByStackDepth&
+        caller_nonrecursive_callees_by_stack_depth) {
+  // The stack depth of a caller exceeds the ones of all its callees, so the
+  // callers of each depth only depend on earlier waves.
+  std::vector<std::vector<DexMethod*>> waves;
+  waves.emplace_back();
+  for (auto& p : m_async_callee_priorities) {
+    if (m_async_caller_callees.count(p.first) == 0) {
+      waves.back().push_back(const_cast<DexMethod*>(p.first));
+    }
+  }
+  if (m_shrinking_enabled && m_config.shrink_other_methods) {
+    walk::code(m_scope, [&](DexMethod* method, IRCode&) {
+      if (m_async_caller_callees.count(method) == 0 &&
+          m_async_callee_priorities.count(method) == 0 &&
+          !method->rstate.no_optimizations()) {
+        waves.back().push_back(method);
+      }
+    });
+  }
+  for (auto stack_depth : ordered_stack_depths) {
+    waves.emplace_back();
+    for (auto& p : caller_nonrecursive_callees_by_stack_depth.at(stack_depth)) {
+      waves.back().push_back(p.first);
+    }
+  }
+
+  auto num_threads = m_config.debug ? 1 : redex_parallel::default_num_threads();
+  for (auto& wave : waves) {
+    if (wave.empty()) {
+      continue;
+    }
+    TRACE(INLINE, 2, "Inlining wave %zu of %zu methods",
+          info.wave_sizes.size(), wave.size());
+    info.wave_sizes.push_back(wave.size());
+    // Callers whose inlining needs deconstructed cfgs are handled one at a
+    // time once the rest of the wave is done.
+    std::vector<DexMethod*> sequential;
+    for (auto method : wave) {
+      if (m_async_caller_callees.count(method) &&
+          inline_inlinables_need_deconstruct(method)) {
+        sequential.push_back(method);
+      }
+    }
+    std::unordered_set<DexMethod*> sequential_set(sequential.begin(),
+                                                  sequential.end());
+    auto wq = workqueue_foreach<DexMethod*>(
+        [&](DexMethod* method) { wave_process_method(method); }, num_threads);
+    for (auto method : wave) {
+      if (!sequential_set.count(method)) {
+        wq.add_item(method);
+      }
+    }
+    wq.run_all();
+    for (auto method : sequential) {
+      wave_process_method(method);
+    }
+  }
+}
+
+void MultiMethodInliner::wave_process_method(DexMethod* method) {
+  auto callees_it = m_async_caller_callees.find(method);
+  if (callees_it != m_async_caller_callees.end()) {
+    caller_inline(method, callees_it->second);
+  }
+  // All callees were shrunk before being inlined, so the shrinking of each
+  // callee benefits all of its callers.
+  if (m_shrinking_enabled && !method->rstate.no_optimizations()) {
+    shrink_method(method);
+  }
+  if (m_async_callee_priorities.count(method) != 0 && should_inline(method)) {
+    get_callee_insn_size(method);
+    get_callee_type_refs(method);
+    if (m_mode != IntraDex && !is_private(method) &&
+        !get_callee_caller_refs(method).same_class) {
+      get_callee_method_refs(method);
+    }
+  }
+}
+
 size_t MultiMethodInliner::compute_caller_nonrecursive_callees_by_stack_depth(
     DexMethod* caller,
     const std::vector<DexMethod*>& callees,
@@ -1359,10 +1462,30 @@ size_t MultiMethodInliner::get_inlined_cost(const DexMethod* callee) {
     return *opt_inlined_cost;
   }
 
+  // The code of the callee no longer changes, see inline_methods().
+  auto fingerprint = m_cost_cache == nullptr
+                         ? 0
+                         : inliner::CostCache::fingerprint(callee->get_code());
+  auto estimate = [&](const ConstantArguments* constant_arguments,
+                      const std::string& arguments_key) {
+    if (m_cost_cache != nullptr) {
+      auto cached = m_cost_cache->get(callee, fingerprint, arguments_key);
+      if (cached) {
+        return InlinedCostAndDeadBlocks{cached->cost, cached->dead_blocks};
+      }
+    }
+    auto res = ::get_inlined_cost(is_static(callee), callee->get_code(),
+                                  constant_arguments);
+    if (m_cost_cache != nullptr) {
+      m_cost_cache->put(callee, fingerprint, arguments_key,
+                        {res.cost, res.dead_blocks});
+    }
+    return res;
+  };
+
   std::atomic<size_t> callees_analyzed{0};
   std::atomic<size_t> callees_unreachable_blocks{0};
-  std::atomic<size_t> inlined_cost{
-      ::get_inlined_cost(is_static(callee), callee->get_code()).cost};
+  std::atomic<size_t> inlined_cost{estimate(nullptr, "").cost};
   ConcurrentMap<std::string, size_t> inlined_costs_keyed;
   auto callee_constant_arguments_it = m_callee_constant_arguments.find(callee);
   if (callee_constant_arguments_it != m_callee_constant_arguments.end() &&
@@ -1373,18 +1496,17 @@ size_t MultiMethodInliner::get_inlined_cost(const DexMethod* callee) {
       const auto& constant_arguments = cao.first;
       const auto count = cao.second;
       TRACE(INLINE, 5, "[too_many_callers] get_inlined_cost %s", SHOW(callee));
-      auto res = ::get_inlined_cost(is_static(callee), callee->get_code(),
-                                    &constant_arguments);
+      auto key = get_key(constant_arguments);
+      auto res = estimate(&constant_arguments, key);
       TRACE(INLINE, 4,
             "[too_many_callers] get_inlined_cost with %zu constant invoke "
             "params %s @ %s: cost %zu (dead blocks: %zu)",
             constant_arguments.is_top() ? 0 : constant_arguments.size(),
-            get_key(constant_arguments).c_str(), SHOW(callee), res.cost,
-            res.dead_blocks);
+            key.c_str(), SHOW(callee), res.cost, res.dead_blocks);
       callees_unreachable_blocks += res.dead_blocks * count;
       inlined_cost += res.cost * count;
       callees_analyzed += count;
-      inlined_costs_keyed.emplace(get_key(constant_arguments), res.cost);
+      inlined_costs_keyed.emplace(key, res.cost);
     };
 
     if (callee_constant_arguments.size() > 1 &&
@@ -1975,18 +2097,26 @@ bool MultiMethodInliner::cross_store_reference(const DexMethod* caller,
 }
 
 void MultiMethodInliner::delayed_change_visibilities() {
-  walk::parallel::code(m_scope, [&](DexMethod* method, IRCode& code) {
-    auto it = m_delayed_change_visibilities->find(method);
-    if (it == m_delayed_change_visibilities->end()) {
-      return;
-    }
-    auto& scopes = it->second;
-    for (auto scope : scopes) {
-      TRACE(MMINL, 6, "checking visibility usage of members in %s",
-            SHOW(method));
-      change_visibility(method, scope);
-    }
-  });
+  // Each worker only rewrites the code of its own methods; the members and
+  // classes to make public are shared, so they are made public afterwards.
+  auto changes = walk::parallel::methods<VisibilityChanges>(
+      m_scope, [&](DexMethod* method, VisibilityChanges* acc) {
+        auto code = method->get_code();
+        if (code == nullptr) {
+          return;
+        }
+        auto it = m_delayed_change_visibilities->find(method);
+        if (it == m_delayed_change_visibilities->end()) {
+          return;
+        }
+        auto& scopes = it->second;
+        for (auto scope : scopes) {
+          TRACE(MMINL, 6, "checking visibility usage of members in %s",
+                SHOW(method));
+          acc->insert(get_visibility_changes(code, scope, method));
+        }
+      });
+  changes.apply();
 }
 
 void MultiMethodInliner::delayed_invoke_direct_to_static() {
@@ -23,6 +23,7 @@
 #include "IPConstantPropagationAnalysis.h"
 #include "IRCode.h"
 #include "InlineForSpeed.h"
+#include "InlinerCostCache.h"
 #include "LocalDce.h"
 #include "MethodProfiles.h"
 #include "PatriciaTreeSet.h"
@@ -146,7 +147,8 @@ class MultiMethodInliner {
       const std::unordered_map<const DexMethod*, size_t>*
           same_method_implementations = nullptr,
       bool analyze_and_prune_inits = false,
-      const std::unordered_set<DexMethodRef*>& configured_pure_methods = {});
+      const std::unordered_set<DexMethodRef*>& configured_pure_methods = {},
+      inliner::CostCache* cost_cache = nullptr);
 
   ~MultiMethodInliner() { delayed_invoke_direct_to_static(); }
 
@@ -399,6 +401,21 @@ class MultiMethodInliner {
    */
   void compute_callee_constant_arguments();
 
+  /**
+   * Process the callers level by level, starting with the methods that are
+   * not callers, see InlinerConfig::wave_scheduling.
+   */
+  void inline_methods_in_waves(
+      const std::vector<size_t>& ordered_stack_depths,
+      const CallerNonrecursiveCalleesByStackDepth&
+          caller_nonrecursive_callees_by_stack_depth);
+
+  /**
+   * Inline into (if it is a caller), shrink, and pre-compute the caches of
+   * (if it is a callee) a method of the current wave.
+   */
+  void wave_process_method(DexMethod* method);
+
   /**
    * Initiate post-processing a method asynchronously.
    */
@@ -588,6 +605,10 @@ class MultiMethodInliner {
     size_t max_call_stack_depth{0};
     size_t waited_seconds{0};
     int critical_path_length{0};
+    // With wave scheduling, the number of methods processed in each wave.
+    std::vector<size_t> wave_sizes;
+    // With a profile-guided size budget, the number of call sites selected.
+    size_t profile_guided_call_sites{0};
 
     // statistics that may be incremented concurrently
     std::atomic<size_t> calls_inlined{0};
@@ -621,7 +642,7 @@ class MultiMethodInliner {
 
   const MultiMethodInlinerMode m_mode;
 
-  const InlineForSpeed m_inline_for_speed;
+  InlineForSpeed m_inline_for_speed;
 
   // Represents the size of the largest same-method-implementation group that a
   // method belongs in; the default value is 1.
@@ -634,6 +655,9 @@ class MultiMethodInliner {
   // can be safely inlined, and don't inline them otherwise.
   bool m_analyze_and_prune_inits;
 
+  // Optional cache of inlined cost estimates shared with other inliner runs.
+  inliner::CostCache* m_cost_cache;
+
   std::unique_ptr<cse_impl::SharedState> m_cse_shared_state;
 
  public:
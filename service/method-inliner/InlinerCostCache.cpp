@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "InlinerCostCache.h"
+
+#include <unordered_map>
+
+#include "ControlFlow.h"
+#include "IRCode.h"
+#include "IRInstruction.h"
+
+namespace inliner {
+
+uint64_t CostCache::fingerprint(const IRCode* code) {
+  size_t hash = code->get_registers_size();
+  if (code->cfg_built()) {
+    const auto& cfg = code->cfg();
+    for (auto* block : cfg.blocks()) {
+      boost::hash_combine(hash, block->id());
+      for (const auto& mie : InstructionIterable(block)) {
+        boost::hash_combine(hash, mie.insn->hash());
+      }
+      for (auto* edge : block->succs()) {
+        boost::hash_combine(hash, edge->type());
+        boost::hash_combine(hash, edge->target()->id());
+        if (edge->case_key()) {
+          boost::hash_combine(hash, *edge->case_key());
+        }
+      }
+    }
+    return hash;
+  }
+  // Branch targets are identified by the position of their branch.
+  std::unordered_map<const IRInstruction*, size_t> insn_indices;
+  for (const auto& mie : InstructionIterable(code)) {
+    insn_indices.emplace(mie.insn, insn_indices.size());
+  }
+  for (const auto& mie : *code) {
+    switch (mie.type) {
+    case MFLOW_OPCODE:
+      boost::hash_combine(hash, mie.insn->hash());
+      break;
+    case MFLOW_TARGET:
+      boost::hash_combine(hash, mie.target->type);
+      boost::hash_combine(hash, insn_indices.at(mie.target->src->insn));
+      if (mie.target->type == BRANCH_MULTI) {
+        boost::hash_combine(hash, mie.target->case_key);
+      }
+      break;
+    case MFLOW_TRY:
+    case MFLOW_CATCH:
+      boost::hash_combine(hash, mie.type);
+      break;
+    default:
+      break;
+    }
+  }
+  return hash;
+}
+
+boost::optional<CostCache::Cost> CostCache::get(
+    const DexMethod* callee,
+    uint64_t fingerprint,
+    const std::string& arguments_key) {
+  auto entry = m_entries.get(Key(callee, arguments_key), boost::none);
+  if (!entry || entry->fingerprint != fingerprint) {
+    ++m_misses;
+    return boost::none;
+  }
+  ++m_hits;
+  return entry->cost;
+}
+
+void CostCache::put(const DexMethod* callee,
+                    uint64_t fingerprint,
+                    const std::string& arguments_key,
+                    const Cost& cost) {
+  m_entries.update(Key(callee, arguments_key),
+                   [&](const Key&, boost::optional<Entry>& entry, bool) {
+                     entry = Entry{fingerprint, cost};
+                   });
+}
+
+CostCache& shared_cost_cache() {
+  static CostCache cache;
+  return cache;
+}
+
+} // namespace inliner
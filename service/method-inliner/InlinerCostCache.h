@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include <boost/functional/hash.hpp>
+#include <boost/optional.hpp>
+
+#include "ConcurrentContainers.h"
+
+class DexMethod;
+class IRCode;
+
+namespace inliner {
+
+/*
+ * Caches the estimated inlined cost of callees, with and without particular
+ * constant arguments, across all the inliner runs of a Redex invocation,
+ * e.g. MethodInlinePass, IntraDexInlinePass and PerfMethodInlinePass.
+ *
+ * Estimating the cost of a callee for a set of constant arguments runs the
+ * constant propagation over the callee, and the same callees tend to be
+ * estimated by every inliner run. Each entry records a fingerprint of the
+ * callee's code, so that entries of callees whose code has changed since are
+ * ignored and replaced.
+ *
+ * All operations are thread-safe.
+ */
+class CostCache {
+ public:
+  struct Cost {
+    size_t cost;
+    size_t dead_blocks;
+  };
+
+  // A hash of :code, including its control-flow structure, that changes
+  // whenever the cost estimate of the code may change.
+  static uint64_t fingerprint(const IRCode* code);
+
+  // The cost recorded for :callee with code :fingerprint and constant
+  // arguments :arguments_key, which is the empty string when no arguments are
+  // known.
+  boost::optional<Cost> get(const DexMethod* callee,
+                            uint64_t fingerprint,
+                            const std::string& arguments_key);
+
+  void put(const DexMethod* callee,
+           uint64_t fingerprint,
+           const std::string& arguments_key,
+           const Cost& cost);
+
+  size_t hits() const { return m_hits; }
+  size_t misses() const { return m_misses; }
+
+ private:
+  using Key = std::pair<const DexMethod*, std::string>;
+
+  struct Entry {
+    uint64_t fingerprint;
+    Cost cost;
+  };
+
+  ConcurrentMap<Key, boost::optional<Entry>, boost::hash<Key>> m_entries;
+  std::atomic<size_t> m_hits{0};
+  std::atomic<size_t> m_misses{0};
+};
+
+/*
+ * The cache shared by all inliner runs.
+ */
+CostCache& shared_cost_cache();
+
+} // namespace inliner
@@ -13,6 +13,8 @@
 #include <string>
 #include <vector>
 
+#include "CallDepth.h"
+#include "CallGraph.h"
 #include "ClassHierarchy.h"
 #include "Deleter.h"
 #include "DexClass.h"
@@ -112,7 +114,7 @@ std::unordered_set<DexMethod*> gather_non_virtual_methods(Scope& scope,
  */
 std::unordered_map<const DexMethod*, DexMethod*> get_same_implementation_map(
     const Scope& scope,
-    const mog::Graph& method_override_graph,
+    const mog::CompactGraph& method_override_graph,
     std::unordered_map<const DexMethod*, size_t>* same_method_implementations) {
   std::unordered_map<const DexMethod*, DexMethod*> method_to_implementations;
   walk::methods(scope, [&](DexMethod* method) {
@@ -195,8 +197,15 @@ void gather_true_virtual_methods(
     CalleeCallerInsns* true_virtual_callers,
     std::unordered_set<DexMethod*>* methods,
     std::unordered_map<const DexMethod*, size_t>* same_method_implementations) {
-  auto method_override_graph = mog::build_graph(scope);
-  auto non_virtual = mog::get_non_true_virtuals(*method_override_graph, scope);
+  std::unique_ptr<const mog::CompactGraph> method_override_graph;
+  std::unordered_set<DexMethod*> non_virtual;
+  {
+    auto graph = mog::build_graph(scope);
+    non_virtual = mog::get_non_true_virtuals(*graph, scope);
+    // All remaining queries are traversals, which are cheaper on the compact
+    // form.
+    method_override_graph = std::make_unique<const mog::CompactGraph>(*graph);
+  }
   auto same_implementation_map = get_same_implementation_map(
       scope, *method_override_graph, same_method_implementations);
   std::unordered_set<DexMethod*> non_virtual_set{non_virtual.begin(),
@@ -341,8 +350,39 @@ void run_inliner(DexStoresVector& stores,
     gather_true_virtual_methods(scope, &true_virtual_callers, &methods,
                                 &same_method_implementations);
   }
+  if (inliner_config.max_inline_call_depth > 0) {
+    auto depths =
+        call_depth::compute(scope, call_graph::complete_call_graph(scope));
+    size_t too_deep = 0;
+    auto is_too_deep = [&](const DexMethod* callee) {
+      auto it = depths.find(callee);
+      return it != depths.end() &&
+             it->second > inliner_config.max_inline_call_depth;
+    };
+    for (auto it = methods.begin(); it != methods.end();) {
+      if (is_too_deep(*it)) {
+        it = methods.erase(it);
+        too_deep++;
+      } else {
+        ++it;
+      }
+    }
+    for (auto it = true_virtual_callers.begin();
+         it != true_virtual_callers.end();) {
+      if (is_too_deep(it->first)) {
+        it = true_virtual_callers.erase(it);
+        too_deep++;
+      } else {
+        ++it;
+      }
+    }
+    TRACE(INLINE, 2, "%zu candidates make calls deeper than %zu", too_deep,
+          inliner_config.max_inline_call_depth);
+    mgr.incr_metric("candidates_over_max_call_depth", too_deep);
+  }
+
   // keep a map from refs to defs or nullptr if no method was found
-  MethodRefCache resolved_refs;
+  ConcurrentMethodRefCache resolved_refs;
   auto resolver = [&resolved_refs](DexMethodRef* method, MethodSearch search) {
     return resolve_method(method, search, resolved_refs);
   };
@@ -357,7 +397,8 @@ void run_inliner(DexStoresVector& stores,
                              intra_dex ? IntraDex : InterDex,
                              true_virtual_callers, &method_profiles,
                              &same_method_implementations,
-                             analyze_and_prune_inits, conf.get_pure_methods());
+                             analyze_and_prune_inits, conf.get_pure_methods(),
+                             &shared_cost_cache());
   inliner.inline_methods();
 
   if (inliner_config.use_cfg_inliner) {
@@ -445,6 +486,20 @@ void run_inliner(DexStoresVector& stores,
       inliner.get_info().constant_invoke_callees_unreachable_blocks);
   mgr.incr_metric("critical_path_length",
                   inliner.get_info().critical_path_length);
+  mgr.incr_metric("profile_guided_call_sites",
+                  inliner.get_info().profile_guided_call_sites);
+  // Cumulative over all inliner runs so far.
+  mgr.set_metric("cost_cache_hits", shared_cost_cache().hits());
+  mgr.set_metric("cost_cache_misses", shared_cost_cache().misses());
+  const auto& wave_sizes = inliner.get_info().wave_sizes;
+  if (!wave_sizes.empty()) {
+    mgr.incr_metric("waves", wave_sizes.size());
+    mgr.incr_metric("max_wave_size",
+                    *std::max_element(wave_sizes.begin(), wave_sizes.end()));
+    for (size_t i = 0; i < wave_sizes.size(); ++i) {
+      mgr.incr_metric("wave_" + std::to_string(i) + "_size", wave_sizes[i]);
+    }
+  }
   mgr.incr_metric("methods_shrunk", inliner.get_methods_shrunk());
   mgr.incr_metric("callers", inliner.get_callers());
   mgr.incr_metric("delayed_shrinking_callees",
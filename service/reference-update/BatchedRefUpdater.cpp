@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "BatchedRefUpdater.h"
+
+#include <mutex>
+
+#include "DexAnnotation.h"
+#include "IRCode.h"
+#include "Resolver.h"
+#include "Show.h"
+#include "Trace.h"
+#include "Walkers.h"
+
+namespace reference_update {
+
+void BatchedRefUpdater::update_calls(DexMethod* old_callee,
+                                     DexMethod* new_callee) {
+  m_callees[old_callee] = new_callee;
+}
+
+void BatchedRefUpdater::update_field_refs(DexField* old_field,
+                                          DexFieldRef* new_field) {
+  m_fields[old_field] = new_field;
+}
+
+void BatchedRefUpdater::update_type_refs(DexType* old_type,
+                                         DexType* new_type) {
+  m_types[old_type] = new_type;
+}
+
+DexType* BatchedRefUpdater::new_type(DexType* type) const {
+  if (m_types.empty()) {
+    return nullptr;
+  }
+  auto it = m_types.find(const_cast<DexType*>(
+      type::get_element_type_if_array(type)));
+  if (it == m_types.end()) {
+    return nullptr;
+  }
+  auto level = type::get_array_level(type);
+  return level == 0 ? it->second : type::make_array_type(it->second, level);
+}
+
+DexMethodRef* BatchedRefUpdater::new_method(DexMethodRef* method) const {
+  if (m_callees.empty()) {
+    return nullptr;
+  }
+  auto def = resolve_method(method, MethodSearch::Any);
+  if (def == nullptr) {
+    return nullptr;
+  }
+  auto it = m_callees.find(def);
+  return it == m_callees.end() ? nullptr : it->second;
+}
+
+DexFieldRef* BatchedRefUpdater::new_field(DexFieldRef* field) const {
+  if (m_fields.empty()) {
+    return nullptr;
+  }
+  auto def = resolve_field(field);
+  if (def == nullptr) {
+    return nullptr;
+  }
+  auto it = m_fields.find(def);
+  return it == m_fields.end() ? nullptr : it->second;
+}
+
+BatchedRefUpdater::Stats BatchedRefUpdater::update_code(
+    DexMethod* method) const {
+  Stats stats;
+  auto code = method->get_code();
+  if (code == nullptr) {
+    return stats;
+  }
+  for (auto& mie : InstructionIterable(code)) {
+    auto insn = mie.insn;
+    if (insn->has_method() && !m_callees.empty()) {
+      auto callee =
+          resolve_method(insn->get_method(), opcode_to_search(insn), method);
+      auto it = callee == nullptr ? m_callees.end() : m_callees.find(callee);
+      if (it == m_callees.end()) {
+        continue;
+      }
+      auto new_callee = it->second;
+      // At this point, a non static private should not exist.
+      always_assert_log(!is_private(new_callee) || is_static(new_callee),
+                        "%s\n", vshow(new_callee).c_str());
+      TRACE(REFU, 9, " Updated call %s to %s", SHOW(insn), SHOW(new_callee));
+      insn->set_method(new_callee);
+      if (new_callee->is_virtual()) {
+        always_assert_log(is_invoke_virtual(insn->opcode()),
+                          "invalid callsite %s\n", SHOW(insn));
+      } else if (is_static(new_callee)) {
+        always_assert_log(is_invoke_static(insn->opcode()),
+                          "invalid callsite %s\n", SHOW(insn));
+      }
+      ++stats.insns;
+    } else if (insn->has_field()) {
+      if (auto field = new_field(insn->get_field())) {
+        TRACE(REFU, 9, " Updated field ref %s to %s", SHOW(insn),
+              SHOW(field));
+        insn->set_field(field);
+        ++stats.insns;
+      }
+    } else if (insn->has_type()) {
+      if (auto type = new_type(insn->get_type())) {
+        TRACE(REFU, 9, " Updated type ref %s to %s", SHOW(insn), SHOW(type));
+        insn->set_type(type);
+        ++stats.insns;
+      }
+    }
+  }
+  return stats;
+}
+
+size_t BatchedRefUpdater::update_encoded_value(DexEncodedValue* value) const {
+  size_t updated = 0;
+  switch (value->evtype()) {
+  case DEVT_TYPE: {
+    auto type_value = static_cast<DexEncodedValueType*>(value);
+    if (auto type = new_type(type_value->type())) {
+      type_value->set_type(type);
+      ++updated;
+    }
+    break;
+  }
+  case DEVT_FIELD:
+  case DEVT_ENUM: {
+    auto field_value = static_cast<DexEncodedValueField*>(value);
+    if (auto field = new_field(field_value->field())) {
+      field_value->set_field(field);
+      ++updated;
+    }
+    break;
+  }
+  case DEVT_METHOD: {
+    auto method_value = static_cast<DexEncodedValueMethod*>(value);
+    if (auto method = new_method(method_value->method())) {
+      method_value->set_method(method);
+      ++updated;
+    }
+    break;
+  }
+  case DEVT_ARRAY:
+    for (auto element : *static_cast<DexEncodedValueArray*>(value)->evalues()) {
+      updated += update_encoded_value(element);
+    }
+    break;
+  case DEVT_ANNOTATION: {
+    auto anno_value = static_cast<DexEncodedValueAnnotation*>(value);
+    if (auto type = new_type(anno_value->type())) {
+      anno_value->set_type(type);
+      ++updated;
+    }
+    for (const auto& elem : *anno_value->annotations()) {
+      updated += update_encoded_value(elem.encoded_value);
+    }
+    break;
+  }
+  default:
+    break;
+  }
+  return updated;
+}
+
+BatchedRefUpdater::Stats BatchedRefUpdater::update_annotation(
+    DexAnnotation* anno) const {
+  Stats stats;
+  if (auto type = new_type(anno->type())) {
+    anno->set_type(type);
+    ++stats.annotations;
+  }
+  for (const auto& elem : anno->anno_elems()) {
+    stats.encoded_values += update_encoded_value(elem.encoded_value);
+  }
+  return stats;
+}
+
+BatchedRefUpdater::Stats BatchedRefUpdater::apply(const Scope& scope) const {
+  Stats total;
+  if (empty()) {
+    return total;
+  }
+  std::mutex total_mutex;
+  walk::parallel::classes(scope, [&](DexClass* cls) {
+    Stats stats;
+    auto update_anno_set = [&](DexAnnotationSet* anno_set) {
+      if (anno_set == nullptr) {
+        return;
+      }
+      for (auto anno : anno_set->get_annotations()) {
+        stats += update_annotation(anno);
+      }
+    };
+    update_anno_set(cls->get_anno_set());
+    for (auto fields : {&cls->get_sfields(), &cls->get_ifields()}) {
+      for (auto field : *fields) {
+        update_anno_set(field->get_anno_set());
+        if (auto value = field->get_static_value()) {
+          stats.encoded_values += update_encoded_value(value);
+        }
+      }
+    }
+    for (auto methods : {&cls->get_dmethods(), &cls->get_vmethods()}) {
+      for (auto method : *methods) {
+        update_anno_set(method->get_anno_set());
+        if (auto param_anno = method->get_param_anno()) {
+          for (const auto& it : *param_anno) {
+            update_anno_set(it.second);
+          }
+        }
+        stats += update_code(method);
+      }
+    }
+    std::lock_guard<std::mutex> lock(total_mutex);
+    total += stats;
+  });
+  return total;
+}
+
+} // namespace reference_update
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <unordered_map>
+
+#include "DexClass.h"
+
+namespace reference_update {
+
+/**
+ * Accumulates method, field and type remappings from any number of rewrites,
+ * and then applies all of them in a single parallel walk over the scope,
+ * instead of one walk per rewrite. The walk covers instruction operands,
+ * annotations (including nested encoded annotations and arrays) and the
+ * encoded static values of fields.
+ *
+ * This only updates references. Definitions whose signature mentions a
+ * remapped type still go through type_reference::TypeRefUpdater or
+ * update_method_signature_type_references, which deal with collisions.
+ *
+ * The remappings are not chained: if A maps to B and B to C, references to A
+ * end up as B.
+ */
+class BatchedRefUpdater final {
+ public:
+  struct Stats {
+    size_t insns{0};
+    size_t encoded_values{0};
+    size_t annotations{0};
+
+    Stats& operator+=(const Stats& that) {
+      insns += that.insns;
+      encoded_values += that.encoded_values;
+      annotations += that.annotations;
+      return *this;
+    }
+  };
+
+  /**
+   * Invokes that resolve to `old_callee` call `new_callee` instead, as with
+   * method_reference::update_call_refs_simple. Encoded method values that
+   * name `old_callee` are updated as well.
+   */
+  void update_calls(DexMethod* old_callee, DexMethod* new_callee);
+
+  /**
+   * Field accesses and encoded field values that refer to `old_field`, or to
+   * a ref that resolves to it, refer to `new_field` instead.
+   */
+  void update_field_refs(DexField* old_field, DexFieldRef* new_field);
+
+  /**
+   * Type operands of instructions, encoded type values and annotation types
+   * that are `old_type`, or arrays of it, become `new_type` (or arrays of
+   * it).
+   */
+  void update_type_refs(DexType* old_type, DexType* new_type);
+
+  bool empty() const {
+    return m_callees.empty() && m_fields.empty() && m_types.empty();
+  }
+
+  /**
+   * Applies all the accumulated remappings to the scope.
+   */
+  Stats apply(const Scope& scope) const;
+
+ private:
+  DexType* new_type(DexType* type) const;
+  DexMethodRef* new_method(DexMethodRef* method) const;
+  DexFieldRef* new_field(DexFieldRef* field) const;
+  Stats update_code(DexMethod* method) const;
+  Stats update_annotation(DexAnnotation* anno) const;
+  size_t update_encoded_value(DexEncodedValue* value) const;
+
+  std::unordered_map<DexMethod*, DexMethod*> m_callees;
+  std::unordered_map<DexField*, DexFieldRef*> m_fields;
+  std::unordered_map<DexType*, DexType*> m_types;
+};
+
+} // namespace reference_update
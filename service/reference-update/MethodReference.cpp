@@ -7,6 +7,7 @@
 
 #include "MethodReference.h"
 
+#include "BatchedRefUpdater.h"
 #include "Resolver.h"
 #include "Walkers.h"
 
@@ -85,40 +86,11 @@ void patch_callsite(const CallSite& callsite, const NewCallee& new_callee) {
 void update_call_refs_simple(
     const Scope& scope,
     const std::unordered_map<DexMethod*, DexMethod*>& old_to_new_callee) {
-  if (old_to_new_callee.empty()) {
-    return;
+  reference_update::BatchedRefUpdater updater;
+  for (const auto& pair : old_to_new_callee) {
+    updater.update_calls(pair.first, pair.second);
   }
-
-  auto patcher = [&](DexMethod* meth, IRCode& code) {
-    for (auto& mie : InstructionIterable(code)) {
-      auto insn = mie.insn;
-      if (!insn->has_method()) {
-        continue;
-      }
-      const auto method =
-          resolve_method(insn->get_method(), opcode_to_search(insn), meth);
-      if (method == nullptr || old_to_new_callee.count(method) == 0) {
-        continue;
-      }
-      auto new_callee = old_to_new_callee.at(method);
-      // At this point, a non static private should not exist.
-      always_assert_log(!is_private(new_callee) || is_static(new_callee),
-                        "%s\n",
-                        vshow(new_callee).c_str());
-      TRACE(REFU, 9, " Updated call %s to %s", SHOW(insn), SHOW(new_callee));
-      insn->set_method(new_callee);
-      if (new_callee->is_virtual()) {
-        always_assert_log(is_invoke_virtual(insn->opcode()),
-                          "invalid callsite %s\n",
-                          SHOW(insn));
-      } else if (is_static(new_callee)) {
-        always_assert_log(is_invoke_static(insn->opcode()),
-                          "invalid callsite %s\n",
-                          SHOW(insn));
-      }
-    }
-  };
-  walk::parallel::code(scope, patcher);
+  updater.apply(scope);
 }
 
 template <typename T>
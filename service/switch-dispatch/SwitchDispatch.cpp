@@ -7,7 +7,9 @@
 
 #include "SwitchDispatch.h"
 
+#include <algorithm>
 #include <cmath>
+#include <vector>
 
 #include "Creators.h"
 #include "TypeReference.h"
@@ -211,6 +213,48 @@ size_t estimate_num_switch_dispatch_needed(
   return 1;
 }
 
+/**
+ * Splits the sorted cases of a large dispatch into runs of at most
+ * `max_leaf_size` cases, one for each leaf switch. Instead of always cutting
+ * at `max_leaf_size`, a run ends at the widest gap between two consecutive type
+ * tags among the last quarter of its possible ends. The leaves then tend to
+ * cover dense ranges of tags, which lower to packed switches (a table lookup at
+ * runtime) rather than sparse ones (a binary search). When the tags are dense
+ * already, the runs are all of `max_leaf_size` cases.
+ *
+ * Returns the number of cases of each leaf.
+ */
+std::vector<size_t> partition_leaf_cases(
+    const std::map<SwitchIndices, MethodBlock*>& cases,
+    const size_t max_leaf_size) {
+  std::vector<int64_t> first_keys;
+  std::vector<int64_t> last_keys;
+  for (auto& case_it : cases) {
+    first_keys.push_back(*case_it.first.begin());
+    last_keys.push_back(*case_it.first.rbegin());
+  }
+  size_t min_leaf_size = std::max<size_t>(1, max_leaf_size - max_leaf_size / 4);
+  std::vector<size_t> leaf_sizes;
+  size_t begin = 0;
+  while (cases.size() - begin > max_leaf_size) {
+    size_t best_size = max_leaf_size;
+    int64_t best_gap = -1;
+    for (size_t size = max_leaf_size; size >= min_leaf_size; --size) {
+      int64_t gap = first_keys[begin + size] - last_keys[begin + size - 1];
+      if (gap > best_gap) {
+        best_gap = gap;
+        best_size = size;
+      }
+    }
+    leaf_sizes.push_back(best_size);
+    begin += best_size;
+  }
+  if (begin < cases.size()) {
+    leaf_sizes.push_back(cases.size() - begin);
+  }
+  return leaf_sizes;
+}
+
 /**
  * Create a simple single level switch based dispatch method.
  * We here construct a leaf level dispatch assuming all targets are dedupped.
@@ -286,17 +330,16 @@ dispatch::DispatchMethod create_two_level_switch_dispatch(
   mb->ret(spec.proto->get_rtype(), ret_loc);
 
   size_t max_num_leaf_switch = cases.size() / num_switch_needed + 1;
+  auto leaf_sizes = partition_leaf_cases(cases, max_num_leaf_switch);
   std::map<SwitchIndices, DexMethod*> sub_indices_to_callee;
   std::vector<DexMethod*> sub_dispatches;
   size_t dispatch_index = 0;
-  size_t case_index = 0;
   size_t subcase_count = 0;
   for (auto& case_it : cases) {
     sub_indices_to_callee[case_it.first] = indices_to_callee.at(case_it.first);
     subcase_count++;
 
-    if (subcase_count == max_num_leaf_switch ||
-        case_index == cases.size() - 1) {
+    if (subcase_count == leaf_sizes[dispatch_index]) {
       auto sub_name = spec.name + "$" + std::to_string(dispatch_index);
       auto new_arg_list =
           prepend_and_make(spec.proto->get_args(), spec.owner_type);
@@ -324,8 +367,6 @@ dispatch::DispatchMethod create_two_level_switch_dispatch(
       dispatch_index++;
       subcase_count = 0;
     }
-
-    case_index++;
   }
 
   auto dispatch_meth = materialize_dispatch(orig_method, mc);
@@ -114,14 +114,34 @@ ArgumentTypePartition GlobalTypeAnalyzer::analyze_edge(
 
 std::unique_ptr<local::LocalTypeAnalyzer>
 GlobalTypeAnalyzer::get_local_analysis(const DexMethod* method) const {
-  auto args = ArgumentTypePartition::bottom();
+  auto args = ArgumentTypeEnvironment::bottom();
 
-  if (m_call_graph.has_node(method)) {
-    args = this->get_entry_state_at(m_call_graph.node(method));
+  if (m_compacted) {
+    auto it = m_method_args.find(method);
+    if (it != m_method_args.end()) {
+      args = it->second;
+    }
+  } else if (m_call_graph.has_node(method)) {
+    args = this->get_entry_state_at(m_call_graph.node(method))
+               .get(CURRENT_PARTITION_LABEL);
   }
-  return analyze_method(method,
-                        this->get_whole_program_state(),
-                        args.get(CURRENT_PARTITION_LABEL));
+  return analyze_method(method, this->get_whole_program_state(), args);
+}
+
+void GlobalTypeAnalyzer::compact(const Scope& scope) {
+  always_assert(!m_compacted);
+  walk::methods(scope, [&](DexMethod* method) {
+    if (method->get_code() == nullptr || !m_call_graph.has_node(method)) {
+      return;
+    }
+    auto args = this->get_entry_state_at(m_call_graph.node(method))
+                    .get(CURRENT_PARTITION_LABEL);
+    if (!args.is_bottom()) {
+      m_method_args.emplace(method, std::move(args));
+    }
+  });
+  this->clear();
+  m_compacted = true;
 }
 
 using CombinedAnalyzer =
@@ -204,6 +224,9 @@ std::unique_ptr<GlobalTypeAnalyzer> GlobalTypeAnalysis::analyze(
         "[global] Finished in %d global iterations (max %d)",
         iteration_cnt,
         m_max_global_analysis_iteration);
+  if (m_compact_results) {
+    gta->compact(scope);
+  }
   return gta;
 }
 
@@ -87,6 +87,14 @@ class GlobalTypeAnalyzer : public sparta::ParallelMonotonicFixpointIterator<
   std::unique_ptr<local::LocalTypeAnalyzer> get_local_analysis(
       const DexMethod*) const;
 
+  /*
+   * Keep only the argument types at the entry of the methods in :scope, and
+   * release the partitions of all call sites, which take up most of the
+   * memory of the analysis. Local analyses are still available afterwards,
+   * but the fixpoint states are not and the analyzer must not be run again.
+   */
+  void compact(const Scope& scope);
+
   const WholeProgramState& get_whole_program_state() const { return *m_wps; }
 
   void set_whole_program_state(std::unique_ptr<WholeProgramState> wps) {
@@ -98,6 +106,8 @@ class GlobalTypeAnalyzer : public sparta::ParallelMonotonicFixpointIterator<
  private:
   std::unique_ptr<const WholeProgramState> m_wps;
   call_graph::Graph m_call_graph;
+  bool m_compacted{false};
+  std::unordered_map<const DexMethod*, ArgumentTypeEnvironment> m_method_args;
 
   std::unique_ptr<local::LocalTypeAnalyzer> analyze_method(
       const DexMethod* method,
@@ -108,8 +118,14 @@ class GlobalTypeAnalyzer : public sparta::ParallelMonotonicFixpointIterator<
 class GlobalTypeAnalysis {
 
  public:
-  explicit GlobalTypeAnalysis(size_t max_global_analysis_iteration = 10)
-      : m_max_global_analysis_iteration(max_global_analysis_iteration) {}
+  /*
+   * With :compact_results, the analyzer that analyze() returns only keeps
+   * summaries, see GlobalTypeAnalyzer::compact().
+   */
+  explicit GlobalTypeAnalysis(size_t max_global_analysis_iteration = 10,
+                              bool compact_results = false)
+      : m_max_global_analysis_iteration(max_global_analysis_iteration),
+        m_compact_results(compact_results) {}
 
   void run(Scope& scope) { analyze(scope); }
 
@@ -120,6 +136,7 @@ class GlobalTypeAnalysis {
 
  private:
   size_t m_max_global_analysis_iteration;
+  bool m_compact_results;
 
   struct Stats {
     size_t resolved_fields{0};
@@ -25,7 +25,11 @@ class LocalTypeAnalyzer final
   LocalTypeAnalyzer(const cfg::ControlFlowGraph& cfg,
                     InstructionAnalyzer<DexTypeEnvironment> insn_analyer)
       : ir_analyzer::BaseIRAnalyzer<DexTypeEnvironment>(cfg),
-        m_insn_analyzer(std::move(insn_analyer)) {}
+        m_insn_analyzer(std::move(insn_analyer)) {
+    // Like the type domains, WholeProgramState is read-only here, so huge
+    // methods can be analyzed on several threads.
+    set_parallel_threshold(PARALLEL_FIXPOINT_MIN_NODES);
+  }
 
   void analyze_instruction(const IRInstruction* insn,
                            DexTypeEnvironment* current_state) const override;
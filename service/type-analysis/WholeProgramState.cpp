@@ -130,6 +130,24 @@ void analyze_clinits_and_ctors(const Scope& scope,
   }
 }
 
+/*
+ * Join :type into the binding of :key as soon as it is collected, so that we
+ * don't hold on to the contribution of every instruction.
+ */
+template <typename Key>
+void join_into(ConcurrentMap<const Key*, DexTypeDomain>* map,
+               const Key* key,
+               const DexTypeDomain& type) {
+  map->update(key,
+              [&type](const Key*, DexTypeDomain& current, bool exists) {
+                if (exists) {
+                  current.join_with(type);
+                } else {
+                  current = type;
+                }
+              });
+}
+
 bool analyze_gets_helper(const WholeProgramState* whole_program_state,
                          const IRInstruction* insn,
                          DexTypeEnvironment* env) {
@@ -189,8 +207,8 @@ WholeProgramState::WholeProgramState(
 
 void WholeProgramState::collect(const Scope& scope,
                                 const global::GlobalTypeAnalyzer& gta) {
-  ConcurrentMap<const DexField*, std::vector<DexTypeDomain>> fields_tmp;
-  ConcurrentMap<const DexMethod*, std::vector<DexTypeDomain>> methods_tmp;
+  ConcurrentMap<const DexField*, DexTypeDomain> fields_tmp;
+  ConcurrentMap<const DexMethod*, DexTypeDomain> methods_tmp;
   walk::parallel::methods(scope, [&](DexMethod* method) {
     IRCode* code = method->get_code();
     if (code == nullptr) {
@@ -209,25 +227,23 @@ void WholeProgramState::collect(const Scope& scope,
     }
   });
   for (const auto& pair : fields_tmp) {
-    for (auto& type : pair.second) {
-      m_field_partition.update(pair.first, [&type](auto* current_type) {
-        current_type->join_with(type);
-      });
-    }
+    const auto& type = pair.second;
+    m_field_partition.update(pair.first, [&type](auto* current_type) {
+      current_type->join_with(type);
+    });
   }
   for (const auto& pair : methods_tmp) {
-    for (auto& type : pair.second) {
-      m_method_partition.update(pair.first, [&type](auto* current_type) {
-        current_type->join_with(type);
-      });
-    }
+    const auto& type = pair.second;
+    m_method_partition.update(pair.first, [&type](auto* current_type) {
+      current_type->join_with(type);
+    });
   }
 }
 
 void WholeProgramState::collect_field_types(
     const IRInstruction* insn,
     const DexTypeEnvironment& env,
-    ConcurrentMap<const DexField*, std::vector<DexTypeDomain>>* field_tmp) {
+    ConcurrentMap<const DexField*, DexTypeDomain>* field_tmp) {
   if (!is_sput(insn->opcode()) && !is_iput(insn->opcode())) {
     return;
   }
@@ -241,17 +257,14 @@ void WholeProgramState::collect_field_types(
     ss << type;
     TRACE(TYPE, 5, "collecting field %s -> %s", SHOW(field), ss.str().c_str());
   }
-  field_tmp->update(field,
-                    [type](const DexField*,
-                           std::vector<DexTypeDomain>& s,
-                           bool /* exists */) { s.emplace_back(type); });
+  join_into(field_tmp, static_cast<const DexField*>(field), type);
 }
 
 void WholeProgramState::collect_return_types(
     const IRInstruction* insn,
     const DexTypeEnvironment& env,
     const DexMethod* method,
-    ConcurrentMap<const DexMethod*, std::vector<DexTypeDomain>>* method_tmp) {
+    ConcurrentMap<const DexMethod*, DexTypeDomain>* method_tmp) {
   auto op = insn->opcode();
   if (!is_return(op)) {
     return;
@@ -261,18 +274,11 @@ void WholeProgramState::collect_return_types(
     // does indeed return -- even though `void` is not actually a return type,
     // this tells us that the code following any invoke of this method is
     // reachable.
-    method_tmp->update(
-        method,
-        [](const DexMethod*, std::vector<DexTypeDomain>& s, bool /* exists */) {
-          s.emplace_back(DexTypeDomain::top());
-        });
+    join_into(method_tmp, method, DexTypeDomain::top());
     return;
   }
   auto type = env.get(insn->src(0));
-  method_tmp->update(method,
-                     [type](const DexMethod*,
-                            std::vector<DexTypeDomain>& s,
-                            bool /* exists */) { s.emplace_back(type); });
+  join_into(method_tmp, method, type);
 }
 
 std::string WholeProgramState::print_field_partition_diff(
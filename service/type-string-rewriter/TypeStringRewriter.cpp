@@ -7,7 +7,13 @@
 
 #include "TypeStringRewriter.h"
 
+#include <atomic>
+#include <unordered_map>
+#include <vector>
+
+#include "ConcurrentContainers.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 namespace {
 
@@ -113,6 +119,34 @@ DexString* make_array(const DexString* name, uint32_t level) {
   array.append(name->str());
   return DexString::make_string(array);
 }
+
+/*
+ * Applies :fn, which returns the replacement of a string or nullptr, once to
+ * each of the distinct strings of :old_strs, in parallel, and returns the
+ * strings that get replaced. The rewriters first gather the distinct strings
+ * in use and then rewrite all their occurrences from this map, so that each
+ * replacement is looked up and interned only once, however many times the
+ * string occurs.
+ */
+template <typename Fn>
+std::unordered_map<DexString*, DexString*> map_strings(
+    const ConcurrentSet<DexString*>& old_strs, const Fn& fn) {
+  std::vector<DexString*> strs(old_strs.begin(), old_strs.end());
+  std::vector<DexString*> replacements(strs.size());
+  auto wq = workqueue_foreach<size_t>(
+      [&](size_t i) { replacements[i] = fn(strs[i]); });
+  for (size_t i = 0; i < strs.size(); i++) {
+    wq.add_item(i);
+  }
+  wq.run_all();
+  std::unordered_map<DexString*, DexString*> new_strs;
+  for (size_t i = 0; i < strs.size(); i++) {
+    if (replacements[i] != nullptr) {
+      new_strs.emplace(strs[i], replacements[i]);
+    }
+  }
+  return new_strs;
+}
 } // namespace
 
 namespace rewriter {
@@ -164,57 +198,88 @@ void rewrite_dalvik_annotation_signature(const Scope& scope,
                                          const TypeStringMap& mapping) {
   static DexType* dalviksig =
       DexType::get_type("Ldalvik/annotation/Signature;");
-  walk::parallel::annotations(scope, [&](DexAnnotation* anno) {
-    if (anno->type() != dalviksig) return;
-    auto elems = anno->anno_elems();
-    for (auto elem : elems) {
-      auto ev = elem.encoded_value;
-      if (ev->evtype() != DEVT_ARRAY) continue;
-      auto arrayev = static_cast<DexEncodedValueArray*>(ev);
-      auto const& evs = arrayev->evalues();
-      for (auto strev : *evs) {
-        if (strev->evtype() != DEVT_STRING) continue;
-        auto stringev = static_cast<DexEncodedValueString*>(strev);
-        DexString* old_str = stringev->string();
-        DexString* new_str = lookup_signature_annotation(mapping, old_str);
-        if (new_str != nullptr) {
-          TRACE(RENAME, 5, "Rewriting Signature from '%s' to '%s'",
-                old_str->c_str(), new_str->c_str());
-          stringev->string(new_str);
+  auto for_each_signature_string = [&](auto&& fn) {
+    walk::parallel::annotations(scope, [&](DexAnnotation* anno) {
+      if (anno->type() != dalviksig) return;
+      auto elems = anno->anno_elems();
+      for (auto elem : elems) {
+        auto ev = elem.encoded_value;
+        if (ev->evtype() != DEVT_ARRAY) continue;
+        auto arrayev = static_cast<DexEncodedValueArray*>(ev);
+        auto const& evs = arrayev->evalues();
+        for (auto strev : *evs) {
+          if (strev->evtype() != DEVT_STRING) continue;
+          fn(static_cast<DexEncodedValueString*>(strev));
         }
       }
+    });
+  };
+
+  ConcurrentSet<DexString*> old_strs;
+  for_each_signature_string([&](DexEncodedValueString* stringev) {
+    old_strs.insert(stringev->string());
+  });
+  auto new_strs = map_strings(old_strs, [&](DexString* old_str) {
+    return lookup_signature_annotation(mapping, old_str);
+  });
+  if (new_strs.empty()) {
+    return;
+  }
+  for_each_signature_string([&](DexEncodedValueString* stringev) {
+    auto it = new_strs.find(stringev->string());
+    if (it != new_strs.end()) {
+      TRACE(RENAME, 5, "Rewriting Signature from '%s' to '%s'",
+            it->first->c_str(), it->second->c_str());
+      stringev->string(it->second);
     }
   });
 }
 
 uint32_t rewrite_string_literal_instructions(const Scope& scope,
                                              const TypeStringMap& mapping) {
+  ConcurrentSet<DexString*> old_strs;
+  walk::parallel::code(scope, [&](DexMethod*, IRCode& code) {
+    for (const auto& mie : InstructionIterable(code)) {
+      if (mie.insn->opcode() == OPCODE_CONST_STRING) {
+        old_strs.insert(mie.insn->get_string());
+      }
+    }
+  });
+  auto new_strs = map_strings(old_strs, [&](DexString* old_str) -> DexString* {
+    DexString* internal_str = DexString::get_string(
+        java_names::external_to_internal(old_str->str()));
+    if (!internal_str || !DexType::get_type(internal_str)) {
+      return nullptr;
+    }
+    auto new_type_name = mapping.get_new_type_name(internal_str);
+    if (!new_type_name) {
+      return nullptr;
+    }
+    return DexString::make_string(
+        java_names::internal_to_external(new_type_name->str()));
+  });
+  if (new_strs.empty()) {
+    return 0;
+  }
+
   std::atomic<uint32_t> total_updates(0);
-  walk::parallel::code(scope, [&](DexMethod* meth, IRCode& code) {
+  walk::parallel::code(scope, [&](DexMethod*, IRCode& code) {
     for (const auto& mie : InstructionIterable(code)) {
       auto insn = mie.insn;
       if (insn->opcode() != OPCODE_CONST_STRING) {
         continue;
       }
-      DexString* old_str = insn->get_string();
-      DexString* internal_str = DexString::get_string(
-          java_names::external_to_internal(old_str->str()));
-      if (!internal_str || !DexType::get_type(internal_str)) {
-        continue;
-      }
-      auto new_type_name = mapping.get_new_type_name(internal_str);
-      if (!new_type_name) {
+      auto it = new_strs.find(insn->get_string());
+      if (it == new_strs.end()) {
         continue;
       }
-      auto new_str = DexString::make_string(
-          java_names::internal_to_external(new_type_name->str()));
-      insn->set_string(new_str);
+      insn->set_string(it->second);
       total_updates++;
       TRACE(RENAME,
             5,
             "Replace const-string from %s to %s",
-            old_str->c_str(),
-            new_str->c_str());
+            it->first->c_str(),
+            it->second->c_str());
     }
   });
   return total_updates.load();
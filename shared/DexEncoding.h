@@ -11,6 +11,7 @@
 #include <stdexcept>
 
 #include <stdint.h>
+#include <string.h>
 #include <string>
 
 /*
@@ -180,18 +181,69 @@ inline uint32_t mutf8_next_code_point(const char*& s) {
   throw std::invalid_argument("Invalid size encoding mutf8 string");
 }
 
+/*
+ * Returns the number of UTF-16 code units of a mutf8 string. Most strings of
+ * an app are pure ASCII, so eight bytes at a time are skipped as long as none
+ * of them has its high bit set; the remaining code points are decoded (and
+ * validated) one by one.
+ */
 inline uint32_t length_of_utf8_string(const char* s) {
   if (s == nullptr) {
     return 0;
   }
+  const char* end = s + strlen(s);
   uint32_t len = 0;
-  while (*s != '\0') {
+  while (s != end) {
+    if (end - s >= 8) {
+      uint64_t word;
+      memcpy(&word, s, sizeof(word));
+      if ((word & 0x8080808080808080ull) == 0) {
+        len += 8;
+        s += 8;
+        continue;
+      }
+    }
     ++len;
     mutf8_next_code_point(s);
   }
   return len;
 }
 
+/*
+ * Orders mutf8 strings by their UTF-16 code units, as the dex format requires
+ * for the string table.
+ *
+ * The mutf8 encoding of UTF-16 code units preserves their order, apart from
+ * U+0000 which is encoded as two bytes instead of one. Hence the strings only
+ * need to be decoded at the first byte where they differ: the shared prefix
+ * is skipped with a plain byte comparison.
+ */
+inline bool mutf8_less(const char* a, const char* b) {
+  size_t i = 0;
+  while (a[i] == b[i]) {
+    if (a[i] == '\0') {
+      return false;
+    }
+    ++i;
+  }
+  // Back up to the first byte of the code point the strings differ at.
+  while (i > 0 && (static_cast<uint8_t>(a[i]) & 0xc0) == 0x80) {
+    --i;
+  }
+  const char* sa = a + i;
+  const char* sb = b + i;
+  while (true) {
+    if (*sa == '\0' || *sb == '\0') {
+      return *sb != '\0';
+    }
+    uint32_t cpa = mutf8_next_code_point(sa);
+    uint32_t cpb = mutf8_next_code_point(sb);
+    if (cpa != cpb) {
+      return cpa < cpb;
+    }
+  }
+}
+
 // https://docs.oracle.com/javase/8/docs/api/java/lang/String.html#hashCode--
 inline int32_t java_hashcode_of_utf8_string(const char* s) {
   if (s == nullptr) {
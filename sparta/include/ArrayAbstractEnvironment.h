@@ -0,0 +1,580 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <ostream>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "AbstractDomain.h"
+
+namespace sparta {
+
+namespace aae_impl {
+
+template <typename Variable, typename Domain>
+class ArrayValue;
+
+} // namespace aae_impl
+
+/*
+ * An abstract environment (see HashedAbstractEnvironment) over variables that
+ * are small unsigned integers, such as the registers of a method. The
+ * bindings are stored in a flat array indexed by variable, along with a
+ * bitmap of the variables that are bound to a non-Top value, so that:
+ *
+ *   - get() and set() are array accesses;
+ *   - the pointwise operations only visit the bound variables, a word of the
+ *     bitmap at a time, however sparse the bindings are;
+ *   - the array is shared between copies of an environment and only copied
+ *     the first time a shared environment is modified, so that operations on
+ *     environments that are still shared (which is common in a fixpoint
+ *     iteration, where most blocks don't change most registers) are
+ *     constant-time.
+ *
+ * Variables from ArrayValue::kMaxDenseVariable on, such as the
+ * RESULT_REGISTER pseudo-register of Redex, are kept in a small side table.
+ *
+ * As in the other environments, variables that aren't bound are implicitly
+ * bound to Top, and binding a variable to Bottom sets the whole environment to
+ * Bottom. This is a drop-in replacement for PatriciaTreeMapAbstractEnvironment
+ * with register variables, except that bindings() is replaced by visit().
+ */
+template <typename Variable, typename Domain>
+class ArrayAbstractEnvironment final
+    : public AbstractDomainScaffolding<
+          aae_impl::ArrayValue<Variable, Domain>,
+          ArrayAbstractEnvironment<Variable, Domain>> {
+ public:
+  using Value = aae_impl::ArrayValue<Variable, Domain>;
+
+  ~ArrayAbstractEnvironment() {
+    static_assert(std::is_unsigned<Variable>::value,
+                  "Variable is not an unsigned arithmetic type");
+  }
+
+  /*
+   * The default constructor produces the Top value.
+   */
+  ArrayAbstractEnvironment()
+      : AbstractDomainScaffolding<Value, ArrayAbstractEnvironment>() {}
+
+  ArrayAbstractEnvironment(AbstractValueKind kind)
+      : AbstractDomainScaffolding<Value, ArrayAbstractEnvironment>(kind) {}
+
+  ArrayAbstractEnvironment(
+      std::initializer_list<std::pair<Variable, Domain>> l) {
+    for (const auto& p : l) {
+      if (p.second.is_bottom()) {
+        this->set_to_bottom();
+        return;
+      }
+      this->get_value()->insert_binding(p.first, p.second);
+    }
+    this->normalize();
+  }
+
+  bool is_value() const { return this->kind() == AbstractValueKind::Value; }
+
+  // The number of variables bound to a non-Top value.
+  size_t size() const {
+    RUNTIME_CHECK(this->kind() == AbstractValueKind::Value,
+                  invalid_abstract_value()
+                      << expected_kind(AbstractValueKind::Value)
+                      << actual_kind(this->kind()));
+    return this->get_value()->size();
+  }
+
+  // Calls f(variable, value) for each variable bound to a non-Top value, in
+  // increasing order of variables.
+  template <typename F>
+  void visit(F f) const {
+    RUNTIME_CHECK(this->kind() == AbstractValueKind::Value,
+                  invalid_abstract_value()
+                      << expected_kind(AbstractValueKind::Value)
+                      << actual_kind(this->kind()));
+    this->get_value()->visit(f);
+  }
+
+  Domain get(const Variable& variable) const {
+    if (this->is_bottom()) {
+      return Domain::bottom();
+    }
+    const Domain* value = this->get_value()->find(variable);
+    return value == nullptr ? Domain::top() : *value;
+  }
+
+  ArrayAbstractEnvironment& set(const Variable& variable, const Domain& value) {
+    if (this->is_bottom()) {
+      return *this;
+    }
+    if (value.is_bottom()) {
+      this->set_to_bottom();
+      return *this;
+    }
+    this->get_value()->insert_binding(variable, value);
+    this->normalize();
+    return *this;
+  }
+
+  ArrayAbstractEnvironment& update(
+      const Variable& variable,
+      std::function<Domain(const Domain&)> operation) {
+    return set(variable, operation(get(variable)));
+  }
+
+  // Replaces each non-Top binding with f(binding). Returns true if any binding
+  // changed.
+  bool map(std::function<Domain(const Domain&)> f) {
+    if (this->is_bottom()) {
+      return false;
+    }
+    bool changed;
+    if (!this->get_value()->map(f, &changed)) {
+      this->set_to_bottom();
+      return true;
+    }
+    this->normalize();
+    return changed;
+  }
+
+  ArrayAbstractEnvironment& clear() {
+    if (this->is_bottom()) {
+      return *this;
+    }
+    this->get_value()->clear();
+    this->normalize();
+    return *this;
+  }
+
+  static ArrayAbstractEnvironment bottom() {
+    return ArrayAbstractEnvironment(AbstractValueKind::Bottom);
+  }
+
+  static ArrayAbstractEnvironment top() {
+    return ArrayAbstractEnvironment(AbstractValueKind::Top);
+  }
+
+  friend std::ostream& operator<<(std::ostream& o,
+                                  const ArrayAbstractEnvironment& e) {
+    switch (e.kind()) {
+    case AbstractValueKind::Bottom: {
+      o << "_|_";
+      break;
+    }
+    case AbstractValueKind::Top: {
+      o << "T";
+      break;
+    }
+    case AbstractValueKind::Value: {
+      o << "[#" << e.size() << "]{";
+      bool first = true;
+      e.visit([&](const Variable& variable, const Domain& value) {
+        o << (first ? "" : ", ") << variable << " -> " << value;
+        first = false;
+      });
+      o << "}";
+      break;
+    }
+    }
+    return o;
+  }
+};
+
+namespace aae_impl {
+
+/*
+ * The definition of an element of an ArrayAbstractEnvironment. An empty value
+ * stands for Top. The array never holds Bottom, which is handled by the
+ * environment; the meet-like operations return AbstractValueKind::Bottom as
+ * soon as a binding would become Bottom.
+ */
+template <typename Variable, typename Domain>
+class ArrayValue final : public AbstractValue<ArrayValue<Variable, Domain>> {
+ public:
+  using Word = uint64_t;
+  static constexpr size_t kWordBits = 64;
+  static constexpr size_t kMaxDenseVariable = 1 << 16;
+
+  ArrayValue() = default;
+
+  void clear() override { m_storage.reset(); }
+
+  AbstractValueKind kind() const override {
+    return size() == 0 ? AbstractValueKind::Top : AbstractValueKind::Value;
+  }
+
+  size_t size() const { return m_storage ? m_storage->size : 0; }
+
+  // The value bound to :variable, or nullptr if it's Top.
+  const Domain* find(Variable variable) const {
+    if (!m_storage) {
+      return nullptr;
+    }
+    if (variable < kMaxDenseVariable) {
+      return m_storage->is_bound(variable) ? &m_storage->dense[variable]
+                                           : nullptr;
+    }
+    const auto& sparse = m_storage->sparse;
+    auto it = sparse_find(sparse, variable);
+    return it != sparse.end() && it->first == variable ? &it->second
+                                                       : nullptr;
+  }
+
+  template <typename F>
+  void visit(const F& f) const {
+    if (!m_storage) {
+      return;
+    }
+    const auto& bits = m_storage->bits;
+    for (size_t i = 0; i < bits.size(); ++i) {
+      for (Word w = bits[i]; w != 0; w &= w - 1) {
+        size_t variable = i * kWordBits + __builtin_ctzll(w);
+        f((Variable)variable, m_storage->dense[variable]);
+      }
+    }
+    for (const auto& binding : m_storage->sparse) {
+      f(binding.first, binding.second);
+    }
+  }
+
+  bool leq(const ArrayValue& other) const override {
+    if (m_storage == other.m_storage) {
+      return true;
+    }
+    if (!other.m_storage) {
+      return true;
+    }
+    if (!m_storage) {
+      return false;
+    }
+    const auto& mine = *m_storage;
+    const auto& theirs = *other.m_storage;
+    // Every variable that :other binds must be bound here, to a smaller value.
+    for (size_t i = 0; i < theirs.bits.size(); ++i) {
+      Word w = theirs.bits[i];
+      if ((w & ~mine.word(i)) != 0) {
+        return false;
+      }
+      for (; w != 0; w &= w - 1) {
+        size_t variable = i * kWordBits + __builtin_ctzll(w);
+        if (!mine.dense[variable].leq(theirs.dense[variable])) {
+          return false;
+        }
+      }
+    }
+    for (const auto& binding : theirs.sparse) {
+      auto it = sparse_find(mine.sparse, binding.first);
+      if (it == mine.sparse.end() || it->first != binding.first ||
+          !it->second.leq(binding.second)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool equals(const ArrayValue& other) const override {
+    if (m_storage == other.m_storage) {
+      return true;
+    }
+    if (size() != other.size()) {
+      return false;
+    }
+    if (size() == 0) {
+      return true;
+    }
+    const auto& mine = *m_storage;
+    const auto& theirs = *other.m_storage;
+    size_t words = std::max(mine.bits.size(), theirs.bits.size());
+    for (size_t i = 0; i < words; ++i) {
+      Word w = mine.word(i);
+      if (w != theirs.word(i)) {
+        return false;
+      }
+      for (; w != 0; w &= w - 1) {
+        size_t variable = i * kWordBits + __builtin_ctzll(w);
+        if (!mine.dense[variable].equals(theirs.dense[variable])) {
+          return false;
+        }
+      }
+    }
+    if (mine.sparse.size() != theirs.sparse.size()) {
+      return false;
+    }
+    for (size_t i = 0; i < mine.sparse.size(); ++i) {
+      if (mine.sparse[i].first != theirs.sparse[i].first ||
+          !mine.sparse[i].second.equals(theirs.sparse[i].second)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  AbstractValueKind join_with(const ArrayValue& other) override {
+    return join_like_operation(
+        other, [](Domain* x, const Domain& y) { x->join_with(y); });
+  }
+
+  AbstractValueKind widen_with(const ArrayValue& other) override {
+    return join_like_operation(
+        other, [](Domain* x, const Domain& y) { x->widen_with(y); });
+  }
+
+  AbstractValueKind meet_with(const ArrayValue& other) override {
+    return meet_like_operation(
+        other, [](Domain* x, const Domain& y) { x->meet_with(y); });
+  }
+
+  AbstractValueKind narrow_with(const ArrayValue& other) override {
+    return meet_like_operation(
+        other, [](Domain* x, const Domain& y) { x->narrow_with(y); });
+  }
+
+ private:
+  using SparseBindings = std::vector<std::pair<Variable, Domain>>;
+
+  struct Storage {
+    // Only the entries whose bit is set are meaningful.
+    std::vector<Domain> dense;
+    std::vector<Word> bits;
+    // Sorted by variable.
+    SparseBindings sparse;
+    size_t size{0};
+
+    Word word(size_t i) const { return i < bits.size() ? bits[i] : 0; }
+
+    bool is_bound(size_t variable) const {
+      return (word(variable / kWordBits) & bit(variable)) != 0;
+    }
+
+    void bind(size_t variable, const Domain& value) {
+      if (variable >= dense.size()) {
+        dense.resize(variable + 1);
+        bits.resize(variable / kWordBits + 1);
+      }
+      dense[variable] = value;
+      if (!is_bound(variable)) {
+        bits[variable / kWordBits] |= bit(variable);
+        ++size;
+      }
+    }
+
+    void unbind(size_t variable) {
+      if (is_bound(variable)) {
+        bits[variable / kWordBits] &= ~bit(variable);
+        dense[variable] = Domain();
+        --size;
+      }
+    }
+  };
+
+  static Word bit(size_t variable) {
+    return Word(1) << (variable % kWordBits);
+  }
+
+  template <typename Bindings>
+  static auto sparse_find(Bindings& sparse, Variable variable)
+      -> decltype(sparse.begin()) {
+    return std::lower_bound(
+        sparse.begin(), sparse.end(), variable,
+        [](const std::pair<Variable, Domain>& binding, Variable v) {
+          return binding.first < v;
+        });
+  }
+
+  // Returns storage that isn't shared with any other value.
+  Storage& mutable_storage() {
+    if (!m_storage) {
+      m_storage = std::make_shared<Storage>();
+    } else if (m_storage.use_count() > 1) {
+      m_storage = std::make_shared<Storage>(*m_storage);
+    }
+    return *m_storage;
+  }
+
+  void insert_binding(Variable variable, const Domain& value) {
+    // The Bottom value is handled in ArrayAbstractEnvironment and should
+    // never occur here.
+    RUNTIME_CHECK(!value.is_bottom(), internal_error());
+    if (value.is_top()) {
+      if (find(variable) == nullptr) {
+        return;
+      }
+      auto& storage = mutable_storage();
+      if (variable < kMaxDenseVariable) {
+        storage.unbind(variable);
+      } else {
+        storage.sparse.erase(sparse_find(storage.sparse, variable));
+        --storage.size;
+      }
+      normalize_storage();
+      return;
+    }
+    auto& storage = mutable_storage();
+    if (variable < kMaxDenseVariable) {
+      storage.bind(variable, value);
+      return;
+    }
+    auto it = sparse_find(storage.sparse, variable);
+    if (it != storage.sparse.end() && it->first == variable) {
+      it->second = value;
+    } else {
+      storage.sparse.emplace(it, variable, value);
+      ++storage.size;
+    }
+  }
+
+  // Returns false if a binding became Bottom.
+  bool map(const std::function<Domain(const Domain&)>& f, bool* changed) {
+    *changed = false;
+    if (!m_storage) {
+      return true;
+    }
+    ArrayValue result;
+    bool bottom = false;
+    visit([&](Variable variable, const Domain& value) {
+      if (bottom) {
+        return;
+      }
+      Domain new_value = f(value);
+      if (new_value.is_bottom()) {
+        bottom = true;
+        return;
+      }
+      *changed |= !new_value.equals(value);
+      result.insert_binding(variable, new_value);
+    });
+    if (bottom) {
+      clear();
+      return false;
+    }
+    if (*changed) {
+      *this = std::move(result);
+    }
+    return true;
+  }
+
+  // Drop the storage of a value that has no bindings left, so that all the
+  // representations of Top compare equal by pointer.
+  void normalize_storage() {
+    if (m_storage && m_storage->size == 0) {
+      m_storage.reset();
+    }
+  }
+
+  template <typename Operation>
+  AbstractValueKind join_like_operation(const ArrayValue& other,
+                                        const Operation& operation) {
+    if (m_storage == other.m_storage || !m_storage) {
+      return kind();
+    }
+    if (!other.m_storage) {
+      clear();
+      return AbstractValueKind::Top;
+    }
+    auto& mine = mutable_storage();
+    const auto& theirs = *other.m_storage;
+    // Only the variables bound on both sides stay bound.
+    for (size_t i = 0; i < mine.bits.size(); ++i) {
+      Word w = mine.bits[i];
+      for (Word dropped = w & ~theirs.word(i); dropped != 0;
+           dropped &= dropped - 1) {
+        mine.unbind(i * kWordBits + __builtin_ctzll(dropped));
+      }
+      for (Word common = w & theirs.word(i); common != 0;
+           common &= common - 1) {
+        size_t variable = i * kWordBits + __builtin_ctzll(common);
+        operation(&mine.dense[variable], theirs.dense[variable]);
+        if (mine.dense[variable].is_top()) {
+          mine.unbind(variable);
+        }
+      }
+    }
+    SparseBindings sparse;
+    for (auto& binding : mine.sparse) {
+      auto it = sparse_find(theirs.sparse, binding.first);
+      if (it != theirs.sparse.end() && it->first == binding.first) {
+        operation(&binding.second, it->second);
+        if (!binding.second.is_top()) {
+          sparse.push_back(std::move(binding));
+        }
+      }
+    }
+    mine.size -= mine.sparse.size() - sparse.size();
+    mine.sparse = std::move(sparse);
+    normalize_storage();
+    return kind();
+  }
+
+  template <typename Operation>
+  AbstractValueKind meet_like_operation(const ArrayValue& other,
+                                        const Operation& operation) {
+    if (m_storage == other.m_storage || !other.m_storage) {
+      return kind();
+    }
+    if (!m_storage) {
+      // Top is the identity of meet-like operations.
+      m_storage = other.m_storage;
+      return kind();
+    }
+    auto& mine = mutable_storage();
+    const auto& theirs = *other.m_storage;
+    for (size_t i = 0; i < theirs.bits.size(); ++i) {
+      for (Word w = theirs.bits[i]; w != 0; w &= w - 1) {
+        size_t variable = i * kWordBits + __builtin_ctzll(w);
+        if (!mine.is_bound(variable)) {
+          mine.bind(variable, theirs.dense[variable]);
+          continue;
+        }
+        operation(&mine.dense[variable], theirs.dense[variable]);
+        if (mine.dense[variable].is_bottom()) {
+          clear();
+          return AbstractValueKind::Bottom;
+        }
+        if (mine.dense[variable].is_top()) {
+          mine.unbind(variable);
+        }
+      }
+    }
+    for (const auto& binding : theirs.sparse) {
+      auto it = sparse_find(mine.sparse, binding.first);
+      if (it == mine.sparse.end() || it->first != binding.first) {
+        mine.sparse.insert(it, binding);
+        ++mine.size;
+        continue;
+      }
+      operation(&it->second, binding.second);
+      if (it->second.is_bottom()) {
+        clear();
+        return AbstractValueKind::Bottom;
+      }
+      if (it->second.is_top()) {
+        mine.sparse.erase(it);
+        --mine.size;
+      }
+    }
+    normalize_storage();
+    return kind();
+  }
+
+  std::shared_ptr<Storage> m_storage;
+
+  template <typename T1, typename T2>
+  friend class sparta::ArrayAbstractEnvironment;
+};
+
+} // namespace aae_impl
+
+} // namespace sparta
@@ -0,0 +1,256 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <ostream>
+#include <type_traits>
+#include <vector>
+
+#include "PowersetAbstractDomain.h"
+
+namespace sparta {
+
+namespace bvsad_impl {
+
+/*
+ * A set of unsigned integers represented as a flat bit vector, for small and
+ * dense universes such as the registers or the blocks of a method. Set
+ * operations are loops over 64-bit words, which the compiler can vectorize.
+ *
+ * The words are shared between copies and only copied when a shared set is
+ * modified, so that copying a set, as fixpoint iterators and environments do
+ * all the time, is cheap. The universe grows with the largest element added;
+ * the words past the last one are implicitly zero.
+ */
+template <typename IntegerType>
+class BitVectorSetValue final
+    : public PowersetImplementation<IntegerType,
+                                    std::vector<IntegerType>,
+                                    BitVectorSetValue<IntegerType>> {
+ public:
+  using Word = uint64_t;
+  static constexpr size_t kWordBits = 64;
+
+  BitVectorSetValue() = default;
+
+  explicit BitVectorSetValue(std::initializer_list<IntegerType> l) {
+    for (IntegerType e : l) {
+      add(e);
+    }
+  }
+
+  void clear() override { m_words.reset(); }
+
+  // Returns the elements in increasing order.
+  std::vector<IntegerType> elements() const override {
+    std::vector<IntegerType> result;
+    result.reserve(size());
+    for (size_t i = 0; i < words_size(); ++i) {
+      for (Word w = (*m_words)[i]; w != 0; w &= w - 1) {
+        result.push_back((IntegerType)(i * kWordBits + __builtin_ctzll(w)));
+      }
+    }
+    return result;
+  }
+
+  AbstractValueKind kind() const override { return AbstractValueKind::Value; }
+
+  bool contains(const IntegerType& element) const override {
+    size_t i = element / kWordBits;
+    return i < words_size() && ((*m_words)[i] & bit(element)) != 0;
+  }
+
+  bool leq(const BitVectorSetValue& other) const override {
+    if (m_words == other.m_words) {
+      return true;
+    }
+    size_t common = std::min(words_size(), other.words_size());
+    Word excess = 0;
+    for (size_t i = 0; i < common; ++i) {
+      excess |= (*m_words)[i] & ~(*other.m_words)[i];
+    }
+    return excess == 0 && all_zero_from(common);
+  }
+
+  bool equals(const BitVectorSetValue& other) const override {
+    if (m_words == other.m_words) {
+      return true;
+    }
+    size_t common = std::min(words_size(), other.words_size());
+    Word diff = 0;
+    for (size_t i = 0; i < common; ++i) {
+      diff |= (*m_words)[i] ^ (*other.m_words)[i];
+    }
+    return diff == 0 && all_zero_from(common) && other.all_zero_from(common);
+  }
+
+  void add(const IntegerType& element) override {
+    if (!contains(element)) {
+      mutable_words(element / kWordBits + 1)[element / kWordBits] |=
+          bit(element);
+    }
+  }
+
+  void remove(const IntegerType& element) override {
+    if (contains(element)) {
+      mutable_words(0)[element / kWordBits] &= ~bit(element);
+    }
+  }
+
+  AbstractValueKind join_with(const BitVectorSetValue& other) override {
+    if (m_words == other.m_words || other.words_size() == 0) {
+      return AbstractValueKind::Value;
+    }
+    if (words_size() == 0) {
+      m_words = other.m_words;
+      return AbstractValueKind::Value;
+    }
+    auto& words = mutable_words(other.words_size());
+    const auto& other_words = *other.m_words;
+    for (size_t i = 0; i < other_words.size(); ++i) {
+      words[i] |= other_words[i];
+    }
+    return AbstractValueKind::Value;
+  }
+
+  AbstractValueKind meet_with(const BitVectorSetValue& other) override {
+    if (m_words == other.m_words || words_size() == 0) {
+      return AbstractValueKind::Value;
+    }
+    if (other.words_size() == 0) {
+      clear();
+      return AbstractValueKind::Value;
+    }
+    auto& words = mutable_words(0);
+    const auto& other_words = *other.m_words;
+    size_t common = std::min(words.size(), other_words.size());
+    for (size_t i = 0; i < common; ++i) {
+      words[i] &= other_words[i];
+    }
+    words.resize(common);
+    return AbstractValueKind::Value;
+  }
+
+  size_t size() const override {
+    size_t result = 0;
+    for (size_t i = 0; i < words_size(); ++i) {
+      result += __builtin_popcountll((*m_words)[i]);
+    }
+    return result;
+  }
+
+  friend std::ostream& operator<<(std::ostream& o,
+                                  const BitVectorSetValue& value) {
+    o << "[#" << value.size() << "]";
+    const auto& elements = value.elements();
+    o << "{";
+    for (auto it = elements.begin(); it != elements.end();) {
+      o << *it++;
+      if (it != elements.end()) {
+        o << ", ";
+      }
+    }
+    o << "}";
+    return o;
+  }
+
+ private:
+  static Word bit(IntegerType element) {
+    return Word(1) << (element % kWordBits);
+  }
+
+  size_t words_size() const { return m_words ? m_words->size() : 0; }
+
+  bool all_zero_from(size_t begin) const {
+    Word any = 0;
+    for (size_t i = begin; i < words_size(); ++i) {
+      any |= (*m_words)[i];
+    }
+    return any == 0;
+  }
+
+  // Returns words that aren't shared with any other set, with at least
+  // :min_size of them.
+  std::vector<Word>& mutable_words(size_t min_size) {
+    if (!m_words) {
+      m_words = std::make_shared<std::vector<Word>>(min_size);
+    } else if (m_words.use_count() > 1) {
+      m_words = std::make_shared<std::vector<Word>>(*m_words);
+    }
+    if (m_words->size() < min_size) {
+      m_words->resize(min_size);
+    }
+    return *m_words;
+  }
+
+  // Null for the empty set.
+  std::shared_ptr<std::vector<Word>> m_words;
+};
+
+} // namespace bvsad_impl
+
+/*
+ * A powerset abstract domain over a dense universe of unsigned integers,
+ * represented as bit vectors. This is a drop-in replacement for
+ * PatriciaTreeSetAbstractDomain when the elements are small integers, such as
+ * register or block numbers.
+ */
+template <typename IntegerType>
+class BitVectorSetAbstractDomain final
+    : public PowersetAbstractDomain<IntegerType,
+                                    bvsad_impl::BitVectorSetValue<IntegerType>,
+                                    std::vector<IntegerType>,
+                                    BitVectorSetAbstractDomain<IntegerType>> {
+ public:
+  using Value = bvsad_impl::BitVectorSetValue<IntegerType>;
+
+  ~BitVectorSetAbstractDomain() {
+    // The destructor is the only method that is guaranteed to be created when
+    // a class template is instantiated. This is a good place to perform all
+    // the sanity checks on the template parameters.
+    static_assert(std::is_unsigned<IntegerType>::value,
+                  "IntegerType is not an unsigned arihmetic type");
+    static_assert(sizeof(IntegerType) <= sizeof(size_t),
+                  "IntegerType is too large");
+  }
+
+  // The empty set.
+  BitVectorSetAbstractDomain()
+      : PowersetAbstractDomain<IntegerType,
+                               Value,
+                               std::vector<IntegerType>,
+                               BitVectorSetAbstractDomain>() {}
+
+  explicit BitVectorSetAbstractDomain(AbstractValueKind kind)
+      : PowersetAbstractDomain<IntegerType,
+                               Value,
+                               std::vector<IntegerType>,
+                               BitVectorSetAbstractDomain>(kind) {}
+
+  explicit BitVectorSetAbstractDomain(IntegerType e) {
+    this->set_to_value(Value({e}));
+  }
+
+  explicit BitVectorSetAbstractDomain(std::initializer_list<IntegerType> l) {
+    this->set_to_value(Value(l));
+  }
+
+  static BitVectorSetAbstractDomain bottom() {
+    return BitVectorSetAbstractDomain(AbstractValueKind::Bottom);
+  }
+
+  static BitVectorSetAbstractDomain top() {
+    return BitVectorSetAbstractDomain(AbstractValueKind::Top);
+  }
+};
+
+} // namespace sparta
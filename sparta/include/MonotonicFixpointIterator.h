@@ -8,10 +8,16 @@
 #pragma once
 
 #include <algorithm>
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
 #include <functional>
+#include <limits>
+#include <queue>
+#include <stack>
 #include <type_traits>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "AbstractDomain.h"
@@ -22,6 +28,117 @@
 
 namespace sparta {
 
+/*
+ * Receives events from the sequential fixpoint iterators, for profiling
+ * analyses that take too long on some graphs, see
+ * MonotonicFixpointIterator::set_observer(). The events are not reported by
+ * the parallel algorithm of ParallelMonotonicFixpointIterator, which
+ * MonotonicFixpointIterator also switches to on very large graphs.
+ */
+template <typename NodeId>
+class FixpointIteratorObserver {
+ public:
+  virtual ~FixpointIteratorObserver() = default;
+
+  /*
+   * A node was analyzed: :join_time was spent computing its entry state from
+   * the exit states of its predecessors, and :transfer_time in the node
+   * transformer.
+   */
+  virtual void on_node_analyzed(const NodeId& /* node */,
+                                std::chrono::nanoseconds /* join_time */,
+                                std::chrono::nanoseconds /* transfer_time */) {}
+
+  /*
+   * The component headed by :head didn't stabilize after another iteration,
+   * and the new entry state of :head was extrapolated. With the default
+   * strategy (see extrapolate()), this is a join after the first iteration
+   * (:previous_iterations == 0) and a widening afterwards.
+   */
+  virtual void on_extrapolation(const NodeId& /* head */,
+                                uint32_t /* previous_iterations */) {}
+
+  // The component headed by :head stabilized after :iterations iterations.
+  virtual void on_component_stabilized(const NodeId& /* head */,
+                                       uint32_t /* iterations */) {}
+};
+
+/*
+ * An observer that sums up the events per node and per component head.
+ */
+template <typename NodeId, typename NodeHash = std::hash<NodeId>>
+class FixpointIteratorStatistics final
+    : public FixpointIteratorObserver<NodeId> {
+ public:
+  struct NodeStatistics {
+    uint32_t visits{0};
+    std::chrono::nanoseconds join_time{0};
+    std::chrono::nanoseconds transfer_time{0};
+  };
+
+  struct ComponentStatistics {
+    // Over all the times the component was stabilized.
+    uint32_t iterations{0};
+    uint32_t max_iterations{0};
+    uint32_t widenings{0};
+  };
+
+  void on_node_analyzed(const NodeId& node,
+                        std::chrono::nanoseconds join_time,
+                        std::chrono::nanoseconds transfer_time) override {
+    auto& stats = m_nodes[node];
+    ++stats.visits;
+    stats.join_time += join_time;
+    stats.transfer_time += transfer_time;
+    ++m_node_visits;
+    m_join_time += join_time;
+    m_transfer_time += transfer_time;
+  }
+
+  void on_extrapolation(const NodeId& head,
+                        uint32_t previous_iterations) override {
+    if (previous_iterations > 0) {
+      ++m_components[head].widenings;
+      ++m_widenings;
+    }
+  }
+
+  void on_component_stabilized(const NodeId& head,
+                               uint32_t iterations) override {
+    auto& stats = m_components[head];
+    stats.iterations += iterations;
+    stats.max_iterations = std::max(stats.max_iterations, iterations);
+    m_max_iterations = std::max(m_max_iterations, iterations);
+  }
+
+  const std::unordered_map<NodeId, NodeStatistics, NodeHash>& nodes() const {
+    return m_nodes;
+  }
+
+  const std::unordered_map<NodeId, ComponentStatistics, NodeHash>& components()
+      const {
+    return m_components;
+  }
+
+  size_t node_visits() const { return m_node_visits; }
+  size_t widenings() const { return m_widenings; }
+  // The most iterations any component needed to stabilize.
+  uint32_t max_iterations() const { return m_max_iterations; }
+  std::chrono::nanoseconds join_time() const { return m_join_time; }
+  std::chrono::nanoseconds transfer_time() const { return m_transfer_time; }
+
+  void clear() { *this = FixpointIteratorStatistics(); }
+
+ private:
+  std::unordered_map<NodeId, NodeStatistics, NodeHash> m_nodes;
+  std::unordered_map<NodeId, ComponentStatistics, NodeHash> m_components;
+  size_t m_node_visits{0};
+  size_t m_widenings{0};
+  uint32_t m_max_iterations{0};
+  std::chrono::nanoseconds m_join_time{0};
+  std::chrono::nanoseconds m_transfer_time{0};
+};
+
 namespace fp_impl {
 
 /*
@@ -177,6 +294,14 @@ class MonotonicFixpointIteratorBase
     m_exit_states.clear();
   }
 
+  /*
+   * Reports the progress of the following runs to :observer, which must
+   * outlive them. Pass nullptr to stop reporting.
+   */
+  void set_observer(FixpointIteratorObserver<NodeId>* observer) {
+    m_observer = observer;
+  }
+
   void set_all_to_bottom(std::unordered_set<NodeId>& all_nodes) {
     // Pre-populate entry and exit states for all nodes.
     for (auto& node : all_nodes) {
@@ -208,13 +333,39 @@ class MonotonicFixpointIteratorBase
     // iteration is not a viable option, since the control-flow graph may
     // contain unreachable nodes pointing to reachable ones (see the
     // documentation of `get_exit_state_at`).
+    if (m_observer == nullptr) {
+      compute_entry_state(context, node, &entry_state);
+      Domain& exit_state = m_exit_states[node];
+      exit_state = entry_state;
+      this->analyze_node(node, &exit_state);
+      return;
+    }
+    using Clock = std::chrono::steady_clock;
+    auto start = Clock::now();
     compute_entry_state(context, node, &entry_state);
+    auto joined = Clock::now();
     Domain& exit_state = m_exit_states[node];
     exit_state = entry_state;
     this->analyze_node(node, &exit_state);
+    m_observer->on_node_analyzed(node, joined - start, Clock::now() - joined);
+  }
+
+  void notify_extrapolation(const Context& context, const NodeId& head) {
+    if (m_observer != nullptr) {
+      m_observer->on_extrapolation(head,
+                                   context.get_local_iterations_for(head));
+    }
+  }
+
+  void notify_stabilized(const Context& context, const NodeId& head) {
+    if (m_observer != nullptr) {
+      m_observer->on_component_stabilized(
+          head, context.get_local_iterations_for(head) + 1);
+    }
   }
 
   const Graph& m_graph;
+  FixpointIteratorObserver<NodeId>* m_observer{nullptr};
   std::unordered_map<NodeId, Domain, NodeHash> m_entry_states;
   std::unordered_map<NodeId, Domain, NodeHash> m_exit_states;
 };
@@ -311,7 +462,9 @@ class WTOMonotonicFixpointIterator
         // it's better to use it as the final result of the iteration sequence.
         *current_state = std::move(new_state);
         iterate = false;
+        this->notify_stabilized(*context, head);
       } else {
+        this->notify_extrapolation(*context, head);
         this->extrapolate(*context, head, current_state, new_state);
       }
     }
@@ -335,6 +488,114 @@ class WPOCounter {
   std::unordered_map<uint32_t, std::atomic<uint32_t>> m_counter;
 };
 
+namespace fp_impl {
+
+/*
+ * The concurrent fixpoint algorithm over a weak partial ordering described
+ * below. It is shared by ParallelMonotonicFixpointIterator and by
+ * MonotonicFixpointIterator when the latter switches to it on large graphs.
+ * The set of nodes must contain all the nodes reachable from the entry.
+ */
+template <typename GraphInterface, typename Domain, typename NodeHash>
+void run_wpo_in_parallel(
+    MonotonicFixpointIteratorBase<GraphInterface, Domain, NodeHash>* iterator,
+    const WeakPartialOrdering<typename GraphInterface::NodeId, NodeHash>& wpo,
+    std::unordered_set<typename GraphInterface::NodeId>& all_nodes,
+    const Domain& init,
+    size_t num_threads) {
+  using NodeId = typename GraphInterface::NodeId;
+  using Context = MonotonicFixpointIteratorContext<NodeId, Domain, NodeHash>;
+  using WPOWorkerState = SpartaWorkerState<uint32_t>;
+
+  // Observers needn't be thread-safe, so they miss parallel runs.
+  auto* observer = iterator->m_observer;
+  iterator->m_observer = nullptr;
+  iterator->set_all_to_bottom(all_nodes);
+  Context context(init, all_nodes);
+  WPOCounter wpo_counter;
+  wpo_counter.init(wpo.size());
+  auto entry_idx = wpo.get_entry();
+  assert(wpo.get_num_preds(entry_idx) == 0);
+  // Prepare work queue.
+  auto wq = sparta::work_queue<uint32_t>(
+      [&context, &entry_idx, &wpo, &wpo_counter, iterator](
+          WPOWorkerState* worker_state, uint32_t wpo_idx) {
+        std::atomic<uint32_t>& current_counter = wpo_counter.value_at(wpo_idx);
+        current_counter = 0;
+        // NonExit node
+        if (!wpo.is_exit(wpo_idx)) {
+          iterator->analyze_vertex(&context, wpo.get_node(wpo_idx));
+          for (auto succ_idx : wpo.get_successors(wpo_idx)) {
+            std::atomic<uint32_t>& succ_counter =
+                wpo_counter.value_at(succ_idx);
+            // Increase succ node's counter, push succ nodes in work queue if
+            // their counter number matches their NumSchedPreds.
+            if (++succ_counter == wpo.get_num_preds(succ_idx)) {
+              worker_state->push_task(succ_idx);
+            }
+          }
+          return nullptr;
+        }
+        // Exit node
+        // Check if component of the exit node has stablized.
+        auto head_idx = wpo.get_head_of_exit(wpo_idx);
+        NodeId head = wpo.get_node(head_idx);
+        Domain* current_state = &iterator->m_entry_states[head];
+        Domain new_state;
+        iterator->compute_entry_state(&context, head, &new_state);
+        if (new_state.leq(*current_state)) {
+          // Component stablized.
+          context.reset_local_iteration_count_for(head);
+          *current_state = std::move(new_state);
+          for (auto succ_idx : wpo.get_successors(wpo_idx)) {
+            std::atomic<uint32_t>& succ_counter =
+                wpo_counter.value_at(succ_idx);
+            // Increase succ node's counter, push succ nodes in work queue if
+            // their counter number matches their NumSchedPreds.
+            if (++succ_counter == wpo.get_num_preds(succ_idx)) {
+              worker_state->push_task(succ_idx);
+            }
+          }
+        } else {
+          // Component didn't stablize.
+          iterator->extrapolate(context, head, current_state, new_state);
+          context.increase_iteration_count_for(head);
+          // Set component nodes v's counter to their
+          // NumOuterSchedPreds(v, wpo_idx)
+          for (auto pred_pair : wpo.get_num_outer_preds(wpo_idx)) {
+            auto component_idx = pred_pair.first;
+            assert(component_idx != entry_idx);
+            std::atomic<uint32_t>& component_counter =
+                wpo_counter.value_at(component_idx);
+            component_counter = pred_pair.second;
+            // Push component nodes in work queue if their counter number
+            // matches their NumSchedPreds.
+            if (wpo_counter.value_at(component_idx) ==
+                wpo.get_num_preds(component_idx)) {
+              worker_state->push_task(component_idx);
+            }
+          }
+          if (head_idx == entry_idx) {
+            // Handle special case when there is a loop on entry node.
+            // Because entry node have num_preds = 0, and for
+            // get_num_outer_preds the nodes with num_outer_preds are ignored.
+            // So we need to manually add entry node back to work queue if
+            // the component didn't stablize.
+            worker_state->push_task(head_idx);
+          }
+        }
+        return nullptr;
+      },
+      num_threads,
+      /*push_tasks_while_running=*/true);
+  wq.add_item(wpo.get_entry());
+  wq.run_all();
+  iterator->m_observer = observer;
+}
+
+
+} // namespace fp_impl
+
 /*
  * Implementation of a deterministic concurrent fixpoint algorithm for weak
  * partial ordering (WPO) of a rooted directed graph, as described in the paper:
@@ -412,91 +673,11 @@ class ParallelMonotonicFixpointIterator
    * initial conditions.
    */
   void run(const Domain& init) {
-    this->set_all_to_bottom(m_all_nodes);
-    Context context(init, m_all_nodes);
-    m_wpo_counter.init(m_wpo.size());
-    auto entry_idx = m_wpo.get_entry();
-    assert(m_wpo.get_num_preds(entry_idx) == 0);
-    // Prepare work queue.
-    auto wq = sparta::work_queue<uint32_t>(
-        [&context, &entry_idx, this](WPOWorkerState* worker_state,
-                                     uint32_t wpo_idx) {
-          std::atomic<uint32_t>& current_counter =
-              m_wpo_counter.value_at(wpo_idx);
-          current_counter = 0;
-          // NonExit node
-          if (!m_wpo.is_exit(wpo_idx)) {
-            this->analyze_vertex(&context, m_wpo.get_node(wpo_idx));
-            for (auto succ_idx : m_wpo.get_successors(wpo_idx)) {
-              std::atomic<uint32_t>& succ_counter =
-                  m_wpo_counter.value_at(succ_idx);
-              // Increase succ node's counter, push succ nodes in work queue if
-              // their counter number matches their NumSchedPreds.
-              if (++succ_counter == m_wpo.get_num_preds(succ_idx)) {
-                worker_state->push_task(succ_idx);
-              }
-            }
-            return nullptr;
-          }
-          // Exit node
-          // Check if component of the exit node has stablized.
-          auto head_idx = m_wpo.get_head_of_exit(wpo_idx);
-          NodeId head = m_wpo.get_node(head_idx);
-          Domain* current_state = &this->m_entry_states[head];
-          Domain new_state;
-          this->compute_entry_state(&context, head, &new_state);
-          if (new_state.leq(*current_state)) {
-            // Component stablized.
-            context.reset_local_iteration_count_for(head);
-            *current_state = std::move(new_state);
-            for (auto succ_idx : m_wpo.get_successors(wpo_idx)) {
-              std::atomic<uint32_t>& succ_counter =
-                  m_wpo_counter.value_at(succ_idx);
-              // Increase succ node's counter, push succ nodes in work queue if
-              // their counter number matches their NumSchedPreds.
-              if (++succ_counter == m_wpo.get_num_preds(succ_idx)) {
-                worker_state->push_task(succ_idx);
-              }
-            }
-          } else {
-            // Component didn't stablize.
-            this->extrapolate(context, head, current_state, new_state);
-            context.increase_iteration_count_for(head);
-            // Set component nodes v's counter to their
-            // NumOuterSchedPreds(v, wpo_idx)
-            for (auto pred_pair : m_wpo.get_num_outer_preds(wpo_idx)) {
-              auto component_idx = pred_pair.first;
-              assert(component_idx != entry_idx);
-              std::atomic<uint32_t>& component_counter =
-                  m_wpo_counter.value_at(component_idx);
-              component_counter = pred_pair.second;
-              // Push component nodes in work queue if their counter number
-              // matches their NumSchedPreds.
-              if (m_wpo_counter.value_at(component_idx) ==
-                  m_wpo.get_num_preds(component_idx)) {
-                worker_state->push_task(component_idx);
-              }
-            }
-            if (head_idx == entry_idx) {
-              // Handle special case when there is a loop on entry node.
-              // Because entry node have num_preds = 0, and for
-              // get_num_outer_preds the nodes with num_outer_preds are ignored.
-              // So we need to manually add entry node back to work queue if
-              // the component didn't stablize.
-              worker_state->push_task(head_idx);
-            }
-          }
-          return nullptr;
-        },
-        m_num_thread,
-        /*push_tasks_while_running=*/true);
-    wq.add_item(m_wpo.get_entry());
-    wq.run_all();
+    fp_impl::run_wpo_in_parallel(this, m_wpo, m_all_nodes, init, m_num_thread);
   }
 
  private:
   WeakPartialOrdering<NodeId, NodeHash> m_wpo;
-  WPOCounter m_wpo_counter;
   size_t m_num_thread;
   std::unordered_set<NodeId> m_all_nodes;
 };
@@ -546,6 +727,20 @@ class MonotonicFixpointIterator
               },
               false) {}
 
+  /*
+   * Makes `run` switch to the concurrent algorithm of
+   * ParallelMonotonicFixpointIterator, on `num_threads` threads, whenever the
+   * weak partial ordering of the graph has at least `min_nodes` elements. The
+   * invariants computed are the same; only the order of evaluation differs.
+   * This only pays off on very large graphs, and requires the node and edge
+   * transformers to be safe to call concurrently on distinct nodes.
+   */
+  void set_parallel_threshold(
+      size_t min_nodes, size_t num_threads = parallel::default_num_threads()) {
+    m_parallel_min_nodes = min_nodes;
+    m_parallel_num_threads = num_threads;
+  }
+
   /*
    * Executes the fixpoint iterator given an abstract value describing the
    * initial program configuration. This method can be invoked multiple times
@@ -553,6 +748,18 @@ class MonotonicFixpointIterator
    * initial conditions.
    */
   void run(const Domain& init) {
+    if (m_wpo.size() >= m_parallel_min_nodes) {
+      std::unordered_set<NodeId> all_nodes;
+      for (uint32_t idx = 0; idx < m_wpo.size(); ++idx) {
+        if (!m_wpo.is_exit(idx)) {
+          all_nodes.emplace(m_wpo.get_node(idx));
+        }
+      }
+      this->clear();
+      fp_impl::run_wpo_in_parallel(this, m_wpo, all_nodes, init,
+                                   m_parallel_num_threads);
+      return;
+    }
     this->clear();
     Context context(init);
     std::unordered_map<uint32_t, uint32_t> wpo_counter;
@@ -583,6 +790,7 @@ class MonotonicFixpointIterator
       this->compute_entry_state(&context, head, &new_state);
       if (new_state.leq(*current_state)) {
         // Component stablized.
+        this->notify_stabilized(context, head);
         context.reset_local_iteration_count_for(head);
         *current_state = std::move(new_state);
         for (auto succ_idx : m_wpo.get_successors(wpo_idx)) {
@@ -594,6 +802,7 @@ class MonotonicFixpointIterator
         }
       } else {
         // Component didn't stablize.
+        this->notify_extrapolation(context, head);
         this->extrapolate(context, head, current_state, new_state);
         context.increase_iteration_count_for(head);
         // Set component nodes v's counter to their
@@ -630,6 +839,8 @@ class MonotonicFixpointIterator
 
  private:
   WeakPartialOrdering<NodeId, NodeHash> m_wpo;
+  size_t m_parallel_min_nodes{std::numeric_limits<size_t>::max()};
+  size_t m_parallel_num_threads{1};
 };
 
 /*
@@ -8,17 +8,22 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
 #include <cstdint>
 #include <functional>
 #include <iterator>
 #include <limits>
 #include <memory>
+#include <mutex>
 #include <ostream>
 #include <stack>
 #include <type_traits>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "AbstractDomain.h"
+#include "PatriciaTreeNodePool.h"
 #include "PatriciaTreeUtil.h"
 
 // Forward declarations
@@ -45,6 +50,9 @@ class PatriciaTree;
 template <typename IntegerType, typename Value>
 class PatriciaTreeLeaf;
 
+template <typename IntegerType, typename Value>
+class BranchTable;
+
 template <typename IntegerType, typename Value>
 class PatriciaTreeIterator;
 
@@ -72,14 +80,18 @@ template <typename IntegerType, typename Value>
 inline std::shared_ptr<PatriciaTree<IntegerType, Value>> combine_new_leaf(
     const CombiningFunction<typename Value::type>& combine,
     IntegerType key,
-    const typename Value::type& value);
+    const typename Value::type& value,
+    const std::shared_ptr<PatriciaTreeLeaf<IntegerType, Value>>& source_leaf =
+        nullptr);
 
 template <typename IntegerType, typename Value>
 inline std::shared_ptr<PatriciaTree<IntegerType, Value>> update(
     const CombiningFunction<typename Value::type>& combine,
     IntegerType key,
     const typename Value::type& value,
-    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& tree);
+    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& tree,
+    const std::shared_ptr<PatriciaTreeLeaf<IntegerType, Value>>& source_leaf =
+        nullptr);
 
 template <typename IntegerType, typename Value>
 inline std::shared_ptr<PatriciaTree<IntegerType, Value>> map(
@@ -95,13 +107,15 @@ template <typename IntegerType, typename Value>
 inline std::shared_ptr<PatriciaTree<IntegerType, Value>> merge(
     const CombiningFunction<typename Value::type>& combine,
     const std::shared_ptr<PatriciaTree<IntegerType, Value>>& s,
-    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& t);
+    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& t,
+    uint32_t combine_id = 0);
 
 template <typename IntegerType, typename Value>
 inline std::shared_ptr<PatriciaTree<IntegerType, Value>> intersect(
     const ptmap_impl::CombiningFunction<typename Value::type>& combine,
     const std::shared_ptr<PatriciaTree<IntegerType, Value>>& s,
-    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& t);
+    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& t,
+    uint32_t combine_id = 0);
 
 template <typename T>
 T snd(const T&, const T& second) {
@@ -125,6 +139,25 @@ struct SimpleValue {
 
 } // namespace ptmap_impl
 
+/*
+ * Opt-in structural sharing for all Patricia-tree maps in the process.
+ *
+ * When enabled, branch nodes are hash-consed: two branches with the same prefix
+ * and the same subtrees are the same object. As the tree operations already
+ * reuse leaves, maps that are rebuilt to the same contents then tend to be the
+ * same tree, and the pointer-equality shortcuts of leq, equals, union and
+ * intersection cover whole subtrees. Each thread also keeps a small cache of
+ * the results of leq, and of unions and intersections whose combining
+ * function is given an id (see `union_with`), on pairs of branch nodes.
+ *
+ * This trades memory for time in analyses that keep joining similar abstract
+ * environments, such as the interprocedural constant propagation. It does not
+ * change any result and may be switched at any time.
+ */
+inline void set_patricia_tree_hash_consing(bool enabled) {
+  pt_util::hash_consing_enabled() = enabled;
+}
+
 /*
  * This structure implements a map of integer/pointer keys and AbstractDomain
  * values. It's based on the following paper:
@@ -310,31 +343,42 @@ class PatriciaTreeMap final {
     return *this;
   }
 
+  /*
+   * A nonzero `combine_id` lets the results be memoized when hash-consing is
+   * enabled (see set_patricia_tree_hash_consing). The same id must always
+   * denote the same function for maps with this Value, and that function must
+   * be pure.
+   */
   PatriciaTreeMap& union_with(const combining_function& combine,
-                              const PatriciaTreeMap& other) {
-    m_tree =
-        ptmap_impl::merge<IntegerType, Value>(combine, m_tree, other.m_tree);
+                              const PatriciaTreeMap& other,
+                              uint32_t combine_id = 0) {
+    m_tree = ptmap_impl::merge<IntegerType, Value>(
+        combine, m_tree, other.m_tree, combine_id);
     return *this;
   }
 
+  // See union_with() for `combine_id`.
   PatriciaTreeMap& intersection_with(const combining_function& combine,
-                                     const PatriciaTreeMap& other) {
+                                     const PatriciaTreeMap& other,
+                                     uint32_t combine_id = 0) {
     m_tree = ptmap_impl::intersect<IntegerType, Value>(
-        combine, m_tree, other.m_tree);
+        combine, m_tree, other.m_tree, combine_id);
     return *this;
   }
 
   PatriciaTreeMap get_union_with(const combining_function& combine,
-                                 const PatriciaTreeMap& other) const {
+                                 const PatriciaTreeMap& other,
+                                 uint32_t combine_id = 0) const {
     auto result = *this;
-    result.union_with(combine, other);
+    result.union_with(combine, other, combine_id);
     return result;
   }
 
   PatriciaTreeMap get_intersection_with(const combining_function& combine,
-                                        const PatriciaTreeMap& other) const {
+                                        const PatriciaTreeMap& other,
+                                        uint32_t combine_id = 0) const {
     auto result = *this;
-    result.intersection_with(combine, other);
+    result.intersection_with(combine, other, combine_id);
     return result;
   }
 
@@ -461,11 +505,21 @@ class PatriciaTreeBranch final : public PatriciaTree<IntegerType, Value> {
     return m_right_tree;
   }
 
+  ~PatriciaTreeBranch() override {
+    if (m_interned) {
+      BranchTable<IntegerType, Value>::erase(this);
+    }
+  }
+
  private:
   IntegerType m_prefix;
   IntegerType m_stacking_bit;
+  // Whether this node is in the BranchTable.
+  bool m_interned{false};
   std::shared_ptr<PatriciaTree<IntegerType, Value>> m_left_tree;
   std::shared_ptr<PatriciaTree<IntegerType, Value>> m_right_tree;
+
+  friend class BranchTable<IntegerType, Value>;
 };
 
 template <typename IntegerType, typename Value>
@@ -489,6 +543,172 @@ class PatriciaTreeLeaf final : public PatriciaTree<IntegerType, Value> {
   friend class ptmap_impl::PatriciaTreeIterator;
 };
 
+/*
+ * The hash-consed branch nodes of one kind of Patricia tree. Leaves are not
+ * interned, since values need not be hashable; the tree operations already
+ * reuse a leaf wherever its binding is unchanged.
+ *
+ * The table only holds weak references, and nodes erase themselves when they
+ * are destroyed.
+ */
+template <typename IntegerType, typename Value>
+class BranchTable final {
+ public:
+  using Tree = PatriciaTree<IntegerType, Value>;
+  using Branch = PatriciaTreeBranch<IntegerType, Value>;
+
+  static std::shared_ptr<Branch> intern(
+      IntegerType prefix,
+      IntegerType branching_bit,
+      const std::shared_ptr<Tree>& left_tree,
+      const std::shared_ptr<Tree>& right_tree) {
+    size_t hash =
+        hash_of(prefix, branching_bit, left_tree.get(), right_tree.get());
+    auto& stripe = instance().m_stripes[hash % kNumStripes];
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    auto range = stripe.nodes.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+      // The node may be under destruction, in which case its weak reference
+      // has expired. Its fields stay intact until it has erased itself, which
+      // requires the lock held here.
+      const Branch* branch = it->second.first;
+      if (branch->m_prefix == prefix &&
+          branch->m_stacking_bit == branching_bit &&
+          branch->m_left_tree == left_tree &&
+          branch->m_right_tree == right_tree) {
+        auto existing = it->second.second.lock();
+        if (existing != nullptr) {
+          return existing;
+        }
+      }
+    }
+    auto branch =
+        make_node<Branch>(prefix, branching_bit, left_tree, right_tree);
+    branch->m_interned = true;
+    stripe.nodes.emplace(hash, std::make_pair(branch.get(), branch));
+    return branch;
+  }
+
+  static void erase(const Branch* branch) {
+    size_t hash = hash_of(branch->m_prefix,
+                          branch->m_stacking_bit,
+                          branch->m_left_tree.get(),
+                          branch->m_right_tree.get());
+    auto& stripe = instance().m_stripes[hash % kNumStripes];
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    auto range = stripe.nodes.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+      if (it->second.first == branch) {
+        stripe.nodes.erase(it);
+        return;
+      }
+    }
+  }
+
+ private:
+  static constexpr size_t kNumStripes = 64;
+
+  struct Stripe {
+    std::mutex mutex;
+    std::unordered_multimap<size_t,
+                            std::pair<const Branch*, std::weak_ptr<Branch>>>
+        nodes;
+  };
+
+  // Leaked, as nodes may outlive static destruction.
+  static BranchTable& instance() {
+    static auto* table = new BranchTable();
+    return *table;
+  }
+
+  static size_t hash_of(IntegerType prefix,
+                        IntegerType branching_bit,
+                        const Tree* left_tree,
+                        const Tree* right_tree) {
+    size_t seed = std::hash<IntegerType>()(prefix);
+    for (size_t h : {std::hash<IntegerType>()(branching_bit),
+                     std::hash<const Tree*>()(left_tree),
+                     std::hash<const Tree*>()(right_tree)}) {
+      seed ^= h + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    }
+    return seed;
+  }
+
+  std::array<Stripe, kNumStripes> m_stripes;
+};
+
+template <typename IntegerType, typename Value>
+inline std::shared_ptr<PatriciaTreeBranch<IntegerType, Value>> new_branch(
+    IntegerType prefix,
+    IntegerType branching_bit,
+    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& left_tree,
+    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& right_tree) {
+  if (hash_consing_enabled()) {
+    return BranchTable<IntegerType, Value>::intern(
+        prefix, branching_bit, left_tree, right_tree);
+  }
+  return make_node<PatriciaTreeBranch<IntegerType, Value>>(
+      prefix, branching_bit, left_tree, right_tree);
+}
+
+struct LeqOperation {};
+struct MergeOperation {};
+struct IntersectOperation {};
+
+/*
+ * A small per-thread, direct-mapped cache for the results of an operation on
+ * pairs of trees, used while hash-consing is enabled. Entries keep their
+ * operands alive, so that no other tree can take their addresses while they
+ * are cached.
+ */
+template <typename IntegerType,
+          typename Value,
+          typename Operation,
+          typename Result>
+class NodePairCache final {
+ public:
+  using TreePtr = std::shared_ptr<PatriciaTree<IntegerType, Value>>;
+
+  static const Result* find(const TreePtr& s,
+                            const TreePtr& t,
+                            uint32_t combine_id) {
+    const auto& entry = slot(s, t, combine_id);
+    if (entry.s == s && entry.t == t && entry.combine_id == combine_id) {
+      return &entry.result;
+    }
+    return nullptr;
+  }
+
+  static void insert(const TreePtr& s,
+                     const TreePtr& t,
+                     uint32_t combine_id,
+                     const Result& result) {
+    auto& entry = slot(s, t, combine_id);
+    entry.s = s;
+    entry.t = t;
+    entry.combine_id = combine_id;
+    entry.result = result;
+  }
+
+ private:
+  static constexpr size_t kNumEntries = 1024;
+
+  struct Entry {
+    TreePtr s;
+    TreePtr t;
+    uint32_t combine_id{0};
+    Result result{};
+  };
+
+  static Entry& slot(const TreePtr& s, const TreePtr& t, uint32_t combine_id) {
+    static thread_local std::vector<Entry> entries(kNumEntries);
+    // Nodes are at least 16-byte aligned, so the low bits carry no entropy.
+    auto h = (reinterpret_cast<uintptr_t>(s.get()) >> 4) * 0x9e3779b97f4a7c15 ^
+             (reinterpret_cast<uintptr_t>(t.get()) >> 4) ^ combine_id;
+    return entries[(h ^ (h >> 29)) % kNumEntries];
+  }
+};
+
 template <typename IntegerType, typename Value>
 std::shared_ptr<PatriciaTreeBranch<IntegerType, Value>> join(
     IntegerType prefix0,
@@ -497,10 +717,10 @@ std::shared_ptr<PatriciaTreeBranch<IntegerType, Value>> join(
     const std::shared_ptr<PatriciaTree<IntegerType, Value>>& tree1) {
   IntegerType m = get_branching_bit(prefix0, prefix1);
   if (is_zero_bit(prefix0, m)) {
-    return std::make_shared<PatriciaTreeBranch<IntegerType, Value>>(
+    return new_branch<IntegerType, Value>(
         mask(prefix0, m), m, tree0, tree1);
   } else {
-    return std::make_shared<PatriciaTreeBranch<IntegerType, Value>>(
+    return new_branch<IntegerType, Value>(
         mask(prefix0, m), m, tree1, tree0);
   }
 }
@@ -519,7 +739,7 @@ std::shared_ptr<PatriciaTree<IntegerType, Value>> make_branch(
   if (right_tree == nullptr) {
     return left_tree;
   }
-  return std::make_shared<PatriciaTreeBranch<IntegerType, Value>>(
+  return new_branch<IntegerType, Value>(
       prefix, branching_bit, left_tree, right_tree);
 }
 
@@ -549,6 +769,11 @@ inline const typename Value::type* find_value(
   }
 }
 
+template <typename IntegerType, typename Value>
+inline bool leq_branches(
+    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& s,
+    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& t);
+
 /* Assumes Value::default_value() is either Top or Bottom */
 template <typename IntegerType, typename Value>
 inline bool leq(const std::shared_ptr<PatriciaTree<IntegerType, Value>>& s,
@@ -617,6 +842,24 @@ inline bool leq(const std::shared_ptr<PatriciaTree<IntegerType, Value>>& s,
   }
 
   // Neither s nor t is a leaf.
+  using Cache = NodePairCache<IntegerType, Value, LeqOperation, bool>;
+  bool memoize = hash_consing_enabled();
+  if (memoize) {
+    if (const bool* cached = Cache::find(s, t, /* combine_id */ 0)) {
+      return *cached;
+    }
+  }
+  bool result = leq_branches(s, t);
+  if (memoize) {
+    Cache::insert(s, t, /* combine_id */ 0, result);
+  }
+  return result;
+}
+
+template <typename IntegerType, typename Value>
+inline bool leq_branches(
+    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& s,
+    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& t) {
   const auto& s_branch =
       std::static_pointer_cast<PatriciaTreeBranch<IntegerType, Value>>(s);
   const auto& t_branch =
@@ -684,14 +927,18 @@ inline bool equals(
 // Finds the value corresponding to :key in the tree and replaces its bound
 // value with combine(bound_value, :value). Note that the existing value is
 // always the first parameter to :combine and the new value is the second.
+// If :value is bound to :key in :source_leaf, that leaf is reused whenever the
+// combined value of a fresh binding is unchanged.
 template <typename IntegerType, typename Value>
 inline std::shared_ptr<PatriciaTree<IntegerType, Value>> update(
     const ptmap_impl::CombiningFunction<typename Value::type>& combine,
     IntegerType key,
     const typename Value::type& value,
-    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& tree) {
+    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& tree,
+    const std::shared_ptr<PatriciaTreeLeaf<IntegerType, Value>>& source_leaf) {
   if (tree == nullptr) {
-    return combine_new_leaf<IntegerType, Value>(combine, key, value);
+    return combine_new_leaf<IntegerType, Value>(
+        combine, key, value, source_leaf);
   }
   if (tree->is_leaf()) {
     const auto& leaf =
@@ -699,7 +946,8 @@ inline std::shared_ptr<PatriciaTree<IntegerType, Value>> update(
     if (key == leaf->key()) {
       return combine_leaf(combine, value, leaf);
     }
-    auto new_leaf = combine_new_leaf<IntegerType, Value>(combine, key, value);
+    auto new_leaf = combine_new_leaf<IntegerType, Value>(
+        combine, key, value, source_leaf);
     if (new_leaf == nullptr) {
       return leaf;
     }
@@ -709,7 +957,8 @@ inline std::shared_ptr<PatriciaTree<IntegerType, Value>> update(
       std::static_pointer_cast<PatriciaTreeBranch<IntegerType, Value>>(tree);
   if (match_prefix(key, branch->prefix(), branch->branching_bit())) {
     if (is_zero_bit(key, branch->branching_bit())) {
-      auto new_left_tree = update(combine, key, value, branch->left_tree());
+      auto new_left_tree = update(
+          combine, key, value, branch->left_tree(), source_leaf);
       if (new_left_tree == branch->left_tree()) {
         return branch;
       }
@@ -718,7 +967,8 @@ inline std::shared_ptr<PatriciaTree<IntegerType, Value>> update(
                          new_left_tree,
                          branch->right_tree());
     } else {
-      auto new_right_tree = update(combine, key, value, branch->right_tree());
+      auto new_right_tree = update(
+          combine, key, value, branch->right_tree(), source_leaf);
       if (new_right_tree == branch->right_tree()) {
         return branch;
       }
@@ -728,7 +978,8 @@ inline std::shared_ptr<PatriciaTree<IntegerType, Value>> update(
                          new_right_tree);
     }
   }
-  auto new_leaf = combine_new_leaf<IntegerType, Value>(combine, key, value);
+  auto new_leaf = combine_new_leaf<IntegerType, Value>(
+      combine, key, value, source_leaf);
   if (new_leaf == nullptr) {
     return branch;
   }
@@ -797,11 +1048,19 @@ inline std::shared_ptr<PatriciaTree<IntegerType, Value>> erase_all_matching(
 
 // We keep the notations of the paper so as to make the implementation easier
 // to follow.
+template <typename IntegerType, typename Value>
+inline std::shared_ptr<PatriciaTree<IntegerType, Value>> merge_branches(
+    const ptmap_impl::CombiningFunction<typename Value::type>& combine,
+    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& s,
+    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& t,
+    uint32_t combine_id);
+
 template <typename IntegerType, typename Value>
 inline std::shared_ptr<PatriciaTree<IntegerType, Value>> merge(
     const ptmap_impl::CombiningFunction<typename Value::type>& combine,
     const std::shared_ptr<PatriciaTree<IntegerType, Value>>& s,
-    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& t) {
+    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& t,
+    uint32_t combine_id) {
   if (s == t) {
     // This conditional is what allows the union operation to complete in
     // sublinear time when the operands share some structure.
@@ -816,13 +1075,34 @@ inline std::shared_ptr<PatriciaTree<IntegerType, Value>> merge(
   if (s->is_leaf()) {
     const auto& leaf =
         std::static_pointer_cast<PatriciaTreeLeaf<IntegerType, Value>>(s);
-    return update(combine, leaf->key(), leaf->value(), t);
+    return update(combine, leaf->key(), leaf->value(), t, leaf);
   }
   if (t->is_leaf()) {
     const auto& leaf =
         std::static_pointer_cast<PatriciaTreeLeaf<IntegerType, Value>>(t);
-    return update(combine, leaf->key(), leaf->value(), s);
+    return update(combine, leaf->key(), leaf->value(), s, leaf);
+  }
+  using TreePtr = std::shared_ptr<PatriciaTree<IntegerType, Value>>;
+  using Cache = NodePairCache<IntegerType, Value, MergeOperation, TreePtr>;
+  bool memoize = combine_id != 0 && hash_consing_enabled();
+  if (memoize) {
+    if (const auto* cached = Cache::find(s, t, combine_id)) {
+      return *cached;
+    }
   }
+  auto result = merge_branches(combine, s, t, combine_id);
+  if (memoize) {
+    Cache::insert(s, t, combine_id, result);
+  }
+  return result;
+}
+
+template <typename IntegerType, typename Value>
+inline std::shared_ptr<PatriciaTree<IntegerType, Value>> merge_branches(
+    const ptmap_impl::CombiningFunction<typename Value::type>& combine,
+    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& s,
+    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& t,
+    uint32_t combine_id) {
   const auto& s_branch =
       std::static_pointer_cast<PatriciaTreeBranch<IntegerType, Value>>(s);
   const auto& t_branch =
@@ -837,51 +1117,46 @@ inline std::shared_ptr<PatriciaTree<IntegerType, Value>> merge(
   const auto& t1 = t_branch->right_tree();
   if (m == n && p == q) {
     // The two trees have the same prefix. We just merge the subtrees.
-    auto new_left = merge(combine, s0, t0);
-    auto new_right = merge(combine, s1, t1);
+    auto new_left = merge(combine, s0, t0, combine_id);
+    auto new_right = merge(combine, s1, t1, combine_id);
     if (new_left == s0 && new_right == s1) {
       return s;
     }
     if (new_left == t0 && new_right == t1) {
       return t;
     }
-    return std::make_shared<PatriciaTreeBranch<IntegerType, Value>>(
-        p, m, new_left, new_right);
+    return new_branch<IntegerType, Value>(p, m, new_left, new_right);
   }
   if (m < n && match_prefix(q, p, m)) {
     // q contains p. Merge t with a subtree of s.
     if (is_zero_bit(q, m)) {
-      auto new_left = merge(combine, s0, t);
+      auto new_left = merge(combine, s0, t, combine_id);
       if (s0 == new_left) {
         return s;
       }
-      return std::make_shared<PatriciaTreeBranch<IntegerType, Value>>(
-          p, m, new_left, s1);
+      return new_branch<IntegerType, Value>(p, m, new_left, s1);
     } else {
-      auto new_right = merge(combine, s1, t);
+      auto new_right = merge(combine, s1, t, combine_id);
       if (s1 == new_right) {
         return s;
       }
-      return std::make_shared<PatriciaTreeBranch<IntegerType, Value>>(
-          p, m, s0, new_right);
+      return new_branch<IntegerType, Value>(p, m, s0, new_right);
     }
   }
   if (m > n && match_prefix(p, q, n)) {
     // p contains q. Merge s with a subtree of t.
     if (is_zero_bit(p, n)) {
-      auto new_left = merge(combine, s, t0);
+      auto new_left = merge(combine, s, t0, combine_id);
       if (t0 == new_left) {
         return t;
       }
-      return std::make_shared<PatriciaTreeBranch<IntegerType, Value>>(
-          q, n, new_left, t1);
+      return new_branch<IntegerType, Value>(q, n, new_left, t1);
     } else {
-      auto new_right = merge(combine, s, t1);
+      auto new_right = merge(combine, s, t1, combine_id);
       if (t1 == new_right) {
         return t;
       }
-      return std::make_shared<PatriciaTreeBranch<IntegerType, Value>>(
-          q, n, t0, new_right);
+      return new_branch<IntegerType, Value>(q, n, t0, new_right);
     }
   }
   // The prefixes disagree.
@@ -899,28 +1174,48 @@ inline std::shared_ptr<PatriciaTree<IntegerType, Value>> combine_leaf(
     return nullptr;
   }
   if (!Value::equals(combined_value, leaf->value())) {
-    return std::make_shared<PatriciaTreeLeaf<IntegerType, Value>>(
+    return make_node<PatriciaTreeLeaf<IntegerType, Value>>(
         leaf->key(), combined_value);
   }
   return leaf;
 }
 
-// Create a new leaf with the default value and combine :value into it.
+// Create a new leaf with the default value and combine :value into it. If the
+// result is the value of :source_leaf, that leaf is returned instead.
 template <typename IntegerType, typename Value>
 inline std::shared_ptr<PatriciaTree<IntegerType, Value>> combine_new_leaf(
     const ptmap_impl::CombiningFunction<typename Value::type>& combine,
     IntegerType key,
-    const typename Value::type& value) {
-  auto new_leaf = std::make_shared<PatriciaTreeLeaf<IntegerType, Value>>(
+    const typename Value::type& value,
+    const std::shared_ptr<PatriciaTreeLeaf<IntegerType, Value>>& source_leaf) {
+  if (source_leaf != nullptr) {
+    auto combined_value = combine(Value::default_value(), value);
+    if (Value::is_default_value(combined_value)) {
+      return nullptr;
+    }
+    if (Value::equals(combined_value, source_leaf->value())) {
+      return source_leaf;
+    }
+    return make_node<PatriciaTreeLeaf<IntegerType, Value>>(key, combined_value);
+  }
+  auto new_leaf = make_node<PatriciaTreeLeaf<IntegerType, Value>>(
       key, Value::default_value());
   return combine_leaf(combine, value, new_leaf);
 }
 
+template <typename IntegerType, typename Value>
+inline std::shared_ptr<PatriciaTree<IntegerType, Value>> intersect_branches(
+    const ptmap_impl::CombiningFunction<typename Value::type>& combine,
+    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& s,
+    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& t,
+    uint32_t combine_id);
+
 template <typename IntegerType, typename Value>
 inline std::shared_ptr<PatriciaTree<IntegerType, Value>> intersect(
     const ptmap_impl::CombiningFunction<typename Value::type>& combine,
     const std::shared_ptr<PatriciaTree<IntegerType, Value>>& s,
-    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& t) {
+    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& t,
+    uint32_t combine_id) {
   if (s == t) {
     // This conditional is what allows the intersection operation to complete in
     // sublinear time when the operands share some structure.
@@ -947,6 +1242,27 @@ inline std::shared_ptr<PatriciaTree<IntegerType, Value>> intersect(
     }
     return combine_leaf(combine, *value, leaf);
   }
+  using TreePtr = std::shared_ptr<PatriciaTree<IntegerType, Value>>;
+  using Cache = NodePairCache<IntegerType, Value, IntersectOperation, TreePtr>;
+  bool memoize = combine_id != 0 && hash_consing_enabled();
+  if (memoize) {
+    if (const auto* cached = Cache::find(s, t, combine_id)) {
+      return *cached;
+    }
+  }
+  auto result = intersect_branches(combine, s, t, combine_id);
+  if (memoize) {
+    Cache::insert(s, t, combine_id, result);
+  }
+  return result;
+}
+
+template <typename IntegerType, typename Value>
+inline std::shared_ptr<PatriciaTree<IntegerType, Value>> intersect_branches(
+    const ptmap_impl::CombiningFunction<typename Value::type>& combine,
+    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& s,
+    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& t,
+    uint32_t combine_id) {
   const auto& s_branch =
       std::static_pointer_cast<PatriciaTreeBranch<IntegerType, Value>>(s);
   const auto& t_branch =
@@ -960,34 +1276,28 @@ inline std::shared_ptr<PatriciaTree<IntegerType, Value>> intersect(
   const auto& t0 = t_branch->left_tree();
   const auto& t1 = t_branch->right_tree();
   if (m == n && p == q) {
-    // The two trees have the same prefix. We merge the intersection of the
-    // corresponding subtrees.
-    //
-    // The subtrees don't have overlapping explicit values, but the combining
-    // function will still be called to merge the elements in one tree with the
-    // implicit default values in the other.
-    return merge<IntegerType, Value>(
-        [](const typename Value::type& x, const typename Value::type& y) ->
-        typename Value::type {
-          if (Value::is_default_value(x)) {
-            return y;
-          }
-          if (Value::is_default_value(y)) {
-            return x;
-          }
-          BOOST_THROW_EXCEPTION(internal_error()
-                                << error_msg("Malformed Patricia tree"));
-        },
-        intersect(combine, s0, t0),
-        intersect(combine, s1, t1));
+    // The two trees have the same prefix. The intersections of the
+    // corresponding subtrees are disjoint and keep to their side of the
+    // branching bit, so they can be put under a branch with the same prefix.
+    // Reusing an operand when the intersection left it unchanged lets later
+    // operations on the result take the pointer-equality shortcuts.
+    auto new_left = intersect(combine, s0, t0, combine_id);
+    auto new_right = intersect(combine, s1, t1, combine_id);
+    if (new_left == s0 && new_right == s1) {
+      return s;
+    }
+    if (new_left == t0 && new_right == t1) {
+      return t;
+    }
+    return make_branch(p, m, new_left, new_right);
   }
   if (m < n && match_prefix(q, p, m)) {
     // q contains p. Intersect t with a subtree of s.
-    return intersect(combine, is_zero_bit(q, m) ? s0 : s1, t);
+    return intersect(combine, is_zero_bit(q, m) ? s0 : s1, t, combine_id);
   }
   if (m > n && match_prefix(p, q, n)) {
     // p contains q. Intersect s with a subtree of t.
-    return intersect(combine, s, is_zero_bit(p, n) ? t0 : t1);
+    return intersect(combine, s, is_zero_bit(p, n) ? t0 : t1, combine_id);
   }
   // The prefixes disagree.
   return nullptr;
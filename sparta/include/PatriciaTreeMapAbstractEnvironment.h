@@ -247,25 +247,37 @@ class MapValue final : public AbstractValue<MapValue<Variable, Domain>> {
 
   AbstractValueKind join_with(const MapValue& other) override {
     return join_like_operation(
-        other, [](const Domain& x, const Domain& y) { return x.join(y); });
+        other,
+        [](const Domain& x, const Domain& y) { return x.join(y); },
+        JOIN_ID);
   }
 
   AbstractValueKind widen_with(const MapValue& other) override {
     return join_like_operation(
-        other, [](const Domain& x, const Domain& y) { return x.widening(y); });
+        other,
+        [](const Domain& x, const Domain& y) { return x.widening(y); },
+        WIDEN_ID);
   }
 
   AbstractValueKind meet_with(const MapValue& other) override {
     return meet_like_operation(
-        other, [](const Domain& x, const Domain& y) { return x.meet(y); });
+        other,
+        [](const Domain& x, const Domain& y) { return x.meet(y); },
+        MEET_ID);
   }
 
   AbstractValueKind narrow_with(const MapValue& other) override {
     return meet_like_operation(
-        other, [](const Domain& x, const Domain& y) { return x.narrowing(y); });
+        other,
+        [](const Domain& x, const Domain& y) { return x.narrowing(y); },
+        NARROW_ID);
   }
 
  private:
+  // Identify the combining functions for memoization in the underlying map,
+  // see set_patricia_tree_hash_consing().
+  enum : uint32_t { JOIN_ID = 1, WIDEN_ID, MEET_ID, NARROW_ID };
+
   void insert_binding(const Variable& variable, const Domain& value) {
     // The Bottom value is handled by the caller and should never occur here.
     RUNTIME_CHECK(!value.is_bottom(), internal_error());
@@ -280,14 +292,16 @@ class MapValue final : public AbstractValue<MapValue<Variable, Domain>> {
 
   AbstractValueKind join_like_operation(
       const MapValue& other,
-      std::function<Domain(const Domain&, const Domain&)> operation) {
-    m_map.intersection_with(operation, other.m_map);
+      std::function<Domain(const Domain&, const Domain&)> operation,
+      uint32_t operation_id) {
+    m_map.intersection_with(operation, other.m_map, operation_id);
     return kind();
   }
 
   AbstractValueKind meet_like_operation(
       const MapValue& other,
-      std::function<Domain(const Domain&, const Domain&)> operation) {
+      std::function<Domain(const Domain&, const Domain&)> operation,
+      uint32_t operation_id) {
     try {
       m_map.union_with(
           [&operation](const Domain& x, const Domain& y) {
@@ -297,7 +311,8 @@ class MapValue final : public AbstractValue<MapValue<Variable, Domain>> {
             }
             return result;
           },
-          other.m_map);
+          other.m_map,
+          operation_id);
       return kind();
     } catch (const value_is_bottom&) {
       clear();
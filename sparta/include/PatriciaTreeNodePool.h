@@ -0,0 +1,378 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace sparta {
+
+/*
+ * The source of the memory of the nodes of Patricia trees, which analyses
+ * allocate and free in huge numbers. Each node records the pool it came from,
+ * so that it goes back to that pool when it is freed, and a pool must outlive
+ * all the nodes it allocated.
+ */
+class NodePool {
+ public:
+  virtual ~NodePool() = default;
+
+  virtual void* allocate(size_t size) = 0;
+
+  virtual void deallocate(void* ptr, size_t size) noexcept = 0;
+};
+
+/*
+ * A pool of fixed-size blocks in size classes of 16 bytes, carved out of
+ * large chunks. Each thread allocates from and frees to its own free lists,
+ * without synchronization, and only takes the lock of the pool to get a new
+ * batch of blocks, to spill the blocks it frees beyond kMaxCachedBlocks per
+ * size class, to free a block of this pool while it allocates from another
+ * one, and when it exits. The cap matters when nodes are allocated on one
+ * long-lived thread and freed on another: the freed blocks flow back to the
+ * allocating thread through the shared lists instead of piling up. Destroying
+ * the pool releases all its chunks at once. Larger blocks come from the global
+ * operator new.
+ */
+class FreeListNodePool final : public NodePool {
+ public:
+  static constexpr size_t kGranularity = 16;
+  static constexpr size_t kNumClasses = 16;
+  static constexpr size_t kMaxBlockSize = kGranularity * kNumClasses;
+  static constexpr size_t kChunkSize = 64 * 1024;
+  static constexpr size_t kBatchSize = 32;
+  static constexpr size_t kMaxCachedBlocks = 8 * kBatchSize;
+
+  FreeListNodePool() : m_id(next_id()) { registry().add(m_id, this); }
+
+  ~FreeListNodePool() override {
+    registry().remove(m_id);
+    for (auto* chunk : m_chunks) {
+      ::operator delete(chunk);
+    }
+  }
+
+  FreeListNodePool(const FreeListNodePool&) = delete;
+  FreeListNodePool& operator=(const FreeListNodePool&) = delete;
+
+  void* allocate(size_t size) override {
+    if (size > kMaxBlockSize) {
+      return ::operator new(size);
+    }
+    size_t cls = size_class(size);
+    auto& cache = thread_cache();
+    if (cache.pool_id != m_id) {
+      if (cache.pool_id == kExitedThread) {
+        return allocate_locked(cls);
+      }
+      cache.switch_to(m_id);
+    }
+    if (cache.free_lists[cls] == nullptr) {
+      refill(&cache, cls);
+    }
+    auto* block = cache.free_lists[cls];
+    cache.free_lists[cls] = block->next;
+    --cache.counts[cls];
+    return block;
+  }
+
+  void deallocate(void* ptr, size_t size) noexcept override {
+    if (size > kMaxBlockSize) {
+      ::operator delete(ptr);
+      return;
+    }
+    size_t cls = size_class(size);
+    auto* block = static_cast<FreeBlock*>(ptr);
+    auto& cache = thread_cache();
+    if (cache.pool_id == m_id) {
+      block->next = cache.free_lists[cls];
+      cache.free_lists[cls] = block;
+      if (++cache.counts[cls] > kMaxCachedBlocks) {
+        spill(&cache, cls);
+      }
+      return;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    block->next = m_shared_free_lists[cls];
+    m_shared_free_lists[cls] = block;
+  }
+
+  // The memory carved into blocks so far, which is only released when the pool
+  // is destroyed.
+  size_t reserved_bytes() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_reserved_bytes;
+  }
+
+  // The default pool of the nodes; it is never destroyed.
+  static FreeListNodePool& global() {
+    static auto* pool = new FreeListNodePool();
+    return *pool;
+  }
+
+ private:
+  struct FreeBlock {
+    FreeBlock* next;
+  };
+
+  using FreeLists = std::array<FreeBlock*, kNumClasses>;
+
+  /*
+   * The pools that are alive, so that a thread can hand the blocks it holds
+   * back to the pool they belong to, if that pool still exists.
+   */
+  class Registry final {
+   public:
+    void add(uint64_t id, FreeListNodePool* pool) {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_pools.emplace(id, pool);
+    }
+
+    void remove(uint64_t id) {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_pools.erase(id);
+    }
+
+    void give_back(uint64_t id, const FreeLists& free_lists) {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      auto it = m_pools.find(id);
+      if (it != m_pools.end()) {
+        it->second->merge_shared(free_lists);
+      }
+    }
+
+   private:
+    std::mutex m_mutex;
+    std::unordered_map<uint64_t, FreeListNodePool*> m_pools;
+  };
+
+  // The id of no pool, for the cache of a thread that is exiting, whose
+  // thread-local destructors may still free nodes.
+  static constexpr uint64_t kExitedThread = UINT64_MAX;
+
+  struct ThreadCache {
+    // Ids start at 1, so no pool matches a fresh cache.
+    uint64_t pool_id{0};
+    FreeLists free_lists{};
+    // The lengths of the free lists.
+    std::array<size_t, kNumClasses> counts{};
+    // The rest of the chunk the thread last got, which it carves blocks from.
+    char* bump{nullptr};
+    char* bump_end{nullptr};
+
+    ~ThreadCache() {
+      give_back();
+      pool_id = kExitedThread;
+    }
+
+    void switch_to(uint64_t id) {
+      give_back();
+      pool_id = id;
+    }
+
+    void give_back() {
+      if (pool_id != 0 && pool_id != kExitedThread) {
+        registry().give_back(pool_id, free_lists);
+      }
+      free_lists.fill(nullptr);
+      counts.fill(0);
+      bump = bump_end = nullptr;
+    }
+  };
+
+  static size_t size_class(size_t size) {
+    return size == 0 ? 0 : (size - 1) / kGranularity;
+  }
+
+  static uint64_t next_id() {
+    static std::atomic<uint64_t> id{0};
+    return ++id;
+  }
+
+  // Leaked, as threads may exit during static destruction.
+  static Registry& registry() {
+    static auto* registry = new Registry();
+    return *registry;
+  }
+
+  static ThreadCache& thread_cache() {
+    static thread_local ThreadCache cache;
+    return cache;
+  }
+
+  // Fills the empty free list of `cls` with a batch of blocks, from the shared
+  // free lists if possible, or else from the thread's chunk.
+  void refill(ThreadCache* cache, size_t cls) {
+    size_t block_size = (cls + 1) * kGranularity;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    FreeBlock* head = nullptr;
+    size_t count = 0;
+    while (count < kBatchSize && m_shared_free_lists[cls] != nullptr) {
+      auto* block = m_shared_free_lists[cls];
+      m_shared_free_lists[cls] = block->next;
+      block->next = head;
+      head = block;
+      ++count;
+    }
+    if (head == nullptr) {
+      if (cache->bump_end - cache->bump < (ptrdiff_t)block_size) {
+        auto* chunk = static_cast<char*>(::operator new(kChunkSize));
+        m_chunks.push_back(chunk);
+        m_reserved_bytes += kChunkSize;
+        cache->bump = chunk;
+        cache->bump_end = chunk + kChunkSize;
+      }
+      // Carve a batch of blocks, so that the lock is taken once per batch.
+      for (; count < kBatchSize; ++count) {
+        if (cache->bump_end - cache->bump < (ptrdiff_t)block_size) {
+          break;
+        }
+        auto* block = reinterpret_cast<FreeBlock*>(cache->bump);
+        cache->bump += block_size;
+        block->next = head;
+        head = block;
+      }
+    }
+    cache->free_lists[cls] = head;
+    cache->counts[cls] = count;
+  }
+
+  // Keeps a batch of blocks in the free list of `cls` and moves the others to
+  // the shared free lists, where any thread can allocate them.
+  void spill(ThreadCache* cache, size_t cls) {
+    auto* last_kept = cache->free_lists[cls];
+    for (size_t i = 1; i < kBatchSize; ++i) {
+      last_kept = last_kept->next;
+    }
+    auto* head = last_kept->next;
+    last_kept->next = nullptr;
+    cache->counts[cls] = kBatchSize;
+    auto* tail = head;
+    while (tail->next != nullptr) {
+      tail = tail->next;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    tail->next = m_shared_free_lists[cls];
+    m_shared_free_lists[cls] = head;
+  }
+
+  void* allocate_locked(size_t cls) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto* block = m_shared_free_lists[cls];
+    if (block != nullptr) {
+      m_shared_free_lists[cls] = block->next;
+      return block;
+    }
+    auto* chunk = static_cast<char*>(::operator new((cls + 1) * kGranularity));
+    m_chunks.push_back(chunk);
+    m_reserved_bytes += (cls + 1) * kGranularity;
+    return chunk;
+  }
+
+  void merge_shared(const FreeLists& free_lists) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (size_t cls = 0; cls < kNumClasses; ++cls) {
+      auto* head = free_lists[cls];
+      if (head == nullptr) {
+        continue;
+      }
+      auto* tail = head;
+      while (tail->next != nullptr) {
+        tail = tail->next;
+      }
+      tail->next = m_shared_free_lists[cls];
+      m_shared_free_lists[cls] = head;
+    }
+  }
+
+  const uint64_t m_id;
+  mutable std::mutex m_mutex;
+  FreeLists m_shared_free_lists{};
+  std::vector<char*> m_chunks;
+  size_t m_reserved_bytes{0};
+};
+
+namespace pt_util {
+
+inline std::atomic<NodePool*>& current_node_pool() {
+  static std::atomic<NodePool*> pool{&FreeListNodePool::global()};
+  return pool;
+}
+
+/*
+ * A standard allocator over a NodePool, which std::allocate_shared keeps in
+ * the control block of the node.
+ */
+template <typename T>
+class NodeAllocator {
+ public:
+  using value_type = T;
+
+  explicit NodeAllocator(NodePool* pool) : m_pool(pool) {}
+
+  template <typename U>
+  NodeAllocator(const NodeAllocator<U>& other) // NOLINT
+      : m_pool(other.pool()) {}
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(m_pool->allocate(n * sizeof(T)));
+  }
+
+  void deallocate(T* ptr, size_t n) noexcept {
+    m_pool->deallocate(ptr, n * sizeof(T));
+  }
+
+  NodePool* pool() const { return m_pool; }
+
+  template <typename U>
+  bool operator==(const NodeAllocator<U>& other) const {
+    return m_pool == other.pool();
+  }
+
+  template <typename U>
+  bool operator!=(const NodeAllocator<U>& other) const {
+    return m_pool != other.pool();
+  }
+
+ private:
+  NodePool* m_pool;
+};
+
+// Allocates a tree node, along with its reference count, from the current
+// pool.
+template <typename Node, typename... Args>
+inline std::shared_ptr<Node> make_node(Args&&... args) {
+  return std::allocate_shared<Node>(
+      NodeAllocator<Node>(current_node_pool().load(std::memory_order_relaxed)),
+      std::forward<Args>(args)...);
+}
+
+} // namespace pt_util
+
+/*
+ * Sets the pool that the nodes of all Patricia trees, maps and sets alike,
+ * are allocated from from now on, e.g. one that only lives as long as an
+ * analysis, and returns the previous one. Null restores the default pool.
+ * Nodes that already exist keep going back to the pool they came from.
+ */
+inline NodePool* set_patricia_tree_node_pool(NodePool* pool) {
+  if (pool == nullptr) {
+    pool = &FreeListNodePool::global();
+  }
+  return pt_util::current_node_pool().exchange(pool);
+}
+
+} // namespace sparta
@@ -22,6 +22,7 @@
 #include <boost/functional/hash.hpp>
 
 #include "Exceptions.h"
+#include "PatriciaTreeNodePool.h"
 #include "PatriciaTreeUtil.h"
 
 namespace sparta {
@@ -417,10 +418,10 @@ std::shared_ptr<PatriciaTreeBranch<IntegerType>> join(
     const std::shared_ptr<PatriciaTree<IntegerType>>& tree1) {
   IntegerType m = get_branching_bit(prefix0, prefix1);
   if (is_zero_bit(prefix0, m)) {
-    return std::make_shared<PatriciaTreeBranch<IntegerType>>(
+    return make_node<PatriciaTreeBranch<IntegerType>>(
         mask(prefix0, m), m, tree0, tree1);
   } else {
-    return std::make_shared<PatriciaTreeBranch<IntegerType>>(
+    return make_node<PatriciaTreeBranch<IntegerType>>(
         mask(prefix0, m), m, tree1, tree0);
   }
 }
@@ -439,7 +440,7 @@ std::shared_ptr<PatriciaTree<IntegerType>> make_branch(
   if (right_tree == nullptr) {
     return left_tree;
   }
-  return std::make_shared<PatriciaTreeBranch<IntegerType>>(
+  return make_node<PatriciaTreeBranch<IntegerType>>(
       prefix, branching_bit, left_tree, right_tree);
 }
 
@@ -557,7 +558,7 @@ template <typename IntegerType>
 inline std::shared_ptr<PatriciaTree<IntegerType>> insert(
     IntegerType key, const std::shared_ptr<PatriciaTree<IntegerType>>& tree) {
   if (tree == nullptr) {
-    return std::make_shared<PatriciaTreeLeaf<IntegerType>>(key);
+    return make_node<PatriciaTreeLeaf<IntegerType>>(key);
   }
   if (tree->is_leaf()) {
     const auto& leaf =
@@ -567,7 +568,7 @@ inline std::shared_ptr<PatriciaTree<IntegerType>> insert(
     }
     return join<IntegerType>(
         key,
-        std::make_shared<PatriciaTreeLeaf<IntegerType>>(key),
+        make_node<PatriciaTreeLeaf<IntegerType>>(key),
         leaf->key(),
         leaf);
   }
@@ -579,7 +580,7 @@ inline std::shared_ptr<PatriciaTree<IntegerType>> insert(
       if (new_left_tree == branch->left_tree()) {
         return branch;
       }
-      return std::make_shared<PatriciaTreeBranch<IntegerType>>(
+      return make_node<PatriciaTreeBranch<IntegerType>>(
           branch->prefix(),
           branch->branching_bit(),
           new_left_tree,
@@ -589,7 +590,7 @@ inline std::shared_ptr<PatriciaTree<IntegerType>> insert(
       if (new_right_tree == branch->right_tree()) {
         return branch;
       }
-      return std::make_shared<PatriciaTreeBranch<IntegerType>>(
+      return make_node<PatriciaTreeBranch<IntegerType>>(
           branch->prefix(),
           branch->branching_bit(),
           branch->left_tree(),
@@ -597,7 +598,7 @@ inline std::shared_ptr<PatriciaTree<IntegerType>> insert(
     }
   }
   return join<IntegerType>(key,
-                           std::make_shared<PatriciaTreeLeaf<IntegerType>>(key),
+                           make_node<PatriciaTreeLeaf<IntegerType>>(key),
                            branch->prefix(),
                            branch);
 }
@@ -721,7 +722,7 @@ inline std::shared_ptr<PatriciaTree<IntegerType>> merge(
     if (new_left == t0 && new_right == t1) {
       return t;
     }
-    return std::make_shared<PatriciaTreeBranch<IntegerType>>(
+    return make_node<PatriciaTreeBranch<IntegerType>>(
         p, m, new_left, new_right);
   }
   if (m < n && match_prefix(q, p, m)) {
@@ -731,15 +732,13 @@ inline std::shared_ptr<PatriciaTree<IntegerType>> merge(
       if (s0 == new_left) {
         return s;
       }
-      return std::make_shared<PatriciaTreeBranch<IntegerType>>(
-          p, m, new_left, s1);
+      return make_node<PatriciaTreeBranch<IntegerType>>(p, m, new_left, s1);
     } else {
       auto new_right = merge(s1, t);
       if (s1 == new_right) {
         return s;
       }
-      return std::make_shared<PatriciaTreeBranch<IntegerType>>(
-          p, m, s0, new_right);
+      return make_node<PatriciaTreeBranch<IntegerType>>(p, m, s0, new_right);
     }
   }
   if (m > n && match_prefix(p, q, n)) {
@@ -749,15 +748,13 @@ inline std::shared_ptr<PatriciaTree<IntegerType>> merge(
       if (t0 == new_left) {
         return t;
       }
-      return std::make_shared<PatriciaTreeBranch<IntegerType>>(
-          q, n, new_left, t1);
+      return make_node<PatriciaTreeBranch<IntegerType>>(q, n, new_left, t1);
     } else {
       auto new_right = merge(s, t1);
       if (t1 == new_right) {
         return t;
       }
-      return std::make_shared<PatriciaTreeBranch<IntegerType>>(
-          q, n, t0, new_right);
+      return make_node<PatriciaTreeBranch<IntegerType>>(q, n, t0, new_right);
     }
   }
   // The prefixes disagree.
@@ -7,6 +7,8 @@
 
 #pragma once
 
+#include <atomic>
+
 namespace sparta {
 
 namespace pt_util {
@@ -36,6 +38,12 @@ IntegerType match_prefix(IntegerType k, IntegerType p, IntegerType m) {
   return mask(k, m) == p;
 }
 
+// See set_patricia_tree_hash_consing() in PatriciaTreeMap.h.
+inline std::atomic<bool>& hash_consing_enabled() {
+  static std::atomic<bool> enabled{false};
+  return enabled;
+}
+
 } // namespace pt_util
 
 } // namespace sparta
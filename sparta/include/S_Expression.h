@@ -18,7 +18,6 @@
 #include <memory>
 #include <ostream>
 #include <sstream>
-#include <stack>
 #include <string>
 #include <vector>
 
@@ -91,6 +90,8 @@ class s_expr final {
    */
   explicit s_expr(const std::string& s);
 
+  explicit s_expr(std::string&& s);
+
   /*
    * Various constructors for a list. The empty list (nil) can be constructed
    * with `s_expr({})`.
@@ -99,6 +100,8 @@ class s_expr final {
 
   explicit s_expr(const std::vector<s_expr>& l);
 
+  explicit s_expr(std::vector<s_expr>&& l);
+
   template <typename InputIterator>
   s_expr(InputIterator first, InputIterator last);
 
@@ -183,13 +186,11 @@ class s_expr final {
   friend size_t hash_value(const s_expr& e) { return e.hash_value(); }
 
  private:
-  // Appends an element to a list. This operation is used during parsing.
-  void add_element(const s_expr& element);
+  explicit s_expr(std::shared_ptr<s_expr_impl::Component> component)
+      : m_component(std::move(component)) {}
 
   // By construction, m_component can never be null.
   std::shared_ptr<s_expr_impl::Component> m_component;
-
-  friend class s_expr_istream;
 };
 
 } // namespace sparta
@@ -258,9 +259,16 @@ class s_expr_istream final {
 
   void skip_white_spaces();
 
+  // Adds an S-expression to the list being parsed, or returns it if it is at
+  // the top level.
+  bool emit(s_expr&& e, s_expr* expr);
+
   void set_status(Status status, const std::string& what_arg);
 
-  std::stack<s_expr> m_stack;
+  // The elements of the lists being parsed, innermost last.
+  std::vector<std::vector<s_expr>> m_stack;
+  // The characters of the symbol being parsed, kept to reuse its buffer.
+  std::string m_symbol;
   std::istream& m_input;
   size_t m_line_number;
   Status m_status;
@@ -374,8 +382,9 @@ enum class ComponentKind { Int32Atom, StringAtom, List };
 // Checks whether a character belongs to a Lisp-like symbol, i.e., a string atom
 // that can be represented without quotes.
 inline bool is_symbol_char(char c) {
-  return std::isalnum(c) || c == '_' || c == '-' || c == '/' || c == ':' ||
-         c == '.';
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9') || c == '_' || c == '-' || c == '/' ||
+         c == ':' || c == '.';
 }
 
 class Component {
@@ -412,7 +421,7 @@ class Int32Atom final : public Component {
     if (other->kind() != ComponentKind::Int32Atom) {
       return false;
     }
-    auto n = std::static_pointer_cast<Int32Atom>(other);
+    auto n = static_cast<const Int32Atom*>(other.get());
     return m_value == n->m_value;
   }
 
@@ -429,8 +438,8 @@ class Int32Atom final : public Component {
 
 class StringAtom final : public Component {
  public:
-  explicit StringAtom(const std::string& s)
-      : Component(ComponentKind::StringAtom), m_string(s) {}
+  explicit StringAtom(std::string s)
+      : Component(ComponentKind::StringAtom), m_string(std::move(s)) {}
 
   const std::string& get_string() const { return m_string; }
 
@@ -443,7 +452,7 @@ class StringAtom final : public Component {
     if (other->kind() != ComponentKind::StringAtom) {
       return false;
     }
-    auto s = std::static_pointer_cast<StringAtom>(other);
+    auto s = static_cast<const StringAtom*>(other.get());
     return m_string == s->m_string;
   }
 
@@ -475,37 +484,50 @@ class StringAtom final : public Component {
   std::string m_string;
 };
 
+/*
+ * The elements of a list are a range of a vector that its tails share, so that
+ * taking a tail, as pattern matching does, doesn't copy them.
+ */
 class List final : public Component {
  public:
-  List() : Component(ComponentKind::List), m_list(0) { m_list.shrink_to_fit(); }
+  using Elements = std::vector<s_expr>;
+
+  List() : Component(ComponentKind::List) {}
 
   template <typename InputIterator>
   List(InputIterator first, InputIterator last)
-      : Component(ComponentKind::List), m_list(first, last) {
-    m_list.shrink_to_fit();
+      : List(Elements(first, last)) {}
+
+  explicit List(Elements&& elements) : Component(ComponentKind::List) {
+    if (!elements.empty()) {
+      m_size = elements.size();
+      m_elements = std::make_shared<Elements>(std::move(elements));
+    }
   }
 
-  size_t size() const { return m_list.size(); }
+  List(std::shared_ptr<Elements> elements, size_t begin, size_t size)
+      : Component(ComponentKind::List),
+        m_elements(std::move(elements)),
+        m_begin(begin),
+        m_size(size) {}
 
-  s_expr get_element(size_t index) const {
-    try {
-      return m_list.at(index);
-    } catch (const std::out_of_range& e) {
-      // The `at` function throws an exception if the index doesn't lie within
-      // the bounds of the vector.
-      BOOST_THROW_EXCEPTION(invalid_argument() << argument_name("index"));
-    }
+  size_t size() const { return m_size; }
+
+  const s_expr& get_element(size_t index) const {
+    RUNTIME_CHECK(index < m_size, invalid_argument() << argument_name("index"));
+    return (*m_elements)[m_begin + index];
   }
 
-  s_expr tail(size_t index) const {
-    RUNTIME_CHECK(index <= m_list.size(),
+  std::shared_ptr<Component> tail(size_t index) const {
+    RUNTIME_CHECK(index <= m_size,
                   invalid_argument() << argument_name("index"));
-    // If index == m_list.size(), the function returns the empty list.
-    return s_expr(std::next(m_list.begin(), index), m_list.end());
+    // If index == m_size, the function returns the empty list.
+    if (index == m_size) {
+      return std::make_shared<List>();
+    }
+    return std::make_shared<List>(m_elements, m_begin + index, m_size - index);
   }
 
-  void add_element(const s_expr& element) { m_list.push_back(element); }
-
   bool equals(const std::shared_ptr<Component>& other) const {
     if (this == other.get()) {
       // Since S-expressions can share structure, checking for pointer equality
@@ -515,26 +537,23 @@ class List final : public Component {
     if (other->kind() != ComponentKind::List) {
       return false;
     }
-    auto l = std::static_pointer_cast<List>(other);
-    if (l->m_list.size() != m_list.size()) {
+    auto l = static_cast<const List*>(other.get());
+    if (l->m_size != m_size) {
       return false;
     }
     return std::equal(
-        m_list.begin(),
-        m_list.end(),
-        l->m_list.begin(),
-        [](const s_expr& e1, const s_expr& e2) { return e1.equals(e2); });
+        begin(), end(), l->begin(), [](const s_expr& e1, const s_expr& e2) {
+          return e1.equals(e2);
+        });
   }
 
-  size_t hash_value() const {
-    return boost::hash_range(m_list.begin(), m_list.end());
-  }
+  size_t hash_value() const { return boost::hash_range(begin(), end()); }
 
   void print(std::ostream& output) const {
     output << "(";
-    for (auto it = m_list.begin(); it != m_list.end(); ++it) {
+    for (auto it = begin(); it != end(); ++it) {
       it->print(output);
-      if (std::next(it) != m_list.end()) {
+      if (std::next(it) != end()) {
         output << " ";
       }
     }
@@ -542,7 +561,16 @@ class List final : public Component {
   }
 
  private:
-  std::vector<s_expr> m_list;
+  const s_expr* begin() const {
+    return m_size == 0 ? nullptr : m_elements->data() + m_begin;
+  }
+
+  const s_expr* end() const { return begin() + m_size; }
+
+  // Null for the empty list.
+  std::shared_ptr<Elements> m_elements;
+  size_t m_begin{0};
+  size_t m_size{0};
 };
 
 class Pattern {
@@ -658,12 +686,18 @@ inline s_expr::s_expr(int32_t n)
 inline s_expr::s_expr(const std::string& s)
     : m_component(std::make_shared<s_expr_impl::StringAtom>(s)) {}
 
+inline s_expr::s_expr(std::string&& s)
+    : m_component(std::make_shared<s_expr_impl::StringAtom>(std::move(s))) {}
+
 inline s_expr::s_expr(std::initializer_list<s_expr> l)
     : m_component(std::make_shared<s_expr_impl::List>(l.begin(), l.end())) {}
 
 inline s_expr::s_expr(const std::vector<s_expr>& l)
     : m_component(std::make_shared<s_expr_impl::List>(l.begin(), l.end())) {}
 
+inline s_expr::s_expr(std::vector<s_expr>&& l)
+    : m_component(std::make_shared<s_expr_impl::List>(std::move(l))) {}
+
 template <typename InputIterator>
 inline s_expr::s_expr(InputIterator first, InputIterator last)
     : m_component(std::make_shared<s_expr_impl::List>(first, last)) {}
@@ -686,30 +720,31 @@ inline bool s_expr::is_list() const {
 
 inline int32_t s_expr::get_int32() const {
   RUNTIME_CHECK(is_int32(), undefined_operation());
-  return std::static_pointer_cast<s_expr_impl::Int32Atom>(m_component)
+  return static_cast<const s_expr_impl::Int32Atom*>(m_component.get())
       ->get_value();
 }
 
 inline const std::string& s_expr::get_string() const {
   RUNTIME_CHECK(is_string(), undefined_operation());
-  return std::static_pointer_cast<s_expr_impl::StringAtom>(m_component)
+  return static_cast<const s_expr_impl::StringAtom*>(m_component.get())
       ->get_string();
 }
 
 inline size_t s_expr::size() const {
   RUNTIME_CHECK(is_list(), undefined_operation());
-  return std::static_pointer_cast<s_expr_impl::List>(m_component)->size();
+  return static_cast<const s_expr_impl::List*>(m_component.get())->size();
 }
 
 inline s_expr s_expr::operator[](size_t index) const {
   RUNTIME_CHECK(is_list(), undefined_operation());
-  return std::static_pointer_cast<s_expr_impl::List>(m_component)
+  return static_cast<const s_expr_impl::List*>(m_component.get())
       ->get_element(index);
 }
 
 inline s_expr s_expr::tail(size_t index) const {
   RUNTIME_CHECK(is_list(), undefined_operation());
-  return std::static_pointer_cast<s_expr_impl::List>(m_component)->tail(index);
+  return s_expr(
+      static_cast<const s_expr_impl::List*>(m_component.get())->tail(index));
 }
 
 inline bool s_expr::equals(const s_expr& other) const {
@@ -733,18 +768,15 @@ inline std::string s_expr::str() const {
   return out.str();
 }
 
-inline void s_expr::add_element(const s_expr& element) {
-  RUNTIME_CHECK(m_component->kind() == s_expr_impl::ComponentKind::List,
-                invalid_argument() << argument_name("element")
-                                   << operation_name("s_expr::add_element()"));
-  auto list = std::static_pointer_cast<s_expr_impl::List>(m_component);
-  list->add_element(element);
-}
-
 inline s_expr_istream& s_expr_istream::operator>>(s_expr& expr) {
+  // The characters are read from the buffer of the stream directly, which
+  // saves setting up the stream for each one.
+  auto* buf = m_input.rdbuf();
+  constexpr auto eof = std::char_traits<char>::eof();
   for (;;) {
     skip_white_spaces();
-    if (!m_input.good()) {
+    int next = buf->sgetc();
+    if (next == eof || !m_input.good()) {
       if (!m_stack.empty()) {
         set_status(Status::Fail, "Incomplete S-expression");
       } else {
@@ -752,11 +784,11 @@ inline s_expr_istream& s_expr_istream::operator>>(s_expr& expr) {
       }
       return *this;
     }
-    char next_char = m_input.peek();
+    char next_char = static_cast<char>(next);
     switch (next_char) {
     case '(': {
-      m_stack.emplace();
-      m_input.get();
+      m_stack.emplace_back();
+      buf->sbumpc();
       break;
     }
     case ')': {
@@ -764,30 +796,27 @@ inline s_expr_istream& s_expr_istream::operator>>(s_expr& expr) {
         set_status(Status::Fail, "Extra ')' encountered");
         return *this;
       }
-      m_input.get();
-      s_expr list = m_stack.top();
-      m_stack.pop();
-      if (m_stack.empty()) {
-        expr = list;
+      buf->sbumpc();
+      s_expr list(std::move(m_stack.back()));
+      m_stack.pop_back();
+      if (emit(std::move(list), &expr)) {
         return *this;
       }
-      m_stack.top().add_element(list);
       break;
     }
     case '#': {
-      m_input.get();
+      buf->sbumpc();
       int32_t n;
       m_input >> n;
       if (m_input.fail()) {
         set_status(Status::Fail, "Error parsing int32_t literal");
         return *this;
       }
-      s_expr atom(n);
-      if (m_stack.empty()) {
-        expr = atom;
+      // Reaching the end of the input after the literal is not an error.
+      m_input.clear();
+      if (emit(s_expr(n), &expr)) {
         return *this;
       }
-      m_stack.top().add_element(atom);
       break;
     }
     case '"': {
@@ -797,16 +826,17 @@ inline s_expr_istream& s_expr_istream::operator>>(s_expr& expr) {
         set_status(Status::Fail, "Error parsing string literal");
         return *this;
       }
-      s_expr atom(s);
-      if (m_stack.empty()) {
-        expr = atom;
+      m_input.clear();
+      if (emit(s_expr(std::move(s)), &expr)) {
         return *this;
       }
-      m_stack.top().add_element(atom);
       break;
     }
     case ';': {
-      m_input.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+      int c;
+      do {
+        c = buf->sbumpc();
+      } while (c != eof && c != '\n');
       ++m_line_number;
       break;
     }
@@ -818,31 +848,39 @@ inline s_expr_istream& s_expr_istream::operator>>(s_expr& expr) {
         set_status(Status::Fail, out.str());
         return *this;
       }
-      std::ostringstream symbol;
-      while (m_input.good() && s_expr_impl::is_symbol_char(next_char)) {
-        symbol << next_char;
-        m_input.get();
-        next_char = m_input.peek();
+      m_symbol.clear();
+      while (next != eof && s_expr_impl::is_symbol_char(next_char)) {
+        m_symbol.push_back(next_char);
+        buf->sbumpc();
+        next = buf->sgetc();
+        next_char = static_cast<char>(next);
       }
-      s_expr atom(symbol.str());
-      if (m_stack.empty()) {
-        expr = atom;
+      if (emit(s_expr(m_symbol), &expr)) {
         return *this;
       }
-      m_stack.top().add_element(atom);
     }
     }
   }
 }
 
+inline bool s_expr_istream::emit(s_expr&& e, s_expr* expr) {
+  if (m_stack.empty()) {
+    *expr = std::move(e);
+    return true;
+  }
+  m_stack.back().push_back(std::move(e));
+  return false;
+}
+
 inline void s_expr_istream::skip_white_spaces() {
+  auto* buf = m_input.rdbuf();
   for (;;) {
-    char c = m_input.peek();
-    if (m_input.good() && std::isspace(c)) {
+    int c = buf->sgetc();
+    if (c != std::char_traits<char>::eof() && std::isspace(c)) {
       if (c == '\n') {
         ++m_line_number;
       }
-      m_input.get();
+      buf->sbumpc();
     } else {
       return;
     }
@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace sparta {
+
+namespace parallel {
+
+/*
+ * A pool of long-lived worker threads. Threads are created lazily, up to the
+ * largest number ever requested via `ensure_threads`, and are parked on a
+ * condition variable while there is no job to run. This lets clients that
+ * repeatedly fan out work (such as SpartaWorkQueue::run_all) avoid paying for
+ * thread creation and teardown on every run.
+ *
+ * With `pin_threads`, the n-th pool thread is bound to the n-th CPU the
+ * process may run on (worker 0 of a run being the calling thread). CPUs are
+ * numbered node by node on common multi-socket hosts, so workers of a run
+ * stay on as few NUMA nodes as possible, and what each touches first is
+ * allocated on its node. Pinning is only supported on Linux.
+ */
+class ThreadPool {
+ public:
+  explicit ThreadPool(bool pin_threads = false) : m_pin_threads(pin_threads) {}
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stopping = true;
+    }
+    m_cv.notify_all();
+    for (auto& thread : m_threads) {
+      thread.join();
+    }
+  }
+
+  size_t num_threads() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_threads.size();
+  }
+
+  // Grow the pool so that it has at least `n` threads.
+  void ensure_threads(size_t n) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    while (m_threads.size() < n) {
+      m_threads.emplace_back([this]() { worker_loop(); });
+      if (m_pin_threads) {
+        pin_to_cpu(m_threads.back(), m_threads.size());
+      }
+    }
+  }
+
+  // Enqueue a job. This method is thread safe.
+  void post(std::function<void()> job) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_jobs.push_back(std::move(job));
+    }
+    m_cv.notify_one();
+  }
+
+  /*
+   * Run `fn(0)` ... `fn(n - 1)` where `fn(0)` is run on the calling thread and
+   * the others are posted as pool jobs. Blocks until `fn(0)` has returned and
+   * every posted job that did start has returned too. Posted jobs that had not
+   * started by then are skipped.
+   *
+   * This fits workers that drain a shared pool of tasks: the caller alone is
+   * always able to finish all the work, so nesting never deadlocks even when
+   * every pool thread is busy, and helpers only add parallelism.
+   */
+  template <typename Fn>
+  void run_workers(size_t n, const Fn& fn) {
+    struct RunState {
+      std::mutex mtx;
+      std::condition_variable cv;
+      size_t active{0};
+      bool closed{false};
+    };
+    auto state = std::make_shared<RunState>();
+    if (n > 1) {
+      ensure_threads(n - 1);
+    }
+    for (size_t i = 1; i < n; ++i) {
+      post([state, &fn, i]() {
+        {
+          std::lock_guard<std::mutex> lock(state->mtx);
+          if (state->closed) {
+            return;
+          }
+          ++state->active;
+        }
+        fn(i);
+        std::lock_guard<std::mutex> lock(state->mtx);
+        if (--state->active == 0 && state->closed) {
+          state->cv.notify_all();
+        }
+      });
+    }
+    fn(0);
+    std::unique_lock<std::mutex> lock(state->mtx);
+    state->closed = true;
+    while (state->active != 0) {
+      state->cv.wait(lock);
+    }
+  }
+
+ private:
+  // Binds `thread` to the `idx`-th allowed CPU, wrapping around. Failures
+  // leave the thread unpinned.
+  static void pin_to_cpu(std::thread& thread, size_t idx) {
+#ifdef __linux__
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+      return;
+    }
+    size_t num_allowed = CPU_COUNT(&allowed);
+    if (num_allowed == 0) {
+      return;
+    }
+    size_t target = idx % num_allowed;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &allowed) && target-- == 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+        return;
+      }
+    }
+#else
+    (void)thread;
+    (void)idx;
+#endif
+  }
+
+  void worker_loop() {
+    while (true) {
+      std::function<void()> job;
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (m_jobs.empty() && !m_stopping) {
+          m_cv.wait(lock);
+        }
+        if (m_jobs.empty()) {
+          return;
+        }
+        job = std::move(m_jobs.front());
+        m_jobs.pop_front();
+      }
+      job();
+    }
+  }
+
+  mutable std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::deque<std::function<void()>> m_jobs;
+  std::vector<std::thread> m_threads;
+  bool m_stopping{false};
+  const bool m_pin_threads;
+};
+
+namespace thread_pool_impl {
+inline std::atomic<ThreadPool*>& shared_thread_pool_slot() {
+  static std::atomic<ThreadPool*> pool{nullptr};
+  return pool;
+}
+} // namespace thread_pool_impl
+
+/*
+ * The process-wide pool that work queues dispatch onto, if any. When no pool
+ * has been installed, work queues spawn and join their own threads.
+ */
+inline ThreadPool* get_shared_thread_pool() {
+  return thread_pool_impl::shared_thread_pool_slot().load();
+}
+
+// The caller keeps ownership of the pool. Passing nullptr uninstalls it.
+inline void set_shared_thread_pool(ThreadPool* pool) {
+  thread_pool_impl::shared_thread_pool_slot().store(pool);
+}
+
+} // namespace parallel
+
+} // namespace sparta
@@ -12,14 +12,19 @@
 #include <boost/optional/optional.hpp>
 #include <chrono>
 #include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
 #include <mutex>
 #include <numeric>
 #include <queue>
 #include <random>
 #include <thread>
 #include <utility>
+#include <vector>
 
 #include "Arity.h"
+#include "SpartaThreadPool.h"
 
 namespace sparta {
 
@@ -92,6 +97,10 @@ class Semaphore {
 struct StateCounters {
   std::atomic_uint num_non_empty;
   std::atomic_uint num_running;
+  // Only used in work-stealing mode: tasks pushed but not yet finished, and
+  // workers parked on `waiter`.
+  std::atomic<size_t> num_outstanding;
+  std::atomic_uint num_sleeping;
   const unsigned int num_all;
   // Mutexes aren't move-able.
   std::unique_ptr<Semaphore> waiter;
@@ -99,15 +108,157 @@ struct StateCounters {
   explicit StateCounters(unsigned int num)
       : num_non_empty(0),
         num_running(0),
+        num_outstanding(0),
+        num_sleeping(0),
         num_all(num),
         waiter(new Semaphore(0)) {}
   StateCounters(StateCounters&& other)
       : num_non_empty(other.num_non_empty.load()),
         num_running(other.num_running.load()),
+        num_outstanding(other.num_outstanding.load()),
+        num_sleeping(other.num_sleeping.load()),
         num_all(other.num_all),
         waiter(std::move(other.waiter)) {}
 };
 
+/**
+ * A lock-free work-stealing deque, after Chase and Lev, "Dynamic Circular
+ * Work-Stealing Deque" (SPAA'05), using the C11 memory orderings given by Le
+ * et al., "Correct and Efficient Work-Stealing for Weak Memory Models"
+ * (PPoPP'13).
+ *
+ * Only the owning thread may call `push` and `pop`, which operate on the
+ * bottom end of the deque in LIFO order. Any thread may call `steal`, which
+ * takes from the top end. Elements must be trivially copyable; the work queue
+ * stores pointers to tasks.
+ */
+template <class T>
+class ChaseLevDeque {
+ public:
+  enum class StealResult { SUCCESS, EMPTY, ABORT };
+
+  explicit ChaseLevDeque(size_t initial_capacity = 64) {
+    size_t capacity = 1;
+    while (capacity < initial_capacity) {
+      capacity <<= 1;
+    }
+    m_arrays.emplace_back(std::make_unique<Array>(capacity));
+    m_array.store(m_arrays.back().get(), std::memory_order_relaxed);
+  }
+
+  ChaseLevDeque(const ChaseLevDeque&) = delete;
+  ChaseLevDeque& operator=(const ChaseLevDeque&) = delete;
+
+  void push(T x) {
+    auto b = m_bottom.load(std::memory_order_relaxed);
+    auto t = m_top.load(std::memory_order_acquire);
+    auto* a = m_array.load(std::memory_order_relaxed);
+    if (b - t > static_cast<int64_t>(a->capacity) - 1) {
+      a = grow(a, t, b);
+    }
+    a->put(b, x);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_bottom.store(b + 1, std::memory_order_relaxed);
+  }
+
+  bool pop(T* out) {
+    auto b = m_bottom.load(std::memory_order_relaxed) - 1;
+    auto* a = m_array.load(std::memory_order_relaxed);
+    m_bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto t = m_top.load(std::memory_order_relaxed);
+    if (t > b) {
+      // Empty.
+      m_bottom.store(b + 1, std::memory_order_relaxed);
+      return false;
+    }
+    *out = a->get(b);
+    if (t == b) {
+      // Last element; race against thieves for it.
+      bool won = m_top.compare_exchange_strong(
+          t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+      m_bottom.store(b + 1, std::memory_order_relaxed);
+      return won;
+    }
+    return true;
+  }
+
+  StealResult steal(T* out) {
+    auto t = m_top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto b = m_bottom.load(std::memory_order_acquire);
+    if (t >= b) {
+      return StealResult::EMPTY;
+    }
+    auto* a = m_array.load(std::memory_order_acquire);
+    T x = a->get(t);
+    if (!m_top.compare_exchange_strong(
+            t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+      return StealResult::ABORT;
+    }
+    *out = x;
+    return StealResult::SUCCESS;
+  }
+
+  bool empty() const {
+    auto b = m_bottom.load(std::memory_order_relaxed);
+    auto t = m_top.load(std::memory_order_relaxed);
+    return t >= b;
+  }
+
+ private:
+  struct Array {
+    explicit Array(size_t cap)
+        : capacity(cap), mask(cap - 1), slots(new std::atomic<T>[cap]) {}
+    T get(int64_t i) const {
+      return slots[i & mask].load(std::memory_order_relaxed);
+    }
+    void put(int64_t i, T x) {
+      slots[i & mask].store(x, std::memory_order_relaxed);
+    }
+    const size_t capacity;
+    const size_t mask;
+    std::unique_ptr<std::atomic<T>[]> slots;
+  };
+
+  Array* grow(Array* a, int64_t t, int64_t b) {
+    auto bigger = std::make_unique<Array>(a->capacity * 2);
+    for (auto i = t; i < b; ++i) {
+      bigger->put(i, a->get(i));
+    }
+    // Thieves may still be reading from the old array, so it is retired
+    // rather than freed.
+    m_arrays.emplace_back(std::move(bigger));
+    auto* result = m_arrays.back().get();
+    m_array.store(result, std::memory_order_release);
+    return result;
+  }
+
+  std::atomic<int64_t> m_top{0};
+  std::atomic<int64_t> m_bottom{0};
+  std::atomic<Array*> m_array;
+  // Owned by the pushing thread.
+  std::vector<std::unique_ptr<Array>> m_arrays;
+};
+
+/**
+ * Small xorshift generator for picking random steal victims; cheaper than
+ * the standard engines and good enough for load balancing.
+ */
+class VictimPicker {
+ public:
+  explicit VictimPicker(uint64_t seed) : m_state(seed | 1) {}
+  unsigned int next(unsigned int bound) {
+    m_state ^= m_state << 13;
+    m_state ^= m_state >> 7;
+    m_state ^= m_state << 17;
+    return static_cast<unsigned int>(m_state % bound);
+  }
+
+ private:
+  uint64_t m_state;
+};
+
 } // namespace workqueue_impl
 
 template <class Input, typename Executor>
@@ -116,8 +267,14 @@ class SpartaWorkQueue;
 template <class Input>
 class SpartaWorkerState final {
  public:
-  SpartaWorkerState(size_t id, workqueue_impl::StateCounters* sc, bool can_push)
-      : m_id(id), m_state_counters(sc), m_can_push_task(can_push) {}
+  SpartaWorkerState(size_t id,
+                    workqueue_impl::StateCounters* sc,
+                    bool can_push,
+                    bool work_stealing = false)
+      : m_id(id),
+        m_state_counters(sc),
+        m_can_push_task(can_push),
+        m_work_stealing(work_stealing) {}
 
   /*
    * Add more items to the queue of the currently-running worker. When a
@@ -126,6 +283,14 @@ class SpartaWorkerState final {
    */
   void push_task(Input task) {
     assert(m_can_push_task);
+    if (m_work_stealing) {
+      ++m_state_counters->num_outstanding;
+      push_stealable(std::move(task));
+      if (m_state_counters->num_sleeping > 0) {
+        m_state_counters->waiter->give(1u);
+      }
+      return;
+    }
     std::lock_guard<std::mutex> guard(m_queue_mtx);
     if (m_queue.empty()) {
       ++m_state_counters->num_non_empty;
@@ -164,12 +329,42 @@ class SpartaWorkerState final {
     return boost::none;
   }
 
+  // Work-stealing mode: tasks live in `m_task_storage`, which only the owner
+  // appends to (std::deque never moves its elements on push_back), and the
+  // lock-free deque hands out pointers into it.
+  void push_stealable(Input task) {
+    m_task_storage.push_back(std::move(task));
+    m_stealable.push(&m_task_storage.back());
+  }
+
+  Input* pop_own_task() {
+    Input* task = nullptr;
+    return m_stealable.pop(&task) ? task : nullptr;
+  }
+
+  Input* steal_task(bool* aborted) {
+    Input* task = nullptr;
+    switch (m_stealable.steal(&task)) {
+    case workqueue_impl::ChaseLevDeque<Input*>::StealResult::SUCCESS:
+      return task;
+    case workqueue_impl::ChaseLevDeque<Input*>::StealResult::ABORT:
+      *aborted = true;
+      return nullptr;
+    case workqueue_impl::ChaseLevDeque<Input*>::StealResult::EMPTY:
+      return nullptr;
+    }
+    return nullptr;
+  }
+
   size_t m_id;
   bool m_running{false};
   std::queue<Input> m_queue;
   std::mutex m_queue_mtx;
   workqueue_impl::StateCounters* m_state_counters;
   const bool m_can_push_task{false};
+  const bool m_work_stealing{false};
+  std::deque<Input> m_task_storage;
+  workqueue_impl::ChaseLevDeque<Input*> m_stealable;
 
   template <class, typename>
   friend class SpartaWorkQueue;
@@ -186,11 +381,19 @@ class SpartaWorkQueue {
   size_t m_insert_idx{0};
   workqueue_impl::StateCounters m_state_counters;
   const bool m_can_push_task{false};
+  const bool m_work_stealing{false};
 
   void consume(SpartaWorkerState<Input>* state, Input task) {
     m_executor(state, task);
   }
 
+  void run_all_work_stealing();
+
+  // Run `worker(state, idx)` once per worker state, on the shared thread pool
+  // if one is installed and on freshly spawned threads otherwise.
+  template <typename Worker>
+  void run_workers(const Worker& worker);
+
  public:
   SpartaWorkQueue(Executor,
                   unsigned int num_threads = parallel::default_num_threads(),
@@ -201,7 +404,16 @@ class SpartaWorkQueue {
                   // * When this flag is false, threads can
                   //   exit as soon as there is no more work (to avoid
                   //   preempting a thread that has useful work)
-                  bool push_tasks_while_running = false);
+                  bool push_tasks_while_running = false,
+                  // work_stealing:
+                  // * When this flag is true, each worker owns a lock-free
+                  //   Chase-Lev deque. Workers run their own tasks in LIFO
+                  //   order and steal from randomly chosen victims when they
+                  //   run dry. This avoids lock contention when the tasks
+                  //   are tiny and there are many threads.
+                  // * When this flag is false, every queue is guarded by a
+                  //   mutex and tasks are run in FIFO order.
+                  bool work_stealing = false);
 
   // copies are not allowed
   SpartaWorkQueue(const SpartaWorkQueue&) = delete;
@@ -211,7 +423,8 @@ class SpartaWorkQueue {
   void add_item(Input task);
 
   /**
-   * Spawn threads and evaluate function.  This method blocks.
+   * Spawn threads, or borrow them from the shared thread pool if one is
+   * installed, and evaluate function.  This method blocks.
    */
   void run_all();
 
@@ -222,15 +435,17 @@ class SpartaWorkQueue {
 template <class Input, typename Executor>
 SpartaWorkQueue<Input, Executor>::SpartaWorkQueue(Executor executor,
                                                   unsigned int num_threads,
-                                                  bool push_tasks_while_running)
+                                                  bool push_tasks_while_running,
+                                                  bool work_stealing)
     : m_executor(executor),
       m_num_threads(num_threads),
       m_state_counters(num_threads),
-      m_can_push_task(push_tasks_while_running) {
+      m_can_push_task(push_tasks_while_running),
+      m_work_stealing(work_stealing) {
   assert(num_threads >= 1);
   for (unsigned int i = 0; i < m_num_threads; ++i) {
     m_states.emplace_back(std::make_unique<SpartaWorkerState<Input>>(
-        i, &m_state_counters, m_can_push_task));
+        i, &m_state_counters, m_can_push_task, m_work_stealing));
   }
 }
 
@@ -238,16 +453,46 @@ template <class Input, typename Executor>
 void SpartaWorkQueue<Input, Executor>::add_item(Input task) {
   m_insert_idx = (m_insert_idx + 1) % m_num_threads;
   assert(m_insert_idx < m_states.size());
+  if (m_work_stealing) {
+    ++m_state_counters.num_outstanding;
+    m_states[m_insert_idx]->push_stealable(std::move(task));
+    return;
+  }
   m_states[m_insert_idx]->m_queue.push(task);
 }
 
+template <class Input, typename Executor>
+template <typename Worker>
+void SpartaWorkQueue<Input, Executor>::run_workers(const Worker& worker) {
+  auto* pool = parallel::get_shared_thread_pool();
+  if (pool != nullptr && m_num_threads > 1) {
+    // Worker 0 runs on the calling thread. An exception escaping a worker
+    // terminates the process, just as it does on a dedicated std::thread.
+    pool->run_workers(m_num_threads, [&](size_t i) noexcept {
+      worker(m_states[i].get(), i);
+    });
+    return;
+  }
+  std::vector<std::thread> all_threads;
+  for (size_t i = 0; i < m_num_threads; ++i) {
+    all_threads.emplace_back(std::bind<void>(worker, m_states[i].get(), i));
+  }
+
+  for (auto& thread : all_threads) {
+    thread.join();
+  }
+}
+
 /*
  * Each worker thread pulls from its own queue first, and then once finished
  * looks randomly at other queues to try and steal work.
  */
 template <class Input, typename Executor>
 void SpartaWorkQueue<Input, Executor>::run_all() {
-  std::vector<std::thread> all_threads;
+  if (m_work_stealing) {
+    run_all_work_stealing();
+    return;
+  }
   m_state_counters.num_non_empty = 0;
   m_state_counters.num_running = 0;
   m_state_counters.waiter->take_all();
@@ -294,16 +539,90 @@ void SpartaWorkQueue<Input, Executor>::run_all() {
       ++m_state_counters.num_non_empty;
     }
   }
+  run_workers(worker);
+
   for (size_t i = 0; i < m_num_threads; ++i) {
-    all_threads.emplace_back(std::bind<void>(worker, m_states[i].get(), i));
+    assert(m_states[i]->m_queue.empty());
   }
+}
 
-  for (auto& thread : all_threads) {
-    thread.join();
-  }
+/*
+ * Each worker pops from the bottom of its own deque without taking any lock,
+ * and once empty steals from the top of the deques of randomly chosen victims.
+ * Termination is detected with a single counter of outstanding tasks instead
+ * of per-queue bookkeeping.
+ */
+template <class Input, typename Executor>
+void SpartaWorkQueue<Input, Executor>::run_all_work_stealing() {
+  m_state_counters.num_sleeping = 0;
+  m_state_counters.waiter->take_all();
+  auto seed = std::chrono::system_clock::now().time_since_epoch().count();
 
+  auto find_task = [&](SpartaWorkerState<Input>* state,
+                       workqueue_impl::VictimPicker& picker) -> Input* {
+    if (auto task = state->pop_own_task()) {
+      return task;
+    }
+    while (true) {
+      bool aborted = false;
+      auto start = picker.next(m_num_threads);
+      for (size_t i = 0; i < m_num_threads; ++i) {
+        auto idx = (start + i) % m_num_threads;
+        if (idx == state->worker_id()) {
+          continue;
+        }
+        if (auto task = m_states[idx]->steal_task(&aborted)) {
+          return task;
+        }
+      }
+      // Only give up once every victim was seen to be empty; an aborted steal
+      // means we lost a race for a task that may have had siblings.
+      if (!aborted) {
+        return nullptr;
+      }
+    }
+  };
+
+  auto worker = [&](SpartaWorkerState<Input>* state, size_t state_idx) {
+    workqueue_impl::VictimPicker picker(seed + state_idx * 0x9E3779B97F4A7C15);
+    while (true) {
+      if (auto task = find_task(state, picker)) {
+        consume(state, *task);
+        if (--m_state_counters.num_outstanding == 0 && m_can_push_task) {
+          // Nothing is queued or running anymore, so nothing can be pushed.
+          m_state_counters.waiter->give(m_state_counters.num_all);
+        }
+        continue;
+      }
+      if (!m_can_push_task || m_state_counters.num_outstanding == 0) {
+        return;
+      }
+      // Announce that we are about to sleep before checking once more, so
+      // that a concurrent push_task either sees us or we see its task.
+      ++m_state_counters.num_sleeping;
+      if (auto task = find_task(state, picker)) {
+        --m_state_counters.num_sleeping;
+        consume(state, *task);
+        if (--m_state_counters.num_outstanding == 0) {
+          m_state_counters.waiter->give(m_state_counters.num_all);
+        }
+        continue;
+      }
+      if (m_state_counters.num_outstanding == 0) {
+        --m_state_counters.num_sleeping;
+        return;
+      }
+      m_state_counters.waiter->take(); // Wait for work.
+      --m_state_counters.num_sleeping;
+    }
+  };
+
+  run_workers(worker);
+
+  assert(m_state_counters.num_outstanding == 0);
   for (size_t i = 0; i < m_num_threads; ++i) {
-    assert(m_states[i]->m_queue.empty());
+    assert(m_states[i]->m_stealable.empty());
+    m_states[i]->m_task_storage.clear();
   }
 }
 
@@ -328,12 +647,14 @@ template <class Input,
 SpartaWorkQueue<Input, workqueue_impl::NoStateWorkQueueHelper<Input, Fn>>
 work_queue(const Fn& fn,
            unsigned int num_threads = parallel::default_num_threads(),
-           bool push_tasks_while_running = false) {
+           bool push_tasks_while_running = false,
+           bool work_stealing = false) {
   return SpartaWorkQueue<Input,
                          workqueue_impl::NoStateWorkQueueHelper<Input, Fn>>(
       workqueue_impl::NoStateWorkQueueHelper<Input, Fn>{fn},
       num_threads,
-      push_tasks_while_running);
+      push_tasks_while_running,
+      work_stealing);
 }
 template <class Input,
           typename Fn,
@@ -341,12 +662,14 @@ template <class Input,
 SpartaWorkQueue<Input, workqueue_impl::WithStateWorkQueueHelper<Input, Fn>>
 work_queue(const Fn& fn,
            unsigned int num_threads = parallel::default_num_threads(),
-           bool push_tasks_while_running = false) {
+           bool push_tasks_while_running = false,
+           bool work_stealing = false) {
   return SpartaWorkQueue<Input,
                          workqueue_impl::WithStateWorkQueueHelper<Input, Fn>>(
       workqueue_impl::WithStateWorkQueueHelper<Input, Fn>{fn},
       num_threads,
-      push_tasks_while_running);
+      push_tasks_while_running,
+      work_stealing);
 }
 
 } // namespace sparta
@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "ArrayAbstractEnvironment.h"
+
+#include <cstdint>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <limits>
+#include <random>
+#include <sstream>
+
+#include "AbstractDomainPropertyTest.h"
+#include "HashedSetAbstractDomain.h"
+#include "PatriciaTreeMapAbstractEnvironment.h"
+
+using namespace sparta;
+
+using Domain = HashedSetAbstractDomain<std::string>;
+using Environment = ArrayAbstractEnvironment<uint32_t, Domain>;
+using PatriciaEnvironment =
+    PatriciaTreeMapAbstractEnvironment<uint32_t, Domain>;
+
+// Stands for a pseudo-register out of the dense range.
+constexpr uint32_t FAR = std::numeric_limits<uint32_t>::max();
+
+INSTANTIATE_TYPED_TEST_CASE_P(ArrayAbstractEnvironment,
+                              AbstractDomainPropertyTest,
+                              Environment);
+
+template <>
+std::vector<Environment>
+AbstractDomainPropertyTest<Environment>::non_extremal_values() {
+  Environment e1({{1, Domain("a")}, {FAR, Domain("b")}});
+  Environment e2({{1, Domain({"a", "b"})}, {70, Domain("c")}});
+  Environment e3({{2, Domain("d")}});
+  return {e1, e2, e3};
+}
+
+class ArrayAbstractEnvironmentTest : public ::testing::Test {
+ protected:
+  ArrayAbstractEnvironmentTest()
+      : m_generator(42), m_size_dist(0, 30), m_var_dist(0, 200) {}
+
+  // Builds the same random environment in both representations.
+  std::pair<Environment, PatriciaEnvironment> generate_random_environments() {
+    Environment env;
+    PatriciaEnvironment ptenv;
+    size_t size = m_size_dist(m_generator);
+    for (size_t i = 0; i < size; ++i) {
+      auto var = m_var_dist(m_generator);
+      if (var == 200) {
+        var = FAR;
+      }
+      Domain value({std::to_string(m_var_dist(m_generator) % 4),
+                    std::to_string(m_var_dist(m_generator) % 4)});
+      env.set(var, value);
+      ptenv.set(var, value);
+    }
+    return {env, ptenv};
+  }
+
+  static void expect_same(const Environment& env,
+                          const PatriciaEnvironment& ptenv) {
+    ASSERT_EQ(env.kind(), ptenv.kind());
+    if (!env.is_value()) {
+      return;
+    }
+    EXPECT_EQ(env.size(), ptenv.size());
+    for (const auto& binding : ptenv.bindings()) {
+      EXPECT_TRUE(env.get(binding.first).equals(binding.second));
+    }
+  }
+
+  std::mt19937 m_generator;
+  std::uniform_int_distribution<uint32_t> m_size_dist;
+  std::uniform_int_distribution<uint32_t> m_var_dist;
+};
+
+TEST_F(ArrayAbstractEnvironmentTest, latticeOperations) {
+  Environment e1({{1, Domain({"a", "b"})},
+                  {2, Domain("c")},
+                  {3, Domain({"d", "e", "f"})},
+                  {FAR, Domain({"a", "f"})}});
+  Environment e2({{0, Domain({"c", "f"})},
+                  {2, Domain({"c", "d"})},
+                  {3, Domain({"d", "e", "g", "h"})}});
+
+  EXPECT_EQ(4, e1.size());
+  EXPECT_EQ(3, e2.size());
+
+  EXPECT_TRUE(Environment::bottom().leq(e1));
+  EXPECT_FALSE(e1.leq(Environment::bottom()));
+  EXPECT_FALSE(Environment::top().leq(e1));
+  EXPECT_TRUE(e1.leq(Environment::top()));
+  EXPECT_FALSE(e1.leq(e2));
+  EXPECT_FALSE(e2.leq(e1));
+
+  Environment join = e1.join(e2);
+  EXPECT_EQ(2, join.size());
+  EXPECT_THAT(join.get(2).elements(),
+              ::testing::UnorderedElementsAre("c", "d"));
+  EXPECT_THAT(join.get(3).elements(),
+              ::testing::UnorderedElementsAre("d", "e", "f", "g", "h"));
+  EXPECT_TRUE(join.get(FAR).is_top());
+  EXPECT_TRUE(e1.leq(join));
+  EXPECT_TRUE(e2.leq(join));
+
+  Environment meet = e1.meet(e2);
+  EXPECT_EQ(5, meet.size());
+  EXPECT_THAT(meet.get(0).elements(),
+              ::testing::UnorderedElementsAre("c", "f"));
+  EXPECT_THAT(meet.get(2).elements(), ::testing::UnorderedElementsAre("c"));
+  EXPECT_THAT(meet.get(3).elements(),
+              ::testing::UnorderedElementsAre("d", "e"));
+  EXPECT_THAT(meet.get(FAR).elements(),
+              ::testing::UnorderedElementsAre("a", "f"));
+  EXPECT_TRUE(meet.leq(e1));
+  EXPECT_TRUE(meet.leq(e2));
+
+  // Meeting disjoint sets yields the empty set, not Bottom.
+  Environment e3({{2, Domain("x")}});
+  EXPECT_TRUE(e1.meet(e3).get(2).elements().empty());
+  EXPECT_TRUE(e1.meet(Environment::bottom()).is_bottom());
+
+  std::ostringstream out;
+  out << Environment({{1, Domain("a")}, {FAR, Domain("b")}});
+  EXPECT_EQ("[#2]{1 -> [#1]{a}, 4294967295 -> [#1]{b}}", out.str());
+}
+
+TEST_F(ArrayAbstractEnvironmentTest, destructiveOperations) {
+  Environment e1;
+  EXPECT_TRUE(e1.is_top());
+  e1.set(3, Domain("a"));
+  e1.set(FAR, Domain("b"));
+  EXPECT_EQ(2, e1.size());
+
+  Environment e2 = e1;
+  e2.update(3, [](const Domain& d) { return d.join(Domain("c")); });
+  EXPECT_THAT(e2.get(3).elements(), ::testing::UnorderedElementsAre("a", "c"));
+  // The copy doesn't see the update.
+  EXPECT_THAT(e1.get(3).elements(), ::testing::UnorderedElementsAre("a"));
+
+  e2.set(3, Domain::top());
+  e2.set(FAR, Domain::top());
+  EXPECT_TRUE(e2.is_top());
+  EXPECT_EQ(2, e1.size());
+
+  EXPECT_TRUE(e1.map([](const Domain& d) { return d.join(Domain("z")); }));
+  EXPECT_THAT(e1.get(FAR).elements(),
+              ::testing::UnorderedElementsAre("b", "z"));
+  EXPECT_FALSE(e1.map([](const Domain& d) { return d; }));
+
+  e1.set(5, Domain::bottom());
+  EXPECT_TRUE(e1.is_bottom());
+  e1.set(5, Domain("a"));
+  EXPECT_TRUE(e1.is_bottom());
+  EXPECT_TRUE(e1.get(5).is_bottom());
+}
+
+TEST_F(ArrayAbstractEnvironmentTest, sameAsPatriciaTree) {
+  for (size_t k = 0; k < 200; ++k) {
+    auto e1 = generate_random_environments();
+    auto e2 = generate_random_environments();
+    expect_same(e1.first, e1.second);
+    expect_same(e1.first.join(e2.first), e1.second.join(e2.second));
+    expect_same(e1.first.meet(e2.first), e1.second.meet(e2.second));
+    EXPECT_EQ(e1.first.leq(e2.first), e1.second.leq(e2.second));
+    EXPECT_TRUE(e1.first.join(e2.first).equals(e2.first.join(e1.first)));
+    auto join = e1.first.join(e2.first);
+    EXPECT_TRUE(e1.first.leq(join));
+    EXPECT_TRUE(join.equals(e1.first.join(e2.first)));
+  }
+}
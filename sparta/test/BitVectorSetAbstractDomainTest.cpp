@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "BitVectorSetAbstractDomain.h"
+
+#include <cstdint>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <sstream>
+
+#include "AbstractDomainPropertyTest.h"
+#include "PatriciaTreeMapAbstractEnvironment.h"
+
+using namespace sparta;
+
+using Domain = BitVectorSetAbstractDomain<uint32_t>;
+
+INSTANTIATE_TYPED_TEST_CASE_P(BitVectorSetAbstractDomain,
+                              AbstractDomainPropertyTest,
+                              Domain);
+
+template <>
+std::vector<Domain> AbstractDomainPropertyTest<Domain>::non_extremal_values() {
+  Domain e1(1);
+  Domain e2({1, 2, 3});
+  Domain e3({2, 3, 200});
+  Domain empty;
+  return {e1, e2, e3, empty};
+}
+
+TEST(BitVectorSetAbstractDomainTest, latticeOperations) {
+  Domain e1(1);
+  Domain e2({1, 2, 3});
+  Domain e3({2, 3, 200});
+
+  EXPECT_THAT(e1.elements(), ::testing::ElementsAre(1));
+  EXPECT_THAT(e2.elements(), ::testing::ElementsAre(1, 2, 3));
+  EXPECT_THAT(e3.elements(), ::testing::ElementsAre(2, 3, 200));
+  EXPECT_EQ(3, e3.size());
+
+  std::ostringstream out;
+  out << e3;
+  EXPECT_EQ("[#3]{2, 3, 200}", out.str());
+
+  EXPECT_TRUE(Domain::bottom().leq(Domain::top()));
+  EXPECT_FALSE(Domain::top().leq(Domain::bottom()));
+  EXPECT_TRUE(Domain().leq(e1));
+  EXPECT_TRUE(e1.leq(e2));
+  EXPECT_FALSE(e1.leq(e3));
+  EXPECT_FALSE(e3.leq(e2));
+  EXPECT_TRUE(e2.equals(Domain({3, 2, 1})));
+  EXPECT_FALSE(e2.equals(e3));
+
+  EXPECT_THAT(e2.join(e3).elements(), ::testing::ElementsAre(1, 2, 3, 200));
+  EXPECT_TRUE(e1.join(e2).equals(e2));
+  EXPECT_TRUE(e2.join(Domain::bottom()).equals(e2));
+  EXPECT_TRUE(e2.join(Domain::top()).is_top());
+  EXPECT_TRUE(e1.widening(e2).equals(e2));
+
+  EXPECT_THAT(e2.meet(e3).elements(), ::testing::ElementsAre(2, 3));
+  EXPECT_TRUE(e1.meet(e2).equals(e1));
+  EXPECT_TRUE(e2.meet(Domain::bottom()).is_bottom());
+  EXPECT_TRUE(e2.meet(Domain::top()).equals(e2));
+  EXPECT_TRUE(e1.meet(e3).elements().empty());
+  EXPECT_TRUE(e1.narrowing(e2).equals(e1));
+
+  EXPECT_TRUE(e3.contains(200));
+  EXPECT_FALSE(e3.contains(1));
+  EXPECT_FALSE(e3.contains(100000));
+
+  // Making sure no side effect happened.
+  EXPECT_THAT(e1.elements(), ::testing::ElementsAre(1));
+  EXPECT_THAT(e2.elements(), ::testing::ElementsAre(1, 2, 3));
+  EXPECT_THAT(e3.elements(), ::testing::ElementsAre(2, 3, 200));
+}
+
+TEST(BitVectorSetAbstractDomainTest, destructiveOperations) {
+  Domain e1(1);
+  Domain e2({1, 2, 3});
+
+  e1.add({2, 3});
+  EXPECT_TRUE(e1.equals(e2));
+  e1.add(130);
+  e1.remove(130);
+  // Trailing empty words don't matter.
+  EXPECT_TRUE(e1.equals(e2));
+  EXPECT_TRUE(e2.equals(e1));
+  e1.remove({1, 3, 500});
+  EXPECT_THAT(e1.elements(), ::testing::ElementsAre(2));
+
+  e1.join_with(e2);
+  EXPECT_TRUE(e1.equals(e2));
+  e1.meet_with(Domain({3, 64, 65}));
+  EXPECT_THAT(e1.elements(), ::testing::ElementsAre(3));
+  e1.meet_with(Domain());
+  EXPECT_TRUE(e1.elements().empty());
+  e1.join_with(Domain::top());
+  EXPECT_TRUE(e1.is_top());
+  e1.set_to_bottom();
+  EXPECT_TRUE(e1.is_bottom());
+  e1.add(1);
+  EXPECT_TRUE(e1.is_bottom());
+}
+
+TEST(BitVectorSetAbstractDomainTest, copyOnWrite) {
+  Domain e1({1, 2, 3});
+  Domain e2 = e1;
+  Domain e3;
+  // Joining into the empty set shares the words of the other set.
+  e3.join_with(e1);
+  e2.add(4);
+  e3.remove(1);
+  EXPECT_THAT(e1.elements(), ::testing::ElementsAre(1, 2, 3));
+  EXPECT_THAT(e2.elements(), ::testing::ElementsAre(1, 2, 3, 4));
+  EXPECT_THAT(e3.elements(), ::testing::ElementsAre(2, 3));
+}
+
+TEST(BitVectorSetAbstractDomainTest, insideEnvironment) {
+  using Environment = PatriciaTreeMapAbstractEnvironment<uint32_t, Domain>;
+  Environment env1({{0, Domain({1, 2})}, {1, Domain(70)}});
+  Environment env2({{0, Domain({2, 3})}});
+  auto join = env1.join(env2);
+  EXPECT_THAT(join.get(0).elements(), ::testing::ElementsAre(1, 2, 3));
+  EXPECT_TRUE(join.get(1).is_top());
+  auto meet = env1.meet(env2);
+  EXPECT_THAT(meet.get(0).elements(), ::testing::ElementsAre(2));
+  EXPECT_THAT(meet.get(1).elements(), ::testing::ElementsAre(70));
+}
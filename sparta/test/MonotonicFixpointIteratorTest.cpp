@@ -360,3 +360,31 @@ TEST_F(MonotonicFixpointIteratorTest, program2) {
   ASSERT_TRUE(fp.get_live_in_vars_at("7").is_bottom());
   ASSERT_TRUE(fp.get_live_out_vars_at("7").is_bottom());
 }
+
+TEST_F(MonotonicFixpointIteratorTest, statistics) {
+  FixpointEngine fp(this->m_program1);
+  FixpointIteratorStatistics<ControlPoint, boost::hash<ControlPoint>> stats;
+  fp.set_observer(&stats);
+  fp.run(LivenessDomain());
+
+  // The loop 2 -> 5 is the only component, and it takes two iterations: one
+  // to propagate the liveness of `c` around the loop, and one to check that
+  // nothing changes anymore.
+  ASSERT_EQ(1, stats.components().size());
+  const auto& loop = stats.components().begin()->second;
+  EXPECT_EQ(2, loop.iterations);
+  EXPECT_EQ(2, loop.max_iterations);
+  EXPECT_EQ(0, loop.widenings);
+  EXPECT_EQ(2, stats.max_iterations());
+  EXPECT_EQ(0, stats.widenings());
+
+  EXPECT_EQ(1, stats.nodes().at(ControlPoint("1")).visits);
+  EXPECT_EQ(1, stats.nodes().at(ControlPoint("6")).visits);
+  EXPECT_EQ(2, stats.nodes().at(ControlPoint("3")).visits);
+  EXPECT_EQ(10, stats.node_visits());
+
+  // Detaching the observer stops the reporting.
+  fp.set_observer(nullptr);
+  fp.run(LivenessDomain());
+  EXPECT_EQ(10, stats.node_visits());
+}
@@ -158,6 +158,37 @@ class FixpointEngine final
   const Program& m_program;
 };
 
+/*
+ * The sequential iterator, made to switch to the concurrent algorithm on any
+ * graph with at least `min_nodes` nodes.
+ */
+class AdaptiveFixpointEngine final
+    : public MonotonicFixpointIterator<
+          BackwardsFixpointIterationAdaptor<ProgramInterface>,
+          LivenessDomain> {
+ public:
+  AdaptiveFixpointEngine(const Program& program, size_t min_nodes)
+      : MonotonicFixpointIterator(program), m_program(program) {
+    set_parallel_threshold(min_nodes, /* num_threads */ 4);
+  }
+
+  void analyze_node(const uint32_t& node,
+                    LivenessDomain* current_state) const override {
+    const Statement& stmt = m_program.statement_at(node);
+    current_state->remove(stmt.def.begin(), stmt.def.end());
+    current_state->add(stmt.use.begin(), stmt.use.end());
+  }
+
+  LivenessDomain analyze_edge(
+      const EdgeId&,
+      const LivenessDomain& exit_state_at_source) const override {
+    return exit_state_at_source;
+  }
+
+ private:
+  const Program& m_program;
+};
+
 class ParallelFixpointIteratorTest : public ::testing::Test {
  protected:
   ParallelFixpointIteratorTest()
@@ -431,3 +462,24 @@ TEST_F(ParallelFixpointIteratorTest, program3) {
   EXPECT_THAT(fp.get_live_out_vars_at(8).elements(),
               ::testing::UnorderedElementsAre("z", "c", "b", "y"));
 }
+
+TEST_F(ParallelFixpointIteratorTest, sequentialSwitchesAboveThreshold) {
+  for (const Program* program : {&m_program1, &m_program2, &m_program3}) {
+    FixpointEngine parallel(*program);
+    parallel.run(LivenessDomain());
+    AdaptiveFixpointEngine above(*program, /* min_nodes */ 1);
+    above.run(LivenessDomain());
+    AdaptiveFixpointEngine below(*program, /* min_nodes */ 1000);
+    below.run(LivenessDomain());
+    for (uint32_t node = 1; node <= 8; ++node) {
+      EXPECT_TRUE(above.get_exit_state_at(node).equals(
+          parallel.get_live_in_vars_at(node)));
+      EXPECT_TRUE(above.get_entry_state_at(node).equals(
+          parallel.get_live_out_vars_at(node)));
+      EXPECT_TRUE(below.get_exit_state_at(node).equals(
+          above.get_exit_state_at(node)));
+      EXPECT_TRUE(below.get_entry_state_at(node).equals(
+          above.get_entry_state_at(node)));
+    }
+  }
+}
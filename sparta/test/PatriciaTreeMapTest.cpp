@@ -114,3 +114,47 @@ TEST(PatriciaTreeMapTest, mapOfUnsignedInt64) {
     EXPECT_EQ(it->second, e.second);
   }
 }
+
+TEST(PatriciaTreeMapTest, hashConsing) {
+  auto first = [](const uint32_t& x, const uint32_t&) { return x; };
+  auto build = [](uint32_t n, uint32_t changed_key) {
+    pt_map m;
+    for (uint32_t k = 0; k < n; ++k) {
+      m.insert_or_assign(k, k == changed_key ? 1000 : k + 1);
+    }
+    return m;
+  };
+
+  pt_map plain1 = build(100, 100);
+  pt_map plain2 = build(100, 42);
+  auto plain_join = plain1.get_intersection_with(first, plain2, 1);
+  EXPECT_TRUE(plain_join.equals(plain1));
+
+  set_patricia_tree_hash_consing(true);
+  pt_map m1 = build(100, 100);
+  pt_map m2 = build(100, 42);
+  // The intersection keeps the leaves of m1, and rebuilding the branches on
+  // top of them yields the nodes of m1 again.
+  auto join = m1.get_intersection_with(first, m2, 1);
+  EXPECT_TRUE(join.reference_equals(m1));
+  EXPECT_TRUE(join.equals(plain_join));
+  // Memoized results are the same as the ones computed afresh.
+  EXPECT_TRUE(m1.get_intersection_with(first, m2, 1).reference_equals(join));
+  EXPECT_FALSE(m2.equals(m1));
+  auto meet = m1.get_union_with(first, m2, 2);
+  EXPECT_TRUE(meet.equals(plain1.get_union_with(first, plain2)));
+  EXPECT_TRUE(m1.get_union_with(first, m2, 2).reference_equals(meet));
+  // Adding the same binding twice, without memoization, yields the same nodes.
+  auto second = [](const uint32_t&, const uint32_t& y) { return y; };
+  pt_map extra;
+  extra.insert_or_assign(500, 7);
+  EXPECT_TRUE(m1.get_union_with(second, extra).reference_equals(
+      m1.get_union_with(second, extra)));
+  set_patricia_tree_hash_consing(false);
+  EXPECT_FALSE(plain1.get_union_with(second, extra)
+                   .reference_equals(plain1.get_union_with(second, extra)));
+
+  // Trees built with and without hash-consing can be mixed.
+  EXPECT_TRUE(m1.equals(plain1));
+  EXPECT_TRUE(m2.get_intersection_with(first, plain1).equals(plain2));
+}
@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "PatriciaTreeNodePool.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "PatriciaTreeMap.h"
+#include "PatriciaTreeSet.h"
+
+using namespace sparta;
+
+namespace {
+
+class CountingNodePool final : public NodePool {
+ public:
+  void* allocate(size_t size) override {
+    ++m_live;
+    return m_pool.allocate(size);
+  }
+
+  void deallocate(void* ptr, size_t size) noexcept override {
+    --m_live;
+    m_pool.deallocate(ptr, size);
+  }
+
+  int64_t live() const { return m_live; }
+
+ private:
+  FreeListNodePool m_pool;
+  std::atomic<int64_t> m_live{0};
+};
+
+} // namespace
+
+TEST(PatriciaTreeNodePoolTest, freeListPool) {
+  FreeListNodePool pool;
+  std::vector<void*> blocks;
+  for (size_t size = 1; size <= FreeListNodePool::kMaxBlockSize + 64;
+       size += 7) {
+    auto* block = pool.allocate(size);
+    memset(block, 0xAB, size);
+    blocks.push_back(block);
+  }
+  for (auto* block : blocks) {
+    EXPECT_EQ(0, reinterpret_cast<uintptr_t>(block) % 16);
+  }
+  size_t size = 1;
+  for (auto* block : blocks) {
+    pool.deallocate(block, size);
+    size += 7;
+  }
+  // Freed blocks are reused.
+  auto* block = pool.allocate(64);
+  pool.deallocate(block, 64);
+  EXPECT_EQ(block, pool.allocate(60));
+  pool.deallocate(block, 60);
+}
+
+TEST(PatriciaTreeNodePoolTest, swappedPool) {
+  CountingNodePool pool;
+  PatriciaTreeSet<uint32_t> old_set{1, 2, 3};
+  {
+    auto* previous = set_patricia_tree_node_pool(&pool);
+    EXPECT_EQ(&FreeListNodePool::global(), previous);
+    PatriciaTreeSet<uint32_t> set;
+    PatriciaTreeMap<uint32_t, uint32_t> map;
+    for (uint32_t i = 0; i < 1000; ++i) {
+      set.insert(i);
+      map.insert_or_assign(i, i * i);
+    }
+    EXPECT_GT(pool.live(), 0);
+    // Nodes of the default pool go back to it.
+    auto live = pool.live();
+    old_set.clear();
+    EXPECT_EQ(live, pool.live());
+    set_patricia_tree_node_pool(nullptr);
+    EXPECT_EQ(1000, set.size());
+    EXPECT_EQ(81, map.at(9));
+  }
+  EXPECT_EQ(0, pool.live());
+}
+
+TEST(PatriciaTreeNodePoolTest, freedOnOtherThreads) {
+  FreeListNodePool pool;
+  auto* previous = set_patricia_tree_node_pool(&pool);
+  std::vector<PatriciaTreeSet<uint32_t>> sets(8);
+  {
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < sets.size(); ++t) {
+      threads.emplace_back([&sets, t]() {
+        for (uint32_t i = 0; i < 10000; ++i) {
+          sets[t].insert(i * 8 + t);
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+  {
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < sets.size(); ++t) {
+      threads.emplace_back([&sets, t]() {
+        auto& set = sets[(t + 1) % sets.size()];
+        EXPECT_EQ(10000, set.size());
+        set.clear();
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+  for (const auto& set : sets) {
+    EXPECT_TRUE(set.empty());
+  }
+  set_patricia_tree_node_pool(previous);
+}
+
+TEST(PatriciaTreeNodePoolTest, freedOnLongLivedThread) {
+  // One long-lived thread allocates the blocks and another long-lived thread,
+  // which has allocated from the pool before, frees them. The blocks must flow
+  // back to the allocating thread rather than pile up on the freeing one.
+  constexpr size_t kRounds = 20;
+  constexpr size_t kBlocksPerRound = 200000;
+  constexpr size_t kBlockSize = 48;
+  FreeListNodePool pool;
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::vector<void*> batch;
+  bool has_batch = false;
+  size_t reserved_after_warmup = 0;
+
+  std::thread freer([&]() {
+    pool.deallocate(pool.allocate(kBlockSize), kBlockSize);
+    for (size_t round = 0; round < kRounds; ++round) {
+      std::unique_lock<std::mutex> lock(mutex);
+      cv.wait(lock, [&]() { return has_batch; });
+      for (auto* block : batch) {
+        pool.deallocate(block, kBlockSize);
+      }
+      batch.clear();
+      has_batch = false;
+      cv.notify_all();
+    }
+  });
+  std::thread producer([&]() {
+    for (size_t round = 0; round < kRounds; ++round) {
+      std::vector<void*> blocks;
+      blocks.reserve(kBlocksPerRound);
+      for (size_t i = 0; i < kBlocksPerRound; ++i) {
+        blocks.push_back(pool.allocate(kBlockSize));
+      }
+      std::unique_lock<std::mutex> lock(mutex);
+      batch = std::move(blocks);
+      has_batch = true;
+      cv.notify_all();
+      // Wait for the blocks to be freed, so that at most one round is live.
+      cv.wait(lock, [&]() { return !has_batch; });
+      if (round == 0) {
+        reserved_after_warmup = pool.reserved_bytes();
+      }
+    }
+  });
+  producer.join();
+  freer.join();
+
+  EXPECT_GT(reserved_after_warmup, 0);
+  // Some slack for the blocks cached by either thread.
+  EXPECT_LE(pool.reserved_bytes(),
+            reserved_after_warmup + 4 * FreeListNodePool::kChunkSize);
+}
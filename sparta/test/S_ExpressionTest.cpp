@@ -254,3 +254,14 @@ TEST(S_ExpressionTest, patternMatching) {
   EXPECT_TRUE(y.is_nil());
   EXPECT_EQ(parse("((c d) e)"), z);
 }
+
+TEST(S_ExpressionTest, sharedTails) {
+  auto e = parse("(a (b c) #3 \"d e\")");
+  auto t1 = e.tail(1);
+  auto t2 = t1.tail(1);
+  EXPECT_EQ(parse("((b c) #3 \"d e\")"), t1);
+  EXPECT_EQ(parse("(#3 \"d e\")"), t2);
+  EXPECT_TRUE(e.tail(4).is_nil());
+  EXPECT_EQ(3, t2[0].get_int32());
+  EXPECT_EQ(hash_value(parse("(#3 \"d e\")")), hash_value(t2));
+}
@@ -85,3 +85,127 @@ TEST(SpartaWorkQueueTest, checkDynamicallyAddingTasks) {
   // 10 + 9 + ... + 1 + 0 = 55
   EXPECT_EQ(55, result);
 }
+
+TEST(SpartaWorkQueueTest, workStealingForeachTest) {
+  std::array<int, NUM_INTS> array = {0};
+
+  auto wq = sparta::work_queue<int*>([](int* a) { (*a)++; },
+                                     4,
+                                     /*push_tasks_while_running=*/false,
+                                     /*work_stealing=*/true);
+
+  for (int idx = 0; idx < NUM_INTS; ++idx) {
+    wq.add_item(&array[idx]);
+  }
+  wq.run_all();
+  for (int idx = 0; idx < NUM_INTS; ++idx) {
+    ASSERT_EQ(1, array[idx]);
+  }
+
+  // The queue can be refilled and run again.
+  for (int idx = 0; idx < NUM_INTS; ++idx) {
+    wq.add_item(&array[idx]);
+  }
+  wq.run_all();
+  for (int idx = 0; idx < NUM_INTS; ++idx) {
+    ASSERT_EQ(2, array[idx]);
+  }
+}
+
+// Check that tasks pushed while running are all executed, including when a
+// single task fans out into far more tasks than a deque initially holds.
+TEST(SpartaWorkQueueTest, workStealingDynamicallyAddingTasks) {
+  constexpr size_t num_threads{8};
+  std::atomic<int> result{0};
+  auto wq = sparta::work_queue<int>(
+      [&](sparta::SpartaWorkerState<int>* worker_state, int a) {
+        if (a > 0) {
+          worker_state->push_task(a - 1);
+          result += a;
+        }
+      },
+      num_threads,
+      /*push_tasks_while_running=*/true,
+      /*work_stealing=*/true);
+  wq.add_item(10);
+  wq.run_all();
+  // 10 + 9 + ... + 1 + 0 = 55
+  EXPECT_EQ(55, result);
+
+  std::atomic<int> count{0};
+  auto fan_out = sparta::work_queue<int>(
+      [&](sparta::SpartaWorkerState<int>* worker_state, int depth) {
+        ++count;
+        if (depth > 0) {
+          worker_state->push_task(depth - 1);
+          worker_state->push_task(depth - 1);
+        }
+      },
+      num_threads,
+      /*push_tasks_while_running=*/true,
+      /*work_stealing=*/true);
+  fan_out.add_item(12);
+  fan_out.run_all();
+  EXPECT_EQ((1 << 13) - 1, count);
+}
+
+// Check that work queues dispatched onto a shared thread pool behave like
+// ones spawning their own threads, including when runs are nested.
+TEST(SpartaWorkQueueTest, sharedThreadPool) {
+  sparta::parallel::ThreadPool pool;
+  sparta::parallel::set_shared_thread_pool(&pool);
+
+  for (bool work_stealing : {false, true}) {
+    std::atomic<int> result{0};
+    auto wq = sparta::work_queue<int>(
+        [&](sparta::SpartaWorkerState<int>* worker_state, int a) {
+          if (a > 0) {
+            worker_state->push_task(a - 1);
+            result += a;
+          }
+        },
+        4,
+        /*push_tasks_while_running=*/true,
+        work_stealing);
+    wq.add_item(10);
+    wq.run_all();
+    EXPECT_EQ(55, result);
+  }
+  EXPECT_EQ(3u, pool.num_threads());
+
+  std::atomic<int> count{0};
+  auto outer = sparta::work_queue<int>(
+      [&](int /* unused */) {
+        auto inner =
+            sparta::work_queue<int>([&](int /* unused */) { ++count; }, 4);
+        for (int i = 0; i < 10; ++i) {
+          inner.add_item(i);
+        }
+        inner.run_all();
+      },
+      4);
+  for (int i = 0; i < 10; ++i) {
+    outer.add_item(i);
+  }
+  outer.run_all();
+  EXPECT_EQ(100, count);
+
+  sparta::parallel::set_shared_thread_pool(nullptr);
+}
+
+// Pinning the pool threads to CPUs must not change what the workers do.
+TEST(SpartaWorkQueueTest, pinnedThreadPool) {
+  sparta::parallel::ThreadPool pool(/* pin_threads */ true);
+  sparta::parallel::set_shared_thread_pool(&pool);
+
+  std::atomic<int> result{0};
+  auto wq = sparta::work_queue<int>([&](int a) { result += a; }, 8);
+  for (int i = 1; i <= 100; ++i) {
+    wq.add_item(i);
+  }
+  wq.run_all();
+  EXPECT_EQ(5050, result);
+  EXPECT_EQ(7, pool.num_threads());
+
+  sparta::parallel::set_shared_thread_pool(nullptr);
+}
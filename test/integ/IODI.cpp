@@ -37,8 +37,10 @@ void reset_redex() {
   g_redex = new RedexContext();
 }
 
-DexClasses run_redex(std::unordered_map<std::string, uint64_t>* mid = nullptr,
-                     std::string* iodi_data = nullptr) {
+DexClasses run_redex(
+    std::unordered_map<std::string, uint64_t>* mid = nullptr,
+    std::string* iodi_data = nullptr,
+    IODIMetadata::Format format = IODIMetadata::Format::Entries) {
   reset_redex();
   const char* dexfile = std::getenv("dexfile");
   EXPECT_NE(nullptr, dexfile);
@@ -104,7 +106,7 @@ DexClasses run_redex(std::unordered_map<std::string, uint64_t>* mid = nullptr,
   }
   if (iodi_data) {
     std::stringstream sstream;
-    iodi_metadata.write(sstream, method_to_id);
+    iodi_metadata.write(sstream, method_to_id, format);
     *iodi_data = sstream.str();
   }
   reset_redex();
@@ -366,6 +368,29 @@ TEST(IODITest, sameNameDontUseIODI) {
 }
 
 namespace {
+std::unordered_map<std::string, uint64_t> iodi_method_ids(
+    const DexClasses& classes,
+    const std::unordered_map<std::string, uint64_t>& mid) {
+  auto debug_data = debug_to_methods(classes);
+  std::unordered_map<std::string, uint64_t> iodi_mid;
+  for (auto& data : debug_data) {
+    DexDebugItem* debug_item = (DexDebugItem*)data.first;
+    if (!is_iodi(*debug_item)) {
+      continue;
+    }
+    for (DexMethod* method : data.second) {
+      std::string pretty_name =
+          java_names::internal_to_external(method->get_class()->str());
+      pretty_name.push_back('.');
+      pretty_name += method->str();
+      auto iter = mid.find(pretty_name);
+      EXPECT_NE(iter, mid.end());
+      iodi_mid.emplace(pretty_name, iter->second);
+    }
+  }
+  return iodi_mid;
+}
+
 struct IODIParser {
   template <typename T>
   const T* parse(size_t len = sizeof(T)) {
@@ -402,23 +427,7 @@ TEST(IODITest, encodedMetadataContainsAllIODI) {
   EXPECT_GT(iodi_data.size(), 0);
 
   // First verify all methods with IODI are in the method_id map
-  auto debug_data = debug_to_methods(classes);
-  std::unordered_map<std::string, uint64_t> iodi_mid;
-  for (auto& data : debug_data) {
-    DexDebugItem* debug_item = (DexDebugItem*)data.first;
-    if (!is_iodi(*debug_item)) {
-      continue;
-    }
-    for (DexMethod* method : data.second) {
-      std::string pretty_name =
-          java_names::internal_to_external(method->get_class()->str());
-      pretty_name.push_back('.');
-      pretty_name += method->str();
-      auto iter = mid.find(pretty_name);
-      EXPECT_NE(iter, mid.end());
-      iodi_mid.emplace(pretty_name, iter->second);
-    }
-  }
+  auto iodi_mid = iodi_method_ids(classes, mid);
 
   /*
    * Binary file format
@@ -462,3 +471,53 @@ TEST(IODITest, encodedMetadataContainsAllIODI) {
   }
   p.ensure_at_end();
 }
+
+TEST(IODITest, columnarMetadataContainsAllIODI) {
+  std::string iodi_data;
+  std::unordered_map<std::string, uint64_t> mid;
+  auto classes =
+      run_redex(&mid, &iodi_data, IODIMetadata::Format::Columnar);
+  EXPECT_GT(mid.size(), 0);
+  EXPECT_GT(iodi_data.size(), 0);
+  auto iodi_mid = iodi_method_ids(classes, mid);
+
+  // See IODIMetadata::write_columnar for the format.
+  auto buffer = (uint8_t*)iodi_data.data();
+  IODIParser p{buffer, buffer + iodi_data.size()};
+  const uint32_t* hdr = p.parse<uint32_t>(4 * sizeof(uint32_t));
+  EXPECT_EQ(hdr[0], 0xfaceb001);
+  EXPECT_EQ(hdr[1], 2);
+  uint32_t count = hdr[2];
+  EXPECT_EQ(count, iodi_mid.size());
+  EXPECT_EQ(hdr[3], 0);
+  uint32_t signature_count = *p.parse<uint32_t>();
+  const uint32_t* signatures =
+      p.parse<uint32_t>(signature_count * sizeof(uint32_t));
+  const uint32_t* key_offsets =
+      p.parse<uint32_t>((count + 1) * sizeof(uint32_t));
+  size_t num_blocks = (count + 63) / 64;
+  const uint32_t* block_offsets =
+      p.parse<uint32_t>(num_blocks * sizeof(uint32_t));
+  uint32_t ids_size = *p.parse<uint32_t>();
+  const uint8_t* ids = p.parse<uint8_t>(ids_size);
+  const char* keys = p.parse<char>(key_offsets[count]);
+  p.ensure_at_end();
+
+  const uint8_t* id_ptr = ids;
+  for (uint32_t i = 0; i < count; i++) {
+    if (i % 64 == 0) {
+      EXPECT_EQ(ids + block_offsets[i / 64], id_ptr);
+    }
+    uint32_t signature_idx = read_uleb128(&id_ptr);
+    ASSERT_LT(signature_idx, signature_count);
+    uint64_t method_idx = read_uleb128(&id_ptr);
+    std::string key(keys + key_offsets[i], key_offsets[i + 1] - key_offsets[i]);
+    if (i > 0) {
+      std::string prev(keys + key_offsets[i - 1],
+                       key_offsets[i] - key_offsets[i - 1]);
+      EXPECT_LT(prev, key);
+    }
+    EXPECT_EQ(iodi_mid.at(key), (method_idx << 32) | signatures[signature_idx]);
+  }
+  EXPECT_EQ(ids + ids_size, id_ptr);
+}
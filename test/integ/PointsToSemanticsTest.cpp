@@ -6,6 +6,7 @@
  */
 
 #include "PointsToSemantics.h"
+#include "PointsToSolver.h"
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
@@ -301,24 +302,29 @@ void patch_filled_new_array_test(Scope& scope) {
   }
 }
 
-class PointsToSemanticsTest : public RedexIntegrationTest {};
+class PointsToSemanticsTest : public RedexIntegrationTest {
+ protected:
+  void load_android_sdk() {
+    const char* android_env_sdk = std::getenv("ANDROID_SDK");
+    const char* android_config_sdk = std::getenv("sdk_path");
 
-TEST_F(PointsToSemanticsTest, semanticActionGeneration) {
-  const char* android_env_sdk = std::getenv("ANDROID_SDK");
-  const char* android_config_sdk = std::getenv("sdk_path");
+    const char* android_sdk = (strncmp(android_config_sdk, "None", 4) != 0)
+                                  ? android_config_sdk
+                                  : android_env_sdk;
 
-  const char* android_sdk = (strncmp(android_config_sdk, "None", 4) != 0)
-                                ? android_config_sdk
-                                : android_env_sdk;
+    ASSERT_NE(nullptr, android_sdk);
+    const char* android_target = std::getenv("android_target");
+    ASSERT_NE(nullptr, android_target);
+    std::string android_version(android_target);
+    ASSERT_NE("NotFound", android_version);
+    std::string sdk_jar = std::string(android_sdk) + "/platforms/" +
+                          android_version + "/android.jar";
+    ASSERT_TRUE(load_jar_file(sdk_jar.c_str()));
+  }
+};
 
-  ASSERT_NE(nullptr, android_sdk);
-  const char* android_target = std::getenv("android_target");
-  ASSERT_NE(nullptr, android_target);
-  std::string android_version(android_target);
-  ASSERT_NE("NotFound", android_version);
-  std::string sdk_jar = std::string(android_sdk) + "/platforms/" +
-                        android_version + "/android.jar";
-  ASSERT_TRUE(load_jar_file(sdk_jar.c_str()));
+TEST_F(PointsToSemanticsTest, semanticActionGeneration) {
+  load_android_sdk();
 
   DexStoreClassesIterator it(stores);
   Scope scope = build_class_scope(it);
@@ -362,3 +368,47 @@ TEST_F(PointsToSemanticsTest, semanticActionGeneration) {
   }
   EXPECT_THAT(deserialization, ::testing::ContainerEq(method_semantics));
 }
+
+TEST_F(PointsToSemanticsTest, solver) {
+  load_android_sdk();
+
+  DexStoreClassesIterator it(stores);
+  Scope scope = build_class_scope(it);
+  patch_filled_new_array_test(scope);
+
+  PointsToSemantics pt_semantics(scope);
+  PointsToSolver solver(pt_semantics);
+  solver.run();
+
+  auto a1 = DexField::get_field(
+      "Lcom/facebook/redextest/PointsToSemantics;.a1:"
+      "Lcom/facebook/redextest/PointsToSemantics$A;");
+  auto a2 = DexField::get_field(
+      "Lcom/facebook/redextest/PointsToSemantics;.a2:"
+      "Lcom/facebook/redextest/PointsToSemantics$A;");
+  ASSERT_NE(nullptr, a1);
+  ASSERT_NE(nullptr, a2);
+  auto a1_objects = solver.get_static_field_points_to_set(a1);
+  auto a2_objects = solver.get_static_field_points_to_set(a2);
+  ASSERT_EQ(1, a1_objects.size());
+  ASSERT_EQ(1, a2_objects.size());
+  EXPECT_NE(*a1_objects.begin(), *a2_objects.begin());
+  for (auto object : a1_objects.get_union_with(a2_objects)) {
+    EXPECT_EQ(PTS_NEW_OBJECT, solver.get_object(object).kind);
+    EXPECT_EQ("Lcom/facebook/redextest/PointsToSemantics$A;",
+              show(solver.get_object(object).type));
+  }
+
+  // The list built by `extract` holds both objects, which `nth` may return.
+  auto extract = DexMethod::get_method(
+      "Lcom/facebook/redextest/PointsToSemantics;.extract:"
+      "()Lcom/facebook/redextest/PointsToSemantics$A;");
+  ASSERT_NE(nullptr, extract);
+  EXPECT_EQ(a1_objects.get_union_with(a2_objects),
+            solver.get_return_points_to_set(extract));
+  auto nth = DexMethod::get_method(
+      "Lcom/facebook/redextest/PointsToSemantics$C;.nth:"
+      "(I)Lcom/facebook/redextest/PointsToSemantics$A;");
+  ASSERT_NE(nullptr, nth);
+  EXPECT_EQ(1, solver.get_callees(extract).count(nth));
+}
@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <gtest/gtest.h>
+#include <queue>
+
+#include "CallGraph.h"
+#include "Debug.h"
+#include "DexLoader.h"
+#include "MethodOverrideGraph.h"
+#include "RedexTest.h"
+#include "Walkers.h"
+
+namespace mog = method_override_graph;
+
+/*
+ * Compares the build time, memory and traversal speed of the node-based call
+ * and method override graphs against their compact forms, on a real dex given
+ * via the `dexfile` environment variable.
+ */
+struct CompactGraphPerfTest : public RedexTest {};
+
+namespace {
+
+using ms = std::chrono::duration<double, std::milli>;
+
+constexpr size_t kTraversals = 10;
+
+size_t count_reachable(const call_graph::Graph& graph) {
+  std::unordered_set<const call_graph::Node*> visited{graph.entry().get()};
+  std::queue<const call_graph::Node*> queue;
+  queue.push(graph.entry().get());
+  while (!queue.empty()) {
+    auto node = queue.front();
+    queue.pop();
+    for (const auto& edge : node->callees()) {
+      if (visited.emplace(edge->callee().get()).second) {
+        queue.push(edge->callee().get());
+      }
+    }
+  }
+  return visited.size();
+}
+
+size_t count_reachable(const call_graph::CompactGraph& graph) {
+  std::vector<bool> visited(graph.num_nodes());
+  std::queue<call_graph::CompactGraph::NodeId> queue;
+  visited[graph.entry()] = true;
+  queue.push(graph.entry());
+  size_t count = 1;
+  while (!queue.empty()) {
+    auto node = queue.front();
+    queue.pop();
+    for (auto e = graph.first_callee_edge(node);
+         e < graph.first_callee_edge(node + 1); ++e) {
+      auto callee = graph.callee(e);
+      if (!visited[callee]) {
+        visited[callee] = true;
+        ++count;
+        queue.push(callee);
+      }
+    }
+  }
+  return count;
+}
+
+} // namespace
+
+TEST_F(CompactGraphPerfTest, buildAndTraverse) {
+  const char* dexfile = std::getenv("dexfile");
+  if (dexfile == nullptr) {
+    printf("Set dexfile to the dex to measure.\n");
+    return;
+  }
+  auto scope = load_classes_from_dex(dexfile);
+
+  // Method override graph.
+  auto rss_start = get_mem_stats().vm_rss;
+  auto start = std::chrono::steady_clock::now();
+  auto override_graph = mog::build_graph(scope);
+  auto end = std::chrono::steady_clock::now();
+  auto rss_graph = get_mem_stats().vm_rss;
+  mog::CompactGraph compact_override_graph(*override_graph);
+  auto compact_end = std::chrono::steady_clock::now();
+  auto rss_compact = get_mem_stats().vm_rss;
+  printf("override graph: %zu methods, build %.1f ms, RSS +%.1f MB\n",
+         override_graph->nodes().size(), ms(end - start).count(),
+         (rss_graph - rss_start) / (1024.0 * 1024.0));
+  printf("compact override graph: freeze %.1f ms, RSS +%.1f MB (%zu bytes)\n",
+         ms(compact_end - end).count(),
+         (rss_compact - rss_graph) / (1024.0 * 1024.0),
+         compact_override_graph.memory_footprint());
+
+  std::vector<const DexMethod*> vmethods;
+  walk::methods(scope, [&](DexMethod* method) {
+    if (method->is_virtual()) {
+      vmethods.push_back(method);
+    }
+  });
+  size_t overrides = 0;
+  start = std::chrono::steady_clock::now();
+  for (const auto* method : vmethods) {
+    overrides += mog::get_overriding_methods(*override_graph, method).size();
+  }
+  end = std::chrono::steady_clock::now();
+  size_t compact_overrides = 0;
+  for (const auto* method : vmethods) {
+    compact_overrides +=
+        mog::get_overriding_methods(compact_override_graph, method).size();
+  }
+  compact_end = std::chrono::steady_clock::now();
+  printf("overriding methods of %zu methods: %.1f ms vs. %.1f ms compact\n",
+         vmethods.size(), ms(end - start).count(),
+         ms(compact_end - end).count());
+  EXPECT_EQ(overrides, compact_overrides);
+
+  // Call graph.
+  rss_start = get_mem_stats().vm_rss;
+  start = std::chrono::steady_clock::now();
+  auto graph = call_graph::complete_call_graph(scope);
+  end = std::chrono::steady_clock::now();
+  rss_graph = get_mem_stats().vm_rss;
+  call_graph::CompactGraph compact_graph(graph);
+  compact_end = std::chrono::steady_clock::now();
+  rss_compact = get_mem_stats().vm_rss;
+  printf("call graph: %zu nodes, %zu edges, build %.1f ms, RSS +%.1f MB\n",
+         compact_graph.num_nodes(), compact_graph.num_edges(),
+         ms(end - start).count(), (rss_graph - rss_start) / (1024.0 * 1024.0));
+  printf("compact call graph: freeze %.1f ms, RSS +%.1f MB (%zu bytes)\n",
+         ms(compact_end - end).count(),
+         (rss_compact - rss_graph) / (1024.0 * 1024.0),
+         compact_graph.memory_footprint());
+
+  size_t reachable = 0;
+  start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < kTraversals; ++i) {
+    reachable = count_reachable(graph);
+  }
+  end = std::chrono::steady_clock::now();
+  size_t compact_reachable = 0;
+  for (size_t i = 0; i < kTraversals; ++i) {
+    compact_reachable = count_reachable(compact_graph);
+  }
+  compact_end = std::chrono::steady_clock::now();
+  printf("reachability: %.2f ms vs. %.2f ms compact per traversal\n",
+         ms(end - start).count() / kTraversals,
+         ms(compact_end - end).count() / kTraversals);
+  EXPECT_EQ(reachable, compact_reachable);
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <chrono>
+#include <gtest/gtest.h>
+#include <string>
+
+#include "ControlFlow.h"
+#include "IRAssembler.h"
+#include "IRCode.h"
+#include "RedexTest.h"
+
+/*
+ * Measures building an editable CFG, which simplifies it, for a method with
+ * 10k blocks that all branch to the same empty block.
+ */
+struct ControlFlowSimplifyPerfTest : public RedexTest {};
+
+TEST_F(ControlFlowSimplifyPerfTest, manyPredsOfEmptyBlock) {
+  constexpr size_t kBranches = 10000;
+  std::string body = "((load-param v0)\n";
+  for (size_t i = 0; i < kBranches; ++i) {
+    body += "(if-eqz v0 :empty)\n";
+  }
+  body += R"(
+    (const v1 1)
+    (return v1)
+    (:empty)
+    (goto :end)
+    (:end)
+    (const v1 0)
+    (return v1)
+  ))";
+  auto code = assembler::ircode_from_string(body);
+
+  auto start = std::chrono::steady_clock::now();
+  code->build_cfg(/* editable */ true);
+  auto end = std::chrono::steady_clock::now();
+
+  using ms = std::chrono::duration<double, std::milli>;
+  printf("build_cfg of %zu branches to an empty block: %.1f ms\n", kBranches,
+         ms(end - start).count());
+  // The empty block is gone; each branch targets the end block directly.
+  EXPECT_EQ(kBranches + 2, code->cfg().num_blocks());
+  code->clear_cfg();
+}
@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "ConcurrentContainers.h"
+#include "ControlFlow.h"
+#include "DexClass.h"
+#include "DexLoader.h"
+#include "IRCode.h"
+#include "RedexTest.h"
+#include "TypeInference.h"
+#include "Walkers.h"
+#include "WorkQueue.h"
+
+/*
+ * Measures the hot paths that most passes share: interning in the
+ * RedexContext, ConcurrentMap operations, and building, linearizing and
+ * analyzing CFGs. The CFG benchmarks run over a real dex, e.g. the
+ * classes.dex of an APK, given via the `dexfile` environment variable.
+ * Compare the numbers before and after a change to any of these.
+ */
+struct CoreHotPathsPerfTest : public RedexTest {
+  using ms = std::chrono::duration<double, std::milli>;
+
+  template <typename Fn>
+  static double time_ms(const Fn& fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    return ms(std::chrono::steady_clock::now() - start).count();
+  }
+
+  static DexClasses load_dexfile() {
+    const char* dexfile = std::getenv("dexfile");
+    if (dexfile == nullptr) {
+      printf("Set dexfile to the dex to measure.\n");
+      return {};
+    }
+    auto classes = load_classes_from_dex(dexfile, /* balloon */ false);
+    balloon_for_test(classes);
+    return classes;
+  }
+};
+
+TEST_F(CoreHotPathsPerfTest, interning) {
+  constexpr size_t kNames = 200000;
+  std::vector<std::string> names;
+  names.reserve(kNames);
+  for (size_t i = 0; i < kNames; ++i) {
+    names.push_back("Lcom/facebook/perf/Class" + std::to_string(i) + ";");
+  }
+
+  size_t num_threads = redex_parallel::default_num_threads();
+  auto intern = [&]() {
+    auto wq = workqueue_foreach<size_t>(
+        [&](size_t t) {
+          for (size_t i = t; i < kNames; i += num_threads) {
+            DexType::make_type(names[i].c_str());
+          }
+        },
+        num_threads);
+    for (size_t t = 0; t < num_threads; ++t) {
+      wq.add_item(t);
+    }
+    wq.run_all();
+  };
+  // The first round creates the strings and types, the second one only looks
+  // them up.
+  auto create = time_ms(intern);
+  auto lookup = time_ms(intern);
+  printf("interning %zu types on %zu threads: create %.1f ms, lookup %.1f ms\n",
+         kNames, num_threads, create, lookup);
+  EXPECT_NE(nullptr, DexType::get_type(names.back().c_str()));
+}
+
+TEST_F(CoreHotPathsPerfTest, bulkInterning) {
+  constexpr size_t kNames = 200000;
+  constexpr size_t kBatch = 1000;
+  size_t num_threads = redex_parallel::default_num_threads();
+  auto intern = [&](const std::string& prefix, bool bulk) {
+    return time_ms([&]() {
+      auto wq = workqueue_foreach<size_t>(
+          [&](size_t t) {
+            std::vector<std::string> names;
+            for (size_t i = t; i < kNames; i += num_threads) {
+              names.push_back(prefix + std::to_string(i));
+              if (names.size() == kBatch) {
+                if (bulk) {
+                  DexString::make_strings(names);
+                } else {
+                  for (const auto& name : names) {
+                    DexString::make_string(name);
+                  }
+                }
+                names.clear();
+              }
+            }
+            DexString::make_strings(names);
+          },
+          num_threads);
+      for (size_t t = 0; t < num_threads; ++t) {
+        wq.add_item(t);
+      }
+      wq.run_all();
+    });
+  };
+  auto one_by_one = intern("Lcom/facebook/perf/One", /* bulk */ false);
+  auto bulk = intern("Lcom/facebook/perf/Bulk", /* bulk */ true);
+  printf("creating %zu strings on %zu threads: make_string %.1f ms, "
+         "make_strings %.1f ms\n",
+         kNames, num_threads, one_by_one, bulk);
+  EXPECT_NE(nullptr, DexString::get_string("Lcom/facebook/perf/Bulk0"));
+}
+
+TEST_F(CoreHotPathsPerfTest, concurrentMap) {
+  constexpr size_t kKeys = 1000000;
+  size_t num_threads = redex_parallel::default_num_threads();
+  ConcurrentMap<uint32_t, size_t> map;
+  auto run = [&](const std::function<void(size_t)>& op) {
+    return time_ms([&]() {
+      auto wq = workqueue_foreach<size_t>(
+          [&](size_t t) {
+            for (size_t i = t; i < kKeys; i += num_threads) {
+              op(i);
+            }
+          },
+          num_threads);
+      for (size_t t = 0; t < num_threads; ++t) {
+        wq.add_item(t);
+      }
+      wq.run_all();
+    });
+  };
+  auto emplace = run([&](size_t i) { map.emplace(i, i); });
+  auto update = run([&](size_t i) {
+    map.update(i, [](uint32_t, size_t& v, bool) { ++v; });
+  });
+  std::atomic<size_t> checksum{0};
+  auto get = run([&](size_t i) { checksum += map.get(i, 0); });
+  printf("ConcurrentMap on %zu threads, %zu keys: emplace %.1f ms, update "
+         "%.1f ms, get %.1f ms\n",
+         num_threads, kKeys, emplace, update, get);
+  EXPECT_EQ(kKeys, map.size());
+  EXPECT_EQ(kKeys * (kKeys + 1) / 2, checksum.load());
+}
+
+TEST_F(CoreHotPathsPerfTest, cfgRoundTrip) {
+  auto classes = load_dexfile();
+  if (classes.empty()) {
+    return;
+  }
+  std::vector<IRCode*> codes;
+  walk::code(classes,
+             [&](DexMethod*, IRCode& code) { codes.push_back(&code); });
+
+  auto build = time_ms([&]() {
+    for (auto code : codes) {
+      code->build_cfg(/* editable */ true);
+    }
+  });
+  size_t checksum = 0;
+  auto iterate = time_ms([&]() {
+    for (auto code : codes) {
+      for (auto block : code->cfg().blocks()) {
+        for (auto& mie : InstructionIterable(block)) {
+          checksum += mie.insn->srcs_size() > 0;
+        }
+        ++checksum;
+      }
+    }
+  });
+  auto linearize = time_ms([&]() {
+    for (auto code : codes) {
+      code->clear_cfg();
+    }
+  });
+  printf("CFG of %zu methods: build %.1f ms, iterate %.1f ms, linearize "
+         "%.1f ms (checksum %zu)\n",
+         codes.size(), build, iterate, linearize, checksum);
+}
+
+TEST_F(CoreHotPathsPerfTest, typeInference) {
+  auto classes = load_dexfile();
+  if (classes.empty()) {
+    return;
+  }
+  std::vector<DexMethod*> methods;
+  walk::code(classes, [&](DexMethod* method, IRCode& code) {
+    code.build_cfg(/* editable */ false);
+    methods.push_back(method);
+  });
+
+  auto infer = time_ms([&]() {
+    for (auto method : methods) {
+      type_inference::TypeInference inference(method->get_code()->cfg());
+      inference.run(method);
+    }
+  });
+  printf("type inference of %zu methods: %.1f ms\n", methods.size(), infer);
+
+  for (auto method : methods) {
+    method->get_code()->clear_cfg();
+  }
+}
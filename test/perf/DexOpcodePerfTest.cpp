@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <gtest/gtest.h>
+#include <memory>
+#include <vector>
+
+#include "DexInstruction.h"
+#include "DexOpcode.h"
+#include "RedexTest.h"
+
+/*
+ * Measures the cost of the opcode format queries that instruction lowering
+ * and dex output perform for each instruction, over every dex opcode
+ * Redex implements.
+ */
+struct DexOpcodePerfTest : public RedexTest {
+  static std::vector<DexOpcode> implemented_opcodes() {
+    std::vector<DexOpcode> opcodes;
+#define OP(op, code, fmt, ...) opcodes.push_back(DOPCODE_##op);
+    DOPS
+#undef OP
+    opcodes.erase(std::remove_if(opcodes.begin(),
+                                 opcodes.end(),
+                                 [](DexOpcode op) {
+                                   switch (dex_opcode::format(op)) {
+                                   case FMT_f20bc:
+                                   case FMT_f22cs:
+                                   case FMT_f35ms:
+                                   case FMT_f35mi:
+                                   case FMT_f3rms:
+                                   case FMT_f3rmi:
+                                     return true;
+                                   default:
+                                     return false;
+                                   }
+                                 }),
+                  opcodes.end());
+    return opcodes;
+  }
+};
+
+TEST_F(DexOpcodePerfTest, formatQueries) {
+  auto opcodes = implemented_opcodes();
+
+  constexpr size_t kRounds = 100000;
+  uint64_t checksum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < kRounds; ++i) {
+    for (auto op : opcodes) {
+      checksum += dex_opcode::format(op);
+      if (dex_opcode::has_dest(op)) {
+        checksum += dex_opcode::dest_bit_width(op);
+      }
+      auto min_srcs = dex_opcode::min_srcs_size(op);
+      for (uint16_t j = 0; j < min_srcs; ++j) {
+        checksum += dex_opcode::src_bit_width(op, j);
+      }
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  using ns = std::chrono::duration<double, std::nano>;
+  printf("format queries: %.2f ns per opcode (checksum %llu)\n",
+         ns(end - start).count() / (kRounds * opcodes.size()),
+         (unsigned long long)checksum);
+  EXPECT_GT(checksum, 0);
+}
+
+TEST_F(DexOpcodePerfTest, encodeInstructions) {
+  std::vector<std::unique_ptr<DexInstruction>> insns;
+  for (auto op : implemented_opcodes()) {
+    insns.emplace_back(new DexInstruction(op));
+  }
+
+  std::vector<uint16_t> buffer;
+  for (const auto& insn : insns) {
+    buffer.resize(buffer.size() + insn->size());
+  }
+
+  constexpr size_t kRounds = 100000;
+  uint64_t checksum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < kRounds; ++i) {
+    uint16_t* out = buffer.data();
+    for (const auto& insn : insns) {
+      if (insn->has_dest()) {
+        checksum += insn->dest();
+      }
+      auto srcs = insn->srcs_size();
+      for (unsigned j = 0; j < srcs; ++j) {
+        checksum += insn->src(j);
+      }
+      insn->encode(/* dodx */ nullptr, out);
+    }
+    checksum += out - buffer.data();
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  using ns = std::chrono::duration<double, std::nano>;
+  printf("encode: %.2f ns per instruction (checksum %llu)\n",
+         ns(end - start).count() / (kRounds * insns.size()),
+         (unsigned long long)checksum);
+  EXPECT_EQ(kRounds * buffer.size(), checksum);
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <gtest/gtest.h>
+
+#include "Debug.h"
+#include "DexLoader.h"
+#include "IRCode.h"
+#include "IRInstruction.h"
+#include "RedexTest.h"
+#include "Walkers.h"
+
+/*
+ * Measures the memory and scan cost of IRInstructions on a real dex, e.g. the
+ * classes.dex of an APK, given via the `dexfile` environment variable.
+ * Compare the numbers before and after a change to the instruction layout.
+ */
+struct IRInstructionPerfTest : public RedexTest {};
+
+TEST_F(IRInstructionPerfTest, balloonAndScan) {
+  const char* dexfile = std::getenv("dexfile");
+  if (dexfile == nullptr) {
+    printf("Set dexfile to the dex to measure.\n");
+    return;
+  }
+  auto classes = load_classes_from_dex(dexfile, /* balloon */ false);
+
+  auto rss_before = get_mem_stats().vm_rss;
+  auto balloon_start = std::chrono::steady_clock::now();
+  balloon_for_test(classes);
+  auto balloon_end = std::chrono::steady_clock::now();
+  auto rss_after = get_mem_stats().vm_rss;
+
+  size_t num_insns = 0;
+  size_t num_spilled = 0;
+  walk::code(classes, [&](DexMethod*, IRCode& code) {
+    for (const auto& mie : InstructionIterable(code)) {
+      ++num_insns;
+      if (mie.insn->srcs_size() > 2) {
+        ++num_spilled;
+      }
+    }
+  });
+
+  constexpr size_t kScans = 20;
+  uint64_t checksum = 0;
+  auto scan_start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < kScans; ++i) {
+    walk::code(classes, [&](DexMethod*, IRCode& code) {
+      for (const auto& mie : InstructionIterable(code)) {
+        for (auto src : mie.insn->srcs()) {
+          checksum += src;
+        }
+        checksum += mie.insn->opcode();
+      }
+    });
+  }
+  auto scan_end = std::chrono::steady_clock::now();
+
+  using ms = std::chrono::duration<double, std::milli>;
+  printf("instructions: %zu (%zu with more than 2 srcs)\n", num_insns,
+         num_spilled);
+  printf("balloon: %.1f ms, RSS +%.1f MB (%.1f bytes per instruction)\n",
+         ms(balloon_end - balloon_start).count(),
+         (rss_after - rss_before) / (1024.0 * 1024.0),
+         num_insns == 0 ? 0.0
+                        : (double)(rss_after - rss_before) / num_insns);
+  printf("scan: %.2f ms per pass over all instructions (checksum %llu)\n",
+         ms(scan_end - scan_start).count() / kScans,
+         (unsigned long long)checksum);
+  EXPECT_GT(num_insns, 0);
+}
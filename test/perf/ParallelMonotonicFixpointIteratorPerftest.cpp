@@ -226,7 +226,45 @@ double calculate_speedup(const MonotonicFixpointIteratorTest& test,
   return duration2;
 }
 
-int main() {
+/*
+ * The sequential iterator, once it switches to the concurrent algorithm above
+ * its node threshold.
+ */
+double calculate_adaptive_speedup(const MonotonicFixpointIteratorTest& test,
+                                  uint32_t num_core) {
+  FixpointEngine fp(test.m_program1);
+  fp.set_parallel_threshold(/* min_nodes */ 1000, num_core);
+  auto start = std::chrono::high_resolution_clock::now();
+  fp.run(LivenessDomain());
+  auto end = std::chrono::high_resolution_clock::now();
+
+  return std::chrono::duration_cast<std::chrono::microseconds>(end - start)
+      .count();
+}
+
+/*
+ * Above its node threshold, the sequential iterator must compute the same
+ * invariants as below it.
+ */
+TEST(ParallelMonotonicFixpointIteratorPerfTest, adaptiveMatchesSequential) {
+  MonotonicFixpointIteratorTest test;
+  test.SetUp();
+  FixpointEngine sequential(test.m_program1);
+  sequential.set_parallel_threshold(/* min_nodes */ 1000000, 1);
+  sequential.run(LivenessDomain());
+  for (size_t num_core : {size_t(2), redex_parallel::default_num_threads()}) {
+    FixpointEngine fp(test.m_program1);
+    fp.set_parallel_threshold(/* min_nodes */ 1000, num_core);
+    fp.run(LivenessDomain());
+    for (uint32_t node = 1; node <= 2001; ++node) {
+      EXPECT_TRUE(fp.get_entry_state_at(node).equals(
+          sequential.get_entry_state_at(node)))
+          << "Mismatch at node " << node << " on " << num_core << " threads";
+    }
+  }
+}
+
+int main(int argc, char** argv) {
   printf("Begin!\n");
   MonotonicFixpointIteratorTest test;
   test.SetUp();
@@ -240,4 +278,10 @@ int main() {
   for (uint32_t i = 1; i <= redex_parallel::default_num_threads(); ++i) {
     printf("%u %lf\n", i, duration1 / calculate_speedup(test, i));
   }
+  printf("Adaptive:\n");
+  for (uint32_t i = 1; i <= redex_parallel::default_num_threads(); ++i) {
+    printf("%u %lf\n", i, duration1 / calculate_adaptive_speedup(test, i));
+  }
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
 }
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <gtest/gtest.h>
+
+#include "ConstantAbstractDomain.h"
+#include "PatriciaTreeMapAbstractEnvironment.h"
+
+using namespace sparta;
+
+namespace {
+
+using Domain = ConstantAbstractDomain<int>;
+using Environment = PatriciaTreeMapAbstractEnvironment<uint32_t, Domain>;
+
+constexpr uint32_t kNumVariables = 5000;
+constexpr size_t kNumIterations = 2000;
+
+/*
+ * Mimics the loop heads of a fixpoint iteration: the states on two incoming
+ * edges are joined, and the result is compared against the previous state,
+ * over and over, while most bindings never change.
+ */
+double run_joins(Environment* result) {
+  Environment base;
+  for (uint32_t v = 0; v < kNumVariables; ++v) {
+    base.set(v, Domain(v));
+  }
+  Environment left = base;
+  Environment right = base;
+  for (uint32_t v = 0; v < 10; ++v) {
+    left.set(v * 97, Domain(-1));
+    right.set(v * 89 + 1, Domain(-2));
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  Environment state = base;
+  for (size_t i = 0; i < kNumIterations; ++i) {
+    auto joined = left.join(right);
+    if (!joined.leq(state)) {
+      state.join_with(joined);
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+  *result = state;
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+} // namespace
+
+TEST(PatriciaTreeHashConsingPerfTest, repeatedJoins) {
+  Environment plain_result;
+  double plain_ms = run_joins(&plain_result);
+
+  set_patricia_tree_hash_consing(true);
+  Environment consed_result;
+  double consed_ms = run_joins(&consed_result);
+  set_patricia_tree_hash_consing(false);
+
+  printf("plain: %.1f ms, hash-consed: %.1f ms (%.1fx)\n", plain_ms, consed_ms,
+         plain_ms / consed_ms);
+  EXPECT_TRUE(plain_result.equals(consed_result));
+}
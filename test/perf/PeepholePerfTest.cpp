@@ -0,0 +1,32 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <chrono>
+#include <gtest/gtest.h>
+
+#include "Peephole.h"
+#include "RedexTest.h"
+
+/*
+ * Measures PeepholePass on a real dex, e.g. the classes.dex of an APK, given
+ * via the `dexfile` environment variable. Compare the numbers before and
+ * after a change to the pattern matching.
+ */
+class PeepholePerfTest : public RedexIntegrationTest {};
+
+TEST_F(PeepholePerfTest, runPass) {
+  PeepholePass peephole_pass;
+  std::vector<Pass*> passes{&peephole_pass};
+
+  auto start = std::chrono::steady_clock::now();
+  run_passes(passes);
+  auto end = std::chrono::steady_clock::now();
+
+  using ms = std::chrono::duration<double, std::milli>;
+  printf("PeepholePass on %zu classes: %.1f ms\n", classes->size(),
+         ms(end - start).count());
+}
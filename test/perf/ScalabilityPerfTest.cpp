@@ -0,0 +1,351 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <gtest/gtest.h>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ConstantPropagationPass.h"
+#include "Creators.h"
+#include "DedupBlocksPass.h"
+#include "IRAssembler.h"
+#include "LocalDcePass.h"
+#include "MethodDevirtualizationPass.h"
+#include "Peephole.h"
+#include "RedexTest.h"
+#include "SimplifyCFG.h"
+#include "SingleImpl.h"
+#include "Walkers.h"
+
+/*
+ * Runs passes over synthesized apps of increasing size and reports how the
+ * time and the peak memory of each pass grow with the number of classes, so
+ * that superlinear behavior shows up before a real app crosses the threshold.
+ *
+ * The shape of the apps and the driver are configured through environment
+ * variables:
+ *
+ *   scales             class counts to run at, e.g. "2000,4000,8000"
+ *   hierarchy_depth    length of the superclass chains
+ *   methods_per_class  virtual methods per class, overridden along the chains
+ *   method_size        instructions per method body
+ *   switch_cases       cases of the switch in each class's static method
+ *   interfaces         number of interfaces...
+ *   interface_fanout   ...and how many of them each chain implements
+ *   passes             comma-separated names of the passes to run, or all
+ *   max_growth         fail if a pass's time or memory grows faster than
+ *                      classes^max_growth
+ *
+ * Each pass runs alone on a fresh app at each scale. The growth is the slope
+ * of log(cost) over log(classes), fitted over the scales where the pass took
+ * at least a millisecond; 1 is linear.
+ */
+struct ScalabilityPerfTest : public RedexTest {};
+
+namespace {
+
+size_t env_size(const char* name, size_t default_value) {
+  const char* value = std::getenv(name);
+  return value == nullptr ? default_value : std::stoul(value);
+}
+
+std::vector<std::string> env_list(const char* name,
+                                  const std::string& default_value) {
+  const char* value = std::getenv(name);
+  std::istringstream ss(value == nullptr ? default_value : value);
+  std::vector<std::string> items;
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    if (!item.empty()) {
+      items.push_back(item);
+    }
+  }
+  return items;
+}
+
+struct AppShape {
+  size_t classes;
+  size_t hierarchy_depth;
+  size_t methods_per_class;
+  size_t method_size;
+  size_t switch_cases;
+  size_t interfaces;
+  size_t interface_fanout;
+
+  static AppShape from_env(size_t classes) {
+    AppShape shape;
+    shape.classes = classes;
+    shape.hierarchy_depth =
+        std::max<size_t>(1, env_size("hierarchy_depth", 4));
+    shape.methods_per_class = env_size("methods_per_class", 4);
+    shape.method_size = env_size("method_size", 24);
+    shape.switch_cases = env_size("switch_cases", 16);
+    shape.interfaces = env_size("interfaces", 32);
+    shape.interface_fanout =
+        std::min(shape.interfaces, env_size("interface_fanout", 2));
+    return shape;
+  }
+};
+
+std::string cls_name(size_t i) {
+  return "Lcom/redex/synth/C" + std::to_string(i) + ";";
+}
+
+std::string intf_name(size_t i) {
+  return "Lcom/redex/synth/I" + std::to_string(i) + ";";
+}
+
+// The interfaces implemented by the chain that class `i` belongs to.
+std::vector<size_t> chain_interfaces(const AppShape& shape, size_t i) {
+  std::vector<size_t> intfs;
+  size_t chain = i / shape.hierarchy_depth;
+  for (size_t j = 0; j < shape.interface_fanout; ++j) {
+    intfs.push_back((chain * shape.interface_fanout + j) % shape.interfaces);
+  }
+  return intfs;
+}
+
+// Straight-line code over v0, with a dead constant that LocalDce and
+// constant propagation see, and a call to the static method of the next
+// class every eight instructions.
+std::string make_body(const AppShape& shape, size_t i) {
+  std::string body;
+  std::string next_static =
+      "\"" + cls_name((i + 1) % shape.classes) + ".s:(I)I\"";
+  for (size_t k = 0; k < shape.method_size; ++k) {
+    switch (k % 8) {
+    case 0:
+    case 4:
+      body += "(add-int/lit8 v0 v0 1)\n";
+      break;
+    case 1:
+      body += "(const v3 " + std::to_string(k) + ")\n";
+      break;
+    case 2:
+    case 5:
+      body += "(const v2 " + std::to_string(k) + ")\n(mul-int v0 v0 v2)\n";
+      break;
+    case 7:
+      body += "(invoke-static (v0) " + next_static + ")\n(move-result v0)\n";
+      break;
+    default:
+      body += "(xor-int/lit8 v0 v0 3)\n";
+      break;
+    }
+  }
+  return body;
+}
+
+std::string make_static_method(const AppShape& shape, size_t i) {
+  std::string cases;
+  std::string labels;
+  for (size_t k = 0; k < shape.switch_cases; ++k) {
+    auto label = ":c" + std::to_string(k);
+    labels += " " + label;
+    // Every other case is a duplicate for DedupBlocks, and every case
+    // returns to the join point like a real dispatch does.
+    cases += "(" + label + " " + std::to_string(k) + ")\n(const v1 " +
+             std::to_string(k / 2) + ")\n(add-int v0 v0 v1)\n(goto :end)\n";
+  }
+  std::string body = "(load-param v0)\n";
+  if (shape.switch_cases > 0) {
+    body += "(switch v0 (" + labels + "))\n";
+  }
+  body += "(:end)\n" + make_body(shape, i) + "(return v0)\n" + cases;
+  return "(method (public static) \"" + cls_name(i) + ".s:(I)I\"\n(" + body +
+         "))";
+}
+
+std::string make_virtual_method(const AppShape& shape,
+                                size_t i,
+                                const std::string& name) {
+  return "(method (public) \"" + cls_name(i) + "." + name + ":(I)I\"\n(" +
+         "(load-param-object v1)\n(load-param v0)\n" + make_body(shape, i) +
+         "(return v0)\n))";
+}
+
+DexClasses make_app(const AppShape& shape) {
+  DexClasses classes;
+  for (size_t j = 0; j < shape.interfaces; ++j) {
+    auto type = DexType::make_type(intf_name(j).c_str());
+    ClassCreator creator(type);
+    creator.set_access(ACC_PUBLIC | ACC_INTERFACE | ACC_ABSTRACT);
+    creator.set_super(type::java_lang_Object());
+    auto method = DexMethod::make_method(intf_name(j) + ".run" +
+                                         std::to_string(j) + ":(I)I");
+    creator.add_method(method->make_concrete(ACC_PUBLIC | ACC_ABSTRACT,
+                                             /* is_virtual */ true));
+    classes.push_back(creator.create());
+  }
+
+  for (size_t i = 0; i < shape.classes; ++i) {
+    bool chain_root = i % shape.hierarchy_depth == 0;
+    ClassCreator creator(DexType::make_type(cls_name(i).c_str()));
+    creator.set_access(ACC_PUBLIC);
+    creator.set_super(chain_root ? type::java_lang_Object()
+                                 : DexType::make_type(cls_name(i - 1).c_str()));
+    creator.add_method(
+        assembler::method_from_string(make_static_method(shape, i)));
+    for (size_t k = 0; k < shape.methods_per_class; ++k) {
+      creator.add_method(assembler::method_from_string(
+          make_virtual_method(shape, i, "m" + std::to_string(k))));
+    }
+    // The chain roots implement the interfaces; their subclasses override
+    // the implementations in turn.
+    for (auto j : chain_interfaces(shape, i)) {
+      if (chain_root) {
+        creator.add_interface(DexType::make_type(intf_name(j).c_str()));
+      }
+      creator.add_method(assembler::method_from_string(
+          make_virtual_method(shape, i, "run" + std::to_string(j))));
+    }
+    classes.push_back(creator.create());
+  }
+  return classes;
+}
+
+// Reads a "<key>: <n> kB" line of /proc/self/status, in bytes, or 0.
+size_t proc_status_bytes(const std::string& key) {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.compare(0, key.size() + 1, key + ":") == 0) {
+      return std::stoul(line.substr(key.size() + 1)) * 1024;
+    }
+  }
+  return 0;
+}
+
+// Resets the peak resident set size, so that VmHWM measures a single pass.
+void reset_peak_rss() { std::ofstream("/proc/self/clear_refs") << "5"; }
+
+struct Sample {
+  size_t classes;
+  size_t insns;
+  double ms;
+  double peak_mb;
+};
+
+// The slope of log(y) over log(classes), over the samples that take at least
+// a millisecond: below that, the timings are mostly noise.
+double growth(const std::vector<Sample>& samples,
+              const std::function<double(const Sample&)>& y) {
+  double n = 0, sx = 0, sy = 0, sxx = 0, sxy = 0;
+  for (const auto& s : samples) {
+    if (s.ms < 1 || y(s) <= 0) {
+      continue;
+    }
+    double lx = std::log((double)s.classes);
+    double ly = std::log(y(s));
+    n++;
+    sx += lx;
+    sy += ly;
+    sxx += lx * lx;
+    sxy += lx * ly;
+  }
+  if (n < 2 || n * sxx == sx * sx) {
+    return NAN;
+  }
+  return (n * sxy - sx * sy) / (n * sxx - sx * sx);
+}
+
+using PassFactory = std::function<std::unique_ptr<Pass>()>;
+
+template <class P>
+std::pair<std::string, PassFactory> pass_factory(const std::string& name) {
+  return {name, []() { return std::unique_ptr<Pass>(new P()); }};
+}
+
+} // namespace
+
+TEST_F(ScalabilityPerfTest, passGrowth) {
+  std::vector<std::pair<std::string, PassFactory>> all_passes{
+      pass_factory<ConstantPropagationPass>("ConstantPropagationPass"),
+      pass_factory<DedupBlocksPass>("DedupBlocksPass"),
+      pass_factory<LocalDcePass>("LocalDcePass"),
+      pass_factory<MethodDevirtualizationPass>("MethodDevirtualizationPass"),
+      pass_factory<PeepholePass>("PeepholePass"),
+      pass_factory<SimplifyCFGPass>("SimplifyCFGPass"),
+      pass_factory<SingleImplPass>("SingleImplPass"),
+  };
+  std::vector<size_t> scales;
+  for (const auto& scale : env_list("scales", "1000,2000,4000,8000")) {
+    scales.push_back(std::stoul(scale));
+  }
+  auto selected = env_list("passes", "");
+  const char* max_growth_env = std::getenv("max_growth");
+  double max_growth = max_growth_env ? std::stod(max_growth_env) : 1.5;
+
+  for (const auto& named_pass : all_passes) {
+    const auto& name = named_pass.first;
+    if (!selected.empty() &&
+        std::find(selected.begin(), selected.end(), name) == selected.end()) {
+      continue;
+    }
+    std::vector<Sample> samples;
+    for (auto num_classes : scales) {
+      // A fresh context per run, so that each pass starts from the same
+      // interned state and the memory of the previous app is released.
+      delete g_redex;
+      g_redex = new RedexContext();
+
+      auto shape = AppShape::from_env(num_classes);
+      DexMetadata dm;
+      dm.set_id("classes");
+      DexStore store(dm);
+      store.add_classes(make_app(shape));
+      size_t insns = 0;
+      walk::code(store.get_dexen()[0], [&](DexMethod*, IRCode& code) {
+        insns += code.count_opcodes();
+      });
+      std::vector<DexStore> stores;
+      stores.emplace_back(std::move(store));
+
+      auto pass = named_pass.second();
+      std::vector<Pass*> passes{pass.get()};
+      PassManager manager(passes);
+      manager.set_testing_mode();
+      Json::Value conf_obj = Json::nullValue;
+      ConfigFiles conf(conf_obj);
+
+      size_t rss_before = proc_status_bytes("VmRSS");
+      reset_peak_rss();
+      auto start = std::chrono::steady_clock::now();
+      manager.run_passes(stores, conf);
+      auto end = std::chrono::steady_clock::now();
+      size_t peak = proc_status_bytes("VmHWM");
+
+      using ms = std::chrono::duration<double, std::milli>;
+      samples.push_back(
+          {num_classes, insns, ms(end - start).count(),
+           peak > rss_before ? (peak - rss_before) / (1024.0 * 1024.0) : 0});
+      printf("%s: %zu classes, %zu instructions: %.1f ms, peak +%.1f MB\n",
+             name.c_str(), num_classes, insns, samples.back().ms,
+             samples.back().peak_mb);
+    }
+
+    auto time_growth = growth(samples, [](const Sample& s) { return s.ms; });
+    auto memory_growth =
+        growth(samples, [](const Sample& s) { return s.peak_mb; });
+    printf("%s: time grows as classes^%.2f, peak memory as classes^%.2f\n",
+           name.c_str(), time_growth, memory_growth);
+    if (!std::isnan(time_growth)) {
+      EXPECT_LE(time_growth, max_growth) << name << " time is superlinear";
+    }
+    if (!std::isnan(memory_growth)) {
+      EXPECT_LE(memory_growth, max_growth) << name << " memory is superlinear";
+    }
+  }
+}
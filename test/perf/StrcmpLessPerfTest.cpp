@@ -78,3 +78,104 @@ TEST(StrcmpLessPerfTest, Test1) {
   EXPECT_EQ(result1, result2);
 }
 #endif // defined(__SSE4_2__) && defined(__linux__) && defined(__STRCMP_LESS__)
+
+#include <chrono>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "DexEncoding.h"
+
+namespace {
+
+// The straightforward code-point-by-code-point implementations, to compare
+// against.
+uint32_t reference_length(const char* s) {
+  uint32_t len = 0;
+  while (*s != '\0') {
+    ++len;
+    mutf8_next_code_point(s);
+  }
+  return len;
+}
+
+bool reference_less(const char* sa, const char* sb) {
+  if (strcmp(sa, sb) == 0) return false;
+  if (*sa == '\0') return true;
+  if (*sb == '\0') return false;
+  while (true) {
+    uint32_t cpa = mutf8_next_code_point(sa);
+    uint32_t cpb = mutf8_next_code_point(sb);
+    if (cpa == cpb) {
+      if (*sa == '\0') return true;
+      if (*sb == '\0') return false;
+      continue;
+    }
+    return cpa < cpb;
+  }
+}
+
+} // namespace
+
+TEST(StrcmpLessPerfTest, Mutf8) {
+  const int iter = 1000000;
+  const std::vector<std::string> strs = {
+      "Lcom/some/class/name;",
+      "Lcom/some/class/name\xc3\xa9;",
+      "Lcom/some/class/name\xc3\xa8;",
+      "Lcom/some/class/name\xc0\x80;",
+      "Lcom/some/class/name\x01;",
+      "\xe4\xb8\xad\xe6\x96\x87 string with a long ASCII tail, long tail",
+      "\xe4\xb8\xad\xe6\x96\x87 string with a long ASCII tail, long tai",
+      "\xed\xa0\xbd\xed\xb8\x80 surrogates",
+      "\xef\xbf\xbd surrogates",
+      ""};
+
+  for (const auto& a : strs) {
+    EXPECT_EQ(reference_length(a.c_str()), length_of_utf8_string(a.c_str()));
+    for (const auto& b : strs) {
+      EXPECT_EQ(reference_less(a.c_str(), b.c_str()),
+                mutf8_less(a.c_str(), b.c_str()))
+          << a << " < " << b;
+    }
+  }
+
+  using ms = std::chrono::duration<double, std::milli>;
+  uint64_t result1 = 0;
+  uint64_t result2 = 0;
+  auto t1 = std::chrono::steady_clock::now();
+  for (int i = 0; i < iter; i++) {
+    for (const auto& a : strs) {
+      result1 += reference_length(a.c_str());
+    }
+  }
+  auto t2 = std::chrono::steady_clock::now();
+  for (int i = 0; i < iter; i++) {
+    for (const auto& a : strs) {
+      result2 += length_of_utf8_string(a.c_str());
+    }
+  }
+  auto t3 = std::chrono::steady_clock::now();
+  printf("Execution time (ms) length reference: %.1f optimized: %.1f\n",
+         ms(t2 - t1).count(), ms(t3 - t2).count());
+  EXPECT_EQ(result1, result2);
+
+  result1 = 0;
+  result2 = 0;
+  t1 = std::chrono::steady_clock::now();
+  for (int i = 0; i < iter; i++) {
+    for (size_t j = 0; j + 1 < strs.size(); j++) {
+      result1 += reference_less(strs[j].c_str(), strs[j + 1].c_str());
+    }
+  }
+  t2 = std::chrono::steady_clock::now();
+  for (int i = 0; i < iter; i++) {
+    for (size_t j = 0; j + 1 < strs.size(); j++) {
+      result2 += mutf8_less(strs[j].c_str(), strs[j + 1].c_str());
+    }
+  }
+  t3 = std::chrono::steady_clock::now();
+  printf("Execution time (ms) compare reference: %.1f optimized: %.1f\n",
+         ms(t2 - t1).count(), ms(t3 - t2).count());
+  EXPECT_EQ(result1, result2);
+}
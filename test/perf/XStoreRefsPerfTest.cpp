@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <chrono>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "DexStore.h"
+#include "RedexTest.h"
+#include "ScopeHelper.h"
+
+/*
+ * Measures the store and dex checks that the inliner and outliner run for
+ * each candidate, over an APK with a primary dex, a secondary dex and two
+ * modules, one of which depends on the other.
+ */
+struct XStoreRefsPerfTest : public RedexTest {};
+
+namespace {
+
+constexpr size_t kClassesPerDex = 20000;
+constexpr size_t kRounds = 20;
+
+DexClasses make_classes(const std::string& prefix) {
+  DexClasses classes;
+  for (size_t i = 0; i < kClassesPerDex; ++i) {
+    auto type = DexType::make_type(
+        ("L" + prefix + "/Cls" + std::to_string(i) + ";").c_str());
+    classes.push_back(
+        create_internal_class(type, type::java_lang_Object(), {}));
+  }
+  return classes;
+}
+
+DexStore make_store(const std::string& name,
+                    const std::vector<std::string>& dependencies) {
+  DexMetadata metadata;
+  metadata.set_id(name);
+  metadata.get_dependencies() = dependencies;
+  return DexStore(metadata);
+}
+
+} // namespace
+
+TEST_F(XStoreRefsPerfTest, illegalAndCrossDexRefs) {
+  auto root = make_store("classes", {});
+  root.add_classes(make_classes("primary"));
+  root.add_classes(make_classes("secondary"));
+  auto base = make_store("base", {});
+  base.add_classes(make_classes("base"));
+  auto feature = make_store("feature", {"base"});
+  feature.add_classes(make_classes("feature"));
+  DexStoresVector stores{root, base, feature};
+
+  std::vector<DexType*> types;
+  for (const auto& store : stores) {
+    for (const auto& dex : store.get_dexen()) {
+      for (auto cls : dex) {
+        types.push_back(cls->get_type());
+      }
+    }
+  }
+
+  using ms = std::chrono::duration<double, std::milli>;
+  auto start = std::chrono::steady_clock::now();
+  XStoreRefs xstores(stores);
+  XDexRefs xdexes(stores);
+  auto built = std::chrono::steady_clock::now();
+
+  // Check every type against a fixed location in each store, as an inliner
+  // does for the references of a callee into its caller.
+  std::vector<DexType*> locations{types.front(),
+                                  types[kClassesPerDex],
+                                  types[2 * kClassesPerDex],
+                                  types[3 * kClassesPerDex]};
+  size_t illegal = 0;
+  size_t cross_dex = 0;
+  for (size_t round = 0; round < kRounds; ++round) {
+    for (auto location : locations) {
+      auto store_idx = xstores.get_store_idx(location);
+      auto dex_idx = xdexes.get_dex_idx(location);
+      for (auto type : types) {
+        illegal += xstores.illegal_ref(store_idx, type);
+        cross_dex += xdexes.get_dex_idx(type) != dex_idx;
+      }
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  size_t num_checks = kRounds * locations.size() * types.size();
+  printf("XStoreRefs/XDexRefs of %zu types: build %.1f ms, %.2f ns per "
+         "check\n",
+         types.size(), ms(built - start).count(),
+         std::chrono::duration<double, std::nano>(end - built).count() /
+             num_checks);
+
+  // From the primary dex, everything but the primary dex is illegal; from
+  // the secondary dex, the modules; from either module, the other one, except
+  // that the feature may reference the base.
+  EXPECT_EQ(kRounds * kClassesPerDex * (3 + 2 + 1 + 0), illegal);
+  EXPECT_EQ(kRounds * 4 * 3 * kClassesPerDex, cross_dex);
+}
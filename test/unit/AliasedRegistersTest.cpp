@@ -8,8 +8,12 @@
 #include <gtest/gtest.h>
 
 #include "AliasedRegisters.h"
+#include <algorithm>
 #include <boost/optional.hpp>
+#include <map>
+#include <random>
 #include <unordered_map>
+#include <vector>
 
 using namespace aliased_registers;
 using namespace sparta;
@@ -366,3 +370,224 @@ TEST(AliasedRegistersTest, CopyOnWriteDomain) {
     EXPECT_FALSE(a.are_aliases(zero, one));
   });
 }
+
+namespace {
+
+// A straightforward model of the alias groups, with the same ordering rules
+// as AliasedRegisters, that the randomized test below compares against.
+struct ReferenceAliases {
+  std::vector<std::vector<Value>> groups;
+  std::map<reg_t, size_t> order;
+
+  int find(const Value& v) const {
+    for (size_t i = 0; i < groups.size(); ++i) {
+      if (std::find(groups[i].begin(), groups[i].end(), v) !=
+          groups[i].end()) {
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  bool are_aliases(const Value& a, const Value& b) const {
+    return a == b || (find(a) >= 0 && find(a) == find(b));
+  }
+
+  void break_alias(const Value& v) {
+    int i = find(v);
+    if (i < 0) {
+      return;
+    }
+    auto& group = groups[i];
+    group.erase(std::find(group.begin(), group.end(), v));
+    if (v.is_register()) {
+      order.erase(v.reg());
+    }
+    if (group.size() == 1) {
+      if (group.front().is_register()) {
+        order.erase(group.front().reg());
+      }
+      groups.erase(groups.begin() + i);
+    }
+  }
+
+  void move(const Value& moving, const Value& group) {
+    if (are_aliases(moving, group)) {
+      return;
+    }
+    break_alias(moving);
+    int i = find(group);
+    if (i < 0) {
+      groups.push_back({group});
+      i = groups.size() - 1;
+      if (group.is_register()) {
+        order[group.reg()] = 0;
+      }
+    }
+    if (moving.is_register()) {
+      size_t max = 0;
+      for (const auto& v : groups[i]) {
+        if (v.is_register()) {
+          max = std::max(max, order.at(v.reg()));
+        }
+      }
+      order[moving.reg()] = max + 1;
+    }
+    groups[i].push_back(moving);
+  }
+
+  reg_t get_representative(const Value& r,
+                           const boost::optional<reg_t>& max) const {
+    int i = find(r);
+    if (i < 0) {
+      return r.reg();
+    }
+    boost::optional<reg_t> best;
+    for (const auto& v : groups[i]) {
+      if (v.is_register() && (!max || v.reg() <= *max) &&
+          (!best || order.at(v.reg()) < order.at(*best))) {
+        best = v.reg();
+      }
+    }
+    return best ? *best : r.reg();
+  }
+
+  size_t num_edges() const {
+    size_t n = 0;
+    for (const auto& group : groups) {
+      n += group.size() - 1;
+    }
+    return n;
+  }
+
+  bool leq(const ReferenceAliases& other) const {
+    if (num_edges() < other.num_edges()) {
+      return false;
+    }
+    for (const auto& group : other.groups) {
+      for (const auto& v : group) {
+        if (!are_aliases(v, group.front())) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  void join_with(const ReferenceAliases& other) {
+    std::vector<std::vector<Value>> joined;
+    for (auto group : groups) {
+      std::sort(group.begin(), group.end());
+      std::vector<bool> taken(group.size());
+      for (size_t i = 0; i < group.size(); ++i) {
+        if (taken[i]) {
+          continue;
+        }
+        std::vector<Value> part{group[i]};
+        for (size_t j = i + 1; j < group.size(); ++j) {
+          if (!taken[j] && other.are_aliases(group[j], group[i])) {
+            taken[j] = true;
+            part.push_back(group[j]);
+          }
+        }
+        if (part.size() > 1) {
+          joined.push_back(part);
+        }
+      }
+    }
+    std::map<reg_t, size_t> joined_order;
+    for (const auto& group : joined) {
+      std::vector<reg_t> regs;
+      for (const auto& v : group) {
+        if (v.is_register()) {
+          regs.push_back(v.reg());
+        }
+      }
+      std::sort(regs.begin(), regs.end(), [&](reg_t a, reg_t b) {
+        bool this_less = order.at(a) < order.at(b);
+        bool other_less = other.order.at(a) < other.order.at(b);
+        return this_less == other_less ? this_less : a < b;
+      });
+      for (size_t i = 0; i < regs.size(); ++i) {
+        joined_order[regs[i]] = i;
+      }
+    }
+    groups = std::move(joined);
+    order = std::move(joined_order);
+  }
+};
+
+} // namespace
+
+TEST(AliasedRegistersTest, randomizedEquivalence) {
+  std::vector<Value> values;
+  for (reg_t r = 0; r < 8; ++r) {
+    values.push_back(Value::create_register(r));
+  }
+  values.push_back(int_one_lit);
+  values.push_back(Value::create_literal(1, constant_uses::TypeDemand::Long));
+  values.push_back(
+      Value::create_literal_upper(1, constant_uses::TypeDemand::Long));
+
+  auto expect_same = [&](const AliasedRegisters& actual,
+                         const ReferenceAliases& expected) {
+    EXPECT_EQ(expected.groups.empty() ? AbstractValueKind::Top
+                                      : AbstractValueKind::Value,
+              actual.kind());
+    for (const auto& a : values) {
+      for (const auto& b : values) {
+        EXPECT_EQ(expected.are_aliases(a, b), actual.are_aliases(a, b))
+            << a.str() << ", " << b.str();
+      }
+      if (a.is_register()) {
+        for (boost::optional<reg_t> max : {boost::optional<reg_t>(),
+                                           boost::optional<reg_t>(1),
+                                           boost::optional<reg_t>(4)}) {
+          EXPECT_EQ(expected.get_representative(a, max),
+                    actual.get_representative(a, max))
+              << a.str();
+        }
+      }
+    }
+  };
+
+  std::mt19937 rng(42);
+  auto pick = [&]() { return values[rng() % values.size()]; };
+  auto mutate = [&](AliasedRegisters& actual, ReferenceAliases& expected) {
+    for (size_t i = rng() % 12; i > 0; --i) {
+      auto moving = Value::create_register(rng() % 8);
+      if (rng() % 4 == 0) {
+        actual.break_alias(moving);
+        expected.break_alias(moving);
+      } else {
+        auto group = pick();
+        actual.move(moving, group);
+        expected.move(moving, group);
+      }
+      expect_same(actual, expected);
+    }
+  };
+
+  for (size_t round = 0; round < 200; ++round) {
+    AliasedRegisters a, b;
+    ReferenceAliases ref_a, ref_b;
+    mutate(a, ref_a);
+    b = a;
+    ref_b = ref_a;
+    mutate(a, ref_a);
+    mutate(b, ref_b);
+
+    EXPECT_EQ(ref_a.leq(ref_b), a.leq(b));
+    EXPECT_EQ(ref_b.leq(ref_a), b.leq(a));
+    EXPECT_EQ(ref_a.leq(ref_b) && ref_a.num_edges() == ref_b.num_edges(),
+              a.equals(b));
+
+    a.join_with(b);
+    ref_a.join_with(ref_b);
+    expect_same(a, ref_a);
+    EXPECT_TRUE(b.leq(a));
+
+    // Ages after a join still order later moves correctly
+    mutate(a, ref_a);
+  }
+}
@@ -0,0 +1,305 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <zlib.h>
+
+#include "ApkWriter.h"
+#include "RedexTestUtils.h"
+
+namespace {
+
+constexpr uint16_t STORED = 0;
+constexpr uint16_t DEFLATED = 8;
+
+void put16(std::string* out, uint16_t v) {
+  out->push_back(v & 0xff);
+  out->push_back(v >> 8);
+}
+
+void put32(std::string* out, uint32_t v) {
+  put16(out, v & 0xffff);
+  put16(out, v >> 16);
+}
+
+uint16_t read16(const std::string& s, size_t pos) {
+  return (uint8_t)s[pos] | ((uint8_t)s[pos + 1] << 8);
+}
+
+uint32_t read32(const std::string& s, size_t pos) {
+  return read16(s, pos) | ((uint32_t)read16(s, pos + 2) << 16);
+}
+
+uint32_t crc(const std::string& data) {
+  return crc32(0, reinterpret_cast<const Bytef*>(data.data()), data.size());
+}
+
+std::string deflate_raw(const std::string& data) {
+  z_stream zs{};
+  deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8,
+               Z_DEFAULT_STRATEGY);
+  std::string out(deflateBound(&zs, data.size()), '\0');
+  zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+  zs.avail_in = data.size();
+  zs.next_out = reinterpret_cast<Bytef*>(&out[0]);
+  zs.avail_out = out.size();
+  EXPECT_EQ(Z_STREAM_END, deflate(&zs, Z_FINISH));
+  out.resize(zs.total_out);
+  deflateEnd(&zs);
+  return out;
+}
+
+std::string inflate_raw(const std::string& data, size_t size) {
+  z_stream zs{};
+  inflateInit2(&zs, -MAX_WBITS);
+  std::string out(size, '\0');
+  zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+  zs.avail_in = data.size();
+  zs.next_out = reinterpret_cast<Bytef*>(&out[0]);
+  zs.avail_out = out.size();
+  EXPECT_EQ(Z_STREAM_END, inflate(&zs, Z_FINISH));
+  EXPECT_EQ(size, zs.total_out);
+  inflateEnd(&zs);
+  return out;
+}
+
+struct ZipEntry {
+  std::string name;
+  uint16_t method;
+  std::string contents;
+};
+
+// A minimal zip writer, standing in for the APK that redex unpacked.
+void write_zip(const std::string& path, const std::vector<ZipEntry>& entries) {
+  std::string zip;
+  std::string central_directory;
+  for (const auto& entry : entries) {
+    auto data = entry.method == STORED ? entry.contents
+                                       : deflate_raw(entry.contents);
+    uint32_t offset = zip.size();
+    put32(&zip, 0x04034b50);
+    put16(&zip, 20);
+    put16(&zip, 0);
+    put16(&zip, entry.method);
+    put32(&zip, 0); // time and date
+    put32(&zip, crc(entry.contents));
+    put32(&zip, data.size());
+    put32(&zip, entry.contents.size());
+    put16(&zip, entry.name.size());
+    put16(&zip, 0);
+    zip += entry.name + data;
+
+    put32(&central_directory, 0x02014b50);
+    put16(&central_directory, 20);
+    put16(&central_directory, 20);
+    put16(&central_directory, 0);
+    put16(&central_directory, entry.method);
+    put32(&central_directory, 0);
+    put32(&central_directory, crc(entry.contents));
+    put32(&central_directory, data.size());
+    put32(&central_directory, entry.contents.size());
+    put16(&central_directory, entry.name.size());
+    central_directory.append(12, '\0');
+    put32(&central_directory, offset);
+    central_directory += entry.name;
+  }
+  uint32_t central_directory_offset = zip.size();
+  zip += central_directory;
+  put32(&zip, 0x06054b50);
+  put32(&zip, 0);
+  put16(&zip, entries.size());
+  put16(&zip, entries.size());
+  put32(&zip, central_directory.size());
+  put32(&zip, central_directory_offset);
+  put16(&zip, 0);
+  std::ofstream(path, std::ios::binary) << zip;
+}
+
+struct ReadEntry {
+  std::string name;
+  uint16_t method;
+  uint32_t crc;
+  uint32_t compressed_size;
+  uint32_t size;
+  // Where the data starts in the file.
+  size_t data_offset;
+  std::string contents;
+};
+
+// Reads :path back through its central directory, checking every local
+// header against it.
+std::vector<ReadEntry> read_zip(const std::string& path) {
+  std::ifstream ifs(path, std::ios::binary);
+  std::string zip((std::istreambuf_iterator<char>(ifs)),
+                  std::istreambuf_iterator<char>());
+  std::vector<ReadEntry> entries;
+  size_t eocd = zip.size() - 22;
+  EXPECT_EQ(0x06054b50u, read32(zip, eocd));
+  size_t count = read16(zip, eocd + 10);
+  EXPECT_EQ(count, read16(zip, eocd + 8));
+  size_t pos = read32(zip, eocd + 16);
+  EXPECT_EQ(eocd, pos + read32(zip, eocd + 12));
+  for (size_t i = 0; i < count; ++i) {
+    EXPECT_EQ(0x02014b50u, read32(zip, pos));
+    ReadEntry entry;
+    entry.method = read16(zip, pos + 10);
+    entry.crc = read32(zip, pos + 16);
+    entry.compressed_size = read32(zip, pos + 20);
+    entry.size = read32(zip, pos + 24);
+    size_t name_len = read16(zip, pos + 28);
+    size_t local = read32(zip, pos + 42);
+    entry.name = zip.substr(pos + 46, name_len);
+    pos += 46 + name_len + read16(zip, pos + 30) + read16(zip, pos + 32);
+
+    EXPECT_EQ(0x04034b50u, read32(zip, local)) << entry.name;
+    EXPECT_EQ(entry.method, read16(zip, local + 8)) << entry.name;
+    EXPECT_EQ(entry.crc, read32(zip, local + 14)) << entry.name;
+    EXPECT_EQ(entry.compressed_size, read32(zip, local + 18)) << entry.name;
+    EXPECT_EQ(entry.size, read32(zip, local + 22)) << entry.name;
+    EXPECT_EQ(entry.name, zip.substr(local + 30, read16(zip, local + 26)));
+    entry.data_offset =
+        local + 30 + read16(zip, local + 26) + read16(zip, local + 28);
+    auto data = zip.substr(entry.data_offset, entry.compressed_size);
+    if (entry.method == STORED) {
+      EXPECT_EQ(entry.size, entry.compressed_size) << entry.name;
+      entry.contents = data;
+    } else {
+      EXPECT_EQ(DEFLATED, entry.method) << entry.name;
+      entry.contents = inflate_raw(data, entry.size);
+    }
+    entries.push_back(std::move(entry));
+  }
+  return entries;
+}
+
+} // namespace
+
+class ApkWriterTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    m_tmp_dir = redex::make_tmp_dir("redex_apk_writer_test_%%%%%%%%");
+    m_input_apk = m_tmp_dir.path + "/input.apk";
+    m_output_apk = m_tmp_dir.path + "/output.apk";
+    m_unpacked = m_tmp_dir.path + "/unpacked";
+  }
+
+  void add_file(const std::string& name, const std::string& contents) {
+    boost::filesystem::path path(m_unpacked + "/" + name);
+    boost::filesystem::create_directories(path.parent_path());
+    std::ofstream(path.string(), std::ios::binary) << contents;
+    m_files[name] = contents;
+  }
+
+  redex::TempDir m_tmp_dir;
+  std::string m_input_apk;
+  std::string m_output_apk;
+  std::string m_unpacked;
+  std::map<std::string, std::string> m_files;
+};
+
+TEST_F(ApkWriterTest, roundTrip) {
+  std::string dex(1000, 'd');
+  std::string arsc = "arsc";
+  write_zip(m_input_apk,
+            {
+                {"classes.dex", DEFLATED, dex},
+                {"resources.arsc", STORED, arsc},
+                {"assets/a.txt", DEFLATED, "old text"},
+                {"lib/arm64-v8a/libfoo.so", STORED, "old library"},
+            });
+  add_file("AndroidManifest.xml", "<manifest/>");
+  add_file("classes.dex", dex);
+  add_file("resources.arsc", arsc);
+  add_file("assets/a.txt", std::string(300, 'a'));
+  add_file("assets/empty", "");
+  add_file("lib/arm64-v8a/libfoo.so", std::string(5000, 's'));
+
+  apk_writer::Options options;
+  options.alignment = 4;
+  options.page_align_libs = true;
+  auto stats = apk_writer::write_apk(m_input_apk, m_unpacked, m_output_apk,
+                                     options);
+  EXPECT_EQ(6u, stats.entries);
+  // classes.dex and resources.arsc are unchanged.
+  EXPECT_EQ(2u, stats.copied);
+  // The manifest isn't in the input APK, so it is deflated like the changed
+  // assets.
+  EXPECT_EQ(3u, stats.deflated);
+  EXPECT_EQ(1u, stats.stored);
+
+  auto entries = read_zip(m_output_apk);
+  // The files of a directory come before its subdirectories.
+  std::vector<std::string> names;
+  for (const auto& entry : entries) {
+    names.push_back(entry.name);
+  }
+  EXPECT_EQ(std::vector<std::string>({"AndroidManifest.xml", "classes.dex",
+                                      "resources.arsc", "assets/a.txt",
+                                      "assets/empty",
+                                      "lib/arm64-v8a/libfoo.so"}),
+            names);
+
+  std::map<std::string, uint16_t> methods{
+      {"AndroidManifest.xml", DEFLATED}, {"classes.dex", DEFLATED},
+      {"resources.arsc", STORED},        {"assets/a.txt", DEFLATED},
+      {"assets/empty", DEFLATED},        {"lib/arm64-v8a/libfoo.so", STORED},
+  };
+  for (const auto& entry : entries) {
+    const auto& contents = m_files.at(entry.name);
+    EXPECT_EQ(methods.at(entry.name), entry.method) << entry.name;
+    EXPECT_EQ(contents.size(), entry.size) << entry.name;
+    EXPECT_EQ(crc(contents), entry.crc) << entry.name;
+    EXPECT_EQ(contents, entry.contents) << entry.name;
+    if (entry.name == "resources.arsc") {
+      EXPECT_EQ(0u, entry.data_offset % 4);
+    } else if (entry.name == "lib/arm64-v8a/libfoo.so") {
+      EXPECT_EQ(0u, entry.data_offset % 4096);
+    }
+  }
+}
+
+TEST_F(ApkWriterTest, alignment) {
+  // Names of different lengths, so that some stored entries need padding.
+  write_zip(m_input_apk,
+            {
+                {"a", STORED, "x"},
+                {"bb", STORED, "xyz"},
+                {"ccc", STORED, "x"},
+                {"lib/libd.so", STORED, "x"},
+            });
+  add_file("a", "1");
+  add_file("bb", "xyz");
+  add_file("ccc", "12345");
+  add_file("lib/libd.so", "1");
+
+  apk_writer::Options options;
+  options.alignment = 4;
+  auto stats = apk_writer::write_apk(m_input_apk, m_unpacked, m_output_apk,
+                                     options);
+  EXPECT_EQ(4u, stats.entries);
+  EXPECT_EQ(1u, stats.copied);
+  EXPECT_EQ(3u, stats.stored);
+  for (const auto& entry : read_zip(m_output_apk)) {
+    EXPECT_EQ(STORED, entry.method) << entry.name;
+    EXPECT_EQ(m_files.at(entry.name), entry.contents) << entry.name;
+    EXPECT_EQ(0u, entry.data_offset % 4) << entry.name;
+  }
+
+  // Without alignment, there is no padding at all.
+  options.alignment = 1;
+  apk_writer::write_apk(m_input_apk, m_unpacked, m_output_apk, options);
+  size_t expected_offset = 0;
+  for (const auto& entry : read_zip(m_output_apk)) {
+    EXPECT_EQ(expected_offset + 30 + entry.name.size(), entry.data_offset)
+        << entry.name;
+    expected_offset = entry.data_offset + entry.size;
+  }
+}
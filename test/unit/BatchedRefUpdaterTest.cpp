@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "BatchedRefUpdater.h"
+
+#include "Creators.h"
+#include "DexAnnotation.h"
+#include "IRAssembler.h"
+#include "RedexTest.h"
+
+using namespace reference_update;
+
+class BatchedRefUpdaterTest : public RedexTest {};
+
+TEST_F(BatchedRefUpdaterTest, code_and_annotations) {
+  auto foo = DexType::make_type("LFoo;");
+  auto bar = DexType::make_type("LBar;");
+  auto anno_type = DexType::make_type("LAnno;");
+  ClassCreator cc(foo);
+  cc.set_super(type::java_lang_Object());
+
+  auto old_callee = DexMethod::make_method("LFoo;.old:()V")
+                        ->make_concrete(ACC_PUBLIC | ACC_STATIC, false);
+  old_callee->set_code(assembler::ircode_from_string("((return-void))"));
+  cc.add_method(old_callee);
+  auto new_callee = DexMethod::make_method("LFoo;.new:()V")
+                        ->make_concrete(ACC_PUBLIC | ACC_STATIC, false);
+  new_callee->set_code(assembler::ircode_from_string("((return-void))"));
+  cc.add_method(new_callee);
+
+  auto old_field = DexField::make_field("LFoo;.old:I")
+                       ->make_concrete(ACC_PUBLIC | ACC_STATIC);
+  cc.add_field(old_field);
+  auto new_field = DexField::make_field("LFoo;.new:I")
+                       ->make_concrete(ACC_PUBLIC | ACC_STATIC);
+  cc.add_field(new_field);
+
+  auto caller = DexMethod::make_method("LFoo;.caller:()V")
+                    ->make_concrete(ACC_PUBLIC | ACC_STATIC, false);
+  caller->set_code(assembler::ircode_from_string(R"(
+    (
+      (invoke-static () "LFoo;.old:()V")
+      (sget "LFoo;.old:I")
+      (move-result-pseudo v0)
+      (const v1 1)
+      (new-array v1 "[LFoo;")
+      (move-result-pseudo-object v2)
+      (return-void)
+    )
+  )"));
+  auto anno = new DexAnnotation(anno_type, DAV_RUNTIME);
+  anno->add_element("type", new DexEncodedValueType(foo));
+  auto anno_set = new DexAnnotationSet();
+  anno_set->add_annotation(anno);
+  caller->attach_annotation_set(anno_set);
+  cc.add_method(caller);
+
+  Scope scope{cc.create()};
+
+  BatchedRefUpdater updater;
+  EXPECT_TRUE(updater.empty());
+  updater.update_calls(old_callee, new_callee);
+  updater.update_field_refs(old_field, new_field);
+  updater.update_type_refs(foo, bar);
+  auto stats = updater.apply(scope);
+
+  auto expected_code = assembler::ircode_from_string(R"(
+    (
+      (invoke-static () "LFoo;.new:()V")
+      (sget "LFoo;.new:I")
+      (move-result-pseudo v0)
+      (const v1 1)
+      (new-array v1 "[LBar;")
+      (move-result-pseudo-object v2)
+      (return-void)
+    )
+  )");
+  EXPECT_CODE_EQ(caller->get_code(), expected_code.get());
+  EXPECT_EQ(3, stats.insns);
+  EXPECT_EQ(1, stats.encoded_values);
+  EXPECT_EQ(0, stats.annotations);
+  auto value = static_cast<DexEncodedValueType*>(
+      anno->anno_elems().front().encoded_value);
+  EXPECT_EQ(bar, value->type());
+}
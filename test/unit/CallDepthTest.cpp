@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "CallDepth.h"
+#include "IRAssembler.h"
+#include "RedexTest.h"
+
+namespace {
+
+// Follows the invoke-static instructions of the methods reachable from the
+// given roots.
+class StaticCallsStrategy final : public call_graph::BuildStrategy {
+ public:
+  explicit StaticCallsStrategy(std::vector<const DexMethod*> roots)
+      : m_roots(std::move(roots)) {}
+
+  std::vector<const DexMethod*> get_roots() const override { return m_roots; }
+
+  call_graph::CallSites get_callsites(const DexMethod* method) const override {
+    call_graph::CallSites callsites;
+    auto* code = const_cast<IRCode*>(method->get_code());
+    for (auto& mie : InstructionIterable(code)) {
+      if (mie.insn->opcode() == OPCODE_INVOKE_STATIC) {
+        auto callee = mie.insn->get_method()->as_def();
+        if (callee != nullptr) {
+          callsites.emplace_back(callee, code->iterator_to(mie));
+        }
+      }
+    }
+    return callsites;
+  }
+
+ private:
+  std::vector<const DexMethod*> m_roots;
+};
+
+} // namespace
+
+struct CallDepthTest : public RedexTest {
+  DexMethod* make_method(const std::string& name,
+                         const std::vector<std::string>& callees) {
+    std::string body;
+    for (const auto& callee : callees) {
+      body += "(invoke-static () \"LFoo;." + callee + ":()V\")";
+    }
+    return assembler::method_from_string("(method (public static) \"LFoo;." +
+                                         name + ":()V\" (" + body +
+                                         " (return-void)))");
+  }
+};
+
+TEST_F(CallDepthTest, depthsAndCycles) {
+  std::vector<DexMethod*> methods{
+      make_method("leaf", {}),
+      make_method("mid", {"leaf"}),
+      make_method("top", {"mid", "leaf"}),
+      make_method("rec1", {"rec2"}),
+      make_method("rec2", {"rec1", "leaf"}),
+      make_method("self", {"self"}),
+      make_method("above_rec", {"rec1", "mid"}),
+      make_method("calls_unknown", {"unknown"}),
+  };
+  // The invokes reference the methods by name, so they resolve once all of
+  // them are defined, except for the unknown one.
+  Scope scope{assembler::class_with_methods("LFoo;", methods)};
+  std::vector<const DexMethod*> roots(methods.begin(), methods.end());
+  call_graph::Graph graph{StaticCallsStrategy(roots)};
+
+  auto depths = call_depth::compute(scope, graph);
+  auto depth_of = [&](const std::string& name) {
+    auto method = DexMethod::get_method("LFoo;." + name + ":()V")->as_def();
+    auto it = depths.find(method);
+    return it == depths.end() ? -1 : (int)it->second;
+  };
+  EXPECT_EQ(0, depth_of("leaf"));
+  EXPECT_EQ(1, depth_of("mid"));
+  EXPECT_EQ(2, depth_of("top"));
+  // The unresolved call still takes a frame.
+  EXPECT_EQ(1, depth_of("calls_unknown"));
+  // Recursion makes the depths unbounded, also for the callers.
+  EXPECT_EQ(-1, depth_of("rec1"));
+  EXPECT_EQ(-1, depth_of("rec2"));
+  EXPECT_EQ(-1, depth_of("self"));
+  EXPECT_EQ(-1, depth_of("above_rec"));
+}
@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "CallGraph.h"
+#include "IRAssembler.h"
+#include "RedexTest.h"
+
+using namespace call_graph;
+
+namespace {
+
+// Follows the invoke-static instructions of the methods reachable from the
+// given roots.
+class StaticCallsStrategy final : public BuildStrategy {
+ public:
+  explicit StaticCallsStrategy(std::vector<const DexMethod*> roots)
+      : m_roots(std::move(roots)) {}
+
+  std::vector<const DexMethod*> get_roots() const override { return m_roots; }
+
+  CallSites get_callsites(const DexMethod* method) const override {
+    CallSites callsites;
+    auto* code = const_cast<IRCode*>(method->get_code());
+    for (auto& mie : InstructionIterable(code)) {
+      if (mie.insn->opcode() == OPCODE_INVOKE_STATIC) {
+        callsites.emplace_back(mie.insn->get_method()->as_def(),
+                               code->iterator_to(mie));
+      }
+    }
+    return callsites;
+  }
+
+ private:
+  std::vector<const DexMethod*> m_roots;
+};
+
+std::vector<const DexMethod*> callees(const Graph& graph,
+                                      const DexMethod* method) {
+  std::vector<const DexMethod*> result;
+  for (const auto& edge : graph.node(method)->callees()) {
+    result.push_back(edge->callee()->method());
+  }
+  return result;
+}
+
+std::vector<const DexMethod*> callers(const Graph& graph,
+                                      const DexMethod* method) {
+  std::vector<const DexMethod*> result;
+  for (const auto& edge : graph.node(method)->callers()) {
+    result.push_back(edge->caller()->method());
+  }
+  return result;
+}
+
+IRList::iterator first_invoke(const DexMethod* method) {
+  auto* code = const_cast<IRCode*>(method->get_code());
+  for (auto& mie : InstructionIterable(code)) {
+    if (is_invoke(mie.insn->opcode())) {
+      return code->iterator_to(mie);
+    }
+  }
+  not_reached();
+}
+
+} // namespace
+
+struct CallGraphTest : public RedexTest {
+  DexMethod* make_method(const std::string& name, const std::string& body) {
+    return assembler::method_from_string("(method (public static) \"LFoo;." +
+                                         name + ":()V\" (" + body +
+                                         " (return-void)))");
+  }
+
+  void SetUp() override {
+    bar = make_method("bar", "");
+    baz = make_method("baz", "");
+    foo = make_method("foo", "(invoke-static () \"LFoo;.bar:()V\")");
+  }
+
+  DexMethod* foo;
+  DexMethod* bar;
+  DexMethod* baz;
+};
+
+TEST_F(CallGraphTest, addRemoveAndRetargetCallsites) {
+  Graph graph(StaticCallsStrategy({foo}));
+  EXPECT_THAT(callees(graph, foo), ::testing::ElementsAre(bar));
+  EXPECT_THAT(callees(graph, bar), ::testing::ElementsAre(nullptr));
+  EXPECT_FALSE(graph.has_node(baz));
+
+  auto invoke = first_invoke(foo);
+  graph.retarget_callsite(foo, invoke, baz);
+  EXPECT_THAT(callees(graph, foo), ::testing::ElementsAre(baz));
+  EXPECT_THAT(callers(graph, baz), ::testing::ElementsAre(foo));
+  EXPECT_THAT(callees(graph, baz), ::testing::ElementsAre(nullptr));
+  EXPECT_TRUE(callers(graph, bar).empty());
+
+  graph.add_callsite(foo, bar, invoke);
+  EXPECT_THAT(callees(graph, foo), ::testing::ElementsAre(baz, bar));
+
+  // Removing the last callsite falls back to an edge to the exit node.
+  graph.remove_callsite(foo, invoke);
+  EXPECT_THAT(callees(graph, foo), ::testing::ElementsAre(nullptr));
+  EXPECT_TRUE(callers(graph, bar).empty());
+  EXPECT_TRUE(callers(graph, baz).empty());
+
+  graph.remove_method(bar);
+  EXPECT_FALSE(graph.has_node(bar));
+  EXPECT_THAT(callers(graph, foo), ::testing::ElementsAre(nullptr));
+}
+
+TEST_F(CallGraphTest, rebuildDirtyMethods) {
+  StaticCallsStrategy strategy({foo});
+  Graph graph(strategy);
+
+  // Change foo to call baz, which is not in the graph yet and calls bar.
+  baz->set_code(assembler::ircode_from_string(R"(
+    (
+     (invoke-static () "LFoo;.bar:()V")
+     (return-void)
+    )
+  )"));
+  foo->set_code(assembler::ircode_from_string(R"(
+    (
+     (invoke-static () "LFoo;.baz:()V")
+     (return-void)
+    )
+  )"));
+  EXPECT_EQ(1, graph.rebuild_callsites(strategy, {foo, foo}));
+  EXPECT_THAT(callees(graph, foo), ::testing::ElementsAre(baz));
+  EXPECT_THAT(callees(graph, baz), ::testing::ElementsAre(bar));
+  EXPECT_THAT(callers(graph, bar), ::testing::ElementsAre(baz));
+  EXPECT_THAT(callers(graph, foo), ::testing::ElementsAre(nullptr));
+}
+
+TEST_F(CallGraphTest, compactGraph) {
+  auto qux = make_method("qux", "(invoke-static () \"LFoo;.foo:()V\")");
+  Graph graph(StaticCallsStrategy({qux, foo}));
+  CompactGraph compact_graph(graph);
+  // The ghost nodes, qux, foo and bar.
+  EXPECT_EQ(5, compact_graph.num_nodes());
+  EXPECT_EQ(nullptr, compact_graph.method(compact_graph.entry()));
+  EXPECT_EQ(nullptr, compact_graph.method(compact_graph.exit()));
+  EXPECT_FALSE(compact_graph.has_node(baz));
+
+  for (const DexMethod* method : {qux, foo, bar}) {
+    auto node = compact_graph.node(method);
+    EXPECT_EQ(method, compact_graph.method(node));
+    auto callee_edges = CompactGraphInterface::successors(compact_graph, node);
+    std::vector<const DexMethod*> compact_callees;
+    for (auto edge : callee_edges) {
+      EXPECT_EQ(node, CompactGraphInterface::source(compact_graph, edge));
+      compact_callees.push_back(compact_graph.method(
+          CompactGraphInterface::target(compact_graph, edge)));
+    }
+    EXPECT_EQ(callees(graph, method), compact_callees);
+    std::vector<const DexMethod*> compact_callers;
+    for (auto edge : compact_graph.caller_edges(node)) {
+      compact_callers.push_back(
+          compact_graph.method(compact_graph.caller(edge)));
+    }
+    EXPECT_THAT(compact_callers,
+                ::testing::UnorderedElementsAreArray(callers(graph, method)));
+  }
+  auto foo_edge = compact_graph.first_callee_edge(compact_graph.node(foo));
+  EXPECT_EQ(first_invoke(foo), compact_graph.invoke_iterator(foo_edge));
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "ClassHierarchy.h"
+#include "DexClass.h"
+#include "RedexTest.h"
+#include "ScopeHelper.h"
+
+struct ClassHierarchyTest : public RedexTest {
+  /**
+   * interface I
+   * class A
+   * class B extends A implements I
+   * class C extends B
+   * class D extends A
+   */
+  void SetUp() override {
+    scope = create_empty_scope();
+    auto obj_t = type::java_lang_Object();
+    i_t = DexType::make_type("LI;");
+    a_t = DexType::make_type("LA;");
+    b_t = DexType::make_type("LB;");
+    c_t = DexType::make_type("LC;");
+    d_t = DexType::make_type("LD;");
+    scope.push_back(
+        create_internal_class(i_t, obj_t, {}, ACC_PUBLIC | ACC_INTERFACE));
+    scope.push_back(create_internal_class(a_t, obj_t, {}));
+    scope.push_back(create_internal_class(b_t, a_t, {i_t}));
+    scope.push_back(create_internal_class(c_t, b_t, {}));
+    scope.push_back(create_internal_class(d_t, a_t, {}));
+  }
+
+  Scope scope;
+  DexType* i_t;
+  DexType* a_t;
+  DexType* b_t;
+  DexType* c_t;
+  DexType* d_t;
+};
+
+TEST_F(ClassHierarchyTest, indexAgreesWithHierarchy) {
+  auto hierarchy = build_type_hierarchy(scope);
+  ClassHierarchyIndex index(hierarchy);
+  for (const auto& p : hierarchy) {
+    auto children = index.get_all_children(p.first);
+    EXPECT_EQ(get_all_children(hierarchy, p.first),
+              TypeSet(children.begin(), children.end()));
+  }
+  EXPECT_TRUE(index.is_subclass(a_t, a_t));
+  EXPECT_TRUE(index.is_subclass(a_t, c_t));
+  EXPECT_TRUE(index.is_subclass(type::java_lang_Object(), d_t));
+  EXPECT_FALSE(index.is_subclass(b_t, d_t));
+  EXPECT_FALSE(index.is_subclass(c_t, b_t));
+  EXPECT_FALSE(index.contains(i_t));
+  EXPECT_TRUE(index.get_all_children(i_t).empty());
+}
+
+TEST_F(ClassHierarchyTest, cachedUntilStructureChanges) {
+  auto cached = get_cached_class_hierarchy(scope);
+  EXPECT_EQ(build_interface_map(cached->hierarchy), cached->interfaces);
+  EXPECT_THAT(cached->interfaces.at(i_t),
+              ::testing::UnorderedElementsAre(b_t, c_t));
+  EXPECT_EQ(cached, get_cached_class_hierarchy(scope));
+
+  // Changes to members don't matter, changes to super classes do.
+  type_class(c_t)->set_access(type_class(c_t)->get_access() | ACC_FINAL);
+  EXPECT_EQ(cached, get_cached_class_hierarchy(scope));
+  type_class(c_t)->set_super_class(d_t);
+  auto updated = get_cached_class_hierarchy(scope);
+  EXPECT_NE(cached, updated);
+  EXPECT_TRUE(updated->index.is_subclass(d_t, c_t));
+  EXPECT_THAT(updated->interfaces.at(i_t), ::testing::ElementsAre(b_t));
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "DexClass.h"
+#include "RedexTest.h"
+#include "ScopeHelper.h"
+#include "VirtualScope.h"
+
+struct ClassScopesTest : public RedexTest {
+  /**
+   * interface I { void m(); }
+   * class A { void m() {} }
+   * class B extends A implements I { void m() {} }
+   * class C extends A {}
+   */
+  void SetUp() override {
+    scope = create_empty_scope();
+    auto obj_t = type::java_lang_Object();
+    void_void =
+        DexProto::make_proto(type::_void(), DexTypeList::make_type_list({}));
+    i_t = DexType::make_type("LI;");
+    a_t = DexType::make_type("LA;");
+    b_t = DexType::make_type("LB;");
+    c_t = DexType::make_type("LC;");
+    auto i_cls =
+        create_internal_class(i_t, obj_t, {}, ACC_PUBLIC | ACC_INTERFACE);
+    create_abstract_method(i_cls, "m", void_void);
+    auto a_cls = create_internal_class(a_t, obj_t, {});
+    a_m = create_empty_method(a_cls, "m", void_void);
+    auto b_cls = create_internal_class(b_t, a_t, {i_t});
+    b_m = create_empty_method(b_cls, "m", void_void);
+    c_cls = create_internal_class(c_t, a_t, {});
+    scope = {i_cls, a_cls, b_cls, c_cls};
+  }
+
+  Scope scope;
+  DexProto* void_void;
+  DexType* i_t;
+  DexType* a_t;
+  DexType* b_t;
+  DexType* c_t;
+  DexClass* c_cls;
+  DexMethod* a_m;
+  DexMethod* b_m;
+};
+
+TEST_F(ClassScopesTest, scopesMatchHierarchy) {
+  ClassScopes class_scopes(scope);
+  const auto& a_scopes = class_scopes.get(a_t);
+  ASSERT_EQ(1, a_scopes.size());
+  const auto* a_scope = a_scopes[0];
+  EXPECT_EQ(a_t, a_scope->type);
+  ASSERT_EQ(2, a_scope->methods.size());
+  EXPECT_EQ(a_m, a_scope->methods[0].first);
+  EXPECT_EQ(b_m, a_scope->methods[1].first);
+  EXPECT_TRUE(a_scope->methods[1].second & OVERRIDE);
+  EXPECT_TRUE(a_scope->methods[1].second & IMPL);
+  EXPECT_EQ(1, a_scope->interfaces.count(i_t));
+  EXPECT_TRUE(class_scopes.get(b_t).empty());
+  EXPECT_TRUE(class_scopes.get(c_t).empty());
+  EXPECT_EQ(a_scope, &class_scopes.find_virtual_scope(b_m));
+
+  const auto& i_scopes = class_scopes.get_interface_scopes(i_t);
+  ASSERT_EQ(1, i_scopes.size());
+  EXPECT_FALSE(i_scopes[0].empty());
+  for (const auto* scope : i_scopes[0]) {
+    EXPECT_EQ(1, scope->interfaces.count(i_t));
+  }
+}
+
+TEST_F(ClassScopesTest, cachedUntilVirtualMethodsChange) {
+  auto cached = get_cached_class_scopes(scope);
+  EXPECT_EQ(cached, get_cached_class_scopes(scope));
+  EXPECT_EQ(1, cached->get(a_t).size());
+
+  auto c_n = create_empty_method(c_cls, "n", void_void);
+  auto updated = get_cached_class_scopes(scope);
+  EXPECT_NE(cached, updated);
+  ASSERT_EQ(1, updated->get(c_t).size());
+  EXPECT_EQ(c_n, updated->get(c_t)[0]->methods[0].first);
+  // Earlier scopes stay valid for as long as they are held.
+  EXPECT_TRUE(cached->get(c_t).empty());
+}
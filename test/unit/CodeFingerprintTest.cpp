@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "CodeFingerprint.h"
+#include "IRAssembler.h"
+#include "IRCode.h"
+#include "RedexTest.h"
+
+using namespace code_fingerprint;
+
+struct CodeFingerprintTest : public RedexTest {};
+
+TEST_F(CodeFingerprintTest, invariantUnderRegisterRenaming) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (load-param v0)
+      (const v1 1)
+      (add-int v2 v0 v1)
+      (return v2)
+    )
+  )");
+  auto renamed = assembler::ircode_from_string(R"(
+    (
+      (load-param v5)
+      (const v3 1)
+      (add-int v4 v5 v3)
+      (return v4)
+    )
+  )");
+  auto swapped = assembler::ircode_from_string(R"(
+    (
+      (load-param v0)
+      (const v1 1)
+      (add-int v2 v1 v0)
+      (return v2)
+    )
+  )");
+  auto other_literal = assembler::ircode_from_string(R"(
+    (
+      (load-param v0)
+      (const v1 2)
+      (add-int v2 v0 v1)
+      (return v2)
+    )
+  )");
+  EXPECT_EQ(compute(*code), compute(*renamed));
+  EXPECT_NE(compute(*code), compute(*swapped));
+  EXPECT_NE(compute(*code), compute(*other_literal));
+}
+
+TEST_F(CodeFingerprintTest, cacheNoticesNewCode) {
+  auto method =
+      DexMethod::make_method("LFoo;.bar:()V")->make_concrete(ACC_STATIC, false);
+  method->set_code(assembler::ircode_from_string("((return-void))"));
+  FingerprintCache cache;
+  auto fingerprint = cache.get(method);
+  EXPECT_EQ(fingerprint, cache.get(method));
+  EXPECT_EQ(1, cache.hits());
+
+  method->set_code(assembler::ircode_from_string(R"(
+    (
+      (const v0 0)
+      (return-void)
+    )
+  )"));
+  EXPECT_NE(fingerprint, cache.get(method));
+  EXPECT_EQ(2, cache.misses());
+}
@@ -1702,3 +1702,89 @@ TEST_F(CommonSubexpressionEliminationTest, no_phi_node) {
   auto expected_str = code_str;
   test(Scope{type_class(type::java_lang_Object())}, code_str, expected_str, 0);
 }
+
+TEST_F(CommonSubexpressionEliminationTest, method_barriers_are_cached) {
+  DexField::make_field("LFoo;.s:I")->make_concrete(ACC_PUBLIC | ACC_STATIC);
+  DexField::make_field("LFoo;.t:I")->make_concrete(ACC_PUBLIC | ACC_STATIC);
+
+  ClassCreator creator(DexType::make_type("LTestCache;"));
+  creator.set_super(type::java_lang_Object());
+  auto method = DexMethod::make_method("LTestCache;.write:()V")
+                    ->make_concrete(ACC_PUBLIC | ACC_STATIC, false);
+  method->set_code(assembler::ircode_from_string(R"(
+    (
+      (const v0 0)
+      (sput v0 "LFoo;.s:I")
+      (return-void)
+    )
+  )"));
+  creator.add_method(method);
+  Scope scope{type_class(type::java_lang_Object()), creator.create()};
+
+  auto pure_methods = get_pure_methods();
+  cse_impl::MethodBarriersCache cache;
+  auto run = [&]() {
+    walk::code(scope, [&](DexMethod*, IRCode& code) {
+      code.build_cfg(/* editable */ true);
+    });
+    cse_impl::SharedState shared_state(pure_methods, &cache);
+    shared_state.init_scope(scope);
+    walk::code(scope, [&](DexMethod*, IRCode& code) { code.clear_cfg(); });
+    return shared_state.get_stats();
+  };
+
+  EXPECT_EQ(0, run().method_barriers_cache_hits);
+  EXPECT_EQ(1, run().method_barriers_cache_hits);
+
+  // Writing another field invalidates the entry.
+  method->set_code(assembler::ircode_from_string(R"(
+    (
+      (const v0 0)
+      (sput v0 "LFoo;.s:I")
+      (sput v0 "LFoo;.t:I")
+      (return-void)
+    )
+  )"));
+  EXPECT_EQ(0, run().method_barriers_cache_hits);
+  EXPECT_EQ(1, run().method_barriers_cache_hits);
+}
+
+TEST_F(CommonSubexpressionEliminationTest, straight_line_code_is_local) {
+  auto get_stats = [](const std::string& code_str) {
+    auto code = assembler::ircode_from_string(code_str);
+    code->build_cfg(/* editable */ true);
+    auto pure_methods = get_pure_methods();
+    cse_impl::SharedState shared_state(pure_methods);
+    shared_state.init_scope(Scope{type_class(type::java_lang_Object())});
+    cse_impl::CommonSubexpressionElimination cse(
+        &shared_state, code->cfg(), /* is_static */ true,
+        /* is_init_or_clinit */ false, /* declaring_type */ nullptr,
+        DexTypeList::make_type_list({}));
+    code->clear_cfg();
+    return cse.get_stats();
+  };
+
+  auto stats = get_stats(R"(
+    (
+      (load-param v0)
+      (add-int v1 v0 v0)
+      (if-eqz v0 :L1)
+      (sub-int v2 v0 v0)
+      (:L1)
+      (return v1)
+    )
+  )");
+  EXPECT_EQ(1, stats.methods_skipped);
+  EXPECT_EQ(0, stats.methods_using_local_value_numbering);
+
+  stats = get_stats(R"(
+    (
+      (load-param v0)
+      (mul-int v1 v0 v0)
+      (mul-int v2 v0 v0)
+      (return v2)
+    )
+  )");
+  EXPECT_EQ(0, stats.methods_skipped);
+  EXPECT_EQ(1, stats.methods_using_local_value_numbering);
+}
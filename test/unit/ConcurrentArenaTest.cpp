@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "ConcurrentArena.h"
+
+#include <atomic>
+#include <gtest/gtest.h>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <boost/thread/thread.hpp>
+
+namespace {
+
+std::atomic<size_t> s_num_destroyed{0};
+
+struct Entity {
+  explicit Entity(size_t i) : id(i), name(std::to_string(i)) {}
+  ~Entity() { ++s_num_destroyed; }
+  size_t id;
+  std::string name;
+};
+
+void destroy_entity(Entity* e) { e->~Entity(); }
+
+constexpr size_t kThreads = 8;
+constexpr size_t kPerThread = 10000;
+
+} // namespace
+
+TEST(ConcurrentArenaTest, concurrentAllocation) {
+  s_num_destroyed = 0;
+  ConcurrentArena<Entity> arena(destroy_entity);
+  std::vector<std::vector<Entity*>> allocated(kThreads);
+  std::vector<boost::thread> threads;
+  for (size_t t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&, t]() {
+      for (size_t i = 0; i < kPerThread; ++i) {
+        auto* e = new (arena.allocate()) Entity(t * kPerThread + i);
+        // Give every other object back right away, as RedexContext does when
+        // it loses an interning race.
+        if (i % 2 == 1) {
+          arena.destroy(e);
+        } else {
+          allocated[t].push_back(e);
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(kThreads * kPerThread / 2, s_num_destroyed);
+
+  std::unordered_set<Entity*> distinct;
+  for (size_t t = 0; t < kThreads; ++t) {
+    for (auto* e : allocated[t]) {
+      EXPECT_EQ(std::to_string(e->id), e->name);
+      EXPECT_EQ(t, e->id / kPerThread);
+      distinct.insert(e);
+    }
+  }
+  EXPECT_EQ(kThreads * kPerThread / 2, distinct.size());
+
+  arena.release();
+  EXPECT_EQ(kThreads * kPerThread, s_num_destroyed);
+
+  // The arena can be reused after a release, and its destructor cleans up.
+  new (arena.allocate()) Entity(0);
+  new (arena.allocate()) Entity(1);
+  EXPECT_EQ(kThreads * kPerThread, s_num_destroyed);
+}
+
+TEST(ConcurrentArenaTest, destructorReleases) {
+  s_num_destroyed = 0;
+  {
+    ConcurrentArena<Entity> a(destroy_entity);
+    ConcurrentArena<Entity> b(destroy_entity);
+    // Alternate between arenas of the same type on one thread.
+    for (size_t i = 0; i < 100; ++i) {
+      new ((i % 2 == 0 ? a : b).allocate()) Entity(i);
+    }
+  }
+  EXPECT_EQ(100, s_num_destroyed);
+}
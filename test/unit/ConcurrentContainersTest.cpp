@@ -8,6 +8,7 @@
 #include "ConcurrentContainers.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cstdint>
 #include <functional>
 #include <gtest/gtest.h>
@@ -302,3 +303,127 @@ TEST_F(ConcurrentContainersTest, concurrentMapTest) {
   map.clear();
   EXPECT_EQ(0, map.size());
 }
+
+TEST_F(ConcurrentContainersTest, readOptimizedConcurrentMapTest) {
+  ReadOptimizedConcurrentMap<std::string, uint32_t> map;
+
+  run_on_samples([&map](const std::vector<uint32_t>& sample) {
+    for (size_t i = 0; i < sample.size(); ++i) {
+      std::string s = std::to_string(sample[i]);
+      map.emplace(s, sample[i]);
+      EXPECT_EQ(1, map.count(s));
+      EXPECT_EQ(sample[i], map.at(s));
+    }
+  });
+  EXPECT_EQ(m_data_set.size(), map.size());
+  for (uint32_t x : m_data) {
+    std::string s = std::to_string(x);
+    auto it = map.find(s);
+    EXPECT_NE(map.end(), it);
+    EXPECT_EQ(s, it->first);
+    EXPECT_EQ(x, it->second);
+    EXPECT_FALSE(map.insert({s, x + 1}));
+    EXPECT_EQ(x, map.get(s, 0));
+  }
+  std::unordered_set<std::string> iterated;
+  for (const auto& p : map) {
+    EXPECT_TRUE(iterated.insert(p.first).second);
+  }
+  EXPECT_EQ(m_data_set.size(), iterated.size());
+
+  // Readers run concurrently with writers erasing a subset of the keys.
+  std::unordered_set<uint32_t> erased(m_subset_data.begin(),
+                                      m_subset_data.end());
+  boost::thread writer([&]() {
+    for (uint32_t x : m_subset_data) {
+      map.erase(std::to_string(x));
+    }
+  });
+  run_on_samples([&](const std::vector<uint32_t>& sample) {
+    for (size_t i = 0; i < sample.size(); ++i) {
+      auto value = map.get(std::to_string(sample[i]), 0);
+      if (value != 0) {
+        EXPECT_EQ(sample[i], value);
+      } else {
+        EXPECT_TRUE(sample[i] == 0 || erased.count(sample[i]));
+      }
+    }
+  });
+  writer.join();
+
+  for (uint32_t x : m_data) {
+    std::string s = std::to_string(x);
+    EXPECT_EQ(erased.count(x) ? 0 : 1, map.count(s));
+    EXPECT_EQ(erased.count(x) != 0, map.end() == map.find(s));
+  }
+  EXPECT_EQ(m_data_set.size() - erased.size(), map.size());
+
+  // Erased keys can be inserted again.
+  for (uint32_t x : m_subset_data) {
+    map.emplace(std::to_string(x), x);
+  }
+  EXPECT_EQ(m_data_set.size(), map.size());
+
+  EXPECT_THROW(map.at("not a number"), std::out_of_range);
+  map.clear();
+  EXPECT_EQ(0, map.size());
+  EXPECT_EQ(map.begin(), map.end());
+}
+
+TEST_F(ConcurrentContainersTest, readOptimizedConcurrentMapFindDuringGrow) {
+  // A single slot makes every insertion contend for the same table, so the
+  // writers keep rehashing it while the readers probe.
+  ReadOptimizedConcurrentMap<uint32_t, uint32_t, std::hash<uint32_t>,
+                             std::equal_to<uint32_t>, 1>
+      map;
+  constexpr uint32_t kStable = 64;
+  constexpr uint32_t kGrowth = 1 << 16;
+  for (uint32_t x = 0; x < kStable; ++x) {
+    map.emplace(x, x * 2);
+  }
+
+  std::atomic<bool> done{false};
+  std::vector<boost::thread> writers;
+  for (uint32_t w = 0; w < 2; ++w) {
+    writers.emplace_back([&, w]() {
+      for (uint32_t x = kStable + w; x < kStable + kGrowth; x += 2) {
+        map.emplace(x, x * 2);
+        // Tombstones force rehashes even when the table is not full.
+        if (x % 3 == 0) {
+          map.erase(x);
+        }
+      }
+    });
+  }
+  std::vector<boost::thread> readers;
+  for (size_t r = 0; r < 4; ++r) {
+    readers.emplace_back([&]() {
+      while (!done.load()) {
+        for (uint32_t x = 0; x < kStable; ++x) {
+          auto it = map.find(x);
+          ASSERT_NE(map.end(), it);
+          ASSERT_EQ(x, it->first);
+          ASSERT_EQ(x * 2, it->second);
+          ASSERT_EQ(x * 2, map.at(x));
+          ASSERT_EQ(x * 2, map.get(x, 0));
+        }
+      }
+    });
+  }
+  for (auto& writer : writers) {
+    writer.join();
+  }
+  done.store(true);
+  for (auto& reader : readers) {
+    reader.join();
+  }
+
+  size_t expected = kStable;
+  for (uint32_t x = kStable; x < kStable + kGrowth; ++x) {
+    expected += x % 3 != 0;
+  }
+  EXPECT_EQ(expected, map.size());
+  for (const auto& p : map) {
+    EXPECT_EQ(p.first * 2, p.second);
+  }
+}
@@ -5,13 +5,17 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <algorithm>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
 #include "ControlFlow.h"
 #include "DexAsm.h"
+#include "Dominators.h"
 #include "IRAssembler.h"
 #include "IRCode.h"
+#include "LiveRange.h"
+#include "MonotonicFixpointIterator.h"
 #include "RedexTest.h"
 
 namespace cfg {
@@ -1110,6 +1114,53 @@ TEST_F(ControlFlowTest, deep_copy_into_existing_cfg) {
   EXPECT_CODE_EQ(code.get(), copy_code.get());
 }
 
+TEST_F(ControlFlowTest, snapshot_and_restore) {
+  const std::string body = R"(
+    (
+      (load-param v0)
+      (.pos:dbg_0 "LFoo;.m:(I)V" "Foo.java" 1)
+      (.pos "LFoo;.n:()V" "Foo.java" 10 dbg_0)
+      (switch v0 (:a :b))
+
+      (:exit)
+      (return-void)
+
+      (:a 0)
+      (.try_start foo)
+      (invoke-static (v0) "LCls;.foo:(I)I")
+      (move-result v1)
+      (.try_end foo)
+      (goto :exit)
+
+      (:b 1)
+      (const v1 1)
+      (goto :exit)
+
+      (.catch (foo))
+      (const v1 2)
+      (goto :exit)
+    )
+  )";
+  auto code = assembler::ircode_from_string(body);
+  code->build_cfg(/* editable */ true);
+  auto& cfg = code->cfg();
+  auto snapshot = cfg.snapshot();
+
+  delete_if(cfg, [](IROpcode op) { return op == OPCODE_SWITCH; });
+  for (auto& mie : cfg::InstructionIterable(cfg)) {
+    if (mie.insn->opcode() == OPCODE_RETURN_VOID) {
+      mie.insn->set_opcode(OPCODE_NOP);
+    }
+  }
+  cfg.restore(std::move(snapshot));
+  code->clear_cfg();
+
+  auto expected = assembler::ircode_from_string(body);
+  expected->build_cfg(/* editable */ true);
+  expected->clear_cfg();
+  EXPECT_CODE_EQ(expected.get(), code.get());
+}
+
 TEST_F(ControlFlowTest, line_numbers) {
 
   DexMethod* m = DexMethod::make_method("LFoo;.m:()V")
@@ -1157,6 +1208,35 @@ TEST_F(ControlFlowTest, line_numbers) {
   EXPECT_CODE_EQ(expected.get(), code.get());
 }
 
+TEST_F(ControlFlowTest, superseded_positions) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (.pos:dbg_0 "LFoo;.m:()V" "Foo.java" 1)
+      (.pos:dbg_1 "LFoo;.n:()V" "Foo.java" 10 dbg_0)
+      (.pos "LFoo;.n:()V" "Foo.java" 11 dbg_0)
+      (const v0 0)
+      (.pos "LFoo;.m:()V" "Foo.java" 2)
+      (.pos "LFoo;.m:()V" "Foo.java" 3)
+      (return-void)
+    )
+  )");
+
+  code->build_cfg(/* editable */ true);
+  code->clear_cfg();
+
+  // dbg_0 stays as it is the parent of other positions.
+  auto expected = assembler::ircode_from_string(R"(
+    (
+      (.pos:dbg_0 "LFoo;.m:()V" "Foo.java" 1)
+      (.pos "LFoo;.n:()V" "Foo.java" 11 dbg_0)
+      (const v0 0)
+      (.pos "LFoo;.m:()V" "Foo.java" 3)
+      (return-void)
+    )
+  )");
+  EXPECT_CODE_EQ(expected.get(), code.get());
+}
+
 TEST_F(ControlFlowTest, simple_push_back) {
   ControlFlowGraph cfg{};
   Block* entry = cfg.create_block();
@@ -2215,3 +2295,150 @@ TEST_F(ControlFlowTest, get_param_instructions_empty) {
 
   EXPECT_TRUE(cfg.get_param_instructions().empty());
 }
+
+TEST_F(ControlFlowTest, cached_dominators) {
+  ControlFlowGraph cfg;
+  auto b0 = cfg.create_block();
+  auto b1 = cfg.create_block();
+  auto b2 = cfg.create_block();
+  auto b3 = cfg.create_block();
+  cfg.set_entry_block(b0);
+  cfg.add_edge(b0, b1, EDGE_GOTO);
+  cfg.add_edge(b0, b2, EDGE_BRANCH);
+  cfg.add_edge(b1, b3, EDGE_GOTO);
+  cfg.add_edge(b2, b3, EDGE_GOTO);
+
+  const auto& doms = cfg.get_dominators();
+  EXPECT_EQ(doms.get_idom(b3), b0);
+  EXPECT_EQ(&cfg.get_dominators(), &doms);
+
+  const auto& post_doms = cfg.get_post_dominators();
+  EXPECT_EQ(cfg.exit_block(), b3);
+  EXPECT_EQ(post_doms.get_idom(b0), b3);
+  EXPECT_EQ(post_doms.get_idom(b1), b3);
+
+  // Once the exit block is known, recomputing it keeps the cached results.
+  cfg.get_dominators();
+  cfg.calculate_exit_block();
+  EXPECT_TRUE(cfg.has_analysis<Dominators>());
+  EXPECT_TRUE(cfg.has_analysis<PostDominators>());
+  EXPECT_EQ(&cfg.get_post_dominators(), &post_doms);
+
+  // Rewiring the edges drops the cached results.
+  cfg.delete_edges_between(b0, b2);
+  cfg.add_edge(b1, b2, EDGE_BRANCH);
+  EXPECT_FALSE(cfg.has_analysis<Dominators>());
+  EXPECT_FALSE(cfg.has_analysis<PostDominators>());
+  EXPECT_EQ(cfg.get_dominators().get_idom(b2), b1);
+  EXPECT_EQ(cfg.get_dominators().get_idom(b3), b1);
+  EXPECT_EQ(cfg.get_post_dominators().get_idom(b0), b1);
+}
+
+TEST_F(ControlFlowTest, cached_dominators_ghost_exit) {
+  ControlFlowGraph cfg;
+  auto b0 = cfg.create_block();
+  auto b1 = cfg.create_block();
+  auto b2 = cfg.create_block();
+  cfg.set_entry_block(b0);
+  cfg.add_edge(b0, b1, EDGE_GOTO);
+  cfg.add_edge(b0, b2, EDGE_BRANCH);
+
+  // Two exits are joined by a ghost exit block.
+  cfg.get_post_dominators();
+  auto exit = cfg.exit_block();
+  EXPECT_NE(exit, b1);
+  EXPECT_NE(exit, b2);
+  cfg.get_dominators();
+  EXPECT_TRUE(cfg.has_analysis<PostDominators>());
+
+  // An unchanged ghost exit block is kept, along with the cached results.
+  cfg.calculate_exit_block();
+  EXPECT_EQ(cfg.exit_block(), exit);
+  EXPECT_TRUE(cfg.has_analysis<Dominators>());
+  EXPECT_TRUE(cfg.has_analysis<PostDominators>());
+
+  // A new exit replaces the ghost exit block.
+  auto b3 = cfg.create_block();
+  cfg.add_edge(b2, b3, EDGE_GOTO);
+  cfg.add_edge(b1, b3, EDGE_GOTO);
+  cfg.calculate_exit_block();
+  EXPECT_EQ(cfg.exit_block(), b3);
+  EXPECT_EQ(cfg.get_post_dominators().get_idom(b0), b3);
+}
+
+TEST_F(ControlFlowTest, cached_order) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (const v0 0)
+      (if-eqz v0 :true)
+
+      (const v1 1)
+      (return v1)
+
+      (:true)
+      (const v1 2)
+      (add-int v1 v1 v1)
+      (return v1)
+    )
+  )");
+  code->build_cfg(/* editable */ true);
+  auto& cfg = code->cfg();
+
+  auto order = cfg.order();
+  EXPECT_EQ(order.size(), 3);
+  EXPECT_EQ(order.front(), cfg.entry_block());
+  EXPECT_EQ(cfg.order(), order);
+
+  // Splitting a block changes the order.
+  Block* block = cfg.blocks().back();
+  Block* split = cfg.split_block(block->to_cfg_instruction_iterator(
+      *block->get_first_insn()));
+  order = cfg.order();
+  EXPECT_EQ(order.size(), 4);
+  EXPECT_NE(std::find(order.begin(), order.end(), split), order.end());
+  code->clear_cfg();
+}
+
+TEST_F(ControlFlowTest, cached_def_use_chains) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (const v0 1)
+      (move v1 v0)
+      (add-int v2 v1 v0)
+      (return v2)
+    )
+  )");
+  code->build_cfg(/* editable */ true);
+  auto& cfg = code->cfg();
+
+  const auto& chains = cfg.get_code_analysis<live_range::Chains>();
+  EXPECT_EQ(&cfg.get_code_analysis<live_range::Chains>(), &chains);
+  auto insns = cfg::InstructionIterable(cfg);
+  auto it = insns.begin();
+  auto const_insn = (it++)->insn;
+  auto move_insn = (it++)->insn;
+  auto add_it = it;
+  auto add_insn = add_it->insn;
+  EXPECT_THAT(chains.get_use_def_chains().at(live_range::Use{add_insn, 1}),
+              ::testing::ElementsAre(move_insn));
+  EXPECT_EQ(chains.get_def_use_chains().at(const_insn).size(), 2);
+
+  const auto& move_aware = cfg.get_code_analysis<live_range::MoveAwareChains>();
+  EXPECT_THAT(move_aware.get_use_def_chains().at(live_range::Use{add_insn, 1}),
+              ::testing::ElementsAre(const_insn));
+
+  // Editing the instructions drops the cached chains, but not the dominators.
+  cfg.get_dominators();
+  auto new_const = dasm(OPCODE_CONST, {0_v, 2_L});
+  cfg.insert_before(add_it, new_const);
+  EXPECT_FALSE(cfg.has_code_analysis<live_range::Chains>());
+  EXPECT_TRUE(cfg.has_analysis<Dominators>());
+  EXPECT_THAT(cfg.get_code_analysis<live_range::Chains>()
+                  .get_use_def_chains()
+                  .at(live_range::Use{add_insn, 0}),
+              ::testing::ElementsAre(new_const));
+
+  cfg.code_changed();
+  EXPECT_FALSE(cfg.has_code_analysis<live_range::Chains>());
+  code->clear_cfg();
+}
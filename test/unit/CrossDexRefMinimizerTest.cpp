@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "CrossDexRefMinimizer.h"
+#include "RedexTest.h"
+#include "ScopeHelper.h"
+
+using namespace interdex;
+
+struct CrossDexRefMinimizerTest : public RedexTest {
+  CrossDexRefMinimizerConfig config{/* method_ref_weight */ 100,
+                                    /* field_ref_weight */ 90,
+                                    /* type_ref_weight */ 100,
+                                    /* string_ref_weight */ 90,
+                                    /* method_seed_weight */ 100,
+                                    /* field_seed_weight */ 20,
+                                    /* type_seed_weight */ 30,
+                                    /* string_seed_weight */ 20};
+
+  // Classes C0 ... Cn-1, where Ci and Ci+n/2 implement the same interface,
+  // which no other class implements.
+  std::vector<DexClass*> make_paired_classes(size_t n) {
+    std::vector<DexClass*> classes;
+    for (size_t i = 0; i < n; ++i) {
+      auto intf = DexType::make_type(
+          DexString::make_string("LI" + std::to_string(i % (n / 2)) + ";"));
+      auto type = DexType::make_type(
+          DexString::make_string("LC" + std::to_string(i) + ";"));
+      classes.push_back(
+          create_internal_class(type, type::java_lang_Object(), {intf}));
+    }
+    return classes;
+  }
+
+  std::vector<DexClass*> drain(CrossDexRefMinimizer& minimizer) {
+    std::vector<DexClass*> order;
+    while (!minimizer.empty()) {
+      auto cls = minimizer.front();
+      minimizer.erase(cls, /* emitted */ true, /* reset */ order.empty());
+      order.push_back(cls);
+    }
+    return order;
+  }
+};
+
+TEST_F(CrossDexRefMinimizerTest, classesSharingRefsAreAdjacent) {
+  auto classes = make_paired_classes(16);
+  CrossDexRefMinimizer minimizer(config);
+  for (auto cls : classes) {
+    minimizer.sample(cls);
+  }
+  for (auto cls : classes) {
+    minimizer.insert(cls);
+  }
+  auto order = drain(minimizer);
+  ASSERT_EQ(16, order.size());
+  for (size_t i = 0; i < 8; ++i) {
+    EXPECT_EQ(classes[i], order[2 * i]);
+    EXPECT_EQ(classes[i + 8], order[2 * i + 1]);
+  }
+  EXPECT_EQ(16, minimizer.stats().classes);
+  EXPECT_EQ(1, minimizer.stats().resets);
+}
+
+TEST_F(CrossDexRefMinimizerTest, resetForgetsAppliedRefs) {
+  auto classes = make_paired_classes(16);
+  CrossDexRefMinimizer minimizer(config);
+  for (auto cls : classes) {
+    minimizer.sample(cls);
+  }
+  for (auto cls : classes) {
+    minimizer.insert(cls);
+  }
+  EXPECT_EQ(classes[0], minimizer.front());
+  minimizer.erase(classes[0], /* emitted */ true, /* reset */ true);
+  EXPECT_EQ(classes[8], minimizer.front());
+  // Starting a new dex with C1 makes the refs of C0 irrelevant to C8.
+  minimizer.erase(classes[1], /* emitted */ true, /* reset */ true);
+  EXPECT_EQ(classes[9], minimizer.front());
+  minimizer.erase(classes[9], /* emitted */ true, /* reset */ false);
+  EXPECT_EQ(classes[2], minimizer.front());
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "DenseIndex.h"
+#include "DexClass.h"
+#include "RedexTest.h"
+#include "WorkQueue.h"
+
+using namespace dense_index;
+
+struct DenseIndexTest : public RedexTest {};
+
+TEST_F(DenseIndexTest, entitiesMapBackFromIndices) {
+  auto foo = DexType::make_type("LFoo;");
+  auto bar = DexType::make_type("LBar;");
+  EXPECT_NE(foo->index(), bar->index());
+  EXPECT_EQ(foo, DexType::make_type("LFoo;"));
+  EXPECT_EQ(foo, g_redex->type_at(foo->index()));
+  EXPECT_EQ(bar, g_redex->type_at(bar->index()));
+  EXPECT_LT(bar->index(), g_redex->num_type_indices());
+
+  auto method = DexMethod::make_method("LFoo;.m:()V");
+  auto field = DexField::make_field("LFoo;.f:I");
+  EXPECT_EQ(method, g_redex->method_at(method->index()));
+  EXPECT_EQ(field, g_redex->field_at(field->index()));
+  EXPECT_EQ(nullptr, g_redex->method_at(g_redex->num_method_indices()));
+}
+
+TEST_F(DenseIndexTest, indexedBitSet) {
+  auto foo = DexType::make_type("LFoo;");
+  auto bar = DexType::make_type("LBar;");
+  IndexedBitSet<DexType> set;
+  EXPECT_FALSE(set.contains(foo));
+  EXPECT_TRUE(set.insert(foo));
+  EXPECT_FALSE(set.insert(foo));
+  EXPECT_TRUE(set.contains(foo));
+  EXPECT_FALSE(set.contains(bar));
+  EXPECT_EQ(1, set.size());
+
+  IndexedVector<DexType, int> vector;
+  vector[bar] = 42;
+  EXPECT_EQ(42, vector.get(bar, 0));
+  EXPECT_EQ(-1, vector.get(foo, -1));
+}
+
+TEST_F(DenseIndexTest, concurrentIndexedBitSet) {
+  std::vector<DexType*> types;
+  for (size_t i = 0; i < 1000; ++i) {
+    auto name = "LFoo" + std::to_string(i) + ";";
+    types.push_back(DexType::make_type(name.c_str()));
+  }
+  ConcurrentIndexedBitSet<DexType> set;
+  std::atomic<size_t> inserted{0};
+  auto wq = workqueue_foreach<DexType*>([&](DexType* type) {
+    if (set.insert(type)) {
+      ++inserted;
+    }
+  });
+  // Insert each type several times; exactly one insertion wins.
+  for (size_t round = 0; round < 4; ++round) {
+    for (auto* type : types) {
+      wq.add_item(type);
+    }
+  }
+  wq.run_all();
+  EXPECT_EQ(types.size(), inserted);
+  EXPECT_EQ(types.size(), set.size());
+  for (auto* type : types) {
+    EXPECT_TRUE(set.contains(type));
+  }
+  EXPECT_FALSE(set.contains(DexType::make_type("LBar;")));
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <chrono>
+#include <gtest/gtest.h>
+#include <sstream>
+
+#include "DenseLiveness.h"
+#include "IRAssembler.h"
+#include "IRCode.h"
+#include "Liveness.h"
+#include "RedexTest.h"
+
+struct DenseLivenessTest : public RedexTest {
+  // Check that both engines agree on every block of :code.
+  static void check_same_as_sparta(IRCode* code) {
+    code->build_cfg(/* editable */ false);
+    auto& cfg = code->cfg();
+    cfg.calculate_exit_block();
+    LivenessFixpointIterator sparta_liveness(cfg);
+    sparta_liveness.run(LivenessDomain());
+    DenseLiveness dense_liveness(cfg);
+    for (auto* block : cfg.blocks()) {
+      EXPECT_EQ(
+          sparta_liveness.get_live_in_vars_at(block),
+          DenseLiveness::to_domain(dense_liveness.get_live_in_vars_at(block)))
+          << "B" << block->id();
+      EXPECT_EQ(
+          sparta_liveness.get_live_out_vars_at(block),
+          DenseLiveness::to_domain(dense_liveness.get_live_out_vars_at(block)))
+          << "B" << block->id();
+    }
+  }
+
+  // A loop with :num_regs registers and a chain of :num_branches diamonds,
+  // each of which reads and writes a few of them.
+  static std::unique_ptr<IRCode> make_code(size_t num_regs,
+                                           size_t num_branches) {
+    std::ostringstream ss;
+    ss << "((load-param v0)\n";
+    for (size_t r = 1; r < num_regs; ++r) {
+      ss << "(const v" << r << " " << r << ")\n";
+    }
+    ss << "(:loop)\n";
+    for (size_t b = 0; b < num_branches; ++b) {
+      auto a = 1 + (b * 7) % (num_regs - 1);
+      auto c = 1 + (b * 13) % (num_regs - 1);
+      ss << "(if-eqz v" << a << " :else" << b << ")\n"
+         << "(add-int v" << c << " v" << a << " v0)\n"
+         << "(goto :join" << b << ")\n"
+         << "(:else" << b << ")\n"
+         << "(const v" << a << " 0)\n"
+         << "(:join" << b << ")\n";
+    }
+    ss << "(if-nez v0 :loop)\n"
+       << "(return v1))";
+    return assembler::ircode_from_string(ss.str());
+  }
+};
+
+TEST_F(DenseLivenessTest, straightLine) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (load-param v0)
+      (const v1 1)
+      (add-int v2 v0 v1)
+      (const v1 2)
+      (return v2)
+    )
+  )");
+  check_same_as_sparta(code.get());
+}
+
+TEST_F(DenseLivenessTest, branchesAndLoops) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (load-param v0)
+      (const v1 0)
+      (const v2 0)
+      (:loop)
+      (if-eqz v0 :end)
+      (add-int v2 v2 v1)
+      (if-eqz v2 :skip)
+      (const v3 1)
+      (add-int v1 v1 v3)
+      (:skip)
+      (goto :loop)
+      (:end)
+      (return v2)
+    )
+  )");
+  check_same_as_sparta(code.get());
+}
+
+TEST_F(DenseLivenessTest, manyRegisters) {
+  // More registers than fit in one word.
+  check_same_as_sparta(make_code(200, 50).get());
+}
+
+// Not run by default; compares the two engines on a large method:
+//   --gtest_also_run_disabled_tests --gtest_filter=*Benchmark*
+TEST_F(DenseLivenessTest, DISABLED_Benchmark) {
+  auto code = make_code(256, 2000);
+  code->build_cfg(/* editable */ false);
+  auto& cfg = code->cfg();
+  cfg.calculate_exit_block();
+
+  const size_t iterations = 10;
+  using Clock = std::chrono::steady_clock;
+  auto start = Clock::now();
+  for (size_t i = 0; i < iterations; ++i) {
+    LivenessFixpointIterator sparta_liveness(cfg);
+    sparta_liveness.run(LivenessDomain());
+  }
+  auto sparta_time = Clock::now() - start;
+  start = Clock::now();
+  for (size_t i = 0; i < iterations; ++i) {
+    DenseLiveness dense_liveness(cfg);
+  }
+  auto dense_time = Clock::now() - start;
+
+  using Millis = std::chrono::duration<double, std::milli>;
+  std::cout << "sparta: " << Millis(sparta_time).count() / iterations
+            << " ms, dense: " << Millis(dense_time).count() / iterations
+            << " ms per run over " << cfg.blocks().size() << " blocks"
+            << std::endl;
+}
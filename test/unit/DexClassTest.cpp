@@ -66,3 +66,47 @@ TEST_F(DexClassTest, testUniqueTypeName) {
   EXPECT_EQ(foor1_type->str(), "LFoor$1;");
   EXPECT_EQ(foor0r0_type->str(), "LFoor$0r$0;");
 }
+
+TEST_F(DexClassTest, deferredBalloon) {
+  auto method = assembler::method_from_string(R"(
+    (method (public static) "LFoo;.bar:()Ljava/lang/String;"
+     (
+      (const-string "hello")
+      (move-result-pseudo-object v0)
+      (return-object v0)
+     )
+    )
+  )");
+  method->sync();
+  method->defer_balloon();
+  EXPECT_TRUE(method->is_balloon_pending());
+
+  // Gathering looks at the DexCode and leaves the method unballooned.
+  std::vector<DexString*> strings;
+  method->gather_strings(strings);
+  EXPECT_NE(std::find(strings.begin(), strings.end(),
+                      DexString::make_string("hello")),
+            strings.end());
+  EXPECT_TRUE(method->is_balloon_pending());
+
+  // Syncing a method nobody looked at keeps its DexCode as is.
+  auto* dex_code = method->get_dex_code();
+  method->sync();
+  EXPECT_FALSE(method->is_balloon_pending());
+  EXPECT_EQ(dex_code, method->get_dex_code());
+
+  method->defer_balloon();
+  auto* code = method->get_code();
+  ASSERT_NE(code, nullptr);
+  EXPECT_FALSE(method->is_balloon_pending());
+  EXPECT_EQ(method->get_dex_code(), nullptr);
+  EXPECT_EQ(assembler::to_s_expr(code),
+            assembler::to_s_expr(assembler::ircode_from_string(R"(
+              (
+               (const-string "hello")
+               (move-result-pseudo-object v0)
+               (return-object v0)
+              )
+            )")
+                                     .get()));
+}
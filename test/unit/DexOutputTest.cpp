@@ -6,9 +6,14 @@
  */
 
 #include "DexOutput.h"
+#include <boost/filesystem.hpp>
+#include <fstream>
 #include <gtest/gtest.h>
 #include <json/json.h>
 
+#include "RedexTest.h"
+#include "ScopeHelper.h"
+
 TEST(DexOutput, checkMethodInstructionSizeLimit) {
 
   Json::Value json_cfg;
@@ -24,3 +29,73 @@ TEST(DexOutput, checkMethodInstructionSizeLimit) {
       DexOutput::check_method_instruction_size_limit(conf, 65537, "method"),
       RedexException);
 }
+
+struct DexOutputLayoutTest : public RedexTest {};
+
+TEST_F(DexOutputLayoutTest, coldstartPhaseOrder) {
+  auto obj_t = type::java_lang_Object();
+  auto void_void =
+      DexProto::make_proto(type::_void(), DexTypeList::make_type_list({}));
+  auto a = create_internal_class(DexType::make_type("LA;"), obj_t, {});
+  auto b = create_internal_class(DexType::make_type("LB;"), obj_t, {});
+  auto c = create_internal_class(DexType::make_type("LC;"), obj_t, {});
+  auto d = create_internal_class(DexType::make_type("LD;"), obj_t, {});
+  auto a_m = create_empty_method(a, "m", void_void);
+  auto b_m = create_empty_method(b, "m", void_void);
+  auto c_m = create_empty_method(c, "m", void_void);
+  auto d_m = create_empty_method(d, "m", void_void);
+
+  auto path = boost::filesystem::temp_directory_path() /
+              boost::filesystem::unique_path();
+  {
+    std::ofstream ofs(path.string());
+    ofs << "C.class\nDexEndMarker0.class\nA.class\nB.class\n";
+  }
+  Json::Value json_cfg;
+  json_cfg["coldstart_classes"] = path.string();
+  ConfigFiles conf(json_cfg);
+
+  DexClasses classes{d, a, b, c};
+  ColdStartLayout layout(classes, conf, /* use_method_profiles */ false);
+  EXPECT_EQ(2, layout.num_phases);
+  EXPECT_EQ(0, layout.get_phase(c));
+  EXPECT_EQ(1, layout.get_phase(a));
+  EXPECT_EQ(1, layout.get_phase(b));
+  EXPECT_EQ(2, layout.get_phase(d));
+  EXPECT_EQ(ColdStartLayout::kUnprofiledBucket, layout.get_bucket(a_m));
+
+  GatheredTypes gtypes(&classes);
+  std::vector<DexMethod*> methods{d_m, b_m, a_m, c_m};
+  gtypes.sort_dexmethod_emitlist_coldstart_phase_order(methods, layout);
+  EXPECT_EQ((std::vector<DexMethod*>{c_m, b_m, a_m, d_m}), methods);
+  boost::filesystem::remove(path);
+}
+
+TEST_F(DexOutputLayoutTest, methodInteractionOrder) {
+  auto obj_t = type::java_lang_Object();
+  auto void_void =
+      DexProto::make_proto(type::_void(), DexTypeList::make_type_list({}));
+  auto a = create_internal_class(DexType::make_type("LA;"), obj_t, {});
+  auto a_m = create_empty_method(a, "m", void_void);
+  auto a_n = create_empty_method(a, "n", void_void);
+  auto a_o = create_empty_method(a, "o", void_void);
+  auto a_p = create_empty_method(a, "p", void_void);
+
+  method_profiles::Stats ran_late;
+  ran_late.appear_percent = 50;
+  ran_late.order_percent = 80;
+  method_profiles::Stats ran_early;
+  ran_early.appear_percent = 100;
+  ran_early.order_percent = 10;
+  method_profiles::Stats never_ran;
+  auto profiles = method_profiles::MethodProfiles::initialize(
+      method_profiles::COLD_START,
+      {{a_n, ran_late}, {a_o, ran_early}, {a_p, never_ran}});
+
+  DexClasses classes{a};
+  GatheredTypes gtypes(&classes);
+  std::vector<DexMethod*> methods{a_m, a_n, a_o, a_p};
+  gtypes.sort_dexmethod_emitlist_interaction_order(
+      methods, profiles, {method_profiles::COLD_START, "Scroll"});
+  EXPECT_EQ((std::vector<DexMethod*>{a_o, a_n, a_m, a_p}), methods);
+}
@@ -6,7 +6,9 @@
  */
 
 #include "DexUtil.h"
+#include "IRAssembler.h"
 #include "RedexTest.h"
+#include "ScopeHelper.h"
 #include <gtest/gtest.h>
 
 class DexUtilTest : public RedexTest {};
@@ -83,3 +85,35 @@ TEST_F(DexUtilTest, is_valid_identifier_range) {
   mod[mod.length() / 2] = ';';
   EXPECT_FALSE(is_valid_identifier(mod, 2, mod.length() - 4));
 }
+
+TEST_F(DexUtilTest, get_visibility_changes) {
+  auto foo_type = DexType::make_type("LFoo;");
+  auto foo = create_internal_class(foo_type, type::java_lang_Object(), {});
+  foo->set_access(ACC_PRIVATE);
+  auto bar = DexMethod::make_method("LFoo;.bar:()V")
+                 ->make_concrete(ACC_PRIVATE | ACC_STATIC, false);
+  bar->set_code(assembler::ircode_from_string("((return-void))"));
+  foo->add_method(bar);
+
+  auto caller = DexMethod::make_method("LBaz;.caller:()V")
+                    ->make_concrete(ACC_PUBLIC | ACC_STATIC, false);
+  caller->set_code(assembler::ircode_from_string(R"(
+    (
+      (invoke-static () "LFoo;.bar:()V")
+      (return-void)
+    )
+  )"));
+
+  auto changes = get_visibility_changes(caller->get_code(), nullptr, caller);
+  EXPECT_FALSE(changes.empty());
+  // Nothing is made public until the changes are applied.
+  EXPECT_FALSE(is_public(foo));
+  EXPECT_FALSE(is_public(bar));
+
+  VisibilityChanges merged;
+  merged += changes;
+  merged += get_visibility_changes(caller->get_code(), nullptr, caller);
+  merged.apply();
+  EXPECT_TRUE(is_public(foo));
+  EXPECT_TRUE(is_public(bar));
+}
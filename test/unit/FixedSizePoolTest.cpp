@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "FixedSizePool.h"
+
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <unordered_set>
+#include <vector>
+
+#include <boost/thread/thread.hpp>
+
+namespace {
+
+struct alignas(8) Node {
+  uint64_t payload[3];
+};
+
+using Pool = FixedSizePool<sizeof(Node), alignof(Node)>;
+
+} // namespace
+
+// These check the pool's layout, which is bypassed under AddressSanitizer.
+#ifndef REDEX_FIXED_SIZE_POOL_PASSTHROUGH
+TEST(FixedSizePoolTest, sequentialAllocationsAreAdjacent) {
+  std::vector<void*> blocks;
+  for (size_t i = 0; i < 16; ++i) {
+    blocks.push_back(Pool::allocate());
+  }
+  size_t adjacent = 0;
+  for (size_t i = 1; i < blocks.size(); ++i) {
+    auto* prev = static_cast<char*>(blocks[i - 1]);
+    if (static_cast<char*>(blocks[i]) == prev + sizeof(Node)) {
+      ++adjacent;
+    }
+  }
+  // At most one slab boundary can interrupt the run.
+  EXPECT_GE(adjacent, blocks.size() - 2);
+  for (auto* block : blocks) {
+    EXPECT_EQ(0, reinterpret_cast<uintptr_t>(block) % alignof(Node));
+    Pool::deallocate(block);
+  }
+}
+
+TEST(FixedSizePoolTest, freedBlocksAreReused) {
+  void* block = Pool::allocate();
+  Pool::deallocate(block);
+  void* again = Pool::allocate();
+  EXPECT_EQ(block, again);
+  Pool::deallocate(again);
+}
+#endif
+
+TEST(FixedSizePoolTest, crossThreadFrees) {
+  constexpr size_t kThreads = 8;
+  constexpr size_t kPerThread = 20000;
+  std::vector<std::vector<Node*>> allocated(kThreads);
+  std::vector<boost::thread> threads;
+  for (size_t t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&, t]() {
+      for (size_t i = 0; i < kPerThread; ++i) {
+        auto* node = static_cast<Node*>(Pool::allocate());
+        node->payload[0] = t;
+        node->payload[1] = i;
+        allocated[t].push_back(node);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  std::unordered_set<Node*> distinct;
+  for (size_t t = 0; t < kThreads; ++t) {
+    for (size_t i = 0; i < kPerThread; ++i) {
+      auto* node = allocated[t][i];
+      EXPECT_EQ(t, node->payload[0]);
+      EXPECT_EQ(i, node->payload[1]);
+      distinct.insert(node);
+    }
+  }
+  EXPECT_EQ(kThreads * kPerThread, distinct.size());
+
+  // Free everything from threads other than the allocating ones; the blocks
+  // end up on the shared list when those threads exit, and get reused.
+  threads.clear();
+  for (size_t t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&, t]() {
+      for (auto* node : allocated[(t + 1) % kThreads]) {
+        Pool::deallocate(node);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+#ifndef REDEX_FIXED_SIZE_POOL_PASSTHROUGH
+  boost::thread([&]() {
+    for (size_t i = 0; i < 100; ++i) {
+      EXPECT_EQ(1, distinct.count(static_cast<Node*>(Pool::allocate())));
+    }
+  }).join();
+#endif
+}
@@ -151,3 +151,30 @@ TEST_F(IRCodeTest, try_region) {
   EXPECT_EQ(split, second->m_start_addr);
   EXPECT_EQ(num * op->size() - split, second->m_insn_count);
 }
+
+TEST_F(IRCodeTest, retainEditableCfgs) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (const v0 0)
+      (if-eqz v0 :l)
+      (const v0 1)
+      (:l)
+      (return v0)
+    )
+  )");
+  auto expected = assembler::to_s_expr(code.get());
+
+  IRCode::set_retain_editable_cfgs(true);
+  code->build_cfg(/* editable */ true);
+  auto* cfg = &code->cfg();
+  code->clear_cfg();
+  EXPECT_TRUE(code->editable_cfg_built());
+  // A retained CFG is reused rather than rebuilt.
+  code->build_cfg(/* editable */ true);
+  EXPECT_EQ(cfg, &code->cfg());
+  code->force_clear_cfg();
+  EXPECT_FALSE(code->cfg_built());
+  IRCode::set_retain_editable_cfgs(false);
+
+  EXPECT_EQ(assembler::to_s_expr(code.get()), expected);
+}
@@ -395,3 +395,30 @@ TEST_F(IRInstructionTest, InvokeSourceIsWideComplex2) {
   EXPECT_FALSE(insn->invoke_src_is_wide(3));
   EXPECT_TRUE(insn->invoke_src_is_wide(4));
 }
+
+TEST_F(IRInstructionTest, SrcsStorageTransitions) {
+  IRInstruction insn(OPCODE_INVOKE_STATIC);
+  insn.set_srcs_size(2);
+  insn.set_src(0, 5);
+  insn.set_src(1, 6);
+
+  // Growing spills the inline registers and zero-fills the rest.
+  insn.set_srcs_size(8);
+  EXPECT_EQ(insn.srcs_vec(), std::vector<reg_t>({5, 6, 0, 0, 0, 0, 0, 0}));
+  insn.set_src(7, 9);
+  insn.set_srcs_size(20);
+  EXPECT_EQ(insn.srcs_size(), 20);
+  EXPECT_EQ(insn.src(7), 9);
+  EXPECT_EQ(insn.src(19), 0);
+
+  IRInstruction copy(insn);
+  EXPECT_EQ(copy, insn);
+  copy.set_src(19, 1);
+  EXPECT_NE(copy, insn);
+
+  // Shrinking keeps the leading registers, whether spilled or inline.
+  insn.set_srcs_size(3);
+  EXPECT_EQ(insn.srcs_vec(), std::vector<reg_t>({5, 6, 0}));
+  insn.set_srcs_size(1);
+  EXPECT_EQ(insn.srcs_vec(), std::vector<reg_t>({5}));
+}
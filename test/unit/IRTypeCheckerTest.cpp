@@ -515,6 +515,38 @@ TEST_F(IRTypeCheckerTest, exceptionHandler) {
   EXPECT_EQ(REFERENCE, checker.get_type(exc_return, 14));
 }
 
+TEST_F(IRTypeCheckerTest, cacheNoticesChanges) {
+  using namespace dex_asm;
+  auto ret = dasm(OPCODE_RETURN, {9_v});
+  add_code({ret});
+
+  Scope scope;
+  IRTypeCheckerCache cache;
+  cache.prepare(scope);
+  auto state = IRTypeCheckerCache::get_state(m_method, false, false);
+  EXPECT_FALSE(cache.is_verified(m_method, state));
+  cache.set_verified(m_method, state);
+  EXPECT_TRUE(cache.is_verified(
+      m_method, IRTypeCheckerCache::get_state(m_method, false, false)));
+  EXPECT_FALSE(cache.is_verified(
+      m_method, IRTypeCheckerCache::get_state(m_method, true, false)));
+
+  // Renaming a register changes the code.
+  ret->set_src(0, 5);
+  EXPECT_FALSE(cache.is_verified(
+      m_method, IRTypeCheckerCache::get_state(m_method, false, false)));
+  ret->set_src(0, 9);
+  EXPECT_TRUE(cache.is_verified(
+      m_method, IRTypeCheckerCache::get_state(m_method, false, false)));
+
+  // So does the class structure of the scope.
+  cache.prepare(scope);
+  EXPECT_EQ(1, cache.size());
+  scope.push_back(type_class(type::java_lang_Object()));
+  cache.prepare(scope);
+  EXPECT_EQ(0, cache.size());
+}
+
 TEST_F(IRTypeCheckerTest, overlappingMoveWide) {
   using namespace dex_asm;
   std::vector<IRInstruction*> insns = {
@@ -1163,6 +1195,41 @@ TEST_F(IRTypeCheckerTest, checkNoOverwriteThis) {
   }
 }
 
+TEST_F(IRTypeCheckerTest, checkMonitors) {
+  auto method = DexMethod::make_method("LFoo;.baz:(LBar;)V")
+                    ->make_concrete(ACC_PUBLIC | ACC_STATIC, false);
+  method->set_code(assembler::ircode_from_string(R"(
+    (
+      (load-param-object v0)
+      (monitor-enter v0)
+
+      (.try_start a)
+      (check-cast v0 "LFoo;")
+      (move-result-pseudo-object v1)
+      (.try_end a)
+
+      (.catch (a) "LMyThrowable;")
+      (monitor-exit v0)
+      (return-void)
+    )
+  )"));
+  {
+    IRTypeChecker checker(method);
+    checker.run();
+    EXPECT_TRUE(checker.good()) << checker.what();
+  }
+  {
+    IRTypeChecker checker(method);
+    checker.check_monitors();
+    checker.run();
+    EXPECT_FALSE(checker.good());
+    EXPECT_EQ(checker.what().find("Encountered CHECK_CAST"), 0)
+        << checker.what();
+  }
+  EXPECT_FALSE(IRTypeCheckerCache::get_state(method, false, false, true) ==
+               IRTypeCheckerCache::get_state(method, false, false, false));
+}
+
 TEST_F(IRTypeCheckerTest, loadParamVirtualFail) {
   m_virtual_method->set_code(assembler::ircode_from_string(R"(
       (
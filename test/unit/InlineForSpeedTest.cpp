@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "IRAssembler.h"
+#include "InlineForSpeed.h"
+#include "RedexTest.h"
+
+using namespace method_profiles;
+
+using Edges = std::vector<InlineForSpeed::CallEdge>;
+
+struct InlineForSpeedTest : public RedexTest {
+  // A static method without arguments, made of :size opcodes.
+  DexMethod* make_callee(const std::string& name, size_t size) {
+    std::string body;
+    for (size_t i = 1; i < size; ++i) {
+      body += "(const v0 0)\n";
+    }
+    auto method = assembler::method_from_string(
+        "(method (public static) \"LCallee;." + name +
+        ":()V\" (\n" + body + "(return-void)\n))");
+    method->get_code()->build_cfg();
+    return method;
+  }
+
+  // Profiles in which :caller always appears, and each callee is called
+  // the given number of times.
+  static MethodProfiles make_profiles(
+      const DexMethod* caller,
+      const std::vector<std::pair<const DexMethod*, double>>& calls) {
+    StatsMap stats;
+    stats[caller] = Stats{100.0, 1.0, 0.0, 21};
+    for (const auto& p : calls) {
+      stats[p.first] = Stats{100.0, p.second, 0.0, 21};
+    }
+    return MethodProfiles::initialize(COLD_START, std::move(stats));
+  }
+
+  DexMethod* m_caller = assembler::method_from_string(R"(
+    (method (public static) "LCaller;.caller:()V"
+     (
+      (return-void)
+     )
+    )
+  )");
+};
+
+TEST_F(InlineForSpeedTest, emptyInput) {
+  auto callee = make_callee("a", 2);
+  auto profiles = make_profiles(m_caller, {{callee, 10}});
+  InlineForSpeed ifs(&profiles);
+  ifs.select_within_budget({}, 100);
+  EXPECT_EQ(0u, ifs.selected_call_sites());
+  // Once budgeted, only selected call sites are inlined.
+  EXPECT_FALSE(ifs.should_inline(m_caller, callee));
+}
+
+TEST_F(InlineForSpeedTest, budgetBoundary) {
+  auto hot = make_callee("hot", 6);
+  auto warm = make_callee("warm", 3);
+  auto cool = make_callee("cool", 1);
+  auto profiles = make_profiles(m_caller, {{hot, 30}, {warm, 20}, {cool, 10}});
+  Edges call_sites{{m_caller, hot}, {m_caller, warm}, {m_caller, cool}};
+
+  {
+    // Exactly enough for all of them.
+    InlineForSpeed ifs(&profiles);
+    ifs.select_within_budget(call_sites, 10);
+    EXPECT_EQ(3u, ifs.selected_call_sites());
+    EXPECT_TRUE(ifs.should_inline(m_caller, hot));
+    EXPECT_TRUE(ifs.should_inline(m_caller, warm));
+    EXPECT_TRUE(ifs.should_inline(m_caller, cool));
+  }
+  {
+    // One short.
+    InlineForSpeed ifs(&profiles);
+    ifs.select_within_budget(call_sites, 9);
+    EXPECT_EQ(2u, ifs.selected_call_sites());
+    EXPECT_TRUE(ifs.should_inline(m_caller, hot));
+    EXPECT_TRUE(ifs.should_inline(m_caller, warm));
+    EXPECT_FALSE(ifs.should_inline(m_caller, cool));
+  }
+  {
+    // warm no longer fits after hot, but the smaller cool still does.
+    InlineForSpeed ifs(&profiles);
+    ifs.select_within_budget(call_sites, 7);
+    EXPECT_EQ(2u, ifs.selected_call_sites());
+    EXPECT_TRUE(ifs.should_inline(m_caller, hot));
+    EXPECT_FALSE(ifs.should_inline(m_caller, warm));
+    EXPECT_TRUE(ifs.should_inline(m_caller, cool));
+  }
+  {
+    // Each call site of a callee counts against the budget.
+    InlineForSpeed ifs(&profiles);
+    ifs.select_within_budget({{m_caller, warm}, {m_caller, warm}}, 5);
+    EXPECT_EQ(0u, ifs.selected_call_sites());
+    EXPECT_FALSE(ifs.should_inline(m_caller, warm));
+  }
+}
+
+TEST_F(InlineForSpeedTest, ties) {
+  auto a = make_callee("a", 3);
+  auto b = make_callee("b", 3);
+  auto small = make_callee("small", 2);
+  auto profiles = make_profiles(m_caller, {{a, 10}, {b, 10}, {small, 10}});
+
+  // With equal scores, the smaller callee goes first.
+  for (const auto& call_sites :
+       std::vector<Edges>{{{m_caller, a}, {m_caller, small}},
+                          {{m_caller, small}, {m_caller, a}}}) {
+    InlineForSpeed ifs(&profiles);
+    ifs.select_within_budget(call_sites, 3);
+    EXPECT_TRUE(ifs.should_inline(m_caller, small));
+    EXPECT_FALSE(ifs.should_inline(m_caller, a));
+  }
+
+  // With equal scores and sizes, the choice doesn't depend on the order of
+  // the call sites.
+  for (const auto& call_sites :
+       std::vector<Edges>{{{m_caller, a}, {m_caller, b}},
+                          {{m_caller, b}, {m_caller, a}}}) {
+    InlineForSpeed ifs(&profiles);
+    ifs.select_within_budget(call_sites, 3);
+    EXPECT_EQ(1u, ifs.selected_call_sites());
+    EXPECT_TRUE(ifs.should_inline(m_caller, a));
+    EXPECT_FALSE(ifs.should_inline(m_caller, b));
+  }
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "IRAssembler.h"
+#include "InlinerCostCache.h"
+#include "RedexTest.h"
+
+struct InlinerCostCacheTest : public RedexTest {};
+
+TEST_F(InlinerCostCacheTest, entriesOfChangedCodeAreIgnored) {
+  auto method = assembler::method_from_string(R"(
+    (method (public static) "LFoo;.bar:(I)I"
+     (
+      (load-param v0)
+      (if-eqz v0 :zero)
+      (const v0 1)
+      (:zero)
+      (return v0)
+     )
+    )
+  )");
+  auto* code = method->get_code();
+  auto fingerprint = inliner::CostCache::fingerprint(code);
+  code->build_cfg(/* editable */ true);
+  auto cfg_fingerprint = inliner::CostCache::fingerprint(code);
+  EXPECT_EQ(cfg_fingerprint, inliner::CostCache::fingerprint(code));
+  code->clear_cfg();
+  EXPECT_EQ(fingerprint, inliner::CostCache::fingerprint(code));
+
+  inliner::CostCache cache;
+  EXPECT_FALSE(cache.get(method, fingerprint, ""));
+  cache.put(method, fingerprint, "", {5, 0});
+  cache.put(method, fingerprint, "0:1", {3, 1});
+  auto cost = cache.get(method, fingerprint, "");
+  ASSERT_TRUE(cost);
+  EXPECT_EQ(5, cost->cost);
+  cost = cache.get(method, fingerprint, "0:1");
+  ASSERT_TRUE(cost);
+  EXPECT_EQ(3, cost->cost);
+  EXPECT_EQ(1, cost->dead_blocks);
+  EXPECT_EQ(2, cache.hits());
+  EXPECT_EQ(1, cache.misses());
+
+  // Changed code has a different fingerprint.
+  method->set_code(assembler::ircode_from_string(R"(
+    (
+     (load-param v0)
+     (if-nez v0 :zero)
+     (const v0 1)
+     (:zero)
+     (return v0)
+    )
+  )"));
+  auto new_fingerprint = inliner::CostCache::fingerprint(method->get_code());
+  EXPECT_NE(fingerprint, new_fingerprint);
+  EXPECT_FALSE(cache.get(method, new_fingerprint, ""));
+  cache.put(method, new_fingerprint, "", {6, 0});
+  EXPECT_EQ(6, cache.get(method, new_fingerprint, "")->cost);
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "locator_index.h"
+
+using namespace facebook;
+
+TEST(LocatorIndexTest, findsEveryClass) {
+  std::vector<LocatorIndexEntry> entries;
+  for (uint32_t i = 0; i < 10000; i++) {
+    entries.push_back({"Lcom/foo/Class" + std::to_string(i) + ";",
+                       1 + i % 7, i / 7});
+  }
+  auto blob = build_locator_index(entries);
+  // A vector of words keeps the blob aligned.
+  std::vector<uint32_t> words((blob.size() + 3) / 4);
+  memcpy(words.data(), blob.data(), blob.size());
+  LocatorIndexView view(words.data(), blob.size());
+  ASSERT_TRUE(view.valid());
+
+  for (const auto& entry : entries) {
+    uint32_t dexnr, clsnr;
+    ASSERT_TRUE(view.find(entry.descriptor.c_str(), &dexnr, &clsnr));
+    EXPECT_EQ(entry.dexnr, dexnr);
+    EXPECT_EQ(entry.clsnr, clsnr);
+  }
+  uint32_t dexnr, clsnr;
+  EXPECT_FALSE(view.find("Lcom/foo/Missing;", &dexnr, &clsnr));
+  EXPECT_FALSE(view.find("Lcom/foo/Class1", &dexnr, &clsnr));
+}
+
+TEST(LocatorIndexTest, rejectsMalformedBlobs) {
+  std::vector<uint32_t> words(64, 0);
+  EXPECT_FALSE(LocatorIndexView(words.data(), words.size() * 4).valid());
+
+  auto blob = build_locator_index({});
+  memcpy(words.data(), blob.data(), blob.size());
+  LocatorIndexView empty(words.data(), blob.size());
+  ASSERT_TRUE(empty.valid());
+  uint32_t dexnr, clsnr;
+  EXPECT_FALSE(empty.find("LFoo;", &dexnr, &clsnr));
+  // Truncated
+  EXPECT_FALSE(LocatorIndexView(words.data(), blob.size() - 1).valid());
+
+  EXPECT_THROW(build_locator_index({{"LFoo;", 1, 0}, {"LFoo;", 2, 0}}),
+               std::runtime_error);
+}
@@ -164,3 +164,19 @@ TEST_F(MatchTest, SameMethodMatch) {
       match);
   EXPECT_EQ(match.size(), 1);
 }
+
+TEST_F(MatchTest, ContainsMatch) {
+  auto const_insn = std::make_unique<IRInstruction>(OPCODE_CONST);
+  const_insn->set_dest(0);
+  auto ret = std::make_unique<IRInstruction>(OPCODE_RETURN);
+  ret->set_src(0, 0);
+
+  std::vector<IRInstruction*> input{const_insn.get(), ret.get()};
+  auto const_then_return = std::make_tuple(m::is_opcode(OPCODE_CONST),
+                                           m::is_opcode(OPCODE_RETURN));
+  auto return_then_const = std::make_tuple(m::is_opcode(OPCODE_RETURN),
+                                           m::is_opcode(OPCODE_CONST));
+  EXPECT_TRUE(m::contains_match(input, const_then_return));
+  EXPECT_FALSE(m::contains_match(input, return_then_const));
+  EXPECT_FALSE(m::contains_match({const_insn.get()}, const_then_return));
+}
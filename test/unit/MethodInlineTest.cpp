@@ -335,6 +335,46 @@ TEST_F(MethodInlineTest, test_intra_dex_inlining) {
   }
 }
 
+TEST_F(MethodInlineTest, wave_scheduling) {
+  MethodRefCache resolve_cache;
+  auto resolver = [&resolve_cache](DexMethodRef* method, MethodSearch search) {
+    return resolve_method(method, search, resolve_cache);
+  };
+
+  DexStoresVector stores;
+  std::unordered_set<DexMethod*> candidates;
+  auto foo_cls = create_a_class("Lfoo;");
+  {
+    DexStore store("root");
+    store.add_classes({});
+    store.add_classes({foo_cls});
+    stores.push_back(std::move(store));
+  }
+  // foo_main calls foo_m2, which calls foo_m1.
+  auto foo_m1 = make_a_method(foo_cls, "foo_m1", 1);
+  auto foo_m2 = make_a_method_calls_others(foo_cls, "foo_m2", {foo_m1});
+  make_a_method_calls_others(foo_cls, "foo_main", {foo_m2});
+  candidates.insert(foo_m1);
+  candidates.insert(foo_m2);
+
+  auto scope = build_class_scope(stores);
+  api::LevelChecker::init(0, scope);
+  inliner::InlinerConfig inliner_config;
+  inliner_config.populate(scope);
+  inliner_config.wave_scheduling = true;
+  MultiMethodInliner inliner(
+      scope, stores, candidates, resolver, inliner_config, InterDex);
+  inliner.inline_methods();
+
+  auto inlined = inliner.get_inlined();
+  EXPECT_EQ(inlined.size(), 2);
+  EXPECT_EQ(inlined.count(foo_m1), 1);
+  EXPECT_EQ(inlined.count(foo_m2), 1);
+  // One wave per level of the call graph: foo_m1, then foo_m2, then foo_main.
+  EXPECT_EQ(inliner.get_info().wave_sizes, std::vector<size_t>({1, 1, 1}));
+  EXPECT_EQ(inliner.get_info().critical_path_length, 2);
+}
+
 TEST_F(MethodInlineTest, minimal_self_loop_regression) {
   MethodRefCache resolve_cache;
   auto resolver = [&resolve_cache](DexMethodRef* method, MethodSearch search) {
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Creators.h"
+#include "IRAssembler.h"
+#include "LocalDcePass.h"
+#include "PassManager.h"
+#include "RedexTest.h"
+#include "ReduceGotos.h"
+#include "UpCodeMotion.h"
+
+struct MethodLocalTransformTest : public RedexTest {
+  struct Result {
+    std::string code;
+    std::vector<std::unordered_map<std::string, int64_t>> metrics;
+  };
+
+  // Runs LocalDce, ReduceGotos and UpCodeMotion on a fresh copy of the code.
+  static Result run_passes(const std::string& class_name,
+                           const std::string& code,
+                           bool fused) {
+    ClassCreator creator(DexType::make_type(class_name.c_str()));
+    creator.set_super(type::java_lang_Object());
+    auto method = DexMethod::make_method(class_name + ".foo:(I)I")
+                      ->make_concrete(ACC_PUBLIC | ACC_STATIC, false);
+    method->set_code(assembler::ircode_from_string(code));
+    creator.add_method(method);
+
+    DexMetadata dm;
+    dm.set_id("classes");
+    DexStore store(dm);
+    store.add_classes({creator.create()});
+    std::vector<DexStore> stores;
+    stores.emplace_back(std::move(store));
+
+    Json::Value config;
+    config["hasher"]["run_after_each_pass"] = false;
+    config["fused_local_passes"] = fused;
+    ConfigFiles conf(config);
+    std::vector<Pass*> passes{new LocalDcePass(), new ReduceGotosPass(),
+                              new UpCodeMotionPass()};
+    PassManager manager(passes, config);
+    manager.set_testing_mode();
+    manager.run_passes(stores, conf);
+
+    Result result;
+    result.code = assembler::to_string(method->get_code());
+    for (const auto& info : manager.get_pass_info()) {
+      result.metrics.push_back(info.metrics);
+    }
+    return result;
+  }
+};
+
+TEST_F(MethodLocalTransformTest, fusedPassesMatchSeparatePasses) {
+  auto code = R"(
+    (
+      (load-param v0)
+      (const v1 0)
+      (if-eqz v0 :a)
+      (const v2 1)
+      (goto :b)
+      (:a)
+      (const v2 2)
+      (:b)
+      (return v2)
+    )
+  )";
+  auto separate = run_passes("LSeparate;", code, /* fused */ false);
+  auto fused = run_passes("LFused;", code, /* fused */ true);
+
+  EXPECT_EQ(separate.code, fused.code);
+  ASSERT_EQ(3, fused.metrics.size());
+  EXPECT_EQ(separate.metrics, fused.metrics);
+  EXPECT_EQ(1, fused.metrics[0].at("num_dead_instructions"));
+}
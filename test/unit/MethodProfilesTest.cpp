@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "MethodProfiles.h"
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <gtest/gtest.h>
+
+#include "RedexTest.h"
+
+using namespace method_profiles;
+
+struct MethodProfilesTest : public RedexTest {
+  void SetUp() override {
+    m_foo = DexMethod::make_method("LFoo;.foo:()V");
+    m_bar = DexMethod::make_method("LFoo;.bar:(I)V");
+    m_csv = write_temp_file(
+        "index,name,appear100,appear#,avg_call,avg_order,avg_rank100,"
+        "min_api_level,interaction\n"
+        "0,LFoo;.foo:()V,100.0,10,2.5,1.0,10.0,21,ColdStart\n"
+        "1,LFoo;.bar:(I)V,50.0,5,1.0,2.0,80.0,23,ColdStart\n"
+        "2,LFoo;.unknown:()V,50.0,5,1.0,2.0,80.0,23,ColdStart\n"
+        "3,LFoo;.bar:(I)V,25.0,5,4.0,2.0,30.0,28,Scroll\n"
+        "4,LFoo;.bar:(I)V,75.0,5,4.0,2.0,30.0,28,Scroll\n");
+  }
+
+  void TearDown() override {
+    for (const auto& path : m_paths) {
+      boost::filesystem::remove(path);
+    }
+  }
+
+  std::string write_temp_file(const std::string& contents) {
+    auto path = (boost::filesystem::temp_directory_path() /
+                 boost::filesystem::unique_path())
+                    .string();
+    std::ofstream ofs(path, std::ios::binary);
+    ofs << contents;
+    m_paths.push_back(path);
+    return path;
+  }
+
+  void check_profiles(const MethodProfiles& profiles) {
+    EXPECT_EQ(2, profiles.all_interactions().size());
+    EXPECT_EQ(2, profiles.method_stats(COLD_START).size());
+
+    auto foo = profiles.get_method_stat(COLD_START, m_foo);
+    ASSERT_TRUE(foo);
+    EXPECT_EQ(100.0, foo->appear_percent);
+    EXPECT_EQ(2.5, foo->call_count);
+    EXPECT_EQ(10.0, foo->order_percent);
+    EXPECT_EQ(21, foo->min_api_level);
+
+    // The first row of a method in an interaction wins.
+    auto bar = profiles.get_method_stat("Scroll", m_bar);
+    ASSERT_TRUE(bar);
+    EXPECT_EQ(25.0, bar->appear_percent);
+    EXPECT_EQ(28, bar->min_api_level);
+    EXPECT_FALSE(profiles.get_method_stat("Scroll", m_foo));
+  }
+
+  DexMethodRef* m_foo;
+  DexMethodRef* m_bar;
+  std::string m_csv;
+  std::vector<std::string> m_paths;
+};
+
+TEST_F(MethodProfilesTest, parseCsv) {
+  MethodProfiles profiles;
+  ASSERT_TRUE(profiles.initialize(m_csv));
+  check_profiles(profiles);
+}
+
+TEST_F(MethodProfilesTest, binaryRoundTrip) {
+  auto binary = write_temp_file("");
+  ASSERT_TRUE(MethodProfiles::convert_to_binary(m_csv, binary));
+  EXPECT_LT(boost::filesystem::file_size(binary),
+            boost::filesystem::file_size(m_csv));
+
+  MethodProfiles profiles;
+  ASSERT_TRUE(profiles.initialize(binary));
+  check_profiles(profiles);
+}
+
+TEST_F(MethodProfilesTest, rejectTruncatedBinary) {
+  auto binary = write_temp_file("");
+  ASSERT_TRUE(MethodProfiles::convert_to_binary(m_csv, binary));
+  boost::filesystem::resize_file(binary,
+                                 boost::filesystem::file_size(binary) - 1);
+
+  MethodProfiles profiles;
+  EXPECT_FALSE(profiles.initialize(binary));
+  EXPECT_FALSE(profiles.has_stats());
+}
@@ -86,3 +86,35 @@ TEST_F(MonitorCountTest, catchButNotCatchAll) {
   EXPECT_EQ(bad_insn->opcode(), OPCODE_CHECK_CAST);
   EXPECT_EQ(bad_insn->get_type(), DexType::get_type("LFoo;"));
 }
+
+TEST_F(MonitorCountTest, onlyInTryRegions) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (load-param v0)
+      (monitor-enter v0)
+      (check-cast v0 "LBar;")
+      (move-result-pseudo-object v1)
+
+      (.try_start a)
+      (check-cast v0 "LFoo;")
+      (move-result-pseudo-object v1)
+      (.try_end a)
+
+      (.catch (a) "LMyThrowable;")
+      (monitor-exit v0)
+      (return-void)
+    )
+  )");
+  code->build_cfg(/* editable */ false);
+
+  // Outside of any try region, the throw leaves the method.
+  auto bad_insn = find_synchronized_throw_outside_catch_all(
+      code->cfg(), /* only_in_try_regions */ true);
+  ASSERT_NE(bad_insn, nullptr);
+  EXPECT_EQ(bad_insn->opcode(), OPCODE_CHECK_CAST);
+  EXPECT_EQ(bad_insn->get_type(), DexType::get_type("LFoo;"));
+
+  bad_insn = find_synchronized_throw_outside_catch_all(code->cfg());
+  ASSERT_NE(bad_insn, nullptr);
+  EXPECT_EQ(bad_insn->get_type(), DexType::get_type("LBar;"));
+}
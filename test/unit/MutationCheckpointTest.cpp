@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "IRAssembler.h"
+#include "IRCode.h"
+#include "MutationCheckpoint.h"
+#include "RedexTest.h"
+#include "ScopeHelper.h"
+
+struct MutationCheckpointTest : public RedexTest {
+  void SetUp() override {
+    auto cls = create_internal_class(DexType::make_type("LFoo;"),
+                                     type::java_lang_Object(), {});
+    foo = assembler::method_from_string(R"(
+      (method (public static) "LFoo;.foo:()V"
+       (
+        (const v0 0)
+        (return-void)
+       )
+      )
+    )");
+    bar = assembler::method_from_string(R"(
+      (method (public static) "LFoo;.bar:()V"
+       (
+        (return-void)
+       )
+      )
+    )");
+    cls->add_method(foo);
+    cls->add_method(bar);
+    scope = {cls};
+  }
+
+  Scope scope;
+  DexMethod* foo;
+  DexMethod* bar;
+};
+
+TEST_F(MutationCheckpointTest, changesThroughIRCode) {
+  MutationCheckpoint checkpoint(scope);
+  EXPECT_TRUE(checkpoint.changed_methods(scope).empty());
+
+  auto code = foo->get_code();
+  auto it = code->begin();
+  while (it->type != MFLOW_OPCODE || it->insn->opcode() != OPCODE_CONST) {
+    ++it;
+  }
+  code->remove_opcode(it);
+  EXPECT_TRUE(checkpoint.changed(foo));
+  EXPECT_FALSE(checkpoint.changed(bar));
+  EXPECT_EQ(std::vector<DexMethod*>{foo}, checkpoint.changed_methods(scope));
+
+  // Analyses don't change the code, editable cfgs might.
+  MutationCheckpoint later(scope);
+  bar->get_code()->build_cfg(/* editable */ false);
+  bar->get_code()->clear_cfg();
+  EXPECT_FALSE(later.changed(bar));
+  bar->get_code()->build_cfg(/* editable */ true);
+  bar->get_code()->clear_cfg();
+  EXPECT_TRUE(later.changed(bar));
+}
+
+TEST_F(MutationCheckpointTest, newCodeCountsAsChanged) {
+  MutationCheckpoint checkpoint(scope);
+  auto copy = std::make_unique<IRCode>(*bar->get_code());
+  EXPECT_NE(copy->get_mutation_epoch(), bar->get_code()->get_mutation_epoch());
+  bar->set_code(std::move(copy));
+  EXPECT_TRUE(checkpoint.changed(bar));
+
+  MutationCheckpoint later(scope);
+  bar->get_code()->mark_changed();
+  EXPECT_TRUE(later.changed(bar));
+  EXPECT_FALSE(later.changed(foo));
+}
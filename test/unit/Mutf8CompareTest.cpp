@@ -19,3 +19,20 @@ TEST_F(Mutf8CompareTest, empty) {
   EXPECT_TRUE(compare_dexstrings(s1, s2));
   EXPECT_FALSE(compare_dexstrings(s2, s1));
 }
+
+TEST_F(Mutf8CompareTest, codeUnitOrder) {
+  // U+0000 is encoded on two bytes but still sorts before U+0001.
+  DexString* null_char = DexString::make_string("a\300\200b");
+  DexString* one = DexString::make_string("a\001");
+  EXPECT_EQ(3, null_char->length());
+  EXPECT_TRUE(compare_dexstrings(null_char, one));
+  EXPECT_FALSE(compare_dexstrings(one, null_char));
+
+  // The strings only differ in the second byte of a code point.
+  DexString* e_acute = DexString::make_string("Lfoo\303\251;");
+  DexString* e_grave = DexString::make_string("Lfoo\303\250;");
+  EXPECT_EQ(6, e_acute->length());
+  EXPECT_TRUE(compare_dexstrings(e_grave, e_acute));
+  EXPECT_FALSE(compare_dexstrings(e_acute, e_grave));
+  EXPECT_FALSE(compare_dexstrings(e_acute, e_acute));
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+#include <limits>
+#include <thread>
+
+#include "InterDex.h"
+#include "RedexTest.h"
+#include "ScopeHelper.h"
+
+using namespace interdex;
+
+struct PackingTrialTest : public RedexTest {
+  CrossDexRefMinimizerConfig config{/* method_ref_weight */ 100,
+                                    /* field_ref_weight */ 90,
+                                    /* type_ref_weight */ 100,
+                                    /* string_ref_weight */ 90,
+                                    /* method_seed_weight */ 100,
+                                    /* field_seed_weight */ 20,
+                                    /* type_seed_weight */ 30,
+                                    /* string_seed_weight */ 20};
+  CrossDexRefMinimizerConfig other_config{/* method_ref_weight */ 10,
+                                          /* field_ref_weight */ 10,
+                                          /* type_ref_weight */ 1,
+                                          /* string_ref_weight */ 10,
+                                          /* method_seed_weight */ 10,
+                                          /* field_seed_weight */ 10,
+                                          /* type_seed_weight */ 1,
+                                          /* string_seed_weight */ 10};
+
+  // Classes C0 ... Cn-1, where Ci and Ci+n/2 implement the same interface,
+  // which no other class implements.
+  std::vector<DexClass*> make_paired_classes(size_t n) {
+    std::vector<DexClass*> classes;
+    for (size_t i = 0; i < n; ++i) {
+      auto intf = DexType::make_type(
+          DexString::make_string("LI" + std::to_string(i % (n / 2)) + ";"));
+      auto type = DexType::make_type(
+          DexString::make_string("LC" + std::to_string(i) + ";"));
+      classes.push_back(
+          create_internal_class(type, type::java_lang_Object(), {intf}));
+    }
+    return classes;
+  }
+};
+
+TEST_F(PackingTrialTest, choiceIsStable) {
+  auto classes = make_paired_classes(64);
+  DexesStructure dexes;
+  dexes.set_linear_alloc_limit(1 << 30);
+  dexes.set_type_refs_limit(16);
+  auto cache = std::make_shared<ClassReferencesCache>();
+  std::vector<CrossDexRefMinimizerConfig> configs{config, other_config};
+  auto pick = [&](size_t work_budget) {
+    return pick_packing_trial(configs, dexes, /* sampled_classes */ {}, classes,
+                              cache, work_budget);
+  };
+
+  auto best = pick(std::numeric_limits<size_t>::max());
+  ASSERT_TRUE(best);
+
+  // The choice only depends on the inputs, also when other trials compete for
+  // the CPUs.
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < 8; ++i) {
+    threads.emplace_back([&]() {
+      for (size_t j = 0; j < 4; ++j) {
+        auto choice = pick(std::numeric_limits<size_t>::max());
+        ASSERT_TRUE(choice);
+        EXPECT_EQ(*best, *choice);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+TEST_F(PackingTrialTest, budgetAndTies) {
+  auto classes = make_paired_classes(32);
+  DexesStructure dexes;
+  dexes.set_linear_alloc_limit(1 << 30);
+  dexes.set_type_refs_limit(16);
+  auto cache = std::make_shared<ClassReferencesCache>();
+
+  // Equal configs tie, and the first one wins.
+  std::vector<CrossDexRefMinimizerConfig> configs{config, config};
+  auto best = pick_packing_trial(configs, dexes, {}, classes, cache,
+                                 std::numeric_limits<size_t>::max());
+  ASSERT_TRUE(best);
+  EXPECT_EQ(0, *best);
+
+  // Placing each class costs at least one unit of work.
+  EXPECT_FALSE(pick_packing_trial(configs, dexes, {}, classes, cache, 0));
+  EXPECT_FALSE(pick_packing_trial(configs, dexes, {}, classes, cache,
+                                  classes.size() - 1));
+
+  // No configs, no choice.
+  EXPECT_FALSE(pick_packing_trial({}, dexes, {}, classes, cache,
+                                  std::numeric_limits<size_t>::max()));
+}
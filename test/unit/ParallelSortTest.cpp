@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+#include "ParallelSort.h"
+
+TEST(ParallelSortTest, sameAsStdSort) {
+  std::mt19937 generator(42);
+  std::uniform_int_distribution<uint32_t> dist;
+  // Sizes that yield no split, uneven chunks and empty trailing chunks.
+  for (size_t size : {0, 10, 4096 * 2, 4096 * 8 + 3, 100000}) {
+    std::vector<uint32_t> values;
+    for (size_t i = 0; i < size; ++i) {
+      values.push_back(dist(generator));
+    }
+    auto expected = values;
+    std::sort(expected.begin(), expected.end(), std::greater<uint32_t>());
+    for (size_t num_threads : {1, 2, 3, 8}) {
+      auto actual = values;
+      redex_parallel::sort(actual.begin(), actual.end(),
+                           std::greater<uint32_t>(), num_threads);
+      EXPECT_EQ(expected, actual) << size << " values, " << num_threads
+                                  << " threads";
+    }
+  }
+}
@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "IRAssembler.h"
+#include "PassResultCache.h"
+#include "RedexTest.h"
+#include "RedexTestUtils.h"
+
+struct PassResultCacheTest : public RedexTest {};
+
+namespace {
+
+const char* const kInput = R"(
+  (method (public static) "LFoo;.bar:()I"
+   (
+    (const v0 1)
+    (const v1 2)
+    (add-int v2 v0 v1)
+    (return v2)
+   )
+  )
+)";
+
+const char* const kInputCode = R"(
+  (
+   (const v0 1)
+   (const v1 2)
+   (add-int v2 v0 v1)
+   (return v2)
+  )
+)";
+
+const char* const kOutput = R"(
+  (
+   (const v0 3)
+   (return v0)
+  )
+)";
+
+} // namespace
+
+TEST_F(PassResultCacheTest, recordSaveReplay) {
+  auto tmp_dir = redex::make_tmp_dir("redex_pass_result_cache_test_%%%%%%%%");
+  auto path = tmp_dir.path + "/Pass.cache";
+
+  auto method = assembler::method_from_string(kInput);
+  std::string key;
+  {
+    PassResultCache cache(path, "salt");
+    key = cache.key(method);
+    ASSERT_FALSE(key.empty());
+    EXPECT_FALSE(cache.replay(key, method));
+    EXPECT_EQ(1, cache.misses());
+
+    method->set_code(assembler::ircode_from_string(kOutput));
+    method->get_code()->set_registers_size(5);
+    cache.record(key, method);
+    cache.save();
+  }
+
+  // The same input code yields the same key, and replays the result.
+  method->set_code(assembler::ircode_from_string(kInputCode));
+  {
+    PassResultCache cache(path, "salt");
+    EXPECT_EQ(key, cache.key(method));
+    EXPECT_TRUE(cache.replay(key, method));
+    EXPECT_EQ(1, cache.hits());
+    auto expected = assembler::ircode_from_string(kOutput);
+    EXPECT_EQ(assembler::to_s_expr(method->get_code()),
+              assembler::to_s_expr(expected.get()));
+    EXPECT_EQ(5, method->get_code()->get_registers_size());
+    cache.save();
+  }
+
+  // A different salt, e.g. a different pass config, misses.
+  {
+    PassResultCache cache(path, "other salt");
+    auto other_key = cache.key(method);
+    EXPECT_NE(key, other_key);
+    EXPECT_FALSE(cache.replay(other_key, method));
+    // Nothing was used, so saving drops the stale entry.
+    cache.save();
+  }
+  {
+    PassResultCache cache(path, "salt");
+    EXPECT_FALSE(cache.replay(key, method));
+  }
+}
+
+TEST_F(PassResultCacheTest, replayKeepsDebugItem) {
+  auto tmp_dir = redex::make_tmp_dir("redex_pass_result_cache_test_%%%%%%%%");
+  auto path = tmp_dir.path + "/Pass.cache";
+
+  auto method = assembler::method_from_string(kInput);
+  method->get_code()->set_debug_item(std::make_unique<DexDebugItem>());
+  std::string key;
+  {
+    PassResultCache cache(path, "salt");
+    key = cache.key(method);
+    ASSERT_FALSE(key.empty());
+    auto code = assembler::ircode_from_string(kOutput);
+    code->set_debug_item(std::make_unique<DexDebugItem>());
+    method->set_code(std::move(code));
+    cache.record(key, method);
+    cache.save();
+  }
+
+  PassResultCache cache(path, "salt");
+  // The same instructions without a debug item are a different input.
+  method->set_code(assembler::ircode_from_string(kInputCode));
+  EXPECT_NE(key, cache.key(method));
+
+  method->get_code()->set_debug_item(std::make_unique<DexDebugItem>());
+  EXPECT_EQ(key, cache.key(method));
+  EXPECT_TRUE(cache.replay(key, method));
+  EXPECT_NE(nullptr, method->get_code()->get_debug_item());
+}
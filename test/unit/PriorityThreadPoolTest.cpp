@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "PriorityThreadPool.h"
+
+#include <atomic>
+#include <future>
+#include <gtest/gtest.h>
+#include <vector>
+
+TEST(PriorityThreadPoolTest, priorities) {
+  std::vector<int> order;
+  {
+    PriorityThreadPool pool(1);
+    // Keep the only thread busy until all items are posted.
+    std::promise<void> posted;
+    auto posted_future = posted.get_future().share();
+    pool.post(100, [posted_future]() { posted_future.wait(); });
+    for (int priority : {1, 3, -2, 2}) {
+      pool.post(priority, [&order, priority]() { order.push_back(priority); });
+    }
+    posted.set_value();
+    pool.join();
+  }
+  EXPECT_EQ(std::vector<int>({3, 2, 1, -2}), order);
+}
+
+// Work items posted by running work items are waited for too.
+TEST(PriorityThreadPoolTest, postWhileRunning) {
+  std::atomic<int> count{0};
+  PriorityThreadPool pool(2);
+  std::function<void(int)> fan_out = [&](int depth) {
+    ++count;
+    if (depth > 0) {
+      pool.post(depth, [&, depth]() { fan_out(depth - 1); });
+      pool.post(depth, [&, depth]() { fan_out(depth - 1); });
+    }
+  };
+  pool.post(0, [&]() { fan_out(8); });
+  pool.join();
+  EXPECT_EQ((1 << 9) - 1, count);
+}
+
+// With a shared thread pool that is too busy to start any of the drainers,
+// the waiting thread has to run the work items itself, including those that
+// work items post while it waits.
+TEST(PriorityThreadPoolTest, busySharedThreadPool) {
+  sparta::parallel::ThreadPool shared_pool;
+  sparta::parallel::set_shared_thread_pool(&shared_pool);
+  {
+    std::atomic<int> count{0};
+    PriorityThreadPool pool(1);
+    EXPECT_EQ(1u, shared_pool.num_threads());
+    std::promise<void> waited;
+    auto waited_future = waited.get_future().share();
+    shared_pool.post([waited_future]() { waited_future.wait(); });
+    pool.post(0, [&]() {
+      ++count;
+      pool.post(1, [&]() { ++count; });
+    });
+    pool.join();
+    EXPECT_EQ(2, count);
+    waited.set_value();
+  }
+  sparta::parallel::set_shared_thread_pool(nullptr);
+}
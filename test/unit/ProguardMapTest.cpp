@@ -7,6 +7,8 @@
 
 #include "ProguardMap.h"
 
+#include <boost/filesystem.hpp>
+#include <fstream>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <sstream>
@@ -89,6 +91,32 @@ TEST_F(ProguardMapTest, HandlesGeneratedComments) {
   EXPECT_EQ("LA;.a:I", pm.translate_field("Lcom/foo/bar;.do1:I"));
 }
 
+TEST_F(ProguardMapTest, ParsesMappedFile) {
+  auto path = boost::filesystem::temp_directory_path() /
+              boost::filesystem::unique_path();
+  {
+    // No newline at the end, and a class used before it is declared.
+    std::ofstream ofs(path.string());
+    ofs << "com.foo.bar -> A:\n"
+           "    com.foo.baz field -> a\n"
+           "    1:2:void run(com.foo.baz) -> b\n"
+           "com.foo.baz -> B:";
+  }
+  ProguardMap pm(path.string());
+  EXPECT_EQ("LB;", pm.translate_class("Lcom/foo/baz;"));
+  EXPECT_EQ("LA;.a:LB;",
+            pm.translate_field("Lcom/foo/bar;.field:Lcom/foo/baz;"));
+  EXPECT_EQ("Lcom/foo/bar;.run:(Lcom/foo/baz;)V",
+            pm.deobfuscate_method("LA;.b:(LB;)V"));
+  EXPECT_EQ("Lcom/foo/bar;.field:Lcom/foo/baz;",
+            pm.deobfuscate_field("LA;.a"));
+  EXPECT_EQ("LC;", pm.deobfuscate_class("LC;"));
+
+  { std::ofstream ofs(path.string()); }
+  EXPECT_TRUE(ProguardMap(path.string()).empty());
+  boost::filesystem::remove(path);
+}
+
 TEST_F(ProguardMapTest, LineNumbers) {
   std::stringstream ss(
       "com.foo.bar -> A:\n"
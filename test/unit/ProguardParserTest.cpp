@@ -5,6 +5,8 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <boost/filesystem.hpp>
+#include <fstream>
 #include <gtest/gtest.h>
 
 #include <istream>
@@ -795,3 +797,30 @@ TEST(ProguardParserTest, remove_blacklisted_rules) {
     EXPECT_EQ(config.keep_rules.size(), 2);
   }
 }
+
+TEST(ProguardParserTest, parse_files_in_order) {
+  auto dir = boost::filesystem::temp_directory_path() /
+             boost::filesystem::unique_path();
+  boost::filesystem::create_directory(dir);
+  auto write = [&](const std::string& name, const std::string& contents) {
+    auto path = (dir / name).string();
+    std::ofstream ofs(path);
+    ofs << contents;
+    return path;
+  };
+  auto included = write("c.pro", "-keep class C {}\n");
+  std::vector<std::string> filenames{
+      write("a.pro", "-keep class A {}\n-include " + included + "\n"),
+      write("b.pro", "-keep class B {}\n")};
+
+  ProguardConfiguration config;
+  proguard_parser::parse_files(filenames, &config);
+  ASSERT_TRUE(config.ok);
+  // Included files are parsed right after the file that includes them.
+  std::vector<std::string> class_names;
+  for (const auto& keep : config.keep_rules) {
+    class_names.push_back(keep->class_spec.className);
+  }
+  EXPECT_EQ(class_names, (std::vector<std::string>{"A", "C", "B"}));
+  boost::filesystem::remove_all(dir);
+}
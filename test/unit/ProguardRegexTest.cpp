@@ -270,3 +270,19 @@ TEST(ProguardRegexTest, types) {
     EXPECT_EQ("Lalpha/**/beta;", descriptor);
   }
 }
+
+TEST(ProguardRegexTest, literalPrefix) {
+  auto prefix = [](const std::string& proguard_regex) {
+    return proguard_parser::literal_prefix(proguard_parser::form_type_regex(
+        proguard_parser::convert_wildcard_type(proguard_regex)));
+  };
+  EXPECT_EQ("Lcom/", prefix("com.*.redex.test.proguard.Delta"));
+  EXPECT_EQ("Lcom/facebook/", prefix("com.facebook.**"));
+  EXPECT_EQ("Lcom/facebook/Foo$Bar;", prefix("com.facebook.Foo$Bar"));
+  EXPECT_EQ("Lcom/fa", prefix("com.fa?ebook.Foo"));
+  EXPECT_EQ("", prefix("**"));
+  EXPECT_EQ("", proguard_parser::literal_prefix("(?:B|S|I|J|Z|F|D|C|V)"));
+  // Quantified and alternated literals are not part of every match.
+  EXPECT_EQ("a", proguard_parser::literal_prefix("ab*c"));
+  EXPECT_EQ("", proguard_parser::literal_prefix("ab|c"));
+}
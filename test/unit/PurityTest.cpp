@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "Creators.h"
+#include "DexClass.h"
+#include "Purity.h"
+#include "RedexTest.h"
+
+struct PurityTest : public RedexTest {};
+
+TEST_F(PurityTest, locationsClosure) {
+  ClassCreator creator(DexType::make_type("LFoo;"));
+  creator.set_super(type::java_lang_Object());
+  std::unordered_map<std::string, DexMethod*> methods;
+  for (auto name : {"a", "b", "c", "d", "e", "f"}) {
+    auto method = DexMethod::make_method(std::string("LFoo;.") + name + ":()V")
+                      ->make_concrete(ACC_PUBLIC | ACC_STATIC, false);
+    creator.add_method(method);
+    methods[name] = method;
+  }
+  std::unordered_map<std::string, CseLocation> fields;
+  for (auto name : {"x", "y", "z"}) {
+    auto field = DexField::make_field(std::string("LFoo;.") + name + ":I")
+                     ->make_concrete(ACC_PUBLIC | ACC_STATIC);
+    creator.add_field(field);
+    fields.emplace(name, CseLocation(field));
+  }
+  Scope scope{creator.create()};
+
+  // a and b call each other, c calls a, e has no known implementation, and
+  // f calls d which calls e.
+  std::unordered_map<const DexMethod*, LocationsAndDependencies> init{
+      {methods["a"], {{fields.at("x")}, {methods["b"]}}},
+      {methods["b"], {{fields.at("y")}, {methods["a"], methods["b"]}}},
+      {methods["c"], {{fields.at("z")}, {methods["a"]}}},
+      {methods["d"], {{}, {methods["e"]}}},
+      {methods["f"], {{fields.at("z")}, {methods["d"]}}},
+  };
+  std::unordered_map<const DexMethod*, CseUnorderedLocationSet> result;
+  auto rounds = compute_locations_closure(
+      scope, /* method_override_graph */ nullptr,
+      [&](DexMethod* method) -> boost::optional<LocationsAndDependencies> {
+        auto it = init.find(method);
+        if (it == init.end()) {
+          return boost::none;
+        }
+        return it->second;
+      },
+      &result);
+
+  // {a, b} is needed by c, and d by f.
+  EXPECT_EQ(2, rounds);
+  EXPECT_EQ(3, result.size());
+  EXPECT_THAT(result.at(methods["a"]),
+              ::testing::UnorderedElementsAre(fields.at("x"), fields.at("y")));
+  EXPECT_THAT(result.at(methods["b"]),
+              ::testing::UnorderedElementsAre(fields.at("x"), fields.at("y")));
+  EXPECT_THAT(result.at(methods["c"]),
+              ::testing::UnorderedElementsAre(
+                  fields.at("x"), fields.at("y"), fields.at("z")));
+  EXPECT_EQ(0, result.count(methods["d"]));
+  EXPECT_EQ(0, result.count(methods["e"]));
+  EXPECT_EQ(0, result.count(methods["f"]));
+}
@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+
+#include "ReachabilityGraph.h"
+#include "RedexTestUtils.h"
+
+using namespace reachability_server;
+
+namespace {
+
+struct Node {
+  NodeType type;
+  std::string name;
+  std::vector<NodeId> retainers;
+};
+
+template <typename T>
+void write(std::ofstream& ofs, T value) {
+  ofs.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+// Writes :nodes in the format of reachability::dump_graph.
+void write_dump(const std::string& path,
+                const std::vector<Node>& nodes,
+                uint32_t magic = 0xfaceb000) {
+  std::ofstream ofs(path, std::ios::binary);
+  write<uint32_t>(ofs, magic);
+  write<uint32_t>(ofs, 1);
+  write<uint32_t>(ofs, nodes.size());
+  for (const auto& node : nodes) {
+    write<uint8_t>(ofs, (uint8_t)node.type);
+    write<uint32_t>(ofs, node.name.size());
+    ofs.write(node.name.data(), node.name.size());
+    write<uint32_t>(ofs, node.retainers.size());
+    for (auto retainer : node.retainers) {
+      write<uint32_t>(ofs, retainer);
+    }
+  }
+}
+
+enum : NodeId { S1, S2, A, B, C, D, E };
+
+/*
+ * S1 -> A -> B -> C <- S2
+ *       |    |
+ *       +--> D <-+
+ *
+ * and E, which nothing keeps.
+ */
+std::vector<Node> small_graph() {
+  return {
+      {NodeType::SEED, "S1", {}},
+      {NodeType::SEED, "S2", {}},
+      {NodeType::CLASS, "LA;", {S1}},
+      {NodeType::METHOD, "LA;.b:()V", {A}},
+      {NodeType::FIELD, "LC;.c:I", {B, S2}},
+      {NodeType::CLASS, "LD;", {A, B}},
+      {NodeType::CLASS, "LE;", {}},
+  };
+}
+
+} // namespace
+
+class ReachabilityGraphTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    m_tmp_dir = redex::make_tmp_dir("redex_reachability_graph_test_%%%%%%%%");
+    m_path = m_tmp_dir.path + "/reachability-graph";
+  }
+
+  redex::TempDir m_tmp_dir;
+  std::string m_path;
+};
+
+TEST_F(ReachabilityGraphTest, load) {
+  write_dump(m_path, small_graph());
+  ReachabilityGraph graph;
+  std::string error;
+  ASSERT_TRUE(graph.load(m_path, &error)) << error;
+  EXPECT_EQ(7u, graph.size());
+  EXPECT_EQ(6u, graph.edges_size());
+  EXPECT_EQ(NodeType::FIELD, graph.type(C));
+  EXPECT_EQ("LC;.c:I", graph.name(C));
+  EXPECT_EQ(std::vector<NodeId>{D}, graph.find("LD;"));
+  EXPECT_TRUE(graph.find("LZ;").empty());
+  EXPECT_EQ((std::vector<NodeId>{A, B}), graph.search("LA;", 10));
+  EXPECT_EQ(std::vector<NodeId>{A}, graph.search("LA;", 1));
+}
+
+TEST_F(ReachabilityGraphTest, retainers) {
+  write_dump(m_path, small_graph());
+  ReachabilityGraph graph;
+  std::string error;
+  ASSERT_TRUE(graph.load(m_path, &error)) << error;
+  EXPECT_EQ((std::vector<NodeId>{B, S2}), graph.retainers(C));
+  EXPECT_EQ((std::vector<NodeId>{A, B}), graph.retainers(D));
+  EXPECT_TRUE(graph.retainers(S1).empty());
+  EXPECT_EQ((std::vector<NodeId>{B, D}), graph.retained(A));
+  EXPECT_EQ((std::vector<NodeId>{C, D}), graph.retained(B));
+  EXPECT_TRUE(graph.retained(E).empty());
+}
+
+TEST_F(ReachabilityGraphTest, keepChain) {
+  write_dump(m_path, small_graph());
+  ReachabilityGraph graph;
+  std::string error;
+  ASSERT_TRUE(graph.load(m_path, &error)) << error;
+  EXPECT_EQ((std::vector<NodeId>{D, A, S1}), graph.keep_chain(D));
+  // S2 keeps C directly, which beats the chain through B.
+  EXPECT_EQ((std::vector<NodeId>{C, S2}), graph.keep_chain(C));
+  EXPECT_EQ(std::vector<NodeId>{S1}, graph.keep_chain(S1));
+  EXPECT_TRUE(graph.keep_chain(E).empty());
+}
+
+TEST_F(ReachabilityGraphTest, dominators) {
+  write_dump(m_path, small_graph());
+  ReachabilityGraph graph;
+  std::string error;
+  ASSERT_TRUE(graph.load(m_path, &error)) << error;
+  // Both chains to D go through A.
+  EXPECT_EQ((std::vector<NodeId>{A, S1}), graph.dominators(D));
+  EXPECT_EQ((std::vector<NodeId>{A, S1}), graph.dominators(B));
+  // C is kept by either seed, so only the virtual root dominates it.
+  EXPECT_TRUE(graph.dominators(C).empty());
+  EXPECT_TRUE(graph.dominators(S1).empty());
+  EXPECT_TRUE(graph.dominators(E).empty());
+}
+
+TEST_F(ReachabilityGraphTest, invalidDumps) {
+  ReachabilityGraph graph;
+  std::string error;
+  EXPECT_FALSE(graph.load(m_path, &error));
+  EXPECT_EQ("cannot open " + m_path, error);
+
+  write_dump(m_path, small_graph(), 0xdeadbeef);
+  EXPECT_FALSE(graph.load(m_path, &error));
+  EXPECT_EQ("magic number mismatch", error);
+
+  write_dump(m_path, {{NodeType::CLASS, "LA;", {1}}});
+  EXPECT_FALSE(graph.load(m_path, &error));
+  EXPECT_EQ("edge to missing node 1", error);
+
+  write_dump(m_path, small_graph());
+  redex::resize_file(m_path, redex::file_size(m_path) - 1);
+  EXPECT_FALSE(graph.load(m_path, &error));
+  EXPECT_EQ(m_path + " is truncated", error);
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "DexClass.h"
+#include "RedexContext.h"
+#include "RedexTest.h"
+
+class RedexContextTest : public RedexTest {};
+
+TEST_F(RedexContextTest, makeStrings) {
+  auto existing = DexString::make_string("existing");
+  auto strs = DexString::make_strings({"new", "existing", "new", "\xc3\xa9"});
+  ASSERT_EQ(4, strs.size());
+  EXPECT_EQ(DexString::get_string("new"), strs[0]);
+  EXPECT_EQ(existing, strs[1]);
+  // Duplicates within a batch are interned once.
+  EXPECT_EQ(strs[0], strs[2]);
+  EXPECT_FALSE(strs[3]->is_simple());
+  EXPECT_EQ(strs[3], DexString::make_string("\xc3\xa9"));
+}
+
+TEST_F(RedexContextTest, stringCacheIsPerContext) {
+  auto first = DexString::make_string("cached");
+  EXPECT_EQ(first, DexString::get_string("cached"));
+
+  // Strings that this thread interned in another context are not found.
+  RedexContext other;
+  auto* saved = g_redex;
+  g_redex = &other;
+  EXPECT_EQ(nullptr, DexString::get_string("cached"));
+  auto second = DexString::make_string("cached");
+  EXPECT_NE(first, second);
+  g_redex = saved;
+
+  EXPECT_EQ(first, DexString::get_string("cached"));
+}
@@ -5,6 +5,8 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <boost/filesystem.hpp>
+#include <fstream>
 #include <gtest/gtest.h>
 #include <map>
 #include <string>
@@ -46,3 +48,49 @@ TEST(RedexResources, ReadXmlTagsAndAttributes) {
   auto no_ns_vals = multimap_values_to_set(attribute_values, "onClick");
   EXPECT_EQ(no_ns_vals.size(), 0);
 }
+
+TEST(RedexResources, CollectFromManyLayouts) {
+  namespace fs = boost::filesystem;
+  auto apk_dir = fs::temp_directory_path() / fs::unique_path();
+  auto layout_dir = apk_dir / "res" / "layout";
+  fs::create_directories(layout_dir);
+  for (size_t i = 0; i < 16; ++i) {
+    fs::copy_file(std::getenv("test_layout_path"),
+                  layout_dir / ("layout" + std::to_string(i) + ".xml"));
+  }
+  // Empty files are skipped rather than failing the whole directory.
+  std::ofstream((layout_dir / "empty.xml").string());
+
+  std::unordered_set<std::string> attributes_to_find;
+  attributes_to_find.emplace("android:onClick");
+  std::unordered_set<std::string> classes;
+  std::unordered_multimap<std::string, std::string> attribute_values;
+  collect_layout_classes_and_attributes(
+      apk_dir.string(), attributes_to_find, classes, attribute_values);
+  fs::remove_all(apk_dir);
+
+  EXPECT_EQ(classes.size(), 3);
+  EXPECT_EQ(classes.count("Lcom/example/test/CustomViewGroup;"), 1);
+  std::unordered_set<std::string> file_classes;
+  std::unordered_multimap<std::string, std::string> file_attribute_values;
+  collect_layout_classes_and_attributes_for_file(
+      std::getenv("test_layout_path"), attributes_to_find, file_classes,
+      file_attribute_values);
+  EXPECT_EQ(attribute_values.size(), 16 * file_attribute_values.size());
+  auto vals = multimap_values_to_set(attribute_values, "android:onClick");
+  EXPECT_EQ(vals.size(), 2);
+}
+
+TEST(RedexResources, ExtractJsResources) {
+  auto resources = extract_js_resources(R"(
+    var a = "sounds/ding.m4a", b = "not_a_sound.mp3", c = ".ogg";
+    var d = {uri: "https://example.com/logo.png"}, e = {suri: "skipped"};
+    __d.registerAsset({name:"Icon-Large", type:"png",
+        httpServerLocation:"/assets/img/Foo"});
+    __d.registerAsset({name:"no_location"});
+    "bell.ogg")");
+  std::unordered_set<std::string> expected{
+      "sounds/ding", "https://example.com/logo.png", "img_foo_iconlarge",
+      "bell"};
+  EXPECT_EQ(resources, expected);
+}
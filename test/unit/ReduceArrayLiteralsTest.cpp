@@ -337,3 +337,25 @@ TEST_F(ReduceArrayLiteralsTest, conditional_escape) {
   const auto& expected_str = code_str;
   test(code_str, expected_str, 0, 0);
 }
+
+TEST_F(ReduceArrayLiteralsTest, escape_before_last_element) {
+  // the array escapes before it is fully initialized, so it is no literal even
+  // though all elements are eventually filled in
+  auto code_str = R"(
+    (
+      (const v0 2)
+      (new-array v0 "[Ljava/lang/String;")
+      (move-result-pseudo-object v1)
+      (const-string "hello")
+      (move-result-pseudo-object v2)
+      (const v0 0)
+      (aput-object v2 v1 v0)
+      (invoke-static (v1) "LFoo;.bar:([Ljava/lang/String;)V")
+      (const v0 1)
+      (aput-object v2 v1 v0)
+      (return-object v1)
+    )
+  )";
+  const auto& expected_str = code_str;
+  test(code_str, expected_str, 0, 0);
+}
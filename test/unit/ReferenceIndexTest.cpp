@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "ReferenceIndex.h"
+
+#include <gtest/gtest.h>
+
+#include "Creators.h"
+#include "IRAssembler.h"
+#include "IRCode.h"
+#include "RedexTest.h"
+
+using namespace reference_index;
+
+struct ReferenceIndexTest : public RedexTest {};
+
+TEST_F(ReferenceIndexTest, queriesAndDirtyMethods) {
+  ClassCreator foo_creator(DexType::make_type("LFoo;"));
+  foo_creator.set_super(type::java_lang_Object());
+  auto field = DexField::make_field("LFoo;.a:I")->make_concrete(ACC_STATIC);
+  foo_creator.add_field(field);
+  auto callee = assembler::method_from_string(R"(
+    (method (public static) "LFoo;.callee:()V"
+     (
+      (return-void)
+     )
+    )
+  )");
+  auto caller = assembler::method_from_string(R"(
+    (method (public static) "LFoo;.caller:()V"
+     (
+      (invoke-static () "LFoo;.callee:()V")
+      (const-string "hello")
+      (move-result-pseudo-object v1)
+      (invoke-static () "LFoo;.callee:()V")
+      (return-void)
+     )
+    )
+  )");
+  foo_creator.add_method(callee);
+  foo_creator.add_method(caller);
+  auto foo = foo_creator.create();
+
+  // Accesses the field through a ref on a subclass.
+  ClassCreator bar_creator(DexType::make_type("LBar;"));
+  bar_creator.set_super(foo->get_type());
+  auto reader = assembler::method_from_string(R"(
+    (method (public static) "LBar;.reader:()I"
+     (
+      (sget "LBar;.a:I")
+      (move-result-pseudo v0)
+      (return v0)
+     )
+    )
+  )");
+  bar_creator.add_method(reader);
+  Scope scope{foo, bar_creator.create()};
+
+  ReferenceIndex index(scope);
+  EXPECT_EQ(index.num_indexed_methods(), 3u);
+  EXPECT_EQ(index.methods(static_cast<DexMethodRef*>(callee)),
+            std::vector<DexMethod*>{caller});
+  EXPECT_EQ(index.methods(DexString::make_string("hello")),
+            std::vector<DexMethod*>{caller});
+  EXPECT_EQ(index.methods(field), std::vector<DexMethod*>{reader});
+  EXPECT_EQ(index.methods(DexField::get_field("LBar;.a:I")),
+            std::vector<DexMethod*>{reader});
+  EXPECT_TRUE(index.methods(DexType::make_type("LBar;")).empty());
+
+  // Edits are only picked up once the method is marked dirty.
+  auto other = DexMethod::make_method("LFoo;.other:()V");
+  for (auto& mie : InstructionIterable(caller->get_code())) {
+    if (mie.insn->has_method()) {
+      mie.insn->set_method(other);
+    }
+  }
+  reader->set_code(nullptr);
+  EXPECT_TRUE(index.methods(other).empty());
+  index.mark_dirty(caller);
+  index.mark_dirty(reader);
+  index.update();
+  EXPECT_EQ(index.num_indexed_methods(), 2u);
+  EXPECT_TRUE(index.methods(static_cast<DexMethodRef*>(callee)).empty());
+  EXPECT_EQ(index.methods(other), std::vector<DexMethod*>{caller});
+  EXPECT_EQ(index.methods(DexString::make_string("hello")),
+            std::vector<DexMethod*>{caller});
+  EXPECT_TRUE(index.methods(field).empty());
+}
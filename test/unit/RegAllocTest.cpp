@@ -343,6 +343,38 @@ TEST_F(RegAllocTest, CombineNonAdjacentNodes) {
   EXPECT_FALSE(ig.get_node(2).is_active());
 }
 
+TEST_F(RegAllocTest, RegPairSet) {
+  using namespace interference::impl;
+  constexpr reg_t big = RegPairSet<true>::MAX_DENSE_REG + 5;
+
+  RegPairSet</* Symmetric */ true> edges;
+  EXPECT_TRUE(edges.insert(3, 70));
+  EXPECT_FALSE(edges.insert(70, 3));
+  EXPECT_TRUE(edges.insert(big, 1));
+  EXPECT_TRUE(edges.contains(70, 3));
+  EXPECT_TRUE(edges.contains(1, big));
+  EXPECT_FALSE(edges.contains(3, 69));
+  EXPECT_FALSE(edges.contains(200, 3));
+  std::vector<std::pair<reg_t, reg_t>> pairs;
+  edges.for_each([&](reg_t u, reg_t v) { pairs.emplace_back(u, v); });
+  EXPECT_THAT(pairs,
+              ::testing::UnorderedElementsAre(std::make_pair(3u, 70u),
+                                              std::make_pair(1u, big)));
+
+  RegPairSet</* Symmetric */ false> containment;
+  EXPECT_TRUE(containment.insert(70, 3));
+  EXPECT_TRUE(containment.insert(1, big));
+  EXPECT_TRUE(containment.contains(70, 3));
+  EXPECT_FALSE(containment.contains(3, 70));
+  EXPECT_TRUE(containment.contains(1, big));
+  EXPECT_FALSE(containment.contains(big, 1));
+  pairs.clear();
+  containment.for_each([&](reg_t u, reg_t v) { pairs.emplace_back(u, v); });
+  EXPECT_THAT(pairs,
+              ::testing::UnorderedElementsAre(std::make_pair(70u, 3u),
+                                              std::make_pair(1u, big)));
+}
+
 TEST_F(RegAllocTest, CombineAdjacentNodes) {
   using namespace interference::impl;
   auto ig = GraphBuilder::create_empty();
@@ -1017,3 +1049,88 @@ TEST_F(RegAllocTest, NoOverwriteThis) {
 )");
   EXPECT_CODE_EQ(expected_code.get(), method->get_code());
 }
+
+TEST_F(RegAllocTest, ReuseScratch) {
+  auto make_method = [](const std::string& name) {
+    auto method = assembler::method_from_string(R"(
+      (method (public) "LFoo;.)" + name + R"(:(I)LFoo;"
+       (
+        (load-param-object v0)
+        (load-param v1)
+        (if-eqz v1 :true-label)
+        (sget-object "LFoo;.foo:LFoo;")
+        (move-result-object v0)
+        (:true-label)
+        (return-object v0)
+       )
+      )
+  )");
+    method->get_code()->set_registers_size(2);
+    return method;
+  };
+  auto fresh = make_method("fresh");
+  auto first = make_method("first");
+  auto second = make_method("second");
+
+  graph_coloring::Allocator::Config config;
+  config.no_overwrite_this = true;
+  RegAllocPass::allocate(config, fresh);
+  // Scratch state left behind by one method must not leak into the next.
+  graph_coloring::AllocatorScratch scratch;
+  RegAllocPass::allocate(config, first, &scratch);
+  RegAllocPass::allocate(config, second, &scratch);
+  EXPECT_CODE_EQ(fresh->get_code(), first->get_code());
+  EXPECT_CODE_EQ(fresh->get_code(), second->get_code());
+}
+
+TEST_F(RegAllocTest, SmallMethodAllocator) {
+  auto method = assembler::method_from_string(R"(
+    (method (public static) "LFoo;.bar:(I)I"
+     (
+      (load-param v0)
+      (move v1 v0)
+      (add-int v2 v1 v1)
+      (move v3 v2)
+      (return v3)
+     )
+    )
+)");
+  method->get_code()->set_registers_size(4);
+
+  graph_coloring::Allocator::Config config;
+  config.use_small_method_allocator = true;
+  auto stats = RegAllocPass::allocate(config, method);
+  EXPECT_EQ(1, stats.small_methods_allocated);
+  EXPECT_EQ(1, stats.moves_coalesced);
+
+  // The param keeps a register of its own at the end of the frame.
+  auto expected_code = assembler::ircode_from_string(R"(
+    (
+     (load-param v1)
+     (move v0 v1)
+     (add-int v0 v0 v0)
+     (return v0)
+    )
+)");
+  EXPECT_CODE_EQ(expected_code.get(), method->get_code());
+  EXPECT_EQ(2, method->get_code()->get_registers_size());
+}
+
+TEST_F(RegAllocTest, SmallMethodAllocatorFallback) {
+  // Range instructions are left to the graph coloring allocator.
+  auto method = assembler::method_from_string(R"(
+    (method (public static) "LFoo;.bar:()V"
+     (
+      (const v0 0)
+      (invoke-static (v0 v0 v0 v0 v0 v0) "LFoo;.baz:(IIIIII)V")
+      (return-void)
+     )
+    )
+)");
+  method->get_code()->set_registers_size(1);
+
+  graph_coloring::Allocator::Config config;
+  config.use_small_method_allocator = true;
+  auto stats = RegAllocPass::allocate(config, method);
+  EXPECT_EQ(0, stats.small_methods_allocated);
+}
@@ -358,4 +358,19 @@ TEST_F(ResolverTest, ResolveMethod) {
               b_method);
   EXPECT_TRUE(resolve_method(c_method, MethodSearch::Interface, ref_cache) ==
               a_method);
+
+  // Resolving again hits the cache.
+  EXPECT_TRUE(resolve_method(c_method, MethodSearch::Virtual, ref_cache) ==
+              b_method);
+
+  ConcurrentMethodRefCache concurrent_ref_cache;
+  for (size_t i = 0; i < 2; ++i) {
+    EXPECT_TRUE(resolve_method(c_method, MethodSearch::Direct,
+                               concurrent_ref_cache) == nullptr);
+    EXPECT_TRUE(resolve_method(c_method, MethodSearch::Virtual,
+                               concurrent_ref_cache) == b_method);
+    EXPECT_TRUE(resolve_method(c_method, MethodSearch::Interface,
+                               concurrent_ref_cache) == a_method);
+  }
+  EXPECT_EQ(2, concurrent_ref_cache.size());
 }
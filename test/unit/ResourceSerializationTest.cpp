@@ -283,3 +283,76 @@ TEST(ResTable, AppendNewType) {
 
   unmap_and_close(file_descriptor, fp, length);
 }
+
+TEST(ResTable, EntryIndexMatchesScan) {
+  size_t length;
+  int file_descriptor;
+  auto fp = map_file(std::getenv("test_arsc_path"), &file_descriptor, &length);
+  android::ResTable scanned;
+  ASSERT_EQ(scanned.add(fp, length, -1, /* copyData */ true), 0);
+  android::ResTable indexed;
+  ASSERT_EQ(indexed.add(fp, length, -1, /* copyData */ true), 0);
+  unmap_and_close(file_descriptor, fp, length);
+  indexed.buildEntryIndex();
+
+  android::SortedVector<uint32_t> ids;
+  scanned.getResourceIds(&ids);
+  ASSERT_GT(ids.size(), 1);
+  for (size_t i = 0; i < ids.size(); i++) {
+    android::Vector<android::Res_value> expected;
+    scanned.getAllValuesForResource(ids[i], expected);
+    android::Vector<android::Res_value> actual;
+    indexed.getAllValuesForResource(ids[i], actual);
+    ASSERT_EQ(expected.size(), actual.size());
+    for (size_t j = 0; j < expected.size(); j++) {
+      EXPECT_EQ(expected[j].dataType, actual[j].dataType);
+      EXPECT_EQ(expected[j].data, actual[j].data);
+    }
+  }
+
+  // Remapping every id to another one must rewrite the same values.
+  android::Vector<uint32_t> remapped;
+  for (size_t i = 0; i < ids.size(); i++) {
+    remapped.push_back(ids[ids.size() - 1 - i]);
+  }
+  for (size_t i = 0; i < ids.size(); i++) {
+    scanned.remapReferenceValuesForResource(ids[i], ids, remapped);
+    indexed.remapReferenceValuesForResource(ids[i], ids, remapped);
+  }
+  android::Vector<char> expected;
+  scanned.serialize(expected, 0);
+  android::Vector<char> actual;
+  indexed.serialize(actual, 0);
+  ASSERT_EQ(expected.size(), actual.size());
+  EXPECT_EQ(0, memcmp(expected.array(), actual.array(), expected.size()));
+}
+
+TEST(ResTable, DeleteResourceRoundTrip) {
+  size_t length;
+  int file_descriptor;
+  auto fp = map_file(std::getenv("test_arsc_path"), &file_descriptor, &length);
+  android::ResTable table;
+  ASSERT_EQ(table.add(fp, length, -1, /* copyData */ true), 0);
+  unmap_and_close(file_descriptor, fp, length);
+
+  android::SortedVector<uint32_t> ids;
+  table.getResourceIds(&ids);
+  ASSERT_GT(ids.size(), 1);
+  auto deleted_id = ids[0];
+  table.deleteResource(deleted_id);
+  android::Vector<char> serialized;
+  table.serialize(serialized, 0);
+  EXPECT_LT(serialized.size(), length);
+
+  android::ResTable round_trip;
+  ASSERT_EQ(round_trip.add((void*)serialized.array(), serialized.size()), 0);
+  android::SortedVector<uint32_t> remaining_ids;
+  round_trip.getResourceIds(&remaining_ids);
+  EXPECT_EQ(remaining_ids.size(), ids.size() - 1);
+
+  // Untouched types are copied as they are, so they must round trip too.
+  android::Vector<char> reserialized;
+  round_trip.serialize(reserialized, 0);
+  assert_serialized_data((void*)serialized.array(), serialized.size(),
+                         reserialized);
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "Sha1.h"
+
+namespace {
+
+// Hashes :data, passing it to sha1_update in chunks of at most :chunk bytes.
+std::string sha1_hex(const std::string& data, size_t chunk) {
+  Sha1Context context;
+  sha1_init(&context);
+  for (size_t i = 0; i < data.size(); i += chunk) {
+    auto size = std::min(chunk, data.size() - i);
+    sha1_update(&context,
+                reinterpret_cast<const unsigned char*>(data.data() + i),
+                size);
+  }
+  unsigned char digest[20];
+  sha1_final(digest, &context);
+  char hex[41];
+  for (size_t i = 0; i < 20; ++i) {
+    snprintf(hex + 2 * i, 3, "%02x", digest[i]);
+  }
+  return hex;
+}
+
+std::string pattern(size_t size) {
+  std::string data(size, '\0');
+  for (size_t i = 0; i < size; ++i) {
+    data[i] = i % 251;
+  }
+  return data;
+}
+
+struct KnownAnswer {
+  std::string data;
+  std::string digest;
+};
+
+std::vector<KnownAnswer> known_answers() {
+  return {
+      {"", "da39a3ee5e6b4b0d3255bfef95601890afd80709"},
+      {"abc", "a9993e364706816aba3e25717850c26c9cd0d89d"},
+      {"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+       "84983e441c3bd26ebaae4aa1f95129e5e54670f1"},
+      {std::string(1000000, 'a'), "34aa973cd4c4daa4f61eeb2bdbad27316534016f"},
+      // Around the block boundaries, where the padding takes one or two
+      // blocks.
+      {pattern(55), "8ae2d46729cfe68ff927af5eec9c7d1b66d65ac2"},
+      {pattern(56), "636e2ec698dac903498e648bd2f3af641d3c88cb"},
+      {pattern(63), "6d942da0c4392b123528f2905c713a3ce28364bd"},
+      {pattern(64), "c6138d514ffa2135bfce0ed0b8fac65669917ec7"},
+      {pattern(65), "69bd728ad6e13cd76ff19751fde427b00e395746"},
+      {pattern(119), "41c89d06001bab4ab78736b44efe7ce18ce6ae08"},
+      {pattern(120), "d3dbd653bd8597b7475321b60a36891278e6a04a"},
+      {pattern(127), "89d7312a903f65cd2b3e34a975e55dbea9033353"},
+      {pattern(128), "e6434bc401f98603d7eda504790c98c67385d535"},
+      {pattern(129), "3352e41cc30b40ae80108970492b21014049e625"},
+      {pattern(1000), "c9c960a0b925474fab83942cc27d504fc24ac37b"},
+  };
+}
+
+void check_known_answers() {
+  for (const auto& answer : known_answers()) {
+    // All at once, which hashes most blocks straight from the input, as well
+    // as in pieces that straddle the blocks buffered in the context.
+    for (size_t chunk : {answer.data.size() + 1, size_t(1), size_t(7),
+                         size_t(64), size_t(100)}) {
+      EXPECT_EQ(answer.digest, sha1_hex(answer.data, chunk))
+          << "size " << answer.data.size() << ", chunk " << chunk;
+    }
+  }
+}
+
+} // namespace
+
+TEST(Sha1Test, portable) {
+  EXPECT_FALSE(sha1_set_cpu_extensions(false));
+  check_known_answers();
+  sha1_set_cpu_extensions(true);
+}
+
+TEST(Sha1Test, cpuExtensions) {
+  if (!sha1_set_cpu_extensions(true)) {
+    std::cerr << "This CPU has no SHA extensions, skipping" << std::endl;
+    return;
+  }
+  check_known_answers();
+}
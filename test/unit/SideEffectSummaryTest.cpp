@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "SideEffectSummary.h"
+
+#include <gtest/gtest.h>
+
+#include "CallGraph.h"
+#include "Creators.h"
+#include "IRAssembler.h"
+#include "RedexTest.h"
+#include "Walkers.h"
+
+namespace ptrs = local_pointers;
+
+struct SideEffectSummaryTest : public RedexTest {};
+
+TEST_F(SideEffectSummaryTest, sharedCacheInvalidatedByCalleeChange) {
+  ClassCreator creator(DexType::make_type("LFoo;"));
+  creator.set_super(type::java_lang_Object());
+  auto callee = assembler::method_from_string(R"(
+    (method (public static) "LFoo;.callee:()V"
+     (
+      (return-void)
+     )
+    )
+  )");
+  auto caller = assembler::method_from_string(R"(
+    (method (public static) "LFoo;.caller:()V"
+     (
+      (invoke-static () "LFoo;.callee:()V")
+      (return-void)
+     )
+    )
+  )");
+  caller->rstate.set_root();
+  creator.add_method(callee);
+  creator.add_method(caller);
+  Scope scope{creator.create()};
+
+  auto summarize = [&](side_effects::SideEffectSummaryCache* cache) {
+    walk::code(scope, [](DexMethod*, IRCode& code) {
+      code.build_cfg(/* editable */ false);
+      code.cfg().calculate_exit_block();
+    });
+    auto call_graph = call_graph::single_callee_graph(scope);
+    ptrs::SummaryCMap escape_summaries;
+    auto ptrs_fp_iter_map =
+        ptrs::analyze_scope(scope, call_graph, &escape_summaries);
+    side_effects::SummaryMap summaries;
+    side_effects::analyze_scope(scope, call_graph, *ptrs_fp_iter_map,
+                                &summaries, /* cache */ nullptr,
+                                &escape_summaries, cache);
+    return summaries.at(caller);
+  };
+
+  side_effects::SideEffectSummaryCache cache;
+  EXPECT_EQ(summarize(&cache).effects, side_effects::EFF_NONE);
+  EXPECT_EQ(cache.hits(), 0);
+  EXPECT_EQ(cache.misses(), 2);
+
+  EXPECT_EQ(summarize(&cache).effects, side_effects::EFF_NONE);
+  EXPECT_EQ(cache.hits(), 2);
+  EXPECT_EQ(cache.misses(), 2);
+
+  // A new side effect of the callee is one of the caller as well, even though
+  // the code of the caller is unchanged.
+  callee->set_code(assembler::ircode_from_string(R"(
+    (
+     (const v0 0)
+     (sput v0 "LFoo;.a:I")
+     (return-void)
+    )
+  )"));
+  EXPECT_EQ(summarize(&cache).effects, side_effects::EFF_WRITE_MAY_ESCAPE);
+  EXPECT_EQ(cache.hits(), 2);
+  EXPECT_EQ(cache.misses(), 4);
+}
@@ -75,16 +75,18 @@ class StringBuilderOutlinerTest : public RedexTest {
   }
 
  protected:
-  void run_outliner(IRCode* code) {
+  // Returns whether the outliner rewrote `code`.
+  bool run_outliner(IRCode* code) {
     Outliner outliner(m_config);
     outliner.analyze(*code);
     outliner.create_outline_helpers(&m_stores);
-    outliner.transform(code);
+    bool rewritten = outliner.transform(code);
 
     // Use OSDCE to remove any unused new-instance StringBuilder opcodes. When
     // running this pass against an app, the app's redex config should always
     // contain a run of OSDCE after StringBuilderOutlinerPass.
     remove_dead_instructions(code);
+    return rewritten;
   }
 
   void populate_summary_maps(
@@ -153,7 +155,7 @@ TEST_F(StringBuilderOutlinerTest, outlineTwo) {
     )
   )");
 
-  run_outliner(code.get());
+  EXPECT_TRUE(run_outliner(code.get()));
 
   auto expected_code = assembler::ircode_from_string(R"(
     (
@@ -549,7 +551,7 @@ TEST_F(StringBuilderOutlinerTest, mutableCharSequence) {
   )");
 
   auto expected = assembler::to_s_expr(code.get());
-  run_outliner(code.get());
+  EXPECT_FALSE(run_outliner(code.get()));
   EXPECT_EQ(expected, assembler::to_s_expr(code.get()));
 }
 
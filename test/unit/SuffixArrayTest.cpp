@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "SuffixArray.h"
+
+using namespace suffix_array;
+using ::testing::ElementsAre;
+
+TEST(SuffixArrayTest, banana) {
+  // b a n a n a
+  std::vector<Symbol> text{1, 0, 2, 0, 2, 0};
+  auto sa = build(text);
+  EXPECT_THAT(sa, ElementsAre(5, 3, 1, 0, 4, 2));
+  EXPECT_THAT(lcp(text, sa), ElementsAre(0, 1, 3, 0, 0, 2));
+  EXPECT_THAT(longest_repeats(text), ElementsAre(0, 3, 2, 3, 2, 1));
+}
+
+TEST(SuffixArrayTest, separatedRuns) {
+  // Two runs "x y z" and "x y w", each followed by a distinct separator.
+  std::vector<Symbol> text{0, 1, 2, 3, 0, 1, 4, 5};
+  EXPECT_THAT(longest_repeats(text), ElementsAre(2, 1, 0, 0, 2, 1, 0, 0));
+}
+
+TEST(SuffixArrayTest, empty) {
+  std::vector<Symbol> text;
+  EXPECT_TRUE(build(text).empty());
+  EXPECT_TRUE(longest_repeats(text).empty());
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "IRAssembler.h"
+#include "RedexTest.h"
+#include "RedexTestUtils.h"
+#include "SummaryCache.h"
+
+struct SummaryCacheTest : public RedexTest {};
+
+TEST_F(SummaryCacheTest, recordSaveFind) {
+  auto tmp_dir = redex::make_tmp_dir("redex_summary_cache_test_%%%%%%%%");
+  auto path = tmp_dir.path + "/Pass.side_effects.cache";
+
+  auto method = assembler::method_from_string(R"(
+    (method (public static) "LFoo;.bar:()V"
+     (
+      (invoke-static () "LFoo;.baz:()V")
+      (return-void)
+     )
+    )
+  )");
+  std::vector<std::string> dependencies{"LFoo;.baz:()V (0 ())"};
+  sparta::s_expr summary({sparta::s_expr("1"), sparta::s_expr()});
+  std::string key;
+  {
+    SummaryCache cache(path, "salt");
+    key = cache.key(method, dependencies);
+    ASSERT_FALSE(key.empty());
+    EXPECT_FALSE(cache.find(key));
+    EXPECT_EQ(1, cache.misses());
+    cache.record(key, summary);
+    cache.save();
+  }
+
+  {
+    SummaryCache cache(path, "salt");
+    EXPECT_EQ(key, cache.key(method, dependencies));
+    auto cached = cache.find(key);
+    ASSERT_TRUE(cached);
+    EXPECT_EQ(summary, *cached);
+    EXPECT_EQ(1, cache.hits());
+
+    // A changed callee summary or salt yields a different key.
+    EXPECT_NE(key, cache.key(method, {"LFoo;.baz:()V (1 ())"}));
+    EXPECT_NE(key, SummaryCache(path, "other salt").key(method, dependencies));
+
+    // So does changed code.
+    method->set_code(assembler::ircode_from_string(R"(
+      (
+       (return-void)
+      )
+    )"));
+    EXPECT_NE(key, cache.key(method, dependencies));
+    cache.save();
+  }
+
+  // The entry was found, so it was kept.
+  SummaryCache cache(path, "salt");
+  EXPECT_TRUE(cache.find(key));
+}
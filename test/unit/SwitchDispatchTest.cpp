@@ -5,6 +5,7 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <algorithm>
 #include <gtest/gtest.h>
 
 #include "ControlFlow.h"
@@ -71,3 +72,50 @@ TEST_F(SwitchDispatchTest, create_simple_dispatch) {
     ASSERT_EQ(method, nullptr);
   }
 }
+
+TEST_F(SwitchDispatchTest, create_virtual_dispatch_splits_at_tag_gaps) {
+  auto owner = DexType::make_type("Lbar;");
+  ClassCreator cc(owner);
+  cc.set_super(type::java_lang_Object());
+  cc.create();
+  auto type_tag_field =
+      DexField::make_field("Lbar;.$t:I")->make_concrete(ACC_PUBLIC);
+
+  // Two dense ranges of tags, 0..3 and 100..107.
+  std::vector<int> tags{0, 1, 2, 3};
+  for (int tag = 100; tag < 108; ++tag) {
+    tags.push_back(tag);
+  }
+  std::map<SwitchIndices, DexMethod*> indices_to_callee;
+  for (auto tag : tags) {
+    indices_to_callee[{tag}] = make_a_method(
+        "Lbar;.m" + std::to_string(tag) + ":(Lbar;)I", ACC_STATIC);
+  }
+  dispatch::Spec spec{owner,
+                      dispatch::Type::VIRTUAL,
+                      "dispatch",
+                      DexProto::make_proto(type::_int(),
+                                           DexTypeList::make_type_list({})),
+                      ACC_PUBLIC,
+                      type_tag_field,
+                      nullptr, // overridden_meth
+                      /* max_num_dispatch_target */ 5,
+                      /* type_tag_param_idx */ boost::none,
+                      /* keep_debug_info */ false};
+  auto dispatch = dispatch::create_virtual_dispatch(spec, indices_to_callee);
+
+  // Leaves hold at most 5 cases, and the first one stops short to end at 3.
+  std::vector<std::vector<int32_t>> leaf_keys;
+  for (auto sub_dispatch : dispatch.sub_dispatches) {
+    leaf_keys.emplace_back();
+    for (auto& mie : *sub_dispatch->get_code()) {
+      if (mie.type == MFLOW_TARGET && mie.target->type == BRANCH_MULTI) {
+        leaf_keys.back().push_back(mie.target->case_key);
+      }
+    }
+    std::sort(leaf_keys.back().begin(), leaf_keys.back().end());
+  }
+  std::vector<std::vector<int32_t>> expected{
+      {0, 1, 2, 3}, {100, 101, 102, 103, 104}, {105, 106, 107}};
+  EXPECT_EQ(leaf_keys, expected);
+}
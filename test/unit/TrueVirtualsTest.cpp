@@ -506,3 +506,22 @@ TEST_F(DevirtualizerTest, GenericRichHierarchy) {
                   "LA;.final1:()V", "LABA;.final2:()V", "LAA;.final1:(I)V",
                   "LAAB;.final2:()V", "LAAA;.final2:()V"));
 }
+
+TEST_F(DevirtualizerTest, CompactGraphAnswersAsGraph) {
+  std::vector<DexClass*> scope = create_scope_10();
+  auto graph = mog::build_graph(scope);
+  mog::CompactGraph compact_graph(*graph);
+  EXPECT_EQ(graph->nodes().size(), compact_graph.size());
+  for (const auto* cls : scope) {
+    for (const auto* method : cls->get_vmethods()) {
+      EXPECT_EQ(mog::get_overriding_methods(*graph, method),
+                mog::get_overriding_methods(compact_graph, method));
+      EXPECT_EQ(mog::get_overriding_methods(*graph, method, true),
+                mog::get_overriding_methods(compact_graph, method, true));
+      EXPECT_EQ(mog::get_overridden_methods(*graph, method, true),
+                mog::get_overridden_methods(compact_graph, method, true));
+      EXPECT_EQ(mog::is_true_virtual(*graph, method),
+                mog::is_true_virtual(compact_graph, method));
+    }
+  }
+}
@@ -10,6 +10,7 @@
 #include <gmock/gmock.h>
 
 #include "DexUtil.h"
+#include "IRAssembler.h"
 #include "RedexTest.h"
 
 struct WalkersTest : public RedexTest {};
@@ -36,3 +37,93 @@ TEST_F(WalkersTest, accumlate) {
       ::testing::UnorderedElementsAre(
           "LFoo;.bar:()V", "LFoo;.baz:()V", "LFoo;.qux:()V", "LFoo;.quux:()V"));
 }
+
+TEST_F(WalkersTest, reduce) {
+  Scope scope;
+  for (size_t i = 0; i < 100; ++i) {
+    auto name = "LFoo" + std::to_string(i) + ";";
+    ClassCreator cc(DexType::make_type(name.c_str()));
+    cc.set_super(type::java_lang_Object());
+    for (size_t j = 0; j <= i % 3; ++j) {
+      cc.add_method(
+          DexMethod::make_method(name + ".m" + std::to_string(j) + ":()V")
+              ->make_concrete(ACC_PUBLIC | ACC_STATIC, false));
+    }
+    scope.push_back(cc.create());
+  }
+
+  // Count the methods per number of the class, merging with a lambda.
+  using Counts = std::array<size_t, 3>;
+  auto counts = walk::parallel::reduce<Counts>(
+      scope,
+      [](DexMethod* m, Counts* acc) {
+        auto name = m->get_name()->str();
+        ++(*acc)[name.back() - '0'];
+      },
+      [](const Counts& counts, Counts* acc) {
+        for (size_t i = 0; i < counts.size(); ++i) {
+          (*acc)[i] += counts[i];
+        }
+      },
+      Counts{0, 0, 0},
+      /* num_threads */ 2);
+  EXPECT_EQ(counts, (Counts{100, 66, 33}));
+
+  size_t num_code = 0;
+  walk::code(scope, [&](DexMethod*, IRCode&) { ++num_code; });
+  EXPECT_EQ(0, num_code);
+}
+
+TEST_F(WalkersTest, batched) {
+  // Enough classes for the parallel walkers to group them into batches.
+  constexpr size_t num_threads = 2;
+  constexpr size_t num_classes = 200;
+  Scope scope;
+  std::unordered_set<std::string> expected;
+  for (size_t i = 0; i < num_classes; ++i) {
+    auto name = "LFoo" + std::to_string(i) + ";";
+    ClassCreator cc(DexType::make_type(name.c_str()));
+    cc.set_super(type::java_lang_Object());
+    auto method_name = name + ".bar:()V";
+    cc.add_method(DexMethod::make_method(method_name)
+                      ->make_concrete(ACC_PUBLIC | ACC_STATIC, false));
+    scope.push_back(cc.create());
+    expected.insert(method_name);
+  }
+
+  using StringSet = std::unordered_set<std::string>;
+  auto strings = walk::parallel::methods<StringSet, MergeContainers<StringSet>>(
+      scope, [&](DexMethod* m) { return StringSet{show(m)}; }, num_threads);
+  EXPECT_EQ(strings, expected);
+
+  std::atomic<size_t> num_visited{0};
+  walk::parallel::classes(
+      scope, [&](DexClass*) { ++num_visited; }, num_threads);
+  EXPECT_EQ(num_visited, num_classes);
+}
+
+TEST_F(WalkersTest, longestFirst) {
+  auto make_class = [](const std::string& name, size_t num_insns) {
+    ClassCreator cc(DexType::make_type(name.c_str()));
+    cc.set_super(type::java_lang_Object());
+    auto method = DexMethod::make_method(name + ".bar:()V")
+                      ->make_concrete(ACC_PUBLIC | ACC_STATIC, false);
+    std::string body = "(";
+    for (size_t i = 0; i < num_insns; ++i) {
+      body += "(const v0 0)";
+    }
+    body += "(return-void))";
+    method->set_code(assembler::ircode_from_string(body));
+    cc.add_method(method);
+    return cc.create();
+  };
+  Scope scope{make_class("LSmall;", 1), make_class("LMedium;", 10),
+              make_class("LLarge;", 100)};
+
+  // With a single thread, classes are visited in order of decreasing cost.
+  std::vector<std::string> order;
+  walk::parallel::classes(
+      scope, [&](DexClass* cls) { order.push_back(show(cls)); },
+      /* num_threads */ 1);
+  EXPECT_THAT(order, ::testing::ElementsAre("LLarge;", "LMedium;", "LSmall;"));
+}
@@ -8,6 +8,8 @@
 #include "ConstantPropagationPass.h"
 
 #include <gtest/gtest.h>
+#include <limits>
+#include <sstream>
 
 #include "ConstantPropagationTestUtil.h"
 #include "IRAssembler.h"
@@ -803,3 +805,43 @@ TEST(ConstantPropagation, ForwardBranchesSwitch) {
 )");
   EXPECT_CODE_EQ(code.get(), expected_code.get());
 }
+
+TEST(ConstantPropagation, HugeMethodInParallel) {
+  // A chain of loops, each with a conditional constant in its body.
+  std::ostringstream body;
+  body << "((load-param v0) (const v1 0)";
+  for (int i = 0; i < 1000; ++i) {
+    body << "(:loop" << i << ")"
+         << "(add-int/lit8 v1 v1 1)"
+         << "(if-nez v0 :skip" << i << ")"
+         << "(const v2 " << i << ")"
+         << "(:skip" << i << ")"
+         << "(if-lez v1 :loop" << i << ")";
+  }
+  body << "(return v2))";
+  auto code = assembler::ircode_from_string(body.str());
+  code->build_cfg(/* editable */ false);
+  auto& cfg = code->cfg();
+  ASSERT_GE(cfg.blocks().size(),
+            ir_analyzer::PARALLEL_FIXPOINT_MIN_NODES);
+
+  cp::intraprocedural::FixpointIterator parallel(
+      cfg, cp::ConstantPrimitiveAnalyzer());
+  // Several threads even on small machines.
+  parallel.set_parallel_threshold(ir_analyzer::PARALLEL_FIXPOINT_MIN_NODES,
+                                  /* num_threads */ 4);
+  parallel.run(ConstantEnvironment());
+  cp::intraprocedural::FixpointIterator sequential(
+      cfg, cp::ConstantPrimitiveAnalyzer());
+  sequential.set_parallel_threshold(std::numeric_limits<size_t>::max());
+  sequential.run(ConstantEnvironment());
+
+  for (auto* block : cfg.blocks()) {
+    EXPECT_TRUE(parallel.get_entry_state_at(block).equals(
+        sequential.get_entry_state_at(block)))
+        << "B" << block->id();
+    EXPECT_TRUE(parallel.get_exit_state_at(block).equals(
+        sequential.get_exit_state_at(block)))
+        << "B" << block->id();
+  }
+}
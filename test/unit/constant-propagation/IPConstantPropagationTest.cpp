@@ -1505,3 +1505,69 @@ TEST_F(InterproceduralConstantPropagationTest, whiteBoxReturnValues) {
             SignedConstantDomain::bottom());
   EXPECT_EQ(wps.get_return_value(returns_constant), SignedConstantDomain(1));
 }
+
+TEST_F(InterproceduralConstantPropagationTest, cachedIntraproceduralAnalyses) {
+  auto cls_ty = DexType::make_type("LFoo;");
+  ClassCreator creator(cls_ty);
+  creator.set_super(type::java_lang_Object());
+
+  auto returns_constant = assembler::method_from_string(R"(
+    (method (public static) "LFoo;.returnsConstant:()I"
+     (
+      (const v0 1)
+      (return v0)
+     )
+    )
+  )");
+  creator.add_method(returns_constant);
+
+  auto uses_return = assembler::method_from_string(R"(
+    (method (public static) "LFoo;.usesReturn:()I"
+     (
+      (invoke-static () "LFoo;.returnsConstant:()I")
+      (move-result v0)
+      (return v0)
+     )
+    )
+  )");
+  uses_return->rstate.set_root(); // Make this an entry point
+  creator.add_method(uses_return);
+
+  auto independent = assembler::method_from_string(R"(
+    (method (public static) "LFoo;.independent:()I"
+     (
+      (const v0 2)
+      (return v0)
+     )
+    )
+  )");
+  independent->rstate.set_root(); // Make this an entry point
+  creator.add_method(independent);
+
+  Scope scope{creator.create()};
+  walk::code(scope, [](DexMethod*, IRCode& code) {
+    code.build_cfg(/* editable */ false);
+    code.cfg().calculate_exit_block();
+  });
+
+  InterproceduralConstantPropagationPass::Config config;
+  config.max_heap_analysis_iterations = 2;
+  config.cache_intraprocedural_analyses = true;
+  auto fp_iter = InterproceduralConstantPropagationPass(config).analyze(
+      scope, &m_immut_analyzer_state);
+  auto& wps = fp_iter->get_whole_program_state();
+  EXPECT_EQ(wps.get_return_value(uses_return), SignedConstantDomain(1));
+  EXPECT_EQ(wps.get_return_value(independent), SignedConstantDomain(2));
+  EXPECT_GT(fp_iter->cache_hits(), 0);
+
+  // The analysis of a method that doesn't depend on the refined values is
+  // shared by all clients.
+  auto analysis = fp_iter->get_intraprocedural_analysis(independent);
+  EXPECT_EQ(analysis, fp_iter->get_intraprocedural_analysis(independent));
+
+  // The refined return value of the callee is visible in the caller.
+  auto& cfg = uses_return->get_code()->cfg();
+  auto exit_env = fp_iter->get_intraprocedural_analysis(uses_return)
+                      ->get_exit_state_at(cfg.exit_block());
+  EXPECT_EQ(exit_env.get(reg_t(0)), SignedConstantDomain(1));
+}
@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "SparseConstantPropagation.h"
+
+#include <gtest/gtest.h>
+
+#include "ConstantPropagationTestUtil.h"
+#include "IRAssembler.h"
+
+namespace {
+
+void do_sparse_const_prop(IRCode* code) {
+  code->build_cfg(/* editable */ false);
+  code->cfg().calculate_exit_block();
+  cp::intraprocedural::SparseFixpointIterator intra_cp(
+      code->cfg(), cp::ConstantPrimitiveAnalyzer());
+  intra_cp.run(ConstantEnvironment());
+  cp::Transform tf;
+  tf.apply_on_uneditable_cfg(
+      intra_cp, cp::WholeProgramState(), code, nullptr, nullptr);
+}
+
+// Both engines must agree on code whose constants don't depend on branch
+// refinements.
+void expect_same_as_dense(const std::string& s_expr) {
+  auto sparse_code = assembler::ircode_from_string(s_expr);
+  do_sparse_const_prop(sparse_code.get());
+  auto dense_code = assembler::ircode_from_string(s_expr);
+  do_const_prop(dense_code.get());
+  EXPECT_EQ(assembler::to_s_expr(sparse_code.get()),
+            assembler::to_s_expr(dense_code.get()));
+}
+
+} // namespace
+
+TEST_F(ConstantPropagationTest, SparseJoinOfConstants) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (load-param v0)
+      (if-eqz v0 :a)
+      (const v1 1)
+      (goto :join)
+      (:a)
+      (const v1 1)
+      (:join)
+      (if-eqz v1 :dead)
+      (return v1)
+      (:dead)
+      (const v1 0)
+      (return v1)
+    )
+)");
+
+  do_sparse_const_prop(code.get());
+
+  auto expected_code = assembler::ircode_from_string(R"(
+    (
+      (load-param v0)
+      (if-eqz v0 :a)
+      (const v1 1)
+      (goto :join)
+      (:a)
+      (const v1 1)
+      (:join)
+      (return v1)
+      (const v1 0)
+      (return v1)
+    )
+)");
+
+  EXPECT_EQ(assembler::to_s_expr(code.get()),
+            assembler::to_s_expr(expected_code.get()));
+}
+
+TEST_F(ConstantPropagationTest, SparseIgnoresUnexecutableDefinitions) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (const v0 0)
+      (if-nez v0 :dead)
+      (const v1 5)
+      (goto :join)
+      (:dead)
+      (const v1 7)
+      (:join)
+      (const v2 5)
+      (if-eq v1 v2 :ok)
+      (const v3 1)
+      (:ok)
+      (return-void)
+    )
+)");
+  code->build_cfg(/* editable */ false);
+  cp::intraprocedural::SparseFixpointIterator intra_cp(
+      code->cfg(), cp::ConstantPrimitiveAnalyzer());
+  intra_cp.run(ConstantEnvironment());
+
+  size_t executable = 0;
+  for (auto* block : code->cfg().blocks()) {
+    executable += intra_cp.is_executable(block);
+    for (auto& mie : InstructionIterable(block)) {
+      if (mie.insn->opcode() != OPCODE_CONST) {
+        continue;
+      }
+      auto value = intra_cp.get_value(mie.insn);
+      if (mie.insn->get_literal() == 7 || mie.insn->get_literal() == 1) {
+        // Neither the const in :dead nor the one on the fallthrough of the
+        // if-eq is ever executed.
+        EXPECT_TRUE(value.is_bottom());
+      } else {
+        EXPECT_TRUE(
+            value.equals(SignedConstantDomain(mie.insn->get_literal())));
+      }
+    }
+  }
+  EXPECT_EQ(4, executable);
+  code->clear_cfg();
+
+  expect_same_as_dense(R"(
+    (
+      (const v0 0)
+      (if-nez v0 :dead)
+      (const v1 5)
+      (goto :join)
+      (:dead)
+      (const v1 7)
+      (:join)
+      (const v2 5)
+      (if-eq v1 v2 :ok)
+      (const v3 1)
+      (:ok)
+      (return-void)
+    )
+)");
+}
+
+TEST_F(ConstantPropagationTest, SparseMatchesDenseOnLoops) {
+  expect_same_as_dense(R"(
+    (
+      (load-param v0)
+      (const v1 0)
+      (const v2 3)
+      (:loop)
+      (if-eqz v0 :end)
+      (add-int/lit8 v3 v2 1)
+      (add-int/lit8 v0 v0 -1)
+      (goto :loop)
+      (:end)
+      (if-lez v3 :dead)
+      (return v1)
+      (:dead)
+      (return v0)
+    )
+)");
+}
+
+TEST_F(ConstantPropagationTest, SparseMoveResults) {
+  expect_same_as_dense(R"(
+    (
+      (load-param-object v0)
+      (const v1 2)
+      (const v2 3)
+      (mul-int v3 v1 v2)
+      (array-length v0)
+      (move-result-pseudo v4)
+      (const v5 6)
+      (if-ne v3 v5 :dead)
+      (if-ltz v4 :dead)
+      (return v4)
+      (:dead)
+      (return v1)
+    )
+)");
+}
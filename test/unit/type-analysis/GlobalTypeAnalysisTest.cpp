@@ -216,6 +216,64 @@ TEST_F(GlobalTypeAnalysisTest, ReturnTypeTest) {
   EXPECT_EQ(bar_exit_env.get_reg_environment().get(0), get_type_domain("LO;"));
 }
 
+TEST_F(GlobalTypeAnalysisTest, CompactResultsTest) {
+  Scope scope;
+  prepare_scope(scope);
+
+  auto cls_a = DexType::make_type("LA;");
+  ClassCreator creator(cls_a);
+  creator.set_super(type::java_lang_Object());
+
+  auto meth_bar = assembler::method_from_string(R"(
+    (method (public static) "LA;.bar:(LO;)LO;"
+     (
+      (load-param-object v0)
+      (return-object v0)
+     )
+    )
+  )");
+  creator.add_method(meth_bar);
+
+  auto meth_foo = assembler::method_from_string(R"(
+    (method (public static) "LA;.foo:()V"
+     (
+      (new-instance "LO;")
+      (move-result-pseudo-object v0)
+      (invoke-direct (v0) "LO;.<init>:()V")
+      (invoke-static (v0) "LA;.bar:(LO;)LO;")
+      (move-result-object v1)
+      (return-void)
+     )
+    )
+  )");
+  meth_foo->rstate.set_root();
+  creator.add_method(meth_foo);
+  scope.push_back(creator.create());
+
+  walk::code(scope, [](DexMethod*, IRCode& code) {
+    code.build_cfg(/* editable */ false);
+  });
+
+  GlobalTypeAnalysis analysis(/* max_global_analysis_iteration */ 10,
+                              /* compact_results */ true);
+  auto gta = analysis.analyze(scope);
+  EXPECT_TRUE(gta->get_entry_state_at(gta->get_call_graph().node(meth_bar))
+                  .is_bottom());
+  auto wps = gta->get_whole_program_state();
+  EXPECT_EQ(wps.get_return_type(meth_bar), get_type_domain("LO;"));
+
+  // Arguments are still known to the local analyses.
+  auto lta = gta->get_local_analysis(meth_bar);
+  auto code = meth_bar->get_code();
+  auto bar_exit_env = lta->get_exit_state_at(code->cfg().exit_block());
+  EXPECT_EQ(bar_exit_env.get_reg_environment().get(0), get_type_domain("LO;"));
+
+  lta = gta->get_local_analysis(meth_foo);
+  code = meth_foo->get_code();
+  auto foo_exit_env = lta->get_exit_state_at(code->cfg().exit_block());
+  EXPECT_EQ(foo_exit_env.get_reg_environment().get(1), get_type_domain("LO;"));
+}
+
 TEST_F(GlobalTypeAnalysisTest, SimpleFieldTypeTest) {
   Scope scope;
   prepare_scope(scope);
@@ -0,0 +1,461 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "ApkWriter.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unordered_map>
+#include <vector>
+#include <zlib.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+
+#include "WorkQueue.h"
+
+namespace apk_writer {
+
+namespace {
+
+constexpr uint32_t LOCAL_HEADER_SIGNATURE = 0x04034b50;
+constexpr uint32_t CENTRAL_HEADER_SIGNATURE = 0x02014b50;
+constexpr uint32_t END_OF_CENTRAL_DIRECTORY_SIGNATURE = 0x06054b50;
+constexpr size_t LOCAL_HEADER_SIZE = 30;
+constexpr size_t CENTRAL_HEADER_SIZE = 46;
+constexpr size_t END_OF_CENTRAL_DIRECTORY_SIZE = 22;
+
+constexpr uint16_t METHOD_STORED = 0;
+constexpr uint16_t METHOD_DEFLATED = 8;
+constexpr uint16_t FLAG_UTF8 = 0x800;
+// Version 2.0, the same as Python's zipfile writes.
+constexpr uint16_t ZIP_VERSION = 20;
+constexpr uint16_t CREATED_BY_UNIX = 3 << 8;
+
+constexpr size_t LIB_ALIGNMENT = 4096;
+
+[[noreturn]] void fail(const std::string& msg) {
+  throw std::runtime_error(msg);
+}
+
+uint16_t read16(const uint8_t* p) { return p[0] | (p[1] << 8); }
+
+uint32_t read32(const uint8_t* p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+void put16(std::vector<uint8_t>* out, uint16_t v) {
+  out->push_back(v & 0xff);
+  out->push_back(v >> 8);
+}
+
+void put32(std::vector<uint8_t>* out, uint32_t v) {
+  put16(out, v & 0xffff);
+  put16(out, v >> 16);
+}
+
+/*
+ * A read-only view of a whole file. Empty files can't be mapped, and are
+ * represented by an empty view instead.
+ */
+class FileContents {
+ public:
+  explicit FileContents(const std::string& path) {
+    if (boost::filesystem::file_size(path) != 0) {
+      m_file.open(path);
+      if (!m_file.is_open()) {
+        fail("Cannot map " + path);
+      }
+    }
+  }
+
+  const uint8_t* data() const {
+    return m_file.is_open() ? reinterpret_cast<const uint8_t*>(m_file.data())
+                            : nullptr;
+  }
+
+  size_t size() const { return m_file.is_open() ? m_file.size() : 0; }
+
+ private:
+  boost::iostreams::mapped_file_source m_file;
+};
+
+struct InputEntry {
+  uint16_t method;
+  uint32_t crc;
+  uint32_t compressed_size;
+  uint32_t size;
+  const uint8_t* data;
+};
+
+std::unordered_map<std::string, InputEntry> read_entries(
+    const FileContents& apk) {
+  auto data = apk.data();
+  auto size = apk.size();
+  if (size < END_OF_CENTRAL_DIRECTORY_SIZE) {
+    fail("Input APK is too small");
+  }
+  // The end of central directory record is followed by a comment of at most
+  // 64k.
+  size_t lowest = size > END_OF_CENTRAL_DIRECTORY_SIZE + 0xffff
+                      ? size - END_OF_CENTRAL_DIRECTORY_SIZE - 0xffff
+                      : 0;
+  size_t eocd = size - END_OF_CENTRAL_DIRECTORY_SIZE;
+  while (read32(data + eocd) != END_OF_CENTRAL_DIRECTORY_SIGNATURE) {
+    if (eocd == lowest) {
+      fail("Input APK has no end of central directory");
+    }
+    --eocd;
+  }
+  size_t count = read16(data + eocd + 10);
+  size_t pos = read32(data + eocd + 16);
+
+  std::unordered_map<std::string, InputEntry> entries;
+  for (size_t i = 0; i < count; ++i) {
+    if (pos + CENTRAL_HEADER_SIZE > size ||
+        read32(data + pos) != CENTRAL_HEADER_SIGNATURE) {
+      fail("Malformed central directory in input APK");
+    }
+    const uint8_t* header = data + pos;
+    InputEntry entry;
+    entry.method = read16(header + 10);
+    entry.crc = read32(header + 16);
+    entry.compressed_size = read32(header + 20);
+    entry.size = read32(header + 24);
+    size_t name_len = read16(header + 28);
+    size_t extra_len = read16(header + 30);
+    size_t comment_len = read16(header + 32);
+    size_t local = read32(header + 42);
+    std::string name(reinterpret_cast<const char*>(header) +
+                         CENTRAL_HEADER_SIZE,
+                     name_len);
+    pos += CENTRAL_HEADER_SIZE + name_len + extra_len + comment_len;
+
+    if (local + LOCAL_HEADER_SIZE > size ||
+        read32(data + local) != LOCAL_HEADER_SIGNATURE) {
+      fail("Malformed local header for " + name + " in input APK");
+    }
+    size_t start = local + LOCAL_HEADER_SIZE + read16(data + local + 26) +
+                   read16(data + local + 28);
+    if (start + entry.compressed_size > size) {
+      fail("Truncated data for " + name + " in input APK");
+    }
+    entry.data = data + start;
+    entries.emplace(std::move(name), entry);
+  }
+  return entries;
+}
+
+/*
+ * Lists the files under :dir the way os.walk does in ZipManager: the sorted
+ * files of a directory first, then its sorted subdirectories, recursively.
+ */
+void list_files(const boost::filesystem::path& dir,
+                const std::string& prefix,
+                std::vector<std::pair<std::string, std::string>>* files) {
+  std::vector<std::string> file_names;
+  std::vector<std::string> dir_names;
+  for (const auto& it : boost::filesystem::directory_iterator(dir)) {
+    auto name = it.path().filename().string();
+    // os.walk doesn't follow symbolic links to directories.
+    if (boost::filesystem::is_directory(it.symlink_status())) {
+      dir_names.push_back(std::move(name));
+    } else if (!boost::filesystem::is_directory(it.status())) {
+      file_names.push_back(std::move(name));
+    }
+  }
+  std::sort(file_names.begin(), file_names.end());
+  std::sort(dir_names.begin(), dir_names.end());
+  for (const auto& name : file_names) {
+    files->emplace_back(prefix + name, (dir / name).string());
+  }
+  for (const auto& name : dir_names) {
+    list_files(dir / name, prefix + name + "/", files);
+  }
+}
+
+struct OutputEntry {
+  std::string name;
+  std::string path;
+  uint16_t method{METHOD_DEFLATED};
+  uint16_t dos_time{0};
+  uint16_t dos_date{0};
+  uint32_t mode{0};
+  uint32_t crc{0};
+  uint32_t size{0};
+  uint32_t compressed_size{0};
+  // The unchanged compressed bytes from the input APK, if any.
+  const uint8_t* copied{nullptr};
+  std::vector<uint8_t> deflated;
+};
+
+void set_timestamp(time_t mtime, OutputEntry* entry) {
+  struct tm tm;
+  localtime_r(&mtime, &tm);
+  if (tm.tm_year < 80) {
+    entry->dos_time = 0;
+    entry->dos_date = (1 << 5) | 1;
+    return;
+  }
+  entry->dos_time = (tm.tm_hour << 11) | (tm.tm_min << 5) | (tm.tm_sec / 2);
+  entry->dos_date =
+      ((tm.tm_year - 80) << 9) | ((tm.tm_mon + 1) << 5) | tm.tm_mday;
+}
+
+std::vector<uint8_t> deflate_raw(const uint8_t* data, size_t size) {
+  z_stream zs;
+  memset(&zs, 0, sizeof(zs));
+  // Negative window bits produce raw deflate data, without a zlib header.
+  if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    fail("deflateInit2 failed");
+  }
+  std::vector<uint8_t> out(deflateBound(&zs, size));
+  zs.next_in = const_cast<Bytef*>(data);
+  zs.avail_in = size;
+  zs.next_out = out.data();
+  zs.avail_out = out.size();
+  auto ret = deflate(&zs, Z_FINISH);
+  out.resize(zs.total_out);
+  deflateEnd(&zs);
+  if (ret != Z_STREAM_END) {
+    fail("deflate failed");
+  }
+  return out;
+}
+
+/*
+ * Works out the contents of :entry, which the single-threaded writing pass
+ * then only has to copy.
+ */
+void prepare(const std::unordered_map<std::string, InputEntry>& input_entries,
+             OutputEntry* entry) {
+  struct stat st;
+  if (stat(entry->path.c_str(), &st) != 0) {
+    fail("Cannot stat " + entry->path);
+  }
+  if ((uint64_t)st.st_size > std::numeric_limits<uint32_t>::max()) {
+    fail(entry->path + " is too large for a zip without zip64 extensions");
+  }
+  set_timestamp(st.st_mtime, entry);
+  entry->mode = st.st_mode & 0xffff;
+
+  FileContents contents(entry->path);
+  entry->size = contents.size();
+  entry->crc = crc32(0, contents.data(), contents.size());
+
+  auto it = input_entries.find(entry->name);
+  if (it != input_entries.end()) {
+    const auto& input = it->second;
+    entry->method =
+        input.method == METHOD_STORED ? METHOD_STORED : METHOD_DEFLATED;
+    if (input.method == entry->method && input.size == entry->size &&
+        input.crc == entry->crc) {
+      entry->copied = input.data;
+      entry->compressed_size = input.compressed_size;
+      return;
+    }
+  }
+  if (entry->method == METHOD_STORED) {
+    entry->compressed_size = entry->size;
+  } else {
+    entry->deflated = deflate_raw(contents.data(), contents.size());
+    if (entry->deflated.size() > std::numeric_limits<uint32_t>::max()) {
+      fail(entry->path + " is too large for a zip without zip64 extensions");
+    }
+    entry->compressed_size = entry->deflated.size();
+  }
+}
+
+bool ends_with(const std::string& s, const std::string& suffix) {
+  return s.size() >= suffix.size() &&
+         s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+class OutputFile {
+ public:
+  explicit OutputFile(const std::string& path)
+      : m_path(path), m_file(fopen(path.c_str(), "wb")) {
+    if (m_file == nullptr) {
+      fail("Cannot open " + path + " for writing");
+    }
+  }
+
+  ~OutputFile() {
+    if (m_file != nullptr) {
+      fclose(m_file);
+    }
+  }
+
+  void write(const void* data, size_t size) {
+    if (size != 0 && fwrite(data, 1, size, m_file) != size) {
+      fail("Cannot write to " + m_path);
+    }
+    m_offset += size;
+  }
+
+  void write(const std::vector<uint8_t>& data) {
+    write(data.data(), data.size());
+  }
+
+  void close() {
+    auto ret = fclose(m_file);
+    m_file = nullptr;
+    if (ret != 0) {
+      fail("Cannot write to " + m_path);
+    }
+  }
+
+  uint64_t offset() const { return m_offset; }
+
+ private:
+  std::string m_path;
+  FILE* m_file;
+  uint64_t m_offset{0};
+};
+
+void check_offset(uint64_t offset) {
+  if (offset > std::numeric_limits<uint32_t>::max()) {
+    fail("Output APK is too large for a zip without zip64 extensions");
+  }
+}
+
+} // namespace
+
+Stats write_apk(const std::string& input_apk,
+                const std::string& directory,
+                const std::string& output_apk,
+                const Options& options) {
+  FileContents input(input_apk);
+  auto input_entries = read_entries(input);
+
+  std::vector<std::pair<std::string, std::string>> files;
+  list_files(directory, "", &files);
+  if (files.size() > std::numeric_limits<uint16_t>::max()) {
+    fail("Too many entries for a zip without zip64 extensions");
+  }
+  std::vector<OutputEntry> entries(files.size());
+  for (size_t i = 0; i < files.size(); ++i) {
+    entries[i].name = std::move(files[i].first);
+    entries[i].path = std::move(files[i].second);
+  }
+
+  // Checksumming and compressing are the expensive parts, do them in
+  // parallel.
+  auto wq = workqueue_foreach<OutputEntry*>(
+      [&](OutputEntry* entry) { prepare(input_entries, entry); });
+  for (auto& entry : entries) {
+    wq.add_item(&entry);
+  }
+  wq.run_all();
+
+  Stats stats;
+  OutputFile out(output_apk);
+  std::vector<uint8_t> central_directory;
+  std::vector<uint8_t> header;
+  for (auto& entry : entries) {
+    uint64_t offset = out.offset();
+    check_offset(offset);
+    uint16_t flags = 0;
+    if (std::any_of(entry.name.begin(), entry.name.end(),
+                    [](char c) { return c & 0x80; })) {
+      flags |= FLAG_UTF8;
+    }
+
+    // Stored entries are padded with zeroes in the extra field, so that their
+    // data starts at the requested alignment.
+    size_t padding = 0;
+    if (entry.method == METHOD_STORED) {
+      size_t alignment = options.page_align_libs && ends_with(entry.name, ".so")
+                             ? LIB_ALIGNMENT
+                             : options.alignment;
+      if (alignment > 1) {
+        auto data_offset = offset + LOCAL_HEADER_SIZE + entry.name.size();
+        padding = (alignment - data_offset % alignment) % alignment;
+      }
+    }
+
+    header.clear();
+    put32(&header, LOCAL_HEADER_SIGNATURE);
+    put16(&header, ZIP_VERSION);
+    put16(&header, flags);
+    put16(&header, entry.method);
+    put16(&header, entry.dos_time);
+    put16(&header, entry.dos_date);
+    put32(&header, entry.crc);
+    put32(&header, entry.compressed_size);
+    put32(&header, entry.size);
+    put16(&header, entry.name.size());
+    put16(&header, padding);
+    header.insert(header.end(), entry.name.begin(), entry.name.end());
+    header.resize(header.size() + padding, 0);
+    out.write(header);
+
+    if (entry.copied != nullptr) {
+      out.write(entry.copied, entry.compressed_size);
+      ++stats.copied;
+    } else if (entry.method == METHOD_STORED) {
+      FileContents contents(entry.path);
+      if (contents.size() != entry.size) {
+        fail(entry.path + " changed while writing " + output_apk);
+      }
+      out.write(contents.data(), contents.size());
+      ++stats.stored;
+    } else {
+      out.write(entry.deflated);
+      std::vector<uint8_t>().swap(entry.deflated);
+      ++stats.deflated;
+    }
+
+    put32(&central_directory, CENTRAL_HEADER_SIGNATURE);
+    put16(&central_directory, CREATED_BY_UNIX | ZIP_VERSION);
+    put16(&central_directory, ZIP_VERSION);
+    put16(&central_directory, flags);
+    put16(&central_directory, entry.method);
+    put16(&central_directory, entry.dos_time);
+    put16(&central_directory, entry.dos_date);
+    put32(&central_directory, entry.crc);
+    put32(&central_directory, entry.compressed_size);
+    put32(&central_directory, entry.size);
+    put16(&central_directory, entry.name.size());
+    put16(&central_directory, 0); // extra field length
+    put16(&central_directory, 0); // comment length
+    put16(&central_directory, 0); // disk number
+    put16(&central_directory, 0); // internal attributes
+    put32(&central_directory, entry.mode << 16);
+    put32(&central_directory, offset);
+    central_directory.insert(
+        central_directory.end(), entry.name.begin(), entry.name.end());
+  }
+
+  uint64_t central_directory_offset = out.offset();
+  check_offset(central_directory_offset + central_directory.size());
+  out.write(central_directory);
+
+  header.clear();
+  put32(&header, END_OF_CENTRAL_DIRECTORY_SIGNATURE);
+  put16(&header, 0); // disk number
+  put16(&header, 0); // disk with the central directory
+  put16(&header, entries.size());
+  put16(&header, entries.size());
+  put32(&header, central_directory.size());
+  put32(&header, central_directory_offset);
+  put16(&header, 0); // comment length
+  out.write(header);
+  out.close();
+
+  stats.entries = entries.size();
+  return stats;
+}
+
+} // namespace apk_writer
@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace apk_writer {
+
+struct Options {
+  // Alignment of the data of stored (uncompressed) entries, as zipalign's.
+  size_t alignment{4};
+  // Whether to align stored .so files to page boundaries, as zipalign -p.
+  bool page_align_libs{false};
+};
+
+struct Stats {
+  size_t entries{0};
+  // Entries whose compressed bytes were copied as-is from the input APK.
+  size_t copied{0};
+  // Entries that had to be deflated again.
+  size_t deflated{0};
+  // Entries that had to be stored again.
+  size_t stored{0};
+};
+
+/*
+ * Packages every file under :directory into :output_apk, in the same order as
+ * redex.py's ZipManager, and with the data of stored entries aligned the way
+ * zipalign would do it.
+ *
+ * Files that also exist in :input_apk keep its compression method. Those whose
+ * contents did not change are copied from it without being recompressed; the
+ * others are compressed in parallel.
+ *
+ * Throws std::runtime_error on malformed input or I/O errors.
+ */
+Stats write_apk(const std::string& input_apk,
+                const std::string& directory,
+                const std::string& output_apk,
+                const Options& options);
+
+} // namespace apk_writer
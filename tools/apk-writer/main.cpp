@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <exception>
+
+#include "ApkWriter.h"
+
+static const char usage_string[] =
+    "ReDex, APK writer\n"
+    "\nredex-apk-writer packages an extracted APK directory into an aligned "
+    "APK.\n"
+    "Entries that are unchanged from the input APK are copied without being "
+    "recompressed.\n"
+    "\n"
+    "Usage:\n"
+    "\tredex-apk-writer [-a <alignment>] [-p] <input.apk> <directory> "
+    "<output.apk>\n"
+    "\noptions:\n"
+    "-h, --help: help summary\n"
+    "-a, --alignment=<n>: alignment of stored entries, 4 by default\n"
+    "-p, --page-align-libs: page-align stored .so files\n";
+
+int main(int argc, char* argv[]) {
+  apk_writer::Options options;
+
+  static const struct option long_options[] = {
+      {"help", no_argument, nullptr, 'h'},
+      {"alignment", required_argument, nullptr, 'a'},
+      {"page-align-libs", no_argument, nullptr, 'p'},
+      {nullptr, 0, nullptr, 0},
+  };
+
+  int c;
+  while ((c = getopt_long(argc, argv, "ha:p", long_options, nullptr)) != -1) {
+    switch (c) {
+    case 'a':
+      options.alignment = strtoul(optarg, nullptr, 10);
+      break;
+    case 'p':
+      options.page_align_libs = true;
+      break;
+    case 'h':
+      puts(usage_string);
+      return 0;
+    default:
+      fputs(usage_string, stderr);
+      return 1;
+    }
+  }
+
+  if (argc - optind != 3) {
+    fputs(usage_string, stderr);
+    return 1;
+  }
+
+  try {
+    auto stats = apk_writer::write_apk(
+        argv[optind], argv[optind + 1], argv[optind + 2], options);
+    fprintf(stderr,
+            "Wrote %zu entries: %zu copied, %zu deflated, %zu stored\n",
+            stats.entries,
+            stats.copied,
+            stats.deflated,
+            stats.stored);
+  } catch (const std::exception& e) {
+    fprintf(stderr, "redex-apk-writer: %s\n", e.what());
+    return 1;
+  }
+  return 0;
+}
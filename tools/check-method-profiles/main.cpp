@@ -15,10 +15,30 @@ int main(int argc, char* argv[]) {
       std::string("-h") == argv[1]) {
     // No args (or help), print usage.
     std::cerr << "Usage: check-method-profiles PROF-FILE [PROF-FILE...]"
-              << std::endl;
+              << std::endl
+              << "       check-method-profiles --to-binary PROF-FILE OUT-FILE"
+              << std::endl
+              << "PROF-FILE may be a csv file or a binary one." << std::endl;
     return argc == 1 ? 1 : 0;
   }
 
+  if (std::string("--to-binary") == argv[1]) {
+    if (argc != 4) {
+      std::cerr << "--to-binary takes an input and an output file"
+                << std::endl;
+      return 1;
+    }
+    RedexContext rc;
+    g_redex = &rc;
+    bool success =
+        method_profiles::MethodProfiles::convert_to_binary(argv[2], argv[3]);
+    g_redex = nullptr;
+    if (!success) {
+      std::cerr << "Failed converting " << argv[2] << std::endl;
+    }
+    return success ? 0 : 1;
+  }
+
   bool fail = false;
   for (int i = 1; i < argc; ++i) {
     std::cout << "Processing " << argv[i] << std::endl;
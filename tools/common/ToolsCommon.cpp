@@ -133,17 +133,23 @@ void load_intermediate_dex(const std::string& input_ir_dir,
                            const Json::Value& dex_files,
                            DexStoresVector& stores) {
   Timer t("Load intermediate dex");
-  dex_stats_t dex_stats;
+  // Load the dexes of all stores together, then hand them out in order.
+  std::vector<std::string> locations;
+  std::vector<size_t> store_indices;
   for (const Json::Value& store_files : dex_files) {
     DexStore store(store_files["name"].asString());
     stores.emplace_back(std::move(store));
     for (const Json::Value& file_name : store_files["list"]) {
       auto location = boost::filesystem::path(input_ir_dir);
       location /= file_name.asString();
-      DexClasses classes = load_classes_from_dex(location.c_str(), &dex_stats);
-      stores.back().add_classes(std::move(classes));
+      locations.push_back(location.string());
+      store_indices.push_back(stores.size() - 1);
     }
   }
+  auto dexen = load_classes_from_dexes(locations, /* stats */ nullptr);
+  for (size_t i = 0; i < dexen.size(); ++i) {
+    stores[store_indices[i]].add_classes(std::move(dexen[i]));
+  }
 }
 
 /**
@@ -248,35 +254,37 @@ void load_classes_from_dexes_and_metadata(
     std::vector<dex_stats_t>& input_dexes_stats) {
   always_assert_log(!stores.empty(),
                     "Cannot load classes into empty DexStoresVector");
+  // Collect all dexes up front, so that they can be loaded together, along
+  // with the index of the store that each goes into.
+  std::vector<std::string> locations;
+  std::vector<size_t> store_indices;
   for (const auto& filename : dex_files) {
     if (filename.size() >= 5 &&
         filename.compare(filename.size() - 4, 4, ".dex") == 0) {
-      assert_dex_magic_consistency(stores[0].get_dex_magic(),
-                                   load_dex_magic_from_dex(filename.c_str()));
-      dex_stats_t dex_stats;
-      DexClasses classes = load_classes_from_dex(filename.c_str(), &dex_stats);
-      input_totals += dex_stats;
-      input_dexes_stats.push_back(dex_stats);
-      stores[0].add_classes(std::move(classes));
+      locations.push_back(filename);
+      store_indices.push_back(0);
     } else {
       DexMetadata store_metadata;
       store_metadata.parse(filename);
-      DexStore store(store_metadata);
       for (const auto& file_path : store_metadata.get_files()) {
-        assert_dex_magic_consistency(
-            stores[0].get_dex_magic(),
-            load_dex_magic_from_dex(file_path.c_str()));
-        dex_stats_t dex_stats;
-        DexClasses classes =
-            load_classes_from_dex(file_path.c_str(), &dex_stats);
-
-        input_totals += dex_stats;
-        input_dexes_stats.push_back(dex_stats);
-        store.add_classes(std::move(classes));
+        locations.push_back(file_path);
+        store_indices.push_back(stores.size());
       }
-      stores.emplace_back(std::move(store));
+      stores.emplace_back(store_metadata);
     }
   }
+  for (const auto& location : locations) {
+    assert_dex_magic_consistency(stores[0].get_dex_magic(),
+                                 load_dex_magic_from_dex(location.c_str()));
+  }
+
+  std::vector<dex_stats_t> dexes_stats;
+  auto dexes = load_classes_from_dexes(locations, &dexes_stats);
+  for (size_t i = 0; i < dexes.size(); ++i) {
+    input_totals += dexes_stats[i];
+    input_dexes_stats.push_back(dexes_stats[i]);
+    stores[store_indices[i]].add_classes(std::move(dexes[i]));
+  }
 }
 
 /**
@@ -5,16 +5,24 @@
  * LICENSE file in the root directory of this source tree.
  */
 
-#include <boost/scope_exit.hpp>
+#include <cerrno>
+#include <cstring>
 #include <fcntl.h>
 #include <iostream>
 #include <memory>
 #include <string>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 #include "PositionMap.h"
 
+PositionMap::~PositionMap() {
+  if (m_mapping != nullptr) {
+    munmap(m_mapping, m_mapping_size);
+  }
+}
+
 std::unique_ptr<PositionMap> read_map(const char* filename) {
   int fd = open(filename, O_RDONLY);
   if (fd == -1) {
@@ -26,44 +34,73 @@ std::unique_ptr<PositionMap> read_map(const char* filename) {
   if (fstat(fd, &buf)) {
     std::cerr << "Cannot fstat file (" << filename
               << ") with error: " << strerror(errno) << std::endl;
+    close(fd);
     return nullptr;
   }
-  uint8_t* mapping = (uint8_t*)mmap(
-      nullptr, buf.st_size, PROT_READ, MAP_FILE | MAP_SHARED, fd, 0);
-  uint32_t magic = *(uint32_t*)mapping;
-  mapping += sizeof(uint32_t);
+  void* mapping =
+      mmap(nullptr, buf.st_size, PROT_READ, MAP_FILE | MAP_SHARED, fd, 0);
+  close(fd);
   if (mapping == MAP_FAILED) {
     std::cerr << "mmap failed for file (" << filename
               << ") with error: " << strerror(errno) << std::endl;
     return nullptr;
   }
-  BOOST_SCOPE_EXIT_ALL(=, &buf) { munmap(mapping, buf.st_size); };
-  if (magic != 0xfaceb000) {
+  std::unique_ptr<PositionMap> map(new PositionMap());
+  map->m_mapping = mapping;
+  map->m_mapping_size = buf.st_size;
+
+  const uint8_t* cur = (const uint8_t*)mapping;
+  const uint8_t* end = cur + buf.st_size;
+  auto read_u32 = [&](uint32_t* value) {
+    if (end - cur < (ptrdiff_t)sizeof(uint32_t)) {
+      return false;
+    }
+    memcpy(value, cur, sizeof(uint32_t));
+    cur += sizeof(uint32_t);
+    return true;
+  };
+  uint32_t magic;
+  if (!read_u32(&magic) || magic != 0xfaceb000) {
     std::cerr << "Magic number mismatch\n";
     return nullptr;
   }
-  uint32_t version = *(uint32_t*)mapping;
-  mapping += sizeof(uint32_t);
-  if (version != 2) {
+  uint32_t version;
+  if (!read_u32(&version) || version != 2) {
     std::cerr << "Version mismatch\n";
     return nullptr;
   }
 
-  std::unique_ptr<PositionMap> map(new PositionMap());
-  std::vector<std::string> string_pool;
-  uint32_t spool_count = *(uint32_t*)mapping;
-  mapping += sizeof(uint32_t);
+  uint32_t spool_count;
+  if (!read_u32(&spool_count)) {
+    std::cerr << "Truncated map file\n";
+    return nullptr;
+  }
+  map->string_pool.reserve(spool_count);
   for (uint32_t i = 0; i < spool_count; ++i) {
-    uint32_t ssize = *(uint32_t*)mapping;
-    mapping += sizeof(uint32_t);
-    map->string_pool.emplace_back((const char*)mapping, ssize);
-    mapping += ssize;
+    uint32_t ssize;
+    if (!read_u32(&ssize) || (size_t)(end - cur) < ssize) {
+      std::cerr << "Truncated map file\n";
+      return nullptr;
+    }
+    map->string_pool.emplace_back((const char*)cur, ssize);
+    cur += ssize;
+  }
+  uint32_t pos_count;
+  if (!read_u32(&pos_count) ||
+      (size_t)(end - cur) < (size_t)pos_count * sizeof(PositionItem)) {
+    std::cerr << "Truncated map file\n";
+    return nullptr;
   }
-  uint32_t pos_count = *(uint32_t*)mapping;
-  mapping += sizeof(uint32_t);
-  map->positions.reset(new PositionItem[pos_count]);
+  map->positions = (const PositionItem*)cur;
   map->positions_size = pos_count;
-  memcpy(map->positions.get(), mapping, pos_count * sizeof(PositionItem));
+  for (size_t i = 0; i < map->positions_size; ++i) {
+    const auto& pi = map->positions[i];
+    if (pi.class_id >= spool_count || pi.method_id >= spool_count ||
+        pi.file_id >= spool_count) {
+      std::cerr << "Position " << i << " refers to a missing string\n";
+      return nullptr;
+    }
+  }
   return map;
 }
 
@@ -79,3 +116,25 @@ std::vector<Position> get_stack(const PositionMap& map, int64_t idx) {
   }
   return stack;
 }
+
+void append_stack(const PositionMap& map,
+                  int64_t line,
+                  const std::string& prefix,
+                  std::string* out) {
+  // A malformed map could have a cycle of parents; no real stack is deeper
+  // than the number of positions.
+  size_t depth = 0;
+  for (auto* pi = map.get_position(line);
+       pi != nullptr && depth++ < map.positions_size;
+       pi = map.get_position(pi->parent)) {
+    *out += prefix;
+    *out += map.string_pool[pi->class_id];
+    *out += '.';
+    *out += map.string_pool[pi->method_id];
+    *out += '(';
+    *out += map.string_pool[pi->file_id];
+    *out += ':';
+    *out += std::to_string(pi->line);
+    *out += ")\n";
+  }
+}
@@ -29,11 +29,44 @@ struct Position {
       : cls(cls), method(method), filename(filename), line(line) {}
 };
 
+/*
+ * A v2 line number map, as written by RealPositionMapper. The positions are
+ * read in place from the mapped file: the line numbers in the dex are indices
+ * into them, so looking one up doesn't need any search.
+ */
 struct PositionMap {
   std::vector<std::string> string_pool;
-  std::unique_ptr<PositionItem[]> positions;
-  size_t positions_size;
+  const PositionItem* positions{nullptr};
+  size_t positions_size{0};
+
+  PositionMap() = default;
+  PositionMap(const PositionMap&) = delete;
+  PositionMap& operator=(const PositionMap&) = delete;
+  ~PositionMap();
+
+  // The position that the dex line number :line stands for, or nullptr if
+  // there is none.
+  const PositionItem* get_position(int64_t line) const {
+    return line > 0 && (size_t)line <= positions_size ? &positions[line - 1]
+                                                      : nullptr;
+  }
+
+ private:
+  friend std::unique_ptr<PositionMap> read_map(const char* filename);
+  void* m_mapping{nullptr};
+  size_t m_mapping_size{0};
 };
 
 std::unique_ptr<PositionMap> read_map(const char* filename);
 std::vector<Position> get_stack(const PositionMap& map, int64_t idx);
+
+/*
+ * Append the frames that the dex line number :line expands to, innermost
+ * first, in the form "<prefix>cls.method(file:line)\n". This is what
+ * symbolicating a single stack frame amounts to, without building any
+ * Positions.
+ */
+void append_stack(const PositionMap& map,
+                  int64_t line,
+                  const std::string& prefix,
+                  std::string* out);
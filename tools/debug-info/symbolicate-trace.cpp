@@ -5,31 +5,143 @@
  * LICENSE file in the root directory of this source tree.
  */
 
-#include <boost/regex.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "PositionMap.h"
 
-boost::regex trace_regex(R"/(((\s+at\s+)[^(]*)\(:(\d+)\)\s?)/");
+namespace {
+
+/*
+ * Matches the whole of :line against the frames Redex emits for remapped
+ * positions, i.e. ((\s+at\s+)[^(]*)\(:(\d+)\)\s? and sets :prefix to the
+ * \s+at\s+ part and :line_number to the digits.
+ */
+bool parse_frame(const std::string& line,
+                 std::string* prefix,
+                 int64_t* line_number) {
+  size_t i = 0;
+  size_t size = line.size();
+  auto skip_spaces = [&]() {
+    size_t start = i;
+    while (i < size && isspace((unsigned char)line[i])) {
+      i++;
+    }
+    return i > start;
+  };
+  if (!skip_spaces() || line.compare(i, 2, "at") != 0) {
+    return false;
+  }
+  i += 2;
+  if (!skip_spaces()) {
+    return false;
+  }
+  prefix->assign(line, 0, i);
+  i = line.find('(', i);
+  if (i == std::string::npos || line.compare(i, 2, "(:") != 0) {
+    return false;
+  }
+  i += 2;
+  size_t digits = i;
+  int64_t value = 0;
+  while (i < size && isdigit((unsigned char)line[i])) {
+    // Saturate rather than overflow; such a line number is out of range
+    // anyway.
+    if (value < INT64_MAX / 10) {
+      value = value * 10 + (line[i] - '0');
+    }
+    i++;
+  }
+  if (i == digits || i == size || line[i] != ')') {
+    return false;
+  }
+  i++;
+  if (i < size && isspace((unsigned char)line[i])) {
+    i++;
+  }
+  if (i != size) {
+    return false;
+  }
+  *line_number = value;
+  return true;
+}
+
+void symbolicate(const PositionMap& map, std::istream& in, std::ostream& out) {
+  std::string prefix;
+  std::string buffer;
+  for (std::string line; std::getline(in, line);) {
+    int64_t line_number;
+    if (parse_frame(line, &prefix, &line_number)) {
+      append_stack(map, line_number, prefix, &buffer);
+    } else {
+      buffer += line;
+      buffer += '\n';
+    }
+    if (buffer.size() >= (1 << 16)) {
+      out.write(buffer.data(), buffer.size());
+      buffer.clear();
+    }
+  }
+  out.write(buffer.data(), buffer.size());
+  out.flush();
+}
+
+} // namespace
 
 int main(int argc, char** argv) {
   if (argc < 2) {
-    std::cerr << "Usage: cat trace | remap mapping_file\n";
+    std::cerr << "Usage: cat trace | remap mapping_file\n"
+              << "       remap mapping_file trace_file...\n"
+              << "The second form writes each trace_file, symbolicated, to "
+                 "trace_file.symbolicated\n";
     abort();
   }
   auto map = read_map(argv[1]);
-  for (std::string line; std::getline(std::cin, line);) {
-    boost::smatch matches;
-    if (boost::regex_match(line, matches, trace_regex)) {
-      auto idx = std::stoi(matches[3]) - 1;
-      auto stack = get_stack(*map, idx);
-      for (const auto& pos : stack) {
-        std::cout << matches[2] << pos.cls << "." << pos.method << "("
-                  << pos.filename << ":" << pos.line << ")" << std::endl;
+  if (map == nullptr) {
+    return 1;
+  }
+  if (argc == 2) {
+    std::ios::sync_with_stdio(false);
+    symbolicate(*map, std::cin, std::cout);
+    return 0;
+  }
+
+  // Batch mode: the map is only read once, and the traces are symbolicated
+  // in parallel.
+  std::vector<const char*> traces(argv + 2, argv + argc);
+  std::atomic<size_t> next{0};
+  std::atomic<bool> failed{false};
+  auto worker = [&]() {
+    for (size_t i = next++; i < traces.size(); i = next++) {
+      std::ifstream in(traces[i]);
+      std::string out_path = std::string(traces[i]) + ".symbolicated";
+      std::ofstream out(out_path);
+      if (!in || !out) {
+        std::cerr << "Cannot symbolicate " << traces[i] << " into "
+                  << out_path << "\n";
+        failed = true;
+        continue;
       }
-    } else {
-      std::cout << line << std::endl;
+      symbolicate(*map, in, out);
     }
+  };
+  std::vector<std::thread> threads;
+  size_t jobs = std::min<size_t>(
+      std::max(1u, std::thread::hardware_concurrency()), traces.size());
+  for (size_t i = 1; i < jobs; i++) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
   }
+  return failed ? 1 : 0;
 }
@@ -5,27 +5,359 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <algorithm>
+#include <atomic>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
 #include <getopt.h>
 #include <regex>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
 
 #include "DexCommon.h"
 
+namespace {
+
+/*
+ * What can be searched. Each kind is a list of names per dex:
+ *   class:  the descriptors of the classes defined in the dex;
+ *   string: every string in the dex;
+ *   type:   the descriptors of every type the dex refers to;
+ *   method: every method the dex refers to, as Lcls;.name:(args)ret
+ */
+enum Kind { CLASS = 0, STRING, TYPE, METHOD, NUM_KINDS };
+
+const char* const kind_names[NUM_KINDS] = {"class", "string", "type",
+                                           "method"};
+
 void print_usage() {
-  fprintf(stderr, "Usage: dexgrep <classname> <dexfile 1> <dexfile 2> ...\n");
+  fprintf(stderr,
+          "Usage: dexgrep [-l] [-k class|string|type|method] [-x] [-j jobs] "
+          "<regex> <dexfile 1> <dexfile 2> ...\n"
+          "  -x, --index  search <dexfile>.grepindex, building it first if it "
+          "is missing or\n"
+          "               out of date. Patterns starting with ^ and a literal "
+          "prefix only\n"
+          "               look at the matching range of the index.\n");
+}
+
+std::vector<std::string> collect_names(ddump_data* rd, Kind kind) {
+  std::vector<std::string> names;
+  auto* type_ids = (uint32_t*)(rd->dexmmap + rd->dexh->type_ids_off);
+  switch (kind) {
+  case CLASS:
+    for (uint32_t i = 0; i < rd->dexh->class_defs_size; i++) {
+      names.emplace_back(
+          dex_string_by_type_idx(rd, rd->dex_class_defs[i].typeidx));
+    }
+    break;
+  case STRING:
+    for (uint32_t i = 0; i < rd->dexh->string_ids_size; i++) {
+      names.emplace_back(dex_string_by_idx(rd, i));
+    }
+    break;
+  case TYPE:
+    for (uint32_t i = 0; i < rd->dexh->type_ids_size; i++) {
+      names.emplace_back(dex_string_by_idx(rd, type_ids[i]));
+    }
+    break;
+  case METHOD:
+    for (uint32_t i = 0; i < rd->dexh->method_ids_size; i++) {
+      const dex_method_id& method = rd->dex_method_ids[i];
+      const dex_proto_id& proto = rd->dex_proto_ids[method.protoidx];
+      std::string name = dex_string_by_type_idx(rd, method.classidx);
+      name += ".";
+      name += dex_string_by_idx(rd, method.nameidx);
+      name += ":(";
+      if (proto.param_off) {
+        auto* params = (uint32_t*)(rd->dexmmap + proto.param_off);
+        auto* param_types = (uint16_t*)(params + 1);
+        for (uint32_t j = 0; j < *params; j++) {
+          name += dex_string_by_type_idx(rd, param_types[j]);
+        }
+      }
+      name += ")";
+      name += dex_string_by_idx(rd, type_ids[proto.rtypeidx]);
+      names.push_back(std::move(name));
+    }
+    break;
+  default:
+    break;
+  }
+  return names;
+}
+
+/*
+ * The index of a dex file is a header identifying the dex, followed by a
+ * section per kind. A section is the number of names, the offset of each
+ * name relative to the end of the offsets, and then the names themselves,
+ * sorted and NUL-terminated. The section offsets in the header are relative
+ * to the start of the file.
+ */
+const char kIndexMagic[8] = {'d', 'x', 'g', 'r', 'e', 'p', '0', '1'};
+
+struct index_header {
+  char magic[8];
+  uint32_t dex_checksum;
+  uint32_t dex_size;
+  uint32_t section_offs[NUM_KINDS];
+};
+
+struct Index {
+  char* map{nullptr};
+  size_t size{0};
+
+  ~Index() {
+    if (map != nullptr) {
+      munmap(map, size);
+    }
+  }
+
+  uint32_t count(Kind kind) const {
+    auto* hdr = (const index_header*)map;
+    return *(const uint32_t*)(map + hdr->section_offs[kind]);
+  }
+
+  const char* name(Kind kind, uint32_t i) const {
+    auto* hdr = (const index_header*)map;
+    auto* section = (const uint32_t*)(map + hdr->section_offs[kind]);
+    auto* names = (const char*)(section + 1 + section[0]);
+    return names + section[1 + i];
+  }
+};
+
+std::string index_path(const char* dexfile) {
+  return std::string(dexfile) + ".grepindex";
+}
+
+// Fails if the index is missing, or was built from a different dex.
+bool load_index(const std::string& path, ddump_data* rd, Index* index) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) || st.st_size < (off_t)sizeof(index_header)) {
+    close(fd);
+    return false;
+  }
+  void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    return false;
+  }
+  auto* hdr = (const index_header*)map;
+  if (memcmp(hdr->magic, kIndexMagic, sizeof(kIndexMagic)) != 0 ||
+      hdr->dex_checksum != rd->dexh->checksum ||
+      hdr->dex_size != rd->dexh->file_size) {
+    munmap(map, st.st_size);
+    return false;
+  }
+  index->map = (char*)map;
+  index->size = st.st_size;
+  return true;
+}
+
+void write_u32(std::string& out, uint32_t value) {
+  out.append((const char*)&value, sizeof(value));
+}
+
+bool write_index(const std::string& path, ddump_data* rd) {
+  index_header hdr;
+  memcpy(hdr.magic, kIndexMagic, sizeof(kIndexMagic));
+  hdr.dex_checksum = rd->dexh->checksum;
+  hdr.dex_size = rd->dexh->file_size;
+  std::string sections;
+  for (int kind = 0; kind < NUM_KINDS; kind++) {
+    hdr.section_offs[kind] = sizeof(hdr) + sections.size();
+    auto names = collect_names(rd, (Kind)kind);
+    std::sort(names.begin(), names.end());
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+    write_u32(sections, names.size());
+    uint32_t off = 0;
+    for (const auto& name : names) {
+      write_u32(sections, off);
+      off += name.size() + 1;
+    }
+    for (const auto& name : names) {
+      sections.append(name.c_str(), name.size() + 1);
+    }
+  }
+  // Write to a temporary file first, so that concurrent queries never see a
+  // partial index.
+  std::string tmp_path = path + ".tmp." + std::to_string(getpid());
+  FILE* fd = fopen(tmp_path.c_str(), "wb");
+  if (fd == nullptr) {
+    return false;
+  }
+  bool ok = fwrite(&hdr, sizeof(hdr), 1, fd) == 1 &&
+            fwrite(sections.data(), 1, sections.size(), fd) == sections.size();
+  ok = fclose(fd) == 0 && ok;
+  if (!ok || rename(tmp_path.c_str(), path.c_str()) != 0) {
+    unlink(tmp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+/*
+ * The literal text every match of :pattern starts with, if :pattern is
+ * anchored at the start. Empty if there is no such prefix.
+ */
+std::string literal_prefix(const std::string& pattern) {
+  if (pattern.empty() || pattern[0] != '^' ||
+      pattern.find('|') != std::string::npos) {
+    return "";
+  }
+  static const char* const special = ".[]{}()\\*+?^$";
+  std::string prefix;
+  for (size_t i = 1; i < pattern.size(); i++) {
+    char c = pattern[i];
+    if (strchr(special, c) != nullptr) {
+      // A quantifier makes the previous character optional.
+      if (!prefix.empty() && (c == '*' || c == '?' || c == '{')) {
+        prefix.pop_back();
+      }
+      break;
+    }
+    prefix += c;
+  }
+  return prefix;
+}
+
+struct Query {
+  Kind kind{CLASS};
+  bool files_only{false};
+  bool use_index{false};
+  std::regex re;
+  std::string prefix;
+};
+
+void append_match(const Query& query,
+                  const char* dexfile,
+                  const char* name,
+                  std::string* out) {
+  *out += dexfile;
+  if (!query.files_only) {
+    *out += ": ";
+    *out += name;
+  }
+  *out += "\n";
+}
+
+// Unlike a scan, which reports matches in dex order, this reports them in
+// sorted order.
+void search_index(const Query& query,
+                  const char* dexfile,
+                  const Index& index,
+                  std::string* out) {
+  uint32_t count = index.count(query.kind);
+  uint32_t begin = 0;
+  uint32_t end = count;
+  if (!query.prefix.empty()) {
+    const auto& prefix = query.prefix;
+    auto less_than_prefix = [&](uint32_t i) {
+      return strncmp(index.name(query.kind, i), prefix.c_str(),
+                     prefix.size()) < 0;
+    };
+    auto has_prefix = [&](uint32_t i) {
+      return strncmp(index.name(query.kind, i), prefix.c_str(),
+                     prefix.size()) == 0;
+    };
+    uint32_t lo = 0, hi = count;
+    while (lo < hi) {
+      uint32_t mid = lo + (hi - lo) / 2;
+      if (less_than_prefix(mid)) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    begin = lo;
+    end = begin;
+    while (end < count && has_prefix(end)) {
+      end++;
+    }
+  }
+  for (uint32_t i = begin; i < end; i++) {
+    const char* name = index.name(query.kind, i);
+    if (std::regex_search(name, query.re)) {
+      append_match(query, dexfile, name, out);
+    }
+  }
 }
 
+void grep_dex(const Query& query, const char* dexfile, std::string* out) {
+  ddump_data rd;
+  open_dex_file(dexfile, &rd);
+  if (query.use_index) {
+    auto path = index_path(dexfile);
+    Index index;
+    bool loaded = load_index(path, &rd, &index);
+    if (!loaded) {
+      if (write_index(path, &rd)) {
+        loaded = load_index(path, &rd, &index);
+      } else {
+        fprintf(stderr, "Cannot write index %s, scanning %s\n", path.c_str(),
+                dexfile);
+      }
+    }
+    if (loaded) {
+      search_index(query, dexfile, index, out);
+      munmap(rd.dexmmap, rd.dex_size);
+      return;
+    }
+  }
+  for (const auto& name : collect_names(&rd, query.kind)) {
+    if (std::regex_search(name, query.re)) {
+      append_match(query, dexfile, name.c_str(), out);
+    }
+  }
+  munmap(rd.dexmmap, rd.dex_size);
+}
+
+} // namespace
+
 int main(int argc, char* argv[]) {
-  bool files_only = false;
-  char c;
+  Query query;
+  size_t jobs = std::max(1u, std::thread::hardware_concurrency());
+  int c;
   static const struct option options[] = {
       {"files-without-match", no_argument, nullptr, 'l'},
+      {"kind", required_argument, nullptr, 'k'},
+      {"index", no_argument, nullptr, 'x'},
+      {"jobs", required_argument, nullptr, 'j'},
+      {nullptr, 0, nullptr, 0},
   };
-  while ((c = getopt_long(argc, argv, "hl", &options[0], nullptr)) != -1) {
+  while ((c = getopt_long(argc, argv, "hlk:xj:", &options[0], nullptr)) !=
+         -1) {
     switch (c) {
     case 'l':
-      files_only = true;
+      query.files_only = true;
+      break;
+    case 'k': {
+      auto it = std::find_if(
+          std::begin(kind_names), std::end(kind_names),
+          [](const char* name) { return strcmp(name, optarg) == 0; });
+      if (it == std::end(kind_names)) {
+        fprintf(stderr, "%s: unknown kind %s\n", argv[0], optarg);
+        print_usage();
+        return 1;
+      }
+      query.kind = (Kind)(it - std::begin(kind_names));
+      break;
+    }
+    case 'x':
+      query.use_index = true;
+      break;
+    case 'j':
+      jobs = std::max(1, atoi(optarg));
       break;
     case 'h':
       print_usage();
@@ -43,24 +375,28 @@ int main(int argc, char* argv[]) {
   }
 
   const char* search_str = argv[optind];
-  std::regex re(search_str);
-
-  for (int i = optind + 1; i < argc; ++i) {
-    const char* dexfile = argv[i];
-    ddump_data rd;
-    open_dex_file(dexfile, &rd);
-
-    auto size = rd.dexh->class_defs_size;
-    for (uint32_t j = 0; j < size; j++) {
-      dex_class_def* cls_def = rd.dex_class_defs + j;
-      char* name = dex_string_by_type_idx(&rd, cls_def->typeidx);
-      if (std::regex_search(name, re)) {
-        if (files_only) {
-          printf("%s\n", dexfile);
-        } else {
-          printf("%s: %s\n", dexfile, name);
-        }
-      }
+  query.re = std::regex(search_str);
+  query.prefix = literal_prefix(search_str);
+
+  // Dex files are searched in parallel, and their matches printed in the
+  // order the files were given.
+  std::vector<const char*> dexfiles(argv + optind + 1, argv + argc);
+  std::vector<std::string> outputs(dexfiles.size());
+  std::atomic<size_t> next{0};
+  auto worker = [&]() {
+    for (size_t i = next++; i < dexfiles.size(); i = next++) {
+      grep_dex(query, dexfiles[i], &outputs[i]);
     }
+  };
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < std::min(jobs, dexfiles.size()); i++) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  for (const auto& output : outputs) {
+    fputs(output.c_str(), stdout);
   }
 }
@@ -8,12 +8,31 @@
 #include "OatmealUtil.h"
 #include <cerrno>
 #include <cstring>
+#include <sys/mman.h>
 #include <sys/stat.h>
 
 void write_buf(FileHandle& fh, ConstBuffer buf) {
   CHECK(fh.fwrite(buf.ptr, sizeof(char), buf.len) == buf.len);
 }
 
+std::unique_ptr<MappedFile> map_file(const std::string& filename) {
+  auto fh = FileHandle(fopen(filename.c_str(), "r"));
+  if (fh.get() == nullptr) {
+    fprintf(stderr,
+            "failed to open file %s %s\n",
+            filename.c_str(),
+            std::strerror(errno));
+    return nullptr;
+  }
+  std::string error_msg;
+  return std::unique_ptr<MappedFile>(MappedFile::mmap_file(get_filesize(fh),
+                                                           PROT_READ,
+                                                           MAP_PRIVATE,
+                                                           fileno(fh.get()),
+                                                           filename.c_str(),
+                                                           &error_msg));
+}
+
 void write_str_and_null(FileHandle& fh, const std::string& str) {
   const auto len = str.size() + 1;
   CHECK(fh.fwrite(str.c_str(), sizeof(char), len) == len);
@@ -40,10 +59,13 @@ void stream_file(FileHandle& in, FileHandle& out) {
 }
 
 void write_padding(FileHandle& fh, char byte, size_t num) {
-  // This might be inefficient, but the most padding we ever do at
-  // once is 4k, so this shouldn't be too bad.
-  for (size_t i = 0; i < num; i++) {
-    CHECK(fh.fwrite(&byte, sizeof(char), 1) == sizeof(char));
+  constexpr size_t kBufSize = 0x1000;
+  char buf[kBufSize];
+  memset(buf, byte, std::min(num, kBufSize));
+  while (num > 0) {
+    auto len = std::min(num, kBufSize);
+    CHECK(fh.fwrite(buf, sizeof(char), len) == len);
+    num -= len;
   }
 }
 
@@ -10,10 +10,15 @@
 #include "DexEncoding.h"
 #include "DexOpcodeDefs.h"
 #include "file-utils.h"
+#include "mmap.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cstdio>
+#include <limits>
 #include <memory>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -117,6 +122,42 @@ struct ConstBuffer {
 
 void write_buf(FileHandle& fh, ConstBuffer buf);
 
+// Maps the whole file read-only, so that large OAT, VDEX and dex files are
+// paged in as they are parsed instead of being read up front. Returns null,
+// after printing why, on failure.
+std::unique_ptr<MappedFile> map_file(const std::string& filename);
+
+inline ConstBuffer to_buffer(const MappedFile& file) {
+  return ConstBuffer{reinterpret_cast<const char*>(file.begin()), file.size()};
+}
+
+// Calls fn(i) for every i in [0, count), spread over the available cores. The
+// calls must be independent of each other.
+template <typename Fn>
+void parallel_for(size_t count, const Fn& fn) {
+  size_t num_threads = std::min<size_t>(
+      count, std::max(1u, std::thread::hardware_concurrency()));
+  if (num_threads <= 1) {
+    for (size_t i = 0; i < count; i++) {
+      fn(i);
+    }
+    return;
+  }
+  std::atomic<size_t> next{0};
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads);
+  for (size_t t = 0; t < num_threads; t++) {
+    threads.emplace_back([&]() {
+      for (size_t i = next++; i < count; i = next++) {
+        fn(i);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
 struct WritableBuffer {
   FileHandle& fh;
   char* begin;
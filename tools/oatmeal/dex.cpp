@@ -17,6 +17,7 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#include <algorithm>
 #include <memory>
 #include <unordered_map>
 
@@ -720,6 +721,91 @@ void print_dex_opcodes(const uint8_t* begin, const size_t size) {
       [](const uint8_t* const insn) {});
 }
 
+namespace {
+
+const char* map_item_type_name(uint16_t type) {
+  switch (type) {
+  case TYPE_HEADER_ITEM:
+    return "header_item";
+  case TYPE_STRING_ID_ITEM:
+    return "string_id_item";
+  case TYPE_TYPE_ID_ITEM:
+    return "type_id_item";
+  case TYPE_PROTO_ID_ITEM:
+    return "proto_id_item";
+  case TYPE_FIELD_ID_ITEM:
+    return "field_id_item";
+  case TYPE_METHOD_ID_ITEM:
+    return "method_id_item";
+  case TYPE_CLASS_DEF_ITEM:
+    return "class_def_item";
+  case TYPE_CALL_SITE_ID_ITEM:
+    return "call_site_id_item";
+  case TYPE_METHOD_HANDLE_ITEM:
+    return "method_handle_item";
+  case TYPE_MAP_LIST:
+    return "map_list";
+  case TYPE_TYPE_LIST:
+    return "type_list";
+  case TYPE_ANNOTATION_SET_REF_LIST:
+    return "annotation_set_ref_list";
+  case TYPE_ANNOTATION_SET_ITEM:
+    return "annotation_set_item";
+  case TYPE_CLASS_DATA_ITEM:
+    return "class_data_item";
+  case TYPE_CODE_ITEM:
+    return "code_item";
+  case TYPE_STRING_DATA_ITEM:
+    return "string_data_item";
+  case TYPE_DEBUG_INFO_ITEM:
+    return "debug_info_item";
+  case TYPE_ANNOTATION_ITEM:
+    return "annotation_item";
+  case TYPE_ENCODED_ARRAY_ITEM:
+    return "encoded_array_item";
+  case TYPE_ANNOTATIONS_DIR_ITEM:
+    return "annotations_directory_item";
+  case TYPE_HIDDENAPI_CLASS_DATA_ITEM:
+    return "hiddenapi_class_data_item";
+  default:
+    return "unknown_map_item";
+  }
+}
+
+} // namespace
+
+void label_dex_sections(ConstBuffer dex) {
+  // Not DexFileHeader::parse, which would consume the file all over again.
+  DexFileHeader header;
+  CHECK(dex.len >= sizeof(DexFileHeader));
+  memcpy(&header, dex.ptr, sizeof(DexFileHeader));
+  CHECK(header.map_off + sizeof(uint32_t) <= dex.len);
+  uint32_t num_items;
+  memcpy(&num_items, dex.ptr + header.map_off, sizeof(uint32_t));
+  auto items_buf = dex.slice(header.map_off + sizeof(uint32_t),
+                             header.map_off + sizeof(uint32_t) +
+                                 num_items * sizeof(dex_map_item));
+
+  std::vector<dex_map_item> items(num_items);
+  memcpy(items.data(), items_buf.ptr, items_buf.len);
+  std::sort(items.begin(),
+            items.end(),
+            [](const dex_map_item& a, const dex_map_item& b) {
+              return a.offset < b.offset;
+            });
+
+  // The map only gives the start of each section, which extends up to the
+  // next one.
+  for (size_t i = 0; i < items.size(); i++) {
+    auto begin = items[i].offset;
+    auto end = i + 1 < items.size() ? items[i + 1].offset : dex.len;
+    if (begin < end && end <= dex.len) {
+      cur_ma()->labelRange(
+          dex.ptr + begin, end - begin, map_item_type_name(items[i].type));
+    }
+  }
+}
+
 void stream::stream_dex(const uint8_t* begin,
                         const size_t size,
                         InsnWalkerFn insn_walker,
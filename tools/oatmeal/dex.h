@@ -102,3 +102,7 @@ class stream {
 };
 
 void print_dex_opcodes(const uint8_t* begin, const size_t size);
+
+// Label the sections listed in the map of the dex file in :dex (class data,
+// code items, string data, ...) for the memory accounter's page report.
+void label_dex_sections(ConstBuffer dex);
@@ -250,6 +250,7 @@ struct PACK OatHeader {
   }
 
   static OatHeader parse(ConstBuffer buf) {
+    MemoryAccounterLabel label("oat_header");
     OatHeader header;
     CHECK(buf.len >= sizeof(OatHeader_Common));
 
@@ -385,6 +386,7 @@ class KeyValueStore {
   using KeyValue = std::pair<std::string, std::string>;
 
   explicit KeyValueStore(ConstBuffer buf) {
+    MemoryAccounterLabel label("key_value_store");
     cur_ma()->markBufferConsumed(buf);
 
     int remaining = buf.len;
@@ -739,6 +741,7 @@ class DexFileListing_079 : public DexFileListing {
   };
 
   DexFileListing_079(int numDexFiles, ConstBuffer buf) {
+    MemoryAccounterLabel label("oat_dex_file");
     auto ptr = buf.ptr;
     while (numDexFiles > 0) {
       numDexFiles--;
@@ -1007,6 +1010,9 @@ class DexFileListing_064 : public DexFileListing {
                      int numDexFiles,
                      ConstBuffer buf,
                      ConstBuffer oat_buf) {
+    // This also parses the class infos, which live right after the dex files
+    // in the 064 format.
+    MemoryAccounterLabel label("oat_dex_file");
     auto oat_method_offset_size = 0;
     if (version == OatVersion::V_039) {
       // http://androidxref.com/5.0.0_r2/xref/art/runtime/oat.h#161
@@ -1250,6 +1256,7 @@ class DexFiles {
       headers_.push_back(dh);
 
       auto dex_buf = buf.slice(file_offset, file_offset + dh.file_size);
+      label_dex_sections(dex_buf);
       dexes_.push_back(dex_buf);
     }
   }
@@ -1321,6 +1328,7 @@ OatClasses_124::OatClasses_124(const DexFileListing_079& dex_file_listing,
                                const DexFiles& dex_files,
                                ConstBuffer oat_buf,
                                ConstBuffer dex_buf) {
+  MemoryAccounterLabel label("oat_class");
   foreach_pair(dex_file_listing.dex_files(),
                dex_files.headers(),
                [&](const DexFileListing_079::DexFile_079& listing,
@@ -1376,6 +1384,7 @@ class OatClasses_064 : public OatClasses {
 OatClasses_079::OatClasses_079(const DexFileListing_079& dex_file_listing,
                                const DexFiles& dex_files,
                                ConstBuffer oat_buf) {
+  MemoryAccounterLabel label("oat_class");
   foreach_pair(
       dex_file_listing.dex_files(),
       dex_files.headers(),
@@ -1557,18 +1566,24 @@ class SamsungLookupTables {
       const std::vector<DexInput>& dex_input_vec,
       const std::vector<DexFileListing_064::DexFile_064>& dex_files,
       FileHandle& cksum_fh) {
+    // The dex files are independent, so build their tables in parallel and
+    // only write them out in order.
+    std::vector<std::unique_ptr<LookupTable>> tables(dex_input_vec.size());
+    parallel_for(tables.size(), [&](size_t i) {
+      tables[i] = std::make_unique<LookupTable>(
+          build_lookup_table(dex_input_vec[i].filename));
+    });
+
     foreach_pair(
-        dex_input_vec,
+        tables,
         dex_files,
-        [&](const DexInput& dex_input,
+        [&](const std::unique_ptr<LookupTable>& table,
             const DexFileListing_064::DexFile_064& dex_file) {
           CHECK(dex_file.lookup_table_offset == cksum_fh.bytes_written());
 
-          auto table = build_lookup_table(dex_input.filename);
-
           auto buf =
-              ConstBuffer{reinterpret_cast<const char*>(table.data.get()),
-                          table.byte_size()};
+              ConstBuffer{reinterpret_cast<const char*>(table->data.get()),
+                          table->byte_size()};
           write_buf(cksum_fh, buf);
         });
   }
@@ -1612,10 +1627,12 @@ class SamsungLookupTables {
 
   static LookupTable build_lookup_table(const std::string& filename) {
 
-    auto dex_fh = FileHandle(fopen(filename.c_str(), "r"));
+    auto dex_file = map_file(filename);
+    CHECK(dex_file != nullptr);
+    auto dex = to_buffer(*dex_file);
 
-    DexFileHeader header = {};
-    CHECK(dex_fh.fread(&header, sizeof(DexFileHeader), 1) == 1);
+    CHECK(dex.len >= sizeof(DexFileHeader));
+    const auto& header = *reinterpret_cast<const DexFileHeader*>(dex.ptr);
 
     const auto num_type_ids = header.type_ids_size;
 
@@ -1626,30 +1643,16 @@ class SamsungLookupTables {
 
     memset(table_buf.get(), 0, lookup_table_size * sizeof(LookupTableEntry));
 
-    // Read type ids array.
-    std::unique_ptr<uint32_t[]> typeid_buf(new uint32_t[num_type_ids]);
-    CHECK(dex_fh.seek_set(header.type_ids_off));
-    CHECK(dex_fh.fread(typeid_buf.get(), sizeof(uint32_t), num_type_ids) ==
-          num_type_ids);
+    const auto* typeid_buf = reinterpret_cast<const uint32_t*>(
+        dex.slice(header.type_ids_off,
+                  header.type_ids_off + num_type_ids * sizeof(uint32_t))
+            .ptr);
 
-    // Read the string ids array.
     const auto num_string_ids = header.string_ids_size;
-    std::unique_ptr<uint32_t[]> stringid_buf(new uint32_t[num_string_ids]);
-    CHECK(dex_fh.seek_set(header.string_ids_off));
-    CHECK(dex_fh.fread(stringid_buf.get(), sizeof(uint32_t), num_string_ids) ==
-          num_string_ids);
-
-    constexpr int kTypeNameBufSize = 256;
-
-    char type_name_buf[kTypeNameBufSize] = {};
-
-    struct Retry {
-      uint32_t string_offset;
-      uint16_t data;
-      uint32_t hash;
-    };
-
-    std::vector<Retry> retry_indices;
+    const auto* stringid_buf = reinterpret_cast<const uint32_t*>(
+        dex.slice(header.string_ids_off,
+                  header.string_ids_off + num_string_ids * sizeof(uint32_t))
+            .ptr);
 
     for (unsigned int i = 0; i < num_type_ids; i++) {
       const auto string_id = typeid_buf[i];
@@ -1657,27 +1660,13 @@ class SamsungLookupTables {
 
       const auto string_offset = stringid_buf[string_id];
 
-      dex_fh.seek_set(string_offset);
-      auto read_size =
-          dex_fh.fread(type_name_buf, sizeof(char), kTypeNameBufSize);
-      CHECK(read_size > 0);
-
-      auto ptr = type_name_buf;
+      // The name is as long as its utf16 size says, including the
+      // terminator.
+      auto ptr = reinterpret_cast<const uint8_t*>(dex.slice(string_offset).ptr);
       const auto str_size = read_uleb128(&ptr) + 1;
-      const auto str_start = ptr - type_name_buf;
-
-      std::string type_name;
-
-      if (str_start + str_size >= kTypeNameBufSize) {
-        std::unique_ptr<char[]> large_class_name_buf(new char[str_size]);
-        dex_fh.seek_set(string_offset + str_start);
-        CHECK(dex_fh.fread(large_class_name_buf.get(),
-                           sizeof(char),
-                           str_size) == str_size);
-        type_name = std::string(large_class_name_buf.get(), str_size);
-      } else {
-        type_name = std::string(ptr, str_size);
-      }
+      const auto str_start = reinterpret_cast<const char*>(ptr) - dex.ptr;
+      const std::string type_name(
+          dex.slice(str_start, str_start + str_size).ptr, str_size);
 
       const auto hash = hash_str(type_name);
       insert(table_buf.get(), lookup_table_size, hash, string_offset, i);
@@ -1721,6 +1710,7 @@ class LookupTables {
                const DexFiles& dex_files,
                ConstBuffer oat_buf)
       : oat_buf_(oat_buf) {
+    MemoryAccounterLabel label("lookup_table");
 
     CHECK(dex_file_listing.dex_files().size() == dex_files.headers().size());
     auto listing_it = dex_file_listing.dex_files().begin();
@@ -1777,20 +1767,24 @@ class LookupTables {
   static void write(const std::vector<DexInput>& dex_input_vec,
                     const std::vector<DexFileType>& dex_files,
                     FileHandle& cksum_fh) {
+    // The dex files are independent, so build their tables in parallel and
+    // only write them out in order.
+    std::vector<std::unique_ptr<LookupTableEntry[]>> tables(
+        dex_input_vec.size());
+    parallel_for(tables.size(), [&](size_t i) {
+      tables[i] = build_lookup_table(dex_input_vec[i].filename,
+                                     numEntries(dex_files[i].num_classes));
+    });
+
     foreach_pair(
-        dex_input_vec,
+        tables,
         dex_files,
-        [&](const DexInput& dex_input,
+        [&](const std::unique_ptr<LookupTableEntry[]>& lookup_table_buf,
             const DexFileListing_079::DexFile_079& dex_file) {
           CHECK(dex_file.lookup_table_offset == cksum_fh.bytes_written());
-          const auto num_classes = dex_file.num_classes;
-
-          const auto lookup_table_size = numEntries(num_classes);
           const auto lookup_table_byte_size =
-              lookup_table_size * sizeof(LookupTableEntry);
+              numEntries(dex_file.num_classes) * sizeof(LookupTableEntry);
 
-          auto lookup_table_buf =
-              build_lookup_table(dex_input.filename, lookup_table_size);
           auto buf =
               ConstBuffer{reinterpret_cast<const char*>(lookup_table_buf.get()),
                           lookup_table_byte_size};
@@ -1858,43 +1852,34 @@ class LookupTables {
         new LookupTableEntry[lookup_table_size]);
     memset(table_buf.get(), 0, lookup_table_size * sizeof(LookupTableEntry));
 
-    auto dex_fh = FileHandle(fopen(filename.c_str(), "r"));
+    // The dex file is mapped rather than read, only the pages holding the ids
+    // and class names are touched.
+    auto dex_file = map_file(filename);
+    CHECK(dex_file != nullptr);
+    auto dex = to_buffer(*dex_file);
 
-    DexFileHeader header = {};
-    CHECK(dex_fh.fread(&header, sizeof(DexFileHeader), 1) == 1);
+    CHECK(dex.len >= sizeof(DexFileHeader));
+    const auto& header = *reinterpret_cast<const DexFileHeader*>(dex.ptr);
 
     const auto num_classes = header.class_defs_size;
     const auto mask = lookup_table_size - 1;
 
-    // TODO: This is probably the most memory hungry part of the whole building
-    // process, but total usage should still be <1MB for all the class strings.
-    // if this proves to be a problem we can build the lookup table with redex
-    // and ship it to the phone.
-
-    // Read type ids array.
     const auto num_type_ids = header.type_ids_size;
-    std::unique_ptr<uint32_t[]> typeid_buf(new uint32_t[num_type_ids]);
-    CHECK(dex_fh.seek_set(header.type_ids_off));
-    CHECK(dex_fh.fread(typeid_buf.get(), sizeof(uint32_t), num_type_ids) ==
-          num_type_ids);
+    const auto* typeid_buf = reinterpret_cast<const uint32_t*>(
+        dex.slice(header.type_ids_off,
+                  header.type_ids_off + num_type_ids * sizeof(uint32_t))
+            .ptr);
 
-    // Read the string ids array.
     const auto num_string_ids = header.string_ids_size;
-    std::unique_ptr<uint32_t[]> stringid_buf(new uint32_t[num_string_ids]);
-    CHECK(dex_fh.seek_set(header.string_ids_off));
-    CHECK(dex_fh.fread(stringid_buf.get(), sizeof(uint32_t), num_string_ids) ==
-          num_string_ids);
-
-    CHECK(dex_fh.seek_set(header.class_defs_off));
+    const auto* stringid_buf = reinterpret_cast<const uint32_t*>(
+        dex.slice(header.string_ids_off,
+                  header.string_ids_off + num_string_ids * sizeof(uint32_t))
+            .ptr);
 
-    std::unique_ptr<DexClassDef[]> class_defs_buf(new DexClassDef[num_classes]);
-    CHECK(dex_fh.fread(class_defs_buf.get(),
-                       sizeof(DexClassDef),
-                       num_classes) == num_classes);
-
-    constexpr int kClassNameBufSize = 256;
-
-    char class_name_buf[kClassNameBufSize] = {};
+    const auto* class_defs_buf = reinterpret_cast<const DexClassDef*>(
+        dex.slice(header.class_defs_off,
+                  header.class_defs_off + num_classes * sizeof(DexClassDef))
+            .ptr);
 
     struct Retry {
       uint32_t string_offset;
@@ -1911,27 +1896,13 @@ class LookupTables {
       CHECK(string_id < num_string_ids);
       const auto string_offset = stringid_buf[string_id];
 
-      dex_fh.seek_set(string_offset);
-      auto read_size =
-          dex_fh.fread(class_name_buf, sizeof(char), kClassNameBufSize);
-      CHECK(read_size > 0);
-
-      auto ptr = class_name_buf;
+      // The name is as long as its utf16 size says, including the
+      // terminator.
+      auto ptr = reinterpret_cast<const uint8_t*>(dex.slice(string_offset).ptr);
       const auto str_size = read_uleb128(&ptr) + 1;
-      const auto str_start = ptr - class_name_buf;
-
-      std::string class_name;
-
-      if (str_start + str_size >= kClassNameBufSize) {
-        std::unique_ptr<char[]> large_class_name_buf(new char[str_size]);
-        dex_fh.seek_set(string_offset + str_start);
-        CHECK(dex_fh.fread(large_class_name_buf.get(),
-                           sizeof(char),
-                           str_size) == str_size);
-        class_name = std::string(large_class_name_buf.get(), str_size);
-      } else {
-        class_name = std::string(ptr, str_size);
-      }
+      const auto str_start = reinterpret_cast<const char*>(ptr) - dex.ptr;
+      const std::string class_name(
+          dex.slice(str_start, str_start + str_size).ptr, str_size);
 
       const auto hash = hash_str(class_name);
       const auto data = make_lt_data(i, hash, mask);
@@ -2259,53 +2230,39 @@ class OatFile_124 : public OatFile {
     auto rest = buf.slice(header.size() + header.key_value_store_size);
     DexFileListingType dfl(header.dex_file_count, rest);
 
-    auto dex_file_name = dexes[0].filename;
-    auto dex_file = FileHandle(fopen(dex_file_name.c_str(), "r"));
-    if (dex_file.get() == nullptr) {
-      fprintf(stderr,
-              "failed to open dex file %s %s\n",
-              dex_file_name.c_str(),
-              std::strerror(errno));
-      return nullptr;
-    }
-
-    auto dex_file_size = get_filesize(dex_file);
-
-    // We don't run dumping during install on device, so it is allowed to
-    // consume lots of memory.
-    auto dex_file_contents = std::make_unique<char[]>(dex_file_size);
-    auto dexFileBytesRead =
-        fread(dex_file_contents.get(), 1, dex_file_size, dex_file.get());
-    if (dexFileBytesRead != dex_file_size) {
-      fprintf(stderr,
-              "Failed to read dex file %s (%zd)\n",
-              std::strerror(errno),
-              dexFileBytesRead);
+    // The parsed dex files point into the mapping, so the returned OatFile
+    // keeps it alive.
+    auto dex_file = map_file(dexes[0].filename);
+    if (dex_file == nullptr) {
       return nullptr;
     }
 
-    ConstBuffer dex_file_buf{dex_file_contents.get(), dex_file_size};
+    ConstBuffer dex_file_buf = to_buffer(*dex_file);
     cur_ma()->addBuffer(dex_file_buf);
     DexFiles dex_files(dfl, dex_file_buf);
 
     if (dex_files_only) {
-      return std::unique_ptr<OatFile>(new OatFileType(header,
-                                                      key_value_store,
-                                                      std::move(dfl),
-                                                      std::move(dex_files),
-                                                      oat_offset));
+      auto ret = std::unique_ptr<OatFile>(new OatFileType(header,
+                                                          key_value_store,
+                                                          std::move(dfl),
+                                                          std::move(dex_files),
+                                                          oat_offset));
+      ret->keep_mapped(std::move(dex_file));
+      return ret;
     }
 
     LookupTables lookup_tables(dfl, dex_files, buf);
     OatClasses_124 oat_classes(dfl, dex_files, buf, dex_file_buf);
 
-    return std::unique_ptr<OatFile>(new OatFileType(header,
-                                                    key_value_store,
-                                                    std::move(dfl),
-                                                    std::move(dex_files),
-                                                    std::move(lookup_tables),
-                                                    std::move(oat_classes),
-                                                    oat_offset));
+    auto ret = std::unique_ptr<OatFile>(new OatFileType(header,
+                                                        key_value_store,
+                                                        std::move(dfl),
+                                                        std::move(dex_files),
+                                                        std::move(lookup_tables),
+                                                        std::move(oat_classes),
+                                                        oat_offset));
+    ret->keep_mapped(std::move(dex_file));
+    return ret;
   }
 
   static std::unique_ptr<OatFile> parse(bool dex_files_only,
@@ -3580,10 +3537,15 @@ OatFile::Status OatFile::build(const std::vector<std::string>& oat_file_names,
       return Status::BUILD_ARG_ERROR;
     }
 
-    for (unsigned int i = 0; i < oat_file_names.size(); i++) {
+    // Each oat file only depends on its own dex file, so build them in
+    // parallel.
+    std::vector<Status> statuses(oat_file_names.size());
+    parallel_for(oat_file_names.size(), [&](size_t i) {
       std::vector<DexInput> dex_file;
       dex_file.push_back(dex_files[i]);
-      auto status = build_fn(oat_file_names[i], dex_file);
+      statuses[i] = build_fn(oat_file_names[i], dex_file);
+    });
+    for (auto status : statuses) {
       if (status != Status::BUILD_SUCCESS) {
         return status;
       }
@@ -114,6 +114,15 @@ class OatFile {
                       const std::string& art_image_location,
                       bool samsung_mode,
                       const std::string& quick_data_location);
+
+  // Keeps a file that the parsed structures point into mapped for as long as
+  // this OatFile lives.
+  void keep_mapped(std::unique_ptr<MappedFile> file) {
+    mapped_files_.push_back(std::move(file));
+  }
+
+ private:
+  std::vector<std::unique_ptr<MappedFile>> mapped_files_;
 };
 
 enum class InstructionSet {
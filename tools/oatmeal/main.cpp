@@ -51,6 +51,10 @@ struct Arguments {
 
   bool print_unverified_classes = false;
 
+  // Offsets of the pages of the dumped file faulted in during startup, for the
+  // page report.
+  std::string page_fault_trace;
+
   std::string arch;
 
   std::string art_image_location;
@@ -101,6 +105,7 @@ Arguments parse_args(int argc, char* argv[]) {
       {"samsung-oatformat", no_argument, nullptr, 2},
       {"one-oat-per-dex", no_argument, nullptr, 3},
       {"quickening-data", required_argument, nullptr, 'q'},
+      {"page-faults", required_argument, nullptr, 4},
       {nullptr, 0, nullptr, 0}};
 
   Arguments ret;
@@ -187,6 +192,10 @@ Arguments parse_args(int argc, char* argv[]) {
       ret.one_oat_per_dex = true;
       break;
 
+    case 4:
+      ret.page_fault_trace = expand(optarg);
+      break;
+
     case 'q':
       ret.quick_data_location = expand(optarg);
       break;
@@ -209,6 +218,11 @@ Arguments parse_args(int argc, char* argv[]) {
     exit(1);
   }
 
+  if (ret.action != Action::DUMP && !ret.page_fault_trace.empty()) {
+    fprintf(stderr, "--page-faults can only be used with -d/--dump\n");
+    exit(1);
+  }
+
   if (!dex_locations.empty()) {
     if (dex_locations.size() != dex_files.size()) {
       fprintf(
@@ -231,6 +245,29 @@ Arguments parse_args(int argc, char* argv[]) {
   return ret;
 }
 
+// A page fault trace lists one byte offset into the dumped file per line, in
+// decimal or 0x-prefixed hex, in the order the pages were faulted in.
+bool read_page_fault_trace(const std::string& filename,
+                           std::vector<uint32_t>* pages) {
+  auto fh = FileHandle(fopen(filename.c_str(), "r"));
+  if (fh.get() == nullptr) {
+    fprintf(stderr,
+            "failed to open file %s %s\n",
+            filename.c_str(),
+            std::strerror(errno));
+    return false;
+  }
+  char line[64];
+  while (fgets(line, sizeof(line), fh.get()) != nullptr) {
+    char* end;
+    auto offset = strtoull(line, &end, 0);
+    if (end != line) {
+      pages->push_back(offset / MemoryAccounter::kPageSize);
+    }
+  }
+  return true;
+}
+
 int dump(const Arguments& args) {
   if (args.oat_files.size() != 1) {
     fprintf(stderr, "-o/--oat required (exactly once)\n");
@@ -238,31 +275,14 @@ int dump(const Arguments& args) {
   }
 
   auto const& oat_file_name = args.oat_files[0];
-  auto oat_file = FileHandle(fopen(oat_file_name.c_str(), "r"));
-  if (oat_file.get() == nullptr) {
-    fprintf(stderr,
-            "failed to open file %s %s\n",
-            oat_file_name.c_str(),
-            std::strerror(errno));
+  // Map the file rather than reading it, only the parts that are parsed need
+  // to be paged in.
+  auto oat_file = map_file(oat_file_name);
+  if (oat_file == nullptr) {
     return 1;
   }
 
-  auto oat_file_size = get_filesize(oat_file);
-
-  // We don't run dumping during install on device, so it is allowed to consume
-  // lots of memory.
-  auto oat_file_contents = std::make_unique<char[]>(oat_file_size);
-  auto oatFileBytesRead =
-      fread(oat_file_contents.get(), 1, oat_file_size, oat_file.get());
-  if (oatFileBytesRead != oat_file_size) {
-    fprintf(stderr,
-            "Failed to read file %s (%zd)\n",
-            std::strerror(errno),
-            oatFileBytesRead);
-    return 1;
-  }
-
-  ConstBuffer oatfile_buffer{oat_file_contents.get(), oat_file_size};
+  ConstBuffer oatfile_buffer = to_buffer(*oat_file);
   auto ma_scope = MemoryAccounter::NewScope(oatfile_buffer);
 
   CHECK(oatfile_buffer.len > 4);
@@ -291,6 +311,14 @@ int dump(const Arguments& args) {
     cur_ma()->print();
   }
 
+  if (!args.page_fault_trace.empty()) {
+    std::vector<uint32_t> pages;
+    if (!read_page_fault_trace(args.page_fault_trace, &pages)) {
+      return 1;
+    }
+    cur_ma()->printPageReport(pages);
+  }
+
   return oatfile->status() == OatFile::Status::PARSE_SUCCESS ? 0 : 1;
 }
 
@@ -10,6 +10,10 @@
 
 #include <algorithm>
 #include <cstring>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace {
@@ -34,6 +38,8 @@ class NilMemoryAccounterImpl : public MemoryAccounter {
   void markRangeConsumed(const char*, uint32_t) override {}
   void markBufferConsumed(ConstBuffer) override {}
   void addBuffer(ConstBuffer) override {}
+  void labelRange(const char*, uint32_t, const char*) override {}
+  void printPageReport(const std::vector<uint32_t>&) override {}
 };
 
 class MultiBufferMemoryAccounter;
@@ -106,6 +112,17 @@ class MemoryAccounterImpl : public MemoryAccounter {
     markRangeConsumed(subBuffer.ptr, subBuffer.len);
   }
 
+  void labelRange(const char* ptr, uint32_t count, const char* label) override {
+    CHECK(buf_.ptr <= ptr);
+
+    uint32_t begin = ptr - buf_.ptr;
+    uint32_t end = begin + count;
+    CHECK(end <= buf_.len);
+    labeled_ranges_.emplace_back(begin, end, label);
+  }
+
+  void printPageReport(const std::vector<uint32_t>& pages) override;
+
   static MemoryAccounter* Cur() {
     if (accounter_stack_.empty()) {
       return &nil_accounter_;
@@ -114,25 +131,95 @@ class MemoryAccounterImpl : public MemoryAccounter {
   }
 
  private:
+  friend class ::MemoryAccounterLabel;
+
   struct Range {
-    Range(size_t b, size_t e) : begin(b), end(e) {}
+    Range(size_t b, size_t e, const char* l = nullptr)
+        : begin(b), end(e), label(l) {}
     uint32_t begin;
     uint32_t end;
+    const char* label;
   };
 
   ConstBuffer buf_;
   std::vector<Range> consumed_ranges_;
+  std::vector<Range> labeled_ranges_;
 
   static NilMemoryAccounterImpl nil_accounter_;
   static std::vector<std::unique_ptr<MemoryAccounter>> accounter_stack_;
+  static std::vector<const char*> label_stack_;
 
   void markRangeImpl(uint32_t begin, uint32_t end) {
     CHECK(begin <= end);
     CHECK(end <= buf_.len);
-    consumed_ranges_.emplace_back(begin, end);
+    consumed_ranges_.emplace_back(
+        begin, end, label_stack_.empty() ? nullptr : label_stack_.back());
   }
 };
 
+void MemoryAccounterImpl::printPageReport(const std::vector<uint32_t>& pages) {
+  // Bytes per structure, for each page of the report. Consumed ranges that
+  // weren't parsed under a label (e.g. whole dex files) don't count, the
+  // labeled ranges within them do.
+  std::unordered_map<uint32_t, std::map<std::string, uint32_t>> page_bytes;
+  for (auto page : pages) {
+    page_bytes[page];
+  }
+  auto add_range = [&](const Range& range) {
+    if (range.label == nullptr) {
+      return;
+    }
+    for (uint32_t page = range.begin / kPageSize;
+         page * kPageSize < range.end;
+         page++) {
+      auto it = page_bytes.find(page);
+      if (it == page_bytes.end()) {
+        continue;
+      }
+      auto begin = std::max(range.begin, page * kPageSize);
+      auto end = std::min(range.end, (page + 1) * kPageSize);
+      it->second[range.label] += end - begin;
+    }
+  };
+  for (const auto& range : consumed_ranges_) {
+    add_range(range);
+  }
+  for (const auto& range : labeled_ranges_) {
+    add_range(range);
+  }
+
+  printf("Page report:\n");
+  std::map<std::string, uint32_t> totals;
+  std::unordered_set<uint32_t> printed;
+  size_t num_pages = 0;
+  for (auto page : pages) {
+    if (!printed.insert(page).second) {
+      continue;
+    }
+    if (page >= (buf_.len + kPageSize - 1) / kPageSize) {
+      printf("  page 0x%08x: beyond the end of the file\n", page);
+      continue;
+    }
+    num_pages++;
+    printf("  page 0x%08x (offset 0x%08x):", page, page * kPageSize);
+    uint32_t page_len =
+        std::min<uint32_t>(kPageSize, buf_.len - page * kPageSize);
+    uint32_t labeled = 0;
+    for (const auto& pair : page_bytes[page]) {
+      printf(" %s %u,", pair.first.c_str(), pair.second);
+      totals[pair.first] += pair.second;
+      labeled += pair.second;
+    }
+    auto unlabeled = labeled < page_len ? page_len - labeled : 0;
+    printf(" unlabeled %u\n", unlabeled);
+    totals["unlabeled"] += unlabeled;
+  }
+  printf("Bytes per structure over %zu pages:\n", num_pages);
+  for (const auto& pair : totals) {
+    printf("  %s: %u\n", pair.first.c_str(), pair.second);
+  }
+}
+
 class MultiBufferMemoryAccounter : public MemoryAccounter {
  public:
   MultiBufferMemoryAccounter() = delete;
@@ -150,6 +237,8 @@ class MultiBufferMemoryAccounter : public MemoryAccounter {
   void markRangeConsumed(const char* ptr, uint32_t count) override;
   void markBufferConsumed(ConstBuffer subBuffer) override;
   void addBuffer(ConstBuffer buf) override;
+  void labelRange(const char* ptr, uint32_t count, const char* label) override;
+  void printPageReport(const std::vector<uint32_t>& pages) override;
 
   ~MultiBufferMemoryAccounter() override = default;
 
@@ -200,6 +289,24 @@ void MultiBufferMemoryAccounter::markBufferConsumed(ConstBuffer subBuffer) {
   CHECK(false, "Can't find memory location");
 }
 
+void MultiBufferMemoryAccounter::labelRange(const char* ptr,
+                                            uint32_t count,
+                                            const char* label) {
+  for (auto& a : accounters_) {
+    auto base_ptr = a.buf_.ptr;
+    if (base_ptr <= ptr && ptr + count <= base_ptr + a.buf_.len) {
+      a.labelRange(ptr, count, label);
+      return;
+    }
+  }
+  CHECK(false, "Can't find memory location");
+}
+
+void MultiBufferMemoryAccounter::printPageReport(
+    const std::vector<uint32_t>& pages) {
+  accounters_.front().printPageReport(pages);
+}
+
 void MultiBufferMemoryAccounter::print() {
   for (auto& a : accounters_) {
     a.print();
@@ -220,8 +327,11 @@ void MultiBufferMemoryAccounter::addBuffer(ConstBuffer buf) {
 NilMemoryAccounterImpl MemoryAccounterImpl::nil_accounter_;
 std::vector<std::unique_ptr<MemoryAccounter>>
     MemoryAccounterImpl::accounter_stack_;
+std::vector<const char*> MemoryAccounterImpl::label_stack_;
 } // namespace
 
+constexpr uint32_t MemoryAccounter::kPageSize;
+
 MemoryAccounter::~MemoryAccounter() = default;
 
 MemoryAccounterScope MemoryAccounter::NewScope(ConstBuffer buf) {
@@ -240,3 +350,12 @@ MemoryAccounterScope::~MemoryAccounterScope() {
   CHECK(!MemoryAccounterImpl::accounter_stack_.empty());
   MemoryAccounterImpl::accounter_stack_.pop_back();
 }
+
+MemoryAccounterLabel::MemoryAccounterLabel(const char* label) {
+  MemoryAccounterImpl::label_stack_.push_back(label);
+}
+
+MemoryAccounterLabel::~MemoryAccounterLabel() {
+  CHECK(!MemoryAccounterImpl::label_stack_.empty());
+  MemoryAccounterImpl::label_stack_.pop_back();
+}
@@ -10,6 +10,7 @@
 #include "OatmealUtil.h"
 
 #include <memory>
+#include <vector>
 
 class MemoryAccounter;
 
@@ -26,6 +27,16 @@ class MemoryAccounterScope {
   explicit MemoryAccounterScope(ConstBuffer buf);
 };
 
+// While alive, the ranges marked consumed are attributed to :label in the page
+// report. :label must outlive the current MemoryAccounter, e.g. be a literal.
+class MemoryAccounterLabel {
+ public:
+  explicit MemoryAccounterLabel(const char* label);
+  UNCOPYABLE(MemoryAccounterLabel);
+
+  ~MemoryAccounterLabel();
+};
+
 // Tracks which ranges of memory have been consumed during parsing,
 // so that we can easily identify sections that may have data we don't
 // yet understand.
@@ -55,6 +66,20 @@ class MemoryAccounter {
   virtual void markRangeConsumed(const char* ptr, uint32_t count) = 0;
   virtual void markBufferConsumed(ConstBuffer subBuffer) = 0;
   virtual void addBuffer(ConstBuffer buf) = 0;
+
+  // Attribute a range of the tracked buffers to a logical structure, for the
+  // page report, without marking it consumed.
+  virtual void labelRange(const char* ptr,
+                          uint32_t count,
+                          const char* label) = 0;
+
+  // For each of the given pages of the first tracked buffer, in order, print
+  // how many of its bytes belong to each logical structure, followed by the
+  // totals over all of them. Fed with the pages faulted in during startup,
+  // this shows which structures are worth laying out together.
+  virtual void printPageReport(const std::vector<uint32_t>& pages) = 0;
+
+  static constexpr uint32_t kPageSize = 0x1000;
 };
 
 inline MemoryAccounter* cur_ma() { return MemoryAccounter::Cur(); }
@@ -15,17 +15,52 @@ class IODIMetadata(object):
             magic, version, count, zero = struct.unpack("<LLLL", f.read(4 * 4))
             if magic != 0xFACEB001:
                 raise Exception("Unexpected magic: " + hex(magic))
-            if version != 1:
+            if version not in (1, 2):
                 raise Exception("Unexpected version: " + str(version))
             if zero != 0:
                 raise Exception("Unexpected zero: " + str(zero))
             self.entries = {}
+            if version == 2:
+                self._read_columnar(f, count)
+                return
             for _ in range(count):
                 klen, method_id = struct.unpack("<HQ", f.read(2 + 8))
                 form = "<" + str(klen) + "s"
                 key = struct.unpack(form, f.read(klen))[0].decode("ascii")
                 self.entries[key] = method_id
 
+    def _read_columnar(self, f, count):
+        def read_u32s(n):
+            return struct.unpack("<" + str(n) + "L", f.read(4 * n))
+
+        (signature_count,) = read_u32s(1)
+        signatures = read_u32s(signature_count)
+        key_offsets = read_u32s(count + 1)
+        read_u32s((count + 63) // 64)  # id block offsets, for random access
+        (ids_size,) = read_u32s(1)
+        ids = f.read(ids_size)
+        keys = f.read(key_offsets[count])
+
+        pos = 0
+
+        def read_uleb128():
+            nonlocal pos
+            result = 0
+            shift = 0
+            while True:
+                byte = ids[pos]
+                pos += 1
+                result |= (byte & 0x7F) << shift
+                if byte < 0x80:
+                    return result
+                shift += 7
+
+        for i in range(count):
+            signature = signatures[read_uleb128()]
+            method_idx = read_uleb128()
+            key = keys[key_offsets[i] : key_offsets[i + 1]].decode("ascii")
+            self.entries[key] = (method_idx << 32) | signature
+
     def _write(self, form, *vals):
         self._f.write(struct.pack(form, *vals))
 
@@ -0,0 +1,375 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "ReachabilityGraph.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace reachability_server {
+
+const char* to_string(NodeType type) {
+  switch (type) {
+  case NodeType::ANNO:
+    return "ANNO";
+  case NodeType::CLASS:
+    return "CLASS";
+  case NodeType::FIELD:
+    return "FIELD";
+  case NodeType::METHOD:
+    return "METHOD";
+  case NodeType::SEED:
+    return "SEED";
+  }
+  return "UNKNOWN";
+}
+
+namespace {
+
+class Reader {
+ public:
+  Reader(const char* data, size_t size) : m_cur(data), m_end(data + size) {}
+
+  template <typename T>
+  bool read(T* value) {
+    return read_bytes(value, sizeof(T));
+  }
+
+  bool read_bytes(void* out, size_t size) {
+    if ((size_t)(m_end - m_cur) < size) {
+      return false;
+    }
+    memcpy(out, m_cur, size);
+    m_cur += size;
+    return true;
+  }
+
+  bool at_end() const { return m_cur == m_end; }
+
+ private:
+  const char* m_cur;
+  const char* m_end;
+};
+
+// Compare the name of a node (given as a range of the names buffer) with
+// :str, like std::string::compare.
+int compare_name(const char* name, size_t name_size, const std::string& str) {
+  int cmp = memcmp(name, str.data(), std::min(name_size, str.size()));
+  if (cmp != 0) {
+    return cmp;
+  }
+  return name_size < str.size() ? -1 : (name_size > str.size() ? 1 : 0);
+}
+
+} // namespace
+
+bool ReachabilityGraph::load(const std::string& filename, std::string* error) {
+  std::ifstream ifs(filename, std::ios::binary);
+  if (!ifs) {
+    *error = "cannot open " + filename;
+    return false;
+  }
+  std::vector<char> data((std::istreambuf_iterator<char>(ifs)),
+                         std::istreambuf_iterator<char>());
+  Reader reader(data.data(), data.size());
+  auto truncated = [&]() {
+    *error = filename + " is truncated";
+    return false;
+  };
+
+  uint32_t magic;
+  uint32_t version;
+  if (!reader.read(&magic) || !reader.read(&version)) {
+    return truncated();
+  }
+  if (magic != 0xfaceb000) {
+    *error = "magic number mismatch";
+    return false;
+  }
+  if (version != 1) {
+    *error = "unsupported version " + std::to_string(version);
+    return false;
+  }
+
+  uint32_t nodes_count;
+  if (!reader.read(&nodes_count)) {
+    return truncated();
+  }
+  m_types.resize(nodes_count);
+  m_name_offsets.resize(nodes_count + 1);
+  m_retainer_offsets.resize(nodes_count + 1);
+  m_names.clear();
+  m_retainers.clear();
+  for (uint32_t i = 0; i < nodes_count; ++i) {
+    uint8_t type;
+    uint32_t name_size;
+    if (!reader.read(&type) || !reader.read(&name_size)) {
+      return truncated();
+    }
+    if (type > (uint8_t)NodeType::SEED) {
+      *error = "node " + std::to_string(i) + " has an unknown type";
+      return false;
+    }
+    m_types[i] = (NodeType)type;
+    m_name_offsets[i] = m_names.size();
+    m_names.resize(m_names.size() + name_size);
+    if (!reader.read_bytes(&m_names[m_name_offsets[i]], name_size)) {
+      return truncated();
+    }
+
+    uint32_t edges_count;
+    if (!reader.read(&edges_count)) {
+      return truncated();
+    }
+    m_retainer_offsets[i] = m_retainers.size();
+    m_retainers.resize(m_retainers.size() + edges_count);
+    if (!reader.read_bytes(m_retainers.data() + m_retainer_offsets[i],
+                           (size_t)edges_count * sizeof(NodeId))) {
+      return truncated();
+    }
+  }
+  m_name_offsets[nodes_count] = m_names.size();
+  m_retainer_offsets[nodes_count] = m_retainers.size();
+  if (!reader.at_end()) {
+    *error = "trailing data after the last node";
+    return false;
+  }
+  for (auto retainer : m_retainers) {
+    if (retainer >= nodes_count) {
+      *error = "edge to missing node " + std::to_string(retainer);
+      return false;
+    }
+  }
+
+  // Invert the edges with a counting pass, so that the retained nodes of each
+  // node are contiguous, too.
+  m_retained_offsets.assign(nodes_count + 1, 0);
+  for (auto retainer : m_retainers) {
+    ++m_retained_offsets[retainer + 1];
+  }
+  for (uint32_t i = 0; i < nodes_count; ++i) {
+    m_retained_offsets[i + 1] += m_retained_offsets[i];
+  }
+  m_retained.resize(m_retainers.size());
+  std::vector<uint32_t> fill(m_retained_offsets.begin(),
+                             m_retained_offsets.end() - 1);
+  for (uint32_t i = 0; i < nodes_count; ++i) {
+    for (auto j = m_retainer_offsets[i]; j < m_retainer_offsets[i + 1]; ++j) {
+      m_retained[fill[m_retainers[j]]++] = i;
+    }
+  }
+
+  build_name_index();
+  build_seed_distances();
+  build_dominators();
+  return true;
+}
+
+void ReachabilityGraph::build_seed_distances() {
+  // A breadth-first search from all the seeds at once.
+  m_seed_distance.assign(size(), UINT32_MAX);
+  std::vector<NodeId> queue;
+  for (NodeId i = 0; i < size(); ++i) {
+    if (m_types[i] == NodeType::SEED) {
+      m_seed_distance[i] = 0;
+      queue.push_back(i);
+    }
+  }
+  for (size_t i = 0; i < queue.size(); ++i) {
+    NodeId cur = queue[i];
+    for (auto j = m_retained_offsets[cur]; j < m_retained_offsets[cur + 1];
+         ++j) {
+      NodeId retained = m_retained[j];
+      if (m_seed_distance[retained] == UINT32_MAX) {
+        m_seed_distance[retained] = m_seed_distance[cur] + 1;
+        queue.push_back(retained);
+      }
+    }
+  }
+}
+
+void ReachabilityGraph::build_name_index() {
+  m_by_name.resize(size());
+  for (NodeId i = 0; i < size(); ++i) {
+    m_by_name[i] = i;
+  }
+  const char* names = m_names.data();
+  std::sort(m_by_name.begin(), m_by_name.end(), [&](NodeId a, NodeId b) {
+    size_t a_size = m_name_offsets[a + 1] - m_name_offsets[a];
+    size_t b_size = m_name_offsets[b + 1] - m_name_offsets[b];
+    int cmp = memcmp(names + m_name_offsets[a], names + m_name_offsets[b],
+                     std::min(a_size, b_size));
+    return cmp != 0 ? cmp < 0 : (a_size != b_size ? a_size < b_size : a < b);
+  });
+}
+
+/*
+ * The iterative algorithm from Cooper, Harvey and Kennedy's "A Simple, Fast
+ * Dominance Algorithm", on the graph whose edges go from retainers to the
+ * nodes they keep, with a virtual root that keeps every seed.
+ */
+void ReachabilityGraph::build_dominators() {
+  const NodeId root = size();
+  auto for_each_succ = [&](NodeId node, auto&& fn) {
+    if (node == root) {
+      for (NodeId i = 0; i < root; ++i) {
+        if (m_types[i] == NodeType::SEED) {
+          fn(i);
+        }
+      }
+    } else {
+      for (auto j = m_retained_offsets[node]; j < m_retained_offsets[node + 1];
+           ++j) {
+        fn(m_retained[j]);
+      }
+    }
+  };
+
+  // Postorder numbers, from an iterative DFS; the graphs are too deep for
+  // recursion.
+  std::vector<uint32_t> postorder(root + 1, UINT32_MAX);
+  std::vector<NodeId> rpo;
+  {
+    std::vector<bool> visited(root + 1, false);
+    std::vector<std::pair<NodeId, std::vector<NodeId>>> stack;
+    auto push = [&](NodeId node) {
+      visited[node] = true;
+      std::vector<NodeId> succs;
+      for_each_succ(node, [&](NodeId succ) {
+        if (!visited[succ]) {
+          succs.push_back(succ);
+        }
+      });
+      std::reverse(succs.begin(), succs.end());
+      stack.emplace_back(node, std::move(succs));
+    };
+    push(root);
+    while (!stack.empty()) {
+      auto& succs = stack.back().second;
+      while (!succs.empty() && visited[succs.back()]) {
+        succs.pop_back();
+      }
+      if (succs.empty()) {
+        postorder[stack.back().first] = rpo.size();
+        rpo.push_back(stack.back().first);
+        stack.pop_back();
+      } else {
+        NodeId succ = succs.back();
+        succs.pop_back();
+        push(succ);
+      }
+    }
+    std::reverse(rpo.begin(), rpo.end());
+  }
+
+  m_idom.assign(root + 1, NO_NODE);
+  m_idom[root] = root;
+  auto intersect = [&](NodeId a, NodeId b) {
+    while (a != b) {
+      while (postorder[a] < postorder[b]) {
+        a = m_idom[a];
+      }
+      while (postorder[b] < postorder[a]) {
+        b = m_idom[b];
+      }
+    }
+    return a;
+  };
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (auto node : rpo) {
+      if (node == root) {
+        continue;
+      }
+      NodeId new_idom = m_types[node] == NodeType::SEED ? root : NO_NODE;
+      for (auto j = m_retainer_offsets[node]; j < m_retainer_offsets[node + 1];
+           ++j) {
+        NodeId pred = m_retainers[j];
+        if (m_idom[pred] == NO_NODE) {
+          continue;
+        }
+        new_idom = new_idom == NO_NODE ? pred : intersect(pred, new_idom);
+      }
+      if (m_idom[node] != new_idom) {
+        m_idom[node] = new_idom;
+        changed = true;
+      }
+    }
+  }
+}
+
+std::vector<NodeId> ReachabilityGraph::find(const std::string& name) const {
+  const char* names = m_names.data();
+  auto cmp = [&](NodeId node) {
+    return compare_name(names + m_name_offsets[node],
+                        m_name_offsets[node + 1] - m_name_offsets[node], name);
+  };
+  auto begin = std::partition_point(m_by_name.begin(), m_by_name.end(),
+                                    [&](NodeId node) { return cmp(node) < 0; });
+  auto end = std::partition_point(begin, m_by_name.end(),
+                                  [&](NodeId node) { return cmp(node) == 0; });
+  return std::vector<NodeId>(begin, end);
+}
+
+std::vector<NodeId> ReachabilityGraph::search(const std::string& needle,
+                                              size_t limit) const {
+  std::vector<NodeId> result;
+  if (needle.empty()) {
+    return result;
+  }
+  // Search the names buffer as a whole, and only keep the matches that don't
+  // straddle two names.
+  size_t pos = 0;
+  while (result.size() < limit &&
+         (pos = m_names.find(needle, pos)) != std::string::npos) {
+    NodeId node = std::upper_bound(m_name_offsets.begin(),
+                                   m_name_offsets.end(), pos) -
+                  m_name_offsets.begin() - 1;
+    if (pos + needle.size() <= m_name_offsets[node + 1]) {
+      result.push_back(node);
+      pos = m_name_offsets[node + 1];
+    } else {
+      ++pos;
+    }
+  }
+  return result;
+}
+
+std::vector<NodeId> ReachabilityGraph::keep_chain(NodeId node) const {
+  // Any retainer that is one step closer to a seed is on a shortest chain, so
+  // there is no search here.
+  if (m_seed_distance[node] == UINT32_MAX) {
+    return {};
+  }
+  std::vector<NodeId> chain{node};
+  for (NodeId cur = node; m_seed_distance[cur] != 0;) {
+    for (auto j = m_retainer_offsets[cur];; ++j) {
+      NodeId retainer = m_retainers[j];
+      if (m_seed_distance[retainer] == m_seed_distance[cur] - 1) {
+        cur = retainer;
+        break;
+      }
+    }
+    chain.push_back(cur);
+  }
+  return chain;
+}
+
+std::vector<NodeId> ReachabilityGraph::dominators(NodeId node) const {
+  std::vector<NodeId> result;
+  const NodeId root = size();
+  for (NodeId cur = m_idom[node]; cur != NO_NODE && cur != root;
+       cur = m_idom[cur]) {
+    result.push_back(cur);
+  }
+  return result;
+}
+
+} // namespace reachability_server
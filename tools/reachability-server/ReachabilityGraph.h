@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace reachability_server {
+
+// Matches reachability::ReachableObjectType.
+enum class NodeType : uint8_t {
+  ANNO,
+  CLASS,
+  FIELD,
+  METHOD,
+  SEED,
+};
+
+const char* to_string(NodeType type);
+
+using NodeId = uint32_t;
+constexpr NodeId NO_NODE = UINT32_MAX;
+
+/*
+ * The graph written by reachability::dump_graph, loaded once into flat
+ * arrays: the names are concatenated into one buffer, and the edges in both
+ * directions are kept in CSR form (an offsets array per node into one edge
+ * array). The distance of each node from the nearest seed, and the dominator
+ * tree rooted at a virtual node that retains every seed, are computed when
+ * loading, so that all queries are cheap walks.
+ *
+ * Once loaded, a graph is immutable and may be queried from any number of
+ * threads.
+ */
+class ReachabilityGraph {
+ public:
+  // Returns false and sets :error if :filename isn't a valid dump.
+  bool load(const std::string& filename, std::string* error);
+
+  size_t size() const { return m_types.size(); }
+  size_t edges_size() const { return m_retainers.size(); }
+
+  NodeType type(NodeId node) const { return m_types[node]; }
+  std::string name(NodeId node) const {
+    return std::string(m_names.data() + m_name_offsets[node],
+                       m_name_offsets[node + 1] - m_name_offsets[node]);
+  }
+
+  // Nodes that keep :node, and nodes that :node keeps.
+  std::vector<NodeId> retainers(NodeId node) const {
+    return edges(m_retainer_offsets, m_retainers, node);
+  }
+  std::vector<NodeId> retained(NodeId node) const {
+    return edges(m_retained_offsets, m_retained, node);
+  }
+
+  // All nodes named :name. Annotations are named after their type, so the
+  // same name may stand for a class and any number of annotations.
+  std::vector<NodeId> find(const std::string& name) const;
+  // Up to :limit nodes whose name contains :needle.
+  std::vector<NodeId> search(const std::string& needle, size_t limit) const;
+
+  // A shortest chain of retainers from :node to a seed, starting with :node
+  // and ending with the seed. Empty if no seed keeps :node.
+  std::vector<NodeId> keep_chain(NodeId node) const;
+
+  // The dominators of :node, nearest first: every chain from a seed to :node
+  // goes through all of them. If there is more than one seed, the chain may
+  // end before reaching any seed. Empty if no seed keeps :node, or if :node is
+  // only dominated by the virtual root.
+  std::vector<NodeId> dominators(NodeId node) const;
+
+ private:
+  static std::vector<NodeId> edges(const std::vector<uint32_t>& offsets,
+                                   const std::vector<NodeId>& edges,
+                                   NodeId node) {
+    return std::vector<NodeId>(edges.begin() + offsets[node],
+                               edges.begin() + offsets[node + 1]);
+  }
+  void build_name_index();
+  void build_seed_distances();
+  void build_dominators();
+
+  std::vector<NodeType> m_types;
+  std::string m_names;
+  std::vector<uint32_t> m_name_offsets;
+  // Node ids sorted by name.
+  std::vector<NodeId> m_by_name;
+
+  std::vector<uint32_t> m_retainer_offsets;
+  std::vector<NodeId> m_retainers;
+  std::vector<uint32_t> m_retained_offsets;
+  std::vector<NodeId> m_retained;
+
+  // The length of the shortest chain from a seed to each node, or UINT32_MAX
+  // for nodes that no seed keeps.
+  std::vector<uint32_t> m_seed_distance;
+  // The immediate dominator of each node; size() stands for the virtual root,
+  // and NO_NODE for nodes that no seed keeps.
+  std::vector<NodeId> m_idom;
+};
+
+} // namespace reachability_server
@@ -0,0 +1,266 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+#include "ReachabilityGraph.h"
+
+/*
+ * Loads a reachability graph (the reachability-graph meta file that
+ * RemoveUnreachablePass writes with "emit_graph_on_run") once and answers
+ * "why is X kept?" queries against it, over a Unix domain socket or on stdin.
+ *
+ * The protocol is line based: each request is one line, and each response is
+ * any number of lines followed by an empty one. Nodes are given by name, or
+ * as #<id> to tell apart nodes with the same name (e.g. annotations).
+ *
+ *   chain NODE       A shortest chain of retainers from NODE to a seed.
+ *   dominators NODE  The nodes that every such chain goes through.
+ *   retainers NODE   The nodes that directly keep NODE.
+ *   retained NODE    The nodes that NODE directly keeps.
+ *   search TEXT      Up to 100 nodes whose name contains TEXT.
+ *   stats            The size of the graph.
+ */
+
+using namespace reachability_server;
+
+namespace {
+
+constexpr size_t SEARCH_LIMIT = 100;
+
+void print_node(const ReachabilityGraph& graph,
+                NodeId node,
+                std::ostream& out) {
+  out << "#" << node << " " << to_string(graph.type(node)) << ": "
+      << graph.name(node) << "\n";
+}
+
+void print_nodes(const ReachabilityGraph& graph,
+                 const std::vector<NodeId>& nodes,
+                 std::ostream& out) {
+  for (auto node : nodes) {
+    print_node(graph, node, out);
+  }
+}
+
+// Resolve the argument of a request to a single node. When a name matches
+// several nodes, prefer the one that isn't an annotation, like the Python
+// tools do.
+bool resolve_node(const ReachabilityGraph& graph,
+                  const std::string& arg,
+                  NodeId* node,
+                  std::ostream& out) {
+  if (!arg.empty() && arg[0] == '#') {
+    char* end;
+    auto id = strtoul(arg.c_str() + 1, &end, 10);
+    if (*end != '\0' || end == arg.c_str() + 1 || id >= graph.size()) {
+      out << "error: no node " << arg << "\n";
+      return false;
+    }
+    *node = id;
+    return true;
+  }
+  auto nodes = graph.find(arg);
+  if (nodes.empty()) {
+    out << "error: no node named " << arg << "\n";
+    return false;
+  }
+  *node = nodes[0];
+  for (auto candidate : nodes) {
+    if (graph.type(candidate) != NodeType::ANNO) {
+      *node = candidate;
+      break;
+    }
+  }
+  return true;
+}
+
+void handle_request(const ReachabilityGraph& graph,
+                    const std::string& line,
+                    std::ostream& out) {
+  auto start = std::chrono::steady_clock::now();
+  auto space = line.find(' ');
+  std::string command = line.substr(0, space);
+  std::string arg = space == std::string::npos ? "" : line.substr(space + 1);
+
+  NodeId node;
+  if (command == "stats") {
+    out << graph.size() << " nodes, " << graph.edges_size() << " edges\n";
+  } else if (command == "search") {
+    print_nodes(graph, graph.search(arg, SEARCH_LIMIT), out);
+  } else if (command == "chain" || command == "dominators" ||
+             command == "retainers" || command == "retained") {
+    if (resolve_node(graph, arg, &node, out)) {
+      if (command == "chain") {
+        auto chain = graph.keep_chain(node);
+        if (chain.empty()) {
+          out << "error: no seed keeps " << arg << "\n";
+        }
+        print_nodes(graph, chain, out);
+      } else if (command == "dominators") {
+        print_nodes(graph, graph.dominators(node), out);
+      } else if (command == "retainers") {
+        print_nodes(graph, graph.retainers(node), out);
+      } else {
+        print_nodes(graph, graph.retained(node), out);
+      }
+    }
+  } else {
+    out << "error: unknown request " << command << "\n";
+  }
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  out << "# " << elapsed.count() << " ms\n\n";
+}
+
+bool write_all(int fd, const std::string& data) {
+  size_t written = 0;
+  while (written < data.size()) {
+    auto n = write(fd, data.data() + written, data.size() - written);
+    if (n <= 0) {
+      return false;
+    }
+    written += n;
+  }
+  return true;
+}
+
+void serve_client(const ReachabilityGraph& graph, int fd) {
+  std::string pending;
+  char buffer[4096];
+  ssize_t n;
+  while ((n = read(fd, buffer, sizeof(buffer))) > 0) {
+    pending.append(buffer, n);
+    size_t newline;
+    while ((newline = pending.find('\n')) != std::string::npos) {
+      std::string line = pending.substr(0, newline);
+      pending.erase(0, newline + 1);
+      if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+      }
+      if (line == "quit") {
+        close(fd);
+        return;
+      }
+      std::ostringstream out;
+      handle_request(graph, line, out);
+      if (!write_all(fd, out.str())) {
+        close(fd);
+        return;
+      }
+    }
+  }
+  close(fd);
+}
+
+sockaddr_un socket_address(const std::string& path) {
+  sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+  return addr;
+}
+
+int serve(const ReachabilityGraph& graph, const std::string& path) {
+  if (path.size() >= sizeof(sockaddr_un::sun_path)) {
+    std::cerr << "Socket path is too long: " << path << "\n";
+    return 1;
+  }
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  auto addr = socket_address(path);
+  unlink(path.c_str());
+  if (fd == -1 || bind(fd, (sockaddr*)&addr, sizeof(addr)) == -1 ||
+      listen(fd, SOMAXCONN) == -1) {
+    std::cerr << "Cannot listen on " << path << ": " << strerror(errno)
+              << "\n";
+    return 1;
+  }
+  std::cerr << "Serving on " << path << "\n";
+  while (true) {
+    int client = accept(fd, nullptr, nullptr);
+    if (client == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      std::cerr << "accept failed: " << strerror(errno) << "\n";
+      return 1;
+    }
+    // The graph is immutable, so the clients need no synchronization.
+    std::thread(serve_client, std::cref(graph), client).detach();
+  }
+}
+
+int query(const std::string& path, const std::string& request) {
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  auto addr = socket_address(path);
+  if (fd == -1 || connect(fd, (sockaddr*)&addr, sizeof(addr)) == -1) {
+    std::cerr << "Cannot connect to " << path << ": " << strerror(errno)
+              << "\n";
+    return 1;
+  }
+  if (!write_all(fd, request + "\nquit\n")) {
+    std::cerr << "Cannot send the request\n";
+    return 1;
+  }
+  char buffer[4096];
+  ssize_t n;
+  while ((n = read(fd, buffer, sizeof(buffer))) > 0) {
+    std::cout.write(buffer, n);
+  }
+  close(fd);
+  return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  if (argc >= 4 && std::string("--query") == argv[1]) {
+    std::string request = argv[3];
+    for (int i = 4; i < argc; ++i) {
+      request += std::string(" ") + argv[i];
+    }
+    return query(argv[2], request);
+  }
+  if (argc != 2 && argc != 3) {
+    std::cerr << "Usage: reachability-server GRAPH_FILE [SOCKET]\n"
+              << "       reachability-server --query SOCKET REQUEST...\n"
+              << "Without a socket, requests are read from stdin.\n";
+    return 1;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  ReachabilityGraph graph;
+  std::string error;
+  if (!graph.load(argv[1], &error)) {
+    std::cerr << "Cannot load " << argv[1] << ": " << error << "\n";
+    return 1;
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::cerr << "Loaded " << graph.size() << " nodes and " << graph.edges_size()
+            << " edges in " << elapsed.count() << " s\n";
+
+  if (argc == 3) {
+    return serve(graph, argv[2]);
+  }
+  for (std::string line; std::getline(std::cin, line);) {
+    if (line == "quit") {
+      break;
+    }
+    handle_request(graph, line, std::cout);
+    std::cout.flush();
+  }
+  return 0;
+}
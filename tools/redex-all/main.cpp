@@ -8,6 +8,7 @@
 #include <cinttypes>
 #include <cstring>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <memory>
 #include <regex>
@@ -61,6 +62,7 @@
 #include "ToolsCommon.h"
 #include "Walkers.h"
 #include "Warning.h"
+#include "WorkQueue.h"
 
 namespace {
 
@@ -278,6 +280,11 @@ Arguments parse_args(int argc, char* argv[]) {
       po::bool_switch(&args.redex_options.redacted)->default_value(false),
       "If specified then resulting dex files will have class data placed at"
       " the end of the file, i.e. last map item entry just before map list.\n");
+  od.add_options()(
+      "low-memory",
+      po::bool_switch(&args.redex_options.low_memory)->default_value(false),
+      "If specified, frees memory more eagerly between passes, at the cost of"
+      " some run time.\n");
   od.add_options()(
       "arch,A",
       po::value<std::vector<std::string>>(),
@@ -557,6 +564,11 @@ Json::Value get_stats(const dex_stats_t& stats) {
 
   val["instruction_bytes"] = stats.instruction_bytes;
 
+  val["open_us"] = stats.open_us;
+  val["decode_us"] = stats.decode_us;
+  val["major_faults"] = stats.major_faults;
+  val["released_bytes"] = stats.released_bytes;
+
   val["header_item_count"] = stats.header_item_count;
   val["header_item_bytes"] = stats.header_item_bytes;
   val["string_id_count"] = stats.string_id_count;
@@ -665,6 +677,18 @@ Json::Value get_times() {
   return list;
 }
 
+Json::Value get_time_summary() {
+  Json::Value summary(Json::objectValue);
+  for (const auto& p : Timer::get_summary()) {
+    Json::Value element;
+    element["count"] = Json::UInt64(p.second.count);
+    element["wall"] = std::round(p.second.wall_s * 10) / 10.0;
+    element["cpu"] = std::round(p.second.cpu_s * 10) / 10.0;
+    summary[p.first] = element;
+  }
+  return summary;
+}
+
 Json::Value get_input_stats(const dex_stats_t& stats,
                             const std::vector<dex_stats_t>& dexes_stats) {
   Json::Value d;
@@ -770,9 +794,10 @@ void redex_frontend(ConfigFiles& conf, /* input */
                     DexStoresVector& stores,
                     Json::Value& stats) {
   Timer redex_frontend_timer("Redex_frontend");
-  for (const auto& pg_config_path : args.proguard_config_paths) {
-    Timer time_pg_parsing("Parsed ProGuard config file");
-    keep_rules::proguard_parser::parse_file(pg_config_path, &pg_config);
+  {
+    Timer time_pg_parsing("Parsed ProGuard config files");
+    keep_rules::proguard_parser::parse_files(args.proguard_config_paths,
+                                             &pg_config);
   }
   keep_rules::proguard_parser::remove_blacklisted_rules(&pg_config);
 
@@ -893,6 +918,23 @@ void redex_backend(const std::string& output_dir,
           "Will emit class-locator strings for classloader optimization");
     locator_index = new LocatorIndex(make_locator_index(stores));
   }
+  if (json_config.get("emit_locator_index", false)) {
+    Timer t("Writing class-locator indices");
+    std::unique_ptr<LocatorIndex> own_index;
+    const LocatorIndex* index = locator_index;
+    if (index == nullptr) {
+      own_index.reset(new LocatorIndex(make_locator_index(stores)));
+      index = own_index.get();
+    }
+    for (size_t store_number = 0; store_number < stores.size();
+         ++store_number) {
+      auto blob = make_locator_index_blob(*index, store_number);
+      std::ofstream out(output_dir + "/" + stores[store_number].get_name() +
+                            ".locator_index",
+                        std::ios::binary);
+      out.write((const char*)blob.data(), blob.size());
+    }
+  }
 
   dex_stats_t output_totals;
   std::vector<dex_stats_t> output_dexes_stats;
@@ -951,10 +993,13 @@ void redex_backend(const std::string& output_dir,
     post_lowering->finalize(manager.apk_manager());
   }
 
-  {
-    Timer t("Writing opt decisions data");
-    const Json::Value& opt_decisions_args = json_config["opt_decisions"];
-    if (opt_decisions_args.get("enable_logs", false).asBool()) {
+  // The metadata files are independent of each other and only read what the
+  // dex writing left behind, so they are written concurrently.
+  std::vector<std::function<void()>> metadata_writers;
+  const Json::Value& opt_decisions_args = json_config["opt_decisions"];
+  if (opt_decisions_args.get("enable_logs", false).asBool()) {
+    metadata_writers.push_back([&] {
+      Timer t("Writing opt decisions data");
       auto opt_decisions_output_path = conf.metafile(OPT_DECISIONS);
       auto opt_data =
           opt_metadata::OptDataMapper::get_instance().serialize_sql();
@@ -962,21 +1007,32 @@ void redex_backend(const std::string& output_dir,
         std::ofstream opt_data_out(opt_decisions_output_path);
         opt_data_out << opt_data;
       }
-    }
+    });
   }
-
-  {
-    Timer t("Writing stats");
-    auto method_move_map =
-        conf.metafile(json_config.get("method_move_map", std::string()));
-    if (needs_addresses) {
+  if (needs_addresses) {
+    metadata_writers.push_back([&] {
+      Timer t("Writing debug line mapping");
       write_debug_line_mapping(debug_line_map_filename, method_to_id,
                                code_debug_lines, stores);
-    }
-    if (is_iodi(dik)) {
-      iodi_metadata.write(iodi_metadata_filename, method_to_id);
-    }
+    });
+  }
+  if (is_iodi(dik)) {
+    metadata_writers.push_back([&] {
+      Timer t("Writing IODI metadata");
+      iodi_metadata.write(iodi_metadata_filename, method_to_id,
+                          json_config.get("iodi_metadata_columnar", false)
+                              ? IODIMetadata::Format::Columnar
+                              : IODIMetadata::Format::Entries);
+    });
+  }
+  metadata_writers.push_back([&] {
+    Timer t("Writing line number map");
     pos_mapper->write_map();
+  });
+
+  {
+    Timer t("Writing stats");
+    redex_parallel::run_tasks(metadata_writers);
     stats["output_stats"] = get_output_stats(
         output_totals, output_dexes_stats, manager, instruction_lowering_stats);
     print_warning_summary();
@@ -1061,6 +1117,7 @@ int main(int argc, char* argv[]) {
   block_multi_asserts(/*block=*/true);
 
   std::string stats_output_path;
+  std::string trace_output_path;
   Json::Value stats;
   {
     Timer redex_all_main_timer("redex-all main()");
@@ -1081,6 +1138,8 @@ int main(int argc, char* argv[]) {
 
     RedexContext::set_record_keep_reasons(
         args.config.get("record_keep_reasons", false).asBool());
+    RedexContext::set_lazy_balloon(
+        args.config.get("lazy_balloon", false).asBool());
 
     auto pg_config = std::make_unique<keep_rules::ProguardConfiguration>();
     DexStoresVector stores;
@@ -1123,6 +1182,10 @@ int main(int argc, char* argv[]) {
 
     stats_output_path = conf.metafile(
         args.config.get("stats_output", "redex-stats.txt").asString());
+    auto trace_output = args.config.get("chrome_trace_output", "").asString();
+    if (!trace_output.empty()) {
+      trace_output_path = conf.metafile(trace_output);
+    }
     {
       Timer t("Freeing global memory");
       delete g_redex;
@@ -1130,6 +1193,11 @@ int main(int argc, char* argv[]) {
   }
   // now that all the timers are done running, we can collect the data
   stats["output_stats"]["time_stats"] = get_times();
+  stats["output_stats"]["time_summary"] = get_time_summary();
+  if (!trace_output_path.empty()) {
+    std::ofstream out(trace_output_path);
+    Timer::write_chrome_trace(out);
+  }
   auto vm_stats = get_mem_stats();
   stats["output_stats"]["mem_stats"]["vm_peak"] =
       (Json::UInt64)vm_stats.vm_peak;
@@ -22,6 +22,7 @@ $ ./native/redex/tools/redex-tool/DexSqlQuery.py dex.db
 */
 
 #include <boost/algorithm/string/replace.hpp>
+#include <cstdarg>
 #include <queue>
 #include <unordered_map>
 #include <vector>
@@ -34,6 +35,7 @@ $ ./native/redex/tools/redex-tool/DexSqlQuery.py dex.db
 #include "Show.h"
 #include "Tool.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 namespace {
 
@@ -42,94 +44,188 @@ static std::unordered_map<DexMethod*, int> method_ids;
 static std::unordered_map<DexField*, int> field_ids;
 static std::unordered_map<DexString*, int> string_ids;
 
-void dump_field_refs(FILE* fdout,
-                     const char* prefix,
-                     DexField* field,
-                     int field_id) {
-  static int next_string_ref = 0;
-  auto* static_value = field->get_static_value();
-  if (!static_value || (static_value->evtype() != DEVT_STRING)) return;
-  auto* static_string_value = static_cast<DexEncodedValueString*>(static_value);
-  auto string_id = string_ids[static_string_value->string()];
-  fprintf(fdout,
-          "INSERT INTO %sfield_string_refs VALUES (%d, %d, %d);\n",
-          prefix,
-          next_string_ref++,
-          field_id,
-          string_id);
+// sqlite3 spends most of an import parsing statements, so rows are written as
+// multi-row INSERTs. SQLite versions before 3.8.8 limit those to 500 rows.
+constexpr size_t kRowsPerInsert = 500;
+
+// Buffers the rows of one table and writes them out in batches.
+class BatchedInserts {
+ public:
+  BatchedInserts(FILE* fdout, const char* prefix, const char* table)
+      : m_fdout(fdout), m_table(std::string(prefix) + table) {}
+
+  ~BatchedInserts() { flush(); }
+
+  // Adds a row from a printf-style format for its values, without the
+  // parentheses.
+  void add(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+    m_values += m_rows == 0 ? "(" : ",\n(";
+    va_list ap;
+    va_start(ap, fmt);
+    append_vprintf(fmt, ap);
+    va_end(ap);
+    m_values += ")";
+    if (++m_rows == kRowsPerInsert) {
+      flush();
+    }
+  }
+
+  void flush() {
+    if (m_rows == 0) {
+      return;
+    }
+    fprintf(m_fdout,
+            "INSERT INTO %s VALUES\n%s;\n",
+            m_table.c_str(),
+            m_values.c_str());
+    m_values.clear();
+    m_rows = 0;
+  }
+
+ private:
+  void append_vprintf(const char* fmt, va_list ap) {
+    va_list ap2;
+    va_copy(ap2, ap);
+    char buf[256];
+    int len = vsnprintf(buf, sizeof(buf), fmt, ap);
+    if (len < (int)sizeof(buf)) {
+      m_values.append(buf, len);
+    } else {
+      std::string big(len + 1, '\0');
+      vsnprintf(&big[0], len + 1, fmt, ap2);
+      m_values.append(big.data(), len);
+    }
+    va_end(ap2);
+  }
+
+  FILE* m_fdout;
+  std::string m_table;
+  std::string m_values;
+  size_t m_rows{0};
+};
+
+template <typename K>
+int get_id(const std::unordered_map<K*, int>& ids, K* key) {
+  auto it = ids.find(key);
+  return it == ids.end() ? -1 : it->second;
 }
 
-void dump_method_refs(FILE* fdout,
-                      const char* prefix,
-                      DexMethod* method,
-                      int method_id) {
+// The references from one method's code, as ids into the dumped tables.
+struct MethodRefs {
+  struct Ref {
+    int id;
+    uint16_t opcode;
+  };
+  std::vector<Ref> strings;
+  std::vector<Ref> classes;
+  std::vector<Ref> fields;
+  std::vector<Ref> methods;
+};
+
+// Only reads the id maps, so that the methods of a dex can be processed in
+// parallel.
+void collect_method_refs(DexMethod* method, MethodRefs* refs) {
   auto code = method->get_code();
   if (!code) return;
 
-  static int next_string_ref = 0;
-  static int next_class_ref = 0;
-  static int next_field_ref = 0;
-  static int next_method_ref = 0;
-
   for (auto& mie : InstructionIterable(code)) {
     auto insn = mie.insn;
     if (insn->has_string()) {
-      if (string_ids.count(insn->get_string())) {
-        auto string_id = string_ids[insn->get_string()];
-        fprintf(fdout,
-                "INSERT INTO %smethod_string_refs VALUES (%d, %d, %d, %d);\n",
-                prefix,
-                next_string_ref++,
-                method_id,
-                string_id,
-                insn->opcode());
+      auto string_id = get_id(string_ids, insn->get_string());
+      if (string_id != -1) {
+        refs->strings.push_back({string_id, insn->opcode()});
       }
     }
     if (insn->has_type()) {
       auto cls = type_class(insn->get_type());
-      if (cls && class_ids.count(cls)) {
-        auto class_id = class_ids[cls];
-        fprintf(fdout,
-                "INSERT INTO %smethod_class_refs VALUES (%d, %d, %d, %d);\n",
-                prefix,
-                next_class_ref++,
-                method_id,
-                class_id,
-                insn->opcode());
+      auto class_id = cls ? get_id(class_ids, cls) : -1;
+      if (class_id != -1) {
+        refs->classes.push_back({class_id, insn->opcode()});
       }
     }
     if (insn->has_field()) {
       auto field = resolve_field(insn->get_field());
-      if (field != nullptr && field_ids.count(field)) {
-        auto field_id = field_ids[field];
-        fprintf(fdout,
-                "INSERT INTO %smethod_field_refs VALUES (%d, %d, %d, %d);\n",
-                prefix,
-                next_field_ref++,
-                method_id,
-                field_id,
-                insn->opcode());
+      auto field_id = field != nullptr ? get_id(field_ids, field) : -1;
+      if (field_id != -1) {
+        refs->fields.push_back({field_id, insn->opcode()});
       }
     }
     if (insn->has_method()) {
       auto meth =
           resolve_method(insn->get_method(), opcode_to_search(insn), method);
-      if (meth != nullptr && method_ids.count(meth)) {
-        auto method_ref_id = method_ids[meth];
-        fprintf(fdout,
-                "INSERT INTO %smethod_method_refs VALUES (%d, %d, %d, %d);\n",
-                prefix,
-                next_method_ref++,
-                method_id,
-                method_ref_id,
-                insn->opcode());
+      auto method_ref_id = meth != nullptr ? get_id(method_ids, meth) : -1;
+      if (method_ref_id != -1) {
+        refs->methods.push_back({method_ref_id, insn->opcode()});
       }
     }
   }
 }
 
-void dump_class(FILE* fdout,
-                const char* prefix,
+struct RefTables {
+  RefTables(FILE* fdout, const char* prefix)
+      : field_strings(fdout, prefix, "field_string_refs"),
+        method_strings(fdout, prefix, "method_string_refs"),
+        method_classes(fdout, prefix, "method_class_refs"),
+        method_fields(fdout, prefix, "method_field_refs"),
+        method_methods(fdout, prefix, "method_method_refs") {}
+
+  BatchedInserts field_strings;
+  BatchedInserts method_strings;
+  BatchedInserts method_classes;
+  BatchedInserts method_fields;
+  BatchedInserts method_methods;
+  int next_field_string_ref{0};
+  int next_string_ref{0};
+  int next_class_ref{0};
+  int next_field_ref{0};
+  int next_method_ref{0};
+};
+
+void dump_field_refs(RefTables& tables, DexField* field, int field_id) {
+  auto* static_value = field->get_static_value();
+  if (!static_value || (static_value->evtype() != DEVT_STRING)) return;
+  auto* static_string_value = static_cast<DexEncodedValueString*>(static_value);
+  auto string_id = string_ids[static_string_value->string()];
+  tables.field_strings.add("%d, %d, %d",
+                           tables.next_field_string_ref++,
+                           field_id,
+                           string_id);
+}
+
+void dump_method_refs(RefTables& tables,
+                      const MethodRefs& refs,
+                      int method_id) {
+  for (const auto& ref : refs.strings) {
+    tables.method_strings.add("%d, %d, %d, %d",
+                              tables.next_string_ref++,
+                              method_id,
+                              ref.id,
+                              ref.opcode);
+  }
+  for (const auto& ref : refs.classes) {
+    tables.method_classes.add("%d, %d, %d, %d",
+                              tables.next_class_ref++,
+                              method_id,
+                              ref.id,
+                              ref.opcode);
+  }
+  for (const auto& ref : refs.fields) {
+    tables.method_fields.add("%d, %d, %d, %d",
+                             tables.next_field_ref++,
+                             method_id,
+                             ref.id,
+                             ref.opcode);
+  }
+  for (const auto& ref : refs.methods) {
+    tables.method_methods.add("%d, %d, %d, %d",
+                              tables.next_method_ref++,
+                              method_id,
+                              ref.id,
+                              ref.opcode);
+  }
+}
+
+void dump_class(BatchedInserts& classes,
                 const char* dex_id,
                 DexClass* cls,
                 int class_id) {
@@ -138,18 +234,15 @@ void dump_class(FILE* fdout,
   // TODO: string usage
   // TODO: size estimate
   const auto& deobfuscated_name = cls->get_deobfuscated_name();
-  fprintf(fdout,
-          "INSERT INTO %sclasses VALUES (%d,'%s','%s','%s',%u);\n",
-          prefix,
-          class_id,
-          dex_id,
-          deobfuscated_name.c_str(),
-          cls->get_name()->c_str(),
-          cls->get_access());
+  classes.add("%d,'%s','%s','%s',%u",
+              class_id,
+              dex_id,
+              deobfuscated_name.c_str(),
+              cls->get_name()->c_str(),
+              cls->get_access());
 }
 
-void dump_field(FILE* fdout,
-                const char* prefix,
+void dump_field(BatchedInserts& fields,
                 int class_id,
                 DexField* field,
                 int field_id) {
@@ -159,21 +252,19 @@ void dump_field(FILE* fdout,
   // TODO: string usage (encoded_value for static fields)
   const auto& deobfuscated_name = field->get_deobfuscated_name();
   auto field_name = strchr(deobfuscated_name.c_str(), ';');
-  fprintf(fdout,
-          "INSERT INTO %sfields VALUES(%d, %d, '%s', '%s', %u);\n",
-          prefix,
-          field_id,
-          class_id,
-          field_name,
-          field->get_name()->c_str(),
-          field->get_access());
+  fields.add("%d, %d, '%s', '%s', %u",
+             field_id,
+             class_id,
+             field_name,
+             field->get_name()->c_str(),
+             field->get_access());
 }
 
-void dump_method(FILE* fdout,
-                 const char* prefix,
+void dump_method(BatchedInserts& methods,
                  int class_id,
                  DexMethod* method,
-                 int method_id) {
+                 int method_id,
+                 size_t code_size) {
   // TODO: more fixup here on this crapped up name/signature
   // TODO: break down signature
   // TODO: throws?
@@ -182,23 +273,46 @@ void dump_method(FILE* fdout,
   // TODO: size estimate
   auto deobfuscated_name = method->get_deobfuscated_name();
   auto method_name = strchr(deobfuscated_name.c_str(), ';');
-  fprintf(fdout,
-          "INSERT INTO %smethods VALUES (%d,%d,'%s','%s',%d,%lu);\n",
-          prefix,
-          method_id,
-          class_id,
-          method_name,
-          method->get_name()->c_str(),
-          method->get_access(),
-          method->get_code() ? method->get_code()->sum_opcode_sizes() : 0);
+  methods.add("%d,%d,'%s','%s',%d,%lu",
+              method_id,
+              class_id,
+              method_name,
+              method->get_name()->c_str(),
+              method->get_access(),
+              code_size);
+}
+
+std::vector<DexMethod*> all_methods(const DexClasses& dex) {
+  std::vector<DexMethod*> methods;
+  for (const auto& cls : dex) {
+    methods.insert(
+        methods.end(), cls->get_dmethods().begin(), cls->get_dmethods().end());
+    methods.insert(
+        methods.end(), cls->get_vmethods().begin(), cls->get_vmethods().end());
+  }
+  return methods;
+}
+
+// Runs fn(i, &results[i]) for every element of :results, in parallel.
+template <typename T, typename Fn>
+void parallel_fill(std::vector<T>& results, const Fn& fn) {
+  auto wq = workqueue_foreach<size_t>([&](size_t i) { fn(i, &results[i]); });
+  for (size_t i = 0; i < results.size(); ++i) {
+    wq.add_item(i);
+  }
+  wq.run_all();
 }
 
 void dump_sql(FILE* fdout,
               DexStoresVector& stores,
               ProguardMap& pg_map,
               const char* prefix) {
+  // The database is built from scratch by the script, so there is nothing to
+  // recover if the import is interrupted.
   fprintf(fdout,
           R"___(
+PRAGMA journal_mode = OFF;
+PRAGMA synchronous = OFF;
 DROP TABLE IF EXISTS %1$sfield_string_refs;
 DROP TABLE IF EXISTS %1$smethod_string_refs;
 DROP TABLE IF EXISTS %1$smethod_field_refs;
@@ -278,79 +392,108 @@ CREATE TABLE %1$smethod_string_refs (
 
   // Dump all dex items
   fprintf(fdout, "BEGIN TRANSACTION;\n");
-  for (auto& store : stores) {
-    auto store_name = store.get_name();
-    auto& dexen = store.get_dexen();
-    apply_deobfuscated_names(dexen, pg_map);
-    for (size_t dex_idx = 0; dex_idx < dexen.size(); ++dex_idx) {
-      auto& dex = dexen[dex_idx];
-      GatheredTypes gtypes(&dex);
-      auto strings = gtypes.get_cls_order_dexstring_emitlist();
-      for (auto dexstr : strings) {
-        int id = next_string_id++;
-        string_ids[dexstr] = id;
-        // Escape string before inserting. ' -> ''
-        std::string esc(dexstr->c_str());
-        boost::replace_all(esc, "'", "''");
-        fprintf(fdout,
-                "INSERT INTO %sstrings VALUES(%d, '%s');\n",
-                prefix,
-                id,
-                esc.c_str());
-      }
-      std::string dex_id_str(store_name + "/" + std::to_string(dex_idx));
-      const char* dex_id = dex_id_str.c_str();
-      for (const auto& cls : dex) {
-        int class_id = next_class_id++;
-        dump_class(fdout, prefix, dex_id, cls, class_id);
-        class_ids[cls] = class_id;
-        for (auto field : cls->get_ifields()) {
-          int field_id = next_field_id++;
-          field_ids[field] = field_id;
-          dump_field(fdout, prefix, class_id, field, field_id);
+  {
+    BatchedInserts strings_table(fdout, prefix, "strings");
+    BatchedInserts classes_table(fdout, prefix, "classes");
+    BatchedInserts fields_table(fdout, prefix, "fields");
+    BatchedInserts methods_table(fdout, prefix, "methods");
+    for (auto& store : stores) {
+      auto store_name = store.get_name();
+      auto& dexen = store.get_dexen();
+      apply_deobfuscated_names(dexen, pg_map);
+      for (size_t dex_idx = 0; dex_idx < dexen.size(); ++dex_idx) {
+        auto& dex = dexen[dex_idx];
+        GatheredTypes gtypes(&dex);
+        auto strings = gtypes.get_cls_order_dexstring_emitlist();
+        for (auto dexstr : strings) {
+          int id = next_string_id++;
+          string_ids[dexstr] = id;
+          // Escape string before inserting. ' -> ''
+          std::string esc(dexstr->c_str());
+          boost::replace_all(esc, "'", "''");
+          strings_table.add("%d, '%s'", id, esc.c_str());
         }
-        for (auto field : cls->get_sfields()) {
-          int field_id = next_field_id++;
-          field_ids[field] = field_id;
-          dump_field(fdout, prefix, class_id, field, field_id);
-        }
-        for (const auto& meth : cls->get_dmethods()) {
-          int meth_id = next_method_id++;
-          method_ids[meth] = meth_id;
-          dump_method(fdout, prefix, class_id, meth, meth_id);
-        }
-        for (auto& meth : cls->get_vmethods()) {
-          int meth_id = next_method_id++;
-          method_ids[meth] = meth_id;
-          dump_method(fdout, prefix, class_id, meth, meth_id);
+        // Walking the code for its size is the only expensive part.
+        auto methods = all_methods(dex);
+        std::vector<size_t> code_sizes(methods.size());
+        parallel_fill(code_sizes, [&](size_t i, size_t* code_size) {
+          auto code = methods[i]->get_code();
+          *code_size = code ? code->sum_opcode_sizes() : 0;
+        });
+        size_t method_idx = 0;
+
+        std::string dex_id_str(store_name + "/" + std::to_string(dex_idx));
+        const char* dex_id = dex_id_str.c_str();
+        for (const auto& cls : dex) {
+          int class_id = next_class_id++;
+          dump_class(classes_table, dex_id, cls, class_id);
+          class_ids[cls] = class_id;
+          for (auto field : cls->get_ifields()) {
+            int field_id = next_field_id++;
+            field_ids[field] = field_id;
+            dump_field(fields_table, class_id, field, field_id);
+          }
+          for (auto field : cls->get_sfields()) {
+            int field_id = next_field_id++;
+            field_ids[field] = field_id;
+            dump_field(fields_table, class_id, field, field_id);
+          }
+          for (const auto& meth : cls->get_dmethods()) {
+            int meth_id = next_method_id++;
+            method_ids[meth] = meth_id;
+            dump_method(methods_table,
+                        class_id,
+                        meth,
+                        meth_id,
+                        code_sizes[method_idx++]);
+          }
+          for (auto& meth : cls->get_vmethods()) {
+            int meth_id = next_method_id++;
+            method_ids[meth] = meth_id;
+            dump_method(methods_table,
+                        class_id,
+                        meth,
+                        meth_id,
+                        code_sizes[method_idx++]);
+          }
         }
       }
     }
   }
   fprintf(fdout, "END TRANSACTION;\n");
 
-  // Dump references
+  // Dump references. The ids are all known by now, so the references of the
+  // methods of each dex are collected in parallel, and written out in order.
   fprintf(fdout, "BEGIN TRANSACTION;\n");
-  for (auto& store : stores) {
-    auto& dexen = store.get_dexen();
-    for (size_t dex_idx = 0; dex_idx < dexen.size(); ++dex_idx) {
-      auto& dex = dexen[dex_idx];
-      for (const auto& cls : dex) {
-        for (const auto& meth : cls->get_dmethods()) {
-          int meth_id = method_ids[meth];
-          dump_method_refs(fdout, prefix, meth, meth_id);
-        }
-        for (auto& meth : cls->get_vmethods()) {
-          int meth_id = method_ids[meth];
-          dump_method_refs(fdout, prefix, meth, meth_id);
-        }
-        for (const auto& field : cls->get_sfields()) {
-          int field_id = field_ids[field];
-          dump_field_refs(fdout, prefix, field, field_id);
-        }
-        for (const auto& field : cls->get_ifields()) {
-          int field_id = field_ids[field];
-          dump_field_refs(fdout, prefix, field, field_id);
+  {
+    RefTables ref_tables(fdout, prefix);
+    for (auto& store : stores) {
+      auto& dexen = store.get_dexen();
+      for (size_t dex_idx = 0; dex_idx < dexen.size(); ++dex_idx) {
+        auto& dex = dexen[dex_idx];
+        auto methods = all_methods(dex);
+        std::vector<MethodRefs> method_refs(methods.size());
+        parallel_fill(method_refs, [&](size_t i, MethodRefs* refs) {
+          collect_method_refs(methods[i], refs);
+        });
+        size_t method_idx = 0;
+        for (const auto& cls : dex) {
+          for (const auto& meth : cls->get_dmethods()) {
+            dump_method_refs(ref_tables,
+                             method_refs[method_idx++],
+                             method_ids.at(meth));
+          }
+          for (auto& meth : cls->get_vmethods()) {
+            dump_method_refs(ref_tables,
+                             method_refs[method_idx++],
+                             method_ids.at(meth));
+          }
+          for (const auto& field : cls->get_sfields()) {
+            dump_field_refs(ref_tables, field, field_ids.at(field));
+          }
+          for (const auto& field : cls->get_ifields()) {
+            dump_field_refs(ref_tables, field, field_ids.at(field));
+          }
         }
       }
     }
@@ -360,20 +503,23 @@ CREATE TABLE %1$smethod_string_refs (
   // Dump hierarchy
   auto scope = build_class_scope(stores);
   ClassHierarchy ch = build_type_hierarchy(scope);
+  std::vector<TypeSet> children(scope.size());
+  parallel_fill(children, [&](size_t i, TypeSet* results) {
+    get_all_children_or_implementors(ch, scope, scope[i], *results);
+  });
   int next_is_a_id = 0;
   fprintf(fdout, "BEGIN TRANSACTION;\n");
-  for (auto& cls : scope) {
-    TypeSet results;
-    get_all_children_or_implementors(ch, scope, cls, results);
-    for (auto type : results) {
-      auto type_cls = type_class(type);
-      if (type_cls) {
-        fprintf(fdout,
-                "INSERT INTO %sis_a VALUES(%d, %d, %d);\n",
-                prefix,
-                next_is_a_id++,
-                class_ids[type_cls],
-                class_ids[cls]);
+  {
+    BatchedInserts is_a_table(fdout, prefix, "is_a");
+    for (size_t i = 0; i < scope.size(); ++i) {
+      for (auto type : children[i]) {
+        auto type_cls = type_class(type);
+        if (type_cls) {
+          is_a_table.add("%d, %d, %d",
+                         next_is_a_id++,
+                         class_ids[type_cls],
+                         class_ids[scope[i]]);
+        }
       }
     }
   }
@@ -13,25 +13,56 @@ bool clean = false;
 bool raw = false;
 bool escape = false;
 
+static thread_local std::string* redump_buffer = nullptr;
+
+void set_redump_buffer(std::string* buffer) { redump_buffer = buffer; }
+
+static void vredump(const char* format, va_list va) {
+  if (redump_buffer == nullptr) {
+    vprintf(format, va);
+    return;
+  }
+  va_list va2;
+  va_copy(va2, va);
+  char buf[512];
+  int len = vsnprintf(buf, sizeof(buf), format, va);
+  if (len < (int)sizeof(buf)) {
+    redump_buffer->append(buf, len);
+  } else {
+    size_t start = redump_buffer->size();
+    redump_buffer->resize(start + len + 1);
+    vsnprintf(&(*redump_buffer)[start], len + 1, format, va2);
+    redump_buffer->resize(start + len);
+  }
+  va_end(va2);
+}
+
+static void redump_prefix(const char* format, ...) {
+  va_list va;
+  va_start(va, format);
+  vredump(format, va);
+  va_end(va);
+}
+
 void redump(const char* format, ...) {
   va_list va;
   va_start(va, format);
-  vprintf(format, va);
+  vredump(format, va);
   va_end(va);
 }
 
 void redump(uint32_t off, const char* format, ...) {
   va_list va;
   va_start(va, format);
-  if (!clean) printf("[0x%x] ", off);
-  vprintf(format, va);
+  if (!clean) redump_prefix("[0x%x] ", off);
+  vredump(format, va);
   va_end(va);
 }
 
 void redump(uint32_t pos, uint32_t off, const char* format, ...) {
   va_list va;
   va_start(va, format);
-  if (!clean) printf("(0x%x) [0x%x] ", pos, off);
-  vprintf(format, va);
+  if (!clean) redump_prefix("(0x%x) [0x%x] ", pos, off);
+  vredump(format, va);
   va_end(va);
 }
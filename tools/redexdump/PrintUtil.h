@@ -8,6 +8,7 @@
 #pragma once
 
 #include <stdint.h>
+#include <string>
 
 extern bool clean;
 extern bool raw;
@@ -16,3 +17,10 @@ extern bool escape;
 void redump(const char* format, ...);
 void redump(uint32_t off, const char* format, ...);
 void redump(uint32_t pos, uint32_t off, const char* format, ...);
+
+/*
+ * Make redump calls on the current thread append to :buffer instead of
+ * writing to stdout, or write to stdout again if :buffer is null. This lets
+ * sections be dumped on separate threads and printed in order.
+ */
+void set_redump_buffer(std::string* buffer);
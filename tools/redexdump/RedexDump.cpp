@@ -6,10 +6,18 @@
  */
 
 #include "RedexDump.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
 #include <getopt.h>
+#include <mutex>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "Formatters.h"
 #include "PrintUtil.h"
@@ -47,7 +55,55 @@ static const char ddump_usage_string[] =
     "printing options:\n"
     "--clean: suppress indices and offsets\n"
     "--no-headers: suppress headers\n"
-    "--raw: print all bytes, even control characters\n";
+    "--raw: print all bytes, even control characters\n"
+    "-j, --jobs=<n>: dump up to <n> sections at once (defaults to the number "
+    "of cores)\n";
+
+namespace {
+
+struct Section {
+  std::function<void()> dump;
+  std::string output;
+  bool done{false};
+};
+
+/*
+ * Dump the sections on :jobs threads, and print their output in order as
+ * soon as each one and all those before it are done.
+ */
+void dump_in_order(std::vector<Section>& sections, size_t jobs) {
+  std::mutex mutex;
+  std::condition_variable done_cv;
+  std::atomic<size_t> next{0};
+  auto worker = [&]() {
+    for (size_t i = next++; i < sections.size(); i = next++) {
+      set_redump_buffer(&sections[i].output);
+      sections[i].dump();
+      set_redump_buffer(nullptr);
+      std::lock_guard<std::mutex> lock(mutex);
+      sections[i].done = true;
+      done_cv.notify_all();
+    }
+  };
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < std::min(jobs, sections.size()); i++) {
+    threads.emplace_back(worker);
+  }
+  for (auto& section : sections) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      done_cv.wait(lock, [&]() { return section.done; });
+    }
+    fwrite(section.output.data(), 1, section.output.size(), stdout);
+    std::string().swap(section.output);
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  fflush(stdout);
+}
+
+} // namespace
 
 int main(int argc, char* argv[]) {
 
@@ -68,6 +124,7 @@ int main(int argc, char* argv[]) {
   bool redexdump_debug = false;
   uint32_t ddebug_offset = 0;
   int no_headers = 0;
+  size_t jobs = std::max(1u, std::thread::hardware_concurrency());
 
   char c;
   static const struct option options[] = {
@@ -92,10 +149,11 @@ int main(int argc, char* argv[]) {
       {"escape", no_argument, (int*)&escape, 1},
       {"no-headers", no_argument, &no_headers, 1},
       {"help", no_argument, nullptr, 'h'},
+      {"jobs", required_argument, nullptr, 'j'},
       {nullptr, 0, nullptr, 0},
   };
 
-  while ((c = getopt_long(argc, argv, "asStpfmcCxeAdDh", &options[0],
+  while ((c = getopt_long(argc, argv, "asStpfmcCxeAdDhj:", &options[0],
                           nullptr)) != -1) {
     switch (c) {
     case 'a':
@@ -146,6 +204,9 @@ int main(int argc, char* argv[]) {
     case 'D':
       sscanf(optarg, "%x", &ddebug_offset);
       break;
+    case 'j':
+      jobs = std::max(1, atoi(optarg));
+      break;
     case 'h':
       puts(ddump_usage_string);
       return 0;
@@ -164,62 +225,70 @@ int main(int argc, char* argv[]) {
     return 1;
   }
 
-  while (optind < argc) {
+  // Sections only read the mapped dex files, so every section of every file
+  // can be dumped independently.
+  std::vector<ddump_data> dexen(argc - optind);
+  std::vector<Section> sections;
+  auto add_section = [&](std::function<void()> dump) {
+    sections.emplace_back();
+    sections.back().dump = std::move(dump);
+  };
+  for (auto& rd_ref : dexen) {
+    auto* rd = &rd_ref;
     const char* dexfile = argv[optind++];
-    ddump_data rd;
-    open_dex_file(dexfile, &rd);
+    open_dex_file(dexfile, rd);
     if (!no_headers) {
-      redump(format_map(&rd).c_str());
+      add_section([=]() { redump(format_map(rd).c_str()); });
     }
     if (string || all) {
-      dump_strings(&rd, !no_headers);
+      add_section([=]() { dump_strings(rd, !no_headers); });
     }
     if (stringdata || all) {
-      dump_stringdata(&rd, !no_headers);
+      add_section([=]() { dump_stringdata(rd, !no_headers); });
     }
     if (type || all) {
-      dump_types(&rd);
+      add_section([=]() { dump_types(rd); });
     }
     if (proto || all) {
-      dump_protos(&rd, !no_headers);
+      add_section([=]() { dump_protos(rd, !no_headers); });
     }
     if (field || all) {
-      dump_fields(&rd, !no_headers);
+      add_section([=]() { dump_fields(rd, !no_headers); });
     }
     if (meth || all) {
-      dump_methods(&rd, !no_headers);
+      add_section([=]() { dump_methods(rd, !no_headers); });
     }
     if (methodhandle || all) {
-      dump_methodhandles(&rd, !no_headers);
+      add_section([=]() { dump_methodhandles(rd, !no_headers); });
     }
     if (callsite || all) {
-      dump_callsites(&rd, !no_headers);
+      add_section([=]() { dump_callsites(rd, !no_headers); });
     }
     if (clsdef || all) {
-      dump_clsdefs(&rd, !no_headers);
+      add_section([=]() { dump_clsdefs(rd, !no_headers); });
     }
     if (clsdata || all) {
-      dump_clsdata(&rd, !no_headers);
+      add_section([=]() { dump_clsdata(rd, !no_headers); });
     }
     if (code || all) {
-      dump_code(&rd);
+      add_section([=]() { dump_code(rd); });
     }
     if (enarr || all) {
-      dump_enarr(&rd);
+      add_section([=]() { dump_enarr(rd); });
     }
     if (anno || all) {
-      dump_anno(&rd);
+      add_section([=]() { dump_anno(rd); });
     }
 
     if (redexdump_debug || all) {
-      dump_debug(&rd);
+      add_section([=]() { dump_debug(rd); });
     }
     if (ddebug_offset != 0) {
-      disassemble_debug(&rd, ddebug_offset);
+      add_section([=]() { disassemble_debug(rd, ddebug_offset); });
     }
-    fprintf(stdout, "\n");
-    fflush(stdout);
+    add_section([]() { redump("\n"); });
   }
+  dump_in_order(sections, jobs);
 
   return 0;
 }
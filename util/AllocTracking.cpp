@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "AllocTracking.h"
+
+#include <atomic>
+
+namespace alloc_tracking {
+
+namespace {
+
+thread_local Category t_category = Category::OTHER;
+
+std::atomic<bool> s_sampler_installed{false};
+
+// Zero-initialized, as they have static storage duration.
+std::array<std::atomic<int64_t>, kNumCategories> s_live_bytes;
+
+} // namespace
+
+const char* category_name(Category category) {
+  switch (category) {
+  case Category::OTHER:
+    return "other";
+  case Category::IR:
+    return "ir";
+  case Category::CFG:
+    return "cfg";
+  case Category::ANALYSIS:
+    return "analysis";
+  case Category::INTERNING:
+    return "interning";
+  case Category::SIZE:
+    break;
+  }
+  return "unknown";
+}
+
+Category current_category() { return t_category; }
+
+Category set_current_category(Category category) {
+  auto previous = t_category;
+  t_category = category;
+  return previous;
+}
+
+void set_sampler_installed() { s_sampler_installed = true; }
+
+bool is_sampler_installed() { return s_sampler_installed; }
+
+void record_live_bytes(Category category, int64_t bytes) {
+  s_live_bytes[static_cast<size_t>(category)].fetch_add(
+      bytes, std::memory_order_relaxed);
+}
+
+std::array<int64_t, kNumCategories> get_live_bytes() {
+  std::array<int64_t, kNumCategories> live_bytes;
+  for (size_t i = 0; i < kNumCategories; ++i) {
+    live_bytes[i] = s_live_bytes[i].load(std::memory_order_relaxed);
+  }
+  return live_bytes;
+}
+
+} // namespace alloc_tracking
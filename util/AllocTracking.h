@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Attribution of allocations to coarse data structure categories.
+ *
+ * Code that builds a large data structure tags the allocations it makes on
+ * the current thread with a ScopedCategory. An allocation sampler, see
+ * MallocSampler.cpp, looks up the category of the allocations it samples and
+ * keeps an estimate of the live bytes per category, which PassManager reports
+ * at the end of each pass. Without a sampler linked in, tagging is only a
+ * thread-local store.
+ */
+namespace alloc_tracking {
+
+enum class Category : uint8_t {
+  OTHER,
+  IR,
+  CFG,
+  ANALYSIS,
+  INTERNING,
+  SIZE,
+};
+
+constexpr size_t kNumCategories = static_cast<size_t>(Category::SIZE);
+
+const char* category_name(Category category);
+
+// The category of the allocations of the current thread.
+Category current_category();
+
+// Sets the category of the allocations of the current thread, returning the
+// previous one.
+Category set_current_category(Category category);
+
+class ScopedCategory final {
+ public:
+  explicit ScopedCategory(Category category)
+      : m_previous(set_current_category(category)) {}
+
+  ~ScopedCategory() { set_current_category(m_previous); }
+
+  ScopedCategory(const ScopedCategory&) = delete;
+  ScopedCategory& operator=(const ScopedCategory&) = delete;
+
+ private:
+  Category m_previous;
+};
+
+/*
+ * The interface for samplers. They must not allocate in these.
+ */
+
+// Marks that a sampler is installed, so that there is something to report.
+void set_sampler_installed();
+bool is_sampler_installed();
+
+// Adds the (possibly negative) estimated bytes to the live bytes of the
+// category.
+void record_live_bytes(Category category, int64_t bytes);
+
+// The estimated live bytes of all categories.
+std::array<int64_t, kNumCategories> get_live_bytes();
+
+} // namespace alloc_tracking
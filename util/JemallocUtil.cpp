@@ -10,6 +10,7 @@
 #endif
 
 #include "Debug.h"
+#include "JemallocUtil.h"
 
 extern "C" {
 
@@ -35,6 +36,16 @@ void set_profile_active(bool active) {
   always_assert_log(err == 0, "mallctl failed with: %d", err);
 }
 
+bool read_size_stat(const char* name, uint64_t* value) {
+  size_t v;
+  size_t len = sizeof(v);
+  if (mallctl(name, &v, &len, nullptr, 0) != 0) {
+    return false;
+  }
+  *value = v;
+  return true;
+}
+
 } // namespace
 
 namespace jemalloc_util {
@@ -43,4 +54,32 @@ void enable_profiling() { set_profile_active(true); }
 
 void disable_profiling() { set_profile_active(false); }
 
+bool get_stats(Stats* stats) {
+  if (mallctl == nullptr) {
+    return false;
+  }
+  // The stats are only refreshed when the epoch is advanced.
+  uint64_t epoch = 1;
+  size_t len = sizeof(epoch);
+  if (mallctl("epoch", &epoch, &len, &epoch, len) != 0) {
+    return false;
+  }
+  Stats result;
+  if (!read_size_stat("stats.allocated", &result.allocated) ||
+      !read_size_stat("stats.active", &result.active)) {
+    return false;
+  }
+  *stats = result;
+  return true;
+}
+
+void purge_arenas() {
+  if (mallctl == nullptr) {
+    return;
+  }
+  // 4096 is MALLCTL_ARENAS_ALL, which addresses all arenas at once.
+  int err = mallctl("arena.4096.purge", nullptr, nullptr, nullptr, 0);
+  always_assert_log(err == 0, "mallctl failed with: %d", err);
+}
+
 } // namespace jemalloc_util
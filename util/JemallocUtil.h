@@ -5,6 +5,9 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#pragma once
+
+#include <cstdint>
 #include <cstdio>
 
 namespace jemalloc_util {
@@ -13,6 +16,21 @@ void enable_profiling();
 
 void disable_profiling();
 
+struct Stats {
+  // Bytes allocated by the application.
+  uint64_t allocated{0};
+  // Bytes in pages that hold allocations; at least `allocated`.
+  uint64_t active{0};
+};
+
+// Read jemalloc's current allocation stats. Returns false, leaving :stats
+// untouched, if the process does not run on jemalloc.
+bool get_stats(Stats* stats);
+
+// Return the unused dirty pages of all arenas to the OS. Does nothing if the
+// process does not run on jemalloc.
+void purge_arenas();
+
 class ScopedProfiling final {
  public:
   explicit ScopedProfiling(bool enable) {
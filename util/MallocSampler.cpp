@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * Sampling malloc, for attributing the memory of redex to the categories of
+ * AllocTracking.h. Like MallocDebug.cpp, it replaces the allocation functions
+ * of glibc when linked into a binary, e.g. a profiling build of redex-all;
+ * PassManager then reports the estimated live bytes of each category at the
+ * end of each pass.
+ *
+ * About one allocation per kSampleInterval bytes is sampled. A sample stands
+ * for at least kSampleInterval bytes, and is kept in a fixed-size table, with
+ * the category that was current when it was allocated, until it is freed. The
+ * estimate is thus coarse for small numbers of bytes, but costs a countdown on
+ * the allocation path and a lookup in a counting filter on the free path.
+ */
+
+#ifdef __linux__
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+
+#include "AllocTracking.h"
+
+extern "C" {
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t nelem, size_t elsize);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void* __libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void* ptr);
+}
+
+namespace {
+
+constexpr int64_t kSampleInterval = 512 * 1024;
+constexpr size_t kTableSize = 1 << 18;
+constexpr size_t kFilterSize = 1 << 16;
+
+struct Sample {
+  uintptr_t ptr;
+  int64_t bytes;
+  alloc_tracking::Category category;
+};
+
+thread_local int64_t t_bytes_until_sample = kSampleInterval;
+// Set while the sampler runs, so that nothing it calls gets sampled.
+thread_local bool t_in_sampler = false;
+
+// An open-addressing table of the live samples, allocated on first use.
+Sample* s_table = nullptr;
+size_t s_table_count = 0;
+std::mutex s_table_mutex;
+
+// The number of live samples per hash bucket, so that most frees need not
+// take the lock.
+std::atomic<uint16_t> s_filter[kFilterSize];
+
+size_t hash_ptr(uintptr_t ptr) {
+  uint64_t h = static_cast<uint64_t>(ptr >> 4) * 0x9E3779B97F4A7C15ull;
+  return static_cast<size_t>(h >> 32);
+}
+
+void insert_sample(uintptr_t ptr, int64_t bytes) {
+  auto category = alloc_tracking::current_category();
+  std::lock_guard<std::mutex> lock(s_table_mutex);
+  if (s_table == nullptr) {
+    s_table = static_cast<Sample*>(__libc_calloc(kTableSize, sizeof(Sample)));
+    if (s_table == nullptr) {
+      return;
+    }
+  }
+  // Keep the table at most half full, dropping the samples that don't fit.
+  if (s_table_count >= kTableSize / 2) {
+    return;
+  }
+  auto h = hash_ptr(ptr);
+  size_t i = h % kTableSize;
+  while (s_table[i].ptr != 0) {
+    i = (i + 1) % kTableSize;
+  }
+  s_table[i] = Sample{ptr, bytes, category};
+  ++s_table_count;
+  s_filter[h % kFilterSize].fetch_add(1, std::memory_order_relaxed);
+  alloc_tracking::record_live_bytes(category, bytes);
+}
+
+void remove_sample(uintptr_t ptr) {
+  auto h = hash_ptr(ptr);
+  auto& filter = s_filter[h % kFilterSize];
+  if (filter.load(std::memory_order_relaxed) == 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(s_table_mutex);
+  size_t i = h % kTableSize;
+  while (s_table[i].ptr != ptr) {
+    if (s_table[i].ptr == 0) {
+      return;
+    }
+    i = (i + 1) % kTableSize;
+  }
+  alloc_tracking::record_live_bytes(s_table[i].category, -s_table[i].bytes);
+  filter.fetch_sub(1, std::memory_order_relaxed);
+  --s_table_count;
+  // Shift the following entries of the probe sequence back over the hole.
+  size_t hole = i;
+  for (size_t j = (i + 1) % kTableSize; s_table[j].ptr != 0;
+       j = (j + 1) % kTableSize) {
+    size_t home = hash_ptr(s_table[j].ptr) % kTableSize;
+    // Move the entry if its home isn't cyclically within (hole, j].
+    bool stays = hole <= j ? (hole < home && home <= j)
+                           : (hole < home || home <= j);
+    if (!stays) {
+      s_table[hole] = s_table[j];
+      hole = j;
+    }
+  }
+  s_table[hole].ptr = 0;
+}
+
+void on_alloc(void* ptr, size_t size) {
+  if (ptr == nullptr || t_in_sampler) {
+    return;
+  }
+  t_bytes_until_sample -= static_cast<int64_t>(size);
+  if (t_bytes_until_sample > 0) {
+    return;
+  }
+  t_bytes_until_sample = kSampleInterval;
+  t_in_sampler = true;
+  insert_sample(reinterpret_cast<uintptr_t>(ptr),
+                std::max(static_cast<int64_t>(size), kSampleInterval));
+  t_in_sampler = false;
+}
+
+void on_free(void* ptr) {
+  if (ptr == nullptr || t_in_sampler) {
+    return;
+  }
+  t_in_sampler = true;
+  remove_sample(reinterpret_cast<uintptr_t>(ptr));
+  t_in_sampler = false;
+}
+
+struct InstallSampler {
+  InstallSampler() { alloc_tracking::set_sampler_installed(); }
+} s_install_sampler;
+
+} // namespace
+
+extern "C" {
+
+void* malloc(size_t size) {
+  auto ptr = __libc_malloc(size);
+  on_alloc(ptr, size);
+  return ptr;
+}
+
+void* calloc(size_t nelem, size_t elsize) {
+  auto ptr = __libc_calloc(nelem, elsize);
+  on_alloc(ptr, nelem * elsize);
+  return ptr;
+}
+
+void* realloc(void* ptr, size_t size) {
+  on_free(ptr);
+  auto new_ptr = __libc_realloc(ptr, size);
+  on_alloc(new_ptr, size);
+  return new_ptr;
+}
+
+void* memalign(size_t alignment, size_t size) {
+  auto ptr = __libc_memalign(alignment, size);
+  on_alloc(ptr, size);
+  return ptr;
+}
+
+int posix_memalign(void** out, size_t alignment, size_t size) {
+  auto ptr = __libc_memalign(alignment, size);
+  if (ptr == nullptr) {
+    return ENOMEM;
+  }
+  on_alloc(ptr, size);
+  *out = ptr;
+  return 0;
+}
+
+void free(void* ptr) {
+  on_free(ptr);
+  __libc_free(ptr);
+}
+}
+
+#endif
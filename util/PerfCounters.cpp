@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "PerfCounters.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include <cstring>
+
+namespace perf_counters {
+
+namespace {
+
+struct Event {
+  const char* name;
+  uint32_t type;
+  uint64_t config;
+};
+
+#ifdef __linux__
+constexpr Event kEvents[] = {
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"cache_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {"branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {"context_switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+};
+
+int open_counter(const Event& event) {
+  perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = event.type;
+  attr.config = event.config;
+  // Count the threads this one starts from now on as well.
+  attr.inherit = 1;
+  // Unprivileged processes may only count user space. Context switches
+  // happen in the kernel, though.
+  attr.exclude_kernel = event.type == PERF_TYPE_HARDWARE;
+  attr.exclude_hv = 1;
+  attr.read_format =
+      PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return (int)syscall(__NR_perf_event_open, &attr, /* pid */ 0, /* cpu */ -1,
+                      /* group_fd */ -1, /* flags */ 0);
+}
+#endif
+
+} // namespace
+
+ScopedPerfCounters::ScopedPerfCounters() {
+#ifdef __linux__
+  for (const auto& event : kEvents) {
+    m_fds.push_back(open_counter(event));
+  }
+#endif
+}
+
+ScopedPerfCounters::~ScopedPerfCounters() {
+#ifdef __linux__
+  for (auto fd : m_fds) {
+    if (fd != -1) {
+      close(fd);
+    }
+  }
+#endif
+}
+
+std::vector<std::pair<std::string, uint64_t>> ScopedPerfCounters::read()
+    const {
+  std::vector<std::pair<std::string, uint64_t>> counts;
+#ifdef __linux__
+  for (size_t i = 0; i < m_fds.size(); ++i) {
+    if (m_fds[i] == -1) {
+      continue;
+    }
+    struct {
+      uint64_t value;
+      uint64_t time_enabled;
+      uint64_t time_running;
+    } data;
+    if (::read(m_fds[i], &data, sizeof(data)) != sizeof(data) ||
+        data.time_running == 0) {
+      continue;
+    }
+    uint64_t value = data.value;
+    if (data.time_running < data.time_enabled) {
+      value = (uint64_t)((double)value * data.time_enabled /
+                         data.time_running);
+    }
+    counts.emplace_back(kEvents[i].name, value);
+  }
+#endif
+  return counts;
+}
+
+} // namespace perf_counters
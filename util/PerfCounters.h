@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace perf_counters {
+
+/*
+ * Counts CPU cycles, instructions, cache misses, branch misses and context
+ * switches of the process from construction on, through perf_event_open.
+ * Threads started after construction, e.g. the workers of a WorkQueue, are
+ * counted too, once they have exited.
+ *
+ * Events that the platform or the kernel's perf_event_paranoid setting don't
+ * allow are left out; off Linux, nothing is counted.
+ */
+class ScopedPerfCounters final {
+ public:
+  ScopedPerfCounters();
+  ~ScopedPerfCounters();
+
+  ScopedPerfCounters(const ScopedPerfCounters&) = delete;
+  ScopedPerfCounters& operator=(const ScopedPerfCounters&) = delete;
+
+  // The counted events so far, by name, e.g. "cycles". Counts are scaled up
+  // for the time the kernel had to multiplex the counters.
+  std::vector<std::pair<std::string, uint64_t>> read() const;
+
+ private:
+  // One per event, -1 if the event can't be counted.
+  std::vector<int> m_fds;
+};
+
+} // namespace perf_counters
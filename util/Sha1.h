@@ -39,3 +39,10 @@ void sha1_update(Sha1Context* context,
  * message digest and zeroizing the context.
  */
 void sha1_final(unsigned char* digest, Sha1Context* context);
+
+/*
+ * Whether SHA1 operations may use the CPU's SHA extensions, which they do by
+ * default when it has them. Returns whether the extensions are used from now
+ * on. Tests use this to check both implementations.
+ */
+bool sha1_set_cpu_extensions(bool enabled);